@@ -100,6 +100,15 @@ typedef struct
 static Options options;
 
 
+typedef struct PatchItem
+{
+    char *url;
+    unsigned char basesha256[32];
+    unsigned char sha256[32];
+    int64_t len;
+    struct PatchItem *next;
+} PatchItem;
+
 typedef struct ManifestItem
 {
     char *fname;
@@ -107,6 +116,7 @@ typedef struct ManifestItem
     int64_t len;
     int update;
     int rollback;
+    PatchItem *patches;
     struct ManifestItem *next;
 } ManifestItem;
 
@@ -119,6 +129,13 @@ static void freeManifest(void)
 
     while (item != NULL) {
         ManifestItem *next = item->next;
+        PatchItem *patch = item->patches;
+        while (patch != NULL) {
+            PatchItem *nextpatch = patch->next;
+            free(patch->url);
+            free(patch);
+            patch = nextpatch;
+        }
         free(item->fname);
         free(item);
         item = next;
@@ -488,7 +505,7 @@ static void parseArgv(int argc, char **argv)
     }
 }
 
-static void downloadURL(const char *from, const char *to)
+static int tryDownloadURL(const char *from, const char *to)
 {
     FILE *io = NULL;
     const size_t len = strlen(AUTOUPDATE_URL) + strlen(from) + 1;
@@ -509,7 +526,7 @@ static void downloadURL(const char *from, const char *to)
     if (!runHttpDownload(fullurl, io)) {
         fclose(io);
         remove(to);
-        die("Download failed");
+        return 0;
     }
 
     if (fclose(io) == EOF) {
@@ -517,6 +534,14 @@ static void downloadURL(const char *from, const char *to)
     }
 
     chmod(to, 0777);  /* !!! FIXME */
+    return 1;
+}
+
+static void downloadURL(const char *from, const char *to)
+{
+    if (!tryDownloadURL(from, to)) {
+        die("Download failed");
+    }
 }
 
 static int hexcvt(const int ch)
@@ -602,6 +627,91 @@ static void parseManifest(const char *fname)
     fclose(io);
 }
 
+/* The patch list is a separate file next to the manifest, so updaters that
+   predate it keep reading the manifest they know. Each entry is five lines:
+   the manifest item it produces, the sha256 of the installed file it
+   applies to, the patch's URL, its size, and its sha256. There may be
+   several entries per item, one for each older release. */
+static void parsePatches(const char *fname)
+{
+    ManifestItem *target = NULL;
+    PatchItem *patch = NULL;
+    int field = 0;
+    FILE *io = fopen(fname, "r");
+    char buf[512];
+    if (!io) {
+        die("Failed to open patch list for reading");
+    }
+
+    while (fgets(buf, sizeof (buf), io)) {
+        char *ptr = (buf + strlen(buf)) - 1;
+        while (ptr >= buf) {
+            if ((*ptr != '\n') && (*ptr != '\r')) {
+                break;
+            }
+            *ptr = '\0';
+            ptr--;
+        }
+
+        if (!patch && !buf[0]) {
+            continue;  /* blank line between entries or blank at EOF */
+        }
+
+        if (!patch) {
+            patch = (PatchItem *) calloc(1, sizeof (PatchItem));
+            if (!patch) {
+                outOfMemory();
+            }
+            for (target = manifest; target != NULL; target = target->next) {
+                if (strcmp(target->fname, buf) == 0) {
+                    break;
+                }
+            }
+            if (!target) {
+                infof("Patch for '%s', which isn't in the manifest", buf);
+            }
+            field = 1;
+        } else if (field == 1) {
+            if (strlen(buf) != 64) {
+                die("Invalid patch list");
+            }
+            convertSha256(buf, patch->basesha256);
+            field++;
+        } else if (field == 2) {
+            patch->url = strdup(buf);
+            if (!patch->url) {
+                outOfMemory();
+            }
+            field++;
+        } else if (field == 3) {
+            patch->len = atoll(buf);
+            field++;
+        } else {
+            if (strlen(buf) != 64) {
+                die("Invalid patch list");
+            }
+            convertSha256(buf, patch->sha256);
+            if (target) {
+                infof("Patch for '%s': %s", target->fname, patch->url);
+                patch->next = target->patches;
+                target->patches = patch;
+            } else {
+                free(patch->url);
+                free(patch);
+            }
+            patch = NULL;
+        }
+    }
+
+    if (ferror(io)) {
+        die("Error reading patch list");
+    } else if (patch) {
+        die("Incomplete patch list");
+    }
+
+    fclose(io);
+}
+
 static void read_file(const char *fname, void *buf, unsigned long *len)
 {
     ssize_t br;
@@ -680,6 +790,24 @@ static void downloadManifest(void)
     parseManifest(manifestfname);
 }
 
+static void downloadPatchList(void)
+{
+    const char *patchesfname = "updates/patches.txt";
+    const char *patchessigfname = "updates/patches.txt.sig";
+
+    /* not every release has patches; without them we get whole files. */
+    if (!tryDownloadURL("patches.txt", patchesfname)) {
+        info("No patch list, updated files will be downloaded in full");
+        return;
+    } else if (!tryDownloadURL("patches.txt.sig", patchessigfname)) {
+        info("No signature for the patch list, ignoring it");
+        return;
+    }
+
+    verifySignature(patchesfname, patchessigfname, PUBLICKEY_FNAME);
+    parsePatches(patchesfname);
+}
+
 static void upgradeSelfAndRestart(const char *argv0) NEVER_RETURNS;
 static void upgradeSelfAndRestart(const char *argv0)
 {
@@ -804,6 +932,201 @@ static int fileNeedsUpdate(const ManifestItem *item)
     return 0;
 }
 
+static int readVarint(FILE *io, uint64_t *val)
+{
+    int shift;
+    *val = 0;
+    for (shift = 0; shift < 64; shift += 7) {
+        const int ch = fgetc(io);
+        if (ch == EOF) {
+            return 0;
+        }
+        *val |= ((uint64_t) (ch & 0x7F)) << shift;
+        if (!(ch & 0x80)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int copyBytes(FILE *in, FILE *out, uint64_t len)
+{
+    char buf[4096];
+    while (len > 0) {
+        const size_t chunk = (len < sizeof (buf)) ? (size_t) len : sizeof (buf);
+        if (fread(buf, 1, chunk, in) != chunk) {
+            return 0;
+        } else if (fwrite(buf, chunk, 1, out) != 1) {
+            return 0;
+        }
+        len -= chunk;
+    }
+    return 1;
+}
+
+/* Patches are laid out like bsdiff's: an 8 byte "IOQ3DIF1" magic and the
+   new file's size, then blocks of (diff length, extra length, seek) until
+   the new file is complete. The diff bytes are added to the old file's
+   bytes from the current position, the extra bytes are copied as they are,
+   and the seek moves the old file's position on from the end of the diff.
+   bsdiff bzip2s the diff, which is mostly zeros where the releases agree;
+   we have no compressor to link against, so the diff is coded as runs of
+   (zeros, literal count, literals) instead. All numbers are LEB128, the
+   seek zigzagged since it can go backwards. All of it streams, so large
+   pk3s don't have to fit in memory. */
+static const char *applyPatch(const char *oldfname, const char *patchfname, const char *newfname)
+{
+    const char *why = NULL;
+    FILE *old = NULL;
+    FILE *patch = NULL;
+    FILE *out = NULL;
+    char magic[8];
+    uint64_t newlen = 0;
+    uint64_t newpos = 0;
+    int64_t oldpos = 0;
+
+    old = fopen(oldfname, "rb");
+    patch = fopen(patchfname, "rb");
+    buildParentDirs(newfname);
+    out = fopen(newfname, "wb");
+    if (!old || !patch || !out) {
+        why = "can't open files";
+    } else if ((fread(magic, sizeof (magic), 1, patch) != 1) || (memcmp(magic, "IOQ3DIF1", sizeof (magic)) != 0)) {
+        why = "not a patch";
+    } else if (!readVarint(patch, &newlen)) {
+        why = "truncated patch";
+    }
+
+    while (!why && (newpos < newlen)) {
+        uint64_t difflen, extralen, seek, remaining;
+
+        if (!readVarint(patch, &difflen) || !readVarint(patch, &extralen) || !readVarint(patch, &seek)) {
+            why = "truncated patch";
+            break;
+        } else if ((difflen > newlen - newpos) || (extralen > newlen - newpos - difflen)) {
+            why = "patch runs past the end of the new file";
+            break;
+        } else if (fseek(old, (long) oldpos, SEEK_SET) == -1) {
+            why = "patch seeks past the old file";
+            break;
+        }
+
+        for (remaining = difflen; !why && (remaining > 0); ) {
+            uint64_t zeros, literals;
+            if (!readVarint(patch, &zeros) || !readVarint(patch, &literals)) {
+                why = "truncated patch";
+            } else if ((zeros > remaining) || (literals > remaining - zeros)) {
+                why = "diff runs past its block";
+            } else if (!copyBytes(old, out, zeros)) {
+                why = "diff reads past the old file";
+            } else {
+                remaining -= zeros + literals;
+                while (literals-- > 0) {
+                    const int a = fgetc(old);
+                    const int b = fgetc(patch);
+                    if ((a == EOF) || (b == EOF)) {
+                        why = "diff reads past the old file";
+                        break;
+                    } else if (fputc((a + b) & 0xFF, out) == EOF) {
+                        why = "write failure";
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (!why && !copyBytes(patch, out, extralen)) {
+            why = "truncated patch";
+        }
+
+        oldpos += (int64_t) difflen + ((int64_t) (seek >> 1) ^ -((int64_t) (seek & 1)));
+        newpos += difflen + extralen;
+        if (!why && (oldpos < 0)) {
+            why = "patch seeks before the old file";
+        }
+    }
+
+    if (old) {
+        fclose(old);
+    }
+    if (patch) {
+        fclose(patch);
+    }
+    if (out && (fclose(out) == EOF) && !why) {
+        why = "close failure";
+    }
+
+    if (why) {
+        remove(newfname);
+    } else {
+        chmod(newfname, 0777);  /* !!! FIXME */
+    }
+    return why;
+}
+
+static int patchFile(const ManifestItem *item, const char *to)
+{
+    const char *patchpath = "updates/patches/";
+    const size_t len = strlen(patchpath) + strlen(item->fname) + 1;
+    char *patchfname = NULL;
+    const PatchItem *patch;
+    const char *why = NULL;
+    unsigned char sha256[32];
+    static int havePatchList = 0;
+
+    if (fileLength(item->fname) == -1) {
+        return 0;  /* nothing to patch. */
+    }
+
+    /* only fetched once something actually needs updating. */
+    if (!havePatchList) {
+        havePatchList = 1;
+        downloadPatchList();
+    }
+
+    if (!item->patches) {
+        return 0;
+    }
+
+    hashFile(item->fname, sha256);
+    for (patch = item->patches; patch != NULL; patch = patch->next) {
+        if (memcmp(patch->basesha256, sha256, 32) == 0) {
+            break;
+        }
+    }
+
+    if (!patch) {
+        infof("No patch from the installed '%s', getting the whole file", item->fname);
+        return 0;
+    }
+
+    patchfname = (char *) alloca(len);
+    if (!patchfname) {
+        outOfMemory();
+    }
+    snprintf(patchfname, len, "%s%s", patchpath, item->fname);
+
+    if (!tryDownloadURL(patch->url, patchfname)) {
+        why = "download failed";
+    } else if ((patch->len != fileLength(patchfname)) || !fileHashMatches(patchfname, patch->sha256)) {
+        why = "patch is incorrect or corrupted";
+    } else if (!(why = applyPatch(item->fname, patchfname, to)) &&
+               ((item->len != fileLength(to)) || !fileHashMatches(to, item->sha256))) {
+        remove(to);
+        why = "patched file is incorrect";
+    }
+
+    remove(patchfname);
+
+    if (why) {
+        infof("Patching '%s' failed (%s), getting the whole file", item->fname, why);
+        return 0;
+    }
+
+    infof("Patched '%s' with '%s'", item->fname, patch->url);
+    return 1;
+}
+
 static void downloadFile(const ManifestItem *item)
 {
     const char *outpath = "updates/downloads/";
@@ -817,7 +1140,7 @@ static void downloadFile(const ManifestItem *item)
 
     if ((item->len == fileLength(to)) && fileHashMatches(to, item->sha256)) {
         infof("Already downloaded '%s', not getting again", item->fname);
-    } else {
+    } else if (!patchFile(item, to)) {
         downloadURL(item->fname, to);
         if ((item->len != fileLength(to)) || !fileHashMatches(to, item->sha256)) {
             die("Download is incorrect or corrupted");
@@ -993,6 +1316,7 @@ int main(int argc, char **argv)
     makeDir("updates");
     makeDir("updates/downloads");
     makeDir("updates/rollbacks");
+    makeDir("updates/patches");
 
     logfile = fopen("updates/updater-log.txt", "a");
     if (!logfile) {
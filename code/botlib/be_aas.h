@@ -188,6 +188,14 @@ typedef struct aas_clientmove_s
 	int frames;				//number of frames predicted ahead
 } aas_clientmove_t;
 
+//one of the candidate inputs of a batched movement prediction
+typedef struct aas_clientmoveinput_s
+{
+	vec3_t velocity;		//start velocity
+	vec3_t cmdmove;			//movement command
+	int cmdframes;			//number of frames the command is applied
+} aas_clientmoveinput_t;
+
 // alternate route goals
 #define ALTROUTEGOAL_ALL				1
 #define ALTROUTEGOAL_CLUSTERPORTALS		2
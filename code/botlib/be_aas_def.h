@@ -40,6 +40,15 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define DF_CLIENTAASENT(x)		(&aasworld.entities[x + 1])
 
 //structure to link entities to areas and areas to entities
+//bsp tree node with its plane, so walking the tree doesn't look up planes
+typedef struct aas_tracenode_s
+{
+	vec3_t normal;
+	float dist;
+	int children[2];
+	int planenum;
+} aas_tracenode_t;
+
 typedef struct aas_link_s
 {
 	int entnum;
@@ -76,6 +85,10 @@ typedef struct aas_entity_s
 	aas_link_t *areas;
 	//links into the BSP leaves
 	bsp_link_t *leaves;
+	//what the links were made with, and how far the origin can move from
+	//there before they change, 0 when they have to be made again
+	vec3_t linkorigin, linkmins, linkmaxs;
+	float linkmargin;
 } aas_entity_t;
 
 typedef struct aas_settings_s
@@ -218,6 +231,7 @@ typedef struct aas_s
 	//nodes of the bsp tree
 	int numnodes;
 	aas_node_t *nodes;
+	aas_tracenode_t *tracenodes;				//the nodes with their planes
 	//cluster portals
 	int numportals;
 	aas_portal_t *portals;
@@ -241,6 +255,11 @@ typedef struct aas_s
 	aas_entity_t *entities;
 	//index to retrieve travel flag for a travel type
 	int travelflagfortype[MAX_TRAVELTYPES];
+	//least travel time per unit of distance for a travel type
+	float traveltimeperunit[MAX_TRAVELTYPES];
+	//the least of them for the travel flags last asked for
+	int boundtravelflags;
+	float boundtraveltimeperunit;
 	//travel flags for each area based on contents
 	int *areacontentstravelflags;
 	//routing update
@@ -55,11 +55,30 @@ enum {
 };
 
 //===========================================================================
+// qtrue when linking the entity again would give the same areas, only its
+// origin moved and not so far that its box touches another plane
 //
 // Parameter:				-
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
+static int AAS_EntityLinksValid(aas_entity_t *ent)
+{
+	vec3_t move;
+
+	if (ent->linkmargin <= 0) return qfalse;
+	if (!VectorCompare(ent->i.mins, ent->linkmins)) return qfalse;
+	if (!VectorCompare(ent->i.maxs, ent->linkmaxs)) return qfalse;
+	//no plane of the AAS tree is closer than the margin along any direction
+	VectorSubtract(ent->i.origin, ent->linkorigin, move);
+	return VectorLengthSquared(move) < ent->linkmargin * ent->linkmargin;
+} //end of the function AAS_EntityLinksValid
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 {
 	int relink;
@@ -83,6 +102,7 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 		ent->areas = NULL;
 		//
 		ent->leaves = NULL;
+		ent->linkmargin = 0;
 		return BLERR_NOERROR;
 	}
 
@@ -108,7 +128,11 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 	//updated so set valid flag
 	ent->i.valid = qtrue;
 	//link everything the first frame
-	if (aasworld.numframes == 1) relink = qtrue;
+	if (aasworld.numframes == 1)
+	{
+		relink = qtrue;
+		ent->linkmargin = 0;
+	} //end if
 	else relink = qfalse;
 	//
 	if (ent->i.solid == SOLID_BSP)
@@ -144,8 +168,8 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 	//if the entity should be relinked
 	if (relink)
 	{
-		//don't link the world model
-		if (entnum != ENTITYNUM_WORLD)
+		//don't link the world model, nor one that is still in the same areas
+		if (entnum != ENTITYNUM_WORLD && !AAS_EntityLinksValid(ent))
 		{
 			//absolute mins and maxs
 			VectorAdd(ent->i.mins, ent->i.origin, absmins);
@@ -153,7 +177,10 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 			//unlink the entity
 			AAS_UnlinkFromAreas(ent->areas);
 			//relink the entity to the AAS areas (use the larges bbox)
-			ent->areas = AAS_LinkEntityClientBBox(absmins, absmaxs, entnum, PRESENCE_NORMAL);
+			ent->areas = AAS_LinkEntityClientBBoxMargin(absmins, absmaxs, entnum, PRESENCE_NORMAL, &ent->linkmargin);
+			VectorCopy(ent->i.origin, ent->linkorigin);
+			VectorCopy(ent->i.mins, ent->linkmins);
+			VectorCopy(ent->i.maxs, ent->linkmaxs);
 			//unlink the entity from the BSP leaves
 			AAS_UnlinkFromBSPLeaves(ent->leaves);
 			//link the entity to the world BSP tree
@@ -330,6 +357,7 @@ void AAS_ResetEntityLinks(void)
 	{
 		aasworld.entities[i].areas = NULL;
 		aasworld.entities[i].leaves = NULL;
+		aasworld.entities[i].linkmargin = 0;
 	} //end for
 } //end of the function AAS_ResetEntityLinks
 //===========================================================================
@@ -367,6 +395,7 @@ void AAS_UnlinkInvalidEntities(void)
 			ent->areas = NULL;
 			AAS_UnlinkFromBSPLeaves( ent->leaves );
 			ent->leaves = NULL;
+			ent->linkmargin = 0;
 		} //end for
 	} //end for
 } //end of the function AAS_UnlinkInvalidEntities
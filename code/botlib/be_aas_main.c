@@ -262,6 +262,8 @@ int AAS_LoadMap(const char *mapname)
 	// to free the caches the old number of areas, number of clusters
 	// and number of areas in a clusters must be available
 	AAS_FreeRoutingCaches();
+	//release the map memory the routing data was allocated from
+	FreeMapMemory();
 	//load the map
 	errnum = AAS_LoadFiles(mapname);
 	if (errnum != BLERR_NOERROR)
@@ -269,6 +271,8 @@ int AAS_LoadMap(const char *mapname)
 		aasworld.loaded = qfalse;
 		return errnum;
 	} //end if
+	//build the tree used for the point and trace lookups
+	AAS_InitTraceNodes();
 	//
 	AAS_InitSettings();
 	//initialize the AAS link heap for the new map
@@ -319,10 +323,14 @@ void AAS_Shutdown(void)
 	AAS_DumpBSPData();
 	//free routing caches
 	AAS_FreeRoutingCaches();
+	//release the map memory the routing data was allocated from
+	FreeMapMemory();
 	//free aas link heap
 	AAS_FreeAASLinkHeap();
 	//free aas linked entities
 	AAS_FreeAASLinkedEntities();
+	//free the tree used for the lookups
+	AAS_FreeTraceNodes();
 	//free the aas data
 	AAS_DumpAASData();
 	//free the entities
@@ -995,6 +995,93 @@ int AAS_PredictClientMovement(struct aas_clientmove_s *move,
 										mins, maxs, visualize);
 } //end of the function AAS_PredictClientMovement
 //===========================================================================
+// all the candidates of a batched movement prediction start from the
+// same state, only the inputs differ
+//===========================================================================
+typedef struct aas_predictbatch_s
+{
+	aas_clientmove_t *moves;
+	aas_clientmoveinput_t *inputs;
+	int entnum;
+	vec3_t origin;
+	int presencetype;
+	int onground;
+	int maxframes;
+	float frametime;
+	int stopevent;
+	int stopareanum;
+} aas_predictbatch_t;
+
+#define MIN_PARALLEL_PREDICTIONS	4
+
+void AAS_PredictClientMovementJob(void *data, int index)
+{
+	aas_predictbatch_t *batch = (aas_predictbatch_t *) data;
+	aas_clientmoveinput_t *input = &batch->inputs[index];
+	vec3_t mins, maxs;
+
+	AAS_ClientMovementPrediction(&batch->moves[index], batch->entnum,
+								batch->origin, batch->presencetype, batch->onground,
+								input->velocity, input->cmdmove, input->cmdframes,
+								batch->maxframes, batch->frametime,
+								batch->stopevent, batch->stopareanum,
+								mins, maxs, qfalse);
+} //end of the function AAS_PredictClientMovementJob
+//===========================================================================
+// predicts the movement for every one of the candidate inputs, each
+// prediction stops at its own stop event, with enough candidates they
+// are spread over the worker threads
+//
+// Parameter:			moves			: numinputs movement predictions
+//						inputs			: numinputs candidate inputs
+// Returns:				the number of predictions that stopped on a stop event
+// Changes Globals:		-
+//===========================================================================
+int AAS_PredictClientMovements(struct aas_clientmove_s *moves,
+								int entnum, vec3_t origin,
+								int presencetype, int onground,
+								struct aas_clientmoveinput_s *inputs, int numinputs,
+								int maxframes, float frametime,
+								int stopevent, int stopareanum)
+{
+	aas_predictbatch_t batch;
+	int i, numstopped;
+
+	if (numinputs <= 0) return 0;
+	//
+	batch.moves = moves;
+	batch.inputs = inputs;
+	batch.entnum = entnum;
+	VectorCopy(origin, batch.origin);
+	batch.presencetype = presencetype;
+	batch.onground = onground;
+	batch.maxframes = maxframes;
+	batch.frametime = frametime;
+	batch.stopevent = stopevent;
+	batch.stopareanum = stopareanum;
+	//the jobs only trace and sample the world, from a job or with a
+	//handful of candidates the thread hand off costs more than it saves
+	if (numinputs < MIN_PARALLEL_PREDICTIONS || botimport.WorkerIndex() ||
+			botimport.NumWorkers() <= 0)
+	{
+		for (i = 0; i < numinputs; i++)
+		{
+			AAS_PredictClientMovementJob(&batch, i);
+		} //end for
+	} //end if
+	else
+	{
+		botimport.RunParallel(AAS_PredictClientMovementJob, &batch, numinputs);
+	} //end else
+	//
+	numstopped = 0;
+	for (i = 0; i < numinputs; i++)
+	{
+		if (moves[i].stopevent & stopevent) numstopped++;
+	} //end for
+	return numstopped;
+} //end of the function AAS_PredictClientMovements
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -41,6 +41,13 @@ int AAS_PredictClientMovement(struct aas_clientmove_s *move,
 							int cmdframes,
 							int maxframes, float frametime,
 							int stopevent, int stopareanum, int visualize);
+//movement prediction for several candidate inputs at once
+int AAS_PredictClientMovements(struct aas_clientmove_s *moves,
+							int entnum, vec3_t origin,
+							int presencetype, int onground,
+							struct aas_clientmoveinput_s *inputs, int numinputs,
+							int maxframes, float frametime,
+							int stopevent, int stopareanum);
 //predict movement until bounding box is hit
 int AAS_ClientMovementHitBBox(struct aas_clientmove_s *move,
 								int entnum, vec3_t origin,
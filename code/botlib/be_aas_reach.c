@@ -94,6 +94,8 @@ typedef struct aas_lreachability_s
 	int traveltype;					//type of travel required to get to the area
 	unsigned short int traveltime;	//travel time of the inter area movement
 	//
+	int listarea;					//area to add it to once the batch is done
+	int *counter;					//reach_ count to add it to
 	struct aas_lreachability_s *next;
 } aas_lreachability_t;
 //temporary reachabilities
@@ -102,6 +104,31 @@ aas_lreachability_t *nextreachability;	//next free reachability from the heap
 aas_lreachability_t **areareachability;	//reachability links for every area
 int numlreachabilities;
 
+//the reachabilities of a batch of areas are calculated in parallel, see
+//AAS_ParallelReachability
+#define MAX_REACHTHREADS					33
+#define REACHJOBS_PER_THREAD				4
+#define MAX_REACHFOREIGNAREAS				8
+//msec a frame calculates batches for
+#define REACHABILITY_PARALLELTIME			100
+
+typedef struct aas_reachjob_s
+{
+	int areanum;					//area the reachabilities are calculated for
+	aas_lreachability_t *first;		//created so far, in order
+	aas_lreachability_t *last;
+	int foreignareas[MAX_REACHFOREIGNAREAS];	//other areas looked at
+	int numforeignareas;			//-1 if more than MAX_REACHFOREIGNAREAS
+} aas_reachjob_t;
+
+static qboolean reachparallel;
+static void *reachmutex;
+static aas_reachjob_t *reachjobs;
+static int numreachjobs;
+static aas_reachjob_t *threadreachjob[MAX_REACHTHREADS];
+static int *reachbatch;				//last batch that added to the area of someone else
+static int reachbatchnum;
+
 //===========================================================================
 // returns the surface area of the given face
 //
@@ -488,16 +515,47 @@ aas_lreachability_t *AAS_AllocReachability(void)
 {
 	aas_lreachability_t *r;
 
-	if (!nextreachability) return NULL;
-	//make sure the error message only shows up once
-	if (!nextreachability->next) AAS_Error("AAS_MAX_REACHABILITYSIZE\n");
-	//
+	if (reachparallel) botimport.LockMutex(reachmutex);
 	r = nextreachability;
-	nextreachability = nextreachability->next;
-	numlreachabilities++;
+	if (r)
+	{
+		//make sure the error message only shows up once
+		if (!r->next) AAS_Error("AAS_MAX_REACHABILITYSIZE\n");
+		//
+		nextreachability = r->next;
+		numlreachabilities++;
+	} //end if
+	if (reachparallel) botimport.UnlockMutex(reachmutex);
 	return r;
 } //end of the function AAS_AllocReachability
 //===========================================================================
+// adds a new reachability link to the links of the area, while
+// calculating in parallel it waits with the job until the batch is done
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_AddReachability(int areanum, aas_lreachability_t *lreach, int *counter)
+{
+	aas_reachjob_t *job;
+
+	if (reachparallel)
+	{
+		job = threadreachjob[botimport.WorkerIndex()];
+		lreach->listarea = areanum;
+		lreach->counter = counter;
+		lreach->next = NULL;
+		if (job->last) job->last->next = lreach;
+		else job->first = lreach;
+		job->last = lreach;
+		return;
+	} //end if
+	lreach->next = areareachability[areanum];
+	areareachability[areanum] = lreach;
+	(*counter)++;
+} //end of the function AAS_AddReachability
+//===========================================================================
 // frees a reachability link
 //
 // Parameter:				-
@@ -785,11 +843,36 @@ unsigned short int AAS_BarrierJumpTravelTime(void)
 qboolean AAS_ReachabilityExists(int area1num, int area2num)
 {
 	aas_lreachability_t *r;
+	aas_reachjob_t *job;
+	int i;
 
 	for (r = areareachability[area1num]; r; r = r->next)
 	{
 		if (r->areanum == area2num) return qtrue;
 	} //end for
+	if (reachparallel)
+	{
+		job = threadreachjob[botimport.WorkerIndex()];
+		for (r = job->first; r; r = r->next)
+		{
+			if (r->listarea == area1num && r->areanum == area2num) return qtrue;
+		} //end for
+		//the other jobs of the batch might still add it, remember the area
+		if (area1num != job->areanum && job->numforeignareas >= 0)
+		{
+			for (i = 0; i < job->numforeignareas; i++)
+			{
+				if (job->foreignareas[i] == area1num) break;
+			} //end for
+			if (i >= job->numforeignareas)
+			{
+				if (job->numforeignareas < MAX_REACHFOREIGNAREAS)
+					job->foreignareas[job->numforeignareas++] = area1num;
+				else
+					job->numforeignareas = -1;
+			} //end if
+		} //end if
+	} //end if
 	return qfalse;
 } //end of the function AAS_ReachabilityExists
 //===========================================================================
@@ -889,9 +972,7 @@ int AAS_Reachability_Swim(int area1num, int area2num)
 						lreach->traveltime += 200;
 					//if (!(AAS_PointContents(start) & MASK_WATER)) lreach->traveltime += 500;
 					//link the reachability
-					lreach->next = areareachability[area1num];
-					areareachability[area1num] = lreach;
-					reach_swim++;
+					AAS_AddReachability(area1num, lreach, &reach_swim);
 					return qtrue;
 				} //end if
 			} //end if
@@ -1024,8 +1105,7 @@ int AAS_Reachability_EqualFloorHeight(int area1num, int area2num)
 		VectorCopy(lr.end, lreach->end);
 		lreach->traveltype = lr.traveltype;
 		lreach->traveltime = lr.traveltime;
-		lreach->next = areareachability[area1num];
-		areareachability[area1num] = lreach;
+		AAS_AddReachability(area1num, lreach, &reach_equalfloor);
 		//if going into a crouch area
 		if (!AAS_AreaCrouch(area1num) && AAS_AreaCrouch(area2num))
 		{
@@ -1041,7 +1121,6 @@ int AAS_Reachability_EqualFloorHeight(int area1num, int area2num)
 		//avoid rather small areas
 		//if (AAS_AreaGroundFaceArea(lreach->areanum) < 500) lreach->traveltime += 100;
 		//
-		reach_equalfloor++;
 		return qtrue;
 	} //end if
 	return qfalse;
@@ -1372,8 +1451,7 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 			{
 				lreach->traveltime += aassettings.rs_startcrouch;
 			} //end if
-			lreach->next = areareachability[area1num];
-			areareachability[area1num] = lreach;
+			AAS_AddReachability(area1num, lreach, &reach_step);
 			//NOTE: if there's nearby solid or a gap area after this area
 			/*
 			if (!AAS_NearbySolidOrGap(lreach->start, lreach->end))
@@ -1384,7 +1462,6 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 			//avoid rather small areas
 			//if (AAS_AreaGroundFaceArea(lreach->areanum) < 500) lreach->traveltime += 100;
 			//
-			reach_step++;
 			return qtrue;
 		} //end if
 	} //end if
@@ -1434,10 +1511,8 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 					VectorMA(water_bestend, INSIDEUNITS_WATERJUMP, water_bestnormal, lreach->end);
 					lreach->traveltype = TRAVEL_WATERJUMP;
 					lreach->traveltime = aassettings.rs_waterjump;
-					lreach->next = areareachability[area1num];
-					areareachability[area1num] = lreach;
+					AAS_AddReachability(area1num, lreach, &reach_waterjump);
 					//we've got another waterjump reachability
-					reach_waterjump++;
 					return qtrue;
 				} //end if
 			} //end if
@@ -1482,10 +1557,8 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 					VectorMA(ground_bestend, INSIDEUNITS_WALKEND, ground_bestnormal, lreach->end);
 					lreach->traveltype = TRAVEL_BARRIERJUMP;
 					lreach->traveltime = aassettings.rs_barrierjump;//AAS_BarrierJumpTravelTime();
-					lreach->next = areareachability[area1num];
-					areareachability[area1num] = lreach;
+					AAS_AddReachability(area1num, lreach, &reach_barrier);
 					//we've got another barrierjump reachability
-					reach_barrier++;
 					return qtrue;
 				} //end if
 			} //end if
@@ -1529,10 +1602,8 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 				VectorMA(ground_bestend, INSIDEUNITS_WALKEND, ground_bestnormal, lreach->end);
 				lreach->traveltype = TRAVEL_WALK;
 				lreach->traveltime = 1;
-				lreach->next = areareachability[area1num];
-				areareachability[area1num] = lreach;
+				AAS_AddReachability(area1num, lreach, &reach_walk);
 				//we've got another walk reachability
-				reach_walk++;
 				return qtrue;
 			} //end if
 			// if no maximum fall height set or less than the max
@@ -1580,10 +1651,8 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 									lreach->traveltime += aassettings.rs_falldamage10;
 								} //end if
 							} //end if
-							lreach->next = areareachability[area1num];
-							areareachability[area1num] = lreach;
+							AAS_AddReachability(area1num, lreach, &reach_walkoffledge);
 							//
-							reach_walkoffledge++;
 							//NOTE: don't create a weapon (rl, bfg) jump reachability here
 							//because it interferes with other reachabilities
 							//like the ladder reachability
@@ -2356,13 +2425,10 @@ int AAS_Reachability_Jump(int area1num, int area2num)
 				lreach->traveltime += aassettings.rs_falldamage10;
 			} //end if
 		} //end if
-		lreach->next = areareachability[area1num];
-		areareachability[area1num] = lreach;
-		//
 		if ((traveltype & TRAVELTYPE_MASK) == TRAVEL_JUMP)
-			reach_jump++;
+			AAS_AddReachability(area1num, lreach, &reach_jump);
 		else
-			reach_walkoffledge++;
+			AAS_AddReachability(area1num, lreach, &reach_walkoffledge);
 	} //end if
 	return qfalse;
 } //end of the function AAS_Reachability_Jump
@@ -2487,10 +2553,8 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 			VectorMA(area2point, -3, plane1->normal, lreach->end);
 			lreach->traveltype = TRAVEL_LADDER;
 			lreach->traveltime = 10;
-			lreach->next = areareachability[area1num];
-			areareachability[area1num] = lreach;
+			AAS_AddReachability(area1num, lreach, &reach_ladder);
 			//
-			reach_ladder++;
 			//create a new reachability link
 			lreach = AAS_AllocReachability();
 			if (!lreach) return qfalse;
@@ -2502,10 +2566,8 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 			VectorMA(area1point, -3, plane1->normal, lreach->end);
 			lreach->traveltype = TRAVEL_LADDER;
 			lreach->traveltime = 10;
-			lreach->next = areareachability[area2num];
-			areareachability[area2num] = lreach;
+			AAS_AddReachability(area2num, lreach, &reach_ladder);
 			//
-			reach_ladder++;
 			//
 			return qtrue;
 		} //end if
@@ -2526,10 +2588,8 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 			VectorMA(lreach->end, -15, plane1->normal, lreach->end);
 			lreach->traveltype = TRAVEL_LADDER;
 			lreach->traveltime = 10;
-			lreach->next = areareachability[area1num];
-			areareachability[area1num] = lreach;
+			AAS_AddReachability(area1num, lreach, &reach_ladder);
 			//
-			reach_ladder++;
 			//create a new reachability link
 			lreach = AAS_AllocReachability();
 			if (!lreach) return qfalse;
@@ -2540,10 +2600,8 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 			VectorCopy(area1point, lreach->end);
 			lreach->traveltype = TRAVEL_WALKOFFLEDGE;
 			lreach->traveltime = 10;
-			lreach->next = areareachability[area2num];
-			areareachability[area2num] = lreach;
+			AAS_AddReachability(area2num, lreach, &reach_walkoffledge);
 			//
-			reach_walkoffledge++;
 			//
 			return qtrue;
 		} //end if
@@ -2621,10 +2679,8 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 					VectorCopy(trace.endpos, lreach->end);
 					lreach->traveltype = TRAVEL_LADDER;
 					lreach->traveltime = 10;
-					lreach->next = areareachability[area1num];
-					areareachability[area1num] = lreach;
+					AAS_AddReachability(area1num, lreach, &reach_ladder);
 					//
-					reach_ladder++;
 					//create a new reachability link
 					lreach = AAS_AllocReachability();
 					if (!lreach) return qfalse;
@@ -2638,10 +2694,8 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 					lreach->end[2] += 10;
 					lreach->traveltype = TRAVEL_JUMP;
 					lreach->traveltime = 10;
-					lreach->next = areareachability[area2num];
-					areareachability[area2num] = lreach;
+					AAS_AddReachability(area2num, lreach, &reach_jump);
 					//
-					reach_jump++;	
 					//
 					return qtrue;
 #ifdef REACH_DEBUG
@@ -3906,10 +3960,8 @@ int AAS_Reachability_Grapple(int area1num, int area2num)
 		lreach->traveltype = TRAVEL_GRAPPLEHOOK;
 		VectorSubtract(lreach->end, lreach->start, dir);
 		lreach->traveltime = aassettings.rs_startgrapple + VectorLength(dir) * 0.25;
-		lreach->next = areareachability[area1num];
-		areareachability[area1num] = lreach;
+		AAS_AddReachability(area1num, lreach, &reach_grapple);
 		//
-		reach_grapple++;
 	} //end for
 	//
 	return qfalse;
@@ -4098,10 +4150,8 @@ int AAS_Reachability_WeaponJump(int area1num, int area2num)
 							lreach->traveltype = TRAVEL_ROCKETJUMP;
 							lreach->traveltime = aassettings.rs_rocketjump;
 						} //end else
-						lreach->next = areareachability[area1num];
-						areareachability[area1num] = lreach;
+						AAS_AddReachability(area1num, lreach, &reach_rocketjump);
 						//
-						reach_rocketjump++;
 						return qtrue;
 					} //end if
 				} //end if
@@ -4332,6 +4382,150 @@ void AAS_StoreReachability(void)
 	} //end for
 } //end of the function AAS_StoreReachability
 //===========================================================================
+// calculates the reachabilities from the area towards all other areas
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_CalculateAreaReachability(int i)
+{
+	int j;
+
+	//only create jumppad reachabilities from jumppad areas
+	if (aasworld.areasettings[i].contents & AREACONTENTS_JUMPPAD)
+	{
+		return;
+	} //end if
+	//loop over the areas
+	for (j = 1; j < aasworld.numareas; j++)
+	{
+		if (i == j) continue;
+		//never create reachabilities from teleporter or jumppad areas to regular areas
+		if (aasworld.areasettings[i].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD))
+		{
+			if (!(aasworld.areasettings[j].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD)))
+			{
+				continue;
+			} //end if
+		} //end if
+		//if there already is a reachability link from area i to j
+		if (AAS_ReachabilityExists(i, j)) continue;
+		//check for a swim reachability
+		if (AAS_Reachability_Swim(i, j)) continue;
+		//check for a simple walk on equal floor height reachability
+		if (AAS_Reachability_EqualFloorHeight(i, j)) continue;
+		//check for step, barrier, waterjump and walk off ledge reachabilities
+		if (AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(i, j)) continue;
+		//check for ladder reachabilities
+		if (AAS_Reachability_Ladder(i, j)) continue;
+		//check for a jump reachability
+		if (AAS_Reachability_Jump(i, j)) continue;
+	} //end for
+	//never create these reachabilities from teleporter or jumppad areas
+	if (aasworld.areasettings[i].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD))
+	{
+		return;
+	} //end if
+	//loop over the areas
+	for (j = 1; j < aasworld.numareas; j++)
+	{
+		if (i == j) continue;
+		//
+		if (AAS_ReachabilityExists(i, j)) continue;
+		//check for a grapple hook reachability
+		if (calcgrapplereach) AAS_Reachability_Grapple(i, j);
+		//check for a weapon jump reachability
+		AAS_Reachability_WeaponJump(i, j);
+	} //end for
+} //end of the function AAS_CalculateAreaReachability
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_ReachabilityJob(void *data, int index)
+{
+	aas_reachjob_t *job;
+	int thread;
+
+	job = &reachjobs[index];
+	thread = botimport.WorkerIndex();
+	threadreachjob[thread] = job;
+	AAS_CalculateAreaReachability(job->areanum);
+	threadreachjob[thread] = NULL;
+} //end of the function AAS_ReachabilityJob
+//===========================================================================
+// calculates the reachabilities of count areas starting at firstarea on
+// the worker threads, the result is exactly what calculating them one
+// after the other gives
+//
+// the jobs only read the links of the areas, the links they create are
+// kept with the job and added in area order once the batch is done. A job
+// that looked at links another job of the batch before it might have
+// added to is calculated again, as are all the jobs after it
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_ParallelReachability(int firstarea, int count)
+{
+	aas_reachjob_t *job;
+	aas_lreachability_t *r, *next;
+	qboolean again;
+	int i, j;
+
+	for (i = 0; i < count; i++)
+	{
+		job = &reachjobs[i];
+		job->areanum = firstarea + i;
+		job->first = job->last = NULL;
+		job->numforeignareas = 0;
+	} //end for
+	//
+	if (!reachmutex) reachmutex = botimport.CreateMutex();
+	reachparallel = qtrue;
+	botimport.RunParallel(AAS_ReachabilityJob, NULL, count);
+	reachparallel = qfalse;
+	//
+	reachbatchnum++;
+	again = qfalse;
+	for (i = 0; i < count; i++)
+	{
+		job = &reachjobs[i];
+		if (!again)
+		{
+			if (reachbatch[job->areanum] == reachbatchnum) again = qtrue;
+			if (job->numforeignareas < 0) again = qtrue;
+			for (j = 0; j < job->numforeignareas && !again; j++)
+			{
+				if (job->foreignareas[j] >= firstarea && job->foreignareas[j] < job->areanum) again = qtrue;
+				if (reachbatch[job->foreignareas[j]] == reachbatchnum) again = qtrue;
+			} //end for
+		} //end if
+		if (again)
+		{
+			for (r = job->first; r; r = next)
+			{
+				next = r->next;
+				AAS_FreeReachability(r);
+			} //end for
+			AAS_CalculateAreaReachability(job->areanum);
+			continue;
+		} //end if
+		for (r = job->first; r; r = next)
+		{
+			next = r->next;
+			if (r->listarea != job->areanum) reachbatch[r->listarea] = reachbatchnum;
+			r->next = areareachability[r->listarea];
+			areareachability[r->listarea] = r;
+			(*r->counter)++;
+		} //end for
+	} //end for
+} //end of the function AAS_ParallelReachability
+//===========================================================================
 //
 // TRAVEL_WALK					100%	equal floor height + steps
 // TRAVEL_CROUCH				100%
@@ -4358,7 +4552,7 @@ void AAS_StoreReachability(void)
 //===========================================================================
 int AAS_ContinueInitReachability(float time)
 {
-	int i, j, todo, start_time;
+	int i, todo, start_time, count;
 	static float framereachability, reachability_delay;
 	static int lastpercentage;
 
@@ -4377,57 +4571,26 @@ int AAS_ContinueInitReachability(float time)
 	todo = aasworld.numreachabilityareas + (int) framereachability;
 	start_time = Sys_MilliSeconds();
 	//loop over the areas
-	for (i = aasworld.numreachabilityareas; i < aasworld.numareas && i < todo; i++)
+	for (i = aasworld.numreachabilityareas; i < aasworld.numareas && i < todo; i += count)
 	{
-		aasworld.numreachabilityareas++;
-		//only create jumppad reachabilities from jumppad areas
-		if (aasworld.areasettings[i].contents & AREACONTENTS_JUMPPAD)
+		count = 1;
+		if (numreachjobs > 1)
 		{
-			continue;
+			count = numreachjobs;
+			if (count > aasworld.numareas - i) count = aasworld.numareas - i;
+			if (count > todo - i) count = todo - i;
 		} //end if
-		//loop over the areas
-		for (j = 1; j < aasworld.numareas; j++)
-		{
-			if (i == j) continue;
-			//never create reachabilities from teleporter or jumppad areas to regular areas
-			if (aasworld.areasettings[i].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD))
-			{
-				if (!(aasworld.areasettings[j].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD)))
-				{
-					continue;
-				} //end if
-			} //end if
-			//if there already is a reachability link from area i to j
-			if (AAS_ReachabilityExists(i, j)) continue;
-			//check for a swim reachability
-			if (AAS_Reachability_Swim(i, j)) continue;
-			//check for a simple walk on equal floor height reachability
-			if (AAS_Reachability_EqualFloorHeight(i, j)) continue;
-			//check for step, barrier, waterjump and walk off ledge reachabilities
-			if (AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(i, j)) continue;
-			//check for ladder reachabilities
-			if (AAS_Reachability_Ladder(i, j)) continue;
-			//check for a jump reachability
-			if (AAS_Reachability_Jump(i, j)) continue;
-		} //end for
-		//never create these reachabilities from teleporter or jumppad areas
-		if (aasworld.areasettings[i].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD))
+		aasworld.numreachabilityareas += count;
+		if (count > 1) AAS_ParallelReachability(i, count);
+		else AAS_CalculateAreaReachability(i);
+		//if the calculation took more time than the max reachability delay
+		if (Sys_MilliSeconds() - start_time > (int) reachability_delay) break;
+		//batches go on for a while before showing the progress
+		if (count > 1)
 		{
+			if (Sys_MilliSeconds() - start_time > REACHABILITY_PARALLELTIME) break;
 			continue;
 		} //end if
-		//loop over the areas
-		for (j = 1; j < aasworld.numareas; j++)
-		{
-			if (i == j) continue;
-			//
-			if (AAS_ReachabilityExists(i, j)) continue;
-			//check for a grapple hook reachability
-			if (calcgrapplereach) AAS_Reachability_Grapple(i, j);
-			//check for a weapon jump reachability
-			AAS_Reachability_WeaponJump(i, j);
-		} //end for
-		//if the calculation took more time than the max reachability delay
-		if (Sys_MilliSeconds() - start_time > (int) reachability_delay) break;
 		//
 		if (aasworld.numreachabilityareas * 1000 / aasworld.numareas > lastpercentage) break;
 	} //end for
@@ -4484,6 +4647,11 @@ int AAS_ContinueInitReachability(float time)
 		AAS_ShutDownReachabilityHeap();
 		//
 		FreeMemory(areareachability);
+		if (reachjobs) FreeMemory(reachjobs);
+		if (reachbatch) FreeMemory(reachbatch);
+		reachjobs = NULL;
+		reachbatch = NULL;
+		numreachjobs = 0;
 		//
 		aasworld.numreachabilityareas++;
 		//
@@ -4505,6 +4673,8 @@ int AAS_ContinueInitReachability(float time)
 //===========================================================================
 void AAS_InitReachability(void)
 {
+	int numthreads;
+
 	if (!aasworld.loaded) return;
 
 	if (aasworld.reachabilitysize)
@@ -4532,6 +4702,15 @@ void AAS_InitReachability(void)
 	//allocate area reachability link array
 	areareachability = (aas_lreachability_t **) GetClearedMemory(
 									aasworld.numareas * sizeof(aas_lreachability_t *));
+	//calculate batches of areas on the worker threads
+	numthreads = botimport.NumWorkers() + 1;
+	if (numthreads > 1 && numthreads <= MAX_REACHTHREADS)
+	{
+		numreachjobs = numthreads * REACHJOBS_PER_THREAD;
+		reachjobs = (aas_reachjob_t *) GetClearedMemory(numreachjobs * sizeof(aas_reachjob_t));
+		reachbatch = (int *) GetClearedMemory(aasworld.numareas * sizeof(int));
+		reachbatchnum = 0;
+	} //end if
 	//
 	AAS_SetWeaponJumpAreaFlags();
 } //end of the function AAS_InitReachable
@@ -51,6 +51,10 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define DISTANCEFACTOR_CROUCH		1.3f		//crouch speed = 100
 #define DISTANCEFACTOR_SWIM			1		//should be 0.66, swim speed = 150
 #define DISTANCEFACTOR_WALK			0.33f	//walk speed = 300
+//see AAS_InitTravelTimeBounds
+#define BOUND_AREATIMEPERUNIT		0.07f
+#define BOUND_SHORTREACH			8
+#define BOUND_AREAEPSILON			16
 
 //cache refresh time
 #define CACHE_REFRESHTIME		15.0f	//15 seconds refresh time
@@ -84,20 +88,96 @@ int numportalcacheupdates;
 int routingcachesize;
 int max_routingcachesize;
 
+//routing cache statistics, see AAS_RoutingInfo
+static int routingcachepeak;
+static int areacachehits, areacachemisses;
+static int portalcachehits, portalcachemisses;
+static int routingcacheevictions;
+
+/*
+
+  parallel routing:
+  while AAS_ParallelRouting runs jobs on worker threads the cache lists,
+  the LRU list and all memory allocation are protected by routingmutex,
+  caches are built outside the lock in per thread update fields and
+  no cache is ever freed
+
+*/
+
+#define MAX_ROUTINGTHREADS		33		//the main thread and up to 32 workers
+
+static qboolean routingparallel;
+static void *routingmutex;
+static int numareaupdates;
+static aas_routingupdate_t *threadareaupdate[MAX_ROUTINGTHREADS];
+static aas_routingupdate_t *threadportalupdate[MAX_ROUTINGTHREADS];
+
+/*
+
+  routing table:
+  optional table with the travel times and first reachabilities from
+  every area to every goal area for a single set of travel flags, built
+  at load time on small maps or read from the route cache file; it is
+  not used while any area is enabled or disabled compared to the time
+  the table was built for
+
+*/
+
+#define RTID						(('B'<<24)+('A'<<16)+('T'<<8)+'R')
+
+//the routing table header, follows the routing cache in the route cache
+//file and is followed by the disabled area bits, the travel times and
+//the reachabilities
+typedef struct routingtableheader_s
+{
+	int ident;
+	int numareas;
+	int travelflags;
+} routingtableheader_t;
+
+typedef struct routingtable_s
+{
+	int travelflags;					//travel flags the table is for
+	int changes;						//number of areas enabled or disabled since
+	byte *disabled;						//bits set for the areas disabled in the table
+	unsigned short int *traveltimes;	//[goalareanum * numareas + areanum], 0 if unreachable
+	unsigned char *reachabilities;		//first reachability relative to firstreachablearea
+} routingtable_t;
+
+static routingtable_t routingtable;
+
 //===========================================================================
 //
 // Parameter:			-
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-#ifdef ROUTING_DEBUG
 void AAS_RoutingInfo(void)
 {
+#ifdef ROUTING_DEBUG
 	botimport.Print(PRT_MESSAGE, "%d area cache updates\n", numareacacheupdates);
 	botimport.Print(PRT_MESSAGE, "%d portal cache updates\n", numportalcacheupdates);
-	botimport.Print(PRT_MESSAGE, "%d bytes routing cache\n", routingcachesize);
-} //end of the function AAS_RoutingInfo
 #endif //ROUTING_DEBUG
+	botimport.Print(PRT_MESSAGE, "%d KB routing cache, peak %d KB, budget %d KB\n",
+						routingcachesize >> 10, routingcachepeak >> 10, max_routingcachesize >> 10);
+	botimport.Print(PRT_MESSAGE, "%d area cache hits, %d misses\n", areacachehits, areacachemisses);
+	botimport.Print(PRT_MESSAGE, "%d portal cache hits, %d misses\n", portalcachehits, portalcachemisses);
+	botimport.Print(PRT_MESSAGE, "%d caches evicted\n", routingcacheevictions);
+	botimport.Print(PRT_MESSAGE, "%d KB map memory\n", MapMemorySize() >> 10);
+} //end of the function AAS_RoutingInfo
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_ResetRoutingInfo(void)
+{
+	routingcachepeak = routingcachesize;
+	areacachehits = areacachemisses = 0;
+	portalcachehits = portalcachemisses = 0;
+	routingcacheevictions = 0;
+} //end of the function AAS_ResetRoutingInfo
 //===========================================================================
 // returns the number of the area in the cluster
 // assumes the given area is in the given cluster or a portal of the cluster
@@ -128,6 +208,26 @@ static ID_INLINE int AAS_ClusterAreaNum(int cluster, int areanum)
 } //end of the function AAS_ClusterAreaNum
 //===========================================================================
 //
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE void AAS_LockRouting(void)
+{
+	if (routingparallel) botimport.LockMutex(routingmutex);
+} //end of the function AAS_LockRouting
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE void AAS_UnlockRouting(void)
+{
+	if (routingparallel) botimport.UnlockMutex(routingmutex);
+} //end of the function AAS_UnlockRouting
+//===========================================================================
+//
 // Parameter:			-
 // Returns:				-
 // Changes Globals:		-
@@ -196,8 +296,21 @@ int AAS_TravelFlagForType(int traveltype)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+static ID_INLINE int AAS_PinnedCache(aas_routingcache_t *cache)
+{
+	//area cache leading towards a portal is never freed
+	return cache->type == CACHETYPE_AREA && aasworld.areasettings[cache->areanum].cluster < 0;
+} //end of the function AAS_PinnedCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 void AAS_UnlinkCache(aas_routingcache_t *cache)
 {
+	//pinned caches are not in the LRU list
+	if (AAS_PinnedCache(cache)) return;
 	if (cache->time_next) cache->time_next->time_prev = cache->time_prev;
 	else aasworld.newestcache = cache->time_prev;
 	if (cache->time_prev) cache->time_prev->time_next = cache->time_next;
@@ -213,6 +326,12 @@ void AAS_UnlinkCache(aas_routingcache_t *cache)
 //===========================================================================
 void AAS_LinkCache(aas_routingcache_t *cache)
 {
+	if (AAS_PinnedCache(cache))
+	{
+		cache->time_prev = NULL;
+		cache->time_next = NULL;
+		return;
+	} //end if
 	if (aasworld.newestcache)
 	{
 		aasworld.newestcache->time_next = cache;
@@ -236,7 +355,7 @@ void AAS_FreeRoutingCache(aas_routingcache_t *cache)
 {
 	AAS_UnlinkCache(cache);
 	routingcachesize -= cache->size;
-	FreeMemory(cache);
+	FreePoolMemory(cache, cache->size);
 } //end of the function AAS_FreeRoutingCache
 //===========================================================================
 //
@@ -329,6 +448,12 @@ int AAS_EnableRoutingArea(int areanum, int enable)
 	{
 		//remove all routing cache involving this area
 		AAS_RemoveRoutingCacheUsingArea( areanum );
+		//the routing table is only valid with the areas it was built for
+		if (routingtable.traveltimes)
+		{
+			if (!(routingtable.disabled[areanum >> 3] & (1 << (areanum & 7))) == !enable) routingtable.changes++;
+			else routingtable.changes--;
+		} //end if
 	} //end if
 	return !flags;
 } //end of the function AAS_EnableRoutingArea
@@ -403,7 +528,7 @@ void AAS_InitAreaContentsTravelFlags(void)
 	int i;
 
 	if (aasworld.areacontentstravelflags) FreeMemory(aasworld.areacontentstravelflags);
-	aasworld.areacontentstravelflags = (int *) GetClearedMemory(aasworld.numareas * sizeof(int));
+	aasworld.areacontentstravelflags = (int *) GetClearedMapMemory(aasworld.numareas * sizeof(int));
 	//
 	for (i = 0; i < aasworld.numareas; i++) {
 		aasworld.areacontentstravelflags[i] = AAS_GetAreaContentsTravelFlags(i);
@@ -430,7 +555,7 @@ void AAS_CreateReversedReachability(void)
 	//free reversed links that have already been created
 	if (aasworld.reversedreachability) FreeMemory(aasworld.reversedreachability);
 	//allocate memory for the reversed reachability links
-	ptr = (char *) GetClearedMemory(aasworld.numareas * sizeof(aas_reversedreachability_t) +
+	ptr = (char *) GetClearedMapMemory(aasworld.numareas * sizeof(aas_reversedreachability_t) +
 							aasworld.reachabilitysize * sizeof(aas_reversedlink_t));
 	//
 	aasworld.reversedreachability = (aas_reversedreachability_t *) ptr;
@@ -526,7 +651,7 @@ void AAS_CalculateAreaTravelTimes(void)
 			PAD(revreach->numlinks, sizeof(long)) * sizeof(unsigned short);
 	} //end for
 	//allocate memory for the area travel times
-	ptr = (char *) GetClearedMemory(size);
+	ptr = (char *) GetClearedMapMemory(size);
 	aasworld.areatraveltimes = (unsigned short ***) ptr;
 	ptr += aasworld.numareas * sizeof(unsigned short **);
 	//calcluate the travel times for all the areas
@@ -605,7 +730,7 @@ void AAS_InitPortalMaxTravelTimes(void)
 
 	if (aasworld.portalmaxtraveltimes) FreeMemory(aasworld.portalmaxtraveltimes);
 
-	aasworld.portalmaxtraveltimes = (int *) GetClearedMemory(aasworld.numportals * sizeof(int));
+	aasworld.portalmaxtraveltimes = (int *) GetClearedMapMemory(aasworld.numportals * sizeof(int));
 
 	for (i = 0; i < aasworld.numportals; i++)
 	{
@@ -699,13 +824,8 @@ int AAS_FreeOldestCache(void)
 	int clusterareanum;
 	aas_routingcache_t *cache;
 
-	for (cache = aasworld.oldestcache; cache; cache = cache->time_next) {
-		// never free area cache leading towards a portal
-		if (cache->type == CACHETYPE_AREA && aasworld.areasettings[cache->areanum].cluster < 0) {
-			continue;
-		}
-		break;
-	}
+	// area cache leading towards a portal is never in the LRU list
+	cache = aasworld.oldestcache;
 	if (cache) {
 		// unlink the cache
 		if (cache->type == CACHETYPE_AREA) {
@@ -723,6 +843,7 @@ int AAS_FreeOldestCache(void)
 			if (cache->next) cache->next->prev = cache->prev;
 		}
 		AAS_FreeRoutingCache(cache);
+		routingcacheevictions++;
 		return qtrue;
 	}
 	return qfalse;
@@ -733,6 +854,20 @@ int AAS_FreeOldestCache(void)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+static void AAS_LimitRoutingCache(void)
+{
+	while ( routingcachesize > max_routingcachesize ) {
+		if ( !AAS_FreeOldestCache() ) {
+			break;
+		}
+	}
+} //end of the function AAS_LimitRoutingCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 aas_routingcache_t *AAS_AllocRoutingCache(int numtraveltimes)
 {
 	aas_routingcache_t *cache;
@@ -744,8 +879,10 @@ aas_routingcache_t *AAS_AllocRoutingCache(int numtraveltimes)
 						+ numtraveltimes * sizeof(unsigned char);
 	//
 	routingcachesize += size;
+	if (routingcachesize > routingcachepeak) routingcachepeak = routingcachesize;
 	//
-	cache = (aas_routingcache_t *) GetClearedMemory(size);
+	cache = (aas_routingcache_t *) GetPoolMemory(size);
+	Com_Memset(cache, 0, size);
 	cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t)
 								+ numtraveltimes * sizeof(unsigned short int);
 	cache->size = size;
@@ -801,7 +938,7 @@ void AAS_InitClusterAreaCache(void)
 	} //end for
 	//two dimensional array with pointers for every cluster to routing cache
 	//for every area in that cluster
-	ptr = (char *) GetClearedMemory(
+	ptr = (char *) GetClearedMapMemory(
 				aasworld.numclusters * sizeof(aas_routingcache_t **) +
 				size * sizeof(aas_routingcache_t *));
 	aasworld.clusterareacache = (aas_routingcache_t ***) ptr;
@@ -847,7 +984,7 @@ void AAS_FreeAllPortalCache(void)
 void AAS_InitPortalCache(void)
 {
 	//
-	aasworld.portalcache = (aas_routingcache_t **) GetClearedMemory(
+	aasworld.portalcache = (aas_routingcache_t **) GetClearedMapMemory(
 								aasworld.numareas * sizeof(aas_routingcache_t *));
 } //end of the function AAS_InitPortalCache
 //===========================================================================
@@ -856,6 +993,24 @@ void AAS_InitPortalCache(void)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
+static void AAS_FreeThreadRoutingUpdate(void)
+{
+	int i;
+
+	for (i = 1; i < MAX_ROUTINGTHREADS; i++)
+	{
+		if (threadareaupdate[i]) FreeMemory(threadareaupdate[i]);
+		threadareaupdate[i] = NULL;
+		if (threadportalupdate[i]) FreeMemory(threadportalupdate[i]);
+		threadportalupdate[i] = NULL;
+	} //end for
+} //end of the function AAS_FreeThreadRoutingUpdate
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
 void AAS_InitRoutingUpdate(void)
 {
 	int i, maxreachabilityareas;
@@ -872,12 +1027,15 @@ void AAS_InitRoutingUpdate(void)
 		} //end if
 	} //end for
 	//allocate memory for the routing update fields
-	aasworld.areaupdate = (aas_routingupdate_t *) GetClearedMemory(
+	aasworld.areaupdate = (aas_routingupdate_t *) GetClearedMapMemory(
 									maxreachabilityareas * sizeof(aas_routingupdate_t));
+	numareaupdates = maxreachabilityareas;
+	//the worker thread update fields depend on the sizes
+	AAS_FreeThreadRoutingUpdate();
 	//
 	if (aasworld.portalupdate) FreeMemory(aasworld.portalupdate);
 	//allocate memory for the portal update fields
-	aasworld.portalupdate = (aas_routingupdate_t *) GetClearedMemory(
+	aasworld.portalupdate = (aas_routingupdate_t *) GetClearedMapMemory(
 									(aasworld.numportals+1) * sizeof(aas_routingupdate_t));
 } //end of the function AAS_InitRoutingUpdate
 //===========================================================================
@@ -913,6 +1071,36 @@ void AAS_CreateAllRoutingCache(void)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+static void AAS_FreeRoutingTable(void)
+{
+	if (routingtable.disabled) FreeMemory(routingtable.disabled);
+	if (routingtable.traveltimes) FreeMemory(routingtable.traveltimes);
+	if (routingtable.reachabilities) FreeMemory(routingtable.reachabilities);
+	Com_Memset(&routingtable, 0, sizeof(routingtable_t));
+} //end of the function AAS_FreeRoutingTable
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_AllocRoutingTable(int travelflags)
+{
+	int n;
+
+	AAS_FreeRoutingTable();
+	n = aasworld.numareas * aasworld.numareas;
+	routingtable.travelflags = travelflags;
+	routingtable.disabled = (byte *) GetClearedMapMemory((aasworld.numareas + 7) >> 3);
+	routingtable.traveltimes = (unsigned short int *) GetClearedMapMemory(n * sizeof(unsigned short int));
+	routingtable.reachabilities = (unsigned char *) GetClearedMapMemory(n * sizeof(unsigned char));
+} //end of the function AAS_AllocRoutingTable
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 
 //the route cache header
 //this header is followed by numportalcache + numareacache aas_routingcache_t
@@ -937,12 +1125,13 @@ typedef struct routecacheheader_s
 
 void AAS_WriteRouteCache(void)
 {
-	int i, j, numportalcache, numareacache, totalsize;
+	int i, j, n, numportalcache, numareacache, totalsize;
 	aas_routingcache_t *cache;
 	aas_cluster_t *cluster;
 	fileHandle_t fp;
 	char filename[MAX_QPATH];
 	routecacheheader_t routecacheheader;
+	routingtableheader_t routingtableheader;
 
 	numportalcache = 0;
 	for (i = 0; i < aasworld.numareas; i++)
@@ -1006,6 +1195,19 @@ void AAS_WriteRouteCache(void)
 			} //end for
 		} //end for
 	} //end for
+	// write the routing table
+	if (routingtable.traveltimes && !routingtable.changes)
+	{
+		routingtableheader.ident = RTID;
+		routingtableheader.numareas = aasworld.numareas;
+		routingtableheader.travelflags = routingtable.travelflags;
+		botimport.FS_Write(&routingtableheader, sizeof(routingtableheader_t), fp);
+		n = aasworld.numareas * aasworld.numareas;
+		botimport.FS_Write(routingtable.disabled, (aasworld.numareas + 7) >> 3, fp);
+		botimport.FS_Write(routingtable.traveltimes, n * sizeof(unsigned short int), fp);
+		botimport.FS_Write(routingtable.reachabilities, n * sizeof(unsigned char), fp);
+		totalsize += sizeof(routingtableheader_t) + ((aasworld.numareas + 7) >> 3) + n * 3;
+	} //end if
 	// write the visareas
 	/*
 	for (i = 0; i < aasworld.numareas; i++)
@@ -1038,7 +1240,8 @@ aas_routingcache_t *AAS_ReadCache(fileHandle_t fp)
 	aas_routingcache_t *cache;
 
 	botimport.FS_Read(&size, sizeof(size), fp);
-	cache = (aas_routingcache_t *) GetMemory(size);
+	cache = (aas_routingcache_t *) GetPoolMemory(size);
+	routingcachesize += size;
 	cache->size = size;
 	botimport.FS_Read((unsigned char *)cache + sizeof(size), size - sizeof(size), fp);
 	cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t) - sizeof(unsigned short) +
@@ -1053,10 +1256,11 @@ aas_routingcache_t *AAS_ReadCache(fileHandle_t fp)
 //===========================================================================
 int AAS_ReadRouteCache(void)
 {
-	int i, clusterareanum;//, size;
+	int i, n, clusterareanum;//, size;
 	fileHandle_t fp;
 	char filename[MAX_QPATH];
 	routecacheheader_t routecacheheader;
+	routingtableheader_t routingtableheader;
 	aas_routingcache_t *cache;
 
 	Com_sprintf(filename, MAX_QPATH, "maps/%s.rcd", aasworld.mapname);
@@ -1102,6 +1306,8 @@ int AAS_ReadRouteCache(void)
 	for (i = 0; i < routecacheheader.numportalcache; i++)
 	{
 		cache = AAS_ReadCache(fp);
+		cache->time = AAS_RoutingTime();
+		AAS_LinkCache(cache);
 		cache->next = aasworld.portalcache[cache->areanum];
 		cache->prev = NULL;
 		if (aasworld.portalcache[cache->areanum])
@@ -1112,6 +1318,8 @@ int AAS_ReadRouteCache(void)
 	for (i = 0; i < routecacheheader.numareacache; i++)
 	{
 		cache = AAS_ReadCache(fp);
+		cache->time = AAS_RoutingTime();
+		AAS_LinkCache(cache);
 		clusterareanum = AAS_ClusterAreaNum(cache->cluster, cache->areanum);
 		cache->next = aasworld.clusterareacache[cache->cluster][clusterareanum];
 		cache->prev = NULL;
@@ -1119,6 +1327,16 @@ int AAS_ReadRouteCache(void)
 			aasworld.clusterareacache[cache->cluster][clusterareanum]->prev = cache;
 		aasworld.clusterareacache[cache->cluster][clusterareanum] = cache;
 	} //end for
+	// read the routing table if there is one
+	if (botimport.FS_Read(&routingtableheader, sizeof(routingtableheader_t), fp) == sizeof(routingtableheader_t)
+		&& routingtableheader.ident == RTID && routingtableheader.numareas == aasworld.numareas)
+	{
+		AAS_AllocRoutingTable(routingtableheader.travelflags);
+		n = aasworld.numareas * aasworld.numareas;
+		botimport.FS_Read(routingtable.disabled, (aasworld.numareas + 7) >> 3, fp);
+		botimport.FS_Read(routingtable.traveltimes, n * sizeof(unsigned short int), fp);
+		botimport.FS_Read(routingtable.reachabilities, n * sizeof(unsigned char), fp);
+	} //end if
 	// read the visareas
 	/*
 	aasworld.areavisibility = (byte **) GetClearedMemory(aasworld.numareas * sizeof(byte *));
@@ -1157,9 +1375,9 @@ void AAS_InitReachabilityAreas(void)
 		FreeMemory(aasworld.reachabilityareaindex);
 
 	aasworld.reachabilityareas = (aas_reachabilityareas_t *)
-				GetClearedMemory(aasworld.reachabilitysize * sizeof(aas_reachabilityareas_t));
+				GetClearedMapMemory(aasworld.reachabilitysize * sizeof(aas_reachabilityareas_t));
 	aasworld.reachabilityareaindex = (int *)
-				GetClearedMemory(aasworld.reachabilitysize * MAX_REACHABILITYPASSAREAS * sizeof(int));
+				GetClearedMapMemory(aasworld.reachabilitysize * MAX_REACHABILITYPASSAREAS * sizeof(int));
 	numreachareas = 0;
 	for (i = 0; i < aasworld.reachabilitysize; i++)
 	{
@@ -1211,6 +1429,90 @@ void AAS_InitReachabilityAreas(void)
 	} //end for
 } //end of the function AAS_InitReachabilityAreas
 //===========================================================================
+// a route is travel through areas and reachabilities taking turns. the
+// time through an area is at least max(1, (int) (0.33 * dist)), which is
+// more than BOUND_AREATIMEPERUNIT * (dist + BOUND_SHORTREACH), so it also
+// pays for the reachability after it up to that length. beyond it every
+// travel type gets the least time per unit its reachabilities take, a
+// route is never faster than the worst of the types it may use
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_InitTravelTimeBounds(void)
+{
+	int i, traveltype;
+	float dist, perunit;
+	aas_reachability_t *reach;
+
+	for (i = 0; i < MAX_TRAVELTYPES; i++)
+	{
+		aasworld.traveltimeperunit[i] = BOUND_AREATIMEPERUNIT;
+	} //end for
+	for (i = 1; i < aasworld.reachabilitysize; i++)
+	{
+		reach = &aasworld.reachability[i];
+		traveltype = reach->traveltype & TRAVELTYPE_MASK;
+		if (traveltype >= MAX_TRAVELTYPES) continue;
+		dist = Distance(reach->start, reach->end) - BOUND_SHORTREACH;
+		if (dist <= 0) continue;
+		perunit = reach->traveltime / dist;
+		if (perunit < aasworld.traveltimeperunit[traveltype])
+		{
+			aasworld.traveltimeperunit[traveltype] = perunit;
+		} //end if
+	} //end for
+	aasworld.boundtravelflags = 0;
+	aasworld.boundtraveltimeperunit = 0;
+} //end of the function AAS_InitTravelTimeBounds
+//===========================================================================
+// from the distance between the area bounds, whatever the origin in the
+// area and the reachability the route goes in with
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int AAS_AreaTravelTimeLowerBound(int areanum, int goalareanum, int travelflags)
+{
+	int i;
+	float gap, dist;
+	aas_area_t *area, *goalarea;
+
+	if (!aasworld.initialized) return 0;
+	if (areanum <= 0 || areanum >= aasworld.numareas) return 0;
+	if (goalareanum <= 0 || goalareanum >= aasworld.numareas) return 0;
+	//the slowest of the travel types that may be used
+	if (travelflags != aasworld.boundtravelflags)
+	{
+		aasworld.boundtravelflags = travelflags;
+		aasworld.boundtraveltimeperunit = BOUND_AREATIMEPERUNIT;
+		for (i = 0; i < MAX_TRAVELTYPES; i++)
+		{
+			if (aasworld.travelflagfortype[i] & ~travelflags) continue;
+			if (aasworld.traveltimeperunit[i] < aasworld.boundtraveltimeperunit)
+			{
+				aasworld.boundtraveltimeperunit = aasworld.traveltimeperunit[i];
+			} //end if
+		} //end for
+	} //end if
+	//
+	area = &aasworld.areas[areanum];
+	goalarea = &aasworld.areas[goalareanum];
+	dist = 0;
+	for (i = 0; i < 3; i++)
+	{
+		gap = goalarea->mins[i] - area->maxs[i];
+		if (area->mins[i] - goalarea->maxs[i] > gap) gap = area->mins[i] - goalarea->maxs[i];
+		if (gap > 0) dist += gap * gap;
+	} //end for
+	//the reachabilities may start or end a bit outside the areas
+	dist = sqrt(dist) - 2 * BOUND_AREAEPSILON;
+	if (dist <= 0) return 0;
+	return (int) (dist * aasworld.boundtraveltimeperunit);
+} //end of the function AAS_AreaTravelTimeLowerBound
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -1233,6 +1535,8 @@ void AAS_InitRouting(void)
 	AAS_CalculateAreaTravelTimes();
 	//calculate the maximum travel times through portals
 	AAS_InitPortalMaxTravelTimes();
+	//the least travel time per unit of distance for each travel type
+	AAS_InitTravelTimeBounds();
 	//get the areas reachabilities go through
 	AAS_InitReachabilityAreas();
 	//
@@ -1242,9 +1546,16 @@ void AAS_InitRouting(void)
 #endif //ROUTING_DEBUG
 	//
 	routingcachesize = 0;
-	max_routingcachesize = 1024 * (int) LibVarValue("max_routingcache", "4096");
+	max_routingcachesize = 1024 * (int) LibVarValue("max_routingcache", "12288");
+	AAS_ResetRoutingInfo();
 	// read any routing cache if available
 	AAS_ReadRouteCache();
+	// build the routing table on small enough maps if it wasn't read
+	if (!routingtable.traveltimes && LibVarValue("routingtable", "0")
+		&& aasworld.numareas <= (int) LibVarValue("routingtable_maxareas", "1024"))
+	{
+		AAS_CreateRoutingTable(TFL_DEFAULT);
+	} //end if
 } //end of the function AAS_InitRouting
 //===========================================================================
 //
@@ -1272,6 +1583,11 @@ void AAS_FreeRoutingCaches(void)
 	aasworld.areaupdate = NULL;
 	if (aasworld.portalupdate) FreeMemory(aasworld.portalupdate);
 	aasworld.portalupdate = NULL;
+	AAS_FreeThreadRoutingUpdate();
+	if (routingmutex) botimport.DestroyMutex(routingmutex);
+	routingmutex = NULL;
+	// free the routing table
+	AAS_FreeRoutingTable();
 	// free lists with areas the reachabilities go through
 	if (aasworld.reachabilityareas) FreeMemory(aasworld.reachabilityareas);
 	aasworld.reachabilityareas = NULL;
@@ -1294,18 +1610,16 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 	int i, nextareanum, cluster, badtravelflags, clusterareanum, linknum;
 	int numreachabilityareas;
 	unsigned short int t, startareatraveltimes[128]; //NOTE: not more than 128 reachabilities per area allowed
-	aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
+	aas_routingupdate_t *areaupdate, *updateliststart, *updatelistend, *curupdate, *nextupdate;
 	aas_reachability_t *reach;
 	aas_reversedreachability_t *revreach;
 	aas_reversedlink_t *revlink;
 
-#ifdef ROUTING_DEBUG
-	numareacacheupdates++;
-#endif //ROUTING_DEBUG
 	//number of reachability areas within this cluster
 	numreachabilityareas = aasworld.clusters[areacache->cluster].numreachabilityareas;
-	//
-	aasworld.frameroutingupdates++;
+	//the update fields of this thread
+	if (routingparallel) areaupdate = threadareaupdate[botimport.WorkerIndex()];
+	else areaupdate = aasworld.areaupdate;
 	//clear the routing update fields
 //	Com_Memset(aasworld.areaupdate, 0, aasworld.numareas * sizeof(aas_routingupdate_t));
 	//
@@ -1316,7 +1630,7 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 	//
 	Com_Memset(startareatraveltimes, 0, sizeof(startareatraveltimes));
 	//
-	curupdate = &aasworld.areaupdate[clusterareanum];
+	curupdate = &areaupdate[clusterareanum];
 	curupdate->areanum = areacache->areanum;
 	//VectorCopy(areacache->origin, curupdate->start);
 	curupdate->areatraveltimes = startareatraveltimes;
@@ -1372,7 +1686,7 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 			{
 				areacache->traveltimes[clusterareanum] = t;
 				areacache->reachabilities[clusterareanum] = linknum - aasworld.areasettings[nextareanum].firstreachablearea;
-				nextupdate = &aasworld.areaupdate[clusterareanum];
+				nextupdate = &areaupdate[clusterareanum];
 				nextupdate->areanum = nextareanum;
 				nextupdate->tmptraveltime = t;
 				//VectorCopy(reach->start, nextupdate->start);
@@ -1403,14 +1717,14 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int travelflags)
 {
 	int clusterareanum;
-	aas_routingcache_t *cache, *clustercache;
+	aas_routingcache_t *cache, *clustercache, *newcache;
 
 	//number of the area in the cluster
 	clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
-	//pointer to the cache for the area in the cluster
-	clustercache = aasworld.clusterareacache[clusternum][clusterareanum];
+	//
+	AAS_LockRouting();
 	//find the cache without undesired travel flags
-	for (cache = clustercache; cache; cache = cache->next)
+	for (cache = aasworld.clusterareacache[clusternum][clusterareanum]; cache; cache = cache->next)
 	{
 		//if there aren't used any undesired travel types for the cache
 		if (cache->travelflags == travelflags) break;
@@ -1418,26 +1732,56 @@ aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int tra
 	//if there was no cache
 	if (!cache)
 	{
-		cache = AAS_AllocRoutingCache(aasworld.clusters[clusternum].numreachabilityareas);
-		cache->cluster = clusternum;
-		cache->areanum = areanum;
-		VectorCopy(aasworld.areas[areanum].center, cache->origin);
-		cache->starttraveltime = 1;
-		cache->travelflags = travelflags;
-		cache->prev = NULL;
-		cache->next = clustercache;
-		if (clustercache) clustercache->prev = cache;
-		aasworld.clusterareacache[clusternum][clusterareanum] = cache;
-		AAS_UpdateAreaRoutingCache(cache);
+		areacachemisses++;
+		newcache = AAS_AllocRoutingCache(aasworld.clusters[clusternum].numreachabilityareas);
+		newcache->cluster = clusternum;
+		newcache->areanum = areanum;
+		VectorCopy(aasworld.areas[areanum].center, newcache->origin);
+		newcache->starttraveltime = 1;
+		newcache->travelflags = travelflags;
+		aasworld.frameroutingupdates++;
+#ifdef ROUTING_DEBUG
+		numareacacheupdates++;
+#endif //ROUTING_DEBUG
+		//build the cache before it is visible to other threads
+		AAS_UnlockRouting();
+		AAS_UpdateAreaRoutingCache(newcache);
+		AAS_LockRouting();
+		//another thread might have built the same cache meanwhile
+		if (routingparallel)
+		{
+			for (cache = aasworld.clusterareacache[clusternum][clusterareanum]; cache; cache = cache->next)
+			{
+				if (cache->travelflags == travelflags) break;
+			} //end for
+		} //end if
+		if (cache)
+		{
+			routingcachesize -= newcache->size;
+			FreePoolMemory(newcache, newcache->size);
+			AAS_UnlinkCache(cache);
+		} //end if
+		else
+		{
+			cache = newcache;
+			//pointer to the cache for the area in the cluster
+			clustercache = aasworld.clusterareacache[clusternum][clusterareanum];
+			cache->prev = NULL;
+			cache->next = clustercache;
+			if (clustercache) clustercache->prev = cache;
+			aasworld.clusterareacache[clusternum][clusterareanum] = cache;
+		} //end else
 	} //end if
 	else
 	{
+		areacachehits++;
 		AAS_UnlinkCache(cache);
 	} //end else
 	//the cache has been accessed
 	cache->time = AAS_RoutingTime();
 	cache->type = CACHETYPE_AREA;
 	AAS_LinkCache(cache);
+	AAS_UnlockRouting();
 	return cache;
 } //end of the function AAS_GetAreaRoutingCache
 //===========================================================================
@@ -1453,15 +1797,15 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 	aas_portal_t *portal;
 	aas_cluster_t *cluster;
 	aas_routingcache_t *cache;
-	aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
+	aas_routingupdate_t *portalupdate, *updateliststart, *updatelistend, *curupdate, *nextupdate;
 
-#ifdef ROUTING_DEBUG
-	numportalcacheupdates++;
-#endif //ROUTING_DEBUG
+	//the update fields of this thread
+	if (routingparallel) portalupdate = threadportalupdate[botimport.WorkerIndex()];
+	else portalupdate = aasworld.portalupdate;
 	//clear the routing update fields
 //	Com_Memset(aasworld.portalupdate, 0, (aasworld.numportals+1) * sizeof(aas_routingupdate_t));
 	//
-	curupdate = &aasworld.portalupdate[aasworld.numportals];
+	curupdate = &portalupdate[aasworld.numportals];
 	curupdate->cluster = portalcache->cluster;
 	curupdate->areanum = portalcache->areanum;
 	curupdate->tmptraveltime = portalcache->starttraveltime;
@@ -1510,7 +1854,7 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 					portalcache->traveltimes[portalnum] > t)
 			{
 				portalcache->traveltimes[portalnum] = t;
-				nextupdate = &aasworld.portalupdate[portalnum];
+				nextupdate = &portalupdate[portalnum];
 				if (portal->frontcluster == curupdate->cluster)
 				{
 					nextupdate->cluster = portal->backcluster;
@@ -1546,8 +1890,9 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 //===========================================================================
 aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int travelflags)
 {
-	aas_routingcache_t *cache;
+	aas_routingcache_t *cache, *newcache;
 
+	AAS_LockRouting();
 	//find the cached portal routing if existing
 	for (cache = aasworld.portalcache[areanum]; cache; cache = cache->next)
 	{
@@ -1556,31 +1901,80 @@ aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int t
 	//if the portal routing isn't cached
 	if (!cache)
 	{
-		cache = AAS_AllocRoutingCache(aasworld.numportals);
-		cache->cluster = clusternum;
-		cache->areanum = areanum;
-		VectorCopy(aasworld.areas[areanum].center, cache->origin);
-		cache->starttraveltime = 1;
-		cache->travelflags = travelflags;
-		//add the cache to the cache list
-		cache->prev = NULL;
-		cache->next = aasworld.portalcache[areanum];
-		if (aasworld.portalcache[areanum]) aasworld.portalcache[areanum]->prev = cache;
-		aasworld.portalcache[areanum] = cache;
-		//update the cache
-		AAS_UpdatePortalRoutingCache(cache);
+		portalcachemisses++;
+		newcache = AAS_AllocRoutingCache(aasworld.numportals);
+		newcache->cluster = clusternum;
+		newcache->areanum = areanum;
+		VectorCopy(aasworld.areas[areanum].center, newcache->origin);
+		newcache->starttraveltime = 1;
+		newcache->travelflags = travelflags;
+#ifdef ROUTING_DEBUG
+		numportalcacheupdates++;
+#endif //ROUTING_DEBUG
+		//update the cache before it is visible to other threads
+		AAS_UnlockRouting();
+		AAS_UpdatePortalRoutingCache(newcache);
+		AAS_LockRouting();
+		//another thread might have built the same cache meanwhile
+		if (routingparallel)
+		{
+			for (cache = aasworld.portalcache[areanum]; cache; cache = cache->next)
+			{
+				if (cache->travelflags == travelflags) break;
+			} //end for
+		} //end if
+		if (cache)
+		{
+			routingcachesize -= newcache->size;
+			FreePoolMemory(newcache, newcache->size);
+			AAS_UnlinkCache(cache);
+		} //end if
+		else
+		{
+			cache = newcache;
+			//add the cache to the cache list
+			cache->prev = NULL;
+			cache->next = aasworld.portalcache[areanum];
+			if (aasworld.portalcache[areanum]) aasworld.portalcache[areanum]->prev = cache;
+			aasworld.portalcache[areanum] = cache;
+		} //end else
 	} //end if
 	else
 	{
+		portalcachehits++;
 		AAS_UnlinkCache(cache);
 	} //end else
 	//the cache has been accessed
 	cache->time = AAS_RoutingTime();
 	cache->type = CACHETYPE_PORTAL;
 	AAS_LinkCache(cache);
+	AAS_UnlockRouting();
 	return cache;
 } //end of the function AAS_GetPortalRoutingCache
 //===========================================================================
+// looks up a route in the routing table, the cluster portal leading
+// towards the goal is chosen without taking the origin into account
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE int AAS_RoutingTableRoute(int areanum, vec3_t origin, int goalareanum, int *traveltime, int *reachnum)
+{
+	int index;
+
+	index = goalareanum * aasworld.numareas + areanum;
+	if (!routingtable.traveltimes[index]) return qfalse;
+	*reachnum = aasworld.areasettings[areanum].firstreachablearea + routingtable.reachabilities[index];
+	*traveltime = routingtable.traveltimes[index];
+	//the travel time from a portal doesn't include the origin
+	if (origin && aasworld.areasettings[areanum].cluster > 0)
+	{
+		*traveltime += AAS_AreaTravelTime(areanum, origin, aasworld.reachability[*reachnum].start);
+	} //end if
+	return qtrue;
+} //end of the function AAS_RoutingTableRoute
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -1624,12 +2018,16 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 	{
 		return qfalse;
 	} //end if
+	//use the routing table if it is valid for the query
+	if (routingtable.traveltimes && routingtable.travelflags == travelflags && !routingtable.changes)
+	{
+		return AAS_RoutingTableRoute(areanum, origin, goalareanum, traveltime, reachnum);
+	} //end if
 
-	// make sure the routing cache doesn't grow to large
-	while ( routingcachesize > 12 * 1024 * 1024 ) {
-		if ( !AAS_FreeOldestCache() ) {
-			break;
-		}
+	// make sure the routing cache doesn't grow to large, parallel
+	// routing does this once before the jobs start
+	if ( !routingparallel ) {
+		AAS_LimitRoutingCache();
 	}
 
 	//
@@ -1749,10 +2147,10 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		//		into the portal area
 		t += aasworld.portalmaxtraveltimes[portalnum];
 		//
+		*reachnum = aasworld.areasettings[areanum].firstreachablearea +
+						areacache->reachabilities[clusterareanum];
 		if (origin)
 		{
-			*reachnum = aasworld.areasettings[areanum].firstreachablearea +
-							areacache->reachabilities[clusterareanum];
 			reach = aasworld.reachability + *reachnum;
 			t += AAS_AreaTravelTime(areanum, origin, reach->start);
 		} //end if
@@ -1792,6 +2190,140 @@ int AAS_AreaTravelTimeToGoalArea(int areanum, vec3_t origin, int goalareanum, in
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+int AAS_ValidRoutingArea(int areanum)
+{
+	if (!aasworld.initialized) return qfalse;
+	if (areanum <= 0 || areanum >= aasworld.numareas) return qfalse;
+	return aasworld.areasettings[areanum].numreachableareas > 0;
+} //end of the function AAS_ValidRoutingArea
+//===========================================================================
+// runs func( data, i ) for every i in [0, count) on worker threads, the
+// jobs may only query routes between valid routing areas and must not
+// change the routing state otherwise
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_ParallelRouting(void (*func)(void *data, int index), void *data, int count)
+{
+	int i, numthreads;
+
+	if (!aasworld.initialized || count <= 0) return;
+	//caches are not freed while the jobs run
+	AAS_LimitRoutingCache();
+	//
+	numthreads = botimport.NumWorkers() + 1;
+	if (numthreads > MAX_ROUTINGTHREADS) numthreads = MAX_ROUTINGTHREADS;
+	if (numthreads <= 1 || count <= 1)
+	{
+		for (i = 0; i < count; i++)
+		{
+			func(data, i);
+		} //end for
+		return;
+	} //end if
+	//
+	if (!routingmutex) routingmutex = botimport.CreateMutex();
+	threadareaupdate[0] = aasworld.areaupdate;
+	threadportalupdate[0] = aasworld.portalupdate;
+	for (i = 1; i < numthreads; i++)
+	{
+		if (!threadareaupdate[i])
+		{
+			threadareaupdate[i] = (aas_routingupdate_t *) GetClearedMapMemory(
+									numareaupdates * sizeof(aas_routingupdate_t));
+		} //end if
+		if (!threadportalupdate[i])
+		{
+			threadportalupdate[i] = (aas_routingupdate_t *) GetClearedMapMemory(
+									(aasworld.numportals+1) * sizeof(aas_routingupdate_t));
+		} //end if
+	} //end for
+	//
+	routingparallel = qtrue;
+	botimport.RunParallel(func, data, count);
+	routingparallel = qfalse;
+} //end of the function AAS_ParallelRouting
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+#define ROUTINGTABLE_BATCH		256
+
+typedef struct routingtablebuild_s
+{
+	routingtable_t table;
+	int firstgoal;
+} routingtablebuild_t;
+
+static void AAS_RoutingTableJob(void *data, int index)
+{
+	routingtablebuild_t *build;
+	int goalareanum, areanum, i, traveltime, reachnum;
+
+	build = (routingtablebuild_t *) data;
+	goalareanum = build->firstgoal + index;
+	if (!AAS_ValidRoutingArea(goalareanum)) return;
+	i = goalareanum * aasworld.numareas;
+	for (areanum = 1; areanum < aasworld.numareas; areanum++)
+	{
+		if (areanum == goalareanum) continue;
+		if (!AAS_ValidRoutingArea(areanum)) continue;
+		if (!AAS_AreaRouteToGoalArea(areanum, NULL, goalareanum, build->table.travelflags, &traveltime, &reachnum)) continue;
+		if (traveltime <= 0) continue;
+		build->table.traveltimes[i + areanum] = traveltime;
+		build->table.reachabilities[i + areanum] = reachnum - aasworld.areasettings[areanum].firstreachablearea;
+	} //end for
+} //end of the function AAS_RoutingTableJob
+//===========================================================================
+// builds the travel times from all areas to all goal areas
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_CreateRoutingTable(int travelflags)
+{
+	routingtablebuild_t build;
+	int i, initialized, count;
+
+	AAS_FreeRoutingTable();
+	AAS_AllocRoutingTable(travelflags);
+	//the routing queries can't use the table while it is being built
+	build.table = routingtable;
+	Com_Memset(&routingtable, 0, sizeof(routingtable_t));
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		if (aasworld.areasettings[i].areaflags & AREA_DISABLED)
+		{
+			build.table.disabled[i >> 3] |= 1 << (i & 7);
+		} //end if
+	} //end for
+	//
+	initialized = aasworld.initialized;
+	aasworld.initialized = qtrue;
+	//in batches so the routing cache can be limited in between
+	for (build.firstgoal = 1; build.firstgoal < aasworld.numareas; build.firstgoal += count)
+	{
+		count = aasworld.numareas - build.firstgoal;
+		if (count > ROUTINGTABLE_BATCH) count = ROUTINGTABLE_BATCH;
+		AAS_ParallelRouting(AAS_RoutingTableJob, &build, count);
+	} //end for
+	aasworld.initialized = initialized;
+	//
+	routingtable = build.table;
+	botimport.Print(PRT_MESSAGE, "routing table for %d areas: %d KB\n", aasworld.numareas,
+						(aasworld.numareas * aasworld.numareas * 3) >> 10);
+} //end of the function AAS_CreateRoutingTable
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 int AAS_AreaReachabilityToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags)
 {
 	int traveltime, reachnum = 0;
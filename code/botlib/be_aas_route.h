@@ -38,11 +38,16 @@ void AAS_FreeRoutingCaches(void);
 unsigned short int AAS_AreaTravelTime(int areanum, vec3_t start, vec3_t end);
 //
 void AAS_CreateAllRoutingCache(void);
+//build the travel times between all areas for the given travel flags
+void AAS_CreateRoutingTable(int travelflags);
 void AAS_WriteRouteCache(void);
-//
-void AAS_RoutingInfo(void);
 #endif //AASINTERN
 
+//print the routing cache statistics
+void AAS_RoutingInfo(void);
+//reset the routing cache statistics
+void AAS_ResetRoutingInfo(void);
+
 //returns the travel flag for the given travel type
 int AAS_TravelFlagForType(int traveltype);
 //return the travel flag(s) for traveling through this area
@@ -59,6 +64,12 @@ int AAS_EnableRoutingArea(int areanum, int enable);
 unsigned short int AAS_AreaTravelTime(int areanum, vec3_t start, vec3_t end);
 //returns the travel time from the area to the goal area using the given travel flags
 int AAS_AreaTravelTimeToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags);
+//returns a travel time AAS_AreaTravelTimeToGoalArea never goes below
+int AAS_AreaTravelTimeLowerBound(int areanum, int goalareanum, int travelflags);
+//returns true if routes can be found from and to the area
+int AAS_ValidRoutingArea(int areanum);
+//runs routing jobs on worker threads against the shared routing cache
+void AAS_ParallelRouting(void (*func)(void *data, int index), void *data, int count);
 //predict a route up to a stop event
 int AAS_PredictRoute(struct aas_predictroute_s *route, int areanum, vec3_t origin,
 							int goalareanum, int travelflags, int maxareas, int maxtime,
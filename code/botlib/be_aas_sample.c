@@ -63,6 +63,18 @@ typedef struct aas_tracestack_s
 
 int numaaslinks;
 
+//the areas of the points looked up last, see AAS_PointAreaNum
+#define AAS_POINTAREACACHE_SIZE			256		//power of two
+
+typedef struct aas_pointarea_s
+{
+	vec3_t point;
+	int areanum;
+	int valid;
+} aas_pointarea_t;
+
+aas_pointarea_t pointareacache[AAS_POINTAREACACHE_SIZE];
+
 //===========================================================================
 //
 // Parameter:				-
@@ -87,6 +99,51 @@ void AAS_PresenceTypeBoundingBox(int presencetype, vec3_t mins, vec3_t maxs)
 	VectorCopy(boxmaxs[index], maxs);
 } //end of the function AAS_PresenceTypeBoundingBox
 //===========================================================================
+// puts the plane of every node in with the node, the tree is walked for
+// every point and trace and this saves a lookup in the plane array for
+// every node passed
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_InitTraceNodes(void)
+{
+	int i;
+	aas_node_t *node;
+	aas_plane_t *plane;
+	aas_tracenode_t *tracenode;
+
+	AAS_FreeTraceNodes();
+	aasworld.tracenodes = (aas_tracenode_t *) GetClearedHunkMemory(
+								(aasworld.numnodes + 1) * sizeof(aas_tracenode_t));
+	for (i = 0; i < aasworld.numnodes; i++)
+	{
+		node = &aasworld.nodes[i];
+		tracenode = &aasworld.tracenodes[i];
+		tracenode->planenum = node->planenum;
+		tracenode->children[0] = node->children[0];
+		tracenode->children[1] = node->children[1];
+		if (node->planenum < 0 || node->planenum >= aasworld.numplanes) continue;
+		plane = &aasworld.planes[node->planenum];
+		VectorCopy(plane->normal, tracenode->normal);
+		tracenode->dist = plane->dist;
+	} //end for
+	//the areas of the last map are no good anymore
+	Com_Memset(pointareacache, 0, sizeof(pointareacache));
+} //end of the function AAS_InitTraceNodes
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_FreeTraceNodes(void)
+{
+	if (aasworld.tracenodes) FreeMemory(aasworld.tracenodes);
+	aasworld.tracenodes = NULL;
+} //end of the function AAS_FreeTraceNodes
+//===========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -212,9 +269,10 @@ void AAS_FreeAASLinkedEntities(void)
 int AAS_PointAreaNum(vec3_t point)
 {
 	int nodenum;
+	unsigned int hash;
 	vec_t	dist;
-	aas_node_t *node;
-	aas_plane_t *plane;
+	aas_tracenode_t *node;
+	aas_pointarea_t *entry;
 
 	if (!aasworld.loaded)
 	{
@@ -222,6 +280,20 @@ int AAS_PointAreaNum(vec3_t point)
 		return 0;
 	} //end if
 
+	//the same origins are looked up over and over during a frame, the tree
+	//doesn't change so an area once found stays valid for the map
+	//the cache isn't locked so it's only used on the main thread
+	entry = NULL;
+	if (!botimport.WorkerIndex())
+	{
+		hash = 2166136261u;
+		hash = (hash ^ *(unsigned int *) &point[0]) * 16777619u;
+		hash = (hash ^ *(unsigned int *) &point[1]) * 16777619u;
+		hash = (hash ^ *(unsigned int *) &point[2]) * 16777619u;
+		entry = &pointareacache[(hash ^ (hash >> 16)) & (AAS_POINTAREACACHE_SIZE - 1)];
+		if (entry->valid && VectorCompare(entry->point, point)) return entry->areanum;
+	} //end if
+
 	//start with node 1 because node zero is a dummy used for solid leafs
 	nodenum = 1;
 	while (nodenum > 0)
@@ -234,7 +306,7 @@ int AAS_PointAreaNum(vec3_t point)
 			return 0;
 		} //end if
 #endif //AAS_SAMPLE_DEBUG
-		node = &aasworld.nodes[nodenum];
+		node = &aasworld.tracenodes[nodenum];
 #ifdef AAS_SAMPLE_DEBUG
 		if (node->planenum < 0 || node->planenum >= aasworld.numplanes)
 		{
@@ -242,17 +314,17 @@ int AAS_PointAreaNum(vec3_t point)
 			return 0;
 		} //end if
 #endif //AAS_SAMPLE_DEBUG
-		plane = &aasworld.planes[node->planenum];
-		dist = DotProduct(point, plane->normal) - plane->dist;
-		if (dist > 0) nodenum = node->children[0];
-		else nodenum = node->children[1];
+		dist = DotProduct(point, node->normal) - node->dist;
+		nodenum = node->children[dist <= 0];
 	} //end while
-	if (!nodenum)
-	{
 #ifdef AAS_SAMPLE_DEBUG
-		botimport.Print(PRT_MESSAGE, "in solid\n");
+	if (!nodenum) botimport.Print(PRT_MESSAGE, "in solid\n");
 #endif //AAS_SAMPLE_DEBUG
-		return 0;
+	if (entry)
+	{
+		VectorCopy(point, entry->point);
+		entry->areanum = -nodenum;
+		entry->valid = qtrue;
 	} //end if
 	return -nodenum;
 } //end of the function AAS_PointAreaNum
@@ -453,7 +525,7 @@ aas_trace_t AAS_TraceClientBBox(vec3_t start, vec3_t end, int presencetype,
 	vec3_t cur_start, cur_end, cur_mid, v1, v2;
 	aas_tracestack_t tracestack[127];
 	aas_tracestack_t *tstack_p;
-	aas_node_t *aasnode;
+	aas_tracenode_t *aasnode;
 	aas_plane_t *plane;
 	aas_trace_t trace;
 
@@ -596,43 +668,16 @@ aas_trace_t AAS_TraceClientBBox(vec3_t start, vec3_t end, int presencetype,
 			return trace;
 		} //end if
 #endif //AAS_SAMPLE_DEBUG
-		//the node to test against
-		aasnode = &aasworld.nodes[nodenum];
+		//the node to test against, with its plane
+		aasnode = &aasworld.tracenodes[nodenum];
 		//start point of current line to test against node
 		VectorCopy(tstack_p->start, cur_start);
 		//end point of the current line to test against node
 		VectorCopy(tstack_p->end, cur_end);
-		//the current node plane
-		plane = &aasworld.planes[aasnode->planenum];
-
-		switch(plane->type)
-		{/*FIXME: wtf doesn't this work? obviously the axial node planes aren't always facing positive!!!
-			//check for axial planes
-			case PLANE_X:
-			{
-				front = cur_start[0] - plane->dist;
-				back = cur_end[0] - plane->dist;
-				break;
-			} //end case
-			case PLANE_Y:
-			{
-				front = cur_start[1] - plane->dist;
-				back = cur_end[1] - plane->dist;
-				break;
-			} //end case
-			case PLANE_Z:
-			{
-				front = cur_start[2] - plane->dist;
-				back = cur_end[2] - plane->dist;
-				break;
-			} //end case*/
-			default: //gee it's not an axial plane
-			{
-				front = DotProduct(cur_start, plane->normal) - plane->dist;
-				back = DotProduct(cur_end, plane->normal) - plane->dist;
-				break;
-			} //end default
-		} //end switch
+		//the distances to the node plane, the axial planes aren't always
+		//facing positive so there's no shortcut for those
+		front = DotProduct(cur_start, aasnode->normal) - aasnode->dist;
+		back = DotProduct(cur_end, aasnode->normal) - aasnode->dist;
 		// bk010221 - old location of FPE hack and divide by zero expression
 		//if the whole to be traced line is totally at the front of this node
 		//only go down the tree with the front child
@@ -730,8 +775,7 @@ int AAS_TraceAreas(vec3_t start, vec3_t end, int *areas, vec3_t *points, int max
 	vec3_t cur_start, cur_end, cur_mid;
 	aas_tracestack_t tracestack[127];
 	aas_tracestack_t *tstack_p;
-	aas_node_t *aasnode;
-	aas_plane_t *plane;
+	aas_tracenode_t *aasnode;
 
 	numareas = 0;
 	areas[0] = 0;
@@ -787,43 +831,16 @@ int AAS_TraceAreas(vec3_t start, vec3_t end, int *areas, vec3_t *points, int max
 			return numareas;
 		} //end if
 #endif //AAS_SAMPLE_DEBUG
-		//the node to test against
-		aasnode = &aasworld.nodes[nodenum];
+		//the node to test against, with its plane
+		aasnode = &aasworld.tracenodes[nodenum];
 		//start point of current line to test against node
 		VectorCopy(tstack_p->start, cur_start);
 		//end point of the current line to test against node
 		VectorCopy(tstack_p->end, cur_end);
-		//the current node plane
-		plane = &aasworld.planes[aasnode->planenum];
-
-		switch(plane->type)
-		{/*FIXME: wtf doesn't this work? obviously the node planes aren't always facing positive!!!
-			//check for axial planes
-			case PLANE_X:
-			{
-				front = cur_start[0] - plane->dist;
-				back = cur_end[0] - plane->dist;
-				break;
-			} //end case
-			case PLANE_Y:
-			{
-				front = cur_start[1] - plane->dist;
-				back = cur_end[1] - plane->dist;
-				break;
-			} //end case
-			case PLANE_Z:
-			{
-				front = cur_start[2] - plane->dist;
-				back = cur_end[2] - plane->dist;
-				break;
-			} //end case*/
-			default: //gee it's not an axial plane
-			{
-				front = DotProduct(cur_start, plane->normal) - plane->dist;
-				back = DotProduct(cur_end, plane->normal) - plane->dist;
-				break;
-			} //end default
-		} //end switch
+		//the distances to the node plane, the axial planes aren't always
+		//facing positive so there's no shortcut for those
+		front = DotProduct(cur_start, aasnode->normal) - aasnode->dist;
+		back = DotProduct(cur_end, aasnode->normal) - aasnode->dist;
 
 		//if the whole to be traced line is totally at the front of this node
 		//only go down the tree with the front child
@@ -1219,9 +1236,52 @@ typedef struct
 	int nodenum;		//node found after splitting
 } aas_linkstack_t;
 
-aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
+//===========================================================================
+// how far the box can move before it is on other sides of the plane than
+// it is now, dist1 and dist2 as in AAS_BoxOnPlaneSide2
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static float AAS_BoxPlaneMargin(vec3_t absmins, vec3_t absmaxs, aas_plane_t *p)
+{
+	int i;
+	float dist1, dist2;
+
+	dist1 = dist2 = -p->dist;
+	for (i = 0; i < 3; i++)
+	{
+		if (p->normal[i] < 0)
+		{
+			dist1 += p->normal[i] * absmins[i];
+			dist2 += p->normal[i] * absmaxs[i];
+		} //end if
+		else
+		{
+			dist1 += p->normal[i] * absmaxs[i];
+			dist2 += p->normal[i] * absmins[i];
+		} //end else
+	} //end for
+	//only on the front side
+	if (dist2 >= 0) return dist2;
+	//only on the back side
+	if (dist1 < 0) return -dist1;
+	//on both sides
+	return dist1 < -dist2 ? dist1 : -dist2;
+} //end of the function AAS_BoxPlaneMargin
+//===========================================================================
+// margin, when not NULL, is set to how far the box can be moved without
+// ending up in other areas, as long as its size stays the same
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+aas_link_t *AAS_AASLinkEntityMargin(vec3_t absmins, vec3_t absmaxs, int entnum, float *margin)
 {
 	int side, nodenum;
+	float nodemargin;
 	aas_linkstack_t linkstack[128];
 	aas_linkstack_t *lstack_p;
 	aas_node_t *aasnode;
@@ -1231,10 +1291,12 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 	if (!aasworld.loaded)
 	{
 		botimport.Print(PRT_ERROR, "AAS_LinkEntity: aas not loaded\n");
+		if (margin) *margin = 0;
 		return NULL;
 	} //end if
 
 	areas = NULL;
+	if (margin) *margin = 99999;
 	//
 	lstack_p = linkstack;
 	//we start with the whole line on the stack
@@ -1263,7 +1325,12 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 			if (link) continue;
 			//
 			link = AAS_AllocAASLink();
-			if (!link) return areas;
+			if (!link)
+			{
+				//not linked everywhere, so try again next time
+				if (margin) *margin = 0;
+				return areas;
+			} //end if
 			link->entnum = entnum;
 			link->areanum = -nodenum;
 			//put the link into the double linked area list of the entity
@@ -1288,6 +1355,11 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 		plane = &aasworld.planes[aasnode->planenum];
 		//get the side(s) the box is situated relative to the plane
 		side = AAS_BoxOnPlaneSide2(absmins, absmaxs, plane);
+		if (margin)
+		{
+			nodemargin = AAS_BoxPlaneMargin(absmins, absmaxs, plane);
+			if (nodemargin < *margin) *margin = nodemargin;
+		} //end if
 		//if on the front side of the node
 		if (side & 1)
 		{
@@ -1297,6 +1369,7 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 		if (lstack_p >= &linkstack[127])
 		{
 			botimport.Print(PRT_ERROR, "AAS_LinkEntity: stack overflow\n");
+			if (margin) *margin = 0;
 			break;
 		} //end if
 		//if on the back side of the node
@@ -1308,10 +1381,21 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 		if (lstack_p >= &linkstack[127])
 		{
 			botimport.Print(PRT_ERROR, "AAS_LinkEntity: stack overflow\n");
+			if (margin) *margin = 0;
 			break;
 		} //end if
 	} //end while
 	return areas;
+} //end of the function AAS_AASLinkEntityMargin
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
+{
+	return AAS_AASLinkEntityMargin(absmins, absmaxs, entnum, NULL);
 } //end of the function AAS_AASLinkEntity
 //===========================================================================
 //
@@ -1319,7 +1403,7 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
-aas_link_t *AAS_LinkEntityClientBBox(vec3_t absmins, vec3_t absmaxs, int entnum, int presencetype)
+aas_link_t *AAS_LinkEntityClientBBoxMargin(vec3_t absmins, vec3_t absmaxs, int entnum, int presencetype, float *margin)
 {
 	vec3_t mins, maxs;
 	vec3_t newabsmins, newabsmaxs;
@@ -1328,7 +1412,17 @@ aas_link_t *AAS_LinkEntityClientBBox(vec3_t absmins, vec3_t absmaxs, int entnum,
 	VectorSubtract(absmins, maxs, newabsmins);
 	VectorSubtract(absmaxs, mins, newabsmaxs);
 	//relink the entity
-	return AAS_AASLinkEntity(newabsmins, newabsmaxs, entnum);
+	return AAS_AASLinkEntityMargin(newabsmins, newabsmaxs, entnum, margin);
+} //end of the function AAS_LinkEntityClientBBoxMargin
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+aas_link_t *AAS_LinkEntityClientBBox(vec3_t absmins, vec3_t absmaxs, int entnum, int presencetype)
+{
+	return AAS_LinkEntityClientBBoxMargin(absmins, absmaxs, entnum, presencetype, NULL);
 } //end of the function AAS_LinkEntityClientBBox
 //===========================================================================
 //
@@ -110,6 +110,7 @@ typedef struct bot_randomlist_s
 typedef struct bot_synonym_s
 {
 	char *string;
+	int id;								//string number in synmatcher
 	float weight;
 	struct bot_synonym_s *next;
 } bot_synonym_t;
@@ -126,6 +127,7 @@ typedef struct bot_synonymlist_s
 typedef struct bot_matchstring_s
 {
 	char *string;
+	int id;								//string number in chatmatcher, -1 if empty
 	struct bot_matchstring_s *next;
 } bot_matchstring_t;
 
@@ -152,6 +154,7 @@ typedef struct bot_replychatkey_s
 {
 	int flags;
 	char *string;
+	int id;								//string number in chatmatcher of a string key
 	bot_matchpiece_t *match;
 	struct bot_replychatkey_s *next;
 } bot_replychatkey_t;
@@ -210,6 +213,32 @@ bot_randomlist_t *randomstrings = NULL;
 //reply chats
 bot_replychat_t *replychats = NULL;
 
+//node of a string matcher trie
+typedef struct bot_matchernode_s
+{
+	int child;							//first child, 0 if none as the root is node 0
+	int sibling;						//next child of the same parent
+	int fail;							//longest proper suffix that is in the trie
+	int output;							//nearest node along the fail links a string ends in
+	int string;							//string that ends here, -1 if none
+	unsigned char c;
+} bot_matchernode_t;
+//upper cased strings compiled into an Aho-Corasick automaton, which of them
+//are somewhere in a message is found in one pass over it
+typedef struct bot_matcher_s
+{
+	bot_matchernode_t *nodes;
+	int numnodes;
+	int maxnodes;
+	int numstrings;
+	unsigned char *found;				//per string, set by BotMatcherScan
+} bot_matcher_t;
+
+//the strings of the match templates and reply chat keys
+bot_matcher_t chatmatcher;
+//the synonyms
+bot_matcher_t synmatcher;
+
 //========================================================================
 //
 // Parameter:				-
@@ -547,10 +576,12 @@ char *StringContainsWord(char *str1, char *str2, int casesensitive)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
-void StringReplaceWords(char *string, char *synonym, char *replacement)
+int StringReplaceWords(char *string, char *synonym, char *replacement)
 {
 	char *str, *str2;
+	int replaced;
 
+	replaced = qfalse;
 	//find the synonym in the string
 	str = StringContainsWord(string, synonym, qfalse);
 	//if the synonym occurred in the string
@@ -569,10 +600,12 @@ void StringReplaceWords(char *string, char *synonym, char *replacement)
 			memmove(str + strlen(replacement), str+strlen(synonym), strlen(str+strlen(synonym))+1);
 			//append the synonum replacement
 			Com_Memcpy(str, replacement, strlen(replacement));
+			replaced = qtrue;
 		} //end if
 		//find the next synonym in the string
 		str = StringContainsWord(str+strlen(replacement), synonym, qfalse);
 	} //end if
+	return replaced;
 } //end of the function StringReplaceWords
 //===========================================================================
 //
@@ -580,6 +613,155 @@ void StringReplaceWords(char *string, char *synonym, char *replacement)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
+static int BotMatcherChild(bot_matcher_t *m, int node, int c)
+{
+	int n;
+
+	for (n = m->nodes[node].child; n; n = m->nodes[n].sibling)
+	{
+		if (m->nodes[n].c == c) return n;
+	} //end for
+	return 0;
+} //end of the function BotMatcherChild
+//===========================================================================
+// adds a string to the trie, the same string twice gets the same number
+//
+// Parameter:				-
+// Returns:					number of the string, -1 for an empty one
+// Changes Globals:		-
+//===========================================================================
+static int BotMatcherAdd(bot_matcher_t *m, char *string)
+{
+	bot_matchernode_t *nodes, *n;
+	int node, next, c;
+
+	if (!*string) return -1;
+	//
+	if (!m->nodes)
+	{
+		m->maxnodes = 256;
+		m->nodes = (bot_matchernode_t *) GetClearedMemory(m->maxnodes * sizeof(bot_matchernode_t));
+		m->nodes[0].output = -1;
+		m->nodes[0].string = -1;
+		m->numnodes = 1;
+	} //end if
+	//
+	node = 0;
+	for (; *string; string++)
+	{
+		c = toupper((unsigned char) *string);
+		next = BotMatcherChild(m, node, c);
+		if (!next)
+		{
+			if (m->numnodes >= m->maxnodes)
+			{
+				nodes = (bot_matchernode_t *) GetClearedMemory(m->maxnodes * 2 * sizeof(bot_matchernode_t));
+				Com_Memcpy(nodes, m->nodes, m->numnodes * sizeof(bot_matchernode_t));
+				FreeMemory(m->nodes);
+				m->nodes = nodes;
+				m->maxnodes *= 2;
+			} //end if
+			next = m->numnodes++;
+			n = &m->nodes[next];
+			n->child = 0;
+			n->sibling = m->nodes[node].child;
+			n->fail = 0;
+			n->output = -1;
+			n->string = -1;
+			n->c = c;
+			m->nodes[node].child = next;
+		} //end if
+		node = next;
+	} //end for
+	if (m->nodes[node].string == -1) m->nodes[node].string = m->numstrings++;
+	return m->nodes[node].string;
+} //end of the function BotMatcherAdd
+//===========================================================================
+// sets the fail and output links once all the strings are added
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotMatcherBuild(bot_matcher_t *m)
+{
+	int *queue, head, tail, node, child, f;
+	bot_matchernode_t *n;
+
+	if (!m->nodes) return;
+	//breadth first so the fail link of every parent is set before its children
+	queue = (int *) GetMemory(m->numnodes * sizeof(int));
+	head = tail = 0;
+	queue[tail++] = 0;
+	while(head < tail)
+	{
+		node = queue[head++];
+		for (child = m->nodes[node].child; child; child = m->nodes[child].sibling)
+		{
+			n = &m->nodes[child];
+			f = 0;
+			if (node)
+			{
+				for (f = m->nodes[node].fail; f && !BotMatcherChild(m, f, n->c); f = m->nodes[f].fail)
+				{
+				} //end for
+				f = BotMatcherChild(m, f, n->c);
+			} //end if
+			n->fail = f;
+			n->output = m->nodes[f].string != -1 ? f : m->nodes[f].output;
+			queue[tail++] = child;
+		} //end for
+	} //end while
+	FreeMemory(queue);
+	//
+	m->found = (unsigned char *) GetClearedMemory(m->numstrings + 1);
+} //end of the function BotMatcherBuild
+//===========================================================================
+// marks every string of the matcher the given string contains, ignoring case
+//
+// Parameter:				-
+// Returns:					per string of the matcher if it was found, NULL
+//							without a matcher
+// Changes Globals:		-
+//===========================================================================
+static unsigned char *BotMatcherScan(bot_matcher_t *m, char *string)
+{
+	int node, next, c, n;
+
+	if (!m->found) return NULL;
+	//
+	Com_Memset(m->found, 0, m->numstrings);
+	node = 0;
+	for (; *string; string++)
+	{
+		c = toupper((unsigned char) *string);
+		while(!(next = BotMatcherChild(m, node, c)) && node) node = m->nodes[node].fail;
+		node = next;
+		for (n = node; n > 0; n = m->nodes[n].output)
+		{
+			if (m->nodes[n].string != -1) m->found[m->nodes[n].string] = 1;
+		} //end for
+	} //end for
+	return m->found;
+} //end of the function BotMatcherScan
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotMatcherFree(bot_matcher_t *m)
+{
+	if (m->nodes) FreeMemory(m->nodes);
+	if (m->found) FreeMemory(m->found);
+	Com_Memset(m, 0, sizeof(bot_matcher_t));
+} //end of the function BotMatcherFree
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
 void BotDumpSynonymList(bot_synonymlist_t *synlist)
 {
 	FILE *fp;
@@ -778,13 +960,20 @@ void BotReplaceSynonyms(char *string, unsigned long int context)
 {
 	bot_synonymlist_t *syn;
 	bot_synonym_t *synonym;
+	unsigned char *found;
 
+	//only the synonyms that are in the string, looked again after a replacement
+	found = BotMatcherScan(&synmatcher, string);
 	for (syn = synonyms; syn; syn = syn->next)
 	{
 		if (!(syn->context & context)) continue;
 		for (synonym = syn->firstsynonym->next; synonym; synonym = synonym->next)
 		{
-			StringReplaceWords(string, synonym->string, syn->firstsynonym->string);
+			if (found && !found[synonym->id]) continue;
+			if (StringReplaceWords(string, synonym->string, syn->firstsynonym->string) && found)
+			{
+				BotMatcherScan(&synmatcher, string);
+			} //end if
 		} //end for
 	} //end for
 } //end of the function BotReplaceSynonyms
@@ -799,7 +988,9 @@ void BotReplaceWeightedSynonyms(char *string, unsigned long int context)
 	bot_synonymlist_t *syn;
 	bot_synonym_t *synonym, *replacement;
 	float weight, curweight;
+	unsigned char *found;
 
+	found = BotMatcherScan(&synmatcher, string);
 	for (syn = synonyms; syn; syn = syn->next)
 	{
 		if (!(syn->context & context)) continue;
@@ -817,7 +1008,11 @@ void BotReplaceWeightedSynonyms(char *string, unsigned long int context)
 		for (synonym = syn->firstsynonym; synonym; synonym = synonym->next)
 		{
 			if (synonym == replacement) continue;
-			StringReplaceWords(string, synonym->string, replacement->string);
+			if (found && !found[synonym->id]) continue;
+			if (StringReplaceWords(string, synonym->string, replacement->string) && found)
+			{
+				BotMatcherScan(&synmatcher, string);
+			} //end if
 		} //end for
 	} //end for
 } //end of the function BotReplaceWeightedSynonyms
@@ -832,7 +1027,9 @@ void BotReplaceReplySynonyms(char *string, unsigned long int context)
 	char *str1, *str2, *replacement;
 	bot_synonymlist_t *syn;
 	bot_synonym_t *synonym;
+	unsigned char *found;
 
+	found = BotMatcherScan(&synmatcher, string);
 	for (str1 = string; *str1; )
 	{
 		//go to the start of the next word
@@ -844,6 +1041,8 @@ void BotReplaceReplySynonyms(char *string, unsigned long int context)
 			if (!(syn->context & context)) continue;
 			for (synonym = syn->firstsynonym->next; synonym; synonym = synonym->next)
 			{
+				//a synonym that isn't anywhere in the string isn't at the front
+				if (found && !found[synonym->id]) continue;
 				//if the synonym is not at the front of the string continue
 				str2 = StringContainsWord(str1, synonym->string, qfalse);
 				if (!str2 || str2 != str1) continue;
@@ -857,6 +1056,7 @@ void BotReplaceReplySynonyms(char *string, unsigned long int context)
 							strlen(str1+strlen(synonym->string)) + 1);
 				//append the synonum replacement
 				Com_Memcpy(str1, replacement, strlen(replacement));
+				if (found) BotMatcherScan(&synmatcher, string);
 				//
 				break;
 			} //end for
@@ -1446,6 +1646,31 @@ int StringsMatch(bot_matchpiece_t *pieces, bot_match_t *match)
 	return qfalse;
 } //end of the function StringsMatch
 //===========================================================================
+// qfalse when a string piece has none of its strings anywhere in the
+// message, StringsMatch would fail on it
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int BotMatchPiecesPossible(bot_matchpiece_t *pieces, unsigned char *found)
+{
+	bot_matchpiece_t *mp;
+	bot_matchstring_t *ms;
+
+	if (!found) return qtrue;
+	for (mp = pieces; mp; mp = mp->next)
+	{
+		if (mp->type != MT_STRING) continue;
+		for (ms = mp->firststring; ms; ms = ms->next)
+		{
+			if (ms->id == -1 || found[ms->id]) break;
+		} //end for
+		if (!ms) return qfalse;
+	} //end for
+	return qtrue;
+} //end of the function BotMatchPiecesPossible
+//===========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -1455,6 +1680,7 @@ int BotFindMatch(char *str, bot_match_t *match, unsigned long int context)
 {
 	int i;
 	bot_matchtemplate_t *ms;
+	unsigned char *found;
 
 	Q_strncpyz(match->string, str, MAX_MESSAGE_SIZE);
 	//remove any trailing enters
@@ -1463,10 +1689,13 @@ int BotFindMatch(char *str, bot_match_t *match, unsigned long int context)
 	{
 		match->string[strlen(match->string)-1] = '\0';
 	} //end while
+	//all the template strings in the message at once
+	found = BotMatcherScan(&chatmatcher, match->string);
 	//compare the string with all the match strings
 	for (ms = matchtemplates; ms; ms = ms->next)
 	{
 		if (!(ms->context & context)) continue;
+		if (!BotMatchPiecesPossible(ms->first, found)) continue;
 		//reset the match variable offsets
 		for (i = 0; i < MAX_MATCHVARIABLES; i++) match->variables[i].offset = -1;
 		//
@@ -2640,11 +2869,14 @@ int BotReplyChat(int chatstate, char *message, int mcontext, int vcontext, char
 	bot_match_t match, bestmatch;
 	int bestpriority, num, found, res, numchatmessages, index;
 	bot_chatstate_t *cs;
+	unsigned char *keysfound;
 
 	cs = BotChatStateFromHandle(chatstate);
 	if (!cs) return qfalse;
 	Com_Memset(&match, 0, sizeof(bot_match_t));
 	strcpy(match.string, message);
+	//all the key strings in the message at once
+	keysfound = BotMatcherScan(&chatmatcher, message);
 	bestpriority = -1;
 	bestchatmessage = NULL;
 	bestrchat = NULL;
@@ -2661,8 +2893,8 @@ int BotReplyChat(int chatstate, char *message, int mcontext, int vcontext, char
 			else if (key->flags & RCKFL_GENDERFEMALE) res = (cs->gender == CHAT_GENDERFEMALE);
 			else if (key->flags & RCKFL_GENDERMALE) res = (cs->gender == CHAT_GENDERMALE);
 			else if (key->flags & RCKFL_GENDERLESS) res = (cs->gender == CHAT_GENDERLESS);
-			else if (key->flags & RCKFL_VARIABLES) res = StringsMatch(key->match, &match);
-			else if (key->flags & RCKFL_STRING) res = (StringContainsWord(message, key->string, qfalse) != NULL);
+			else if (key->flags & RCKFL_VARIABLES) res = BotMatchPiecesPossible(key->match, keysfound) && StringsMatch(key->match, &match);
+			else if (key->flags & RCKFL_STRING) res = (!keysfound || keysfound[key->id]) && StringContainsWord(message, key->string, qfalse) != NULL;
 			//if the key must be present
 			if (key->flags & RCKFL_AND)
 			{
@@ -2966,6 +3198,68 @@ void BotFreeChatState(int handle)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
+static void BotCompileChatMatchPieces(bot_matchpiece_t *pieces)
+{
+	bot_matchpiece_t *mp;
+	bot_matchstring_t *ms;
+
+	for (mp = pieces; mp; mp = mp->next)
+	{
+		if (mp->type != MT_STRING) continue;
+		for (ms = mp->firststring; ms; ms = ms->next)
+		{
+			ms->id = BotMatcherAdd(&chatmatcher, ms->string);
+		} //end for
+	} //end for
+} //end of the function BotCompileChatMatchPieces
+//===========================================================================
+// builds the matchers over the loaded match templates, reply chats and
+// synonyms
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotCompileChatMatchers(void)
+{
+	bot_matchtemplate_t *mt;
+	bot_replychat_t *rchat;
+	bot_replychatkey_t *key;
+	bot_synonymlist_t *syn;
+	bot_synonym_t *synonym;
+
+	BotMatcherFree(&chatmatcher);
+	BotMatcherFree(&synmatcher);
+
+	for (mt = matchtemplates; mt; mt = mt->next)
+	{
+		BotCompileChatMatchPieces(mt->first);
+	} //end for
+	for (rchat = replychats; rchat; rchat = rchat->next)
+	{
+		for (key = rchat->keys; key; key = key->next)
+		{
+			if (key->flags & RCKFL_VARIABLES) BotCompileChatMatchPieces(key->match);
+			else if (key->flags & RCKFL_STRING) key->id = BotMatcherAdd(&chatmatcher, key->string);
+		} //end for
+	} //end for
+	BotMatcherBuild(&chatmatcher);
+	//
+	for (syn = synonyms; syn; syn = syn->next)
+	{
+		for (synonym = syn->firstsynonym; synonym; synonym = synonym->next)
+		{
+			synonym->id = BotMatcherAdd(&synmatcher, synonym->string);
+		} //end for
+	} //end for
+	BotMatcherBuild(&synmatcher);
+} //end of the function BotCompileChatMatchers
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
 int BotSetupChatAI(void)
 {
 	char *file;
@@ -2986,6 +3280,7 @@ int BotSetupChatAI(void)
 		file = LibVarString("rchatfile", "rchat.c");
 		replychats = BotLoadReplyChat(file);
 	} //end if
+	BotCompileChatMatchers();
 
 	InitConsoleMessageHeap();
 
@@ -3032,4 +3327,6 @@ void BotShutdownChatAI(void)
 	synonyms = NULL;
 	if (replychats) BotFreeReplyChat(replychats);
 	replychats = NULL;
+	BotMatcherFree(&chatmatcher);
+	BotMatcherFree(&synmatcher);
 } //end of the function BotShutdownChatAI
@@ -120,6 +120,15 @@ typedef struct levelitem_s
 	struct levelitem_s *prev, *next;
 } levelitem_t;
 
+//an item a bot may go for, see BotItemCandidates
+typedef struct itemcandidate_s
+{
+	levelitem_t *li;
+	float weight;						//fuzzy weight of the item
+	float bestweight;					//weight with the least travel time possible
+	int order;							//place in the level item list
+} itemcandidate_t;
+
 typedef struct iteminfo_s
 {
 	char classname[32];					//classname of the item
@@ -184,6 +193,8 @@ levelitem_t *levelitemheap = NULL;
 levelitem_t *freelevelitems = NULL;
 levelitem_t *levelitems = NULL;
 int numlevelitems = 0;
+itemcandidate_t *itemcandidates = NULL;
+int maxitemcandidates = 0;
 //map locations
 maplocation_t *maplocations = NULL;
 //camp spots
@@ -379,6 +390,10 @@ void InitLevelItemHeap(void)
 
 	max_levelitems = (int) LibVarValue("max_levelitems", "256");
 	levelitemheap = (levelitem_t *) GetClearedMemory(max_levelitems * sizeof(levelitem_t));
+	//as many candidates as there can be items
+	if (itemcandidates) FreeMemory(itemcandidates);
+	itemcandidates = (itemcandidate_t *) GetClearedMemory(max_levelitems * sizeof(itemcandidate_t));
+	maxitemcandidates = max_levelitems;
 
 	for (i = 0; i < max_levelitems-1; i++)
 	{
@@ -1282,50 +1297,44 @@ int BotGetSecondGoal(int goalstate, bot_goal_t *goal)
 	return qtrue;
 } //end of the function BotGetSecondGoal
 //===========================================================================
-// pops a new long term goal on the goal stack in the goalstate
 //
 // Parameter:				-
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
-int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelflags)
+int QDECL BotCompareItemCandidates(const void *a, const void *b)
 {
-	int areanum, t, weightnum;
-	float weight, bestweight, avoidtime;
+	const itemcandidate_t *ca = (const itemcandidate_t *) a;
+	const itemcandidate_t *cb = (const itemcandidate_t *) b;
+
+	if (ca->bestweight > cb->bestweight) return -1;
+	if (ca->bestweight < cb->bestweight) return 1;
+	return ca->order - cb->order;
+} //end of the function BotCompareItemCandidates
+//===========================================================================
+// fills itemcandidates with the items worth going for, the best weight
+// each could have first. the weight of an item falls with the travel time,
+// which is never less than AAS_AreaTravelTimeLowerBound, so once the best
+// weight of the next candidate is below the best weight found the rest
+// needn't be routed to. maxtime < 0 is no limit
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int BotItemCandidates(bot_goalstate_t *gs, int areanum, int *inventory, int travelflags, float maxtime)
+{
+	int weightnum, order, numcandidates, t;
+	float weight;
 	iteminfo_t *iteminfo;
 	itemconfig_t *ic;
-	levelitem_t *li, *bestitem;
-	bot_goal_t goal;
-	bot_goalstate_t *gs;
+	levelitem_t *li;
+	itemcandidate_t *candidate;
 
-	gs = BotGoalStateFromHandle(goalstate);
-	if (!gs)
-		return qfalse;
-	if (!gs->itemweightconfig)
-		return qfalse;
-	//get the area the bot is in
-	areanum = BotReachabilityArea(origin, gs->client);
-	//if the bot is in solid or if the area the bot is in has no reachability links
-	if (!areanum || !AAS_AreaReachability(areanum))
-	{
-		//use the last valid area the bot was in
-		areanum = gs->lastreachabilityarea;
-	} //end if
-	//remember the last area with reachabilities the bot was in
-	gs->lastreachabilityarea = areanum;
-	//if still in solid
-	if (!areanum)
-		return qfalse;
-	//the item configuration
 	ic = itemconfig;
-	if (!itemconfig)
-		return qfalse;
-	//best weight and item so far
-	bestweight = 0;
-	bestitem = NULL;
-	Com_Memset(&goal, 0, sizeof(bot_goal_t));
+	numcandidates = 0;
 	//go through the items in the level
-	for (li = levelitems; li; li = li->next)
+	for (li = levelitems, order = 0; li; li = li->next, order++)
 	{
 		if (g_gametype == GT_SINGLE_PLAYER) {
 			if (li->flags & IFL_NOTSINGLE)
@@ -1366,25 +1375,97 @@ int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 		//use weight scale for item_botroam
 		if (li->flags & IFL_ROAM) weight *= li->weight;
 		//
-		if (weight > 0)
+		if (weight <= 0)
+			continue;
+		//the item can't be reached faster than this
+		t = AAS_AreaTravelTimeLowerBound(areanum, li->goalareanum, travelflags);
+		if (maxtime >= 0 && t >= maxtime)
+			continue;
+		if (t < 1) t = 1;
+		//
+		if (numcandidates >= maxitemcandidates)
+			break;
+		candidate = &itemcandidates[numcandidates++];
+		candidate->li = li;
+		candidate->weight = weight;
+		candidate->bestweight = weight / ((float) t * TRAVELTIME_SCALE);
+		candidate->order = order;
+	} //end for
+	//
+	qsort(itemcandidates, numcandidates, sizeof(itemcandidate_t), BotCompareItemCandidates);
+	return numcandidates;
+} //end of the function BotItemCandidates
+//===========================================================================
+// pops a new long term goal on the goal stack in the goalstate
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelflags)
+{
+	int areanum, t, i, numcandidates, bestorder;
+	float weight, bestweight, avoidtime;
+	iteminfo_t *iteminfo;
+	itemconfig_t *ic;
+	levelitem_t *li, *bestitem;
+	itemcandidate_t *candidate;
+	bot_goal_t goal;
+	bot_goalstate_t *gs;
+
+	gs = BotGoalStateFromHandle(goalstate);
+	if (!gs)
+		return qfalse;
+	if (!gs->itemweightconfig)
+		return qfalse;
+	//get the area the bot is in
+	areanum = BotReachabilityArea(origin, gs->client);
+	//if the bot is in solid or if the area the bot is in has no reachability links
+	if (!areanum || !AAS_AreaReachability(areanum))
+	{
+		//use the last valid area the bot was in
+		areanum = gs->lastreachabilityarea;
+	} //end if
+	//remember the last area with reachabilities the bot was in
+	gs->lastreachabilityarea = areanum;
+	//if still in solid
+	if (!areanum)
+		return qfalse;
+	//the item configuration
+	ic = itemconfig;
+	if (!itemconfig)
+		return qfalse;
+	//best weight and item so far
+	bestweight = 0;
+	bestitem = NULL;
+	bestorder = 0;
+	Com_Memset(&goal, 0, sizeof(bot_goal_t));
+	//go through the items worth going for, the best first
+	numcandidates = BotItemCandidates(gs, areanum, inventory, travelflags, -1);
+	for (i = 0; i < numcandidates; i++)
+	{
+		candidate = &itemcandidates[i];
+		//none of the items left can do better
+		if (candidate->bestweight < bestweight)
+			break;
+		li = candidate->li;
+		//get the travel time towards the goal area
+		t = AAS_AreaTravelTimeToGoalArea(areanum, origin, li->goalareanum, travelflags);
+		//if the goal is reachable
+		if (t > 0)
 		{
-			//get the travel time towards the goal area
-			t = AAS_AreaTravelTimeToGoalArea(areanum, origin, li->goalareanum, travelflags);
-			//if the goal is reachable
-			if (t > 0)
+			//if this item won't respawn before we get there
+			avoidtime = BotAvoidGoalTime(goalstate, li->number);
+			if (avoidtime - t * 0.009 > 0)
+				continue;
+			//
+			weight = candidate->weight / ((float) t * TRAVELTIME_SCALE);
+			//the first of equally good items in the level item list
+			if (weight > bestweight || (bestitem && weight == bestweight && candidate->order < bestorder))
 			{
-				//if this item won't respawn before we get there
-				avoidtime = BotAvoidGoalTime(goalstate, li->number);
-				if (avoidtime - t * 0.009 > 0)
-					continue;
-				//
-				weight /= (float) t * TRAVELTIME_SCALE;
-				//
-				if (weight > bestweight)
-				{
-					bestweight = weight;
-					bestitem = li;
-				} //end if
+				bestweight = weight;
+				bestitem = li;
+				bestorder = candidate->order;
 			} //end if
 		} //end if
 	} //end for
@@ -1458,11 +1539,12 @@ int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 int BotChooseNBGItem(int goalstate, vec3_t origin, int *inventory, int travelflags,
 														bot_goal_t *ltg, float maxtime)
 {
-	int areanum, t, weightnum, ltg_time;
+	int areanum, t, ltg_time, i, numcandidates, bestorder;
 	float weight, bestweight, avoidtime;
 	iteminfo_t *iteminfo;
 	itemconfig_t *ic;
 	levelitem_t *li, *bestitem;
+	itemcandidate_t *candidate;
 	bot_goal_t goal;
 	bot_goalstate_t *gs;
 
@@ -1494,77 +1576,43 @@ int BotChooseNBGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 	//best weight and item so far
 	bestweight = 0;
 	bestitem = NULL;
+	bestorder = 0;
 	Com_Memset(&goal, 0, sizeof(bot_goal_t));
-	//go through the items in the level
-	for (li = levelitems; li; li = li->next)
+	//go through the items close enough and worth going for, the best first
+	numcandidates = BotItemCandidates(gs, areanum, inventory, travelflags, maxtime > 0 ? maxtime : 0);
+	for (i = 0; i < numcandidates; i++)
 	{
-		if (g_gametype == GT_SINGLE_PLAYER) {
-			if (li->flags & IFL_NOTSINGLE)
-				continue;
-		}
-		else if (g_gametype >= GT_TEAM) {
-			if (li->flags & IFL_NOTTEAM)
-				continue;
-		}
-		else {
-			if (li->flags & IFL_NOTFREE)
-				continue;
-		}
-		if (li->flags & IFL_NOTBOT)
-			continue;
-		//if the item is in a possible goal area
-		if (!li->goalareanum)
-			continue;
-		//FIXME: is this a good thing? added this for items that never spawned into the game (f.i. CTF flags in obelisk)
-		if (!li->entitynum && !(li->flags & IFL_ROAM))
-			continue;
-		//get the fuzzy weight function for this item
-		iteminfo = &ic->iteminfo[li->iteminfo];
-		weightnum = gs->itemweightindex[iteminfo->number];
-		if (weightnum < 0)
-			continue;
-		//
-#ifdef UNDECIDEDFUZZY
-		weight = FuzzyWeightUndecided(inventory, gs->itemweightconfig, weightnum);
-#else
-		weight = FuzzyWeight(inventory, gs->itemweightconfig, weightnum);
-#endif //UNDECIDEDFUZZY
-#ifdef DROPPEDWEIGHT
-		//HACK: to make dropped items more attractive
-		if (li->timeout)
-			weight += droppedweight->value;
-#endif //DROPPEDWEIGHT
-		//use weight scale for item_botroam
-		if (li->flags & IFL_ROAM) weight *= li->weight;
-		//
-		if (weight > 0)
+		candidate = &itemcandidates[i];
+		//none of the items left can do better
+		if (candidate->bestweight < bestweight)
+			break;
+		li = candidate->li;
+		//get the travel time towards the goal area
+		t = AAS_AreaTravelTimeToGoalArea(areanum, origin, li->goalareanum, travelflags);
+		//if the goal is reachable
+		if (t > 0 && t < maxtime)
 		{
-			//get the travel time towards the goal area
-			t = AAS_AreaTravelTimeToGoalArea(areanum, origin, li->goalareanum, travelflags);
-			//if the goal is reachable
-			if (t > 0 && t < maxtime)
+			//if this item won't respawn before we get there
+			avoidtime = BotAvoidGoalTime(goalstate, li->number);
+			if (avoidtime - t * 0.009 > 0)
+				continue;
+			//
+			weight = candidate->weight / ((float) t * TRAVELTIME_SCALE);
+			//the first of equally good items in the level item list
+			if (weight > bestweight || (bestitem && weight == bestweight && candidate->order < bestorder))
 			{
-				//if this item won't respawn before we get there
-				avoidtime = BotAvoidGoalTime(goalstate, li->number);
-				if (avoidtime - t * 0.009 > 0)
-					continue;
-				//
-				weight /= (float) t * TRAVELTIME_SCALE;
-				//
-				if (weight > bestweight)
+				t = 0;
+				if (ltg && !li->timeout)
 				{
-					t = 0;
-					if (ltg && !li->timeout)
-					{
-						//get the travel time from the goal to the long term goal
-						t = AAS_AreaTravelTimeToGoalArea(li->goalareanum, li->goalorigin, ltg->areanum, travelflags);
-					} //end if
-					//if the travel back is possible and doesn't take too long
-					if (t <= ltg_time)
-					{
-						bestweight = weight;
-						bestitem = li;
-					} //end if
+					//get the travel time from the goal to the long term goal
+					t = AAS_AreaTravelTimeToGoalArea(li->goalareanum, li->goalorigin, ltg->areanum, travelflags);
+				} //end if
+				//if the travel back is possible and doesn't take too long
+				if (t <= ltg_time)
+				{
+					bestweight = weight;
+					bestitem = li;
+					bestorder = candidate->order;
 				} //end if
 			} //end if
 		} //end if
@@ -1815,6 +1863,9 @@ void BotShutdownGoalAI(void)
 	freelevelitems = NULL;
 	levelitems = NULL;
 	numlevelitems = 0;
+	if (itemcandidates) FreeMemory(itemcandidates);
+	itemcandidates = NULL;
+	maxitemcandidates = 0;
 
 	BotFreeInfoEntities();
 
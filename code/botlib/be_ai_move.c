@@ -69,6 +69,7 @@ typedef struct bot_movestate_s
 	int areanum;								//area the bot is in
 	int lastareanum;							//last area the bot was in
 	int lastgoalareanum;						//last goal area number
+	int lasttravelflags;						//travel flags used towards the last goal
 	int lastreachnum;							//last reachability number
 	vec3_t lastorigin;							//origin previous cycle
 	int reachareanum;							//area number of the reachabilty
@@ -3019,6 +3020,7 @@ void BotMoveToGoal(bot_moveresult_t *result, int movestate, bot_goal_t *goal, in
 	//
 	ms = BotMoveStateFromHandle(movestate);
 	if (!ms) return;
+	ms->lasttravelflags = travelflags;
 	//reset the grapple before testing if the bot has a valid goal
 	//because the bot could lose all its goals when stuck to a wall
 	BotResetGrapple(ms);
@@ -3517,6 +3519,59 @@ void BotResetMoveState(int movestate)
 	Com_Memset(ms, 0, sizeof(bot_movestate_t));
 } //end of the function BotResetMoveState
 //===========================================================================
+// routes from all the reachabilities of the area the bot is in towards
+// its last goal, which are the routes BotGetReachabilityToGoal and
+// friends will most likely ask for during the next movement update
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BotPrefetchMoveRoutesJob(void *data, int index)
+{
+	bot_movestate_t *ms;
+	aas_reachability_t reach;
+	int reachnum, travelflags;
+
+	ms = ((bot_movestate_t **) data)[index];
+	travelflags = ms->lasttravelflags;
+	if (AAS_AreaDoNotEnter(ms->areanum) || AAS_AreaDoNotEnter(ms->lastgoalareanum))
+	{
+		travelflags |= TFL_DONOTENTER;
+	} //end if
+	for (reachnum = AAS_NextAreaReachability(ms->areanum, 0); reachnum;
+		reachnum = AAS_NextAreaReachability(ms->areanum, reachnum))
+	{
+		AAS_ReachabilityFromNum(reachnum, &reach);
+		if (!BotValidTravel(ms->origin, &reach, travelflags)) continue;
+		AAS_AreaTravelTimeToGoalArea(reach.areanum, reach.end, ms->lastgoalareanum, travelflags);
+	} //end for
+} //end of the function BotPrefetchMoveRoutesJob
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void BotPrefetchMoveRoutes(void)
+{
+	bot_movestate_t *movestates[MAX_CLIENTS+1];
+	bot_movestate_t *ms;
+	int i, num;
+
+	num = 0;
+	for (i = 1; i <= MAX_CLIENTS; i++)
+	{
+		ms = botmovestates[i];
+		if (!ms) continue;
+		if (!AAS_ValidRoutingArea(ms->areanum)) continue;
+		if (!AAS_ValidRoutingArea(ms->lastgoalareanum)) continue;
+		if (ms->areanum == ms->lastgoalareanum) continue;
+		movestates[num++] = ms;
+	} //end for
+	AAS_ParallelRouting(BotPrefetchMoveRoutesJob, movestates, num);
+} //end of the function BotPrefetchMoveRoutes
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -135,6 +135,8 @@ void BotInitMoveState(int handle, bot_initmove_t *initmove);
 void BotAddAvoidSpot(int movestate, vec3_t origin, float radius, int type);
 //must be called every map change
 void BotSetBrushModelTypes(void);
+//build the routing caches for the next movement of all bots on worker threads
+void BotPrefetchMoveRoutes(void);
 //setup movement AI
 int BotSetupMoveAI(void);
 //shutdown movement AI
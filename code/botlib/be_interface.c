@@ -294,6 +294,62 @@ int Export_BotLibUpdateEntity(int ent, bot_entitystate_t *state)
 	return AAS_UpdateEntity(ent, state);
 } //end of the function Export_BotLibUpdateEntity
 //===========================================================================
+// returns the first error, the entities after a bad number are still updated
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Export_BotLibUpdateEntities(int numEntities, const int *entnums, bot_entitystate_t *states)
+{
+	int i, ent, errnum, result;
+
+	if (!BotLibSetup("BotUpdateEntities")) return BLERR_LIBRARYNOTSETUP;
+
+	result = BLERR_NOERROR;
+	for (i = 0; i < numEntities; i++)
+	{
+		ent = entnums[i] & ~BOTLIB_ENTITY_UNLINK;
+		if (!ValidEntityNumber(ent, "BotUpdateEntities"))
+		{
+			if (result == BLERR_NOERROR) result = BLERR_INVALIDENTITYNUMBER;
+			continue;
+		} //end if
+		errnum = AAS_UpdateEntity(ent, (entnums[i] & BOTLIB_ENTITY_UNLINK) ? NULL : &states[i]);
+		//no AAS file, the rest would only say so again
+		if (errnum == BLERR_NOAASFILE) return errnum;
+		if (result == BLERR_NOERROR) result = errnum;
+	} //end for
+	return result;
+} //end of the function Export_BotLibUpdateEntities
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Export_BotLibPrefetchRoutes(void)
+{
+	if (!BotLibSetup("BotPrefetchRoutes")) return BLERR_LIBRARYNOTSETUP;
+
+	BotPrefetchMoveRoutes();
+	return BLERR_NOERROR;
+} //end of the function Export_BotLibPrefetchRoutes
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Export_BotLibRoutingInfo(int reset)
+{
+	if (!BotLibSetup("BotRoutingInfo")) return BLERR_LIBRARYNOTSETUP;
+
+	if (reset) AAS_ResetRoutingInfo();
+	else AAS_RoutingInfo();
+	return BLERR_NOERROR;
+} //end of the function Export_BotLibRoutingInfo
+//===========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -703,6 +759,7 @@ static void Init_AAS_Export( aas_export_t *aas ) {
 	//--------------------------------------------
 	aas->AAS_Swimming = AAS_Swimming;
 	aas->AAS_PredictClientMovement = AAS_PredictClientMovement;
+	aas->AAS_PredictClientMovements = AAS_PredictClientMovements;
 }
 
   
@@ -879,6 +936,9 @@ botlib_export_t *GetBotLibAPI(int apiVersion, botlib_import_t *import) {
 	be_botlib_export.BotLibStartFrame = Export_BotLibStartFrame;
 	be_botlib_export.BotLibLoadMap = Export_BotLibLoadMap;
 	be_botlib_export.BotLibUpdateEntity = Export_BotLibUpdateEntity;
+	be_botlib_export.BotLibUpdateEntities = Export_BotLibUpdateEntities;
+	be_botlib_export.BotLibPrefetchRoutes = Export_BotLibPrefetchRoutes;
+	be_botlib_export.BotLibRoutingInfo = Export_BotLibRoutingInfo;
 	be_botlib_export.Test = BotExportTest;
 
 	return &be_botlib_export;
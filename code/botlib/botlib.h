@@ -32,6 +32,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define	BOTLIB_API_VERSION		2
 
 struct aas_clientmove_s;
+struct aas_clientmoveinput_s;
 struct aas_entityinfo_s;
 struct aas_areainfo_s;
 struct aas_altroutegoal_s;
@@ -166,6 +167,8 @@ typedef struct bot_entitystate_s
 	int		torsoAnim;		// mask off ANIM_TOGGLEBIT
 } bot_entitystate_t;
 
+#define BOTLIB_ENTITY_UNLINK	0x40000000
+
 //bot AI library exported functions
 typedef struct botlib_import_s
 {
@@ -203,6 +206,14 @@ typedef struct botlib_import_s
 	//
 	int			(*DebugPolygonCreate)(int color, int numPoints, vec3_t *points);
 	void		(*DebugPolygonDelete)(int id);
+	//worker threads, the jobs run func( data, index ) for index in [0, count)
+	void		(*RunParallel)(void (*func)(void *data, int index), void *data, int count);
+	int			(*NumWorkers)(void);
+	int			(*WorkerIndex)(void);		// 0 on the main thread
+	void		*(*CreateMutex)(void);
+	void		(*DestroyMutex)(void *mutex);
+	void		(*LockMutex)(void *mutex);
+	void		(*UnlockMutex)(void *mutex);
 } botlib_import_t;
 
 typedef struct aas_export_s
@@ -263,6 +274,12 @@ typedef struct aas_export_s
 											int cmdframes,
 											int maxframes, float frametime,
 											int stopevent, int stopareanum, int visualize);
+	int			(*AAS_PredictClientMovements)(struct aas_clientmove_s *moves,
+											int entnum, vec3_t origin,
+											int presencetype, int onground,
+											struct aas_clientmoveinput_s *inputs, int numinputs,
+											int maxframes, float frametime,
+											int stopevent, int stopareanum);
 } aas_export_t;
 
 typedef struct ea_export_s
@@ -426,6 +443,13 @@ typedef struct botlib_export_s
 	int (*BotLibLoadMap)(const char *mapname);
 	//entity updates
 	int (*BotLibUpdateEntity)(int ent, bot_entitystate_t *state);
+	//the updates of many entities at once, numbers with BOTLIB_ENTITY_UNLINK
+	//set are unlinked as a NULL state does
+	int (*BotLibUpdateEntities)(int numEntities, const int *entnums, bot_entitystate_t *states);
+	//build the routing caches the bots will need on worker threads
+	int (*BotLibPrefetchRoutes)(void);
+	//print the routing cache statistics, or reset them
+	int (*BotLibRoutingInfo)(int reset);
 	//just for testing
 	int (*Test)(int parm0, char *parm1, vec3_t parm2, vec3_t parm3);
 } botlib_export_t;
@@ -484,7 +508,9 @@ name:						default:			module(s):			description:
 "rs_maxjumpfallheight"		"450"				be_aas_move.c
 
 "max_aaslinks"				"4096"				be_aas_sample.c		maximum links in the AAS
-"max_routingcache"			"4096"				be_aas_route.c		maximum routing cache size in KB
+"max_routingcache"			"12288"				be_aas_route.c		maximum routing cache size in KB
+"routingtable"				"0"					be_aas_route.c		build the all pairs routing table
+"routingtable_maxareas"		"1024"				be_aas_route.c		maximum number of areas for the routing table
 "forceclustering"			"0"					be_aas_main.c		force recalculation of clusters
 "forcereachability"			"0"					be_aas_main.c		force recalculation of reachabilities
 "forcewrite"				"0"					be_aas_main.c		force writing of aas file
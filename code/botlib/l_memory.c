@@ -40,6 +40,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #define MEM_ID		0x12345678l
 #define HUNK_ID		0x87654321l
+#define MAP_ID		0x13572468l
 
 int allocatedmemory;
 int totalmemorysize;
@@ -462,3 +463,182 @@ void PrintMemoryLabels(void)
 } //end of the function PrintMemoryLabels
 
 #endif
+
+//===========================================================================
+// map memory
+//
+// memory that lives as long as the current map is allocated from large
+// chunks and released all at once with FreeMapMemory, blocks that are
+// allocated and freed repeatedly are recycled through pools of equally
+// sized blocks carved out of the same chunks
+//===========================================================================
+
+#define MAPMEMORY_CHUNKSIZE		(256 * 1024)
+#define MAPMEMORY_ALIGN			16
+#define MEMORYPOOL_HASHSIZE		64
+
+typedef struct mapmemorychunk_s
+{
+	unsigned long size;
+	unsigned long used;
+	struct mapmemorychunk_s *next;
+} mapmemorychunk_t;
+
+typedef struct memorypool_s
+{
+	unsigned long size;
+	void *freeblocks;
+	struct memorypool_s *next;
+} memorypool_t;
+
+mapmemorychunk_t *mapmemory;
+memorypool_t *memorypools[MEMORYPOOL_HASHSIZE];
+int nummapmemorychunks;
+unsigned long mapmemorysize;
+
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void *GetMapMemory(unsigned long size)
+{
+	mapmemorychunk_t *chunk;
+	unsigned long blocksize, chunksize;
+	unsigned long int *memid;
+
+	//every block starts with an id so FreeMemory can tell it apart
+	blocksize = (size + sizeof(unsigned long int) + MAPMEMORY_ALIGN - 1) & ~(MAPMEMORY_ALIGN - 1);
+	chunk = mapmemory;
+	if (!chunk || chunk->used + blocksize > chunk->size)
+	{
+		chunksize = MAPMEMORY_CHUNKSIZE;
+		if (blocksize > chunksize / 4) chunksize = blocksize;
+		chunk = (mapmemorychunk_t *) botimport.GetMemory(sizeof(mapmemorychunk_t) + 2 * MAPMEMORY_ALIGN + chunksize);
+		if (!chunk) return NULL;
+		chunk->size = chunksize;
+		chunk->used = 0;
+		//large blocks get a chunk of their own and leave the current chunk in use
+		if (mapmemory && chunksize == blocksize)
+		{
+			chunk->next = mapmemory->next;
+			mapmemory->next = chunk;
+		} //end if
+		else
+		{
+			chunk->next = mapmemory;
+			mapmemory = chunk;
+		} //end else
+		nummapmemorychunks++;
+		mapmemorysize += chunksize;
+	} //end if
+	memid = (unsigned long int *) (((size_t) (chunk + 1) + MAPMEMORY_ALIGN - 1) & ~(size_t) (MAPMEMORY_ALIGN - 1));
+	memid = (unsigned long int *) ((char *) memid + chunk->used + MAPMEMORY_ALIGN - sizeof(unsigned long int));
+	chunk->used += blocksize;
+	*memid = MAP_ID;
+	return (void *) (memid + 1);
+} //end of the function GetMapMemory
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void *GetClearedMapMemory(unsigned long size)
+{
+	void *ptr;
+
+	ptr = GetMapMemory(size);
+	Com_Memset(ptr, 0, size);
+	return ptr;
+} //end of the function GetClearedMapMemory
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static memorypool_t *MemoryPoolForSize(unsigned long size)
+{
+	memorypool_t *pool;
+	int hash;
+
+	hash = (size / sizeof(void *)) & (MEMORYPOOL_HASHSIZE - 1);
+	for (pool = memorypools[hash]; pool; pool = pool->next)
+	{
+		if (pool->size == size) return pool;
+	} //end for
+	pool = (memorypool_t *) GetMapMemory(sizeof(memorypool_t));
+	pool->size = size;
+	pool->freeblocks = NULL;
+	pool->next = memorypools[hash];
+	memorypools[hash] = pool;
+	return pool;
+} //end of the function MemoryPoolForSize
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void *GetPoolMemory(unsigned long size)
+{
+	memorypool_t *pool;
+	void *ptr;
+
+	if (size < sizeof(void *)) size = sizeof(void *);
+	pool = MemoryPoolForSize(size);
+	if (pool->freeblocks)
+	{
+		ptr = pool->freeblocks;
+		pool->freeblocks = *(void **) ptr;
+		return ptr;
+	} //end if
+	return GetMapMemory(size);
+} //end of the function GetPoolMemory
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void FreePoolMemory(void *ptr, unsigned long size)
+{
+	memorypool_t *pool;
+
+	if (size < sizeof(void *)) size = sizeof(void *);
+	pool = MemoryPoolForSize(size);
+	*(void **) ptr = pool->freeblocks;
+	pool->freeblocks = ptr;
+} //end of the function FreePoolMemory
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void FreeMapMemory(void)
+{
+	mapmemorychunk_t *chunk, *next;
+
+	for (chunk = mapmemory; chunk; chunk = next)
+	{
+		next = chunk->next;
+		botimport.FreeMemory(chunk);
+	} //end for
+	mapmemory = NULL;
+	Com_Memset(memorypools, 0, sizeof(memorypools));
+	nummapmemorychunks = 0;
+	mapmemorysize = 0;
+} //end of the function FreeMapMemory
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int MapMemorySize(void)
+{
+	return (int) mapmemorysize;
+} //end of the function MapMemorySize
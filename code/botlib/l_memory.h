@@ -64,6 +64,18 @@ void *GetClearedHunkMemory(unsigned long size);
 
 //free the given memory block
 void FreeMemory(void *ptr);
+//allocate a memory block that lives until FreeMapMemory is called
+void *GetMapMemory(unsigned long size);
+//allocate a map memory block of the given size and clear it
+void *GetClearedMapMemory(unsigned long size);
+//allocate a map memory block from the pool of blocks with the given size
+void *GetPoolMemory(unsigned long size);
+//return a block to the pool of blocks with the given size
+void FreePoolMemory(void *ptr, unsigned long size);
+//free all map memory including the pools
+void FreeMapMemory(void);
+//returns the number of bytes reserved for map memory
+int MapMemorySize(void);
 //returns the amount available memory
 int AvailableMemory(void);
 //prints the total used memory size
@@ -60,6 +60,7 @@ typedef enum {qfalse, qtrue}	qboolean;
 #include "l_script.h"
 #include "l_precomp.h"
 #include "l_log.h"
+#include "l_crc.h"
 #endif //BOTLIB
 
 #ifdef MEQCC
@@ -119,6 +120,165 @@ token_t *freetokens;					//free tokens from the heap
 //list with global defines added to every source loaded
 define_t *globaldefines;
 
+//the tokens a source file gave, see PC_FindSourceCache
+#define PC_SOURCECACHE_SIZE		(2 * 1024 * 1024)
+
+typedef struct pc_cachetoken_s
+{
+	int string;							//offset in strings
+	int type;
+	int subtype;
+	unsigned long int intvalue;
+	float floatvalue;
+	int line;
+	int linescrossed;
+} pc_cachetoken_t;
+
+//a script file the tokens came from, the source file itself first
+typedef struct pc_cachefile_s
+{
+	char filename[MAX_QPATH];
+	int length;
+	unsigned short crc;
+} pc_cachefile_t;
+
+typedef struct pc_cache_s
+{
+	char basefolder[MAX_QPATH];
+	unsigned short definescrc;			//of the global defines
+	int numdefines;
+	pc_cachefile_t *files;
+	int numfiles, maxfiles;
+	pc_cachetoken_t *tokens;
+	int numtokens, maxtokens;
+	char *strings;
+	int stringsize, maxstringsize;
+	int valid;							//recording, no errors so far
+	int complete;						//recording, the end was read
+	int users;							//sources reading it
+	struct pc_cache_s *next;
+} pc_cache_t;
+
+pc_cache_t *sourcecache;
+int sourcecachesize;
+
+extern char basefolder[MAX_QPATH];			//l_script.c
+
+//============================================================================
+// room for one more in array, which has num used of max
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void *PC_CacheGrow(void *array, int num, int *max, int size, int extra)
+{
+	void *newarray;
+
+	if (num + extra <= *max) return array;
+	if (!*max) *max = 64;
+	while(*max < num + extra) *max *= 2;
+	newarray = GetMemory(*max * size);
+	if (array)
+	{
+		Com_Memcpy(newarray, array, num * size);
+		FreeMemory(array);
+	} //end if
+	return newarray;
+} //end of the function PC_CacheGrow
+//============================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static int PC_CacheSize(pc_cache_t *cache)
+{
+	return sizeof(pc_cache_t) + cache->maxfiles * sizeof(pc_cachefile_t) +
+		cache->maxtokens * sizeof(pc_cachetoken_t) + cache->maxstringsize;
+} //end of the function PC_CacheSize
+//============================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_FreeCache(pc_cache_t *cache)
+{
+	if (cache->files) FreeMemory(cache->files);
+	if (cache->tokens) FreeMemory(cache->tokens);
+	if (cache->strings) FreeMemory(cache->strings);
+	FreeMemory(cache);
+} //end of the function PC_FreeCache
+//============================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_CacheAddFile(pc_cache_t *cache, script_t *script)
+{
+	pc_cachefile_t *file;
+
+	cache->files = PC_CacheGrow(cache->files, cache->numfiles, &cache->maxfiles, sizeof(pc_cachefile_t), 1);
+	file = &cache->files[cache->numfiles++];
+	Q_strncpyz(file->filename, script->filename, sizeof(file->filename));
+	file->length = script->length;
+	file->crc = CRC_ProcessString((unsigned char *) script->buffer, script->length);
+} //end of the function PC_CacheAddFile
+//============================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_CacheRecordToken(pc_cache_t *cache, token_t *token)
+{
+	pc_cachetoken_t *t;
+	int len;
+
+	len = strlen(token->string) + 1;
+	cache->tokens = PC_CacheGrow(cache->tokens, cache->numtokens, &cache->maxtokens, sizeof(pc_cachetoken_t), 1);
+	cache->strings = PC_CacheGrow(cache->strings, cache->stringsize, &cache->maxstringsize, 1, len);
+	//
+	t = &cache->tokens[cache->numtokens++];
+	t->string = cache->stringsize;
+	Com_Memcpy(cache->strings + cache->stringsize, token->string, len);
+	cache->stringsize += len;
+	t->type = token->type;
+	t->subtype = token->subtype;
+	t->intvalue = token->intvalue;
+	t->floatvalue = token->floatvalue;
+	t->line = token->line;
+	t->linescrossed = token->linescrossed;
+} //end of the function PC_CacheRecordToken
+//============================================================================
+// the reader put back the token it read last
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_CacheUnrecordToken(pc_cache_t *cache, token_t *token)
+{
+	pc_cachetoken_t *t;
+
+	if (!cache->numtokens)
+	{
+		cache->valid = qfalse;
+		return;
+	} //end if
+	t = &cache->tokens[cache->numtokens - 1];
+	if (strcmp(cache->strings + t->string, token->string))
+	{
+		//something else than what was read, replaying wouldn't be the same
+		cache->valid = qfalse;
+		return;
+	} //end if
+	cache->numtokens--;
+	cache->stringsize = t->string;
+} //end of the function PC_CacheUnrecordToken
+
 //============================================================================
 //
 // Parameter:				-
@@ -133,8 +293,13 @@ void QDECL SourceError(source_t *source, char *str, ...)
 	va_start(ap, str);
 	Q_vsnprintf(text, sizeof(text), str, ap);
 	va_end(ap);
+	//don't cache what gave an error
+	if (source->record) source->record->valid = qfalse;
 #ifdef BOTLIB
-	botimport.Print(PRT_ERROR, "file %s, line %d: %s\n", source->scriptstack->filename, source->scriptstack->line, text);
+	if (!source->scriptstack)
+		botimport.Print(PRT_ERROR, "file %s, line %d: %s\n", source->filename, source->token.line, text);
+	else
+		botimport.Print(PRT_ERROR, "file %s, line %d: %s\n", source->scriptstack->filename, source->scriptstack->line, text);
 #endif	//BOTLIB
 #ifdef MEQCC
 	printf("error: file %s, line %d: %s\n", source->scriptstack->filename, source->scriptstack->line, text);
@@ -157,8 +322,13 @@ void QDECL SourceWarning(source_t *source, char *str, ...)
 	va_start(ap, str);
 	Q_vsnprintf(text, sizeof(text), str, ap);
 	va_end(ap);
+	//replaying it would skip the warning
+	if (source->record) source->record->valid = qfalse;
 #ifdef BOTLIB
-	botimport.Print(PRT_WARNING, "file %s, line %d: %s\n", source->scriptstack->filename, source->scriptstack->line, text);
+	if (!source->scriptstack)
+		botimport.Print(PRT_WARNING, "file %s, line %d: %s\n", source->filename, source->token.line, text);
+	else
+		botimport.Print(PRT_WARNING, "file %s, line %d: %s\n", source->scriptstack->filename, source->scriptstack->line, text);
 #endif //BOTLIB
 #ifdef MEQCC
 	printf("warning: file %s, line %d: %s\n", source->scriptstack->filename, source->scriptstack->line, text);
@@ -348,6 +518,8 @@ int PC_UnreadSourceToken(source_t *source, token_t *token)
 {
 	token_t *t;
 
+	//put back by the reader of the source, not while expanding
+	if (source->record && !source->readdepth) PC_CacheUnrecordToken(source->record, token);
 	t = PC_CopyToken(token);
 	t->next = source->tokens;
 	source->tokens = t;
@@ -468,9 +640,9 @@ int PC_StringizeTokens(token_t *tokens, token_t *token)
 	strcat(token->string, "\"");
 	for (t = tokens; t; t = t->next)
 	{
-		strncat(token->string, t->string, MAX_TOKEN - strlen(token->string) - 1);
+		Q_strcat(token->string, MAX_TOKEN, t->string);
 	} //end for
-	strncat(token->string, "\"", MAX_TOKEN - strlen(token->string) - 1);
+	Q_strcat(token->string, MAX_TOKEN, "\"");
 	return qtrue;
 } //end of the function PC_StringizeTokens
 //============================================================================
@@ -1049,6 +1221,7 @@ int PC_Directive_include(source_t *source)
 #endif //SCREWUP
 	} //end if
 	PC_PushScript(source, script);
+	if (source->record) PC_CacheAddFile(source->record, script);
 	return qtrue;
 } //end of the function PC_Directive_include
 //============================================================================
@@ -2703,7 +2876,7 @@ int QuakeCMacro(source_t *source)
 // Returns:					-
 // Changes Globals:		-
 //============================================================================
-int PC_ReadToken(source_t *source, token_t *token)
+static int PC_ReadPrecompiledToken(source_t *source, token_t *token)
 {
 	define_t *define;
 
@@ -2779,6 +2952,51 @@ int PC_ReadToken(source_t *source, token_t *token)
 		//found a token
 		return qtrue;
 	} //end while
+} //end of the function PC_ReadPrecompiledToken
+//============================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+int PC_ReadToken(source_t *source, token_t *token)
+{
+	pc_cachetoken_t *t;
+	int ret;
+
+	if (source->replay)
+	{
+		//first the tokens that were read back
+		if (source->tokens) ret = PC_ReadSourceToken(source, token);
+		else
+		{
+			Com_Memset(token, 0, sizeof(token_t));
+			if (source->replaytoken >= source->replay->numtokens) return qfalse;
+			t = &source->replay->tokens[source->replaytoken++];
+			strcpy(token->string, source->replay->strings + t->string);
+			token->type = t->type;
+			token->subtype = t->subtype;
+			token->intvalue = t->intvalue;
+			token->floatvalue = t->floatvalue;
+			token->line = t->line;
+			token->linescrossed = t->linescrossed;
+			ret = qtrue;
+		} //end else
+		if (ret) Com_Memcpy(&source->token, token, sizeof(token_t));
+		return ret;
+	} //end if
+	//only the tokens handed out by the outermost read go into the cache
+	source->readdepth++;
+	ret = PC_ReadPrecompiledToken(source, token);
+	source->readdepth--;
+	if (source->record && !source->readdepth && source->record->valid)
+	{
+		if (ret) PC_CacheRecordToken(source->record, token);
+		//not a script error, which doesn't go through SourceError
+		else if (EndOfScript(source->scriptstack)) source->record->complete = qtrue;
+		else source->record->valid = qfalse;
+	} //end if
+	return ret;
 } //end of the function PC_ReadToken
 //============================================================================
 //
@@ -2982,6 +3200,143 @@ void PC_SetPunctuations(source_t *source, punctuation_t *p)
 } //end of the function PC_SetPunctuations
 //============================================================================
 //
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_CRCString(unsigned short *crc, const char *string)
+{
+	do
+	{
+		CRC_ProcessByte(crc, (byte) *string);
+	} while(*string++);
+} //end of the function PC_CRCString
+//============================================================================
+// the global defines are in every source, the tokens depend on them
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static unsigned short PC_GlobalDefinesCRC(int *numdefines)
+{
+	define_t *define;
+	token_t *t;
+	unsigned short crc;
+
+	CRC_Init(&crc);
+	*numdefines = 0;
+	for (define = globaldefines; define; define = define->next)
+	{
+		PC_CRCString(&crc, define->name);
+		for (t = define->parms; t; t = t->next) PC_CRCString(&crc, t->string);
+		CRC_ProcessByte(&crc, 0xff);
+		for (t = define->tokens; t; t = t->next) PC_CRCString(&crc, t->string);
+		CRC_ProcessByte(&crc, 0xff);
+		(*numdefines)++;
+	} //end for
+	return CRC_Value(crc);
+} //end of the function PC_GlobalDefinesCRC
+//============================================================================
+// PC_ReadToken of a source file always gives the same tokens as long as
+// the file, the files it includes and the global defines are the same, so
+// the first time a file is read through the tokens are kept and the next
+// time they are read back from memory, which skips all the tokenizing,
+// directives and define expansion; the bot character, chat, weight and
+// item config files are loaded again for every bot and map
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static pc_cache_t *PC_FindSourceCache(script_t *script)
+{
+	pc_cache_t *cache;
+	script_t *include;
+	unsigned short definescrc;
+	int numdefines, i;
+
+	definescrc = PC_GlobalDefinesCRC(&numdefines);
+	for (cache = sourcecache; cache; cache = cache->next)
+	{
+		if (cache->definescrc != definescrc) continue;
+		if (cache->numdefines != numdefines) continue;
+		if (Q_stricmp(cache->basefolder, basefolder)) continue;
+		if (Q_stricmp(cache->files[0].filename, script->filename)) continue;
+		if (cache->files[0].length != script->length) continue;
+		if (cache->files[0].crc != CRC_ProcessString((unsigned char *) script->buffer, script->length)) continue;
+		//the included files have to be the same as well
+		for (i = 1; i < cache->numfiles; i++)
+		{
+			include = LoadScriptFile(cache->files[i].filename);
+			if (!include) break;
+			if (include->length != cache->files[i].length ||
+				CRC_ProcessString((unsigned char *) include->buffer, include->length) != cache->files[i].crc)
+			{
+				FreeScript(include);
+				break;
+			} //end if
+			FreeScript(include);
+		} //end for
+		if (i < cache->numfiles) continue;
+		return cache;
+	} //end for
+	return NULL;
+} //end of the function PC_FindSourceCache
+//============================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_StoreSourceCache(source_t *source)
+{
+	pc_cache_t *cache, **prev, *oldest;
+
+	if (source->replay) source->replay->users--;
+	cache = source->record;
+	if (!cache) return;
+	source->record = NULL;
+	//only what was read through without errors
+	if (!cache->valid || !cache->complete)
+	{
+		PC_FreeCache(cache);
+		return;
+	} //end if
+	//replaces an older version of the same file
+	for (prev = &sourcecache; *prev; )
+	{
+		if ((*prev)->users == 0 && !Q_stricmp((*prev)->files[0].filename, cache->files[0].filename))
+		{
+			oldest = *prev;
+			*prev = oldest->next;
+			sourcecachesize -= PC_CacheSize(oldest);
+			PC_FreeCache(oldest);
+			continue;
+		} //end if
+		prev = &(*prev)->next;
+	} //end for
+	cache->next = sourcecache;
+	sourcecache = cache;
+	sourcecachesize += PC_CacheSize(cache);
+	//drop the least recently stored ones not being read
+	while(sourcecachesize > PC_SOURCECACHE_SIZE)
+	{
+		oldest = NULL;
+		for (prev = &sourcecache; *prev; prev = &(*prev)->next)
+		{
+			if ((*prev)->users == 0 && *prev != cache) oldest = *prev;
+		} //end for
+		if (!oldest) break;
+		for (prev = &sourcecache; *prev != oldest; prev = &(*prev)->next)
+			;
+		*prev = oldest->next;
+		sourcecachesize -= PC_CacheSize(oldest);
+		PC_FreeCache(oldest);
+	} //end while
+} //end of the function PC_StoreSourceCache
+//============================================================================
+//
 // Parameter:			-
 // Returns:				-
 // Changes Globals:		-
@@ -2990,6 +3345,7 @@ source_t *LoadSourceFile(const char *filename)
 {
 	source_t *source;
 	script_t *script;
+	pc_cache_t *cache;
 
 	PC_InitTokenHeap();
 
@@ -3002,7 +3358,6 @@ source_t *LoadSourceFile(const char *filename)
 	Com_Memset(source, 0, sizeof(source_t));
 
 	Q_strncpyz(source->filename, filename, sizeof(source->filename));
-	source->scriptstack = script;
 	source->tokens = NULL;
 	source->defines = NULL;
 	source->indentstack = NULL;
@@ -3011,6 +3366,26 @@ source_t *LoadSourceFile(const char *filename)
 #if DEFINEHASHING
 	source->definehash = GetClearedMemory(DEFINEHASHSIZE * sizeof(define_t *));
 #endif //DEFINEHASHING
+
+	cache = PC_FindSourceCache(script);
+	if (cache)
+	{
+		//read the tokens from the cache, no script or defines needed
+		FreeScript(script);
+		cache->users++;
+		source->replay = cache;
+		source->replaytoken = 0;
+		return source;
+	} //end if
+	//keep the tokens for the next time
+	cache = (pc_cache_t *) GetClearedMemory(sizeof(pc_cache_t));
+	Q_strncpyz(cache->basefolder, basefolder, sizeof(cache->basefolder));
+	cache->definescrc = PC_GlobalDefinesCRC(&cache->numdefines);
+	cache->valid = qtrue;
+	PC_CacheAddFile(cache, script);
+	source->record = cache;
+
+	source->scriptstack = script;
 	PC_AddGlobalDefinesToSource(source);
 	return source;
 } //end of the function LoadSourceFile
@@ -3062,6 +3437,7 @@ void FreeSource(source_t *source)
 	int i;
 
 	//PC_PrintDefineHashTable(source->definehash);
+	PC_StoreSourceCache(source);
 	//free all the scripts
 	while(source->scriptstack)
 	{
@@ -3199,7 +3575,7 @@ int PC_SourceFileAndLine(int handle, char *filename, int *line)
 	if (sourceFiles[handle]->scriptstack)
 		*line = sourceFiles[handle]->scriptstack->line;
 	else
-		*line = 0;
+		*line = sourceFiles[handle]->token.line;
 	return qtrue;
 } //end of the function PC_SourceFileAndLine
 //============================================================================
@@ -3227,7 +3603,7 @@ void PC_CheckOpenSourceHandles(void)
 		if (sourceFiles[i])
 		{
 #ifdef BOTLIB
-			botimport.Print(PRT_ERROR, "file %s still open in precompiler\n", sourceFiles[i]->scriptstack->filename);
+			botimport.Print(PRT_ERROR, "file %s still open in precompiler\n", sourceFiles[i]->filename);
 #endif	//BOTLIB
 		} //end if
 	} //end for
@@ -100,6 +100,10 @@ typedef struct source_s
 	indent_t *indentstack;					//stack with indents
 	int skip;								// > 0 if skipping conditional code
 	token_t token;							//last read token
+	int readdepth;							//PC_ReadToken calls in progress
+	struct pc_cache_s *record;				//the tokens read so far, for the cache
+	struct pc_cache_s *replay;				//cached tokens read instead of the scripts
+	int replaytoken;						//next token in replay
 } source_t;
 
 
@@ -23,10 +23,29 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "client.h"
 #include "snd_local.h"
 
+/*
+The renderer reads a frame back while the next ones are drawn and hands it
+over in CL_AVIVideoFrameCaptured, which copies it into a queue of
+cl_aviQueue frames. An encoder thread turns those into BGR, NV12 or JPEG
+and writes the chunk, so the client only waits on it once the queue is
+full. Audio is still written by the client, both take afd.lock around the
+file.
+
+With cl_aviPipe set there is no AVI, frames go top down and unpadded to
+the stdin of the command, which does whatever encoding it likes.
+*/
+
 #define INDEX_FILE_EXTENSION ".index.dat"
 
 #define MAX_RIFF_CHUNKS 16
 
+#define MAX_AVI_QUEUE 8
+
+// chunk header, its padding and its index entry
+#define AVI_CHUNK_OVERHEAD ( 8 + 2 + 16 )
+
+#define PCM_BUFFER_SIZE 44100
+
 typedef struct audioFormat_s
 {
   int rate;
@@ -56,6 +75,11 @@ typedef struct aviFileData_s
   int           numVideoFrames;
   int           maxRecordSize;
   qboolean      motionJpeg;
+  int           jpegQuality;
+  qboolean      nv12;
+  int           frameSize;          // of an encoded frame at most
+
+  FILE          *pipe;
 
   qboolean      audio;
   audioFormat_t a;
@@ -65,10 +89,28 @@ typedef struct aviFileData_s
   int           chunkStackTop;
 
   byte          *cBuffer, *eBuffer;
+
+  // frames asked for and handed back by the renderer
+  int           framesTaken;
+  int           framesCaptured;
+
+  sysThread_t     *encoder;
+  sysMutex_t      *lock;
+  sysSemaphore_t  *room;
+  sysSemaphore_t  *work;
+  byte          *queue[ MAX_AVI_QUEUE ];
+  int           queuePadding[ MAX_AVI_QUEUE ];
+  int           queueSize;
+  int           queueHead, queueTail;
+
+  qboolean      writeFailed;
 } aviFileData_t;
 
 static aviFileData_t afd;
 
+// capture lines may be padded to this, and the buffer start aligned to it
+#define MAX_PACK_LEN 16
+
 #define MAX_AVI_BUFFER 2048
 
 static byte buffer[ MAX_AVI_BUFFER ];
@@ -85,6 +127,47 @@ static ID_INLINE void SafeFS_Write( const void *buffer, int len, fileHandle_t f
     Com_Error( ERR_DROP, "Failed to write AVI file" );
 }
 
+/*
+===============
+CL_AVIWrite
+
+For the chunks, which may be written by the encoder thread, so a failure
+is only noted for the client to raise
+===============
+*/
+static qboolean CL_AVIWrite( const void *buffer, int len, fileHandle_t f )
+{
+  if( FS_Write( buffer, len, f ) < len )
+  {
+    afd.writeFailed = qtrue;
+    return qfalse;
+  }
+
+  return qtrue;
+}
+
+/*
+===============
+CL_LockAVI
+===============
+*/
+static ID_INLINE void CL_LockAVI( void )
+{
+  if( afd.lock )
+    Sys_LockMutex( afd.lock );
+}
+
+/*
+===============
+CL_UnlockAVI
+===============
+*/
+static ID_INLINE void CL_UnlockAVI( void )
+{
+  if( afd.lock )
+    Sys_UnlockMutex( afd.lock );
+}
+
 /*
 ===============
 WRITE_STRING
@@ -211,6 +294,8 @@ void CL_WriteAVIHeader( void )
 
           if( afd.motionJpeg )
             WRITE_STRING( "MJPG" );
+          else if( afd.nv12 )
+            WRITE_STRING( "NV12" );
           else
             WRITE_4BYTES( 0 );                  // BI_RGB
 
@@ -237,7 +322,11 @@ void CL_WriteAVIHeader( void )
           WRITE_4BYTES( afd.width );            //biWidth
           WRITE_4BYTES( afd.height );           //biHeight
           WRITE_2BYTES( 1 );                    //biPlanes
-          WRITE_2BYTES( 24 );                   //biBitCount
+
+          if( afd.nv12 )                        //biBitCount
+            WRITE_2BYTES( 12 );
+          else
+            WRITE_2BYTES( 24 );
 
           if( afd.motionJpeg )                  //biCompression
           {
@@ -245,6 +334,12 @@ void CL_WriteAVIHeader( void )
             WRITE_4BYTES( afd.width *
                 afd.height );                   //biSizeImage
           }
+          else if( afd.nv12 )
+          {
+            WRITE_STRING( "NV12" );
+            WRITE_4BYTES( afd.width *
+                afd.height * 3 / 2 );           //biSizeImage
+          }
           else
           {
             WRITE_4BYTES( 0 );                  // BI_RGB
@@ -313,6 +408,371 @@ void CL_WriteAVIHeader( void )
   }
 }
 
+/*
+===============
+CL_OpenAVIPipe
+
+Starts cl_aviPipe with %w %h %r %p and %o filled in
+===============
+*/
+static qboolean CL_OpenAVIPipe( const char *fileName )
+{
+  char        command[ MAX_STRING_CHARS ];
+  char        output[ MAX_OSPATH ];
+  const char  *s;
+  int         len = 0;
+
+  Q_strncpyz( output, FS_BuildOSPath( Cvar_VariableString( "fs_homepath" ),
+        FS_GetCurrentGameDir( ), fileName ), sizeof( output ) );
+  FS_CreatePath( output );
+  COM_StripExtension( output, output, sizeof( output ) );
+
+  for( s = cl_aviPipe->string; *s && len < sizeof( command ) - 1; s++ )
+  {
+    const char *token = NULL;
+
+    if( *s == '%' && s[ 1 ] )
+    {
+      s++;
+
+      switch( *s )
+      {
+        case 'w': token = va( "%d", afd.width ); break;
+        case 'h': token = va( "%d", afd.height ); break;
+        case 'r': token = va( "%d", afd.frameRate ); break;
+        case 'o': token = output; break;
+        case 'p':
+          if( afd.motionJpeg )
+            token = "mjpeg";
+          else if( afd.nv12 )
+            token = "nv12";
+          else
+            token = "rgb24";
+          break;
+        default: break;
+      }
+    }
+
+    if( token )
+    {
+      Q_strncpyz( command + len, token, sizeof( command ) - len );
+      len += strlen( command + len );
+    }
+    else
+      command[ len++ ] = *s;
+  }
+  command[ len ] = '\0';
+
+  Com_Printf( "Piping video to: %s\n", command );
+
+  if( !( afd.pipe = Sys_OpenPipe( command ) ) )
+  {
+    Com_Printf( S_COLOR_RED "ERROR: couldn't run cl_aviPipe\n" );
+    return qfalse;
+  }
+
+  return qtrue;
+}
+
+/*
+===============
+CL_FrameToBGR
+
+Bottom up rows padded to 4 bytes, as a raw AVI has them
+===============
+*/
+static int CL_FrameToBGR( const byte *pixels, int padding, byte *out )
+{
+  int         linelen = afd.width * 3;
+  int         avipadlen = PAD( linelen, AVI_LINE_PADDING ) - linelen;
+  const byte  *src = pixels, *lineend;
+  byte        *dest = out;
+  int         y;
+
+  for( y = 0; y < afd.height; y++ )
+  {
+    lineend = src + linelen;
+    while( src < lineend )
+    {
+      *dest++ = src[ 2 ];
+      *dest++ = src[ 1 ];
+      *dest++ = src[ 0 ];
+      src += 3;
+    }
+
+    Com_Memset( dest, 0, avipadlen );
+    dest += avipadlen;
+
+    src += padding;
+  }
+
+  return dest - out;
+}
+
+/*
+===============
+CL_FrameToRGB
+
+Top down rows without padding, as rawvideo rgb24 has them
+===============
+*/
+static int CL_FrameToRGB( const byte *pixels, int padding, byte *out )
+{
+  int linelen = afd.width * 3;
+  int stride = linelen + padding;
+  int y;
+
+  for( y = 0; y < afd.height; y++ )
+    Com_Memcpy( out + y * linelen, pixels + ( afd.height - 1 - y ) * stride, linelen );
+
+  return linelen * afd.height;
+}
+
+/*
+===============
+CL_FrameToNV12
+
+Top down, a full Y plane and then interleaved U and V a quarter the size,
+BT.601 limited range with each chroma sample the average of a 2x2 block
+===============
+*/
+static int CL_FrameToNV12( const byte *pixels, int padding, byte *out )
+{
+  int         stride = afd.width * 3 + padding;
+  byte        *lumaTop, *lumaBottom, *chroma;
+  const byte  *top, *bottom;
+  int         x, y, r, g, b;
+
+  chroma = out + afd.width * afd.height;
+
+  for( y = 0; y < afd.height; y += 2 )
+  {
+    top = pixels + ( afd.height - 1 - y ) * stride;
+    bottom = top - stride;
+    lumaTop = out + y * afd.width;
+    lumaBottom = lumaTop + afd.width;
+
+    for( x = 0; x < afd.width; x += 2 )
+    {
+      *lumaTop++ = ( ( 66 * top[ 0 ] + 129 * top[ 1 ] + 25 * top[ 2 ] + 128 ) >> 8 ) + 16;
+      *lumaTop++ = ( ( 66 * top[ 3 ] + 129 * top[ 4 ] + 25 * top[ 5 ] + 128 ) >> 8 ) + 16;
+      *lumaBottom++ = ( ( 66 * bottom[ 0 ] + 129 * bottom[ 1 ] + 25 * bottom[ 2 ] + 128 ) >> 8 ) + 16;
+      *lumaBottom++ = ( ( 66 * bottom[ 3 ] + 129 * bottom[ 4 ] + 25 * bottom[ 5 ] + 128 ) >> 8 ) + 16;
+
+      r = ( top[ 0 ] + top[ 3 ] + bottom[ 0 ] + bottom[ 3 ] + 2 ) >> 2;
+      g = ( top[ 1 ] + top[ 4 ] + bottom[ 1 ] + bottom[ 4 ] + 2 ) >> 2;
+      b = ( top[ 2 ] + top[ 5 ] + bottom[ 2 ] + bottom[ 5 ] + 2 ) >> 2;
+
+      *chroma++ = ( ( -38 * r - 74 * g + 112 * b + 128 ) >> 8 ) + 128;
+      *chroma++ = ( ( 112 * r - 94 * g - 18 * b + 128 ) >> 8 ) + 128;
+
+      top += 6;
+      bottom += 6;
+    }
+  }
+
+  return afd.width * afd.height * 3 / 2;
+}
+
+/*
+===============
+CL_WriteAVIVideoFrame
+===============
+*/
+static void CL_WriteAVIVideoFrame( const byte *imageBuffer, int size )
+{
+  int   chunkOffset;
+  int   chunkSize = 8 + size;
+  int   paddingSize = PADLEN(size, 2);
+  byte  padding[ 4 ] = { 0 };
+
+  if( afd.pipe )
+  {
+    CL_LockAVI( );
+    if( !afd.writeFailed && fwrite( imageBuffer, 1, size, afd.pipe ) < size )
+      afd.writeFailed = qtrue;
+
+    afd.numVideoFrames++;
+    CL_UnlockAVI( );
+    return;
+  }
+
+  CL_LockAVI( );
+
+  if( afd.writeFailed )
+  {
+    CL_UnlockAVI( );
+    return;
+  }
+
+  chunkOffset = afd.fileSize - afd.moviOffset - 8;
+
+  bufIndex = 0;
+  WRITE_STRING( "00dc" );
+  WRITE_4BYTES( size );
+
+  if( !CL_AVIWrite( buffer, 8, afd.f ) ||
+      !CL_AVIWrite( imageBuffer, size, afd.f ) ||
+      !CL_AVIWrite( padding, paddingSize, afd.f ) )
+  {
+    CL_UnlockAVI( );
+    return;
+  }
+  afd.fileSize += ( chunkSize + paddingSize );
+
+  afd.numVideoFrames++;
+  afd.moviSize += ( chunkSize + paddingSize );
+
+  if( size > afd.maxRecordSize )
+    afd.maxRecordSize = size;
+
+  // Index
+  bufIndex = 0;
+  WRITE_STRING( "00dc" );           //dwIdentifier
+  WRITE_4BYTES( 0x00000010 );       //dwFlags (all frames are KeyFrames)
+  WRITE_4BYTES( chunkOffset );      //dwOffset
+  WRITE_4BYTES( size );             //dwLength
+  CL_AVIWrite( buffer, 16, afd.idxF );
+
+  afd.numIndices++;
+
+  CL_UnlockAVI( );
+}
+
+/*
+===============
+CL_EncodeAVIVideoFrame
+===============
+*/
+static void CL_EncodeAVIVideoFrame( const byte *pixels, int padding )
+{
+  int size;
+
+  if( afd.motionJpeg )
+  {
+    size = re.SaveJPGToBuffer( afd.eBuffer, afd.width * 3 * afd.height,
+        afd.jpegQuality, afd.width, afd.height, (byte *)pixels, padding );
+  }
+  else if( afd.nv12 )
+    size = CL_FrameToNV12( pixels, padding, afd.eBuffer );
+  else if( afd.pipe )
+    size = CL_FrameToRGB( pixels, padding, afd.eBuffer );
+  else
+    size = CL_FrameToBGR( pixels, padding, afd.eBuffer );
+
+  CL_WriteAVIVideoFrame( afd.eBuffer, size );
+}
+
+/*
+===============
+CL_AVIEncoderThread
+
+Every queued frame posts work once, and CL_StopAVIEncoder once more after
+the last, which finds the queue empty
+===============
+*/
+static void CL_AVIEncoderThread( void *arg )
+{
+  int slot;
+
+  for( ;; )
+  {
+    Sys_WaitSemaphore( afd.work );
+
+    Sys_LockMutex( afd.lock );
+    if( afd.queueTail == afd.queueHead )
+    {
+      Sys_UnlockMutex( afd.lock );
+      return;
+    }
+    slot = afd.queueTail % afd.queueSize;
+    Sys_UnlockMutex( afd.lock );
+
+    CL_EncodeAVIVideoFrame( afd.queue[ slot ], afd.queuePadding[ slot ] );
+
+    Sys_LockMutex( afd.lock );
+    afd.queueTail++;
+    Sys_UnlockMutex( afd.lock );
+
+    Sys_PostSemaphore( afd.room );
+  }
+}
+
+/*
+===============
+CL_StopAVIEncoder
+===============
+*/
+static void CL_StopAVIEncoder( void )
+{
+  int i;
+
+  if( afd.encoder )
+  {
+    Sys_PostSemaphore( afd.work );
+    Sys_JoinThread( afd.encoder );
+    afd.encoder = NULL;
+  }
+
+  if( afd.room )
+    Sys_DestroySemaphore( afd.room );
+  if( afd.work )
+    Sys_DestroySemaphore( afd.work );
+
+  afd.room = afd.work = NULL;
+
+  for( i = 0; i < MAX_AVI_QUEUE; i++ )
+  {
+    free( afd.queue[ i ] );
+    afd.queue[ i ] = NULL;
+  }
+  afd.queueSize = 0;
+}
+
+/*
+===============
+CL_StartAVIEncoder
+
+Falls back to encoding as the frames come in if anything fails
+===============
+*/
+static void CL_StartAVIEncoder( void )
+{
+  int i, size;
+
+  afd.queueSize = Com_Clamp( 0, MAX_AVI_QUEUE, cl_aviQueue->integer );
+  if( !afd.queueSize || !afd.lock )
+  {
+    afd.queueSize = 0;
+    return;
+  }
+
+  size = ( afd.width * 3 + MAX_PACK_LEN - 1 ) * afd.height;
+
+  for( i = 0; i < afd.queueSize; i++ )
+  {
+    if( !( afd.queue[ i ] = malloc( size ) ) )
+      break;
+  }
+
+  afd.room = Sys_CreateSemaphore( );
+  afd.work = Sys_CreateSemaphore( );
+
+  if( i == afd.queueSize && afd.room && afd.work )
+  {
+    for( i = 0; i < afd.queueSize; i++ )
+      Sys_PostSemaphore( afd.room );
+
+    afd.encoder = Sys_CreateThread( CL_AVIEncoderThread, NULL );
+  }
+
+  if( !afd.encoder )
+  {
+    Com_Printf( S_COLOR_YELLOW "WARNING: couldn't start the video encoder thread\n" );
+    CL_StopAVIEncoder( );
+  }
+}
+
 /*
 ===============
 CL_OpenAVIForWriting
@@ -335,16 +795,6 @@ qboolean CL_OpenAVIForWriting( const char *fileName )
     return qfalse;
   }
 
-  if( ( afd.f = FS_FOpenFileWrite( fileName ) ) <= 0 )
-    return qfalse;
-
-  if( ( afd.idxF = FS_FOpenFileWrite(
-          va( "%s" INDEX_FILE_EXTENSION, fileName ) ) ) <= 0 )
-  {
-    FS_FCloseFile( afd.f );
-    return qfalse;
-  }
-
   Q_strncpyz( afd.fileName, fileName, MAX_QPATH );
 
   afd.frameRate = cl_aviFrameRate->integer;
@@ -357,10 +807,47 @@ qboolean CL_OpenAVIForWriting( const char *fileName )
   else
     afd.motionJpeg = qfalse;
 
+  afd.jpegQuality = Cvar_VariableIntegerValue( "r_aviMotionJpegQuality" );
+
+  if( !afd.motionJpeg && cl_aviNV12->integer )
+  {
+    if( ( afd.width & 1 ) || ( afd.height & 1 ) )
+    {
+      Com_Printf( S_COLOR_YELLOW "WARNING: NV12 needs an even width and "
+          "height, recording RGB\n" );
+    }
+    else
+      afd.nv12 = qtrue;
+  }
+
+  if( afd.motionJpeg )
+    afd.frameSize = afd.width * 3 * afd.height;
+  else if( afd.nv12 )
+    afd.frameSize = afd.width * afd.height * 3 / 2;
+  else
+    afd.frameSize = PAD( afd.width * 3, AVI_LINE_PADDING ) * afd.height;
+
+  if( *cl_aviPipe->string )
+  {
+    if( !CL_OpenAVIPipe( fileName ) )
+      return qfalse;
+  }
+  else
+  {
+    if( ( afd.f = FS_FOpenFileWrite( fileName ) ) <= 0 )
+      return qfalse;
+
+    if( ( afd.idxF = FS_FOpenFileWrite(
+            va( "%s" INDEX_FILE_EXTENSION, fileName ) ) ) <= 0 )
+    {
+      FS_FCloseFile( afd.f );
+      return qfalse;
+    }
+  }
+
   // Buffers only need to store RGB pixels.
   // Allocate a bit more space for the capture buffer to account for possible
   // padding at the end of pixel lines, and padding for alignment
-  #define MAX_PACK_LEN 16
   afd.cBuffer = Z_Malloc((afd.width * 3 + MAX_PACK_LEN - 1) * afd.height + MAX_PACK_LEN - 1);
   // raw avi files have pixel lines start on 4-byte boundaries
   afd.eBuffer = Z_Malloc(PAD(afd.width * 3, AVI_LINE_PADDING) * afd.height);
@@ -385,7 +872,12 @@ qboolean CL_OpenAVIForWriting( const char *fileName )
         "of the audio rate, suggest %d\n", suggestRate );
   }
 
-  if( !Cvar_VariableIntegerValue( "s_initsound" ) )
+  if( afd.pipe )
+  {
+    // the command only gets the video
+    afd.audio = qfalse;
+  }
+  else if( !Cvar_VariableIntegerValue( "s_initsound" ) )
   {
     afd.audio = qfalse;
   }
@@ -407,18 +899,26 @@ qboolean CL_OpenAVIForWriting( const char *fileName )
         "with OpenAL. Set s_useOpenAL to 0 for audio capture\n" );
   }
 
-  // This doesn't write a real header, but allocates the
-  // correct amount of space at the beginning of the file
-  CL_WriteAVIHeader( );
+  if( !afd.pipe )
+  {
+    // This doesn't write a real header, but allocates the
+    // correct amount of space at the beginning of the file
+    CL_WriteAVIHeader( );
 
-  SafeFS_Write( buffer, bufIndex, afd.f );
-  afd.fileSize = bufIndex;
+    SafeFS_Write( buffer, bufIndex, afd.f );
+    afd.fileSize = bufIndex;
 
-  bufIndex = 0;
-  START_CHUNK( "idx1" );
-  SafeFS_Write( buffer, bufIndex, afd.idxF );
+    bufIndex = 0;
+    START_CHUNK( "idx1" );
+    SafeFS_Write( buffer, bufIndex, afd.idxF );
+
+    afd.moviSize = 4; // For the "movi"
+  }
+
+  // a renderer with a render thread may hand frames over on it
+  afd.lock = Sys_CreateMutex( );
+  CL_StartAVIEncoder( );
 
-  afd.moviSize = 4; // For the "movi"
   afd.fileOpen = qtrue;
 
   return qtrue;
@@ -433,11 +933,13 @@ static qboolean CL_CheckFileSize( int bytesToAdd )
 {
   unsigned int newFileSize;
 
+  CL_LockAVI( );
   newFileSize =
     afd.fileSize +                // Current file size
     bytesToAdd +                  // What we want to add
     ( afd.numIndices * 16 ) +     // The index
     4;                            // The index size
+  CL_UnlockAVI( );
 
   // I assume all the operating systems
   // we target can handle a 2Gb file
@@ -457,51 +959,41 @@ static qboolean CL_CheckFileSize( int bytesToAdd )
 
 /*
 ===============
-CL_WriteAVIVideoFrame
+CL_AVIVideoFrameCaptured
+
+Called by the renderer with a frame it has read back, possibly from its
+render thread
 ===============
 */
-void CL_WriteAVIVideoFrame( const byte *imageBuffer, int size )
+void CL_AVIVideoFrameCaptured( const byte *pixels, int padding )
 {
-  int   chunkOffset = afd.fileSize - afd.moviOffset - 8;
-  int   chunkSize = 8 + size;
-  int   paddingSize = PADLEN(size, 2);
-  byte  padding[ 4 ] = { 0 };
+  int slot;
+
+  afd.framesCaptured++;
 
   if( !afd.fileOpen )
     return;
 
-  // Chunk header + contents + padding
-  if( CL_CheckFileSize( 8 + size + 2 ) )
+  if( !afd.encoder )
+  {
+    CL_EncodeAVIVideoFrame( pixels, padding );
     return;
+  }
 
-  bufIndex = 0;
-  WRITE_STRING( "00dc" );
-  WRITE_4BYTES( size );
-
-  SafeFS_Write( buffer, 8, afd.f );
-  SafeFS_Write( imageBuffer, size, afd.f );
-  SafeFS_Write( padding, paddingSize, afd.f );
-  afd.fileSize += ( chunkSize + paddingSize );
-
-  afd.numVideoFrames++;
-  afd.moviSize += ( chunkSize + paddingSize );
+  // waits here when the encoder falls behind
+  Sys_WaitSemaphore( afd.room );
 
-  if( size > afd.maxRecordSize )
-    afd.maxRecordSize = size;
+  slot = afd.queueHead % afd.queueSize;
+  Com_Memcpy( afd.queue[ slot ], pixels, ( afd.width * 3 + padding ) * afd.height );
+  afd.queuePadding[ slot ] = padding;
 
-  // Index
-  bufIndex = 0;
-  WRITE_STRING( "00dc" );           //dwIdentifier
-  WRITE_4BYTES( 0x00000010 );       //dwFlags (all frames are KeyFrames)
-  WRITE_4BYTES( chunkOffset );      //dwOffset
-  WRITE_4BYTES( size );             //dwLength
-  SafeFS_Write( buffer, 16, afd.idxF );
+  Sys_LockMutex( afd.lock );
+  afd.queueHead++;
+  Sys_UnlockMutex( afd.lock );
 
-  afd.numIndices++;
+  Sys_PostSemaphore( afd.work );
 }
 
-#define PCM_BUFFER_SIZE 44100
-
 /*
 ===============
 CL_WriteAVIAudioFrame
@@ -518,10 +1010,6 @@ void CL_WriteAVIAudioFrame( const byte *pcmBuffer, int size )
   if( !afd.fileOpen )
     return;
 
-  // Chunk header + contents + padding
-  if( CL_CheckFileSize( 8 + bytesInBuffer + size + 2 ) )
-    return;
-
   if( bytesInBuffer + size > PCM_BUFFER_SIZE )
   {
     Com_Printf( S_COLOR_YELLOW
@@ -536,33 +1024,41 @@ void CL_WriteAVIAudioFrame( const byte *pcmBuffer, int size )
   if( bytesInBuffer >= (int)ceil( (float)afd.a.rate / (float)afd.frameRate ) *
         afd.a.sampleSize )
   {
-    int   chunkOffset = afd.fileSize - afd.moviOffset - 8;
+    int   chunkOffset;
     int   chunkSize = 8 + bytesInBuffer;
     int   paddingSize = PADLEN(bytesInBuffer, 2);
     byte  padding[ 4 ] = { 0 };
 
+    CL_LockAVI( );
+
+    chunkOffset = afd.fileSize - afd.moviOffset - 8;
+
     bufIndex = 0;
     WRITE_STRING( "01wb" );
     WRITE_4BYTES( bytesInBuffer );
 
-    SafeFS_Write( buffer, 8, afd.f );
-    SafeFS_Write( pcmCaptureBuffer, bytesInBuffer, afd.f );
-    SafeFS_Write( padding, paddingSize, afd.f );
-    afd.fileSize += ( chunkSize + paddingSize );
+    if( CL_AVIWrite( buffer, 8, afd.f ) &&
+        CL_AVIWrite( pcmCaptureBuffer, bytesInBuffer, afd.f ) &&
+        CL_AVIWrite( padding, paddingSize, afd.f ) )
+    {
+      afd.fileSize += ( chunkSize + paddingSize );
 
-    afd.numAudioFrames++;
-    afd.moviSize += ( chunkSize + paddingSize );
-    afd.a.totalBytes += bytesInBuffer;
+      afd.numAudioFrames++;
+      afd.moviSize += ( chunkSize + paddingSize );
+      afd.a.totalBytes += bytesInBuffer;
 
-    // Index
-    bufIndex = 0;
-    WRITE_STRING( "01wb" );           //dwIdentifier
-    WRITE_4BYTES( 0 );                //dwFlags
-    WRITE_4BYTES( chunkOffset );      //dwOffset
-    WRITE_4BYTES( bytesInBuffer );    //dwLength
-    SafeFS_Write( buffer, 16, afd.idxF );
+      // Index
+      bufIndex = 0;
+      WRITE_STRING( "01wb" );           //dwIdentifier
+      WRITE_4BYTES( 0 );                //dwFlags
+      WRITE_4BYTES( chunkOffset );      //dwOffset
+      WRITE_4BYTES( bytesInBuffer );    //dwLength
+      CL_AVIWrite( buffer, 16, afd.idxF );
 
-    afd.numIndices++;
+      afd.numIndices++;
+    }
+
+    CL_UnlockAVI( );
 
     bytesInBuffer = 0;
   }
@@ -575,12 +1071,31 @@ CL_TakeVideoFrame
 */
 void CL_TakeVideoFrame( void )
 {
+  int pending;
+
   // AVI file isn't open
   if( !afd.fileOpen )
     return;
 
-  re.TakeVideoFrame( afd.width, afd.height,
-      afd.cBuffer, afd.eBuffer, afd.motionJpeg );
+  if( afd.writeFailed )
+    Com_Error( ERR_DROP, "Failed to write AVI file" );
+
+  // the file is split here, making room for every frame that is still on
+  // its way and, with audio, a chunk of it alongside each
+  if( !afd.pipe )
+  {
+    pending = afd.framesTaken - afd.framesCaptured + afd.queueSize + 1;
+
+    if( CL_CheckFileSize( pending * ( afd.frameSize + AVI_CHUNK_OVERHEAD +
+            ( afd.audio ? PCM_BUFFER_SIZE + AVI_CHUNK_OVERHEAD : 0 ) ) ) )
+    {
+      if( !afd.fileOpen )
+        return;
+    }
+  }
+
+  afd.framesTaken++;
+  re.TakeVideoFrame( afd.width, afd.height, afd.cBuffer );
 }
 
 /*
@@ -593,15 +1108,40 @@ Closes the AVI file and writes an index chunk
 qboolean CL_CloseAVI( void )
 {
   int indexRemainder;
-  int indexSize = afd.numIndices * 16;
+  int indexSize;
   const char *idxFileName = va( "%s" INDEX_FILE_EXTENSION, afd.fileName );
 
   // AVI file isn't open
   if( !afd.fileOpen )
     return qfalse;
 
+  // the frames the renderer still has, then whatever is queued
+  if( re.FinishVideoFrames )
+    re.FinishVideoFrames( afd.cBuffer );
+  CL_StopAVIEncoder( );
+
+  if( afd.lock )
+    Sys_DestroyMutex( afd.lock );
+  afd.lock = NULL;
+
   afd.fileOpen = qfalse;
 
+  Z_Free( afd.cBuffer );
+  Z_Free( afd.eBuffer );
+
+  if( afd.pipe )
+  {
+    if( Sys_ClosePipe( afd.pipe ) != 0 || afd.writeFailed )
+      Com_Printf( S_COLOR_YELLOW "WARNING: cl_aviPipe didn't take every frame\n" );
+    afd.pipe = NULL;
+
+    Com_Printf( "Piped %d frames for %s\n", afd.numVideoFrames, afd.fileName );
+
+    return qtrue;
+  }
+
+  indexSize = afd.numIndices * 16;
+
   FS_Seek( afd.idxF, 4, FS_SEEK_SET );
   bufIndex = 0;
   WRITE_4BYTES( indexSize );
@@ -648,8 +1188,6 @@ qboolean CL_CloseAVI( void )
 
   SafeFS_Write( buffer, bufIndex, afd.f );
 
-  Z_Free( afd.cBuffer );
-  Z_Free( afd.eBuffer );
   FS_FCloseFile( afd.f );
 
   Com_Printf( "Wrote %d:%d frames to %s\n", afd.numVideoFrames, afd.numAudioFrames, afd.fileName );
@@ -0,0 +1,652 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// cl_bench.c -- timedemo runs over a list of demos and renderers, see benchmark
+
+#include "client.h"
+
+/*
+Every demo is played as a timedemo with the settings in benchSettings, once
+per renderer in cl_benchRenderers, each renderer starting from a vid_restart.
+The run is driven from CL_BenchFrame a step per frame, through the command
+buffer like a user typing, so a demo that fails to load or is stopped with
+escape drops back to CA_DISCONNECTED and ends the run with what it has.
+
+Frame times are wall clock microseconds between client frames once the demo
+is active, the time before that is the load. GPU times come from the
+renderer where it has them (renderergl2 timer queries) and trail the frames
+by a few, so they are kept as a separate set of samples.
+*/
+
+#define MAX_BENCH_DEMOS		32
+#define MAX_BENCH_RENDERERS	4
+#define MAX_BENCH_FRAMES	65536	// 54 minutes of demo at the timedemo 50 msec step
+
+typedef enum {
+	BENCH_IDLE,
+	BENCH_PASS,			// switch renderer and vid_restart
+	BENCH_DEMO,			// queue the next demo
+	BENCH_QUEUED,		// waiting for CL_PlayDemo_f to pick it up
+	BENCH_LOADING,		// demo started, waiting for the first active frame
+	BENCH_RUNNING
+} benchState_t;
+
+typedef struct {
+	char	renderer[MAX_QPATH];
+	char	demo[MAX_QPATH];
+	int		frames;
+	int		loadMsec;
+	float	avgFps;
+	float	lowFps;			// over the slowest 1% of the frames
+	float	avgMsec;
+	float	p50Msec;
+	float	p99Msec;
+	int		gpuFrames;
+	float	gpuAvgMsec;
+	float	gpuP99Msec;
+} benchResult_t;
+
+static const char *benchSettings[][2] = {
+	{ "timedemo", "1" },
+	{ "com_maxfps", "0" },
+	{ "com_maxfpsUnfocused", "0" },
+	{ "r_swapInterval", "0" },
+	{ "r_speeds", "0" },
+	{ "r_profile", "1" },			// renderergl2 GPU times
+	{ "cl_timedemoLog", "" },
+	{ "nextdemo", "" }
+};
+
+static struct {
+	benchState_t	state;
+
+	char			demos[MAX_BENCH_DEMOS][MAX_QPATH];
+	int				numDemos;
+	char			renderers[MAX_BENCH_RENDERERS][MAX_QPATH];
+	int				numRenderers;
+	int				demo;
+	int				renderer;
+
+	char			saved[ARRAY_LEN( benchSettings )][MAX_CVAR_VALUE_STRING];
+	char			savedRenderer[MAX_CVAR_VALUE_STRING];
+
+	benchResult_t	results[MAX_BENCH_DEMOS * MAX_BENCH_RENDERERS];
+	int				numResults;
+
+	// the demo being played
+	int				loadStart;
+	int				loadMsec;
+	int64_t			lastFrame;
+	int				numFrames;
+	int				frameTimes[MAX_BENCH_FRAMES];
+	int				numGPUFrames;
+	int				lastGPUFrame;
+	int				gpuTimes[MAX_BENCH_FRAMES];
+	int				sorted[MAX_BENCH_FRAMES];
+} bench;
+
+/*
+=================
+CL_BenchCompare
+=================
+*/
+static int QDECL CL_BenchCompare( const void *a, const void *b ) {
+	return *(const int *)a - *(const int *)b;
+}
+
+/*
+=================
+CL_BenchStats
+
+Average, median and 99th percentile of times in msec, the 1% low as fps
+=================
+*/
+static void CL_BenchStats( const int *times, int numTimes, float *avg, float *p50, float *p99, float *low ) {
+	int64_t	total;
+	int		i, numLow;
+
+	*avg = *p50 = *p99 = 0.0f;
+	if ( low ) {
+		*low = 0.0f;
+	}
+
+	if ( numTimes <= 0 ) {
+		return;
+	}
+
+	Com_Memcpy( bench.sorted, times, numTimes * sizeof( *times ) );
+	qsort( bench.sorted, numTimes, sizeof( *bench.sorted ), CL_BenchCompare );
+
+	total = 0;
+	for ( i = 0 ; i < numTimes ; i++ ) {
+		total += bench.sorted[i];
+	}
+
+	*avg = total / ( 1000.0f * numTimes );
+	*p50 = bench.sorted[( numTimes - 1 ) / 2] / 1000.0f;
+	*p99 = bench.sorted[( numTimes - 1 ) * 99 / 100] / 1000.0f;
+
+	if ( !low ) {
+		return;
+	}
+
+	numLow = ( numTimes + 99 ) / 100;
+	total = 0;
+	for ( i = numTimes - numLow ; i < numTimes ; i++ ) {
+		total += bench.sorted[i];
+	}
+
+	if ( total > 0 ) {
+		*low = 1000000.0f * numLow / total;
+	}
+}
+
+/*
+=================
+CL_BenchWriteResult
+=================
+*/
+static void CL_BenchWriteResult( fileHandle_t f, const benchResult_t *r ) {
+	FS_Printf( f, "%s \"%s\" %d %d %.1f %.1f %.2f %.2f %.2f %d %.2f %.2f\n",
+		r->renderer, r->demo, r->frames, r->loadMsec, r->avgFps, r->lowFps,
+		r->avgMsec, r->p50Msec, r->p99Msec, r->gpuFrames, r->gpuAvgMsec, r->gpuP99Msec );
+}
+
+/*
+=================
+CL_BenchWriteFrameLog
+
+benchmark/<renderer>-<demo>.csv, GPU samples are numbered on their own
+=================
+*/
+static void CL_BenchWriteFrameLog( const benchResult_t *r ) {
+	char			demo[MAX_QPATH];
+	char			name[MAX_QPATH];
+	fileHandle_t	f;
+	int				i;
+
+	COM_StripExtension( COM_SkipPath( (char *)r->demo ), demo, sizeof( demo ) );
+	Com_sprintf( name, sizeof( name ), "benchmark/%s-%s.csv", r->renderer, demo );
+
+	f = FS_FOpenFileWrite( name );
+	if ( !f ) {
+		Com_Printf( "Couldn't open %s for writing\n", name );
+		return;
+	}
+
+	FS_Printf( f, "frame,frame_usec,gpu_usec\n" );
+	for ( i = 0 ; i < bench.numFrames || i < bench.numGPUFrames ; i++ ) {
+		FS_Printf( f, "%d,", i );
+		if ( i < bench.numFrames ) {
+			FS_Printf( f, "%d", bench.frameTimes[i] );
+		}
+		FS_Printf( f, "," );
+		if ( i < bench.numGPUFrames ) {
+			FS_Printf( f, "%d", bench.gpuTimes[i] );
+		}
+		FS_Printf( f, "\n" );
+	}
+
+	FS_FCloseFile( f );
+}
+
+/*
+=================
+CL_BenchParseResult
+
+One line of a results file, qfalse at the end of it
+=================
+*/
+static qboolean CL_BenchParseResult( char **text, benchResult_t *r ) {
+	char	*token;
+
+	while ( 1 ) {
+		token = COM_ParseExt( text, qtrue );
+		if ( !token[0] ) {
+			return qfalse;
+		}
+		if ( token[0] != '#' ) {
+			break;
+		}
+		SkipRestOfLine( text );
+	}
+
+	Com_Memset( r, 0, sizeof( *r ) );
+	Q_strncpyz( r->renderer, token, sizeof( r->renderer ) );
+	Q_strncpyz( r->demo, COM_ParseExt( text, qfalse ), sizeof( r->demo ) );
+	r->frames = atoi( COM_ParseExt( text, qfalse ) );
+	r->loadMsec = atoi( COM_ParseExt( text, qfalse ) );
+	r->avgFps = atof( COM_ParseExt( text, qfalse ) );
+	r->lowFps = atof( COM_ParseExt( text, qfalse ) );
+	r->avgMsec = atof( COM_ParseExt( text, qfalse ) );
+	r->p50Msec = atof( COM_ParseExt( text, qfalse ) );
+	r->p99Msec = atof( COM_ParseExt( text, qfalse ) );
+	r->gpuFrames = atoi( COM_ParseExt( text, qfalse ) );
+	r->gpuAvgMsec = atof( COM_ParseExt( text, qfalse ) );
+	r->gpuP99Msec = atof( COM_ParseExt( text, qfalse ) );
+	SkipRestOfLine( text );
+
+	return qtrue;
+}
+
+/*
+=================
+CL_BenchDelta
+
+Prints one measurement against the baseline, qtrue if it got worse by more
+than cl_benchTolerance percent
+=================
+*/
+static qboolean CL_BenchDelta( fileHandle_t f, const char *label, float value, float base, qboolean higherIsBetter ) {
+	float		change;
+	qboolean	regressed;
+	char		*line;
+
+	if ( base <= 0.0f || value <= 0.0f ) {
+		return qfalse;
+	}
+
+	change = 100.0f * ( value - base ) / base;
+	regressed = ( higherIsBetter ? -change : change ) > cl_benchTolerance->value;
+
+	line = va( "  %-10s %9.2f %9.2f %+7.1f%%%s\n", label, base, value, change,
+		regressed ? "  REGRESSION" : "" );
+	Com_Printf( "%s%s", regressed ? S_COLOR_RED : "", line );
+	if ( f ) {
+		FS_Printf( f, "#%s", line );
+	}
+
+	return regressed;
+}
+
+/*
+=================
+CL_BenchCompareBaseline
+
+Returns the number of demos that regressed against cl_benchBaseline
+=================
+*/
+static int CL_BenchCompareBaseline( fileHandle_t f ) {
+	benchResult_t	base;
+	benchResult_t	*r;
+	union {
+		char	*c;
+		void	*v;
+	} buffer;
+	char			*text;
+	int				i, regressions;
+	qboolean		regressed, found;
+
+	if ( !cl_benchBaseline->string[0] ) {
+		return 0;
+	}
+
+	if ( FS_ReadFile( cl_benchBaseline->string, &buffer.v ) <= 0 ) {
+		Com_Printf( "benchmark: couldn't read baseline %s\n", cl_benchBaseline->string );
+		return 0;
+	}
+
+	Com_Printf( "Against baseline %s (%s%% tolerance):\n", cl_benchBaseline->string, cl_benchTolerance->string );
+	if ( f ) {
+		FS_Printf( f, "# against baseline %s (%s%% tolerance): baseline current change\n",
+			cl_benchBaseline->string, cl_benchTolerance->string );
+	}
+
+	regressions = 0;
+	for ( i = 0, r = bench.results ; i < bench.numResults ; i++, r++ ) {
+		found = qfalse;
+		text = buffer.c;
+		while ( CL_BenchParseResult( &text, &base ) ) {
+			if ( !Q_stricmp( base.renderer, r->renderer ) && !Q_stricmp( base.demo, r->demo ) ) {
+				found = qtrue;
+				break;
+			}
+		}
+
+		Com_Printf( "%s %s%s\n", r->renderer, r->demo, found ? "" : ": not in the baseline" );
+		if ( f ) {
+			FS_Printf( f, "# %s %s%s\n", r->renderer, r->demo, found ? "" : ": not in the baseline" );
+		}
+		if ( !found ) {
+			continue;
+		}
+
+		regressed = CL_BenchDelta( f, "avg fps", r->avgFps, base.avgFps, qtrue );
+		regressed |= CL_BenchDelta( f, "1% low", r->lowFps, base.lowFps, qtrue );
+		regressed |= CL_BenchDelta( f, "p99 ms", r->p99Msec, base.p99Msec, qfalse );
+		regressed |= CL_BenchDelta( f, "gpu ms", r->gpuAvgMsec, base.gpuAvgMsec, qfalse );
+		regressed |= CL_BenchDelta( f, "load ms", r->loadMsec, base.loadMsec, qfalse );
+		if ( regressed ) {
+			regressions++;
+		}
+	}
+
+	FS_FreeFile( buffer.v );
+
+	return regressions;
+}
+
+/*
+=================
+CL_BenchFinish
+
+Writes the results, compares them and puts the settings back
+=================
+*/
+static void CL_BenchFinish( const char *error ) {
+	fileHandle_t	f;
+	qtime_t			now;
+	int				i, regressions;
+
+	if ( error ) {
+		Com_Printf( S_COLOR_YELLOW "benchmark stopped: %s\n", error );
+	}
+
+	f = 0;
+	if ( bench.numResults ) {
+		f = FS_FOpenFileWrite( cl_benchResults->string );
+		if ( !f ) {
+			Com_Printf( "Couldn't open %s for writing\n", cl_benchResults->string );
+		}
+	}
+
+	if ( f ) {
+		Com_RealTime( &now );
+		FS_Printf( f, "# benchmark %04d-%02d-%02d %02d:%02d:%02d, %s %s\n",
+			1900 + now.tm_year, 1 + now.tm_mon, now.tm_mday, now.tm_hour, now.tm_min, now.tm_sec,
+			cls.glconfig.renderer_string, cls.glconfig.version_string );
+		if ( error ) {
+			FS_Printf( f, "# incomplete: %s\n", error );
+		}
+		FS_Printf( f, "# renderer demo frames load_ms avg_fps 1%%_low_fps avg_ms p50_ms p99_ms gpu_frames gpu_avg_ms gpu_p99_ms\n" );
+		for ( i = 0 ; i < bench.numResults ; i++ ) {
+			CL_BenchWriteResult( f, &bench.results[i] );
+		}
+	}
+
+	regressions = CL_BenchCompareBaseline( f );
+
+	if ( f ) {
+		FS_FCloseFile( f );
+		Com_Printf( "%s written\n", cl_benchResults->string );
+	}
+
+	if ( cl_benchBaseline->string[0] ) {
+		Com_Printf( "%d of %d demo runs regressed\n", regressions, bench.numResults );
+	}
+
+	for ( i = 0 ; i < ARRAY_LEN( benchSettings ) ; i++ ) {
+		Cvar_Set( benchSettings[i][0], bench.saved[i] );
+	}
+
+#ifdef USE_RENDERER_DLOPEN
+	Cbuf_AddText( va( "cl_renderer %s\n", bench.savedRenderer ) );
+#endif
+	Cbuf_AddText( "vid_restart\n" );
+
+	bench.state = BENCH_IDLE;
+}
+
+/*
+=================
+CL_BenchNextDemo
+=================
+*/
+static void CL_BenchNextDemo( void ) {
+	if ( ++bench.demo < bench.numDemos ) {
+		bench.state = BENCH_DEMO;
+		return;
+	}
+
+	bench.demo = 0;
+	if ( ++bench.renderer < bench.numRenderers ) {
+		bench.state = BENCH_PASS;
+		return;
+	}
+
+	CL_BenchFinish( NULL );
+}
+
+/*
+=================
+CL_BenchDemoLoading
+
+Called from CL_PlayDemo_f, the load time starts here
+=================
+*/
+void CL_BenchDemoLoading( void ) {
+	if ( bench.state != BENCH_QUEUED ) {
+		return;
+	}
+
+	bench.state = BENCH_LOADING;
+	bench.loadStart = Sys_Milliseconds();
+	bench.numFrames = 0;
+	bench.numGPUFrames = 0;
+	bench.lastGPUFrame = -1;
+}
+
+/*
+=================
+CL_BenchDemoCompleted
+
+Called from CL_DemoCompleted before the disconnect
+=================
+*/
+void CL_BenchDemoCompleted( void ) {
+	benchResult_t	*r;
+	float			gpuP50;
+
+	if ( bench.state == BENCH_LOADING ) {
+		Com_Printf( S_COLOR_YELLOW "benchmark: %s ended before its first frame\n", bench.demos[bench.demo] );
+		CL_BenchNextDemo();
+		return;
+	}
+
+	if ( bench.state != BENCH_RUNNING ) {
+		return;
+	}
+
+	r = &bench.results[bench.numResults++];
+	Com_Memset( r, 0, sizeof( *r ) );
+	Q_strncpyz( r->renderer, bench.renderers[bench.renderer], sizeof( r->renderer ) );
+	Q_strncpyz( r->demo, bench.demos[bench.demo], sizeof( r->demo ) );
+	r->frames = bench.numFrames;
+	r->loadMsec = bench.loadMsec;
+	CL_BenchStats( bench.frameTimes, bench.numFrames, &r->avgMsec, &r->p50Msec, &r->p99Msec, &r->lowFps );
+	if ( r->avgMsec > 0.0f ) {
+		r->avgFps = 1000.0f / r->avgMsec;
+	}
+	r->gpuFrames = bench.numGPUFrames;
+	CL_BenchStats( bench.gpuTimes, bench.numGPUFrames, &r->gpuAvgMsec, &gpuP50, &r->gpuP99Msec, NULL );
+
+	Com_Printf( "%s %s: %d frames %.1f fps, 1%% low %.1f fps, p99 %.2f ms", r->renderer, r->demo,
+		r->frames, r->avgFps, r->lowFps, r->p99Msec );
+	if ( r->gpuFrames ) {
+		Com_Printf( ", gpu %.2f ms p99 %.2f ms", r->gpuAvgMsec, r->gpuP99Msec );
+	}
+	Com_Printf( ", load %d ms\n", r->loadMsec );
+
+	if ( cl_benchFrameLog->integer ) {
+		CL_BenchWriteFrameLog( r );
+	}
+
+	CL_BenchNextDemo();
+}
+
+/*
+=================
+CL_BenchFrame
+
+Called from CL_Frame after the screen has been updated
+=================
+*/
+void CL_BenchFrame( void ) {
+	int64_t	now;
+	int		frameNum, usec;
+
+	switch ( bench.state ) {
+	case BENCH_IDLE:
+		return;
+
+	case BENCH_PASS:
+#ifdef USE_RENDERER_DLOPEN
+		Cbuf_AddText( va( "cl_renderer %s\n", bench.renderers[bench.renderer] ) );
+#endif
+		Cbuf_AddText( "vid_restart\n" );
+		bench.state = BENCH_DEMO;
+		return;
+
+	case BENCH_DEMO:
+		Cbuf_AddText( va( "demo \"%s\"\n", bench.demos[bench.demo] ) );
+		bench.state = BENCH_QUEUED;
+		return;
+
+	case BENCH_QUEUED:
+		// the command buffer ran without getting to CL_PlayDemo_f
+		CL_BenchFinish( va( "%s didn't start", bench.demos[bench.demo] ) );
+		return;
+
+	default:
+		break;
+	}
+
+	if ( !clc.demoplaying ) {
+		CL_BenchFinish( va( "%s stopped during %s", bench.demos[bench.demo],
+			bench.state == BENCH_LOADING ? "the load" : "playback" ) );
+		return;
+	}
+
+	if ( clc.state != CA_ACTIVE ) {
+		return;
+	}
+
+	now = Sys_Microseconds();
+
+	if ( bench.state == BENCH_LOADING ) {
+		bench.loadMsec = Sys_Milliseconds() - bench.loadStart;
+		bench.lastFrame = now;
+		bench.state = BENCH_RUNNING;
+		return;
+	}
+
+	if ( bench.numFrames < MAX_BENCH_FRAMES ) {
+		bench.frameTimes[bench.numFrames++] = now - bench.lastFrame;
+	}
+	bench.lastFrame = now;
+
+	if ( re.GetGPUFrameTime && re.GetGPUFrameTime( &frameNum, &usec ) && frameNum != bench.lastGPUFrame ) {
+		bench.lastGPUFrame = frameNum;
+		if ( bench.numGPUFrames < MAX_BENCH_FRAMES ) {
+			bench.gpuTimes[bench.numGPUFrames++] = usec;
+		}
+	}
+}
+
+/*
+=================
+CL_BenchParseList
+=================
+*/
+static int CL_BenchParseList( const char *list, char names[][MAX_QPATH], int maxNames, const char *what ) {
+	char	buffer[MAX_STRING_CHARS];
+	char	*text, *token;
+	int		num;
+
+	Q_strncpyz( buffer, list, sizeof( buffer ) );
+	text = buffer;
+
+	for ( num = 0 ; ; num++ ) {
+		token = COM_Parse( &text );
+		if ( !token[0] ) {
+			break;
+		}
+		if ( num == maxNames ) {
+			Com_Printf( "benchmark: only the first %d %s are used\n", maxNames, what );
+			break;
+		}
+		Q_strncpyz( names[num], token, MAX_QPATH );
+	}
+
+	return num;
+}
+
+/*
+=================
+CL_Benchmark_f
+
+benchmark [demo ...]
+=================
+*/
+void CL_Benchmark_f( void ) {
+	int		i;
+
+	if ( bench.state != BENCH_IDLE ) {
+		Com_Printf( "A benchmark is already running, escape stops it\n" );
+		return;
+	}
+
+	if ( clc.state != CA_DISCONNECTED || com_sv_running->integer ) {
+		Com_Printf( "Disconnect before starting a benchmark\n" );
+		return;
+	}
+
+	bench.numDemos = 0;
+	if ( Cmd_Argc() > 1 ) {
+		for ( i = 1 ; i < Cmd_Argc() && bench.numDemos < MAX_BENCH_DEMOS ; i++ ) {
+			Q_strncpyz( bench.demos[bench.numDemos++], Cmd_Argv( i ), MAX_QPATH );
+		}
+	} else {
+		bench.numDemos = CL_BenchParseList( cl_benchDemos->string, bench.demos, MAX_BENCH_DEMOS, "demos" );
+	}
+
+	if ( !bench.numDemos ) {
+		Com_Printf( "benchmark [demo ...], with no demos given cl_benchDemos is played\n" );
+		return;
+	}
+
+#ifdef USE_RENDERER_DLOPEN
+	Q_strncpyz( bench.savedRenderer, cl_renderer->string, sizeof( bench.savedRenderer ) );
+	bench.numRenderers = CL_BenchParseList( cl_benchRenderers->string, bench.renderers, MAX_BENCH_RENDERERS, "renderers" );
+	if ( !bench.numRenderers ) {
+		Q_strncpyz( bench.renderers[0], cl_renderer->string, MAX_QPATH );
+		bench.numRenderers = 1;
+	}
+#else
+	if ( cl_benchRenderers->string[0] ) {
+		Com_Printf( "benchmark: cl_benchRenderers needs a build with USE_RENDERER_DLOPEN\n" );
+	}
+	Q_strncpyz( bench.renderers[0], "default", MAX_QPATH );
+	bench.numRenderers = 1;
+#endif
+
+	for ( i = 0 ; i < ARRAY_LEN( benchSettings ) ; i++ ) {
+		Q_strncpyz( bench.saved[i], Cvar_VariableString( benchSettings[i][0] ), sizeof( bench.saved[i] ) );
+		Cvar_Set( benchSettings[i][0], benchSettings[i][1] );
+	}
+
+	bench.demo = 0;
+	bench.renderer = 0;
+	bench.numResults = 0;
+	bench.state = BENCH_PASS;
+
+	Com_Printf( "Benchmarking %d demos with %d renderers\n", bench.numDemos, bench.numRenderers );
+}
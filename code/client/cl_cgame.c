@@ -121,7 +121,7 @@ CL_GetSnapshot
 */
 qboolean	CL_GetSnapshot( int snapshotNumber, snapshot_t *snapshot ) {
 	clSnapshot_t	*clSnap;
-	int				i, count;
+	int				i, count, first;
 
 	if ( snapshotNumber > cl.snap.messageNum ) {
 		Com_Error( ERR_DROP, "CL_GetSnapshot: snapshotNumber > cl.snapshot.messageNum" );
@@ -157,10 +157,15 @@ qboolean	CL_GetSnapshot( int snapshotNumber, snapshot_t *snapshot ) {
 		count = MAX_ENTITIES_IN_SNAPSHOT;
 	}
 	snapshot->numEntities = count;
-	for ( i = 0 ; i < count ; i++ ) {
-		snapshot->entities[i] = 
-			cl.parseEntities[ ( clSnap->parseEntitiesNum + i ) & (MAX_PARSE_ENTITIES-1) ];
+
+	// at most two blocks, the entities may wrap around the end of the ring
+	first = clSnap->parseEntitiesNum & (MAX_PARSE_ENTITIES-1);
+	i = MAX_PARSE_ENTITIES - first;
+	if ( i > count ) {
+		i = count;
 	}
+	Com_Memcpy( snapshot->entities, &cl.parseEntities[first], i * sizeof( entityState_t ) );
+	Com_Memcpy( snapshot->entities + i, cl.parseEntities, ( count - i ) * sizeof( entityState_t ) );
 
 	// FIXME: configstring changes and server commands!!!
 
@@ -321,6 +326,34 @@ rescan:
 		goto rescan;
 	}
 
+	if ( !strcmp( cmd, "csd" ) ) {
+		// only the changed middle of a configstring, turn it back into a full cs
+		int		index, prefix, suffix, oldLen;
+		char	*old;
+
+		index = atoi( Cmd_Argv(1) );
+		if ( index < 0 || index >= MAX_CONFIGSTRINGS ) {
+			Com_Error( ERR_DROP, "CL_GetServerCommand: bad csd index %i", index );
+		}
+		prefix = atoi( Cmd_Argv(2) );
+		suffix = atoi( Cmd_Argv(3) );
+		s = Cmd_Argv(4);
+
+		old = cl.gameState.stringData + cl.gameState.stringOffsets[ index ];
+		oldLen = strlen( old );
+		if ( prefix < 0 || suffix < 0 || prefix + suffix > oldLen ) {
+			Com_Error( ERR_DROP, "CL_GetServerCommand: bad csd for configstring %i", index );
+		}
+		if ( prefix + strlen( s ) + suffix + 16 >= BIG_INFO_STRING ) {
+			Com_Error( ERR_DROP, "csd exceeded BIG_INFO_STRING" );
+		}
+
+		Com_sprintf( bigConfigString, BIG_INFO_STRING, "cs %i \"%.*s%s%s\"", index,
+			prefix, old, s, old + oldLen - suffix );
+		s = bigConfigString;
+		goto rescan;
+	}
+
 	if ( !strcmp( cmd, "cs" ) ) {
 		CL_ConfigstringModified();
 		// reparse the string, because CL_ConfigstringModified may have done another Cmd_TokenizeString()
@@ -372,9 +405,12 @@ Just adds default parameters that cgame doesn't need to know about
 ====================
 */
 void CL_CM_LoadMap( const char *mapname ) {
+	memClass_t	oldClass;
 	int		checksum;
 
+	oldClass = Com_SetMemClass( MEMCLASS_CM );
 	CM_LoadMap( mapname, qtrue, &checksum );
+	Com_SetMemClass( oldClass );
 }
 
 /*
@@ -701,6 +737,28 @@ intptr_t CL_CgameSystemCalls( intptr_t *args ) {
 }
 
 
+/*
+====================
+CL_PreloadSounds
+
+Registers every sound in the configstrings, so the ones the cgame only
+registers when they are first played don't load in the middle of the
+match. Player specific sounds starting with '*' are left to the cgame.
+====================
+*/
+static void CL_PreloadSounds( void ) {
+	const char	*name;
+	int			i;
+
+	for ( i = 1 ; i < MAX_SOUNDS ; i++ ) {
+		name = cl.gameState.stringData + cl.gameState.stringOffsets[CS_SOUNDS + i];
+		if ( !name[0] || name[0] == '*' ) {
+			continue;
+		}
+		S_RegisterSound( name, qfalse );
+	}
+}
+
 /*
 ====================
 CL_InitCGame
@@ -756,6 +814,9 @@ void CL_InitCGame( void ) {
 
 	Com_Printf( "CL_InitCGame: %5.2f seconds\n", (t2-t1)/1000.0 );
 
+	// load the sounds of the map now, instead of on first play
+	CL_PreloadSounds();
+
 	// have the renderer touch all its images, so they are present
 	// on the card even if the driver does deferred loading
 	re.EndRegistration();
@@ -831,7 +892,7 @@ void CL_AdjustTimeDelta( void ) {
 		return;
 	}
 
-	newDelta = cl.snap.serverTime - cls.realtime;
+	newDelta = cl.snap.serverTime - cl.snap.realtime;
 	deltaDelta = abs( newDelta - cl.serverTimeDelta );
 
 	if ( deltaDelta > RESET_TIME ) {
@@ -888,6 +949,11 @@ void CL_FirstSnapshot( void ) {
 
 	clc.timeDemoBaseTime = cl.snap.serverTime;
 
+	// demo_seek times are from here, unless the seek index says otherwise
+	if ( clc.demoplaying && !clc.demoStartTime ) {
+		clc.demoStartTime = cl.snap.serverTime;
+	}
+
 	// if this is the first frame of active play,
 	// execute the contents of activeAction now
 	// this is to allow scripting a timedemo to start right
@@ -1067,6 +1133,14 @@ void CL_SetCGameTime( void ) {
 		cl.serverTime = clc.timeDemoBaseTime + clc.timeDemoFrames * 50;
 	}
 
+	// a demo_seek target is read up to over as many frames as it takes
+	if ( clc.demoSeekTime ) {
+		CL_DemoSeekFrame();
+		if ( clc.state != CA_ACTIVE ) {
+			return;		// end of demo
+		}
+	}
+
 	while ( cl.serverTime >= cl.snap.serverTime ) {
 		// feed another messag, which should change
 		// the contents of cl.snap
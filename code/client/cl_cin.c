@@ -52,8 +52,13 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #define MAX_VIDEO_HANDLES	16
 
+#define CIN_QUEUE_FRAMES	4		// decoded ahead, and the one being shown
+#define CIN_COMMANDS		8
+#define CIN_MAX_PACKET		65536
+
 
 static void RoQ_init( void );
+static void CIN_StopDecode( void );
 
 /******************************************************************************
 *
@@ -132,6 +137,50 @@ static cin_cache		cinTable[MAX_VIDEO_HANDLES];
 static int				currentHandle = -1;
 static int				CL_handle = -1;
 
+/*
+The stream is parsed on the client up to CIN_QUEUE_FRAMES - 1 video frames
+ahead of what is shown. Codebook and VQ packets go to a decode thread,
+which builds each frame in cin.linbuf as before and copies it out to the
+frame queue. Sound packets are held back with the frame that follows them
+and only go to the mixer when that frame is shown, so they keep the timing
+they had. There is one decoder, as there is one cin, so switching videos
+drops whatever was queued.
+*/
+
+typedef struct {
+	int					id;				// ROQ_CODEBOOK or ROQ_QUAD_VQ
+	int					flags;
+	long				roqF0, roqF1;
+	long				frame;			// numQuads before this frame
+	int					size;
+	byte				data[CIN_MAX_PACKET];
+} cinCommand_t;
+
+typedef struct {
+	long				number;			// shown once tfps gets to it
+	int					command;		// the one that decodes it
+	int					samples, channels;
+	short				audio[32768];
+	byte				pixels[DEFAULT_CIN_WIDTH*DEFAULT_CIN_HEIGHT*4];
+} cinFrame_t;
+
+static struct {
+	sysThread_t			*thread;
+	sysSemaphore_t		*work;
+	sysSemaphore_t		*done;
+	qboolean			quit;
+
+	cinCommand_t		commands[CIN_COMMANDS];
+	int					commandsQueued;
+	int					commandsDone;	// the client's count
+	int					commandsRun;	// the decoder's count
+
+	cinFrame_t			frames[CIN_QUEUE_FRAMES];
+	int					framesQueued;
+	int					framesDecoded;	// the decoder's count
+	int					framesShown;
+} cinDecode;
+
 extern int				s_soundtime;		// sample PAIRS
 
 
@@ -143,6 +192,8 @@ void CIN_CloseAllVideos(void) {
 			CIN_StopCinematic(i);
 		}
 	}
+
+	CIN_StopDecode();
 }
 
 
@@ -429,7 +480,7 @@ int		spl;
 	celdata = 0;
 	index	= 0;
 	
-        spl = cinTable[currentHandle].samplesPerLine;
+        spl = cinTable[cin.currentHandle].samplesPerLine;
         
 	do {
 		if (!newd) { 
@@ -643,12 +694,12 @@ static void decodeCodeBook( byte *input, unsigned short roq_flags )
 
 	bptr = (unsigned short *)vq2;
 
-	if (!cinTable[currentHandle].half) {
-		if (!cinTable[currentHandle].smootheddouble) {
+	if (!cinTable[cin.currentHandle].half) {
+		if (!cinTable[cin.currentHandle].smootheddouble) {
 //
 // normal height
 //
-			if (cinTable[currentHandle].samplesPerPixel==2) {
+			if (cinTable[cin.currentHandle].samplesPerPixel==2) {
 				for(i=0;i<two;i++) {
 					y0 = (long)*input++;
 					y1 = (long)*input++;
@@ -671,7 +722,7 @@ static void decodeCodeBook( byte *input, unsigned short roq_flags )
 					for(j=0;j<2;j++)
 						VQ2TO4(aptr,bptr,cptr,dptr);
 				}
-			} else if (cinTable[currentHandle].samplesPerPixel==4) {
+			} else if (cinTable[cin.currentHandle].samplesPerPixel==4) {
 				ibptr.s = bptr;
 				for(i=0;i<two;i++) {
 					y0 = (long)*input++;
@@ -697,13 +748,13 @@ static void decodeCodeBook( byte *input, unsigned short roq_flags )
 					for(j=0;j<2;j++) 
 						VQ2TO4(iaptr.i, ibptr.i, icptr.i, idptr.i);
 				}
-			} else if (cinTable[currentHandle].samplesPerPixel==1) {
+			} else if (cinTable[cin.currentHandle].samplesPerPixel==1) {
 				bbptr = (byte *)bptr;
 				for(i=0;i<two;i++) {
-					*bbptr++ = cinTable[currentHandle].gray[*input++];
-					*bbptr++ = cinTable[currentHandle].gray[*input++];
-					*bbptr++ = cinTable[currentHandle].gray[*input++];
-					*bbptr++ = cinTable[currentHandle].gray[*input]; input +=3;
+					*bbptr++ = cinTable[cin.currentHandle].gray[*input++];
+					*bbptr++ = cinTable[cin.currentHandle].gray[*input++];
+					*bbptr++ = cinTable[cin.currentHandle].gray[*input++];
+					*bbptr++ = cinTable[cin.currentHandle].gray[*input]; input +=3;
 				}
 
 				bcptr = (byte *)vq4;
@@ -720,7 +771,7 @@ static void decodeCodeBook( byte *input, unsigned short roq_flags )
 //
 // double height, smoothed
 //
-			if (cinTable[currentHandle].samplesPerPixel==2) {
+			if (cinTable[cin.currentHandle].samplesPerPixel==2) {
 				for(i=0;i<two;i++) {
 					y0 = (long)*input++;
 					y1 = (long)*input++;
@@ -749,7 +800,7 @@ static void decodeCodeBook( byte *input, unsigned short roq_flags )
 						VQ2TO4(aptr,bptr,cptr,dptr);
 					}
 				}
-			} else if (cinTable[currentHandle].samplesPerPixel==4) {
+			} else if (cinTable[cin.currentHandle].samplesPerPixel==4) {
 				ibptr.s = bptr;
 				for(i=0;i<two;i++) {
 					y0 = (long)*input++;
@@ -781,21 +832,21 @@ static void decodeCodeBook( byte *input, unsigned short roq_flags )
 						VQ2TO4(iaptr.i, ibptr.i, icptr.i, idptr.i);
 					}
 				}
-			} else if (cinTable[currentHandle].samplesPerPixel==1) {
+			} else if (cinTable[cin.currentHandle].samplesPerPixel==1) {
 				bbptr = (byte *)bptr;
 				for(i=0;i<two;i++) {
 					y0 = (long)*input++;
 					y1 = (long)*input++;
 					y2 = (long)*input++;
 					y3 = (long)*input; input+= 3;
-					*bbptr++ = cinTable[currentHandle].gray[y0];
-					*bbptr++ = cinTable[currentHandle].gray[y1];
-					*bbptr++ = cinTable[currentHandle].gray[((y0*3)+y2)/4];
-					*bbptr++ = cinTable[currentHandle].gray[((y1*3)+y3)/4];
-					*bbptr++ = cinTable[currentHandle].gray[(y0+(y2*3))/4];
-					*bbptr++ = cinTable[currentHandle].gray[(y1+(y3*3))/4];						
-					*bbptr++ = cinTable[currentHandle].gray[y2];
-					*bbptr++ = cinTable[currentHandle].gray[y3];
+					*bbptr++ = cinTable[cin.currentHandle].gray[y0];
+					*bbptr++ = cinTable[cin.currentHandle].gray[y1];
+					*bbptr++ = cinTable[cin.currentHandle].gray[((y0*3)+y2)/4];
+					*bbptr++ = cinTable[cin.currentHandle].gray[((y1*3)+y3)/4];
+					*bbptr++ = cinTable[cin.currentHandle].gray[(y0+(y2*3))/4];
+					*bbptr++ = cinTable[cin.currentHandle].gray[(y1+(y3*3))/4];						
+					*bbptr++ = cinTable[cin.currentHandle].gray[y2];
+					*bbptr++ = cinTable[cin.currentHandle].gray[y3];
 				}
 
 				bcptr = (byte *)vq4;
@@ -815,7 +866,7 @@ static void decodeCodeBook( byte *input, unsigned short roq_flags )
 //
 // 1/4 screen
 //
-		if (cinTable[currentHandle].samplesPerPixel==2) {
+		if (cinTable[cin.currentHandle].samplesPerPixel==2) {
 			for(i=0;i<two;i++) {
 				y0 = (long)*input; input+=2;
 				y2 = (long)*input; input+=2;
@@ -835,12 +886,12 @@ static void decodeCodeBook( byte *input, unsigned short roq_flags )
 					VQ2TO2(aptr,bptr,cptr,dptr);
 				}
 			}
-		} else if (cinTable[currentHandle].samplesPerPixel == 1) {
+		} else if (cinTable[cin.currentHandle].samplesPerPixel == 1) {
 			bbptr = (byte *)bptr;
 				
 			for(i=0;i<two;i++) {
-				*bbptr++ = cinTable[currentHandle].gray[*input]; input+=2;
-				*bbptr++ = cinTable[currentHandle].gray[*input]; input+=4;
+				*bbptr++ = cinTable[cin.currentHandle].gray[*input]; input+=2;
+				*bbptr++ = cinTable[cin.currentHandle].gray[*input]; input+=4;
 			}
 
 			bcptr = (byte *)vq4;
@@ -853,7 +904,7 @@ static void decodeCodeBook( byte *input, unsigned short roq_flags )
 					VQ2TO2(baptr,bbptr,bcptr,bdptr);
 				}
 			}			
-		} else if (cinTable[currentHandle].samplesPerPixel == 4) {
+		} else if (cinTable[cin.currentHandle].samplesPerPixel == 4) {
 			ibptr.s = bptr;
 			for(i=0;i<two;i++) {
 				y0 = (long)*input; input+=2;
@@ -1022,18 +1073,318 @@ static void RoQPrepMcomp( long xoff, long yoff )
 {
 	long i, j, x, y, temp, temp2;
 
-	i=cinTable[currentHandle].samplesPerLine; j=cinTable[currentHandle].samplesPerPixel;
-	if ( cinTable[currentHandle].xsize == (cinTable[currentHandle].ysize*4) && !cinTable[currentHandle].half ) { j = j+j; i = i+i; }
+	i=cinTable[cin.currentHandle].samplesPerLine; j=cinTable[cin.currentHandle].samplesPerPixel;
+	if ( cinTable[cin.currentHandle].xsize == (cinTable[cin.currentHandle].ysize*4) && !cinTable[cin.currentHandle].half ) { j = j+j; i = i+i; }
 	
 	for(y=0;y<16;y++) {
 		temp2 = (y+yoff-8)*i;
 		for(x=0;x<16;x++) {
 			temp = (x+xoff-8)*j;
-			cin.mcomp[(x*16)+y] = cinTable[currentHandle].normalBuffer0-(temp2+temp);
+			cin.mcomp[(x*16)+y] = cinTable[cin.currentHandle].normalBuffer0-(temp2+temp);
+		}
+	}
+}
+
+/*
+==================
+CIN_RunCommand
+
+On the decode thread, or on the client without one
+==================
+*/
+static void CIN_RunCommand( cinCommand_t *cmd ) {
+	cin_cache	*c = &cinTable[cin.currentHandle];
+	byte		*buf;
+
+	if ( cmd->id == ROQ_CODEBOOK ) {
+		decodeCodeBook( cmd->data, (unsigned short)cmd->flags );
+		return;
+	}
+
+	if ( cmd->frame & 1 ) {
+		c->normalBuffer0 = c->t[1];
+		RoQPrepMcomp( cmd->roqF0, cmd->roqF1 );
+		c->VQ1( (byte *)cin.qStatus[1], cmd->data );
+		buf = cin.linbuf + c->screenDelta;
+	} else {
+		c->normalBuffer0 = c->t[0];
+		RoQPrepMcomp( cmd->roqF0, cmd->roqF1 );
+		c->VQ0( (byte *)cin.qStatus[0], cmd->data );
+		buf = cin.linbuf;
+	}
+	if ( cmd->frame == 0 ) {		// first frame
+		Com_Memcpy( cin.linbuf + c->screenDelta, cin.linbuf, c->samplesPerLine * c->ysize );
+	}
+
+	Com_Memcpy( cinDecode.frames[cinDecode.framesDecoded % CIN_QUEUE_FRAMES].pixels, buf, c->screenDelta );
+	cinDecode.framesDecoded++;
+}
+
+/*
+==================
+CIN_DecodeThread
+==================
+*/
+static void CIN_DecodeThread( void *arg ) {
+	for ( ;; ) {
+		Sys_WaitSemaphore( cinDecode.work );
+
+		if ( cinDecode.quit ) {
+			return;
+		}
+
+		CIN_RunCommand( &cinDecode.commands[cinDecode.commandsRun % CIN_COMMANDS] );
+		cinDecode.commandsRun++;
+
+		Sys_PostSemaphore( cinDecode.done );
+	}
+}
+
+/*
+==================
+CIN_StartDecode
+==================
+*/
+static void CIN_StartDecode( void ) {
+	if ( cinDecode.thread ) {
+		return;
+	}
+
+	cinDecode.work = Sys_CreateSemaphore();
+	cinDecode.done = Sys_CreateSemaphore();
+	cinDecode.quit = qfalse;
+
+	if ( cinDecode.work && cinDecode.done ) {
+		cinDecode.thread = Sys_CreateThread( CIN_DecodeThread, NULL );
+	}
+
+	if ( !cinDecode.thread ) {
+		Com_DPrintf( "couldn't start the cinematic decode thread\n" );
+
+		if ( cinDecode.work ) {
+			Sys_DestroySemaphore( cinDecode.work );
+		}
+		if ( cinDecode.done ) {
+			Sys_DestroySemaphore( cinDecode.done );
+		}
+		cinDecode.work = cinDecode.done = NULL;
+	}
+}
+
+/*
+==================
+CIN_WaitCommands
+
+Until count commands have been run
+==================
+*/
+static void CIN_WaitCommands( int count ) {
+	while ( cinDecode.commandsDone - count < 0 ) {
+		Sys_WaitSemaphore( cinDecode.done );
+		cinDecode.commandsDone++;
+	}
+}
+
+/*
+==================
+CIN_FlushDecode
+
+Waits for the decoder to finish what it has, which it has to before its
+state is touched. The queued frames are dropped as well with discard.
+==================
+*/
+static void CIN_FlushDecode( qboolean discard ) {
+	int		i;
+
+	CIN_WaitCommands( cinDecode.commandsQueued );
+
+	if ( discard ) {
+		cinDecode.framesShown = cinDecode.framesQueued;
+		for ( i = 0 ; i < CIN_QUEUE_FRAMES ; i++ ) {
+			cinDecode.frames[i].samples = 0;
+		}
+	}
+}
+
+/*
+==================
+CIN_StopDecode
+==================
+*/
+static void CIN_StopDecode( void ) {
+	CIN_FlushDecode( qtrue );
+
+	if ( !cinDecode.thread ) {
+		return;
+	}
+
+	cinDecode.quit = qtrue;
+	Sys_PostSemaphore( cinDecode.work );
+	Sys_JoinThread( cinDecode.thread );
+	cinDecode.thread = NULL;
+
+	Sys_DestroySemaphore( cinDecode.work );
+	Sys_DestroySemaphore( cinDecode.done );
+	cinDecode.work = cinDecode.done = NULL;
+}
+
+/*
+==================
+CIN_QueueCommand
+==================
+*/
+static cinCommand_t *CIN_QueueCommand( int id, byte *data ) {
+	cinCommand_t	*cmd;
+	int				size = cinTable[currentHandle].RoQFrameSize;
+
+	// room for it
+	CIN_WaitCommands( cinDecode.commandsQueued - CIN_COMMANDS + 1 );
+
+	cmd = &cinDecode.commands[cinDecode.commandsQueued % CIN_COMMANDS];
+	cmd->id = id;
+	cmd->flags = cinTable[currentHandle].roq_flags;
+	cmd->roqF0 = cinTable[currentHandle].roqF0;
+	cmd->roqF1 = cinTable[currentHandle].roqF1;
+	cmd->frame = cinTable[currentHandle].numQuads;
+	cmd->size = size;
+	Com_Memcpy( cmd->data, data, size );
+
+	return cmd;
+}
+
+/*
+==================
+CIN_SendCommand
+==================
+*/
+static void CIN_SendCommand( void ) {
+	if ( !cinDecode.thread ) {
+		CIN_RunCommand( &cinDecode.commands[cinDecode.commandsQueued % CIN_COMMANDS] );
+		cinDecode.commandsQueued++;
+		cinDecode.commandsDone++;
+		return;
+	}
+
+	cinDecode.commandsQueued++;
+	Sys_PostSemaphore( cinDecode.work );
+}
+
+/*
+==================
+CIN_ShowFrame
+
+The oldest queued frame goes up, and the sound that came before it to the
+mixer
+==================
+*/
+static void CIN_ShowFrame( void ) {
+	cinFrame_t	*frame = &cinDecode.frames[cinDecode.framesShown % CIN_QUEUE_FRAMES];
+
+	CIN_WaitCommands( frame->command + 1 );
+
+	if ( frame->samples ) {
+		S_RawSamples( 0, frame->samples, 22050, 2, frame->channels, (byte *)frame->audio, 1.0f, -1 );
+		frame->samples = 0;
+	}
+
+	cinTable[currentHandle].buf = frame->pixels;
+	cinTable[currentHandle].dirty = qtrue;
+	cinDecode.framesShown++;
+}
+
+/*
+==================
+CIN_ShowFrames
+==================
+*/
+static void CIN_ShowFrames( void ) {
+	while ( cinDecode.framesShown != cinDecode.framesQueued ) {
+		if ( cinDecode.frames[cinDecode.framesShown % CIN_QUEUE_FRAMES].number > cinTable[currentHandle].tfps ) {
+			break;
 		}
+		CIN_ShowFrame();
 	}
 }
 
+/*
+==================
+CIN_ParseAhead
+
+Whether the client may read further, the end of the stream waits for the
+last frame to have had its time
+==================
+*/
+static qboolean CIN_ParseAhead( void ) {
+	int		queued = cinDecode.framesQueued - cinDecode.framesShown;
+
+	if ( cinTable[currentHandle].RoQPlayed >= cinTable[currentHandle].ROQSize ) {
+		return queued == 0 && cinTable[currentHandle].tfps != cinTable[currentHandle].numQuads;
+	}
+
+	return queued < CIN_QUEUE_FRAMES - 1;
+}
+
+/*
+==================
+CIN_QueueCodeBook
+==================
+*/
+static void CIN_QueueCodeBook( byte *data ) {
+	CIN_QueueCommand( ROQ_CODEBOOK, data );
+	CIN_SendCommand();
+}
+
+/*
+==================
+CIN_QueueFrame
+==================
+*/
+static void CIN_QueueFrame( byte *data ) {
+	cinFrame_t	*frame;
+
+	// a packet with several frames in it, only the last was ever seen
+	while ( cinDecode.framesQueued - cinDecode.framesShown >= CIN_QUEUE_FRAMES - 1 ) {
+		CIN_ShowFrame();
+	}
+
+	frame = &cinDecode.frames[cinDecode.framesQueued % CIN_QUEUE_FRAMES];
+	frame->number = cinTable[currentHandle].numQuads + 1;
+	frame->command = cinDecode.commandsQueued;
+
+	CIN_QueueCommand( ROQ_QUAD_VQ, data );
+	cinDecode.framesQueued++;
+	CIN_SendCommand();
+}
+
+/*
+==================
+CIN_QueueSamples
+
+Held back for the next frame, before the first one they play right away
+==================
+*/
+static void CIN_QueueSamples( short *samples, int count, int channels ) {
+	cinFrame_t	*frame = &cinDecode.frames[cinDecode.framesQueued % CIN_QUEUE_FRAMES];
+
+	if ( cinTable[currentHandle].numQuads >= 0 && count * channels <= ARRAY_LEN( frame->audio ) ) {
+		if ( !frame->samples ) {
+			frame->channels = channels;
+		}
+
+		if ( frame->channels == channels && ( frame->samples + count ) * channels <= ARRAY_LEN( frame->audio ) ) {
+			Com_Memcpy( frame->audio + frame->samples * channels, samples, count * channels * sizeof( short ) );
+			frame->samples += count;
+			return;
+		}
+	}
+
+	if ( frame->samples ) {
+		S_RawSamples( 0, frame->samples, 22050, 2, frame->channels, (byte *)frame->audio, 1.0f, -1 );
+		frame->samples = 0;
+	}
+	S_RawSamples( 0, count, 22050, 2, channels, (byte *)samples, 1.0f, -1 );
+}
+
 /******************************************************************************
 *
 * Function:		
@@ -1126,30 +1477,16 @@ redump:
 	switch(cinTable[currentHandle].roq_id) 
 	{
 		case	ROQ_QUAD_VQ:
-			if ((cinTable[currentHandle].numQuads&1)) {
-				cinTable[currentHandle].normalBuffer0 = cinTable[currentHandle].t[1];
-				RoQPrepMcomp( cinTable[currentHandle].roqF0, cinTable[currentHandle].roqF1 );
-				cinTable[currentHandle].VQ1( (byte *)cin.qStatus[1], framedata);
-				cinTable[currentHandle].buf = 	cin.linbuf + cinTable[currentHandle].screenDelta;
-			} else {
-				cinTable[currentHandle].normalBuffer0 = cinTable[currentHandle].t[0];
-				RoQPrepMcomp( cinTable[currentHandle].roqF0, cinTable[currentHandle].roqF1 );
-				cinTable[currentHandle].VQ0( (byte *)cin.qStatus[0], framedata );
-				cinTable[currentHandle].buf = 	cin.linbuf;
-			}
-			if (cinTable[currentHandle].numQuads == 0) {		// first frame
-				Com_Memcpy(cin.linbuf+cinTable[currentHandle].screenDelta, cin.linbuf, cinTable[currentHandle].samplesPerLine*cinTable[currentHandle].ysize);
-			}
+			CIN_QueueFrame( framedata );
 			cinTable[currentHandle].numQuads++;
-			cinTable[currentHandle].dirty = qtrue;
 			break;
 		case	ROQ_CODEBOOK:
-			decodeCodeBook( framedata, (unsigned short)cinTable[currentHandle].roq_flags );
+			CIN_QueueCodeBook( framedata );
 			break;
 		case	ZA_SOUND_MONO:
 			if (!cinTable[currentHandle].silent) {
 				ssize = RllDecodeMonoToStereo( framedata, sbuf, cinTable[currentHandle].RoQFrameSize, 0, (unsigned short)cinTable[currentHandle].roq_flags);
-                                S_RawSamples(0, ssize, 22050, 2, 1, (byte *)sbuf, 1.0f, -1);
+				CIN_QueueSamples( sbuf, ssize, 1 );
 			}
 			break;
 		case	ZA_SOUND_STEREO:
@@ -1159,11 +1496,13 @@ redump:
 					s_rawend[0] = s_soundtime;
 				}
 				ssize = RllDecodeStereoToStereo( framedata, sbuf, cinTable[currentHandle].RoQFrameSize, 0, (unsigned short)cinTable[currentHandle].roq_flags);
-                                S_RawSamples(0, ssize, 22050, 2, 2, (byte *)sbuf, 1.0f, -1);
+				CIN_QueueSamples( sbuf, ssize, 2 );
 			}
 			break;
 		case	ROQ_QUAD_INFO:
 			if (cinTable[currentHandle].numQuads == -1) {
+				// the decoder reads what these set up
+				CIN_FlushDecode( qfalse );
 				readQuadInfo( framedata );
 				setupQuad( 0, 0 );
 				cinTable[currentHandle].startTime = cinTable[currentHandle].lastTime = CL_ScaledMilliseconds();
@@ -1275,6 +1614,10 @@ static void RoQShutdown( void ) {
 	Com_DPrintf("finished cinematic\n");
 	cinTable[currentHandle].status = FMV_IDLE;
 
+	if (currentHandle == cin.currentHandle) {
+		CIN_FlushDecode( qtrue );
+	}
+
 	if (cinTable[currentHandle].iFile) {
 		FS_FCloseFile( cinTable[currentHandle].iFile );
 		cinTable[currentHandle].iFile = 0;
@@ -1341,6 +1684,7 @@ e_status CIN_RunCinematic (int handle)
 	if (handle < 0 || handle>= MAX_VIDEO_HANDLES || cinTable[handle].status == FMV_EOF) return FMV_EOF;
 
 	if (cin.currentHandle != handle) {
+		CIN_FlushDecode( qtrue );
 		currentHandle = handle;
 		cin.currentHandle = currentHandle;
 		cinTable[currentHandle].status = FMV_EOF;
@@ -1370,8 +1714,9 @@ e_status CIN_RunCinematic (int handle)
 	}
 	cinTable[currentHandle].tfps = (((CL_ScaledMilliseconds() - cinTable[currentHandle].startTime)*3)/100);
 
+	// read ahead while there is room in the queue
 	start = cinTable[currentHandle].startTime;
-	while(  (cinTable[currentHandle].tfps != cinTable[currentHandle].numQuads)
+	while(  CIN_ParseAhead()
 		&& (cinTable[currentHandle].status == FMV_PLAY) ) 
 	{
 		RoQInterrupt();
@@ -1381,6 +1726,8 @@ e_status CIN_RunCinematic (int handle)
 		}
 	}
 
+	CIN_ShowFrames();
+
 	cinTable[currentHandle].lastTime = thisTime;
 
 	if (cinTable[currentHandle].status == FMV_LOOPED) {
@@ -1425,6 +1772,9 @@ int CIN_PlayCinematic( const char *arg, int x, int y, int w, int h, int systemBi
 
 	Com_DPrintf("CIN_PlayCinematic( %s )\n", arg);
 
+	CIN_FlushDecode( qtrue );
+	CIN_StartDecode();
+
 	Com_Memset(&cin, 0, sizeof(cinematics_t) );
 	currentHandle = CIN_HandleForVideo();
 
@@ -667,7 +667,6 @@ void Con_DrawNotify (void)
 	int		currentColor;
 
 	currentColor = 7;
-	re.SetColor( g_color_table[currentColor] );
 
 	v = 0;
 	for (i= currentCon->current-NUM_CON_TIMES+1 ; i<=currentCon->current ; i++)
@@ -690,16 +689,15 @@ void Con_DrawNotify (void)
 			if ( ( text[x] & 0xff ) == ' ' ) {
 				continue;
 			}
-			if ( ( (text[x]>>8)&7 ) != currentColor ) {
-				currentColor = (text[x]>>8)&7;
-				re.SetColor( g_color_table[currentColor] );
-			}
-			SCR_DrawSmallChar( cl_conXOffset->integer + mainCon->xadjust + (x+1)*SMALLCHAR_WIDTH, v, text[x] & 0xff );
+			currentColor = (text[x]>>8)&7;
+			SCR_AddSmallChar( cl_conXOffset->integer + mainCon->xadjust + (x+1)*SMALLCHAR_WIDTH, v, text[x] & 0xff,
+				g_color_table[currentColor] );
 		}
 
 		v += SMALLCHAR_HEIGHT;
 	}
 
+	SCR_FlushGlyphs();
 	re.SetColor( NULL );
 
 	if (Key_GetCatcher( ) & (KEYCATCH_UI | KEYCATCH_CGAME) ) {
@@ -829,13 +827,11 @@ void Con_DrawSolidConsole( float frac ) {
 
 	// draw the version number
 
-	re.SetColor( g_color_table[ColorIndex(COLOR_RED)] );
-
 	i = strlen( Q3_VERSION );
 
 	for (x=0 ; x<i ; x++) {
-		SCR_DrawSmallChar( cls.glconfig.vidWidth - ( i - x + 1 ) * SMALLCHAR_WIDTH,
-			lines - SMALLCHAR_HEIGHT, Q3_VERSION[x] );
+		SCR_AddSmallChar( cls.glconfig.vidWidth - ( i - x + 1 ) * SMALLCHAR_WIDTH,
+			lines - SMALLCHAR_HEIGHT, Q3_VERSION[x], g_color_table[ColorIndex(COLOR_RED)] );
 	}
 
 
@@ -849,9 +845,9 @@ void Con_DrawSolidConsole( float frac ) {
 	if (currentCon->display != currentCon->current)
 	{
 	// draw arrows to show the buffer is backscrolled
-		re.SetColor( g_color_table[ColorIndex(COLOR_RED)] );
 		for (x=0 ; x<currentCon->linewidth ; x+=4)
-			SCR_DrawSmallChar( currentCon->xadjust + (x+1)*(SMALLCHAR_WIDTH - 1), y, '^' );
+			SCR_AddSmallChar( currentCon->xadjust + (x+1)*(SMALLCHAR_WIDTH - 1), y, '^',
+				g_color_table[ColorIndex(COLOR_RED)] );
 		y -= SMALLCHAR_HEIGHT;
 		rows--;
 	}
@@ -863,7 +859,6 @@ void Con_DrawSolidConsole( float frac ) {
 	}
 
 	currentColor = 7;
-	re.SetColor( g_color_table[currentColor] );
 
 	for (i=0 ; i<rows ; i++, y -= SMALLCHAR_HEIGHT, row--)
 	{
@@ -883,12 +878,14 @@ void Con_DrawSolidConsole( float frac ) {
 
 			if ( ( (text[x]>>8)&7 ) != currentColor ) {
 				currentColor = (text[x] >> 8) % 10;
-				re.SetColor( g_color_table[currentColor] );
 			}
-			SCR_DrawSmallChar(  currentCon->xadjust + (x+1)*(SMALLCHAR_WIDTH - 1), y, text[x] & 0xff );
+			SCR_AddSmallChar( currentCon->xadjust + (x+1)*(SMALLCHAR_WIDTH - 1), y, text[x] & 0xff,
+				g_color_table[currentColor] );
 		}
 	}
 
+	SCR_FlushGlyphs();
+
 	// draw the input prompt, user text, and cursor if desired
 	Con_DrawInput ();
 
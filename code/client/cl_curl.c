@@ -174,29 +174,104 @@ void CL_cURL_Shutdown( void )
 #endif /* USE_CURL_DLOPEN */
 }
 
-void CL_cURL_Cleanup(void)
+/*
+A download starts with one connection asking for the rest of the file
+from the end of what is already in the .tmp file. If the reply is a
+206 and the file is big enough, what's left is split between
+cl_downloadConnections connections, each asking for its own range.
+Part 0 keeps writing into the .tmp file, the others write into their
+own .tmp<n> files which are appended to it in order once they and all
+the parts before them are done. So the .tmp file always holds a
+complete start of the file, and an interrupted download resumes from
+there the next time.
+*/
+
+#define	MAX_DOWNLOAD_PARTS		8
+#define	DOWNLOAD_MIN_PART		( 1024 * 1024 )		// not worth a connection below this
+#define	DOWNLOAD_COPY_CHUNK		( 64 * 1024 )
+
+typedef struct {
+	CURL			*curl;
+	fileHandle_t	file;				// the same as clc.download for part 0
+	char			tempName[MAX_OSPATH];
+	int				start;
+	int				end;				// one past the last byte, 0 = to the end of the file
+	int				received;
+	qboolean		done;
+} downloadPart_t;
+
+typedef struct {
+	downloadPart_t	parts[MAX_DOWNLOAD_PARTS];
+	int				numParts;
+	int				merged;				// parts in clc.downloadTempName
+	int				total;				// size of the file, 0 until known
+	qboolean		replied;			// part 0 got its first data
+	qboolean		split;				// tried to split already
+	qboolean		rangesOK;			// the server answered with a 206
+	qboolean		restarted;			// the .tmp file was thrown away
+} download_t;
+
+static download_t	dl;
+
+/*
+=================
+CL_cURL_RemoveTemp
+=================
+*/
+static void CL_cURL_RemoveTemp( const char *name )
 {
-	if(clc.downloadCURLM) {
-		CURLMcode result;
+	char *ospath = FS_BuildOSPath( Cvar_VariableString( "fs_homepath" ), name, "" );
+
+	ospath[strlen( ospath ) - 1] = '\0';
+	FS_Remove( ospath );
+}
+
+/*
+=================
+CL_cURL_ReleasePart
+=================
+*/
+static void CL_cURL_ReleasePart( downloadPart_t *part, qboolean removeTemp )
+{
+	CURLMcode result;
 
-		if(clc.downloadCURL) {
-			result = qcurl_multi_remove_handle(clc.downloadCURLM,
-				clc.downloadCURL);
+	if(part->curl) {
+		if(clc.downloadCURLM) {
+			result = qcurl_multi_remove_handle(clc.downloadCURLM, part->curl);
 			if(result != CURLM_OK) {
 				Com_DPrintf("qcurl_multi_remove_handle failed: %s\n", qcurl_multi_strerror(result));
 			}
-			qcurl_easy_cleanup(clc.downloadCURL);
 		}
+		qcurl_easy_cleanup(part->curl);
+		part->curl = NULL;
+	}
+
+	if(part != &dl.parts[0] && part->file) {
+		FS_FCloseFile(part->file);
+		part->file = 0;
+		if(removeTemp) {
+			CL_cURL_RemoveTemp(part->tempName);
+		}
+	}
+}
+
+void CL_cURL_Cleanup(void)
+{
+	int i;
+
+	for(i = 0; i < dl.numParts; i++) {
+		CL_cURL_ReleasePart(&dl.parts[i], qtrue);
+	}
+	Com_Memset(&dl, 0, sizeof(dl));
+
+	if(clc.downloadCURLM) {
+		CURLMcode result;
+
 		result = qcurl_multi_cleanup(clc.downloadCURLM);
 		if(result != CURLM_OK) {
 			Com_DPrintf("CL_cURL_Cleanup: qcurl_multi_cleanup failed: %s\n", qcurl_multi_strerror(result));
 		}
 		clc.downloadCURLM = NULL;
-		clc.downloadCURL = NULL;
-	}
-	else if(clc.downloadCURL) {
-		qcurl_easy_cleanup(clc.downloadCURL);
-		clc.downloadCURL = NULL;
 	}
 
 	if (clc.download) {
@@ -205,21 +280,67 @@ void CL_cURL_Cleanup(void)
 	}
 }
 
-static int CL_cURL_CallbackProgress( void *dummy, double dltotal, double dlnow,
-	double ultotal, double ulnow )
+/*
+=================
+CL_cURL_FirstReply
+
+The first data for part 0 tells whether the server does ranges and
+how big the file is
+=================
+*/
+static void CL_cURL_FirstReply( downloadPart_t *part )
 {
-	clc.downloadSize = (int)dltotal;
-	Cvar_SetValue( "cl_downloadSize", clc.downloadSize );
-	clc.downloadCount = (int)dlnow;
-	Cvar_SetValue( "cl_downloadCount", clc.downloadCount );
-	return 0;
+	long code = 0;
+	double length = -1;
+
+	dl.replied = qtrue;
+	qcurl_easy_getinfo(part->curl, CURLINFO_RESPONSE_CODE, &code);
+	qcurl_easy_getinfo(part->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &length);
+
+	if(code == 206) {
+		dl.rangesOK = qtrue;
+	} else if(code == 200 && part->start > 0) {
+		// the whole file is coming, start the .tmp over
+		Com_DPrintf("Server ignored the range, downloading %s from the start\n", clc.downloadName);
+		FS_FCloseFile(clc.download);
+		clc.download = part->file = FS_SV_FOpenFileWrite(clc.downloadTempName);
+		if(!clc.download) {
+			Com_Error(ERR_DROP, "CL_cURL_FirstReply: failed to open "
+				"%s for writing", clc.downloadTempName);
+		}
+		part->start = 0;
+	}
+
+	if(length > 0) {
+		dl.total = part->start + (int)length;
+	}
 }
 
 static size_t CL_cURL_CallbackWrite(void *buffer, size_t size, size_t nmemb,
 	void *stream)
 {
-	FS_Write( buffer, size*nmemb, ((fileHandle_t*)stream)[0] );
-	return size*nmemb;
+	downloadPart_t *part = stream;
+	size_t length = size*nmemb;
+	fileHandle_t file;
+
+	if(part == &dl.parts[0] && !dl.replied) {
+		CL_cURL_FirstReply(part);
+	}
+
+	// part 0 only learns where it ends once the rest is split off,
+	// a short write stops the transfer there
+	if(part->end && part->start + part->received + length > part->end) {
+		length = part->end - part->start - part->received;
+	}
+
+	// CL_Disconnect may have closed the .tmp file under us
+	file = (part == &dl.parts[0]) ? clc.download : part->file;
+	if(!file)
+		return 0;
+
+	FS_Write( buffer, length, file );
+	part->received += length;
+	return length;
 }
 
 CURLcode qcurl_easy_setopt_warn(CURL *curl, CURLoption option, ...)
@@ -248,10 +369,99 @@ CURLcode qcurl_easy_setopt_warn(CURL *curl, CURLoption option, ...)
 	return result;
 }
 
-void CL_cURL_BeginDownload( const char *localName, const char *remoteURL )
+/*
+=================
+CL_cURL_StartPart
+
+Asks for bytes start to end of clc.downloadURL, written to part->file
+=================
+*/
+static void CL_cURL_StartPart( downloadPart_t *part )
 {
 	CURLMcode result;
+	char range[64];
+
+	part->curl = qcurl_easy_init();
+	if(!part->curl) {
+		Com_Error(ERR_DROP, "CL_cURL_BeginDownload: qcurl_easy_init() "
+			"failed");
+		return;
+	}
+
+	if(part->end) {
+		Com_sprintf(range, sizeof(range), "%i-%i", part->start, part->end - 1);
+	} else {
+		Com_sprintf(range, sizeof(range), "%i-", part->start);
+	}
+
+	if(com_developer->integer)
+		qcurl_easy_setopt_warn(part->curl, CURLOPT_VERBOSE, 1);
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_URL, clc.downloadURL);
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_RANGE, range);
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_TRANSFERTEXT, 0);
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_REFERER, va("ioQ3://%s",
+		NET_AdrToStringwPort(clc.serverAddress)));
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_USERAGENT, va("%s %s",
+		Q3_VERSION, qcurl_version()));
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_WRITEFUNCTION,
+		CL_cURL_CallbackWrite);
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_WRITEDATA, part);
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_FAILONERROR, 1);
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_FOLLOWLOCATION, 1);
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_MAXREDIRS, 5);
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_PROTOCOLS,
+		CURLPROTO_HTTP | CURLPROTO_HTTPS | CURLPROTO_FTP | CURLPROTO_FTPS);
+	qcurl_easy_setopt_warn(part->curl, CURLOPT_BUFFERSIZE, CURL_MAX_READ_SIZE);
+
+	result = qcurl_multi_add_handle(clc.downloadCURLM, part->curl);
+	if(result != CURLM_OK) {
+		qcurl_easy_cleanup(part->curl);
+		part->curl = NULL;
+		Com_Error(ERR_DROP,"CL_cURL_BeginDownload: qcurl_multi_add_handle() failed: %s", qcurl_multi_strerror(result));
+		return;
+	}
+}
+
+/*
+=================
+CL_cURL_StartFile
+
+(Re)starts part 0 from the end of the .tmp file
+=================
+*/
+static void CL_cURL_StartFile( qboolean resume )
+{
+	downloadPart_t *part = &dl.parts[0];
+
+	if(resume)
+		clc.download = FS_SV_FOpenFileAppend(clc.downloadTempName);
+	else
+		clc.download = FS_SV_FOpenFileWrite(clc.downloadTempName);
+	if(!clc.download) {
+		Com_Error(ERR_DROP, "CL_cURL_BeginDownload: failed to open "
+			"%s for writing", clc.downloadTempName);
+		return;
+	}
+
+	FS_Seek(clc.download, 0, FS_SEEK_END);
 
+	Com_Memset(part, 0, sizeof(*part));
+	part->file = clc.download;
+	part->start = FS_FTell(clc.download);
+	if(part->start > 0) {
+		Com_Printf("Resuming at %i KB\n", part->start / 1024);
+	}
+
+	dl.numParts = 1;
+	dl.merged = 0;
+	dl.total = 0;
+	dl.replied = dl.split = dl.rangesOK = qfalse;
+
+	CL_cURL_StartPart(part);
+}
+
+void CL_cURL_BeginDownload( const char *localName, const char *remoteURL )
+{
 	Com_Printf("URL: %s\n", remoteURL);
 	Com_DPrintf("***** CL_cURL_BeginDownload *****\n"
 		"Localname: %s\n"
@@ -270,56 +480,16 @@ void CL_cURL_BeginDownload( const char *localName, const char *remoteURL )
 	Cvar_SetValue("cl_downloadTime", cls.realtime);
 
 	clc.downloadCount = 0;
+	clc.downloadSize = 0;
 
-	clc.downloadCURL = qcurl_easy_init();
-	if(!clc.downloadCURL) {
-		Com_Error(ERR_DROP, "CL_cURL_BeginDownload: qcurl_easy_init() "
-			"failed");
-		return;
-	}
-	clc.download = FS_SV_FOpenFileWrite(clc.downloadTempName);
-	if(!clc.download) {
-		Com_Error(ERR_DROP, "CL_cURL_BeginDownload: failed to open "
-			"%s for writing", clc.downloadTempName);
-		return;
-	}
-
-	if(com_developer->integer)
-		qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_VERBOSE, 1);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_URL, clc.downloadURL);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_TRANSFERTEXT, 0);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_REFERER, va("ioQ3://%s",
-		NET_AdrToStringwPort(clc.serverAddress)));
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_USERAGENT, va("%s %s",
-		Q3_VERSION, qcurl_version()));
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_WRITEFUNCTION,
-		CL_cURL_CallbackWrite);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_WRITEDATA, &clc.download);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_NOPROGRESS, 0);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_PROGRESSFUNCTION,
-		CL_cURL_CallbackProgress);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_PROGRESSDATA, NULL);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_FAILONERROR, 1);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_FOLLOWLOCATION, 1);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_MAXREDIRS, 5);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_PROTOCOLS,
-		CURLPROTO_HTTP | CURLPROTO_HTTPS | CURLPROTO_FTP | CURLPROTO_FTPS);
-	qcurl_easy_setopt_warn(clc.downloadCURL, CURLOPT_BUFFERSIZE, CURL_MAX_READ_SIZE);
-	clc.downloadCURLM = qcurl_multi_init();	
+	clc.downloadCURLM = qcurl_multi_init();
 	if(!clc.downloadCURLM) {
-		qcurl_easy_cleanup(clc.downloadCURL);
-		clc.downloadCURL = NULL;
 		Com_Error(ERR_DROP, "CL_cURL_BeginDownload: qcurl_multi_init() "
 			"failed");
 		return;
 	}
-	result = qcurl_multi_add_handle(clc.downloadCURLM, clc.downloadCURL);
-	if(result != CURLM_OK) {
-		qcurl_easy_cleanup(clc.downloadCURL);
-		clc.downloadCURL = NULL;
-		Com_Error(ERR_DROP,"CL_cURL_BeginDownload: qcurl_multi_add_handle() failed: %s", qcurl_multi_strerror(result));
-		return;
-	}
+
+	CL_cURL_StartFile(qtrue);
 
 	if(!(cl_autodownload->integer & DLF_NO_DISCONNECT) &&
 		!clc.cURLDisconnected) {
@@ -332,10 +502,152 @@ void CL_cURL_BeginDownload( const char *localName, const char *remoteURL )
 	}
 }
 
+/*
+=================
+CL_cURL_Split
+
+Hands what part 0 hasn't got yet to more connections
+=================
+*/
+static void CL_cURL_Split( void )
+{
+	downloadPart_t *part;
+	int i, count, size, position;
+
+	dl.split = qtrue;
+
+	position = dl.parts[0].start + dl.parts[0].received;
+	count = cl_downloadConnections->integer;
+	if(count > MAX_DOWNLOAD_PARTS)
+		count = MAX_DOWNLOAD_PARTS;
+	if(count > (dl.total - position) / DOWNLOAD_MIN_PART)
+		count = (dl.total - position) / DOWNLOAD_MIN_PART;
+	if(count < 2)
+		return;
+
+	for(i = 1; i < count; i++) {
+		part = &dl.parts[i];
+		Com_Memset(part, 0, sizeof(*part));
+		Com_sprintf(part->tempName, sizeof(part->tempName), "%s%i",
+			clc.downloadTempName, i);
+		part->file = FS_SV_FOpenFileWrite(part->tempName);
+		if(!part->file)
+			break;
+	}
+	count = i;
+	if(count < 2)
+		return;
+
+	size = (dl.total - position) / count;
+	dl.parts[0].end = position + size;
+
+	for(i = 1; i < count; i++) {
+		part = &dl.parts[i];
+		part->start = position + i * size;
+		part->end = (i == count - 1) ? dl.total : part->start + size;
+		dl.numParts++;
+		CL_cURL_StartPart(part);
+	}
+
+	Com_DPrintf("Downloading %s over %i connections\n", clc.downloadName, dl.numParts);
+}
+
+/*
+=================
+CL_cURL_Merge
+
+Appends the finished parts that follow the .tmp file to it
+=================
+*/
+static void CL_cURL_Merge( void )
+{
+	downloadPart_t *part;
+	fileHandle_t f;
+	byte *buffer;
+	int length, chunk;
+
+	while(dl.merged < dl.numParts && dl.parts[dl.merged].done) {
+		part = &dl.parts[dl.merged++];
+		if(part == &dl.parts[0]) {
+			continue;
+		}
+
+		FS_FCloseFile(part->file);
+		part->file = 0;
+
+		length = FS_SV_FOpenFileRead(part->tempName, &f);
+		if(!f || length != part->received) {
+			if(f)
+				FS_FCloseFile(f);
+			CL_cURL_RemoveTemp(part->tempName);
+			CL_cURL_Cleanup();
+			Com_Error(ERR_DROP, "Download Error: lost part of %s", clc.downloadName);
+			return;
+		}
+
+		buffer = Z_Malloc(DOWNLOAD_COPY_CHUNK);
+		while(length > 0) {
+			chunk = FS_Read(buffer, length < DOWNLOAD_COPY_CHUNK ? length : DOWNLOAD_COPY_CHUNK, f);
+			if(chunk <= 0)
+				break;
+			FS_Write(buffer, chunk, clc.download);
+			length -= chunk;
+		}
+		Z_Free(buffer);
+		FS_FCloseFile(f);
+		CL_cURL_RemoveTemp(part->tempName);
+	}
+}
+
+/*
+=================
+CL_cURL_PartDone
+
+Returns qfalse if the download failed
+=================
+*/
+static qboolean CL_cURL_PartDone( downloadPart_t *part, CURLcode result )
+{
+	long code = 0;
+	int expected;
+
+	qcurl_easy_getinfo(part->curl, CURLINFO_RESPONSE_CODE, &code);
+
+	// no range reply means the whole file was sent
+	expected = part->end ? part->end - part->start : part->received;
+	if(result == CURLE_WRITE_ERROR && part->end && part->received == expected)
+		result = CURLE_OK;
+	else if(result == CURLE_OK && part->received != expected)
+		result = CURLE_PARTIAL_FILE;
+
+	if(result == CURLE_OK) {
+		CL_cURL_ReleasePart(part, qfalse);
+		part->done = qtrue;
+		return qtrue;
+	}
+
+	// the .tmp file is no start of what the server has now, start over once
+	if(part == &dl.parts[0] && code == 416 && part->start > 0 && !dl.restarted) {
+		Com_Printf("Can't resume %s, downloading it again\n", clc.downloadName);
+		dl.restarted = qtrue;
+		CL_cURL_ReleasePart(part, qfalse);
+		FS_FCloseFile(clc.download);
+		clc.download = 0;
+		CL_cURL_StartFile(qfalse);
+		return qtrue;
+	}
+
+	CL_cURL_Cleanup();
+	Com_Error(ERR_DROP, "Download Error: %s Code: %ld URL: %s",
+		qcurl_easy_strerror(result), code, clc.downloadURL);
+	return qfalse;
+}
+
 void CL_cURL_PerformDownload(void)
 {
 	CURLMcode res;
 	CURLMsg *msg;
+	downloadPart_t *part;
 	int c;
 	int i = 0;
 
@@ -346,25 +658,41 @@ void CL_cURL_PerformDownload(void)
 	}
 	if(res == CURLM_CALL_MULTI_PERFORM)
 		return;
-	msg = qcurl_multi_info_read(clc.downloadCURLM, &c);
-	if(msg == NULL) {
-		return;
-	}
-	FS_FCloseFile(clc.download);
-	if(msg->msg == CURLMSG_DONE && msg->data.result == CURLE_OK) {
-		FS_SV_Rename(clc.downloadTempName, clc.downloadName, qfalse);
-		clc.downloadRestart = qtrue;
-	}
-	else {
-		long code;
-
-		qcurl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE,
-			&code);	
-		Com_Error(ERR_DROP, "Download Error: %s Code: %ld URL: %s",
-			qcurl_easy_strerror(msg->data.result),
-			code, clc.downloadURL);
+
+	if(dl.replied && dl.rangesOK && !dl.split && dl.total)
+		CL_cURL_Split();
+
+	while((msg = qcurl_multi_info_read(clc.downloadCURLM, &c)) != NULL) {
+		if(msg->msg != CURLMSG_DONE)
+			continue;
+
+		for(i = 0, part = dl.parts; i < dl.numParts; i++, part++) {
+			if(part->curl == msg->easy_handle)
+				break;
+		}
+		if(i == dl.numParts)
+			continue;
+
+		if(!CL_cURL_PartDone(part, msg->data.result))
+			return;
 	}
 
+	CL_cURL_Merge();
+
+	clc.downloadSize = dl.total;
+	clc.downloadCount = dl.parts[0].start;
+	for(i = 0; i < dl.numParts; i++)
+		clc.downloadCount += dl.parts[i].received;
+	Cvar_SetValue( "cl_downloadSize", clc.downloadSize );
+	Cvar_SetValue( "cl_downloadCount", clc.downloadCount );
+
+	if(dl.merged < dl.numParts)
+		return;
+
+	CL_cURL_Cleanup();
+	FS_SV_Rename(clc.downloadTempName, clc.downloadName, qfalse);
+	clc.downloadRestart = qtrue;
+
 	CL_NextDownload();
 }
 #endif /* USE_CURL */
@@ -26,6 +26,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 unsigned	frame_msec;
 int			old_com_frameTime;
 
+// what the usercmd being built is for, once a frame or at cl_cmdRate
+static int	cmd_time;			// com_frameTime based
+static int	cmd_serverTime;
+static int	cmd_frametime;		// cls.frametime or the cl_cmdRate period
+
 /*
 ===============================================================================
 
@@ -166,13 +171,14 @@ float CL_KeyState( kbutton_t *key ) {
 	key->msec = 0;
 
 	if ( key->active ) {
-		// still down
+		// still down, a press after this command counts towards the next
 		if ( !key->downtime ) {
-			msec = com_frameTime;
-		} else {
-			msec += com_frameTime - key->downtime;
+			msec = cmd_time;
+			key->downtime = cmd_time;
+		} else if ( cmd_time - key->downtime > 0 ) {
+			msec += cmd_time - key->downtime;
+			key->downtime = cmd_time;
 		}
-		key->downtime = com_frameTime;
 	}
 
 #if 0
@@ -293,9 +299,9 @@ void CL_AdjustAngles( void ) {
 	float	speed;
 	
 	if ( in_speed.active ) {
-		speed = 0.001 * cls.frametime * cl_anglespeedkey->value;
+		speed = 0.001 * cmd_frametime * cl_anglespeedkey->value;
 	} else {
-		speed = 0.001 * cls.frametime;
+		speed = 0.001 * cmd_frametime;
 	}
 
 	if ( !in_strafe.active ) {
@@ -365,8 +371,21 @@ void CL_MouseEvent( int dx, int dy, int time ) {
 	} else if (Key_GetCatcher( ) & KEYCATCH_CGAME) {
 		VM_Call (cgvm, CG_MOUSE_EVENT, dx, dy);
 	} else {
-		cl.mouseDx[cl.mouseIndex] += dx;
-		cl.mouseDy[cl.mouseIndex] += dy;
+		mouseSample_t	*sample;
+
+		// a full ring only happens over a long hitch, fold into the newest
+		if ( cl.mouseSampleHead - cl.mouseSampleTail >= MAX_MOUSE_SAMPLES ) {
+			sample = &cl.mouseSamples[( cl.mouseSampleHead - 1 ) & MOUSE_SAMPLE_MASK];
+			sample->dx += dx;
+			sample->dy += dy;
+			return;
+		}
+
+		sample = &cl.mouseSamples[cl.mouseSampleHead & MOUSE_SAMPLE_MASK];
+		sample->time = time;
+		sample->dx = dx;
+		sample->dy = dy;
+		cl.mouseSampleHead++;
 	}
 }
 
@@ -403,9 +422,9 @@ void CL_JoystickMove( usercmd_t *cmd ) {
 	}
 
 	if ( in_speed.active ) {
-		anglespeed = 0.001 * cls.frametime * cl_anglespeedkey->value;
+		anglespeed = 0.001 * cmd_frametime * cl_anglespeedkey->value;
 	} else {
-		anglespeed = 0.001 * cls.frametime;
+		anglespeed = 0.001 * cmd_frametime;
 	}
 
 	if ( !in_strafe.active ) {
@@ -429,33 +448,15 @@ void CL_JoystickMove( usercmd_t *cmd ) {
 
 /*
 =================
-CL_MouseMove
+CL_MouseAccel
+
+Sensitivity and acceleration for motion that took msec
 =================
 */
-
-void CL_MouseMove(usercmd_t *cmd)
+static void CL_MouseAccel(float *pmx, float *pmy, float msec)
 {
-	float mx, my;
+	float mx = *pmx, my = *pmy;
 
-	// allow mouse smoothing
-	if (m_filter->integer)
-	{
-		mx = (cl.mouseDx[0] + cl.mouseDx[1]) * 0.5f;
-		my = (cl.mouseDy[0] + cl.mouseDy[1]) * 0.5f;
-	}
-	else
-	{
-		mx = cl.mouseDx[cl.mouseIndex];
-		my = cl.mouseDy[cl.mouseIndex];
-	}
-	
-	cl.mouseIndex ^= 1;
-	cl.mouseDx[cl.mouseIndex] = 0;
-	cl.mouseDy[cl.mouseIndex] = 0;
-
-	if (mx == 0.0f && my == 0.0f)
-		return;
-	
 	if (cl_mouseAccel->value != 0.0f)
 	{
 		if(cl_mouseAccelStyle->integer == 0)
@@ -463,7 +464,7 @@ void CL_MouseMove(usercmd_t *cmd)
 			float accelSensitivity;
 			float rate;
 			
-			rate = sqrt(mx * mx + my * my) / (float) frame_msec;
+			rate = sqrt(mx * mx + my * my) / msec;
 
 			accelSensitivity = cl_sensitivity->value + rate * cl_mouseAccel->value;
 			mx *= accelSensitivity;
@@ -482,8 +483,8 @@ void CL_MouseMove(usercmd_t *cmd)
 			// cl_mouseAccelOffset is the rate for which the acceleration will have doubled the non accelerated amplification
 			// NOTE: decouple the config cvars for independent acceleration setup along X and Y?
 
-			rate[0] = fabs(mx) / (float) frame_msec;
-			rate[1] = fabs(my) / (float) frame_msec;
+			rate[0] = fabs(mx) / msec;
+			rate[1] = fabs(my) / msec;
 
 			if(cl_mouseAccelStyle->integer == 1)
 			{
@@ -518,6 +519,78 @@ void CL_MouseMove(usercmd_t *cmd)
 		my *= cl_sensitivity->value;
 	}
 
+
+	*pmx = mx;
+	*pmy = my;
+}
+
+/*
+=================
+CL_MouseMove
+
+Takes the motion stamped up to the time of this command, anything later
+waits for the next one. Without m_filter acceleration goes by the rate of
+each sample, so it doesn't change with the framerate.
+=================
+*/
+
+void CL_MouseMove(usercmd_t *cmd)
+{
+	mouseSample_t *sample;
+	float mx, my;
+	float dx, dy, msec;
+	int lastTime;
+
+	mx = my = 0.0f;
+	lastTime = cl.mouseTime;
+
+	while(cl.mouseSampleTail != cl.mouseSampleHead)
+	{
+		sample = &cl.mouseSamples[cl.mouseSampleTail & MOUSE_SAMPLE_MASK];
+		if(sample->time - cmd_time > 0)
+			break;
+
+		cl.mouseDx[cl.mouseIndex] += sample->dx;
+		cl.mouseDy[cl.mouseIndex] += sample->dy;
+
+		if(!m_filter->integer)
+		{
+			msec = sample->time - lastTime;
+			if(msec < 1)
+				msec = 1;
+			else if(msec > frame_msec)
+				msec = frame_msec;
+
+			dx = sample->dx;
+			dy = sample->dy;
+			CL_MouseAccel(&dx, &dy, msec);
+			mx += dx;
+			my += dy;
+		}
+
+		if(sample->time - lastTime > 0)
+			lastTime = sample->time;
+		cl.mouseSampleTail++;
+	}
+	cl.mouseTime = cmd_time;
+
+	// allow mouse smoothing
+	if (m_filter->integer)
+	{
+		mx = (cl.mouseDx[0] + cl.mouseDx[1]) * 0.5f;
+		my = (cl.mouseDy[0] + cl.mouseDy[1]) * 0.5f;
+
+		if (mx != 0.0f || my != 0.0f)
+			CL_MouseAccel(&mx, &my, frame_msec);
+	}
+	
+	cl.mouseIndex ^= 1;
+	cl.mouseDx[cl.mouseIndex] = 0;
+	cl.mouseDy[cl.mouseIndex] = 0;
+
+	if (mx == 0.0f && my == 0.0f)
+		return;
+
 	// ingame FOV
 	mx *= cl.cgameSensitivity;
 	my *= cl.cgameSensitivity;
@@ -580,7 +653,7 @@ void CL_FinishMove( usercmd_t *cmd ) {
 
 	// send the current server time so the amount of movement
 	// can be determined without allowing cheating
-	cmd->serverTime = cl.serverTime;
+	cmd->serverTime = cmd_serverTime;
 
 	for (i=0 ; i<3 ; i++) {
 		cmd->angles[i] = ANGLE2SHORT(cl.viewangles[i]);
@@ -641,20 +714,20 @@ usercmd_t CL_CreateCmd( void ) {
 
 /*
 =================
-CL_CreateNewCommands
+CL_CreateNewCommand
 
-Create a new usercmd_t structure for this frame
+Create a new usercmd_t structure for input up to time, which the server
+gets as serverTime
 =================
 */
-void CL_CreateNewCommands( void ) {
+static void CL_CreateNewCommand( int time, int serverTime, int frametime ) {
 	int			cmdNum;
 
-	// no need to create usercmds until we have a gamestate
-	if ( clc.state < CA_PRIMED ) {
-		return;
-	}
+	cmd_time = time;
+	cmd_serverTime = serverTime;
+	cmd_frametime = frametime;
 
-	frame_msec = com_frameTime - old_com_frameTime;
+	frame_msec = time - old_com_frameTime;
 
 	// if running over 1000fps, act as if each frame is 1ms
 	// prevents divisions by zero
@@ -667,15 +740,178 @@ void CL_CreateNewCommands( void ) {
 	if ( frame_msec > 200 ) {
 		frame_msec = 200;
 	}
-	old_com_frameTime = com_frameTime;
+	old_com_frameTime = time;
 
-
-	// generate a command for this frame
 	cl.cmdNumber++;
 	cmdNum = cl.cmdNumber & CMD_MASK;
 	cl.cmds[cmdNum] = CL_CreateCmd ();
 }
 
+/*
+=================
+CL_CreateNewCommands
+
+Create a new usercmd_t structure for this frame, or with cl_cmdRate one for
+every period that came due since the last, each with the input and server
+time of its own moment, so the server gets them evenly spaced whatever
+the framerate
+=================
+*/
+void CL_CreateNewCommands( void ) {
+	int			period, serverTime, lastServerTime;
+
+	// no need to create usercmds until we have a gamestate
+	if ( clc.state < CA_PRIMED ) {
+		return;
+	}
+
+	if ( cl_cmdRate->integer <= 0 || clc.demoplaying ) {
+		CL_CreateNewCommand( com_frameTime, cl.serverTime, cls.frametime );
+		return;
+	}
+
+	period = 1000 / Com_Clamp( 20, 1000, cl_cmdRate->integer );
+
+	// start over after a hitch or a change of rate
+	if ( com_frameTime - cl.nextCmdTime > 200 || cl.nextCmdTime - com_frameTime > period ) {
+		cl.nextCmdTime = com_frameTime;
+	}
+
+	lastServerTime = cl.cmds[cl.cmdNumber & CMD_MASK].serverTime;
+
+	while ( com_frameTime - cl.nextCmdTime >= 0 ) {
+		serverTime = cl.serverTime - ( com_frameTime - cl.nextCmdTime );
+
+		// the server drops a command that isn't after the last one
+		if ( serverTime > lastServerTime ) {
+			CL_CreateNewCommand( cl.nextCmdTime, serverTime, period );
+			lastServerTime = serverTime;
+		}
+
+		cl.nextCmdTime += period;
+	}
+}
+
+/*
+cl_adaptivePackets picks cl_packetdup and cl_maxpackets from the loss
+seen on the packets coming from the server, the only loss the client
+can measure. Past ADAPT_WINDOW msec the share of dropped packets is
+folded into the estimate, which rises at once and decays slowly. The
+more loss, the more of the previous packets' commands are resent,
+with cl_packetdup as the least. After ADAPT_CLEAN msec without any
+loss, commands are coalesced into about as many packets as the server
+sends snapshots, as more would only reach it between its frames.
+*/
+
+#define	ADAPT_WINDOW	2000
+#define	ADAPT_CLEAN		10000
+
+typedef struct {
+	int		windowStart;		// cls.realtime
+	int		received;
+	int		dropped;
+	int		packetRate;			// from the server, last window
+	int		loss;				// percent
+	int		lossTime;			// cls.realtime of the last window with loss
+
+	int		packetdup;
+	int		maxpackets;			// 0 = cl_maxpackets
+} clAdaptivePackets_t;
+
+static clAdaptivePackets_t	clAdapt;
+
+/*
+=================
+CL_NotePacketLoss
+
+Called for every sequenced packet from the server, with how many before
+it went missing
+=================
+*/
+void CL_NotePacketLoss( int dropped ) {
+	int		windowLoss, msec, packetdup, maxpackets;
+
+	if ( dropped < 0 ) {
+		dropped = 0;
+	}
+	clAdapt.received++;
+	clAdapt.dropped += dropped;
+
+	msec = cls.realtime - clAdapt.windowStart;
+	if ( msec < ADAPT_WINDOW ) {
+		if ( msec < 0 ) {
+			clAdapt.windowStart = cls.realtime;
+		}
+		return;
+	}
+
+	windowLoss = clAdapt.dropped * 100 / ( clAdapt.received + clAdapt.dropped );
+	if ( windowLoss >= clAdapt.loss ) {
+		clAdapt.loss = windowLoss;
+	} else {
+		clAdapt.loss = ( clAdapt.loss * 3 + windowLoss ) / 4;
+	}
+	if ( windowLoss ) {
+		clAdapt.lossTime = cls.realtime;
+	}
+	clAdapt.packetRate = clAdapt.received * 1000 / msec;
+
+	clAdapt.windowStart = cls.realtime;
+	clAdapt.received = 0;
+	clAdapt.dropped = 0;
+
+	// what's left after dup + 1 packets in a row go missing
+	packetdup = 1 + ( clAdapt.loss >= 2 ) + ( clAdapt.loss >= 8 ) + ( clAdapt.loss >= 20 );
+
+	maxpackets = 0;
+	if ( !clAdapt.loss && cls.realtime - clAdapt.lossTime >= ADAPT_CLEAN ) {
+		maxpackets = clAdapt.packetRate;
+	}
+
+	if ( cl_showSend->integer && ( packetdup != clAdapt.packetdup || maxpackets != clAdapt.maxpackets ) ) {
+		Com_Printf( "adaptive packets: %i%% loss, packetdup %i, maxpackets %i\n",
+			clAdapt.loss, packetdup, maxpackets ? maxpackets : cl_maxpackets->integer );
+	}
+	clAdapt.packetdup = packetdup;
+	clAdapt.maxpackets = maxpackets;
+}
+
+/*
+=================
+CL_PacketDup
+=================
+*/
+static int CL_PacketDup( void ) {
+	if ( cl_packetdup->integer < 0 ) {
+		Cvar_Set( "cl_packetdup", "0" );
+	} else if ( cl_packetdup->integer > 5 ) {
+		Cvar_Set( "cl_packetdup", "5" );
+	}
+
+	if ( cl_adaptivePackets->integer && clAdapt.packetdup > cl_packetdup->integer ) {
+		return clAdapt.packetdup;
+	}
+	return cl_packetdup->integer;
+}
+
+/*
+=================
+CL_MaxPackets
+=================
+*/
+static int CL_MaxPackets( void ) {
+	if ( cl_maxpackets->integer < 15 ) {
+		Cvar_Set( "cl_maxpackets", "15" );
+	} else if ( cl_maxpackets->integer > 125 ) {
+		Cvar_Set( "cl_maxpackets", "125" );
+	}
+
+	if ( cl_adaptivePackets->integer && clAdapt.maxpackets && clAdapt.maxpackets < cl_maxpackets->integer ) {
+		return clAdapt.maxpackets < 15 ? 15 : clAdapt.maxpackets;
+	}
+	return cl_maxpackets->integer;
+}
+
 /*
 =================
 CL_ReadyToSendPacket
@@ -722,14 +958,9 @@ qboolean CL_ReadyToSendPacket( void ) {
 	}
 
 	// check for exceeding cl_maxpackets
-	if ( cl_maxpackets->integer < 15 ) {
-		Cvar_Set( "cl_maxpackets", "15" );
-	} else if ( cl_maxpackets->integer > 125 ) {
-		Cvar_Set( "cl_maxpackets", "125" );
-	}
 	oldPacketNum = (clc.netchan.outgoingSequence - 1) & PACKET_MASK;
 	delta = cls.realtime -  cl.outPackets[ oldPacketNum ].p_realtime;
-	if ( delta < 1000 / cl_maxpackets->integer ) {
+	if ( delta < 1000 / CL_MaxPackets() ) {
 		// the accumulated commands will go out in the next packet
 		return qfalse;
 	}
@@ -801,12 +1032,7 @@ void CL_WritePacket( void ) {
 	// we want to send all the usercmds that were generated in the last
 	// few packet, so even if a couple packets are dropped in a row,
 	// all the cmds will make it to the server
-	if ( cl_packetdup->integer < 0 ) {
-		Cvar_Set( "cl_packetdup", "0" );
-	} else if ( cl_packetdup->integer > 5 ) {
-		Cvar_Set( "cl_packetdup", "5" );
-	}
-	oldPacketNum = (clc.netchan.outgoingSequence - 1 - cl_packetdup->integer) & PACKET_MASK;
+	oldPacketNum = (clc.netchan.outgoingSequence - 1 - CL_PacketDup()) & PACKET_MASK;
 	count = cl.cmdNumber - cl.outPackets[ oldPacketNum ].p_cmdNumber;
 	if ( count > MAX_PACKET_USERCMDS ) {
 		count = MAX_PACKET_USERCMDS;
@@ -870,7 +1096,7 @@ void CL_WritePacket( void ) {
 		}
 
 		// begin a client move command
-		if ( cl_nodelta->integer || !cl.snap.valid || clc.demowaiting
+		if ( cl_nodelta->integer || !cl.snap.valid || clc.demowaiting || clc.demoKeyframeWanted
 			|| clc.serverMessageSequence != cl.snap.messageNum ) {
 			MSG_WriteByte (&buf, clc_moveNoDelta);
 		} else {
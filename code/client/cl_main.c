@@ -63,6 +63,7 @@ cvar_t	*rconAddress;
 cvar_t	*cl_timeout;
 cvar_t	*cl_maxpackets;
 cvar_t	*cl_packetdup;
+cvar_t	*cl_cmdRate;
 cvar_t	*cl_timeNudge;
 cvar_t	*cl_showTimeDelta;
 cvar_t	*cl_freezeDemo;
@@ -71,9 +72,24 @@ cvar_t	*cl_shownet;
 cvar_t	*cl_showSend;
 cvar_t	*cl_timedemo;
 cvar_t	*cl_timedemoLog;
+cvar_t	*cl_benchDemos;
+cvar_t	*cl_benchRenderers;
+cvar_t	*cl_benchResults;
+cvar_t	*cl_benchBaseline;
+cvar_t	*cl_benchTolerance;
+cvar_t	*cl_benchFrameLog;
+cvar_t	*cl_demoKeyframes;
+cvar_t	*cl_pingRate;
+cvar_t	*cl_pingConcurrency;
+cvar_t	*cl_pingRetries;
+cvar_t	*cl_mtu;
+cvar_t	*cl_pmtu;
 cvar_t	*cl_autoRecordDemo;
 cvar_t	*cl_aviFrameRate;
 cvar_t	*cl_aviMotionJpeg;
+cvar_t	*cl_aviNV12;
+cvar_t	*cl_aviPipe;
+cvar_t	*cl_aviQueue;
 cvar_t	*cl_forceavidemo;
 
 cvar_t	*cl_freelook;
@@ -104,12 +120,14 @@ cvar_t	*j_up_axis;
 cvar_t	*cl_activeAction;
 
 cvar_t	*cl_autodownload;
+cvar_t	*cl_downloadConnections;
 cvar_t	*cl_conXOffset;
 cvar_t	*cl_inGameVideo;
 
 cvar_t	*cl_serverStatusResendTime;
 
 cvar_t	*cl_lanForcePackets;
+cvar_t	*cl_adaptivePackets;
 
 cvar_t	*cl_guidServerUniq;
 
@@ -629,6 +647,112 @@ CLIENT SIDE DEMO RECORDING
 =======================================================================
 */
 
+/*
+====================
+CL_WriteDemoGamestate
+
+The gamestate message a demo starts with, up to the final svc_EOF
+====================
+*/
+static void CL_WriteDemoGamestate( msg_t *buf, int serverCommandSequence ) {
+	int			i;
+	entityState_t	*ent;
+	entityState_t	nullstate;
+	char		*s;
+
+	// NOTE, MRE: all server->client messages now acknowledge
+	MSG_WriteLong( buf, clc.reliableSequence );
+
+	MSG_WriteByte (buf, svc_gamestate);
+	MSG_WriteLong (buf, serverCommandSequence );
+
+	// configstrings
+	for ( i = 0 ; i < MAX_CONFIGSTRINGS ; i++ ) {
+		if ( !cl.gameState.stringOffsets[i] ) {
+			continue;
+		}
+		s = cl.gameState.stringData + cl.gameState.stringOffsets[i];
+		MSG_WriteByte (buf, svc_configstring);
+		MSG_WriteShort (buf, i);
+		MSG_WriteBigString (buf, s);
+	}
+
+	// baselines
+	Com_Memset (&nullstate, 0, sizeof(nullstate));
+	for ( i = 0; i < MAX_GENTITIES ; i++ ) {
+		ent = &cl.entityBaselines[i];
+		if ( !ent->number ) {
+			continue;
+		}
+		MSG_WriteByte (buf, svc_baseline);		
+		MSG_WriteDeltaEntity (buf, &nullstate, ent, qtrue );
+	}
+
+	MSG_WriteByte( buf, svc_EOF );
+	
+	// finished writing the gamestate stuff
+
+	// write the client num
+	MSG_WriteLong(buf, clc.clientNum);
+	// write the checksum feed
+	MSG_WriteLong(buf, clc.checksumFeed);
+}
+
+#ifdef USE_DEMO_FORMAT_42
+/*
+====================
+CL_WriteDemoKeyframe
+
+Written in front of a full snapshot, see DEMO_KEYFRAME
+====================
+*/
+static void CL_WriteDemoKeyframe( void ) {
+	byte		bufData[MAX_MSGLEN];
+	msg_t		buf;
+	demoKeyframe_t	*key;
+	int			i, len;
+
+	clc.demoKeyframeWanted = qfalse;
+	clc.demoKeyframeTime = cl.snap.serverTime;
+
+	// cl.gameState only has the configstrings of the commands the cgame
+	// executed, the ones it hasn't got to go after the gamestate
+	i = clc.lastExecutedServerCommand;
+	if ( i < clc.serverCommandSequence - MAX_RELIABLE_COMMANDS ) {
+		i = clc.serverCommandSequence - MAX_RELIABLE_COMMANDS;
+	}
+
+	MSG_Init (&buf, bufData, sizeof(bufData));
+	MSG_Bitstream(&buf);
+	CL_WriteDemoGamestate( &buf, i );
+	for ( i++ ; i <= clc.serverCommandSequence ; i++ ) {
+		MSG_WriteByte( &buf, svc_serverCommand );
+		MSG_WriteLong( &buf, i );
+		MSG_WriteString( &buf, clc.serverCommands[ i & ( MAX_RELIABLE_COMMANDS - 1 ) ] );
+	}
+	MSG_WriteByte( &buf, svc_EOF );
+
+	if ( buf.overflowed ) {
+		Com_DPrintf( "Demo keyframe overflowed, skipped\n" );
+		return;
+	}
+
+	key = &clc.demoRecordIndex[clc.demoRecordKeyframes++];
+	key->serverTime = cl.snap.serverTime;
+	key->offset = FS_FTell( clc.demofile );
+
+	len = LittleLong( clc.serverMessageSequence - 1 );
+	FS_Write (&len, 4, clc.demofile);
+	len = LittleLong( DEMO_KEYFRAME );
+	FS_Write (&len, 4, clc.demofile);
+
+	len = LittleLong (buf.cursize);
+	FS_Write (&len, 4, clc.demofile);
+	FS_Write (buf.data, buf.cursize, clc.demofile);
+	FS_Write (&len, 4, clc.demofile);
+}
+#endif
+
 /*
 ====================
 CL_WriteDemoMessage
@@ -640,6 +764,21 @@ Dumps the current net message, prefixed by the length
 void CL_WriteDemoMessage ( msg_t *msg, int headerBytes ) {
 	int		len, swlen;
 
+#ifdef USE_DEMO_FORMAT_42
+	// once a keyframe is due the server is asked for a full snapshot, the
+	// VoIP messages cl_input fakes don't count
+	if ( clc.demoKeyframeWanted ) {
+		if ( headerBytes && cl.snap.valid && cl.snap.deltaNum <= 0
+			&& cl.snap.messageNum == clc.serverMessageSequence ) {
+			CL_WriteDemoKeyframe();
+		}
+	} else if ( clc.demoRecordIndex && cl_demoKeyframes->integer > 0
+		&& clc.demoRecordKeyframes < MAX_DEMO_KEYFRAMES
+		&& cl.snap.serverTime - clc.demoKeyframeTime >= cl_demoKeyframes->integer * 1000 ) {
+		clc.demoKeyframeWanted = qtrue;
+	}
+#endif
+
 	// write the packet sequence
 	len = clc.serverMessageSequence;
 	swlen = LittleLong( len );
@@ -667,6 +806,9 @@ stop recording a demo
 */
 void CL_StopRecord_f( void ) {
 	int		len;
+#ifdef USE_DEMO_FORMAT_42
+	int		i;
+#endif
 
 	if ( !clc.demorecording ) {
 		Com_Printf ("Not recording a demo.\n");
@@ -677,6 +819,28 @@ void CL_StopRecord_f( void ) {
 	len = -1;
 	FS_Write (&len, 4, clc.demofile);
 	FS_Write (&len, 4, clc.demofile);
+
+#ifdef USE_DEMO_FORMAT_42
+	// the seek index goes after the end
+	if ( clc.demoRecordIndex ) {
+		for ( i = 0 ; i < clc.demoRecordKeyframes ; i++ ) {
+			len = LittleLong( clc.demoRecordIndex[i].serverTime );
+			FS_Write (&len, 4, clc.demofile);
+			len = LittleLong( clc.demoRecordIndex[i].offset );
+			FS_Write (&len, 4, clc.demofile);
+		}
+		len = LittleLong( clc.demoRecordKeyframes );
+		FS_Write (&len, 4, clc.demofile);
+		len = LittleLong( DEMO_INDEX_MAGIC );
+		FS_Write (&len, 4, clc.demofile);
+
+		Z_Free( clc.demoRecordIndex );
+		clc.demoRecordIndex = NULL;
+		clc.demoRecordKeyframes = 0;
+		clc.demoKeyframeWanted = qfalse;
+	}
+#endif
+
 	FS_FCloseFile (clc.demofile);
 	clc.demofile = 0;
 	clc.demorecording = qfalse;
@@ -721,10 +885,7 @@ void CL_Record_f( void ) {
 	char		name[MAX_OSPATH];
 	byte		bufData[MAX_MSGLEN];
 	msg_t	buf;
-	int			i;
 	int			len;
-	entityState_t	*ent;
-	entityState_t	nullstate;
 	char		*s;
 #ifdef USE_DEMO_FORMAT_42
 	char		*s2;
@@ -812,7 +973,15 @@ void CL_Record_f( void ) {
 	FS_Write( &len, 4, clc.demofile );
 	FS_Write( s2 , size ,  clc.demofile );
 		
-	v = LittleLong( DEMO_VERSION );
+	// without keyframes it stays readable by older clients
+	if ( cl_demoKeyframes->integer > 0 ) {
+		v = LittleLong( DEMO_VERSION_INDEXED );
+		clc.demoRecordIndex = Z_Malloc( MAX_DEMO_KEYFRAMES * sizeof( *clc.demoRecordIndex ) );
+		clc.demoRecordKeyframes = 0;
+		clc.demoKeyframeWanted = qfalse;
+	} else {
+		v = LittleLong( DEMO_VERSION );
+	}
 	FS_Write ( &v, 4 , clc.demofile );
 		
 	len = 0;
@@ -838,47 +1007,21 @@ void CL_Record_f( void ) {
 	// write out the gamestate message
 	MSG_Init (&buf, bufData, sizeof(bufData));
 	MSG_Bitstream(&buf);
-
-	// NOTE, MRE: all server->client messages now acknowledge
-	MSG_WriteLong( &buf, clc.reliableSequence );
-
-	MSG_WriteByte (&buf, svc_gamestate);
-	MSG_WriteLong (&buf, clc.serverCommandSequence );
-
-	// configstrings
-	for ( i = 0 ; i < MAX_CONFIGSTRINGS ; i++ ) {
-		if ( !cl.gameState.stringOffsets[i] ) {
-			continue;
-		}
-		s = cl.gameState.stringData + cl.gameState.stringOffsets[i];
-		MSG_WriteByte (&buf, svc_configstring);
-		MSG_WriteShort (&buf, i);
-		MSG_WriteBigString (&buf, s);
-	}
-
-	// baselines
-	Com_Memset (&nullstate, 0, sizeof(nullstate));
-	for ( i = 0; i < MAX_GENTITIES ; i++ ) {
-		ent = &cl.entityBaselines[i];
-		if ( !ent->number ) {
-			continue;
-		}
-		MSG_WriteByte (&buf, svc_baseline);		
-		MSG_WriteDeltaEntity (&buf, &nullstate, ent, qtrue );
-	}
-
-	MSG_WriteByte( &buf, svc_EOF );
-	
-	// finished writing the gamestate stuff
-
-	// write the client num
-	MSG_WriteLong(&buf, clc.clientNum);
-	// write the checksum feed
-	MSG_WriteLong(&buf, clc.checksumFeed);
+	CL_WriteDemoGamestate( &buf, clc.serverCommandSequence );
 
 	// finished writing the client packet
 	MSG_WriteByte( &buf, svc_EOF );
 
+#ifdef USE_DEMO_FORMAT_42
+	// the gamestate is the first keyframe
+	if ( clc.demoRecordIndex ) {
+		clc.demoRecordIndex[0].serverTime = cl.snap.serverTime;
+		clc.demoRecordIndex[0].offset = FS_FTell( clc.demofile );
+		clc.demoRecordKeyframes = 1;
+		clc.demoKeyframeTime = cl.snap.serverTime;
+	}
+#endif
+
 	// write it to the demo file
 	len = LittleLong( clc.serverMessageSequence - 1 );
 	FS_Write (&len, 4, clc.demofile);
@@ -996,6 +1139,8 @@ void CL_DemoCompleted( void )
 		}
 	}
 
+	CL_BenchDemoCompleted();
+
 	CL_Disconnect( qtrue );
 	CL_NextDemo();
 }
@@ -1014,6 +1159,7 @@ void CL_ReadDemoMessage( void ) {
 #ifdef USE_DEMO_FORMAT_42
 	// skip the end length (read it a second time) ... Is usefull only in backward read /* holblin */
 	int length_backward;
+	qboolean	keyframe;
 #endif
 
 	if ( !clc.demofile ) {
@@ -1027,7 +1173,6 @@ void CL_ReadDemoMessage( void ) {
 		CL_DemoCompleted ();
 		return;
 	}
-	clc.serverMessageSequence = LittleLong( s );
 
 	// init the message
 	MSG_Init( &buf, bufData, sizeof( bufData ) );
@@ -1045,7 +1190,17 @@ void CL_ReadDemoMessage( void ) {
 	}
 	
 #ifdef USE_DEMO_FORMAT_42
-	if ( buf.cursize == 0 ) { // backward read gain the header demo /* holblin */
+	keyframe = ( buf.cursize == DEMO_KEYFRAME );
+	if ( keyframe ) {
+		r = FS_Read (&buf.cursize, 4, clc.demofile);
+		if ( r != 4 ) {
+			CL_DemoCompleted ();
+			return;
+		}
+		buf.cursize = LittleLong( buf.cursize );
+	}
+
+	if ( buf.cursize <= 0 ) { // backward read gain the header demo /* holblin */
 		CL_DemoCompleted ();
 		return;
 	}
@@ -1074,8 +1229,16 @@ void CL_ReadDemoMessage( void ) {
 		CL_DemoCompleted ();
 		return;
 	}
+
+	// the messages before a keyframe already got everything it has, only
+	// a demo_seek starts at one
+	if ( keyframe && !clc.demoReadKeyframe ) {
+		return;
+	}
+	clc.demoReadKeyframe = qfalse;
 #endif
 
+	clc.serverMessageSequence = LittleLong( s );
 	clc.lastPacketTime = cls.realtime;
 	buf.readcount = 0;
 	CL_ParseServerMessage( &buf );
@@ -1168,37 +1331,75 @@ static void CL_CompleteDemoName( char *args, int argNum )
 	}
 }
 
+#ifdef USE_DEMO_FORMAT_42
 /*
 ====================
-CL_PlayDemo_f
+CL_ReadDemoIndex
 
-demo <demoname>
+Loads the seek index from the end of the file, a demo whose recording was
+cut short doesn't have one and seeks from the start
+====================
+*/
+static void CL_ReadDemoIndex( int length ) {
+	int		count, magic, i;
+
+	if ( length < clc.demoDataOffset + 8 ) {
+		return;
+	}
+
+	FS_Seek( clc.demofile, length - 8, FS_SEEK_SET );
+	if ( FS_Read( &count, 4, clc.demofile ) == 4 && FS_Read( &magic, 4, clc.demofile ) == 4 ) {
+		count = LittleLong( count );
+		magic = LittleLong( magic );
+
+		if ( magic == DEMO_INDEX_MAGIC && count > 0 && count <= MAX_DEMO_KEYFRAMES
+			&& length - 8 - count * (int)sizeof( demoKeyframe_t ) >= clc.demoDataOffset ) {
+			clc.demoIndex = Z_Malloc( count * sizeof( *clc.demoIndex ) );
+
+			FS_Seek( clc.demofile, length - 8 - count * sizeof( demoKeyframe_t ), FS_SEEK_SET );
+			if ( FS_Read( clc.demoIndex, count * sizeof( demoKeyframe_t ), clc.demofile ) == count * sizeof( demoKeyframe_t ) ) {
+				for ( i = 0 ; i < count ; i++ ) {
+					clc.demoIndex[i].serverTime = LittleLong( clc.demoIndex[i].serverTime );
+					clc.demoIndex[i].offset = LittleLong( clc.demoIndex[i].offset );
+				}
+				clc.demoKeyframes = count;
+				clc.demoStartTime = clc.demoIndex[0].serverTime;
+			} else {
+				Z_Free( clc.demoIndex );
+				clc.demoIndex = NULL;
+			}
+		}
+	}
+
+	if ( !clc.demoIndex ) {
+		Com_Printf( "Demo has no seek index, seeking starts over\n" );
+	}
 
+	FS_Seek( clc.demofile, clc.demoDataOffset, FS_SEEK_SET );
+}
+#endif
+
+/*
+====================
+CL_StartDemo
+
+Plays a demo from the start, or from the keyframe at offset
 ====================
 */
-void CL_PlayDemo_f( void ) {
+static void CL_StartDemo( const char *demo, int offset ) {
 	char		name[MAX_OSPATH];
 	char		arg[MAX_OSPATH];
 	char		*ext_test;
 #ifdef USE_DEMO_FORMAT_42
-	int			r, len, v1, v2;
+	int			r, len, v2, length;
 	char		*s2;
 #else
 	int			protocol, i;
 	char		retry[MAX_OSPATH];
 #endif
 
-	if (Cmd_Argc() != 2) {
-		Com_Printf ("demo <demoname>\n");
-		return;
-	}
-
-	// make sure a local server is killed
-	// 2 means don't force disconnect of local client
-	Cvar_Set( "sv_killserver", "2" );
-
 	// open the demo file
-	Q_strncpyz( arg, Cmd_Argv(1), sizeof( arg ) );
+	Q_strncpyz( arg, demo, sizeof( arg ) );
 	
 	CL_Disconnect( qtrue );
 
@@ -1211,7 +1412,7 @@ void CL_PlayDemo_f( void ) {
 	} else {
 		Com_sprintf(name, sizeof(name), "demos/%s.urtdemo", arg);
 	}
-	FS_FOpenFileRead( name, &clc.demofile, qtrue );
+	length = FS_FOpenFileRead( name, &clc.demofile, qtrue );
 #else
 	if(ext_test && !Q_stricmpn(ext_test + 1, DEMOEXT, ARRAY_LEN(DEMOEXT) - 1))
 	{
@@ -1282,7 +1483,6 @@ void CL_PlayDemo_f( void ) {
 	}
 	s2[len] = '\0';
 
-	v1 = LittleLong( DEMO_VERSION );
 	r = FS_Read ( &v2, 4 , clc.demofile );
 	if ( r != 4 ) {
 		CL_DemoCompleted ();
@@ -1300,7 +1500,8 @@ void CL_PlayDemo_f( void ) {
 	*/
 	free(s2);
 		
-	if ( v1 != v2 ){
+	v2 = LittleLong( v2 );
+	if ( v2 != DEMO_VERSION && v2 != DEMO_VERSION_INDEXED ){
 		Com_Printf("Protocol %d not supported for demos\n", v2);
 		CL_DemoCompleted ();
 		return;
@@ -1322,6 +1523,19 @@ void CL_PlayDemo_f( void ) {
 #endif
 	/* END HOLBLIN entete demo */ 
 
+	clc.demoDataOffset = FS_FTell( clc.demofile );
+#ifdef USE_DEMO_FORMAT_42
+	if ( v2 == DEMO_VERSION_INDEXED ) {
+		CL_ReadDemoIndex( length );
+	}
+#endif
+
+	// a demo_seek starts over at a keyframe
+	if ( offset > clc.demoDataOffset ) {
+		FS_Seek( clc.demofile, offset, FS_SEEK_SET );
+		clc.demoReadKeyframe = qtrue;
+	}
+
 	clc.state = CA_CONNECTED;
 	clc.demoplaying = qtrue;
 	Q_strncpyz( clc.servername, arg, sizeof( clc.servername ) );
@@ -1344,6 +1558,147 @@ void CL_PlayDemo_f( void ) {
 	clc.firstDemoFrameSkipped = qfalse;
 }
 
+/*
+====================
+CL_PlayDemo_f
+
+demo <demoname>
+
+====================
+*/
+void CL_PlayDemo_f( void ) {
+	if (Cmd_Argc() != 2) {
+		Com_Printf ("demo <demoname>\n");
+		return;
+	}
+
+	// make sure a local server is killed
+	// 2 means don't force disconnect of local client
+	Cvar_Set( "sv_killserver", "2" );
+
+	// a benchmark times the load from here
+	CL_BenchDemoLoading();
+
+	CL_StartDemo( Cmd_Argv(1), 0 );
+}
+
+/*
+====================
+CL_DemoSeekMsec
+
+[[h:]m:]s, seconds may have a fraction
+====================
+*/
+static int CL_DemoSeekMsec( const char *s ) {
+	const char	*colon;
+	float		seconds = 0;
+
+	while ( ( colon = strchr( s, ':' ) ) != NULL ) {
+		seconds = ( seconds + atoi( s ) ) * 60;
+		s = colon + 1;
+	}
+
+	return ( seconds + atof( s ) ) * 1000;
+}
+
+/*
+====================
+CL_DemoSeek_f
+
+demo_seek [+|-][[h:]m:]s
+
+Jumps to a time from the start of the demo, or relative to now with a sign.
+Going back or past a keyframe starts over at the last keyframe before the
+target, then reads ahead from there.
+====================
+*/
+static void CL_DemoSeek_f( void ) {
+	char		demo[MAX_QPATH];
+	const char	*arg;
+	int			now, target, offset, keyTime, i;
+
+	if ( !clc.demoplaying || clc.state != CA_ACTIVE ) {
+		Com_Printf( "Not playing a demo.\n" );
+		return;
+	}
+
+	now = cl.snap.serverTime;
+
+	if ( Cmd_Argc() != 2 ) {
+		Com_Printf( "usage: demo_seek [+|-][[h:]m:]s\n" );
+		Com_Printf( "at %.1f seconds, %d keyframes\n", ( now - clc.demoStartTime ) / 1000.0f, clc.demoKeyframes );
+		return;
+	}
+
+	arg = Cmd_Argv( 1 );
+	if ( *arg == '+' ) {
+		target = now + CL_DemoSeekMsec( arg + 1 );
+	} else if ( *arg == '-' ) {
+		target = now - CL_DemoSeekMsec( arg + 1 );
+	} else {
+		target = clc.demoStartTime + CL_DemoSeekMsec( arg );
+	}
+	if ( target < clc.demoStartTime ) {
+		target = clc.demoStartTime;
+	}
+
+	// the last keyframe at or before the target, or the very start
+	offset = 0;
+	keyTime = clc.demoStartTime;
+	for ( i = 0 ; i < clc.demoKeyframes && clc.demoIndex[i].serverTime <= target ; i++ ) {
+		offset = clc.demoIndex[i].offset;
+		keyTime = clc.demoIndex[i].serverTime;
+	}
+
+	// ahead with no keyframe in between, just read on
+	if ( target >= now && keyTime <= now ) {
+		clc.demoSeekTime = target;
+		return;
+	}
+
+	Q_strncpyz( demo, clc.demoName, sizeof( demo ) );
+	CL_StartDemo( demo, offset );
+	if ( clc.demoplaying ) {
+		clc.demoSeekTime = target;
+	}
+}
+
+/*
+====================
+CL_DemoSeekFrame
+
+Reads ahead to the demo_seek target, stopping short each frame when the
+cgame would lose server commands it hasn't executed yet
+====================
+*/
+void CL_DemoSeekFrame( void ) {
+	int		skipped;
+
+	while ( cl.snap.serverTime < clc.demoSeekTime ) {
+		if ( clc.serverCommandSequence - clc.lastExecutedServerCommand >= MAX_RELIABLE_COMMANDS / 2 ) {
+			break;
+		}
+
+		CL_ReadDemoMessage();
+		if ( clc.state != CA_ACTIVE ) {
+			return;		// end of demo
+		}
+	}
+
+	if ( cl.snap.serverTime >= clc.demoSeekTime ) {
+		clc.demoSeekTime = 0;
+	}
+
+	// move the clock along with it
+	skipped = cl.snap.serverTime - cl.serverTime;
+	if ( skipped > 0 ) {
+		cl.serverTimeDelta += skipped;
+		cl.serverTime += skipped;
+		cl.oldServerTime = cl.serverTime;
+		clc.timeDemoBaseTime += skipped;
+	}
+}
+
 
 /*
 ====================
@@ -1583,6 +1938,11 @@ void CL_Disconnect( qboolean showMainMenu ) {
 	*clc.downloadTempName = *clc.downloadName = 0;
 	Cvar_Set( "cl_downloadName", "" );
 
+	// the next server is probed again
+	if ( cl_pmtu->integer ) {
+		Cvar_Set( "cl_pmtu", "0" );
+	}
+
 #ifdef USE_MUMBLE
 	if (cl_useMumble->integer && mumble_islinked()) {
 		Com_Printf("Mumble: Unlinking from Mumble application\n");
@@ -1616,6 +1976,11 @@ void CL_Disconnect( qboolean showMainMenu ) {
 		clc.demofile = 0;
 	}
 
+	if ( clc.demoIndex ) {
+		Z_Free( clc.demoIndex );
+		clc.demoIndex = NULL;
+	}
+
 	if ( uivm && showMainMenu ) {
 		VM_Call( uivm, UI_SET_ACTIVE_MENU, UIMENU_NONE );
 	}
@@ -2477,6 +2842,83 @@ void CL_InitDownloads(void) {
 	CL_DownloadsComplete();
 }
 
+#define	MTU_PROBE_ROUNDS	3
+#define	MTU_PROBE_MSEC		1000
+
+// link MTUs probed for: jumbo frames, Ethernet and PPPoE
+static const int mtuProbeLinks[] = { 9000, 1500, 1492 };
+
+/*
+=================
+CL_MtuProbeFrame
+
+Once in the game, sends the server a probe of each datagram size that
+fills one of the link MTUs up to cl_mtu, with the don't fragment bit set.
+The server echoes them at the same size, and the largest one that makes
+it back goes in the userinfo as cl_pmtu. Sizes that don't fit are lost on
+the way, a few rounds are sent for what is just packet loss.
+=================
+*/
+static void CL_MtuProbeFrame( void ) {
+	byte	probe[NET_MAX_PACKETLEN];
+	int		i, size;
+
+	if ( clc.state != CA_ACTIVE || clc.demoplaying || clc.mtuProbeRounds >= MTU_PROBE_ROUNDS ) {
+		return;
+	}
+	if ( clc.serverAddress.type != NA_IP && clc.serverAddress.type != NA_IP6 ) {
+		return;
+	}
+	if ( clc.mtuProbeRounds && cls.realtime - clc.mtuProbeTime < MTU_PROBE_MSEC ) {
+		return;
+	}
+
+	clc.mtuProbeRounds++;
+	clc.mtuProbeTime = cls.realtime;
+
+	for ( i = 0 ; i < ARRAY_LEN( mtuProbeLinks ) ; i++ ) {
+		if ( mtuProbeLinks[i] > cl_mtu->integer ) {
+			continue;
+		}
+
+		size = MIN( mtuProbeLinks[i] - NET_UDP_HEADERS( clc.serverAddress.type ), NET_MAX_PACKETLEN );
+		if ( size <= MAX_PACKETLEN || size <= cl_pmtu->integer ) {
+			continue;
+		}
+
+		Com_Memset( probe, 0, size );
+		*(int *)probe = -1;
+		Com_sprintf( (char *)probe + 4, size - 4, "mtuprobe %i %i\n", size, clc.challenge );
+
+		if ( !Sys_SendProbePacket( size, probe, clc.serverAddress ) ) {
+			// without the don't fragment bit the probes would prove nothing
+			clc.mtuProbeRounds = MTU_PROBE_ROUNDS;
+			return;
+		}
+	}
+}
+
+/*
+=================
+CL_MtuProbeResponse
+=================
+*/
+static void CL_MtuProbeResponse( netadr_t from, msg_t *msg ) {
+	int		size;
+
+	if ( !NET_CompareAdr( from, clc.serverAddress ) || atoi( Cmd_Argv( 2 ) ) != clc.challenge ) {
+		return;
+	}
+
+	size = atoi( Cmd_Argv( 1 ) );
+	if ( size > msg->cursize || size > NET_MAX_PACKETLEN || size <= cl_pmtu->integer ) {
+		return;
+	}
+
+	Com_DPrintf( "%i byte datagrams reach %s\n", size, NET_AdrToStringwPort( from ) );
+	Cvar_Set( "cl_pmtu", va( "%i", size ) );
+}
+
 /*
 =================
 CL_CheckForResend
@@ -2886,6 +3328,12 @@ void CL_ConnectionlessPacket( netadr_t from, msg_t *msg ) {
 		return;
 	}
 
+	// a path MTU probe that made it back
+	if ( !Q_stricmp(c, "mtuprobe") ) {
+		CL_MtuProbeResponse( from, msg );
+		return;
+	}
+
 	// echo request from server
 	if ( !Q_stricmp(c, "print") ) {
 		// NOTE: we may have to add exceptions for auth and update servers
@@ -2969,6 +3417,8 @@ void CL_PacketEvent( netadr_t from, msg_t *msg ) {
 	// gamestate
 	clc.serverMessageSequence = LittleLong( *(int *)msg->data );
 
+	CL_NotePacketLoss( clc.netchan.dropped );
+
 	clc.lastPacketTime = cls.realtime;
 	CL_ParseServerMessage( msg );
 
@@ -3165,12 +3615,21 @@ void CL_Frame ( int msec ) {
 	// resend a connection request if necessary
 	CL_CheckForResend();
 
+	// look for a path that takes larger datagrams
+	CL_MtuProbeFrame();
+
+	// send the next burst of server browser pings
+	CL_PingFrame();
+
 	// decide on the serverTime to render
 	CL_SetCGameTime();
 
 	// update the screen
 	SCR_UpdateScreen();
 
+	// time the frame and step a benchmark run
+	CL_BenchFrame();
+
 	// update audio
 	S_Update();
 
@@ -3320,6 +3779,30 @@ void *CL_RefMalloc( int size ) {
 	return Z_TagMalloc( size, TAG_RENDERER );
 }
 
+/*
+============
+CL_RefHunkAlloc
+============
+*/
+#ifdef HUNK_DEBUG
+static void *CL_RefHunkAllocDebug( int size, ha_pref preference, char *label, char *file, int line ) {
+#else
+static void *CL_RefHunkAlloc( int size, ha_pref preference ) {
+#endif
+	memClass_t	oldClass;
+	void		*buf;
+
+	oldClass = Com_SetMemClass( MEMCLASS_RENDERER );
+#ifdef HUNK_DEBUG
+	buf = Hunk_AllocDebug( size, preference, label, file, line );
+#else
+	buf = Hunk_Alloc( size, preference );
+#endif
+	Com_SetMemClass( oldClass );
+
+	return buf;
+}
+
 int CL_ScaledMilliseconds(void) {
 	return Sys_Milliseconds()*com_timescale->value;
 }
@@ -3377,9 +3860,9 @@ void CL_InitRef( void ) {
 	ri.Malloc = CL_RefMalloc;
 	ri.Free = Z_Free;
 #ifdef HUNK_DEBUG
-	ri.Hunk_AllocDebug = Hunk_AllocDebug;
+	ri.Hunk_AllocDebug = CL_RefHunkAllocDebug;
 #else
-	ri.Hunk_Alloc = Hunk_Alloc;
+	ri.Hunk_Alloc = CL_RefHunkAlloc;
 #endif
 	ri.Hunk_AllocateTempMemory = Hunk_AllocateTempMemory;
 	ri.Hunk_FreeTempMemory = Hunk_FreeTempMemory;
@@ -3394,6 +3877,11 @@ void CL_InitRef( void ) {
 	ri.FS_ListFiles = FS_ListFiles;
 	ri.FS_FileIsInPAK = FS_FileIsInPAK;
 	ri.FS_FileExists = FS_FileExists;
+	ri.FS_Inflate = FS_InflateEntry;
+	ri.FS_PakFileCrc = FS_PakFileCrc;
+	ri.FS_PureServerActive = FS_PureServerActive;
+	ri.FS_ReadCacheFile = FS_ReadCacheFile;
+	ri.FS_WriteCacheFile = FS_WriteCacheFile;
 	ri.Cvar_Get = Cvar_Get;
 	ri.Cvar_Set = Cvar_Set;
 	ri.Cvar_SetValue = Cvar_SetValue;
@@ -3407,7 +3895,7 @@ void CL_InitRef( void ) {
 	ri.CIN_PlayCinematic = CIN_PlayCinematic;
 	ri.CIN_RunCinematic = CIN_RunCinematic;
   
-	ri.CL_WriteAVIVideoFrame = CL_WriteAVIVideoFrame;
+	ri.CL_AVIVideoFrameCaptured = CL_AVIVideoFrameCaptured;
 
 	ri.IN_Init = IN_Init;
 	ri.IN_Shutdown = IN_Shutdown;
@@ -3419,6 +3907,19 @@ void CL_InitRef( void ) {
 	ri.Sys_GLimpSafeInit = Sys_GLimpSafeInit;
 	ri.Sys_GLimpInit = Sys_GLimpInit;
 	ri.Sys_LowPhysicalMemory = Sys_LowPhysicalMemory;
+	ri.Sys_GetProcessorFeatures = Sys_GetProcessorFeatures;
+
+	ri.Com_RunParallel = Com_RunParallel;
+	ri.Com_NumWorkers = Com_NumWorkers;
+	ri.Com_WorkerIndex = Com_WorkerIndex;
+	ri.Com_ParallelRange = Com_ParallelRange;
+	ri.Com_AddJobs = Com_AddJobs;
+	ri.Com_JobsDone = Com_JobsDone;
+	ri.Com_WaitJobs = Com_WaitJobs;
+	ri.Com_ScratchAlloc = Com_ScratchAlloc;
+	ri.Com_ScratchMark = Com_ScratchMark;
+	ri.Com_ScratchRelease = Com_ScratchRelease;
+	ri.Microseconds = Sys_Microseconds;
 
 	ret = GetRefAPI( REF_API_VERSION, &ri );
 
@@ -3657,9 +4158,19 @@ void CL_Init( void ) {
 
 	cl_timedemo = Cvar_Get ("timedemo", "0", 0);
 	cl_timedemoLog = Cvar_Get ("cl_timedemoLog", "", CVAR_ARCHIVE);
+	cl_benchDemos = Cvar_Get ("cl_benchDemos", "", CVAR_ARCHIVE);
+	cl_benchRenderers = Cvar_Get ("cl_benchRenderers", "", CVAR_ARCHIVE);
+	cl_benchResults = Cvar_Get ("cl_benchResults", "benchmark/results.txt", CVAR_ARCHIVE);
+	cl_benchBaseline = Cvar_Get ("cl_benchBaseline", "", CVAR_ARCHIVE);
+	cl_benchTolerance = Cvar_Get ("cl_benchTolerance", "5", CVAR_ARCHIVE);
+	cl_benchFrameLog = Cvar_Get ("cl_benchFrameLog", "0", CVAR_ARCHIVE);
+	cl_demoKeyframes = Cvar_Get ("cl_demoKeyframes", "30", CVAR_ARCHIVE);
 	cl_autoRecordDemo = Cvar_Get ("cl_autoRecordDemo", "0", CVAR_ARCHIVE);
 	cl_aviFrameRate = Cvar_Get ("cl_aviFrameRate", "25", CVAR_ARCHIVE);
 	cl_aviMotionJpeg = Cvar_Get ("cl_aviMotionJpeg", "1", CVAR_ARCHIVE);
+	cl_aviNV12 = Cvar_Get ("cl_aviNV12", "0", CVAR_ARCHIVE);
+	cl_aviPipe = Cvar_Get ("cl_aviPipe", "", CVAR_ARCHIVE);
+	cl_aviQueue = Cvar_Get ("cl_aviQueue", "3", CVAR_ARCHIVE);
 	cl_forceavidemo = Cvar_Get ("cl_forceavidemo", "0", 0);
 
 	rconAddress = Cvar_Get ("rconAddress", "", 0);
@@ -3670,6 +4181,7 @@ void CL_Init( void ) {
 
 	cl_maxpackets = Cvar_Get ("cl_maxpackets", "30", CVAR_ARCHIVE );
 	cl_packetdup = Cvar_Get ("cl_packetdup", "1", CVAR_ARCHIVE );
+	cl_cmdRate = Cvar_Get ("cl_cmdRate", "0", CVAR_ARCHIVE );
 
 	cl_run = Cvar_Get ("cl_run", "1", CVAR_ARCHIVE);
 	cl_sensitivity = Cvar_Get ("sensitivity", "5", CVAR_ARCHIVE);
@@ -3687,6 +4199,7 @@ void CL_Init( void ) {
 	cl_showMouseRate = Cvar_Get ("cl_showmouserate", "0", 0);
 
 	cl_autodownload = Cvar_Get ("cl_autodownload", "1", CVAR_ARCHIVE);
+	cl_downloadConnections = Cvar_Get ("cl_downloadConnections", "4", CVAR_ARCHIVE);
 #ifdef USE_CURL_DLOPEN
 	cl_cURLLib = Cvar_Get("cl_cURLLib", DEFAULT_CURL_LIB, CVAR_ARCHIVE | CVAR_PROTECTED);
 #endif
@@ -3735,8 +4248,16 @@ void CL_Init( void ) {
 	Cvar_CheckRange(j_up_axis, 0, MAX_JOYSTICK_AXIS-1, qtrue);
 
 	Cvar_Get( "cl_maxPing", "800", CVAR_ARCHIVE );
+	cl_pingRate = Cvar_Get( "cl_pingRate", "400", CVAR_ARCHIVE );
+	cl_pingConcurrency = Cvar_Get( "cl_pingConcurrency", "128", CVAR_ARCHIVE );
+	cl_pingRetries = Cvar_Get( "cl_pingRetries", "1", CVAR_ARCHIVE );
+
+	cl_mtu = Cvar_Get( "cl_mtu", "9000", CVAR_ARCHIVE );
+	// the largest datagram the server may send, probed for each connection
+	cl_pmtu = Cvar_Get( "cl_pmtu", "0", CVAR_USERINFO | CVAR_ROM );
 
 	cl_lanForcePackets = Cvar_Get ("cl_lanForcePackets", "1", CVAR_ARCHIVE);
+	cl_adaptivePackets = Cvar_Get ("cl_adaptivePackets", "0", CVAR_ARCHIVE);
 
 	cl_guidServerUniq = Cvar_Get ("cl_guidServerUniq", "1", CVAR_ARCHIVE);
 
@@ -3808,6 +4329,9 @@ void CL_Init( void ) {
 	Cmd_AddCommand ("record", CL_Record_f);
 	Cmd_AddCommand ("demo", CL_PlayDemo_f);
 	Cmd_SetCommandCompletionFunc( "demo", CL_CompleteDemoName );
+	Cmd_AddCommand ("demo_seek", CL_DemoSeek_f);
+	Cmd_AddCommand ("benchmark", CL_Benchmark_f);
+	Cmd_SetCommandCompletionFunc( "benchmark", CL_CompleteDemoName );
 	Cmd_AddCommand ("cinematic", CL_PlayCinematic_f);
 	Cmd_AddCommand ("stoprecord", CL_StopRecord_f);
 	Cmd_AddCommand ("connect", CL_Connect_f);
@@ -3838,6 +4362,8 @@ void CL_Init( void ) {
 
 	CL_GenerateQKey();
 	Cvar_Get( "cl_guid", "", CVAR_USERINFO | CVAR_ROM );
+	// tells the server we can apply "csd" configstring deltas
+	Cvar_Get( "cl_csDelta", "1", CVAR_USERINFO | CVAR_ROM );
 	CL_UpdateGUID( NULL, 0 );
 
 	Com_Printf( "----- Client Initialization Complete -----\n" );
@@ -3882,6 +4408,8 @@ void CL_Shutdown(char *finalmsg, qboolean disconnect, qboolean quit)
 	Cmd_RemoveCommand ("disconnect");
 	Cmd_RemoveCommand ("record");
 	Cmd_RemoveCommand ("demo");
+	Cmd_RemoveCommand ("demo_seek");
+	Cmd_RemoveCommand ("benchmark");
 	Cmd_RemoveCommand ("cinematic");
 	Cmd_RemoveCommand ("stoprecord");
 	Cmd_RemoveCommand ("connect");
@@ -3936,7 +4464,7 @@ static void CL_SetServerInfo(serverInfo_t *server, const char *info, int ping) {
 	}
 }
 
-static void CL_SetServerInfoByAddress(netadr_t from, const char *info, int ping) {
+void CL_SetServerInfoByAddress(netadr_t from, const char *info, int ping) {
 	int i;
 
 	for (i = 0; i < MAX_OTHER_SERVERS; i++) {
@@ -3959,13 +4487,33 @@ static void CL_SetServerInfoByAddress(netadr_t from, const char *info, int ping)
 
 }
 
+/*
+===================
+CL_NetType
+
+NOTE: make sure these types are in sync with the netnames strings in the UI
+===================
+*/
+static int CL_NetType( const netadr_t *adr ) {
+	switch (adr->type)
+	{
+		case NA_BROADCAST:
+		case NA_IP:
+			return 1;
+		case NA_IP6:
+			return 2;
+		default:
+			return 0;
+	}
+}
+
 /*
 ===================
 CL_ServerInfoPacket
 ===================
 */
 void CL_ServerInfoPacket( netadr_t from, msg_t *msg ) {
-	int		i, type;
+	int		i, time;
 	char	info[MAX_INFO_STRING];
 	char	*infoString;
 	int		prot;
@@ -4010,34 +4558,29 @@ void CL_ServerInfoPacket( netadr_t from, msg_t *msg ) {
 		if ( cl_pinglist[i].adr.port && !cl_pinglist[i].time && NET_CompareAdr( from, cl_pinglist[i].adr ) )
 		{
 			// calc ping time
-			cl_pinglist[i].time = Sys_Milliseconds() - cl_pinglist[i].start;
+			cl_pinglist[i].time = Sys_Milliseconds() - NET_PacketAge() - cl_pinglist[i].start;
 			Com_DPrintf( "ping time %dms from %s\n", cl_pinglist[i].time, NET_AdrToStringwPort( from ) );
 
 			// save of info
 			Q_strncpyz( cl_pinglist[i].info, infoString, sizeof( cl_pinglist[i].info ) );
 
 			// tack on the net type
-			// NOTE: make sure these types are in sync with the netnames strings in the UI
-			switch (from.type)
-			{
-				case NA_BROADCAST:
-				case NA_IP:
-					type = 1;
-					break;
-				case NA_IP6:
-					type = 2;
-					break;
-				default:
-					type = 0;
-					break;
-			}
-			Info_SetValueForKey( cl_pinglist[i].info, "nettype", va("%d", type) );
+			Info_SetValueForKey( cl_pinglist[i].info, "nettype", va("%d", CL_NetType( &from )) );
 			CL_SetServerInfoByAddress(from, infoString, cl_pinglist[i].time);
 
 			return;
 		}
 	}
 
+	// or queued by the server browser, straight into the lists
+	time = CL_PingResponse( from, infoString );
+	if ( time != -1 ) {
+		Q_strncpyz( info, infoString, sizeof( info ) );
+		Info_SetValueForKey( info, "nettype", va("%d", CL_NetType( &from )) );
+		CL_SetServerInfoByAddress( from, info, time );
+		return;
+	}
+
 	// if not just sent a local broadcast or pinging local servers
 	if (cls.pingUpdateSource != AS_LOCAL) {
 		return;
@@ -4601,6 +5144,7 @@ qboolean CL_UpdateVisiblePings_f(int source) {
 	char		buff[MAX_STRING_CHARS];
 	int			pingTime;
 	int			max;
+	serverInfo_t *server;
 	qboolean status = qfalse;
 
 	if (source < 0 || source > AS_FAVORITES) {
@@ -4610,75 +5154,50 @@ qboolean CL_UpdateVisiblePings_f(int source) {
 	cls.pingUpdateSource = source;
 
 	slots = CL_GetPingQueueCount();
-	if (slots < MAX_PINGREQUESTS) {
-		serverInfo_t *server = NULL;
 
-		switch (source) {
-			case AS_LOCAL :
-				server = &cls.localServers[0];
-				max = cls.numlocalservers;
-			break;
-			case AS_GLOBAL :
-				server = &cls.globalServers[0];
-				max = cls.numglobalservers;
-			break;
-			case AS_FAVORITES :
-				server = &cls.favoriteServers[0];
-				max = cls.numfavoriteservers;
-			break;
-			default:
-				return qfalse;
-		}
-		for (i = 0; i < max; i++) {
-			if (server[i].visible) {
-				if (server[i].ping == -1) {
-					int j;
-
-					if (slots >= MAX_PINGREQUESTS) {
-						break;
-					}
-					for (j = 0; j < MAX_PINGREQUESTS; j++) {
-						if (!cl_pinglist[j].adr.port) {
-							continue;
-						}
-						if (NET_CompareAdr( cl_pinglist[j].adr, server[i].adr)) {
-							// already on the list
-							break;
-						}
-					}
-					if (j >= MAX_PINGREQUESTS) {
-						status = qtrue;
-						for (j = 0; j < MAX_PINGREQUESTS; j++) {
-							if (!cl_pinglist[j].adr.port) {
-								break;
-							}
-						}
-						memcpy(&cl_pinglist[j].adr, &server[i].adr, sizeof(netadr_t));
-						cl_pinglist[j].start = Sys_Milliseconds();
-						cl_pinglist[j].time = 0;
-						NET_OutOfBandPrint( NS_CLIENT, cl_pinglist[j].adr, "getinfo xxx" );
-						slots++;
-					}
+	// the pings themselves go out from CL_PingFrame
+	switch (source) {
+		case AS_LOCAL :
+			server = &cls.localServers[0];
+			max = cls.numlocalservers;
+		break;
+		case AS_GLOBAL :
+			server = &cls.globalServers[0];
+			max = cls.numglobalservers;
+		break;
+		case AS_FAVORITES :
+			server = &cls.favoriteServers[0];
+			max = cls.numfavoriteservers;
+		break;
+		default:
+			return qfalse;
+	}
+	for (i = 0; i < max; i++) {
+		if (server[i].visible) {
+			if (server[i].ping == -1) {
+				if (!CL_QueuePing( &server[i].adr )) {
+					// full, the rest on a later call
+					break;
 				}
-				// if the server has a ping higher than cl_maxPing or
-				// the ping packet got lost
-				else if (server[i].ping == 0) {
-					// if we are updating global servers
-					if (source == AS_GLOBAL) {
-						//
-						if ( cls.numGlobalServerAddresses > 0 ) {
-							// overwrite this server with one from the additional global servers
-							cls.numGlobalServerAddresses--;
-							CL_InitServerInfo(&server[i], &cls.globalServerAddresses[cls.numGlobalServerAddresses]);
-							// NOTE: the server[i].visible flag stays untouched
-						}
+			}
+			// if the server has a ping higher than cl_maxPing or
+			// the ping packet got lost
+			else if (server[i].ping == 0) {
+				// if we are updating global servers
+				if (source == AS_GLOBAL) {
+					//
+					if ( cls.numGlobalServerAddresses > 0 ) {
+						// overwrite this server with one from the additional global servers
+						cls.numGlobalServerAddresses--;
+						CL_InitServerInfo(&server[i], &cls.globalServerAddresses[cls.numGlobalServerAddresses]);
+						// NOTE: the server[i].visible flag stays untouched
 					}
 				}
 			}
 		}
-	} 
+	}
 
-	if (slots) {
+	if (slots || CL_PingsPending()) {
 		status = qtrue;
 	}
 	for (i = 0; i < MAX_PINGREQUESTS; i++) {
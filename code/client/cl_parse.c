@@ -82,6 +82,38 @@ void CL_DeltaEntity (msg_t *msg, clSnapshot_t *frame, int newnum, entityState_t
 	frame->numEntities++;
 }
 
+/*
+==================
+CL_CopyUnchangedEntities
+
+Adds a run of entities the server left out of the delta, copied from
+the old frame in as few blocks as the ring wrapping allows
+==================
+*/
+static void CL_CopyUnchangedEntities( clSnapshot_t *oldframe, int oldindex, clSnapshot_t *frame, int count ) {
+	int		from, to, n;
+
+	from = oldframe->parseEntitiesNum + oldindex;
+	while ( count > 0 ) {
+		n = count;
+		if ( n > MAX_PARSE_ENTITIES - ( from & (MAX_PARSE_ENTITIES-1) ) ) {
+			n = MAX_PARSE_ENTITIES - ( from & (MAX_PARSE_ENTITIES-1) );
+		}
+		to = cl.parseEntitiesNum & (MAX_PARSE_ENTITIES-1);
+		if ( n > MAX_PARSE_ENTITIES - to ) {
+			n = MAX_PARSE_ENTITIES - to;
+		}
+
+		// an invalid delta frame can be old enough to overlap
+		memmove( &cl.parseEntities[to], &cl.parseEntities[from & (MAX_PARSE_ENTITIES-1)], n * sizeof( entityState_t ) );
+
+		from += n;
+		cl.parseEntitiesNum += n;
+		frame->numEntities += n;
+		count -= n;
+	}
+}
+
 /*
 ==================
 CL_ParsePacketEntities
@@ -92,6 +124,7 @@ void CL_ParsePacketEntities( msg_t *msg, clSnapshot_t *oldframe, clSnapshot_t *n
 	int			newnum;
 	entityState_t	*oldstate;
 	int			oldindex, oldnum;
+	int			unchanged;
 
 	newframe->parseEntitiesNum = cl.parseEntitiesNum;
 	newframe->numEntities = 0;
@@ -123,13 +156,12 @@ void CL_ParsePacketEntities( msg_t *msg, clSnapshot_t *oldframe, clSnapshot_t *n
 			Com_Error (ERR_DROP,"CL_ParsePacketEntities: end of message");
 		}
 
+		unchanged = oldindex;
 		while ( oldnum < newnum ) {
 			// one or more entities from the old packet are unchanged
 			if ( cl_shownet->integer == 3 ) {
 				Com_Printf ("%3i:  unchanged: %i\n", msg->readcount, oldnum);
 			}
-			CL_DeltaEntity( msg, newframe, oldnum, oldstate, qtrue );
-			
 			oldindex++;
 
 			if ( oldindex >= oldframe->numEntities ) {
@@ -140,6 +172,9 @@ void CL_ParsePacketEntities( msg_t *msg, clSnapshot_t *oldframe, clSnapshot_t *n
 				oldnum = oldstate->number;
 			}
 		}
+		if ( oldindex > unchanged ) {
+			CL_CopyUnchangedEntities( oldframe, unchanged, newframe, oldindex - unchanged );
+		}
 		if (oldnum == newnum) {
 			// delta from previous state
 			if ( cl_shownet->integer == 3 ) {
@@ -171,13 +206,12 @@ void CL_ParsePacketEntities( msg_t *msg, clSnapshot_t *oldframe, clSnapshot_t *n
 	}
 
 	// any remaining entities in the old frame are copied over
+	unchanged = oldindex;
 	while ( oldnum != 99999 ) {
 		// one or more entities from the old packet are unchanged
 		if ( cl_shownet->integer == 3 ) {
 			Com_Printf ("%3i:  unchanged: %i\n", msg->readcount, oldnum);
 		}
-		CL_DeltaEntity( msg, newframe, oldnum, oldstate, qtrue );
-		
 		oldindex++;
 
 		if ( oldindex >= oldframe->numEntities ) {
@@ -188,6 +222,9 @@ void CL_ParsePacketEntities( msg_t *msg, clSnapshot_t *oldframe, clSnapshot_t *n
 			oldnum = oldstate->number;
 		}
 	}
+	if ( oldindex > unchanged ) {
+		CL_CopyUnchangedEntities( oldframe, unchanged, newframe, oldindex - unchanged );
+	}
 }
 
 
@@ -222,6 +259,9 @@ void CL_ParseSnapshot( msg_t *msg ) {
 
 	newSnap.serverTime = MSG_ReadLong( msg );
 
+	// read by the network thread maybe long before this frame
+	newSnap.realtime = cls.realtime - (int)( NET_PacketAge() * com_timescale->value );
+
 	// if we were just unpaused, we can only *now* really let the
 	// change come into effect or the client hangs.
 	cl_paused->modified = qfalse;
@@ -309,7 +349,7 @@ void CL_ParseSnapshot( msg_t *msg ) {
 	for ( i = 0 ; i < PACKET_BACKUP ; i++ ) {
 		packetNum = ( clc.netchan.outgoingSequence - 1 - i ) & PACKET_MASK;
 		if ( cl.snap.ps.commandTime >= cl.outPackets[ packetNum ].p_serverTime ) {
-			cl.snap.ping = cls.realtime - cl.outPackets[ packetNum ].p_realtime;
+			cl.snap.ping = cl.snap.realtime - cl.outPackets[ packetNum ].p_realtime;
 			break;
 		}
 	}
@@ -627,6 +667,9 @@ static void CL_ParseServerInfo(void)
 {
 	const char *serverInfo;
 	const char *mapname;
+#ifdef USE_CURL
+	int port;
+#endif
 
 	serverInfo = cl.gameState.stringData
 		+ cl.gameState.stringOffsets[ CS_SERVERINFO ];
@@ -638,6 +681,14 @@ static void CL_ParseServerInfo(void)
 		Info_ValueForKey(serverInfo, "sv_dlURL"),
 		sizeof(clc.sv_dlURL));
 
+	// without a mirror the server may serve its pk3s itself, over TCP
+	// it takes the whole path rather than a window of UDP packets
+	port = atoi(Info_ValueForKey(serverInfo, "sv_dlPort"));
+	if (!clc.sv_dlURL[0] && clc.serverAddress.type == NA_IP && port > 0 && port < 65536) {
+		Com_sprintf(clc.sv_dlURL, sizeof(clc.sv_dlURL), "http://%s:%i",
+			NET_AdrToString(clc.serverAddress), port);
+	}
+
 	Q_strncpyz(clc.mapname,
 		mapname,
 		sizeof(clc.mapname));
@@ -0,0 +1,360 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// cl_ping.c -- server browser pings, a whole master list per refresh
+
+#include "client.h"
+
+/*
+The browser used to ping through the 32 cl_pinglist slots, refilled once a
+UI frame, so a full global list took minutes. Here every server the UI asks
+for is queued, and CL_PingFrame sends getinfo in bursts paced by a token
+bucket at cl_pingRate packets a second, keeping at most cl_pingConcurrency
+unanswered at a time.
+
+Each getinfo carries its send time in usec as the challenge, which the
+server echoes, so a reply to an earlier attempt is timed against that
+attempt and not the retry. The receive side uses the time the packet came
+off the socket, not when the frame got around to it, and the round trip is
+rounded to the nearest msec rather than losing up to one at either end.
+
+Entries are found by address through a hash, results go straight into the
+server lists as they arrive and the entry is dropped. The cl_pinglist slots
+stay for the ping command and the q3_ui LAN_GetPing calls.
+*/
+
+#define MAX_PING_ENTRIES	( MAX_GLOBAL_SERVERS + 2 * MAX_OTHER_SERVERS )
+#define MAX_PING_INFLIGHT	1024
+#define PING_HASH_SIZE		8192	// power of two
+
+typedef struct {
+	netadr_t	adr;
+	qboolean	used;
+	qboolean	queued;
+	int			attempts;
+	int64_t		firstSent;			// Sys_Microseconds of the first attempt, -1 before it
+	int64_t		lastSent;
+	int			inFlight;			// index in ping.inFlight, -1 if not
+	int			hashNext;			// entry + 1, also the free list
+} pingEntry_t;
+
+static struct {
+	pingEntry_t	entries[MAX_PING_ENTRIES];
+	int			numEntries;			// high water mark
+	int			freeList;			// entry + 1
+	int			hash[PING_HASH_SIZE];	// entry + 1
+
+	int			queue[MAX_PING_ENTRIES];
+	int			queueHead;
+	int			queueCount;
+
+	int			inFlight[MAX_PING_INFLIGHT];
+	int			numInFlight;
+
+	float		tokens;
+	int64_t		lastFrame;
+} ping;
+
+/*
+==================
+CL_PingHash
+==================
+*/
+static int CL_PingHash( const netadr_t *adr ) {
+	const byte	*b;
+	unsigned	hash;
+	int			i, len;
+
+	switch ( adr->type ) {
+	case NA_IP:
+		b = adr->ip;
+		len = sizeof( adr->ip );
+		break;
+	case NA_IP6:
+		b = adr->ip6;
+		len = sizeof( adr->ip6 );
+		break;
+	default:
+		// NET_CompareAdr ignores the rest for these
+		return adr->type & ( PING_HASH_SIZE - 1 );
+	}
+
+	hash = 2166136261u ^ adr->type;
+	for ( i = 0; i < len; i++ ) {
+		hash = ( hash ^ b[i] ) * 16777619u;
+	}
+	hash = ( hash ^ adr->port ) * 16777619u;
+
+	return ( hash ^ ( hash >> 16 ) ) & ( PING_HASH_SIZE - 1 );
+}
+
+/*
+==================
+CL_FindPing
+==================
+*/
+static int CL_FindPing( const netadr_t *adr ) {
+	int		e;
+
+	for ( e = ping.hash[CL_PingHash( adr )]; e; e = ping.entries[e - 1].hashNext ) {
+		if ( NET_CompareAdr( *adr, ping.entries[e - 1].adr ) ) {
+			return e - 1;
+		}
+	}
+
+	return -1;
+}
+
+/*
+==================
+CL_LandPing
+
+Off the in flight list, the last one takes its place
+==================
+*/
+static void CL_LandPing( int n ) {
+	pingEntry_t	*entry = &ping.entries[n];
+	int			last;
+
+	if ( entry->inFlight == -1 ) {
+		return;
+	}
+
+	last = ping.inFlight[--ping.numInFlight];
+	ping.inFlight[entry->inFlight] = last;
+	ping.entries[last].inFlight = entry->inFlight;
+	entry->inFlight = -1;
+}
+
+/*
+==================
+CL_QueueEntry
+==================
+*/
+static void CL_QueueEntry( int n ) {
+	ping.entries[n].queued = qtrue;
+	ping.queue[( ping.queueHead + ping.queueCount ) % MAX_PING_ENTRIES] = n;
+	ping.queueCount++;
+}
+
+/*
+==================
+CL_FreePing
+==================
+*/
+static void CL_FreePing( int n ) {
+	pingEntry_t	*entry = &ping.entries[n];
+	int			*link;
+
+	// off the hash chain
+	for ( link = &ping.hash[CL_PingHash( &entry->adr )]; *link; link = &ping.entries[*link - 1].hashNext ) {
+		if ( *link == n + 1 ) {
+			*link = entry->hashNext;
+			break;
+		}
+	}
+
+	CL_LandPing( n );
+
+	// a queue reference left behind is skipped as it isn't queued
+	entry->used = qfalse;
+	entry->queued = qfalse;
+	entry->hashNext = ping.freeList;
+	ping.freeList = n + 1;
+}
+
+/*
+==================
+CL_QueuePing
+
+Returns qfalse when the table is full, a server already queued counts as
+queued.
+==================
+*/
+qboolean CL_QueuePing( const netadr_t *adr ) {
+	pingEntry_t	*entry;
+	int			n, h;
+
+	if ( CL_FindPing( adr ) != -1 ) {
+		return qtrue;
+	}
+
+	if ( ping.queueCount >= MAX_PING_ENTRIES ) {
+		return qfalse;
+	}
+
+	if ( ping.freeList ) {
+		n = ping.freeList - 1;
+		ping.freeList = ping.entries[n].hashNext;
+	} else if ( ping.numEntries < MAX_PING_ENTRIES ) {
+		n = ping.numEntries++;
+	} else {
+		return qfalse;
+	}
+
+	entry = &ping.entries[n];
+	Com_Memset( entry, 0, sizeof( *entry ) );
+	entry->adr = *adr;
+	entry->used = qtrue;
+	entry->firstSent = -1;
+	entry->inFlight = -1;
+
+	h = CL_PingHash( adr );
+	entry->hashNext = ping.hash[h];
+	ping.hash[h] = n + 1;
+
+	CL_QueueEntry( n );
+
+	return qtrue;
+}
+
+/*
+==================
+CL_PingsPending
+==================
+*/
+qboolean CL_PingsPending( void ) {
+	return ping.queueCount || ping.numInFlight;
+}
+
+/*
+==================
+CL_PingResponse
+
+Returns the round trip in msec if from is a server being pinged, -1 if not
+==================
+*/
+int CL_PingResponse( netadr_t from, const char *info ) {
+	pingEntry_t	*entry;
+	int64_t		stamp, arrived;
+	int			n, time;
+	const char	*challenge;
+
+	n = CL_FindPing( &from );
+	// a late answer to an attempt that is queued for a retry still counts
+	if ( n == -1 || ping.entries[n].firstSent == -1 ) {
+		return -1;
+	}
+	entry = &ping.entries[n];
+
+	arrived = NET_PacketTime();
+
+	// only trust the echo if it is one of ours
+	challenge = Info_ValueForKey( info, "challenge" );
+	stamp = strtoll( challenge, NULL, 10 );
+	if ( !*challenge || stamp < entry->firstSent || stamp > entry->lastSent ) {
+		stamp = entry->lastSent;
+	}
+
+	time = (int)( ( arrived - stamp + 500 ) / 1000 );
+	if ( time < 1 ) {
+		// the UI takes 0 for no answer
+		time = 1;
+	}
+
+	Com_DPrintf( "ping time %dms from %s\n", time, NET_AdrToStringwPort( from ) );
+
+	CL_FreePing( n );
+
+	return time;
+}
+
+/*
+==================
+CL_PingFrame
+==================
+*/
+void CL_PingFrame( void ) {
+	pingEntry_t	*entry;
+	int64_t		now;
+	int			maxPing, concurrency, burst;
+	int			i, n;
+
+	if ( !ping.queueCount && !ping.numInFlight ) {
+		ping.tokens = 0;
+		return;
+	}
+
+	now = Sys_Microseconds();
+
+	maxPing = Cvar_VariableIntegerValue( "cl_maxPing" );
+	if ( maxPing < 100 ) {
+		maxPing = 100;
+	}
+
+	// time outs, a retry goes to the back of the queue
+	for ( i = 0; i < ping.numInFlight; ) {
+		n = ping.inFlight[i];
+		entry = &ping.entries[n];
+
+		if ( now - entry->lastSent < maxPing * 1000 ) {
+			i++;
+			continue;
+		}
+
+		if ( entry->attempts <= cl_pingRetries->integer && ping.queueCount < MAX_PING_ENTRIES ) {
+			CL_LandPing( n );
+			CL_QueueEntry( n );
+			continue;
+		}
+
+		CL_SetServerInfoByAddress( entry->adr, NULL, 0 );
+		CL_FreePing( n );
+	}
+
+	// refill the bucket, a frame hitch doesn't turn into one huge burst
+	burst = cl_pingRate->integer / 10;
+	if ( burst < 1 ) {
+		burst = 1;
+	}
+	if ( ping.lastFrame && now > ping.lastFrame ) {
+		ping.tokens += cl_pingRate->value * ( now - ping.lastFrame ) * 0.000001f;
+	}
+	if ( ping.tokens > burst || !ping.lastFrame ) {
+		ping.tokens = burst;
+	}
+	ping.lastFrame = now;
+
+	concurrency = Com_Clamp( 1, MAX_PING_INFLIGHT, cl_pingConcurrency->integer );
+
+	while ( ping.queueCount && ping.numInFlight < concurrency && ping.tokens >= 1.0f ) {
+		n = ping.queue[ping.queueHead];
+		ping.queueHead = ( ping.queueHead + 1 ) % MAX_PING_ENTRIES;
+		ping.queueCount--;
+
+		entry = &ping.entries[n];
+		if ( !entry->used || !entry->queued ) {
+			continue;
+		}
+		entry->queued = qfalse;
+
+		if ( entry->firstSent == -1 ) {
+			entry->firstSent = now;
+		}
+		entry->lastSent = now;
+		entry->attempts++;
+		entry->inFlight = ping.numInFlight;
+		ping.inFlight[ping.numInFlight++] = n;
+		ping.tokens -= 1.0f;
+
+		NET_OutOfBandPrint( NS_CLIENT, entry->adr, "getinfo %lld", (long long)now );
+	}
+}
@@ -116,10 +116,69 @@ void SCR_DrawPic( float x, float y, float width, float height, qhandle_t hShader
 
 
 /*
-** SCR_DrawChar
+Text goes to the renderer through a batch of glyphs, one re.DrawStretchPics
+per run of the same shader with every glyph keeping its own color, rather
+than a SetColor and a DrawStretchPic command for each character. Whatever
+adds glyphs flushes them before it returns, so they still come out in
+order with everything else that is drawn.
+*/
+#define	MAX_SCR_GLYPHS	512
+
+static struct {
+	stretchPic_t	pics[MAX_SCR_GLYPHS];
+	int				numPics;
+	qhandle_t		shader;
+} scrGlyphs;
+
+/*
+** SCR_FlushGlyphs
+*/
+void SCR_FlushGlyphs( void ) {
+	if ( scrGlyphs.numPics ) {
+		re.DrawStretchPics( scrGlyphs.pics, scrGlyphs.numPics, scrGlyphs.shader );
+		scrGlyphs.numPics = 0;
+	}
+}
+
+/*
+** SCR_AddGlyph
+** in screen pixels, NULL color is white
+*/
+static void SCR_AddGlyph( float x, float y, float w, float h, float s1, float t1, float s2, float t2,
+		qhandle_t hShader, const float *color ) {
+	stretchPic_t	*pic;
+
+	if ( scrGlyphs.numPics && ( hShader != scrGlyphs.shader || scrGlyphs.numPics == MAX_SCR_GLYPHS ) ) {
+		SCR_FlushGlyphs();
+	}
+	scrGlyphs.shader = hShader;
+
+	pic = &scrGlyphs.pics[scrGlyphs.numPics++];
+	pic->x = x;
+	pic->y = y;
+	pic->w = w;
+	pic->h = h;
+	pic->s1 = s1;
+	pic->t1 = t1;
+	pic->s2 = s2;
+	pic->t2 = t2;
+
+	// as RB_SetColor does it
+	if ( color ) {
+		pic->color[0] = color[0] * 255;
+		pic->color[1] = color[1] * 255;
+		pic->color[2] = color[2] * 255;
+		pic->color[3] = color[3] * 255;
+	} else {
+		pic->color[0] = pic->color[1] = pic->color[2] = pic->color[3] = 255;
+	}
+}
+
+/*
+** SCR_AddChar
 ** chars are drawn at 640*480 virtual screen size
 */
-static void SCR_DrawChar( int x, int y, float size, int ch ) {
+static void SCR_AddChar( int x, int y, float size, int ch, const float *color ) {
 	int row, col;
 	float frow, fcol;
 	float	ax, ay, aw, ah;
@@ -147,16 +206,48 @@ static void SCR_DrawChar( int x, int y, float size, int ch ) {
 	fcol = col*0.0625;
 	size = 0.0625;
 
-	re.DrawStretchPic( ax, ay, aw, ah,
+	SCR_AddGlyph( ax, ay, aw, ah,
 					   fcol, frow, 
 					   fcol + size, frow + size, 
-					   cls.charSetShader );
+					   cls.charSetShader, color );
 }
 
 /*
-** SCR_DrawSmallChar
+** SCR_AddSmallChar
 ** small chars are drawn at native screen resolution
 */
+void SCR_AddSmallChar( int x, int y, int ch, const float *color ) {
+	int row, col;
+	float frow, fcol;
+	float size;
+
+	ch &= 255;
+
+	if ( ch == ' ' ) {
+		return;
+	}
+
+	if ( y < -SMALLCHAR_HEIGHT ) {
+		return;
+	}
+
+	row = ch>>4;
+	col = ch&15;
+
+	frow = row*0.0625;
+	fcol = col*0.0625;
+	size = 0.0625;
+
+	SCR_AddGlyph( x, y, SMALLCHAR_WIDTH, SMALLCHAR_HEIGHT,
+					   fcol, frow, 
+					   fcol + size, frow + size, 
+					   cls.charSetShader, color );
+}
+
+/*
+** SCR_DrawSmallChar
+** in the color last given to re.SetColor
+*/
 void SCR_DrawSmallChar( int x, int y, int ch ) {
 	int row, col;
 	float frow, fcol;
@@ -205,7 +296,6 @@ void SCR_DrawStringExt( int x, int y, float size, const char *string, float *set
 	// draw the drop shadow
 	color[0] = color[1] = color[2] = 0;
 	color[3] = setColor[3];
-	re.SetColor( color );
 	s = string;
 	xx = x;
 	while ( *s ) {
@@ -213,7 +303,7 @@ void SCR_DrawStringExt( int x, int y, float size, const char *string, float *set
 			s += 2;
 			continue;
 		}
-		SCR_DrawChar( xx+2, y+2, size, *s );
+		SCR_AddChar( xx+2, y+2, size, *s, color );
 		xx += size;
 		s++;
 	}
@@ -222,23 +312,23 @@ void SCR_DrawStringExt( int x, int y, float size, const char *string, float *set
 	// draw the colored text
 	s = string;
 	xx = x;
-	re.SetColor( setColor );
+	Com_Memcpy( color, setColor, sizeof( color ) );
 	while ( *s ) {
 		if ( Q_IsColorString( s ) ) {
 			if ( !forceColor ) {
 				Com_Memcpy( color, g_color_table[ColorIndex(*(s+1))], sizeof( color ) );
 				color[3] = setColor[3];
-				re.SetColor( color );
 			}
 			if ( !noColorEscape ) {
 				s += 2;
 				continue;
 			}
 		}
-		SCR_DrawChar( xx, y, size, *s );
+		SCR_AddChar( xx, y, size, *s, color );
 		xx += size;
 		s++;
 	}
+	SCR_FlushGlyphs();
 	re.SetColor( NULL );
 }
 
@@ -273,23 +363,23 @@ void SCR_DrawSmallStringExt( int x, int y, const char *string, float *setColor,
 	// draw the colored text
 	s = string;
 	xx = x;
-	re.SetColor( setColor );
+	Com_Memcpy( color, setColor, sizeof( color ) );
 	while ( *s ) {
 		if ( Q_IsColorString( s ) ) {
 			if ( !forceColor ) {
 				Com_Memcpy( color, g_color_table[ColorIndex(*(s+1))], sizeof( color ) );
 				color[3] = setColor[3];
-				re.SetColor( color );
 			}
 			if ( !noColorEscape ) {
 				s += 2;
 				continue;
 			}
 		}
-		SCR_DrawSmallChar( xx, y, *s );
+		SCR_AddSmallChar( xx, y, *s, color );
 		xx += SMALLCHAR_WIDTH;
 		s++;
 	}
+	SCR_FlushGlyphs();
 	re.SetColor( NULL );
 }
 
@@ -355,16 +445,14 @@ int SCR_FontWidth(const char *text, float scale) {
 }
 
 
-void SCR_DrawFontChar(float x, float y, float width, float height, float scale, float s, float t, float s2, float t2, qhandle_t hShader) {
-	if (!cls.fontFont)
-		return;
-
+static void SCR_AddFontChar(float x, float y, float width, float height, float scale, float s, float t, float s2, float t2,
+		qhandle_t hShader, const float *color) {
 	float  w, h;
 
 	w = width * scale;
 	h = height * scale;
 	SCR_AdjustFrom640(&x, &y, &w, &h);
-	re.DrawStretchPic(x, y, w, h, s, t, s2, t2, hShader);
+	SCR_AddGlyph(x, y, w, h, s, t, s2, t2, hShader, color);
 }
 
 void SCR_DrawFontText(float x, float y, float scale, vec4_t color, const char *text, int style) {
@@ -383,7 +471,7 @@ void SCR_DrawFontText(float x, float y, float scale, vec4_t color, const char *t
 
 	if (text) {
 		const char	*s = text;
-		re.SetColor( color );
+		const float	*shadowColor;
 		memcpy(&newColor[0], &color[0], sizeof(vec4_t));
 		len = strlen(text);
 
@@ -395,7 +483,6 @@ void SCR_DrawFontText(float x, float y, float scale, vec4_t color, const char *t
 			if (Q_IsColorString(s)) {
 				memcpy( newColor, g_color_table[ColorIndex(*(s + 1))], sizeof(newColor));
 				newColor[3] = color[3];
-				re.SetColor( newColor );
 				s += 2;
 				continue;
 			}
@@ -410,12 +497,12 @@ void SCR_DrawFontText(float x, float y, float scale, vec4_t color, const char *t
 
 				if (newColor[0] == 0.0f && newColor[1] == 0.0f && newColor[2] == 0.0f) {
 					grey[3] = black[3];
-					re.SetColor(grey);
+					shadowColor = grey;
 				} else {
-					re.SetColor(black);
+					shadowColor = black;
 				}
 
-				SCR_DrawFontChar(x + 1, y - yadj + 1,
+				SCR_AddFontChar(x + 1, y - yadj + 1,
 						  glyph->imageWidth,
 						  glyph->imageHeight,
 						  useScale,
@@ -423,13 +510,13 @@ void SCR_DrawFontText(float x, float y, float scale, vec4_t color, const char *t
 						  glyph->t,
 						  glyph->s2,
 						  glyph->t2,
-						  glyph->glyph);
+						  glyph->glyph,
+						  shadowColor);
 
 				colorBlack[3] = 1.0;
-				re.SetColor(newColor);
 			}
 
-			SCR_DrawFontChar(x, y - yadj,
+			SCR_AddFontChar(x, y - yadj,
 					  glyph->imageWidth,
 					  glyph->imageHeight,
 					  useScale,
@@ -437,11 +524,13 @@ void SCR_DrawFontText(float x, float y, float scale, vec4_t color, const char *t
 					  glyph->t,
 					  glyph->s2,
 					  glyph->t2,
-					  glyph->glyph);
+					  glyph->glyph,
+					  newColor);
 			x += (glyph->xSkip * useScale);
 			s++;
 			count++;
 		}
+		SCR_FlushGlyphs();
 		re.SetColor(NULL);
 	}
 }
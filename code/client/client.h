@@ -50,6 +50,7 @@ typedef struct {
 	int				snapFlags;		// rate delayed and dropped commands
 
 	int				serverTime;		// server time the message is valid for (in msec)
+	int				realtime;		// cls.realtime the packet arrived at, see net_recvThread
 
 	int				messageNum;		// copied from netchan->incoming_sequence
 	int				deltaNum;		// messageNum the delta is from
@@ -88,6 +89,15 @@ typedef struct {
 // it can be un-deltad from the original 
 #define	MAX_PARSE_ENTITIES	( PACKET_BACKUP * MAX_SNAPSHOT_ENTITIES )
 
+// mouse motion as it was stamped by the input code, at most one per msec
+#define	MAX_MOUSE_SAMPLES	256		// power of two
+#define	MOUSE_SAMPLE_MASK	( MAX_MOUSE_SAMPLES - 1 )
+
+typedef struct {
+	int		time;
+	int		dx, dy;
+} mouseSample_t;
+
 extern int g_console_field_width;
 
 typedef struct {
@@ -112,6 +122,10 @@ typedef struct {
 
 	int			mouseDx[2], mouseDy[2];	// added to by mouse events
 	int			mouseIndex;
+	mouseSample_t	mouseSamples[MAX_MOUSE_SAMPLES];	// not yet in a usercmd
+	int			mouseSampleHead, mouseSampleTail;
+	int			mouseTime;			// time the last usercmd took motion up to
+	int			nextCmdTime;		// com_frameTime the next cl_cmdRate usercmd is due
 	int			joystickAxis[MAX_JOYSTICK_AXIS];	// set by joystick events
 
 	// cgame communicates a few values to the client system
@@ -203,7 +217,6 @@ typedef struct {
 	qboolean	cURLEnabled;
 	qboolean	cURLDisconnected;
 	char		downloadURL[MAX_OSPATH];
-	CURL		*downloadCURL;
 	CURLM		*downloadCURLM;
 	char		sv_dlURL[MAX_CVAR_VALUE_STRING];
 	int			downloadCount;	// how many bytes we got so far
@@ -222,6 +235,18 @@ typedef struct {
 	qboolean	firstDemoFrameSkipped;
 	fileHandle_t	demofile;
 
+	demoKeyframe_t	*demoRecordIndex;	// keyframes written so far, NULL if not indexing
+	int			demoRecordKeyframes;
+	int			demoKeyframeTime;	// serverTime of the last keyframe written
+	qboolean	demoKeyframeWanted;	// ask for a full snapshot to put one in front of
+
+	demoKeyframe_t	*demoIndex;		// seek index of the demo being played, may be NULL
+	int			demoKeyframes;
+	int			demoDataOffset;		// where the messages start after the header
+	int			demoStartTime;		// serverTime of the first snapshot
+	int			demoSeekTime;		// demo_seek is reading ahead to this serverTime
+	qboolean	demoReadKeyframe;	// parse the next keyframe instead of skipping it
+
 	int			timeDemoFrames;		// counter of rendered frames
 	int			timeDemoStart;		// cls.realtime before first frame
 	int			timeDemoBaseTime;	// each frame will be at this time + frameNum * 50
@@ -230,6 +255,9 @@ typedef struct {
 	int			timeDemoMaxDuration;	// maximum frame duration
 	unsigned char	timeDemoDurations[ MAX_TIMEDEMO_DURATIONS ];	// log of frame durations
 
+	int			mtuProbeRounds;		// sent so far, see CL_MtuProbeFrame
+	int			mtuProbeTime;		// cls.realtime of the last round
+
 	float		aviVideoFrameRemainder;
 	float		aviSoundFrameRemainder;
 
@@ -407,6 +435,7 @@ extern	cvar_t	*cl_noprint;
 extern	cvar_t	*cl_timegraph;
 extern	cvar_t	*cl_maxpackets;
 extern	cvar_t	*cl_packetdup;
+extern	cvar_t	*cl_cmdRate;
 extern	cvar_t	*cl_shownet;
 extern	cvar_t	*cl_showSend;
 extern	cvar_t	*cl_timeNudge;
@@ -444,18 +473,38 @@ extern	cvar_t	*j_side_axis;
 extern	cvar_t	*j_up_axis;
 
 extern	cvar_t	*cl_timedemo;
+extern	cvar_t	*cl_benchDemos;
+extern	cvar_t	*cl_benchRenderers;
+extern	cvar_t	*cl_benchResults;
+extern	cvar_t	*cl_benchBaseline;
+extern	cvar_t	*cl_benchTolerance;
+extern	cvar_t	*cl_benchFrameLog;
+extern	cvar_t	*cl_demoKeyframes;
+extern	cvar_t	*cl_pingRate;
+extern	cvar_t	*cl_pingConcurrency;
+extern	cvar_t	*cl_pingRetries;
+extern	cvar_t	*cl_mtu;
+extern	cvar_t	*cl_pmtu;
 extern	cvar_t	*cl_aviFrameRate;
 extern	cvar_t	*cl_aviMotionJpeg;
+extern	cvar_t	*cl_aviNV12;
+extern	cvar_t	*cl_aviPipe;
+extern	cvar_t	*cl_aviQueue;
 
 extern	cvar_t	*cl_activeAction;
 
 extern	cvar_t	*cl_autodownload;
 extern  cvar_t  *cl_downloadMethod;
+extern	cvar_t	*cl_downloadConnections;
 extern	cvar_t	*cl_conXOffset;
 extern	cvar_t	*cl_inGameVideo;
 
 extern	cvar_t	*cl_lanForcePackets;
+extern	cvar_t	*cl_adaptivePackets;
 extern	cvar_t	*cl_autoRecordDemo;
+#ifdef USE_RENDERER_DLOPEN
+extern	cvar_t	*cl_renderer;
+#endif
 
 extern	cvar_t	*cl_consoleKeys;
 extern	cvar_t	*cl_consoleUseScanCode;
@@ -512,6 +561,7 @@ void CL_Snd_Restart_f (void);
 void CL_StartDemoLoop( void );
 void CL_NextDemo( void );
 void CL_ReadDemoMessage( void );
+void CL_DemoSeekFrame( void );
 void CL_StopRecord_f(void);
 
 void CL_InitDownloads(void);
@@ -550,6 +600,7 @@ void CL_ClearState (void);
 void CL_ReadPackets (void);
 
 void CL_WritePacket( void );
+void CL_NotePacketLoss( int dropped );
 void IN_CenterView (void);
 
 void CL_VerifyCode( void );
@@ -579,6 +630,7 @@ void	CL_GlobalServers_f( void );
 void	CL_FavoriteServers_f( void );
 void	CL_Ping_f( void );
 qboolean CL_UpdateVisiblePings_f( int source );
+void	CL_SetServerInfoByAddress( netadr_t from, const char *info, int ping );
 
 
 //
@@ -626,6 +678,8 @@ void	SCR_DrawBigString( int x, int y, const char *s, float alpha, qboolean noCol
 void	SCR_DrawBigStringColor( int x, int y, const char *s, vec4_t color, qboolean noColorEscape );	// ignores embedded color control characters
 void	SCR_DrawSmallStringExt( int x, int y, const char *string, float *setColor, qboolean forceColor, qboolean noColorEscape );
 void	SCR_DrawSmallChar( int x, int y, int ch );
+void	SCR_AddSmallChar( int x, int y, int ch, const float *color );
+void	SCR_FlushGlyphs( void );
 
 
 //
@@ -681,11 +735,27 @@ qboolean CL_Netchan_Process( netchan_t *chan, msg_t *msg );
 //
 qboolean CL_OpenAVIForWriting( const char *filename );
 void CL_TakeVideoFrame( void );
-void CL_WriteAVIVideoFrame( const byte *imageBuffer, int size );
+void CL_AVIVideoFrameCaptured( const byte *pixels, int padding );
 void CL_WriteAVIAudioFrame( const byte *pcmBuffer, int size );
 qboolean CL_CloseAVI( void );
 qboolean CL_VideoRecording( void );
 
+//
+// cl_bench.c
+//
+void CL_Benchmark_f( void );
+void CL_BenchFrame( void );
+void CL_BenchDemoLoading( void );
+void CL_BenchDemoCompleted( void );
+
+//
+// cl_ping.c
+//
+qboolean CL_QueuePing( const netadr_t *adr );
+qboolean CL_PingsPending( void );
+int CL_PingResponse( netadr_t from, const char *info );
+void CL_PingFrame( void );
+
 //
 // cl_main.c
 //
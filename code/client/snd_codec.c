@@ -26,6 +26,323 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 static snd_codec_t *codecs;
 
+//=======================================================================
+// Read-ahead thread
+
+/*
+Streams opened with s_streamReadAhead are decoded by a thread into a ring
+of PCM per stream, so the file reads and the decoding of the background
+track never stall the client, which only copies the decoded samples.
+The ring positions are protected by readAheadLock, the ranges being
+filled and copied out never overlap.
+*/
+
+#define READAHEAD_CHUNK		8192		// bytes decoded at once
+#define READAHEAD_MIN_SIZE	65536
+
+struct snd_readahead_s
+{
+	snd_stream_t *stream;
+	byte *buffer;
+	unsigned size;				// power of two
+	unsigned readPos;			// bytes copied out, advanced by the client
+	unsigned writePos;			// bytes decoded, advanced by the thread
+	qboolean eof;
+	qboolean busy;				// the thread is decoding outside of the lock
+	qboolean waiting;			// the client waits on readAheadData
+	snd_readahead_t *next;
+};
+
+static cvar_t *s_streamReadAhead;
+
+static sysThread_t *readAheadThread;
+static sysMutex_t *readAheadLock;
+static sysSemaphore_t *readAheadWake;	// posted when a ring has room
+static sysSemaphore_t *readAheadData;	// posted for a waiting client
+static snd_readahead_t *readAheadStreams;
+static qboolean readAheadQuit;
+
+/*
+=================
+S_ReadAheadNextStream
+
+Returns the least filled stream with room for a chunk, with the lock held
+=================
+*/
+static snd_readahead_t *S_ReadAheadNextStream(void)
+{
+	snd_readahead_t *ra, *best = NULL;
+	unsigned fill, bestFill = 0;
+
+	for(ra = readAheadStreams; ra; ra = ra->next)
+	{
+		fill = ra->writePos - ra->readPos;
+
+		if(ra->eof || ra->size - fill < READAHEAD_CHUNK)
+			continue;
+
+		if(!best || fill < bestFill)
+		{
+			best = ra;
+			bestFill = fill;
+		}
+	}
+
+	return best;
+}
+
+/*
+=================
+S_ReadAheadThread
+=================
+*/
+static void S_ReadAheadThread(void *arg)
+{
+	static byte chunk[READAHEAD_CHUNK];
+	snd_readahead_t *ra;
+	unsigned ofs, len;
+	int r;
+
+	for(;;)
+	{
+		Sys_WaitSemaphore(readAheadWake);
+		Sys_LockMutex(readAheadLock);
+
+		if(readAheadQuit)
+		{
+			Sys_UnlockMutex(readAheadLock);
+			return;
+		}
+
+		while((ra = S_ReadAheadNextStream()) != NULL)
+		{
+			ra->busy = qtrue;
+			Sys_UnlockMutex(readAheadLock);
+
+			r = ra->stream->codec->read(ra->stream, READAHEAD_CHUNK, chunk);
+
+			Sys_LockMutex(readAheadLock);
+
+			if(r > 0)
+			{
+				ofs = ra->writePos & (ra->size - 1);
+				len = MIN((unsigned)r, ra->size - ofs);
+
+				Com_Memcpy(ra->buffer + ofs, chunk, len);
+				Com_Memcpy(ra->buffer, chunk + len, r - len);
+				ra->writePos += r;
+			}
+			else
+				ra->eof = qtrue;
+
+			ra->busy = qfalse;
+
+			if(ra->waiting)
+			{
+				ra->waiting = qfalse;
+				Sys_PostSemaphore(readAheadData);
+			}
+		}
+
+		Sys_UnlockMutex(readAheadLock);
+	}
+}
+
+/*
+=================
+S_ReadAheadStart
+=================
+*/
+static qboolean S_ReadAheadStart(void)
+{
+	if(readAheadThread)
+		return qtrue;
+
+	readAheadLock = Sys_CreateMutex();
+	readAheadWake = Sys_CreateSemaphore();
+	readAheadData = Sys_CreateSemaphore();
+	readAheadQuit = qfalse;
+
+	if(readAheadLock && readAheadWake && readAheadData)
+		readAheadThread = Sys_CreateThread(S_ReadAheadThread, NULL);
+
+	if(!readAheadThread)
+	{
+		Com_Printf(S_COLOR_YELLOW "WARNING: couldn't start the sound read-ahead thread\n");
+
+		if(readAheadLock)
+			Sys_DestroyMutex(readAheadLock);
+		if(readAheadWake)
+			Sys_DestroySemaphore(readAheadWake);
+		if(readAheadData)
+			Sys_DestroySemaphore(readAheadData);
+
+		readAheadLock = NULL;
+		readAheadWake = readAheadData = NULL;
+		return qfalse;
+	}
+
+	return qtrue;
+}
+
+/*
+=================
+S_ReadAheadStop
+=================
+*/
+static void S_ReadAheadStop(void)
+{
+	if(!readAheadThread)
+		return;
+
+	Sys_LockMutex(readAheadLock);
+	readAheadQuit = qtrue;
+	Sys_UnlockMutex(readAheadLock);
+	Sys_PostSemaphore(readAheadWake);
+
+	Sys_JoinThread(readAheadThread);
+	readAheadThread = NULL;
+
+	// streams still open go back to decoding on the client
+	while(readAheadStreams)
+	{
+		snd_readahead_t *ra = readAheadStreams;
+
+		readAheadStreams = ra->next;
+		ra->stream->ahead = NULL;
+		Z_Free(ra->buffer);
+		Z_Free(ra);
+	}
+
+	Sys_DestroyMutex(readAheadLock);
+	Sys_DestroySemaphore(readAheadWake);
+	Sys_DestroySemaphore(readAheadData);
+	readAheadLock = NULL;
+	readAheadWake = readAheadData = NULL;
+}
+
+/*
+=================
+S_ReadAheadAttach
+
+Hands a freshly opened stream over to the read-ahead thread
+=================
+*/
+static void S_ReadAheadAttach(snd_stream_t *stream)
+{
+	snd_readahead_t *ra;
+	unsigned bytes, size;
+
+	if(s_streamReadAhead->integer <= 0 || !S_ReadAheadStart())
+		return;
+
+	bytes = (unsigned)stream->info.rate * stream->info.width * stream->info.channels / 1000;
+	bytes *= MIN(s_streamReadAhead->integer, 10000);
+
+	for(size = READAHEAD_MIN_SIZE; size < bytes; size <<= 1)
+		;
+
+	ra = Z_Malloc(sizeof(*ra));
+	ra->stream = stream;
+	ra->buffer = Z_Malloc(size);
+	ra->size = size;
+
+	Sys_LockMutex(readAheadLock);
+	ra->next = readAheadStreams;
+	readAheadStreams = ra;
+	stream->ahead = ra;
+	Sys_UnlockMutex(readAheadLock);
+
+	Sys_PostSemaphore(readAheadWake);
+}
+
+/*
+=================
+S_ReadAheadDetach
+
+Takes a stream back from the read-ahead thread before it's closed
+=================
+*/
+static void S_ReadAheadDetach(snd_stream_t *stream)
+{
+	snd_readahead_t *ra = stream->ahead, **prev;
+
+	Sys_LockMutex(readAheadLock);
+
+	while(ra->busy)
+	{
+		ra->waiting = qtrue;
+		Sys_UnlockMutex(readAheadLock);
+		Sys_WaitSemaphore(readAheadData);
+		Sys_LockMutex(readAheadLock);
+	}
+
+	for(prev = &readAheadStreams; *prev; prev = &(*prev)->next)
+	{
+		if(*prev == ra)
+		{
+			*prev = ra->next;
+			break;
+		}
+	}
+
+	stream->ahead = NULL;
+	Sys_UnlockMutex(readAheadLock);
+
+	Z_Free(ra->buffer);
+	Z_Free(ra);
+}
+
+/*
+=================
+S_ReadAheadRead
+
+Copies out decoded samples, only waits for the thread when the ring ran dry
+=================
+*/
+static int S_ReadAheadRead(snd_stream_t *stream, int bytes, void *buffer)
+{
+	snd_readahead_t *ra = stream->ahead;
+	int frame = stream->info.width * stream->info.channels;
+	unsigned avail, ofs, len, n;
+
+	if(bytes <= 0)
+		return 0;
+
+	Sys_LockMutex(readAheadLock);
+
+	while(ra->writePos == ra->readPos && !ra->eof)
+	{
+		ra->waiting = qtrue;
+		Sys_UnlockMutex(readAheadLock);
+		Sys_PostSemaphore(readAheadWake);
+		Sys_WaitSemaphore(readAheadData);
+		Sys_LockMutex(readAheadLock);
+	}
+
+	avail = ra->writePos - ra->readPos;
+	Sys_UnlockMutex(readAheadLock);
+
+	// keep the copies on whole sample frames, but drain the tail
+	n = MIN((unsigned)bytes, avail);
+	if(frame > 0 && n > (unsigned)frame)
+		n -= n % frame;
+
+	ofs = ra->readPos & (ra->size - 1);
+	len = MIN(n, ra->size - ofs);
+
+	Com_Memcpy(buffer, ra->buffer + ofs, len);
+	Com_Memcpy((byte *)buffer + len, ra->buffer, n - len);
+
+	Sys_LockMutex(readAheadLock);
+	ra->readPos += n;
+	Sys_UnlockMutex(readAheadLock);
+
+	Sys_PostSemaphore(readAheadWake);
+
+	return n;
+}
+
 /*
 =================
 S_CodecGetSound
@@ -124,6 +441,8 @@ void S_CodecInit()
 {
 	codecs = NULL;
 
+	s_streamReadAhead = Cvar_Get("s_streamReadAhead", "1000", CVAR_ARCHIVE);
+
 #ifdef USE_CODEC_OPUS
 	S_CodecRegister(&opus_codec);
 #endif
@@ -143,6 +462,7 @@ S_CodecShutdown
 */
 void S_CodecShutdown()
 {
+	S_ReadAheadStop();
 	codecs = NULL;
 }
 
@@ -174,16 +494,27 @@ S_CodecOpenStream
 */
 snd_stream_t *S_CodecOpenStream(const char *filename)
 {
-	return S_CodecGetSound(filename, NULL);
+	snd_stream_t *stream = S_CodecGetSound(filename, NULL);
+
+	if(stream)
+		S_ReadAheadAttach(stream);
+
+	return stream;
 }
 
 void S_CodecCloseStream(snd_stream_t *stream)
 {
+	if(stream->ahead)
+		S_ReadAheadDetach(stream);
+
 	stream->codec->close(stream);
 }
 
 int S_CodecReadStream(snd_stream_t *stream, int bytes, void *buffer)
 {
+	if(stream->ahead)
+		return S_ReadAheadRead(stream, bytes, buffer);
+
 	return stream->codec->read(stream, bytes, buffer);
 }
 
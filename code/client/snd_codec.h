@@ -38,6 +38,7 @@ typedef struct snd_info_s
 } snd_info_t;
 
 typedef struct snd_codec_s snd_codec_t;
+typedef struct snd_readahead_s snd_readahead_t;
 
 typedef struct snd_stream_s
 {
@@ -47,6 +48,7 @@ typedef struct snd_stream_s
 	int length;
 	int pos;
 	void *ptr;
+	snd_readahead_t *ahead;	// decoded by the read-ahead thread, see s_streamReadAhead
 } snd_stream_t;
 
 // Codec functions
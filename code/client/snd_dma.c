@@ -81,10 +81,32 @@ cvar_t		*s_testsound;
 cvar_t		*s_show;
 cvar_t		*s_mixahead;
 cvar_t		*s_mixPreStep;
+cvar_t		*s_simd;
+cvar_t		*s_threadedMix;
+cvar_t		*s_compression;
+
+// s_threadedMix is active, see S_Base_MixThread
+static qboolean	s_mixThreaded;
+static Q_THREADLOCAL qboolean	s_onMixThread;
 
 loopSound_t	loopSounds[MAX_GENTITIES];
 static	channel_t		*freelist = NULL;
 
+channel_t	*s_activeChannels[MAX_CHANNELS];
+int			s_numActiveChannels;
+static int	s_activeSlots[MAX_CHANNELS];	// of each of s_channels in s_activeChannels
+
+// S_SpatializeChannels works on one array per component
+static struct {
+	float		x[MAX_CHANNELS];
+	float		y[MAX_CHANNELS];
+	float		z[MAX_CHANNELS];
+	float		master_vol[MAX_CHANNELS];
+	int			leftvol[MAX_CHANNELS];
+	int			rightvol[MAX_CHANNELS];
+	channel_t	*ch[MAX_CHANNELS];
+} s_spatial;
+
 int						s_rawend[MAX_RAW_STREAMS];
 portable_samplepair_t s_rawsamples[MAX_RAW_STREAMS][MAX_RAW_SAMPLES];
 
@@ -182,6 +204,12 @@ void S_Base_SoundList( void ) {
 
 
 void S_ChannelFree(channel_t *v) {
+	int		slot;
+
+	slot = s_activeSlots[v - s_channels];
+	s_activeChannels[slot] = s_activeChannels[--s_numActiveChannels];
+	s_activeSlots[s_activeChannels[slot] - s_channels] = slot;
+
 	v->thesfx = NULL;
 	*(channel_t **)v = freelist;
 	freelist = (channel_t*)v;
@@ -195,6 +223,9 @@ channel_t*	S_ChannelMalloc( void ) {
 	v = freelist;
 	freelist = *(channel_t **)freelist;
 	v->allocTime = Com_Milliseconds();
+
+	s_activeSlots[v - s_channels] = s_numActiveChannels;
+	s_activeChannels[s_numActiveChannels++] = v;
 	return v;
 }
 
@@ -212,6 +243,7 @@ void S_ChannelSetup( void ) {
 	
 	*(channel_t **)q = NULL;
 	freelist = p + MAX_CHANNELS - 1;
+	s_numActiveChannels = 0;
 	Com_DPrintf("Channel memory manager started\n");
 }
 
@@ -354,7 +386,9 @@ Creates a default buzz sound if the file can't be loaded
 sfxHandle_t	S_Base_RegisterSound( const char *name, qboolean compressed ) {
 	sfx_t	*sfx;
 
-	compressed = qfalse;
+	// mono sounds are kept as adpcm, the ones being played are decoded
+	// into the hot cache by S_WarmSound
+	compressed = s_compression->integer ? qtrue : qfalse;
 	if (!s_soundStarted) {
 		return 0;
 	}
@@ -415,6 +449,30 @@ void S_memoryLoad(sfx_t	*sfx) {
 
 //=============================================================================
 
+/*
+=================
+S_ChannelDPrintf
+
+Com_Printf isn't thread safe, so channel diagnostics are dropped when
+the channels are run by the audio thread
+=================
+*/
+static void QDECL S_ChannelDPrintf( const char *fmt, ... ) __attribute__ ((format (printf, 1, 2)));
+static void QDECL S_ChannelDPrintf( const char *fmt, ... ) {
+	va_list		argptr;
+	char		msg[MAXPRINTMSG];
+
+	if ( s_onMixThread ) {
+		return;
+	}
+
+	va_start( argptr, fmt );
+	Q_vsnprintf( msg, sizeof( msg ), fmt, argptr );
+	va_end( argptr );
+
+	Com_DPrintf( "%s", msg );
+}
+
 /*
 =================
 S_SpatializeOrigin
@@ -474,6 +532,97 @@ void S_SpatializeOrigin (vec3_t origin, int master_vol, int *left_vol, int *righ
 		*left_vol = 0;
 }
 
+/*
+=================
+S_SpatializeChannels
+
+S_SpatializeOrigin for the count channels in s_spatial, four at a time
+with SSE2 or NEON if s_simd is set
+=================
+*/
+static void S_SpatializeChannels( int count )
+{
+	vec3_t	origin;
+	int		i;
+
+	i = 0;
+#ifdef USE_SIMD_MIX
+	// mono isn't worth another version
+	if ( s_simd->integer && dma.channels != 1 ) {
+#if defined( USE_SSE_MIX )
+		const __m128	ox = _mm_set1_ps( listener_origin[0] );
+		const __m128	oy = _mm_set1_ps( listener_origin[1] );
+		const __m128	oz = _mm_set1_ps( listener_origin[2] );
+		const __m128	ax = _mm_set1_ps( listener_axis[1][0] );
+		const __m128	ay = _mm_set1_ps( listener_axis[1][1] );
+		const __m128	az = _mm_set1_ps( listener_axis[1][2] );
+		const __m128	zero = _mm_setzero_ps();
+		const __m128	half = _mm_set1_ps( 0.5f );
+		const __m128	one = _mm_set1_ps( 1.0f );
+		__m128	dx, dy, dz, len, inv, dist, dot, vol;
+
+		for ( ; i + 4 <= count ; i += 4 ) {
+			dx = _mm_sub_ps( _mm_loadu_ps( s_spatial.x + i ), ox );
+			dy = _mm_sub_ps( _mm_loadu_ps( s_spatial.y + i ), oy );
+			dz = _mm_sub_ps( _mm_loadu_ps( s_spatial.z + i ), oz );
+			len = _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) ) );
+			// VectorNormalize leaves a zero vector alone
+			inv = _mm_and_ps( _mm_div_ps( one, len ), _mm_cmpgt_ps( len, zero ) );
+
+			dist = _mm_max_ps( _mm_sub_ps( len, _mm_set1_ps( SOUND_FULLVOLUME ) ), zero );
+			dist = _mm_sub_ps( one, _mm_mul_ps( dist, _mm_set1_ps( SOUND_ATTENUATE ) ) );
+			vol = _mm_mul_ps( _mm_loadu_ps( s_spatial.master_vol + i ), dist );
+
+			dot = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, ax ), _mm_mul_ps( dy, ay ) ), _mm_mul_ps( dz, az ) );
+			dot = _mm_mul_ps( dot, inv );
+
+			// dot is the rotated y, where S_SpatializeOrigin has minus that
+			_mm_storeu_si128( (__m128i *)( s_spatial.rightvol + i ), _mm_cvttps_epi32( _mm_max_ps(
+				_mm_mul_ps( vol, _mm_max_ps( _mm_mul_ps( half, _mm_sub_ps( one, dot ) ), zero ) ), zero ) ) );
+			_mm_storeu_si128( (__m128i *)( s_spatial.leftvol + i ), _mm_cvttps_epi32( _mm_max_ps(
+				_mm_mul_ps( vol, _mm_max_ps( _mm_mul_ps( half, _mm_add_ps( one, dot ) ), zero ) ), zero ) ) );
+		}
+#else
+		const float32x4_t	ox = vdupq_n_f32( listener_origin[0] );
+		const float32x4_t	oy = vdupq_n_f32( listener_origin[1] );
+		const float32x4_t	oz = vdupq_n_f32( listener_origin[2] );
+		const float32x4_t	zero = vdupq_n_f32( 0.0f );
+		const float32x4_t	one = vdupq_n_f32( 1.0f );
+		float32x4_t	dx, dy, dz, len, inv, dist, dot, vol;
+
+		for ( ; i + 4 <= count ; i += 4 ) {
+			dx = vsubq_f32( vld1q_f32( s_spatial.x + i ), ox );
+			dy = vsubq_f32( vld1q_f32( s_spatial.y + i ), oy );
+			dz = vsubq_f32( vld1q_f32( s_spatial.z + i ), oz );
+			len = vsqrtq_f32( vaddq_f32( vaddq_f32( vmulq_f32( dx, dx ), vmulq_f32( dy, dy ) ), vmulq_f32( dz, dz ) ) );
+			// VectorNormalize leaves a zero vector alone
+			inv = vreinterpretq_f32_u32( vandq_u32( vreinterpretq_u32_f32( vdivq_f32( one, len ) ), vcgtq_f32( len, zero ) ) );
+
+			dist = vmaxq_f32( vsubq_f32( len, vdupq_n_f32( SOUND_FULLVOLUME ) ), zero );
+			dist = vsubq_f32( one, vmulq_n_f32( dist, SOUND_ATTENUATE ) );
+			vol = vmulq_f32( vld1q_f32( s_spatial.master_vol + i ), dist );
+
+			dot = vmulq_n_f32( dx, listener_axis[1][0] );
+			dot = vmlaq_n_f32( dot, dy, listener_axis[1][1] );
+			dot = vmlaq_n_f32( dot, dz, listener_axis[1][2] );
+			dot = vmulq_f32( dot, inv );
+
+			// dot is the rotated y, where S_SpatializeOrigin has minus that
+			vst1q_s32( s_spatial.rightvol + i, vcvtq_s32_f32( vmaxq_f32(
+				vmulq_f32( vol, vmaxq_f32( vmulq_n_f32( vsubq_f32( one, dot ), 0.5f ), zero ) ), zero ) ) );
+			vst1q_s32( s_spatial.leftvol + i, vcvtq_s32_f32( vmaxq_f32(
+				vmulq_f32( vol, vmaxq_f32( vmulq_n_f32( vaddq_f32( one, dot ), 0.5f ), zero ) ), zero ) ) );
+		}
+#endif
+	}
+#endif
+
+	for ( ; i < count ; i++ ) {
+		VectorSet( origin, s_spatial.x[i], s_spatial.y[i], s_spatial.z[i] );
+		S_SpatializeOrigin( origin, (int)s_spatial.master_vol[i], &s_spatial.leftvol[i], &s_spatial.rightvol[i] );
+	}
+}
+
 // =======================================================================
 // Start a sound effect
 // =======================================================================
@@ -551,7 +700,7 @@ static void S_Base_StartSoundEx( vec3_t origin, int entityNum, int entchannel, s
 		S_memoryLoad(sfx);
 	}
 
-	if ( s_show->integer == 1 ) {
+	if ( s_show->integer == 1 && !s_onMixThread ) {
 		Com_Printf( "%i : %s\n", s_paintedtime, sfx->soundName );
 	}
 
@@ -570,12 +719,12 @@ static void S_Base_StartSoundEx( vec3_t origin, int entityNum, int entchannel, s
 		fullVolume = qtrue;
 	}
 
-	ch = s_channels;
 	inplay = 0;
-	for ( i = 0; i < MAX_CHANNELS ; i++, ch++ ) {		
+	for ( i = 0; i < s_numActiveChannels ; i++ ) {
+		ch = s_activeChannels[i];
 		if (ch->entnum == entityNum && ch->thesfx == sfx) {
 			if (time - ch->allocTime < 30) {
-				Com_DPrintf(S_COLOR_YELLOW "S_StartSound: Double start (%d ms < 30 ms) for %s\n", time - ch->allocTime, sfx->soundName);
+				S_ChannelDPrintf(S_COLOR_YELLOW "S_StartSound: Double start (%d ms < 30 ms) for %s\n", time - ch->allocTime, sfx->soundName);
 				return;
 			}
 			inplay++;
@@ -583,7 +732,7 @@ static void S_Base_StartSoundEx( vec3_t origin, int entityNum, int entchannel, s
 	}
 
 	if (inplay > allowed) {
-		Com_DPrintf(S_COLOR_YELLOW "S_StartSound: %s hit the concurrent channels limit (%d)\n", sfx->soundName, allowed);
+		S_ChannelDPrintf(S_COLOR_YELLOW "S_StartSound: %s hit the concurrent channels limit (%d)\n", sfx->soundName, allowed);
 		return;
 	}
 
@@ -620,14 +769,14 @@ static void S_Base_StartSoundEx( vec3_t origin, int entityNum, int entchannel, s
 					}
 				}
 				if (chosen == -1) {
-					Com_DPrintf(S_COLOR_YELLOW "S_StartSound: No more channels free for %s\n", sfx->soundName);
+					S_ChannelDPrintf(S_COLOR_YELLOW "S_StartSound: No more channels free for %s\n", sfx->soundName);
 					return;
 				}
 			}
 		}
 		ch = &s_channels[chosen];
 		ch->allocTime = sfx->lastTimeUsed;
-		Com_DPrintf(S_COLOR_YELLOW "S_StartSound: No more channels free for %s, dropping earliest sound: %s\n", sfx->soundName, ch->thesfx->soundName);
+		S_ChannelDPrintf(S_COLOR_YELLOW "S_StartSound: No more channels free for %s, dropping earliest sound: %s\n", sfx->soundName, ch->thesfx->soundName);
 	}
 
 	if (origin) {
@@ -646,6 +795,8 @@ static void S_Base_StartSoundEx( vec3_t origin, int entityNum, int entchannel, s
 	ch->rightvol = ch->master_vol;		// unless the game isn't running
 	ch->doppler = qfalse;
 	ch->fullVolume = fullVolume;
+
+	S_WarmSound( sfx );
 }
 
 /*
@@ -788,6 +939,8 @@ void S_Base_AddLoopingSound( int entityNum, const vec3_t origin, const vec3_t ve
 		Com_Error( ERR_DROP, "%s has length 0", sfx->soundName );
 	}
 
+	S_WarmSound( sfx );
+
 	VectorCopy( origin, loopSounds[entityNum].origin );
 	VectorCopy( velocity, loopSounds[entityNum].velocity );
 	loopSounds[entityNum].active = qtrue;
@@ -850,6 +1003,9 @@ void S_Base_AddRealLoopingSound( int entityNum, const vec3_t origin, const vec3_
 	if ( !sfx->soundLength ) {
 		Com_Error( ERR_DROP, "%s has length 0", sfx->soundName );
 	}
+
+	S_WarmSound( sfx );
+
 	VectorCopy( origin, loopSounds[entityNum].origin );
 	VectorCopy( velocity, loopSounds[entityNum].velocity );
 	loopSounds[entityNum].sfx = sfx;
@@ -1121,9 +1277,9 @@ Change the volumes of all the playing sounds for changes in their positions
 ============
 */
 void S_Base_Respatialize( int entityNum, const vec3_t head, vec3_t axis[3], int inwater ) {
-	int			i;
+	int			i, count;
 	channel_t	*ch;
-	vec3_t		origin;
+	const float	*origin;
 
 	if ( !s_soundStarted || s_soundMuted ) {
 		return;
@@ -1135,25 +1291,35 @@ void S_Base_Respatialize( int entityNum, const vec3_t head, vec3_t axis[3], int
 	VectorCopy(axis[1], listener_axis[1]);
 	VectorCopy(axis[2], listener_axis[2]);
 
-	// update spatialization for dynamic sounds	
-	ch = s_channels;
-	for ( i = 0 ; i < MAX_CHANNELS ; i++, ch++ ) {
-		if ( !ch->thesfx ) {
-			continue;
-		}
+	// update spatialization for dynamic sounds, all at once
+	count = 0;
+	for ( i = 0 ; i < s_numActiveChannels ; i++ ) {
+		ch = s_activeChannels[i];
 		// local and first person sounds will always be full volume
 		if (ch->fullVolume) {
 			ch->leftvol = ch->master_vol;
 			ch->rightvol = ch->master_vol;
-		} else {
-			if (ch->fixed_origin) {
-				VectorCopy( ch->origin, origin );
-			} else {
-				VectorCopy( loopSounds[ ch->entnum ].origin, origin );
-			}
+			continue;
+		}
 
-			S_SpatializeOrigin (origin, ch->master_vol, &ch->leftvol, &ch->rightvol);
+		if (ch->fixed_origin) {
+			origin = ch->origin;
+		} else {
+			origin = loopSounds[ ch->entnum ].origin;
 		}
+		s_spatial.x[count] = origin[0];
+		s_spatial.y[count] = origin[1];
+		s_spatial.z[count] = origin[2];
+		s_spatial.master_vol[count] = ch->master_vol;
+		s_spatial.ch[count] = ch;
+		count++;
+	}
+
+	S_SpatializeChannels( count );
+
+	for ( i = 0 ; i < count ; i++ ) {
+		s_spatial.ch[i]->leftvol = s_spatial.leftvol[i];
+		s_spatial.ch[i]->rightvol = s_spatial.rightvol[i];
 	}
 
 	// add loopsounds
@@ -1174,12 +1340,10 @@ qboolean S_ScanChannelStarts( void ) {
 	qboolean		newSamples;
 
 	newSamples = qfalse;
-	ch = s_channels;
 
-	for (i=0; i<MAX_CHANNELS ; i++, ch++) {
-		if ( !ch->thesfx ) {
-			continue;
-		}
+	// backwards, see S_ChannelFree
+	for (i=s_numActiveChannels-1; i>=0 ; i--) {
+		ch = s_activeChannels[i];
 		// if this channel was just started this frame,
 		// set the sample count to it begins mixing
 		// into the very first sample
@@ -1475,9 +1639,13 @@ void S_UpdateBackgroundTrack( void ) {
 
 		if(r > 0)
 		{
-			// add to raw buffer
+			// add to raw buffer, the audio thread of s_threadedMix reads it
+			if ( s_mixThreaded )
+				SNDDMA_BeginPainting();
 			S_Base_RawSamples(0, fileSamples, s_backgroundStream->info.rate,
 				s_backgroundStream->info.width, s_backgroundStream->info.channels, raw, s_musicVolume->value, -1);
+			if ( s_mixThreaded )
+				SNDDMA_Submit();
 		}
 		else
 		{
@@ -1499,6 +1667,37 @@ void S_UpdateBackgroundTrack( void ) {
 }
 
 
+/*
+======================
+S_MarkPlayingSounds
+
+Flags the sounds the mixer is using, playing must hold MAX_SFX entries
+======================
+*/
+void S_MarkPlayingSounds( byte *playing ) {
+	int		i;
+
+	Com_Memset( playing, 0, MAX_SFX );
+
+	for ( i = 0 ; i < MAX_CHANNELS ; i++ ) {
+		if ( s_channels[i].thesfx ) {
+			playing[s_channels[i].thesfx - s_knownSfx] = 1;
+		}
+	}
+
+	for ( i = 0 ; i < numLoopChannels ; i++ ) {
+		if ( loop_channels[i].thesfx ) {
+			playing[loop_channels[i].thesfx - s_knownSfx] = 1;
+		}
+	}
+
+	for ( i = 0 ; i < MAX_GENTITIES ; i++ ) {
+		if ( loopSounds[i].active && loopSounds[i].sfx ) {
+			playing[loopSounds[i].sfx - s_knownSfx] = 1;
+		}
+	}
+}
+
 /*
 ======================
 S_FreeOldestSound
@@ -1509,22 +1708,41 @@ void S_FreeOldestSound( void ) {
 	int	i, oldest, used;
 	sfx_t	*sfx;
 	sndBuffer	*buffer, *nbuffer;
+	byte	playing[MAX_SFX];
+
+	// the chunks of a sound still playing would be reused under its channels
+	S_MarkPlayingSounds( playing );
 
 	oldest = Com_Milliseconds();
 	used = 0;
 
 	for (i=1 ; i < s_numSfx ; i++) {
 		sfx = &s_knownSfx[i];
-		if (sfx->inMemory && sfx->lastTimeUsed<oldest) {
+		if (sfx->inMemory && !playing[i] && sfx->lastTimeUsed<oldest) {
 			used = i;
 			oldest = sfx->lastTimeUsed;
 		}
 	}
 
+	if (!used) {
+		for (i=1 ; i < s_numSfx ; i++) {
+			sfx = &s_knownSfx[i];
+			if (sfx->inMemory && sfx->lastTimeUsed<oldest) {
+				used = i;
+				oldest = sfx->lastTimeUsed;
+			}
+		}
+	}
+
 	sfx = &s_knownSfx[used];
 
 	Com_DPrintf("S_FreeOldestSound: freeing sound %s\n", sfx->soundName);
 
+	S_CoolSound(sfx);
+	if (sfxScratchPointer == sfx) {
+		sfxScratchPointer = NULL;
+	}
+
 	buffer = sfx->soundData;
 	while(buffer != NULL) {
 		nbuffer = buffer->next;
@@ -1535,6 +1753,430 @@ void S_FreeOldestSound( void ) {
 	sfx->soundData = NULL;
 }
 
+/*
+===============================================================================
+
+threaded mixing
+
+With s_threadedMix the audio callback of the SNDDMA driver mixes each block
+right before it is played, instead of the client frame mixing s_mixahead in
+advance. The client pushes the per frame channel state changes into a
+single producer/single consumer ring, which the audio thread drains before
+mixing. Rare calls that load sounds or reset the channels take the device
+lock, drain the ring and run directly.
+
+===============================================================================
+*/
+
+#define	MAX_SOUND_COMMANDS	4096		// must be a power of two
+
+typedef enum {
+	SC_START_SOUND,
+	SC_START_LOCAL_SOUND,
+	SC_CLEAR_LOOPING_SOUNDS,
+	SC_ADD_LOOPING_SOUND,
+	SC_ADD_REAL_LOOPING_SOUND,
+	SC_STOP_LOOPING_SOUND,
+	SC_RESPATIALIZE,
+	SC_UPDATE_ENTITY_POSITION
+} soundCommandType_t;
+
+typedef struct {
+	soundCommandType_t	type;
+	int			entityNum;
+	int			arg;			// entchannel, inwater or killall
+	sfxHandle_t	sfx;
+	qboolean	hasOrigin;
+	vec3_t		origin;			// also the listener head
+	vec3_t		velocity;
+	vec3_t		axis[3];
+} soundCommand_t;
+
+static soundCommand_t	s_commands[MAX_SOUND_COMMANDS];
+static volatile unsigned	s_commandHead;		// written by the client
+static volatile unsigned	s_commandTail;		// written by the audio thread
+
+/*
+=================
+S_Thread_RunCommands
+
+Called by the audio thread, or by the client with the device locked
+=================
+*/
+static void S_Thread_RunCommands( void ) {
+	unsigned		tail, head;
+	soundCommand_t	*cmd;
+
+	tail = s_commandTail;
+	head = s_commandHead;
+	Sys_MemoryBarrier();
+
+	for ( ; tail != head ; tail++ ) {
+		cmd = &s_commands[tail & ( MAX_SOUND_COMMANDS - 1 )];
+
+		switch ( cmd->type ) {
+		case SC_START_SOUND:
+			S_Base_StartSound( cmd->hasOrigin ? cmd->origin : NULL, cmd->entityNum, cmd->arg, cmd->sfx );
+			break;
+		case SC_START_LOCAL_SOUND:
+			S_Base_StartLocalSound( cmd->sfx, cmd->arg );
+			break;
+		case SC_CLEAR_LOOPING_SOUNDS:
+			S_Base_ClearLoopingSounds( cmd->arg );
+			break;
+		case SC_ADD_LOOPING_SOUND:
+			S_Base_AddLoopingSound( cmd->entityNum, cmd->origin, cmd->velocity, cmd->sfx );
+			break;
+		case SC_ADD_REAL_LOOPING_SOUND:
+			S_Base_AddRealLoopingSound( cmd->entityNum, cmd->origin, cmd->velocity, cmd->sfx );
+			break;
+		case SC_STOP_LOOPING_SOUND:
+			S_Base_StopLoopingSound( cmd->entityNum );
+			break;
+		case SC_RESPATIALIZE:
+			S_Base_Respatialize( cmd->entityNum, cmd->origin, cmd->axis, cmd->arg );
+			break;
+		case SC_UPDATE_ENTITY_POSITION:
+			S_Base_UpdateEntityPosition( cmd->entityNum, cmd->origin );
+			break;
+		}
+	}
+
+	// done with the slots before the client may reuse them
+	Sys_MemoryBarrier();
+	s_commandTail = tail;
+}
+
+/*
+=================
+S_Thread_Lock
+
+Stops the audio thread and catches up with the commands it hasn't run yet
+=================
+*/
+static void S_Thread_Lock( void ) {
+	SNDDMA_BeginPainting();
+	S_Thread_RunCommands();
+}
+
+static void S_Thread_Unlock( void ) {
+	SNDDMA_Submit();
+}
+
+/*
+=================
+S_Thread_AllocCommand
+=================
+*/
+static soundCommand_t *S_Thread_AllocCommand( soundCommandType_t type ) {
+	soundCommand_t	*cmd;
+
+	if ( s_commandHead - s_commandTail >= MAX_SOUND_COMMANDS ) {
+		// the audio thread is stalled, make room ourselves
+		S_Thread_Lock();
+		S_Thread_Unlock();
+	}
+	Sys_MemoryBarrier();
+
+	cmd = &s_commands[s_commandHead & ( MAX_SOUND_COMMANDS - 1 )];
+	cmd->type = type;
+	return cmd;
+}
+
+/*
+=================
+S_Thread_PushCommand
+=================
+*/
+static void S_Thread_PushCommand( void ) {
+	Sys_MemoryBarrier();
+	s_commandHead++;
+}
+
+/*
+=================
+S_Thread_LoadSound
+
+Validates a handle and loads the sound on the client, so the audio thread
+never touches the file system or errors out. The ring is drained first
+because loading can free the oldest sound.
+=================
+*/
+static qboolean S_Thread_LoadSound( const char *func, sfxHandle_t sfxHandle, qboolean looping ) {
+	sfx_t	*sfx;
+
+	if ( !s_soundStarted || s_soundMuted ) {
+		return qfalse;
+	}
+
+	if ( sfxHandle < 0 || sfxHandle >= s_numSfx ) {
+		Com_Printf( S_COLOR_YELLOW "%s: handle %i out of range\n", func, sfxHandle );
+		return qfalse;
+	}
+
+	sfx = &s_knownSfx[ sfxHandle ];
+
+	if ( sfx->inMemory == qfalse ) {
+		S_Thread_Lock();
+		S_memoryLoad( sfx );
+		S_Thread_Unlock();
+	}
+
+	if ( looping && !sfx->soundLength ) {
+		Com_Error( ERR_DROP, "%s has length 0", sfx->soundName );
+	}
+
+	return qtrue;
+}
+
+static void S_Thread_StartSound( vec3_t origin, int entityNum, int entchannel, sfxHandle_t sfxHandle ) {
+	soundCommand_t	*cmd;
+
+	if ( !s_soundStarted || s_soundMuted ) {
+		return;
+	}
+
+	if ( !origin && ( entityNum < 0 || entityNum >= MAX_GENTITIES ) ) {
+		Com_Error( ERR_DROP, "S_StartSound: bad entitynum %i", entityNum );
+	}
+
+	if ( !S_Thread_LoadSound( "S_StartSound", sfxHandle, qfalse ) ) {
+		return;
+	}
+
+	cmd = S_Thread_AllocCommand( SC_START_SOUND );
+	cmd->entityNum = entityNum;
+	cmd->arg = entchannel;
+	cmd->sfx = sfxHandle;
+	cmd->hasOrigin = origin != NULL;
+	if ( origin ) {
+		VectorCopy( origin, cmd->origin );
+	}
+	S_Thread_PushCommand();
+}
+
+static void S_Thread_StartLocalSound( sfxHandle_t sfxHandle, int channelNum ) {
+	soundCommand_t	*cmd;
+
+	if ( !S_Thread_LoadSound( "S_StartLocalSound", sfxHandle, qfalse ) ) {
+		return;
+	}
+
+	cmd = S_Thread_AllocCommand( SC_START_LOCAL_SOUND );
+	cmd->arg = channelNum;
+	cmd->sfx = sfxHandle;
+	S_Thread_PushCommand();
+}
+
+static void S_Thread_ClearLoopingSounds( qboolean killall ) {
+	soundCommand_t	*cmd;
+
+	cmd = S_Thread_AllocCommand( SC_CLEAR_LOOPING_SOUNDS );
+	cmd->arg = killall;
+	S_Thread_PushCommand();
+}
+
+static void S_Thread_AddLoopingSound( int entityNum, const vec3_t origin, const vec3_t velocity, sfxHandle_t sfxHandle ) {
+	soundCommand_t	*cmd;
+
+	if ( !S_Thread_LoadSound( "S_AddLoopingSound", sfxHandle, qtrue ) ) {
+		return;
+	}
+
+	cmd = S_Thread_AllocCommand( SC_ADD_LOOPING_SOUND );
+	cmd->entityNum = entityNum;
+	cmd->sfx = sfxHandle;
+	VectorCopy( origin, cmd->origin );
+	VectorCopy( velocity, cmd->velocity );
+	S_Thread_PushCommand();
+}
+
+static void S_Thread_AddRealLoopingSound( int entityNum, const vec3_t origin, const vec3_t velocity, sfxHandle_t sfxHandle ) {
+	soundCommand_t	*cmd;
+
+	if ( !S_Thread_LoadSound( "S_AddRealLoopingSound", sfxHandle, qtrue ) ) {
+		return;
+	}
+
+	cmd = S_Thread_AllocCommand( SC_ADD_REAL_LOOPING_SOUND );
+	cmd->entityNum = entityNum;
+	cmd->sfx = sfxHandle;
+	VectorCopy( origin, cmd->origin );
+	VectorCopy( velocity, cmd->velocity );
+	S_Thread_PushCommand();
+}
+
+static void S_Thread_StopLoopingSound( int entityNum ) {
+	soundCommand_t	*cmd;
+
+	cmd = S_Thread_AllocCommand( SC_STOP_LOOPING_SOUND );
+	cmd->entityNum = entityNum;
+	S_Thread_PushCommand();
+}
+
+static void S_Thread_Respatialize( int entityNum, const vec3_t head, vec3_t axis[3], int inwater ) {
+	soundCommand_t	*cmd;
+
+	cmd = S_Thread_AllocCommand( SC_RESPATIALIZE );
+	cmd->entityNum = entityNum;
+	cmd->arg = inwater;
+	VectorCopy( head, cmd->origin );
+	VectorCopy( axis[0], cmd->axis[0] );
+	VectorCopy( axis[1], cmd->axis[1] );
+	VectorCopy( axis[2], cmd->axis[2] );
+	S_Thread_PushCommand();
+}
+
+static void S_Thread_UpdateEntityPosition( int entityNum, const vec3_t origin ) {
+	soundCommand_t	*cmd;
+
+	if ( entityNum < 0 || entityNum >= MAX_GENTITIES ) {
+		Com_Error( ERR_DROP, "S_UpdateEntityPosition: bad entitynum %i", entityNum );
+	}
+
+	cmd = S_Thread_AllocCommand( SC_UPDATE_ENTITY_POSITION );
+	cmd->entityNum = entityNum;
+	VectorCopy( origin, cmd->origin );
+	S_Thread_PushCommand();
+}
+
+static void S_Thread_RawSamples( int stream, int samples, int rate, int width, int channels, const byte *data, float volume, int entityNum ) {
+	SNDDMA_BeginPainting();
+	S_Base_RawSamples( stream, samples, rate, width, channels, data, volume, entityNum );
+	SNDDMA_Submit();
+}
+
+static void S_Thread_StopAllSounds( void ) {
+	S_Thread_Lock();
+	S_Base_StopAllSounds();
+	S_Thread_Unlock();
+}
+
+static void S_Thread_ClearSoundBuffer( void ) {
+	S_Thread_Lock();
+	S_Base_ClearSoundBuffer();
+	S_Thread_Unlock();
+}
+
+static void S_Thread_DisableSounds( void ) {
+	S_Thread_Lock();
+	S_Base_DisableSounds();
+	S_Thread_Unlock();
+}
+
+static void S_Thread_BeginRegistration( void ) {
+	S_Thread_Lock();
+	S_Base_BeginRegistration();
+	S_Thread_Unlock();
+}
+
+static sfxHandle_t S_Thread_RegisterSound( const char *name, qboolean compressed ) {
+	sfxHandle_t	handle;
+
+	S_Thread_Lock();
+	handle = S_Base_RegisterSound( name, compressed );
+	S_Thread_Unlock();
+
+	return handle;
+}
+
+/*
+=================
+S_Thread_Update
+
+The client only streams the background track, unless a video is being
+recorded, which needs the sound mixed in step with the frames
+=================
+*/
+static void S_Thread_Update( void ) {
+	if ( !s_soundStarted || s_soundMuted ) {
+		return;
+	}
+
+	if ( CL_VideoRecording() ) {
+		S_Thread_Lock();
+		S_Base_Update();
+		S_Thread_Unlock();
+		return;
+	}
+
+	S_UpdateBackgroundTrack();
+}
+
+/*
+=================
+S_Base_MixThread
+
+Called by the SNDDMA audio callback with the device locked, before it
+plays sample pairs from pos in the dma buffer
+=================
+*/
+void S_Base_MixThread( int pos, int samples ) {
+	int		offset;
+
+	if ( !s_mixThreaded ) {
+		return;
+	}
+
+	s_onMixThread = qtrue;
+
+	S_Thread_RunCommands();
+
+	if ( CL_VideoRecording() ) {
+		return;		// the client mixes for the video
+	}
+
+	// keep the painted time in step with the callback position
+	offset = s_paintedtime % dma.fullsamples;
+	if ( offset != pos ) {
+		s_paintedtime += ( pos - offset + dma.fullsamples ) % dma.fullsamples;
+	}
+
+	if ( s_paintedtime > 0x40000000 ) {
+		// time to chop things off to avoid 32 bit limits
+		s_paintedtime = dma.fullsamples + pos;
+		S_Base_ClearSoundBuffer();
+	}
+
+	s_soundtime = s_paintedtime;
+
+	// clear any sound effects that have ended and start any new sounds
+	S_ScanChannelStarts();
+
+	S_PaintChannels( s_paintedtime + samples );
+}
+
+/*
+=================
+S_Thread_Init
+=================
+*/
+static void S_Thread_Init( soundInterface_t *si ) {
+	s_commandHead = s_commandTail = 0;
+
+	si->StartSound = S_Thread_StartSound;
+	si->StartLocalSound = S_Thread_StartLocalSound;
+	si->RawSamples = S_Thread_RawSamples;
+	si->StopAllSounds = S_Thread_StopAllSounds;
+	si->ClearLoopingSounds = S_Thread_ClearLoopingSounds;
+	si->AddLoopingSound = S_Thread_AddLoopingSound;
+	si->AddRealLoopingSound = S_Thread_AddRealLoopingSound;
+	si->StopLoopingSound = S_Thread_StopLoopingSound;
+	si->Respatialize = S_Thread_Respatialize;
+	si->UpdateEntityPosition = S_Thread_UpdateEntityPosition;
+	si->Update = S_Thread_Update;
+	si->DisableSounds = S_Thread_DisableSounds;
+	si->BeginRegistration = S_Thread_BeginRegistration;
+	si->RegisterSound = S_Thread_RegisterSound;
+	si->ClearSoundBuffer = S_Thread_ClearSoundBuffer;
+
+	SNDDMA_BeginPainting();
+	s_mixThreaded = qtrue;
+	SNDDMA_Submit();
+
+	Com_Printf( "Mixing on the audio thread\n" );
+}
+
 // =======================================================================
 // Shutdown sound engine
 // =======================================================================
@@ -1544,6 +2186,10 @@ void S_Base_Shutdown( void ) {
 		return;
 	}
 
+	SNDDMA_BeginPainting();
+	s_mixThreaded = qfalse;
+	SNDDMA_Submit();
+
 	SNDDMA_Shutdown();
 	SND_shutdown();
 
@@ -1569,6 +2215,9 @@ qboolean S_Base_Init( soundInterface_t *si ) {
 	s_mixPreStep = Cvar_Get ("s_mixPreStep", "0.05", CVAR_ARCHIVE);
 	s_show = Cvar_Get ("s_show", "0", CVAR_CHEAT);
 	s_testsound = Cvar_Get ("s_testsound", "0", CVAR_CHEAT);
+	s_simd = Cvar_Get ("s_simd", "1", CVAR_ARCHIVE);
+	s_threadedMix = Cvar_Get ("s_threadedMix", "0", CVAR_ARCHIVE | CVAR_LATCH);
+	s_compression = Cvar_Get ("s_compression", "1", CVAR_ARCHIVE);
 
 	r = SNDDMA_Init();
 
@@ -1617,9 +2266,17 @@ qboolean S_Base_Init( soundInterface_t *si ) {
 #endif
 
 #ifndef NO_DMAHD
-	if (dmaHD_Enabled())
+	if (dmaHD_Enabled()) {
+		if ( s_threadedMix->integer ) {
+			Com_Printf( "s_threadedMix is not supported by dmaHD, mixing on the main thread\n" );
+		}
 		return dmaHD_Init(si);
+	}
 #endif
 
+	if ( s_threadedMix->integer ) {
+		S_Thread_Init( si );
+	}
+
 	return qtrue;
 }
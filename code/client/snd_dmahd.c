@@ -216,6 +216,10 @@ void dmaHD_FreeOldestSound( void )
 	int	i, oldest, used;
 	sfx_t *sfx;
 	short* buffer;
+	byte playing[MAX_SFX];
+
+	// the samples of a sound still playing would be freed under its channels
+	S_MarkPlayingSounds(playing);
 
 	oldest = Com_Milliseconds();
 	used = 0;
@@ -223,13 +227,26 @@ void dmaHD_FreeOldestSound( void )
 	for (i = 1 ; i < s_numSfx ; i++) 
 	{
 		sfx = &s_knownSfx[i];
-		if (sfx->inMemory && sfx->lastTimeUsed < oldest) 
+		if (sfx->inMemory && !playing[i] && sfx->lastTimeUsed < oldest) 
 		{
 			used = i;
 			oldest = sfx->lastTimeUsed;
 		}
 	}
 
+	if (!used)
+	{
+		for (i = 1 ; i < s_numSfx ; i++) 
+		{
+			sfx = &s_knownSfx[i];
+			if (sfx->inMemory && sfx->lastTimeUsed < oldest) 
+			{
+				used = i;
+				oldest = sfx->lastTimeUsed;
+			}
+		}
+	}
+
 	sfx = &s_knownSfx[used];
 
 	Com_DPrintf("dmaHD_FreeOldestSound: freeing sound %s\n", sfx->soundName);
@@ -290,114 +307,95 @@ static float dmaHD_NormalizeSamplePosition(float t, int samples) {
 	while (t>=(float)samples) t-=(float)samples;
 	return t;
 }
-static int dmaHD_GetSampleRaw_8bitMono(int index, int samples, byte* data)
-{
-	if (index < 0) index += samples; else if (index >= samples) index -= samples;
-	return (int)(((byte)(data[index])-128)<<8);
-}
-static int dmaHD_GetSampleRaw_16bitMono(int index, int samples, byte* data)
-{
-	if (index < 0) index += samples; else if (index >= samples) index -= samples;
-	return (int)LittleShort(((short*)data)[index]);
-}
-static int dmaHD_GetSampleRaw_8bitStereo(int index, int samples, byte* data)
-{
-	int left, right;
-	if (index < 0) index += samples; else if (index >= samples) index -= samples;
-	left = (int)(((byte)(data[index * 2])-128)<<8);
-	right = (int)(((byte)(data[index * 2 + 1])-128)<<8);
-	return (left + right) / 2;
-}
-static int dmaHD_GetSampleRaw_16bitStereo(int index, int samples, byte* data)
+// The source as floats, with the sample before it and the two after it wrapped
+// around, so the interpolation below can read x - 1 to x + 2 of any sample x.
+// Stereo is mixed down to mono.
+static float *dmaHD_DecodeSource(int channels, int width, int samples, byte *data)
 {
-	int left, right;
-	if (index < 0) index += samples; else if (index >= samples) index -= samples;
-	left = (int)LittleShort(((short*)data)[index * 2]);
-	right = (int)LittleShort(((short*)data)[index * 2 + 1]);
-	return (left + right) / 2;
-}
+	float *src;
+	int i, j, left, right;
 
-// Get only decimal part (a - floor(a))
-#define FLOAT_DECIMAL_PART(a) (a-(float)((int)a))
+	src = (float*)malloc((samples + 3) * sizeof(float));
+	if (src == NULL) Com_Error (ERR_FATAL, "Out of Memory");
 
-// t must be a float between 0 and samples
-static int dmaHD_GetInterpolatedSampleHermite4pt3oX(float t, int samples, byte *data,
-													int (*dmaHD_GetSampleRaw)(int, int, byte*))
-{
-	int x, val;
+	if (channels == 2 && width == 2)
+	{
+		for (i = 0; i < samples; i++) {
+			left = LittleShort(((short*)data)[i * 2]);
+			right = LittleShort(((short*)data)[i * 2 + 1]);
+			src[i + 1] = (float)((left + right) / 2);
+		}
+	}
+	else if (channels == 2)
+	{
+		for (i = 0; i < samples; i++) {
+			left = (data[i * 2] - 128) * 256;
+			right = (data[i * 2 + 1] - 128) * 256;
+			src[i + 1] = (float)((left + right) / 2);
+		}
+	}
+	else if (width == 2)
+	{
+		for (i = 0; i < samples; i++) src[i + 1] = (float)LittleShort(((short*)data)[i]);
+	}
+	else
+	{
+		for (i = 0; i < samples; i++) src[i + 1] = (float)((data[i] - 128) * 256);
+	}
 
-	t = dmaHD_NormalizeSamplePosition(t, samples);
-	// Get points
-	x = (int)t;
-	// Interpolate
-	val = (int)dmaHD_InterpolateHermite4pt3oX(
-		(float)dmaHD_GetSampleRaw(x - 1, samples, data),
-		(float)dmaHD_GetSampleRaw(x, samples, data),
-		(float)dmaHD_GetSampleRaw(x + 1, samples, data),
-		(float)dmaHD_GetSampleRaw(x + 2, samples, data), FLOAT_DECIMAL_PART(t));
-	// Clamp
-	return SMPCLAMP(val);
+	if (samples <= 0) return src;
+	src[0] = src[samples];
+	for (j = 0; j < 2; j++) src[samples + 1 + j] = src[1 + (j % samples)];
+
+	return src;
 }
 
-// t must be a float between 0 and samples
-static int dmaHD_GetInterpolatedSampleCubic(float t, int samples, byte *data,
-											int (*dmaHD_GetSampleRaw)(int, int, byte*))
-{
-	int x, val;
+// dmaHD_interpolation when dmaHD started, 0 none, 1 linear, 2 cubic, 3 hermite
+static int dmaHD_interpolation = 3;
 
-	t = dmaHD_NormalizeSamplePosition(t, samples);
-	// Get points
-	x = (int)t;
-	// Interpolate
-	val = (int)dmaHD_InterpolateCubic(
-		(float)dmaHD_GetSampleRaw(x - 1, samples, data),
-		(float)dmaHD_GetSampleRaw(x, samples, data),
-		(float)dmaHD_GetSampleRaw(x + 1, samples, data),
-		(float)dmaHD_GetSampleRaw(x + 2, samples, data), FLOAT_DECIMAL_PART(t));
-	// Clamp
-	return SMPCLAMP(val);
-}
+// Get only decimal part (a - floor(a))
+#define FLOAT_DECIMAL_PART(a) (a-(float)((int)a))
 
-// t must be a float between 0 and samples
-static int dmaHD_GetInterpolatedSampleLinear(float t, int samples, byte *data,
-											 int (*dmaHD_GetSampleRaw)(int, int, byte*))
+// The sample at t, t between 0 and samples after the wrap. src is from dmaHD_DecodeSource.
+static ID_INLINE int dmaHD_GetNoInterpolationSample(float t, int samples, const float *src)
 {
-	int x, val;
-	float c0, c1;
+	int x;
 
+	if (samples <= 0) return 0;
 	t = dmaHD_NormalizeSamplePosition(t, samples);
-
-	// Get points
 	x = (int)t;
-	
-	c0 = (float)dmaHD_GetSampleRaw(x, samples, data);
-	c1 = (float)dmaHD_GetSampleRaw(x+1, samples, data);
-	
-	val = (int)(((c1 - c0) * FLOAT_DECIMAL_PART(t)) + c0);
-	// No need to clamp for linear
-	return val;
+	if (FLOAT_DECIMAL_PART(t) > 0.5) x++;
+
+	return (int)src[x + 1];
 }
 
-// t must be a float between 0 and samples
-static int dmaHD_GetNoInterpolationSample(float t, int samples, byte *data,
-										  int (*dmaHD_GetSampleRaw)(int, int, byte*))
+static ID_INLINE int dmaHD_GetInterpolatedSample(int interpolation, float t, int samples, const float *src)
 {
-	int x;
+	const float *p;
+	float frac;
+	int val;
 
+	if (samples <= 0) return 0;
 	t = dmaHD_NormalizeSamplePosition(t, samples);
+	p = &src[(int)t]; // p[0] to p[3] are x - 1 to x + 2
+	frac = FLOAT_DECIMAL_PART(t);
 
-	// Get points
-	x = (int)t;
-	
-	if (FLOAT_DECIMAL_PART(t) > 0.5) x++;
-
-	return dmaHD_GetSampleRaw(x, samples, data);
+	switch (interpolation)
+	{
+	case 0:
+		return dmaHD_GetNoInterpolationSample(t, samples, src);
+	case 1:
+		// No need to clamp for linear
+		return (int)(((p[2] - p[1]) * frac) + p[1]);
+	case 2:
+		val = (int)dmaHD_InterpolateCubic(p[0], p[1], p[2], p[3], frac);
+		return SMPCLAMP(val);
+	default:
+		val = (int)dmaHD_InterpolateHermite4pt3oX(p[0], p[1], p[2], p[3], frac);
+		return SMPCLAMP(val);
+	}
 }
 
-int (*dmaHD_GetInterpolatedSample)(float t, int samples, byte *data, 
-								   int (*dmaHD_GetSampleRaw)(int, int, byte*)) = 
-	dmaHD_GetInterpolatedSampleHermite4pt3oX;
-
 // =======================================================
 // =======================================================
 
@@ -411,7 +409,7 @@ resample / decimate to the current source rate
 void dmaHD_ResampleSfx( sfx_t *sfx, int channels, int inrate, int inwidth, byte *data, qboolean compressed)
 {
 	short* buffer;
-	int (*dmaHD_GetSampleRaw)(int, int, byte*);
+	float *src;
 	float stepscale, idx_smp, sample, bsample;
 	float lp_inva, lp_a, hp_a, lp_data, lp_last, hp_data, hp_last, hp_lastsample;
 	int outcount, idx_hp, idx_lp;
@@ -425,15 +423,13 @@ void dmaHD_ResampleSfx( sfx_t *sfx, int channels, int inrate, int inwidth, byte
 	// Check if this is a weapon sound.
 	sfx->weaponsound = (memcmp(sfx->soundName, "sound/weapons/", 14) == 0) ? qtrue : qfalse;
 
-	if (channels == 2)
-		dmaHD_GetSampleRaw = (inwidth == 2) ? dmaHD_GetSampleRaw_16bitStereo : dmaHD_GetSampleRaw_8bitStereo;
-	else
-		dmaHD_GetSampleRaw = (inwidth == 2) ? dmaHD_GetSampleRaw_16bitMono : dmaHD_GetSampleRaw_8bitMono;
+	// Decode the whole source once instead of sample by sample.
+	src = dmaHD_DecodeSource(channels, inwidth, sfx->soundLength, data);
 
 	// Get last sample from sound effect.
 	idx_smp = -(stepscale * 4.0f);
-	sample = dmaHD_GetInterpolatedSample(idx_smp, sfx->soundLength, data, dmaHD_GetSampleRaw);
-	bsample = dmaHD_GetNoInterpolationSample(idx_smp, sfx->soundLength, data, dmaHD_GetSampleRaw);
+	sample = dmaHD_GetInterpolatedSample(dmaHD_interpolation, idx_smp, sfx->soundLength, src);
+	bsample = dmaHD_GetNoInterpolationSample(idx_smp, sfx->soundLength, src);
 	idx_smp += stepscale;
 
 	// Set up high pass filter.
@@ -452,8 +448,8 @@ void dmaHD_ResampleSfx( sfx_t *sfx, int channels, int inrate, int inwidth, byte
 	// Now do actual high/low pass on actual data.
 	for (;idx_hp < outcount; idx_hp++)
 	{ 
-		sample = dmaHD_GetInterpolatedSample(idx_smp, sfx->soundLength, data, dmaHD_GetSampleRaw);
-		bsample = dmaHD_GetNoInterpolationSample(idx_smp, sfx->soundLength, data, dmaHD_GetSampleRaw);
+		sample = dmaHD_GetInterpolatedSample(dmaHD_interpolation, idx_smp, sfx->soundLength, src);
+		bsample = dmaHD_GetNoInterpolationSample(idx_smp, sfx->soundLength, src);
 		idx_smp += stepscale;
 
 		// High pass.
@@ -467,6 +463,8 @@ void dmaHD_ResampleSfx( sfx_t *sfx, int channels, int inrate, int inwidth, byte
 		buffer[idx_lp++] = SMPCLAMP(lp_data);
 		lp_last = lp_data;
 	}
+
+	free(src);
 	
 	sfx->soundData = (sndBuffer*)buffer;
 	sfx->soundLength = outcount;
@@ -530,13 +528,131 @@ PART#02: dmaHD: Mixing
 ===============================================================================
 */
 
+// The mixers only ever add (sample * vol) >> 8 to one side or both sides of the
+// paintbuffer, these do whole runs of it, with SSE2 or NEON if s_simd is set.
+// Volumes can be negative, behind the viewer.
+#ifdef USE_SIMD_MIX
+#define DMAHD_SIMD_VOL(vol) (s_simd->integer && (vol) >= -0x7fffff && (vol) <= 0x7fffff)
+
+#if defined(USE_SSE_MIX)
+// (sample * vol) >> 8 of eight samples into two times four ints. vol is split so
+// both halves multiply in 16 bits: (s * vol) >> 8 == s * (vol >> 8) + ((s * (vol & 255)) >> 8)
+static ID_INLINE void dmaHD_ScaleSamples(__m128i data, int vol, __m128i *lo, __m128i *hi)
+{
+	__m128i vh = _mm_set1_epi16((short)(vol >> 8)), vl = _mm_set1_epi16((short)(vol & 255));
+	__m128i hl = _mm_mullo_epi16(data, vh), hh = _mm_mulhi_epi16(data, vh);
+	__m128i ll = _mm_mullo_epi16(data, vl), lh = _mm_mulhi_epi16(data, vl);
+
+	*lo = _mm_add_epi32(_mm_unpacklo_epi16(hl, hh), _mm_srai_epi32(_mm_unpacklo_epi16(ll, lh), 8));
+	*hi = _mm_add_epi32(_mm_unpackhi_epi16(hl, hh), _mm_srai_epi32(_mm_unpackhi_epi16(ll, lh), 8));
+}
+
+static ID_INLINE void dmaHD_AddPairs(int *out, __m128i pairs)
+{
+	_mm_storeu_si128((__m128i*)out, _mm_add_epi32(_mm_loadu_si128((const __m128i*)out), pairs));
+}
+#else
+static ID_INLINE int32x4_t dmaHD_ScaleSamples(int16x4_t data, int vol)
+{
+	return vshrq_n_s32(vmulq_n_s32(vmovl_s16(data), vol), 8);
+}
+
+static ID_INLINE void dmaHD_AddPairs(int *out, int32x4_t pairs)
+{
+	vst1q_s32(out, vaddq_s32(vld1q_s32(out), pairs));
+}
+#endif
+#endif
+
+// out[chan], out[chan + 2]... += (samples[i] * vol) >> 8
+static void dmaHD_MixSide(int *out, const short *samples, int count, int vol, int chan)
+{
+	int i = 0;
+
+#ifdef USE_SIMD_MIX
+	if (DMAHD_SIMD_VOL(vol))
+	{
+#if defined(USE_SSE_MIX)
+		__m128i zero = _mm_setzero_si128(), lo, hi;
+
+		for (; i + 8 <= count; i += 8) {
+			dmaHD_ScaleSamples(_mm_loadu_si128((const __m128i*)(samples + i)), vol, &lo, &hi);
+			if (chan) {
+				dmaHD_AddPairs(out + i * 2, _mm_unpacklo_epi32(zero, lo));
+				dmaHD_AddPairs(out + i * 2 + 4, _mm_unpackhi_epi32(zero, lo));
+				dmaHD_AddPairs(out + i * 2 + 8, _mm_unpacklo_epi32(zero, hi));
+				dmaHD_AddPairs(out + i * 2 + 12, _mm_unpackhi_epi32(zero, hi));
+			} else {
+				dmaHD_AddPairs(out + i * 2, _mm_unpacklo_epi32(lo, zero));
+				dmaHD_AddPairs(out + i * 2 + 4, _mm_unpackhi_epi32(lo, zero));
+				dmaHD_AddPairs(out + i * 2 + 8, _mm_unpacklo_epi32(hi, zero));
+				dmaHD_AddPairs(out + i * 2 + 12, _mm_unpackhi_epi32(hi, zero));
+			}
+		}
+#else
+		int32x4_t zero = vdupq_n_s32(0), p;
+		int32x4x2_t pairs;
+
+		for (; i + 4 <= count; i += 4) {
+			p = dmaHD_ScaleSamples(vld1_s16(samples + i), vol);
+			pairs = chan ? vzipq_s32(zero, p) : vzipq_s32(p, zero);
+			dmaHD_AddPairs(out + i * 2, pairs.val[0]);
+			dmaHD_AddPairs(out + i * 2 + 4, pairs.val[1]);
+		}
+#endif
+	}
+#endif
+
+	for (out += chan; i < count; i++) {
+		out[i * 2] += (samples[i] * vol) >> 8;
+	}
+}
+
+// out[0], out[2]... += (samples[i] * lvol) >> 8 and out[1], out[3]... += (samples[i] * rvol) >> 8
+static void dmaHD_MixBoth(int *out, const short *samples, int count, int lvol, int rvol)
+{
+	int i = 0;
+
+#ifdef USE_SIMD_MIX
+	if (DMAHD_SIMD_VOL(lvol) && DMAHD_SIMD_VOL(rvol))
+	{
+#if defined(USE_SSE_MIX)
+		__m128i data, l0, l1, r0, r1;
+
+		for (; i + 8 <= count; i += 8) {
+			data = _mm_loadu_si128((const __m128i*)(samples + i));
+			dmaHD_ScaleSamples(data, lvol, &l0, &l1);
+			dmaHD_ScaleSamples(data, rvol, &r0, &r1);
+			dmaHD_AddPairs(out + i * 2, _mm_unpacklo_epi32(l0, r0));
+			dmaHD_AddPairs(out + i * 2 + 4, _mm_unpackhi_epi32(l0, r0));
+			dmaHD_AddPairs(out + i * 2 + 8, _mm_unpacklo_epi32(l1, r1));
+			dmaHD_AddPairs(out + i * 2 + 12, _mm_unpackhi_epi32(l1, r1));
+		}
+#else
+		int16x4_t data;
+		int32x4x2_t pairs;
+
+		for (; i + 4 <= count; i += 4) {
+			data = vld1_s16(samples + i);
+			pairs = vzipq_s32(dmaHD_ScaleSamples(data, lvol), dmaHD_ScaleSamples(data, rvol));
+			dmaHD_AddPairs(out + i * 2, pairs.val[0]);
+			dmaHD_AddPairs(out + i * 2 + 4, pairs.val[1]);
+		}
+#endif
+	}
+#endif
+
+	for (; i < count; i++) {
+		out[i * 2] += (samples[i] * lvol) >> 8;
+		out[i * 2 + 1] += (samples[i] * rvol) >> 8;
+	}
+}
+
 static void dmaHD_PaintChannelFrom16_HHRTF(channel_t *ch, const sfx_t *sc, int count, int sampleOffset, int bufferOffset, int chan) 
 {
-	int vol, i, so;
+	int vol, so;
 	portable_samplepair_t *samp = &dmaHD_paintbuffer[bufferOffset];
 	short *samples;
-	short *tsamples;
-	int *out;
 	ch_side_t* chs = (chan == 0) ? &ch->l : &ch->r;
 
 	if (dmaHD_snd_vol <= 0) return;
@@ -550,34 +666,22 @@ static void dmaHD_PaintChannelFrom16_HHRTF(channel_t *ch, const sfx_t *sc, int c
 		samples = &((short*)sc->soundData)[sc->soundLength]; // Select bass frequency offset (just after high frequency)
 		// Calculate volumes.
 		vol = chs->bassvol * dmaHD_snd_vol;
-		tsamples = &samples[so];
-		out = (int*)samp;
-		if (chan == 1) out++;
-		for (i = 0; i < count; i++) {
-			*out += (*tsamples * vol) >> 8; ++tsamples; ++out; ++out;
-		}
+		dmaHD_MixSide((int*)samp, &samples[so], count, vol, chan);
 	}
 	if (chs->vol > 0) // Process high frequency
 	{
 		samples = (short*)sc->soundData; // Select high frequency offset.
 		// Calculate volumes.
 		vol = chs->vol * dmaHD_snd_vol;
-		tsamples = &samples[so];
-		out = (int*)samp;
-		if (chan == 1) out++;
-		for (i = 0; i < count; i++) {
-			*out += (*tsamples * vol) >> 8; ++tsamples; ++out; ++out;
-		}
+		dmaHD_MixSide((int*)samp, &samples[so], count, vol, chan);
 	}
 }
 
 static void dmaHD_PaintChannelFrom16_dmaEX2(channel_t *ch, const sfx_t *sc, int count, int sampleOffset, int bufferOffset) 
 {
-	int data, rvol, lvol, i, so;
+	int rvol, lvol, so;
 	portable_samplepair_t *samp = &dmaHD_paintbuffer[bufferOffset];
 	short *samples;
-	short *tsamples;
-	int *out;
 
 	if (dmaHD_snd_vol <= 0) return;
 
@@ -591,14 +695,7 @@ static void dmaHD_PaintChannelFrom16_dmaEX2(channel_t *ch, const sfx_t *sc, int
 		samples = &((short*)sc->soundData)[sc->soundLength]; // Select bass frequency offset (just after high frequency)
 		// Calculate volumes.
 		lvol = ch->l.bassvol * dmaHD_snd_vol;
-		tsamples = &samples[so];
-		out = (int*)samp;
-		for (i = 0; i < count; i++) 
-		{ 
-			data = (*tsamples * lvol) >> 8; ++tsamples;
-			*out += data; ++out; // L
-			*out += data; ++out; // R
-		}
+		dmaHD_MixBoth((int*)samp, &samples[so], count, lvol, lvol);
 	}
 	if (ch->l.vol > 0 || ch->r.vol > 0) // Process high frequency.
 	{
@@ -611,14 +708,7 @@ static void dmaHD_PaintChannelFrom16_dmaEX2(channel_t *ch, const sfx_t *sc, int
 		{
 			if (ch->r.vol > ch->l.vol) lvol = -lvol; else rvol = -rvol;
 		}
-		tsamples = &samples[so];
-		out = (int*)samp;
-		for (i = 0; i < count; i++)
-		{ 
-			*out += (*tsamples * lvol) >> 8; ++out; // L
-			*out += (*tsamples * rvol) >> 8; ++out; // R
-			++tsamples;
-		}
+		dmaHD_MixBoth((int*)samp, &samples[so], count, lvol, rvol);
 	}
 	if (ch->l.reverbvol > 0 || ch->r.reverbvol > 0) // Process high frequency reverb.
 	{
@@ -629,23 +719,15 @@ static void dmaHD_PaintChannelFrom16_dmaEX2(channel_t *ch, const sfx_t *sc, int
 		// Calculate volumes for reverb.
 		lvol = ch->l.reverbvol * dmaHD_snd_vol;
 		rvol = ch->r.reverbvol * dmaHD_snd_vol;
-		tsamples = &samples[so];
-		out = (int*)samp;
-		for (i = 0; i < count; i++)
-		{ 
-			*out += (*tsamples * lvol) >> 8; ++out; // L
-			*out += (*tsamples * rvol) >> 8; ++out; // R
-			++tsamples;
-		}
+		dmaHD_MixBoth((int*)samp, &samples[so], count, lvol, rvol);
 	}
 }
 
 static void dmaHD_PaintChannelFrom16_dmaEX(channel_t *ch, const sfx_t *sc, int count, int sampleOffset, int bufferOffset) 
 {
-	int rvol, lvol, i, so;
+	int rvol, lvol, so;
 	portable_samplepair_t *samp = &dmaHD_paintbuffer[bufferOffset];
 	short *samples, *bsamples;
-	int *out;
 
 	if (dmaHD_snd_vol <= 0) return;
 
@@ -665,13 +747,8 @@ static void dmaHD_PaintChannelFrom16_dmaEX(channel_t *ch, const sfx_t *sc, int c
 	{
 		if (lvol < rvol) lvol = -lvol; else rvol = -rvol;
 	}
-	out = (int*)samp;
-	for (i = 0; i < count; i++) 
-	{ 
-		*out += ((*samples * lvol) >> 8) + ((*bsamples * lvol) >> 8); ++out; // L
-		*out += ((*samples * rvol) >> 8) + ((*bsamples * rvol) >> 8); ++out; // R
-		++samples; ++bsamples;
-	}
+	dmaHD_MixBoth((int*)samp, samples, count, lvol, rvol);
+	dmaHD_MixBoth((int*)samp, bsamples, count, lvol, rvol);
 }
 
 static void dmaHD_PaintChannelFrom16(channel_t *ch, const sfx_t *sc, int count, int sampleOffset, int bufferOffset) 
@@ -778,10 +855,9 @@ void dmaHD_PaintChannels( int endtime )
 #endif
 
 		// paint in the channels.
-		ch = s_channels;
-		for ( i = 0; i < MAX_CHANNELS ; i++, ch++ ) 
+		for ( i = 0; i < s_numActiveChannels ; i++ ) 
 		{
-			if (!ch->thesfx) continue;
+			ch = s_activeChannels[i];
 
 			ltime = s_paintedtime;
 			sc = ch->thesfx;
@@ -1191,10 +1267,9 @@ void dmaHD_Respatialize( int entityNum, const vec3_t head, vec3_t axis[3], int i
 
 	// update spatialization for dynamic sounds	
 	//#pragma omp parallel for private(ch)
-	for (i = 0 ; i < MAX_CHANNELS; i++) 
+	for (i = 0 ; i < s_numActiveChannels; i++) 
 	{
-		ch = &s_channels[i];
-		if (!ch->thesfx) continue;
+		ch = s_activeChannels[i];
 		
 		dmaHD_SpatializeReset(ch);
 		// Anything coming from the view entity will always be full volume
@@ -1397,21 +1472,13 @@ qboolean dmaHD_Init(soundInterface_t *si)
 	}
 
 	dmaHD_Interpolation = Cvar_Get("dmaHD_interpolation", "3", CVAR_ARCHIVE);
-	if (dmaHD_Interpolation->integer == 0)
-	{
-		dmaHD_GetInterpolatedSample = dmaHD_GetNoInterpolationSample;
-	}
-	else if (dmaHD_Interpolation->integer == 1)
-	{
-		dmaHD_GetInterpolatedSample = dmaHD_GetInterpolatedSampleLinear;
-	}
-	else if (dmaHD_Interpolation->integer == 2)
+	if (dmaHD_Interpolation->integer >= 0 && dmaHD_Interpolation->integer <= 2)
 	{
-		dmaHD_GetInterpolatedSample = dmaHD_GetInterpolatedSampleCubic;
+		dmaHD_interpolation = dmaHD_Interpolation->integer;
 	}
-	else //if (dmaHD_Interpolation->integer == 3) // DEFAULT
+	else // DEFAULT
 	{
-		dmaHD_GetInterpolatedSample = dmaHD_GetInterpolatedSampleHermite4pt3oX;
+		dmaHD_interpolation = 3;
 	}
 
 	dmaHD_InitTables();
@@ -26,6 +26,19 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "../qcommon/qcommon.h"
 #include "snd_public.h"
 
+// the mixers of snd_mix.c and snd_dmahd.c have SSE2 and NEON versions, see s_simd
+#if defined( __SSE2__ ) || idx64
+#include <emmintrin.h>
+#define USE_SSE_MIX
+#elif defined( __aarch64__ )
+#include <arm_neon.h>
+#define USE_NEON_MIX
+#endif
+
+#if defined( USE_SSE_MIX ) || defined( USE_NEON_MIX )
+#define USE_SIMD_MIX
+#endif
+
 #define	PAINTBUFFER_SIZE		4096					// this is in samples
 
 #define SND_CHUNK_SIZE			1024					// samples
@@ -51,6 +64,7 @@ typedef	struct sndBuffer_s {
 
 typedef struct sfx_s {
 	sndBuffer		*soundData;
+	sndBuffer		*packedData;			// the adpcm data while soundData holds a decoded copy
 	qboolean		defaultSound;			// couldn't be loaded, so use buzz
 	qboolean		inMemory;				// not in Memory
 	qboolean		soundCompressed;		// not in Memory
@@ -198,6 +212,10 @@ void	SNDDMA_BeginPainting (void);
 
 void	SNDDMA_Submit(void);
 
+// called from the audio callback before it plays sample pairs from pos,
+// mixes them there when s_threadedMix is active
+void	S_Base_MixThread( int pos, int samples );
+
 #ifdef USE_VOIP
 void SNDDMA_StartCapture(void);
 int SNDDMA_AvailableCaptureSamples(void);
@@ -215,6 +233,11 @@ extern	channel_t   s_channels[MAX_CHANNELS];
 extern	channel_t   loop_channels[MAX_CHANNELS];
 extern	int		numLoopChannels;
 
+// the s_channels playing, in no particular order. S_ChannelFree moves the
+// last one into the place of the one freed, so loops that free go backwards
+extern	channel_t	*s_activeChannels[MAX_CHANNELS];
+extern	int		s_numActiveChannels;
+
 extern	int		s_paintedtime;
 extern	vec3_t	listener_forward;
 extern	vec3_t	listener_right;
@@ -232,6 +255,9 @@ extern cvar_t *s_muted;
 extern cvar_t *s_doppler;
 
 extern cvar_t *s_testsound;
+extern cvar_t *s_simd;
+extern cvar_t *s_threadedMix;
+extern cvar_t *s_compression;
 
 qboolean S_LoadSound( sfx_t *sfx );
 
@@ -258,6 +284,11 @@ void S_AdpcmGetSamples(sndBuffer *chunk, short *to);
 #define SENTINEL_MULAW_FOUR_BIT_RUN 126
 
 void S_FreeOldestSound( void );
+void S_MarkPlayingSounds( byte *playing );
+
+// the hot cache of decoded adpcm sounds
+void S_WarmSound( sfx_t *sfx );
+void S_CoolSound( sfx_t *sfx );
 
 #define	NXStream byte
 
@@ -284,11 +284,18 @@ S_RegisterSound
 */
 sfxHandle_t	S_RegisterSound( const char *sample, qboolean compressed )
 {
-	if( si.RegisterSound ) {
-		return si.RegisterSound( sample, compressed );
-	} else {
+	memClass_t	oldClass;
+	sfxHandle_t	sfx;
+
+	if( !si.RegisterSound ) {
 		return 0;
 	}
+
+	oldClass = Com_SetMemClass( MEMCLASS_SOUND );
+	sfx = si.RegisterSound( sample, compressed );
+	Com_SetMemClass( oldClass );
+
+	return sfx;
 }
 
 /*
@@ -34,6 +34,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "snd_dmahd.h"
 
 #define DEF_COMSOUNDMEGS "8"
+#define DEF_COMSOUNDHOTMEGS "2"
 
 /*
 ===============================================================================
@@ -48,6 +49,15 @@ static	sndBuffer	*freelist = NULL;
 static	int inUse = 0;
 static	int totalInUse = 0;
 
+extern	sfx_t		s_knownSfx[];
+extern	int			s_numSfx;
+
+// decoded copies of adpcm sounds, see S_WarmSound
+static	sndBuffer	*hotBuffer = NULL;
+static	sndBuffer	*hotFreelist = NULL;
+static	int hotFree = 0;
+static	int hotTotal = 0;
+
 short *sfxScratchBuffer = NULL;
 sfx_t *sfxScratchPointer = NULL;
 int	   sfxScratchIndex = 0;
@@ -103,6 +113,22 @@ void SND_setup(void) {
 	*(sndBuffer **)q = NULL;
 	freelist = p + scs - 1;
 
+	cv = Cvar_Get( "com_soundHotMegs", DEF_COMSOUNDHOTMEGS, CVAR_LATCH | CVAR_ARCHIVE );
+
+	hotTotal = MAX(cv->integer, 0) * 1536;
+	hotBuffer = hotTotal ? malloc(hotTotal*sizeof(sndBuffer)) : NULL;
+	hotFreelist = NULL;
+	hotFree = 0;
+
+	if (!hotBuffer)
+		hotTotal = 0;
+
+	for (p = hotBuffer; p < hotBuffer + hotTotal; p++) {
+		*(sndBuffer **)p = hotFreelist;
+		hotFreelist = p;
+		hotFree++;
+	}
+
 	Com_Printf("Sound memory manager started\n");
 }
 
@@ -110,6 +136,127 @@ void SND_shutdown(void)
 {
 		free(sfxScratchBuffer);
 		free(buffer);
+		free(hotBuffer);
+		hotBuffer = hotFreelist = NULL;
+		hotFree = hotTotal = 0;
+}
+
+/*
+================
+S_CoolSound
+
+Drops the decoded copy of a sound, it plays from its adpcm data again
+================
+*/
+void S_CoolSound( sfx_t *sfx ) {
+	sndBuffer	*chunk, *next;
+
+	if (!sfx->packedData) {
+		return;
+	}
+
+	for (chunk = sfx->soundData; chunk; chunk = next) {
+		next = chunk->next;
+		*(sndBuffer **)chunk = hotFreelist;
+		hotFreelist = chunk;
+		hotFree++;
+	}
+
+	sfx->soundData = sfx->packedData;
+	sfx->packedData = NULL;
+	sfx->soundCompressionMethod = 1;
+}
+
+/*
+================
+S_CoolOldestSound
+
+Makes room in the hot cache, never for the sound being warmed up
+================
+*/
+static qboolean S_CoolOldestSound( sfx_t *keep ) {
+	int		i, oldest;
+	sfx_t	*sfx, *used;
+
+	oldest = Com_Milliseconds() + 1;
+	used = NULL;
+
+	for (i = 0, sfx = s_knownSfx; i < s_numSfx; i++, sfx++) {
+		if (sfx->packedData && sfx != keep && sfx->lastTimeUsed <= oldest) {
+			used = sfx;
+			oldest = sfx->lastTimeUsed;
+		}
+	}
+
+	if (!used) {
+		return qfalse;
+	}
+
+	S_CoolSound(used);
+	return qtrue;
+}
+
+/*
+================
+S_WarmSound
+
+Decodes an adpcm sound into the small hot cache when it is played, so
+it is mixed from 16 bit samples until the cache needs the room for
+something played more recently. Channels keep their sample position
+across the switch, both forms index the same samples.
+================
+*/
+void S_WarmSound( sfx_t *sfx ) {
+	short		samples[SND_CHUNK_SIZE*4];
+	sndBuffer	*packed, *chunk, *head, *last;
+	int			needed, offset, count, n;
+
+	if (sfx->soundCompressionMethod != 1 || !sfx->soundData) {
+		return;
+	}
+
+	// long sounds would flush everything else, leave them compressed
+	needed = (sfx->soundLength + SND_CHUNK_SIZE - 1) / SND_CHUNK_SIZE;
+	if (needed > hotTotal / 4) {
+		return;
+	}
+
+	while (hotFree < needed) {
+		if (!S_CoolOldestSound(sfx)) {
+			return;
+		}
+	}
+
+	head = last = NULL;
+	offset = 0;
+	for (packed = sfx->soundData; packed && offset < sfx->soundLength; packed = packed->next) {
+		S_AdpcmGetSamples(packed, samples);
+
+		for (n = 0; n < SND_CHUNK_SIZE*4 && offset < sfx->soundLength; n += count, offset += count) {
+			count = MIN(SND_CHUNK_SIZE, sfx->soundLength - offset);
+
+			chunk = hotFreelist;
+			hotFreelist = *(sndBuffer **)chunk;
+			hotFree--;
+
+			Com_Memcpy(chunk->sndChunk, samples + n, count * sizeof(short));
+			chunk->next = NULL;
+			if (last) {
+				last->next = chunk;
+			} else {
+				head = chunk;
+			}
+			last = chunk;
+		}
+	}
+
+	if (!head) {
+		return;
+	}
+
+	sfx->packedData = sfx->soundData;
+	sfx->soundData = head;
+	sfx->soundCompressionMethod = 0;
 }
 
 /*
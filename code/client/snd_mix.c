@@ -108,6 +108,49 @@ LClampDone2:
 
 #endif
 
+#ifdef USE_SIMD_MIX
+/*
+===================
+S_WriteLinearBlastStereo16_simd
+
+Eight samples at a time, the saturating packs clip them
+===================
+*/
+static void S_WriteLinearBlastStereo16_simd( void )
+{
+	int		i;
+	int		val;
+
+	i = 0;
+#if defined( USE_SSE_MIX )
+	for ( ; i + 8 <= snd_linear_count ; i += 8 )
+	{
+		__m128i a = _mm_srai_epi32( _mm_loadu_si128( (const __m128i *)( snd_p + i ) ), 8 );
+		__m128i b = _mm_srai_epi32( _mm_loadu_si128( (const __m128i *)( snd_p + i + 4 ) ), 8 );
+		_mm_storeu_si128( (__m128i *)( snd_out + i ), _mm_packs_epi32( a, b ) );
+	}
+#else
+	for ( ; i + 8 <= snd_linear_count ; i += 8 )
+	{
+		int16x4_t a = vqshrn_n_s32( vld1q_s32( snd_p + i ), 8 );
+		int16x4_t b = vqshrn_n_s32( vld1q_s32( snd_p + i + 4 ), 8 );
+		vst1q_s16( snd_out + i, vcombine_s16( a, b ) );
+	}
+#endif
+
+	for ( ; i < snd_linear_count ; i++ )
+	{
+		val = snd_p[i]>>8;
+		if (val > 0x7fff)
+			snd_out[i] = 0x7fff;
+		else if (val < -32768)
+			snd_out[i] = -32768;
+		else
+			snd_out[i] = val;
+	}
+}
+#endif
+
 void S_TransferStereo16 (unsigned long *pbuf, int endtime)
 {
 	int		lpos;
@@ -129,7 +172,12 @@ void S_TransferStereo16 (unsigned long *pbuf, int endtime)
 		snd_linear_count <<= 1; // snd_linear_count *= dma.channels
 
 	// write a linear blast of samples
-		S_WriteLinearBlastStereo16 ();
+#ifdef USE_SIMD_MIX
+		if ( s_simd->integer )
+			S_WriteLinearBlastStereo16_simd ();
+		else
+#endif
+			S_WriteLinearBlastStereo16 ();
 
 		snd_p += snd_linear_count;
 		ls_paintedtime += (snd_linear_count>>1); // snd_linear_count / dma.channels
@@ -352,6 +400,189 @@ static void S_PaintChannelFrom16_scalar( channel_t *ch, const sfx_t *sc, int cou
 	}
 }
 
+#ifdef USE_SIMD_MIX
+#if defined( USE_SSE_MIX )
+/*
+The volumes go up to 255 * 255, so they are multiplied as unsigned 16 bit
+numbers, and the high halves of the products made signed again: minus
+the volume where the sample was negative.
+*/
+static ID_INLINE void S_ScaleSamples( __m128i data, __m128i vol, __m128i *lo, __m128i *hi ) {
+	__m128i	l, h;
+
+	l = _mm_mullo_epi16( data, vol );
+	h = _mm_sub_epi16( _mm_mulhi_epu16( data, vol ), _mm_and_si128( vol, _mm_srai_epi16( data, 15 ) ) );
+	*lo = _mm_srai_epi32( _mm_unpacklo_epi16( l, h ), 8 );
+	*hi = _mm_srai_epi32( _mm_unpackhi_epi16( l, h ), 8 );
+}
+
+static ID_INLINE void S_AddSamples( portable_samplepair_t *samp, __m128i pair ) {
+	_mm_storeu_si128( (__m128i *)samp, _mm_add_epi32( _mm_loadu_si128( (const __m128i *)samp ), pair ) );
+}
+#else
+static ID_INLINE void S_AddSamples( portable_samplepair_t *samp, int32x4_t pair ) {
+	vst1q_s32( (int *)samp, vaddq_s32( vld1q_s32( (const int *)samp ), pair ) );
+}
+#endif
+
+/*
+===================
+S_MixMono16
+
+Mixes count samples of a mono chunk, the same one into both sides
+===================
+*/
+static void S_MixMono16( portable_samplepair_t *samp, const short *samples, int count, int leftvol, int rightvol ) {
+	int		i, data;
+
+	i = 0;
+#if defined( USE_SSE_MIX )
+	{
+		__m128i	lv = _mm_set1_epi16( (short)leftvol );
+		__m128i	rv = _mm_set1_epi16( (short)rightvol );
+		__m128i	data8, l0, l1, r0, r1;
+
+		for ( ; i + 8 <= count ; i += 8 ) {
+			data8 = _mm_loadu_si128( (const __m128i *)( samples + i ) );
+			S_ScaleSamples( data8, lv, &l0, &l1 );
+			S_ScaleSamples( data8, rv, &r0, &r1 );
+			S_AddSamples( samp + i, _mm_unpacklo_epi32( l0, r0 ) );
+			S_AddSamples( samp + i + 2, _mm_unpackhi_epi32( l0, r0 ) );
+			S_AddSamples( samp + i + 4, _mm_unpacklo_epi32( l1, r1 ) );
+			S_AddSamples( samp + i + 6, _mm_unpackhi_epi32( l1, r1 ) );
+		}
+	}
+#else
+	{
+		int32x4_t	data4;
+		int32x4x2_t	pairs;
+
+		for ( ; i + 4 <= count ; i += 4 ) {
+			data4 = vmovl_s16( vld1_s16( samples + i ) );
+			pairs = vzipq_s32( vshrq_n_s32( vmulq_n_s32( data4, leftvol ), 8 ),
+				vshrq_n_s32( vmulq_n_s32( data4, rightvol ), 8 ) );
+			S_AddSamples( samp + i, pairs.val[0] );
+			S_AddSamples( samp + i + 2, pairs.val[1] );
+		}
+	}
+#endif
+
+	for ( ; i < count ; i++ ) {
+		data = samples[i];
+		samp[i].left += (data * leftvol)>>8;
+		samp[i].right += (data * rightvol)>>8;
+	}
+}
+
+/*
+===================
+S_MixStereo16
+
+Mixes count left and right pairs of a stereo chunk
+===================
+*/
+static void S_MixStereo16( portable_samplepair_t *samp, const short *samples, int count, int leftvol, int rightvol ) {
+	int		i;
+
+	i = 0;
+#if defined( USE_SSE_MIX )
+	{
+		__m128i	vol = _mm_set1_epi32( (int)( ( (unsigned)rightvol << 16 ) | leftvol ) );
+		__m128i	lo, hi;
+
+		for ( ; i + 4 <= count ; i += 4 ) {
+			S_ScaleSamples( _mm_loadu_si128( (const __m128i *)( samples + 2 * i ) ), vol, &lo, &hi );
+			S_AddSamples( samp + i, lo );
+			S_AddSamples( samp + i + 2, hi );
+		}
+	}
+#else
+	{
+		const int	vols[4] = { leftvol, rightvol, leftvol, rightvol };
+		int32x4_t	vol = vld1q_s32( vols );
+		int16x8_t	data8;
+
+		for ( ; i + 4 <= count ; i += 4 ) {
+			data8 = vld1q_s16( samples + 2 * i );
+			S_AddSamples( samp + i, vshrq_n_s32( vmulq_s32( vmovl_s16( vget_low_s16( data8 ) ), vol ), 8 ) );
+			S_AddSamples( samp + i + 2, vshrq_n_s32( vmulq_s32( vmovl_s16( vget_high_s16( data8 ) ), vol ), 8 ) );
+		}
+	}
+#endif
+
+	for ( ; i < count ; i++ ) {
+		samp[i].left += (samples[2 * i] * leftvol)>>8;
+		samp[i].right += (samples[2 * i + 1] * rightvol)>>8;
+	}
+}
+
+/*
+===================
+S_PaintChannelFrom16_simd
+
+S_PaintChannelFrom16_scalar without doppler, a chunk at a time. It gives
+the same samples.
+===================
+*/
+static void S_PaintChannelFrom16_simd( channel_t *ch, const sfx_t *sc, int count, int sampleOffset, int bufferOffset ) {
+	int						leftvol, rightvol;
+	int						i, n, stereo;
+	portable_samplepair_t	*samp;
+	sndBuffer				*chunk;
+
+	leftvol = ch->leftvol*snd_vol;
+	rightvol = ch->rightvol*snd_vol;
+	if ( leftvol < 0 || leftvol > 0xffff || rightvol < 0 || rightvol > 0xffff ) {
+		// s_volume above 1
+		S_PaintChannelFrom16_scalar( ch, sc, count, sampleOffset, bufferOffset );
+		return;
+	}
+
+	if (sc->soundChannels <= 0) {
+		return;
+	}
+
+	samp = &paintbuffer[ bufferOffset ];
+
+	if (ch->doppler) {
+		sampleOffset = sampleOffset*ch->oldDopplerScale;
+	}
+
+	stereo = ( sc->soundChannels == 2 );
+	if ( stereo ) {
+		sampleOffset = ( sampleOffset * 2 ) & ~1;
+	}
+
+	chunk = sc->soundData;
+	while (sampleOffset>=SND_CHUNK_SIZE) {
+		chunk = chunk->next;
+		sampleOffset -= SND_CHUNK_SIZE;
+		if (!chunk) {
+			chunk = sc->soundData;
+		}
+	}
+
+	for ( i = 0 ; i < count ; i += n ) {
+		if ( sampleOffset == SND_CHUNK_SIZE ) {
+			chunk = chunk->next;
+			sampleOffset = 0;
+		}
+
+		n = ( SND_CHUNK_SIZE - sampleOffset ) >> stereo;
+		if ( n > count - i ) {
+			n = count - i;
+		}
+
+		if ( stereo ) {
+			S_MixStereo16( samp + i, chunk->sndChunk + sampleOffset, n, leftvol, rightvol );
+		} else {
+			S_MixMono16( samp + i, chunk->sndChunk + sampleOffset, n, leftvol, rightvol );
+		}
+		sampleOffset += n << stereo;
+	}
+}
+#endif
+
 static void S_PaintChannelFrom16( channel_t *ch, const sfx_t *sc, int count, int sampleOffset, int bufferOffset ) {
 #if idppc_altivec
 	if (com_altivec->integer) {
@@ -359,6 +590,12 @@ static void S_PaintChannelFrom16( channel_t *ch, const sfx_t *sc, int count, int
 		S_PaintChannelFrom16_altivec( paintbuffer, snd_vol, ch, sc, count, sampleOffset, bufferOffset );
 		return;
 	}
+#endif
+#ifdef USE_SIMD_MIX
+	if ( s_simd->integer && ( !ch->doppler || ch->dopplerScale == 1.0f ) ) {
+		S_PaintChannelFrom16_simd( ch, sc, count, sampleOffset, bufferOffset );
+		return;
+	}
 #endif
 	S_PaintChannelFrom16_scalar( ch, sc, count, sampleOffset, bufferOffset );
 }
@@ -550,9 +787,9 @@ void S_PaintChannels( int endtime ) {
 		}
 
 		// paint in the channels.
-		ch = s_channels;
-		for ( i = 0; i < MAX_CHANNELS ; i++, ch++ ) {		
-			if ( !ch->thesfx || (ch->leftvol<0.25 && ch->rightvol<0.25 )) {
+		for ( i = 0; i < s_numActiveChannels ; i++ ) {
+			ch = s_activeChannels[i];
+			if ( ch->leftvol<0.25 && ch->rightvol<0.25 ) {
 				continue;
 			}
 
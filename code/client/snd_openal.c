@@ -51,6 +51,15 @@ static qboolean enumeration_all_ext = qfalse;
 static qboolean capture_ext = qfalse;
 #endif
 
+// lets all the source changes of a frame be applied at once
+#ifndef AL_SOFT_deferred_updates
+#define AL_SOFT_deferred_updates 1
+typedef void (AL_APIENTRY *LPALDEFERUPDATESSOFT)( void );
+typedef void (AL_APIENTRY *LPALPROCESSUPDATESSOFT)( void );
+#endif
+static LPALDEFERUPDATESSOFT qalDeferUpdatesSOFT;
+static LPALPROCESSUPDATESSOFT qalProcessUpdatesSOFT;
+
 /*
 =================
 S_AL_Format
@@ -580,6 +589,17 @@ typedef struct src_s
 	vec3_t		loopSpeakerPos;		// Origin of the loop speaker
 	
 	qboolean	local;			// Is this local (relative to the cam)
+
+	int		stopTime;		// When a one-shot should have played out, not queried before
+
+	// What OpenAL was last given, so unchanged values aren't passed again.
+	// Not valid while a stream has the source locked and sets it itself.
+	qboolean	alCached;
+	vec3_t		alPosition;
+	vec3_t		alVelocity;
+	qboolean	alLooping;
+	qboolean	alRelative;
+	float		alRolloff;
 } src_t;
 
 #ifdef __APPLE__
@@ -609,6 +629,27 @@ typedef struct sentity_s
 
 static sentity_t entityList[MAX_GENTITIES];
 
+// One-shots that lost their source to a stronger sound, or never got one,
+// carry on silently here, and get a source back at the point they would
+// have reached when one frees up while they would still be playing
+#define MAX_VIRTUAL_VOICES 64
+
+typedef struct alVirtualVoice_s
+{
+	sfxHandle_t	sfx;
+	alSrcPriority_t	priority;
+	int		entity;
+	int		channel;
+	qboolean	local;
+	qboolean	isTracking;
+	vec3_t		origin;
+	int		startTime;
+	int		stopTime;
+} alVirtualVoice_t;
+
+static alVirtualVoice_t virtualVoices[MAX_VIRTUAL_VOICES];
+static int numVirtualVoices = 0;
+
 /*
 =================
 S_AL_SanitiseVector
@@ -680,6 +721,60 @@ static void S_AL_ScaleGain(src_t *chksrc, vec3_t origin)
 	}
 }
 
+/*
+=================
+S_AL_SrcPosition
+S_AL_SrcVelocity
+S_AL_SrcLooping
+S_AL_SrcLocal
+
+Only pass a source parameter on to OpenAL if it changed
+=================
+*/
+static void S_AL_SrcPosition(src_t *src, const vec3_t origin)
+{
+	if(src->alCached && VectorCompare(origin, src->alPosition))
+		return;
+
+	VectorCopy(origin, src->alPosition);
+	qalSourcefv(src->alSource, AL_POSITION, src->alPosition);
+}
+
+static void S_AL_SrcVelocity(src_t *src, const vec3_t velocity)
+{
+	if(src->alCached && VectorCompare(velocity, src->alVelocity))
+		return;
+
+	VectorCopy(velocity, src->alVelocity);
+	qalSourcefv(src->alSource, AL_VELOCITY, src->alVelocity);
+}
+
+static void S_AL_SrcLooping(src_t *src, qboolean looping)
+{
+	if(src->alCached && src->alLooping == looping)
+		return;
+
+	src->alLooping = looping;
+	qalSourcei(src->alSource, AL_LOOPING, looping ? AL_TRUE : AL_FALSE);
+}
+
+static void S_AL_SrcLocal(src_t *src, qboolean local)
+{
+	float rolloff = local ? 0.0f : s_alRolloff->value;
+
+	if(!src->alCached || src->alRelative != local)
+	{
+		src->alRelative = local;
+		qalSourcei(src->alSource, AL_SOURCE_RELATIVE, local ? AL_TRUE : AL_FALSE);
+	}
+
+	if(!src->alCached || src->alRolloff != rolloff)
+	{
+		src->alRolloff = rolloff;
+		qalSourcef(src->alSource, AL_ROLLOFF_FACTOR, rolloff);
+	}
+}
+
 /*
 =================
 S_AL_HearingThroughEntity
@@ -781,6 +876,7 @@ void S_AL_SrcShutdown( void )
 	}
 
 	memset(srcList, 0, sizeof(srcList));
+	numVirtualVoices = 0;
 
 	alSourcesInitialised = qfalse;
 }
@@ -811,6 +907,7 @@ static void S_AL_SrcSetup(srcHandle_t src, sfxHandle_t sfx, alSrcPriority_t prio
 	curSource->curGain = s_alGain->value * s_volume->value;
 	curSource->scaleGain = curSource->curGain;
 	curSource->local = local;
+	curSource->stopTime = 0;
 
 	// Set up OpenAL source
 	if(sfx >= 0)
@@ -818,25 +915,57 @@ static void S_AL_SrcSetup(srcHandle_t src, sfxHandle_t sfx, alSrcPriority_t prio
         	// Mark the SFX as used, and grab the raw AL buffer
         	S_AL_BufferUse(sfx);
         	qalSourcei(curSource->alSource, AL_BUFFER, S_AL_BufferGet(sfx));
+
+		// nothing changes the pitch, so a one-shot won't be done before this
+		if(knownSfx[sfx].info.rate > 0)
+			curSource->stopTime = curSource->lastUsedTime +
+				(int) ((long long) knownSfx[sfx].info.samples * 1000 / knownSfx[sfx].info.rate);
 	}
 
 	qalSourcef(curSource->alSource, AL_PITCH, 1.0f);
 	S_AL_Gain(curSource->alSource, curSource->curGain);
-	qalSourcefv(curSource->alSource, AL_POSITION, vec3_origin);
-	qalSourcefv(curSource->alSource, AL_VELOCITY, vec3_origin);
-	qalSourcei(curSource->alSource, AL_LOOPING, AL_FALSE);
+	S_AL_SrcPosition(curSource, vec3_origin);
+	S_AL_SrcVelocity(curSource, vec3_origin);
+	S_AL_SrcLooping(curSource, qfalse);
 	qalSourcef(curSource->alSource, AL_REFERENCE_DISTANCE, s_alMinDistance->value);
+	S_AL_SrcLocal(curSource, local);
 
-	if(local)
-	{
-		qalSourcei(curSource->alSource, AL_SOURCE_RELATIVE, AL_TRUE);
-		qalSourcef(curSource->alSource, AL_ROLLOFF_FACTOR, 0.0f);
-	}
-	else
-	{
-		qalSourcei(curSource->alSource, AL_SOURCE_RELATIVE, AL_FALSE);
-		qalSourcef(curSource->alSource, AL_ROLLOFF_FACTOR, s_alRolloff->value);
-	}
+	curSource->alCached = qtrue;
+}
+
+/*
+=================
+S_AL_SrcVirtualize
+
+Keep a one-shot going without a source
+=================
+*/
+static void S_AL_SrcVirtualize(sfxHandle_t sfx, alSrcPriority_t priority, int entity, int channel,
+		qboolean local, qboolean isTracking, const vec3_t origin, int startTime)
+{
+	alVirtualVoice_t *voice;
+	int stopTime;
+
+	if(knownSfx[sfx].info.rate <= 0)
+		return;
+
+	stopTime = startTime + (int) ((long long) knownSfx[sfx].info.samples * 1000 / knownSfx[sfx].info.rate);
+	if(stopTime - Sys_Milliseconds() < 50)
+		return;		// not worth it
+
+	if(numVirtualVoices >= MAX_VIRTUAL_VOICES)
+		return;
+
+	voice = &virtualVoices[numVirtualVoices++];
+	voice->sfx = sfx;
+	voice->priority = priority;
+	voice->entity = entity;
+	voice->channel = channel;
+	voice->local = local;
+	voice->isTracking = isTracking;
+	VectorCopy(origin, voice->origin);
+	voice->startTime = startTime;
+	voice->stopTime = stopTime;
 }
 
 /*
@@ -1099,7 +1228,18 @@ srcHandle_t S_AL_SrcAlloc( alSrcPriority_t priority, int entnum, int channel )
 	}
 
 	if(empty == -1)
+	{
 		empty = weakest;
+
+		// a one-shot cut short goes on without a source
+		if(empty >= 0 && !srcList[empty].isLooping && srcList[empty].isPlaying &&
+		   (srcList[empty].priority == SRCPRI_ONESHOT || srcList[empty].priority == SRCPRI_LOCAL))
+		{
+			curSource = &srcList[empty];
+			S_AL_SrcVirtualize(curSource->sfx, curSource->priority, curSource->entity, curSource->channel,
+				curSource->local, curSource->isTracking, curSource->alPosition, curSource->lastUsedTime);
+		}
+	}
 	
 	if(empty >= 0)
 	{
@@ -1146,6 +1286,7 @@ static
 void S_AL_SrcLock(srcHandle_t src)
 {
 	srcList[src].isLocked = qtrue;
+	srcList[src].alCached = qfalse;
 }
 
 /*
@@ -1218,7 +1359,10 @@ void S_AL_StartLocalSound(sfxHandle_t sfx, int channel)
 	src = S_AL_SrcAlloc(SRCPRI_LOCAL, -1, channel);
 	
 	if(src == -1)
+	{
+		S_AL_SrcVirtualize(sfx, SRCPRI_LOCAL, -1, channel, qtrue, qfalse, vec3_origin, Sys_Milliseconds());
 		return;
+	}
 
 	// Set up the effect
 	S_AL_SrcSetup(src, sfx, SRCPRI_LOCAL, -1, channel, qtrue);
@@ -1275,7 +1419,10 @@ static void S_AL_StartSound( vec3_t origin, int entnum, int entchannel, sfxHandl
 	// Try to grab a source
 	src = S_AL_SrcAlloc(SRCPRI_ONESHOT, entnum, entchannel);
 	if(src == -1)
+	{
+		S_AL_SrcVirtualize(sfx, SRCPRI_ONESHOT, entnum, entchannel, qfalse, !origin, sorigin, Sys_Milliseconds());
 		return;
+	}
 
 	S_AL_SrcSetup(src, sfx, SRCPRI_ONESHOT, entnum, entchannel, qfalse);
 	
@@ -1284,7 +1431,7 @@ static void S_AL_StartSound( vec3_t origin, int entnum, int entchannel, sfxHandl
 	if(!origin)
 		curSource->isTracking = qtrue;
 		
-	qalSourcefv(curSource->alSource, AL_POSITION, sorigin );
+	S_AL_SrcPosition(curSource, sorigin);
 	S_AL_ScaleGain(curSource, sorigin);
 
 	// Start it playing
@@ -1371,8 +1518,8 @@ static void S_AL_SrcLoop( alSrcPriority_t priority, sfxHandle_t sfx,
 
 		VectorClear(sorigin);
 
-		qalSourcefv(curSource->alSource, AL_POSITION, sorigin);
-		qalSourcefv(curSource->alSource, AL_VELOCITY, vec3_origin);
+		S_AL_SrcPosition(curSource, sorigin);
+		S_AL_SrcVelocity(curSource, vec3_origin);
 	}
 	else
 	{
@@ -1395,8 +1542,8 @@ static void S_AL_SrcLoop( alSrcPriority_t priority, sfxHandle_t sfx,
 		else
 			VectorClear(svelocity);
 
-		qalSourcefv(curSource->alSource, AL_POSITION, (ALfloat *) sorigin);
-		qalSourcefv(curSource->alSource, AL_VELOCITY, (ALfloat *) svelocity);
+		S_AL_SrcPosition(curSource, sorigin);
+		S_AL_SrcVelocity(curSource, svelocity);
 	}
 }
 
@@ -1432,6 +1579,89 @@ void S_AL_StopLoopingSound(int entityNum )
 		S_AL_SrcKill(entityList[entityNum].srcIndex);
 }
 
+/*
+=================
+S_AL_VirtualUpdate
+
+Give virtual voices a free source again, the most important first
+=================
+*/
+static void S_AL_VirtualUpdate(int now)
+{
+	alVirtualVoice_t *voice;
+	src_t *curSource;
+	int priority;
+	float maxDistance;
+	int i, src;
+
+	// drop those that have played out
+	for(i = 0; i < numVirtualVoices; )
+	{
+		if(now >= virtualVoices[i].stopTime)
+			virtualVoices[i] = virtualVoices[--numVirtualVoices];
+		else
+			i++;
+	}
+
+	maxDistance = s_alMaxDistance->value + s_alGraceDistance->value;
+
+	for(priority = SRCPRI_LOCAL; priority >= SRCPRI_ONESHOT; priority--)
+	{
+		for(i = 0; i < numVirtualVoices && srcActiveCnt < srcCount; )
+		{
+			voice = &virtualVoices[i];
+
+			if(voice->priority != priority)
+			{
+				i++;
+				continue;
+			}
+
+			if(voice->isTracking)
+				VectorCopy(entityList[voice->entity].origin, voice->origin);
+
+			// still out of earshot, a source would only play silence
+			if(!voice->local && DistanceSquared(voice->origin, lastListenerOrigin) >= maxDistance * maxDistance)
+			{
+				i++;
+				continue;
+			}
+
+			for(src = 0; src < srcCount; src++)
+			{
+				if(!srcList[src].isActive && !srcList[src].isLocked)
+					break;
+			}
+			if(src == srcCount)
+				return;
+
+			S_AL_SrcKill(src);
+			srcList[src].isActive = qtrue;
+			srcActiveCnt++;
+
+			S_AL_SrcSetup(src, voice->sfx, voice->priority, voice->entity, voice->channel, voice->local);
+
+			curSource = &srcList[src];
+			curSource->isTracking = voice->isTracking;
+			curSource->lastUsedTime = voice->startTime;
+			curSource->stopTime = voice->stopTime;
+
+			if(!voice->local)
+			{
+				S_AL_SrcPosition(curSource, voice->origin);
+				S_AL_ScaleGain(curSource, voice->origin);
+			}
+
+			qalSourcef(curSource->alSource, AL_SEC_OFFSET, (now - voice->startTime) / 1000.0f);
+
+			curSource->isPlaying = qtrue;
+			qalSourcePlay(curSource->alSource);
+
+			*voice = virtualVoices[--numVirtualVoices];
+		}
+	}
+}
+
 /*
 =================
 S_AL_SrcUpdate
@@ -1444,6 +1674,7 @@ void S_AL_SrcUpdate( void )
 {
 	int i;
 	int entityNum;
+	int now = Sys_Milliseconds();
 	ALint state;
 	src_t *curSource;
 	
@@ -1461,8 +1692,8 @@ void S_AL_SrcUpdate( void )
 		// Update source parameters
 		if((s_alGain->modified) || (s_volume->modified))
 			curSource->curGain = s_alGain->value * s_volume->value;
-		if((s_alRolloff->modified) && (!curSource->local))
-			qalSourcef(curSource->alSource, AL_ROLLOFF_FACTOR, s_alRolloff->value);
+		if(s_alRolloff->modified)
+			S_AL_SrcLocal(curSource, curSource->local);
 		if(s_alMinDistance->modified)
 			qalSourcef(curSource->alSource, AL_REFERENCE_DISTANCE, s_alMinDistance->value);
 
@@ -1518,7 +1749,7 @@ void S_AL_SrcUpdate( void )
 
 				if(!curSource->isPlaying)
 				{
-					qalSourcei(curSource->alSource, AL_LOOPING, AL_TRUE);
+					S_AL_SrcLooping(curSource, qtrue);
 					curSource->isPlaying = qtrue;
 					qalSourcePlay(curSource->alSource);
 
@@ -1582,17 +1813,7 @@ void S_AL_SrcUpdate( void )
 				}
 
 				// Update locality
-				if(curSource->local)
-				{
-					qalSourcei(curSource->alSource, AL_SOURCE_RELATIVE, AL_TRUE);
-					qalSourcef(curSource->alSource, AL_ROLLOFF_FACTOR, 0.0f);
-				}
-				else
-				{
-					qalSourcei(curSource->alSource, AL_SOURCE_RELATIVE, AL_FALSE);
-					qalSourcef(curSource->alSource, AL_ROLLOFF_FACTOR, s_alRolloff->value);
-				}
-				
+				S_AL_SrcLocal(curSource, curSource->local);
 			}
 			else if(curSource->priority == SRCPRI_AMBIENT)
 			{
@@ -1609,25 +1830,22 @@ void S_AL_SrcUpdate( void )
 			continue;
 		}
 
-		if(!curSource->isStream)
+		// Check if it's done, and flag it, no need to ask before it can be
+		if(!curSource->isStream && now - curSource->stopTime >= 0)
 		{
-        		// Check if it's done, and flag it
-	        	qalGetSourcei(curSource->alSource, AL_SOURCE_STATE, &state);
-	        	if(state == AL_STOPPED)
-        		{
-	        		curSource->isPlaying = qfalse;
-		        	S_AL_SrcKill(i);
-		        	continue;
-        		}
-                }
-
-		// Query relativity of source, don't move if it's true
-		qalGetSourcei(curSource->alSource, AL_SOURCE_RELATIVE, &state);
-
-		// See if it needs to be moved
-		if(curSource->isTracking && !state)
+			qalGetSourcei(curSource->alSource, AL_SOURCE_STATE, &state);
+			if(state == AL_STOPPED)
+			{
+				curSource->isPlaying = qfalse;
+				S_AL_SrcKill(i);
+				continue;
+			}
+		}
+
+		// See if it needs to be moved, local sources are relative to the listener
+		if(curSource->isTracking && !curSource->local)
 		{
-			qalSourcefv(curSource->alSource, AL_POSITION, entityList[entityNum].origin);
+			S_AL_SrcPosition(curSource, entityList[entityNum].origin);
  			S_AL_ScaleGain(curSource, entityList[entityNum].origin);
 		}
 	}
@@ -1644,6 +1862,8 @@ void S_AL_SrcShutup( void )
 	int i;
 	for(i = 0; i < srcCount; i++)
 		S_AL_SrcKill(i);
+
+	numVirtualVoices = 0;
 }
 
 /*
@@ -2274,6 +2494,12 @@ void S_AL_Update( void )
 {
 	int i;
 
+	// hold back the changes below so they are all heard from the same point
+	if(qalDeferUpdatesSOFT)
+		qalDeferUpdatesSOFT();
+	else
+		qalcSuspendContext(alContext);
+
 	if(s_muted->modified)
 	{
 		// muted state changed. Let S_AL_Gain turn up all sources again.
@@ -2288,12 +2514,18 @@ void S_AL_Update( void )
 
 	// Update SFX channels
 	S_AL_SrcUpdate();
+	S_AL_VirtualUpdate(Sys_Milliseconds());
 
 	// Update streams
 	for (i = 0; i < MAX_RAW_STREAMS; i++)
 		S_AL_StreamUpdate(i);
 	S_AL_MusicUpdate();
 
+	if(qalProcessUpdatesSOFT)
+		qalProcessUpdatesSOFT();
+	else
+		qalcProcessContext(alContext);
+
 	// Doppler
 	if(s_doppler->modified)
 	{
@@ -2619,6 +2851,16 @@ qboolean S_AL_Init( soundInterface_t *si )
 	}
 	qalcMakeContextCurrent( alContext );
 
+	qalDeferUpdatesSOFT = NULL;
+	qalProcessUpdatesSOFT = NULL;
+	if( qalIsExtensionPresent( "AL_SOFT_deferred_updates" ) )
+	{
+		qalDeferUpdatesSOFT = (LPALDEFERUPDATESSOFT) qalGetProcAddress( "alDeferUpdatesSOFT" );
+		qalProcessUpdatesSOFT = (LPALPROCESSUPDATESSOFT) qalGetProcAddress( "alProcessUpdatesSOFT" );
+		if( !qalDeferUpdatesSOFT || !qalProcessUpdatesSOFT )
+			qalDeferUpdatesSOFT = qalProcessUpdatesSOFT = NULL;
+	}
+
 	// Initialize sources, buffers, music
 	S_AL_BufferInit( );
 	S_AL_SrcInit( );
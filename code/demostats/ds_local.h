@@ -0,0 +1,147 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// ds_local.h -- headless demo analyzer, demo to per frame player state
+
+#include <stdio.h>
+
+#include "../qcommon/q_shared.h"
+#include "../qcommon/qcommon.h"
+
+/*
+demostats reads client and server demos with the message code of the
+engine and writes out what the recorded player and every other player was
+doing on each snapshot, without a renderer, sound or cgame. Each demo is
+parsed on its own, so a batch is spread over as many threads as asked for.
+
+Both outputs are a stream of records in demo order, a gamestate first and
+after every map change, every server command, and a frame for every valid
+snapshot.
+
+JSON is one object per line:
+	{"gamestate":{"clientNum":0,"serverinfo":{"mapname":"ut4_turnpike",...}}}
+	{"command":{"seq":12,"text":"print \"...\""}}
+	{"frame":{"serverTime":1234,"messageNum":56,"ps":{...},"players":[...]}}
+
+The binary output starts with DS_MAGIC and DS_VERSION, followed by the
+records, each a type and the length of what follows:
+	DS_REC_GAMESTATE	int clientNum, the serverinfo string with its 0
+	DS_REC_COMMAND		int seq, the command with its 0
+	DS_REC_FRAME		dsFrame_t, then dsFrame_t.numPlayers dsPlayer_t
+Every int and float is 4 bytes little endian, so the structs below are the
+exact layout on disk.
+*/
+
+#define DS_MAGIC			0x41545344	// "DSTA"
+#define DS_VERSION			1
+
+#define DS_REC_GAMESTATE	1
+#define DS_REC_COMMAND		2
+#define DS_REC_FRAME		3
+
+#define	DS_PARSE_ENTITIES	( PACKET_BACKUP * MAX_SNAPSHOT_ENTITIES )	// MAX_PARSE_ENTITIES
+
+typedef struct {
+	int			serverTime;
+	int			messageNum;
+	int			snapFlags;
+
+	// the recorded player
+	int			clientNum;
+	int			commandTime;
+	int			pm_type;
+	int			pm_flags;
+	float		origin[3];
+	float		velocity[3];
+	float		viewangles[3];
+	int			groundEntityNum;
+	int			weapon;
+	int			weaponstate;
+	int			eFlags;
+	int			legsAnim;
+	int			torsoAnim;
+	int			stats[MAX_STATS];
+	int			persistant[MAX_PERSISTANT];
+
+	int			numPlayers;
+} dsFrame_t;
+
+// the other players in the snapshot, by entity
+typedef struct {
+	int			number;
+	float		origin[3];
+	float		angles[3];
+	int			groundEntityNum;
+	int			weapon;
+	int			eFlags;
+	int			legsAnim;
+	int			torsoAnim;
+} dsPlayer_t;
+
+typedef enum {
+	DS_JSON,
+	DS_BINARY
+} dsFormat_t;
+
+typedef struct {
+	qboolean		valid;
+	int				snapFlags;
+	int				serverTime;
+	int				messageNum;
+	int				deltaNum;
+	playerState_t	ps;
+	int				numEntities;
+	int				parseEntitiesNum;
+} dsSnapshot_t;
+
+// everything cl and clc keep that the parse needs, one per demo being read
+typedef struct {
+	const char		*name;
+	FILE			*out;
+	dsFormat_t		format;
+
+	int				serverMessageSequence;
+	int				serverCommandSequence;
+	int				clientNum;
+	gameState_t		gameState;
+
+	dsSnapshot_t	snap;
+	dsSnapshot_t	snapshots[PACKET_BACKUP];
+
+	entityState_t	entityBaselines[MAX_GENTITIES];
+	entityState_t	parseEntities[DS_PARSE_ENTITIES];
+	int				parseEntitiesNum;
+
+	int				numFrames;
+} dsDemo_t;
+
+//
+// ds_parse.c
+//
+void DS_ClearState( dsDemo_t *demo );
+void DS_ParseServerMessage( dsDemo_t *demo, msg_t *msg );
+
+//
+// ds_main.c
+//
+void DS_WriteGamestate( dsDemo_t *demo );
+void DS_WriteCommand( dsDemo_t *demo, int seq, const char *text );
+void DS_WriteFrame( dsDemo_t *demo );
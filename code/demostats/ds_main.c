@@ -0,0 +1,695 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// ds_main.c -- demostats command line, demo reading and the output writers
+
+#include <stdlib.h>
+#include <setjmp.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "ds_local.h"
+
+/*
+usage: demostats [-j threads] [-f json|bin] [-o outdir] [-v] demo...
+
+Every demo gets its own output, next to it or in outdir, with .json or
+.dstats for an extension. The threads take the demos off a shared list one
+at a time, so a batch of uneven demos still keeps them all busy. A demo
+that fails to parse is reported and the rest go on.
+
+A .urtdemo is read with its header and the lengths around every message,
+keyframe records being skipped as the messages around them already carry
+all they have. Anything else is taken for a plain .dm_ demo.
+*/
+
+// DEMO_VERSION and DEMO_VERSION_INDEXED of a USE_DEMO_FORMAT_42 build
+#define DS_URTDEMO_VERSION		70
+#define DS_URTDEMO_INDEXED		71
+
+#define DS_MAX_THREADS			64
+
+// msg.c only looks at it if set
+cvar_t		*cl_shownet;
+
+static struct {
+	dsFormat_t		format;
+	const char		*outdir;
+	qboolean		verbose;
+
+	char			**demos;
+	int				numDemos;
+	int				nextDemo;
+	int				numFailed;
+	pthread_mutex_t	lock;
+} ds;
+
+static Q_THREADLOCAL jmp_buf	*dsAbort;	// where Com_Error goes on this thread
+static Q_THREADLOCAL char		dsError[MAXPRINTMSG];
+
+/*
+=============
+Com_Printf
+=============
+*/
+void QDECL Com_Printf( const char *fmt, ... ) {
+	va_list		argptr;
+	char		msg[MAXPRINTMSG];
+
+	va_start( argptr, fmt );
+	Q_vsnprintf( msg, sizeof( msg ), fmt, argptr );
+	va_end( argptr );
+
+	fputs( msg, stderr );
+}
+
+/*
+=============
+Com_DPrintf
+=============
+*/
+void QDECL Com_DPrintf( const char *fmt, ... ) {
+	va_list		argptr;
+	char		msg[MAXPRINTMSG];
+
+	if ( !ds.verbose ) {
+		return;
+	}
+
+	va_start( argptr, fmt );
+	Q_vsnprintf( msg, sizeof( msg ), fmt, argptr );
+	va_end( argptr );
+
+	fputs( msg, stderr );
+}
+
+/*
+=============
+Com_Error
+
+Gives up on the demo being read on this thread
+=============
+*/
+void QDECL Com_Error( int code, const char *fmt, ... ) {
+	va_list		argptr;
+
+	va_start( argptr, fmt );
+	Q_vsnprintf( dsError, sizeof( dsError ), fmt, argptr );
+	va_end( argptr );
+
+	if ( !dsAbort ) {
+		fprintf( stderr, "ERROR: %s\n", dsError );
+		exit( 1 );
+	}
+
+	longjmp( *dsAbort, 1 );
+}
+
+/*
+==============================================================================
+
+OUTPUT
+
+==============================================================================
+*/
+
+/*
+=============
+DS_JsonString
+=============
+*/
+static void DS_JsonString( FILE *f, const char *s ) {
+	int		c;
+
+	fputc( '"', f );
+	for ( ; *s ; s++ ) {
+		c = *(const unsigned char *)s;
+		if ( c == '"' || c == '\\' ) {
+			fputc( '\\', f );
+			fputc( c, f );
+		} else if ( c == '\n' ) {
+			fputs( "\\n", f );
+		} else if ( c < ' ' || c >= 0x7f ) {
+			// the game's own charset, not utf-8
+			fprintf( f, "\\u%04x", c );
+		} else {
+			fputc( c, f );
+		}
+	}
+	fputc( '"', f );
+}
+
+/*
+=============
+DS_JsonVector
+=============
+*/
+static void DS_JsonVector( FILE *f, const char *name, const float *v ) {
+	fprintf( f, "\"%s\":[%g,%g,%g]", name, v[0], v[1], v[2] );
+}
+
+/*
+=============
+DS_JsonInts
+=============
+*/
+static void DS_JsonInts( FILE *f, const char *name, const int *v, int count ) {
+	int		i;
+
+	fprintf( f, "\"%s\":[", name );
+	for ( i = 0 ; i < count ; i++ ) {
+		fprintf( f, i ? ",%d" : "%d", v[i] );
+	}
+	fputc( ']', f );
+}
+
+/*
+=============
+DS_WriteRecord
+
+A binary record, data is swapped to little endian in place
+=============
+*/
+static void DS_WriteRecord( dsDemo_t *demo, int type, void *data, int length, int swapLength ) {
+	int		header[2];
+	int		*words = data;
+	int		i;
+
+	for ( i = 0 ; i < swapLength / 4 ; i++ ) {
+		words[i] = LittleLong( words[i] );
+	}
+
+	header[0] = LittleLong( type );
+	header[1] = LittleLong( length );
+	fwrite( header, sizeof( header ), 1, demo->out );
+	fwrite( data, length, 1, demo->out );
+}
+
+/*
+=============
+DS_ConfigString
+=============
+*/
+static const char *DS_ConfigString( dsDemo_t *demo, int index ) {
+	return demo->gameState.stringData + demo->gameState.stringOffsets[index];
+}
+
+/*
+=============
+DS_WriteGamestate
+=============
+*/
+void DS_WriteGamestate( dsDemo_t *demo ) {
+	const char	*info = DS_ConfigString( demo, CS_SERVERINFO );
+	static Q_THREADLOCAL char	key[BIG_INFO_STRING], value[BIG_INFO_STRING];
+	static Q_THREADLOCAL byte	buffer[4 + BIG_INFO_STRING];
+	int			len, first;
+
+	if ( demo->format == DS_BINARY ) {
+		len = strlen( info ) + 1;
+		if ( len > BIG_INFO_STRING ) {
+			len = BIG_INFO_STRING;
+		}
+		*(int *)buffer = demo->clientNum;
+		Com_Memcpy( buffer + 4, info, len );
+		buffer[4 + len - 1] = 0;
+		DS_WriteRecord( demo, DS_REC_GAMESTATE, buffer, 4 + len, 4 );
+		return;
+	}
+
+	fprintf( demo->out, "{\"gamestate\":{\"clientNum\":%d,\"serverinfo\":{", demo->clientNum );
+	for ( first = 1 ; ; first = 0 ) {
+		Info_NextPair( &info, key, value );
+		if ( !key[0] ) {
+			break;
+		}
+		if ( !first ) {
+			fputc( ',', demo->out );
+		}
+		DS_JsonString( demo->out, key );
+		fputc( ':', demo->out );
+		DS_JsonString( demo->out, value );
+	}
+	fputs( "}}}\n", demo->out );
+}
+
+/*
+=============
+DS_WriteCommand
+=============
+*/
+void DS_WriteCommand( dsDemo_t *demo, int seq, const char *text ) {
+	static Q_THREADLOCAL byte	buffer[4 + MAX_STRING_CHARS];
+	int			len;
+
+	if ( demo->format == DS_BINARY ) {
+		len = strlen( text ) + 1;
+		*(int *)buffer = seq;
+		Com_Memcpy( buffer + 4, text, len );
+		DS_WriteRecord( demo, DS_REC_COMMAND, buffer, 4 + len, 4 );
+		return;
+	}
+
+	fprintf( demo->out, "{\"command\":{\"seq\":%d,\"text\":", seq );
+	DS_JsonString( demo->out, text );
+	fputs( "}}\n", demo->out );
+}
+
+/*
+=============
+DS_WriteFrame
+=============
+*/
+void DS_WriteFrame( dsDemo_t *demo ) {
+	static Q_THREADLOCAL struct {
+		dsFrame_t	frame;
+		dsPlayer_t	players[MAX_CLIENTS];
+	} out;
+	const dsSnapshot_t	*snap = &demo->snap;
+	const playerState_t	*ps = &snap->ps;
+	const entityState_t	*es;
+	dsFrame_t			*frame = &out.frame;
+	dsPlayer_t			*player;
+	int					i;
+
+	demo->numFrames++;
+
+	frame->serverTime = snap->serverTime;
+	frame->messageNum = snap->messageNum;
+	frame->snapFlags = snap->snapFlags;
+	frame->clientNum = ps->clientNum;
+	frame->commandTime = ps->commandTime;
+	frame->pm_type = ps->pm_type;
+	frame->pm_flags = ps->pm_flags;
+	VectorCopy( ps->origin, frame->origin );
+	VectorCopy( ps->velocity, frame->velocity );
+	VectorCopy( ps->viewangles, frame->viewangles );
+	frame->groundEntityNum = ps->groundEntityNum;
+	frame->weapon = ps->weapon;
+	frame->weaponstate = ps->weaponstate;
+	frame->eFlags = ps->eFlags;
+	frame->legsAnim = ps->legsAnim;
+	frame->torsoAnim = ps->torsoAnim;
+	Com_Memcpy( frame->stats, ps->stats, sizeof( frame->stats ) );
+	Com_Memcpy( frame->persistant, ps->persistant, sizeof( frame->persistant ) );
+
+	// the client entities, the recorded one is in the playerstate
+	frame->numPlayers = 0;
+	for ( i = 0 ; i < snap->numEntities ; i++ ) {
+		es = &demo->parseEntities[( snap->parseEntitiesNum + i ) & ( DS_PARSE_ENTITIES - 1 )];
+		if ( es->number >= MAX_CLIENTS ) {
+			break;	// sorted by number
+		}
+		if ( es->number == ps->clientNum ) {
+			continue;
+		}
+
+		player = &out.players[frame->numPlayers++];
+		player->number = es->number;
+		VectorCopy( es->pos.trBase, player->origin );
+		VectorCopy( es->apos.trBase, player->angles );
+		player->groundEntityNum = es->groundEntityNum;
+		player->weapon = es->weapon;
+		player->eFlags = es->eFlags;
+		player->legsAnim = es->legsAnim;
+		player->torsoAnim = es->torsoAnim;
+	}
+
+	if ( demo->format == DS_BINARY ) {
+		i = sizeof( dsFrame_t ) + frame->numPlayers * sizeof( dsPlayer_t );
+		DS_WriteRecord( demo, DS_REC_FRAME, &out, i, i );
+		return;
+	}
+
+	fprintf( demo->out, "{\"frame\":{\"serverTime\":%d,\"messageNum\":%d,\"snapFlags\":%d,\"ps\":{",
+		frame->serverTime, frame->messageNum, frame->snapFlags );
+	fprintf( demo->out, "\"clientNum\":%d,\"commandTime\":%d,\"pm_type\":%d,\"pm_flags\":%d,",
+		frame->clientNum, frame->commandTime, frame->pm_type, frame->pm_flags );
+	DS_JsonVector( demo->out, "origin", frame->origin );
+	fputc( ',', demo->out );
+	DS_JsonVector( demo->out, "velocity", frame->velocity );
+	fputc( ',', demo->out );
+	DS_JsonVector( demo->out, "viewangles", frame->viewangles );
+	fprintf( demo->out, ",\"groundEntityNum\":%d,\"weapon\":%d,\"weaponstate\":%d,\"eFlags\":%d,\"legsAnim\":%d,\"torsoAnim\":%d,",
+		frame->groundEntityNum, frame->weapon, frame->weaponstate, frame->eFlags, frame->legsAnim, frame->torsoAnim );
+	DS_JsonInts( demo->out, "stats", frame->stats, MAX_STATS );
+	fputc( ',', demo->out );
+	DS_JsonInts( demo->out, "persistant", frame->persistant, MAX_PERSISTANT );
+	fputs( "},\"players\":[", demo->out );
+
+	for ( i = 0 ; i < frame->numPlayers ; i++ ) {
+		player = &out.players[i];
+		fprintf( demo->out, "%s{\"number\":%d,", i ? "," : "", player->number );
+		DS_JsonVector( demo->out, "origin", player->origin );
+		fputc( ',', demo->out );
+		DS_JsonVector( demo->out, "angles", player->angles );
+		fprintf( demo->out, ",\"groundEntityNum\":%d,\"weapon\":%d,\"eFlags\":%d,\"legsAnim\":%d,\"torsoAnim\":%d}",
+			player->groundEntityNum, player->weapon, player->eFlags, player->legsAnim, player->torsoAnim );
+	}
+	fputs( "]}}\n", demo->out );
+}
+
+/*
+==============================================================================
+
+DEMO READING
+
+==============================================================================
+*/
+
+/*
+=============
+DS_ReadInt
+=============
+*/
+static qboolean DS_ReadInt( FILE *f, int *value ) {
+	if ( fread( value, 4, 1, f ) != 1 ) {
+		return qfalse;
+	}
+	*value = LittleLong( *value );
+	return qtrue;
+}
+
+/*
+=============
+DS_ReadHeader
+
+The .urtdemo header, a mod version string, the demo version and two 0s
+=============
+*/
+static qboolean DS_ReadHeader( FILE *f ) {
+	int		len, version, zero1, zero2;
+
+	if ( !DS_ReadInt( f, &len ) || len < 0 || fseek( f, len, SEEK_CUR ) ) {
+		return qfalse;
+	}
+
+	if ( !DS_ReadInt( f, &version ) || !DS_ReadInt( f, &zero1 ) || !DS_ReadInt( f, &zero2 ) ) {
+		return qfalse;
+	}
+
+	if ( version != DS_URTDEMO_VERSION && version != DS_URTDEMO_INDEXED ) {
+		Com_Printf( "demo version %d not supported\n", version );
+		return qfalse;
+	}
+
+	return !zero1 && !zero2;
+}
+
+/*
+=============
+DS_ReadDemo
+
+Feeds every message to the parse, as CL_ReadDemoMessage does
+=============
+*/
+static void DS_ReadDemo( dsDemo_t *demo, FILE *f, qboolean urtdemo ) {
+	static Q_THREADLOCAL byte	data[MAX_MSGLEN];
+	msg_t		buf;
+	int			seq, len, trailer;
+	qboolean	keyframe;
+
+	while ( 1 ) {
+		if ( !DS_ReadInt( f, &seq ) || !DS_ReadInt( f, &len ) ) {
+			return;		// cut short
+		}
+
+		keyframe = qfalse;
+		if ( urtdemo && len == DEMO_KEYFRAME ) {
+			keyframe = qtrue;
+			if ( !DS_ReadInt( f, &len ) ) {
+				return;
+			}
+		}
+
+		if ( len == -1 || ( urtdemo && len <= 0 ) ) {
+			return;
+		}
+		if ( len < 0 || len > MAX_MSGLEN ) {
+			Com_Error( ERR_DROP, "demoMsglen %d > MAX_MSGLEN", len );
+		}
+
+		MSG_Init( &buf, data, sizeof( data ) );
+		buf.cursize = len;
+		if ( fread( buf.data, len, 1, f ) != 1 ) {
+			Com_Printf( "%s: demo file was truncated\n", demo->name );
+			return;
+		}
+
+		if ( urtdemo ) {
+			if ( !DS_ReadInt( f, &trailer ) || trailer != len ) {
+				return;
+			}
+			if ( keyframe ) {
+				continue;
+			}
+		}
+
+		demo->serverMessageSequence = seq;
+		DS_ParseServerMessage( demo, &buf );
+	}
+}
+
+/*
+=============
+DS_OutputName
+=============
+*/
+static void DS_OutputName( const char *demoName, char *out, int size ) {
+	char	base[MAX_OSPATH];
+	const char	*ext = ds.format == DS_BINARY ? ".dstats" : ".json";
+
+	if ( ds.outdir ) {
+		COM_StripExtension( COM_SkipPath( demoName ), base, sizeof( base ) );
+		Com_sprintf( out, size, "%s/%s%s", ds.outdir, base, ext );
+	} else {
+		COM_StripExtension( demoName, base, sizeof( base ) );
+		Com_sprintf( out, size, "%s%s", base, ext );
+	}
+}
+
+/*
+=============
+DS_ProcessDemo
+=============
+*/
+static qboolean DS_ProcessDemo( dsDemo_t *demo, const char *demoName ) {
+	jmp_buf		abort;
+	char		outName[MAX_OSPATH];
+	const char	*ext;
+	FILE		*in, *out;
+	qboolean	urtdemo, ok;
+	int			header[2];
+
+	in = fopen( demoName, "rb" );
+	if ( !in ) {
+		Com_Printf( "%s: couldn't open\n", demoName );
+		return qfalse;
+	}
+
+	ext = strrchr( demoName, '.' );
+	urtdemo = ext && !Q_stricmp( ext, ".urtdemo" );
+	if ( urtdemo && !DS_ReadHeader( in ) ) {
+		Com_Printf( "%s: bad demo header\n", demoName );
+		fclose( in );
+		return qfalse;
+	}
+
+	DS_OutputName( demoName, outName, sizeof( outName ) );
+	out = fopen( outName, ds.format == DS_BINARY ? "wb" : "w" );
+	if ( !out ) {
+		Com_Printf( "%s: couldn't write %s\n", demoName, outName );
+		fclose( in );
+		return qfalse;
+	}
+
+	Com_Memset( demo, 0, sizeof( *demo ) );
+	demo->name = demoName;
+	demo->out = out;
+	demo->format = ds.format;
+
+	if ( demo->format == DS_BINARY ) {
+		header[0] = LittleLong( DS_MAGIC );
+		header[1] = LittleLong( DS_VERSION );
+		fwrite( header, sizeof( header ), 1, out );
+	}
+
+	ok = qtrue;
+	dsAbort = &abort;
+	if ( !setjmp( abort ) ) {
+		DS_ReadDemo( demo, in, urtdemo );
+	} else {
+		Com_Printf( "%s: %s\n", demoName, dsError );
+		ok = qfalse;
+	}
+	dsAbort = NULL;
+
+	fclose( in );
+	if ( fclose( out ) ) {
+		Com_Printf( "%s: couldn't write %s\n", demoName, outName );
+		ok = qfalse;
+	}
+
+	Com_DPrintf( "%s: %d frames to %s\n", demoName, demo->numFrames, outName );
+
+	return ok;
+}
+
+/*
+=============
+DS_Thread
+=============
+*/
+static void *DS_Thread( void *arg ) {
+	dsDemo_t	*demo;
+	int			n;
+
+	// too big for a thread stack
+	demo = malloc( sizeof( *demo ) );
+	if ( !demo ) {
+		Com_Printf( "couldn't allocate a demo\n" );
+		return NULL;
+	}
+
+	while ( 1 ) {
+		pthread_mutex_lock( &ds.lock );
+		n = ds.nextDemo++;
+		pthread_mutex_unlock( &ds.lock );
+
+		if ( n >= ds.numDemos ) {
+			break;
+		}
+
+		if ( !DS_ProcessDemo( demo, ds.demos[n] ) ) {
+			pthread_mutex_lock( &ds.lock );
+			ds.numFailed++;
+			pthread_mutex_unlock( &ds.lock );
+		}
+	}
+
+	free( demo );
+	return NULL;
+}
+
+/*
+=============
+DS_NumProcessors
+=============
+*/
+static int DS_NumProcessors( void ) {
+#ifdef _WIN32
+	SYSTEM_INFO	info;
+
+	GetSystemInfo( &info );
+	return info.dwNumberOfProcessors;
+#else
+	return sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+}
+
+/*
+=============
+DS_Usage
+=============
+*/
+static void DS_Usage( const char *name ) {
+	Com_Printf( "usage: %s [-j threads] [-f json|bin] [-o outdir] [-v] demo...\n", name );
+	exit( 1 );
+}
+
+/*
+=============
+main
+=============
+*/
+int main( int argc, char **argv ) {
+	pthread_t	threads[DS_MAX_THREADS];
+	msg_t		msg;
+	byte		data[1];
+	int			numThreads, started;
+	int			i;
+
+	numThreads = DS_NumProcessors();
+	ds.format = DS_JSON;
+
+	for ( i = 1 ; i < argc && argv[i][0] == '-' ; i++ ) {
+		if ( !strcmp( argv[i], "-j" ) && i + 1 < argc ) {
+			numThreads = atoi( argv[++i] );
+		} else if ( !strcmp( argv[i], "-f" ) && i + 1 < argc ) {
+			i++;
+			if ( !strcmp( argv[i], "json" ) ) {
+				ds.format = DS_JSON;
+			} else if ( !strcmp( argv[i], "bin" ) ) {
+				ds.format = DS_BINARY;
+			} else {
+				DS_Usage( argv[0] );
+			}
+		} else if ( !strcmp( argv[i], "-o" ) && i + 1 < argc ) {
+			ds.outdir = argv[++i];
+		} else if ( !strcmp( argv[i], "-v" ) ) {
+			ds.verbose = qtrue;
+		} else {
+			DS_Usage( argv[0] );
+		}
+	}
+
+	if ( i == argc ) {
+		DS_Usage( argv[0] );
+	}
+
+	ds.demos = argv + i;
+	ds.numDemos = argc - i;
+
+	if ( numThreads > ds.numDemos ) {
+		numThreads = ds.numDemos;
+	}
+	numThreads = Com_Clamp( 1, DS_MAX_THREADS, numThreads );
+
+	// the huffman tables are built on the first use, not on the threads
+	MSG_Init( &msg, data, sizeof( data ) );
+
+	pthread_mutex_init( &ds.lock, NULL );
+
+	for ( started = 0 ; started < numThreads ; started++ ) {
+		if ( pthread_create( &threads[started], NULL, DS_Thread, NULL ) ) {
+			break;
+		}
+	}
+	if ( !started ) {
+		DS_Thread( NULL );
+	}
+	for ( i = 0 ; i < started ; i++ ) {
+		pthread_join( threads[i], NULL );
+	}
+
+	pthread_mutex_destroy( &ds.lock );
+
+	if ( ds.numFailed ) {
+		Com_Printf( "%d of %d demos failed\n", ds.numFailed, ds.numDemos );
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,411 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// ds_parse.c -- the server message parse of cl_parse.c, on a dsDemo_t
+
+#include "ds_local.h"
+
+/*
+These follow CL_ParseServerMessage and what it calls function for
+function, with cl and clc swapped for the demo being read. Everything the
+client does beyond reading the stream is left out: no cgame, no pure
+checks, no downloads, no VoIP decoding.
+*/
+
+/*
+==================
+DS_ClearState
+==================
+*/
+void DS_ClearState( dsDemo_t *demo ) {
+	Com_Memset( &demo->gameState, 0, sizeof( demo->gameState ) );
+	Com_Memset( &demo->snap, 0, sizeof( demo->snap ) );
+	Com_Memset( demo->snapshots, 0, sizeof( demo->snapshots ) );
+	Com_Memset( demo->entityBaselines, 0, sizeof( demo->entityBaselines ) );
+	demo->parseEntitiesNum = 0;
+}
+
+/*
+==================
+DS_DeltaEntity
+==================
+*/
+static void DS_DeltaEntity( dsDemo_t *demo, msg_t *msg, dsSnapshot_t *frame, int newnum, entityState_t *old,
+					 qboolean unchanged ) {
+	entityState_t	*state;
+
+	state = &demo->parseEntities[demo->parseEntitiesNum & (DS_PARSE_ENTITIES-1)];
+
+	if ( unchanged ) {
+		*state = *old;
+	} else {
+		MSG_ReadDeltaEntity( msg, old, state, newnum );
+	}
+
+	if ( state->number == (MAX_GENTITIES-1) ) {
+		return;		// entity was delta removed
+	}
+	demo->parseEntitiesNum++;
+	frame->numEntities++;
+}
+
+/*
+==================
+DS_CopyUnchangedEntities
+==================
+*/
+static void DS_CopyUnchangedEntities( dsDemo_t *demo, dsSnapshot_t *oldframe, int oldindex, dsSnapshot_t *frame, int count ) {
+	int		from, to, n;
+
+	from = oldframe->parseEntitiesNum + oldindex;
+	while ( count > 0 ) {
+		n = count;
+		if ( n > DS_PARSE_ENTITIES - ( from & (DS_PARSE_ENTITIES-1) ) ) {
+			n = DS_PARSE_ENTITIES - ( from & (DS_PARSE_ENTITIES-1) );
+		}
+		to = demo->parseEntitiesNum & (DS_PARSE_ENTITIES-1);
+		if ( n > DS_PARSE_ENTITIES - to ) {
+			n = DS_PARSE_ENTITIES - to;
+		}
+
+		memmove( &demo->parseEntities[to], &demo->parseEntities[from & (DS_PARSE_ENTITIES-1)], n * sizeof( entityState_t ) );
+
+		from += n;
+		demo->parseEntitiesNum += n;
+		frame->numEntities += n;
+		count -= n;
+	}
+}
+
+/*
+==================
+DS_OldEntity
+
+The number of the entity at oldindex in oldframe, 99999 past the end
+==================
+*/
+static int DS_OldEntity( dsDemo_t *demo, dsSnapshot_t *oldframe, int oldindex, entityState_t **oldstate ) {
+	if ( !oldframe || oldindex >= oldframe->numEntities ) {
+		return 99999;
+	}
+
+	*oldstate = &demo->parseEntities[(oldframe->parseEntitiesNum + oldindex) & (DS_PARSE_ENTITIES-1)];
+	return (*oldstate)->number;
+}
+
+/*
+==================
+DS_ParsePacketEntities
+==================
+*/
+static void DS_ParsePacketEntities( dsDemo_t *demo, msg_t *msg, dsSnapshot_t *oldframe, dsSnapshot_t *newframe ) {
+	int				newnum;
+	entityState_t	*oldstate;
+	int				oldindex, oldnum;
+	int				unchanged;
+
+	newframe->parseEntitiesNum = demo->parseEntitiesNum;
+	newframe->numEntities = 0;
+
+	// delta from the entities present in oldframe
+	oldindex = 0;
+	oldstate = NULL;
+	oldnum = DS_OldEntity( demo, oldframe, oldindex, &oldstate );
+
+	while ( 1 ) {
+		// read the entity index number
+		newnum = MSG_ReadBits( msg, GENTITYNUM_BITS );
+
+		if ( newnum == (MAX_GENTITIES-1) ) {
+			break;
+		}
+
+		if ( msg->readcount > msg->cursize ) {
+			Com_Error( ERR_DROP, "DS_ParsePacketEntities: end of message" );
+		}
+
+		// one or more entities from the old packet are unchanged
+		unchanged = oldindex;
+		while ( oldnum < newnum ) {
+			oldnum = DS_OldEntity( demo, oldframe, ++oldindex, &oldstate );
+		}
+		if ( oldindex > unchanged ) {
+			DS_CopyUnchangedEntities( demo, oldframe, unchanged, newframe, oldindex - unchanged );
+		}
+
+		if ( oldnum == newnum ) {
+			// delta from previous state
+			DS_DeltaEntity( demo, msg, newframe, newnum, oldstate, qfalse );
+			oldnum = DS_OldEntity( demo, oldframe, ++oldindex, &oldstate );
+			continue;
+		}
+
+		// delta from baseline
+		DS_DeltaEntity( demo, msg, newframe, newnum, &demo->entityBaselines[newnum], qfalse );
+	}
+
+	// any remaining entities in the old frame are copied over
+	unchanged = oldindex;
+	while ( oldnum != 99999 ) {
+		oldnum = DS_OldEntity( demo, oldframe, ++oldindex, &oldstate );
+	}
+	if ( oldindex > unchanged ) {
+		DS_CopyUnchangedEntities( demo, oldframe, unchanged, newframe, oldindex - unchanged );
+	}
+}
+
+/*
+================
+DS_ParseSnapshot
+
+A valid snapshot is kept for later deltas and written out as a frame
+================
+*/
+static void DS_ParseSnapshot( dsDemo_t *demo, msg_t *msg ) {
+	int				len;
+	dsSnapshot_t	*old;
+	dsSnapshot_t	newSnap;
+	byte			areamask[MAX_MAP_AREA_BYTES];
+	int				deltaNum;
+	int				oldMessageNum;
+
+	Com_Memset( &newSnap, 0, sizeof( newSnap ) );
+
+	newSnap.serverTime = MSG_ReadLong( msg );
+	newSnap.messageNum = demo->serverMessageSequence;
+
+	deltaNum = MSG_ReadByte( msg );
+	if ( !deltaNum ) {
+		newSnap.deltaNum = -1;
+	} else {
+		newSnap.deltaNum = newSnap.messageNum - deltaNum;
+	}
+	newSnap.snapFlags = MSG_ReadByte( msg );
+
+	// a delta from a frame we don't have is read through and dropped
+	if ( newSnap.deltaNum <= 0 ) {
+		newSnap.valid = qtrue;		// uncompressed frame
+		old = NULL;
+	} else {
+		old = &demo->snapshots[newSnap.deltaNum & PACKET_MASK];
+		if ( !old->valid ) {
+			Com_Printf( "%s: delta from invalid frame\n", demo->name );
+		} else if ( old->messageNum != newSnap.deltaNum ) {
+			// the server demo starts on a delta from before the recording
+			Com_DPrintf( "%s: delta frame too old\n", demo->name );
+		} else if ( demo->parseEntitiesNum - old->parseEntitiesNum > DS_PARSE_ENTITIES - MAX_SNAPSHOT_ENTITIES ) {
+			Com_DPrintf( "%s: delta parseEntitiesNum too old\n", demo->name );
+		} else {
+			newSnap.valid = qtrue;	// valid delta parse
+		}
+	}
+
+	// the areamask isn't of any use here
+	len = MSG_ReadByte( msg );
+	if ( len > sizeof( areamask ) ) {
+		Com_Error( ERR_DROP, "DS_ParseSnapshot: Invalid size %d for areamask", len );
+	}
+	MSG_ReadData( msg, areamask, len );
+
+	if ( old ) {
+		MSG_ReadDeltaPlayerstate( msg, &old->ps, &newSnap.ps );
+	} else {
+		MSG_ReadDeltaPlayerstate( msg, NULL, &newSnap.ps );
+	}
+
+	DS_ParsePacketEntities( demo, msg, old, &newSnap );
+
+	if ( !newSnap.valid ) {
+		return;
+	}
+
+	// the frames in between are gone, don't take them for deltas later
+	oldMessageNum = demo->snap.messageNum + 1;
+	if ( newSnap.messageNum - oldMessageNum >= PACKET_BACKUP ) {
+		oldMessageNum = newSnap.messageNum - ( PACKET_BACKUP - 1 );
+	}
+	for ( ; oldMessageNum < newSnap.messageNum ; oldMessageNum++ ) {
+		demo->snapshots[oldMessageNum & PACKET_MASK].valid = qfalse;
+	}
+
+	demo->snap = newSnap;
+	demo->snapshots[demo->snap.messageNum & PACKET_MASK] = demo->snap;
+
+	DS_WriteFrame( demo );
+}
+
+/*
+==================
+DS_ParseGamestate
+==================
+*/
+static void DS_ParseGamestate( dsDemo_t *demo, msg_t *msg ) {
+	int				i;
+	entityState_t	nullstate;
+	int				newnum;
+	int				cmd, len;
+	char			*s;
+
+	DS_ClearState( demo );
+
+	// a gamestate always marks a server command sequence
+	demo->serverCommandSequence = MSG_ReadLong( msg );
+
+	// parse all the configstrings and baselines
+	demo->gameState.dataCount = 1;	// leave a 0 at the beginning for uninitialized configstrings
+	while ( 1 ) {
+		cmd = MSG_ReadByte( msg );
+
+		if ( cmd == svc_EOF ) {
+			break;
+		}
+
+		if ( cmd == svc_configstring ) {
+			i = MSG_ReadShort( msg );
+			if ( i < 0 || i >= MAX_CONFIGSTRINGS ) {
+				Com_Error( ERR_DROP, "configstring > MAX_CONFIGSTRINGS" );
+			}
+			s = MSG_ReadBigString( msg );
+			len = strlen( s );
+
+			if ( len + 1 + demo->gameState.dataCount > MAX_GAMESTATE_CHARS ) {
+				Com_Error( ERR_DROP, "MAX_GAMESTATE_CHARS exceeded" );
+			}
+
+			demo->gameState.stringOffsets[ i ] = demo->gameState.dataCount;
+			Com_Memcpy( demo->gameState.stringData + demo->gameState.dataCount, s, len + 1 );
+			demo->gameState.dataCount += len + 1;
+		} else if ( cmd == svc_baseline ) {
+			newnum = MSG_ReadBits( msg, GENTITYNUM_BITS );
+			if ( newnum < 0 || newnum >= MAX_GENTITIES ) {
+				Com_Error( ERR_DROP, "Baseline number out of range: %i", newnum );
+			}
+			Com_Memset( &nullstate, 0, sizeof( nullstate ) );
+			MSG_ReadDeltaEntity( msg, &nullstate, &demo->entityBaselines[ newnum ], newnum );
+		} else {
+			Com_Error( ERR_DROP, "DS_ParseGamestate: bad command byte" );
+		}
+	}
+
+	demo->clientNum = MSG_ReadLong( msg );
+	// the checksum feed
+	MSG_ReadLong( msg );
+
+	DS_WriteGamestate( demo );
+}
+
+/*
+=====================
+DS_ParseCommandString
+=====================
+*/
+static void DS_ParseCommandString( dsDemo_t *demo, msg_t *msg ) {
+	char	*s;
+	int		seq;
+
+	seq = MSG_ReadLong( msg );
+	s = MSG_ReadString( msg );
+
+	// a repeat of one already seen
+	if ( demo->serverCommandSequence >= seq ) {
+		return;
+	}
+	demo->serverCommandSequence = seq;
+
+	DS_WriteCommand( demo, seq, s );
+}
+
+/*
+=====================
+DS_SkipVoip
+
+The same reads CL_ParseVoip makes, the data goes nowhere
+=====================
+*/
+static void DS_SkipVoip( msg_t *msg ) {
+	byte	encoded[4000];
+	int		packetsize, br;
+
+	MSG_ReadShort( msg );	// sender
+	MSG_ReadByte( msg );	// generation
+	MSG_ReadLong( msg );	// sequence
+	MSG_ReadByte( msg );	// frames
+	packetsize = MSG_ReadShort( msg );
+	MSG_ReadBits( msg, VOIP_FLAGCNT );
+
+	while ( packetsize > 0 ) {
+		br = packetsize;
+		if ( br > sizeof( encoded ) ) {
+			br = sizeof( encoded );
+		}
+		MSG_ReadData( msg, encoded, br );
+		packetsize -= br;
+	}
+}
+
+/*
+=====================
+DS_ParseServerMessage
+=====================
+*/
+void DS_ParseServerMessage( dsDemo_t *demo, msg_t *msg ) {
+	int			cmd;
+
+	MSG_Bitstream( msg );
+
+	// the reliable sequence acknowledge number
+	MSG_ReadLong( msg );
+
+	while ( 1 ) {
+		if ( msg->readcount > msg->cursize ) {
+			Com_Error( ERR_DROP, "DS_ParseServerMessage: read past end of server message" );
+		}
+
+		cmd = MSG_ReadByte( msg );
+
+		if ( cmd == svc_EOF ) {
+			break;
+		}
+
+		switch ( cmd ) {
+		default:
+			Com_Error( ERR_DROP, "DS_ParseServerMessage: Illegible server message" );
+			break;
+		case svc_nop:
+			break;
+		case svc_serverCommand:
+			DS_ParseCommandString( demo, msg );
+			break;
+		case svc_gamestate:
+			DS_ParseGamestate( demo, msg );
+			break;
+		case svc_snapshot:
+			DS_ParseSnapshot( demo, msg );
+			break;
+		case svc_download:
+			break;
+		case svc_voipSpeex:
+		case svc_voipOpus:
+			DS_SkipVoip( msg );
+			break;
+		}
+	}
+}
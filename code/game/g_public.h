@@ -230,6 +230,12 @@ typedef enum {
 	// 1.32
 	G_FS_SEEK,
 
+	G_TRACE_AT_TIME,	// ( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int time );
+	// G_TRACE against the entities as they were at the given server time
+
+	G_GET_NATIVE_API,	// gameNativeApi_t *( int version )
+	// typed engine calls for a game built as a shared library, see below
+
 	BOTLIB_SETUP = 200,				// ( void );
 	BOTLIB_SHUTDOWN,				// ( void );
 	BOTLIB_LIBVAR_SET,
@@ -244,6 +250,9 @@ typedef enum {
 	BOTLIB_GET_CONSOLE_MESSAGE,		// ( int client, char *message, int size );
 	BOTLIB_USER_COMMAND,			// ( int client, usercmd_t *ucmd );
 
+	BOTLIB_UPDATEENTITIES,			// ( int numEntities, const int *entnums, bot_entitystate_t *states );
+	// BOTLIB_UPDATENTITY for each, entity numbers with BOTLIB_ENTITY_UNLINK set are unlinked
+
 	BOTLIB_AAS_ENABLE_ROUTING_AREA = 300,
 	BOTLIB_AAS_BBOX_AREAS,
 	BOTLIB_AAS_AREA_INFO,
@@ -269,6 +278,7 @@ typedef enum {
 
 	BOTLIB_AAS_SWIMMING,
 	BOTLIB_AAS_PREDICT_CLIENT_MOVEMENT,
+	BOTLIB_AAS_PREDICT_CLIENT_MOVEMENTS,	// ( aas_clientmove_t *moves, int entnum, vec3_t origin, int presencetype, int onground, aas_clientmoveinput_t *inputs, int numinputs, int maxframes, float frametime, int stopevent, int stopareanum );
 
 	BOTLIB_EA_SAY = 400,
 	BOTLIB_EA_SAY_TEAM,
@@ -399,6 +409,66 @@ typedef enum {
 } gameImport_t;
 
 
+/*
+A game built as a shared library can ask for G_GET_NATIVE_API with the
+version it was built against, and then call the engine straight through
+the table it gets back, without the syscall argument packing and dispatch.
+The result is NULL for a QVM and from an engine without that version, and
+a game that never asks works as before. New versions only append members.
+
+GetEntities hands out MAX_GENTITIES sharedEntity_t owned by the engine. A
+game that keeps the s and r parts of its entities there, and gives that
+array to LocateGameData with a size of sizeof( sharedEntity_t ), lets the
+server walk the entities densely instead of stepping over each gentity_t.
+*/
+#define	GAME_NATIVE_API_VERSION	2
+
+typedef struct {
+	int			version;
+
+	void		(*Print)( const char *string );
+	void		(*Error)( const char *string );
+	int			(*Milliseconds)( void );
+
+	void		(*Cvar_Register)( vmCvar_t *vmCvar, const char *varName, const char *defaultValue, int flags );
+	void		(*Cvar_Update)( vmCvar_t *vmCvar );
+	void		(*Cvar_Set)( const char *varName, const char *value );
+	int			(*Cvar_VariableIntegerValue)( const char *varName );
+	void		(*Cvar_VariableStringBuffer)( const char *varName, char *buffer, int bufsize );
+	int			(*Argc)( void );
+	void		(*Argv)( int n, char *buffer, int bufferLength );
+	void		(*SendConsoleCommand)( int exec_when, const char *text );
+
+	void		(*LocateGameData)( sharedEntity_t *gEnts, int numGEntities, int sizeofGEntity_t,
+							playerState_t *clients, int sizeofGameClient );
+	sharedEntity_t	*(*GetEntities)( void );
+	void		(*DropClient)( int clientNum, const char *reason );
+	void		(*SendServerCommand)( int clientNum, const char *text );
+	void		(*SetConfigstring)( int num, const char *string );
+	void		(*GetConfigstring)( int num, char *buffer, int bufferSize );
+	void		(*SetUserinfo)( int num, const char *buffer );
+	void		(*GetUserinfo)( int num, char *buffer, int bufferSize );
+	void		(*GetServerinfo)( char *buffer, int bufferSize );
+	void		(*GetUsercmd)( int clientNum, usercmd_t *cmd );
+	qboolean	(*GetEntityToken)( char *buffer, int bufferSize );
+
+	void		(*LinkEntity)( sharedEntity_t *ent );
+	void		(*UnlinkEntity)( sharedEntity_t *ent );
+	void		(*SetBrushModel)( sharedEntity_t *ent, const char *name );
+	int			(*EntitiesInBox)( const vec3_t mins, const vec3_t maxs, int *list, int maxcount );
+	qboolean	(*EntityContact)( vec3_t mins, vec3_t maxs, const sharedEntity_t *ent, int capsule );
+	void		(*Trace)( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end,
+							int passEntityNum, int contentmask, int capsule );
+	void		(*TraceAtTime)( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end,
+							int passEntityNum, int contentmask, int capsule, int time );
+	int			(*PointContents)( const vec3_t point, int passEntityNum );
+	qboolean	(*InPVS)( const vec3_t p1, const vec3_t p2 );
+	qboolean	(*InPVSIgnorePortals)( const vec3_t p1, const vec3_t p2 );
+	void		(*AdjustAreaPortalState)( sharedEntity_t *ent, qboolean open );
+	qboolean	(*AreasConnected)( int area1, int area2 );
+} gameNativeApi_t;
+
+
 //
 // functions exported by the game subsystem
 //
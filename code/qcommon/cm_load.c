@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 // cmodel.c -- model loading
 
 #include "cm_local.h"
+#include "cm_patch.h"
 
 #ifdef BSPC
 
@@ -42,7 +43,8 @@ void SetPlaneSignbits (cplane_t *out) {
 #endif //BSPC
 
 // to allow boxes to be treated as brush models, we allocate
-// some extra indexes along with those needed by the map
+// some extra indexes along with those needed by the map,
+// one set for each collision thread
 #define	BOX_BRUSHES		1
 #define	BOX_SIDES		6
 #define	BOX_LEAFS		2
@@ -52,8 +54,8 @@ void SetPlaneSignbits (cplane_t *out) {
 
 
 clipMap_t	cm;
-int			c_pointcontents;
-int			c_traces, c_brush_traces, c_patch_traces;
+
+static cmThread_t	cm_noMapThread;		// used while no map is loaded
 
 
 byte		*cmod_base;
@@ -62,12 +64,10 @@ byte		*cmod_base;
 cvar_t		*cm_noAreas;
 cvar_t		*cm_noCurves;
 cvar_t		*cm_playerCurveClip;
+cvar_t		*cm_simdBrushes;
+cvar_t		*cm_cache;
 #endif
 
-cmodel_t	box_model;
-cplane_t	*box_planes;
-cbrush_t	*box_brush;
-
 
 
 void	CM_InitBoxHull (void);
@@ -100,7 +100,7 @@ void CMod_LoadShaders( lump_t *l ) {
 	if (count < 1) {
 		Com_Error (ERR_DROP, "Map with no shaders");
 	}
-	cm.shaders = Hunk_Alloc( count * sizeof( *cm.shaders ), h_high );
+	cm.shaders = CM_Alloc( count * sizeof( *cm.shaders ) );
 	cm.numShaders = count;
 
 	Com_Memcpy( cm.shaders, in, count * sizeof( *cm.shaders ) );
@@ -131,7 +131,7 @@ void CMod_LoadSubmodels( lump_t *l ) {
 
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map with no models");
-	cm.cmodels = Hunk_Alloc( count * sizeof( *cm.cmodels ), h_high );
+	cm.cmodels = CM_Alloc( count * sizeof( *cm.cmodels ) );
 	cm.numSubModels = count;
 
 	if ( count > MAX_SUBMODELS ) {
@@ -154,14 +154,14 @@ void CMod_LoadSubmodels( lump_t *l ) {
 
 		// make a "leaf" just to hold the model's brushes and surfaces
 		out->leaf.numLeafBrushes = LittleLong( in->numBrushes );
-		indexes = Hunk_Alloc( out->leaf.numLeafBrushes * 4, h_high );
+		indexes = CM_Alloc( out->leaf.numLeafBrushes * 4 );
 		out->leaf.firstLeafBrush = indexes - cm.leafbrushes;
 		for ( j = 0 ; j < out->leaf.numLeafBrushes ; j++ ) {
 			indexes[j] = LittleLong( in->firstBrush ) + j;
 		}
 
 		out->leaf.numLeafSurfaces = LittleLong( in->numSurfaces );
-		indexes = Hunk_Alloc( out->leaf.numLeafSurfaces * 4, h_high );
+		indexes = CM_Alloc( out->leaf.numLeafSurfaces * 4 );
 		out->leaf.firstLeafSurface = indexes - cm.leafsurfaces;
 		for ( j = 0 ; j < out->leaf.numLeafSurfaces ; j++ ) {
 			indexes[j] = LittleLong( in->firstSurface ) + j;
@@ -189,7 +189,7 @@ void CMod_LoadNodes( lump_t *l ) {
 
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map has no nodes");
-	cm.nodes = Hunk_Alloc( count * sizeof( *cm.nodes ), h_high );
+	cm.nodes = CM_Alloc( count * sizeof( *cm.nodes ) );
 	cm.numNodes = count;
 
 	out = cm.nodes;
@@ -224,6 +224,49 @@ void CM_BoundBrush( cbrush_t *b ) {
 }
 
 
+/*
+=================
+CM_PackBrushPlanes
+
+Copies the side planes of every map brush into blocks of
+PACKED_PLANE_LANES normals and distances so the trace code can
+test several sides at once.  Unused lanes get a zero plane.
+The box brushes are rebuilt per trace and stay unpacked.
+=================
+*/
+static void CM_PackBrushPlanes( void ) {
+	cbrush_t	*b;
+	cplane_t	*plane;
+	float		*out;
+	int			i, j, total;
+
+	total = 0;
+	for ( i = 0, b = cm.brushes ; i < cm.numBrushes ; i++, b++ ) {
+		total += ( b->numsides + PACKED_PLANE_LANES - 1 ) / PACKED_PLANE_LANES;
+	}
+
+	out = CM_Alloc( total * PACKED_PLANE_BLOCK * sizeof( float ) );
+
+	for ( i = 0, b = cm.brushes ; i < cm.numBrushes ; i++, b++ ) {
+		b->packedPlanes = out;
+		for ( j = 0 ; j < b->numsides ; j++ ) {
+			plane = b->sides[j].plane;
+			out[0] = plane->normal[0];
+			out[PACKED_PLANE_LANES] = plane->normal[1];
+			out[PACKED_PLANE_LANES * 2] = plane->normal[2];
+			out[PACKED_PLANE_LANES * 3] = plane->dist;
+			if ( ( j + 1 ) % PACKED_PLANE_LANES ) {
+				out++;
+			} else {
+				out += PACKED_PLANE_BLOCK - PACKED_PLANE_LANES + 1;
+			}
+		}
+		if ( j % PACKED_PLANE_LANES ) {
+			out += PACKED_PLANE_BLOCK - j % PACKED_PLANE_LANES;
+		}
+	}
+}
+
 /*
 =================
 CMod_LoadBrushes
@@ -241,7 +284,7 @@ void CMod_LoadBrushes( lump_t *l ) {
 	}
 	count = l->filelen / sizeof(*in);
 
-	cm.brushes = Hunk_Alloc( ( BOX_BRUSHES + count ) * sizeof( *cm.brushes ), h_high );
+	cm.brushes = CM_Alloc( ( BOX_BRUSHES * cm.numThreads + count ) * sizeof( *cm.brushes ) );
 	cm.numBrushes = count;
 
 	out = cm.brushes;
@@ -258,7 +301,214 @@ void CMod_LoadBrushes( lump_t *l ) {
 
 		CM_BoundBrush( out );
 	}
+}
+
+/*
+=================
+CM_RepackBrushes
+
+Renumbers the brushes in the order the leafs reference them, so the
+brushes of a leaf sit next to each other, and gives every brush its own
+run of sides with a copy of each side plane right behind the last one.
+The order brushes are tested in a leaf doesn't change, so neither do
+the trace results.
+=================
+*/
+static void CM_RepackBrushes( void ) {
+	cbrush_t		*old, *b;
+	cbrushside_t	*sides, *s;
+	cplane_t		*planes;
+	cLeaf_t			*leaf;
+	int				*remap;
+	int				i, j, k, next, total;
+
+	if ( !cm.numBrushes ) {
+		return;
+	}
+
+	remap = Z_Malloc( cm.numBrushes * sizeof( *remap ) );
+	for ( i = 0 ; i < cm.numBrushes ; i++ ) {
+		remap[i] = -1;
+	}
+
+	// first come first numbered, the world leafs and then the submodels
+	next = 0;
+	for ( i = 0 ; i < cm.numLeafs + cm.numSubModels ; i++ ) {
+		if ( i < cm.numLeafs ) {
+			leaf = &cm.leafs[i];
+		} else {
+			leaf = &cm.cmodels[i - cm.numLeafs].leaf;
+		}
+		for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
+			j = cm.leafbrushes[leaf->firstLeafBrush + k];
+			if ( (unsigned)j >= (unsigned)cm.numBrushes ) {
+				Com_Error( ERR_DROP, "CM_RepackBrushes: bad brush number %i", j );
+			}
+			if ( remap[j] == -1 ) {
+				remap[j] = next++;
+			}
+		}
+	}
+	for ( i = 0 ; i < cm.numBrushes ; i++ ) {
+		if ( remap[i] == -1 ) {
+			remap[i] = next++;
+		}
+	}
+
+	// the world leafs share the lump, every submodel has its own list
+	for ( i = 0 ; i < cm.numLeafBrushes ; i++ ) {
+		cm.leafbrushes[i] = remap[cm.leafbrushes[i]];
+	}
+	for ( i = 1 ; i < cm.numSubModels ; i++ ) {
+		leaf = &cm.cmodels[i].leaf;
+		for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
+			cm.leafbrushes[leaf->firstLeafBrush + k] = remap[cm.leafbrushes[leaf->firstLeafBrush + k]];
+		}
+	}
+
+	old = Z_Malloc( cm.numBrushes * sizeof( *old ) );
+	Com_Memcpy( old, cm.brushes, cm.numBrushes * sizeof( *old ) );
+	total = 0;
+	for ( i = 0 ; i < cm.numBrushes ; i++ ) {
+		if ( old[i].numsides < 0 || old[i].sides < cm.brushsides
+			|| old[i].sides + old[i].numsides > cm.brushsides + cm.numBrushSides ) {
+			Com_Error( ERR_DROP, "CM_RepackBrushes: bad brush sides" );
+		}
+		cm.brushes[remap[i]] = old[i];
+		total += old[i].numsides;
+	}
+
+	// the box hull sides still go after the map ones
+	sides = CM_Alloc( ( BOX_SIDES * cm.numThreads + total ) * sizeof( *sides ) );
+	planes = CM_Alloc( total * sizeof( *planes ) );
+	s = sides;
+	for ( i = 0, b = cm.brushes ; i < cm.numBrushes ; i++, b++ ) {
+		for ( j = 0 ; j < b->numsides ; j++, s++ ) {
+			*s = b->sides[j];
+			planes[s - sides] = *s->plane;
+			s->plane = &planes[s - sides];
+		}
+		b->sides = s - b->numsides;
+	}
+	cm.brushsides = sides;
+	cm.numBrushSides = total;
+
+	Z_Free( old );
+	Z_Free( remap );
+}
+
+/*
+=================
+CM_LeafContents
+
+Contents of every point in the box, or -1 if some brush of the leaf is
+partly in it.  The tests are the ones CM_PointContents does, on the box
+corner nearest to and farthest along each side plane.
+=================
+*/
+static int CM_LeafContents( cLeaf_t *leaf, const vec3_t mins, const vec3_t maxs ) {
+	cbrush_t	*b;
+	cplane_t	*plane;
+	vec3_t		nearp, farp;
+	qboolean	inside, outside;
+	int			contents;
+	int			i, j, k;
+
+	contents = 0;
+	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
+		b = &cm.brushes[cm.leafbrushes[leaf->firstLeafBrush + k]];
+
+		inside = qtrue;
+		outside = qfalse;
+		for ( i = 0 ; i < b->numsides && !outside ; i++ ) {
+			plane = b->sides[i].plane;
+			for ( j = 0 ; j < 3 ; j++ ) {
+				if ( plane->normal[j] < 0 ) {
+					nearp[j] = maxs[j];
+					farp[j] = mins[j];
+				} else {
+					nearp[j] = mins[j];
+					farp[j] = maxs[j];
+				}
+			}
+			if ( DotProduct( nearp, plane->normal ) > plane->dist ) {
+				outside = qtrue;
+			} else if ( DotProduct( farp, plane->normal ) > plane->dist ) {
+				inside = qfalse;
+			}
+		}
+
+		if ( outside ) {
+			continue;
+		}
+		if ( !inside ) {
+			return -1;
+		}
+		contents |= b->contents;
+	}
+
+	return contents;
+}
+
+/*
+=================
+CM_FindLeafContents_r
+
+The bounds are those of the world cut down by the axial node planes on
+the way to the leaf, the others are left out so the box may be larger
+than the leaf.
+=================
+*/
+static void CM_FindLeafContents_r( int num, const vec3_t mins, const vec3_t maxs ) {
+	cLeafContents_t	*out;
+	cplane_t	*plane;
+	vec3_t		childMins, childMaxs;
+	int			i;
+
+	while ( num >= 0 ) {
+		plane = cm.nodes[num].plane;
+		if ( plane->type >= 3 ) {
+			CM_FindLeafContents_r( cm.nodes[num].children[0], mins, maxs );
+			num = cm.nodes[num].children[1];
+			continue;
+		}
+
+		// CM_PointLeafnum_r sends p[type] >= dist to the front
+		VectorCopy( mins, childMins );
+		VectorCopy( maxs, childMaxs );
+		childMins[plane->type] = MAX( mins[plane->type], plane->dist );
+		childMaxs[plane->type] = MIN( maxs[plane->type], plane->dist );
+		CM_FindLeafContents_r( cm.nodes[num].children[0], childMins, maxs );
+		CM_FindLeafContents_r( cm.nodes[num].children[1], mins, childMaxs );
+		return;
+	}
+
+	out = &cm.leafContents[-1 - num];
+	for ( i = 0 ; i < 3 ; i++ ) {
+		out->bounds[0][i] = mins[i] + LEAF_CONTENTS_EPSILON;
+		out->bounds[1][i] = maxs[i] - LEAF_CONTENTS_EPSILON;
+		if ( out->bounds[0][i] > out->bounds[1][i] ) {
+			out->contents = -1;
+			return;
+		}
+	}
+	out->contents = CM_LeafContents( &cm.leafs[-1 - num], out->bounds[0], out->bounds[1] );
+}
+
+/*
+=================
+CM_FindLeafContents
+=================
+*/
+static void CM_FindLeafContents( void ) {
+	int		i;
+
+	cm.leafContents = CM_Alloc( cm.numLeafs * sizeof( *cm.leafContents ) );
+	for ( i = 0 ; i < cm.numLeafs ; i++ ) {
+		cm.leafContents[i].contents = -1;
+	}
 
+	CM_FindLeafContents_r( 0, cm.cmodels[0].mins, cm.cmodels[0].maxs );
 }
 
 /*
@@ -281,7 +531,7 @@ void CMod_LoadLeafs (lump_t *l)
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map with no leafs");
 
-	cm.leafs = Hunk_Alloc( ( BOX_LEAFS + count ) * sizeof( *cm.leafs ), h_high );
+	cm.leafs = CM_Alloc( ( BOX_LEAFS + count ) * sizeof( *cm.leafs ) );
 	cm.numLeafs = count;
 
 	out = cm.leafs;	
@@ -300,8 +550,11 @@ void CMod_LoadLeafs (lump_t *l)
 			cm.numAreas = out->area + 1;
 	}
 
-	cm.areas = Hunk_Alloc( cm.numAreas * sizeof( *cm.areas ), h_high );
-	cm.areaPortals = Hunk_Alloc( cm.numAreas * cm.numAreas * sizeof( *cm.areaPortals ), h_high );
+	cm.areas = CM_Alloc( cm.numAreas * sizeof( *cm.areas ) );
+	cm.areaPortals = CM_Alloc( cm.numAreas * cm.numAreas * sizeof( *cm.areaPortals ) );
+	cm.areaPortalWords = ( cm.numAreas + 31 ) >> 5;
+	cm.areaPortalBits = CM_Alloc( cm.numAreas * cm.areaPortalWords * sizeof( *cm.areaPortalBits ) );
+	cm.areaFloodStack = CM_Alloc( cm.numAreas * sizeof( *cm.areaFloodStack ) );
 }
 
 /*
@@ -324,7 +577,7 @@ void CMod_LoadPlanes (lump_t *l)
 
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map with no planes");
-	cm.planes = Hunk_Alloc( ( BOX_PLANES + count ) * sizeof( *cm.planes ), h_high );
+	cm.planes = CM_Alloc( ( BOX_PLANES * cm.numThreads + count ) * sizeof( *cm.planes ) );
 	cm.numPlanes = count;
 
 	out = cm.planes;	
@@ -362,7 +615,7 @@ void CMod_LoadLeafBrushes (lump_t *l)
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
 
-	cm.leafbrushes = Hunk_Alloc( (count + BOX_BRUSHES) * sizeof( *cm.leafbrushes ), h_high );
+	cm.leafbrushes = CM_Alloc( (count + BOX_BRUSHES * cm.numThreads) * sizeof( *cm.leafbrushes ) );
 	cm.numLeafBrushes = count;
 
 	out = cm.leafbrushes;
@@ -389,7 +642,7 @@ void CMod_LoadLeafSurfaces( lump_t *l )
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
 
-	cm.leafsurfaces = Hunk_Alloc( count * sizeof( *cm.leafsurfaces ), h_high );
+	cm.leafsurfaces = CM_Alloc( count * sizeof( *cm.leafsurfaces ) );
 	cm.numLeafSurfaces = count;
 
 	out = cm.leafsurfaces;
@@ -418,7 +671,7 @@ void CMod_LoadBrushSides (lump_t *l)
 	}
 	count = l->filelen / sizeof(*in);
 
-	cm.brushsides = Hunk_Alloc( ( BOX_SIDES + count ) * sizeof( *cm.brushsides ), h_high );
+	cm.brushsides = CM_Alloc( ( BOX_SIDES * cm.numThreads + count ) * sizeof( *cm.brushsides ) );
 	cm.numBrushSides = count;
 
 	out = cm.brushsides;	
@@ -441,7 +694,7 @@ CMod_LoadEntityString
 =================
 */
 void CMod_LoadEntityString( lump_t *l ) {
-	cm.entityString = Hunk_Alloc( l->filelen, h_high );
+	cm.entityString = CM_Alloc( l->filelen );
 	cm.numEntityChars = l->filelen;
 	Com_Memcpy (cm.entityString, cmod_base + l->fileofs, l->filelen);
 }
@@ -459,14 +712,14 @@ void CMod_LoadVisibility( lump_t *l ) {
     len = l->filelen;
 	if ( !len ) {
 		cm.clusterBytes = ( cm.numClusters + 31 ) & ~31;
-		cm.visibility = Hunk_Alloc( cm.clusterBytes, h_high );
+		cm.visibility = CM_Alloc( cm.clusterBytes );
 		Com_Memset( cm.visibility, 255, cm.clusterBytes );
 		return;
 	}
 	buf = cmod_base + l->fileofs;
 
 	cm.vised = qtrue;
-	cm.visibility = Hunk_Alloc( len, h_high );
+	cm.visibility = CM_Alloc( len );
 	cm.numClusters = LittleLong( ((int *)buf)[0] );
 	cm.clusterBytes = LittleLong( ((int *)buf)[1] );
 	Com_Memcpy (cm.visibility, buf + VIS_HEADER, len - VIS_HEADER );
@@ -475,13 +728,461 @@ void CMod_LoadVisibility( lump_t *l ) {
 //==================================================================
 
 
+#ifndef BSPC
+/*
+===============================================================================
+
+					COLLISION CACHE
+
+Generating the patch collision is most of the load time on maps with
+many curves, so the result is saved under fs_homepath and reused the
+next time a map with the same checksum is loaded.  Only the planes and
+facets are stored, the facet trees are cheap to rebuild.
+
+===============================================================================
+*/
+
+#define	CMCACHE_IDENT		(('H'<<24)+('C'<<16)+('M'<<8)+'C')
+#define	CMCACHE_VERSION		1
+
+typedef struct {
+	int			ident;
+	int			version;
+	int			checksum;		// of the bsp the cache was built from
+	int			numSurfaces;
+	int			numPatches;
+	int			planeSize;		// structure sizes, a cache written by a
+	int			facetSize;		// differently built binary is not used
+} cmCacheHeader_t;
+
+typedef struct {
+	int			surfaceNum;
+	vec3_t		bounds[2];
+	int			numPlanes;
+	int			numFacets;
+} cmCachePatch_t;
+
+/*
+=================
+CM_CacheFileName
+=================
+*/
+static void CM_CacheFileName( const char *name, char *out, int outSize ) {
+	char	base[MAX_QPATH];
+
+	COM_StripExtension( COM_SkipPath( name ), base, sizeof( base ) );
+	Com_sprintf( out, outSize, "cmcache/%s.cmcache", base );
+}
+
+/*
+=================
+CM_OpenCache
+
+Returns a handle positioned at the first patch record, or 0 if there
+is no cache for this exact map.
+=================
+*/
+static fileHandle_t CM_OpenCache( const char *name, int checksum, int numPatches ) {
+	char			path[MAX_QPATH];
+	cmCacheHeader_t	header;
+	fileHandle_t	f;
+
+	CM_CacheFileName( name, path, sizeof( path ) );
+	if ( FS_SV_FOpenFileRead( path, &f ) < (long)sizeof( header ) ) {
+		if ( f ) {
+			FS_FCloseFile( f );
+		}
+		return 0;
+	}
+
+	if ( FS_Read( &header, sizeof( header ), f ) != sizeof( header )
+		|| header.ident != CMCACHE_IDENT
+		|| header.version != CMCACHE_VERSION
+		|| header.checksum != checksum
+		|| header.numSurfaces != cm.numSurfaces
+		|| header.numPatches != numPatches
+		|| header.planeSize != sizeof( patchPlane_t )
+		|| header.facetSize != sizeof( facet_t ) ) {
+		FS_FCloseFile( f );
+		return 0;
+	}
+
+	return f;
+}
+
+/*
+=================
+CM_ReadCachedPatch
+
+Returns NULL if the record is damaged or doesn't belong to this surface.
+The whole record is read and checked in temp memory first, so a damaged
+one leaves nothing allocated behind.
+=================
+*/
+static patchCollide_t *CM_ReadCachedPatch( fileHandle_t f, int surfaceNum ) {
+	cmCachePatch_t	rec;
+	patchCollide_t	*pc;
+	patchPlane_t	*planes;
+	facet_t			*facets, *facet;
+	byte			*buf;
+	int				i, j, planesLen, facetsLen;
+
+	if ( FS_Read( &rec, sizeof( rec ), f ) != sizeof( rec ) ) {
+		return NULL;
+	}
+	if ( rec.surfaceNum != surfaceNum
+		|| rec.numPlanes < 1 || rec.numPlanes > MAX_PATCH_PLANES
+		|| rec.numFacets < 0 || rec.numFacets > MAX_FACETS ) {
+		return NULL;
+	}
+
+	planesLen = rec.numPlanes * sizeof( *planes );
+	facetsLen = rec.numFacets * sizeof( *facets );
+
+	buf = Hunk_AllocateTempMemory( planesLen + facetsLen );
+	planes = (patchPlane_t *)buf;
+	facets = (facet_t *)( buf + planesLen );
+
+	if ( FS_Read( buf, planesLen + facetsLen, f ) != planesLen + facetsLen ) {
+		Hunk_FreeTempMemory( buf );
+		return NULL;
+	}
+
+	// make sure a damaged file can't index outside the patch
+	for ( i = 0 ; i < rec.numPlanes ; i++ ) {
+		if ( (unsigned)planes[i].signbits > 7 ) {
+			Hunk_FreeTempMemory( buf );
+			return NULL;
+		}
+	}
+	for ( i = 0, facet = facets ; i < rec.numFacets ; i++, facet++ ) {
+		if ( (unsigned)facet->surfacePlane >= (unsigned)rec.numPlanes
+			|| (unsigned)facet->numBorders > ARRAY_LEN( facet->borderPlanes ) ) {
+			Hunk_FreeTempMemory( buf );
+			return NULL;
+		}
+		for ( j = 0 ; j < facet->numBorders ; j++ ) {
+			if ( (unsigned)facet->borderPlanes[j] >= (unsigned)rec.numPlanes ) {
+				Hunk_FreeTempMemory( buf );
+				return NULL;
+			}
+		}
+	}
+
+	pc = CM_Alloc( sizeof( *pc ) );
+	VectorCopy( rec.bounds[0], pc->bounds[0] );
+	VectorCopy( rec.bounds[1], pc->bounds[1] );
+	pc->numPlanes = rec.numPlanes;
+	pc->numFacets = rec.numFacets;
+
+	pc->planes = CM_Alloc( planesLen );
+	Com_Memcpy( pc->planes, planes, planesLen );
+	pc->facets = CM_Alloc( facetsLen );
+	Com_Memcpy( pc->facets, facets, facetsLen );
+
+	Hunk_FreeTempMemory( buf );
+
+	CM_BuildFacetTree( pc );
+
+	return pc;
+}
+
+/*
+=================
+CM_WriteCache
+=================
+*/
+static void CM_WriteCache( const char *name, int checksum, int numPatches ) {
+	char			path[MAX_QPATH];
+	cmCacheHeader_t	header;
+	cmCachePatch_t	rec;
+	patchCollide_t	*pc;
+	fileHandle_t	f;
+	int				i;
+
+	CM_CacheFileName( name, path, sizeof( path ) );
+	f = FS_SV_FOpenFileWrite( path );
+	if ( !f ) {
+		Com_DPrintf( "Couldn't write collision cache %s\n", path );
+		return;
+	}
+
+	header.ident = CMCACHE_IDENT;
+	header.version = CMCACHE_VERSION;
+	header.checksum = checksum;
+	header.numSurfaces = cm.numSurfaces;
+	header.numPatches = numPatches;
+	header.planeSize = sizeof( patchPlane_t );
+	header.facetSize = sizeof( facet_t );
+	FS_Write( &header, sizeof( header ), f );
+
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+		pc = cm.surfaces[i]->pc;
+
+		Com_Memset( &rec, 0, sizeof( rec ) );
+		rec.surfaceNum = i;
+		VectorCopy( pc->bounds[0], rec.bounds[0] );
+		VectorCopy( pc->bounds[1], rec.bounds[1] );
+		rec.numPlanes = pc->numPlanes;
+		rec.numFacets = pc->numFacets;
+		FS_Write( &rec, sizeof( rec ), f );
+		FS_Write( pc->planes, pc->numPlanes * sizeof( *pc->planes ), f );
+		FS_Write( pc->facets, pc->numFacets * sizeof( *pc->facets ), f );
+	}
+
+	FS_FCloseFile( f );
+	Com_DPrintf( "Wrote collision cache %s\n", path );
+}
+
+/*
+===============================================================================
+
+					SHARED COLLISION MAP
+
+Dedicated servers on one host running the same map each hold an
+identical copy of the collision data.  With cm_shared set, the map is
+loaded into address space reserved at a fixed address picked from its
+checksum, and the result is written to cm_sharedDir.  Other processes
+loading the same map then map that file copy-on-write at the same
+address, so the pointers inside stay valid and only the pages a process
+writes to (trace counters, area portal states, box hulls) become its own.
+
+The pointers in the file are used as they are, so it is only mapped when
+this user owns it and nobody else may write it, and it is created that
+way.  cm_sharedDir defaults to cmshared/ in fs_homepath, which other
+users can't write to either.
+
+===============================================================================
+*/
+
+#define	CMSHARED_IDENT		(('H'<<24)+('S'<<16)+('M'<<8)+'C')
+#define	CMSHARED_VERSION	2
+#define	CMSHARED_BASE		0x500000000000ULL
+#define	CMSHARED_SLOTS		4096
+#define	CMSHARED_RESERVE	0x40000000		// address space per map
+
+typedef struct {
+	int			ident;
+	int			version;
+	int			checksum;		// of the bsp the map was built from
+	int			length;			// of the whole file, header included
+	int			mapSize;		// sizeof( clipMap_t ) and pointer size, a file
+	int			pointerSize;	// written by a differently built binary is not used
+	intptr_t	base;			// address the file has to be mapped at
+	clipMap_t	cm;
+} cmSharedHeader_t;
+
+static cvar_t	*cm_shared;
+static cvar_t	*cm_sharedDir;
+
+static byte		*cm_sharedBase;		// reserved region of the current map, NULL if none
+static int		cm_sharedUsed;
+static qboolean	cm_sharedLoading;	// CM_Alloc takes from the region
+
+/*
+=================
+CM_SharedFileName
+=================
+*/
+static void CM_SharedFileName( const char *name, int checksum, char *out, int outSize ) {
+	char	base[MAX_QPATH];
+
+	COM_StripExtension( COM_SkipPath( name ), base, sizeof( base ) );
+	if ( cm_sharedDir->string[0] ) {
+		Com_sprintf( out, outSize, "%s/%s-%08x-%i.cmshared", cm_sharedDir->string, base, checksum, cm.numThreads );
+	} else {
+		Com_sprintf( out, outSize, "%s/cmshared/%s-%08x-%i.cmshared", Cvar_VariableString( "fs_homepath" ),
+			base, checksum, cm.numThreads );
+	}
+}
+
+/*
+=================
+CM_SharedAddress
+=================
+*/
+static void *CM_SharedAddress( int checksum ) {
+	return (void *)(intptr_t)( CMSHARED_BASE + (unsigned long long)( (unsigned)checksum % CMSHARED_SLOTS ) * CMSHARED_RESERVE );
+}
+
+/*
+=================
+CM_SharedHeaderValid
+=================
+*/
+static qboolean CM_SharedHeaderValid( const cmSharedHeader_t *header, int checksum ) {
+	return header->ident == CMSHARED_IDENT
+		&& header->version == CMSHARED_VERSION
+		&& header->checksum == checksum
+		&& header->length >= (int)sizeof( *header ) && header->length <= CMSHARED_RESERVE
+		&& header->mapSize == sizeof( clipMap_t )
+		&& header->pointerSize == sizeof( void * )
+		&& header->base == (intptr_t)CM_SharedAddress( checksum )
+		&& header->cm.numThreads == cm.numThreads;
+}
+
+/*
+=================
+CM_ReleaseShared
+=================
+*/
+static void CM_ReleaseShared( void ) {
+	if ( cm_sharedBase ) {
+		Sys_ReleaseMemory( cm_sharedBase, CMSHARED_RESERVE );
+		cm_sharedBase = NULL;
+	}
+	cm_sharedLoading = qfalse;
+}
+
+/*
+=================
+CM_MapShared
+
+Takes the map from a file another process wrote, qfalse if there is no
+usable one
+=================
+*/
+static qboolean CM_MapShared( const char *name, int checksum ) {
+	char			path[MAX_OSPATH];
+	cmSharedHeader_t	header;
+	FILE			*f;
+	byte			*base;
+	size_t			read;
+
+	CM_SharedFileName( name, checksum, path, sizeof( path ) );
+	f = Sys_FOpen( path, "rb" );
+	if ( !f ) {
+		return qfalse;
+	}
+	read = fread( &header, 1, sizeof( header ), f );
+	fclose( f );
+
+	if ( read != sizeof( header ) || !CM_SharedHeaderValid( &header, checksum ) ) {
+		return qfalse;
+	}
+
+	base = Sys_ReserveMemory( (void *)header.base, CMSHARED_RESERVE );
+	if ( !base ) {
+		Com_DPrintf( "Address space for shared collision map %s is taken\n", path );
+		return qfalse;
+	}
+	// checks the owner, and the file may have been replaced since the read
+	if ( !Sys_MapFileAt( path, base, header.length )
+		|| !CM_SharedHeaderValid( (cmSharedHeader_t *)base, checksum )
+		|| ( (cmSharedHeader_t *)base )->length != header.length ) {
+		Sys_ReleaseMemory( base, CMSHARED_RESERVE );
+		return qfalse;
+	}
+
+	cm_sharedBase = base;
+	cm = ( (cmSharedHeader_t *)base )->cm;
+
+	Com_Printf( "Mapped shared collision map %s\n", path );
+	return qtrue;
+}
+
+/*
+=================
+CM_BeginShared
+
+Makes CM_Alloc load the map into the shared region
+=================
+*/
+static qboolean CM_BeginShared( int checksum ) {
+	cm_sharedBase = Sys_ReserveMemory( CM_SharedAddress( checksum ), CMSHARED_RESERVE );
+	if ( !cm_sharedBase ) {
+		return qfalse;
+	}
+
+	cm_sharedUsed = PAD( sizeof( cmSharedHeader_t ), 32 );
+	cm_sharedLoading = qtrue;
+	return qtrue;
+}
+
+/*
+=================
+CM_WriteShared
+
+Saves the region for other processes and switches this one over to the
+file's pages too
+=================
+*/
+static void CM_WriteShared( const char *name, int checksum ) {
+	char			path[MAX_OSPATH], temp[MAX_OSPATH];
+	cmSharedHeader_t	*header = (cmSharedHeader_t *)cm_sharedBase;
+	FILE			*f;
+	qboolean		written;
+
+	cm_sharedLoading = qfalse;
+
+	header->ident = CMSHARED_IDENT;
+	header->version = CMSHARED_VERSION;
+	header->checksum = checksum;
+	header->length = cm_sharedUsed;
+	header->mapSize = sizeof( clipMap_t );
+	header->pointerSize = sizeof( void * );
+	header->base = (intptr_t)cm_sharedBase;
+	header->cm = cm;
+
+	// write under a temporary name so no process maps a partial file
+	CM_SharedFileName( name, checksum, path, sizeof( path ) );
+	if ( !cm_sharedDir->string[0] ) {
+		FS_CreatePath( path );
+	}
+	Com_sprintf( temp, sizeof( temp ), "%s.%x%x", path, rand(), Com_Milliseconds() );
+	f = Sys_FCreate( temp );
+	if ( !f ) {
+		Com_DPrintf( "Couldn't write shared collision map %s\n", temp );
+		return;
+	}
+	written = fwrite( cm_sharedBase, 1, cm_sharedUsed, f ) == (size_t)cm_sharedUsed;
+	if ( fclose( f ) || !written || rename( temp, path ) ) {
+		Com_DPrintf( "Couldn't write shared collision map %s\n", path );
+		remove( temp );
+		return;
+	}
+
+	if ( Sys_MapFileAt( path, cm_sharedBase, cm_sharedUsed ) ) {
+		Com_Printf( "Wrote shared collision map %s\n", path );
+	}
+}
+#endif
+
+/*
+=================
+CM_Alloc
+
+All the collision data is allocated here, so it can go into the shared
+region as well as on the hunk
+=================
+*/
+void *CM_Alloc( int size ) {
+#ifndef BSPC
+	void	*buf;
+
+	if ( cm_sharedLoading ) {
+		size = PAD( size, 32 );
+		if ( size > CMSHARED_RESERVE - cm_sharedUsed ) {
+			Com_Error( ERR_DROP, "CM_Alloc: map doesn't fit the shared collision region, set cm_shared 0" );
+		}
+		buf = cm_sharedBase + cm_sharedUsed;
+		cm_sharedUsed += size;
+		return buf;
+	}
+#endif
+	return Hunk_Alloc( size, h_high );
+}
+
 /*
 =================
 CMod_LoadPatches
 =================
 */
 #define	MAX_PATCH_VERTS		1024
-void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
+void CMod_LoadPatches( lump_t *surfs, lump_t *verts, const char *name, int checksum ) {
 	drawVert_t	*dv, *dv_p;
 	dsurface_t	*in;
 	int			count;
@@ -491,17 +1192,34 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 	vec3_t		points[MAX_PATCH_VERTS];
 	int			width, height;
 	int			shaderNum;
+#ifndef BSPC
+	fileHandle_t	cache;
+	int			numPatches;
+#endif
 
 	in = (void *)(cmod_base + surfs->fileofs);
 	if (surfs->filelen % sizeof(*in))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	cm.numSurfaces = count = surfs->filelen / sizeof(*in);
-	cm.surfaces = Hunk_Alloc( cm.numSurfaces * sizeof( cm.surfaces[0] ), h_high );
+	cm.surfaces = CM_Alloc( cm.numSurfaces * sizeof( cm.surfaces[0] ) );
 
 	dv = (void *)(cmod_base + verts->fileofs);
 	if (verts->filelen % sizeof(*dv))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 
+#ifndef BSPC
+	cache = 0;
+	numPatches = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( LittleLong( in[i].surfaceType ) == MST_PATCH ) {
+			numPatches++;
+		}
+	}
+	if ( cm_cache->integer && numPatches ) {
+		cache = CM_OpenCache( name, checksum, numPatches );
+	}
+#endif
+
 	// scan through all the surfaces, but only load patches,
 	// not planar faces
 	for ( i = 0 ; i < count ; i++, in++ ) {
@@ -510,7 +1228,7 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 		}
 		// FIXME: check for non-colliding patches
 
-		cm.surfaces[ i ] = patch = Hunk_Alloc( sizeof( *patch ), h_high );
+		cm.surfaces[ i ] = patch = CM_Alloc( sizeof( *patch ) );
 
 		// load the full drawverts onto the stack
 		width = LittleLong( in->patchWidth );
@@ -531,9 +1249,31 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 		patch->contents = cm.shaders[shaderNum].contentFlags;
 		patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
 
+#ifndef BSPC
+		if ( cache ) {
+			patch->pc = CM_ReadCachedPatch( cache, i );
+			if ( !patch->pc ) {
+				Com_Printf( "WARNING: collision cache for %s is damaged, rebuilding\n", name );
+				FS_FCloseFile( cache );
+				cache = 0;
+			}
+		}
+		if ( patch->pc ) {
+			continue;
+		}
+#endif
+
 		// create the internal facet structure
 		patch->pc = CM_GeneratePatchCollide( width, height, points );
 	}
+
+#ifndef BSPC
+	if ( cache ) {
+		FS_FCloseFile( cache );
+	} else if ( cm_cache->integer && numPatches ) {
+		CM_WriteCache( name, checksum, numPatches );
+	}
+#endif
 }
 
 //==================================================================
@@ -575,6 +1315,9 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	dheader_t		header;
 	int				length;
 	static unsigned	last_checksum;
+#ifndef BSPC
+	qboolean		sharing;
+#endif
 
 	if ( !name || !name[0] ) {
 		Com_Error( ERR_DROP, "CM_LoadMap: NULL name" );
@@ -584,6 +1327,10 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	cm_noAreas = Cvar_Get ("cm_noAreas", "0", CVAR_CHEAT);
 	cm_noCurves = Cvar_Get ("cm_noCurves", "0", CVAR_CHEAT);
 	cm_playerCurveClip = Cvar_Get ("cm_playerCurveClip", "1", CVAR_ARCHIVE|CVAR_CHEAT );
+	cm_simdBrushes = Cvar_Get ("cm_simdBrushes", "1", CVAR_ARCHIVE );
+	cm_cache = Cvar_Get ("cm_cache", "1", CVAR_ARCHIVE );
+	cm_shared = Cvar_Get ("cm_shared", "0", CVAR_ARCHIVE );
+	cm_sharedDir = Cvar_Get ("cm_sharedDir", "", CVAR_ARCHIVE );
 #endif
 	Com_DPrintf( "CM_LoadMap( %s, %i )\n", name, clientload );
 
@@ -593,14 +1340,23 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	}
 
 	// free old stuff
+#ifndef BSPC
+	CM_ReleaseShared();
+#endif
 	Com_Memset( &cm, 0, sizeof( cm ) );
 	CM_ClearLevelPatches();
 
+#ifdef BSPC
+	cm.numThreads = 1;
+#else
+	cm.numThreads = Com_NumWorkers();
+#endif
+
 	if ( !name[0] ) {
 		cm.numLeafs = 1;
 		cm.numClusters = 1;
 		cm.numAreas = 1;
-		cm.cmodels = Hunk_Alloc( sizeof( *cm.cmodels ), h_high );
+		cm.cmodels = CM_Alloc( sizeof( *cm.cmodels ) );
 		*checksum = 0;
 		return;
 	}
@@ -633,6 +1389,20 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 
 	cmod_base = (byte *)buf.i;
 
+#ifndef BSPC
+	sharing = qfalse;
+	if ( cm_shared->integer && sizeof( void * ) >= 8 ) {
+		if ( CM_MapShared( name, last_checksum ) ) {
+			FS_FreeFile( buf.v );
+			if ( !clientload ) {
+				Q_strncpyz( cm.name, name, sizeof( cm.name ) );
+			}
+			return;
+		}
+		sharing = CM_BeginShared( last_checksum );
+	}
+#endif
+
 	// load into heap
 	CMod_LoadShaders( &header.lumps[LUMP_SHADERS] );
 	CMod_LoadLeafs (&header.lumps[LUMP_LEAFS]);
@@ -642,10 +1412,13 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	CMod_LoadBrushSides (&header.lumps[LUMP_BRUSHSIDES]);
 	CMod_LoadBrushes (&header.lumps[LUMP_BRUSHES]);
 	CMod_LoadSubmodels (&header.lumps[LUMP_MODELS]);
+	CM_RepackBrushes ();
+	CM_PackBrushPlanes ();
 	CMod_LoadNodes (&header.lumps[LUMP_NODES]);
+	CM_FindLeafContents ();
 	CMod_LoadEntityString (&header.lumps[LUMP_ENTITIES]);
 	CMod_LoadVisibility( &header.lumps[LUMP_VISIBILITY] );
-	CMod_LoadPatches( &header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS] );
+	CMod_LoadPatches( &header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS], name, last_checksum );
 
 	// we are NOT freeing the file, because it is cached for the ref
 	FS_FreeFile (buf.v);
@@ -658,6 +1431,12 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	if ( !clientload ) {
 		Q_strncpyz( cm.name, name, sizeof( cm.name ) );
 	}
+
+#ifndef BSPC
+	if ( sharing ) {
+		CM_WriteShared( name, last_checksum );
+	}
+#endif
 }
 
 /*
@@ -666,6 +1445,9 @@ CM_ClearMap
 ==================
 */
 void CM_ClearMap( void ) {
+#ifndef BSPC
+	CM_ReleaseShared();
+#endif
 	Com_Memset( &cm, 0, sizeof( cm ) );
 	CM_ClearLevelPatches();
 }
@@ -683,7 +1465,7 @@ cmodel_t	*CM_ClipHandleToModel( clipHandle_t handle ) {
 		return &cm.cmodels[handle];
 	}
 	if ( handle == BOX_MODEL_HANDLE ) {
-		return &box_model;
+		return &CM_ThreadState()->boxModel;
 	}
 	if ( handle < MAX_SUBMODELS ) {
 		Com_Error( ERR_DROP, "CM_ClipHandleToModel: bad handle %i < %i < %i", 
@@ -736,57 +1518,100 @@ int		CM_LeafArea( int leafnum ) {
 //=======================================================================
 
 
+/*
+===================
+CM_ThreadState
+
+Returns the collision state of the calling thread
+===================
+*/
+cmThread_t *CM_ThreadState( void ) {
+	int		index;
+
+	if ( !cm.threads ) {
+		return &cm_noMapThread;
+	}
+
+#ifdef BSPC
+	index = 0;
+#else
+	index = Com_WorkerIndex();
+#endif
+	if ( index >= cm.numThreads ) {
+		Com_Error( ERR_FATAL, "CM_ThreadState: thread %i has no collision state", index );
+	}
+
+	return &cm.threads[index];
+}
+
 /*
 ===================
 CM_InitBoxHull
 
 Set up the planes and nodes so that the six floats of a bounding box
 can just be stored out and get a proper clipping hull structure.
+Every collision thread gets its own box, so it's also where the
+per thread state is allocated.
 ===================
 */
 void CM_InitBoxHull (void)
 {
-	int			i;
+	int			i, t;
 	int			side;
+	int			firstPlane, firstSide;
 	cplane_t	*p;
 	cbrushside_t	*s;
+	cmThread_t	*thread;
 
-	box_planes = &cm.planes[cm.numPlanes];
+	cm.threads = CM_Alloc( cm.numThreads * sizeof( *cm.threads ) );
 
-	box_brush = &cm.brushes[cm.numBrushes];
-	box_brush->numsides = 6;
-	box_brush->sides = cm.brushsides + cm.numBrushSides;
-	box_brush->contents = CONTENTS_BODY;
+	for ( t = 0 ; t < cm.numThreads ; t++ ) {
+		thread = &cm.threads[t];
 
-	box_model.leaf.numLeafBrushes = 1;
-//	box_model.leaf.firstLeafBrush = cm.numBrushes;
-	box_model.leaf.firstLeafBrush = cm.numLeafBrushes;
-	cm.leafbrushes[cm.numLeafBrushes] = cm.numBrushes;
+		thread->brushChecks = CM_Alloc( ( cm.numBrushes + BOX_BRUSHES * cm.numThreads ) * sizeof( int ) );
+		if ( cm.numSurfaces ) {
+			thread->surfaceChecks = CM_Alloc( cm.numSurfaces * sizeof( int ) );
+		}
 
-	for (i=0 ; i<6 ; i++)
-	{
-		side = i&1;
+		firstPlane = cm.numPlanes + t * BOX_PLANES;
+		firstSide = cm.numBrushSides + t * BOX_SIDES;
 
-		// brush sides
-		s = &cm.brushsides[cm.numBrushSides+i];
-		s->plane = 	cm.planes + (cm.numPlanes+i*2+side);
-		s->surfaceFlags = 0;
+		thread->boxPlanes = &cm.planes[firstPlane];
 
-		// planes
-		p = &box_planes[i*2];
-		p->type = i>>1;
-		p->signbits = 0;
-		VectorClear (p->normal);
-		p->normal[i>>1] = 1;
+		thread->boxBrush = &cm.brushes[cm.numBrushes + t];
+		thread->boxBrush->numsides = 6;
+		thread->boxBrush->sides = cm.brushsides + firstSide;
+		thread->boxBrush->contents = CONTENTS_BODY;
 
-		p = &box_planes[i*2+1];
-		p->type = 3 + (i>>1);
-		p->signbits = 0;
-		VectorClear (p->normal);
-		p->normal[i>>1] = -1;
+		thread->boxModel.leaf.numLeafBrushes = 1;
+		thread->boxModel.leaf.firstLeafBrush = cm.numLeafBrushes + t;
+		cm.leafbrushes[cm.numLeafBrushes + t] = cm.numBrushes + t;
 
-		SetPlaneSignbits( p );
-	}	
+		for (i=0 ; i<6 ; i++)
+		{
+			side = i&1;
+
+			// brush sides
+			s = &cm.brushsides[firstSide+i];
+			s->plane = 	cm.planes + (firstPlane+i*2+side);
+			s->surfaceFlags = 0;
+
+			// planes
+			p = &thread->boxPlanes[i*2];
+			p->type = i>>1;
+			p->signbits = 0;
+			VectorClear (p->normal);
+			p->normal[i>>1] = 1;
+
+			p = &thread->boxPlanes[i*2+1];
+			p->type = 3 + (i>>1);
+			p->signbits = 0;
+			VectorClear (p->normal);
+			p->normal[i>>1] = -1;
+
+			SetPlaneSignbits( p );
+		}
+	}
 }
 
 /*
@@ -796,12 +1621,15 @@ CM_TempBoxModel
 To keep everything totally uniform, bounding boxes are turned into small
 BSP trees instead of being compared directly.
 Capsules are handled differently though.
+The box belongs to the calling thread and is replaced by its next call.
 ===================
 */
 clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule ) {
+	cmThread_t	*thread = CM_ThreadState();
+	cplane_t	*box_planes = thread->boxPlanes;
 
-	VectorCopy( mins, box_model.mins );
-	VectorCopy( maxs, box_model.maxs );
+	VectorCopy( mins, thread->boxModel.mins );
+	VectorCopy( maxs, thread->boxModel.maxs );
 
 	if ( capsule ) {
 		return CAPSULE_MODEL_HANDLE;
@@ -820,12 +1648,38 @@ clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule
 	box_planes[10].dist = mins[2];
 	box_planes[11].dist = -mins[2];
 
-	VectorCopy( mins, box_brush->bounds[0] );
-	VectorCopy( maxs, box_brush->bounds[1] );
+	VectorCopy( mins, thread->boxBrush->bounds[0] );
+	VectorCopy( maxs, thread->boxBrush->bounds[1] );
 
 	return BOX_MODEL_HANDLE;
 }
 
+/*
+===================
+CM_TraceCounters
+
+Sums the trace statistics of all collision threads and clears them
+===================
+*/
+void CM_TraceCounters( int *traces, int *brushTraces, int *patchTraces, int *pointContents ) {
+	cmThread_t	*thread;
+	int			i;
+
+	*traces = *brushTraces = *patchTraces = *pointContents = 0;
+
+	for ( i = -1 ; i < cm.numThreads ; i++ ) {
+		thread = ( i < 0 ) ? &cm_noMapThread : &cm.threads[i];
+
+		*traces += thread->c_traces;
+		*brushTraces += thread->c_brush_traces;
+		*patchTraces += thread->c_patch_traces;
+		*pointContents += thread->c_pointcontents;
+
+		thread->c_traces = thread->c_brush_traces = thread->c_patch_traces = 0;
+		thread->c_pointcontents = 0;
+	}
+}
+
 /*
 ===================
 CM_ModelBounds
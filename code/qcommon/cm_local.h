@@ -45,6 +45,12 @@ typedef struct {
 	int			numLeafSurfaces;
 } cLeaf_t;
 
+// for points within bounds the leaf brushes don't have to be tested
+typedef struct {
+	vec3_t		bounds[2];
+	int			contents;		// -1 if the brushes split the bounds
+} cLeafContents_t;
+
 typedef struct cmodel_s {
 	vec3_t		mins, maxs;
 	cLeaf_t		leaf;			// submodels don't reference the main tree
@@ -62,12 +68,11 @@ typedef struct {
 	vec3_t		bounds[2];
 	int			numsides;
 	cbrushside_t	*sides;
-	int			checkcount;		// to avoid repeated testings
+	float		*packedPlanes;	// numsides rounded up to 4, as blocks of nx[4] ny[4] nz[4] dist[4]
 } cbrush_t;
 
 
 typedef struct {
-	int			checkcount;				// to avoid repeated testings
 	int			surfaceFlags;
 	int			contents;
 	struct patchCollide_s	*pc;
@@ -79,6 +84,22 @@ typedef struct {
 	int			floodvalid;
 } cArea_t;
 
+// Everything a trace writes to lives here, one per thread that may call
+// into the collision model, so traces can run concurrently.
+// Thread 0 is the main thread, the others are Com_RunParallel workers.
+typedef struct {
+	int			checkcount;			// incremented on each trace
+	int			*brushChecks;		// [numBrushes + box brushes] to avoid repeated testings
+	int			*surfaceChecks;		// [numSurfaces]
+
+	cmodel_t	boxModel;			// CM_TempBoxModel results
+	cplane_t	*boxPlanes;
+	cbrush_t	*boxBrush;
+
+	int			c_traces, c_brush_traces, c_patch_traces;
+	int			c_pointcontents;
+} cmThread_t;
+
 typedef struct {
 	char		name[MAX_QPATH];
 
@@ -96,6 +117,7 @@ typedef struct {
 
 	int			numLeafs;
 	cLeaf_t		*leafs;
+	cLeafContents_t	*leafContents;	// [numLeafs]
 
 	int			numLeafBrushes;
 	int			*leafbrushes;
@@ -120,12 +142,18 @@ typedef struct {
 	int			numAreas;
 	cArea_t		*areas;
 	int			*areaPortals;	// [ numAreas*numAreas ] reference counts
+	unsigned	*areaPortalBits;	// [ numAreas*areaPortalWords ] set where areaPortals is above 0
+	int			areaPortalWords;
+	int			*areaFloodStack;	// [ numAreas ] for CM_FloodArea
 
 	int			numSurfaces;
 	cPatch_t	**surfaces;			// non-patches will be NULL
 
 	int			floodvalid;
-	int			checkcount;					// incremented on each trace
+	int			lastFloodnum;	// floodnums are never reused within a map
+
+	int			numThreads;
+	cmThread_t	*threads;
 } clipMap_t;
 
 
@@ -133,12 +161,21 @@ typedef struct {
 // and to avoid various numeric issues
 #define	SURFACE_CLIP_EPSILON	(0.125)
 
+// uniform leaf contents hold this far inside the leaf bounds, so brushes
+// that only touch the bounds don't split them
+#define	LEAF_CONTENTS_EPSILON	(0.03125)
+
+// brush sides are tested this many at a time against the packed planes
+#define	PACKED_PLANE_LANES		4
+#define	PACKED_PLANE_BLOCK		( PACKED_PLANE_LANES * 4 )
+
 extern	clipMap_t	cm;
-extern	int			c_pointcontents;
-extern	int			c_traces, c_brush_traces, c_patch_traces;
 extern	cvar_t		*cm_noAreas;
 extern	cvar_t		*cm_noCurves;
 extern	cvar_t		*cm_playerCurveClip;
+extern	cvar_t		*cm_simdBrushes;
+
+void *CM_Alloc( int size );
 
 // cm_test.c
 
@@ -164,6 +201,7 @@ typedef struct {
 	qboolean	isPoint;	// optimized case
 	trace_t		trace;		// returned from trace call
 	sphere_t	sphere;		// sphere for oriendted capsule collision
+	cmThread_t	*thread;	// collision state of the tracing thread
 } traceWork_t;
 
 typedef struct leafList_s {
@@ -174,6 +212,7 @@ typedef struct leafList_s {
 	vec3_t	bounds[2];
 	int		lastLeaf;		// for overflows where each leaf can't be stored individually
 	void	(*storeLeafs)( struct leafList_s *ll, int nodenum );
+	cmThread_t	*thread;
 } leafList_t;
 
 
@@ -185,6 +224,7 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum );
 void CM_BoxLeafnums_r( leafList_t *ll, int nodenum );
 
 cmodel_t	*CM_ClipHandleToModel( clipHandle_t handle );
+cmThread_t	*CM_ThreadState( void );
 qboolean CM_BoundsIntersect( const vec3_t mins, const vec3_t maxs, const vec3_t mins2, const vec3_t maxs2 );
 qboolean CM_BoundsIntersectPoint( const vec3_t mins, const vec3_t maxs, const vec3_t point );
 
@@ -420,6 +420,13 @@ static	patchPlane_t	planes[MAX_PATCH_PLANES];
 static	int				numFacets;
 static	facet_t			facets[MAX_FACETS];
 
+static	int				numFacetNodes;
+static	facetNode_t		facetNodes[MAX_FACETS * 2];
+static	vec3_t			facetBounds[MAX_FACETS][2];
+
+// a facet with no axial plane on a side is open on that side
+#define	FACET_UNBOUNDED	1.0e30f
+
 #define	NORMAL_EPSILON	0.0001
 #define	DIST_EPSILON	0.02
 
@@ -993,6 +1000,111 @@ void CM_AddFacetBevels( facet_t *facet ) {
 
 }
 
+/*
+==================
+CM_FacetBounds
+
+Bounds of the region a facet clips against, taken from the axial planes
+among its surface and border planes.  The trace code expands all of them
+by the box size, so a trace that misses these bounds by more than the
+clip epsilon is in front of one of them and can't touch the facet.
+==================
+*/
+static void CM_FacetBounds( const patchCollide_t *pf, const facet_t *facet, vec3_t bounds[2] ) {
+	float	plane[4];
+	int		i, axis;
+
+	VectorSet( bounds[0], -FACET_UNBOUNDED, -FACET_UNBOUNDED, -FACET_UNBOUNDED );
+	VectorSet( bounds[1], FACET_UNBOUNDED, FACET_UNBOUNDED, FACET_UNBOUNDED );
+
+	for ( i = -1 ; i < facet->numBorders ; i++ ) {
+		if ( i < 0 ) {
+			Vector4Copy( pf->planes[ facet->surfacePlane ].plane, plane );
+		} else {
+			Vector4Copy( pf->planes[ facet->borderPlanes[i] ].plane, plane );
+			if ( facet->borderInward[i] ) {
+				VectorNegate( plane, plane );
+				plane[3] = -plane[3];
+			}
+		}
+
+		for ( axis = 0 ; axis < 3 ; axis++ ) {
+			if ( plane[(axis+1)%3] != 0 || plane[(axis+2)%3] != 0 ) {
+				continue;
+			}
+			if ( plane[axis] == 1 && plane[3] < bounds[1][axis] ) {
+				bounds[1][axis] = plane[3];
+			} else if ( plane[axis] == -1 && -plane[3] > bounds[0][axis] ) {
+				bounds[0][axis] = -plane[3];
+			}
+		}
+	}
+}
+
+/*
+==================
+CM_BuildFacetNodes
+
+Splits a range of facets in half until the leaves are small.  Facets
+are generated row by row across the grid, so neighbouring indices are
+neighbours on the surface and the halves stay spatially tight.
+==================
+*/
+static int CM_BuildFacetNodes( int firstFacet, int count, int depth ) {
+	facetNode_t	*node;
+	int			i, nodeNum, half;
+
+	nodeNum = numFacetNodes++;
+	node = &facetNodes[nodeNum];
+	node->firstFacet = firstFacet;
+	node->numFacets = count;
+	node->secondChild = 0;
+
+	ClearBounds( node->bounds[0], node->bounds[1] );
+	for ( i = firstFacet ; i < firstFacet + count ; i++ ) {
+		AddPointToBounds( facetBounds[i][0], node->bounds[0], node->bounds[1] );
+		AddPointToBounds( facetBounds[i][1], node->bounds[0], node->bounds[1] );
+	}
+
+	// expand by one unit for epsilon purposes
+	for ( i = 0 ; i < 3 ; i++ ) {
+		node->bounds[0][i] -= 1;
+		node->bounds[1][i] += 1;
+	}
+
+	if ( count <= MAX_FACET_LEAF || depth == MAX_FACET_DEPTH - 1 ) {
+		return nodeNum;
+	}
+
+	half = count / 2;
+	CM_BuildFacetNodes( firstFacet, half, depth + 1 );
+	facetNodes[nodeNum].secondChild = CM_BuildFacetNodes( firstFacet + half, count - half, depth + 1 );
+
+	return nodeNum;
+}
+
+/*
+==================
+CM_BuildFacetTree
+
+Also used to rebuild the tree for patches loaded from the collision cache.
+==================
+*/
+void CM_BuildFacetTree( patchCollide_t *pf ) {
+	int		i;
+
+	for ( i = 0 ; i < pf->numFacets ; i++ ) {
+		CM_FacetBounds( pf, &pf->facets[i], facetBounds[i] );
+	}
+
+	numFacetNodes = 0;
+	CM_BuildFacetNodes( 0, pf->numFacets, 0 );
+
+	pf->numNodes = numFacetNodes;
+	pf->nodes = CM_Alloc( numFacetNodes * sizeof( *pf->nodes ) );
+	Com_Memcpy( pf->nodes, facetNodes, numFacetNodes * sizeof( *pf->nodes ) );
+}
+
 typedef enum {
 	EN_TOP,
 	EN_RIGHT,
@@ -1156,10 +1268,12 @@ static void CM_PatchCollideFromGrid( cGrid_t *grid, patchCollide_t *pf ) {
 	// copy the results out
 	pf->numPlanes = numPlanes;
 	pf->numFacets = numFacets;
-	pf->facets = Hunk_Alloc( numFacets * sizeof( *pf->facets ), h_high );
+	pf->facets = CM_Alloc( numFacets * sizeof( *pf->facets ) );
 	Com_Memcpy( pf->facets, facets, numFacets * sizeof( *pf->facets ) );
-	pf->planes = Hunk_Alloc( numPlanes * sizeof( *pf->planes ), h_high );
+	pf->planes = CM_Alloc( numPlanes * sizeof( *pf->planes ) );
 	Com_Memcpy( pf->planes, planes, numPlanes * sizeof( *pf->planes ) );
+
+	CM_BuildFacetTree( pf );
 }
 
 
@@ -1216,7 +1330,7 @@ struct patchCollide_s	*CM_GeneratePatchCollide( int width, int height, vec3_t *p
 	// we now have a grid of points exactly on the curve
 	// the approximate surface defined by these points will be
 	// collided against
-	pf = Hunk_Alloc( sizeof( *pf ), h_high );
+	pf = CM_Alloc( sizeof( *pf ) );
 	ClearBounds( pf->bounds[0], pf->bounds[1] );
 	for ( i = 0 ; i < grid.width ; i++ ) {
 		for ( j = 0 ; j < grid.height ; j++ ) {
@@ -1325,12 +1439,15 @@ void CM_TracePointThroughPatchCollide( traceWork_t *tw, const struct patchCollid
 		if ( j == facet->numBorders ) {
 			// we hit this facet
 #ifndef BSPC
-			if (!cv) {
-				cv = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
-			}
-			if (cv->integer) {
-				debugPatchCollide = pc;
-				debugFacet = facet;
+			// only the main thread may touch cvars and the debug surface
+			if ( tw->thread == cm.threads ) {
+				if (!cv) {
+					cv = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
+				}
+				if (cv->integer) {
+					debugPatchCollide = pc;
+					debugFacet = facet;
+				}
 			}
 #endif //BSPC
 			planes = &pc->planes[facet->surfacePlane];
@@ -1399,39 +1516,64 @@ int CM_CheckFacetPlane(float *plane, vec3_t start, vec3_t end, float *enterFrac,
 
 /*
 ====================
-CM_TraceThroughPatchCollide
+CM_TraceThroughFacet
 ====================
 */
-void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *pc ) {
-	int i, j, hit, hitnum;
+static void CM_TraceThroughFacet( traceWork_t *tw, const struct patchCollide_s *pc, const facet_t *facet ) {
+	int j, hit, hitnum;
 	float offset, enterFrac, leaveFrac, t;
-	patchPlane_t *planes;
-	facet_t	*facet;
+	const patchPlane_t *planes;
 	float plane[4] = {0, 0, 0, 0}, bestplane[4] = {0, 0, 0, 0};
 	vec3_t startp, endp;
 #ifndef BSPC
 	static cvar_t *cv;
 #endif //BSPC
 
-	if ( !CM_BoundsIntersect( tw->bounds[0], tw->bounds[1],
-				pc->bounds[0], pc->bounds[1] ) ) {
-		return;
+	enterFrac = -1.0;
+	leaveFrac = 1.0;
+	hitnum = -1;
+	planes = &pc->planes[ facet->surfacePlane ];
+	VectorCopy(planes->plane, plane);
+	plane[3] = planes->plane[3];
+	if ( tw->sphere.use ) {
+		// adjust the plane distance appropriately for radius
+		plane[3] += tw->sphere.radius;
+
+		// find the closest point on the capsule to the plane
+		t = DotProduct( plane, tw->sphere.offset );
+		if ( t > 0.0f ) {
+			VectorSubtract( tw->start, tw->sphere.offset, startp );
+			VectorSubtract( tw->end, tw->sphere.offset, endp );
+		}
+		else {
+			VectorAdd( tw->start, tw->sphere.offset, startp );
+			VectorAdd( tw->end, tw->sphere.offset, endp );
+		}
+	}
+	else {
+		offset = DotProduct( tw->offsets[ planes->signbits ], plane);
+		plane[3] -= offset;
+		VectorCopy( tw->start, startp );
+		VectorCopy( tw->end, endp );
 	}
 
-	if (tw->isPoint) {
-		CM_TracePointThroughPatchCollide( tw, pc );
+	if (!CM_CheckFacetPlane(plane, startp, endp, &enterFrac, &leaveFrac, &hit)) {
 		return;
 	}
+	if (hit) {
+		Vector4Copy(plane, bestplane);
+	}
 
-	facet = pc->facets;
-	for ( i = 0 ; i < pc->numFacets ; i++, facet++ ) {
-		enterFrac = -1.0;
-		leaveFrac = 1.0;
-		hitnum = -1;
-		//
-		planes = &pc->planes[ facet->surfacePlane ];
-		VectorCopy(planes->plane, plane);
-		plane[3] = planes->plane[3];
+	for ( j = 0; j < facet->numBorders; j++ ) {
+		planes = &pc->planes[ facet->borderPlanes[j] ];
+		if (facet->borderInward[j]) {
+			VectorNegate(planes->plane, plane);
+			plane[3] = -planes->plane[3];
+		}
+		else {
+			VectorCopy(planes->plane, plane);
+			plane[3] = planes->plane[3];
+		}
 		if ( tw->sphere.use ) {
 			// adjust the plane distance appropriately for radius
 			plane[3] += tw->sphere.radius;
@@ -1448,70 +1590,32 @@ void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *
 			}
 		}
 		else {
+			// NOTE: this works even though the plane might be flipped because the bbox is centered
 			offset = DotProduct( tw->offsets[ planes->signbits ], plane);
-			plane[3] -= offset;
+			plane[3] += fabs(offset);
 			VectorCopy( tw->start, startp );
 			VectorCopy( tw->end, endp );
 		}
 
 		if (!CM_CheckFacetPlane(plane, startp, endp, &enterFrac, &leaveFrac, &hit)) {
-			continue;
+			break;
 		}
 		if (hit) {
+			hitnum = j;
 			Vector4Copy(plane, bestplane);
 		}
-
-		for ( j = 0; j < facet->numBorders; j++ ) {
-			planes = &pc->planes[ facet->borderPlanes[j] ];
-			if (facet->borderInward[j]) {
-				VectorNegate(planes->plane, plane);
-				plane[3] = -planes->plane[3];
-			}
-			else {
-				VectorCopy(planes->plane, plane);
-				plane[3] = planes->plane[3];
-			}
-			if ( tw->sphere.use ) {
-				// adjust the plane distance appropriately for radius
-				plane[3] += tw->sphere.radius;
-
-				// find the closest point on the capsule to the plane
-				t = DotProduct( plane, tw->sphere.offset );
-				if ( t > 0.0f ) {
-					VectorSubtract( tw->start, tw->sphere.offset, startp );
-					VectorSubtract( tw->end, tw->sphere.offset, endp );
-				}
-				else {
-					VectorAdd( tw->start, tw->sphere.offset, startp );
-					VectorAdd( tw->end, tw->sphere.offset, endp );
-				}
-			}
-			else {
-				// NOTE: this works even though the plane might be flipped because the bbox is centered
-				offset = DotProduct( tw->offsets[ planes->signbits ], plane);
-				plane[3] += fabs(offset);
-				VectorCopy( tw->start, startp );
-				VectorCopy( tw->end, endp );
-			}
-
-			if (!CM_CheckFacetPlane(plane, startp, endp, &enterFrac, &leaveFrac, &hit)) {
-				break;
-			}
-			if (hit) {
-				hitnum = j;
-				Vector4Copy(plane, bestplane);
+	}
+	if (j < facet->numBorders) return;
+	//never clip against the back side
+	if (hitnum == facet->numBorders - 1) return;
+
+	if (enterFrac < leaveFrac && enterFrac >= 0) {
+		if (enterFrac < tw->trace.fraction) {
+			if (enterFrac < 0) {
+				enterFrac = 0;
 			}
-		}
-		if (j < facet->numBorders) continue;
-		//never clip against the back side
-		if (hitnum == facet->numBorders - 1) continue;
-
-		if (enterFrac < leaveFrac && enterFrac >= 0) {
-			if (enterFrac < tw->trace.fraction) {
-				if (enterFrac < 0) {
-					enterFrac = 0;
-				}
 #ifndef BSPC
+			if ( tw->thread == cm.threads ) {
 				if (!cv) {
 					cv = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
 				}
@@ -1519,13 +1623,55 @@ void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *
 					debugPatchCollide = pc;
 					debugFacet = facet;
 				}
+			}
 #endif //BSPC
 
-				tw->trace.fraction = enterFrac;
-				VectorCopy( bestplane, tw->trace.plane.normal );
-				tw->trace.plane.dist = bestplane[3];
+			tw->trace.fraction = enterFrac;
+			VectorCopy( bestplane, tw->trace.plane.normal );
+			tw->trace.plane.dist = bestplane[3];
+		}
+	}
+}
+
+/*
+====================
+CM_TraceThroughPatchCollide
+====================
+*/
+void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *pc ) {
+	int i, sp;
+	int stack[MAX_FACET_DEPTH];
+	const facetNode_t *node;
+
+	if ( !CM_BoundsIntersect( tw->bounds[0], tw->bounds[1],
+				pc->bounds[0], pc->bounds[1] ) ) {
+		return;
+	}
+
+	if (tw->isPoint) {
+		CM_TracePointThroughPatchCollide( tw, pc );
+		return;
+	}
+
+	// walk the facet tree first child first, so overlapping facets are
+	// still clipped against in their original order
+	sp = 0;
+	node = pc->nodes;
+	while ( 1 ) {
+		if ( CM_BoundsIntersect( tw->bounds[0], tw->bounds[1], node->bounds[0], node->bounds[1] ) ) {
+			if ( node->secondChild ) {
+				stack[sp++] = node->secondChild;
+				node++;
+				continue;
+			}
+			for ( i = 0 ; i < node->numFacets ; i++ ) {
+				CM_TraceThroughFacet( tw, pc, &pc->facets[node->firstFacet + i] );
 			}
 		}
+		if ( !sp ) {
+			break;
+		}
+		node = &pc->nodes[stack[--sp]];
 	}
 }
 
@@ -1540,33 +1686,59 @@ POSITION TEST
 
 /*
 ====================
-CM_PositionTestInPatchCollide
+CM_PositionTestInFacet
 ====================
 */
-qboolean CM_PositionTestInPatchCollide( traceWork_t *tw, const struct patchCollide_s *pc ) {
-	int i, j;
+static qboolean CM_PositionTestInFacet( traceWork_t *tw, const struct patchCollide_s *pc, const facet_t *facet ) {
+	int j;
 	float offset, t;
-	patchPlane_t *planes;
-	facet_t	*facet;
+	const patchPlane_t *planes;
 	float plane[4];
 	vec3_t startp;
 
-	if (tw->isPoint) {
+	planes = &pc->planes[ facet->surfacePlane ];
+	VectorCopy(planes->plane, plane);
+	plane[3] = planes->plane[3];
+	if ( tw->sphere.use ) {
+		// adjust the plane distance appropriately for radius
+		plane[3] += tw->sphere.radius;
+
+		// find the closest point on the capsule to the plane
+		t = DotProduct( plane, tw->sphere.offset );
+		if ( t > 0 ) {
+			VectorSubtract( tw->start, tw->sphere.offset, startp );
+		}
+		else {
+			VectorAdd( tw->start, tw->sphere.offset, startp );
+		}
+	}
+	else {
+		offset = DotProduct( tw->offsets[ planes->signbits ], plane);
+		plane[3] -= offset;
+		VectorCopy( tw->start, startp );
+	}
+
+	if ( DotProduct( plane, startp ) - plane[3] > 0.0f ) {
 		return qfalse;
 	}
-	//
-	facet = pc->facets;
-	for ( i = 0 ; i < pc->numFacets ; i++, facet++ ) {
-		planes = &pc->planes[ facet->surfacePlane ];
-		VectorCopy(planes->plane, plane);
-		plane[3] = planes->plane[3];
+
+	for ( j = 0; j < facet->numBorders; j++ ) {
+		planes = &pc->planes[ facet->borderPlanes[j] ];
+		if (facet->borderInward[j]) {
+			VectorNegate(planes->plane, plane);
+			plane[3] = -planes->plane[3];
+		}
+		else {
+			VectorCopy(planes->plane, plane);
+			plane[3] = planes->plane[3];
+		}
 		if ( tw->sphere.use ) {
 			// adjust the plane distance appropriately for radius
 			plane[3] += tw->sphere.radius;
 
 			// find the closest point on the capsule to the plane
 			t = DotProduct( plane, tw->sphere.offset );
-			if ( t > 0 ) {
+			if ( t > 0.0f ) {
 				VectorSubtract( tw->start, tw->sphere.offset, startp );
 			}
 			else {
@@ -1574,54 +1746,56 @@ qboolean CM_PositionTestInPatchCollide( traceWork_t *tw, const struct patchColli
 			}
 		}
 		else {
+			// NOTE: this works even though the plane might be flipped because the bbox is centered
 			offset = DotProduct( tw->offsets[ planes->signbits ], plane);
-			plane[3] -= offset;
+			plane[3] += fabs(offset);
 			VectorCopy( tw->start, startp );
 		}
 
 		if ( DotProduct( plane, startp ) - plane[3] > 0.0f ) {
-			continue;
+			break;
 		}
+	}
+	if (j < facet->numBorders) {
+		return qfalse;
+	}
+	// inside this patch facet
+	return qtrue;
+}
 
-		for ( j = 0; j < facet->numBorders; j++ ) {
-			planes = &pc->planes[ facet->borderPlanes[j] ];
-			if (facet->borderInward[j]) {
-				VectorNegate(planes->plane, plane);
-				plane[3] = -planes->plane[3];
-			}
-			else {
-				VectorCopy(planes->plane, plane);
-				plane[3] = planes->plane[3];
+/*
+====================
+CM_PositionTestInPatchCollide
+====================
+*/
+qboolean CM_PositionTestInPatchCollide( traceWork_t *tw, const struct patchCollide_s *pc ) {
+	int i, sp;
+	int stack[MAX_FACET_DEPTH];
+	const facetNode_t *node;
+
+	if (tw->isPoint) {
+		return qfalse;
+	}
+
+	sp = 0;
+	node = pc->nodes;
+	while ( 1 ) {
+		if ( CM_BoundsIntersect( tw->bounds[0], tw->bounds[1], node->bounds[0], node->bounds[1] ) ) {
+			if ( node->secondChild ) {
+				stack[sp++] = node->secondChild;
+				node++;
+				continue;
 			}
-			if ( tw->sphere.use ) {
-				// adjust the plane distance appropriately for radius
-				plane[3] += tw->sphere.radius;
-
-				// find the closest point on the capsule to the plane
-				t = DotProduct( plane, tw->sphere.offset );
-				if ( t > 0.0f ) {
-					VectorSubtract( tw->start, tw->sphere.offset, startp );
+			for ( i = 0 ; i < node->numFacets ; i++ ) {
+				if ( CM_PositionTestInFacet( tw, pc, &pc->facets[node->firstFacet + i] ) ) {
+					return qtrue;
 				}
-				else {
-					VectorAdd( tw->start, tw->sphere.offset, startp );
-				}
-			}
-			else {
-				// NOTE: this works even though the plane might be flipped because the bbox is centered
-				offset = DotProduct( tw->offsets[ planes->signbits ], plane);
-				plane[3] += fabs(offset);
-				VectorCopy( tw->start, startp );
-			}
-
-			if ( DotProduct( plane, startp ) - plane[3] > 0.0f ) {
-				break;
 			}
 		}
-		if (j < facet->numBorders) {
-			continue;
+		if ( !sp ) {
+			break;
 		}
-		// inside this patch facet
-		return qtrue;
+		node = &pc->nodes[stack[--sp]];
 	}
 	return qfalse;
 }
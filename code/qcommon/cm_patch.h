@@ -76,12 +76,26 @@ typedef struct {
 	qboolean	borderNoAdjust[4+6+16];
 } facet_t;
 
+// bounding volume hierarchy over a contiguous range of facets, children
+// keep the facet order so traversal visits facets in the original order
+#define	MAX_FACET_LEAF		4
+#define	MAX_FACET_DEPTH		32
+
+typedef struct {
+	vec3_t		bounds[2];
+	int			firstFacet;
+	int			numFacets;
+	int			secondChild;	// the first child directly follows its parent, 0 for a leaf
+} facetNode_t;
+
 typedef struct patchCollide_s {
 	vec3_t	bounds[2];
 	int		numPlanes;			// surface planes plus edge planes
 	patchPlane_t	*planes;
 	int		numFacets;
 	facet_t	*facets;
+	int		numNodes;
+	facetNode_t	*nodes;
 } patchCollide_t;
 
 
@@ -101,3 +115,4 @@ typedef struct {
 
 
 struct patchCollide_s	*CM_GeneratePatchCollide( int width, int height, vec3_t *points );
+void CM_BuildFacetTree( patchCollide_t *pf );
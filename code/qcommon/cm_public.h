@@ -46,6 +46,9 @@ void		CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 						  clipHandle_t model, int brushmask,
 						  const vec3_t origin, const vec3_t angles, int capsule );
 
+// collision queries may run on the main thread and on Com_RunParallel workers
+void		CM_TraceCounters( int *traces, int *brushTraces, int *patchTraces, int *pointContents );
+
 byte		*CM_ClusterPVS (int cluster);
 
 int			CM_PointLeafnum( const vec3_t p );
@@ -48,7 +48,7 @@ int CM_PointLeafnum_r( const vec3_t p, int num ) {
 			num = node->children[0];
 	}
 
-	c_pointcontents++;		// optimize counter
+	CM_ThreadState()->c_pointcontents++;		// optimize counter
 
 	return -1 - num;
 }
@@ -101,10 +101,10 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum ) {
 	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( ll->thread->brushChecks[brushnum] == ll->thread->checkcount ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		ll->thread->brushChecks[brushnum] = ll->thread->checkcount;
 		for ( i = 0 ; i < 3 ; i++ ) {
 			if ( b->bounds[0][i] >= ll->bounds[1][i] || b->bounds[1][i] <= ll->bounds[0][i] ) {
 				break;
@@ -172,7 +172,8 @@ CM_BoxLeafnums
 int	CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *list, int listsize, int *lastLeaf) {
 	leafList_t	ll;
 
-	cm.checkcount++;
+	ll.thread = CM_ThreadState();
+	ll.thread->checkcount++;
 
 	VectorCopy( mins, ll.bounds[0] );
 	VectorCopy( maxs, ll.bounds[1] );
@@ -197,7 +198,8 @@ CM_BoxBrushes
 int CM_BoxBrushes( const vec3_t mins, const vec3_t maxs, cbrush_t **list, int listsize ) {
 	leafList_t	ll;
 
-	cm.checkcount++;
+	ll.thread = CM_ThreadState();
+	ll.thread->checkcount++;
 
 	VectorCopy( mins, ll.bounds[0] );
 	VectorCopy( maxs, ll.bounds[1] );
@@ -228,6 +230,7 @@ int CM_PointContents( const vec3_t p, clipHandle_t model ) {
 	int			i, k;
 	int			brushnum;
 	cLeaf_t		*leaf;
+	cLeafContents_t	*uniform;
 	cbrush_t	*b;
 	int			contents;
 	float		d;
@@ -243,6 +246,15 @@ int CM_PointContents( const vec3_t p, clipHandle_t model ) {
 	} else {
 		leafnum = CM_PointLeafnum_r (p, 0);
 		leaf = &cm.leafs[leafnum];
+
+		// every brush of the leaf has all of the bounds in or out
+		uniform = &cm.leafContents[leafnum];
+		if ( uniform->contents != -1
+			&& p[0] >= uniform->bounds[0][0] && p[0] <= uniform->bounds[1][0]
+			&& p[1] >= uniform->bounds[0][1] && p[1] <= uniform->bounds[1][1]
+			&& p[2] >= uniform->bounds[0][2] && p[2] <= uniform->bounds[1][2] ) {
+			return uniform->contents;
+		}
 	}
 
 	contents = 0;
@@ -328,28 +340,54 @@ byte	*CM_ClusterPVS (int cluster) {
 
 AREAPORTALS
 
+Areas that are connected through open portals share a floodnum. The
+whole map is only flooded when it is loaded: a portal that opens joins
+two floods by renumbering one of them, and one that closes refloods the
+areas it joined, which either all stay connected or split in two.
+cm.areaPortalBits has the portals that are open a word at a time.
 ===============================================================================
 */
 
-void CM_FloodArea_r( int areaNum, int floodnum) {
-	int		i;
-	cArea_t *area;
-	int		*con;
+/*
+====================
+CM_FloodArea
 
-	area = &cm.areas[ areaNum ];
+Gives floodnum to every area connected to areaNum, marking them with the
+current cm.floodvalid
+====================
+*/
+static void CM_FloodArea( int areaNum, int floodnum ) {
+	cArea_t		*area;
+	unsigned	*row, bits;
+	int			*stack, depth;
+	int			i, w;
 
-	if ( area->floodvalid == cm.floodvalid ) {
-		if (area->floodnum == floodnum)
-			return;
-		Com_Error (ERR_DROP, "FloodArea_r: reflooded");
-	}
+	stack = cm.areaFloodStack;
+	depth = 0;
 
+	area = &cm.areas[ areaNum ];
 	area->floodnum = floodnum;
 	area->floodvalid = cm.floodvalid;
-	con = cm.areaPortals + areaNum * cm.numAreas;
-	for ( i=0 ; i < cm.numAreas  ; i++ ) {
-		if ( con[i] > 0 ) {
-			CM_FloodArea_r( i, floodnum );
+	stack[depth++] = areaNum;
+
+	// every area goes on the stack once, when it is marked
+	while ( depth ) {
+		areaNum = stack[--depth];
+		row = cm.areaPortalBits + areaNum * cm.areaPortalWords;
+
+		for ( w = 0 ; w < cm.areaPortalWords ; w++ ) {
+			for ( bits = row[w], i = w << 5 ; bits ; bits >>= 1, i++ ) {
+				if ( !( bits & 1 ) ) {
+					continue;
+				}
+				area = &cm.areas[ i ];
+				if ( area->floodvalid == cm.floodvalid ) {
+					continue;
+				}
+				area->floodnum = floodnum;
+				area->floodvalid = cm.floodvalid;
+				stack[depth++] = i;
+			}
 		}
 	}
 }
@@ -363,23 +401,37 @@ CM_FloodAreaConnections
 void	CM_FloodAreaConnections( void ) {
 	int		i;
 	cArea_t	*area;
-	int		floodnum;
 
 	// all current floods are now invalid
 	cm.floodvalid++;
-	floodnum = 0;
+	cm.lastFloodnum = 0;
 
 	for (i = 0 ; i < cm.numAreas ; i++) {
 		area = &cm.areas[i];
 		if (area->floodvalid == cm.floodvalid) {
 			continue;		// already flooded into
 		}
-		floodnum++;
-		CM_FloodArea_r (i, floodnum);
+		CM_FloodArea( i, ++cm.lastFloodnum );
 	}
 
 }
 
+/*
+====================
+CM_SetAreaPortalBit
+====================
+*/
+static void CM_SetAreaPortalBit( int area1, int area2, qboolean open ) {
+	unsigned	*word;
+
+	word = cm.areaPortalBits + area1 * cm.areaPortalWords + ( area2 >> 5 );
+	if ( open ) {
+		*word |= 1u << ( area2 & 31 );
+	} else {
+		*word &= ~( 1u << ( area2 & 31 ) );
+	}
+}
+
 /*
 ====================
 CM_AdjustAreaPortalState
@@ -387,6 +439,8 @@ CM_AdjustAreaPortalState
 ====================
 */
 void	CM_AdjustAreaPortalState( int area1, int area2, qboolean open ) {
+	int		i, count, from, to;
+
 	if ( area1 < 0 || area2 < 0 ) {
 		return;
 	}
@@ -406,7 +460,39 @@ void	CM_AdjustAreaPortalState( int area1, int area2, qboolean open ) {
 		}
 	}
 
-	CM_FloodAreaConnections ();
+	count = cm.areaPortals[ area1 * cm.numAreas + area2 ];
+
+	// only a portal that just opened or closed changes the floods,
+	// one inside an area never does
+	if ( area1 == area2 ) {
+		CM_SetAreaPortalBit( area1, area2, count > 0 );
+		return;
+	}
+	if ( open ? count != 1 : count != 0 ) {
+		return;
+	}
+
+	CM_SetAreaPortalBit( area1, area2, open );
+	CM_SetAreaPortalBit( area2, area1, open );
+
+	if ( open ) {
+		from = cm.areas[ area2 ].floodnum;
+		to = cm.areas[ area1 ].floodnum;
+		if ( from == to ) {
+			return;
+		}
+		for ( i = 0 ; i < cm.numAreas ; i++ ) {
+			if ( cm.areas[ i ].floodnum == from ) {
+				cm.areas[ i ].floodnum = to;
+			}
+		}
+		return;
+	}
+
+	// if area2 isn't reached it keeps the old floodnum with whatever is
+	// still connected to it
+	cm.floodvalid++;
+	CM_FloodArea( area1, ++cm.lastFloodnum );
 }
 
 /*
@@ -21,6 +21,21 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 #include "cm_local.h"
 
+// BSPC has no cvars, so it always takes the scalar path
+#ifndef BSPC
+#if defined( __SSE__ ) || idx64
+#include <xmmintrin.h>
+#define USE_SSE_BRUSHES
+#elif defined( __aarch64__ )
+#include <arm_neon.h>
+#define USE_NEON_BRUSHES
+#endif
+#endif
+
+#if defined( USE_SSE_BRUSHES ) || defined( USE_NEON_BRUSHES )
+#define USE_SIMD_BRUSHES
+#endif
+
 // always use bbox vs. bbox collision and never capsule vs. bbox or vice versa
 //#define ALWAYS_BBOX_VS_BBOX
 // always use capsule vs. capsule collision and never capsule vs. bbox or vice versa
@@ -145,6 +160,82 @@ float SquareRootFloat(float number) {
 }
 
 
+#ifdef USE_SIMD_BRUSHES
+/*
+================
+CM_PackedPlaneDistances
+
+Distances from the trace start and end to one block of packed brush
+planes, each plane pushed out by the box corner selected by the sign
+of its normal.  The products are summed in the same order as the
+scalar DotProduct code so the results are bit for bit identical.
+d2 may be NULL when only the start point is needed.
+================
+*/
+static ID_INLINE void CM_PackedPlaneDistances( const traceWork_t *tw, const float *block, float *d1, float *d2 ) {
+#if defined( USE_SSE_BRUSHES )
+	__m128	nx, ny, nz, zero, neg, o, dist, d;
+
+	nx = _mm_loadu_ps( block );
+	ny = _mm_loadu_ps( block + PACKED_PLANE_LANES );
+	nz = _mm_loadu_ps( block + PACKED_PLANE_LANES * 2 );
+	zero = _mm_setzero_ps();
+
+	// offsets[signbits] picks size[1] on the axes where the normal is negative
+	neg = _mm_cmplt_ps( nx, zero );
+	o = _mm_or_ps( _mm_and_ps( neg, _mm_set1_ps( tw->size[1][0] ) ), _mm_andnot_ps( neg, _mm_set1_ps( tw->size[0][0] ) ) );
+	d = _mm_mul_ps( o, nx );
+	neg = _mm_cmplt_ps( ny, zero );
+	o = _mm_or_ps( _mm_and_ps( neg, _mm_set1_ps( tw->size[1][1] ) ), _mm_andnot_ps( neg, _mm_set1_ps( tw->size[0][1] ) ) );
+	d = _mm_add_ps( d, _mm_mul_ps( o, ny ) );
+	neg = _mm_cmplt_ps( nz, zero );
+	o = _mm_or_ps( _mm_and_ps( neg, _mm_set1_ps( tw->size[1][2] ) ), _mm_andnot_ps( neg, _mm_set1_ps( tw->size[0][2] ) ) );
+	d = _mm_add_ps( d, _mm_mul_ps( o, nz ) );
+	dist = _mm_sub_ps( _mm_loadu_ps( block + PACKED_PLANE_LANES * 3 ), d );
+
+	d = _mm_mul_ps( _mm_set1_ps( tw->start[0] ), nx );
+	d = _mm_add_ps( d, _mm_mul_ps( _mm_set1_ps( tw->start[1] ), ny ) );
+	d = _mm_add_ps( d, _mm_mul_ps( _mm_set1_ps( tw->start[2] ), nz ) );
+	_mm_storeu_ps( d1, _mm_sub_ps( d, dist ) );
+
+	if ( d2 ) {
+		d = _mm_mul_ps( _mm_set1_ps( tw->end[0] ), nx );
+		d = _mm_add_ps( d, _mm_mul_ps( _mm_set1_ps( tw->end[1] ), ny ) );
+		d = _mm_add_ps( d, _mm_mul_ps( _mm_set1_ps( tw->end[2] ), nz ) );
+		_mm_storeu_ps( d2, _mm_sub_ps( d, dist ) );
+	}
+#else
+	float32x4_t	nx, ny, nz, zero, o, dist, d;
+
+	nx = vld1q_f32( block );
+	ny = vld1q_f32( block + PACKED_PLANE_LANES );
+	nz = vld1q_f32( block + PACKED_PLANE_LANES * 2 );
+	zero = vdupq_n_f32( 0 );
+
+	// offsets[signbits] picks size[1] on the axes where the normal is negative
+	o = vbslq_f32( vcltq_f32( nx, zero ), vdupq_n_f32( tw->size[1][0] ), vdupq_n_f32( tw->size[0][0] ) );
+	d = vmulq_f32( o, nx );
+	o = vbslq_f32( vcltq_f32( ny, zero ), vdupq_n_f32( tw->size[1][1] ), vdupq_n_f32( tw->size[0][1] ) );
+	d = vaddq_f32( d, vmulq_f32( o, ny ) );
+	o = vbslq_f32( vcltq_f32( nz, zero ), vdupq_n_f32( tw->size[1][2] ), vdupq_n_f32( tw->size[0][2] ) );
+	d = vaddq_f32( d, vmulq_f32( o, nz ) );
+	dist = vsubq_f32( vld1q_f32( block + PACKED_PLANE_LANES * 3 ), d );
+
+	d = vmulq_f32( vdupq_n_f32( tw->start[0] ), nx );
+	d = vaddq_f32( d, vmulq_f32( vdupq_n_f32( tw->start[1] ), ny ) );
+	d = vaddq_f32( d, vmulq_f32( vdupq_n_f32( tw->start[2] ), nz ) );
+	vst1q_f32( d1, vsubq_f32( d, dist ) );
+
+	if ( d2 ) {
+		d = vmulq_f32( vdupq_n_f32( tw->end[0] ), nx );
+		d = vaddq_f32( d, vmulq_f32( vdupq_n_f32( tw->end[1] ), ny ) );
+		d = vaddq_f32( d, vmulq_f32( vdupq_n_f32( tw->end[2] ), nz ) );
+		vst1q_f32( d2, vsubq_f32( d, dist ) );
+	}
+#endif
+}
+#endif
+
 /*
 ===============================================================================
 
@@ -207,6 +298,22 @@ void CM_TestBoxInBrush( traceWork_t *tw, cbrush_t *brush ) {
 				return;
 			}
 		}
+#ifdef USE_SIMD_BRUSHES
+	} else if ( brush->packedPlanes && cm_simdBrushes->integer ) {
+		float	ds[PACKED_PLANE_LANES];
+		int		j;
+
+		// the axial planes fill the first block and half of the second
+		for ( i = PACKED_PLANE_LANES ; i < brush->numsides ; i += PACKED_PLANE_LANES ) {
+			CM_PackedPlaneDistances( tw, brush->packedPlanes + ( i / PACKED_PLANE_LANES ) * PACKED_PLANE_BLOCK, ds, NULL );
+			for ( j = 0 ; j < PACKED_PLANE_LANES && i + j < brush->numsides ; j++ ) {
+				// if completely in front of face, no intersection
+				if ( i + j >= 6 && ds[j] > 0 ) {
+					return;
+				}
+			}
+		}
+#endif
 	} else {
 		// the first six planes are the axial planes, so we only
 		// need to test the remainder
@@ -241,7 +348,7 @@ CM_TestInLeaf
 */
 void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	int			k;
-	int			brushnum;
+	int			brushnum, surfnum;
 	cbrush_t	*b;
 	cPatch_t	*patch;
 
@@ -249,10 +356,10 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	for (k=0 ; k<leaf->numLeafBrushes ; k++) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 		b = &cm.brushes[brushnum];
-		if (b->checkcount == cm.checkcount) {
+		if ( tw->thread->brushChecks[brushnum] == tw->thread->checkcount ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		tw->thread->brushChecks[brushnum] = tw->thread->checkcount;
 
 		if ( !(b->contents & tw->contents)) {
 			continue;
@@ -271,14 +378,15 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	if ( !cm_noCurves->integer ) {
 #endif //BSPC
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			surfnum = cm.leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = cm.surfaces[ surfnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( tw->thread->surfaceChecks[surfnum] == tw->thread->checkcount ) {
 				continue;	// already checked this brush in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			tw->thread->surfaceChecks[surfnum] = tw->thread->checkcount;
 
 			if ( !(patch->contents & tw->contents)) {
 				continue;
@@ -427,13 +535,14 @@ void CM_PositionTest( traceWork_t *tw ) {
 	ll.storeLeafs = CM_StoreLeafs;
 	ll.lastLeaf = 0;
 	ll.overflowed = qfalse;
+	ll.thread = tw->thread;
 
-	cm.checkcount++;
+	tw->thread->checkcount++;
 
 	CM_BoxLeafnums_r( &ll, 0 );
 
 
-	cm.checkcount++;
+	tw->thread->checkcount++;
 
 	// test the contents of the leafs
 	for (i=0 ; i < ll.count ; i++) {
@@ -462,7 +571,7 @@ CM_TraceThroughPatch
 void CM_TraceThroughPatch( traceWork_t *tw, cPatch_t *patch ) {
 	float		oldFrac;
 
-	c_patch_traces++;
+	tw->thread->c_patch_traces++;
 
 	oldFrac = tw->trace.fraction;
 
@@ -500,7 +609,7 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 		return;
 	}
 
-	c_brush_traces++;
+	tw->thread->c_brush_traces++;
 
 	getout = qfalse;
 	startout = qfalse;
@@ -575,6 +684,11 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 			}
 		}
 	} else {
+#ifdef USE_SIMD_BRUSHES
+		const float	*packed = cm_simdBrushes->integer ? brush->packedPlanes : NULL;
+		float		d1s[PACKED_PLANE_LANES], d2s[PACKED_PLANE_LANES];
+#endif
+
 		//
 		// compare the trace against all planes of the brush
 		// find the latest time the trace crosses a plane towards the interior
@@ -584,11 +698,23 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 			side = brush->sides + i;
 			plane = side->plane;
 
-			// adjust the plane distance appropriately for mins/maxs
-			dist = plane->dist - DotProduct( tw->offsets[ plane->signbits ], plane->normal );
+#ifdef USE_SIMD_BRUSHES
+			if ( packed ) {
+				if ( !( i % PACKED_PLANE_LANES ) ) {
+					CM_PackedPlaneDistances( tw, packed, d1s, d2s );
+					packed += PACKED_PLANE_BLOCK;
+				}
+				d1 = d1s[i % PACKED_PLANE_LANES];
+				d2 = d2s[i % PACKED_PLANE_LANES];
+			} else
+#endif
+			{
+				// adjust the plane distance appropriately for mins/maxs
+				dist = plane->dist - DotProduct( tw->offsets[ plane->signbits ], plane->normal );
 
-			d1 = DotProduct( tw->start, plane->normal ) - dist;
-			d2 = DotProduct( tw->end, plane->normal ) - dist;
+				d1 = DotProduct( tw->start, plane->normal ) - dist;
+				d2 = DotProduct( tw->end, plane->normal ) - dist;
+			}
 
 			if (d2 > 0) {
 				getout = qtrue;	// endpoint is not in solid
@@ -668,7 +794,7 @@ CM_TraceThroughLeaf
 */
 void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	int			k;
-	int			brushnum;
+	int			brushnum, surfnum;
 	cbrush_t	*b;
 	cPatch_t	*patch;
 
@@ -677,10 +803,10 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 
 		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( tw->thread->brushChecks[brushnum] == tw->thread->checkcount ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		tw->thread->brushChecks[brushnum] = tw->thread->checkcount;
 
 		if ( !(b->contents & tw->contents) ) {
 			continue;
@@ -704,14 +830,15 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	if ( !cm_noCurves->integer ) {
 #endif
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			surfnum = cm.leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = cm.surfaces[ surfnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( tw->thread->surfaceChecks[surfnum] == tw->thread->checkcount ) {
 				continue;	// already checked this patch in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			tw->thread->surfaceChecks[surfnum] = tw->thread->checkcount;
 
 			if ( !(patch->contents & tw->contents) ) {
 				continue;
@@ -1154,12 +1281,12 @@ void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, vec3_t mi
 
 	cmod = CM_ClipHandleToModel( model );
 
-	cm.checkcount++;		// for multi-check avoidance
-
-	c_traces++;				// for statistics, may be zeroed
-
 	// fill in a default trace
 	Com_Memset( &tw, 0, sizeof(tw) );
+
+	tw.thread = CM_ThreadState();
+	tw.thread->checkcount++;		// for multi-check avoidance
+	tw.thread->c_traces++;			// for statistics, may be zeroed
 	tw.trace.fraction = 1;	// assume it goes the entire distance until shown otherwise
 	VectorCopy(origin, tw.modelOrigin);
 
@@ -382,7 +382,8 @@ void Cmd_Echo_f (void)
 
 typedef struct cmd_function_s
 {
-	struct cmd_function_s	*next;
+	struct cmd_function_s	*next;		// in name order
+	struct cmd_function_s	*hashNext;
 	char					*name;
 	xcommand_t				function;
 	completionFunc_t	complete;
@@ -394,7 +395,31 @@ static	char		*cmd_argv[MAX_STRING_TOKENS];		// points into cmd_tokenized
 static	char		cmd_tokenized[BIG_INFO_STRING+MAX_STRING_TOKENS];	// will have 0 bytes inserted
 static	char		cmd_cmd[BIG_INFO_STRING]; // the original command we received (no token processing)
 
-static	cmd_function_t	*cmd_functions;		// possible commands to execute
+static	cmd_function_t	*cmd_functions;		// possible commands to execute, sorted by name
+
+#define CMD_HASH_SIZE		256
+static	cmd_function_t	*cmd_hashTable[CMD_HASH_SIZE];
+
+/*
+================
+return a hash value for the command name
+================
+*/
+static long Cmd_HashValue( const char *name ) {
+	int		i;
+	long	hash;
+	char	letter;
+
+	hash = 0;
+	i = 0;
+	while (name[i] != '\0') {
+		letter = tolower(name[i]);
+		hash+=(long)(letter)*(i+119);
+		i++;
+	}
+	hash &= (CMD_HASH_SIZE-1);
+	return hash;
+}
 
 /*
 ============
@@ -667,7 +692,7 @@ Cmd_FindCommand
 cmd_function_t *Cmd_FindCommand( const char *cmd_name )
 {
 	cmd_function_t *cmd;
-	for( cmd = cmd_functions; cmd; cmd = cmd->next )
+	for( cmd = cmd_hashTable[Cmd_HashValue( cmd_name )]; cmd; cmd = cmd->hashNext )
 		if( !Q_stricmp( cmd_name, cmd->name ) )
 			return cmd;
 	return NULL;
@@ -679,7 +704,8 @@ Cmd_AddCommand
 ============
 */
 void	Cmd_AddCommand( const char *cmd_name, xcommand_t function ) {
-	cmd_function_t	*cmd;
+	cmd_function_t	*cmd, **prev;
+	long			hash;
 	
 	// fail if the command already exists
 	if( Cmd_FindCommand( cmd_name ) )
@@ -695,8 +721,18 @@ void	Cmd_AddCommand( const char *cmd_name, xcommand_t function ) {
 	cmd->name = CopyString( cmd_name );
 	cmd->function = function;
 	cmd->complete = NULL;
-	cmd->next = cmd_functions;
-	cmd_functions = cmd;
+
+	// keep the list sorted for listing and completion
+	for( prev = &cmd_functions; *prev; prev = &(*prev)->next ) {
+		if( Q_stricmp( cmd_name, (*prev)->name ) < 0 )
+			break;
+	}
+	cmd->next = *prev;
+	*prev = cmd;
+
+	hash = Cmd_HashValue( cmd_name );
+	cmd->hashNext = cmd_hashTable[hash];
+	cmd_hashTable[hash] = cmd;
 }
 
 /*
@@ -705,13 +741,10 @@ Cmd_SetCommandCompletionFunc
 ============
 */
 void Cmd_SetCommandCompletionFunc( const char *command, completionFunc_t complete ) {
-	cmd_function_t	*cmd;
+	cmd_function_t	*cmd = Cmd_FindCommand( command );
 
-	for( cmd = cmd_functions; cmd; cmd = cmd->next ) {
-		if( !Q_stricmp( command, cmd->name ) ) {
-			cmd->complete = complete;
-			return;
-		}
+	if( cmd ) {
+		cmd->complete = complete;
 	}
 }
 
@@ -723,7 +756,7 @@ Cmd_RemoveCommand
 void	Cmd_RemoveCommand( const char *cmd_name ) {
 	cmd_function_t	*cmd, **back;
 
-	back = &cmd_functions;
+	back = &cmd_hashTable[Cmd_HashValue( cmd_name )];
 	while( 1 ) {
 		cmd = *back;
 		if ( !cmd ) {
@@ -731,13 +764,18 @@ void	Cmd_RemoveCommand( const char *cmd_name ) {
 			return;
 		}
 		if ( !strcmp( cmd_name, cmd->name ) ) {
-			*back = cmd->next;
-			Z_Free (cmd->name);
-			Z_Free (cmd);
-			return;
+			*back = cmd->hashNext;
+			break;
 		}
-		back = &cmd->next;
+		back = &cmd->hashNext;
+	}
+
+	for( back = &cmd_functions; *back != cmd; back = &(*back)->next ) {
 	}
+	*back = cmd->next;
+
+	Z_Free (cmd->name);
+	Z_Free (cmd);
 }
 
 /*
@@ -782,15 +820,10 @@ Cmd_CompleteArgument
 ============
 */
 void Cmd_CompleteArgument( const char *command, char *args, int argNum ) {
-	cmd_function_t	*cmd;
+	cmd_function_t	*cmd = Cmd_FindCommand( command );
 
-	for( cmd = cmd_functions; cmd; cmd = cmd->next ) {
-		if( !Q_stricmp( command, cmd->name ) ) {
-			if ( cmd->complete ) {
-				cmd->complete( args, argNum );
-			}
-			return;
-		}
+	if( cmd && cmd->complete ) {
+		cmd->complete( args, argNum );
 	}
 }
 
@@ -803,7 +836,7 @@ A complete command line has been parsed, so try to execute it
 ============
 */
 void	Cmd_ExecuteString( const char *text ) {	
-	cmd_function_t	*cmd, **prev;
+	cmd_function_t	*cmd, **prev, **chain;
 
 	// execute the command line
 	Cmd_TokenizeString( text );		
@@ -812,14 +845,15 @@ void	Cmd_ExecuteString( const char *text ) {
 	}
 
 	// check registered command functions	
-	for ( prev = &cmd_functions ; *prev ; prev = &cmd->next ) {
+	chain = &cmd_hashTable[Cmd_HashValue( cmd_argv[0] )];
+	for ( prev = chain ; *prev ; prev = &cmd->hashNext ) {
 		cmd = *prev;
 		if ( !Q_stricmp( cmd_argv[0],cmd->name ) ) {
 			// rearrange the links so that the command will be
-			// near the head of the list next time it is used
-			*prev = cmd->next;
-			cmd->next = cmd_functions;
-			cmd_functions = cmd;
+			// near the head of its chain next time it is used
+			*prev = cmd->hashNext;
+			cmd->hashNext = *chain;
+			*chain = cmd;
 
 			// perform the action
 			if ( !cmd->function ) {
@@ -52,6 +52,7 @@ jmp_buf abortframe;		// an ERR_DROP occurred, exit the entire frame
 FILE *debuglogfile;
 static fileHandle_t pipefile;
 static fileHandle_t logfile;
+static char logfileName[MAX_QPATH];	// a forked server's own, see Com_ForkLogfile
 fileHandle_t	com_journalFile;			// events are written here
 fileHandle_t	com_journalDataFile;		// config files are written here
 
@@ -94,6 +95,12 @@ cvar_t	*com_legacyprotocol;
 cvar_t	*com_basegame;
 cvar_t	*com_homepath;
 cvar_t	*com_busyWait;
+cvar_t	*com_preciseTicks;
+cvar_t	*com_affinity;
+cvar_t	*com_priority;
+cvar_t	*com_realtime;
+cvar_t	*com_numa;
+cvar_t	*com_lockMemory;
 cvar_t	*com_logfileName;
 #ifndef DEDICATED
 cvar_t	*con_autochat;
@@ -108,7 +115,7 @@ cvar_t	*con_autochat;
 #endif
 
 // com_speeds times
-int			time_game;
+int			time_game;			// usec
 int			time_frontend;		// renderer frontend time
 int			time_backend;		// renderer backend time
 
@@ -122,7 +129,10 @@ qboolean	com_gameClientRestarting = qfalse;
 
 char	com_errorMessage[MAXPRINTMSG];
 
-static	qboolean isDevPrint = qfalse;
+static	Q_THREADLOCAL qboolean isDevPrint = qfalse;
+
+static	qboolean				com_mainThreadKnown = qfalse;
+static	Q_THREADLOCAL qboolean	com_onMainThread = qfalse;
 
 void Com_WriteConfig_f( void );
 void CIN_CloseAllVideos( void );
@@ -157,23 +167,24 @@ void Com_EndRedirect (void)
 
 /*
 =============
-Com_Printf
+Com_IsMainThread
 
-Both client and server can use this, and it will output
-to the appropriate place.
-
-A raw string should NEVER be passed as fmt, because of "%f" type crashers.
+Everything runs on the main thread until Com_Init says which one it is
 =============
 */
-void QDECL Com_Printf( const char *fmt, ... ) {
-	va_list		argptr;
-	char		msg[MAXPRINTMSG];
-	static qboolean opening_qconsole = qfalse;
+qboolean Com_IsMainThread( void ) {
+	return !com_mainThreadKnown || com_onMainThread;
+}
 
+/*
+=============
+Com_PrintMessage
 
-	va_start (argptr,fmt);
-	Q_vsnprintf (msg, sizeof(msg), fmt, argptr);
-	va_end (argptr);
+Main thread only
+=============
+*/
+static void Com_PrintMessage( char *msg ) {
+	static qboolean opening_qconsole = qfalse;
 
 	if ( rd_buffer ) {
 		if ((strlen (msg) + strlen(rd_buffer)) > (rd_buffersize - 1)) {
@@ -210,7 +221,7 @@ void QDECL Com_Printf( const char *fmt, ... ) {
 			time( &aclock );
 			newtime = localtime( &aclock );
 
-			logfile = FS_FOpenFileWrite( com_logfileName->string );
+			logfile = FS_FOpenFileWrite( logfileName[0] ? logfileName : com_logfileName->string );
 			
 			if(logfile)
 			{
@@ -225,7 +236,7 @@ void QDECL Com_Printf( const char *fmt, ... ) {
 			}
 			else
 			{
-				Com_Printf("Opening %s failed!\n", com_logfileName->string);
+				Com_Printf("Opening %s failed!\n", logfileName[0] ? logfileName : com_logfileName->string);
 				Cvar_SetValue("logfile", 0);
 			}
 
@@ -237,6 +248,72 @@ void QDECL Com_Printf( const char *fmt, ... ) {
 	}
 }
 
+/*
+=============
+Com_DrainPrints
+
+Prints what other threads queued with Com_Printf. Not while a redirect is
+open, their messages have nothing to do with the rcon reply.
+=============
+*/
+void Com_DrainPrints( void ) {
+	char		msg[MAXPRINTMSG];
+	qboolean	devPrint, wasDevPrint;
+	int			dropped;
+
+	if ( !Com_IsMainThread() || rd_buffer ) {
+		return;
+	}
+
+	wasDevPrint = isDevPrint;
+
+	while ( Sys_NextQueuedPrint( msg, sizeof( msg ), &devPrint ) ) {
+		isDevPrint = devPrint;
+		Com_PrintMessage( msg );
+	}
+
+	dropped = Sys_QueuedPrintsDropped();
+	if ( dropped ) {
+		isDevPrint = qfalse;
+		Com_sprintf( msg, sizeof( msg ), S_COLOR_YELLOW "WARNING: %i messages from other threads dropped\n", dropped );
+		Com_PrintMessage( msg );
+	}
+
+	isDevPrint = wasDevPrint;
+}
+
+/*
+=============
+Com_Printf
+
+Both client and server can use this, and it will output
+to the appropriate place.
+
+Safe to call from any thread, anything but the main thread only queues
+the message for Com_DrainPrints and never waits.
+
+A raw string should NEVER be passed as fmt, because of "%f" type crashers.
+=============
+*/
+void QDECL Com_Printf( const char *fmt, ... ) {
+	va_list		argptr;
+	char		msg[MAXPRINTMSG];
+
+	va_start (argptr,fmt);
+	Q_vsnprintf (msg, sizeof(msg), fmt, argptr);
+	va_end (argptr);
+
+	if ( !Com_IsMainThread() ) {
+		Sys_QueuePrint( msg, isDevPrint );
+		return;
+	}
+
+	// keep the order with what other threads printed before
+	Com_DrainPrints();
+
+	Com_PrintMessage( msg );
+}
+
 
 /*
 ================
@@ -282,6 +359,9 @@ void QDECL Com_Error( int code, const char *fmt, ... ) {
 
 	com_errorEntered = qtrue;
 
+	// the error unwinds whatever set the memory class
+	Com_SetMemClass( MEMCLASS_OTHER );
+
 	Cvar_Set("com_errorCode", va("%i", code));
 
 	// when we are running automated scripts, make sure we
@@ -795,6 +875,12 @@ The rover can be left pointing at a non-empty block
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
+
+Small blocks come from slabs instead, zone blocks tagged TAG_SLAB that are
+cut into blocks of one size class. Those keep a memblock_t header each, so
+Z_Free, the tags and the trash tester work the same for them; their prev is
+NULL, and next is the slab's zone block while in use, or the next free
+block of the slab.
 ==============================================================================
 */
 
@@ -813,16 +899,31 @@ typedef struct memblock_s {
 	int			tag;			// a tag of 0 is a free block
 	struct		memblock_s	*next, *prev;
 	int			id;				// should be ZONEID
+	int			memClass;		// memClass_t the block is charged to
 #ifdef ZONE_DEBUG
 	zonedebug_t d;
 #endif
 } memblock_t;
 
-typedef struct {
+#define SLAB_STEP		16
+#define SLAB_CLASSES	16		// blocks of up to SLAB_STEP * SLAB_CLASSES bytes
+#define SLAB_SIZE		4096	// bytes of blocks in a slab
+
+typedef struct zoneslab_s {
+	struct memzone_s	*zone;
+	int			sizeClass;
+	int			numBlocks;
+	int			numFree;
+	memblock_t	*free;
+	struct zoneslab_s	*prev, *next;	// in the zone's list for the class while it has free blocks
+} zoneslab_t;
+
+typedef struct memzone_s {
 	int			size;			// total bytes malloced, including header
 	int			used;			// total bytes used
 	memblock_t	blocklist;	// start / end cap for linked list
 	memblock_t	*rover;
+	zoneslab_t	*slabs[SLAB_CLASSES];
 } memzone_t;
 
 // main zone for all "dynamic" memory allocation
@@ -831,8 +932,40 @@ static memzone_t	*mainzone;
 // fragment the main zone (think of cvar and cmd strings)
 static memzone_t	*smallzone;
 
+// bytes in use per memory class, the peaks last across map loads
+static memClass_t	com_memClass;
+static int			com_memHunk[MEMCLASS_COUNT], com_memHunkPeak[MEMCLASS_COUNT];
+static int			com_memHunkMark[MEMCLASS_COUNT];
+static int			com_memZone[MEMCLASS_COUNT], com_memZonePeak[MEMCLASS_COUNT];
+static int			com_hunkPeak, com_zonePeak, com_smallZonePeak;
+
+static const char *com_memClassNames[MEMCLASS_COUNT] = {
+	"other",
+	"renderer",
+	"cm",
+	"botlib",
+	"vm",
+	"sound",
+	"temp"
+};
+
 static void Z_CheckHeap( void );
 
+/*
+========================
+Com_SetMemClass
+
+Charges hunk and zone allocations made from now on to memClass,
+returns the class to restore afterwards
+========================
+*/
+memClass_t Com_SetMemClass( memClass_t memClass ) {
+	memClass_t	old = com_memClass;
+
+	com_memClass = memClass;
+	return old;
+}
+
 /*
 ========================
 Z_ClearZone
@@ -851,6 +984,7 @@ static void Z_ClearZone( memzone_t *zone, int size ) {
 	zone->rover = block;
 	zone->size = size;
 	zone->used = 0;
+	Com_Memset( zone->slabs, 0, sizeof( zone->slabs ) );
 	
 	block->prev = block->next = &zone->blocklist;
 	block->tag = 0;			// free block
@@ -876,14 +1010,96 @@ int Z_AvailableMemory( void ) {
 	return Z_AvailableZoneMemory( mainzone );
 }
 
+/*
+========================
+Z_FreeBlock
+========================
+*/
+static void Z_FreeBlock( memzone_t *zone, memblock_t *block ) {
+	memblock_t	*other;
+
+	zone->used -= block->size;
+	// set the block to something that should cause problems
+	// if it is referenced...
+	Com_Memset( block + 1, 0xaa, block->size - sizeof( *block ) );
+
+	block->tag = 0;		// mark as free
+	
+	other = block->prev;
+	if (!other->tag) {
+		// merge with previous free block
+		other->size += block->size;
+		other->next = block->next;
+		other->next->prev = other;
+		if (block == zone->rover) {
+			zone->rover = other;
+		}
+		block = other;
+	}
+
+	zone->rover = block;
+
+	other = block->next;
+	if ( !other->tag ) {
+		// merge the next free block onto the end
+		block->size += other->size;
+		block->next = other->next;
+		block->next->prev = block;
+	}
+}
+
+/*
+========================
+Z_SlabFree
+
+Gives the slab back to the zone once it is empty, unless it is the only one
+of its class with free blocks; returns qtrue then
+========================
+*/
+static qboolean Z_SlabFree( memblock_t *block ) {
+	memblock_t	*slabBlock = block->next;
+	zoneslab_t	*slab = (zoneslab_t *)( slabBlock + 1 );
+	memzone_t	*zone = slab->zone;
+
+	Com_Memset( block + 1, 0xaa, block->size - sizeof( *block ) );
+
+	block->tag = 0;		// mark as free
+	block->next = slab->free;
+	slab->free = block;
+
+	if ( slab->numFree++ == 0 ) {
+		slab->prev = NULL;
+		slab->next = zone->slabs[slab->sizeClass];
+		if ( slab->next ) {
+			slab->next->prev = slab;
+		}
+		zone->slabs[slab->sizeClass] = slab;
+		return qfalse;
+	}
+
+	if ( slab->numFree < slab->numBlocks || ( !slab->prev && !slab->next ) ) {
+		return qfalse;
+	}
+
+	if ( slab->prev ) {
+		slab->prev->next = slab->next;
+	} else {
+		zone->slabs[slab->sizeClass] = slab->next;
+	}
+	if ( slab->next ) {
+		slab->next->prev = slab->prev;
+	}
+	Z_FreeBlock( zone, slabBlock );
+	return qtrue;
+}
+
 /*
 ========================
 Z_Free
 ========================
 */
 void Z_Free( void *ptr ) {
-	memblock_t	*block, *other;
-	memzone_t *zone;
+	memblock_t	*block;
 	
 	if (!ptr) {
 		Com_Error( ERR_DROP, "Z_Free: NULL pointer" );
@@ -906,41 +1122,42 @@ void Z_Free( void *ptr ) {
 		Com_Error( ERR_FATAL, "Z_Free: memory block wrote past end" );
 	}
 
-	if (block->tag == TAG_SMALL) {
-		zone = smallzone;
+	com_memZone[block->memClass] -= block->size;
+
+	if (!block->prev) {
+		Z_SlabFree( block );
+	}
+	else if (block->tag == TAG_SMALL) {
+		Z_FreeBlock( smallzone, block );
 	}
 	else {
-		zone = mainzone;
+		Z_FreeBlock( mainzone, block );
 	}
+}
 
-	zone->used -= block->size;
-	// set the block to something that should cause problems
-	// if it is referenced...
-	Com_Memset( ptr, 0xaa, block->size - sizeof( *block ) );
-
-	block->tag = 0;		// mark as free
-	
-	other = block->prev;
-	if (!other->tag) {
-		// merge with previous free block
-		other->size += block->size;
-		other->next = block->next;
-		other->next->prev = other;
-		if (block == zone->rover) {
-			zone->rover = other;
-		}
-		block = other;
-	}
+/*
+================
+Z_SlabFreeTags
 
-	zone->rover = block;
+Returns qtrue if the slab went back to the zone
+================
+*/
+static qboolean Z_SlabFreeTags( memblock_t *slabBlock, int tag ) {
+	zoneslab_t	*slab = (zoneslab_t *)( slabBlock + 1 );
+	memblock_t	*block;
+	int			i;
 
-	other = block->next;
-	if ( !other->tag ) {
-		// merge the next free block onto the end
-		block->size += other->size;
-		block->next = other->next;
-		block->next->prev = block;
+	block = (memblock_t *)( (byte *)slab + PAD( sizeof( *slab ), sizeof( intptr_t ) ) );
+	for ( i = 0 ; i < slab->numBlocks ; i++ ) {
+		if ( block->tag == tag ) {
+			com_memZone[block->memClass] -= block->size;
+			if ( Z_SlabFree( block ) ) {
+				return qtrue;
+			}
+		}
+		block = (memblock_t *)( (byte *)block + block->size );
 	}
+	return qfalse;
 }
 
 
@@ -966,6 +1183,9 @@ void Z_FreeTags( int tag ) {
 			Z_Free( (void *)(zone->rover + 1) );
 			continue;
 		}
+		if ( zone->rover->tag == TAG_SLAB && Z_SlabFreeTags( zone->rover, tag ) ) {
+			continue;
+		}
 		zone->rover = zone->rover->next;
 	} while ( zone->rover != &zone->blocklist );
 }
@@ -973,56 +1193,25 @@ void Z_FreeTags( int tag ) {
 
 /*
 ================
-Z_TagMalloc
+Z_ZoneAlloc
+
+Size includes the header and trash tester, returns NULL if the zone is full
 ================
 */
-#ifdef ZONE_DEBUG
-void *Z_TagMallocDebug( int size, int tag, char *label, char *file, int line ) {
-	int		allocSize;
-#else
-void *Z_TagMalloc( int size, int tag ) {
-#endif
+static memblock_t *Z_ZoneAlloc( memzone_t *zone, int size, int tag ) {
 	int		extra;
 	memblock_t	*start, *rover, *new, *base;
-	memzone_t *zone;
-
-	if (!tag) {
-		Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use a 0 tag" );
-	}
-
-	if ( tag == TAG_SMALL ) {
-		zone = smallzone;
-	}
-	else {
-		zone = mainzone;
-	}
 
-#ifdef ZONE_DEBUG
-	allocSize = size;
-#endif
 	//
 	// scan through the block list looking for the first free block
 	// of sufficient size
 	//
-	size += sizeof(memblock_t);	// account for size of block header
-	size += 4;					// space for memory trash tester
-	size = PAD(size, sizeof(intptr_t));		// align to 32/64 bit boundary
-	
 	base = rover = zone->rover;
 	start = base->prev;
 	
 	do {
 		if (rover == start)	{
 			// scaned all the way around the list
-#ifdef ZONE_DEBUG
-			Z_LogHeap();
-
-			Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone: %s, line: %d (%s)",
-								size, zone == smallzone ? "small" : "main", file, line, label);
-#else
-			Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
-								size, zone == smallzone ? "small" : "main");
-#endif
 			return NULL;
 		}
 		if (rover->tag) {
@@ -1056,6 +1245,139 @@ void *Z_TagMalloc( int size, int tag ) {
 	
 	base->id = ZONEID;
 
+	// marker for memory trash testing
+	*(int *)((byte *)base + base->size - 4) = ZONEID;
+
+	return base;
+}
+
+/*
+================
+Z_SlabAlloc
+
+Size includes the header and trash tester, returns NULL if the zone is
+too full for another slab
+================
+*/
+static memblock_t *Z_SlabAlloc( memzone_t *zone, int size ) {
+	int			sizeClass = ( size - 1 ) / SLAB_STEP;
+	zoneslab_t	*slab = zone->slabs[sizeClass];
+	memblock_t	*slabBlock, *block;
+	int			i;
+
+	if ( !slab ) {
+		slabBlock = Z_ZoneAlloc( zone, PAD( sizeof( memblock_t ) + PAD( sizeof( *slab ), sizeof( intptr_t ) ) + SLAB_SIZE + 4, sizeof( intptr_t ) ), TAG_SLAB );
+		if ( !slabBlock ) {
+			return NULL;
+		}
+
+		slab = (zoneslab_t *)( slabBlock + 1 );
+		slab->zone = zone;
+		slab->sizeClass = sizeClass;
+		slab->numBlocks = SLAB_SIZE / ( ( sizeClass + 1 ) * SLAB_STEP );
+		slab->numFree = slab->numBlocks;
+		slab->free = NULL;
+		slab->prev = slab->next = NULL;
+		zone->slabs[sizeClass] = slab;
+
+		block = (memblock_t *)( (byte *)slab + PAD( sizeof( *slab ), sizeof( intptr_t ) ) );
+		for ( i = 0 ; i < slab->numBlocks ; i++ ) {
+			block->size = ( sizeClass + 1 ) * SLAB_STEP;
+			block->tag = 0;
+			block->prev = NULL;
+			block->id = ZONEID;
+			block->next = slab->free;
+			slab->free = block;
+			block = (memblock_t *)( (byte *)block + block->size );
+		}
+	}
+
+	block = slab->free;
+	slab->free = block->next;
+	block->next = (memblock_t *)slab - 1;
+
+	if ( --slab->numFree == 0 ) {
+		zone->slabs[sizeClass] = slab->next;
+		if ( slab->next ) {
+			slab->next->prev = NULL;
+		}
+	}
+
+	return block;
+}
+
+/*
+================
+Z_TagMalloc
+================
+*/
+#ifdef ZONE_DEBUG
+void *Z_TagMallocDebug( int size, int tag, char *label, char *file, int line ) {
+	int		allocSize;
+#else
+void *Z_TagMalloc( int size, int tag ) {
+#endif
+	memblock_t	*base;
+	memzone_t *zone;
+
+	if (!tag) {
+		Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use a 0 tag" );
+	}
+
+	if ( tag == TAG_SMALL ) {
+		zone = smallzone;
+	}
+	else {
+		zone = mainzone;
+	}
+
+#ifdef ZONE_DEBUG
+	allocSize = size;
+#endif
+	size += sizeof(memblock_t);	// account for size of block header
+	size += 4;					// space for memory trash tester
+	size = PAD(size, sizeof(intptr_t));		// align to 32/64 bit boundary
+
+	if ( size <= SLAB_STEP * SLAB_CLASSES ) {
+		base = Z_SlabAlloc( zone, size );
+	} else {
+		base = Z_ZoneAlloc( zone, size, tag );
+	}
+
+	if ( !base ) {
+#ifdef ZONE_DEBUG
+		Z_LogHeap();
+
+		Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone: %s, line: %d (%s)",
+							size, zone == smallzone ? "small" : "main", file, line, label);
+#else
+		Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
+							size, zone == smallzone ? "small" : "main");
+#endif
+		return NULL;
+	}
+
+	base->tag = tag;
+
+	if ( tag == TAG_BOTLIB ) {
+		base->memClass = MEMCLASS_BOTLIB;
+	} else if ( tag == TAG_RENDERER ) {
+		base->memClass = MEMCLASS_RENDERER;
+	} else {
+		base->memClass = com_memClass;
+	}
+	com_memZone[base->memClass] += base->size;
+	if ( com_memZone[base->memClass] > com_memZonePeak[base->memClass] ) {
+		com_memZonePeak[base->memClass] = com_memZone[base->memClass];
+	}
+	if ( zone == smallzone ) {
+		if ( zone->used > com_smallZonePeak ) {
+			com_smallZonePeak = zone->used;
+		}
+	} else if ( zone->used > com_zonePeak ) {
+		com_zonePeak = zone->used;
+	}
+
 #ifdef ZONE_DEBUG
 	base->d.label = label;
 	base->d.file = file;
@@ -1136,9 +1458,10 @@ void Z_LogZoneHeap( memzone_t *zone, char *name ) {
 	char dump[32], *ptr;
 	int  i, j;
 #endif
-	memblock_t	*block;
+	memblock_t	*zoneBlock, *block;
+	zoneslab_t	*slab;
 	char		buf[4096];
-	int size, allocSize, numBlocks;
+	int size, allocSize, numBlocks, count;
 
 	if (!logfile || !FS_Initialized())
 		return;
@@ -1148,8 +1471,19 @@ void Z_LogZoneHeap( memzone_t *zone, char *name ) {
 #endif
 	Com_sprintf(buf, sizeof(buf), "\r\n================\r\n%s log\r\n================\r\n", name);
 	FS_Write(buf, strlen(buf), logfile);
-	for (block = zone->blocklist.next ; block->next != &zone->blocklist; block = block->next) {
-		if (block->tag) {
+	for (zoneBlock = zone->blocklist.next ; zoneBlock->next != &zone->blocklist; zoneBlock = zoneBlock->next) {
+		block = zoneBlock;
+		count = 1;
+		if (zoneBlock->tag == TAG_SLAB) {
+			// log the blocks of the slab instead
+			slab = (zoneslab_t *)(zoneBlock + 1);
+			block = (memblock_t *)((byte *)slab + PAD(sizeof(*slab), sizeof(intptr_t)));
+			count = slab->numBlocks;
+		}
+		for ( ; count > 0; count--, block = (memblock_t *)((byte *)block + block->size)) {
+			if (!block->tag) {
+				continue;
+			}
 #ifdef ZONE_DEBUG
 			ptr = ((char *) block) + sizeof(memblock_t);
 			j = 0;
@@ -1308,6 +1642,31 @@ static	int		s_zoneTotal;
 static	int		s_smallZoneTotal;
 
 
+/*
+=================
+Z_SlabMeminfo
+
+Charges the blocks of a slab to their tags
+=================
+*/
+static void Z_SlabMeminfo( memblock_t *slabBlock, int *botlibBytes, int *rendererBytes, int *freeBytes ) {
+	zoneslab_t	*slab = (zoneslab_t *)( slabBlock + 1 );
+	memblock_t	*block;
+	int			i;
+
+	block = (memblock_t *)( (byte *)slab + PAD( sizeof( *slab ), sizeof( intptr_t ) ) );
+	for ( i = 0 ; i < slab->numBlocks ; i++ ) {
+		if ( !block->tag ) {
+			*freeBytes += block->size;
+		} else if ( block->tag == TAG_BOTLIB && botlibBytes ) {
+			*botlibBytes += block->size;
+		} else if ( block->tag == TAG_RENDERER && rendererBytes ) {
+			*rendererBytes += block->size;
+		}
+		block = (memblock_t *)( (byte *)block + block->size );
+	}
+}
+
 /*
 =================
 Com_Meminfo_f
@@ -1318,11 +1677,13 @@ void Com_Meminfo_f( void ) {
 	int			zoneBytes, zoneBlocks;
 	int			smallZoneBytes;
 	int			botlibBytes, rendererBytes;
+	int			slabFreeBytes;
 	int			unused;
 
 	zoneBytes = 0;
 	botlibBytes = 0;
 	rendererBytes = 0;
+	slabFreeBytes = 0;
 	zoneBlocks = 0;
 	for (block = mainzone->blocklist.next ; ; block = block->next) {
 		if ( Cmd_Argc() != 1 ) {
@@ -1336,6 +1697,8 @@ void Com_Meminfo_f( void ) {
 				botlibBytes += block->size;
 			} else if ( block->tag == TAG_RENDERER ) {
 				rendererBytes += block->size;
+			} else if ( block->tag == TAG_SLAB ) {
+				Z_SlabMeminfo( block, &botlibBytes, &rendererBytes, &slabFreeBytes );
 			}
 		}
 
@@ -1357,6 +1720,9 @@ void Com_Meminfo_f( void ) {
 	for (block = smallzone->blocklist.next ; ; block = block->next) {
 		if ( block->tag ) {
 			smallZoneBytes += block->size;
+			if ( block->tag == TAG_SLAB ) {
+				Z_SlabMeminfo( block, NULL, NULL, &slabFreeBytes );
+			}
 		}
 
 		if (block->next == &smallzone->blocklist) {
@@ -1396,6 +1762,48 @@ void Com_Meminfo_f( void ) {
 	Com_Printf( "        %8i bytes in dynamic renderer\n", rendererBytes );
 	Com_Printf( "        %8i bytes in dynamic other\n", zoneBytes - ( botlibBytes + rendererBytes ) );
 	Com_Printf( "        %8i bytes in small Zone memory\n", smallZoneBytes );
+	Com_Printf( "        %8i bytes free in zone slabs\n", slabFreeBytes );
+}
+
+/*
+=================
+Com_MemUsage_f
+
+Reports hunk and zone use per subsystem along with the peaks since
+startup, to size com_hunkMegs and com_zoneMegs
+=================
+*/
+void Com_MemUsage_f( void ) {
+	int		i, temp;
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		Com_Memcpy( com_memHunkPeak, com_memHunk, sizeof( com_memHunkPeak ) );
+		Com_Memcpy( com_memZonePeak, com_memZone, sizeof( com_memZonePeak ) );
+		com_hunkPeak = hunk_low.temp + hunk_high.temp;
+		com_zonePeak = mainzone->used;
+		com_smallZonePeak = smallzone->used;
+		Com_ScratchInfo( qtrue );
+		Com_Printf( "memory peaks reset\n" );
+		return;
+	}
+
+	temp = ( hunk_low.temp - hunk_low.permanent ) + ( hunk_high.temp - hunk_high.permanent );
+
+	Com_Printf( "class        hunk   hunk peak        zone   zone peak\n" );
+	for ( i = 0 ; i < MEMCLASS_COUNT ; i++ ) {
+		Com_Printf( "%-8s %8i    %8i    %8i    %8i\n", com_memClassNames[i],
+			i == MEMCLASS_TEMP ? temp : com_memHunk[i], com_memHunkPeak[i],
+			com_memZone[i], com_memZonePeak[i] );
+	}
+	Com_Printf( "\n" );
+	Com_Printf( "%8i of %8i bytes hunk in use, peak %i\n",
+		hunk_low.temp + hunk_high.temp, s_hunkTotal, com_hunkPeak );
+	Com_Printf( "%8i of %8i bytes zone in use, peak %i\n",
+		mainzone->used, s_zoneTotal, com_zonePeak );
+	Com_Printf( "%8i of %8i bytes small zone in use, peak %i\n",
+		smallzone->used, s_smallZoneTotal, com_smallZonePeak );
+
+	Com_ScratchInfo( qfalse );
 }
 
 /*
@@ -1613,6 +2021,7 @@ void Com_InitHunkMemory( void ) {
 	Hunk_Clear();
 
 	Cmd_AddCommand( "meminfo", Com_Meminfo_f );
+	Cmd_AddCommand( "memusage", Com_MemUsage_f );
 #ifdef ZONE_DEBUG
 	Cmd_AddCommand( "zonelog", Z_LogHeap );
 #endif
@@ -1636,6 +2045,20 @@ int	Hunk_MemoryRemaining( void ) {
 	return s_hunkTotal - ( low + high );
 }
 
+/*
+====================
+Com_MemoryUsage
+
+Hunk and main zone bytes in use and allocated, as meminfo reports them
+====================
+*/
+void Com_MemoryUsage( int *hunkUsed, int *hunkTotal, int *zoneUsed, int *zoneTotal ) {
+	*hunkUsed = hunk_low.temp + hunk_high.temp;
+	*hunkTotal = s_hunkTotal;
+	*zoneUsed = mainzone ? mainzone->used : 0;
+	*zoneTotal = s_zoneTotal;
+}
+
 /*
 ===================
 Hunk_SetMark
@@ -1646,6 +2069,7 @@ The server calls this after the level and game VM have been loaded
 void Hunk_SetMark( void ) {
 	hunk_low.mark = hunk_low.permanent;
 	hunk_high.mark = hunk_high.permanent;
+	Com_Memcpy( com_memHunkMark, com_memHunk, sizeof( com_memHunkMark ) );
 }
 
 /*
@@ -1658,6 +2082,7 @@ The client calls this before starting a vid_restart or snd_restart
 void Hunk_ClearToMark( void ) {
 	hunk_low.permanent = hunk_low.temp = hunk_low.mark;
 	hunk_high.permanent = hunk_high.temp = hunk_high.mark;
+	Com_Memcpy( com_memHunk, com_memHunkMark, sizeof( com_memHunk ) );
 }
 
 /*
@@ -1706,6 +2131,9 @@ void Hunk_Clear( void ) {
 	hunk_permanent = &hunk_low;
 	hunk_temp = &hunk_high;
 
+	Com_Memset( com_memHunk, 0, sizeof( com_memHunk ) );
+	Com_Memset( com_memHunkMark, 0, sizeof( com_memHunkMark ) );
+
 	Com_Printf( "Hunk_Clear: reset the hunk ok\n" );
 	VM_Clear();
 #ifdef HUNK_DEBUG
@@ -1789,6 +2217,14 @@ void *Hunk_Alloc( int size, ha_pref preference ) {
 
 	hunk_permanent->temp = hunk_permanent->permanent;
 
+	com_memHunk[com_memClass] += size;
+	if ( com_memHunk[com_memClass] > com_memHunkPeak[com_memClass] ) {
+		com_memHunkPeak[com_memClass] = com_memHunk[com_memClass];
+	}
+	if ( hunk_low.temp + hunk_high.temp > com_hunkPeak ) {
+		com_hunkPeak = hunk_low.temp + hunk_high.temp;
+	}
+
 	Com_Memset( buf, 0, size );
 
 #ifdef HUNK_DEBUG
@@ -1849,6 +2285,12 @@ void *Hunk_AllocateTempMemory( int size ) {
 	if ( hunk_temp->temp > hunk_temp->tempHighwater ) {
 		hunk_temp->tempHighwater = hunk_temp->temp;
 	}
+	if ( hunk_temp->temp - hunk_temp->permanent > com_memHunkPeak[MEMCLASS_TEMP] ) {
+		com_memHunkPeak[MEMCLASS_TEMP] = hunk_temp->temp - hunk_temp->permanent;
+	}
+	if ( hunk_low.temp + hunk_high.temp > com_hunkPeak ) {
+		com_hunkPeak = hunk_low.temp + hunk_high.temp;
+	}
 
 	hdr = (hunkHeader_t *)buf;
 	buf = (void *)(hdr+1);
@@ -1993,12 +2435,19 @@ void Com_QueueEvent( int time, sysEventType_t type, int value, int value2, int p
 {
 	sysEvent_t  *ev;
 
-	// combine mouse movement with previous mouse event
+	if ( time == 0 )
+	{
+		time = Sys_Milliseconds();
+	}
+
+	// combine mouse movement with previous mouse event of the same msec, so
+	// the client sees when it happened, or any once the queue fills up
 	if ( type == SE_MOUSE && eventHead != eventTail )
 	{
 		ev = &eventQueue[ ( eventHead + MAX_QUEUED_EVENTS - 1 ) & MASK_QUEUED_EVENTS ];
 
-		if ( ev->evType == SE_MOUSE )
+		if ( ev->evType == SE_MOUSE &&
+			( ev->evTime == time || eventHead - eventTail >= MAX_QUEUED_EVENTS / 2 ) )
 		{
 			ev->evValue += value;
 			ev->evValue2 += value2;
@@ -2021,11 +2470,6 @@ void Com_QueueEvent( int time, sysEventType_t type, int value, int value2, int p
 
 	eventHead++;
 
-	if ( time == 0 )
-	{
-		time = Sys_Milliseconds();
-	}
-
 	ev->evTime = time;
 	ev->evType = type;
 	ev->evValue = value;
@@ -2262,6 +2706,7 @@ int Com_EventLoop( void ) {
 			break;
 #endif
 			case SE_CONSOLE:
+				SV_CaptureConsole( (char *)ev.evPtr );
 				Cbuf_AddText( (char *)ev.evPtr );
 				Cbuf_AddText( "\n" );
 			break;
@@ -2559,6 +3004,77 @@ static void Com_InitRand(void)
 		srand(time(NULL));
 }
 
+/*
+=================
+Com_ParseCpuList
+
+"0-3,8,10" into cpus, in that order
+=================
+*/
+static int Com_ParseCpuList( const char *s, int *cpus, int maxCpus ) {
+	int		count, first, last;
+
+	count = 0;
+
+	while ( *s && count < maxCpus ) {
+		if ( *s < '0' || *s > '9' ) {
+			s++;
+			continue;
+		}
+
+		first = last = atoi( s );
+		while ( *s >= '0' && *s <= '9' ) {
+			s++;
+		}
+
+		if ( *s == '-' && s[1] >= '0' && s[1] <= '9' ) {
+			last = atoi( ++s );
+			while ( *s >= '0' && *s <= '9' ) {
+				s++;
+			}
+		}
+
+		for ( ; first <= last && count < maxCpus ; first++ ) {
+			cpus[count++] = first;
+		}
+	}
+
+	return count;
+}
+
+/*
+=================
+Com_InitPlacement
+
+Startup options for servers sharing a big host. com_affinity is a list of
+CPUs, the main thread takes the first and the worker threads the ones
+after it, so listing sibling cores of one socket keeps them together.
+=================
+*/
+static void Com_InitPlacement( void ) {
+	int		cpus[256];
+	int		numCpus;
+
+	com_affinity = Cvar_Get( "com_affinity", "", CVAR_INIT );
+	Cvar_SetDescription( com_affinity, "CPUs to run on, like 0-3,8, the main thread takes the first one" );
+	com_priority = Cvar_Get( "com_priority", "0", CVAR_INIT );
+	Cvar_CheckRange( com_priority, -20, 19, qtrue );
+	Cvar_SetDescription( com_priority, "Nice level, negative raises the priority" );
+	com_realtime = Cvar_Get( "com_realtime", "0", CVAR_INIT );
+	Cvar_CheckRange( com_realtime, 0, 99, qtrue );
+	Cvar_SetDescription( com_realtime, "SCHED_FIFO priority, 0 for the normal scheduler" );
+	com_numa = Cvar_Get( "com_numa", "0", CVAR_INIT );
+	Cvar_SetDescription( com_numa, "Allocate memory on the NUMA node of the CPU using it" );
+	com_lockMemory = Cvar_Get( "com_lockMemory", "0", CVAR_INIT );
+	Cvar_SetDescription( com_lockMemory, "Lock the hunk in memory so it never gets swapped out" );
+
+	numCpus = Com_ParseCpuList( com_affinity->string, cpus, ARRAY_LEN( cpus ) );
+
+	if ( numCpus || com_priority->integer || com_realtime->integer || com_numa->integer ) {
+		Sys_SetPlacement( cpus, numCpus, com_priority->integer, com_realtime->integer, com_numa->integer );
+	}
+}
+
 /*
 =================
 Com_Init
@@ -2568,6 +3084,9 @@ void Com_Init( char *commandLine ) {
 	char	*s;
 	int	qport;
 
+	com_onMainThread = qtrue;
+	com_mainThreadKnown = qtrue;
+
 	Com_Printf( "%s %s %s\n", Q3_VERSION, PLATFORM_STRING, PRODUCT_DATE );
 
 	if ( setjmp (abortframe) ) {
@@ -2602,6 +3121,7 @@ void Com_Init( char *commandLine ) {
 	Cbuf_Init ();
 
 	Com_DetectSSE();
+	Q_InitMathFuncs( Sys_GetProcessorFeatures() );
 
 	// override anything from the config files with command line args
 	Com_StartupVariable( NULL );
@@ -2649,9 +3169,16 @@ void Com_Init( char *commandLine ) {
 	com_dedicated = Cvar_Get ("dedicated", "0", CVAR_LATCH);
 	Cvar_CheckRange( com_dedicated, 0, 2, qtrue );
 #endif
+	// place the threads before the hunk so it ends up next to them
+	Com_InitPlacement();
+
 	// allocate the stack based hunk allocator
 	Com_InitHunkMemory();
 
+	if ( com_lockMemory->integer ) {
+		Sys_LockMemory( s_hunkData, s_hunkTotal );
+	}
+
 	// if any archived cvars are modified after this, we will trigger a writing
 	// of the config file
 	cvar_modifiedFlags &= ~CVAR_ARCHIVE;
@@ -2688,6 +3215,7 @@ void Com_Init( char *commandLine ) {
 	com_maxfpsMinimized = Cvar_Get( "com_maxfpsMinimized", "0", CVAR_ARCHIVE );
 	com_abnormalExit = Cvar_Get( "com_abnormalExit", "0", CVAR_ROM );
 	com_busyWait = Cvar_Get("com_busyWait", "0", CVAR_ARCHIVE);
+	com_preciseTicks = Cvar_Get("com_preciseTicks", "1", CVAR_ARCHIVE);
 	Cvar_Get("com_errorMessage", "", CVAR_ROM | CVAR_NORESTART);
 
 #ifdef CINEMATICS_INTRO
@@ -2716,6 +3244,8 @@ void Com_Init( char *commandLine ) {
 
 	Sys_InitPIDFile( FS_GetCurrentGameDir() );
 
+	Com_InitWorkers();
+
 	// Pick a random port value
 	Com_RandomBytes( (byte*)&qport, sizeof(int) );
 	Netchan_Init( qport & 0xffff );
@@ -2965,6 +3495,53 @@ int Com_TimeVal(int minMsec)
 	return timeVal;
 }
 
+static qboolean	com_tickResync;		// idling threw the tick deadline off
+
+/*
+=================
+Com_WaitForTick
+
+Dedicated servers sleep against a microsecond deadline instead of
+Com_TimeVal, which can only wake on whole milliseconds and then spins
+through the last one. Returns the number of server frames that are due.
+=================
+*/
+static int Com_WaitForTick(int tickMsec)
+{
+	static int64_t	nextTick;
+	static int		tickPeriod;
+	int64_t			now, usec;
+	int				timeValSV, ticks;
+
+	now = Sys_Microseconds();
+
+	// resync after sv_fps changes, after hitches too long to catch up on
+	// and after idling
+	if(com_tickResync || tickPeriod != tickMsec * 1000 || now - nextTick > 5000000)
+	{
+		com_tickResync = qfalse;
+		tickPeriod = tickMsec * 1000;
+		nextTick = now + tickPeriod;
+	}
+
+	while(now < nextTick)
+	{
+		usec = nextTick - now;
+
+		timeValSV = SV_SendQueuedPackets();
+		if((int64_t) timeValSV * 1000 < usec)
+			usec = (int64_t) timeValSV * 1000;
+
+		NET_SleepUsec(com_busyWait->integer ? 0 : (int) usec);
+		now = Sys_Microseconds();
+	}
+
+	for(ticks = 0; nextTick <= now; ticks++)
+		nextTick += tickPeriod;
+
+	return ticks;
+}
+
 /*
 =================
 Com_Frame
@@ -2974,13 +3551,15 @@ void Com_Frame( void ) {
 
 	int		msec, minMsec;
 	int		timeVal, timeValSV;
+	int		tickMsec, ticks;
+	int		replayMsec;
 	static int	lastTime = 0, bias = 0;
  
-	int		timeBeforeFirstEvents;
-	int		timeBeforeServer;
-	int		timeBeforeEvents;
-	int		timeBeforeClient;
-	int		timeAfter;
+	int64_t	timeBeforeFirstEvents;
+	int64_t	timeBeforeServer;
+	int64_t	timeBeforeEvents;
+	int64_t	timeBeforeClient;
+	int64_t	timeAfter;
 
 	if ( setjmp (abortframe) ) {
 		return;			// an ERR_DROP was thrown
@@ -2992,6 +3571,8 @@ void Com_Frame( void ) {
 	timeBeforeClient = 0;
 	timeAfter = 0;
 
+	Com_DrainPrints();
+
 	// write config file if anything changed
 	Com_WriteConfiguration(); 
 
@@ -2999,7 +3580,7 @@ void Com_Frame( void ) {
 	// main event loop
 	//
 	if ( com_speeds->integer ) {
-		timeBeforeFirstEvents = Sys_Milliseconds ();
+		timeBeforeFirstEvents = Sys_Microseconds();
 	}
 
 	// Figure out how much time we have
@@ -3032,25 +3613,55 @@ void Com_Frame( void ) {
 	else
 		minMsec = 1;
 
-	do
+	// game time only advances in whole msec, so a tick is the period
+	// SV_Frame actually runs at rather than 1000 / sv_fps
+	ticks = 0;
+	tickMsec = SV_TickMsec();
+
+	if(SV_Replaying())
 	{
-		if(com_sv_running->integer)
+		// svreplay runs the recorded frames as fast as they go
+	}
+	else if(com_dedicated->integer && SV_Idle() && !com_timedemo->integer)
+	{
+		// nobody on, sleep until the next idle frame or a packet comes in
+		timeVal = SV_IdleMsec() - (Sys_Milliseconds() - com_frameTime);
+		timeValSV = SV_SendQueuedPackets();
+		if(timeValSV < timeVal)
+			timeVal = timeValSV;
+
+		NET_Sleep(timeVal);
+		com_tickResync = qtrue;
+	}
+	else if(com_dedicated->integer && com_sv_running->integer && com_preciseTicks->integer &&
+		!com_timedemo->integer && com_timescale->value == 1.0f && !com_fixedtime->integer)
+	{
+		ticks = Com_WaitForTick(tickMsec);
+	}
+	else
+	{
+		do
 		{
-			timeValSV = SV_SendQueuedPackets();
-			
-			timeVal = Com_TimeVal(minMsec);
+			if(com_sv_running->integer)
+			{
+				timeValSV = SV_SendQueuedPackets();
+				
+				timeVal = Com_TimeVal(minMsec);
 
-			if(timeValSV < timeVal)
-				timeVal = timeValSV;
-		}
-		else
-			timeVal = Com_TimeVal(minMsec);
-		
-		if(com_busyWait->integer || timeVal < 1)
-			NET_Sleep(0);
-		else
-			NET_Sleep(timeVal - 1);
-	} while(Com_TimeVal(minMsec));
+				if(timeValSV < timeVal)
+					timeVal = timeValSV;
+			}
+			else
+				timeVal = Com_TimeVal(minMsec);
+			
+			if(com_busyWait->integer || timeVal < 1)
+				NET_Sleep(0);
+			else if(IN_SampleMouse() && timeVal > 2)
+				NET_Sleep(1);
+			else
+				NET_Sleep(timeVal - 1);
+		} while(Com_TimeVal(minMsec));
+	}
 	
 	IN_Frame();
 
@@ -3059,6 +3670,13 @@ void Com_Frame( void ) {
 	
 	msec = com_frameTime - lastTime;
 
+	// run exactly the frames that came due, however the msec rounded
+	if(ticks)
+		msec = ticks * tickMsec;
+
+	// the recorded packets and console lines come in with the rest
+	replayMsec = SV_ReplayEvents();
+
 	Cbuf_Execute ();
 
 	if (com_altivec->modified)
@@ -3069,12 +3687,14 @@ void Com_Frame( void ) {
 
 	// mess with msec if needed
 	msec = Com_ModifyMsec(msec);
+	if(replayMsec >= 0)
+		msec = replayMsec;
 
 	//
 	// server side
 	//
 	if ( com_speeds->integer ) {
-		timeBeforeServer = Sys_Milliseconds ();
+		timeBeforeServer = Sys_Microseconds();
 	}
 
 	SV_Frame( msec );
@@ -3102,7 +3722,7 @@ void Com_Frame( void ) {
 	// without a frame of latency
 	//
 	if ( com_speeds->integer ) {
-		timeBeforeEvents = Sys_Milliseconds ();
+		timeBeforeEvents = Sys_Microseconds();
 	}
 	Com_EventLoop();
 	Cbuf_Execute ();
@@ -3112,17 +3732,17 @@ void Com_Frame( void ) {
 	// client side
 	//
 	if ( com_speeds->integer ) {
-		timeBeforeClient = Sys_Milliseconds ();
+		timeBeforeClient = Sys_Microseconds();
 	}
 
 	CL_Frame( msec );
 
 	if ( com_speeds->integer ) {
-		timeAfter = Sys_Milliseconds ();
+		timeAfter = Sys_Microseconds();
 	}
 #else
 	if ( com_speeds->integer ) {
-		timeAfter = Sys_Milliseconds ();
+		timeAfter = Sys_Microseconds();
 		timeBeforeEvents = timeAfter;
 		timeBeforeClient = timeAfter;
 	}
@@ -3131,50 +3751,80 @@ void Com_Frame( void ) {
 
 	NET_FlushPacketQueue();
 
+	VM_SampleFrame();
+
 	//
 	// report timing information
 	//
 	if ( com_speeds->integer ) {
-		int			all, sv, ev, cl;
+		int			all, sv, ev, cl, jb;
 
+		// usec, printed as msec
 		all = timeAfter - timeBeforeServer;
 		sv = timeBeforeEvents - timeBeforeServer;
 		ev = timeBeforeServer - timeBeforeFirstEvents + timeBeforeClient - timeBeforeEvents;
 		cl = timeAfter - timeBeforeClient;
 		sv -= time_game;
-		cl -= time_frontend + time_backend;
+		cl -= ( time_frontend + time_backend ) * 1000;
+		jb = Com_JobsFrame( com_speeds->integer == 4 );
 
-		Com_Printf ("frame:%i all:%3i sv:%3i ev:%3i cl:%3i gm:%3i rf:%3i bk:%3i\n", 
-					 com_frameNumber, all, sv, ev, cl, time_game, time_frontend, time_backend );
+		Com_Printf ("frame:%i all:%6.2f sv:%6.2f ev:%6.2f cl:%6.2f gm:%6.2f rf:%3i bk:%3i jb:%6.2f\n", 
+					 com_frameNumber, all * 0.001f, sv * 0.001f, ev * 0.001f, cl * 0.001f,
+					 time_game * 0.001f, time_frontend, time_backend, jb * 0.001f );
 	}	
 
 	//
 	// trace optimization tracking
 	//
 	if ( com_showtrace->integer ) {
-	
-		extern	int c_traces, c_brush_traces, c_patch_traces;
-		extern	int	c_pointcontents;
+		int		c_traces, c_brush_traces, c_patch_traces;
+		int		c_pointcontents;
 
+		CM_TraceCounters( &c_traces, &c_brush_traces, &c_patch_traces, &c_pointcontents );
 		Com_Printf ("%4i traces  (%ib %ip) %4i points\n", c_traces,
 			c_brush_traces, c_patch_traces, c_pointcontents);
-		c_traces = 0;
-		c_brush_traces = 0;
-		c_patch_traces = 0;
-		c_pointcontents = 0;
 	}
 
 	Com_ReadFromPipe( );
 
+	Com_ScratchFrame();
+
 	com_frameNumber++;
 }
 
+/*
+=================
+Com_ForkLogfile
+
+Gives a forked process a log of its own, named like the shared one with
+the suffix before the extension. The next print opens it. Whatever the
+parent had buffered was written before the fork, see Sys_Fork
+=================
+*/
+void Com_ForkLogfile( const char *suffix ) {
+	char	base[MAX_QPATH];
+	const char	*ext;
+
+	if ( logfile ) {
+		FS_FCloseFile( logfile );
+		logfile = 0;
+	}
+
+	COM_StripExtension( com_logfileName->string, base, sizeof( base ) );
+	ext = COM_GetExtension( com_logfileName->string );
+	Com_sprintf( logfileName, sizeof( logfileName ), "%s%s%s%s", base, suffix, *ext ? "." : "", ext );
+}
+
 /*
 =================
 Com_Shutdown
 =================
 */
 void Com_Shutdown (void) {
+	Com_ShutdownWorkers();
+	Com_ShutdownScratch();
+	Com_DrainPrints();
+
 	if (logfile) {
 		FS_FCloseFile (logfile);
 		logfile = 0;
@@ -3357,6 +4007,22 @@ void Field_CompleteFilename( const char *dir,
 		FS_FilenameCompletion( dir, ext, stripExt, PrintMatches, searchUnpureDirs, searchUnpurePaks );
 }
 
+/*
+===============
+Field_CompleteMapName
+===============
+*/
+void Field_CompleteMapName( void )
+{
+	matchCount = 0;
+	shortestMatch[ 0 ] = 0;
+
+	FS_MapCompletion( completionString, FindMatches );
+
+	if( !Field_Complete( ) )
+		FS_MapCompletion( completionString, PrintMatches );
+}
+
 /*
 ===============
 Field_CompleteCommand
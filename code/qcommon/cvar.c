@@ -35,6 +35,17 @@ int			cvar_numIndexes;
 #define FILE_HASH_SIZE		256
 static	cvar_t	*hashTable[FILE_HASH_SIZE];
 
+#define MAX_CVAR_SUBSCRIPTIONS	64
+
+typedef struct {
+	cvar_t				*var;		// NULL for a subscription to flags
+	int					flags;
+	cvarChangeFunc_t	func;
+} cvarSubscription_t;
+
+static	cvarSubscription_t	cvar_subscriptions[MAX_CVAR_SUBSCRIPTIONS];
+static	int					cvar_numSubscriptions;
+
 /*
 ================
 return a hash value for the filename
@@ -56,6 +67,86 @@ static long generateHashValue( const char *fname ) {
 	return hash;
 }
 
+/*
+============
+Cvar_Subscribe
+
+Calls func whenever the value of var changes
+============
+*/
+void Cvar_Subscribe( cvar_t *var, cvarChangeFunc_t func ) {
+	cvarSubscription_t	*sub;
+
+	if ( cvar_numSubscriptions == MAX_CVAR_SUBSCRIPTIONS ) {
+		Com_Error( ERR_FATAL, "Cvar_Subscribe: MAX_CVAR_SUBSCRIPTIONS" );
+	}
+	sub = &cvar_subscriptions[cvar_numSubscriptions++];
+	sub->var = var;
+	sub->flags = 0;
+	sub->func = func;
+}
+
+/*
+============
+Cvar_SubscribeFlags
+
+Calls func whenever a cvar with any of flags changes, gets or loses
+one of them, is created with them or is unset
+============
+*/
+void Cvar_SubscribeFlags( int flags, cvarChangeFunc_t func ) {
+	cvarSubscription_t	*sub;
+
+	if ( cvar_numSubscriptions == MAX_CVAR_SUBSCRIPTIONS ) {
+		Com_Error( ERR_FATAL, "Cvar_SubscribeFlags: MAX_CVAR_SUBSCRIPTIONS" );
+	}
+	sub = &cvar_subscriptions[cvar_numSubscriptions++];
+	sub->var = NULL;
+	sub->flags = flags;
+	sub->func = func;
+}
+
+/*
+============
+Cvar_Unsubscribe
+
+Drops every subscription of func
+============
+*/
+void Cvar_Unsubscribe( cvarChangeFunc_t func ) {
+	int		i;
+
+	for ( i = 0 ; i < cvar_numSubscriptions ; ) {
+		if ( cvar_subscriptions[i].func == func ) {
+			cvar_subscriptions[i] = cvar_subscriptions[--cvar_numSubscriptions];
+		} else {
+			i++;
+		}
+	}
+}
+
+/*
+============
+Cvar_Notify
+
+flags are the groups the change concerns, the current flags of var
+may no longer have them
+============
+*/
+static void Cvar_Notify( cvar_t *var, int flags ) {
+	cvarSubscription_t	*sub;
+	int					i;
+
+	cvar_modifiedFlags |= flags;
+
+	for ( i = 0 ; i < cvar_numSubscriptions ; i++ ) {
+		sub = &cvar_subscriptions[i];
+		if ( sub->var == var || ( sub->flags & flags ) ) {
+			sub->func( var );
+		}
+	}
+}
+
 /*
 ============
 Cvar_ValidateString
@@ -311,6 +402,7 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, int flags ) {
 	cvar_t	*var;
 	long	hash;
 	int	index;
+	int	oldFlags;
 
 	if ( !var_name || ! var_value ) {
 		Com_Error( ERR_FATAL, "Cvar_Get: NULL parameter" );
@@ -378,6 +470,7 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, int flags ) {
 				flags &= ~CVAR_SERVER_CREATED;
 		}
 		
+		oldFlags = var->flags;
 		var->flags |= flags;
 
 		// only allow one non-empty reset string without a warning
@@ -402,6 +495,9 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, int flags ) {
 		// ZOID--needs to be set so that cvars the game sets as 
 		// SERVERINFO get sent to clients
 		cvar_modifiedFlags |= flags;
+		if ( var->flags & ~oldFlags ) {
+			Cvar_Notify( var, var->flags & ~oldFlags );
+		}
 
 		return var;
 	}
@@ -462,6 +558,8 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, int flags ) {
 	var->hashPrev = NULL;
 	hashTable[hash] = var;
 
+	Cvar_Notify( var, var->flags );
+
 	return var;
 }
 
@@ -617,6 +715,8 @@ cvar_t *Cvar_Set2( const char *var_name, const char *value, qboolean force ) {
 	var->value = atof (var->string);
 	var->integer = atoi (var->string);
 
+	Cvar_Notify( var, var->flags );
+
 	return var;
 }
 
@@ -880,19 +980,19 @@ void Cvar_Set_f( void ) {
 		case 'a':
 			if( !( v->flags & CVAR_ARCHIVE ) ) {
 				v->flags |= CVAR_ARCHIVE;
-				cvar_modifiedFlags |= CVAR_ARCHIVE;
+				Cvar_Notify( v, CVAR_ARCHIVE );
 			}
 			break;
 		case 'u':
 			if( !( v->flags & CVAR_USERINFO ) ) {
 				v->flags |= CVAR_USERINFO;
-				cvar_modifiedFlags |= CVAR_USERINFO;
+				Cvar_Notify( v, CVAR_USERINFO );
 			}
 			break;
 		case 's':
 			if( !( v->flags & CVAR_SERVERINFO ) ) {
 				v->flags |= CVAR_SERVERINFO;
-				cvar_modifiedFlags |= CVAR_SERVERINFO;
+				Cvar_Notify( v, CVAR_SERVERINFO );
 			}
 			break;
 	}
@@ -1121,9 +1221,21 @@ Unsets a cvar
 cvar_t *Cvar_Unset(cvar_t *cv)
 {
 	cvar_t *next = cv->next;
+	int flags = cv->flags;
+	int i;
 
 	// note what types of cvars have been modified (userinfo, archive, serverinfo, systeminfo)
-	cvar_modifiedFlags |= cv->flags;
+	cv->flags = 0;
+	Cvar_Notify(cv, flags);
+
+	// the slot will be reused by another cvar
+	for(i = 0; i < cvar_numSubscriptions; )
+	{
+		if(cvar_subscriptions[i].var == cv)
+			cvar_subscriptions[i] = cvar_subscriptions[--cvar_numSubscriptions];
+		else
+			i++;
+	}
 
 	if(cv->name)
 		Z_Free(cv->name);
@@ -1234,6 +1346,9 @@ void Cvar_Restart_f(void)
 	Cvar_Restart(qfalse);
 }
 
+// built up parsed, so each cvar isn't another pass over the string
+static infoString_t	cvar_info;
+
 /*
 =====================
 Cvar_InfoString
@@ -1244,14 +1359,15 @@ char *Cvar_InfoString(int bit)
 	static char	info[MAX_INFO_STRING];
 	cvar_t	*var;
 
-	info[0] = 0;
+	Info_Init(&cvar_info, MAX_INFO_STRING);
 
 	for(var = cvar_vars; var; var = var->next)
 	{
 		if(var->name && (var->flags & bit))
-			Info_SetValueForKey (info, var->name, var->string);
+			Info_Set(&cvar_info, var->name, var->string);
 	}
 
+	Q_strncpyz(info, Info_String(&cvar_info), sizeof(info));
 	return info;
 }
 
@@ -1267,13 +1383,15 @@ char *Cvar_InfoString_Big(int bit)
 	static char	info[BIG_INFO_STRING];
 	cvar_t	*var;
 
-	info[0] = 0;
+	Info_Init(&cvar_info, BIG_INFO_STRING);
 
 	for (var = cvar_vars; var; var = var->next)
 	{
 		if(var->name && (var->flags & bit))
-			Info_SetValueForKey_Big (info, var->name, var->string);
+			Info_Set(&cvar_info, var->name, var->string);
 	}
+
+	Q_strncpyz(info, Info_String(&cvar_info), sizeof(info));
 	return info;
 }
 
@@ -33,6 +33,10 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "qcommon.h"
 #include "unzip.h"
 
+#ifdef USE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
 /*
 =============================================================================
 
@@ -204,6 +208,13 @@ typedef struct {
 	qboolean		extrapure;					// if false, the pak will be excluded from the loaded paks
 	fileInPack_t*	*hashTable;					// hash table
 	fileInPack_t*	buildBuffer;				// buffer with the filenames etc.
+	byte			*mapData;					// the whole pk3 mapped, or NULL
+	int				mapLength;
+	int				*headerLongs;				// checksum feed and file CRCs
+	int				numHeaderLongs;
+	qboolean		indexed;					// goes into the pak index
+	int64_t			fileSize;
+	int64_t			fileTime;
 } pack_t;
 
 typedef struct {
@@ -236,6 +247,8 @@ static	cvar_t		*fs_gamedirvar;
 static	searchpath_t	*fs_searchpaths;
 static	cvar_t		*fs_lowPriorityDownloads;
 static	cvar_t		*fs_reorderPaks;
+static	cvar_t		*fs_mmapPaks;
+static	cvar_t		*fs_missingCacheMsec;
 static	int			fs_readCount;			// total bytes read
 static	int			fs_loadCount;			// total files read
 static	int			fs_loadStack;			// total files in memory
@@ -385,6 +398,110 @@ static fileHandle_t	FS_HandleForFile(void) {
 	return 0;
 }
 
+/*
+=================================================================================
+
+MISSING FILES
+
+Names FS_FOpenFileRead found nowhere on the search path, so asking again
+for an image extension or sound codec that isn't there doesn't go back to
+the disk for every directory. Anything that changes the search path or
+writes through the filesystem forgets them all, and each one is only
+trusted for fs_missingCacheMsec in case something outside the game puts
+the file there.
+=================================================================================
+*/
+
+#define	MAX_MISSING_FILES	1024
+#define	MISSING_HASH_SIZE	1024
+
+typedef struct missingFile_s {
+	char					name[MAX_QPATH];
+	int						time;
+	struct missingFile_s	*next;
+} missingFile_t;
+
+static missingFile_t	fs_missingFiles[MAX_MISSING_FILES];
+static missingFile_t	*fs_missingHash[MISSING_HASH_SIZE];
+static int				fs_numMissingFiles;
+
+/*
+=================
+FS_ForgetMissingFiles
+=================
+*/
+static void FS_ForgetMissingFiles( void ) {
+	if ( fs_numMissingFiles ) {
+		Com_Memset( fs_missingHash, 0, sizeof( fs_missingHash ) );
+		fs_numMissingFiles = 0;
+	}
+}
+
+/*
+=================
+FS_FindMissingFile
+=================
+*/
+static missingFile_t *FS_FindMissingFile( const char *filename ) {
+	missingFile_t	*missing;
+
+	for ( missing = fs_missingHash[FS_HashFileName( filename, MISSING_HASH_SIZE )] ; missing ; missing = missing->next ) {
+		if ( !FS_FilenameCompare( missing->name, filename ) ) {
+			return missing;
+		}
+	}
+	return NULL;
+}
+
+/*
+=================
+FS_IsMissingFile
+=================
+*/
+static qboolean FS_IsMissingFile( const char *filename ) {
+	missingFile_t	*missing;
+
+	if ( !fs_missingCacheMsec || fs_missingCacheMsec->integer <= 0 ) {
+		return qfalse;
+	}
+
+	missing = FS_FindMissingFile( filename );
+	if ( !missing ) {
+		return qfalse;
+	}
+	return Sys_Milliseconds() - missing->time < fs_missingCacheMsec->integer;
+}
+
+/*
+=================
+FS_AddMissingFile
+=================
+*/
+static void FS_AddMissingFile( const char *filename ) {
+	missingFile_t	*missing;
+	int				hash;
+
+	if ( !fs_missingCacheMsec || fs_missingCacheMsec->integer <= 0 ) {
+		return;
+	}
+	if ( strlen( filename ) >= MAX_QPATH ) {
+		return;
+	}
+
+	missing = FS_FindMissingFile( filename );
+	if ( !missing ) {
+		if ( fs_numMissingFiles == MAX_MISSING_FILES ) {
+			FS_ForgetMissingFiles();
+		}
+		missing = &fs_missingFiles[fs_numMissingFiles++];
+		Q_strncpyz( missing->name, filename, sizeof( missing->name ) );
+		hash = FS_HashFileName( filename, MISSING_HASH_SIZE );
+		missing->next = fs_missingHash[hash];
+		fs_missingHash[hash] = missing;
+	}
+	missing->time = Sys_Milliseconds();
+}
+
 static FILE	*FS_FileForHandle( fileHandle_t f ) {
 	if ( f < 1 || f >= MAX_FILE_HANDLES ) {
 		Com_Error( ERR_DROP, "FS_FileForHandle: out of range" );
@@ -539,11 +656,34 @@ qboolean FS_CreatePath (char *OSPath) {
 	return qfalse;
 }
 
+/*
+=================
+FS_InDirectory
+
+True if one of the directories in the path is called dir
+=================
+*/
+static qboolean FS_InDirectory( const char *path, const char *dir )
+{
+	int		len = strlen( dir );
+	const char	*s;
+
+	for( s = path; *s; s++ )
+	{
+		if( ( s == path || s[-1] == '/' || s[-1] == '\\' ) && !Q_stricmpn( s, dir, len )
+			&& ( s[len] == '/' || s[len] == '\\' ) )
+			return qtrue;
+	}
+
+	return qfalse;
+}
+
 /*
 =================
 FS_CheckFilenameIsMutable
 
-ERR_FATAL if trying to maniuplate a file with the platform library, QVM, or pk3 extension
+ERR_FATAL if trying to maniuplate a file with the platform library, QVM, or pk3 extension,
+or compiled QVM code
 =================
  */
 static void FS_CheckFilenameIsMutable( const char *filename,
@@ -552,11 +692,19 @@ static void FS_CheckFilenameIsMutable( const char *filename,
 	// Check if the filename ends with the library, QVM, or pk3 extension
 	if( Sys_DllExtension( filename )
 		|| COM_CompareExtension( filename, ".qvm" )
-		|| COM_CompareExtension( filename, ".pk3" ) )
+		|| COM_CompareExtension( filename, ".pk3" )
+		|| COM_CompareExtension( filename, ".jit" ) )
 	{
 		Com_Error( ERR_FATAL, "%s: Not allowed to manipulate '%s' due "
 			"to %s extension", function, filename, COM_GetExtension( filename ) );
 	}
+
+	// where compiled code was cached before
+	if( FS_InDirectory( filename, "vmcache" ) )
+	{
+		Com_Error( ERR_FATAL, "%s: Not allowed to manipulate '%s' in "
+			"vmcache/", function, filename );
+	}
 }
 
 /*
@@ -567,6 +715,7 @@ FS_Remove
 */
 void FS_Remove( const char *osPath ) {
 	FS_CheckFilenameIsMutable( osPath, __func__ );
+	FS_ForgetMissingFiles();
 
 	remove( osPath );
 }
@@ -579,6 +728,7 @@ FS_HomeRemove
 */
 void FS_HomeRemove( const char *homePath ) {
 	FS_CheckFilenameIsMutable( homePath, __func__ );
+	FS_ForgetMissingFiles();
 
 	remove( FS_BuildOSPath( fs_homepath->string,
 			fs_gamedir, homePath ) );
@@ -664,6 +814,7 @@ fileHandle_t FS_SV_FOpenFileWrite( const char *filename ) {
 	}
 
 	FS_CheckFilenameIsMutable( ospath, __func__ );
+	FS_ForgetMissingFiles();
 
 	if( FS_CreatePath( ospath ) ) {
 		return 0;
@@ -681,6 +832,49 @@ fileHandle_t FS_SV_FOpenFileWrite( const char *filename ) {
 	return f;
 }
 
+/*
+===========
+FS_SV_FOpenFileAppend
+
+Like FS_SV_FOpenFileWrite, but keeps what is already in the file
+===========
+*/
+fileHandle_t FS_SV_FOpenFileAppend( const char *filename ) {
+	char *ospath;
+	fileHandle_t	f;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+
+	ospath = FS_BuildOSPath( fs_homepath->string, filename, "" );
+	ospath[strlen(ospath)-1] = '\0';
+
+	f = FS_HandleForFile();
+	fsh[f].zipFile = qfalse;
+
+	if ( fs_debug->integer ) {
+		Com_Printf( "FS_SV_FOpenFileAppend: %s\n", ospath );
+	}
+
+	FS_CheckFilenameIsMutable( ospath, __func__ );
+	FS_ForgetMissingFiles();
+
+	if( FS_CreatePath( ospath ) ) {
+		return 0;
+	}
+
+	fsh[f].handleFiles.file.o = Sys_FOpen( ospath, "ab" );
+
+	Q_strncpyz( fsh[f].name, filename, sizeof( fsh[f].name ) );
+
+	fsh[f].handleSync = qfalse;
+	if (!fsh[f].handleFiles.file.o) {
+		f = 0;
+	}
+	return f;
+}
+
 /*
 ===========
 FS_SV_FOpenFileRead
@@ -808,6 +1002,7 @@ void FS_SV_Rename( const char *from, const char *to, qboolean safe ) {
 	if ( safe ) {
 		FS_CheckFilenameIsMutable( to_ospath, __func__ );
 	}
+	FS_ForgetMissingFiles();
 
 	rename(from_ospath, to_ospath);
 }
@@ -838,6 +1033,7 @@ void FS_Rename( const char *from, const char *to ) {
 	}
 
 	FS_CheckFilenameIsMutable( to_ospath, __func__ );
+	FS_ForgetMissingFiles();
 
 	rename(from_ospath, to_ospath);
 }
@@ -897,6 +1093,7 @@ fileHandle_t FS_FOpenFileWrite( const char *filename ) {
 	}
 
 	FS_CheckFilenameIsMutable( ospath, __func__ );
+	FS_ForgetMissingFiles();
 
 	if( FS_CreatePath( ospath ) ) {
 		return 0;
@@ -945,6 +1142,7 @@ fileHandle_t FS_FOpenFileAppend( const char *filename ) {
 	}
 
 	FS_CheckFilenameIsMutable( ospath, __func__ );
+	FS_ForgetMissingFiles();
 
 	if( FS_CreatePath( ospath ) ) {
 		return 0;
@@ -958,6 +1156,67 @@ fileHandle_t FS_FOpenFileAppend( const char *filename ) {
 	return f;
 }
 
+/*
+===========
+FS_FOpenRawFile
+
+Like FS_FOpenFileWrite and FS_FOpenFileAppend, but hands out the FILE
+itself so it can be written from another thread and outlives filesystem
+restarts. The caller fcloses it.
+===========
+*/
+static FILE *FS_FOpenRawFile( const char *filename, const char *mode, const char *function ) {
+	char	*ospath;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+
+	ospath = FS_BuildOSPath( fs_homepath->string, fs_gamedir, filename );
+
+	if ( fs_debug->integer ) {
+		Com_Printf( "%s: %s\n", function, ospath );
+	}
+
+	FS_CheckFilenameIsMutable( ospath, function );
+	FS_ForgetMissingFiles();
+
+	if( FS_CreatePath( ospath ) ) {
+		return NULL;
+	}
+
+	return Sys_FOpen( ospath, mode );
+}
+
+FILE *FS_FOpenRawFileWrite( const char *filename ) {
+	return FS_FOpenRawFile( filename, "wb", __func__ );
+}
+
+FILE *FS_FOpenRawFileAppend( const char *filename ) {
+	return FS_FOpenRawFile( filename, "ab", __func__ );
+}
+
+/*
+===========
+FS_SV_FOpenRawFileRead
+
+Searches like FS_SV_FOpenFileRead, but hands out the FILE itself so it
+can be read from another thread. The caller fcloses it.
+===========
+*/
+FILE *FS_SV_FOpenRawFileRead( const char *filename ) {
+	fileHandle_t	f;
+	FILE			*file;
+
+	if ( FS_SV_FOpenFileRead( filename, &f ) < 0 ) {
+		return NULL;
+	}
+
+	file = fsh[f].handleFiles.file.o;
+	Com_Memset( &fsh[f], 0, sizeof( fsh[f] ) );
+	return file;
+}
+
 /*
 ===========
 FS_FCreateOpenPipeFile
@@ -988,6 +1247,7 @@ fileHandle_t FS_FCreateOpenPipeFile( const char *filename ) {
 	}
 
 	FS_CheckFilenameIsMutable( ospath, __func__ );
+	FS_ForgetMissingFiles();
 
 	fifo = Sys_Mkfifo( ospath );
 	if( fifo ) {
@@ -1098,6 +1358,89 @@ qboolean FS_IsDemoExt(const char *filename, int namelen)
 	return qfalse;
 }
 
+/*
+=================
+FS_UnzOpen
+
+Opens a zip through its mapping when there is one, so reading from it
+takes no syscalls and inflates straight from the mapped file
+=================
+*/
+static unzFile FS_UnzOpen( const char *zipfile, const byte *mapData, int mapLength )
+{
+	zlib_filefunc_def	funcs;
+	zlib_memory_file	memory;
+
+	if ( !mapData ) {
+		return unzOpen( zipfile );
+	}
+
+	memory.base = mapData;
+	memory.size = mapLength;
+	fill_memory_filefunc( &funcs, &memory );
+
+	return unzOpen2( zipfile, &funcs );
+}
+
+/*
+=================
+FS_MapPak
+
+Maps a pk3 unless fs_mmapPaks is off. A page of the mapping that a file
+lost by shrinking faults with SIGBUS where a read would fail, so paks under
+fs_homepath, which downloads and updates rewrite while the game runs, are
+read through a FILE. A size other than 0 is the one the central directory
+was read at, a pak that changed since isn't mapped either
+=================
+*/
+static byte *FS_MapPak( const char *zipfile, int64_t size, int *length )
+{
+	byte	*data;
+	int		homeLength;
+
+	*length = 0;
+
+	if ( !fs_mmapPaks || !fs_mmapPaks->integer ) {
+		return NULL;
+	}
+
+	homeLength = strlen( fs_homepath->string );
+	if ( homeLength && !Q_stricmpn( zipfile, fs_homepath->string, homeLength )
+		&& ( zipfile[homeLength] == '/' || zipfile[homeLength] == '\\' ) ) {
+		return NULL;
+	}
+
+	data = Sys_MapFile( zipfile, length );
+	if ( data && size && *length != size ) {
+		Sys_UnmapFile( data, *length );
+		*length = 0;
+		return NULL;
+	}
+
+	return data;
+}
+
+/*
+=================
+FS_PakHandle
+
+Paks that came from the index are only opened once something is read from them
+=================
+*/
+static unzFile FS_PakHandle(pack_t *pack)
+{
+	if ( pack->handle ) {
+		return pack->handle;
+	}
+
+	if ( !pack->mapData ) {
+		pack->mapData = FS_MapPak( pack->pakFilename, pack->fileSize, &pack->mapLength );
+	}
+
+	pack->handle = FS_UnzOpen( pack->pakFilename, pack->mapData, pack->mapLength );
+	return pack->handle;
+}
+
 /*
 ===========
 FS_FOpenFileReadDir
@@ -1279,10 +1622,13 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
 					if(strstr(filename, "ui.qvm"))
 						pak->referenced |= FS_UI_REF;
 
+					if(!FS_PakHandle(pak))
+						Com_Error(ERR_FATAL, "Couldn't open %s", pak->pakFilename);
+
 					if(uniqueFILE)
 					{
 						// open a new file on the pakfile
-						fsh[*file].handleFiles.file.z = unzOpen(pak->pakFilename);
+						fsh[*file].handleFiles.file.z = FS_UnzOpen(pak->pakFilename, pak->mapData, pak->mapLength);
 
 						if(fsh[*file].handleFiles.file.z == NULL)
 							Com_Error(ERR_FATAL, "Couldn't open %s", pak->pakFilename);
@@ -1368,61 +1714,260 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
 }
 
 /*
-===========
-FS_FOpenFileRead
+=================================================================================
 
-Finds the file in the search path.
-Returns filesize and an open FILE pointer.
-Used for streaming data out of either a
-separate file or a ZIP file.
-===========
+FILE INDEX
+
+One hash table over the files of all paks on the search path, so
+FS_FOpenFileRead doesn't have to probe every pak for a name. Every
+entry knows the position of its pak in the search path, and entries
+for the same name are chained in search path order. A lookup merges
+them with the directories on the search path, which can't be indexed,
+and tries only those with FS_FOpenFileReadDir as before, so pure
+checks and all the other rules still apply.
+
+The index is thrown away whenever the search path changes and rebuilt
+by the next lookup.
+=================================================================================
 */
-long FS_FOpenFileRead(const char *filename, fileHandle_t *file, qboolean uniqueFILE)
-{
-	searchpath_t *search;
-	long len;
 
-	if(!fs_searchpaths)
-		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+typedef struct {
+	fileInPack_t	*file;
+	searchpath_t	*search;
+	int				order;		// position on the search path
+	int				next;		// next entry in the bucket, in search path order
+} fileIndexEntry_t;
 
-	for(search = fs_searchpaths; search; search = search->next)
-	{
-		len = FS_FOpenFileReadDir(filename, search, file, uniqueFILE, qfalse);
+typedef struct {
+	searchpath_t	*search;
+	int				order;
+} fileIndexDir_t;
 
-		if(file == NULL)
-		{
-			if(len > 0)
-				return len;
-		}
-		else
-		{
-			if(len >= 0 && *file)
-				return len;
-		}
+static fileIndexEntry_t	*fs_fileIndex;
+static int				*fs_fileIndexHash;
+static int				fs_fileIndexHashSize;
+static fileIndexDir_t	*fs_fileIndexDirs;
+static int				fs_numFileIndexDirs;
 
-	}
-	
-#ifdef FS_MISSING
-	if(missingFiles)
-		fprintf(missingFiles, "%s\n", filename);
-#endif
+/*
+=================
+FS_InvalidateFileIndex
+=================
+*/
+static void FS_InvalidateFileIndex( void ) {
+	FS_ForgetMissingFiles();
+
+	if ( fs_fileIndex ) {
+		Z_Free( fs_fileIndex );
+		Z_Free( fs_fileIndexHash );
+		Z_Free( fs_fileIndexDirs );
+	}
+	fs_fileIndex = NULL;
+	fs_fileIndexHash = NULL;
+	fs_fileIndexHashSize = 0;
+	fs_fileIndexDirs = NULL;
+	fs_numFileIndexDirs = 0;
+}
 
-	if(file)
-	{
-		*file = 0;
-		return -1;
-	}
-	else
-	{
-		// When file is NULL, we're querying the existence of the file
-		// If we've got here, it doesn't exist
-		return 0;
+/*
+=================
+FS_FileIndexHash
+
+Agrees with FS_FilenameCompare on what is the same name
+=================
+*/
+static int FS_FileIndexHash( const char *name ) {
+	unsigned int	hash;
+	int				c;
+
+	hash = 5381;
+	while ( ( c = *name++ ) != '\0' ) {
+		if ( c >= 'a' && c <= 'z' ) {
+			c -= ( 'a' - 'A' );
+		}
+		if ( c == '\\' || c == ':' ) {
+			c = '/';
+		}
+		hash = hash * 33 + c;
 	}
+	return hash & ( fs_fileIndexHashSize - 1 );
 }
 
 /*
 =================
-FS_FindVM
+FS_BuildFileIndex
+=================
+*/
+static void FS_BuildFileIndex( void ) {
+	searchpath_t	*search, **searches;
+	int				numSearches, numFiles, numDirs;
+	int				i, j, n, hash;
+	pack_t			*pak;
+
+	FS_InvalidateFileIndex();
+
+	numSearches = numFiles = numDirs = 0;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		numSearches++;
+		if ( search->pack ) {
+			numFiles += search->pack->numfiles;
+		} else if ( search->dir ) {
+			numDirs++;
+		}
+	}
+
+	for ( fs_fileIndexHashSize = 1024 ; fs_fileIndexHashSize < numFiles ; fs_fileIndexHashSize <<= 1 ) {
+	}
+
+	fs_fileIndex = Z_Malloc( numFiles * sizeof( *fs_fileIndex ) + 1 );
+	fs_fileIndexHash = Z_Malloc( fs_fileIndexHashSize * sizeof( *fs_fileIndexHash ) );
+	fs_fileIndexDirs = Z_Malloc( numDirs * sizeof( *fs_fileIndexDirs ) + 1 );
+	for ( i = 0 ; i < fs_fileIndexHashSize ; i++ ) {
+		fs_fileIndexHash[i] = -1;
+	}
+
+	searches = Z_Malloc( numSearches * sizeof( *searches ) + 1 );
+	for ( i = 0, search = fs_searchpaths ; search ; search = search->next, i++ ) {
+		searches[i] = search;
+		if ( !search->pack && search->dir ) {
+			fs_fileIndexDirs[fs_numFileIndexDirs].search = search;
+			fs_fileIndexDirs[fs_numFileIndexDirs].order = i;
+			fs_numFileIndexDirs++;
+		}
+	}
+
+	// insert from the back, so the buckets end up in search path order
+	n = 0;
+	for ( i = numSearches - 1 ; i >= 0 ; i-- ) {
+		pak = searches[i]->pack;
+		if ( !pak ) {
+			continue;
+		}
+		for ( j = pak->numfiles - 1 ; j >= 0 ; j-- ) {
+			hash = FS_FileIndexHash( pak->buildBuffer[j].name );
+			fs_fileIndex[n].file = &pak->buildBuffer[j];
+			fs_fileIndex[n].search = searches[i];
+			fs_fileIndex[n].order = i;
+			fs_fileIndex[n].next = fs_fileIndexHash[hash];
+			fs_fileIndexHash[hash] = n;
+			n++;
+		}
+	}
+
+	Z_Free( searches );
+}
+
+/*
+=================
+FS_FileIndexNext
+
+Next entry from e on called filename, or -1
+=================
+*/
+static int FS_FileIndexNext( int e, const char *filename ) {
+	while ( e != -1 && FS_FilenameCompare( fs_fileIndex[e].file->name, filename ) ) {
+		e = fs_fileIndex[e].next;
+	}
+	return e;
+}
+
+/*
+===========
+FS_FOpenFileRead
+
+Finds the file in the search path.
+Returns filesize and an open FILE pointer.
+Used for streaming data out of either a
+separate file or a ZIP file.
+===========
+*/
+long FS_FOpenFileRead(const char *filename, fileHandle_t *file, qboolean uniqueFILE)
+{
+	searchpath_t *search, *lastSearch;
+	const char *name;
+	long len;
+	int e, d;
+
+	if(!fs_searchpaths)
+		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+
+	if(filename == NULL)
+		Com_Error(ERR_FATAL, "FS_FOpenFileRead: NULL 'filename' parameter passed");
+
+	if(!fs_fileIndex)
+		FS_BuildFileIndex();
+
+	// FS_FOpenFileReadDir does the same
+	name = filename;
+	if(name[0] == '/' || name[0] == '\\')
+		name++;
+
+	if(FS_IsMissingFile(name))
+		goto missing;
+
+	e = FS_FileIndexNext(fs_fileIndexHash[FS_FileIndexHash(name)], name);
+	d = 0;
+	lastSearch = NULL;
+
+	// only the dirs and the paks that have the file, in search path order
+	while(d < fs_numFileIndexDirs || e != -1)
+	{
+		if(d < fs_numFileIndexDirs && (e == -1 || fs_fileIndexDirs[d].order < fs_fileIndex[e].order))
+		{
+			search = fs_fileIndexDirs[d++].search;
+		}
+		else
+		{
+			search = fs_fileIndex[e].search;
+			e = FS_FileIndexNext(fs_fileIndex[e].next, name);
+
+			// a pak with the same name twice
+			if(search == lastSearch)
+				continue;
+		}
+		lastSearch = search;
+
+		len = FS_FOpenFileReadDir(filename, search, file, uniqueFILE, qfalse);
+
+		if(file == NULL)
+		{
+			if(len > 0)
+				return len;
+		}
+		else
+		{
+			if(len >= 0 && *file)
+				return len;
+		}
+
+	}
+
+	// an existence query also misses files that are there but empty
+	if(file)
+		FS_AddMissingFile(name);
+
+missing:
+#ifdef FS_MISSING
+	if(missingFiles)
+		fprintf(missingFiles, "%s\n", filename);
+#endif
+
+	if(file)
+	{
+		*file = 0;
+		return -1;
+	}
+	else
+	{
+		// When file is NULL, we're querying the existence of the file
+		// If we've got here, it doesn't exist
+		return 0;
+	}
+}
+
+/*
+=================
+FS_FindVM
 
 Find a suitable VM file in search path order.
 
@@ -1797,6 +2342,303 @@ int	FS_FileIsInPAK(const char *filename, int *pChecksum ) {
 	return -1;
 }
 
+/*
+==============
+FS_PakFileCrc
+
+Opens filename the way FS_ReadFile would, which references its pak all
+the same, and gives the CRC32 and length its pk3 records for it, so a
+caller can tell that a copy it kept is still what would be read. Returns
+qfalse for files that aren't read from a pk3.
+==============
+*/
+qboolean FS_PakFileCrc( const char *filename, unsigned *crc, int *len ) {
+	fileHandle_t	h;
+	unz_file_info	info;
+	qboolean		found;
+
+	*len = FS_FOpenFileRead( filename, &h, qfalse );
+	if ( !h ) {
+		return qfalse;
+	}
+
+	found = fsh[h].zipFile && unzGetCurrentFileInfo( fsh[h].handleFiles.file.z,
+		&info, NULL, 0, NULL, 0, NULL, 0 ) == UNZ_OK;
+	if ( found ) {
+		*crc = info.crc;
+	}
+
+	FS_FCloseFile( h );
+	return found;
+}
+
+/*
+Big pk3 entries, BSPs and AAS files, are read by FS_ReadFileDir with one
+inflate of the whole entry straight into the buffer that is handed back,
+from the memory map when the pk3 is mapped. With USE_LIBDEFLATE that
+inflate goes through libdeflate.
+
+A pk3 we repack ourselves can also store an entry as deflate chunks that
+each start from an empty dictionary, so every chunk inflates on its own
+and they are spread over the worker threads. The entry is still an
+ordinary deflate stream, with a full flush between chunks, so any unzip
+reads it. The local header of such an entry has an extra field, all of
+it little endian:
+	uint16	FS_CHUNK_EXTRA_ID
+	uint16	size of what follows, 8 + 4 * numChunks
+	uint32	chunkSize, what every chunk but the last one inflates to
+	uint32	numChunks
+	uint32	offset of each chunk in the compressed data, the first one 0
+*/
+
+#define FS_CHUNK_EXTRA_ID	0x4351		// "QC"
+
+typedef struct {
+	const byte	*src;
+	int			srcLen;
+	byte		*dst;
+	int			dstLen;
+	int			chunkSize;
+	int			numChunks;
+	const byte	*offsets;				// in the extra field
+	qboolean	failed;
+} fsInflate_t;
+
+/*
+=================
+FS_ExtraLong
+=================
+*/
+static int FS_ExtraLong( const byte *p ) {
+	return p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) | ( (unsigned)p[3] << 24 );
+}
+
+/*
+=================
+FS_Inflate
+
+Inflates exactly dstLen bytes, the data doesn't have to be the end of the
+deflate stream. Safe to call from a worker.
+=================
+*/
+static qboolean FS_Inflate( const byte *src, int srcLen, byte *dst, int dstLen ) {
+	z_stream	stream;
+	int			err;
+
+	Com_Memset( &stream, 0, sizeof( stream ) );
+	if ( inflateInit2( &stream, -MAX_WBITS ) != Z_OK ) {
+		return qfalse;
+	}
+
+	stream.next_in = (Bytef *)src;
+	stream.avail_in = srcLen;
+	stream.next_out = dst;
+	stream.avail_out = dstLen;
+
+	err = inflate( &stream, Z_SYNC_FLUSH );
+	inflateEnd( &stream );
+
+	if ( err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR ) {
+		return qfalse;
+	}
+
+	return stream.avail_out == 0;
+}
+
+/*
+=================
+FS_InflateEntry
+
+Also what the renderer inflates PNG data with.
+=================
+*/
+qboolean FS_InflateEntry( const byte *src, int srcLen, byte *dst, int dstLen ) {
+#ifdef USE_LIBDEFLATE
+	struct libdeflate_decompressor	*decompressor;
+	enum libdeflate_result			result;
+	size_t							actual;
+
+	decompressor = libdeflate_alloc_decompressor();
+	if ( decompressor ) {
+		result = libdeflate_deflate_decompress( decompressor, src, srcLen, dst, dstLen, &actual );
+		libdeflate_free_decompressor( decompressor );
+
+		return result == LIBDEFLATE_SUCCESS && actual == dstLen;
+	}
+#endif
+
+	return FS_Inflate( src, srcLen, dst, dstLen );
+}
+
+/*
+=================
+FS_InflateChunk
+=================
+*/
+static void FS_InflateChunk( void *data, int index ) {
+	fsInflate_t	*inf = data;
+	int			start, end, out, outLen;
+
+	start = FS_ExtraLong( inf->offsets + index * 4 );
+	if ( index == inf->numChunks - 1 ) {
+		end = inf->srcLen;
+	} else {
+		end = FS_ExtraLong( inf->offsets + ( index + 1 ) * 4 );
+	}
+
+	out = index * inf->chunkSize;
+	outLen = index == inf->numChunks - 1 ? inf->dstLen - out : inf->chunkSize;
+
+	if ( !FS_Inflate( inf->src + start, end - start, inf->dst + out, outLen ) ) {
+		inf->failed = qtrue;
+	}
+}
+
+/*
+=================
+FS_ChunkTable
+
+Looks for a chunk table in the local extra field and checks it against the
+entry, qfalse when there is none or it doesn't fit
+=================
+*/
+static qboolean FS_ChunkTable( const byte *extra, int extraLen, fsInflate_t *inf ) {
+	int		id, size, prev, offset;
+	int		i;
+
+	while ( extraLen >= 4 ) {
+		id = extra[0] | ( extra[1] << 8 );
+		size = extra[2] | ( extra[3] << 8 );
+		extra += 4;
+		extraLen -= 4;
+
+		if ( size > extraLen ) {
+			return qfalse;
+		}
+
+		if ( id == FS_CHUNK_EXTRA_ID && size >= 8 ) {
+			inf->chunkSize = FS_ExtraLong( extra );
+			inf->numChunks = FS_ExtraLong( extra + 4 );
+			inf->offsets = extra + 8;
+
+			if ( inf->chunkSize <= 0 || inf->numChunks < 1 || size != 8 + 4 * inf->numChunks ) {
+				return qfalse;
+			}
+			if ( inf->dstLen <= 0 || ( inf->dstLen - 1 ) / inf->chunkSize + 1 != inf->numChunks ) {
+				return qfalse;
+			}
+
+			prev = -1;
+			for ( i = 0 ; i < inf->numChunks ; i++ ) {
+				offset = FS_ExtraLong( inf->offsets + i * 4 );
+				if ( offset <= prev || offset >= inf->srcLen || ( !i && offset ) ) {
+					return qfalse;
+				}
+				prev = offset;
+			}
+
+			return qtrue;
+		}
+
+		extra += size;
+		extraLen -= size;
+	}
+
+	return qfalse;
+}
+
+/*
+=================
+FS_ReadZipEntry
+
+Reads all of the pk3 entry just opened on f into buf, returns qfalse
+without having read anything when it has to go through FS_Read
+=================
+*/
+static qboolean FS_ReadZipEntry( fileHandle_t f, byte *buf, int len ) {
+	unzFile		z;
+	uLong		compressedSize, uncompressedSize;
+	int			method, extraLen;
+	byte		*compressed, *extra;
+	fsInflate_t	inf;
+	qboolean	ok;
+
+	z = fsh[f].handleFiles.file.z;
+
+	if ( unzGetCurrentFileData( z, &method, &compressedSize, &uncompressedSize ) != UNZ_OK ) {
+		return qfalse;
+	}
+	if ( uncompressedSize != len || compressedSize > 0x7fffffff ) {
+		return qfalse;
+	}
+
+	inf.src = unzMapCurrentFile( z );
+	inf.srcLen = compressedSize;
+	inf.dst = buf;
+	inf.dstLen = len;
+	inf.failed = qfalse;
+
+	if ( method == 0 ) {
+		if ( compressedSize != len ) {
+			return qfalse;
+		}
+		if ( inf.src ) {
+			Com_Memcpy( buf, inf.src, len );
+		} else if ( unzReadCurrentFileRaw( z, buf, len ) != UNZ_OK ) {
+			return qfalse;
+		}
+		fs_readCount += len;
+		return qtrue;
+	}
+
+	if ( method != Z_DEFLATED ) {
+		return qfalse;
+	}
+
+	compressed = NULL;
+	if ( !inf.src ) {
+		compressed = Hunk_AllocateTempMemory( inf.srcLen + 1 );
+		if ( unzReadCurrentFileRaw( z, compressed, inf.srcLen ) != UNZ_OK ) {
+			Hunk_FreeTempMemory( compressed );
+			return qfalse;
+		}
+		inf.src = compressed;
+	}
+
+	extra = NULL;
+	extraLen = unzGetLocalExtrafield( z, NULL, 0 );
+	if ( extraLen >= 4 + 8 + 4 ) {
+		extra = Z_Malloc( extraLen );
+		if ( unzGetLocalExtrafield( z, extra, extraLen ) != extraLen ) {
+			extraLen = 0;
+		}
+	}
+
+	// a chunk table that doesn't add up is ignored, the entry is plain
+	// deflate either way
+	if ( extra && FS_ChunkTable( extra, extraLen, &inf ) ) {
+		Com_RunParallel( FS_InflateChunk, &inf, inf.numChunks );
+		ok = !inf.failed;
+	} else {
+		ok = FS_InflateEntry( inf.src, inf.srcLen, buf, len );
+	}
+
+	if ( extra ) {
+		Z_Free( extra );
+	}
+	if ( compressed ) {
+		Hunk_FreeTempMemory( compressed );
+	}
+
+	if ( !ok ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: couldn't inflate %s\n", fsh[f].name );
+		return qfalse;
+	}
+
+	fs_readCount += len;
+	return qtrue;
+}
+
 /*
 ============
 FS_ReadFileDir
@@ -1912,7 +2754,9 @@ long FS_ReadFileDir(const char *qpath, void *searchPath, qboolean unpure, void *
 	buf = Hunk_AllocateTempMemory(len+1);
 	*buffer = buf;
 
-	FS_Read (buf, len, h);
+	if ( !fsh[h].zipFile || !FS_ReadZipEntry( h, buf, len ) ) {
+		FS_Read (buf, len, h);
+	}
 
 	// guarantee that it will have a trailing 0 for string operations
 	buf[len] = 0;
@@ -1992,48 +2836,361 @@ void FS_WriteFile( const char *qpath, const void *buffer, int size ) {
 	FS_FCloseFile( f );
 }
 
-
-
 /*
 ==========================================================================
 
-ZIP FILE LOADING
+PRIVATE CACHE FILES
+
+Compiled code and driver binaries are kept in fs_homepath/cache/, out of
+every game directory, so nothing the game modules write can end up there.
+Each file ends with an HMAC of its name and contents, keyed by the random
+cache/key made on first use, and only files that carry it are read back.
 
 ==========================================================================
 */
 
+#define FS_CACHE_DIR		"cache"
+#define FS_CACHE_KEY		"key"
+#define FS_CACHE_KEY_LENGTH	32
+#define FS_CACHE_MAC_LENGTH	16
+
+static byte		fs_cacheKey[FS_CACHE_KEY_LENGTH];
+static qboolean	fs_cacheKeyLoaded;
+
 /*
-=================
-FS_LoadZipFile
+============
+FS_CacheKey
 
-Creates a new pak_t in the search chain for the contents
-of a zip file.
-=================
+Reads the key of the cache, or makes one
+============
 */
-static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename, const char *gamename)
+static qboolean FS_CacheKey( void ) {
+	char		*ospath;
+	qboolean	loaded;
+	FILE		*f;
+
+	if ( fs_cacheKeyLoaded ) {
+		return qtrue;
+	}
+
+	ospath = FS_BuildOSPath( fs_homepath->string, FS_CACHE_DIR, FS_CACHE_KEY );
+
+	f = Sys_FOpenPrivate( ospath );
+	if ( f ) {
+		loaded = fread( fs_cacheKey, sizeof( fs_cacheKey ), 1, f ) == 1 ? qtrue : qfalse;
+		fclose( f );
+		fs_cacheKeyLoaded = loaded;
+		return loaded;
+	}
+
+	if ( FS_CreatePath( ospath ) ) {
+		return qfalse;
+	}
+
+	// another process may be making one at the same time
+	f = Sys_FCreate( ospath );
+	if ( !f ) {
+		return qfalse;
+	}
+
+	Com_RandomBytes( fs_cacheKey, sizeof( fs_cacheKey ) );
+	loaded = fwrite( fs_cacheKey, sizeof( fs_cacheKey ), 1, f ) == 1 ? qtrue : qfalse;
+	if ( fclose( f ) ) {
+		loaded = qfalse;
+	}
+	if ( !loaded ) {
+		remove( ospath );
+	}
+
+	fs_cacheKeyLoaded = loaded;
+	return loaded;
+}
+
+/*
+============
+FS_ReadCacheFile
+
+Filename is relative to the cache directory, -1 if the file is missing or
+wasn't written by FS_WriteCacheFile. Free the buffer with FS_FreeFile
+============
+*/
+long FS_ReadCacheFile( const char *name, void **buffer ) {
+	byte	mac[FS_CACHE_MAC_LENGTH];
+	byte	*buf;
+	FILE	*f;
+	long	len;
+
+	*buffer = NULL;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+
+	if ( FS_CheckDirTraversal( name ) || !FS_CacheKey() ) {
+		return -1;
+	}
+
+	f = Sys_FOpenPrivate( FS_BuildOSPath( fs_homepath->string, FS_CACHE_DIR, name ) );
+	if ( !f ) {
+		return -1;
+	}
+
+	if ( fseek( f, 0, SEEK_END ) || ( len = ftell( f ) ) < FS_CACHE_MAC_LENGTH
+		|| fseek( f, 0, SEEK_SET ) ) {
+		fclose( f );
+		return -1;
+	}
+
+	buf = Hunk_AllocateTempMemory( len + 1 );
+	if ( fread( buf, len, 1, f ) != 1 ) {
+		fclose( f );
+		Hunk_FreeTempMemory( buf );
+		return -1;
+	}
+	fclose( f );
+
+	len -= FS_CACHE_MAC_LENGTH;
+	Com_HMACMD5( fs_cacheKey, sizeof( fs_cacheKey ), name, strlen( name ), buf, len, mac );
+	if ( memcmp( mac, buf + len, sizeof( mac ) ) ) {
+		Com_DPrintf( "FS_ReadCacheFile: %s wasn't written here\n", name );
+		Hunk_FreeTempMemory( buf );
+		return -1;
+	}
+
+	fs_loadCount++;
+	fs_loadStack++;
+
+	buf[len] = 0;
+	*buffer = buf;
+	return len;
+}
+
+/*
+============
+FS_WriteCacheFile
+
+Filename is relative to the cache directory. The file is written aside and
+renamed, so it's never seen half written
+============
+*/
+qboolean FS_WriteCacheFile( const char *name, const void *buffer, int size ) {
+	char		ospath[MAX_OSPATH], tempPath[MAX_OSPATH];
+	byte		mac[FS_CACHE_MAC_LENGTH];
+	qboolean	written;
+	FILE		*f;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+
+	if ( FS_CheckDirTraversal( name ) || !FS_CacheKey() ) {
+		return qfalse;
+	}
+
+	Q_strncpyz( ospath, FS_BuildOSPath( fs_homepath->string, FS_CACHE_DIR, name ), sizeof( ospath ) );
+	Com_sprintf( tempPath, sizeof( tempPath ), "%s.%i", ospath, Sys_Milliseconds() );
+	if ( FS_CreatePath( tempPath ) ) {
+		return qfalse;
+	}
+
+	f = Sys_FCreate( tempPath );
+	if ( !f ) {
+		return qfalse;
+	}
+
+	Com_HMACMD5( fs_cacheKey, sizeof( fs_cacheKey ), name, strlen( name ), buffer, size, mac );
+	written = fwrite( buffer, size, 1, f ) == 1 && fwrite( mac, sizeof( mac ), 1, f ) == 1;
+	if ( fclose( f ) ) {
+		written = qfalse;
+	}
+
+	if ( written ) {
+		remove( ospath );
+		written = !rename( tempPath, ospath );
+	}
+	if ( !written ) {
+		remove( tempPath );
+		Com_DPrintf( "FS_WriteCacheFile: couldn't write %s\n", ospath );
+	}
+
+	return written;
+}
+
+
+
+/*
+==========================================================================
+
+ZIP FILE LOADING
+
+==========================================================================
+*/
+
+/*
+=================
+FS_AllocPack
+
+Sets up an empty pack for numfiles files with namesLength bytes of names
+=================
+*/
+static pack_t *FS_AllocPack(const char *zipfile, const char *basename, const char *gamename, int numfiles, int namesLength)
+{
+	pack_t			*pack;
+	char			*download;
+	int				i;
+
+	// get the hash table size from the number of files in the zip
+	// because lots of custom pk3 files have less than 32 or 64 files
+	for (i = 1; i <= MAX_FILEHASH_SIZE; i <<= 1) {
+		if (i > numfiles) {
+			break;
+		}
+	}
+
+	pack = Z_Malloc( sizeof( pack_t ) + i * sizeof(fileInPack_t *) );
+	pack->hashSize = i;
+	pack->hashTable = (fileInPack_t **) (((char *) pack) + sizeof( pack_t ));
+	for(i = 0; i < pack->hashSize; i++) {
+		pack->hashTable[i] = NULL;
+	}
+
+	pack->buildBuffer = Z_Malloc( (numfiles * sizeof( fileInPack_t )) + namesLength );
+	pack->numfiles = numfiles;
+	pack->headerLongs = Z_Malloc( ( numfiles + 1 ) * sizeof(int) );
+
+	Q_strncpyz( pack->pakFilename, zipfile, sizeof( pack->pakFilename ) );
+	Q_strncpyz( pack->pakBasename, basename, sizeof( pack->pakBasename ) );
+	Q_strncpyz( pack->pakGamename, gamename, sizeof( pack->pakGamename ) );
+
+	download = strrchr(pack->pakGamename, '/');
+
+	if (download && !strcmp(download, "/download")) {
+		pack->downloaded = qtrue;
+		*download = 0; // strip the /download suffix from the gamename
+	} else {
+		pack->downloaded = qfalse;
+	}
+
+	// strip .pk3 if needed
+	if ( strlen( pack->pakBasename ) > 4 && !Q_stricmp( pack->pakBasename + strlen( pack->pakBasename ) - 4, ".pk3" ) ) {
+		pack->pakBasename[strlen( pack->pakBasename ) - 4] = 0;
+	}
+
+	return pack;
+}
+
+/*
+=================
+FS_CheckDangerousFile
+
+Downloaded paks shouldn't bring code or configs along
+=================
+*/
+static void FS_CheckDangerousFile(pack_t *pack, const char *name)
+{
+	int				j;
+	qboolean		alreadydangerous = qfalse;
+
+	if (pack->downloaded && (COM_CompareExtension(name, ".qvm")
+	                         || !Q_stricmp(name, "autoexec.cfg")
+	                         || !Q_stricmp(name, "q3config.cfg")))
+	{
+
+		for (j = 0; j < fs_dangerousPaksFound; j++) {
+			if (!strcmp(fs_dangerousPakNames[j], pack->pakBasename)) {
+				alreadydangerous = qtrue;
+				break;
+			}
+		}
+
+		if (!alreadydangerous) {
+			Q_strncpyz(fs_dangerousPakNames[fs_dangerousPaksFound], pack->pakBasename, MAX_ZPATH);
+			fs_dangerousPaksFound++;
+		}
+
+		Com_Printf(S_COLOR_RED "Dangerous file %s found in %s\n",
+				name,
+				pack->pakFilename);
+	}
+}
+
+/*
+=================
+FS_AddPackFile
+
+Adds file i to the hash table of the pack, namePtr is where its name goes
+=================
+*/
+static char *FS_AddPackFile(pack_t *pack, int i, const char *name, unsigned long pos, unsigned long len, char *namePtr)
+{
+	fileInPack_t	*buildBuffer = pack->buildBuffer;
+	long			hash;
+
+	FS_CheckDangerousFile(pack, name);
+
+	hash = FS_HashFileName(name, pack->hashSize);
+	buildBuffer[i].name = namePtr;
+	strcpy( buildBuffer[i].name, name );
+	namePtr += strlen(name) + 1;
+	// store the file position in the zip
+	buildBuffer[i].pos = pos;
+	buildBuffer[i].len = len;
+	buildBuffer[i].next = pack->hashTable[hash];
+	pack->hashTable[hash] = &buildBuffer[i];
+
+	return namePtr;
+}
+
+/*
+=================
+FS_FinishPack
+
+The checksums come from the CRCs of the files in headerLongs
+=================
+*/
+static void FS_FinishPack(pack_t *pack)
+{
+	pack->headerLongs[ 0 ] = LittleLong( fs_checksumFeed );
+	pack->checksum = Com_BlockChecksum( &pack->headerLongs[ 1 ], sizeof(*pack->headerLongs) * ( pack->numHeaderLongs - 1 ) );
+	pack->pure_checksum = Com_BlockChecksum( pack->headerLongs, sizeof(*pack->headerLongs) * pack->numHeaderLongs );
+	pack->checksum = LittleLong( pack->checksum );
+	pack->pure_checksum = LittleLong( pack->pure_checksum );
+	pack->extrapure = qtrue;
+}
+
+/*
+=================
+FS_ScanZipFile
+
+Reads the central directory of a zip file into a new pack
+=================
+*/
+static pack_t *FS_ScanZipFile(const char *zipfile, const char *basename, const char *gamename)
 {
-	fileInPack_t	*buildBuffer;
 	pack_t			*pack;
 	unzFile			uf;
 	int				err;
 	unz_global_info gi;
 	char			filename_inzip[MAX_ZPATH];
 	unz_file_info	file_info;
-	int				i, j, len;
-	long			hash;
-	int				fs_numHeaderLongs;
-	int				*fs_headerLongs;
+	int				i, len;
 	char			*namePtr;
-	qboolean		alreadydangerous = qfalse;
-	char			*download;
+	byte			*mapData;
+	int				mapLength;
 
-	fs_numHeaderLongs = 0;
+	// the central directory is found from the end of the mapping, and
+	// read inside it
+	mapData = FS_MapPak( zipfile, 0, &mapLength );
 
-	uf = unzOpen(zipfile);
+	uf = FS_UnzOpen(zipfile, mapData, mapLength);
 	err = unzGetGlobalInfo (uf,&gi);
 
-	if (err != UNZ_OK)
+	if (err != UNZ_OK) {
+		if ( mapData ) {
+			Sys_UnmapFile( mapData, mapLength );
+		}
 		return NULL;
+	}
 
 	len = 0;
 	unzGoToFirstFile(uf);
@@ -2047,102 +3204,820 @@ static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename, const c
 		unzGoToNextFile(uf);
 	}
 
-	buildBuffer = Z_Malloc( (gi.number_entry * sizeof( fileInPack_t )) + len );
-	namePtr = ((char *) buildBuffer) + gi.number_entry * sizeof( fileInPack_t );
-	fs_headerLongs = Z_Malloc( ( gi.number_entry + 1 ) * sizeof(int) );
-	fs_headerLongs[ fs_numHeaderLongs++ ] = LittleLong( fs_checksumFeed );
+	pack = FS_AllocPack(zipfile, basename, gamename, gi.number_entry, len);
+	namePtr = ((char *) pack->buildBuffer) + gi.number_entry * sizeof( fileInPack_t );
+	pack->numHeaderLongs = 1;
+
+	pack->handle = uf;
+	pack->mapData = mapData;
+	pack->mapLength = mapLength;
+	unzGoToFirstFile(uf);
+
+	for (i = 0; i < gi.number_entry; i++)
+	{
+		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
+		if (err != UNZ_OK) {
+			break;
+		}
+
+		if (file_info.uncompressed_size > 0) {
+			pack->headerLongs[pack->numHeaderLongs++] = LittleLong(file_info.crc);
+		}
+		Q_strlwr( filename_inzip );
+		namePtr = FS_AddPackFile(pack, i, filename_inzip, unzGetOffset(uf), file_info.uncompressed_size, namePtr);
+		unzGoToNextFile(uf);
+	}
+
+	FS_FinishPack(pack);
+	return pack;
+}
+
+/*
+==========================================================================
+
+PAK INDEX
+
+The file lists and CRCs of the pk3 files are kept in pk3index.dat in
+the home path, keyed by the path, size and modification time of each
+pk3. Paks found there are not opened at all until a file is read from
+them, which makes FS_Startup with thousands of paks much faster.
+
+The index is rewritten after a startup that found a new or changed pk3,
+and it only keeps the paks that startup loaded.
+==========================================================================
+*/
+
+#define PAKINDEX_NAME		"pk3index.dat"
+#define PAKINDEX_VERSION	1
+#define PAKINDEX_HASH_SIZE	1024
+
+typedef struct pakIndex_s {
+	const char			*path;
+	int64_t				size;
+	int64_t				mtime;
+	int					numfiles;
+	int					numHeaderLongs;
+	const byte			*headerLongs;
+	const byte			*files;
+	const byte			*filesEnd;
+	int					namesLength;
+	qboolean			used;
+	struct pakIndex_s	*next;
+} pakIndex_t;
+
+static byte			*fs_pakIndexData;
+static pakIndex_t	*fs_pakIndex;
+static int			fs_pakIndexCount;
+static pakIndex_t	*fs_pakIndexHash[PAKINDEX_HASH_SIZE];
+static qboolean		fs_pakIndexDirty;
+static qboolean		fs_pakIndexLoaded;
+
+/*
+=================
+FS_PakIndexPath
+=================
+*/
+static const char *FS_PakIndexPath(void)
+{
+	return va( "%s%c%s", fs_homepath->string, PATH_SEP, PAKINDEX_NAME );
+}
+
+/*
+=================
+FS_PakIndexHash
+=================
+*/
+static long FS_PakIndexHash(const char *path)
+{
+	long	hash = 0;
+	int		i;
+
+	for (i = 0; path[i]; i++) {
+		hash += (long)(path[i]) * (i+119);
+	}
+	hash = (hash ^ (hash >> 10) ^ (hash >> 20));
+	return hash & (PAKINDEX_HASH_SIZE - 1);
+}
+
+/*
+=================
+FS_PakIndexLong
+=================
+*/
+static qboolean FS_PakIndexLong(const byte **p, const byte *end, int *value)
+{
+	if ( end - *p < 4 ) {
+		return qfalse;
+	}
+	*value = LittleLong( *(const int *)*p );
+	*p += 4;
+	return qtrue;
+}
+
+/*
+=================
+FS_PakIndexString
+
+Strings are stored with their length and trailing zero
+=================
+*/
+static qboolean FS_PakIndexString(const byte **p, const byte *end, const char **string)
+{
+	int		len;
+
+	if ( !FS_PakIndexLong( p, end, &len ) || len < 1 || end - *p < len || (*p)[len - 1] ) {
+		return qfalse;
+	}
+	*string = (const char *)*p;
+	*p += len;
+	return qtrue;
+}
+
+/*
+=================
+FS_FreePakIndex
+=================
+*/
+static void FS_FreePakIndex(void)
+{
+	if ( fs_pakIndexData ) {
+		Z_Free( fs_pakIndexData );
+	}
+	if ( fs_pakIndex ) {
+		Z_Free( fs_pakIndex );
+	}
+	fs_pakIndexData = NULL;
+	fs_pakIndex = NULL;
+	fs_pakIndexCount = 0;
+	fs_pakIndexLoaded = qfalse;
+	Com_Memset( fs_pakIndexHash, 0, sizeof( fs_pakIndexHash ) );
+}
+
+/*
+=================
+FS_LoadPakIndex
+
+Anything wrong with the index throws all of it away
+=================
+*/
+static void FS_LoadPakIndex(void)
+{
+	FILE		*f;
+	long		length;
+	const byte	*p, *end, *name;
+	pakIndex_t	*entry;
+	int			i, j, value, count, lo, hi, pos, len;
+
+	FS_FreePakIndex();
+	fs_pakIndexDirty = qfalse;
+	fs_pakIndexLoaded = qtrue;
+
+	f = Sys_FOpen( FS_PakIndexPath(), "rb" );
+	if ( !f ) {
+		fs_pakIndexDirty = qtrue;
+		return;
+	}
+
+	fseek( f, 0, SEEK_END );
+	length = ftell( f );
+	fseek( f, 0, SEEK_SET );
+
+	if ( length <= 0 || length > 0x7fffffff ) {
+		fclose( f );
+		fs_pakIndexDirty = qtrue;
+		return;
+	}
+
+	fs_pakIndexData = Z_Malloc( length );
+	if ( fread( fs_pakIndexData, 1, length, f ) != length ) {
+		length = 0;
+	}
+	fclose( f );
+
+	p = fs_pakIndexData;
+	end = p + length;
+
+	if ( end - p < 4 || memcmp( p, "PK3I", 4 ) ) {
+		goto bad;
+	}
+	p += 4;
+	if ( !FS_PakIndexLong( &p, end, &value ) || value != PAKINDEX_VERSION ) {
+		goto bad;
+	}
+	if ( !FS_PakIndexLong( &p, end, &count ) || count < 0 || count > length / 16 ) {
+		goto bad;
+	}
+
+	fs_pakIndex = Z_Malloc( count * sizeof( pakIndex_t ) + 1 );
+	for ( i = 0 ; i < count ; i++ ) {
+		entry = &fs_pakIndex[i];
+
+		if ( !FS_PakIndexString( &p, end, &entry->path ) ) {
+			goto bad;
+		}
+		if ( !FS_PakIndexLong( &p, end, &lo ) || !FS_PakIndexLong( &p, end, &hi ) ) {
+			goto bad;
+		}
+		entry->size = ( (int64_t)hi << 32 ) | (unsigned int)lo;
+		if ( !FS_PakIndexLong( &p, end, &lo ) || !FS_PakIndexLong( &p, end, &hi ) ) {
+			goto bad;
+		}
+		entry->mtime = ( (int64_t)hi << 32 ) | (unsigned int)lo;
+
+		if ( !FS_PakIndexLong( &p, end, &entry->numfiles ) || entry->numfiles < 0 ) {
+			goto bad;
+		}
+		if ( !FS_PakIndexLong( &p, end, &entry->numHeaderLongs ) || entry->numHeaderLongs < 1
+			|| entry->numHeaderLongs > entry->numfiles + 1 || ( end - p ) / 4 < entry->numHeaderLongs ) {
+			goto bad;
+		}
+		entry->headerLongs = p;
+		p += entry->numHeaderLongs * 4;
+
+		// check the file list now, so building the pack can't fail
+		entry->files = p;
+		entry->namesLength = 0;
+		for ( j = 0 ; j < entry->numfiles ; j++ ) {
+			if ( !FS_PakIndexLong( &p, end, &pos ) || !FS_PakIndexLong( &p, end, &len )
+				|| !FS_PakIndexString( &p, end, (const char **)&name ) || strlen( (const char *)name ) >= MAX_ZPATH ) {
+				goto bad;
+			}
+			entry->namesLength += strlen( (const char *)name ) + 1;
+		}
+		entry->filesEnd = p;
+
+		value = FS_PakIndexHash( entry->path );
+		entry->next = fs_pakIndexHash[value];
+		fs_pakIndexHash[value] = entry;
+	}
+	fs_pakIndexCount = count;
+	return;
+
+bad:
+	Com_Printf( "WARNING: ignoring the broken pk3 index %s\n", FS_PakIndexPath() );
+	FS_FreePakIndex();
+	fs_pakIndexDirty = qtrue;
+	fs_pakIndexLoaded = qtrue;
+}
+
+/*
+=================
+FS_WritePakIndexLong
+=================
+*/
+static void FS_WritePakIndexLong(FILE *f, int value)
+{
+	value = LittleLong( value );
+	fwrite( &value, 4, 1, f );
+}
+
+/*
+=================
+FS_WritePakIndexString
+=================
+*/
+static void FS_WritePakIndexString(FILE *f, const char *string)
+{
+	int		len = strlen( string ) + 1;
+
+	FS_WritePakIndexLong( f, len );
+	fwrite( string, 1, len, f );
+}
+
+/*
+=================
+FS_WritePakIndex
+
+Writes the index for all paks on the search path, if the startup had
+to look at any directory at all
+=================
+*/
+static void FS_WritePakIndex(void)
+{
+	searchpath_t	*search;
+	pack_t			*pack;
+	FILE			*f;
+	int				i, count;
+
+	if ( !fs_pakIndexLoaded ) {
+		return;
+	}
+
+	for ( i = 0 ; i < fs_pakIndexCount ; i++ ) {
+		if ( !fs_pakIndex[i].used ) {
+			fs_pakIndexDirty = qtrue;
+		}
+	}
+
+	if ( !fs_pakIndexDirty ) {
+		return;
+	}
+
+	count = 0;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack && search->pack->indexed ) {
+			count++;
+		}
+	}
+
+	f = Sys_FOpen( FS_PakIndexPath(), "wb" );
+	if ( !f ) {
+		Com_Printf( "WARNING: couldn't write the pk3 index %s\n", FS_PakIndexPath() );
+		return;
+	}
+
+	fwrite( "PK3I", 1, 4, f );
+	FS_WritePakIndexLong( f, PAKINDEX_VERSION );
+	FS_WritePakIndexLong( f, count );
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		pack = search->pack;
+		if ( !pack || !pack->indexed ) {
+			continue;
+		}
+
+		FS_WritePakIndexString( f, pack->pakFilename );
+		FS_WritePakIndexLong( f, (int)pack->fileSize );
+		FS_WritePakIndexLong( f, (int)( pack->fileSize >> 32 ) );
+		FS_WritePakIndexLong( f, (int)pack->fileTime );
+		FS_WritePakIndexLong( f, (int)( pack->fileTime >> 32 ) );
+		FS_WritePakIndexLong( f, pack->numfiles );
+		FS_WritePakIndexLong( f, pack->numHeaderLongs );
+		// the CRCs are kept little endian already, the feed in front doesn't matter
+		fwrite( pack->headerLongs, 4, pack->numHeaderLongs, f );
+
+		for ( i = 0 ; i < pack->numfiles ; i++ ) {
+			FS_WritePakIndexLong( f, pack->buildBuffer[i].pos );
+			FS_WritePakIndexLong( f, pack->buildBuffer[i].len );
+			FS_WritePakIndexString( f, pack->buildBuffer[i].name );
+		}
+	}
+
+	if ( ferror( f ) ) {
+		Com_Printf( "WARNING: couldn't write the pk3 index %s\n", FS_PakIndexPath() );
+	}
+	fclose( f );
+
+	fs_pakIndexDirty = qfalse;
+}
+
+/*
+=================
+FS_PackFromIndex
+=================
+*/
+static pack_t *FS_PackFromIndex(pakIndex_t *entry, const char *zipfile, const char *basename, const char *gamename)
+{
+	pack_t		*pack;
+	const byte	*p, *end;
+	const char	*name;
+	char		*namePtr;
+	int			i, pos, len;
+
+	pack = FS_AllocPack(zipfile, basename, gamename, entry->numfiles, entry->namesLength);
+	namePtr = ((char *) pack->buildBuffer) + entry->numfiles * sizeof( fileInPack_t );
+
+	Com_Memcpy( pack->headerLongs, entry->headerLongs, entry->numHeaderLongs * 4 );
+	pack->numHeaderLongs = entry->numHeaderLongs;
+
+	// already checked by FS_LoadPakIndex
+	p = entry->files;
+	end = entry->filesEnd;
+	for ( i = 0 ; i < entry->numfiles ; i++ ) {
+		if ( !FS_PakIndexLong( &p, end, &pos ) || !FS_PakIndexLong( &p, end, &len ) || !FS_PakIndexString( &p, end, &name ) ) {
+			pack->numfiles = i;
+			break;
+		}
+		namePtr = FS_AddPackFile(pack, i, name, (unsigned int)pos, (unsigned int)len, namePtr);
+	}
+
+	FS_FinishPack(pack);
+	entry->used = qtrue;
+	return pack;
+}
+
+/*
+=================
+FS_FindPakIndex
+=================
+*/
+static pakIndex_t *FS_FindPakIndex(const char *zipfile, int64_t size, int64_t mtime)
+{
+	pakIndex_t	*entry;
+
+	for ( entry = fs_pakIndexHash[FS_PakIndexHash( zipfile )] ; entry ; entry = entry->next ) {
+		if ( !strcmp( entry->path, zipfile ) && entry->size == size && entry->mtime == mtime ) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/*
+==========================================================================
+
+INCREMENTAL RESTART
+
+FS_Restart parks the packs of the search path instead of freeing them,
+and FS_AddGameDirectory takes back every one whose pk3 has the same
+path, size and modification time, only new and changed pk3s are read.
+What wasn't taken back is freed after the startup.
+
+Each game directory is also watched where the system can, with its last
+listing kept. When the watch reports nothing about pk3 names, the
+listing stands and its paks are taken back without even a stat, so a
+restart after a download only lists the download directory again.
+==========================================================================
+*/
+
+#define MAX_PAK_DIRS		64
+
+typedef struct {
+	char			path[MAX_OSPATH];
+	sysDirWatch_t	*watch;			// NULL if it can't be watched
+	qboolean		listed;
+	char			**pakfiles;		// from the last listing, sorted
+	int				numfiles;
+	char			**pakdirs;
+	int				numdirs;
+} pakDir_t;
+
+static pakDir_t		fs_pakDirs[MAX_PAK_DIRS];
+static int			fs_numPakDirs;
+
+static searchpath_t	*fs_parkedPaks[PAKINDEX_HASH_SIZE];
+
+/*
+=================
+FS_FindParkedPak
+
+Only reads, so the scan jobs can call it
+=================
+*/
+static pack_t *FS_FindParkedPak(const char *zipfile)
+{
+	searchpath_t	*search;
+
+	for ( search = fs_parkedPaks[FS_PakIndexHash( zipfile )] ; search ; search = search->next ) {
+		if ( !strcmp( search->pack->pakFilename, zipfile ) ) {
+			return search->pack;
+		}
+	}
+	return NULL;
+}
+
+/*
+=================
+FS_UnparkPak
+
+Takes a parked pack back as if it had just been loaded
+=================
+*/
+static pack_t *FS_UnparkPak(pack_t *pack)
+{
+	searchpath_t	**link, *parked;
+	pakIndex_t		*entry;
+	int				i;
+
+	for ( link = &fs_parkedPaks[FS_PakIndexHash( pack->pakFilename )] ; *link ; link = &(*link)->next ) {
+		if ( (*link)->pack == pack ) {
+			parked = *link;
+			*link = parked->next;
+			Z_Free( parked );
+			break;
+		}
+	}
+
+	// the checksum feed may have changed
+	FS_FinishPack( pack );
+	pack->referenced = 0;
+
+	if ( pack->downloaded ) {
+		for ( i = 0 ; i < pack->numfiles ; i++ ) {
+			FS_CheckDangerousFile( pack, pack->buildBuffer[i].name );
+		}
+	}
+
+	// so the index isn't rewritten for leaving it out
+	if ( pack->indexed && fs_pakIndexLoaded ) {
+		entry = FS_FindPakIndex( pack->pakFilename, pack->fileSize, pack->fileTime );
+		if ( entry ) {
+			entry->used = qtrue;
+		}
+	}
+
+	return pack;
+}
+
+/*
+==========================================================================
+
+PAK SCANNING
+
+FS_AddGameDirectory looks up or reads the central directories of all
+the pk3 files in a directory with Com_RunParallel, then builds the
+packs in paksort order on the main thread. The jobs only stat, read
+and parse into malloc'd memory. A pk3 they can't make sense of is left
+to FS_ScanZipFile on the main thread, which decides as it always did.
+==========================================================================
+*/
+
+#define ZIP_EOCD_SIZE		22
+#define ZIP_CDIR_SIZE		46
+#define ZIP_MAX_COMMENT		0xffff
+
+typedef struct {
+	char		path[MAX_OSPATH];
+	qboolean	statted;
+	int64_t		size;
+	int64_t		mtime;
+	qboolean	unchanged;		// its directory watch saw nothing
+	pack_t		*parked;		// the pack from before the restart
+	pakIndex_t	*entry;			// from the index, or scanned
+	pakIndex_t	scanned;
+	byte		*scanData;		// scanned headerLongs and files, malloc'd
+} pakScan_t;
+
+static int FS_ZipShort(const byte *p)
+{
+	return p[0] | ( p[1] << 8 );
+}
+
+static unsigned int FS_ZipLong(const byte *p)
+{
+	return p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) | ( (unsigned int)p[3] << 24 );
+}
+
+static byte *FS_ZipPutLong(byte *p, int value)
+{
+	value = LittleLong( value );
+	Com_Memcpy( p, &value, 4 );
+	return p + 4;
+}
+
+/*
+=================
+FS_ReadZipData
+=================
+*/
+static byte *FS_ReadZipData(FILE *f, long pos, long len)
+{
+	byte	*data;
+
+	if ( fseek( f, pos, SEEK_SET ) ) {
+		return NULL;
+	}
+	data = malloc( len + 1 );
+	if ( !data ) {
+		return NULL;
+	}
+	if ( fread( data, 1, len, f ) != len ) {
+		free( data );
+		return NULL;
+	}
+	return data;
+}
+
+/*
+=================
+FS_ReadZipDirectory
+
+Reads the central directory of a zip the way unzip.c does, into the
+same layout as a pak index entry. Any thread may call it.
+=================
+*/
+static qboolean FS_ReadZipDirectory(pakScan_t *scan)
+{
+	FILE			*f;
+	byte			*tail, *cdir, *out, *p;
+	char			name[MAX_ZPATH];
+	long			fileLength, back, centralPos, i;
+	long			cdirSize, cdirOffset, before, cdirPos;
+	int				numEntries, nameLength, extraLength, commentLength;
+	int				numHeaderLongs, namesLength, j, crcLong;
+	unsigned int	crc, size;
+
+	f = Sys_FOpen( scan->path, "rb" );
+	if ( !f ) {
+		return qfalse;
+	}
+
+	tail = cdir = NULL;
+	fseek( f, 0, SEEK_END );
+	fileLength = ftell( f );
+	if ( fileLength < ZIP_EOCD_SIZE || fileLength > 0x7fffffff ) {
+		goto fail;
+	}
+
+	// the end of central directory record is somewhere before the comment
+	back = fileLength < ZIP_MAX_COMMENT ? fileLength : ZIP_MAX_COMMENT;
+	tail = FS_ReadZipData( f, fileLength - back, back );
+	if ( !tail ) {
+		goto fail;
+	}
+	for ( i = back - 4 ; i > 0 ; i-- ) {
+		if ( tail[i] == 0x50 && tail[i+1] == 0x4b && tail[i+2] == 0x05 && tail[i+3] == 0x06 ) {
+			break;
+		}
+	}
+	if ( i <= 0 || back - i < ZIP_EOCD_SIZE ) {
+		goto fail;
+	}
+	p = tail + i;
+	centralPos = fileLength - back + i;
+
+	numEntries = FS_ZipShort( p + 8 );
+	if ( FS_ZipShort( p + 4 ) || FS_ZipShort( p + 6 ) || FS_ZipShort( p + 10 ) != numEntries ) {
+		goto fail;
+	}
+	cdirSize = FS_ZipLong( p + 12 );
+	cdirOffset = FS_ZipLong( p + 16 );
+	if ( cdirSize > centralPos || cdirOffset > centralPos - cdirSize ) {
+		goto fail;
+	}
+	before = centralPos - ( cdirOffset + cdirSize );
+
+	cdir = FS_ReadZipData( f, cdirOffset + before, cdirSize );
+	if ( !cdir ) {
+		goto fail;
+	}
+
+	// every name only shrinks from the directory to the output
+	out = malloc( ( numEntries + 1 ) * 4 + numEntries * 12 + cdirSize );
+	if ( !out ) {
+		goto fail;
+	}
+
+	scan->scanned.headerLongs = out;
+	numHeaderLongs = 1;
+	out += ( numEntries + 1 ) * 4;
+	scan->scanned.files = out;
+	namesLength = 0;
+
+	p = cdir;
+	cdirPos = cdirOffset;
+	for ( j = 0 ; j < numEntries ; j++ ) {
+		if ( cdir + cdirSize - p < ZIP_CDIR_SIZE || FS_ZipLong( p ) != 0x02014b50 ) {
+			break;
+		}
+		crc = FS_ZipLong( p + 16 );
+		size = FS_ZipLong( p + 24 );
+		nameLength = FS_ZipShort( p + 28 );
+		extraLength = FS_ZipShort( p + 30 );
+		commentLength = FS_ZipShort( p + 32 );
+		if ( nameLength >= MAX_ZPATH || cdir + cdirSize - p < ZIP_CDIR_SIZE + nameLength ) {
+			break;
+		}
+
+		Com_Memcpy( name, p + ZIP_CDIR_SIZE, nameLength );
+		name[nameLength] = 0;
+		Q_strlwr( name );
+
+		if ( size > 0 ) {
+			// kept the way FS_ScanZipFile keeps them
+			crcLong = LittleLong( crc );
+			Com_Memcpy( (byte *)scan->scanned.headerLongs + numHeaderLongs * 4, &crcLong, 4 );
+			numHeaderLongs++;
+		}
+		out = FS_ZipPutLong( out, cdirPos );
+		out = FS_ZipPutLong( out, size );
+		out = FS_ZipPutLong( out, strlen( name ) + 1 );
+		strcpy( (char *)out, name );
+		out += strlen( name ) + 1;
+		namesLength += strlen( name ) + 1;
+
+		p += ZIP_CDIR_SIZE + nameLength + extraLength + commentLength;
+		cdirPos += ZIP_CDIR_SIZE + nameLength + extraLength + commentLength;
+	}
+
+	if ( j < numEntries ) {
+		free( (byte *)scan->scanned.headerLongs );
+		goto fail;
+	}
+
+	scan->scanData = (byte *)scan->scanned.headerLongs;
+	scan->scanned.path = scan->path;
+	scan->scanned.numfiles = numEntries;
+	scan->scanned.numHeaderLongs = numHeaderLongs;
+	scan->scanned.filesEnd = out;
+	scan->scanned.namesLength = namesLength;
+
+	free( tail );
+	free( cdir );
+	fclose( f );
+	return qtrue;
+
+fail:
+	free( tail );
+	free( cdir );
+	fclose( f );
+	return qfalse;
+}
+
+/*
+=================
+FS_ScanPakJob
+
+Com_RunParallel job over an array of pakScan_t
+=================
+*/
+static void FS_ScanPakJob(void *data, int index)
+{
+	pakScan_t	*scan = &((pakScan_t *)data)[index];
+	pack_t		*parked;
+
+	parked = FS_FindParkedPak( scan->path );
+	if ( parked && scan->unchanged ) {
+		scan->parked = parked;
+		return;
+	}
+
+	scan->statted = Sys_StatFile( scan->path, &scan->size, &scan->mtime );
+	if ( scan->statted ) {
+		if ( parked && parked->indexed && parked->fileSize == scan->size && parked->fileTime == scan->mtime ) {
+			scan->parked = parked;
+			return;
+		}
 
-	// get the hash table size from the number of files in the zip
-	// because lots of custom pk3 files have less than 32 or 64 files
-	for (i = 1; i <= MAX_FILEHASH_SIZE; i <<= 1) {
-		if (i > gi.number_entry) {
-			break;
+		scan->entry = FS_FindPakIndex( scan->path, scan->size, scan->mtime );
+		if ( scan->entry ) {
+			return;
 		}
 	}
 
-	pack = Z_Malloc( sizeof( pack_t ) + i * sizeof(fileInPack_t *) );
-	pack->hashSize = i;
-	pack->hashTable = (fileInPack_t **) (((char *) pack) + sizeof( pack_t ));
-	for(i = 0; i < pack->hashSize; i++) {
-		pack->hashTable[i] = NULL;
+	if ( FS_ReadZipDirectory( scan ) ) {
+		scan->entry = &scan->scanned;
 	}
+}
 
-	Q_strncpyz( pack->pakFilename, zipfile, sizeof( pack->pakFilename ) );
-	Q_strncpyz( pack->pakBasename, basename, sizeof( pack->pakBasename ) );
-	Q_strncpyz( pack->pakGamename, gamename, sizeof( pack->pakGamename ) );
+/*
+=================
+FS_LoadScannedPak
 
-	download = strrchr(pack->pakGamename, '/');
+Creates a new pak_t for the contents of a zip file from what
+FS_ScanPakJob found out about it
+=================
+*/
+static pack_t *FS_LoadScannedPak(pakScan_t *scan, const char *basename, const char *gamename)
+{
+	pack_t		*pack;
 
-	if (download && !strcmp(download, "/download")) {
-		pack->downloaded = qtrue;
-		*download = 0; // strip the /download suffix from the gamename
-	} else {
-		pack->downloaded = qfalse;
+	if ( scan->parked ) {
+		return FS_UnparkPak( scan->parked );
 	}
 
-	// strip .pk3 if needed
-	if ( strlen( pack->pakBasename ) > 4 && !Q_stricmp( pack->pakBasename + strlen( pack->pakBasename ) - 4, ".pk3" ) ) {
-		pack->pakBasename[strlen( pack->pakBasename ) - 4] = 0;
+	if ( scan->entry ) {
+		pack = FS_PackFromIndex( scan->entry, scan->path, basename, gamename );
+	} else {
+		pack = FS_ScanZipFile( scan->path, basename, gamename );
 	}
 
-	pack->handle = uf;
-	pack->numfiles = gi.number_entry;
-	unzGoToFirstFile(uf);
-
-	for (i = 0; i < gi.number_entry; i++)
-	{
-		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
-		if (err != UNZ_OK) {
-			break;
+	if ( pack && scan->statted ) {
+		pack->indexed = qtrue;
+		pack->fileSize = scan->size;
+		pack->fileTime = scan->mtime;
+		// not found in the index
+		if ( !scan->entry || scan->entry == &scan->scanned ) {
+			fs_pakIndexDirty = qtrue;
 		}
+	}
+	return pack;
+}
 
-		if (pack->downloaded && (COM_CompareExtension(filename_inzip, ".qvm")
-		                         || !Q_stricmp(filename_inzip, "autoexec.cfg")
-		                         || !Q_stricmp(filename_inzip, "q3config.cfg")))
-		{
-
-			for (j = 0; j < fs_dangerousPaksFound; j++) {
-				if (!strcmp(fs_dangerousPakNames[j], pack->pakBasename)) {
-					alreadydangerous = qtrue;
-					break;
-				}
-			}
+/*
+=================
+FS_FreePakScans
+=================
+*/
+static void FS_FreePakScans(pakScan_t *scans, int count)
+{
+	int		i;
 
-			if (!alreadydangerous) {
-				Q_strncpyz(fs_dangerousPakNames[fs_dangerousPaksFound], pack->pakBasename, MAX_ZPATH);
-				fs_dangerousPaksFound++;
-			}
+	for ( i = 0 ; i < count ; i++ ) {
+		free( scans[i].scanData );
+	}
+}
 
-			Com_Printf(S_COLOR_RED "Dangerous file %s found in %s\n",
-					filename_inzip,
-					pack->pakFilename);
-		}
+/*
+=================
+FS_LoadZipFile
 
-		if (file_info.uncompressed_size > 0) {
-			fs_headerLongs[fs_numHeaderLongs++] = LittleLong(file_info.crc);
-		}
-		Q_strlwr( filename_inzip );
-		hash = FS_HashFileName(filename_inzip, pack->hashSize);
-		buildBuffer[i].name = namePtr;
-		strcpy( buildBuffer[i].name, filename_inzip );
-		namePtr += strlen(filename_inzip) + 1;
-		// store the file position in the zip
-		buildBuffer[i].pos = unzGetOffset(uf);
-		buildBuffer[i].len = file_info.uncompressed_size;
-		buildBuffer[i].next = pack->hashTable[hash];
-		pack->hashTable[hash] = &buildBuffer[i];
-		unzGoToNextFile(uf);
-	}
+Creates a new pak_t in the search chain for the contents
+of a zip file.
+=================
+*/
+static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename, const char *gamename)
+{
+	pakScan_t	scan;
+	pack_t		*pack;
 
-	pack->checksum = Com_BlockChecksum( &fs_headerLongs[ 1 ], sizeof(*fs_headerLongs) * ( fs_numHeaderLongs - 1 ) );
-	pack->pure_checksum = Com_BlockChecksum( fs_headerLongs, sizeof(*fs_headerLongs) * fs_numHeaderLongs );
-	pack->checksum = LittleLong( pack->checksum );
-	pack->pure_checksum = LittleLong( pack->pure_checksum );
-	pack->extrapure = qtrue;
+	Com_Memset( &scan, 0, sizeof( scan ) );
+	Q_strncpyz( scan.path, zipfile, sizeof( scan.path ) );
 
-	Z_Free(fs_headerLongs);
+	FS_ScanPakJob( &scan, 0 );
+	pack = FS_LoadScannedPak( &scan, basename, gamename );
+	FS_FreePakScans( &scan, 1 );
 
-	pack->buildBuffer = buildBuffer;
 	return pack;
 }
 
@@ -2156,11 +4031,68 @@ Frees a pak structure and releases all associated resources
 
 static void FS_FreePak(pack_t *thepak)
 {
-	unzClose(thepak->handle);
+	if (thepak->handle)
+		unzClose(thepak->handle);
+	if (thepak->mapData)
+		Sys_UnmapFile(thepak->mapData, thepak->mapLength);
+	Z_Free(thepak->headerLongs);
 	Z_Free(thepak->buildBuffer);
 	Z_Free(thepak);
 }
 
+/*
+=================
+FS_FreeParkedPaks
+
+Whatever the startup didn't take back
+=================
+*/
+static void FS_FreeParkedPaks(void)
+{
+	searchpath_t	*search;
+	int				i;
+
+	for ( i = 0 ; i < PAKINDEX_HASH_SIZE ; i++ ) {
+		while ( ( search = fs_parkedPaks[i] ) != NULL ) {
+			fs_parkedPaks[i] = search->next;
+			FS_FreePak( search->pack );
+			Z_Free( search );
+		}
+	}
+}
+
+/*
+=================
+FS_ParkPaks
+
+Moves the packs off the search path for FS_Startup to take back
+=================
+*/
+static void FS_ParkPaks(void)
+{
+	searchpath_t	*search, *next, **link;
+	long			hash;
+
+	// left over from a startup that errored out
+	FS_FreeParkedPaks();
+
+	link = &fs_searchpaths;
+	for ( search = fs_searchpaths ; search ; search = next ) {
+		next = search->next;
+
+		if ( !search->pack ) {
+			*link = search;
+			link = &search->next;
+			continue;
+		}
+
+		hash = FS_PakIndexHash( search->pack->pakFilename );
+		search->next = fs_parkedPaks[hash];
+		fs_parkedPaks[hash] = search;
+	}
+	*link = NULL;
+}
+
 /*
 =================
 FS_GetZipChecksum
@@ -2306,112 +4238,464 @@ char **FS_ListFilteredFiles( const char *path, const char *extension, char *filt
 				char	*name;
 				int		zpathLen, depth;
 
-				// check for directory match
-				name = buildBuffer[i].name;
-				//
-				if (filter) {
-					// case insensitive
-					if (!Com_FilterPath( filter, name, qfalse ))
-						continue;
-					// unique the match
-					nfiles = FS_AddFileToList( name, list, nfiles );
-				}
-				else {
+				// check for directory match
+				name = buildBuffer[i].name;
+				//
+				if (filter) {
+					// case insensitive
+					if (!Com_FilterPath( filter, name, qfalse ))
+						continue;
+					// unique the match
+					nfiles = FS_AddFileToList( name, list, nfiles );
+				}
+				else {
+
+					zpathLen = FS_ReturnPath(name, zpath, &depth);
+
+					if ( (depth-pathDepth)>2 || pathLength > zpathLen || Q_stricmpn( name, path, pathLength ) ) {
+						continue;
+					}
+
+					// check for extension match
+					length = strlen( name );
+					if ( length < extensionLength ) {
+						continue;
+					}
+
+					if ( Q_stricmp( name + length - extensionLength, extension ) ) {
+						continue;
+					}
+					// unique the match
+
+					temp = pathLength;
+					if (pathLength) {
+						temp++; // include the '/'
+					}
+					nfiles = FS_AddFileToList( name + temp, list, nfiles );
+				}
+			}
+		} else if (search->dir) { // scan for files in the filesystem
+			char	*netpath;
+			int		numSysFiles;
+			char	**sysFiles;
+			char	*name;
+
+			// don't scan directories for files if we are pure or restricted
+			if ( fs_numServerPaks && !searchUnpureDirs ) {
+				continue;
+			} else {
+				netpath = FS_BuildOSPath( search->dir->path, search->dir->gamedir, path );
+				sysFiles = Sys_ListFiles( netpath, extension, filter, &numSysFiles, qfalse );
+				for ( i = 0 ; i < numSysFiles ; i++ ) {
+					// unique the match
+					name = sysFiles[i];
+					nfiles = FS_AddFileToList( name, list, nfiles );
+				}
+				Sys_FreeFileList( sysFiles );
+			}
+		}
+	}
+
+	// return a copy of the list
+	*numfiles = nfiles;
+
+	if ( !nfiles ) {
+		return NULL;
+	}
+
+	listCopy = Z_Malloc( ( nfiles + 1 ) * sizeof( *listCopy ) );
+	for ( i = 0 ; i < nfiles ; i++ ) {
+		listCopy[i] = list[i];
+	}
+	listCopy[i] = NULL;
+
+	return listCopy;
+}
+
+/*
+=================
+FS_ListFiles
+=================
+*/
+char **FS_ListFiles( const char *path, const char *extension, int *numfiles ) {
+	return FS_ListFilteredFiles( path, extension, NULL, numfiles, qfalse, qfalse );
+}
+
+/*
+=================
+FS_FreeFileList
+=================
+*/
+void FS_FreeFileList( char **list ) {
+	int		i;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+
+	if ( !list ) {
+		return;
+	}
+
+	for ( i = 0 ; list[i] ; i++ ) {
+		Z_Free( list[i] );
+	}
+
+	Z_Free( list );
+}
+
+
+/*
+=================================================================================
+
+MAP CATALOG
+
+The names of the maps on the search path, sorted, for the map command,
+its completion and FS_GetFileList( "maps", ".bsp" ). It is built at the
+end of FS_Startup, so it follows every filesystem restart, which is
+what a pk3 coming or going takes.
+
+Every trigram of the lowercased names is listed with the maps that have
+it, sorted by trigram. A substring lookup only checks the maps under the
+rarest trigram of what it looks for, and FS_SimilarMaps ranks maps by
+the trigrams they share with a name that matches none.
+=================================================================================
+*/
+
+typedef struct {
+	int		key;
+	int		first;				// in fs_mapTrigramMaps
+	int		count;
+} mapTrigram_t;
+
+typedef struct {
+	int		key;
+	int		map;
+} mapTrigramPair_t;
+
+static char			*fs_mapNames;
+static const char	**fs_maps;
+static int			fs_numMaps;
+static mapTrigram_t	*fs_mapTrigrams;
+static int			fs_numMapTrigrams;
+static int			*fs_mapTrigramMaps;
+
+/*
+=================
+FS_MapTrigramKey
+=================
+*/
+static int FS_MapTrigramKey( const char *s ) {
+	return ( tolower( (byte)s[0] ) << 16 ) | ( tolower( (byte)s[1] ) << 8 ) | tolower( (byte)s[2] );
+}
+
+/*
+=================
+FS_FindMapTrigram
+=================
+*/
+static const mapTrigram_t *FS_FindMapTrigram( int key ) {
+	int		low, high, mid;
+
+	low = 0;
+	high = fs_numMapTrigrams - 1;
+	while ( low <= high ) {
+		mid = ( low + high ) / 2;
+		if ( fs_mapTrigrams[mid].key == key ) {
+			return &fs_mapTrigrams[mid];
+		}
+		if ( fs_mapTrigrams[mid].key < key ) {
+			low = mid + 1;
+		} else {
+			high = mid - 1;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+=================
+FS_MapNameCompare
+=================
+*/
+static int QDECL FS_MapNameCompare( const void *a, const void *b ) {
+	return Q_stricmp( *(const char **)a, *(const char **)b );
+}
+
+/*
+=================
+FS_MapTrigramCompare
+=================
+*/
+static int QDECL FS_MapTrigramCompare( const void *a, const void *b ) {
+	const mapTrigramPair_t	*pa = a, *pb = b;
+
+	if ( pa->key != pb->key ) {
+		return pa->key < pb->key ? -1 : 1;
+	}
+	return pa->map - pb->map;
+}
+
+/*
+=================
+FS_FreeMapCatalog
+=================
+*/
+static void FS_FreeMapCatalog( void ) {
+	if ( fs_maps ) {
+		Z_Free( fs_mapNames );
+		Z_Free( (void *)fs_maps );
+		Z_Free( fs_mapTrigrams );
+		Z_Free( fs_mapTrigramMaps );
+	}
+
+	fs_mapNames = NULL;
+	fs_maps = NULL;
+	fs_numMaps = 0;
+	fs_mapTrigrams = NULL;
+	fs_numMapTrigrams = 0;
+	fs_mapTrigramMaps = NULL;
+}
+
+/*
+=================
+FS_RefreshMapCatalog
 
-					zpathLen = FS_ReturnPath(name, zpath, &depth);
+Lists the maps on the search path again. The pure pak list is left out,
+the catalog has to stay whole for after a pure server is left, which
+clears the list without a restart; FS_GetFileList filters while it is set.
+=================
+*/
+void FS_RefreshMapCatalog( void ) {
+	mapTrigramPair_t	*pairs;
+	char				**list;
+	char				*name;
+	int					numFiles, numPairs, size, len;
+	int					i, j;
 
-					if ( (depth-pathDepth)>2 || pathLength > zpathLen || Q_stricmpn( name, path, pathLength ) ) {
-						continue;
-					}
+	FS_FreeMapCatalog();
 
-					// check for extension match
-					length = strlen( name );
-					if ( length < extensionLength ) {
-						continue;
-					}
+	list = FS_ListFilteredFiles( "maps", ".bsp", NULL, &numFiles, qtrue, qtrue );
 
-					if ( Q_stricmp( name + length - extensionLength, extension ) ) {
-						continue;
-					}
-					// unique the match
+	size = 0;
+	for ( i = 0 ; i < numFiles ; i++ ) {
+		size += strlen( list[i] ) + 1;
+	}
 
-					temp = pathLength;
-					if (pathLength) {
-						temp++; // include the '/'
-					}
-					nfiles = FS_AddFileToList( name + temp, list, nfiles );
-				}
-			}
-		} else if (search->dir) { // scan for files in the filesystem
-			char	*netpath;
-			int		numSysFiles;
-			char	**sysFiles;
-			char	*name;
+	fs_mapNames = Z_Malloc( size + 1 );
+	fs_maps = Z_Malloc( ( numFiles + 1 ) * sizeof( *fs_maps ) );
 
-			// don't scan directories for files if we are pure or restricted
-			if ( fs_numServerPaks && !searchUnpureDirs ) {
-				continue;
-			} else {
-				netpath = FS_BuildOSPath( search->dir->path, search->dir->gamedir, path );
-				sysFiles = Sys_ListFiles( netpath, extension, filter, &numSysFiles, qfalse );
-				for ( i = 0 ; i < numSysFiles ; i++ ) {
-					// unique the match
-					name = sysFiles[i];
-					nfiles = FS_AddFileToList( name, list, nfiles );
-				}
-				Sys_FreeFileList( sysFiles );
-			}
+	name = fs_mapNames;
+	for ( i = 0 ; i < numFiles ; i++ ) {
+		COM_StripExtension( list[i], name, strlen( list[i] ) + 1 );
+		fs_maps[i] = name;
+		name += strlen( name ) + 1;
+	}
+	FS_FreeFileList( list );
+
+	// the same map in other case from another pak counts once
+	qsort( (void *)fs_maps, numFiles, sizeof( *fs_maps ), FS_MapNameCompare );
+	for ( i = 0 ; i < numFiles ; i++ ) {
+		if ( fs_numMaps && !Q_stricmp( fs_maps[fs_numMaps - 1], fs_maps[i] ) ) {
+			continue;
 		}
+		fs_maps[fs_numMaps++] = fs_maps[i];
 	}
 
-	// return a copy of the list
-	*numfiles = nfiles;
+	numPairs = 0;
+	for ( i = 0 ; i < fs_numMaps ; i++ ) {
+		len = strlen( fs_maps[i] );
+		if ( len >= 3 ) {
+			numPairs += len - 2;
+		}
+	}
 
-	if ( !nfiles ) {
-		return NULL;
+	pairs = Z_Malloc( ( numPairs + 1 ) * sizeof( *pairs ) );
+	numPairs = 0;
+	for ( i = 0 ; i < fs_numMaps ; i++ ) {
+		len = strlen( fs_maps[i] );
+		for ( j = 0 ; j + 3 <= len ; j++ ) {
+			pairs[numPairs].key = FS_MapTrigramKey( fs_maps[i] + j );
+			pairs[numPairs].map = i;
+			numPairs++;
+		}
 	}
+	qsort( pairs, numPairs, sizeof( *pairs ), FS_MapTrigramCompare );
 
-	listCopy = Z_Malloc( ( nfiles + 1 ) * sizeof( *listCopy ) );
-	for ( i = 0 ; i < nfiles ; i++ ) {
-		listCopy[i] = list[i];
+	fs_mapTrigrams = Z_Malloc( ( numPairs + 1 ) * sizeof( *fs_mapTrigrams ) );
+	fs_mapTrigramMaps = Z_Malloc( ( numPairs + 1 ) * sizeof( *fs_mapTrigramMaps ) );
+
+	for ( i = 0, j = 0 ; i < numPairs ; i++ ) {
+		if ( !fs_numMapTrigrams || fs_mapTrigrams[fs_numMapTrigrams - 1].key != pairs[i].key ) {
+			fs_mapTrigrams[fs_numMapTrigrams].key = pairs[i].key;
+			fs_mapTrigrams[fs_numMapTrigrams].first = j;
+			fs_mapTrigrams[fs_numMapTrigrams].count = 0;
+			fs_numMapTrigrams++;
+		} else if ( fs_mapTrigramMaps[j - 1] == pairs[i].map ) {
+			// a trigram twice in one name
+			continue;
+		}
+
+		fs_mapTrigramMaps[j++] = pairs[i].map;
+		fs_mapTrigrams[fs_numMapTrigrams - 1].count++;
 	}
-	listCopy[i] = NULL;
 
-	return listCopy;
+	Z_Free( pairs );
 }
 
 /*
 =================
-FS_ListFiles
+FS_FindMaps
+
+The maps with s in their name, in order, fills in up to maxMatches and
+returns how many there are in all
 =================
 */
-char **FS_ListFiles( const char *path, const char *extension, int *numfiles ) {
-	return FS_ListFilteredFiles( path, extension, NULL, numfiles, qfalse, qfalse );
+int FS_FindMaps( const char *s, const char **matches, int maxMatches ) {
+	const mapTrigram_t	*trigram, *rarest;
+	const int			*candidates;
+	int					i, len, count, numCandidates;
+
+	len = strlen( s );
+	rarest = NULL;
+
+	for ( i = 0 ; i + 3 <= len ; i++ ) {
+		trigram = FS_FindMapTrigram( FS_MapTrigramKey( s + i ) );
+		if ( !trigram ) {
+			return 0;
+		}
+		if ( !rarest || trigram->count < rarest->count ) {
+			rarest = trigram;
+		}
+	}
+
+	if ( rarest ) {
+		candidates = fs_mapTrigramMaps + rarest->first;
+		numCandidates = rarest->count;
+	} else {
+		// too short to have a trigram
+		candidates = NULL;
+		numCandidates = fs_numMaps;
+	}
+
+	count = 0;
+	for ( i = 0 ; i < numCandidates ; i++ ) {
+		const char *name = fs_maps[candidates ? candidates[i] : i];
+
+		if ( Q_stristr( name, s ) ) {
+			if ( count < maxMatches ) {
+				matches[count] = name;
+			}
+			count++;
+		}
+	}
+
+	return count;
 }
 
 /*
 =================
-FS_FreeFileList
+FS_SimilarMaps
+
+The maps sharing most of the trigrams of s, best first, at least half of
+them, returns how many were filled in
 =================
 */
-void FS_FreeFileList( char **list ) {
-	int		i;
+int FS_SimilarMaps( const char *s, const char **matches, int maxMatches ) {
+	const mapTrigram_t	*trigram;
+	int					*score;
+	int					best[MAX_MAPLIST_SIZE];
+	int					i, j, k, len, numTrigrams, count, minScore;
+
+	len = strlen( s );
+	if ( len < 3 || !fs_numMaps ) {
+		return 0;
+	}
+	if ( maxMatches > MAX_MAPLIST_SIZE ) {
+		maxMatches = MAX_MAPLIST_SIZE;
+	}
 
-	if ( !fs_searchpaths ) {
-		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	score = Z_Malloc( fs_numMaps * sizeof( *score ) );
+
+	numTrigrams = len - 2;
+	for ( i = 0 ; i < numTrigrams ; i++ ) {
+		// count a trigram s has twice once
+		for ( j = 0 ; j < i ; j++ ) {
+			if ( FS_MapTrigramKey( s + j ) == FS_MapTrigramKey( s + i ) ) {
+				break;
+			}
+		}
+		if ( j < i ) {
+			continue;
+		}
+
+		trigram = FS_FindMapTrigram( FS_MapTrigramKey( s + i ) );
+		if ( !trigram ) {
+			continue;
+		}
+		for ( j = 0 ; j < trigram->count ; j++ ) {
+			score[fs_mapTrigramMaps[trigram->first + j]]++;
+		}
 	}
 
-	if ( !list ) {
-		return;
+	minScore = ( numTrigrams + 1 ) / 2;
+	count = 0;
+	for ( i = 0 ; i < fs_numMaps ; i++ ) {
+		if ( score[i] < minScore ) {
+			continue;
+		}
+
+		// insert in order of score, the earlier name first on a tie
+		for ( k = count ; k > 0 && score[best[k - 1]] < score[i] ; k-- ) {
+			if ( k < maxMatches ) {
+				best[k] = best[k - 1];
+			}
+		}
+		if ( k < maxMatches ) {
+			best[k] = i;
+			if ( count < maxMatches ) {
+				count++;
+			}
+		}
 	}
 
-	for ( i = 0 ; list[i] ; i++ ) {
-		Z_Free( list[i] );
+	for ( i = 0 ; i < count ; i++ ) {
+		matches[i] = fs_maps[best[i]];
 	}
 
-	Z_Free( list );
+	Z_Free( score );
+	return count;
 }
 
+/*
+=================
+FS_MapCompletion
+
+Calls callback for every map starting with prefix
+=================
+*/
+void FS_MapCompletion( const char *prefix, void (*callback)( const char *s ) ) {
+	int		low, high, mid, len;
+
+	len = strlen( prefix );
+
+	// the first name not before prefix
+	low = 0;
+	high = fs_numMaps;
+	while ( low < high ) {
+		mid = ( low + high ) / 2;
+		if ( Q_stricmp( fs_maps[mid], prefix ) < 0 ) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	for ( ; low < fs_numMaps && !Q_stricmpn( fs_maps[low], prefix, len ) ; low++ ) {
+		callback( fs_maps[low] );
+	}
+}
 
 /*
 ================
@@ -2430,6 +4714,21 @@ int	FS_GetFileList(  const char *path, const char *extension, char *listbuf, int
 		return FS_GetModList(listbuf, bufsize);
 	}
 
+	// the map list of a pure server is only what its paks have
+	if (fs_maps && !fs_numServerPaks && !Q_stricmp(path, "maps") &&
+		(!Q_stricmp(extension, ".bsp") || !Q_stricmp(extension, "bsp"))) {
+		for (i = 0; i < fs_numMaps; i++) {
+			nLen = strlen(fs_maps[i]) + 5;
+			if (nTotal + nLen + 1 >= bufsize) {
+				break;
+			}
+			Com_sprintf(listbuf, nLen, "%s.bsp", fs_maps[i]);
+			listbuf += nLen;
+			nTotal += nLen;
+		}
+		return i;
+	}
+
 	pFiles = FS_ListFiles(path, extension, &nFiles);
 
 	for (i =0; i < nFiles; i++) {
@@ -2909,6 +5208,37 @@ void FS_Which_f( void ) {
 	Com_Printf("File not found: \"%s\"\n", filename);
 }
 
+/*
+============
+FS_OSPathForFile
+
+Where on disk FS_FOpenFileRead would read filename from: the pk3 it is
+in, or the file itself. Returns qfalse if it isn't on the search path.
+============
+*/
+qboolean FS_OSPathForFile( const char *filename, char *ospath, int size ) {
+	searchpath_t	*search;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( FS_FOpenFileReadDir( filename, search, NULL, qfalse, qfalse ) <= 0 ) {
+			continue;
+		}
+
+		if ( search->pack ) {
+			Q_strncpyz( ospath, search->pack->pakFilename, size );
+		} else {
+			Q_strncpyz( ospath, FS_BuildOSPath( search->dir->path, search->dir->gamedir, filename ), size );
+		}
+		return qtrue;
+	}
+
+	return qfalse;
+}
+
 
 //===========================================================================
 
@@ -2922,6 +5252,77 @@ static int QDECL paksort( const void *a, const void *b ) {
 	return FS_PathCmp( aa, bb );
 }
 
+/*
+================
+FS_ForgetPakDirs
+================
+*/
+static void FS_ForgetPakDirs( void ) {
+	pakDir_t	*pakDir;
+	int			i;
+
+	for ( i = 0, pakDir = fs_pakDirs ; i < fs_numPakDirs ; i++, pakDir++ ) {
+		if ( pakDir->watch ) {
+			Sys_UnwatchDirectory( pakDir->watch );
+		}
+		Sys_FreeFileList( pakDir->pakfiles );
+		Sys_FreeFileList( pakDir->pakdirs );
+	}
+
+	Com_Memset( fs_pakDirs, 0, sizeof( fs_pakDirs ) );
+	fs_numPakDirs = 0;
+}
+
+/*
+================
+FS_ListPakDir
+
+The pk3 files and directories in curpath, listed again unless its watch
+says nothing changed. The lists stay with the directory.
+================
+*/
+static pakDir_t *FS_ListPakDir( const char *curpath, qboolean *unchanged ) {
+	pakDir_t	*pakDir;
+	int			i;
+
+	for ( i = 0, pakDir = fs_pakDirs ; i < fs_numPakDirs ; i++, pakDir++ ) {
+		if ( !strcmp( pakDir->path, curpath ) ) {
+			break;
+		}
+	}
+
+	if ( i == fs_numPakDirs ) {
+		if ( fs_numPakDirs == MAX_PAK_DIRS ) {
+			FS_ForgetPakDirs();
+		}
+		pakDir = &fs_pakDirs[fs_numPakDirs++];
+		Q_strncpyz( pakDir->path, curpath, sizeof( pakDir->path ) );
+	}
+
+	*unchanged = pakDir->listed && pakDir->watch && !Sys_DirectoryChanged( pakDir->watch );
+	if ( *unchanged ) {
+		return pakDir;
+	}
+
+	// watch before listing, so nothing slips in between
+	if ( !pakDir->watch ) {
+		pakDir->watch = Sys_WatchDirectory( curpath, ".pk3" );
+	}
+
+	Sys_FreeFileList( pakDir->pakfiles );
+	Sys_FreeFileList( pakDir->pakdirs );
+
+	pakDir->pakfiles = Sys_ListFiles( curpath, ".pk3", NULL, &pakDir->numfiles, qfalse );
+	qsort( pakDir->pakfiles, pakDir->numfiles, sizeof(char*), paksort );
+
+	// Get top level directories (we'll filter them later since the Sys_ListFiles filtering is terrible)
+	pakDir->pakdirs = Sys_ListFiles( curpath, "/", NULL, &pakDir->numdirs, qfalse );
+	qsort( pakDir->pakdirs, pakDir->numdirs, sizeof(char *), paksort );
+
+	pakDir->listed = qtrue;
+	return pakDir;
+}
+
 /*
 ================
 FS_AddGameDirectory
@@ -2946,6 +5347,10 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 
 	int				pakwhich;
 	int				len;
+	pakScan_t		*scans;
+	pakDir_t		*pakDir;
+	qboolean		unchanged;
+	int				i;
 
 	// Unique
 	for ( sp = fs_searchpaths ; sp ; sp = sp->next ) {
@@ -2954,6 +5359,8 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 		}
 	}
 
+	FS_InvalidateFileIndex();
+
 	Q_strncpyz( fs_gamedir, dir, sizeof( fs_gamedir ) );
 
 	// find all pak files in this directory
@@ -2961,18 +5368,28 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 	curpath[strlen(curpath) - 1] = '\0';	// strip the trailing slash
 
 	// Get .pk3 files
-	pakfiles = Sys_ListFiles(curpath, ".pk3", NULL, &numfiles, qfalse);
+	pakDir = FS_ListPakDir( curpath, &unchanged );
+	pakfiles = pakDir->pakfiles;
+	numfiles = pakDir->numfiles;
+
+	// anything to read goes into the index
+	if ( !unchanged && !fs_pakIndexLoaded ) {
+		FS_LoadPakIndex();
+	}
 
-	qsort( pakfiles, numfiles, sizeof(char*), paksort );
+	scans = Z_Malloc( numfiles * sizeof( *scans ) + 1 );
+	for ( i = 0 ; i < numfiles ; i++ ) {
+		Q_strncpyz( scans[i].path, FS_BuildOSPath( path, dir, pakfiles[i] ), sizeof( scans[i].path ) );
+		scans[i].unchanged = unchanged;
+	}
+	Com_RunParallel( FS_ScanPakJob, scans, numfiles );
 
 	if ( fs_numServerPaks ) {
 		numdirs = 0;
 		pakdirs = NULL;
 	} else {
-		// Get top level directories (we'll filter them later since the Sys_ListFiles filtering is terrible)
-		pakdirs = Sys_ListFiles(curpath, "/", NULL, &numdirs, qfalse);
-
-		qsort( pakdirs, numdirs, sizeof(char *), paksort );
+		numdirs = pakDir->numdirs;
+		pakdirs = pakDir->pakdirs;
 	}
 
 	pakfilesi = 0;
@@ -2999,8 +5416,7 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 
 		if (pakwhich) {
 			// The next .pk3 file is before the next .pk3dir
-			pakfile = FS_BuildOSPath(path, dir, pakfiles[pakfilesi]);
-			if ((pak = FS_LoadZipFile(pakfile, pakfiles[pakfilesi], dir)) == 0) {
+			if ((pak = FS_LoadScannedPak(&scans[pakfilesi], pakfiles[pakfilesi], dir)) == 0) {
 				// This isn't a .pk3! Next!
 				pakfilesi++;
 				continue;
@@ -3045,8 +5461,8 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 	}
 
 	// done
-	Sys_FreeFileList( pakfiles );
-	Sys_FreeFileList( pakdirs );
+	FS_FreePakScans( scans, numfiles );
+	Z_Free( scans );
 
 	//
 	// add the directory to the search path
@@ -3096,11 +5512,11 @@ qboolean FS_CheckDirTraversal(const char *checkdir)
 FS_InvalidGameDir
 
 return true if path is a reference to current directory or directory traversal
-or a sub-directory
+or a sub-directory, or the private cache directory
 ================
 */
 qboolean FS_InvalidGameDir( const char *gamedir ) {
-	if ( !strcmp( gamedir, "." ) || !strcmp( gamedir, ".." )
+	if ( !strcmp( gamedir, "." ) || !strcmp( gamedir, ".." ) || !Q_stricmp( gamedir, FS_CACHE_DIR )
 		|| strchr( gamedir, '/' ) || strchr( gamedir, '\\' ) ) {
 		return qtrue;
 	}
@@ -3226,6 +5642,42 @@ qboolean FS_ComparePaks( char *neededpaks, int len, qboolean dlstring ) {
 	return qfalse; // We have them all
 }
 
+/*
+================
+FS_ReopenPaks
+
+After a fork() the paks that are read through a FILE share its offset
+with the other process, they are closed to be opened again by
+FS_PakHandle. Mapped ones and any with a file open in them are kept.
+The directory watches are dropped, the new process lists again.
+================
+*/
+void FS_ReopenPaks( void ) {
+	searchpath_t	*p;
+	int				i;
+
+	for ( p = fs_searchpaths ; p ; p = p->next ) {
+		if ( !p->pack || !p->pack->handle || p->pack->mapData ) {
+			continue;
+		}
+
+		for ( i = 1 ; i < MAX_FILE_HANDLES ; i++ ) {
+			if ( fsh[i].zipFile && fsh[i].handleFiles.file.z == p->pack->handle ) {
+				break;
+			}
+		}
+		if ( i < MAX_FILE_HANDLES ) {
+			continue;
+		}
+
+		unzClose( p->pack->handle );
+		p->pack->handle = NULL;
+	}
+
+	// the watches would have the two processes take events from each other
+	FS_ForgetPakDirs();
+}
+
 /*
 ================
 FS_Shutdown
@@ -3258,6 +5710,8 @@ void FS_Shutdown( qboolean closemfp ) {
 
 	// any FS_ calls will now be an error until reinitialized
 	fs_searchpaths = NULL;
+	FS_InvalidateFileIndex();
+	FS_FreeMapCatalog();
 
 	Cmd_RemoveCommand( "path" );
 	Cmd_RemoveCommand( "dir" );
@@ -3265,6 +5719,12 @@ void FS_Shutdown( qboolean closemfp ) {
 	Cmd_RemoveCommand( "touchFile" );
 	Cmd_RemoveCommand( "which" );
 
+	// quitting, not restarting
+	if (closemfp) {
+		FS_FreeParkedPaks();
+		FS_ForgetPakDirs();
+	}
+
 #ifdef FS_MISSING
 	if (closemfp) {
 		fclose(missingFiles);
@@ -3292,6 +5752,8 @@ static void FS_ReorderPurePaks( void )
 	if ( !fs_numServerPaks )
 		return;
 
+	FS_InvalidateFileIndex();
+
 	p_insert_index = &fs_searchpaths; // we insert in order at the beginning of the list
 	for ( i = 0 ; i < fs_numServerPaks ; i++ ) {
 		p_previous = p_insert_index; // track the pointer-to-current-item
@@ -3404,6 +5866,7 @@ void FS_ReorderPaks( void )
 	if (tail != NULL) {
 		tail->next = fs_searchpaths;
 		fs_searchpaths = head;
+		FS_InvalidateFileIndex();
 	}
 
 	fs_mapNameChanged = qfalse;
@@ -3429,6 +5892,9 @@ static void FS_Startup( const char *gameName )
 	fs_basegame = Cvar_Get ("fs_basegame", "", CVAR_INIT );
 	fs_lowPriorityDownloads = Cvar_Get ("fs_lowPriorityDownloads", "1", CVAR_ARCHIVE|CVAR_LATCH);
 	fs_reorderPaks = Cvar_Get ("fs_reorderPaks", "1", CVAR_ARCHIVE|CVAR_LATCH);
+	// mapping every pk3 could run a 32 bit process out of address space
+	fs_mmapPaks = Cvar_Get ("fs_mmapPaks", sizeof( void * ) >= 8 ? "1" : "0", CVAR_ARCHIVE|CVAR_LATCH);
+	fs_missingCacheMsec = Cvar_Get ("fs_missingCacheMsec", "5000", CVAR_ARCHIVE);
 	fs_defaultHomePath = Cvar_Get ("fs_defaultHomePath", "0", CVAR_INIT|CVAR_PROTECTED );
 
 	if (fs_defaultHomePath->integer == 1) {
@@ -3548,6 +6014,9 @@ static void FS_Startup( const char *gameName )
 	}
 
 
+	FS_WritePakIndex();
+	FS_FreePakIndex();
+
 	// add our commands
 	Cmd_AddCommand ("path", FS_Path_f);
 	Cmd_AddCommand ("dir", FS_Dir_f );
@@ -3566,6 +6035,8 @@ static void FS_Startup( const char *gameName )
 
 	fs_gamedirvar->modified = qfalse; // We just loaded, it's not modified
 
+	FS_RefreshMapCatalog();
+
 	Com_Printf( "----------------------\n" );
 
 #ifdef FS_MISSING
@@ -3785,6 +6256,36 @@ const char *FS_ReferencedPakNames( void ) {
 	return info;
 }
 
+/*
+=====================
+FS_PakFilename
+
+Returns the full path of the pk3 named like in FS_ReferencedPakNames,
+gamename/basename, or NULL if no such pk3 is loaded
+=====================
+*/
+const char *FS_PakFilename( const char *name ) {
+	searchpath_t	*search;
+	const char		*base;
+	int				len;
+
+	base = strchr( name, '/' );
+	if ( !base ) {
+		return NULL;
+	}
+	len = base - name;
+	base++;
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack && !Q_stricmp( search->pack->pakBasename, base )
+			&& !Q_stricmpn( search->pack->pakGamename, name, len ) && !search->pack->pakGamename[len] ) {
+			return search->pack->pakFilename;
+		}
+	}
+
+	return NULL;
+}
+
 /*
 =====================
 FS_ClearPakReferences
@@ -3805,6 +6306,17 @@ void FS_ClearPakReferences( int flags ) {
 }
 
 
+/*
+=====================
+FS_PureServerActive
+
+While only the server's paks are searched, see FS_PureServerSetLoadedPaks
+=====================
+*/
+qboolean FS_PureServerActive( void ) {
+	return fs_numServerPaks != 0;
+}
+
 /*
 =====================
 FS_PureServerSetLoadedPaks
@@ -4024,7 +6536,9 @@ FS_Restart
 void FS_Restart( int checksumFeed ) {
 	const char *lastGameDir;
 
-	// free anything we currently have loaded
+	// free anything we currently have loaded, but the paks that may be
+	// taken back
+	FS_ParkPaks();
 	FS_Shutdown(qfalse);
 
 	// set the checksum feed
@@ -4035,6 +6549,7 @@ void FS_Restart( int checksumFeed ) {
 
 	// try to start up normally
 	FS_Startup(com_basegame->string);
+	FS_FreeParkedPaks();
 
 	// if we can't find default.cfg, assume that the paths are
 	// busted and error out now, rather than getting an unreadable
@@ -49,12 +49,12 @@ void	Huff_setBloc(int _bloc)
 	bloc = _bloc;
 }
 
+// the receive side keeps its position on the caller's offset and leaves
+// bloc alone, so separate threads can read their own messages at once
 int		Huff_getBit( byte *fin, int *offset) {
 	int t;
-	bloc = *offset;
-	t = (fin[(bloc>>3)] >> (bloc&7)) & 0x1;
-	bloc++;
-	*offset = bloc;
+	t = (fin[(*offset>>3)] >> (*offset&7)) & 0x1;
+	(*offset)++;
 	return t;
 }
 
@@ -280,18 +280,19 @@ int Huff_Receive (node_t *node, int *ch, byte *fin) {
 
 /* Get a symbol */
 void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxoffset) {
-	bloc = *offset;
+	int pos = *offset;
 	while (node && node->symbol == INTERNAL_NODE) {
-		if (bloc >= maxoffset) {
+		if (pos >= maxoffset) {
 			*ch = 0;
 			*offset = maxoffset + 1;
 			return;
 		}
-		if (get_bit(fin)) {
+		if ((fin[(pos>>3)] >> (pos&7)) & 0x1) {
 			node = node->right;
 		} else {
 			node = node->left;
 		}
+		pos++;
 	}
 	if (!node) {
 		*ch = 0;
@@ -299,7 +300,7 @@ void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxo
 //		Com_Error(ERR_DROP, "Illegal tree!");
 	}
 	*ch = node->symbol;
-	*offset = bloc;
+	*offset = pos;
 }
 
 /* Send the prefix code for this node */
@@ -452,3 +453,157 @@ void Huff_Init(huffman_t *huff) {
 	huff->compressor.tree->parent = huff->compressor.tree->left = huff->compressor.tree->right = NULL;
 }
 
+
+/*
+ * Static code tables
+ *
+ * Once a tree has stopped adapting, the bits of each symbol never change,
+ * so they are looked up instead of walking the tree one bit at a time.
+ * The output is bit for bit the same as Huff_offsetTransmit and
+ * Huff_offsetReceive.
+ */
+
+static void Huff_fillLookup( huffTable_t *table, node_t *node, unsigned int code, int depth ) {
+	int i;
+
+	if ( !node ) {
+		return;
+	}
+
+	if ( node->symbol != INTERNAL_NODE ) {
+		if ( node->symbol < 0 || node->symbol > HMAX || depth > HUFF_LOOKUP_BITS ) {
+			return;
+		}
+		for ( i = code; i < ( 1 << HUFF_LOOKUP_BITS ); i += 1 << depth ) {
+			table->lookup[i] = node->symbol | ( depth << 9 );
+		}
+		return;
+	}
+
+	if ( depth == HUFF_LOOKUP_BITS ) {
+		return;		// left at 0, walked in the tree
+	}
+
+	Huff_fillLookup( table, node->left, code, depth + 1 );
+	Huff_fillLookup( table, node->right, code | ( 1 << depth ), depth + 1 );
+}
+
+void Huff_BuildTable( huffTable_t *table, huff_t *compressor, huff_t *decompressor ) {
+	node_t			*node;
+	unsigned int	code;
+	int				ch, length;
+
+	Com_Memset( table, 0, sizeof( *table ) );
+
+	for ( ch = 0; ch < HMAX; ch++ ) {
+		if ( !compressor->loc[ch] ) {
+			return;		// not transmittable without a NYT escape
+		}
+
+		// collect the path from the leaf up, the root's bit goes first
+		code = 0;
+		length = 0;
+		for ( node = compressor->loc[ch]; node->parent; node = node->parent ) {
+			if ( length == 32 ) {
+				return;
+			}
+			code = ( code << 1 ) | ( node->parent->right == node ? 1 : 0 );
+			length++;
+		}
+
+		table->code[ch] = code;
+		table->length[ch] = length;
+	}
+
+	Huff_fillLookup( table, decompressor->tree, 0, 0 );
+	table->tree = decompressor->tree;
+	table->valid = qtrue;
+}
+
+void Huff_tableTransmit( const huffTable_t *table, int ch, byte *fout, int *offset, int maxoffset ) {
+	unsigned int	code = table->code[ch];
+	int				count = table->length[ch];
+	int				pos = *offset;
+	int				shift, n;
+
+	if ( pos + count > maxoffset ) {
+		*offset = maxoffset + 1;
+		return;
+	}
+
+	while ( count > 0 ) {
+		shift = pos & 7;
+		n = 8 - shift;
+		if ( n > count ) {
+			n = count;
+		}
+
+		if ( !shift ) {
+			fout[pos >> 3] = 0;
+		}
+		fout[pos >> 3] |= ( code & ( ( 1 << n ) - 1 ) ) << shift;
+
+		code >>= n;
+		count -= n;
+		pos += n;
+	}
+
+	*offset = pos;
+}
+
+void Huff_tableReceive( const huffTable_t *table, int *ch, byte *fin, int *offset, int maxoffset ) {
+	int				pos = *offset;
+	int				lastByte, i, length;
+	unsigned int	bits;
+	node_t			*node;
+
+	if ( pos >= maxoffset ) {
+		*ch = 0;
+		*offset = maxoffset + 1;
+		return;
+	}
+
+	// peek at the next bits without reading past the end of the data
+	lastByte = ( maxoffset - 1 ) >> 3;
+	bits = 0;
+	for ( i = 0; i < 3 && ( pos >> 3 ) + i <= lastByte; i++ ) {
+		bits |= fin[( pos >> 3 ) + i] << ( i * 8 );
+	}
+	bits = ( bits >> ( pos & 7 ) ) & ( ( 1 << HUFF_LOOKUP_BITS ) - 1 );
+
+	length = table->lookup[bits] >> 9;
+
+	if ( !length ) {
+		// long code, walk down the tree
+		node = table->tree;
+		while ( node && node->symbol == INTERNAL_NODE ) {
+			if ( pos >= maxoffset ) {
+				*ch = 0;
+				*offset = maxoffset + 1;
+				return;
+			}
+			if ( ( fin[pos >> 3] >> ( pos & 7 ) ) & 0x1 ) {
+				node = node->right;
+			} else {
+				node = node->left;
+			}
+			pos++;
+		}
+		if ( !node ) {
+			*ch = 0;
+			return;
+		}
+		*ch = node->symbol;
+		*offset = pos;
+		return;
+	}
+
+	if ( pos + length > maxoffset ) {
+		*ch = 0;
+		*offset = maxoffset + 1;
+		return;
+	}
+
+	*ch = table->lookup[bits] & 0x1ff;
+	*offset = pos + length;
+}
@@ -178,5 +178,179 @@ void fill_fopen_filefunc (pzlib_filefunc_def)
     pzlib_filefunc_def->zseek_file = fseek_file_func;
     pzlib_filefunc_def->zclose_file = fclose_file_func;
     pzlib_filefunc_def->zerror_file = ferror_file_func;
+    pzlib_filefunc_def->zmap_file = NULL;
     pzlib_filefunc_def->opaque = NULL;
 }
+
+
+/* memory files, the opaque zlib_memory_file is only read when opening */
+
+typedef struct
+{
+    zlib_memory_file memory;
+    uLong            pos;
+} memory_stream;
+
+voidpf ZCALLBACK mopen_file_func OF((
+   voidpf opaque,
+   const char* filename,
+   int mode));
+
+uLong ZCALLBACK mread_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   void* buf,
+   uLong size));
+
+uLong ZCALLBACK mwrite_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   const void* buf,
+   uLong size));
+
+long ZCALLBACK mtell_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+long ZCALLBACK mseek_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   uLong offset,
+   int origin));
+
+int ZCALLBACK mclose_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+int ZCALLBACK merror_file_func OF((
+   voidpf opaque,
+   voidpf stream));
+
+const void* ZCALLBACK mmap_file_func OF((
+   voidpf opaque,
+   voidpf stream,
+   uLong offset,
+   uLong size));
+
+
+voidpf ZCALLBACK mopen_file_func (opaque, filename, mode)
+   voidpf opaque;
+   const char* filename;
+   int mode;
+{
+    memory_stream* stream;
+
+    if ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER)!=ZLIB_FILEFUNC_MODE_READ)
+        return NULL;
+
+    stream = (memory_stream*)malloc(sizeof(memory_stream));
+    if (stream==NULL)
+        return NULL;
+    stream->memory = *(zlib_memory_file*)opaque;
+    stream->pos = 0;
+    return stream;
+}
+
+uLong ZCALLBACK mread_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   void* buf;
+   uLong size;
+{
+    memory_stream* mem = (memory_stream*)stream;
+
+    if (mem->pos >= mem->memory.size)
+        return 0;
+    if (size > mem->memory.size - mem->pos)
+        size = mem->memory.size - mem->pos;
+    memcpy(buf, mem->memory.base + mem->pos, (size_t)size);
+    mem->pos += size;
+    return size;
+}
+
+uLong ZCALLBACK mwrite_file_func (opaque, stream, buf, size)
+   voidpf opaque;
+   voidpf stream;
+   const void* buf;
+   uLong size;
+{
+    return 0;
+}
+
+long ZCALLBACK mtell_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    return (long)((memory_stream*)stream)->pos;
+}
+
+long ZCALLBACK mseek_file_func (opaque, stream, offset, origin)
+   voidpf opaque;
+   voidpf stream;
+   uLong offset;
+   int origin;
+{
+    memory_stream* mem = (memory_stream*)stream;
+    uLong pos;
+
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        pos = mem->pos + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        pos = mem->memory.size + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        pos = offset;
+        break;
+    default: return -1;
+    }
+    if (pos > mem->memory.size)
+        return -1;
+    mem->pos = pos;
+    return 0;
+}
+
+int ZCALLBACK mclose_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    free(stream);
+    return 0;
+}
+
+int ZCALLBACK merror_file_func (opaque, stream)
+   voidpf opaque;
+   voidpf stream;
+{
+    return 0;
+}
+
+const void* ZCALLBACK mmap_file_func (opaque, stream, offset, size)
+   voidpf opaque;
+   voidpf stream;
+   uLong offset;
+   uLong size;
+{
+    memory_stream* mem = (memory_stream*)stream;
+
+    if (offset > mem->memory.size || size > mem->memory.size - offset)
+        return NULL;
+    return mem->memory.base + offset;
+}
+
+void fill_memory_filefunc (pzlib_filefunc_def, memory)
+  zlib_filefunc_def* pzlib_filefunc_def;
+  zlib_memory_file* memory;
+{
+    pzlib_filefunc_def->zopen_file = mopen_file_func;
+    pzlib_filefunc_def->zread_file = mread_file_func;
+    pzlib_filefunc_def->zwrite_file = mwrite_file_func;
+    pzlib_filefunc_def->ztell_file = mtell_file_func;
+    pzlib_filefunc_def->zseek_file = mseek_file_func;
+    pzlib_filefunc_def->zclose_file = mclose_file_func;
+    pzlib_filefunc_def->zerror_file = merror_file_func;
+    pzlib_filefunc_def->zmap_file = mmap_file_func;
+    pzlib_filefunc_def->opaque = memory;
+}
@@ -42,6 +42,7 @@ typedef long   (ZCALLBACK *tell_file_func) OF((voidpf opaque, voidpf stream));
 typedef long   (ZCALLBACK *seek_file_func) OF((voidpf opaque, voidpf stream, uLong offset, int origin));
 typedef int    (ZCALLBACK *close_file_func) OF((voidpf opaque, voidpf stream));
 typedef int    (ZCALLBACK *testerror_file_func) OF((voidpf opaque, voidpf stream));
+typedef const void* (ZCALLBACK *map_file_func) OF((voidpf opaque, voidpf stream, uLong offset, uLong size));
 
 typedef struct zlib_filefunc_def_s
 {
@@ -52,12 +53,21 @@ typedef struct zlib_filefunc_def_s
     seek_file_func      zseek_file;
     close_file_func     zclose_file;
     testerror_file_func zerror_file;
+    map_file_func       zmap_file;      /* NULL, or hands out pointers into the file */
     voidpf              opaque;
 } zlib_filefunc_def;
 
+/* a zip file already in memory, such as a mapped pk3 */
+typedef struct zlib_memory_file_s
+{
+    const unsigned char* base;
+    uLong                size;
+} zlib_memory_file;
+
 
 
 void fill_fopen_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def));
+void fill_memory_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def, zlib_memory_file* memory));
 
 #define ZREAD(filefunc,filestream,buf,size) ((*((filefunc).zread_file))((filefunc).opaque,filestream,buf,size))
 #define ZWRITE(filefunc,filestream,buf,size) ((*((filefunc).zwrite_file))((filefunc).opaque,filestream,buf,size))
@@ -65,6 +75,7 @@ void fill_fopen_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def));
 #define ZSEEK(filefunc,filestream,pos,mode) ((*((filefunc).zseek_file))((filefunc).opaque,filestream,pos,mode))
 #define ZCLOSE(filefunc,filestream) ((*((filefunc).zclose_file))((filefunc).opaque,filestream))
 #define ZERROR(filefunc,filestream) ((*((filefunc).zerror_file))((filefunc).opaque,filestream))
+#define ZMAP(filefunc,filestream,offset,size) ((*((filefunc).zmap_file))((filefunc).opaque,filestream,offset,size))
 
 
 #ifdef __cplusplus
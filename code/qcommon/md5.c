@@ -256,6 +256,45 @@ static void MD5Final(struct MD5Context *ctx, unsigned char *digest)
     memset(ctx, 0, sizeof(*ctx));	/* In case it's sensitive */
 }
 
+/*
+ * HMAC-MD5 (RFC 2104) of the prefix followed by the data, the digest is
+ * 16 bytes.
+ */
+void Com_HMACMD5( const byte *key, int keyLength, const char *prefix, int prefix_len,
+	const void *data, int length, byte *digest )
+{
+	MD5_CTX md5;
+	unsigned char keyBlock[64], pad[64];
+	int i;
+
+	memset(keyBlock, 0, sizeof(keyBlock));
+	if(keyLength > sizeof(keyBlock)) {
+		MD5Init(&md5);
+		MD5Update(&md5, key, keyLength);
+		MD5Final(&md5, keyBlock);
+	} else {
+		memcpy(keyBlock, key, keyLength);
+	}
+
+	for(i = 0; i < sizeof(pad); i++)
+		pad[i] = keyBlock[i] ^ 0x36;
+	MD5Init(&md5);
+	MD5Update(&md5, pad, sizeof(pad));
+	if(prefix_len > 0)
+		MD5Update(&md5, (unsigned char *)prefix, prefix_len);
+	MD5Update(&md5, data, length);
+	MD5Final(&md5, digest);
+
+	for(i = 0; i < sizeof(pad); i++)
+		pad[i] = keyBlock[i] ^ 0x5c;
+	MD5Init(&md5);
+	MD5Update(&md5, pad, sizeof(pad));
+	MD5Update(&md5, digest, 16);
+	MD5Final(&md5, digest);
+
+	memset(keyBlock, 0, sizeof(keyBlock));
+	memset(pad, 0, sizeof(pad));
+}
 
 char *Com_MD5File( const char *fn, int length, const char *prefix, int prefix_len )
 {
@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "qcommon.h"
 
 static huffman_t		msgHuff;
+static huffTable_t		msgHuffTable;	// msgHuff is never adapted after MSG_initHuffman
 
 static qboolean			msgInit = qfalse;
 
@@ -159,7 +160,11 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 		}
 		if ( bits ) {
 			for( i = 0; i < bits; i += 8 ) {
-				Huff_offsetTransmit( &msgHuff.compressor, (value & 0xff), msg->data, &msg->bit, msg->maxsize << 3 );
+				if ( msgHuffTable.valid ) {
+					Huff_tableTransmit( &msgHuffTable, (value & 0xff), msg->data, &msg->bit, msg->maxsize << 3 );
+				} else {
+					Huff_offsetTransmit( &msgHuff.compressor, (value & 0xff), msg->data, &msg->bit, msg->maxsize << 3 );
+				}
 				value = (value >> 8);
 
 				if ( msg->bit > msg->maxsize << 3 ) {
@@ -172,6 +177,170 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 	}
 }
 
+/*
+=================
+MSG_WriteBitstream
+
+Appends bits that were written to another bitstream message starting at
+bit 0, without encoding them again. This is only valid because msgHuff
+is never adapted while writing.
+=================
+*/
+void MSG_WriteBitstream( msg_t *msg, const byte *data, int bits ) {
+	int		i, shift, bytes, outBytes;
+	byte	*out;
+
+	oldsize += bits;
+
+	if ( msg->overflowed || bits <= 0 ) {
+		return;
+	}
+
+	if ( msg->oob ) {
+		Com_Error( ERR_DROP, "MSG_WriteBitstream: not a bitstream message" );
+	}
+
+	if ( msg->bit + bits > msg->maxsize << 3 ) {
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	shift = msg->bit & 7;
+	out = msg->data + ( msg->bit >> 3 );
+	bytes = ( bits + 7 ) >> 3;
+
+	if ( !shift ) {
+		Com_Memcpy( out, data, bytes );
+	} else {
+		// the bits above msg->bit in the current byte are always clear
+		outBytes = ( shift + bits + 7 ) >> 3;
+		for ( i = 0 ; i < bytes ; i++ ) {
+			out[i] |= data[i] << shift;
+			if ( i + 1 < outBytes ) {
+				out[i + 1] = data[i] >> ( 8 - shift );
+			}
+		}
+	}
+
+	msg->bit += bits;
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
+/*
+=============================================================================
+
+word at a time bit writer
+
+Collects the bits of a run of MSG_WriteBits calls in a 64 bit accumulator
+and stores them four bytes at a time, with the same output as MSG_WriteBits.
+Messages that can't use msgHuffTable go through MSG_WriteBits directly.
+
+=============================================================================
+*/
+
+typedef struct {
+	msg_t		*msg;
+	qboolean	direct;
+	uint64_t	acc;		// pending bits, the first one in bit 0
+	int			count;		// number of pending bits
+	int			bit;		// message bit offset that acc starts at, a multiple of 8
+	int			maxbits;
+} msgBitWriter_t;
+
+static void MSG_BeginBitWriter( msgBitWriter_t *bw, msg_t *msg ) {
+	bw->msg = msg;
+	bw->direct = ( msg->oob || !msgHuffTable.valid ) ? qtrue : qfalse;
+	bw->maxbits = msg->maxsize << 3;
+
+	// pick up the bits already written to the current byte
+	bw->bit = msg->bit & ~7;
+	bw->count = msg->bit & 7;
+	bw->acc = bw->count ? ( msg->data[bw->bit >> 3] & ( ( 1 << bw->count ) - 1 ) ) : 0;
+}
+
+static ID_INLINE void MSG_FlushBitWriter( msgBitWriter_t *bw ) {
+	byte	*out;
+
+	while ( bw->count >= 32 ) {
+		out = bw->msg->data + ( bw->bit >> 3 );
+		out[0] = bw->acc;
+		out[1] = bw->acc >> 8;
+		out[2] = bw->acc >> 16;
+		out[3] = bw->acc >> 24;
+		bw->acc >>= 32;
+		bw->count -= 32;
+		bw->bit += 32;
+	}
+}
+
+static void MSG_EndBitWriter( msgBitWriter_t *bw ) {
+	msg_t	*msg = bw->msg;
+	byte	*out;
+	int		i;
+
+	if ( bw->direct ) {
+		return;
+	}
+
+	MSG_FlushBitWriter( bw );
+
+	out = msg->data + ( bw->bit >> 3 );
+	for ( i = 0 ; i < bw->count ; i += 8 ) {
+		*out++ = bw->acc >> i;
+	}
+
+	msg->bit = bw->bit + bw->count;
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
+static ID_INLINE void MSG_PutBits( msgBitWriter_t *bw, int value, int bits ) {
+	int		nbits, ch;
+
+	if ( bw->direct ) {
+		MSG_WriteBits( bw->msg, value, bits );
+		return;
+	}
+
+	oldsize += bits;
+
+	if ( bw->msg->overflowed ) {
+		return;
+	}
+
+	if ( bits < 0 ) {
+		bits = -bits;
+	}
+
+	value &= ( 0xffffffff >> ( 32 - bits ) );
+
+	// the odd low bits go out raw
+	nbits = bits & 7;
+	if ( nbits ) {
+		if ( bw->bit + bw->count + nbits > bw->maxbits ) {
+			bw->msg->overflowed = qtrue;
+			return;
+		}
+		bw->acc |= (uint64_t)( value & ( ( 1 << nbits ) - 1 ) ) << bw->count;
+		bw->count += nbits;
+		value = (unsigned int)value >> nbits;
+		bits -= nbits;
+		MSG_FlushBitWriter( bw );
+	}
+
+	// whole bytes are huffman coded
+	for ( ; bits > 0 ; bits -= 8 ) {
+		ch = value & 0xff;
+		if ( bw->bit + bw->count + msgHuffTable.length[ch] > bw->maxbits ) {
+			bw->msg->overflowed = qtrue;
+			return;
+		}
+		bw->acc |= (uint64_t)msgHuffTable.code[ch] << bw->count;
+		bw->count += msgHuffTable.length[ch];
+		value = (unsigned int)value >> 8;
+		MSG_FlushBitWriter( bw );
+	}
+}
+
 int MSG_ReadBits( msg_t *msg, int bits ) {
 	int			value;
 	int			get;
@@ -237,7 +406,11 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 		if (bits) {
 //			fp = fopen("c:\\netchan.bin", "a");
 			for(i=0;i<bits;i+=8) {
-				Huff_offsetReceive (msgHuff.decompressor.tree, &get, msg->data, &msg->bit, msg->cursize<<3);
+				if ( msgHuffTable.valid ) {
+					Huff_tableReceive( &msgHuffTable, &get, msg->data, &msg->bit, msg->cursize<<3 );
+				} else {
+					Huff_offsetReceive (msgHuff.decompressor.tree, &get, msg->data, &msg->bit, msg->cursize<<3);
+				}
 //				fwrite(&get, 1, 1, fp);
 				value = (unsigned int)value | ((unsigned int)get<<(i+nbits));
 
@@ -444,8 +617,9 @@ float MSG_ReadFloat( msg_t *msg ) {
 	return dat.f;	
 }
 
+// the string buffers are per thread, demostats parses demos on several
 char *MSG_ReadString( msg_t *msg ) {
-	static char	string[MAX_STRING_CHARS];
+	static Q_THREADLOCAL char	string[MAX_STRING_CHARS];
 	int		l,c;
 	
 	l = 0;
@@ -475,7 +649,7 @@ char *MSG_ReadString( msg_t *msg ) {
 }
 
 char *MSG_ReadBigString( msg_t *msg ) {
-	static char	string[BIG_INFO_STRING];
+	static Q_THREADLOCAL char	string[BIG_INFO_STRING];
 	int		l,c;
 	
 	l = 0;
@@ -505,7 +679,7 @@ char *MSG_ReadBigString( msg_t *msg ) {
 }
 
 char *MSG_ReadStringLine( msg_t *msg ) {
-	static char	string[MAX_STRING_CHARS];
+	static Q_THREADLOCAL char	string[MAX_STRING_CHARS];
 	int		l,c;
 
 	l = 0;
@@ -821,6 +995,7 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 	int			trunc;
 	float		fullFloat;
 	int			*fromF, *toF;
+	msgBitWriter_t	bw;
 
 	numFields = ARRAY_LEN( entityStateFields );
 
@@ -866,11 +1041,13 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 		return;
 	}
 
-	MSG_WriteBits( msg, to->number, GENTITYNUM_BITS );
-	MSG_WriteBits( msg, 0, 1 );			// not removed
-	MSG_WriteBits( msg, 1, 1 );			// we have a delta
+	MSG_BeginBitWriter( &bw, msg );
+
+	MSG_PutBits( &bw, to->number, GENTITYNUM_BITS );
+	MSG_PutBits( &bw, 0, 1 );			// not removed
+	MSG_PutBits( &bw, 1, 1 );			// we have a delta
 
-	MSG_WriteByte( msg, lc );	// # of changes
+	MSG_PutBits( &bw, lc, 8 );	// # of changes
 
 	oldsize += numFields;
 
@@ -879,11 +1056,11 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 		toF = (int *)( (byte *)to + field->offset );
 
 		if ( *fromF == *toF ) {
-			MSG_WriteBits( msg, 0, 1 );	// no change
+			MSG_PutBits( &bw, 0, 1 );	// no change
 			continue;
 		}
 
-		MSG_WriteBits( msg, 1, 1 );	// changed
+		MSG_PutBits( &bw, 1, 1 );	// changed
 
 		if ( field->bits == 0 ) {
 			// float
@@ -891,31 +1068,33 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 			trunc = (int)fullFloat;
 
 			if (fullFloat == 0.0f) {
-					MSG_WriteBits( msg, 0, 1 );
+					MSG_PutBits( &bw, 0, 1 );
 					oldsize += FLOAT_INT_BITS;
 			} else {
-				MSG_WriteBits( msg, 1, 1 );
+				MSG_PutBits( &bw, 1, 1 );
 				if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 && 
 					trunc + FLOAT_INT_BIAS < ( 1 << FLOAT_INT_BITS ) ) {
 					// send as small integer
-					MSG_WriteBits( msg, 0, 1 );
-					MSG_WriteBits( msg, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
+					MSG_PutBits( &bw, 0, 1 );
+					MSG_PutBits( &bw, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
 				} else {
 					// send as full floating point value
-					MSG_WriteBits( msg, 1, 1 );
-					MSG_WriteBits( msg, *toF, 32 );
+					MSG_PutBits( &bw, 1, 1 );
+					MSG_PutBits( &bw, *toF, 32 );
 				}
 			}
 		} else {
 			if (*toF == 0) {
-				MSG_WriteBits( msg, 0, 1 );
+				MSG_PutBits( &bw, 0, 1 );
 			} else {
-				MSG_WriteBits( msg, 1, 1 );
+				MSG_PutBits( &bw, 1, 1 );
 				// integer
-				MSG_WriteBits( msg, *toF, field->bits );
+				MSG_PutBits( &bw, *toF, field->bits );
 			}
 		}
 	}
+
+	MSG_EndBitWriter( &bw );
 }
 
 /*
@@ -1128,6 +1307,7 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 	int				*fromF, *toF;
 	float			fullFloat;
 	int				trunc, lc;
+	msgBitWriter_t	bw;
 
 	if (!from) {
 		from = &dummy;
@@ -1145,7 +1325,9 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 		}
 	}
 
-	MSG_WriteByte( msg, lc );	// # of changes
+	MSG_BeginBitWriter( &bw, msg );
+
+	MSG_PutBits( &bw, lc, 8 );	// # of changes
 
 	oldsize += numFields - lc;
 
@@ -1154,11 +1336,11 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 		toF = (int *)( (byte *)to + field->offset );
 
 		if ( *fromF == *toF ) {
-			MSG_WriteBits( msg, 0, 1 );	// no change
+			MSG_PutBits( &bw, 0, 1 );	// no change
 			continue;
 		}
 
-		MSG_WriteBits( msg, 1, 1 );	// changed
+		MSG_PutBits( &bw, 1, 1 );	// changed
 //		pcount[i]++;
 
 		if ( field->bits == 0 ) {
@@ -1169,16 +1351,16 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 			if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 && 
 				trunc + FLOAT_INT_BIAS < ( 1 << FLOAT_INT_BITS ) ) {
 				// send as small integer
-				MSG_WriteBits( msg, 0, 1 );
-				MSG_WriteBits( msg, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
+				MSG_PutBits( &bw, 0, 1 );
+				MSG_PutBits( &bw, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
 			} else {
 				// send as full floating point value
-				MSG_WriteBits( msg, 1, 1 );
-				MSG_WriteBits( msg, *toF, 32 );
+				MSG_PutBits( &bw, 1, 1 );
+				MSG_PutBits( &bw, *toF, 32 );
 			}
 		} else {
 			// integer
-			MSG_WriteBits( msg, *toF, field->bits );
+			MSG_PutBits( &bw, *toF, field->bits );
 		}
 	}
 
@@ -1212,54 +1394,57 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 	}
 
 	if (!statsbits && !persistantbits && !ammobits && !powerupbits) {
-		MSG_WriteBits( msg, 0, 1 );	// no change
+		MSG_PutBits( &bw, 0, 1 );	// no change
 		oldsize += 4;
+		MSG_EndBitWriter( &bw );
 		return;
 	}
-	MSG_WriteBits( msg, 1, 1 );	// changed
+	MSG_PutBits( &bw, 1, 1 );	// changed
 
 	if ( statsbits ) {
-		MSG_WriteBits( msg, 1, 1 );	// changed
-		MSG_WriteBits( msg, statsbits, MAX_STATS );
+		MSG_PutBits( &bw, 1, 1 );	// changed
+		MSG_PutBits( &bw, statsbits, MAX_STATS );
 		for (i=0 ; i<MAX_STATS ; i++)
 			if (statsbits & (1<<i) )
-				MSG_WriteShort (msg, to->stats[i]);
+				MSG_PutBits( &bw, to->stats[i], 16 );
 	} else {
-		MSG_WriteBits( msg, 0, 1 );	// no change
+		MSG_PutBits( &bw, 0, 1 );	// no change
 	}
 
 
 	if ( persistantbits ) {
-		MSG_WriteBits( msg, 1, 1 );	// changed
-		MSG_WriteBits( msg, persistantbits, MAX_PERSISTANT );
+		MSG_PutBits( &bw, 1, 1 );	// changed
+		MSG_PutBits( &bw, persistantbits, MAX_PERSISTANT );
 		for (i=0 ; i<MAX_PERSISTANT ; i++)
 			if (persistantbits & (1<<i) )
-				MSG_WriteShort (msg, to->persistant[i]);
+				MSG_PutBits( &bw, to->persistant[i], 16 );
 	} else {
-		MSG_WriteBits( msg, 0, 1 );	// no change
+		MSG_PutBits( &bw, 0, 1 );	// no change
 	}
 
 
 	if ( ammobits ) {
-		MSG_WriteBits( msg, 1, 1 );	// changed
-		MSG_WriteBits( msg, ammobits, MAX_WEAPONS );
+		MSG_PutBits( &bw, 1, 1 );	// changed
+		MSG_PutBits( &bw, ammobits, MAX_WEAPONS );
 		for (i=0 ; i<MAX_WEAPONS ; i++)
 			if (ammobits & (1<<i) )
-				MSG_WriteShort (msg, to->ammo[i]);
+				MSG_PutBits( &bw, to->ammo[i], 16 );
 	} else {
-		MSG_WriteBits( msg, 0, 1 );	// no change
+		MSG_PutBits( &bw, 0, 1 );	// no change
 	}
 
 
 	if ( powerupbits ) {
-		MSG_WriteBits( msg, 1, 1 );	// changed
-		MSG_WriteBits( msg, powerupbits, MAX_POWERUPS );
+		MSG_PutBits( &bw, 1, 1 );	// changed
+		MSG_PutBits( &bw, powerupbits, MAX_POWERUPS );
 		for (i=0 ; i<MAX_POWERUPS ; i++)
 			if (powerupbits & (1<<i) )
-				MSG_WriteLong( msg, to->powerups[i] );
+				MSG_PutBits( &bw, to->powerups[i], 32 );
 	} else {
-		MSG_WriteBits( msg, 0, 1 );	// no change
+		MSG_PutBits( &bw, 0, 1 );	// no change
 	}
+
+	MSG_EndBitWriter( &bw );
 }
 
 
@@ -1677,6 +1862,7 @@ void MSG_initHuffman( void ) {
 			Huff_addRef(&msgHuff.decompressor,	(byte)i);			// Do update
 		}
 	}
+	Huff_BuildTable(&msgHuffTable, &msgHuff.compressor, &msgHuff.decompressor);
 }
 
 /*
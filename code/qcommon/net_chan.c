@@ -32,6 +32,11 @@ packet header
 [2	fragment start byte]
 [2	fragment length. if < FRAGMENT_SIZE, this is the last fragment]
 
+FRAGMENT_SIZE is what every peer takes. A server may send larger fragments
+to a client that found a path for larger datagrams, so the receiver goes by
+the length of the first fragment instead, which is the same for all but the
+last one. From a peer that keeps to FRAGMENT_SIZE that is the old rule.
+
 if the sequence number is -1, the packet should be handled as an out-of-band
 message instead of as part of a netcon.
 
@@ -47,8 +52,6 @@ to the new value before sending out any replies.
 */
 
 
-#define	MAX_PACKETLEN			1400		// max size of a network packet
-
 #define	FRAGMENT_SIZE			(MAX_PACKETLEN - 100)
 #define	PACKET_HEADER			10			// two ints and a short
 
@@ -93,12 +96,31 @@ void Netchan_Setup(netsrc_t sock, netchan_t *chan, netadr_t adr, int qport, int
 	chan->incomingSequence = 0;
 	chan->outgoingSequence = 1;
 	chan->challenge = challenge;
+	chan->sendFragmentSize = FRAGMENT_SIZE;
 
 #ifdef LEGACY_PROTOCOL
 	chan->compat = compat;
 #endif
 }
 
+/*
+==============
+Netchan_SetPacketLength
+
+Datagrams of up to length bytes reach the other end, which goes by the
+length of the first fragment. Takes effect from the next message.
+==============
+*/
+void Netchan_SetPacketLength( netchan_t *chan, int length ) {
+	if ( length < MAX_PACKETLEN ) {
+		length = MAX_PACKETLEN;
+	} else if ( length > NET_MAX_PACKETLEN ) {
+		length = NET_MAX_PACKETLEN;
+	}
+
+	chan->sendFragmentSize = length - ( MAX_PACKETLEN - FRAGMENT_SIZE );
+}
+
 /*
 =================
 Netchan_TransmitNextFragment
@@ -108,7 +130,7 @@ Send one fragment of the current message
 */
 void Netchan_TransmitNextFragment( netchan_t *chan ) {
 	msg_t		send;
-	byte		send_buf[MAX_PACKETLEN];
+	byte		send_buf[NET_MAX_PACKETLEN];
 	int			fragmentLength;
 	int			outgoingSequence;
 
@@ -129,7 +151,7 @@ void Netchan_TransmitNextFragment( netchan_t *chan ) {
 		MSG_WriteLong(&send, NETCHAN_GENCHECKSUM(chan->challenge, chan->outgoingSequence));
 
 	// copy the reliable message to the packet first
-	fragmentLength = FRAGMENT_SIZE;
+	fragmentLength = chan->unsentFragmentSize;
 	if ( chan->unsentFragmentStart  + fragmentLength > chan->unsentLength ) {
 		fragmentLength = chan->unsentLength - chan->unsentFragmentStart;
 	}
@@ -159,7 +181,7 @@ void Netchan_TransmitNextFragment( netchan_t *chan ) {
 	// that is exactly the fragment length still needs to send
 	// a second packet of zero length so that the other side
 	// can tell there aren't more to follow
-	if ( chan->unsentFragmentStart == chan->unsentLength && fragmentLength != FRAGMENT_SIZE ) {
+	if ( chan->unsentFragmentStart == chan->unsentLength && fragmentLength != chan->unsentFragmentSize ) {
 		chan->outgoingSequence++;
 		chan->unsentFragments = qfalse;
 	}
@@ -172,20 +194,27 @@ Netchan_Transmit
 
 Sends a message to a connection, fragmenting if necessary
 A 0 length will still generate a packet.
+
+The loopback takes whole messages, so those are never fragmented and
+the data is copied once, straight into the loopback buffer.
 ================
 */
 void Netchan_Transmit( netchan_t *chan, int length, const byte *data ) {
 	msg_t		send;
-	byte		send_buf[MAX_PACKETLEN];
+	byte		send_buf[NET_MAX_PACKETLEN];
+	qboolean	loopback;
 
 	if ( length > MAX_MSGLEN ) {
 		Com_Error( ERR_DROP, "Netchan_Transmit: length = %i", length );
 	}
 	chan->unsentFragmentStart = 0;
 
+	loopback = ( chan->remoteAddress.type == NA_LOOPBACK );
+
 	// fragment large reliable messages
-	if ( length >= FRAGMENT_SIZE ) {
+	if ( length >= chan->sendFragmentSize && !loopback ) {
 		chan->unsentFragments = qtrue;
+		chan->unsentFragmentSize = chan->sendFragmentSize;
 		chan->unsentLength = length;
 		Com_Memcpy( chan->unsentBuffer, data, length );
 
@@ -211,10 +240,14 @@ void Netchan_Transmit( netchan_t *chan, int length, const byte *data ) {
 
 	chan->outgoingSequence++;
 
-	MSG_WriteData( &send, data, length );
-
 	// send the datagram
-	NET_SendPacket( chan->sock, send.cursize, send.data, chan->remoteAddress );
+	if ( loopback ) {
+		NET_SendLoopMessage( chan->sock, send.data, send.cursize, data, length );
+		send.cursize += length;
+	} else {
+		MSG_WriteData( &send, data, length );
+		NET_SendPacket( chan->sock, send.cursize, send.data, chan->remoteAddress );
+	}
 
 	// Store send time and size of this packet for rate control
 	chan->lastSentTime = Sys_Milliseconds();
@@ -236,13 +269,13 @@ Netchan_Process
 Returns qfalse if the message should not be processed due to being
 out of order or a fragment.
 
-Msg must be large enough to hold MAX_MSGLEN, because if this is the
-final fragment of a multi-part message, the entire thing will be
-copied out.
+If this is the final fragment of a multi-part message, msg is pointed at
+the reassembled one in the channel, which stays there until the next
+packet for the channel. The loopback never fragments.
 =================
 */
 qboolean Netchan_Process( netchan_t *chan, msg_t *msg ) {
-	int			sequence;
+	int			sequence, littleSequence;
 	int			fragmentStart, fragmentLength;
 	qboolean	fragmented;
 
@@ -356,7 +389,7 @@ qboolean Netchan_Process( netchan_t *chan, msg_t *msg ) {
 
 		// copy the fragment to the fragment buffer
 		if ( fragmentLength < 0 || msg->readcount + fragmentLength > msg->cursize ||
-			chan->fragmentLength + fragmentLength > sizeof( chan->fragmentBuffer ) ) {
+			chan->fragmentLength + fragmentLength > MAX_MSGLEN ) {
 			if ( showdrop->integer || showpackets->integer ) {
 				Com_Printf ("%s:illegal fragment length\n"
 				, NET_AdrToStringwPort (chan->remoteAddress ) );
@@ -364,29 +397,28 @@ qboolean Netchan_Process( netchan_t *chan, msg_t *msg ) {
 			return qfalse;
 		}
 
-		Com_Memcpy( chan->fragmentBuffer + chan->fragmentLength, 
+		// all but the last fragment are as long as the first
+		if ( !fragmentStart ) {
+			chan->fragmentSize = fragmentLength;
+		}
+
+		Com_Memcpy( chan->fragmentBuffer + 4 + chan->fragmentLength, 
 			msg->data + msg->readcount, fragmentLength );
 
 		chan->fragmentLength += fragmentLength;
 
 		// if this wasn't the last fragment, don't process anything
-		if ( fragmentLength == FRAGMENT_SIZE ) {
+		if ( fragmentLength && fragmentLength == chan->fragmentSize ) {
 			return qfalse;
 		}
 
-		if ( chan->fragmentLength > msg->maxsize ) {
-			Com_Printf( "%s:fragmentLength %i > msg->maxsize\n"
-				, NET_AdrToStringwPort (chan->remoteAddress ),
-				chan->fragmentLength );
-			return qfalse;
-		}
-
-		// copy the full message over the partial fragment
-
-		// make sure the sequence number is still there
-		*(int *)msg->data = LittleLong( sequence );
+		// read the full message where it was put together, with the
+		// sequence number in front instead of copying it over the fragment
+		littleSequence = LittleLong( sequence );
+		Com_Memcpy( chan->fragmentBuffer, &littleSequence, 4 );
 
-		Com_Memcpy( msg->data + 4, chan->fragmentBuffer, chan->fragmentLength );
+		msg->data = chan->fragmentBuffer;
+		msg->maxsize = sizeof( chan->fragmentBuffer );
 		msg->cursize = chan->fragmentLength + 4;
 		chan->fragmentLength = 0;
 		msg->readcount = 4;	// past the sequence number
@@ -419,12 +451,15 @@ LOOPBACK BUFFERS FOR LOCAL PLAYER
 =============================================================================
 */
 
-// there needs to be enough loopback messages to hold a complete
-// gamestate of maximum size
+// netchan messages go through whole, with their header, so a gamestate
+// takes one. The packet being read is handed out in place and stays in
+// the buffer until the next is read, a packet sent while the buffer is
+// full is dropped rather than overwrite it.
 #define	MAX_LOOPBACK	16
+#define	LOOPBACK_HEADER	16		// sequence, qport and checksum
 
 typedef struct {
-	byte	data[MAX_PACKETLEN];
+	byte	data[LOOPBACK_HEADER + MAX_MSGLEN];
 	int		datalen;
 } loopmsg_t;
 
@@ -452,7 +487,9 @@ qboolean	NET_GetLoopPacket (netsrc_t sock, netadr_t *net_from, msg_t *net_messag
 	i = loop->get & (MAX_LOOPBACK-1);
 	loop->get++;
 
-	Com_Memcpy (net_message->data, loop->msgs[i].data, loop->msgs[i].datalen);
+	// no copy, the message is read where it is
+	net_message->data = loop->msgs[i].data;
+	net_message->maxsize = sizeof( loop->msgs[i].data );
 	net_message->cursize = loop->msgs[i].datalen;
 	Com_Memset (net_from, 0, sizeof(*net_from));
 	net_from->type = NA_LOOPBACK;
@@ -460,19 +497,57 @@ qboolean	NET_GetLoopPacket (netsrc_t sock, netadr_t *net_from, msg_t *net_messag
 
 }
 
+/*
+=================
+NET_LoopSlot
 
-void NET_SendLoopPacket (netsrc_t sock, int length, const void *data, netadr_t to)
+The buffer for the next packet to sock, NULL if it is full
+=================
+*/
+static loopmsg_t *NET_LoopSlot( netsrc_t sock )
 {
-	int		i;
 	loopback_t	*loop;
 
 	loop = &loopbacks[sock^1];
 
-	i = loop->send & (MAX_LOOPBACK-1);
-	loop->send++;
+	// the last one handed out may still be being read
+	if ( loop->send - loop->get >= MAX_LOOPBACK - 1 ) {
+		return NULL;
+	}
 
-	Com_Memcpy (loop->msgs[i].data, data, length);
-	loop->msgs[i].datalen = length;
+	return &loop->msgs[loop->send++ & (MAX_LOOPBACK-1)];
+}
+
+void NET_SendLoopPacket (netsrc_t sock, int length, const void *data, netadr_t to)
+{
+	loopmsg_t	*slot;
+
+	if ( length > sizeof( slot->data ) || !( slot = NET_LoopSlot( sock ) ) ) {
+		return;
+	}
+
+	Com_Memcpy (slot->data, data, length);
+	slot->datalen = length;
+}
+
+/*
+=================
+NET_SendLoopMessage
+
+A netchan header and its message, put together in the loopback buffer
+=================
+*/
+void NET_SendLoopMessage( netsrc_t sock, const byte *header, int headerLength, const byte *data, int length )
+{
+	loopmsg_t	*slot;
+
+	if ( headerLength > LOOPBACK_HEADER || length > MAX_MSGLEN || !( slot = NET_LoopSlot( sock ) ) ) {
+		return;
+	}
+
+	Com_Memcpy( slot->data, header, headerLength );
+	Com_Memcpy( slot->data + headerLength, data, length );
+	slot->datalen = headerLength + length;
 }
 
 //=============================================================================
@@ -545,7 +620,7 @@ void NET_SendPacket( netsrc_t sock, int length, const void *data, netadr_t to )
 		NET_SendLoopPacket (sock, length, data, to);
 		return;
 	}
-	if ( to.type == NA_BOT ) {
+	if ( to.type == NA_BOT || to.type == NA_LOADTEST ) {
 		return;
 	}
 	if ( to.type == NA_BAD ) {
@@ -627,6 +702,19 @@ return 0 on address not found, 1 on address found with port, 2 on address found
 =============
 */
 int NET_StringToAdr( const char *s, netadr_t *a, netadrtype_t family )
+{
+	return NET_ResolveAdr( s, a, family, NULL, 0 );
+}
+
+/*
+=============
+NET_ResolveAdr
+
+NET_StringToAdr, with what went wrong put in error instead of printed when
+error isn't NULL, for the resolver thread
+=============
+*/
+int NET_ResolveAdr( const char *s, netadr_t *a, netadrtype_t family, char *error, int errorSize )
 {
 	char	base[MAX_STRING_CHARS], *search;
 	char	*port = NULL;
@@ -671,7 +759,7 @@ int NET_StringToAdr( const char *s, netadr_t *a, netadrtype_t family )
 		search = base;
 	}
 
-	if(!Sys_StringToAdr(search, a, family))
+	if(!Sys_ResolveAdr(search, a, family, error, errorSize))
 	{
 		a->type = NA_BAD;
 		return 0;
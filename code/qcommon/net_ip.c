@@ -20,6 +20,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 ===========================================================================
 */
 
+#ifdef __linux__
+	// needed for recvmmsg() and sendmmsg()
+#	define _GNU_SOURCE
+#endif
+
 #include "../qcommon/q_shared.h"
 #include "../qcommon/qcommon.h"
 
@@ -81,6 +86,24 @@ static qboolean	winsockInitialized = qfalse;
 #		include <sys/filio.h>
 #	endif
 
+#	if defined(__linux__)
+#		define USE_EPOLL
+#		include <sys/epoll.h>
+#		include <sys/timerfd.h>
+#		ifdef MSG_WAITFORONE
+#			define USE_RECVMMSG
+#			define USE_SENDMMSG
+#		endif
+#	elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
+#		define USE_KQUEUE
+#		include <sys/event.h>
+#	endif
+
+#	ifndef DEDICATED
+#		define USE_RECV_THREAD
+#		include <fcntl.h>
+#	endif
+
 typedef int SOCKET;
 #	define INVALID_SOCKET		-1
 #	define SOCKET_ERROR			-1
@@ -111,6 +134,8 @@ static cvar_t	*net_mcast6iface;
 
 static cvar_t	*net_dropsim;
 
+static cvar_t	*net_poll;
+
 static struct sockaddr	socksRelayAddr;
 
 static SOCKET	ip_socket = INVALID_SOCKET;
@@ -118,6 +143,91 @@ static SOCKET	ip6_socket = INVALID_SOCKET;
 static SOCKET	socks_socket = INVALID_SOCKET;
 static SOCKET	multicast6_socket = INVALID_SOCKET;
 
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+// epoll/kqueue descriptor watching ip_socket and ip6_socket, used by NET_Sleep
+// instead of rebuilding an fd_set for select() every frame.
+static int		poll_fd = -1;
+#define	MAX_POLL_EVENTS	4
+#endif
+
+#ifdef USE_EPOLL
+// epoll_wait only takes milliseconds, sub millisecond sleeps arm this
+// timer in the poll set instead
+static int		timer_fd = -1;
+#endif
+
+#ifdef USE_RECVMMSG
+// number of datagrams pulled off a socket by a single recvmmsg() call
+#define	NET_RECV_BATCH	16
+
+// allocated while networking is up, NET_Event reads packet by packet without it
+typedef struct {
+	byte						data[NET_RECV_BATCH][MAX_MSGLEN + 1];
+	struct sockaddr_storage		from[NET_RECV_BATCH];
+	struct iovec				iov[NET_RECV_BATCH];
+	struct mmsghdr				hdr[NET_RECV_BATCH];
+} recvBatch_t;
+
+static recvBatch_t	*recvBatch;
+#endif
+
+#ifdef USE_SENDMMSG
+// outgoing datagrams collected between Sys_BeginPacketBatch and
+// Sys_FlushPacketBatch, sent with one sendmmsg() call per socket run
+#define	NET_SEND_BATCH	64
+// larger datagrams bypass the batch
+#define	NET_BATCH_PACKETLEN	MAX_PACKETLEN
+
+typedef struct
+{
+	SOCKET		sock;
+	netadr_t	to;
+	struct sockaddr_storage	addr;
+	int			length;
+	byte		data[NET_BATCH_PACKETLEN];
+} sendBatchPacket_t;
+
+static qboolean				sendBatchActive;
+static int					sendBatchCount;
+static sendBatchPacket_t	sendBatch[NET_SEND_BATCH];
+#endif
+
+#ifdef USE_RECV_THREAD
+// with net_recvThread the client reads its sockets from a thread, so a
+// packet's arrival time isn't rounded up to the next rendered frame
+#define	NET_RECV_QUEUE	64
+
+typedef struct
+{
+	struct sockaddr_storage	from;
+	int			length;
+	int64_t		time;			// Sys_Microseconds it was read at
+	byte		data[MAX_MSGLEN + 1];
+} recvQueuedPacket_t;
+
+typedef struct
+{
+	sysThread_t	*thread;
+	int			wake[2];		// a byte per batch queued, NET_SleepUsec waits on it
+
+	// under mutex
+	sysMutex_t	*mutex;
+	qboolean	quit;
+	int			head;			// next to write
+	int			tail;			// next to dispatch
+	int			dropped;
+
+	qboolean	dispatching;
+	recvQueuedPacket_t	packets[NET_RECV_QUEUE];
+} recvThread_t;
+
+static recvThread_t	recvThread = { NULL, { -1, -1 } };
+static cvar_t		*net_recvThread;
+#endif
+
+// Sys_Microseconds the packet being dispatched was read at, 0 if just now
+static int64_t		net_packetTime;
+
 // Keep track of currently joined multicast group.
 static struct ipv6_mreq curgroup;
 // And the currently bound address.
@@ -269,7 +379,8 @@ static struct addrinfo *SearchAddrInfo(struct addrinfo *hints, sa_family_t famil
 Sys_StringToSockaddr
 =============
 */
-static qboolean Sys_StringToSockaddr(const char *s, struct sockaddr *sadr, int sadr_len, sa_family_t family)
+static qboolean Sys_StringToSockaddr(const char *s, struct sockaddr *sadr, int sadr_len, sa_family_t family,
+	char *error, int errorSize)
 {
 	struct addrinfo hints;
 	struct addrinfo *res = NULL;
@@ -321,9 +432,13 @@ static qboolean Sys_StringToSockaddr(const char *s, struct sockaddr *sadr, int s
 			
 			return qtrue;
 		}
+		else if(error)
+			Q_strncpyz(error, "No address of required type found.", errorSize);
 		else
 			Com_Printf("Sys_StringToSockaddr: Error resolving %s: No address of required type found.\n", s);
 	}
+	else if(error)
+		Q_strncpyz(error, gai_strerror(retval), errorSize);
 	else
 		Com_Printf("Sys_StringToSockaddr: Error resolving %s: %s\n", s, gai_strerror(retval));
 	
@@ -353,10 +468,13 @@ static void Sys_SockaddrToString(char *dest, int destlen, struct sockaddr *input
 
 /*
 =============
-Sys_StringToAdr
+Sys_ResolveAdr
+
+Sys_StringToAdr that puts what went wrong in error rather than printing
+it, when error isn't NULL, so it can run off the main thread
 =============
 */
-qboolean Sys_StringToAdr( const char *s, netadr_t *a, netadrtype_t family ) {
+qboolean Sys_ResolveAdr( const char *s, netadr_t *a, netadrtype_t family, char *error, int errorSize ) {
 	struct sockaddr_storage sadr;
 	sa_family_t fam;
 	
@@ -372,7 +490,7 @@ qboolean Sys_StringToAdr( const char *s, netadr_t *a, netadrtype_t family ) {
 			fam = AF_UNSPEC;
 		break;
 	}
-	if( !Sys_StringToSockaddr(s, (struct sockaddr *) &sadr, sizeof(sadr), fam ) ) {
+	if( !Sys_StringToSockaddr(s, (struct sockaddr *) &sadr, sizeof(sadr), fam, error, errorSize ) ) {
 		return qfalse;
 	}
 	
@@ -380,6 +498,15 @@ qboolean Sys_StringToAdr( const char *s, netadr_t *a, netadrtype_t family ) {
 	return qtrue;
 }
 
+/*
+=============
+Sys_StringToAdr
+=============
+*/
+qboolean Sys_StringToAdr( const char *s, netadr_t *a, netadrtype_t family ) {
+	return Sys_ResolveAdr( s, a, family, NULL, 0 );
+}
+
 /*
 ===================
 NET_CompareBaseAdrMask
@@ -395,7 +522,7 @@ qboolean NET_CompareBaseAdrMask(netadr_t a, netadr_t b, int netmask)
 	if (a.type != b.type)
 		return qfalse;
 
-	if (a.type == NA_LOOPBACK)
+	if (a.type == NA_LOOPBACK || a.type == NA_LOADTEST)
 		return qtrue;
 
 	if(a.type == NA_IP)
@@ -461,6 +588,8 @@ const char	*NET_AdrToString (netadr_t a)
 		Com_sprintf (s, sizeof(s), "loopback");
 	else if (a.type == NA_BOT)
 		Com_sprintf (s, sizeof(s), "bot");
+	else if (a.type == NA_LOADTEST)
+		Com_sprintf (s, sizeof(s), "loadtest");
 	else if (a.type == NA_IP || a.type == NA_IP6)
 	{
 		struct sockaddr_storage sadr;
@@ -481,6 +610,8 @@ const char	*NET_AdrToStringwPort (netadr_t a)
 		Com_sprintf (s, sizeof(s), "loopback");
 	else if (a.type == NA_BOT)
 		Com_sprintf (s, sizeof(s), "bot");
+	else if (a.type == NA_LOADTEST)
+		Com_sprintf (s, sizeof(s), "loadtest:%i", a.port);
 	else if(a.type == NA_IP)
 		Com_sprintf(s, sizeof(s), "%s:%hu", NET_AdrToString(a), ntohs(a.port));
 	else if(a.type == NA_IP6)
@@ -635,6 +766,31 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 
 static char socksBuf[4096];
 
+/*
+==================
+NET_SendError
+==================
+*/
+static void NET_SendError( const char *func, netadr_t to ) {
+	int err = socketError;
+
+	// wouldblock is silent
+	if( err == EAGAIN ) {
+		return;
+	}
+
+	// some PPP links do not allow broadcasts and return an error
+	if( ( err == EADDRNOTAVAIL ) && ( ( to.type == NA_BROADCAST ) ) ) {
+		return;
+	}
+
+	Com_Printf( "%s: %s\n", func, NET_ErrorString() );
+}
+
+#ifdef USE_SENDMMSG
+static void NET_BatchPacket( SOCKET sock, int length, const void *data, netadr_t to, struct sockaddr_storage *addr );
+#endif
+
 /*
 ==================
 Sys_SendPacket
@@ -673,28 +829,182 @@ void Sys_SendPacket( int length, const void *data, netadr_t to ) {
 		ret = sendto( ip_socket, socksBuf, length+10, 0, &socksRelayAddr, sizeof(socksRelayAddr) );
 	}
 	else {
+#ifdef USE_SENDMMSG
+		if( sendBatchActive && length <= NET_BATCH_PACKETLEN ) {
+			NET_BatchPacket( addr.ss_family == AF_INET ? ip_socket : ip6_socket, length, data, to, &addr );
+			return;
+		}
+#endif
+
 		if(addr.ss_family == AF_INET)
 			ret = sendto( ip_socket, data, length, 0, (struct sockaddr *) &addr, sizeof(struct sockaddr_in) );
 		else if(addr.ss_family == AF_INET6)
 			ret = sendto( ip6_socket, data, length, 0, (struct sockaddr *) &addr, sizeof(struct sockaddr_in6) );
 	}
 	if( ret == SOCKET_ERROR ) {
-		int err = socketError;
+		NET_SendError( "Sys_SendPacket", to );
+	}
+}
 
-		// wouldblock is silent
-		if( err == EAGAIN ) {
-			return;
+/*
+==================
+Sys_SendProbePacket
+
+Sends a datagram with the don't fragment bit set, ignoring what is known
+about the path, so that it is dropped rather than fragmented where it
+doesn't fit. Returns qfalse where that can't be asked for, nothing is
+sent then.
+==================
+*/
+qboolean Sys_SendProbePacket( int length, const void *data, netadr_t to ) {
+#if defined( IP_MTU_DISCOVER ) && defined( IP_PMTUDISC_PROBE ) && defined( IPV6_MTU_DISCOVER ) && defined( IPV6_PMTUDISC_PROBE )
+	struct sockaddr_storage	addr;
+	SOCKET		sock;
+	int			level, option, probe, old;
+	socklen_t	optlen;
+	int			ret;
+
+	if( to.type == NA_IP && ip_socket != INVALID_SOCKET && !usingSocks ) {
+		sock = ip_socket;
+		level = IPPROTO_IP;
+		option = IP_MTU_DISCOVER;
+		probe = IP_PMTUDISC_PROBE;
+	} else if( to.type == NA_IP6 && ip6_socket != INVALID_SOCKET ) {
+		sock = ip6_socket;
+		level = IPPROTO_IPV6;
+		option = IPV6_MTU_DISCOVER;
+		probe = IPV6_PMTUDISC_PROBE;
+	} else {
+		return qfalse;
+	}
+
+	optlen = sizeof( old );
+	if( getsockopt( sock, level, option, (char *) &old, &optlen ) == SOCKET_ERROR ||
+		setsockopt( sock, level, option, (char *) &probe, sizeof( probe ) ) == SOCKET_ERROR ) {
+		return qfalse;
+	}
+
+	memset( &addr, 0, sizeof( addr ) );
+	NetadrToSockadr( &to, (struct sockaddr *) &addr );
+
+	ret = sendto( sock, data, length, 0, (struct sockaddr *) &addr,
+		to.type == NA_IP ? sizeof( struct sockaddr_in ) : sizeof( struct sockaddr_in6 ) );
+
+	// larger than the first link, that is as much of an answer as a loss
+	if( ret == SOCKET_ERROR && socketError != EMSGSIZE ) {
+		NET_SendError( "Sys_SendProbePacket", to );
+	}
+
+	setsockopt( sock, level, option, (char *) &old, sizeof( old ) );
+
+	return qtrue;
+#else
+	return qfalse;
+#endif
+}
+
+#ifdef USE_SENDMMSG
+/*
+==================
+NET_SendBatchRun
+
+Sends count packets that all go through the same socket
+==================
+*/
+static void NET_SendBatchRun( sendBatchPacket_t *packets, int count ) {
+	struct mmsghdr	hdr[NET_SEND_BATCH];
+	struct iovec	iov[NET_SEND_BATCH];
+	int				i, ret;
+
+	for( i = 0; i < count; i++ ) {
+		iov[i].iov_base = packets[i].data;
+		iov[i].iov_len = packets[i].length;
+
+		memset( &hdr[i], 0, sizeof( hdr[i] ) );
+		hdr[i].msg_hdr.msg_name = &packets[i].addr;
+		hdr[i].msg_hdr.msg_namelen = packets[i].addr.ss_family == AF_INET ?
+			sizeof( struct sockaddr_in ) : sizeof( struct sockaddr_in6 );
+		hdr[i].msg_hdr.msg_iov = &iov[i];
+		hdr[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	i = 0;
+	while( i < count ) {
+		ret = sendmmsg( packets[0].sock, &hdr[i], count - i, 0 );
+
+		if( ret == SOCKET_ERROR ) {
+			// the packet at i failed, report it and carry on with the rest
+			NET_SendError( "Sys_FlushPacketBatch", packets[i].to );
+			i++;
 		}
+		else
+			i += ret;
+	}
+}
 
-		// some PPP links do not allow broadcasts and return an error
-		if( ( err == EADDRNOTAVAIL ) && ( ( to.type == NA_BROADCAST ) ) ) {
-			return;
+/*
+==================
+Sys_FlushPacketBatch
+
+Sends everything collected since Sys_BeginPacketBatch and ends the batch
+==================
+*/
+void Sys_FlushPacketBatch( void ) {
+	int		start, end;
+
+	for( start = 0; start < sendBatchCount; start = end ) {
+		for( end = start + 1; end < sendBatchCount; end++ ) {
+			if( sendBatch[end].sock != sendBatch[start].sock )
+				break;
 		}
 
-		Com_Printf( "Sys_SendPacket: %s\n", NET_ErrorString() );
+		NET_SendBatchRun( &sendBatch[start], end - start );
+	}
+
+	sendBatchCount = 0;
+	sendBatchActive = qfalse;
+}
+
+/*
+==================
+NET_BatchPacket
+==================
+*/
+static void NET_BatchPacket( SOCKET sock, int length, const void *data, netadr_t to, struct sockaddr_storage *addr ) {
+	sendBatchPacket_t	*packet;
+
+	if( sendBatchCount == NET_SEND_BATCH ) {
+		Sys_FlushPacketBatch();
+		sendBatchActive = qtrue;
 	}
+
+	packet = &sendBatch[sendBatchCount++];
+	packet->sock = sock;
+	packet->to = to;
+	packet->addr = *addr;
+	packet->length = length;
+	Com_Memcpy( packet->data, data, length );
 }
 
+/*
+==================
+Sys_BeginPacketBatch
+
+Datagrams sent until the next Sys_FlushPacketBatch are collected and sent
+with as few sendmmsg() calls as possible
+==================
+*/
+void Sys_BeginPacketBatch( void ) {
+	sendBatchActive = qtrue;
+}
+#else
+void Sys_BeginPacketBatch( void ) {
+}
+
+void Sys_FlushPacketBatch( void ) {
+}
+#endif
+
 
 //=============================================================================
 
@@ -849,7 +1159,7 @@ SOCKET NET_IPSocket( char *net_interface, int port, int *err ) {
 	}
 	else
 	{
-		if(!Sys_StringToSockaddr( net_interface, (struct sockaddr *)&address, sizeof(address), AF_INET))
+		if(!Sys_StringToSockaddr( net_interface, (struct sockaddr *)&address, sizeof(address), AF_INET, NULL, 0))
 		{
 			closesocket(newsocket);
 			return INVALID_SOCKET;
@@ -929,7 +1239,7 @@ SOCKET NET_IP6Socket( char *net_interface, int port, struct sockaddr_in6 *bindto
 	}
 	else
 	{
-		if(!Sys_StringToSockaddr( net_interface, (struct sockaddr *)&address, sizeof(address), AF_INET6))
+		if(!Sys_StringToSockaddr( net_interface, (struct sockaddr *)&address, sizeof(address), AF_INET6, NULL, 0))
 		{
 			closesocket(newsocket);
 			return INVALID_SOCKET;
@@ -966,7 +1276,7 @@ void NET_SetMulticast6(void)
 {
 	struct sockaddr_in6 addr;
 
-	if(!*net_mcast6addr->string || !Sys_StringToSockaddr(net_mcast6addr->string, (struct sockaddr *) &addr, sizeof(addr), AF_INET6))
+	if(!*net_mcast6addr->string || !Sys_StringToSockaddr(net_mcast6addr->string, (struct sockaddr *) &addr, sizeof(addr), AF_INET6, NULL, 0))
 	{
 		Com_Printf("WARNING: NET_JoinMulticast6: Incorrect multicast address given, "
 			   "please set cvar %s to a sane value.\n", net_mcast6addr->name);
@@ -1407,6 +1717,422 @@ void NET_OpenIP( void ) {
 }
 
 
+//===================================================================
+
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+/*
+====================
+NET_PollAdd
+====================
+*/
+static qboolean NET_PollAdd( SOCKET sock ) {
+#ifdef USE_EPOLL
+	struct epoll_event ev;
+
+	memset( &ev, 0, sizeof( ev ) );
+	ev.events = EPOLLIN;
+	ev.data.fd = sock;
+
+	return epoll_ctl( poll_fd, EPOLL_CTL_ADD, sock, &ev ) == 0 ? qtrue : qfalse;
+#else
+	struct kevent ev;
+
+	EV_SET( &ev, sock, EVFILT_READ, EV_ADD, 0, 0, NULL );
+
+	return kevent( poll_fd, &ev, 1, NULL, 0, NULL ) == 0 ? qtrue : qfalse;
+#endif
+}
+#endif
+
+/*
+====================
+NET_OpenPoll
+
+Registers the game sockets with the epoll/kqueue backend. If that fails
+for any reason, NET_Sleep silently falls back to select().
+====================
+*/
+static void NET_OpenPoll( void ) {
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+	if( poll_fd != -1 || !net_poll->integer )
+		return;
+
+	if( ip_socket == INVALID_SOCKET && ip6_socket == INVALID_SOCKET )
+		return;
+
+#ifdef USE_EPOLL
+	poll_fd = epoll_create( MAX_POLL_EVENTS );
+#else
+	poll_fd = kqueue();
+#endif
+
+	if( poll_fd == -1 ) {
+		Com_Printf( "WARNING: NET_OpenPoll: %s, using select()\n", NET_ErrorString() );
+		return;
+	}
+
+	if( ( ip_socket != INVALID_SOCKET && !NET_PollAdd( ip_socket ) ) ||
+		( ip6_socket != INVALID_SOCKET && !NET_PollAdd( ip6_socket ) ) ) {
+		Com_Printf( "WARNING: NET_OpenPoll: %s, using select()\n", NET_ErrorString() );
+		close( poll_fd );
+		poll_fd = -1;
+		return;
+	}
+
+#ifdef USE_EPOLL
+	timer_fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK );
+	if( timer_fd != -1 && !NET_PollAdd( timer_fd ) ) {
+		close( timer_fd );
+		timer_fd = -1;
+	}
+
+	Com_Printf( "Using epoll for network events\n" );
+#else
+	Com_Printf( "Using kqueue for network events\n" );
+#endif
+#endif
+}
+
+/*
+====================
+NET_ClosePoll
+====================
+*/
+static void NET_ClosePoll( void ) {
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+	if( poll_fd != -1 ) {
+		close( poll_fd );
+		poll_fd = -1;
+	}
+#endif
+#ifdef USE_EPOLL
+	if( timer_fd != -1 ) {
+		struct itimerspec its;
+
+		memset( &its, 0, sizeof( its ) );
+		timerfd_settime( timer_fd, 0, &its, NULL );
+
+		close( timer_fd );
+		timer_fd = -1;
+	}
+#endif
+}
+
+
+//===================================================================
+
+#ifdef USE_RECV_THREAD
+static void NET_DispatchPacket(netadr_t *from, msg_t *netmsg);
+
+/*
+====================
+NET_RecvThreadSocket
+
+Reads sock until it would block
+====================
+*/
+static qboolean NET_RecvThreadSocket( SOCKET sock )
+{
+	static byte			discard[MAX_MSGLEN + 1];
+	recvQueuedPacket_t	*packet;
+	socklen_t			fromlen;
+	qboolean			queued = qfalse;
+	int					ret;
+
+	while( 1 )
+	{
+		Sys_LockMutex( recvThread.mutex );
+		if( recvThread.head - recvThread.tail < NET_RECV_QUEUE )
+			packet = &recvThread.packets[recvThread.head % NET_RECV_QUEUE];
+		else
+			packet = NULL;
+		Sys_UnlockMutex( recvThread.mutex );
+
+		if( !packet )
+		{
+			// the main thread is stalled, the freshest packets matter most
+			// but the ones queued are already owned by it
+			if( recv( sock, (void *)discard, sizeof( discard ), 0 ) == SOCKET_ERROR )
+				break;
+
+			Sys_LockMutex( recvThread.mutex );
+			recvThread.dropped++;
+			Sys_UnlockMutex( recvThread.mutex );
+			continue;
+		}
+
+		fromlen = sizeof( packet->from );
+		ret = recvfrom( sock, (void *)packet->data, sizeof( packet->data ), 0, (struct sockaddr *) &packet->from, &fromlen );
+		if( ret == SOCKET_ERROR )
+			break;
+
+		packet->length = ret;
+		packet->time = Sys_Microseconds();
+
+		Sys_LockMutex( recvThread.mutex );
+		recvThread.head++;
+		Sys_UnlockMutex( recvThread.mutex );
+		queued = qtrue;
+	}
+
+	return queued;
+}
+
+/*
+====================
+NET_RecvThread
+====================
+*/
+static void NET_RecvThread( void *arg )
+{
+	struct timeval	timeout;
+	fd_set			fdr;
+	SOCKET			highestfd;
+	qboolean		quit, queued;
+	char			wake = 0;
+
+	while( 1 )
+	{
+		Sys_LockMutex( recvThread.mutex );
+		quit = recvThread.quit;
+		Sys_UnlockMutex( recvThread.mutex );
+		if( quit )
+			break;
+
+		FD_ZERO( &fdr );
+		highestfd = INVALID_SOCKET;
+		if( ip_socket != INVALID_SOCKET )
+		{
+			FD_SET( ip_socket, &fdr );
+			highestfd = ip_socket;
+		}
+		if( ip6_socket != INVALID_SOCKET )
+		{
+			FD_SET( ip6_socket, &fdr );
+			if( highestfd == INVALID_SOCKET || ip6_socket > highestfd )
+				highestfd = ip6_socket;
+		}
+		if( multicast6_socket != INVALID_SOCKET && multicast6_socket != ip6_socket )
+		{
+			FD_SET( multicast6_socket, &fdr );
+			if( multicast6_socket > highestfd )
+				highestfd = multicast6_socket;
+		}
+
+		// short enough for NET_StopRecvThread not to notice
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 10000;
+
+		if( select( highestfd + 1, &fdr, NULL, NULL, &timeout ) <= 0 )
+			continue;
+
+		queued = qfalse;
+		if( ip_socket != INVALID_SOCKET && FD_ISSET( ip_socket, &fdr ) )
+			queued |= NET_RecvThreadSocket( ip_socket );
+		if( ip6_socket != INVALID_SOCKET && FD_ISSET( ip6_socket, &fdr ) )
+			queued |= NET_RecvThreadSocket( ip6_socket );
+		if( multicast6_socket != INVALID_SOCKET && multicast6_socket != ip6_socket && FD_ISSET( multicast6_socket, &fdr ) )
+			queued |= NET_RecvThreadSocket( multicast6_socket );
+
+		if( queued && write( recvThread.wake[1], &wake, 1 ) < 0 )
+			wake = 0;
+	}
+}
+
+/*
+====================
+NET_StartRecvThread
+====================
+*/
+static void NET_StartRecvThread( void )
+{
+	if( !net_recvThread->integer || usingSocks )
+		return;
+
+	if( ip_socket == INVALID_SOCKET && ip6_socket == INVALID_SOCKET )
+		return;
+
+	if( pipe( recvThread.wake ) == -1 )
+	{
+		Com_Printf( "WARNING: NET_StartRecvThread: pipe: %s\n", strerror( errno ) );
+		recvThread.wake[0] = recvThread.wake[1] = -1;
+		return;
+	}
+	fcntl( recvThread.wake[0], F_SETFL, O_NONBLOCK );
+	fcntl( recvThread.wake[1], F_SETFL, O_NONBLOCK );
+
+	if( !recvThread.mutex )
+		recvThread.mutex = Sys_CreateMutex();
+
+	recvThread.head = recvThread.tail = 0;
+	recvThread.dropped = 0;
+	recvThread.quit = qfalse;
+
+	recvThread.thread = Sys_CreateThread( NET_RecvThread, NULL );
+	if( !recvThread.thread )
+	{
+		Com_Printf( "WARNING: NET_StartRecvThread: no thread, reading packets once per frame\n" );
+		close( recvThread.wake[0] );
+		close( recvThread.wake[1] );
+		recvThread.wake[0] = recvThread.wake[1] = -1;
+		return;
+	}
+
+	Com_Printf( "Reading packets from a thread\n" );
+}
+
+/*
+====================
+NET_StopRecvThread
+
+Packets still queued are dropped, the sockets are about to go away
+====================
+*/
+static void NET_StopRecvThread( void )
+{
+	if( !recvThread.thread )
+		return;
+
+	Sys_LockMutex( recvThread.mutex );
+	recvThread.quit = qtrue;
+	Sys_UnlockMutex( recvThread.mutex );
+
+	Sys_JoinThread( recvThread.thread );
+	recvThread.thread = NULL;
+
+	if( recvThread.dropped )
+		Com_DPrintf( "NET_StopRecvThread: %i packets dropped on a full queue\n", recvThread.dropped );
+
+	close( recvThread.wake[0] );
+	close( recvThread.wake[1] );
+	recvThread.wake[0] = recvThread.wake[1] = -1;
+}
+
+/*
+====================
+NET_RecvThreadDispatch
+
+Hands the queued packets to the client or server, returns qfalse if
+nothing was queued
+====================
+*/
+static qboolean NET_RecvThreadDispatch( void )
+{
+	recvQueuedPacket_t	*packet;
+	netadr_t			from;
+	msg_t				netmsg;
+	qboolean			dispatched = qfalse;
+
+	// CL_PacketEvent can end up back in here
+	if( recvThread.dispatching )
+		return qfalse;
+	recvThread.dispatching = qtrue;
+
+	while( recvThread.thread )
+	{
+		Sys_LockMutex( recvThread.mutex );
+		packet = ( recvThread.tail != recvThread.head ) ? &recvThread.packets[recvThread.tail % NET_RECV_QUEUE] : NULL;
+		Sys_UnlockMutex( recvThread.mutex );
+
+		if( !packet )
+			break;
+
+		SockadrToNetadr( (struct sockaddr *) &packet->from, &from );
+
+		if( packet->length >= sizeof( packet->data ) )
+			Com_Printf( "Oversize packet from %s\n", NET_AdrToStringwPort( from ) );
+		else
+		{
+			MSG_Init( &netmsg, packet->data, sizeof( packet->data ) );
+			netmsg.cursize = packet->length;
+
+			net_packetTime = packet->time;
+			NET_DispatchPacket( &from, &netmsg );
+			net_packetTime = 0;
+		}
+
+		// the slot is the thread's again
+		Sys_LockMutex( recvThread.mutex );
+		recvThread.tail++;
+		Sys_UnlockMutex( recvThread.mutex );
+
+		dispatched = qtrue;
+	}
+
+	recvThread.dispatching = qfalse;
+	return dispatched;
+}
+
+/*
+====================
+NET_RecvThreadSleep
+
+NET_SleepUsec while the thread owns the sockets
+====================
+*/
+static void NET_RecvThreadSleep( int usec )
+{
+	struct timeval	timeout;
+	fd_set			fdr;
+	char			buf[64];
+
+	if( NET_RecvThreadDispatch() || usec <= 0 )
+		return;
+
+	FD_ZERO( &fdr );
+	FD_SET( recvThread.wake[0], &fdr );
+
+	timeout.tv_sec = usec / 1000000;
+	timeout.tv_usec = usec % 1000000;
+
+	if( select( recvThread.wake[0] + 1, &fdr, NULL, NULL, &timeout ) > 0 )
+	{
+		while( read( recvThread.wake[0], buf, sizeof( buf ) ) > 0 )
+			;
+		NET_RecvThreadDispatch();
+	}
+}
+#else
+static void NET_StartRecvThread( void ) {
+}
+
+static void NET_StopRecvThread( void ) {
+}
+#endif
+
+/*
+====================
+NET_PacketAge
+
+How long ago the packet being handled arrived, in msec
+====================
+*/
+int NET_PacketAge( void )
+{
+	int64_t age;
+
+	if( !net_packetTime )
+		return 0;
+
+	age = Sys_Microseconds() - net_packetTime;
+	return age > 0 ? (int)( age / 1000 ) : 0;
+}
+
+/*
+====================
+NET_PacketTime
+
+Sys_Microseconds the packet being handled was read at
+====================
+*/
+int64_t NET_PacketTime( void )
+{
+	if( !net_packetTime )
+		return Sys_Microseconds();
+
+	return net_packetTime;
+}
+
 //===================================================================
 
 
@@ -1480,6 +2206,18 @@ static qboolean NET_GetCvars( void ) {
 
 	net_dropsim = Cvar_Get("net_dropsim", "", CVAR_TEMP);
 
+	net_poll = Cvar_Get( "net_poll", "1", CVAR_LATCH | CVAR_ARCHIVE );
+	Cvar_SetDescription( net_poll, "Wait for network events with epoll/kqueue where available instead of select()" );
+	modified += net_poll->modified;
+	net_poll->modified = qfalse;
+
+#ifdef USE_RECV_THREAD
+	net_recvThread = Cvar_Get( "net_recvThread", "0", CVAR_LATCH | CVAR_ARCHIVE );
+	Cvar_SetDescription( net_recvThread, "Read packets from a thread as they arrive instead of once per frame" );
+	modified += net_recvThread->modified;
+	net_recvThread->modified = qfalse;
+#endif
+
 	return modified ? qtrue : qfalse;
 }
 
@@ -1529,6 +2267,17 @@ void NET_Config( qboolean enableNetworking ) {
 	}
 
 	if( stop ) {
+		Sys_FlushPacketBatch();
+		NET_StopRecvThread();
+		NET_ClosePoll();
+
+#ifdef USE_RECVMMSG
+		if ( recvBatch ) {
+			Z_Free( recvBatch );
+			recvBatch = NULL;
+		}
+#endif
+
 		if ( ip_socket != INVALID_SOCKET ) {
 			closesocket( ip_socket );
 			ip_socket = INVALID_SOCKET;
@@ -1560,6 +2309,11 @@ void NET_Config( qboolean enableNetworking ) {
 		{
 			NET_OpenIP();
 			NET_SetMulticast6();
+			NET_OpenPoll();
+#ifdef USE_RECVMMSG
+			recvBatch = Z_Malloc( sizeof( *recvBatch ) );
+#endif
+			NET_StartRecvThread();
 		}
 	}
 }
@@ -1596,6 +2350,8 @@ NET_Shutdown
 ====================
 */
 void NET_Shutdown( void ) {
+	NET_ResolverShutdown();
+
 	if ( !networkingEnabled ) {
 		return;
 	}
@@ -1608,11 +2364,120 @@ void NET_Shutdown( void ) {
 #endif
 }
 
+/*
+====================
+NET_DispatchPacket
+
+Hands a received packet to the server or the client
+====================
+*/
+static void NET_DispatchPacket(netadr_t *from, msg_t *netmsg)
+{
+	if(net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f)
+	{
+		// com_dropsim->value percent of incoming packets get dropped.
+		if(rand() < (int) (((double) RAND_MAX) / 100.0 * (double) net_dropsim->value))
+			return;          // drop this packet
+	}
+
+	if(com_sv_running->integer)
+		Com_RunAndTimeServerPacket(from, netmsg);
+	else
+		CL_PacketEvent(*from, netmsg);
+}
+
+#ifdef USE_RECVMMSG
+/*
+====================
+NET_GetPacketBatch
+
+Reads up to NET_RECV_BATCH datagrams from sock with one recvmmsg() call
+and fills msgs/froms with them. Returns the number of packets that filled
+the batch, including oversized ones which are dropped here, or 0 when the
+socket has nothing more to read.
+====================
+*/
+static int NET_GetPacketBatch(SOCKET sock, msg_t *msgs, netadr_t *froms, int *count)
+{
+	int i, ret;
+
+	for(i = 0; i < NET_RECV_BATCH; i++)
+	{
+		recvBatch->iov[i].iov_base = recvBatch->data[i];
+		recvBatch->iov[i].iov_len = sizeof(recvBatch->data[i]);
+
+		memset(&recvBatch->hdr[i], 0, sizeof(recvBatch->hdr[i]));
+		recvBatch->hdr[i].msg_hdr.msg_name = &recvBatch->from[i];
+		recvBatch->hdr[i].msg_hdr.msg_namelen = sizeof(recvBatch->from[i]);
+		recvBatch->hdr[i].msg_hdr.msg_iov = &recvBatch->iov[i];
+		recvBatch->hdr[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	*count = 0;
+
+	ret = recvmmsg(sock, recvBatch->hdr, NET_RECV_BATCH, 0, NULL);
+
+	if(ret == SOCKET_ERROR)
+	{
+		int err = socketError;
+
+		if(err != EAGAIN && err != ECONNRESET)
+			Com_Printf("NET_GetPacketBatch: %s\n", NET_ErrorString());
+
+		return 0;
+	}
+
+	for(i = 0; i < ret; i++)
+	{
+		netadr_t *from = &froms[*count];
+		msg_t *msg = &msgs[*count];
+
+		SockadrToNetadr((struct sockaddr *) &recvBatch->from[i], from);
+
+		if(recvBatch->hdr[i].msg_len >= MAX_MSGLEN + 1)
+		{
+			Com_Printf("Oversize packet from %s\n", NET_AdrToStringwPort(*from));
+			continue;
+		}
+
+		MSG_Init(msg, recvBatch->data[i], sizeof(recvBatch->data[i]));
+		msg->cursize = recvBatch->hdr[i].msg_len;
+		(*count)++;
+	}
+
+	return ret;
+}
+
+/*
+====================
+NET_EventBatch
+
+Drains a readable socket in batches, then dispatches every packet of
+each batch in one pass.
+====================
+*/
+static void NET_EventBatch(SOCKET sock)
+{
+	msg_t msgs[NET_RECV_BATCH];
+	netadr_t froms[NET_RECV_BATCH];
+	int i, count, ret;
+
+	do
+	{
+		ret = NET_GetPacketBatch(sock, msgs, froms, &count);
+
+		for(i = 0; i < count; i++)
+			NET_DispatchPacket(&froms[i], &msgs[i]);
+	} while(ret == NET_RECV_BATCH);
+}
+#endif
+
 /*
 ====================
 NET_Event
 
-Called from NET_Sleep which uses select() to determine which sockets have seen action.
+Called from NET_Sleep which uses select(), epoll or kqueue to determine which
+sockets have seen action.
 ====================
 */
 
@@ -1621,25 +2486,31 @@ void NET_Event(fd_set *fdr)
 	byte bufData[MAX_MSGLEN + 1];
 	netadr_t from = {0};
 	msg_t netmsg;
-	
+
+#ifdef USE_RECVMMSG
+	// the socks relay header has to be stripped packet by packet, so only
+	// take the batched path for plain sockets
+	if(!usingSocks && recvBatch)
+	{
+		if(ip_socket != INVALID_SOCKET && FD_ISSET(ip_socket, fdr))
+			NET_EventBatch(ip_socket);
+
+		if(ip6_socket != INVALID_SOCKET && FD_ISSET(ip6_socket, fdr))
+			NET_EventBatch(ip6_socket);
+
+		if(multicast6_socket != INVALID_SOCKET && multicast6_socket != ip6_socket && FD_ISSET(multicast6_socket, fdr))
+			NET_EventBatch(multicast6_socket);
+
+		return;
+	}
+#endif
+
 	while(1)
 	{
 		MSG_Init(&netmsg, bufData, sizeof(bufData));
 
 		if(NET_GetPacket(&from, &netmsg, fdr))
-		{
-			if(net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f)
-			{
-				// com_dropsim->value percent of incoming packets get dropped.
-				if(rand() < (int) (((double) RAND_MAX) / 100.0 * (double) net_dropsim->value))
-					continue;          // drop this packet
-			}
-
-			if(com_sv_running->integer)
-				Com_RunAndTimeServerPacket(&from, &netmsg);
-			else
-				CL_PacketEvent(from, &netmsg);
-		}
+			NET_DispatchPacket(&from, &netmsg);
 		else
 			break;
 	}
@@ -1647,23 +2518,116 @@ void NET_Event(fd_set *fdr)
 
 /*
 ====================
-NET_Sleep
+NET_SleepUsec
 
-Sleeps msec or until something happens on the network
+Sleeps usec or until something happens on the network
 ====================
 */
-void NET_Sleep(int msec)
+void NET_SleepUsec(int usec)
 {
 	struct timeval timeout;
 	fd_set fdr;
 	int retval;
 	SOCKET highestfd = INVALID_SOCKET;
 
-	if(msec < 0)
-		msec = 0;
+	if(usec < 0)
+		usec = 0;
+
+#ifdef USE_SENDMMSG
+	// never sleep on packets left over from an interrupted batch
+	if(sendBatchActive)
+		Sys_FlushPacketBatch();
+#endif
+
+#ifdef USE_RECV_THREAD
+	if(recvThread.thread)
+	{
+		NET_RecvThreadSleep(usec);
+		return;
+	}
+#endif
 
 	FD_ZERO(&fdr);
 
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+	if(poll_fd != -1)
+	{
+#ifdef USE_EPOLL
+		struct epoll_event events[MAX_POLL_EVENTS];
+		int msec;
+
+		// round up, waking early only makes the caller sleep again
+		msec = usec / 1000 + (usec % 1000 ? 1 : 0);
+
+		if(timer_fd != -1 && usec % 1000)
+		{
+			struct itimerspec its;
+
+			memset(&its, 0, sizeof(its));
+			its.it_value.tv_sec = usec / 1000000;
+			its.it_value.tv_nsec = (usec % 1000000) * 1000;
+
+			if(timerfd_settime(timer_fd, 0, &its, NULL) == 0)
+				msec = -1;
+		}
+
+		retval = epoll_wait(poll_fd, events, MAX_POLL_EVENTS, msec);
+
+		if(msec == -1)
+		{
+			struct itimerspec its;
+
+			// a packet may have come first, don't leave the timer to wake
+			// a later sleep that never asked for it
+			memset(&its, 0, sizeof(its));
+			timerfd_settime(timer_fd, 0, &its, NULL);
+		}
+#else
+		struct kevent events[MAX_POLL_EVENTS];
+		struct timespec ts;
+
+		ts.tv_sec = usec / 1000000;
+		ts.tv_nsec = (usec % 1000000) * 1000;
+
+		retval = kevent(poll_fd, NULL, 0, events, MAX_POLL_EVENTS, &ts);
+#endif
+
+		if(retval == SOCKET_ERROR)
+		{
+			if(socketError != EINTR)
+				Com_Printf("Warning: NET_Sleep: %s\n", NET_ErrorString());
+		}
+		else if(retval > 0)
+		{
+			int i;
+
+			// hand the ready sockets to NET_Event, which reads them until
+			// they would block
+			for(i = 0; i < retval; i++)
+			{
+#ifdef USE_EPOLL
+				if(events[i].data.fd == timer_fd)
+				{
+					uint64_t expirations;
+
+					// just drain the timer, the count is of no interest
+					if(read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+						expirations = 0;
+					continue;
+				}
+				FD_SET(events[i].data.fd, &fdr);
+#else
+				FD_SET((int) events[i].ident, &fdr);
+#endif
+			}
+
+			NET_Event(&fdr);
+		}
+
+		return;
+	}
+#endif
+
 	if(ip_socket != INVALID_SOCKET)
 	{
 		FD_SET(ip_socket, &fdr);
@@ -1682,13 +2646,13 @@ void NET_Sleep(int msec)
 	if(highestfd == INVALID_SOCKET)
 	{
 		// windows ain't happy when select is called without valid FDs
-		SleepEx(msec, 0);
+		SleepEx(usec / 1000, 0);
 		return;
 	}
 #endif
 
-	timeout.tv_sec = msec/1000;
-	timeout.tv_usec = (msec%1000)*1000;
+	timeout.tv_sec = usec/1000000;
+	timeout.tv_usec = usec%1000000;
 
 	retval = select(highestfd + 1, &fdr, NULL, NULL, &timeout);
 
@@ -1698,6 +2662,23 @@ void NET_Sleep(int msec)
 		NET_Event(&fdr);
 }
 
+/*
+====================
+NET_Sleep
+
+Sleeps msec or until something happens on the network
+====================
+*/
+void NET_Sleep(int msec)
+{
+	if(msec < 0)
+		msec = 0;
+	else if(msec > 1000000)
+		msec = 1000000;
+
+	NET_SleepUsec(msec * 1000);
+}
+
 /*
 ====================
 NET_Restart_f
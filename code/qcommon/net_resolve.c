@@ -0,0 +1,290 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// net_resolve.c -- name lookups off the main thread
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+/*
+getaddrinfo blocks for as long as DNS takes to answer, seconds when a
+server is slow or down, and the master heartbeats and the auth server
+used to wait for it on the frame thread. NET_ResolveAsync answers from a
+cache straight away and has a thread look the name up again once the
+answer is older than the caller allows, keeping the last one meanwhile.
+
+getaddrinfo doesn't pass on the TTL of the records, so the callers give
+the age they accept instead. A failed lookup is tried again after
+RESOLVE_RETRY_MSEC, a good answer isn't replaced by a failure. Without a
+thread names are resolved inline, as before.
+*/
+
+#define	MAX_RESOLVE_NAMES	32
+#define	RESOLVE_RETRY_MSEC	( 10 * 1000 )
+
+typedef enum {
+	RESOLVE_IDLE,
+	RESOLVE_QUEUED,
+	RESOLVE_BUSY,				// the thread is on it
+	RESOLVE_DONE				// newResult waits to be taken
+} resolveState_t;
+
+typedef struct {
+	char			name[MAX_OSPATH];
+	netadrtype_t	family;
+	int				lastUsed;
+
+	// under resolver.lock once the thread runs
+	resolveState_t	state;
+	netadr_t		newAdr;
+	int				newResult;
+	char			error[128];
+
+	// main thread only
+	netadr_t		adr;
+	int				result;			// of NET_StringToAdr, -1 before the first answer
+	int				tryTime;		// Sys_Milliseconds of the last answer
+	int				answerTime;		// and of the last good one
+} resolveName_t;
+
+static struct {
+	resolveName_t	names[MAX_RESOLVE_NAMES];
+
+	sysThread_t		*thread;
+	sysMutex_t		*lock;
+	sysSemaphore_t	*wake;
+	qboolean		quit;
+	qboolean		started;
+} resolver;
+
+/*
+==================
+NET_ResolverThread
+==================
+*/
+static void NET_ResolverThread( void *arg ) {
+	resolveName_t	*entry;
+	char			name[MAX_OSPATH], error[128];
+	netadrtype_t	family;
+	netadr_t		adr;
+	int				i, result;
+
+	while ( 1 ) {
+		Sys_WaitSemaphore( resolver.wake );
+
+		if ( resolver.quit ) {
+			break;
+		}
+
+		Sys_LockMutex( resolver.lock );
+		for ( i = 0, entry = resolver.names ; i < MAX_RESOLVE_NAMES ; i++, entry++ ) {
+			if ( entry->state == RESOLVE_QUEUED ) {
+				break;
+			}
+		}
+		if ( i == MAX_RESOLVE_NAMES ) {
+			Sys_UnlockMutex( resolver.lock );
+			continue;
+		}
+		entry->state = RESOLVE_BUSY;
+		Q_strncpyz( name, entry->name, sizeof( name ) );
+		family = entry->family;
+		Sys_UnlockMutex( resolver.lock );
+
+		error[0] = '\0';
+		result = NET_ResolveAdr( name, &adr, family, error, sizeof( error ) );
+
+		Sys_LockMutex( resolver.lock );
+		entry->newAdr = adr;
+		entry->newResult = result;
+		Q_strncpyz( entry->error, error, sizeof( entry->error ) );
+		entry->state = RESOLVE_DONE;
+		Sys_UnlockMutex( resolver.lock );
+	}
+}
+
+/*
+==================
+NET_ResolverStart
+
+Falls back to resolving inline if anything fails.
+==================
+*/
+static void NET_ResolverStart( void ) {
+	resolver.started = qtrue;
+
+	resolver.lock = Sys_CreateMutex();
+	resolver.wake = Sys_CreateSemaphore();
+
+	if ( resolver.lock && resolver.wake ) {
+		resolver.thread = Sys_CreateThread( NET_ResolverThread, NULL );
+		if ( resolver.thread ) {
+			return;
+		}
+	}
+
+	Com_Printf( "WARNING: couldn't start the resolver thread\n" );
+
+	if ( resolver.wake ) {
+		Sys_DestroySemaphore( resolver.wake );
+		resolver.wake = NULL;
+	}
+	if ( resolver.lock ) {
+		Sys_DestroyMutex( resolver.lock );
+		resolver.lock = NULL;
+	}
+}
+
+/*
+==================
+NET_ResolverShutdown
+
+Waits for a lookup that is under way
+==================
+*/
+void NET_ResolverShutdown( void ) {
+	if ( resolver.thread ) {
+		resolver.quit = qtrue;
+		Sys_PostSemaphore( resolver.wake );
+		Sys_JoinThread( resolver.thread );
+
+		Sys_DestroySemaphore( resolver.wake );
+		Sys_DestroyMutex( resolver.lock );
+	}
+
+	Com_Memset( &resolver, 0, sizeof( resolver ) );
+}
+
+/*
+==================
+NET_ResolveTake
+
+Takes in what the thread found out
+==================
+*/
+static void NET_ResolveTake( resolveName_t *entry, int result, const netadr_t *adr, const char *error ) {
+	entry->tryTime = Sys_Milliseconds();
+
+	if ( !result ) {
+		Com_Printf( "Error resolving %s: %s\n", entry->name, error[0] ? error : "not found" );
+
+		// keep what worked until something else does
+		if ( entry->result > 0 ) {
+			return;
+		}
+	} else {
+		entry->answerTime = entry->tryTime;
+	}
+
+	entry->result = result;
+	entry->adr = *adr;
+}
+
+/*
+==================
+NET_ResolveAsync
+
+Returns what NET_StringToAdr did for the name when it was last looked up,
+or -1 with an NA_BAD address if it hasn't been answered yet, and asks for
+it again when the answer is older than maxAgeMsec. answerTime, if not
+NULL, gets the Sys_Milliseconds of the last good answer.
+==================
+*/
+int NET_ResolveAsync( const char *s, netadr_t *a, netadrtype_t family, int maxAgeMsec, int *answerTime ) {
+	resolveName_t	*entry, *oldest;
+	resolveState_t	state;
+	netadr_t		adr;
+	char			error[128];
+	int				i, now, result;
+
+	if ( !resolver.started ) {
+		NET_ResolverStart();
+	}
+
+	now = Sys_Milliseconds();
+
+	oldest = NULL;
+	for ( i = 0, entry = resolver.names ; i < MAX_RESOLVE_NAMES ; i++, entry++ ) {
+		if ( entry->name[0] && entry->family == family && !strcmp( entry->name, s ) ) {
+			break;
+		}
+		// the thread may be holding on to a name that is queued
+		if ( entry->state == RESOLVE_IDLE && ( !oldest || entry->lastUsed < oldest->lastUsed ) ) {
+			oldest = entry;
+		}
+	}
+
+	if ( i == MAX_RESOLVE_NAMES ) {
+		if ( !oldest ) {
+			Com_Memset( a, 0, sizeof( *a ) );
+			a->type = NA_BAD;
+			return -1;
+		}
+
+		entry = oldest;
+		Com_Memset( entry, 0, sizeof( *entry ) );
+		Q_strncpyz( entry->name, s, sizeof( entry->name ) );
+		entry->family = family;
+		entry->result = -1;
+		entry->adr.type = NA_BAD;
+	}
+	entry->lastUsed = now;
+
+	if ( resolver.thread ) {
+		Sys_LockMutex( resolver.lock );
+		state = entry->state;
+		if ( state == RESOLVE_DONE ) {
+			result = entry->newResult;
+			adr = entry->newAdr;
+			Q_strncpyz( error, entry->error, sizeof( error ) );
+			entry->state = RESOLVE_IDLE;
+		}
+		Sys_UnlockMutex( resolver.lock );
+
+		if ( state == RESOLVE_DONE ) {
+			NET_ResolveTake( entry, result, &adr, error );
+			state = RESOLVE_IDLE;
+		}
+	} else {
+		state = RESOLVE_IDLE;
+	}
+
+	if ( state == RESOLVE_IDLE && ( entry->result < 0 ||
+		now - entry->tryTime >= ( entry->result > 0 ? maxAgeMsec : RESOLVE_RETRY_MSEC ) ) ) {
+		if ( resolver.thread ) {
+			Sys_LockMutex( resolver.lock );
+			entry->state = RESOLVE_QUEUED;
+			Sys_UnlockMutex( resolver.lock );
+			Sys_PostSemaphore( resolver.wake );
+		} else {
+			error[0] = '\0';
+			result = NET_ResolveAdr( s, &adr, family, error, sizeof( error ) );
+			NET_ResolveTake( entry, result, &adr, error );
+		}
+	}
+
+	if ( answerTime ) {
+		*answerTime = entry->answerTime;
+	}
+
+	*a = entry->adr;
+	return entry->result;
+}
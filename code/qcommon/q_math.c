@@ -31,6 +31,17 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "q_shared.h"
 
+#ifndef Q3_VM
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) && ( idx64 || id386 )
+#include <immintrin.h>
+#define QMATH_X86
+#define QMATH_TARGET( t )	__attribute__(( target( t ) ))
+#elif defined( __aarch64__ )
+#include <arm_neon.h>
+#define QMATH_NEON
+#endif
+#endif
+
 vec3_t	vec3_origin = {0,0,0};
 vec3_t	axisDefault[3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
 
@@ -1047,3 +1058,345 @@ float Q_acos(float c) {
 	return angle;
 }
 #endif
+
+#ifndef Q3_VM
+/*
+===============================================================================
+
+BATCHED MATH
+
+The x86 variants are compiled for their instruction set only and picked
+at run time, NEON is always there on aarch64.  Vectors and planes are
+gathered into lanes, so the arithmetic per lane is exactly that of the
+scalar function.  BoxOnPlaneSide's axial and bad signbits cases are left
+to it.
+
+===============================================================================
+*/
+
+/*
+=================
+BoxOnPlaneSides_Scalar
+=================
+*/
+static void BoxOnPlaneSides_Scalar( const vec3_t mins, const vec3_t maxs, const cplane_t *planes, int numPlanes, int *sides ) {
+	int		i;
+
+	for ( i = 0 ; i < numPlanes ; i++ ) {
+		sides[i] = BoxOnPlaneSide( (vec_t *)mins, (vec_t *)maxs, (cplane_t *)&planes[i] );
+	}
+}
+
+/*
+=================
+VectorNormalizeArray_Scalar
+=================
+*/
+static void VectorNormalizeArray_Scalar( vec3_t *v, int count ) {
+	int		i;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		VectorNormalize( v[i] );
+	}
+}
+
+/*
+=================
+BoxOnPlaneSidesFinish
+
+Turns the lane masks into sides, front and back have bit i set for
+planes[i]
+=================
+*/
+static ID_INLINE void BoxOnPlaneSidesFinish( const vec3_t mins, const vec3_t maxs, const cplane_t *planes, int numPlanes, int front, int back, int *sides ) {
+	int		i;
+
+	for ( i = 0 ; i < numPlanes ; i++ ) {
+		if ( planes[i].type < 3 || planes[i].signbits >= 8 ) {
+			sides[i] = BoxOnPlaneSide( (vec_t *)mins, (vec_t *)maxs, (cplane_t *)&planes[i] );
+		} else {
+			sides[i] = ( ( front >> i ) & 1 ) | ( ( ( back >> i ) & 1 ) << 1 );
+		}
+	}
+}
+
+#ifdef QMATH_X86
+
+/*
+=================
+BoxOnPlaneSides_SSE41
+=================
+*/
+static QMATH_TARGET( "sse4.1" ) void BoxOnPlaneSides_SSE41( const vec3_t mins, const vec3_t maxs, const cplane_t *planes, int numPlanes, int *sides ) {
+	const cplane_t	*p;
+	__m128		mn[3], mx[3];
+	__m128		n, neg, d0, d1, dist;
+	__m128i		signbits, bit;
+	int			i, j;
+
+	for ( j = 0 ; j < 3 ; j++ ) {
+		mn[j] = _mm_set1_ps( mins[j] );
+		mx[j] = _mm_set1_ps( maxs[j] );
+	}
+
+	for ( i = 0 ; i + 4 <= numPlanes ; i += 4 ) {
+		p = planes + i;
+		signbits = _mm_setr_epi32( p[0].signbits, p[1].signbits, p[2].signbits, p[3].signbits );
+
+		// dist0 takes maxs where the normal is positive, dist1 mins
+		d0 = d1 = _mm_setzero_ps();
+		for ( j = 0 ; j < 3 ; j++ ) {
+			n = _mm_setr_ps( p[0].normal[j], p[1].normal[j], p[2].normal[j], p[3].normal[j] );
+			bit = _mm_set1_epi32( 1 << j );
+			neg = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( signbits, bit ), bit ) );
+			d0 = _mm_add_ps( d0, _mm_mul_ps( n, _mm_blendv_ps( mx[j], mn[j], neg ) ) );
+			d1 = _mm_add_ps( d1, _mm_mul_ps( n, _mm_blendv_ps( mn[j], mx[j], neg ) ) );
+		}
+
+		dist = _mm_setr_ps( p[0].dist, p[1].dist, p[2].dist, p[3].dist );
+		BoxOnPlaneSidesFinish( mins, maxs, p, 4,
+			_mm_movemask_ps( _mm_cmpge_ps( d0, dist ) ), _mm_movemask_ps( _mm_cmplt_ps( d1, dist ) ), sides + i );
+	}
+
+	BoxOnPlaneSides_Scalar( mins, maxs, planes + i, numPlanes - i, sides + i );
+}
+
+/*
+=================
+VectorNormalizeArray_SSE41
+=================
+*/
+static QMATH_TARGET( "sse4.1" ) void VectorNormalizeArray_SSE41( vec3_t *v, int count ) {
+	__m128		x, y, z, length, ilength, nonzero;
+	float		out[3][4];
+	int			i, j;
+
+	for ( i = 0 ; i + 4 <= count ; i += 4 ) {
+		x = _mm_setr_ps( v[i][0], v[i + 1][0], v[i + 2][0], v[i + 3][0] );
+		y = _mm_setr_ps( v[i][1], v[i + 1][1], v[i + 2][1], v[i + 3][1] );
+		z = _mm_setr_ps( v[i][2], v[i + 1][2], v[i + 2][2], v[i + 3][2] );
+
+		length = _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) ), _mm_mul_ps( z, z ) );
+		ilength = _mm_div_ps( _mm_set1_ps( 1.0f ), _mm_sqrt_ps( length ) );
+		nonzero = _mm_cmpneq_ps( length, _mm_setzero_ps() );
+
+		_mm_storeu_ps( out[0], _mm_blendv_ps( x, _mm_mul_ps( x, ilength ), nonzero ) );
+		_mm_storeu_ps( out[1], _mm_blendv_ps( y, _mm_mul_ps( y, ilength ), nonzero ) );
+		_mm_storeu_ps( out[2], _mm_blendv_ps( z, _mm_mul_ps( z, ilength ), nonzero ) );
+		for ( j = 0 ; j < 4 ; j++ ) {
+			v[i + j][0] = out[0][j];
+			v[i + j][1] = out[1][j];
+			v[i + j][2] = out[2][j];
+		}
+	}
+
+	VectorNormalizeArray_Scalar( v + i, count - i );
+}
+
+/*
+=================
+BoxOnPlaneSides_AVX2
+=================
+*/
+static QMATH_TARGET( "avx2" ) void BoxOnPlaneSides_AVX2( const vec3_t mins, const vec3_t maxs, const cplane_t *planes, int numPlanes, int *sides ) {
+	const cplane_t	*p;
+	__m256		mn[3], mx[3];
+	__m256		n, neg, d0, d1, dist;
+	__m256i		signbits, bit;
+	int			i, j;
+
+	for ( j = 0 ; j < 3 ; j++ ) {
+		mn[j] = _mm256_set1_ps( mins[j] );
+		mx[j] = _mm256_set1_ps( maxs[j] );
+	}
+
+	for ( i = 0 ; i + 8 <= numPlanes ; i += 8 ) {
+		p = planes + i;
+		signbits = _mm256_setr_epi32( p[0].signbits, p[1].signbits, p[2].signbits, p[3].signbits,
+			p[4].signbits, p[5].signbits, p[6].signbits, p[7].signbits );
+
+		d0 = d1 = _mm256_setzero_ps();
+		for ( j = 0 ; j < 3 ; j++ ) {
+			n = _mm256_setr_ps( p[0].normal[j], p[1].normal[j], p[2].normal[j], p[3].normal[j],
+				p[4].normal[j], p[5].normal[j], p[6].normal[j], p[7].normal[j] );
+			bit = _mm256_set1_epi32( 1 << j );
+			neg = _mm256_castsi256_ps( _mm256_cmpeq_epi32( _mm256_and_si256( signbits, bit ), bit ) );
+			d0 = _mm256_add_ps( d0, _mm256_mul_ps( n, _mm256_blendv_ps( mx[j], mn[j], neg ) ) );
+			d1 = _mm256_add_ps( d1, _mm256_mul_ps( n, _mm256_blendv_ps( mn[j], mx[j], neg ) ) );
+		}
+
+		dist = _mm256_setr_ps( p[0].dist, p[1].dist, p[2].dist, p[3].dist,
+			p[4].dist, p[5].dist, p[6].dist, p[7].dist );
+		BoxOnPlaneSidesFinish( mins, maxs, p, 8,
+			_mm256_movemask_ps( _mm256_cmp_ps( d0, dist, _CMP_GE_OQ ) ),
+			_mm256_movemask_ps( _mm256_cmp_ps( d1, dist, _CMP_LT_OQ ) ), sides + i );
+	}
+
+	BoxOnPlaneSides_SSE41( mins, maxs, planes + i, numPlanes - i, sides + i );
+}
+
+/*
+=================
+VectorNormalizeArray_AVX2
+=================
+*/
+static QMATH_TARGET( "avx2" ) void VectorNormalizeArray_AVX2( vec3_t *v, int count ) {
+	__m256		x, y, z, length, ilength, nonzero;
+	float		out[3][8];
+	int			i, j;
+
+	for ( i = 0 ; i + 8 <= count ; i += 8 ) {
+		x = _mm256_setr_ps( v[i][0], v[i + 1][0], v[i + 2][0], v[i + 3][0],
+			v[i + 4][0], v[i + 5][0], v[i + 6][0], v[i + 7][0] );
+		y = _mm256_setr_ps( v[i][1], v[i + 1][1], v[i + 2][1], v[i + 3][1],
+			v[i + 4][1], v[i + 5][1], v[i + 6][1], v[i + 7][1] );
+		z = _mm256_setr_ps( v[i][2], v[i + 1][2], v[i + 2][2], v[i + 3][2],
+			v[i + 4][2], v[i + 5][2], v[i + 6][2], v[i + 7][2] );
+
+		length = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( x, x ), _mm256_mul_ps( y, y ) ), _mm256_mul_ps( z, z ) );
+		ilength = _mm256_div_ps( _mm256_set1_ps( 1.0f ), _mm256_sqrt_ps( length ) );
+		nonzero = _mm256_cmp_ps( length, _mm256_setzero_ps(), _CMP_NEQ_UQ );
+
+		_mm256_storeu_ps( out[0], _mm256_blendv_ps( x, _mm256_mul_ps( x, ilength ), nonzero ) );
+		_mm256_storeu_ps( out[1], _mm256_blendv_ps( y, _mm256_mul_ps( y, ilength ), nonzero ) );
+		_mm256_storeu_ps( out[2], _mm256_blendv_ps( z, _mm256_mul_ps( z, ilength ), nonzero ) );
+		for ( j = 0 ; j < 8 ; j++ ) {
+			v[i + j][0] = out[0][j];
+			v[i + j][1] = out[1][j];
+			v[i + j][2] = out[2][j];
+		}
+	}
+
+	VectorNormalizeArray_SSE41( v + i, count - i );
+}
+
+#endif // QMATH_X86
+
+#ifdef QMATH_NEON
+
+/*
+=================
+BoxOnPlaneSides_NEON
+=================
+*/
+static void BoxOnPlaneSides_NEON( const vec3_t mins, const vec3_t maxs, const cplane_t *planes, int numPlanes, int *sides ) {
+	const cplane_t	*p;
+	float32x4_t	mn[3], mx[3];
+	float32x4_t	n, d0, d1, dist;
+	uint32x4_t	signbits, bit, neg, front, back;
+	float		lane[4];
+	uint32_t	mask[4];
+	int			i, j, frontBits, backBits;
+
+	for ( j = 0 ; j < 3 ; j++ ) {
+		mn[j] = vdupq_n_f32( mins[j] );
+		mx[j] = vdupq_n_f32( maxs[j] );
+	}
+
+	for ( i = 0 ; i + 4 <= numPlanes ; i += 4 ) {
+		p = planes + i;
+		for ( j = 0 ; j < 4 ; j++ ) {
+			mask[j] = p[j].signbits;
+		}
+		signbits = vld1q_u32( mask );
+
+		d0 = d1 = vdupq_n_f32( 0 );
+		for ( j = 0 ; j < 3 ; j++ ) {
+			lane[0] = p[0].normal[j];
+			lane[1] = p[1].normal[j];
+			lane[2] = p[2].normal[j];
+			lane[3] = p[3].normal[j];
+			n = vld1q_f32( lane );
+			bit = vdupq_n_u32( 1 << j );
+			neg = vceqq_u32( vandq_u32( signbits, bit ), bit );
+			d0 = vaddq_f32( d0, vmulq_f32( n, vbslq_f32( neg, mn[j], mx[j] ) ) );
+			d1 = vaddq_f32( d1, vmulq_f32( n, vbslq_f32( neg, mx[j], mn[j] ) ) );
+		}
+
+		for ( j = 0 ; j < 4 ; j++ ) {
+			lane[j] = p[j].dist;
+		}
+		dist = vld1q_f32( lane );
+		front = vcgeq_f32( d0, dist );
+		back = vcltq_f32( d1, dist );
+
+		frontBits = backBits = 0;
+		vst1q_u32( mask, front );
+		for ( j = 0 ; j < 4 ; j++ ) {
+			frontBits |= ( mask[j] & 1 ) << j;
+		}
+		vst1q_u32( mask, back );
+		for ( j = 0 ; j < 4 ; j++ ) {
+			backBits |= ( mask[j] & 1 ) << j;
+		}
+		BoxOnPlaneSidesFinish( mins, maxs, p, 4, frontBits, backBits, sides + i );
+	}
+
+	BoxOnPlaneSides_Scalar( mins, maxs, planes + i, numPlanes - i, sides + i );
+}
+
+/*
+=================
+VectorNormalizeArray_NEON
+=================
+*/
+static void VectorNormalizeArray_NEON( vec3_t *v, int count ) {
+	float32x4x3_t	xyz;
+	float32x4_t		length, ilength;
+	uint32x4_t		nonzero;
+	int				i;
+
+	for ( i = 0 ; i + 4 <= count ; i += 4 ) {
+		// vld3 deinterleaves four packed vec3_t
+		xyz = vld3q_f32( v[i] );
+
+		length = vaddq_f32( vaddq_f32( vmulq_f32( xyz.val[0], xyz.val[0] ), vmulq_f32( xyz.val[1], xyz.val[1] ) ),
+			vmulq_f32( xyz.val[2], xyz.val[2] ) );
+		ilength = vdivq_f32( vdupq_n_f32( 1.0f ), vsqrtq_f32( length ) );
+		nonzero = vmvnq_u32( vceqq_f32( length, vdupq_n_f32( 0 ) ) );
+
+		xyz.val[0] = vbslq_f32( nonzero, vmulq_f32( xyz.val[0], ilength ), xyz.val[0] );
+		xyz.val[1] = vbslq_f32( nonzero, vmulq_f32( xyz.val[1], ilength ), xyz.val[1] );
+		xyz.val[2] = vbslq_f32( nonzero, vmulq_f32( xyz.val[2], ilength ), xyz.val[2] );
+		vst3q_f32( v[i], xyz );
+	}
+
+	VectorNormalizeArray_Scalar( v + i, count - i );
+}
+
+#endif // QMATH_NEON
+
+qmathFuncs_t	qmath = {
+	BoxOnPlaneSides_Scalar,
+	VectorNormalizeArray_Scalar
+};
+
+/*
+=================
+Q_InitMathFuncs
+
+cpuFeatures is what Sys_GetProcessorFeatures returned
+=================
+*/
+void Q_InitMathFuncs( int cpuFeatures ) {
+	qmath.BoxOnPlaneSides = BoxOnPlaneSides_Scalar;
+	qmath.VectorNormalizeArray = VectorNormalizeArray_Scalar;
+
+#ifdef QMATH_X86
+	if ( cpuFeatures & CF_AVX2 ) {
+		qmath.BoxOnPlaneSides = BoxOnPlaneSides_AVX2;
+		qmath.VectorNormalizeArray = VectorNormalizeArray_AVX2;
+	} else if ( cpuFeatures & CF_SSE41 ) {
+		qmath.BoxOnPlaneSides = BoxOnPlaneSides_SSE41;
+		qmath.VectorNormalizeArray = VectorNormalizeArray_SSE41;
+	}
+#endif
+
+#ifdef QMATH_NEON
+	if ( cpuFeatures & CF_NEON ) {
+		qmath.BoxOnPlaneSides = BoxOnPlaneSides_NEON;
+		qmath.VectorNormalizeArray = VectorNormalizeArray_NEON;
+	}
+#endif
+}
+#endif
@@ -1405,6 +1405,366 @@ void Info_SetValueForKey_Big( char *s, const char *key, const char *value ) {
 	strcat (s, newi);
 }
 
+/*
+=====================================================================
+
+  PARSED INFO STRINGS
+
+An info string split into its pairs once, with the keys hashed, so reading
+or setting many of them doesn't walk and rebuild the whole string for each.
+Keys are found ignoring case like Info_ValueForKey, set and removed by exact
+match like Info_SetValueForKey and Info_RemoveKey. The string form is only
+put back together when asked for.
+
+A changed or new pair goes at the end. An empty value removes the key, except
+in a BIG_INFO_STRING sized one where it is kept as Info_SetValueForKey_Big does.
+
+=====================================================================
+*/
+
+/*
+==================
+Info_HashKey
+
+Lower case the way Q_stricmp does
+==================
+*/
+static int Info_HashKey( const char *key ) {
+	unsigned	hash;
+	int			c;
+
+	hash = 2166136261u;
+	for ( ; *key ; key++ ) {
+		c = *key;
+		if ( c >= 'A' && c <= 'Z' ) {
+			c += 'a' - 'A';
+		}
+		hash = ( hash ^ c ) * 16777619u;
+	}
+
+	return ( hash ^ ( hash >> 16 ) ) & ( INFO_HASH_SIZE - 1 );
+}
+
+/*
+==================
+Info_FindPair
+==================
+*/
+static int Info_FindPair( const infoString_t *info, const char *key, qboolean exact ) {
+	const char	*pkey;
+	int			n;
+
+	for ( n = info->hash[Info_HashKey( key )] ; n ; n = info->pairs[n - 1].hashNext ) {
+		pkey = info->data + info->pairs[n - 1].key;
+		if ( exact ? !strcmp( pkey, key ) : !Q_stricmp( pkey, key ) ) {
+			return n - 1;
+		}
+	}
+
+	return -1;
+}
+
+/*
+==================
+Info_RemovePair
+==================
+*/
+static void Info_RemovePair( infoString_t *info, int n ) {
+	infoPair_t	*pair = &info->pairs[n];
+	short		*link;
+
+	for ( link = &info->hash[Info_HashKey( info->data + pair->key )] ; *link ; link = &info->pairs[*link - 1].hashNext ) {
+		if ( *link == n + 1 ) {
+			*link = pair->hashNext;
+			break;
+		}
+	}
+
+	info->length -= pair->keyLength + pair->valueLength + 2;
+	pair->key = -1;
+	info->dirty = qtrue;
+}
+
+/*
+==================
+Info_Compact
+
+Drops what removed and replaced pairs left behind
+==================
+*/
+static void Info_Compact( infoString_t *info ) {
+	char	s[BIG_INFO_STRING];
+
+	Com_Memcpy( s, Info_String( info ), info->length + 1 );
+	Info_Parse( info, s, info->maxSize );
+}
+
+/*
+==================
+Info_AddPair
+
+At the end of the pairs, and of its hash chain so the first of two keys
+that only differ in case is the one found, as in the string.
+==================
+*/
+static qboolean Info_AddPair( infoString_t *info, const char *key, int keyLength, const char *value, int valueLength ) {
+	infoPair_t	*pair;
+	short		*link;
+	int			size;
+
+	size = keyLength + valueLength + 2;
+
+	// every pair takes as much data as it does in the string, the rest is waste
+	if ( ( info->numPairs >= MAX_INFO_PAIRS || info->dataUsed + size > sizeof( info->data ) )
+		&& info->dataUsed > info->length ) {
+		Info_Compact( info );
+	}
+	if ( info->numPairs >= MAX_INFO_PAIRS || info->dataUsed + size > sizeof( info->data ) ) {
+		Com_Printf( S_COLOR_YELLOW "Info string has too many keys\n" );
+		return qfalse;
+	}
+
+	pair = &info->pairs[info->numPairs];
+	pair->key = info->dataUsed;
+	pair->keyLength = keyLength;
+	Com_Memcpy( info->data + pair->key, key, keyLength );
+	info->data[pair->key + keyLength] = 0;
+
+	pair->value = pair->key + keyLength + 1;
+	pair->valueLength = valueLength;
+	Com_Memcpy( info->data + pair->value, value, valueLength );
+	info->data[pair->value + valueLength] = 0;
+
+	info->dataUsed += size;
+	info->length += size;
+
+	pair->hashNext = 0;
+	for ( link = &info->hash[Info_HashKey( info->data + pair->key )] ; *link ; link = &info->pairs[*link - 1].hashNext ) {
+	}
+	*link = ++info->numPairs;
+
+	info->dirty = qtrue;
+
+	return qtrue;
+}
+
+/*
+==================
+Info_Init
+
+An empty info string that can grow to maxSize, with the terminator
+==================
+*/
+void Info_Init( infoString_t *info, int maxSize ) {
+	if ( maxSize > BIG_INFO_STRING ) {
+		maxSize = BIG_INFO_STRING;
+	}
+
+	info->maxSize = maxSize;
+	info->length = 0;
+	info->dataUsed = 0;
+	info->numPairs = 0;
+	Com_Memset( info->hash, 0, sizeof( info->hash ) );
+	info->dirty = qfalse;
+	info->string[0] = 0;
+}
+
+/*
+==================
+Info_Parse
+
+A trailing key without a value is dropped, Info_ValueForKey never
+finds one either
+==================
+*/
+void Info_Parse( infoString_t *info, const char *s, int maxSize ) {
+	const char	*key, *value;
+	int			keyLength;
+
+	Info_Init( info, maxSize );
+
+	if ( strlen( s ) >= info->maxSize ) {
+		Com_Error( ERR_DROP, "Info_Parse: oversize infostring" );
+	}
+
+	if ( *s == '\\' ) {
+		s++;
+	}
+	while ( *s ) {
+		key = s;
+		while ( *s && *s != '\\' ) {
+			s++;
+		}
+		if ( !*s ) {
+			break;
+		}
+		keyLength = s - key;
+		s++;
+
+		value = s;
+		while ( *s && *s != '\\' ) {
+			s++;
+		}
+
+		if ( !Info_AddPair( info, key, keyLength, value, s - value ) ) {
+			break;
+		}
+
+		if ( *s ) {
+			s++;
+		}
+	}
+}
+
+/*
+==================
+Info_Find
+
+The value of key, an empty string if it isn't there
+==================
+*/
+const char *Info_Find( const infoString_t *info, const char *key ) {
+	int		n;
+
+	if ( !key ) {
+		return "";
+	}
+
+	n = Info_FindPair( info, key, qfalse );
+	if ( n == -1 ) {
+		return "";
+	}
+
+	return info->data + info->pairs[n].value;
+}
+
+/*
+==================
+Info_Set
+
+Changes or adds a key/value pair, qfalse if it was refused
+==================
+*/
+qboolean Info_Set( infoString_t *info, const char *key, const char *value ) {
+	const char	*blacklist = "\\;\"";
+	int			n, keyLength, valueLength;
+
+	if ( !value ) {
+		value = "";
+	}
+
+	for ( ; *blacklist ; ++blacklist ) {
+		if ( strchr( key, *blacklist ) || strchr( value, *blacklist ) ) {
+			Com_Printf( S_COLOR_YELLOW "Can't use keys or values with a '%c': %s = %s\n", *blacklist, key, value );
+			return qfalse;
+		}
+	}
+
+	n = Info_FindPair( info, key, qtrue );
+	if ( n != -1 ) {
+		if ( !strcmp( info->data + info->pairs[n].value, value ) ) {
+			return qtrue;
+		}
+		Info_RemovePair( info, n );
+	}
+
+	if ( !*value && info->maxSize < BIG_INFO_STRING ) {
+		return qtrue;
+	}
+
+	keyLength = strlen( key );
+	valueLength = strlen( value );
+
+	if ( info->length + keyLength + valueLength + 2 >= info->maxSize ) {
+		if ( info->maxSize < BIG_INFO_STRING ) {
+			Com_Printf( "Info string length exceeded\n" );
+		} else {
+			Com_Printf( "BIG Info string length exceeded\n" );
+		}
+		return qfalse;
+	}
+
+	return Info_AddPair( info, key, keyLength, value, valueLength );
+}
+
+/*
+==================
+Info_Remove
+==================
+*/
+void Info_Remove( infoString_t *info, const char *key ) {
+	int		n;
+
+	if ( strchr( key, '\\' ) ) {
+		return;
+	}
+
+	n = Info_FindPair( info, key, qtrue );
+	if ( n != -1 ) {
+		Info_RemovePair( info, n );
+	}
+}
+
+/*
+==================
+Info_GetPair
+
+For going through the pairs in order, index up to info->numPairs.
+qfalse for one that has been removed.
+==================
+*/
+qboolean Info_GetPair( const infoString_t *info, int index, const char **key, const char **value ) {
+	const infoPair_t	*pair;
+
+	if ( index < 0 || index >= info->numPairs ) {
+		return qfalse;
+	}
+
+	pair = &info->pairs[index];
+	if ( pair->key == -1 ) {
+		return qfalse;
+	}
+
+	*key = info->data + pair->key;
+	*value = info->data + pair->value;
+	return qtrue;
+}
+
+/*
+==================
+Info_String
+
+The string form, valid until the info is changed again
+==================
+*/
+const char *Info_String( infoString_t *info ) {
+	const infoPair_t	*pair;
+	char				*o;
+	int					i;
+
+	if ( !info->dirty ) {
+		return info->string;
+	}
+
+	o = info->string;
+	for ( i = 0, pair = info->pairs ; i < info->numPairs ; i++, pair++ ) {
+		if ( pair->key == -1 ) {
+			continue;
+		}
+		*o++ = '\\';
+		Com_Memcpy( o, info->data + pair->key, pair->keyLength );
+		o += pair->keyLength;
+		*o++ = '\\';
+		Com_Memcpy( o, info->data + pair->value, pair->valueLength );
+		o += pair->valueLength;
+	}
+	*o = 0;
+
+	info->dirty = qfalse;
+
+	return info->string;
+}
+
 
 
 
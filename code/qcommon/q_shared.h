@@ -876,6 +876,43 @@ void Info_SetValueForKey_Big( char *s, const char *key, const char *value );
 qboolean Info_Validate( const char *s );
 void Info_NextPair( const char **s, char *key, char *value );
 
+//
+// a parsed info string, for when many keys are read or set at once
+//
+#define	MAX_INFO_PAIRS		512
+#define	INFO_HASH_SIZE		64		// power of two
+
+typedef struct {
+	short		key;				// offset in data, -1 once removed
+	short		value;
+	short		keyLength;
+	short		valueLength;
+	short		hashNext;			// pair + 1
+} infoPair_t;
+
+typedef struct {
+	int			maxSize;			// MAX_INFO_STRING or BIG_INFO_STRING
+	int			length;				// of the string form
+
+	char		data[BIG_INFO_STRING * 2];	// "key\0value\0" of every pair set
+	int			dataUsed;
+
+	infoPair_t	pairs[MAX_INFO_PAIRS];
+	int			numPairs;
+	short		hash[INFO_HASH_SIZE];	// pair + 1
+
+	qboolean	dirty;				// string is out of date
+	char		string[BIG_INFO_STRING];
+} infoString_t;
+
+void Info_Init( infoString_t *info, int maxSize );
+void Info_Parse( infoString_t *info, const char *s, int maxSize );
+const char *Info_Find( const infoString_t *info, const char *key );
+qboolean Info_Set( infoString_t *info, const char *key, const char *value );
+void Info_Remove( infoString_t *info, const char *key );
+qboolean Info_GetPair( const infoString_t *info, int index, const char **key, const char **value );
+const char *Info_String( infoString_t *info );
+
 // this is only here so the functions in q_shared.c and bg_*.c can link
 void	QDECL Com_Error( int level, const char *error, ... ) __attribute__ ((noreturn, format(printf, 2, 3)));
 void	QDECL Com_Printf( const char *msg, ... ) __attribute__ ((format (printf, 1, 2)));
@@ -1011,6 +1048,42 @@ typedef struct cplane_s {
 	byte	pad[2];
 } cplane_t;
 
+// returned by Sys_GetProcessorFeatures
+typedef enum
+{
+  CF_RDTSC      = 1 << 0,
+  CF_MMX        = 1 << 1,
+  CF_MMX_EXT    = 1 << 2,
+  CF_3DNOW      = 1 << 3,
+  CF_3DNOW_EXT  = 1 << 4,
+  CF_SSE        = 1 << 5,
+  CF_SSE2       = 1 << 6,
+  CF_ALTIVEC    = 1 << 7,
+  CF_SSE41      = 1 << 8,
+  CF_AVX2       = 1 << 9,
+  CF_NEON       = 1 << 10
+} cpuFeatures_t;
+
+#ifndef Q3_VM
+/*
+Batched math for the engine.  Each function does what its single vector
+counterpart does for a whole array, with the same operations in the same
+order, so the results match.  Q_InitMathFuncs points the table at the
+widest variant the processor has, until then it holds the scalar ones.
+Game code and Q_SnapVector keep using the plain functions.
+*/
+typedef struct {
+	// sides[i] = BoxOnPlaneSide( mins, maxs, &planes[i] )
+	void	(*BoxOnPlaneSides)( const vec3_t mins, const vec3_t maxs, const cplane_t *planes, int numPlanes, int *sides );
+	// VectorNormalize on each vector
+	void	(*VectorNormalizeArray)( vec3_t *v, int count );
+} qmathFuncs_t;
+
+extern qmathFuncs_t	qmath;
+
+void Q_InitMathFuncs( int cpuFeatures );
+#endif
+
 
 // a trace is returned when a box is swept through the world
 typedef struct {
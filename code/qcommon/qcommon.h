@@ -67,6 +67,7 @@ struct entityState_s;
 struct playerState_s;
 
 void MSG_WriteBits( msg_t *msg, int value, int bits );
+void MSG_WriteBitstream( msg_t *msg, const byte *data, int bits );
 
 void MSG_WriteChar (msg_t *sb, int c);
 void MSG_WriteByte (msg_t *sb, int c);
@@ -148,7 +149,8 @@ typedef enum {
 	NA_IP,
 	NA_IP6,
 	NA_MULTICAST6,
-	NA_UNSPEC
+	NA_UNSPEC,
+	NA_LOADTEST					// simulated client of loadtest, nothing is sent
 } netadrtype_t;
 
 typedef enum {
@@ -183,15 +185,34 @@ qboolean	NET_IsLocalAddress (netadr_t adr);
 const char	*NET_AdrToString (netadr_t a);
 const char	*NET_AdrToStringwPort (netadr_t a);
 int		NET_StringToAdr ( const char *s, netadr_t *a, netadrtype_t family);
+int		NET_ResolveAdr( const char *s, netadr_t *a, netadrtype_t family, char *error, int errorSize );
+
+// net_resolve.c, names looked up on a thread, the last answer is used meanwhile
+int		NET_ResolveAsync( const char *s, netadr_t *a, netadrtype_t family, int maxAgeMsec, int *answerTime );
+void		NET_ResolverShutdown( void );
 qboolean	NET_GetLoopPacket (netsrc_t sock, netadr_t *net_from, msg_t *net_message);
+void		NET_SendLoopMessage( netsrc_t sock, const byte *header, int headerLength, const byte *data, int length );
 void		NET_JoinMulticast6(void);
 void		NET_LeaveMulticast6(void);
 void		NET_Sleep(int msec);
+void		NET_SleepUsec(int usec);
+int			NET_PacketAge(void);
+// msec since the packet being handled was read, non zero with net_recvThread
+int64_t		NET_PacketTime(void);
+// Sys_Microseconds the packet being handled was read at
 
 
 #define	MAX_MSGLEN				16384		// max length of a message, which may
 											// be fragmented into multiple packets
 
+#define	MAX_PACKETLEN			1400		// max size of a network packet any
+											// peer takes
+#define	NET_MAX_PACKETLEN		8972		// a 9000 byte jumbo frame less its IPv4
+											// and UDP headers, as large as probes go
+
+// IP and UDP header bytes that go with every datagram
+#define	NET_UDP_HEADERS( type )	( (type) == NA_IP6 ? 48 : 28 )
+
 #define MAX_DOWNLOAD_WINDOW		48	// ACK window of 48 download chunks. Cannot set this higher, or clients
 						// will overflow the reliable commands buffer
 #define MAX_DOWNLOAD_BLKSIZE		1024	// 896 byte block chunks
@@ -217,15 +238,19 @@ typedef struct {
 	// incoming fragment assembly buffer
 	int			fragmentSequence;
 	int			fragmentLength;	
-	byte		fragmentBuffer[MAX_MSGLEN];
+	int			fragmentSize;		// of the message being assembled, its first fragment's length
+	byte		fragmentBuffer[4 + MAX_MSGLEN];	// the sequence number goes in front
 
 	// outgoing fragment buffer
 	// we need to space out the sending of large fragmented messages
 	qboolean	unsentFragments;
 	int			unsentFragmentStart;
+	int			unsentFragmentSize;
 	int			unsentLength;
 	byte		unsentBuffer[MAX_MSGLEN];
 
+	int			sendFragmentSize;	// raised by Netchan_SetPacketLength for peers that take more
+
 	int			challenge;
 	int		lastSentTime;
 	int		lastSentSize;
@@ -237,6 +262,7 @@ typedef struct {
 
 void Netchan_Init( int qport );
 void Netchan_Setup(netsrc_t sock, netchan_t *chan, netadr_t adr, int qport, int challenge, qboolean compat);
+void Netchan_SetPacketLength( netchan_t *chan, int length );
 
 void Netchan_Transmit( netchan_t *chan, int length, const byte *data );
 void Netchan_TransmitNextFragment( netchan_t *chan );
@@ -258,10 +284,26 @@ PROTOCOL
 
 #ifdef USE_DEMO_FORMAT_42
 #	define	DEMO_VERSION	70
+#	define	DEMO_VERSION_INDEXED	71	// has keyframes and a seek index
 #else
 #	define	DEMO_VERSION	68
 #endif
 
+// In an indexed demo a record with DEMO_KEYFRAME for its length is a
+// keyframe: the real length follows, then a gamestate message that stands
+// in for everything before it, and the record after it is a full snapshot.
+// Playback skips them unless it is starting at one. After the -1 -1 end
+// marker comes the seek index, demoKeyframe_t[count], count, and
+// DEMO_INDEX_MAGIC, the first keyframe being the demo's own gamestate.
+#define	DEMO_KEYFRAME		-2
+#define	DEMO_INDEX_MAGIC	0x58444944	// "DIDX"
+#define	MAX_DEMO_KEYFRAMES	4096
+
+typedef struct {
+	int		serverTime;
+	int		offset;				// of the record in the file
+} demoKeyframe_t;
+
 // maintain a list of compatible protocols for demo playing
 // NOTE: that stuff only works with two digits protocols
 extern int demo_protocols[];
@@ -361,6 +403,16 @@ vm_t	*VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *),
 				   vmInterpret_t interpret );
 // module should be bare: "cgame", not "cgame.dll" or "vm/cgame.qvm"
 
+typedef struct {
+	intptr_t	(*func)( intptr_t *args );
+	int			numArgs;		// not counting the syscall number in args[0]
+} vmSyscall_t;
+
+// syscalls indexed by number; those with a func are called directly
+// instead of through systemCalls, and only get the arguments they take
+void	VM_SetSyscalls( vm_t *vm, const vmSyscall_t *syscalls, int numSyscalls );
+qboolean	VM_IsNative( vm_t *vm );
+
 void	VM_Free( vm_t *vm );
 void	VM_Clear(void);
 void	VM_Forced_Unload_Start(void);
@@ -370,6 +422,7 @@ vm_t	*VM_Restart(vm_t *vm, qboolean unpure);
 intptr_t		QDECL VM_Call( vm_t *vm, int callNum, ... );
 
 void	VM_Debug( int level );
+void	VM_SampleFrame( void );
 
 void	*VM_ArgPtr( intptr_t intValue );
 void	*VM_ExplicitArgPtr( vm_t *vm, intptr_t intValue );
@@ -572,6 +625,14 @@ void	Cvar_Restart_f( void );
 
 void Cvar_CompleteCvarName( char *args, int argNum );
 
+typedef void (*cvarChangeFunc_t)( cvar_t *var );
+
+void	Cvar_Subscribe( cvar_t *var, cvarChangeFunc_t func );
+void	Cvar_SubscribeFlags( int flags, cvarChangeFunc_t func );
+void	Cvar_Unsubscribe( cvarChangeFunc_t func );
+// func is called right after the change, Cvar_SubscribeFlags also calls it
+// for cvars that gain, lose or are created or unset with any of the flags
+
 extern	int			cvar_modifiedFlags;
 // whenever a cvar is modifed, its flags will be OR'd into this, so
 // a single check can determine if any CVAR_USERINFO, CVAR_SERVERINFO,
@@ -616,6 +677,10 @@ qboolean FS_Initialized( void );
 
 void	FS_InitFilesystem ( void );
 void	FS_Shutdown( qboolean closemfp );
+void	FS_ReopenPaks( void );
+
+qboolean FS_InflateEntry( const byte *src, int srcLen, byte *dst, int dstLen );
+// raw deflate data straight into dst, it must come out at exactly dstLen
 
 qboolean FS_ConditionalRestart(int checksumFeed, qboolean disconnect);
 void	FS_Restart( int checksumFeed );
@@ -642,17 +707,27 @@ qboolean FS_CompareZipChecksum(const char *zipfile);
 int		FS_LoadStack( void );
 
 int		FS_GetFileList(  const char *path, const char *extension, char *listbuf, int bufsize );
+
+// the maps on the search path, kept from FS_Startup on
+void	FS_RefreshMapCatalog( void );
+int		FS_FindMaps( const char *s, const char **matches, int maxMatches );
+int		FS_SimilarMaps( const char *s, const char **matches, int maxMatches );
+void	FS_MapCompletion( const char *prefix, void (*callback)( const char *s ) );
 int		FS_GetModList(  char *listbuf, int bufsize );
 
 void	FS_GetModDescription( const char *modDir, char *description, int descriptionLen );
 
 fileHandle_t	FS_FOpenFileWrite( const char *qpath );
 fileHandle_t	FS_FOpenFileAppend( const char *filename );
+FILE			*FS_FOpenRawFileWrite( const char *filename );
+FILE			*FS_FOpenRawFileAppend( const char *filename );
 fileHandle_t	FS_FCreateOpenPipeFile( const char *filename );
 // will properly create any needed paths and deal with seperater character issues
 
 fileHandle_t FS_SV_FOpenFileWrite( const char *filename );
+fileHandle_t FS_SV_FOpenFileAppend( const char *filename );
 long		FS_SV_FOpenFileRead( const char *filename, fileHandle_t *fp );
+FILE		*FS_SV_FOpenRawFileRead( const char *filename );
 void	FS_SV_Rename( const char *from, const char *to, qboolean safe );
 long		FS_FOpenFileRead( const char *qpath, fileHandle_t *file, qboolean uniqueFILE );
 // if uniqueFILE is true, then a new FILE will be fopened even if the file
@@ -664,6 +739,9 @@ long		FS_FOpenFileRead( const char *qpath, fileHandle_t *file, qboolean uniqueFI
 int		FS_FileIsInPAK(const char *filename, int *pChecksum );
 // returns 1 if a file is in the PAK file, otherwise -1
 
+qboolean	FS_PakFileCrc( const char *filename, unsigned *crc, int *len );
+// qtrue with the CRC32 its pk3 records if the file is read from a pk3
+
 int		FS_Write( const void *buffer, int len, fileHandle_t f );
 
 int		FS_Read( void *buffer, int len, fileHandle_t f );
@@ -690,6 +768,10 @@ void	FS_FreeFile( void *buffer );
 void	FS_WriteFile( const char *qpath, const void *buffer, int size );
 // writes a complete file, creating any subdirectories needed
 
+long	FS_ReadCacheFile( const char *name, void **buffer );
+qboolean FS_WriteCacheFile( const char *name, const void *buffer, int size );
+// files in the private cache under fs_homepath, read back only if written here
+
 long FS_filelength(fileHandle_t f);
 // doesn't work for files that are opened from a pack file
 
@@ -720,6 +802,8 @@ void FS_SetMapName( const char *mapname );
 void FS_SetExtraPure( const char *mapname, const char *extrapaks );
 
 const char *FS_ReferencedPakNames( void );
+const char *FS_PakFilename( const char *name );
+// full path of a pk3 named gamename/basename like in FS_ReferencedPakNames
 const char *FS_ReferencedPakChecksums( void );
 const char *FS_ReferencedPakPureChecksums( void );
 // Returns a space separated string containing the checksums of all loaded 
@@ -731,6 +815,7 @@ void FS_ClearPakReferences( int flags );
 
 void FS_PureServerSetReferencedPaks( const char *pakSums, const char *pakNames );
 void FS_PureServerSetLoadedPaks( const char *pakSums, const char *pakNames );
+qboolean FS_PureServerActive( void );
 // If the string is empty, all data sources will be allowed.
 // If not empty, only pk3 files that match one of the space
 // separated checksums will be checked for files, with the
@@ -751,6 +836,7 @@ void	FS_FilenameCompletion( const char *dir, const char *ext,
 
 const char *FS_GetCurrentGameDir(void);
 qboolean FS_Which(const char *filename, void *searchPath);
+qboolean FS_OSPathForFile( const char *filename, char *ospath, int size );
 
 extern int	fs_dangerousPaksFound;
 extern char	fs_dangerousPakNames[MAX_ZPATH][MAX_SEARCH_PATHS];
@@ -776,6 +862,7 @@ void Field_AutoComplete( field_t *edit );
 void Field_CompleteKeyname( void );
 void Field_CompleteFilename( const char *dir,
 		const char *ext, qboolean stripExt, qboolean searchUnpureDirs, qboolean searchUnpurePaks );
+void Field_CompleteMapName( void );
 void Field_CompleteCommand( char *cmd,
 		qboolean doCommands, qboolean doCvars );
 void Field_CompletePlayerName( const char **names, int count );
@@ -788,19 +875,6 @@ MISC
 ==============================================================
 */
 
-// returned by Sys_GetProcessorFeatures
-typedef enum
-{
-  CF_RDTSC      = 1 << 0,
-  CF_MMX        = 1 << 1,
-  CF_MMX_EXT    = 1 << 2,
-  CF_3DNOW      = 1 << 3,
-  CF_3DNOW_EXT  = 1 << 4,
-  CF_SSE        = 1 << 5,
-  CF_SSE2       = 1 << 6,
-  CF_ALTIVEC    = 1 << 7
-} cpuFeatures_t;
-
 // centralized and cleaned, that's the max string you can send to a Com_Printf / Com_DPrintf (above gets truncated)
 #define	MAXPRINTMSG	4096
 
@@ -832,6 +906,8 @@ void		Info_Print( const char *s );
 
 void		Com_BeginRedirect (char *buffer, int buffersize, void (*flush)(char *));
 void		Com_EndRedirect( void );
+qboolean	Com_IsMainThread( void );
+void		Com_DrainPrints( void );
 void 		QDECL Com_Printf( const char *fmt, ... ) __attribute__ ((format (printf, 1, 2)));
 void 		QDECL Com_DPrintf( const char *fmt, ... ) __attribute__ ((format (printf, 1, 2)));
 void 		QDECL Com_Error( int code, const char *fmt, ... ) __attribute__ ((noreturn, format(printf, 2, 3)));
@@ -841,6 +917,7 @@ void		Com_GameRestart(int checksumFeed, qboolean disconnect);
 int			Com_Milliseconds( void );	// will be journaled properly
 unsigned	Com_BlockChecksum( const void *buffer, int length );
 char		*Com_MD5File(const char *filename, int length, const char *prefix, int prefix_len);
+void		Com_HMACMD5(const byte *key, int keyLength, const char *prefix, int prefix_len, const void *data, int length, byte *digest);
 int			Com_Filter(char *filter, char *name, int casesensitive);
 int			Com_FilterPath(char *filter, char *name, int casesensitive);
 int			Com_RealTime(qtime_t *qtime);
@@ -896,7 +973,7 @@ extern	cvar_t	*com_legacyprotocol;
 extern  cvar_t  *con_autochat;
 #endif
 
-// com_speeds times
+// com_speeds times, the game in usec, the renderer in msec
 extern	int		time_game;
 extern	int		time_frontend;
 extern	int		time_backend;		// renderer backend time
@@ -915,9 +992,25 @@ typedef enum {
 	TAG_BOTLIB,
 	TAG_RENDERER,
 	TAG_SMALL,
-	TAG_STATIC
+	TAG_STATIC,
+	TAG_SLAB
 } memtag_t;
 
+// subsystems hunk and zone use is accounted to, see memusage
+typedef enum {
+	MEMCLASS_OTHER,
+	MEMCLASS_RENDERER,
+	MEMCLASS_CM,
+	MEMCLASS_BOTLIB,
+	MEMCLASS_VM,
+	MEMCLASS_SOUND,
+	MEMCLASS_TEMP,		// Hunk_AllocateTempMemory
+
+	MEMCLASS_COUNT
+} memClass_t;
+
+memClass_t Com_SetMemClass( memClass_t memClass );	// returns the previous class
+
 /*
 
 --- low memory ----
@@ -966,6 +1059,7 @@ void Hunk_ClearTempMemory( void );
 void *Hunk_AllocateTempMemory( int size );
 void Hunk_FreeTempMemory( void *buf );
 int	Hunk_MemoryRemaining( void );
+void	Com_MemoryUsage( int *hunkUsed, int *hunkTotal, int *zoneUsed, int *zoneTotal );
 void Hunk_Log( void);
 
 void Com_TouchMemory( void );
@@ -974,6 +1068,49 @@ void Com_TouchMemory( void );
 void Com_Init( char *commandLine );
 void Com_Frame( void );
 void Com_Shutdown( void );
+void Com_ForkLogfile( const char *suffix );
+
+//
+// worker.c
+//
+// Jobs run on worker threads and must not call Com_Error or touch
+// anything that isn't owned by their index.
+typedef void (*workerFunc_t)( void *data, int index );
+typedef void (*rangeFunc_t)( void *data, int start, int end );
+
+// a queued job group, 0 is a group that is already done
+typedef int jobGroup_t;
+
+#define MAX_JOB_DEPENDS		4
+
+#ifdef _MSC_VER
+#define Q_THREADLOCAL	__declspec( thread )
+#else
+#define Q_THREADLOCAL	__thread
+#endif
+
+void Com_InitWorkers( void );
+void Com_ShutdownWorkers( void );
+int Com_NumWorkers( void );
+int Com_WorkerIndex( void );
+void Com_RunParallel( workerFunc_t func, void *data, int count );
+void Com_ParallelRange( const char *name, rangeFunc_t func, void *data, int count, int minBatch );
+jobGroup_t Com_AddJobs( const char *name, workerFunc_t func, void *data, int count, const jobGroup_t *depends, int numDepends );
+qboolean Com_JobsDone( jobGroup_t group );
+void Com_WaitJobs( jobGroup_t group );
+int Com_JobsFrame( qboolean print );
+
+//
+// scratch.c
+//
+// Per thread memory for the main thread and the workers, given back at
+// the end of the frame or the job, or when an earlier mark is released.
+void *Com_ScratchAlloc( int size );
+int Com_ScratchMark( void );
+void Com_ScratchRelease( int mark );
+void Com_ScratchFrame( void );
+void Com_ScratchInfo( qboolean reset );
+void Com_ShutdownScratch( void );
 
 
 /*
@@ -1061,8 +1198,14 @@ void SV_Shutdown( char *finalmsg );
 void SV_Frame( int msec );
 void SV_PacketEvent( netadr_t from, msg_t *msg );
 int SV_FrameMsec(void);
+int SV_TickMsec(void);
+qboolean SV_Idle(void);
+int SV_IdleMsec(void);
 qboolean SV_GameCommand( void );
 int SV_SendQueuedPackets(void);
+void SV_CaptureConsole( const char *text );
+qboolean SV_Replaying( void );
+int SV_ReplayEvents( void );
 
 //
 // UI interface
@@ -1084,6 +1227,7 @@ void IN_Init( void *windowData );
 void IN_Frame( void );
 void IN_Shutdown( void );
 void IN_Restart( void );
+qboolean IN_SampleMouse( void );
 
 /*
 ==============================================================
@@ -1112,9 +1256,18 @@ char	*Sys_GetClipboardData( void );	// note that this isn't journaled...
 
 void	Sys_Print( const char *msg );
 
+// Com_Printf from other threads, printed by the main thread
+qboolean	Sys_QueuePrint( const char *msg, qboolean devPrint );
+qboolean	Sys_NextQueuedPrint( char *out, int outSize, qboolean *devPrint );
+int			Sys_QueuedPrintsDropped( void );
+
 // Sys_Milliseconds should only be used for profiling purposes,
-// any game related timing information should come from event timestamps
+// any game related timing information should come from event timestamps.
+// It is the Sys_Microseconds clock, from the first call
 int		Sys_Milliseconds (void);
+// monotonic time in microseconds from an arbitrary origin, for profiling,
+// pacing and round trips
+int64_t	Sys_Microseconds (void);
 
 qboolean Sys_RandomBytes( byte *string, int len );
 
@@ -1126,16 +1279,38 @@ cpuFeatures_t Sys_GetProcessorFeatures( void );
 void	Sys_SetErrorText( const char *text );
 
 void	Sys_SendPacket( int length, const void *data, netadr_t to );
+qboolean	Sys_SendProbePacket( int length, const void *data, netadr_t to );
+void	Sys_BeginPacketBatch( void );
+void	Sys_FlushPacketBatch( void );
 
 qboolean	Sys_StringToAdr( const char *s, netadr_t *a, netadrtype_t family );
+qboolean	Sys_ResolveAdr( const char *s, netadr_t *a, netadrtype_t family, char *error, int errorSize );
 //Does NOT parse port numbers, only base addresses.
 
 qboolean	Sys_IsLANAddress (netadr_t adr);
 void		Sys_ShowIP(void);
 
 FILE	*Sys_FOpen( const char *ospath, const char *mode );
+FILE	*Sys_FCreate( const char *ospath );
+FILE	*Sys_FOpenPrivate( const char *ospath );
 qboolean Sys_Mkdir( const char *path );
 FILE	*Sys_Mkfifo( const char *ospath );
+FILE	*Sys_OpenPipe( const char *command );
+int		Sys_ClosePipe( FILE *pipe );
+qboolean Sys_StatFile( const char *ospath, int64_t *size, int64_t *mtime );
+void	*Sys_MapFile( const char *ospath, int *length );
+void	Sys_UnmapFile( void *data, int length );
+void	*Sys_ReserveMemory( void *base, size_t size );
+qboolean Sys_MapFileAt( const char *ospath, void *base, int length );
+void	Sys_ReleaseMemory( void *base, size_t size );
+
+// changes to the names in a directory, NULL where they can't be watched
+typedef struct sysDirWatch_s	sysDirWatch_t;
+
+sysDirWatch_t	*Sys_WatchDirectory( const char *path, const char *filter );
+qboolean		Sys_DirectoryChanged( sysDirWatch_t *watch );
+void			Sys_UnwatchDirectory( sysDirWatch_t *watch );
+
 char	*Sys_Cwd( void );
 void	Sys_SetDefaultInstallPath(const char *path);
 char	*Sys_DefaultInstallPath(void);
@@ -1183,6 +1358,44 @@ dialogResult_t Sys_Dialog( dialogType_t type, const char *message, const char *t
 void Sys_RemovePIDFile( const char *gamedir );
 void Sys_InitPIDFile( const char *gamedir );
 
+// -1 where there is no fork(), see SV_Zygote_f
+int Sys_Fork( void );
+qboolean Sys_ChildExited( int pid );
+
+// threads, used by the worker pool in worker.c and the threaded sound mixer
+typedef struct sysThread_s		sysThread_t;
+typedef struct sysMutex_s		sysMutex_t;
+typedef struct sysSemaphore_s	sysSemaphore_t;
+
+int				Sys_ProcessorCount( void );
+
+// thread placement, priority and memory locking for servers
+void			Sys_SetPlacement( const int *cpus, int numCpus, int nice, int realtime, qboolean numa );
+void			Sys_PinThread( int index );
+void			Sys_LockMemory( void *base, size_t size );
+sysThread_t		*Sys_CreateThread( void (*func)( void *arg ), void *arg );
+void			Sys_JoinThread( sysThread_t *thread );
+sysMutex_t		*Sys_CreateMutex( void );
+void			Sys_DestroyMutex( sysMutex_t *mutex );
+void			Sys_LockMutex( sysMutex_t *mutex );
+void			Sys_UnlockMutex( sysMutex_t *mutex );
+sysSemaphore_t	*Sys_CreateSemaphore( void );
+void			Sys_DestroySemaphore( sysSemaphore_t *sem );
+void			Sys_PostSemaphore( sysSemaphore_t *sem );
+void			Sys_WaitSemaphore( sysSemaphore_t *sem );
+void			Sys_MemoryBarrier( void );
+int				Sys_AtomicAdd( volatile int *value, int add );
+qboolean		Sys_AtomicCompareExchange( volatile int *value, int compare, int exchange );
+
+// sampling profiler support, for vmsample
+qboolean		Sys_StartProfileTimer( int hz, void (*handler)( void *ip, void *sp, void *fp ) );
+void			Sys_StopProfileTimer( void );
+qboolean		Sys_AddressToSymbol( const void *address, const void *moduleAddress, char *name, int size );
+
+// the handler returns where to resume after a memory fault, or NULL to
+// let it through to the one there was before
+qboolean		Sys_SetFaultHandler( void *(*handler)( void *address, void *ip ) );
+
 /* This is based on the Adaptive Huffman algorithm described in Sayood's Data
  * Compression book.  The ranks are not actually stored, but implicitly defined
  * by the location of a node within a doubly-linked list */
@@ -1219,6 +1432,17 @@ typedef struct {
 	huff_t		decompressor;
 } huffman_t;
 
+// precomputed codes for a tree that is no longer adapted, see Huff_BuildTable
+#define HUFF_LOOKUP_BITS	11
+
+typedef struct {
+	qboolean		valid;
+	unsigned int	code[HMAX];		// first bit to send in bit 0
+	byte			length[HMAX];
+	unsigned short	lookup[1 << HUFF_LOOKUP_BITS];	// symbol | (length << 9), 0 if the code is longer
+	node_t			*tree;			// for codes longer than HUFF_LOOKUP_BITS
+} huffTable_t;
+
 void	Huff_Compress(msg_t *buf, int offset);
 void	Huff_Decompress(msg_t *buf, int offset);
 void	Huff_Init(huffman_t *huff);
@@ -1227,6 +1451,9 @@ int		Huff_Receive (node_t *node, int *ch, byte *fin);
 void	Huff_transmit (huff_t *huff, int ch, byte *fout, int maxoffset);
 void	Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxoffset);
 void	Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset, int maxoffset);
+void	Huff_BuildTable( huffTable_t *table, huff_t *compressor, huff_t *decompressor );
+void	Huff_tableTransmit( const huffTable_t *table, int ch, byte *fout, int *offset, int maxoffset );
+void	Huff_tableReceive( const huffTable_t *table, int *ch, byte *fin, int *offset, int maxoffset );
 void	Huff_putBit( int bit, byte *fout, int *offset);
 int		Huff_getBit( byte *fout, int *offset);
 
@@ -0,0 +1,259 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// scratch.c -- per thread scratch memory for the temporaries of a frame
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+/*
+The temporaries of a frame were arrays on the stack, a MAX_MSGLEN buffer
+for every message built, or temp hunk memory, which has to be freed in
+the reverse order it was taken and belongs to the main thread. Instead
+Com_ScratchAlloc moves a pointer along a block of the calling thread.
+Nothing is freed one by one: the main thread's block starts over at the
+end of Com_Frame and whatever a job took goes when it returns. Code that
+runs many times a frame brackets its allocations with Com_ScratchMark and
+Com_ScratchRelease.
+
+When the block runs out the rest is malloced and freed with it. Once a
+block is empty again it grows to the high water mark it reached, so the
+overflows don't come back next frame. memusage lists the blocks.
+
+Only the main thread and the workers have blocks, they are found by
+Com_WorkerIndex, so no other thread may use them.
+*/
+
+#define	MAX_SCRATCH_THREADS	64					// more than the workers, see Com_WorkerIndex
+#define	SCRATCH_MIN_BLOCK	( 64 * 1024 )
+#define	SCRATCH_MAX_BLOCK	( 16 * 1024 * 1024 )	// beyond that they stay overflows
+#define	SCRATCH_ALIGN		16
+
+typedef struct scratchOverflow_s {
+	int							mark;			// where it starts in the arena
+	int							size;
+	struct scratchOverflow_s	*next;
+} scratchOverflow_t;
+
+#define	SCRATCH_OVERFLOW_HEADER	PAD( sizeof( scratchOverflow_t ), SCRATCH_ALIGN )
+
+typedef struct {
+	byte				*block;
+	int					size;
+	int					used;			// of the block
+	int					overflowBytes;
+	scratchOverflow_t	*overflows;		// newest first
+
+	int					highwater;		// since the arena was last empty
+	int					peak;			// since startup or memusage reset
+	int					overflowed;		// allocations that didn't fit, since then too
+} scratchArena_t;
+
+static scratchArena_t	scratchArenas[MAX_SCRATCH_THREADS];
+
+/*
+=================
+Com_ScratchArena
+=================
+*/
+static scratchArena_t *Com_ScratchArena( void ) {
+	return &scratchArenas[Com_WorkerIndex()];
+}
+
+/*
+=================
+Com_ScratchEmptied
+
+Makes room for the high water mark
+=================
+*/
+static void Com_ScratchEmptied( scratchArena_t *arena ) {
+	int		size;
+
+	size = PAD( arena->highwater, SCRATCH_MIN_BLOCK );
+	arena->highwater = 0;
+
+	if ( size <= arena->size || size > SCRATCH_MAX_BLOCK ) {
+		return;
+	}
+
+	free( arena->block );
+	arena->block = malloc( size );
+	arena->size = arena->block ? size : 0;
+}
+
+/*
+=================
+Com_ScratchAlloc
+
+Returns size bytes that stay until the frame ends, the job returns or an
+earlier mark is released. They are 16 byte aligned but not cleared. A job
+gets NULL if even malloc fails, the main thread drops the game.
+=================
+*/
+void *Com_ScratchAlloc( int size ) {
+	scratchArena_t		*arena = Com_ScratchArena();
+	scratchOverflow_t	*overflow;
+	void				*data;
+
+	size = PAD( size, SCRATCH_ALIGN );
+
+	if ( !arena->block ) {
+		arena->block = malloc( SCRATCH_MIN_BLOCK );
+		arena->size = arena->block ? SCRATCH_MIN_BLOCK : 0;
+	}
+
+	if ( size >= 0 && arena->used + size <= arena->size ) {
+		data = arena->block + arena->used;
+		arena->used += size;
+	} else {
+		overflow = ( size >= 0 ) ? malloc( SCRATCH_OVERFLOW_HEADER + size ) : NULL;
+		if ( !overflow ) {
+			if ( Com_WorkerIndex() ) {
+				return NULL;
+			}
+			Com_Error( ERR_FATAL, "Com_ScratchAlloc: failed on %i bytes", size );
+		}
+
+		overflow->mark = arena->used + arena->overflowBytes;
+		overflow->size = size;
+		overflow->next = arena->overflows;
+		arena->overflows = overflow;
+		arena->overflowBytes += size;
+		arena->overflowed++;
+
+		data = (byte *)overflow + SCRATCH_OVERFLOW_HEADER;
+	}
+
+	if ( arena->used + arena->overflowBytes > arena->highwater ) {
+		arena->highwater = arena->used + arena->overflowBytes;
+		if ( arena->highwater > arena->peak ) {
+			arena->peak = arena->highwater;
+		}
+	}
+
+	return data;
+}
+
+/*
+=================
+Com_ScratchMark
+=================
+*/
+int Com_ScratchMark( void ) {
+	scratchArena_t	*arena = Com_ScratchArena();
+
+	return arena->used + arena->overflowBytes;
+}
+
+/*
+=================
+Com_ScratchRelease
+
+Gives back everything taken since the mark
+=================
+*/
+void Com_ScratchRelease( int mark ) {
+	scratchArena_t		*arena = Com_ScratchArena();
+	scratchOverflow_t	*overflow;
+
+	while ( arena->overflows && arena->overflows->mark >= mark ) {
+		overflow = arena->overflows;
+		arena->overflows = overflow->next;
+		arena->overflowBytes -= overflow->size;
+		free( overflow );
+	}
+
+	if ( mark - arena->overflowBytes < arena->used ) {
+		arena->used = mark - arena->overflowBytes;
+	}
+
+	if ( !mark ) {
+		Com_ScratchEmptied( arena );
+	}
+}
+
+/*
+=================
+Com_ScratchFrame
+
+Empties the main thread's block at the end of Com_Frame
+=================
+*/
+void Com_ScratchFrame( void ) {
+	Com_ScratchRelease( 0 );
+}
+
+/*
+=================
+Com_ScratchInfo
+
+Lists the blocks for memusage, reset starts the peaks over
+=================
+*/
+void Com_ScratchInfo( qboolean reset ) {
+	scratchArena_t	*arena;
+	int				i;
+
+	if ( !reset ) {
+		Com_Printf( "\n" );
+		Com_Printf( "scratch      block        peak   overflowed\n" );
+	}
+
+	for ( i = 0, arena = scratchArenas ; i < MAX_SCRATCH_THREADS ; i++, arena++ ) {
+		if ( !arena->block && !arena->peak ) {
+			continue;
+		}
+
+		if ( reset ) {
+			arena->peak = arena->used + arena->overflowBytes;
+			arena->overflowed = 0;
+			continue;
+		}
+
+		Com_Printf( "%-8s %8i    %8i   %10i\n", i ? va( "worker%i", i ) : "main",
+			arena->size, arena->peak, arena->overflowed );
+	}
+}
+
+/*
+=================
+Com_ShutdownScratch
+
+After the workers are gone
+=================
+*/
+void Com_ShutdownScratch( void ) {
+	scratchArena_t	*arena;
+	int				i;
+
+	for ( i = 0, arena = scratchArenas ; i < MAX_SCRATCH_THREADS ; i++, arena++ ) {
+		while ( arena->overflows ) {
+			scratchOverflow_t	*overflow = arena->overflows;
+
+			arena->overflows = overflow->next;
+			free( overflow );
+		}
+		free( arena->block );
+	}
+
+	Com_Memset( scratchArenas, 0, sizeof( scratchArenas ) );
+}
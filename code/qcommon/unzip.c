@@ -1273,6 +1273,30 @@ extern int ZEXPORT unzReadCurrentFile  (file, buf, len)
 
     while (pfile_in_zip_read_info->stream.avail_out>0)
     {
+        if ((pfile_in_zip_read_info->stream.avail_in==0) &&
+            (pfile_in_zip_read_info->rest_read_compressed>0) &&
+            (pfile_in_zip_read_info->z_filefunc.zmap_file!=NULL) &&
+            (!s->encrypted))
+        {
+            /* the zip file is in memory, take all of the data from there */
+            const void* mapped = ZMAP(pfile_in_zip_read_info->z_filefunc,
+                      pfile_in_zip_read_info->filestream,
+                      pfile_in_zip_read_info->pos_in_zipfile +
+                         pfile_in_zip_read_info->byte_before_the_zipfile,
+                      pfile_in_zip_read_info->rest_read_compressed);
+            if (mapped==NULL)
+                return UNZ_ERRNO;
+
+            pfile_in_zip_read_info->pos_in_zipfile +=
+                pfile_in_zip_read_info->rest_read_compressed;
+
+            pfile_in_zip_read_info->stream.next_in = (Bytef*)mapped;
+            pfile_in_zip_read_info->stream.avail_in =
+                (uInt)pfile_in_zip_read_info->rest_read_compressed;
+
+            pfile_in_zip_read_info->rest_read_compressed = 0;
+        }
+
         if ((pfile_in_zip_read_info->stream.avail_in==0) &&
             (pfile_in_zip_read_info->rest_read_compressed>0))
         {
@@ -1317,7 +1341,7 @@ extern int ZEXPORT unzReadCurrentFile  (file, buf, len)
 
         if ((pfile_in_zip_read_info->compression_method==0) || (pfile_in_zip_read_info->raw))
         {
-            uInt uDoCopy,i ;
+            uInt uDoCopy ;
 
             if ((pfile_in_zip_read_info->stream.avail_in == 0) &&
                 (pfile_in_zip_read_info->rest_read_compressed == 0))
@@ -1329,9 +1353,8 @@ extern int ZEXPORT unzReadCurrentFile  (file, buf, len)
             else
                 uDoCopy = pfile_in_zip_read_info->stream.avail_in ;
 
-            for (i=0;i<uDoCopy;i++)
-                *(pfile_in_zip_read_info->stream.next_out+i) =
-                        *(pfile_in_zip_read_info->stream.next_in+i);
+            memcpy(pfile_in_zip_read_info->stream.next_out,
+                   pfile_in_zip_read_info->stream.next_in, uDoCopy);
 
             pfile_in_zip_read_info->crc32 = crc32(pfile_in_zip_read_info->crc32,
                                 pfile_in_zip_read_info->stream.next_out,
@@ -1606,3 +1629,91 @@ extern int ZEXPORT unzSetOffset (file, pos)
     s->current_file_ok = (err == UNZ_OK);
     return err;
 }
+
+/* Whole entry access, the compressed data of the current file in one go */
+extern int ZEXPORT unzGetCurrentFileData (file, method, compressed_size,
+                                          uncompressed_size)
+    unzFile file;
+    int* method;
+    uLong* compressed_size;
+    uLong* uncompressed_size;
+{
+    unz_s* s;
+    file_in_zip_read_info_s* pfile_in_zip_read_info;
+
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+
+    if (pfile_in_zip_read_info==NULL)
+        return UNZ_PARAMERROR;
+
+    /* only from the start of the file, and not for encrypted ones */
+    if ((pfile_in_zip_read_info->rest_read_compressed !=
+            s->cur_file_info.compressed_size) ||
+        (pfile_in_zip_read_info->stream.total_out != 0) ||
+        (s->encrypted))
+        return UNZ_PARAMERROR;
+
+    if (method!=NULL)
+        *method = (int)pfile_in_zip_read_info->compression_method;
+    if (compressed_size!=NULL)
+        *compressed_size = s->cur_file_info.compressed_size;
+    if (uncompressed_size!=NULL)
+        *uncompressed_size = s->cur_file_info.uncompressed_size;
+
+    return UNZ_OK;
+}
+
+extern const void* ZEXPORT unzMapCurrentFile (file)
+    unzFile file;
+{
+    unz_s* s;
+    file_in_zip_read_info_s* pfile_in_zip_read_info;
+
+    if (unzGetCurrentFileData(file, NULL, NULL, NULL) != UNZ_OK)
+        return NULL;
+    s=(unz_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+
+    if (pfile_in_zip_read_info->z_filefunc.zmap_file==NULL)
+        return NULL;
+
+    return ZMAP(pfile_in_zip_read_info->z_filefunc,
+                pfile_in_zip_read_info->filestream,
+                pfile_in_zip_read_info->pos_in_zipfile +
+                   pfile_in_zip_read_info->byte_before_the_zipfile,
+                pfile_in_zip_read_info->rest_read_compressed);
+}
+
+extern int ZEXPORT unzReadCurrentFileRaw (file, buf, len)
+    unzFile file;
+    voidp buf;
+    uLong len;
+{
+    unz_s* s;
+    file_in_zip_read_info_s* pfile_in_zip_read_info;
+
+    if (unzGetCurrentFileData(file, NULL, NULL, NULL) != UNZ_OK)
+        return UNZ_PARAMERROR;
+    s=(unz_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+
+    if (len != pfile_in_zip_read_info->rest_read_compressed)
+        return UNZ_PARAMERROR;
+
+    if (ZSEEK(pfile_in_zip_read_info->z_filefunc,
+              pfile_in_zip_read_info->filestream,
+              pfile_in_zip_read_info->pos_in_zipfile +
+                 pfile_in_zip_read_info->byte_before_the_zipfile,
+              ZLIB_FILEFUNC_SEEK_SET)!=0)
+        return UNZ_ERRNO;
+
+    if (ZREAD(pfile_in_zip_read_info->z_filefunc,
+              pfile_in_zip_read_info->filestream,
+              buf,len)!=len)
+        return UNZ_ERRNO;
+
+    return UNZ_OK;
+}
@@ -346,6 +346,33 @@ extern uLong ZEXPORT unzGetOffset (unzFile file);
 /* Set the current file offset */
 extern int ZEXPORT unzSetOffset (unzFile file, uLong pos);
 
+/***************************************************************************/
+/* Whole entry access, for a file just opened with unzOpenCurrentFile and
+   not read from yet */
+
+extern int ZEXPORT unzGetCurrentFileData OF((unzFile file,
+                                             int* method,
+                                             uLong* compressed_size,
+                                             uLong* uncompressed_size));
+/*
+  Give the compression method (0 stored, Z_DEFLATED) and both sizes of the
+  current file
+*/
+
+extern const void* ZEXPORT unzMapCurrentFile OF((unzFile file));
+/*
+  Return a pointer to all of the compressed data of the current file when
+  the zipfile is in memory, NULL if not
+*/
+
+extern int ZEXPORT unzReadCurrentFileRaw OF((unzFile file,
+                                             voidp buf,
+                                             uLong len));
+/*
+  Read all of the compressed data of the current file, len must be its
+  compressed size
+*/
+
 
 
 #ifdef __cplusplus
@@ -75,8 +75,11 @@ void VM_Init( void ) {
 	Cvar_Get( "vm_ui", "2", CVAR_ARCHIVE );			// !@# SHIP WITH SET TO 2
 #endif
 	Cvar_Get( "vm_game", "2", CVAR_ARCHIVE );		// !@# SHIP WITH SET TO 2
+	Cvar_Get( "vm_jitCache", "0", CVAR_ARCHIVE );	// reuse compiled code from the private cache
+	Cvar_Get( "vm_guardData", "0", CVAR_ARCHIVE );	// guard pages instead of masking in compiled code
 
 	Cmd_AddCommand ("vmprofile", VM_VmProfile_f );
+	Cmd_AddCommand ("vmsample", VM_Sample_f );
 	Cmd_AddCommand ("vminfo", VM_VmInfo_f );
 
 	Com_Memset( vmTable, 0, sizeof( vmTable ) );
@@ -159,10 +162,7 @@ int VM_SymbolToValue( vm_t *vm, const char *symbol ) {
 VM_SymbolForCompiledPointer
 =====================
 */
-#if 0 // 64bit!
 const char *VM_SymbolForCompiledPointer( vm_t *vm, void *code ) {
-	int			i;
-
 	if ( code < (void *)vm->codeBase ) {
 		return "Before code block";
 	}
@@ -170,18 +170,34 @@ const char *VM_SymbolForCompiledPointer( vm_t *vm, void *code ) {
 		return "After code block";
 	}
 
+	// now look up the bytecode instruction pointer
+	return VM_ValueToSymbol( vm, VM_CompiledInstruction( vm, code ) );
+}
+
+/*
+=====================
+VM_CompiledInstruction
+
+The instruction whose compiled code the address is in
+=====================
+*/
+int VM_CompiledInstruction( vm_t *vm, const void *code ) {
+	int			low, high, mid;
+
 	// find which original instruction it is after
-	for ( i = 0 ; i < vm->codeLength ; i++ ) {
-		if ( (void *)vm->instructionPointers[i] > code ) {
-			break;
+	low = 0;
+	high = vm->instructionCount - 1;
+	while ( low < high ) {
+		mid = ( low + high + 1 ) / 2;
+		if ( (const void *)vm->instructionPointers[mid] <= code ) {
+			low = mid;
+		} else {
+			high = mid - 1;
 		}
 	}
-	i--;
 
-	// now look up the bytecode instruction pointer
-	return VM_ValueToSymbol( vm, i );
+	return low;
 }
-#endif
 
 
 
@@ -283,8 +299,9 @@ void VM_LoadSymbols( vm_t *vm ) {
 		prev = &sym->next;
 		sym->next = NULL;
 
-		// convert value from an instruction number to a code offset
-		if ( value >= 0 && value < numInstructions ) {
+		// convert value from an instruction number to a code offset,
+		// compiled code is looked up by instruction number
+		if ( !vm->compiled && value >= 0 && value < numInstructions ) {
 			value = vm->instructionPointers[value];
 		}
 
@@ -334,27 +351,127 @@ Dlls will call this directly
 
   For speed, we just grab 15 arguments, and don't worry about exactly
    how many the syscall actually needs; the extra is thrown away.
+   Syscalls in the VM's direct table only get as many as they take.
  
 ============
 */
 intptr_t QDECL VM_DllSyscall( intptr_t arg, ... ) {
+  vm_t *vm = currentVM;
+  const vmSyscall_t *syscall = NULL;
+  int savedSyscall;
+  void *savedReturn;
+  intptr_t r;
+
+  if ( arg >= 0 && arg < vm->numSyscalls && vm->syscalls[arg].func ) {
+    syscall = &vm->syscalls[arg];
+  }
+
+  // for vmsample, which can't unwind the module from engine code
+  savedSyscall = vm->currentSyscall;
+  savedReturn = vm->syscallReturn;
+#ifdef __GNUC__
+  vm->syscallReturn = __builtin_return_address( 0 );
+#endif
+  vm->currentSyscall = arg + 1;
+
 #if !id386 || defined __clang__
+  {
   // rcg010206 - see commentary above
   intptr_t args[MAX_VMSYSCALL_ARGS];
-  int i;
+  int i, count;
   va_list ap;
   
   args[0] = arg;
+  count = syscall ? syscall->numArgs + 1 : ARRAY_LEN (args);
   
   va_start(ap, arg);
-  for (i = 1; i < ARRAY_LEN (args); i++)
+  for (i = 1; i < count; i++)
     args[i] = va_arg(ap, intptr_t);
   va_end(ap);
   
-  return currentVM->systemCall( args );
+  if ( syscall ) {
+    r = syscall->func( args );
+  } else {
+    r = vm->systemCall( args );
+  }
+  }
 #else // original id code
-	return currentVM->systemCall( &arg );
+	if ( syscall ) {
+		r = syscall->func( &arg );
+	} else {
+		r = vm->systemCall( &arg );
+	}
 #endif
+
+  vm->currentSyscall = savedSyscall;
+  vm->syscallReturn = savedReturn;
+  return r;
+}
+
+/*
+============
+VM_SystemCall
+
+For the interpreter and the compilers, args points at the syscall number
+in the VM's stack frame, followed by its 32 bit arguments
+============
+*/
+intptr_t VM_SystemCall( vm_t *vm, int *args ) {
+	const vmSyscall_t	*syscall = NULL;
+	intptr_t			argarr[MAX_VMSYSCALL_ARGS];
+	intptr_t			*parms;
+	intptr_t			r;
+	int					i, count, saved;
+
+	if ( args[0] >= 0 && args[0] < vm->numSyscalls && vm->syscalls[args[0]].func ) {
+		syscall = &vm->syscalls[args[0]];
+	}
+
+	// the vm has ints on the stack, we expect
+	// pointers so we might have to convert it
+	if ( sizeof( intptr_t ) == sizeof( int ) ) {
+		parms = (intptr_t *)args;
+	} else {
+		count = syscall ? syscall->numArgs + 1 : ARRAY_LEN( argarr );
+		for ( i = 0 ; i < count ; i++ ) {
+			argarr[i] = args[i];
+		}
+		parms = argarr;
+	}
+
+	saved = vm->currentSyscall;
+	vm->currentSyscall = args[0] + 1;
+
+	if ( syscall ) {
+		r = syscall->func( parms );
+	} else {
+		r = vm->systemCall( parms );
+	}
+
+	vm->currentSyscall = saved;
+	return r;
+}
+
+/*
+============
+VM_SetSyscalls
+============
+*/
+void VM_SetSyscalls( vm_t *vm, const vmSyscall_t *syscalls, int numSyscalls ) {
+	vm->syscalls = syscalls;
+	vm->numSyscalls = numSyscalls;
+}
+
+/*
+============
+VM_IsNative
+
+True for a module loaded as a shared library, which shares the address
+space of the engine
+============
+*/
+qboolean VM_IsNative( vm_t *vm ) {
+	return vm->dllHandle != NULL;
 }
 
 
@@ -455,8 +572,14 @@ vmHeader_t *VM_LoadQVM( vm_t *vm, qboolean alloc, qboolean unpure)
 		// allocate zero filled space for initialized and uninitialized data
 		// leave some space beyond data mask so we can secure all mask operations
 		vm->dataAlloc = dataLength + 4;
-		vm->dataBase = Hunk_Alloc(vm->dataAlloc, h_high);
 		vm->dataMask = dataLength - 1;
+#if idx64
+		// the compiler can leave out the masking then
+		if(vm->compiled && Cvar_VariableIntegerValue("vm_guardData"))
+			vm->dataBase = VM_AllocGuardedData(vm);
+		if(!vm->dataBase)
+#endif
+		vm->dataBase = Hunk_Alloc(vm->dataAlloc, h_high);
 	}
 	else
 	{
@@ -542,13 +665,20 @@ vm_t *VM_Restart(vm_t *vm, qboolean unpure)
 	if ( vm->dllHandle ) {
 		char	name[MAX_QPATH];
 		intptr_t	(*systemCall)( intptr_t *parms );
+		const vmSyscall_t	*syscalls;
+		int			numSyscalls;
 		
 		systemCall = vm->systemCall;	
+		syscalls = vm->syscalls;
+		numSyscalls = vm->numSyscalls;
 		Q_strncpyz( name, vm->name, sizeof( name ) );
 
 		VM_Free( vm );
 
 		vm = VM_Create( name, systemCall, VMI_NATIVE );
+		if ( vm ) {
+			VM_SetSyscalls( vm, syscalls, numSyscalls );
+		}
 		return vm;
 	}
 
@@ -569,13 +699,30 @@ vm_t *VM_Restart(vm_t *vm, qboolean unpure)
 
 /*
 ================
-VM_Create
+VM_Find
+================
+*/
+vm_t *VM_Find( const char *module ) {
+	int		i;
+
+	for ( i = 0 ; i < MAX_VM ; i++ ) {
+		if ( vmTable[i].name[0] && !Q_stricmp( vmTable[i].name, module ) ) {
+			return &vmTable[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+================
+VM_CreateModule
 
 If image ends in .qvm it will be interpreted, otherwise
 it will attempt to load as a system dll
 ================
 */
-vm_t *VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *), 
+static vm_t *VM_CreateModule( const char *module, intptr_t (*systemCalls)(intptr_t *), 
 				vmInterpret_t interpret ) {
 	vm_t		*vm;
 	vmHeader_t	*header;
@@ -633,6 +780,7 @@ vm_t *VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *),
 		else if(retval == VMI_COMPILED)
 		{
 			vm->searchPath = startSearch;
+			vm->compiled = (interpret != VMI_BYTECODE);
 			if((header = VM_LoadQVM(vm, qtrue, qfalse)))
 				break;
 
@@ -688,6 +836,25 @@ vm_t *VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *),
 	return vm;
 }
 
+/*
+================
+VM_Create
+
+Charges everything the module loads to the VM memory class
+================
+*/
+vm_t *VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *), 
+				vmInterpret_t interpret ) {
+	memClass_t	oldClass;
+	vm_t		*vm;
+
+	oldClass = Com_SetMemClass( MEMCLASS_VM );
+	vm = VM_CreateModule( module, systemCalls, interpret );
+	Com_SetMemClass( oldClass );
+
+	return vm;
+}
+
 /*
 ==============
 VM_Free
@@ -708,6 +875,9 @@ void VM_Free( vm_t *vm ) {
 		}
 	}
 
+	// pending samples still need the code
+	VM_SampleFree( vm );
+
 	if(vm->destroy)
 		vm->destroy(vm);
 
@@ -715,6 +885,11 @@ void VM_Free( vm_t *vm ) {
 		Sys_UnloadDll( vm->dllHandle );
 		Com_Memset( vm, 0, sizeof( *vm ) );
 	}
+#if idx64
+	if ( vm->dataGuarded ) {
+		VM_FreeGuardedData( vm );
+	}
+#endif
 #if 0	// now automatically freed by hunk
 	if ( vm->codeBase ) {
 		Z_Free( vm->codeBase );
@@ -824,6 +999,9 @@ intptr_t QDECL VM_Call( vm_t *vm, int callnum, ... )
 	}
 
 	++vm->callLevel;
+	if ( vm->callLevel == 1 ) {
+		vm->callStackTop = (byte *)&oldVM;
+	}
 	// if we have a dll loaded, call it directly
 	if ( vm->entryPoint ) {
 		//rcg010207 -  see dissertation at top of VM_DllSyscall() in this file.
@@ -0,0 +1,849 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+
+AArch64 VM, laid out like the ARMv7l one in vm_armv7l.c
+
+The opStack is kept in memory and grows up by 4, with rOPSTACK pointing
+at the top value. VM functions get an AAPCS64 frame record each, so the
+native stack can be walked through them.
+
+Docu:
+ARM Architecture Reference Manual for A-profile architecture, DDI0487
+*/
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <stddef.h>
+
+#include "vm_local.h"
+
+#define X0	0
+#define X1	1
+#define X2	2
+#define X16	16	// IP0, scratch for calls
+#define FP	29
+#define LR	30
+#define SP	31	// as a base register or for ADD/SUB immediate
+#define ZR	31	// everywhere else
+
+#define S0	0
+#define S1	1
+
+// callee saved, so they survive the calls into the engine
+#define rOPSTACK	19
+#define rDATABASE	20
+#define rPSTACK		21
+#define rDATAMASK	22
+#define rINSPOINTERS	23
+#define rINSCOUNT	24
+
+/* exit() won't be called but use it because it is marked with noreturn */
+#define DIE( reason, args... ) \
+	do { \
+		Com_Error(ERR_DROP, "vm_aarch64 compiler error: " reason, ##args); \
+		exit(1); \
+	} while(0)
+
+// conditions, invert one by flipping the lowest bit
+#define EQ	0x0
+#define NE	0x1
+#define HS	0x2
+#define LO	0x3
+#define MI	0x4
+#define PL	0x5
+#define HI	0x8
+#define LS	0x9
+#define GE	0xA
+#define LT	0xB
+#define GT	0xC
+#define LE	0xD
+
+// move wide
+#define MOVZw(dst, i, hw)	(0x52800000 | ((hw)<<21) | (((i)&0xFFFF)<<5) | (dst))
+#define MOVNw(dst, i, hw)	(0x12800000 | ((hw)<<21) | (((i)&0xFFFF)<<5) | (dst))
+#define MOVKw(dst, i, hw)	(0x72800000 | ((hw)<<21) | (((i)&0xFFFF)<<5) | (dst))
+#define MOVZx(dst, i, hw)	(0xD2800000 | ((hw)<<21) | (((i)&0xFFFF)<<5) | (dst))
+#define MOVKx(dst, i, hw)	(0xF2800000 | ((hw)<<21) | (((i)&0xFFFF)<<5) | (dst))
+
+// arithmetic with a 12 bit immediate
+#define ADDwi(dst, src, i)	(0x11000000 | ((i)<<10) | ((src)<<5) | (dst))
+#define SUBwi(dst, src, i)	(0x51000000 | ((i)<<10) | ((src)<<5) | (dst))
+#define ADDxi(dst, src, i)	(0x91000000 | ((i)<<10) | ((src)<<5) | (dst))
+#define SUBxi(dst, src, i)	(0xD1000000 | ((i)<<10) | ((src)<<5) | (dst))
+#define MOVx_SP(dst, src)	ADDxi(dst, src, 0)
+
+// arithmetic and logic on registers
+#define ADDw(dst, src, reg)	(0x0B000000 | ((reg)<<16) | ((src)<<5) | (dst))
+#define SUBw(dst, src, reg)	(0x4B000000 | ((reg)<<16) | ((src)<<5) | (dst))
+#define CMPw(src, reg)		(0x6B000000 | ((reg)<<16) | ((src)<<5) | ZR)
+#define NEGw(dst, reg)		SUBw(dst, ZR, reg)
+#define ANDw(dst, src, reg)	(0x0A000000 | ((reg)<<16) | ((src)<<5) | (dst))
+#define ORRw(dst, src, reg)	(0x2A000000 | ((reg)<<16) | ((src)<<5) | (dst))
+#define EORw(dst, src, reg)	(0x4A000000 | ((reg)<<16) | ((src)<<5) | (dst))
+#define MVNw(dst, reg)		(0x2A200000 | ((reg)<<16) | (ZR<<5) | (dst))
+#define MOVw(dst, reg)		ORRw(dst, ZR, reg)
+#define MOVx(dst, reg)		(0xAA000000 | ((reg)<<16) | (ZR<<5) | (dst))
+#define LSLVw(dst, src, reg)	(0x1AC02000 | ((reg)<<16) | ((src)<<5) | (dst))
+#define LSRVw(dst, src, reg)	(0x1AC02400 | ((reg)<<16) | ((src)<<5) | (dst))
+#define ASRVw(dst, src, reg)	(0x1AC02800 | ((reg)<<16) | ((src)<<5) | (dst))
+#define MULw(dst, src, reg)	(0x1B007C00 | ((reg)<<16) | ((src)<<5) | (dst))
+#define MSUBw(dst, src, reg, acc)	(0x1B008000 | ((reg)<<16) | ((acc)<<10) | ((src)<<5) | (dst))
+#define SDIVw(dst, src, reg)	(0x1AC00C00 | ((reg)<<16) | ((src)<<5) | (dst))
+#define UDIVw(dst, src, reg)	(0x1AC00800 | ((reg)<<16) | ((src)<<5) | (dst))
+
+// loads and stores, offsets in bytes
+#define LDRwi(dst, base, off)	(0xB9400000 | (((off)>>2)<<10) | ((base)<<5) | (dst))
+#define STRwi(src, base, off)	(0xB9000000 | (((off)>>2)<<10) | ((base)<<5) | (src))
+#define LDRxi(dst, base, off)	(0xF9400000 | (((off)>>3)<<10) | ((base)<<5) | (dst))
+#define STRxi(src, base, off)	(0xF9000000 | (((off)>>3)<<10) | ((base)<<5) | (src))
+#define LDRSBwi(dst, base, off)	(0x39C00000 | ((off)<<10) | ((base)<<5) | (dst))
+#define LDRSHwi(dst, base, off)	(0x79C00000 | (((off)>>1)<<10) | ((base)<<5) | (dst))
+#define STRwpre(src, base, off)	(0xB8000C00 | (((off)&0x1FF)<<12) | ((base)<<5) | (src))
+#define LDRwpost(dst, base, off)	(0xB8400400 | (((off)&0x1FF)<<12) | ((base)<<5) | (dst))
+
+// base + zero extended 32 bit index
+#define LDRw_uxtw(dst, base, reg)	(0xB8604800 | ((reg)<<16) | ((base)<<5) | (dst))
+#define STRw_uxtw(src, base, reg)	(0xB8204800 | ((reg)<<16) | ((base)<<5) | (src))
+#define LDRHw_uxtw(dst, base, reg)	(0x78604800 | ((reg)<<16) | ((base)<<5) | (dst))
+#define STRHw_uxtw(src, base, reg)	(0x78204800 | ((reg)<<16) | ((base)<<5) | (src))
+#define LDRBw_uxtw(dst, base, reg)	(0x38604800 | ((reg)<<16) | ((base)<<5) | (dst))
+#define STRBw_uxtw(src, base, reg)	(0x38204800 | ((reg)<<16) | ((base)<<5) | (src))
+#define LDRx_uxtw3(dst, base, reg)	(0xF8605800 | ((reg)<<16) | ((base)<<5) | (dst))
+
+// pairs, offsets in bytes
+#define LDPw(r1, r2, base, off)		(0x29400000 | ((((off)>>2)&0x7F)<<15) | ((r2)<<10) | ((base)<<5) | (r1))
+#define LDPwpre(r1, r2, base, off)	(0x29C00000 | ((((off)>>2)&0x7F)<<15) | ((r2)<<10) | ((base)<<5) | (r1))
+#define STPx(r1, r2, base, off)		(0xA9000000 | ((((off)>>3)&0x7F)<<15) | ((r2)<<10) | ((base)<<5) | (r1))
+#define LDPx(r1, r2, base, off)		(0xA9400000 | ((((off)>>3)&0x7F)<<15) | ((r2)<<10) | ((base)<<5) | (r1))
+#define STPxpre(r1, r2, base, off)	(0xA9800000 | ((((off)>>3)&0x7F)<<15) | ((r2)<<10) | ((base)<<5) | (r1))
+#define LDPxpost(r1, r2, base, off)	(0xA8C00000 | ((((off)>>3)&0x7F)<<15) | ((r2)<<10) | ((base)<<5) | (r1))
+
+// floating point, single precision
+#define LDRsi(dst, base, off)	(0xBD400000 | (((off)>>2)<<10) | ((base)<<5) | (dst))
+#define STRsi(src, base, off)	(0xBD000000 | (((off)>>2)<<10) | ((base)<<5) | (src))
+#define LDPs(r1, r2, base, off)		(0x2D400000 | ((((off)>>2)&0x7F)<<15) | ((r2)<<10) | ((base)<<5) | (r1))
+#define LDPspre(r1, r2, base, off)	(0x2DC00000 | ((((off)>>2)&0x7F)<<15) | ((r2)<<10) | ((base)<<5) | (r1))
+#define FADDs(dst, src, reg)	(0x1E202800 | ((reg)<<16) | ((src)<<5) | (dst))
+#define FSUBs(dst, src, reg)	(0x1E203800 | ((reg)<<16) | ((src)<<5) | (dst))
+#define FMULs(dst, src, reg)	(0x1E200800 | ((reg)<<16) | ((src)<<5) | (dst))
+#define FDIVs(dst, src, reg)	(0x1E201800 | ((reg)<<16) | ((src)<<5) | (dst))
+#define FNEGs(dst, src)		(0x1E214000 | ((src)<<5) | (dst))
+#define FCMPs(src, reg)		(0x1E202000 | ((reg)<<16) | ((src)<<5))
+#define SCVTFsw(dst, src)	(0x1E220000 | ((src)<<5) | (dst))
+#define FCVTZSws(dst, src)	(0x1E380000 | ((src)<<5) | (dst))
+
+// branches, offsets in bytes from the branch
+#define Bi(off)			(0x14000000 | (((off)>>2)&0x3FFFFFF))
+#define BLi(off)		(0x94000000 | (((off)>>2)&0x3FFFFFF))
+#define Bcond(c, off)		(0x54000000 | ((((off)>>2)&0x7FFFF)<<5) | (c))
+#define BR(reg)			(0xD61F0000 | ((reg)<<5))
+#define BLR(reg)		(0xD63F0000 | ((reg)<<5))
+#define RET			0xD65F03C0
+#define BRK(v)			(0xD4200000 | (((v)&0xFFFF)<<5))
+
+#define PUSH_FRAME	STPxpre(FP, LR, SP, -16)
+#define POP_FRAME	LDPxpost(FP, LR, SP, 16)
+
+// conditional branches reach 1MB, leave room for where in the
+// instruction the branch is
+#define COND_REACH	((1 << 20) - 64)
+
+/*
+ * opcode information table:
+ * - length of immediate value
+ */
+#define opImm0	0x0000 /* no immediate */
+#define opImm1	0x0001 /* 1 byte immadiate value after opcode */
+#define opImm4	0x0002 /* 4 bytes immediate value after opcode */
+
+static const unsigned char vm_opInfo[256] =
+{
+	[OP_ENTER]	= opImm4,
+	[OP_LEAVE]	= opImm4,
+	[OP_CONST]	= opImm4,
+	[OP_LOCAL]	= opImm4,
+
+	[OP_EQ]		= opImm4,
+	[OP_NE]		= opImm4,
+	[OP_LTI]	= opImm4,
+	[OP_LEI]	= opImm4,
+	[OP_GTI]	= opImm4,
+	[OP_GEI]	= opImm4,
+	[OP_LTU]	= opImm4,
+	[OP_LEU]	= opImm4,
+	[OP_GTU]	= opImm4,
+	[OP_GEU]	= opImm4,
+	[OP_EQF]	= opImm4,
+	[OP_NEF]	= opImm4,
+	[OP_LTF]	= opImm4,
+	[OP_LEF]	= opImm4,
+	[OP_GTF]	= opImm4,
+	[OP_GEF]	= opImm4,
+
+	[OP_ARG]	= opImm1,
+	[OP_BLOCK_COPY]	= opImm4,
+};
+
+static void VM_Destroy_Compiled(vm_t *vm)
+{
+	if (vm->codeBase) {
+		if (munmap(vm->codeBase, vm->codeLength))
+			Com_Printf(S_COLOR_RED "Memory unmap failed, possible memory leak\n");
+	}
+	vm->codeBase = NULL;
+}
+
+/*
+=================
+ErrJump
+Error handler for jump/call to invalid instruction number
+=================
+*/
+
+static void __attribute__((__noreturn__)) ErrJump(unsigned num)
+{
+	Com_Error(ERR_DROP, "program tried to execute code outside VM (%x)", num);
+}
+
+/*
+=================
+DoSyscall
+Called from the syscall stub with a negative instruction number, the stack
+is where the stub saved the return address into the function making it
+=================
+*/
+
+static int DoSyscall(int call, int pstack, void *stack)
+{
+	// save currentVM so as to allow for recursive VM entry
+	vm_t *savedVM = currentVM;
+	void *savedStack;
+	int *args;
+	int ret;
+
+	if (call >= 0)
+		ErrJump(call);
+
+	// modify VM stack pointer for recursive VM entry
+	currentVM->programStack = pstack - 4;
+
+	// for vmsample
+	savedStack = savedVM->syscallStack;
+	savedVM->syscallStack = stack;
+
+	args = (int *)(savedVM->dataBase + pstack + 4);
+	args[0] = -1 - call;
+	ret = VM_SystemCall(savedVM, args);
+
+	savedVM->syscallStack = savedStack;
+	currentVM = savedVM;
+
+	return ret;
+}
+
+static void _emit(vm_t *vm, unsigned isn, int pass)
+{
+	if (pass == 2)
+		memcpy(vm->codeBase+vm->codeLength, &isn, 4);
+	vm->codeLength+=4;
+}
+
+#define emit(isn) _emit(vm, isn, pass)
+
+// only the last pass has the final offsets
+#define rel(target) (pass == 2 ? _rel(vm, target, pc) : 0)
+
+static int _rel(vm_t *vm, int target, int pc)
+{
+	int x = target - vm->codeLength;
+
+	if (x < -(1 << 27) || x >= (1 << 27))
+		DIE("jump %d out of range at %d", x, pc);
+	return x;
+}
+
+static void emit_MOVwi(vm_t *vm, int pass, int reg, unsigned val)
+{
+	if (!(val & 0xFFFF0000))
+		emit(MOVZw(reg, val, 0));
+	else if (!(~val & 0xFFFF0000))
+		emit(MOVNw(reg, ~val, 0));
+	else if (!(val & 0xFFFF))
+		emit(MOVZw(reg, val >> 16, 1));
+	else
+	{
+		emit(MOVZw(reg, val, 0));
+		emit(MOVKw(reg, val >> 16, 1));
+	}
+}
+
+// always four instructions, the passes have to agree on the length
+static void emit_MOVxi(vm_t *vm, int pass, int reg, void *ptr)
+{
+	uint64_t val = (uintptr_t)ptr;
+
+	emit(MOVZx(reg, val, 0));
+	emit(MOVKx(reg, val >> 16, 1));
+	emit(MOVKx(reg, val >> 32, 2));
+	emit(MOVKx(reg, val >> 48, 3));
+}
+
+// dst = src + val, or src - val
+static void emit_ADDwi(vm_t *vm, int pass, int dst, int src, int val)
+{
+	if (val >= 0 && val < 4096)
+		emit(ADDwi(dst, src, val));
+	else if (val < 0 && val > -4096)
+		emit(SUBwi(dst, src, -val));
+	else
+	{
+		emit_MOVwi(vm, pass, X16, val);
+		emit(ADDw(dst, src, X16));
+	}
+}
+
+#define emit_MOVwi(reg, val) emit_MOVwi(vm, pass, reg, val)
+#define emit_MOVxi(reg, ptr) emit_MOVxi(vm, pass, reg, ptr)
+#define emit_ADDwi(dst, src, val) emit_ADDwi(vm, pass, dst, src, val)
+
+// check the instruction number in W0 and branch to it, clobbers X16
+#define BRANCH_INDIRECT(call) do { \
+	emit(CMPw(X0, rINSCOUNT)); \
+	emit(Bcond(LO, 8)); \
+	emit(BLi(rel(errJumpOfs))); \
+	emit(LDRx_uxtw3(X16, rINSPOINTERS, X0)); \
+	emit(call(X16)); \
+} while(0)
+
+// conditional jump to a fixed instruction, a long one when it may be too
+// far; a bad target is found in pass 0, before allocating anything
+#define JUMP_COND(c) do { \
+	if ((unsigned)arg.i >= (unsigned)header->instructionCount) \
+		Com_Error(ERR_DROP, "VM_CompileAArch64: jump target out of range at offset %d", pc); \
+	if (pass && abs(branchOfs[arg.i] - branchOfs[i_count]) < COND_REACH) \
+		emit(Bcond(c, rel(vm->instructionPointers[arg.i]))); \
+	else { \
+		emit(Bcond((c) ^ 1, 8)); \
+		emit(Bi(rel(vm->instructionPointers[arg.i]))); \
+	} \
+} while(0)
+
+#define IJ(c) do { \
+	emit(LDPw(X1, X0, rOPSTACK, -4));   /* w1 = opstack[-1]; w0 = *opstack */ \
+	emit(SUBxi(rOPSTACK, rOPSTACK, 8)); \
+	emit(CMPw(X1, X0)); \
+	JUMP_COND(c); \
+} while(0)
+
+// an unordered compare has only NE true, the same as C
+#define FJ(c) do { \
+	emit(LDPs(S1, S0, rOPSTACK, -4)); \
+	emit(SUBxi(rOPSTACK, rOPSTACK, 8)); \
+	emit(FCMPs(S1, S0)); \
+	JUMP_COND(c); \
+} while(0)
+
+// w0 = opstack[-1] op *opstack; opstack -= 4
+#define BINOP(isn) do { \
+	emit(LDPwpre(X1, X0, rOPSTACK, -4)); \
+	emit(isn); \
+	emit(STRwi(X0, rOPSTACK, 0)); \
+} while(0)
+
+#define FBINOP(isn) do { \
+	emit(LDPspre(S1, S0, rOPSTACK, -4)); \
+	emit(isn); \
+	emit(STRsi(S0, rOPSTACK, 0)); \
+} while(0)
+
+void VM_Compile(vm_t *vm, vmHeader_t *header)
+{
+	unsigned char *code;
+	int i_count, pc = 0;
+	int pass;
+	int *branchOfs = NULL;	// where the instructions were with only long branches
+	int syscallOfs = 0, errJumpOfs = 0, blockCopyOfs = 0, codeOfs = 0;
+
+	vm->compiled = qfalse;
+
+	vm->codeBase = NULL;
+	vm->codeLength = 0;
+
+	// pass 0 sizes the code with long conditional branches, pass 1 with
+	// the short ones that reach for sure, and pass 2 writes it
+	for (pass = 0; pass < 3; ++pass) {
+
+	if (pass == 1)
+	{
+		branchOfs = Z_Malloc(header->instructionCount * sizeof(*branchOfs));
+		for (i_count = 0; i_count < header->instructionCount; i_count++)
+			branchOfs[i_count] = vm->instructionPointers[i_count];
+	}
+	else if (pass == 2)
+	{
+		vm->codeBase = mmap(NULL, vm->codeLength, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if(vm->codeBase == MAP_FAILED)
+			Com_Error(ERR_FATAL, "VM_CompileAArch64: can't mmap memory");
+	}
+	vm->codeLength = 0;
+
+	//int *(*entry)(vm_t*, int*, int*);
+	emit(STPxpre(FP, LR, SP, -80));
+	emit(MOVx_SP(FP, SP));
+	emit(STPx(rOPSTACK, rDATABASE, SP, 16));
+	emit(STPx(rPSTACK, rDATAMASK, SP, 32));
+	emit(STPx(rINSPOINTERS, rINSCOUNT, SP, 48));
+	emit(STRxi(X1, SP, 64));
+	emit(LDRxi(rDATABASE, X0, offsetof(vm_t, dataBase)));
+	emit(LDRwi(rDATAMASK, X0, offsetof(vm_t, dataMask)));
+	emit(LDRxi(rINSPOINTERS, X0, offsetof(vm_t, instructionPointers)));
+	emit(LDRwi(rINSCOUNT, X0, offsetof(vm_t, instructionCount)));
+	emit(LDRwi(rPSTACK, X1, 0));
+	emit(MOVx(rOPSTACK, X2));
+
+	emit(BLi(rel(codeOfs)));
+
+	// write back the program stack and return the opstack
+	emit(LDRxi(X1, SP, 64));
+	emit(STRwi(rPSTACK, X1, 0));
+	emit(MOVx(X0, rOPSTACK));
+	emit(LDPx(rINSPOINTERS, rINSCOUNT, SP, 48));
+	emit(LDPx(rPSTACK, rDATAMASK, SP, 32));
+	emit(LDPx(rOPSTACK, rDATABASE, SP, 16));
+	emit(LDPxpost(FP, LR, SP, 80));
+	emit(RET);
+
+	// syscall, or call to a bad instruction number, in W0; the frame
+	// record holds the return address into the calling function
+	syscallOfs = vm->codeLength;
+	emit(PUSH_FRAME);
+	emit(MOVx_SP(FP, SP));
+	emit(MOVw(X1, rPSTACK));
+	emit(MOVx_SP(X2, SP));
+	emit_MOVxi(X16, DoSyscall);
+	emit(BLR(X16));
+	emit(STRwpre(X0, rOPSTACK, 4));      // opstack+=4; *opstack = w0
+	emit(POP_FRAME);
+	emit(RET);
+
+	errJumpOfs = vm->codeLength;
+	emit_MOVxi(X16, ErrJump);
+	emit(BR(X16));
+
+	blockCopyOfs = vm->codeLength;
+	emit_MOVxi(X16, VM_BlockCopy);
+	emit(BR(X16));
+
+	// vmsample takes the stubs before entryOfs for engine code
+	codeOfs = vm->codeLength;
+	vm->entryOfs = codeOfs;
+
+	code = (unsigned char *) header + header->codeOffset;
+	pc = 0;
+
+	for (i_count = 0; i_count < header->instructionCount; i_count++) {
+		union {
+			unsigned char b[4];
+			unsigned int i;
+		} arg;
+		unsigned char op = code[pc++];
+
+		vm->instructionPointers[i_count] = vm->codeLength;
+
+		if (vm_opInfo[op] & opImm4)
+		{
+			memcpy(arg.b, &code[pc], 4);
+			pc += 4;
+		}
+		else if (vm_opInfo[op] & opImm1)
+		{
+			arg.b[0] = code[pc];
+			++pc;
+		}
+
+		switch ( op )
+		{
+			case OP_UNDEF:
+			case OP_IGNORE:
+				break;
+
+			case OP_BREAK:
+				emit(BRK(0));
+				break;
+
+			case OP_ENTER:
+				emit(PUSH_FRAME);
+				emit(MOVx_SP(FP, SP));
+				emit_ADDwi(rPSTACK, rPSTACK, -(int)arg.i);  // pstack -= arg
+				break;
+
+			case OP_LEAVE:
+				emit_ADDwi(rPSTACK, rPSTACK, arg.i);        // pstack += arg
+				emit(POP_FRAME);
+				emit(RET);
+				break;
+
+			case OP_CALL:
+				// get instruction nr from stack
+				emit(LDRwpost(X0, rOPSTACK, -4));   // w0 = *opstack; opstack -= 4
+				emit(CMPw(X0, rINSCOUNT));
+				emit(Bcond(HS, 16));
+				emit(LDRx_uxtw3(X16, rINSPOINTERS, X0));
+				emit(BLR(X16));
+				emit(Bi(8));
+				// negative for syscalls, the stub leaves the result on the opstack
+				emit(BLi(rel(syscallOfs)));
+				break;
+
+			case OP_PUSH:
+				emit(ADDxi(rOPSTACK, rOPSTACK, 4));
+				break;
+
+			case OP_POP:
+				emit(SUBxi(rOPSTACK, rOPSTACK, 4));
+				break;
+
+			case OP_CONST:
+				emit_MOVwi(X0, arg.i);
+				emit(STRwpre(X0, rOPSTACK, 4));     // opstack+=4; *opstack = w0
+				break;
+
+			case OP_LOCAL:
+				emit_ADDwi(X0, rPSTACK, arg.i);     // w0 = pstack+arg
+				emit(STRwpre(X0, rOPSTACK, 4));     // opstack+=4; *opstack = w0
+				break;
+
+			case OP_JUMP:
+				emit(LDRwpost(X0, rOPSTACK, -4));   // w0 = *opstack; opstack -= 4
+				BRANCH_INDIRECT(BR);
+				break;
+
+			case OP_EQ:
+				IJ(EQ);
+				break;
+
+			case OP_NE:
+				IJ(NE);
+				break;
+
+			case OP_LTI:
+				IJ(LT);
+				break;
+
+			case OP_LEI:
+				IJ(LE);
+				break;
+
+			case OP_GTI:
+				IJ(GT);
+				break;
+
+			case OP_GEI:
+				IJ(GE);
+				break;
+
+			case OP_LTU:
+				IJ(LO);
+				break;
+
+			case OP_LEU:
+				IJ(LS);
+				break;
+
+			case OP_GTU:
+				IJ(HI);
+				break;
+
+			case OP_GEU:
+				IJ(HS);
+				break;
+
+			case OP_EQF:
+				FJ(EQ);
+				break;
+
+			case OP_NEF:
+				FJ(NE);
+				break;
+
+			case OP_LTF:
+				FJ(MI);
+				break;
+
+			case OP_LEF:
+				FJ(LS);
+				break;
+
+			case OP_GTF:
+				FJ(GT);
+				break;
+
+			case OP_GEF:
+				FJ(GE);
+				break;
+
+			case OP_LOAD1:
+				emit(LDRwi(X0, rOPSTACK, 0));       // w0 = *opstack
+				emit(ANDw(X0, X0, rDATAMASK));      // w0 = w0 & rDATAMASK
+				emit(LDRBw_uxtw(X0, rDATABASE, X0));  // w0 = (unsigned char)dataBase[w0]
+				emit(STRwi(X0, rOPSTACK, 0));       // *opstack = w0
+				break;
+
+			case OP_LOAD2:
+				emit(LDRwi(X0, rOPSTACK, 0));       // w0 = *opstack
+				emit(ANDw(X0, X0, rDATAMASK));      // w0 = w0 & rDATAMASK
+				emit(LDRHw_uxtw(X0, rDATABASE, X0));  // w0 = (unsigned short)dataBase[w0]
+				emit(STRwi(X0, rOPSTACK, 0));       // *opstack = w0
+				break;
+
+			case OP_LOAD4:
+				emit(LDRwi(X0, rOPSTACK, 0));       // w0 = *opstack
+				emit(ANDw(X0, X0, rDATAMASK));      // w0 = w0 & rDATAMASK
+				emit(LDRw_uxtw(X0, rDATABASE, X0));   // w0 = dataBase[w0]
+				emit(STRwi(X0, rOPSTACK, 0));       // *opstack = w0
+				break;
+
+			case OP_STORE1:
+				emit(LDPw(X1, X0, rOPSTACK, -4));   // w1 = pointer; w0 = value
+				emit(SUBxi(rOPSTACK, rOPSTACK, 8));
+				emit(ANDw(X1, X1, rDATAMASK));      // w1 = w1 & rDATAMASK
+				emit(STRBw_uxtw(X0, rDATABASE, X1));  // dataBase[w1] = w0
+				break;
+
+			case OP_STORE2:
+				emit(LDPw(X1, X0, rOPSTACK, -4));   // w1 = pointer; w0 = value
+				emit(SUBxi(rOPSTACK, rOPSTACK, 8));
+				emit(ANDw(X1, X1, rDATAMASK));      // w1 = w1 & rDATAMASK
+				emit(STRHw_uxtw(X0, rDATABASE, X1));  // dataBase[w1] = w0
+				break;
+
+			case OP_STORE4:
+				emit(LDPw(X1, X0, rOPSTACK, -4));   // w1 = pointer; w0 = value
+				emit(SUBxi(rOPSTACK, rOPSTACK, 8));
+				emit(ANDw(X1, X1, rDATAMASK));      // w1 = w1 & rDATAMASK
+				emit(STRw_uxtw(X0, rDATABASE, X1));   // dataBase[w1] = w0
+				break;
+
+			case OP_ARG:
+				emit(LDRwpost(X0, rOPSTACK, -4));   // w0 = *opstack; opstack -= 4
+				emit(ADDwi(X1, rPSTACK, arg.b[0])); // w1 = programStack+arg
+				emit(ANDw(X1, X1, rDATAMASK));      // w1 = w1 & rDATAMASK
+				emit(STRw_uxtw(X0, rDATABASE, X1));   // dataBase[w1] = w0
+				break;
+
+			case OP_BLOCK_COPY:
+				emit(LDPw(X0, X1, rOPSTACK, -4));   // w0 = dest; w1 = src
+				emit(SUBxi(rOPSTACK, rOPSTACK, 8));
+				emit_MOVwi(X2, arg.i);
+				emit(BLi(rel(blockCopyOfs)));
+				break;
+
+			case OP_SEX8:
+				emit(LDRSBwi(X0, rOPSTACK, 0));     // sign extend *opstack
+				emit(STRwi(X0, rOPSTACK, 0));       // *opstack = w0
+				break;
+
+			case OP_SEX16:
+				emit(LDRSHwi(X0, rOPSTACK, 0));     // sign extend *opstack
+				emit(STRwi(X0, rOPSTACK, 0));       // *opstack = w0
+				break;
+
+			case OP_NEGI:
+				emit(LDRwi(X0, rOPSTACK, 0));       // w0 = *opstack
+				emit(NEGw(X0, X0));                 // w0 = -w0
+				emit(STRwi(X0, rOPSTACK, 0));       // *opstack = w0
+				break;
+
+			case OP_ADD:
+				BINOP(ADDw(X0, X1, X0));            // w0 = w1 + w0
+				break;
+
+			case OP_SUB:
+				BINOP(SUBw(X0, X1, X0));            // w0 = w1 - w0
+				break;
+
+			// division by zero gives 0 instead of trapping
+			case OP_DIVI:
+				BINOP(SDIVw(X0, X1, X0));           // w0 = w1 / w0
+				break;
+
+			case OP_DIVU:
+				BINOP(UDIVw(X0, X1, X0));           // w0 = w1 / w0
+				break;
+
+			case OP_MODI:
+				emit(LDPwpre(X1, X0, rOPSTACK, -4));
+				emit(SDIVw(X2, X1, X0));            // w2 = w1 / w0
+				emit(MSUBw(X0, X2, X0, X1));        // w0 = w1 - w2 * w0
+				emit(STRwi(X0, rOPSTACK, 0));
+				break;
+
+			case OP_MODU:
+				emit(LDPwpre(X1, X0, rOPSTACK, -4));
+				emit(UDIVw(X2, X1, X0));            // w2 = w1 / w0
+				emit(MSUBw(X0, X2, X0, X1));        // w0 = w1 - w2 * w0
+				emit(STRwi(X0, rOPSTACK, 0));
+				break;
+
+			case OP_MULI:
+			case OP_MULU:
+				BINOP(MULw(X0, X1, X0));            // w0 = w1 * w0
+				break;
+
+			case OP_BAND:
+				BINOP(ANDw(X0, X1, X0));            // w0 = w1 & w0
+				break;
+
+			case OP_BOR:
+				BINOP(ORRw(X0, X1, X0));            // w0 = w1 | w0
+				break;
+
+			case OP_BXOR:
+				BINOP(EORw(X0, X1, X0));            // w0 = w1 ^ w0
+				break;
+
+			case OP_BCOM:
+				emit(LDRwi(X0, rOPSTACK, 0));       // w0 = *opstack
+				emit(MVNw(X0, X0));                 // w0 = ~w0
+				emit(STRwi(X0, rOPSTACK, 0));       // *opstack = w0
+				break;
+
+			// the shift counts are taken modulo 32, like on x86
+			case OP_LSH:
+				BINOP(LSLVw(X0, X1, X0));           // w0 = w1 << w0
+				break;
+
+			case OP_RSHI:
+				BINOP(ASRVw(X0, X1, X0));           // w0 = w1 >> w0
+				break;
+
+			case OP_RSHU:
+				BINOP(LSRVw(X0, X1, X0));           // w0 = (unsigned)w1 >> w0
+				break;
+
+			case OP_NEGF:
+				emit(LDRsi(S0, rOPSTACK, 0));       // s0 = *((float*)opstack)
+				emit(FNEGs(S0, S0));                // s0 = -s0
+				emit(STRsi(S0, rOPSTACK, 0));       // *((float*)opstack) = s0
+				break;
+
+			case OP_ADDF:
+				FBINOP(FADDs(S0, S1, S0));          // s0 = s1 + s0
+				break;
+
+			case OP_SUBF:
+				FBINOP(FSUBs(S0, S1, S0));          // s0 = s1 - s0
+				break;
+
+			case OP_DIVF:
+				FBINOP(FDIVs(S0, S1, S0));          // s0 = s1 / s0
+				break;
+
+			case OP_MULF:
+				FBINOP(FMULs(S0, S1, S0));          // s0 = s1 * s0
+				break;
+
+			case OP_CVIF:
+				emit(LDRwi(X0, rOPSTACK, 0));       // w0 = *opstack
+				emit(SCVTFsw(S0, X0));              // s0 = (float)w0
+				emit(STRsi(S0, rOPSTACK, 0));       // *((float*)opstack) = s0
+				break;
+
+			case OP_CVFI:
+				emit(LDRsi(S0, rOPSTACK, 0));       // s0 = *((float*)opstack)
+				emit(FCVTZSws(X0, S0));             // w0 = (int)s0
+				emit(STRwi(X0, rOPSTACK, 0));       // *opstack = w0
+				break;
+
+			default:
+				Com_Error(ERR_DROP, "VM_CompileAArch64: bad opcode %i at offset %i", op, pc);
+		}
+	}
+
+	// never reached
+	emit(BRK(0));
+	} // pass
+
+	Z_Free(branchOfs);
+
+	if (mprotect(vm->codeBase, vm->codeLength, PROT_READ|PROT_EXEC)) {
+		VM_Destroy_Compiled(vm);
+		Com_Error(ERR_FATAL, "VM_CompileAArch64: can't make the code executable");
+	}
+
+	__builtin___clear_cache((char *)vm->codeBase, (char *)vm->codeBase + vm->codeLength);
+
+	// offset all the instruction pointers for the new location
+	for (i_count = 0; i_count < header->instructionCount; i_count++)
+		vm->instructionPointers[i_count] += (intptr_t) vm->codeBase;
+
+	Com_Printf( "VM file %s compiled to %i bytes of code\n", vm->name, vm->codeLength );
+
+	vm->destroy = VM_Destroy_Compiled;
+	vm->compiled = qtrue;
+}
+
+int VM_CallCompiled(vm_t *vm, int *args)
+{
+	byte	stack[OPSTACK_SIZE + 15];
+	int	*opStack, *opStackTop;
+	int	programStack = vm->programStack;
+	int	stackOnEntry = programStack;
+	byte	*image = vm->dataBase;
+	int	*argPointer;
+	int	retVal;
+
+	currentVM = vm;
+
+	vm->currentlyInterpreting = qtrue;
+
+	programStack -= ( 8 + 4 * MAX_VMMAIN_ARGS );
+	argPointer = (int *)&image[ programStack + 8 ];
+	memcpy( argPointer, args, 4 * MAX_VMMAIN_ARGS );
+	argPointer[-1] = 0;
+	argPointer[-2] = -1;
+
+	opStack = PADP(stack, 16);
+	*opStack = 0xDEADBEEF;
+
+	/* call generated code */
+	{
+		int *(*entry)(vm_t*, int*, int*);
+
+		entry = (void *)(vm->codeBase);
+		opStackTop = entry(vm, &programStack, opStack);
+	}
+
+	if(opStackTop != opStack + 1 || *opStack != 0xDEADBEEF)
+	{
+		Com_Error(ERR_DROP, "opStack corrupted in compiled code");
+	}
+
+	if(programStack != stackOnEntry - (8 + 4 * MAX_VMMAIN_ARGS))
+		Com_Error(ERR_DROP, "programStack corrupted in compiled code");
+
+	retVal = *opStackTop;
+
+	vm->programStack = stackOnEntry;
+	vm->currentlyInterpreting = qfalse;
+
+	return retVal;
+}
@@ -108,8 +108,47 @@ static char	*opnames[256] = {
 	"OP_MULF",
 
 	"OP_CVIF",
-	"OP_CVFI"
+	"OP_CVFI",
+
+	//-------------------
+
+	"OP_LOCAL_LOAD4",
+	"OP_LOCAL_CONST_STORE4",
+	"OP_CONST_ADD",
+	"OP_CONST_EQ",
+	"OP_CONST_NE",
+	"OP_CONST_JUMP",
+	"OP_CONST_CALL"
+};
+#endif
+
+/*
+Superinstructions, written over the first opcode of a common sequence by
+VM_PrepareInterpreter. The operands and the opcodes that follow are left in
+place, so a jump into the middle of a sequence still runs it one plain
+instruction at a time.
+*/
+enum {
+	OP_NUM_BYTECODE = OP_CVFI + 1,
+
+	OP_LOCAL_LOAD4 = OP_NUM_BYTECODE,	// LOCAL n, LOAD4
+	OP_LOCAL_CONST_STORE4,				// LOCAL n, CONST c, STORE4
+	OP_CONST_ADD,						// CONST c, ADD
+	OP_CONST_EQ,						// CONST c, EQ t
+	OP_CONST_NE,						// CONST c, NE t
+	OP_CONST_JUMP,						// CONST n, JUMP with n resolved to a code offset
+	OP_CONST_CALL,						// CONST n, CALL with n resolved to a code offset
+
+	OP_NUM_INTERPRETED
 };
+
+// with GCC and clang every handler jumps straight to the next one through a
+// table of label addresses instead of going back around a switch
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_THREADED_DISPATCH
+#define OPCASE(op)	lbl_##op
+#else
+#define OPCASE(op)	case op
 #endif
 
 #if idppc
@@ -174,6 +213,7 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 	byte	*code;
 	int		instruction;
 	int		*codeBase;
+	int		next, value;
 
 	vm->codeBase = Hunk_Alloc( vm->codeLength*4, h_high );			// we're now int aligned
 //	memcpy( vm->codeBase, (byte *)header + header->codeOffset, vm->codeLength );
@@ -194,6 +234,8 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 		codeBase[int_pc] = op;
 		if(byte_pc > header->codeLength)
 			Com_Error(ERR_DROP, "VM_PrepareInterpreter: pc > header->codeLength");
+		if(op >= OP_NUM_BYTECODE)
+			Com_Error(ERR_DROP, "VM_PrepareInterpreter: bad opcode %i", op);
 
 		byte_pc++;
 		int_pc++;
@@ -263,7 +305,7 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 		case OP_LEF:
 		case OP_GTF:
 		case OP_GEF:
-			if(codeBase[int_pc] < 0 || codeBase[int_pc] > vm->instructionCount)
+			if(codeBase[int_pc] < 0 || codeBase[int_pc] >= vm->instructionCount)
 				Com_Error(ERR_DROP, "VM_PrepareInterpreter: Jump to invalid instruction number");
 
 			// codeBase[pc] is the instruction index. Convert that into an offset into
@@ -287,6 +329,54 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 		}
 
 	}
+
+	// Last, fuse the common sequences. Branch operands are code offsets by now,
+	//and a constant jump or call target is resolved here once instead of on every call.
+	for ( instruction = 0; instruction < header->instructionCount - 1; instruction++ ) {
+		int_pc = vm->instructionPointers[ instruction ];
+		op = codeBase[ int_pc ];
+
+		if ( op != OP_LOCAL && op != OP_CONST )
+			continue;
+
+		// both have one operand, so the next instruction starts two ints on
+		next = codeBase[ int_pc + 2 ];
+		value = codeBase[ int_pc + 1 ];
+
+		switch ( next ) {
+		case OP_CONST:
+			if ( op == OP_LOCAL && instruction < header->instructionCount - 2
+				&& codeBase[ int_pc + 4 ] == OP_STORE4 )
+				codeBase[ int_pc ] = OP_LOCAL_CONST_STORE4;
+			break;
+		case OP_LOAD4:
+			if ( op == OP_LOCAL )
+				codeBase[ int_pc ] = OP_LOCAL_LOAD4;
+			break;
+		case OP_ADD:
+			if ( op == OP_CONST )
+				codeBase[ int_pc ] = OP_CONST_ADD;
+			break;
+		case OP_EQ:
+			if ( op == OP_CONST )
+				codeBase[ int_pc ] = OP_CONST_EQ;
+			break;
+		case OP_NE:
+			if ( op == OP_CONST )
+				codeBase[ int_pc ] = OP_CONST_NE;
+			break;
+		case OP_JUMP:
+		case OP_CALL:
+			// system calls and bad targets are left to the checks in the plain ops
+			if ( op == OP_CONST && value >= 0 && value < header->instructionCount ) {
+				codeBase[ int_pc ] = ( next == OP_JUMP ) ? OP_CONST_JUMP : OP_CONST_CALL;
+				codeBase[ int_pc + 1 ] = vm->instructionPointers[ value ];
+			}
+			break;
+		default:
+			break;
+		}
+	}
 }
 
 /*
@@ -330,6 +420,78 @@ int	VM_CallInterpreted( vm_t *vm, int *args ) {
 #ifdef DEBUG_VM
 	vmSymbol_t	*profileSymbol;
 #endif
+#ifdef VM_THREADED_DISPATCH
+	static void	*dispatchTable[OP_NUM_INTERPRETED] = {
+		&&lbl_OP_UNDEF,
+		&&lbl_OP_IGNORE,
+		&&lbl_OP_BREAK,
+		&&lbl_OP_ENTER,
+		&&lbl_OP_LEAVE,
+		&&lbl_OP_CALL,
+		&&lbl_OP_PUSH,
+		&&lbl_OP_POP,
+		&&lbl_OP_CONST,
+		&&lbl_OP_LOCAL,
+		&&lbl_OP_JUMP,
+		&&lbl_OP_EQ,
+		&&lbl_OP_NE,
+		&&lbl_OP_LTI,
+		&&lbl_OP_LEI,
+		&&lbl_OP_GTI,
+		&&lbl_OP_GEI,
+		&&lbl_OP_LTU,
+		&&lbl_OP_LEU,
+		&&lbl_OP_GTU,
+		&&lbl_OP_GEU,
+		&&lbl_OP_EQF,
+		&&lbl_OP_NEF,
+		&&lbl_OP_LTF,
+		&&lbl_OP_LEF,
+		&&lbl_OP_GTF,
+		&&lbl_OP_GEF,
+		&&lbl_OP_LOAD1,
+		&&lbl_OP_LOAD2,
+		&&lbl_OP_LOAD4,
+		&&lbl_OP_STORE1,
+		&&lbl_OP_STORE2,
+		&&lbl_OP_STORE4,
+		&&lbl_OP_ARG,
+		&&lbl_OP_BLOCK_COPY,
+		&&lbl_OP_SEX8,
+		&&lbl_OP_SEX16,
+		&&lbl_OP_NEGI,
+		&&lbl_OP_ADD,
+		&&lbl_OP_SUB,
+		&&lbl_OP_DIVI,
+		&&lbl_OP_DIVU,
+		&&lbl_OP_MODI,
+		&&lbl_OP_MODU,
+		&&lbl_OP_MULI,
+		&&lbl_OP_MULU,
+		&&lbl_OP_BAND,
+		&&lbl_OP_BOR,
+		&&lbl_OP_BXOR,
+		&&lbl_OP_BCOM,
+		&&lbl_OP_LSH,
+		&&lbl_OP_RSHI,
+		&&lbl_OP_RSHU,
+		&&lbl_OP_NEGF,
+		&&lbl_OP_ADDF,
+		&&lbl_OP_SUBF,
+		&&lbl_OP_DIVF,
+		&&lbl_OP_MULF,
+		&&lbl_OP_CVIF,
+		&&lbl_OP_CVFI,
+
+		&&lbl_OP_LOCAL_LOAD4,
+		&&lbl_OP_LOCAL_CONST_STORE4,
+		&&lbl_OP_CONST_ADD,
+		&&lbl_OP_CONST_EQ,
+		&&lbl_OP_CONST_NE,
+		&&lbl_OP_CONST_JUMP,
+		&&lbl_OP_CONST_CALL
+	};
+#endif
 
 	// interpret the code
 	vm->currentlyInterpreting = qtrue;
@@ -404,23 +566,32 @@ nextInstruction2:
 #endif
 		opcode = codeImage[ programCounter++ ];
 
+#ifdef VM_THREADED_DISPATCH
+		// opcodes are checked on load, the table covers every one of them
+		goto *dispatchTable[ opcode ];
+		{
+#else
 		switch ( opcode ) {
 #ifdef DEBUG_VM
 		default:
 			Com_Error( ERR_DROP, "Bad VM instruction" );  // this should be scanned on load!
 			return 0;
 #endif
-		case OP_BREAK:
+#endif
+		OPCASE(OP_UNDEF):
+		OPCASE(OP_IGNORE):
+			goto nextInstruction2;
+		OPCASE(OP_BREAK):
 			vm->breakCount++;
 			goto nextInstruction2;
-		case OP_CONST:
+		OPCASE(OP_CONST):
 			opStackOfs++;
 			r1 = r0;
 			r0 = opStack[opStackOfs] = r2;
 			
 			programCounter += 1;
 			goto nextInstruction2;
-		case OP_LOCAL:
+		OPCASE(OP_LOCAL):
 			opStackOfs++;
 			r1 = r0;
 			r0 = opStack[opStackOfs] = r2+programStack;
@@ -428,7 +599,7 @@ nextInstruction2:
 			programCounter += 1;
 			goto nextInstruction2;
 
-		case OP_LOAD4:
+		OPCASE(OP_LOAD4):
 #ifdef DEBUG_VM
 			if(opStack[opStackOfs] & 3)
 			{
@@ -438,40 +609,40 @@ nextInstruction2:
 #endif
 			r0 = opStack[opStackOfs] = *(int *) &image[r0 & dataMask];
 			goto nextInstruction2;
-		case OP_LOAD2:
+		OPCASE(OP_LOAD2):
 			r0 = opStack[opStackOfs] = *(unsigned short *)&image[r0 & dataMask];
 			goto nextInstruction2;
-		case OP_LOAD1:
+		OPCASE(OP_LOAD1):
 			r0 = opStack[opStackOfs] = image[r0 & dataMask];
 			goto nextInstruction2;
 
-		case OP_STORE4:
+		OPCASE(OP_STORE4):
 			*(int *)&image[r1 & dataMask] = r0;
 			opStackOfs -= 2;
 			goto nextInstruction;
-		case OP_STORE2:
+		OPCASE(OP_STORE2):
 			*(short *)&image[r1 & dataMask] = r0;
 			opStackOfs -= 2;
 			goto nextInstruction;
-		case OP_STORE1:
+		OPCASE(OP_STORE1):
 			image[r1 & dataMask] = r0;
 			opStackOfs -= 2;
 			goto nextInstruction;
 
-		case OP_ARG:
+		OPCASE(OP_ARG):
 			// single byte offset from programStack
 			*(int *)&image[ (codeImage[programCounter] + programStack) & dataMask ] = r0;
 			opStackOfs--;
 			programCounter += 1;
 			goto nextInstruction;
 
-		case OP_BLOCK_COPY:
+		OPCASE(OP_BLOCK_COPY):
 			VM_BlockCopy(r1, r0, r2);
 			programCounter += 1;
 			opStackOfs -= 2;
 			goto nextInstruction;
 
-		case OP_CALL:
+		OPCASE(OP_CALL):
 			// save current program counter
 			*(int *)&image[ programStack ] = programCounter;
 			
@@ -498,22 +669,7 @@ nextInstruction2:
 				*(int *)&image[ programStack + 4 ] = -1 - programCounter;
 
 //VM_LogSyscalls( (int *)&image[ programStack + 4 ] );
-				{
-					// the vm has ints on the stack, we expect
-					// pointers so we might have to convert it
-					if (sizeof(intptr_t) != sizeof(int)) {
-						intptr_t argarr[ MAX_VMSYSCALL_ARGS ];
-						int *imagePtr = (int *)&image[ programStack ];
-						int i;
-						for (i = 0; i < ARRAY_LEN(argarr); ++i) {
-							argarr[i] = *(++imagePtr);
-						}
-						r = vm->systemCall( argarr );
-					} else {
-						intptr_t* argptr = (intptr_t *)&image[ programStack + 4 ];
-						r = vm->systemCall( argptr );
-					}
-				}
+				r = VM_SystemCall( vm, (int *)&image[ programStack + 4 ] );
 
 #ifdef DEBUG_VM
 				// this is just our stack frame pointer, only needed
@@ -540,14 +696,14 @@ nextInstruction2:
 			goto nextInstruction;
 
 		// push and pop are only needed for discarded or bad function return values
-		case OP_PUSH:
+		OPCASE(OP_PUSH):
 			opStackOfs++;
 			goto nextInstruction;
-		case OP_POP:
+		OPCASE(OP_POP):
 			opStackOfs--;
 			goto nextInstruction;
 
-		case OP_ENTER:
+		OPCASE(OP_ENTER):
 #ifdef DEBUG_VM
 			profileSymbol = VM_ValueToFunctionSymbol( vm, programCounter );
 #endif
@@ -571,7 +727,7 @@ nextInstruction2:
 			}
 #endif
 			goto nextInstruction;
-		case OP_LEAVE:
+		OPCASE(OP_LEAVE):
 			// remove our stack frame
 			v1 = r2;
 
@@ -601,7 +757,7 @@ nextInstruction2:
 		===================================================================
 		*/
 
-		case OP_JUMP:
+		OPCASE(OP_JUMP):
 			if ( (unsigned)r0 >= vm->instructionCount )
 			{
 				Com_Error( ERR_DROP, "VM program counter out of range in OP_JUMP" );
@@ -613,7 +769,7 @@ nextInstruction2:
 			opStackOfs--;
 			goto nextInstruction;
 
-		case OP_EQ:
+		OPCASE(OP_EQ):
 			opStackOfs -= 2;
 			if ( r1 == r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
@@ -623,7 +779,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_NE:
+		OPCASE(OP_NE):
 			opStackOfs -= 2;
 			if ( r1 != r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
@@ -633,7 +789,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_LTI:
+		OPCASE(OP_LTI):
 			opStackOfs -= 2;
 			if ( r1 < r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
@@ -643,7 +799,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_LEI:
+		OPCASE(OP_LEI):
 			opStackOfs -= 2;
 			if ( r1 <= r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
@@ -653,7 +809,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_GTI:
+		OPCASE(OP_GTI):
 			opStackOfs -= 2;
 			if ( r1 > r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
@@ -663,7 +819,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_GEI:
+		OPCASE(OP_GEI):
 			opStackOfs -= 2;
 			if ( r1 >= r0 ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
@@ -673,7 +829,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_LTU:
+		OPCASE(OP_LTU):
 			opStackOfs -= 2;
 			if ( ((unsigned)r1) < ((unsigned)r0) ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
@@ -683,7 +839,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_LEU:
+		OPCASE(OP_LEU):
 			opStackOfs -= 2;
 			if ( ((unsigned)r1) <= ((unsigned)r0) ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
@@ -693,7 +849,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_GTU:
+		OPCASE(OP_GTU):
 			opStackOfs -= 2;
 			if ( ((unsigned)r1) > ((unsigned)r0) ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
@@ -703,7 +859,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_GEU:
+		OPCASE(OP_GEU):
 			opStackOfs -= 2;
 			if ( ((unsigned)r1) >= ((unsigned)r0) ) {
 				programCounter = r2;	//vm->instructionPointers[r2];
@@ -713,7 +869,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_EQF:
+		OPCASE(OP_EQF):
 			opStackOfs -= 2;
 			
 			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] == ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
@@ -725,7 +881,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_NEF:
+		OPCASE(OP_NEF):
 			opStackOfs -= 2;
 
 			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] != ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
@@ -737,7 +893,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_LTF:
+		OPCASE(OP_LTF):
 			opStackOfs -= 2;
 
 			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] < ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
@@ -749,7 +905,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_LEF:
+		OPCASE(OP_LEF):
 			opStackOfs -= 2;
 
 			if(((float *) opStack)[(uint8_t) ((uint8_t) (opStackOfs + 1))] <= ((float *) opStack)[(uint8_t) ((uint8_t) (opStackOfs + 2))])
@@ -761,7 +917,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_GTF:
+		OPCASE(OP_GTF):
 			opStackOfs -= 2;
 
 			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] > ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
@@ -773,7 +929,7 @@ nextInstruction2:
 				goto nextInstruction;
 			}
 
-		case OP_GEF:
+		OPCASE(OP_GEF):
 			opStackOfs -= 2;
 
 			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] >= ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
@@ -788,103 +944,158 @@ nextInstruction2:
 
 		//===================================================================
 
-		case OP_NEGI:
+		OPCASE(OP_NEGI):
 			opStack[opStackOfs] = -r0;
 			goto nextInstruction;
-		case OP_ADD:
+		OPCASE(OP_ADD):
 			opStackOfs--;
 			opStack[opStackOfs] = r1 + r0;
 			goto nextInstruction;
-		case OP_SUB:
+		OPCASE(OP_SUB):
 			opStackOfs--;
 			opStack[opStackOfs] = r1 - r0;
 			goto nextInstruction;
-		case OP_DIVI:
+		OPCASE(OP_DIVI):
 			opStackOfs--;
 			opStack[opStackOfs] = r1 / r0;
 			goto nextInstruction;
-		case OP_DIVU:
+		OPCASE(OP_DIVU):
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) / ((unsigned) r0);
 			goto nextInstruction;
-		case OP_MODI:
+		OPCASE(OP_MODI):
 			opStackOfs--;
 			opStack[opStackOfs] = r1 % r0;
 			goto nextInstruction;
-		case OP_MODU:
+		OPCASE(OP_MODU):
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) % ((unsigned) r0);
 			goto nextInstruction;
-		case OP_MULI:
+		OPCASE(OP_MULI):
 			opStackOfs--;
 			opStack[opStackOfs] = r1 * r0;
 			goto nextInstruction;
-		case OP_MULU:
+		OPCASE(OP_MULU):
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) * ((unsigned) r0);
 			goto nextInstruction;
 
-		case OP_BAND:
+		OPCASE(OP_BAND):
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) & ((unsigned) r0);
 			goto nextInstruction;
-		case OP_BOR:
+		OPCASE(OP_BOR):
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) | ((unsigned) r0);
 			goto nextInstruction;
-		case OP_BXOR:
+		OPCASE(OP_BXOR):
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) ^ ((unsigned) r0);
 			goto nextInstruction;
-		case OP_BCOM:
+		OPCASE(OP_BCOM):
 			opStack[opStackOfs] = ~((unsigned) r0);
 			goto nextInstruction;
 
-		case OP_LSH:
+		OPCASE(OP_LSH):
 			opStackOfs--;
 			opStack[opStackOfs] = r1 << r0;
 			goto nextInstruction;
-		case OP_RSHI:
+		OPCASE(OP_RSHI):
 			opStackOfs--;
 			opStack[opStackOfs] = r1 >> r0;
 			goto nextInstruction;
-		case OP_RSHU:
+		OPCASE(OP_RSHU):
 			opStackOfs--;
 			opStack[opStackOfs] = ((unsigned) r1) >> r0;
 			goto nextInstruction;
 
-		case OP_NEGF:
+		OPCASE(OP_NEGF):
 			((float *) opStack)[opStackOfs] =  -((float *) opStack)[opStackOfs];
 			goto nextInstruction;
-		case OP_ADDF:
+		OPCASE(OP_ADDF):
 			opStackOfs--;
 			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] + ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
 			goto nextInstruction;
-		case OP_SUBF:
+		OPCASE(OP_SUBF):
 			opStackOfs--;
 			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] - ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
 			goto nextInstruction;
-		case OP_DIVF:
+		OPCASE(OP_DIVF):
 			opStackOfs--;
 			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] / ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
 			goto nextInstruction;
-		case OP_MULF:
+		OPCASE(OP_MULF):
 			opStackOfs--;
 			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] * ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
 			goto nextInstruction;
 
-		case OP_CVIF:
+		OPCASE(OP_CVIF):
 			((float *) opStack)[opStackOfs] = (float) opStack[opStackOfs];
 			goto nextInstruction;
-		case OP_CVFI:
+		OPCASE(OP_CVFI):
 			opStack[opStackOfs] = Q_ftol(((float *) opStack)[opStackOfs]);
 			goto nextInstruction;
-		case OP_SEX8:
+		OPCASE(OP_SEX8):
 			opStack[opStackOfs] = (signed char) opStack[opStackOfs];
 			goto nextInstruction;
-		case OP_SEX16:
+		OPCASE(OP_SEX16):
 			opStack[opStackOfs] = (short) opStack[opStackOfs];
 			goto nextInstruction;
+
+		/*
+		===================================================================
+		SUPERINSTRUCTIONS
+		===================================================================
+		*/
+
+		OPCASE(OP_LOCAL_LOAD4):
+			opStackOfs++;
+			r1 = r0;
+			r0 = opStack[opStackOfs] = *(int *)&image[ ( r2 + programStack ) & dataMask ];
+
+			programCounter += 2;
+			goto nextInstruction2;
+		OPCASE(OP_LOCAL_CONST_STORE4):
+			*(int *)&image[ ( r2 + programStack ) & dataMask ] = codeImage[ programCounter + 2 ];
+
+			programCounter += 4;
+			goto nextInstruction2;
+		OPCASE(OP_CONST_ADD):
+			r0 = opStack[opStackOfs] = r0 + r2;
+
+			programCounter += 2;
+			goto nextInstruction2;
+
+		OPCASE(OP_CONST_EQ):
+			opStackOfs--;
+			if ( r0 == r2 ) {
+				programCounter = codeImage[ programCounter + 2 ];
+				goto nextInstruction;
+			} else {
+				programCounter += 3;
+				goto nextInstruction;
+			}
+
+		OPCASE(OP_CONST_NE):
+			opStackOfs--;
+			if ( r0 != r2 ) {
+				programCounter = codeImage[ programCounter + 2 ];
+				goto nextInstruction;
+			} else {
+				programCounter += 3;
+				goto nextInstruction;
+			}
+
+		OPCASE(OP_CONST_JUMP):
+			programCounter = r2;
+			goto nextInstruction2;
+
+		OPCASE(OP_CONST_CALL):
+			// save the program counter past the CALL, the target is already a code offset
+			*(int *)&image[ programStack ] = programCounter + 2;
+
+			programCounter = r2;
+			goto nextInstruction;
 		}
 	}
 
@@ -171,6 +171,7 @@ struct vm_s {
 	byte		*dataBase;
 	int			dataMask;
 	int			dataAlloc;			// actually allocated
+	qboolean	dataGuarded;		// in a region of guard pages, from VM_AllocGuardedData
 
 	int			stackBottom;		// if programStack < stackBottom, error
 
@@ -183,6 +184,15 @@ struct vm_s {
 
 	byte		*jumpTableTargets;
 	int			numJumpTableTargets;
+
+	const vmSyscall_t	*syscalls;
+	int			numSyscalls;
+
+	// for vmsample
+	byte		*callStackTop;		// native stack at the outermost VM_Call
+	int			currentSyscall;		// syscall number + 1 while in one
+	void		*syscallStack;		// compiled: return address into the code at the syscall
+	void		*syscallReturn;		// native: where the syscall was made from
 };
 
 
@@ -191,6 +201,10 @@ extern	int		vm_debugLevel;
 
 void VM_Compile( vm_t *vm, vmHeader_t *header );
 int	VM_CallCompiled( vm_t *vm, int *args );
+#if idx64
+byte *VM_AllocGuardedData( vm_t *vm );
+void VM_FreeGuardedData( vm_t *vm );
+#endif
 
 void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header );
 int	VM_CallInterpreted( vm_t *vm, int *args );
@@ -199,5 +213,12 @@ vmSymbol_t *VM_ValueToFunctionSymbol( vm_t *vm, int value );
 int VM_SymbolToValue( vm_t *vm, const char *symbol );
 const char *VM_ValueToSymbol( vm_t *vm, int value );
 void VM_LogSyscalls( int *args );
+intptr_t VM_SystemCall( vm_t *vm, int *args );
+int VM_CompiledInstruction( vm_t *vm, const void *code );
+const char *VM_SymbolForCompiledPointer( vm_t *vm, void *code );
+vm_t *VM_Find( const char *module );
+
+void VM_Sample_f( void );
+void VM_SampleFree( vm_t *vm );
 
 void VM_BlockCopy(unsigned int dest, unsigned int src, size_t n);
@@ -0,0 +1,599 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// vm_profile.c -- sampling profiler for compiled and native VMs
+
+#include "vm_local.h"
+
+/*
+vmsample start samples the call stacks of a running VM from a profiling
+timer signal. The signal handler only copies return addresses into a
+ring, VM_SampleFrame names them and counts each distinct stack, and
+vmsample stop writes them out as folded stacks ("vmMain;G_RunFrame 42"),
+the input of flamegraph.pl.
+
+Compiled code keeps nothing but return addresses on the native stack, so
+it always unwinds. Native modules are unwound through their frame
+pointers, which only gives full stacks if they were built with them.
+Time spent in the engine is put under the syscall it was made from.
+Functions are named from vm/<module>.map when it was loaded, otherwise
+by the instruction they start at.
+*/
+
+#define	SAMPLE_FRAMES		32
+#define	SAMPLE_RING			1024		// power of two
+#define	SAMPLE_STACK_HASH	1024
+#define	SAMPLE_DEFAULT_HZ	100
+#define	SAMPLE_MAX_HZ		1000
+
+typedef struct {
+	int			syscall;				// + 1, 0 if the VM wasn't in one
+	int			numFrames;
+	void		*frames[SAMPLE_FRAMES];	// innermost first
+} vmSample_t;
+
+typedef struct sampleStack_s {
+	struct sampleStack_s	*next;
+	int						count;
+	char					stack[1];	// variable sized
+} sampleStack_t;
+
+typedef struct {
+	char				name[MAX_QPATH];	// of the VM, set while sampling
+	vm_t * volatile		vm;					// NULL while it isn't loaded
+	int					hz;
+	int					startTime;
+
+	// written by the signal handler, read by VM_SampleFrame
+	volatile vmSample_t	*ring;
+	volatile unsigned	head;
+	volatile unsigned	tail;
+	volatile int		idle;				// signals while the VM wasn't running
+	volatile int		dropped;			// signals with the ring full
+
+	int					*functions;			// instructions starting with OP_ENTER
+	int					numFunctions;
+
+	sampleStack_t		*stacks[SAMPLE_STACK_HASH];
+	int					numStacks;
+	int					samples;
+} vmSampler_t;
+
+static vmSampler_t	vmSampler;
+
+/*
+==================
+VM_SampleInCode
+
+For compiled VMs, the stubs before entryOfs aren't part of any function
+==================
+*/
+static qboolean VM_SampleInCode( vm_t *vm, const void *address ) {
+	return (const byte *)address >= vm->codeBase + vm->entryOfs && (const byte *)address < vm->codeBase + vm->codeLength;
+}
+
+/*
+==================
+VM_SampleCompiled
+==================
+*/
+static void VM_SampleCompiled( vm_t *vm, volatile vmSample_t *sample, void *ip, void *sp ) {
+	void	**stack, **top;
+
+	top = (void **)vm->callStackTop;
+
+	if ( sample->syscall ) {
+		// left by an earlier syscall if it isn't on the live stack
+		stack = vm->syscallStack;
+		if ( (void *)stack < sp || stack >= top ) {
+			return;
+		}
+	} else {
+		if ( VM_SampleInCode( vm, ip ) ) {
+			sample->frames[sample->numFrames++] = ip;
+		}
+		stack = sp;
+	}
+
+	// return addresses into the call stubs come between the ones into
+	// functions, and engine frames below them if it was interrupted there;
+	// on AArch64 each one is next to the saved frame pointer going up
+	for ( ; stack < top && sample->numFrames < SAMPLE_FRAMES ; stack++ ) {
+		if ( VM_SampleInCode( vm, *stack ) ) {
+			sample->frames[sample->numFrames++] = *stack;
+		} else if ( sample->numFrames && ( (byte *)*stack < vm->codeBase || (byte *)*stack >= vm->codeBase + vm->codeLength )
+			&& ( *stack <= (void *)stack || *stack >= (void *)top ) ) {
+			break;
+		}
+	}
+}
+
+/*
+==================
+VM_SampleNative
+==================
+*/
+static void VM_SampleNative( vm_t *vm, volatile vmSample_t *sample, void *ip, void *sp, void *fp ) {
+	void	**frame, **top;
+
+	if ( sample->syscall ) {
+		// the frame pointer is the engine's by now
+		if ( vm->syscallReturn ) {
+			sample->frames[sample->numFrames++] = vm->syscallReturn;
+		}
+		return;
+	}
+
+	sample->frames[sample->numFrames++] = ip;
+
+	// frame[0] is the caller's frame pointer and frame[1] the return address,
+	// as long as the frames stay on this stack and keep going up
+	top = (void **)vm->callStackTop;
+	for ( frame = fp ; sample->numFrames < SAMPLE_FRAMES ; frame = frame[0] ) {
+		if ( (void *)frame < sp || frame + 1 >= top || ( (intptr_t)frame & ( sizeof( void * ) - 1 ) ) ) {
+			break;
+		}
+		sample->frames[sample->numFrames++] = frame[1];
+		if ( (void **)frame[0] <= frame ) {
+			break;
+		}
+	}
+}
+
+/*
+==================
+VM_SampleSignal
+
+Runs in a signal handler, so it only reads memory and fills in the ring
+==================
+*/
+static void VM_SampleSignal( void *ip, void *sp, void *fp ) {
+	vm_t				*vm = vmSampler.vm;
+	volatile vmSample_t	*sample;
+	unsigned			head = vmSampler.head;
+
+	if ( !vm || vm->callLevel <= 0 || !vm->callStackTop ) {
+		vmSampler.idle++;
+		return;
+	}
+
+	if ( head - vmSampler.tail >= SAMPLE_RING ) {
+		vmSampler.dropped++;
+		return;
+	}
+
+	sample = &vmSampler.ring[head & ( SAMPLE_RING - 1 )];
+	sample->syscall = vm->currentSyscall;
+	sample->numFrames = 0;
+
+	if ( vm->dllHandle ) {
+		VM_SampleNative( vm, sample, ip, sp, fp );
+	} else {
+		VM_SampleCompiled( vm, sample, ip, sp );
+	}
+
+	vmSampler.head = head + 1;
+}
+
+/*
+==================
+VM_SampleLoadFunctions
+
+Finds where the functions start in the QVM, for naming them without symbols
+==================
+*/
+static void VM_SampleLoadFunctions( vm_t *vm ) {
+	union {
+		vmHeader_t	*h;
+		void		*v;
+	} header;
+	byte	*code;
+	int		pc, instruction, count, codeLength, instructionCount;
+	int		op;
+
+	vmSampler.functions = NULL;
+	vmSampler.numFunctions = 0;
+
+	if ( vm->dllHandle || vm->numSymbols ) {
+		return;
+	}
+
+	if ( FS_ReadFile( va( "vm/%s.qvm", vm->name ), &header.v ) < (int)sizeof( vmHeader_t ) ) {
+		if ( header.v ) {
+			FS_FreeFile( header.v );
+		}
+		return;
+	}
+
+	code = (byte *)header.h + LittleLong( header.h->codeOffset );
+	codeLength = LittleLong( header.h->codeLength );
+	instructionCount = LittleLong( header.h->instructionCount );
+	if ( instructionCount != vm->instructionCount ) {
+		FS_FreeFile( header.v );
+		return;
+	}
+
+	vmSampler.functions = Z_Malloc( instructionCount * sizeof( *vmSampler.functions ) );
+
+	count = 0;
+	pc = 0;
+	for ( instruction = 0 ; instruction < instructionCount && pc < codeLength ; instruction++ ) {
+		op = code[pc++];
+		switch ( op ) {
+		case OP_ENTER:
+			vmSampler.functions[count++] = instruction;
+			// fall through
+		case OP_LEAVE:
+		case OP_CONST:
+		case OP_LOCAL:
+		case OP_EQ:
+		case OP_NE:
+		case OP_LTI:
+		case OP_LEI:
+		case OP_GTI:
+		case OP_GEI:
+		case OP_LTU:
+		case OP_LEU:
+		case OP_GTU:
+		case OP_GEU:
+		case OP_EQF:
+		case OP_NEF:
+		case OP_LTF:
+		case OP_LEF:
+		case OP_GTF:
+		case OP_GEF:
+		case OP_BLOCK_COPY:
+			pc += 4;
+			break;
+		case OP_ARG:
+			pc += 1;
+			break;
+		default:
+			break;
+		}
+	}
+
+	vmSampler.numFunctions = count;
+	FS_FreeFile( header.v );
+}
+
+/*
+==================
+VM_SampleFunctionName
+==================
+*/
+static const char *VM_SampleFunctionName( vm_t *vm, const void *address, qboolean leaf ) {
+	static char	name[MAX_QPATH];
+	int			instruction, low, high, mid;
+
+	if ( vm->dllHandle ) {
+		if ( !Sys_AddressToSymbol( leaf ? address : (const byte *)address - 1, vm->entryPoint, name, sizeof( name ) ) ) {
+			return NULL;
+		}
+		return name;
+	}
+
+	// a return address can already be the next instruction
+	instruction = VM_CompiledInstruction( vm, leaf ? address : (const byte *)address - 1 );
+
+	if ( vm->numSymbols ) {
+		return VM_ValueToFunctionSymbol( vm, instruction )->symName;
+	}
+
+	if ( !vmSampler.numFunctions || instruction < vmSampler.functions[0] ) {
+		Com_sprintf( name, sizeof( name ), "%s:%i", vm->name, instruction );
+		return name;
+	}
+
+	low = 0;
+	high = vmSampler.numFunctions - 1;
+	while ( low < high ) {
+		mid = ( low + high + 1 ) / 2;
+		if ( vmSampler.functions[mid] <= instruction ) {
+			low = mid;
+		} else {
+			high = mid - 1;
+		}
+	}
+
+	Com_sprintf( name, sizeof( name ), "%s:%i", vm->name, vmSampler.functions[low] );
+	return name;
+}
+
+/*
+==================
+VM_SampleAddStack
+==================
+*/
+static void VM_SampleAddStack( const char *stack ) {
+	sampleStack_t	*entry;
+	unsigned		hash;
+	const char		*s;
+
+	hash = 0;
+	for ( s = stack ; *s ; s++ ) {
+		hash = hash * 31 + (byte)*s;
+	}
+	hash &= SAMPLE_STACK_HASH - 1;
+
+	for ( entry = vmSampler.stacks[hash] ; entry ; entry = entry->next ) {
+		if ( !strcmp( entry->stack, stack ) ) {
+			entry->count++;
+			return;
+		}
+	}
+
+	entry = Z_Malloc( sizeof( *entry ) + strlen( stack ) );
+	strcpy( entry->stack, stack );
+	entry->count = 1;
+	entry->next = vmSampler.stacks[hash];
+	vmSampler.stacks[hash] = entry;
+	vmSampler.numStacks++;
+}
+
+/*
+==================
+VM_SampleDrain
+
+Names and counts the samples in the ring
+==================
+*/
+static void VM_SampleDrain( vm_t *vm ) {
+	volatile vmSample_t	*sample;
+	char				stack[SAMPLE_FRAMES * MAX_QPATH];
+	const char			*name, *last;
+	int					i;
+
+	while ( vmSampler.tail != vmSampler.head ) {
+		sample = &vmSampler.ring[vmSampler.tail & ( SAMPLE_RING - 1 )];
+
+		// outermost first, without the repeats of a recursion through the
+		// call stub or a frame outside a native module
+		Q_strncpyz( stack, vm->name, sizeof( stack ) );
+		last = NULL;
+		for ( i = sample->numFrames - 1 ; i >= 0 ; i-- ) {
+			name = VM_SampleFunctionName( vm, sample->frames[i], i == 0 && !sample->syscall );
+			if ( !name ) {
+				continue;
+			}
+			Q_strcat( stack, sizeof( stack ), ";" );
+			Q_strcat( stack, sizeof( stack ), name );
+			last = name;
+		}
+		if ( sample->syscall ) {
+			Q_strcat( stack, sizeof( stack ), va( ";syscall %i", sample->syscall - 1 ) );
+		} else if ( !last ) {
+			Q_strcat( stack, sizeof( stack ), ";[unknown]" );
+		}
+
+		VM_SampleAddStack( stack );
+		vmSampler.samples++;
+		vmSampler.tail++;
+	}
+}
+
+/*
+==================
+VM_SampleFrame
+
+Called every frame while sampling
+==================
+*/
+void VM_SampleFrame( void ) {
+	vm_t	*vm;
+
+	if ( !vmSampler.name[0] ) {
+		return;
+	}
+
+	// picks the VM up again after a map change
+	if ( !vmSampler.vm ) {
+		vm = VM_Find( vmSampler.name );
+		if ( !vm || ( !vm->compiled && !vm->dllHandle ) ) {
+			return;
+		}
+		VM_SampleLoadFunctions( vm );
+		vmSampler.vm = vm;
+	}
+
+	VM_SampleDrain( vmSampler.vm );
+}
+
+/*
+==================
+VM_SampleFree
+
+The VM is about to go away, count what it left and wait for it to come back
+==================
+*/
+void VM_SampleFree( vm_t *vm ) {
+	if ( vm != vmSampler.vm ) {
+		return;
+	}
+
+	vmSampler.vm = NULL;
+	VM_SampleDrain( vm );
+
+	// samples taken since then can't be named any more
+	vmSampler.tail = vmSampler.head;
+
+	if ( vmSampler.functions ) {
+		Z_Free( vmSampler.functions );
+		vmSampler.functions = NULL;
+		vmSampler.numFunctions = 0;
+	}
+}
+
+/*
+==================
+VM_SampleReset
+==================
+*/
+static void VM_SampleReset( void ) {
+	sampleStack_t	*entry, *next;
+	int				i;
+
+	for ( i = 0 ; i < SAMPLE_STACK_HASH ; i++ ) {
+		for ( entry = vmSampler.stacks[i] ; entry ; entry = next ) {
+			next = entry->next;
+			Z_Free( entry );
+		}
+	}
+
+	if ( vmSampler.functions ) {
+		Z_Free( vmSampler.functions );
+	}
+	if ( vmSampler.ring ) {
+		Z_Free( (void *)vmSampler.ring );
+	}
+
+	Com_Memset( &vmSampler, 0, sizeof( vmSampler ) );
+}
+
+/*
+==================
+VM_SampleStart
+==================
+*/
+static void VM_SampleStart( const char *module, int hz ) {
+	vm_t	*vm;
+
+	if ( vmSampler.name[0] ) {
+		Com_Printf( "Already sampling %s\n", vmSampler.name );
+		return;
+	}
+
+	vm = VM_Find( module );
+	if ( !vm ) {
+		Com_Printf( "No VM named %s is loaded\n", module );
+		return;
+	}
+	if ( !vm->compiled && !vm->dllHandle ) {
+		Com_Printf( "%s is interpreted, use vmprofile for interpreted VMs\n", module );
+		return;
+	}
+
+	VM_SampleReset();
+
+	vmSampler.hz = Com_Clamp( 1, SAMPLE_MAX_HZ, hz );
+	vmSampler.ring = Z_Malloc( SAMPLE_RING * sizeof( *vmSampler.ring ) );
+	VM_SampleLoadFunctions( vm );
+	Q_strncpyz( vmSampler.name, vm->name, sizeof( vmSampler.name ) );
+	vmSampler.vm = vm;
+	vmSampler.startTime = Sys_Milliseconds();
+
+	if ( !Sys_StartProfileTimer( vmSampler.hz, VM_SampleSignal ) ) {
+		Com_Printf( "Sampling isn't supported on this platform\n" );
+		VM_SampleReset();
+		return;
+	}
+
+	Com_Printf( "Sampling %s %i times a second\n", vmSampler.name, vmSampler.hz );
+}
+
+/*
+==================
+VM_SampleStop
+==================
+*/
+static void VM_SampleStop( const char *filename ) {
+	sampleStack_t	*entry;
+	fileHandle_t	f;
+	char			line[SAMPLE_FRAMES * MAX_QPATH + 16];
+	int				i;
+
+	if ( !vmSampler.name[0] ) {
+		Com_Printf( "Not sampling\n" );
+		return;
+	}
+
+	Sys_StopProfileTimer();
+	if ( vmSampler.vm ) {
+		VM_SampleDrain( vmSampler.vm );
+	}
+
+	if ( !filename[0] ) {
+		filename = va( "%s.folded", vmSampler.name );
+	}
+
+	f = FS_FOpenFileWrite( filename );
+	if ( !f ) {
+		Com_Printf( "Couldn't write %s\n", filename );
+	} else {
+		for ( i = 0 ; i < SAMPLE_STACK_HASH ; i++ ) {
+			for ( entry = vmSampler.stacks[i] ; entry ; entry = entry->next ) {
+				Com_sprintf( line, sizeof( line ), "%s %i\n", entry->stack, entry->count );
+				FS_Write( line, strlen( line ), f );
+			}
+		}
+		FS_FCloseFile( f );
+
+		Com_Printf( "Wrote %i stacks from %i samples of %s over %i seconds to %s\n", vmSampler.numStacks,
+			vmSampler.samples, vmSampler.name, ( Sys_Milliseconds() - vmSampler.startTime ) / 1000, filename );
+	}
+
+	if ( vmSampler.dropped ) {
+		Com_Printf( "%i samples were dropped, the frames were too long for %i a second\n", vmSampler.dropped, vmSampler.hz );
+	}
+
+	VM_SampleReset();
+}
+
+/*
+==================
+VM_Sample_f
+
+vmsample start [vm] [hz]
+vmsample stop [file]
+vmsample
+==================
+*/
+void VM_Sample_f( void ) {
+	const char	*cmd = Cmd_Argv( 1 );
+
+	if ( !Q_stricmp( cmd, "start" ) ) {
+		VM_SampleStart( Cmd_Argc() > 2 ? Cmd_Argv( 2 ) : "qagame",
+			Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : SAMPLE_DEFAULT_HZ );
+		return;
+	}
+
+	if ( !Q_stricmp( cmd, "stop" ) ) {
+		VM_SampleStop( Cmd_Argv( 2 ) );
+		return;
+	}
+
+	if ( cmd[0] ) {
+		Com_Printf( "Usage: vmsample [start [vm] [hz] | stop [file]]\n" );
+		return;
+	}
+
+	if ( !vmSampler.name[0] ) {
+		Com_Printf( "Not sampling\n" );
+		return;
+	}
+
+	if ( vmSampler.vm ) {
+		VM_SampleDrain( vmSampler.vm );
+	}
+	Com_Printf( "Sampling %s %i times a second for %i seconds: %i samples in %i stacks, %i idle, %i dropped\n",
+		vmSampler.name, vmSampler.hz, ( Sys_Milliseconds() - vmSampler.startTime ) / 1000,
+		vmSampler.samples, vmSampler.numStacks, vmSampler.idle, vmSampler.dropped );
+}
@@ -58,10 +58,12 @@ x86_64:
 
 */
 
-#define VMFREE_BUFFERS() do {Z_Free(buf); Z_Free(jused);} while(0)
+#define VMFREE_BUFFERS() do {Z_Free(buf); Z_Free(jused); Z_Free(relocs);} while(0)
 static	byte	*buf = NULL;
 static	byte	*jused = NULL;
 static	int		jusedSize = 0;
+static	int		*relocs = NULL;		// offsets of the absolute addresses in buf
+static	int		numRelocs, maxRelocs;
 static	int		compiledOfs = 0;
 static	byte	*code = NULL;
 static	int		pc = 0;
@@ -148,7 +150,13 @@ static void Emit4(int v)
 static void EmitPtr(void *ptr)
 {
 	intptr_t v = (intptr_t) ptr;
-	
+
+	// code that was taken back can't have any
+	while(numRelocs && relocs[numRelocs - 1] >= compiledOfs)
+		numRelocs--;
+	if(numRelocs < maxRelocs)
+		relocs[numRelocs++] = compiledOfs;
+
 	Emit4(v);
 #if idx64
 	Emit1((v >> 32) & 0xFF);
@@ -204,11 +212,16 @@ static void EmitRexString(byte rex, const char *string)
 
 #define MASK_REG(modrm, mask) \
 	do { \
-		EmitString("81"); \
-		EmitString((modrm)); \
-		Emit4((mask)); \
+		if((mask)) { \
+			EmitString("81"); \
+			EmitString((modrm)); \
+			Emit4((mask)); \
+		} \
 	} while(0)
 
+// for addresses computed at run time, the guard pages stop those out of range instead
+#define DATA_MASK(vm) ((vm)->dataGuarded ? 0 : (vm)->dataMask)
+
 // add bl, bytes
 #define STACK_PUSH(bytes) \
 	do { \
@@ -402,6 +415,7 @@ work around different calling conventions
 */
 
 int vm_syscallNum;
+void *vm_syscallStack;
 int vm_programStack;
 int *vm_opStackBase;
 uint8_t vm_opStackOfs;
@@ -419,24 +433,19 @@ static void DoSyscall(void)
 	if(vm_syscallNum < 0)
 	{
 		int *data, *ret;
-#if idx64
-		int index;
-		intptr_t args[MAX_VMSYSCALL_ARGS];
-#endif
+		void *savedStack;
 		
 		data = (int *) (savedVM->dataBase + vm_programStack + 4);
 		ret = &vm_opStackBase[vm_opStackOfs + 1];
 
-#if idx64
-		args[0] = ~vm_syscallNum;
-		for(index = 1; index < ARRAY_LEN(args); index++)
-			args[index] = data[index];
-			
-		*ret = savedVM->systemCall(args);
-#else
+		// for vmsample
+		savedStack = savedVM->syscallStack;
+		savedVM->syscallStack = vm_syscallStack;
+
 		data[0] = ~vm_syscallNum;
-		*ret = savedVM->systemCall((intptr_t *) data);
-#endif
+		*ret = VM_SystemCall(savedVM, data);
+
+		savedVM->syscallStack = savedStack;
 	}
 	else
 	{
@@ -520,6 +529,15 @@ int EmitCallDoSyscall(vm_t *vm)
 	// align the stack pointer to a 16-byte-boundary
 	EmitString("55");			// push ebp
 	EmitRexString(0x48, "89 E5");		// mov ebp, esp
+
+	// the return address into the VM code, above the pushed registers
+#if idx64
+	EmitString("48 8D 45 30");		// lea rax, [rbp + 0x30]
+#else
+	EmitString("8D 45 10");			// lea eax, [ebp + 0x10]
+#endif
+	EmitRexString(0x48, "A3");		// mov [0x12345678], eax
+	EmitPtr(&vm_syscallStack);
 	EmitRexString(0x48, "83 E4 F0");	// and esp, 0xFFFFFFF0
 			
 	// call the syscall wrapper function DoSyscall()
@@ -591,7 +609,7 @@ int EmitCallProcedure(vm_t *vm, int sysCallOfs)
 	EmitRexString(0x49, "FF 14 C0");	// call qword ptr [r8 + eax * 8]
 #else
 	EmitString("FF 14 85");			// call dword ptr [vm->instructionPointers + eax * 4]
-	Emit4((intptr_t) vm->instructionPointers);
+	EmitPtr(vm->instructionPointers);
 #endif
 	EmitString("8B 04 9F");			// mov eax, dword ptr [edi + ebx * 4]
 	EmitString("C3");			// ret
@@ -719,6 +737,65 @@ void EmitBranchConditions(vm_t *vm, int op)
 }
 
 
+/*
+=================
+MemOperandOpcode
+Returns the x86 opcode for "op eax, dword ptr [mem]" of a QVM integer
+operation or compare, so a load feeding it can be folded in as its
+memory operand, or 0 if there is none
+=================
+*/
+
+static int MemOperandOpcode(int op)
+{
+	switch(op)
+	{
+	case OP_ADD:
+		return 0x03;	// add eax, dword ptr [mem]
+	case OP_SUB:
+		return 0x2B;	// sub eax, dword ptr [mem]
+	case OP_BAND:
+		return 0x23;	// and eax, dword ptr [mem]
+	case OP_BOR:
+		return 0x0B;	// or eax, dword ptr [mem]
+	case OP_BXOR:
+		return 0x33;	// xor eax, dword ptr [mem]
+	case OP_EQ:
+	case OP_NE:
+	case OP_LTI:
+	case OP_LEI:
+	case OP_GTI:
+	case OP_GEI:
+	case OP_LTU:
+	case OP_LEU:
+	case OP_GTU:
+	case OP_GEU:
+		return 0x3B;	// cmp eax, dword ptr [mem]
+	default:
+		return 0;
+	}
+}
+
+/*
+=================
+EmitMemOperandOp
+Second half of a fused load: eax holds the operand under the loaded one,
+which would have been on top of the opStack, the rest is as for op
+=================
+*/
+
+static void EmitMemOperandOp(vm_t *vm, int op)
+{
+	if(op >= OP_EQ && op <= OP_GEU)
+	{
+		EmitBranchConditions(vm, op);
+	}
+	else
+	{
+		EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
+	}
+}
+
 /*
 =================
 ConstOptimize
@@ -742,6 +819,30 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 	switch ( op1 ) {
 
 	case OP_LOAD4:
+		op1 = MemOperandOpcode(code[pc+5]);
+		if(op1 && !jused[instruction + 1])
+		{
+			v = Constant4();
+
+			EmitMovEAXStack(vm, 0);
+			if(code[pc+1] >= OP_EQ && code[pc+1] <= OP_GEU)
+				EmitCommand(LAST_COMMAND_SUB_BL_1);	// sub bl, 1
+#if idx64
+			Emit1(0x41);					// op eax, dword ptr [r9 + 0x12345678]
+			Emit1(op1);
+			Emit1(0x81);
+			Emit4(v & vm->dataMask);
+#else
+			Emit1(op1);					// op eax, dword ptr [0x12345678]
+			Emit1(0x05);
+			EmitPtr(vm->dataBase + (v & vm->dataMask));
+#endif
+			pc += 2;					// OP_LOAD4 + OP_*
+			EmitMemOperandOp(vm, code[pc-1]);
+			instruction += 2;
+			return qtrue;
+		}
+
 		EmitPushStack(vm);
 #if idx64
 		EmitRexString(0x41, "8B 81");			// mov eax, dword ptr [r9 + 0x12345678]
@@ -790,13 +891,13 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		return qtrue;
 
 	case OP_STORE4:
-		EmitMovEAXStack(vm, vm->dataMask);
+		EmitMovEAXStack(vm, DATA_MASK(vm));
 #if idx64
 		EmitRexString(0x41, "C7 04 01");		// mov dword ptr [r9 + eax], 0x12345678
 		Emit4(Constant4());
 #else
 		EmitString("C7 80");				// mov dword ptr [eax + 0x12345678], 0x12345678
-		Emit4((intptr_t) vm->dataBase);
+		EmitPtr(vm->dataBase);
 		Emit4(Constant4());
 #endif
 		EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
@@ -805,14 +906,14 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		return qtrue;
 
 	case OP_STORE2:
-		EmitMovEAXStack(vm, vm->dataMask);
+		EmitMovEAXStack(vm, DATA_MASK(vm));
 #if idx64
 		Emit1(0x66);					// mov word ptr [r9 + eax], 0x1234
 		EmitRexString(0x41, "C7 04 01");
 		Emit2(Constant4());
 #else
 		EmitString("66 C7 80");				// mov word ptr [eax + 0x12345678], 0x1234
-		Emit4((intptr_t) vm->dataBase);
+		EmitPtr(vm->dataBase);
 		Emit2(Constant4());
 #endif
 		EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
@@ -822,13 +923,13 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		return qtrue;
 
 	case OP_STORE1:
-		EmitMovEAXStack(vm, vm->dataMask);
+		EmitMovEAXStack(vm, DATA_MASK(vm));
 #if idx64
 		EmitRexString(0x41, "C6 04 01");		// mov byte [r9 + eax], 0x12
 		Emit1(Constant4());
 #else
 		EmitString("C6 80");				// mov byte ptr [eax + 0x12345678], 0x12
-		Emit4((intptr_t) vm->dataBase);
+		EmitPtr(vm->dataBase);
 		Emit1(Constant4());
 #endif
 		EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
@@ -1062,6 +1163,407 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 	return qfalse;
 }
 
+/*
+=================
+LocalOptimize
+A local that is loaded only to be the second operand of an integer operation
+or compare is used as its memory operand instead of going through the opStack.
+Returns the operation, or 0 if the LOCAL has to be emitted as usual
+=================
+*/
+
+int LocalOptimize(vm_t *vm)
+{
+	int v;
+	int op, op1;
+
+	// neither the load nor the operation may be a jump label
+	if(!vm->jumpTableTargets || jused[instruction] || jused[instruction + 1] || code[pc+4] != OP_LOAD4)
+		return 0;
+
+	op = code[pc+5];
+	op1 = MemOperandOpcode(op);
+	if(!op1)
+		return 0;
+
+	v = Constant4();
+
+	EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
+	EmitString("8D 96");				// lea edx, [esi + 0x12345678]
+	Emit4(v);
+	MASK_REG("E2", DATA_MASK(vm));			// and edx, 0x12345678
+	if(op >= OP_EQ && op <= OP_GEU)
+		EmitCommand(LAST_COMMAND_SUB_BL_1);	// sub bl, 1
+#if idx64
+	Emit1(0x41);					// op eax, dword ptr [r9 + edx]
+	Emit1(op1);
+	EmitString("04 11");
+#else
+	Emit1(op1);					// op eax, dword ptr [edx + 0x12345678]
+	Emit1(0x82);
+	EmitPtr(vm->dataBase);
+#endif
+	pc += 2;					// OP_LOAD4 + OP_*
+	EmitMemOperandOp(vm, op);
+
+	instruction += 2;
+	return op;
+}
+
+/*
+=================
+VM_AllocCode
+
+Writable memory for the compiled code, until VM_ProtectCode
+=================
+*/
+static byte *VM_AllocCode(int length)
+{
+	byte *codeBase;
+
+#ifdef VM_X86_MMAP
+	codeBase = mmap(NULL, length, PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if(codeBase == MAP_FAILED)
+		Com_Error(ERR_FATAL, "VM_CompileX86: can't mmap memory");
+#elif _WIN32
+	// allocate memory with EXECUTE permissions under windows.
+	codeBase = VirtualAlloc(NULL, length, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+	if(!codeBase)
+		Com_Error(ERR_FATAL, "VM_CompileX86: VirtualAlloc failed");
+#else
+	codeBase = malloc(length);
+	if(!codeBase)
+	        Com_Error(ERR_FATAL, "VM_CompileX86: malloc failed");
+#endif
+
+	return codeBase;
+}
+
+/*
+=================
+VM_ProtectCode
+
+Takes the write permission away for the execute one
+=================
+*/
+static qboolean VM_ProtectCode(byte *codeBase, int length)
+{
+#ifdef VM_X86_MMAP
+	if(mprotect(codeBase, length, PROT_READ|PROT_EXEC))
+		return qfalse;
+#elif _WIN32
+	{
+		DWORD oldProtect = 0;
+
+		// remove write permissions.
+		if(!VirtualProtect(codeBase, length, PAGE_EXECUTE_READ, &oldProtect))
+			return qfalse;
+	}
+#endif
+
+	return qtrue;
+}
+
+/*
+==============================================================================
+
+COMPILED CODE CACHE
+
+With vm_jitCache set, the code compiled for a qvm is written to
+vm/<game>/<name>.jit in the private cache, see FS_WriteCacheFile, and
+used instead of compiling the same qvm again. It's only valid for the
+build that wrote it. The absolute addresses in the code are saved as
+relocations, and put back before the code is made executable.
+
+==============================================================================
+*/
+
+#define	VM_CACHE_IDENT		(('J'<<24)+('M'<<16)+('V'<<8)+'Q')
+#define	VM_CACHE_VERSION	2
+#define	VM_CACHE_BUILD		Q3_VERSION " " PLATFORM_STRING " " __DATE__ " " __TIME__
+
+#define	VM_CACHE_SYMBOLS	8
+
+typedef enum
+{
+	VM_RELOC_DATA,			// vm->dataBase + value
+	VM_RELOC_POINTERS,		// vm->instructionPointers
+	VM_RELOC_ENGINE			// VM_CacheSymbols()[value]
+} vmRelocType_t;
+
+typedef struct
+{
+	int			offset;
+	int			type;
+	int			value;
+} vmCacheReloc_t;
+
+typedef struct
+{
+	int			ident;
+	int			version;
+	char		build[128];
+
+	// the qvm it was compiled from
+	int			codeChecksum;
+	int			jumpTableChecksum;
+	int			codeLength;
+	int			instructionCount;
+	int			dataMask;
+	int			dataGuarded;
+
+	// followed by the instruction offsets and the relocations
+	int			compiledLength;
+	int			entryOfs;
+	int			numRelocs;
+	int			codeOffset;
+} vmCacheHeader_t;
+
+/*
+=================
+VM_CacheSymbols
+
+The engine addresses the compiled code can refer to
+=================
+*/
+static void VM_CacheSymbols(void **symbols)
+{
+	symbols[0] = DoSyscall;
+	symbols[1] = &vm_syscallNum;
+	symbols[2] = &vm_programStack;
+	symbols[3] = &vm_opStackOfs;
+	symbols[4] = &vm_opStackBase;
+	symbols[5] = &vm_arg;
+	symbols[6] = &vm_syscallStack;
+	symbols[7] = Q_VMftol;
+}
+
+/*
+=================
+VM_CachePath
+=================
+*/
+static const char *VM_CachePath(vm_t *vm)
+{
+	return va("vm/%s/%s.jit", FS_GetCurrentGameDir(), vm->name);
+}
+
+/*
+=================
+VM_CacheKey
+
+Fills in what has to match for the cache to be used
+=================
+*/
+static void VM_CacheKey(vm_t *vm, vmHeader_t *header, vmCacheHeader_t *cache)
+{
+	Com_Memset(cache, 0, sizeof(*cache));
+	cache->ident = VM_CACHE_IDENT;
+	cache->version = VM_CACHE_VERSION;
+	Q_strncpyz(cache->build, VM_CACHE_BUILD, sizeof(cache->build));
+	cache->codeChecksum = Com_BlockChecksum((byte *)header + header->codeOffset, header->codeLength);
+	if(vm->numJumpTableTargets)
+		cache->jumpTableChecksum = Com_BlockChecksum(vm->jumpTableTargets, vm->numJumpTableTargets * sizeof(int));
+	cache->codeLength = header->codeLength;
+	cache->instructionCount = header->instructionCount;
+	cache->dataMask = vm->dataMask;
+	cache->dataGuarded = vm->dataGuarded;
+}
+
+/*
+=================
+VM_LoadCache
+
+Returns qfalse if the qvm has to be compiled
+=================
+*/
+static qboolean VM_LoadCache(vm_t *vm, vmHeader_t *header)
+{
+	vmCacheHeader_t	key, *cache;
+	vmCacheReloc_t	*cacheRelocs;
+	int		*offsets;
+	void		*symbols[VM_CACHE_SYMBOLS];
+	intptr_t	value;
+	byte		*data, *codeBase = NULL;
+	long		length;
+	int		i;
+
+	if(!Cvar_VariableIntegerValue("vm_jitCache"))
+		return qfalse;
+
+	length = FS_ReadCacheFile(VM_CachePath(vm), (void **) &data);
+	if(length < 0)
+		return qfalse;
+
+	cache = (vmCacheHeader_t *) data;
+	VM_CacheKey(vm, header, &key);
+	if(length < sizeof(*cache) || memcmp(&key, cache, (byte *)&key.compiledLength - (byte *)&key))
+		goto fail;
+
+	if(cache->compiledLength <= cache->entryOfs || cache->entryOfs <= 0 || cache->numRelocs < 0
+		|| cache->numRelocs > cache->compiledLength
+		|| cache->codeOffset != sizeof(*cache) + cache->instructionCount * sizeof(*offsets) + cache->numRelocs * sizeof(*cacheRelocs)
+		|| length != (long) cache->codeOffset + cache->compiledLength)
+		goto fail;
+
+	offsets = (int *) (data + sizeof(*cache));
+	cacheRelocs = (vmCacheReloc_t *) (offsets + cache->instructionCount);
+
+	// those folded into the one before them are never jumped to, and can be anything inside
+	for(i = 0; i < cache->instructionCount; i++)
+	{
+		if(offsets[i] < 0 || offsets[i] >= cache->compiledLength)
+			goto fail;
+	}
+
+	// copied out of the checked file, so what runs is what was checked
+	codeBase = VM_AllocCode(cache->compiledLength);
+	Com_Memcpy(codeBase, data + cache->codeOffset, cache->compiledLength);
+
+	VM_CacheSymbols(symbols);
+	for(i = 0; i < cache->numRelocs; i++)
+	{
+		vmCacheReloc_t *reloc = &cacheRelocs[i];
+
+		if(reloc->offset < 0 || reloc->offset > cache->compiledLength - (int) sizeof(value))
+			goto fail;
+
+		switch(reloc->type)
+		{
+		case VM_RELOC_DATA:
+			if(reloc->value < 0 || reloc->value > vm->dataMask)
+				goto fail;
+			value = (intptr_t) (vm->dataBase + reloc->value);
+			break;
+		case VM_RELOC_POINTERS:
+			value = (intptr_t) vm->instructionPointers;
+			break;
+		case VM_RELOC_ENGINE:
+			if(reloc->value < 0 || reloc->value >= VM_CACHE_SYMBOLS)
+				goto fail;
+			value = (intptr_t) symbols[reloc->value];
+			break;
+		default:
+			goto fail;
+		}
+
+		Com_Memcpy(codeBase + reloc->offset, &value, sizeof(value));
+	}
+
+	if(!VM_ProtectCode(codeBase, cache->compiledLength))
+		goto fail;
+
+	vm->codeBase = codeBase;
+	vm->codeLength = cache->compiledLength;
+	vm->entryOfs = cache->entryOfs;
+	vm->destroy = VM_Destroy_Compiled;
+
+	for(i = 0; i < cache->instructionCount; i++)
+		vm->instructionPointers[i] = (intptr_t) codeBase + offsets[i];
+
+	FS_FreeFile(data);
+
+	Com_Printf("VM file %s loaded %i bytes of compiled code from the cache\n", vm->name, vm->codeLength);
+	return qtrue;
+
+fail:
+	Com_DPrintf("VM_LoadCache: %s is out of date or damaged\n", VM_CachePath(vm));
+
+	if(codeBase)
+	{
+#ifdef VM_X86_MMAP
+		munmap(codeBase, cache->compiledLength);
+#elif _WIN32
+		VirtualFree(codeBase, 0, MEM_RELEASE);
+#else
+		free(codeBase);
+#endif
+	}
+	FS_FreeFile(data);
+
+	return qfalse;
+}
+
+/*
+=================
+VM_SaveCache
+
+Called with the code in buf and the instruction offsets relative to it
+=================
+*/
+static void VM_SaveCache(vm_t *vm, vmHeader_t *header)
+{
+	vmCacheHeader_t	*cache;
+	vmCacheReloc_t	*cacheRelocs;
+	int		*offsets;
+	void		*symbols[VM_CACHE_SYMBOLS];
+	intptr_t	value;
+	byte		*data;
+	int		i, j, length;
+
+	if(!Cvar_VariableIntegerValue("vm_jitCache"))
+		return;
+
+	// more than fit must have been left out
+	if(numRelocs >= maxRelocs)
+		return;
+
+	length = sizeof(*cache) + header->instructionCount * sizeof(*offsets) + numRelocs * sizeof(*cacheRelocs);
+	data = Z_Malloc(length + compiledOfs);
+
+	cache = (vmCacheHeader_t *) data;
+	offsets = (int *) (data + sizeof(*cache));
+	cacheRelocs = (vmCacheReloc_t *) (offsets + header->instructionCount);
+
+	VM_CacheKey(vm, header, cache);
+	cache->compiledLength = compiledOfs;
+	cache->entryOfs = vm->entryOfs;
+	cache->numRelocs = numRelocs;
+	cache->codeOffset = length;
+
+	VM_CacheSymbols(symbols);
+	for(i = 0; i < numRelocs; i++)
+	{
+		Com_Memcpy(&value, buf + relocs[i], sizeof(value));
+
+		cacheRelocs[i].offset = relocs[i];
+		if(value == (intptr_t) vm->instructionPointers)
+		{
+			cacheRelocs[i].type = VM_RELOC_POINTERS;
+			cacheRelocs[i].value = 0;
+			continue;
+		}
+		if(value >= (intptr_t) vm->dataBase && value <= (intptr_t) vm->dataBase + vm->dataMask)
+		{
+			cacheRelocs[i].type = VM_RELOC_DATA;
+			cacheRelocs[i].value = value - (intptr_t) vm->dataBase;
+			continue;
+		}
+		for(j = 0; j < VM_CACHE_SYMBOLS; j++)
+		{
+			if(value == (intptr_t) symbols[j])
+				break;
+		}
+		if(j == VM_CACHE_SYMBOLS)
+		{
+			Com_DPrintf("VM_SaveCache: unknown address at %i in %s\n", relocs[i], vm->name);
+			Z_Free(data);
+			return;
+		}
+		cacheRelocs[i].type = VM_RELOC_ENGINE;
+		cacheRelocs[i].value = j;
+	}
+
+	for(i = 0; i < header->instructionCount; i++)
+		offsets[i] = vm->instructionPointers[i];
+
+	Com_Memcpy(data + length, buf, compiledOfs);
+
+	FS_WriteCacheFile(VM_CachePath(vm), data, length + compiledOfs);
+
+	Z_Free(data);
+}
+
 /*
 =================
 VM_Compile
@@ -1075,6 +1577,9 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 	int		i;
         int		callProcOfsSyscall, callProcOfs, callDoSyscallOfs;
 
+	if(VM_LoadCache(vm, header))
+		return;
+
 	jusedSize = header->instructionCount + 2;
 
 	// allocate a very large temp buffer, we will shrink it later
@@ -1082,6 +1587,11 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 	buf = Z_Malloc(maxLength);
 	jused = Z_Malloc(jusedSize);
 	code = Z_Malloc(header->codeLength+32);
+
+	// an address takes at least one byte of bytecode, besides the stubs
+	maxRelocs = header->codeLength + 64;
+	relocs = Z_Malloc(maxRelocs * sizeof(*relocs));
+	numRelocs = 0;
 	
 	Com_Memset(jused, 0, jusedSize);
 	Com_Memset(buf, 0, maxLength);
@@ -1119,6 +1629,10 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 	//code = (byte *)header + header->codeOffset;
 	compiledOfs = vm->entryOfs;
 
+	// keep those of the stubs
+	while(numRelocs && relocs[numRelocs - 1] >= compiledOfs)
+		numRelocs--;
+
 	LastCommand = LAST_COMMAND_NONE;
 
 	while(instruction < header->instructionCount)
@@ -1170,6 +1684,14 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 
 			break;
 		case OP_LOCAL:
+			// the operation is the last instruction then, so this
+			// doesn't count as a LOCAL for the increment in OP_LOAD4
+			if((v = LocalOptimize(vm)))
+			{
+				op = v;
+				break;
+			}
+
 			EmitPushStack(vm);
 			EmitString("8D 86");				// lea eax, [0x12345678 + esi]
 			oc0 = oc1;
@@ -1182,12 +1704,12 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitString("8B D6");				// mov edx, esi
 			EmitString("81 C2");				// add edx, 0x12345678
 			Emit4((Constant1() & 0xFF));
-			MASK_REG("E2", vm->dataMask);			// and edx, 0x12345678
+			MASK_REG("E2", DATA_MASK(vm));			// and edx, 0x12345678
 #if idx64
 			EmitRexString(0x41, "89 04 11");		// mov dword ptr [r9 + edx], eax
 #else
 			EmitString("89 82");				// mov dword ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
+			EmitPtr(vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
@@ -1218,14 +1740,14 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 				pc++;				// OP_CONST
 				v = Constant4();
 
-				EmitMovEDXStack(vm, vm->dataMask);
+				EmitMovEDXStack(vm, DATA_MASK(vm));
 				if(v == 1 && oc0 == oc1 && pop0 == OP_LOCAL && pop1 == OP_LOCAL)
 				{
 #if idx64
 					EmitRexString(0x41, "FF 04 11");	// inc dword ptr [r9 + edx]
 #else
 					EmitString("FF 82");			// inc dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitPtr(vm->dataBase);
 #endif
 				}
 				else
@@ -1234,7 +1756,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 					EmitRexString(0x41, "8B 04 11");	// mov eax, dword ptr [r9 + edx]
 #else
 					EmitString("8B 82");			// mov eax, dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitPtr(vm->dataBase);
 #endif
 					EmitString("05");			// add eax, v
 					Emit4(v);
@@ -1245,19 +1767,19 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitPtr(vm->dataBase);
 #endif
 					}
 					else
 					{
 						EmitCommand(LAST_COMMAND_SUB_BL_1);	// sub bl, 1
 						EmitString("8B 14 9F");			// mov edx, dword ptr [edi + ebx * 4]
-						MASK_REG("E2", vm->dataMask);		// and edx, 0x12345678
+						MASK_REG("E2", DATA_MASK(vm));		// and edx, 0x12345678
 #if idx64
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitPtr(vm->dataBase);
 #endif
 					}
 				}
@@ -1280,14 +1802,14 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 				pc++;					// OP_CONST
 				v = Constant4();
 
-				EmitMovEDXStack(vm, vm->dataMask);
+				EmitMovEDXStack(vm, DATA_MASK(vm));
 				if(v == 1 && oc0 == oc1 && pop0 == OP_LOCAL && pop1 == OP_LOCAL)
 				{
 #if idx64
 					EmitRexString(0x41, "FF 0C 11");	// dec dword ptr [r9 + edx]
 #else
 					EmitString("FF 8A");			// dec dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitPtr(vm->dataBase);
 #endif
 				}
 				else
@@ -1296,7 +1818,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 					EmitRexString(0x41, "8B 04 11");	// mov eax, dword ptr [r9 + edx]
 #else
 					EmitString("8B 82");			// mov eax, dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitPtr(vm->dataBase);
 #endif
 					EmitString("2D");			// sub eax, v
 					Emit4(v);
@@ -1307,19 +1829,19 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitPtr(vm->dataBase);
 #endif
 					}
 					else
 					{
 						EmitCommand(LAST_COMMAND_SUB_BL_1);	// sub bl, 1
 						EmitString("8B 14 9F");			// mov edx, dword ptr [edi + ebx * 4]
-						MASK_REG("E2", vm->dataMask);		// and edx, 0x12345678
+						MASK_REG("E2", DATA_MASK(vm));		// and edx, 0x12345678
 #if idx64
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitPtr(vm->dataBase);
 #endif
 					}
 				}
@@ -1334,80 +1856,80 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			{
 				compiledOfs -= 3;
 				vm->instructionPointers[instruction - 1] = compiledOfs;
-				MASK_REG("E0", vm->dataMask);			// and eax, 0x12345678
+				MASK_REG("E0", DATA_MASK(vm));			// and eax, 0x12345678
 #if idx64
 				EmitRexString(0x41, "8B 04 01");		// mov eax, dword ptr [r9 + eax]
 #else
 				EmitString("8B 80");				// mov eax, dword ptr [eax + 0x1234567]
-				Emit4((intptr_t) vm->dataBase);
+				EmitPtr(vm->dataBase);
 #endif
 				EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 				break;
 			}
 			
-			EmitMovEAXStack(vm, vm->dataMask);
+			EmitMovEAXStack(vm, DATA_MASK(vm));
 #if idx64
 			EmitRexString(0x41, "8B 04 01");		// mov eax, dword ptr [r9 + eax]
 #else
 			EmitString("8B 80");				// mov eax, dword ptr [eax + 0x12345678]
-			Emit4((intptr_t) vm->dataBase);
+			EmitPtr(vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_LOAD2:
-			EmitMovEAXStack(vm, vm->dataMask);
+			EmitMovEAXStack(vm, DATA_MASK(vm));
 #if idx64
 			EmitRexString(0x41, "0F B7 04 01");		// movzx eax, word ptr [r9 + eax]
 #else
 			EmitString("0F B7 80");				// movzx eax, word ptr [eax + 0x12345678]
-			Emit4((intptr_t) vm->dataBase);
+			EmitPtr(vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_LOAD1:
-			EmitMovEAXStack(vm, vm->dataMask);
+			EmitMovEAXStack(vm, DATA_MASK(vm));
 #if idx64
 			EmitRexString(0x41, "0F B6 04 01");		// movzx eax, byte ptr [r9 + eax]
 #else
 			EmitString("0F B6 80");				// movzx eax, byte ptr [eax + 0x12345678]
-			Emit4((intptr_t) vm->dataBase);
+			EmitPtr(vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_STORE4:
 			EmitMovEAXStack(vm, 0);	
 			EmitString("8B 54 9F FC");			// mov edx, dword ptr -4[edi + ebx * 4]
-			MASK_REG("E2", vm->dataMask);			// and edx, 0x12345678
+			MASK_REG("E2", DATA_MASK(vm));			// and edx, 0x12345678
 #if idx64
 			EmitRexString(0x41, "89 04 11");		// mov dword ptr [r9 + edx], eax
 #else
 			EmitString("89 82");				// mov dword ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
+			EmitPtr(vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_SUB_BL_2);		// sub bl, 2
 			break;
 		case OP_STORE2:
 			EmitMovEAXStack(vm, 0);	
 			EmitString("8B 54 9F FC");			// mov edx, dword ptr -4[edi + ebx * 4]
-			MASK_REG("E2", vm->dataMask);			// and edx, 0x12345678
+			MASK_REG("E2", DATA_MASK(vm));			// and edx, 0x12345678
 #if idx64
 			Emit1(0x66);					// mov word ptr [r9 + edx], eax
 			EmitRexString(0x41, "89 04 11");
 #else
 			EmitString("66 89 82");				// mov word ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
+			EmitPtr(vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_SUB_BL_2);		// sub bl, 2
 			break;
 		case OP_STORE1:
 			EmitMovEAXStack(vm, 0);	
 			EmitString("8B 54 9F FC");			// mov edx, dword ptr -4[edi + ebx * 4]
-			MASK_REG("E2", vm->dataMask);			// and edx, 0x12345678
+			MASK_REG("E2", DATA_MASK(vm));			// and edx, 0x12345678
 #if idx64
 			EmitRexString(0x41, "88 04 11");		// mov byte ptr [r9 + edx], eax
 #else
 			EmitString("88 82");				// mov byte ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
+			EmitPtr(vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_SUB_BL_2);		// sub bl, 2
 			break;
@@ -1474,13 +1996,16 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			break;
 		case OP_ADD:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("01 44 9F FC");			// add dword ptr -4[edi + ebx * 4], eax
+			EmitString("03 44 9F FC");			// add eax, dword ptr -4[edi + ebx * 4]
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_SUB:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("29 44 9F FC");			// sub dword ptr -4[edi + ebx * 4], eax
+			EmitString("F7 D8");				// neg eax
+			EmitString("03 44 9F FC");			// add eax, dword ptr -4[edi + ebx * 4]
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_DIVI:
 			EmitString("8B 44 9F FC");			// mov eax,dword ptr -4[edi + ebx * 4]
@@ -1524,18 +2049,21 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			break;
 		case OP_BAND:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("21 44 9F FC");			// and dword ptr -4[edi + ebx * 4],eax
+			EmitString("23 44 9F FC");			// and eax, dword ptr -4[edi + ebx * 4]
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_BOR:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("09 44 9F FC");			// or dword ptr -4[edi + ebx * 4],eax
+			EmitString("0B 44 9F FC");			// or eax, dword ptr -4[edi + ebx * 4]
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_BXOR:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("31 44 9F FC");			// xor dword ptr -4[edi + ebx * 4],eax
+			EmitString("33 44 9F FC");			// xor eax, dword ptr -4[edi + ebx * 4]
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_BCOM:
 			EmitString("F7 14 9F");				// not dword ptr [edi + ebx * 4]
@@ -1632,7 +2160,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 #else
 			EmitString("73 07");			// jae +7
 			EmitString("FF 24 85");			// jmp dword ptr [instructionPointers + eax * 4]
-			Emit4((intptr_t) vm->instructionPointers);
+			EmitPtr(vm->instructionPointers);
 #endif
 			EmitCallErrJump(vm, callDoSyscallOfs);
 			break;
@@ -1647,39 +2175,19 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 
 	// copy to an exact sized buffer with the appropriate permission bits
 	vm->codeLength = compiledOfs;
-#ifdef VM_X86_MMAP
-	vm->codeBase = mmap(NULL, compiledOfs, PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
-	if(vm->codeBase == MAP_FAILED)
-		Com_Error(ERR_FATAL, "VM_CompileX86: can't mmap memory");
-#elif _WIN32
-	// allocate memory with EXECUTE permissions under windows.
-	vm->codeBase = VirtualAlloc(NULL, compiledOfs, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
-	if(!vm->codeBase)
-		Com_Error(ERR_FATAL, "VM_CompileX86: VirtualAlloc failed");
-#else
-	vm->codeBase = malloc(compiledOfs);
-	if(!vm->codeBase)
-	        Com_Error(ERR_FATAL, "VM_CompileX86: malloc failed");
-#endif
+	vm->codeBase = VM_AllocCode(compiledOfs);
 
 	Com_Memcpy( vm->codeBase, buf, compiledOfs );
 
-#ifdef VM_X86_MMAP
-	if(mprotect(vm->codeBase, compiledOfs, PROT_READ|PROT_EXEC))
-		Com_Error(ERR_FATAL, "VM_CompileX86: mprotect failed");
-#elif _WIN32
-	{
-		DWORD oldProtect = 0;
-		
-		// remove write permissions.
-		if(!VirtualProtect(vm->codeBase, compiledOfs, PAGE_EXECUTE_READ, &oldProtect))
-			Com_Error(ERR_FATAL, "VM_CompileX86: VirtualProtect failed");
-	}
-#endif
+	if(!VM_ProtectCode(vm->codeBase, compiledOfs))
+		Com_Error(ERR_FATAL, "VM_CompileX86: can't make the code executable");
+
+	VM_SaveCache(vm, header);
 
 	Z_Free( code );
 	Z_Free( buf );
 	Z_Free( jused );
+	Z_Free( relocs );
 	Com_Printf( "VM file %s compiled to %i bytes of code\n", vm->name, compiledOfs );
 
 	vm->destroy = VM_Destroy_Compiled;
@@ -1701,6 +2209,103 @@ void VM_Destroy_Compiled(vm_t* self)
 #endif
 }
 
+/*
+==============================================================================
+
+GUARDED DATA
+
+With vm_guardData set on 64-bit hosts, the data of a compiled VM is put
+at the start of a reserved region that any 32-bit offset stays inside,
+and only the data is accessible. The compiled code then leaves out the
+masking of the addresses it computes, as those past the data fault.
+The fault is turned into an ERR_DROP where the program made it.
+
+==============================================================================
+*/
+
+#define	VM_GUARD_SIZE	( 0x100000000ULL + 0x10000 )	// 4GB, and an access at the end of that
+#define	VM_GUARD_SLACK	0x10000		// for the engine reading strings past the end of the data
+
+/*
+=================
+ErrData
+=================
+*/
+static void __attribute__((__noreturn__)) ErrData(void)
+{
+	Com_Error(ERR_DROP, "program tried to access memory outside VM");
+}
+
+/*
+=================
+VM_DataFault
+
+Only for faults of the compiled code in the region of the VM running it
+=================
+*/
+static void *VM_DataFault(void *address, void *ip)
+{
+	vm_t *vm = currentVM;
+
+	if(!vm || !vm->dataGuarded || !vm->codeBase)
+		return NULL;
+
+	if((byte *) address < vm->dataBase || (byte *) address >= vm->dataBase + VM_GUARD_SIZE)
+		return NULL;
+
+	if((byte *) ip < vm->codeBase || (byte *) ip >= vm->codeBase + vm->codeLength)
+		return NULL;
+
+	return ErrData;
+}
+
+/*
+=================
+VM_AllocGuardedData
+
+Returns NULL if the data has to be masked
+=================
+*/
+byte *VM_AllocGuardedData(vm_t *vm)
+{
+#if idx64 && defined(VM_X86_MMAP)
+	byte *data;
+
+	data = mmap(NULL, VM_GUARD_SIZE, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if(data == MAP_FAILED)
+	{
+		Com_Printf(S_COLOR_YELLOW "Warning: can't reserve guarded data for %s, masking it\n", vm->name);
+		return NULL;
+	}
+
+	if(mprotect(data, vm->dataAlloc + VM_GUARD_SLACK, PROT_READ|PROT_WRITE) || !Sys_SetFaultHandler(VM_DataFault))
+	{
+		munmap(data, VM_GUARD_SIZE);
+		Com_Printf(S_COLOR_YELLOW "Warning: can't guard the data of %s, masking it\n", vm->name);
+		return NULL;
+	}
+
+	vm->dataGuarded = qtrue;
+	return data;
+#else
+	return NULL;
+#endif
+}
+
+/*
+=================
+VM_FreeGuardedData
+=================
+*/
+void VM_FreeGuardedData(vm_t *vm)
+{
+#if idx64 && defined(VM_X86_MMAP)
+	munmap(vm->dataBase, VM_GUARD_SIZE);
+#endif
+	vm->dataBase = NULL;
+	vm->dataGuarded = qfalse;
+}
+
 /*
 ==============
 VM_CallCompiled
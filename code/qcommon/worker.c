@@ -0,0 +1,779 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// worker.c -- the engine job system, a pool of worker threads for parallel loops
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+#define MAX_WORKERS			32
+#define MAX_THREADS			( MAX_WORKERS + 1 )		// the workers and index 0
+#define MAX_JOB_GROUPS		64						// power of two
+#define MAX_JOB_STATS		32
+#define MAX_SLICED_JOBS		0xffff					// slices are packed in 16 bits
+#define RANGE_JOBS_PER_THREAD	4
+
+/*
+A job group is func( data, i ) for every i in [0, count), queued with
+Com_AddJobs. It is ready once the groups it depends on are done, then the
+workers and whoever is in Com_WaitJobs for it run its jobs. Com_RunParallel
+is a group that is waited for right away.
+
+The jobs of a group start out split into one slice per thread, so each
+thread walks a contiguous range of its own. A thread whose slice has run
+dry steals the upper half of the biggest slice left. A slice is its next
+and end index packed into one int and is only moved on with a compare and
+swap, so claiming a job takes no lock. Groups are found, pinned and freed
+under workerLock.
+
+With com_speeds on, the time spent in jobs is added up by group name, the
+frame total shows up as jb: and com_speeds 4 lists every name.
+*/
+
+typedef struct {
+	const char		*name;
+	int				groups;
+	volatile int	jobs;
+	volatile int	usec;
+} jobStats_t;
+
+typedef struct {
+	jobGroup_t		handle;			// 0 once done
+	int				users;			// threads running its jobs
+	qboolean		ready;			// the groups it depends on are done
+
+	workerFunc_t	func;
+	void			*data;
+	int				count;
+	jobGroup_t		depends[MAX_JOB_DEPENDS];
+	int				numDepends;
+
+	qboolean		sliced;
+	volatile int	slices[MAX_THREADS];
+	volatile int	next;			// instead of the slices for big groups
+	volatile int	done;
+
+	jobStats_t		*stats;
+} workGroup_t;
+
+#define	JOB_SLICE( next, end )	( (int)( ( (unsigned)( next ) << 16 ) | (unsigned)( end ) ) )
+#define	SLICE_NEXT( slice )		( (int)( (unsigned)( slice ) >> 16 ) )
+#define	SLICE_END( slice )		( (int)( (unsigned)( slice ) & 0xffff ) )
+
+static cvar_t			*com_workerThreads;
+
+static sysThread_t		*workers[MAX_WORKERS];
+static int				numWorkers;
+static qboolean			workersQuit;
+
+static sysMutex_t		*workerLock;
+static sysSemaphore_t	*workerWake;		// a worker looks for a ready group
+static sysSemaphore_t	*jobFinished;		// a group is done, for Com_WaitJobs
+
+// protected by workerLock
+static workGroup_t		groups[MAX_JOB_GROUPS];
+static int				groupSerial;
+static int				jobWaiters;
+static jobStats_t		jobStats[MAX_JOB_STATS];
+static int				numJobStats;
+
+static Q_THREADLOCAL int	workerIndex;		// 0 on every thread that isn't a worker
+static Q_THREADLOCAL int	jobDepth;			// inside a job
+
+/*
+=================
+Com_GroupDone
+=================
+*/
+static qboolean Com_GroupDone( jobGroup_t group ) {
+	return !group || groups[group & ( MAX_JOB_GROUPS - 1 )].handle != group;
+}
+
+/*
+=================
+Com_GroupReady
+
+workerLock held
+=================
+*/
+static qboolean Com_GroupReady( workGroup_t *g ) {
+	int		i;
+
+	if ( !g->ready ) {
+		for ( i = 0 ; i < g->numDepends ; i++ ) {
+			if ( !Com_GroupDone( g->depends[i] ) ) {
+				return qfalse;
+			}
+		}
+		g->ready = qtrue;
+	}
+
+	return qtrue;
+}
+
+/*
+=================
+Com_GroupHasJobs
+
+Any jobs left to claim, workerLock held
+=================
+*/
+static qboolean Com_GroupHasJobs( workGroup_t *g ) {
+	int		i, slice;
+
+	if ( !g->handle || !Com_GroupReady( g ) ) {
+		return qfalse;
+	}
+
+	if ( !g->sliced ) {
+		return g->next < g->count;
+	}
+
+	for ( i = 0 ; i <= numWorkers ; i++ ) {
+		slice = g->slices[i];
+		if ( SLICE_NEXT( slice ) < SLICE_END( slice ) ) {
+			return qtrue;
+		}
+	}
+
+	return qfalse;
+}
+
+/*
+=================
+Com_NextGroup
+
+A ready group with jobs left, the preferred one if it is, and pinned.
+workerLock held.
+=================
+*/
+static workGroup_t *Com_NextGroup( jobGroup_t prefer ) {
+	workGroup_t	*g;
+	int			i;
+
+	g = NULL;
+	if ( prefer && !Com_GroupDone( prefer ) && Com_GroupHasJobs( &groups[prefer & ( MAX_JOB_GROUPS - 1 )] ) ) {
+		g = &groups[prefer & ( MAX_JOB_GROUPS - 1 )];
+	}
+
+	for ( i = 0 ; !g && i < MAX_JOB_GROUPS ; i++ ) {
+		if ( Com_GroupHasJobs( &groups[i] ) ) {
+			g = &groups[i];
+		}
+	}
+
+	if ( g ) {
+		g->users++;
+	}
+
+	return g;
+}
+
+/*
+=================
+Com_ClaimJobs
+
+The next range of jobs for this thread to run, from its own slice or
+stolen from another one. qfalse when none are left.
+=================
+*/
+static qboolean Com_ClaimJobs( workGroup_t *g, int self, int *start, int *end ) {
+	int		slice, next, last, mid;
+	int		i, best, bestLeft;
+
+	if ( !g->sliced ) {
+		next = Sys_AtomicAdd( &g->next, 1 ) - 1;
+		if ( next >= g->count ) {
+			return qfalse;
+		}
+		*start = next;
+		*end = next + 1;
+		return qtrue;
+	}
+
+	// our own slice, one at a time
+	while ( 1 ) {
+		slice = g->slices[self];
+		next = SLICE_NEXT( slice );
+		last = SLICE_END( slice );
+		if ( next >= last ) {
+			break;
+		}
+		if ( Sys_AtomicCompareExchange( &g->slices[self], slice, JOB_SLICE( next + 1, last ) ) ) {
+			*start = next;
+			*end = next + 1;
+			return qtrue;
+		}
+	}
+
+	// steal from the biggest one left
+	while ( 1 ) {
+		best = -1;
+		bestLeft = 0;
+		for ( i = 0 ; i <= numWorkers ; i++ ) {
+			slice = g->slices[i];
+			if ( SLICE_END( slice ) - SLICE_NEXT( slice ) > bestLeft ) {
+				bestLeft = SLICE_END( slice ) - SLICE_NEXT( slice );
+				best = i;
+			}
+		}
+		if ( best == -1 ) {
+			return qfalse;
+		}
+
+		slice = g->slices[best];
+		next = SLICE_NEXT( slice );
+		last = SLICE_END( slice );
+		if ( next >= last ) {
+			continue;
+		}
+
+		if ( last - next == 1 ) {
+			if ( Sys_AtomicCompareExchange( &g->slices[best], slice, JOB_SLICE( last, last ) ) ) {
+				*start = next;
+				*end = last;
+				return qtrue;
+			}
+			continue;
+		}
+
+		mid = next + ( last - next ) / 2;
+		if ( !Sys_AtomicCompareExchange( &g->slices[best], slice, JOB_SLICE( next, mid ) ) ) {
+			continue;
+		}
+
+		// run the first of the stolen half and leave the rest in our
+		// slice for others to steal back, unless another thread with
+		// our index refilled it already, then run all of it here
+		slice = g->slices[self];
+		if ( SLICE_NEXT( slice ) >= SLICE_END( slice ) &&
+			Sys_AtomicCompareExchange( &g->slices[self], slice, JOB_SLICE( mid + 1, last ) ) ) {
+			*start = mid;
+			*end = mid + 1;
+		} else {
+			*start = mid;
+			*end = last;
+		}
+		return qtrue;
+	}
+}
+
+/*
+=================
+Com_FinishGroup
+
+Called by the thread that completed the last job
+=================
+*/
+static void Com_FinishGroup( workGroup_t *g ) {
+	int			i, waiters;
+	qboolean	blocked;
+
+	Sys_LockMutex( workerLock );
+
+	g->handle = 0;
+
+	waiters = jobWaiters;
+	jobWaiters = 0;
+
+	// groups that waited on this one may be ready now
+	blocked = qfalse;
+	for ( i = 0 ; i < MAX_JOB_GROUPS ; i++ ) {
+		if ( groups[i].handle && !groups[i].ready ) {
+			blocked = qtrue;
+			break;
+		}
+	}
+
+	Sys_UnlockMutex( workerLock );
+
+	for ( i = 0 ; i < waiters ; i++ ) {
+		Sys_PostSemaphore( jobFinished );
+	}
+
+	if ( blocked ) {
+		for ( i = 0 ; i < numWorkers ; i++ ) {
+			Sys_PostSemaphore( workerWake );
+		}
+	}
+}
+
+/*
+=================
+Com_RunGroup
+
+Runs jobs of a pinned group until there are none left to claim
+=================
+*/
+static void Com_RunGroup( workGroup_t *g ) {
+	jobStats_t	*stats;
+	int64_t		startTime;
+	int			start, end, i, jobs, mark;
+
+	stats = g->stats;
+	startTime = ( com_speeds && com_speeds->integer ) ? Sys_Microseconds() : 0;
+	jobs = 0;
+
+	jobDepth++;
+
+	while ( Com_ClaimJobs( g, workerIndex, &start, &end ) ) {
+		for ( i = start ; i < end ; i++ ) {
+			// what the job takes of the scratch memory goes with it
+			mark = Com_ScratchMark();
+			g->func( g->data, i );
+			Com_ScratchRelease( mark );
+		}
+		jobs += end - start;
+
+		if ( Sys_AtomicAdd( &g->done, end - start ) == g->count ) {
+			Com_FinishGroup( g );
+		}
+	}
+
+	jobDepth--;
+
+	if ( startTime && jobs && stats ) {
+		Sys_AtomicAdd( &stats->jobs, jobs );
+		Sys_AtomicAdd( &stats->usec, (int)( Sys_Microseconds() - startTime ) );
+	}
+
+	Sys_LockMutex( workerLock );
+	g->users--;
+	Sys_UnlockMutex( workerLock );
+}
+
+/*
+=================
+Com_RunReadyGroups
+
+Runs jobs until no ready group has any left
+=================
+*/
+static void Com_RunReadyGroups( void ) {
+	workGroup_t	*g;
+
+	while ( 1 ) {
+		Sys_LockMutex( workerLock );
+		g = Com_NextGroup( 0 );
+		Sys_UnlockMutex( workerLock );
+
+		if ( !g ) {
+			return;
+		}
+
+		Com_RunGroup( g );
+	}
+}
+
+/*
+=================
+Com_WorkerThread
+=================
+*/
+static void Com_WorkerThread( void *arg ) {
+	workerIndex = (int)(intptr_t)arg;
+
+	// its own CPU of com_affinity, if there is one
+	Sys_PinThread( workerIndex );
+
+	while ( 1 ) {
+		Sys_WaitSemaphore( workerWake );
+
+		if ( workersQuit ) {
+			break;
+		}
+
+		Com_RunReadyGroups();
+	}
+}
+
+/*
+=================
+Com_JobStats
+
+workerLock held
+=================
+*/
+static jobStats_t *Com_JobStats( const char *name ) {
+	int		i;
+
+	for ( i = 0 ; i < numJobStats ; i++ ) {
+		if ( jobStats[i].name == name || !strcmp( jobStats[i].name, name ) ) {
+			return &jobStats[i];
+		}
+	}
+
+	if ( numJobStats == MAX_JOB_STATS ) {
+		return NULL;
+	}
+
+	jobStats[numJobStats].name = name;
+	return &jobStats[numJobStats++];
+}
+
+/*
+=================
+Com_AddJobs
+
+Queues func( data, i ) for every i in [0, count) to run once all of the
+groups in depends are done. name is kept for the job statistics, so it
+has to be a static string. Every group has to be waited for with
+Com_WaitJobs, without worker threads that is where it runs.
+=================
+*/
+jobGroup_t Com_AddJobs( const char *name, workerFunc_t func, void *data, int count, const jobGroup_t *depends, int numDepends ) {
+	workGroup_t	*g;
+	jobGroup_t	handle;
+	int			i, slot, threads, wake;
+
+	if ( count <= 0 ) {
+		return 0;
+	}
+
+	if ( numDepends > MAX_JOB_DEPENDS ) {
+		Com_Error( ERR_FATAL, "Com_AddJobs: %s has %i depends", name, numDepends );
+	}
+
+	if ( !workerLock ) {
+		Com_Error( ERR_FATAL, "Com_AddJobs: job system not initialized" );
+	}
+
+	while ( 1 ) {
+		Sys_LockMutex( workerLock );
+
+		for ( i = 0 ; i < MAX_JOB_GROUPS ; i++ ) {
+			slot = ( groupSerial + i ) & ( MAX_JOB_GROUPS - 1 );
+			if ( !groups[slot].handle && !groups[slot].users ) {
+				break;
+			}
+		}
+		if ( i < MAX_JOB_GROUPS ) {
+			break;
+		}
+
+		// all of them queued, help out the oldest one
+		handle = groups[groupSerial & ( MAX_JOB_GROUPS - 1 )].handle;
+		Sys_UnlockMutex( workerLock );
+		Com_WaitJobs( handle );
+	}
+
+	// never 0, and a slot that is reused gets a new handle
+	groupSerial = ( groupSerial + 1 ) & 0xffffff;
+	handle = ( ( groupSerial + 1 ) * MAX_JOB_GROUPS ) | slot;
+
+	g = &groups[slot];
+	g->handle = handle;
+	g->ready = qfalse;
+	g->func = func;
+	g->data = data;
+	g->count = count;
+	g->numDepends = numDepends;
+	for ( i = 0 ; i < numDepends ; i++ ) {
+		g->depends[i] = depends[i];
+	}
+
+	threads = numWorkers + 1;
+	g->sliced = count <= MAX_SLICED_JOBS ? qtrue : qfalse;
+	for ( i = 0 ; i < threads ; i++ ) {
+		g->slices[i] = g->sliced ? JOB_SLICE( count * i / threads, count * ( i + 1 ) / threads ) : 0;
+	}
+	g->next = 0;
+	g->done = 0;
+
+	g->stats = Com_JobStats( name );
+	if ( g->stats ) {
+		g->stats->groups++;
+	}
+
+	wake = Com_GroupReady( g ) ? MIN( numWorkers, count ) : 0;
+
+	Sys_UnlockMutex( workerLock );
+
+	for ( i = 0 ; i < wake ; i++ ) {
+		Sys_PostSemaphore( workerWake );
+	}
+
+	return handle;
+}
+
+/*
+=================
+Com_JobsDone
+=================
+*/
+qboolean Com_JobsDone( jobGroup_t group ) {
+	return Com_GroupDone( group );
+}
+
+/*
+=================
+Com_WaitJobs
+
+Returns once the group is done. The calling thread runs jobs of it, or of
+any other ready group, in the meantime. Can be called from inside a job.
+=================
+*/
+void Com_WaitJobs( jobGroup_t group ) {
+	workGroup_t	*g;
+
+	while ( 1 ) {
+		Sys_LockMutex( workerLock );
+
+		if ( Com_GroupDone( group ) ) {
+			Sys_UnlockMutex( workerLock );
+			return;
+		}
+
+		g = Com_NextGroup( group );
+		if ( !g ) {
+			// the last jobs are running on other threads
+			jobWaiters++;
+			Sys_UnlockMutex( workerLock );
+			Sys_WaitSemaphore( jobFinished );
+			continue;
+		}
+
+		Sys_UnlockMutex( workerLock );
+
+		Com_RunGroup( g );
+	}
+}
+
+/*
+=================
+Com_RunParallel
+
+Calls func( data, i ) for every i in [0, count) and returns once all of
+them are done. The calling thread takes part in the work. Without worker
+threads, or when called from inside a job, the loop simply runs here.
+=================
+*/
+void Com_RunParallel( workerFunc_t func, void *data, int count ) {
+	int		i;
+
+	if ( !numWorkers || jobDepth || count <= 1 ) {
+		for ( i = 0 ; i < count ; i++ ) {
+			func( data, i );
+		}
+		return;
+	}
+
+	Com_WaitJobs( Com_AddJobs( "parallel", func, data, count, NULL, 0 ) );
+}
+
+typedef struct {
+	rangeFunc_t	func;
+	void		*data;
+	int			count;
+	int			batch;
+} rangeJobs_t;
+
+/*
+=================
+Com_RangeJob
+=================
+*/
+static void Com_RangeJob( void *data, int index ) {
+	rangeJobs_t	*range = data;
+	int			start, end;
+
+	start = index * range->batch;
+	end = MIN( start + range->batch, range->count );
+
+	range->func( range->data, start, end );
+}
+
+/*
+=================
+Com_ParallelRange
+
+Calls func( data, start, end ) over batches of [0, count), at least
+minBatch long, a few for each thread so that they even out
+=================
+*/
+void Com_ParallelRange( const char *name, rangeFunc_t func, void *data, int count, int minBatch ) {
+	rangeJobs_t	range;
+	int			jobs;
+
+	if ( count <= 0 ) {
+		return;
+	}
+
+	if ( minBatch < 1 ) {
+		minBatch = 1;
+	}
+
+	jobs = MIN( count / minBatch, Com_NumWorkers() * RANGE_JOBS_PER_THREAD );
+	if ( !numWorkers || jobDepth || jobs <= 1 ) {
+		func( data, 0, count );
+		return;
+	}
+
+	range.func = func;
+	range.data = data;
+	range.count = count;
+	range.batch = ( count + jobs - 1 ) / jobs;
+
+	Com_WaitJobs( Com_AddJobs( name, Com_RangeJob, &range, ( count + range.batch - 1 ) / range.batch, NULL, 0 ) );
+}
+
+/*
+=================
+Com_NumWorkers
+
+Number of threads, including the calling one, that Com_RunParallel spreads
+its jobs over
+=================
+*/
+int Com_NumWorkers( void ) {
+	return numWorkers + 1;
+}
+
+/*
+=================
+Com_WorkerIndex
+
+1 to Com_NumWorkers() - 1 on worker threads, 0 on the main thread and any
+other thread. Lets code keep per thread state in an array sized by
+Com_NumWorkers().
+=================
+*/
+int Com_WorkerIndex( void ) {
+	return workerIndex;
+}
+
+/*
+=================
+Com_JobsFrame
+
+Returns the usec spent in jobs, on all threads, since the last call and
+clears the statistics, listing them first if print is set
+=================
+*/
+int Com_JobsFrame( qboolean print ) {
+	jobStats_t	*stats;
+	int			i, usec, jobs, total;
+
+	if ( !workerLock ) {
+		return 0;
+	}
+
+	total = 0;
+
+	Sys_LockMutex( workerLock );
+
+	for ( i = 0 ; i < numJobStats ; i++ ) {
+		stats = &jobStats[i];
+
+		usec = stats->usec;
+		jobs = stats->jobs;
+		Sys_AtomicAdd( &stats->usec, -usec );
+		Sys_AtomicAdd( &stats->jobs, -jobs );
+
+		if ( print && stats->groups ) {
+			Com_Printf( "jobs %-16s %3i groups %5i jobs %4i.%02i msec\n", stats->name, stats->groups, jobs, usec / 1000, ( usec % 1000 ) / 10 );
+		}
+		stats->groups = 0;
+
+		total += usec;
+	}
+
+	Sys_UnlockMutex( workerLock );
+
+	return total;
+}
+
+/*
+=================
+Com_ShutdownWorkers
+=================
+*/
+void Com_ShutdownWorkers( void ) {
+	int		i;
+
+	if ( !workerLock ) {
+		return;
+	}
+
+	for ( i = 0 ; i < MAX_JOB_GROUPS ; i++ ) {
+		Com_WaitJobs( groups[i].handle );
+	}
+
+	workersQuit = qtrue;
+
+	for ( i = 0 ; i < numWorkers ; i++ ) {
+		Sys_PostSemaphore( workerWake );
+	}
+
+	for ( i = 0 ; i < numWorkers ; i++ ) {
+		Sys_JoinThread( workers[i] );
+		workers[i] = NULL;
+	}
+
+	numWorkers = 0;
+	workersQuit = qfalse;
+
+	Sys_DestroySemaphore( jobFinished );
+	Sys_DestroySemaphore( workerWake );
+	Sys_DestroyMutex( workerLock );
+	jobFinished = NULL;
+	workerWake = NULL;
+	workerLock = NULL;
+}
+
+/*
+=================
+Com_InitWorkers
+=================
+*/
+void Com_InitWorkers( void ) {
+	int		i, count;
+
+	com_workerThreads = Cvar_Get( "com_workerThreads", "-1", CVAR_ARCHIVE | CVAR_LATCH );
+	Cvar_CheckRange( com_workerThreads, -1, MAX_WORKERS, qtrue );
+	Cvar_SetDescription( com_workerThreads, "Number of extra threads used for parallel engine work, -1 for one less than the CPU count, 0 disables them" );
+
+	workerLock = Sys_CreateMutex();
+	workerWake = Sys_CreateSemaphore();
+	jobFinished = Sys_CreateSemaphore();
+
+	if ( !workerLock || !workerWake || !jobFinished ) {
+		Com_Error( ERR_FATAL, "Couldn't create the job system primitives" );
+	}
+
+	count = com_workerThreads->integer;
+	if ( count < 0 ) {
+		count = Com_Clamp( 0, MAX_WORKERS, Sys_ProcessorCount() - 1 );
+	}
+
+	for ( i = 0 ; i < count ; i++ ) {
+		workers[i] = Sys_CreateThread( Com_WorkerThread, (void *)(intptr_t)( i + 1 ) );
+		if ( !workers[i] ) {
+			Com_Printf( "WARNING: couldn't create worker thread %i\n", i );
+			break;
+		}
+		numWorkers++;
+	}
+
+	if ( numWorkers ) {
+		Com_Printf( "%i worker threads started\n", numWorkers );
+	}
+}
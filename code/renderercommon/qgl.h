@@ -140,6 +140,11 @@ extern void (APIENTRYP qglUnlockArraysEXT) (void);
 	GLE(void, CompressedTexImage2D, GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void *data) \
 	GLE(void, CompressedTexSubImage2D, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void *data) \
 
+// OpenGL 1.3 but not OpenGL ES, texture readback
+#define QGL_DESKTOP_1_3_PROCS \
+	GLE(void, GetCompressedTexImage, GLenum target, GLint level, void *img) \
+	GLE(void, GetTexLevelParameteriv, GLenum target, GLint level, GLenum pname, GLint *params) \
+
 // GL_ARB_occlusion_query, built-in to OpenGL 1.5 but not OpenGL ES 2.0
 #define QGL_ARB_occlusion_query_PROCS \
 	GLE(void, GenQueries, GLsizei n, GLuint *ids) \
@@ -185,6 +190,7 @@ extern void (APIENTRYP qglUnlockArraysEXT) (void);
 	GLE(void, Uniform4f, GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) \
 	GLE(void, Uniform1i, GLint location, GLint v0) \
 	GLE(void, Uniform1fv, GLint location, GLsizei count, const GLfloat *value) \
+	GLE(void, Uniform4fv, GLint location, GLsizei count, const GLfloat *value) \
 	GLE(void, UniformMatrix4fv, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) \
 	GLE(void, ValidateProgram, GLuint program) \
 	GLE(void, VertexAttribPointer, GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer) \
@@ -263,6 +269,41 @@ extern void (APIENTRYP qglUnlockArraysEXT) (void);
 	GLE(void, DeleteVertexArrays, GLsizei n, const GLuint *arrays) \
 	GLE(void, GenVertexArrays, GLsizei n, GLuint *arrays) \
 
+// GL_ARB_get_program_binary, built-in to OpenGL 4.1
+#define QGL_ARB_get_program_binary_PROCS \
+	GLE(void, GetProgramBinary, GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary) \
+	GLE(void, ProgramBinary, GLuint program, GLenum binaryFormat, const void *binary, GLsizei length) \
+	GLE(void, ProgramParameteri, GLuint program, GLenum pname, GLint value) \
+
+// GL_ARB_buffer_storage, built-in to OpenGL 4.4, with GL_ARB_map_buffer_range and GL_ARB_sync
+#define QGL_ARB_buffer_storage_PROCS \
+	GLE(void, BufferStorage, GLenum target, GLsizeiptr size, const void *data, GLbitfield flags) \
+	GLE(void *, MapBufferRange, GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) \
+	GLE(GLsync, FenceSync, GLenum condition, GLbitfield flags) \
+	GLE(GLenum, ClientWaitSync, GLsync sync, GLbitfield flags, GLuint64 timeout) \
+	GLE(void, DeleteSync, GLsync sync) \
+
+// GL_ARB_pixel_buffer_object, built-in to OpenGL 2.1, mapped with MapBufferRange
+#define QGL_ARB_pixel_buffer_object_PROCS \
+	GLE(GLboolean, UnmapBuffer, GLenum target) \
+
+// GL_ARB_timer_query, built-in to OpenGL 3.3, GetInteger64v is OpenGL 3.2
+#define QGL_ARB_timer_query_PROCS \
+	GLE(void, QueryCounter, GLuint id, GLenum target) \
+	GLE(void, GetQueryObjectui64v, GLuint id, GLenum pname, GLuint64 *params) \
+	GLE(void, GetInteger64v, GLenum pname, GLint64 *data) \
+
+// GL_EXT_texture_array, built-in to OpenGL 3.0, TexImage3D is OpenGL 1.2
+#define QGL_EXT_texture_array_PROCS \
+	GLE(void, TexImage3D, GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels) \
+	GLE(void, TexSubImage3D, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels) \
+
+#ifndef GL_EXT_texture_array
+#define GL_EXT_texture_array
+#define GL_TEXTURE_2D_ARRAY_EXT                       0x8C1A
+#define GL_MAX_ARRAY_TEXTURE_LAYERS_EXT               0x88FF
+#endif
+
 #ifndef GL_ARB_texture_compression_rgtc
 #define GL_ARB_texture_compression_rgtc
 #define GL_COMPRESSED_RED_RGTC1                       0x8DBB
@@ -296,6 +337,8 @@ extern void (APIENTRYP qglUnlockArraysEXT) (void);
 	GLE(GLvoid, TextureParameteriEXT, GLuint texture, GLenum target, GLenum pname, GLint param) \
 	GLE(GLvoid, TextureImage2DEXT, GLuint texture, GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels) \
 	GLE(GLvoid, TextureSubImage2DEXT, GLuint texture, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels) \
+	GLE(GLvoid, TextureImage3DEXT, GLuint texture, GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const GLvoid *pixels) \
+	GLE(GLvoid, TextureSubImage3DEXT, GLuint texture, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const GLvoid *pixels) \
 	GLE(GLvoid, CopyTextureSubImage2DEXT, GLuint texture, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height) \
 	GLE(GLvoid, CompressedTextureImage2DEXT, GLuint texture, GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid *data) \
 	GLE(GLvoid, CompressedTextureSubImage2DEXT, GLuint texture, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const GLvoid *data) \
@@ -306,6 +349,7 @@ extern void (APIENTRYP qglUnlockArraysEXT) (void);
 	GLE(GLvoid, ProgramUniform3fEXT, GLuint program, GLint location, GLfloat v0, GLfloat v1, GLfloat v2) \
 	GLE(GLvoid, ProgramUniform4fEXT, GLuint program, GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) \
 	GLE(GLvoid, ProgramUniform1fvEXT, GLuint program, GLint location, GLsizei count, const GLfloat *value) \
+	GLE(GLvoid, ProgramUniform4fvEXT, GLuint program, GLint location, GLsizei count, const GLfloat *value) \
 	GLE(GLvoid, ProgramUniformMatrix4fvEXT, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) \
 	GLE(GLvoid, NamedRenderbufferStorageEXT, GLuint renderbuffer, GLenum internalformat, GLsizei width, GLsizei height) \
 	GLE(GLvoid, NamedRenderbufferStorageMultisampleEXT, GLuint renderbuffer, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height) \
@@ -321,12 +365,18 @@ QGL_DESKTOP_1_1_FIXED_FUNCTION_PROCS;
 QGL_ES_1_1_PROCS;
 QGL_ES_1_1_FIXED_FUNCTION_PROCS;
 QGL_1_3_PROCS;
+QGL_DESKTOP_1_3_PROCS;
 QGL_1_5_PROCS;
 QGL_2_0_PROCS;
 QGL_3_0_PROCS;
 QGL_ARB_occlusion_query_PROCS;
 QGL_ARB_framebuffer_object_PROCS;
 QGL_ARB_vertex_array_object_PROCS;
+QGL_ARB_get_program_binary_PROCS;
+QGL_ARB_buffer_storage_PROCS;
+QGL_ARB_pixel_buffer_object_PROCS;
+QGL_ARB_timer_query_PROCS;
+QGL_EXT_texture_array_PROCS;
 QGL_EXT_direct_state_access_PROCS;
 #undef GLE
 
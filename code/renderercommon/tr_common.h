@@ -44,6 +44,7 @@ typedef enum
 	IMGFLAG_NOLIGHTSCALE   = 0x0020,
 	IMGFLAG_CLAMPTOEDGE    = 0x0040,
 	IMGFLAG_GENNORMALMAP   = 0x0080,
+	IMGFLAG_ARRAY          = 0x0100,	// renderergl2 lightmap layers
 } imgFlags_t;
 
 typedef struct image_s {
@@ -114,6 +115,7 @@ extern cvar_t *r_ext_max_anisotropy;
 extern cvar_t *r_stereoEnabled;
 
 extern	cvar_t	*r_saveFontData;
+extern	cvar_t	*r_modelCache;			// megabytes of model files kept across map changes
 
 qboolean	R_GetModeInfo( int *width, int *height, float *windowAspect, int mode );
 
@@ -148,6 +150,47 @@ void R_LoadPCX( const char *name, byte **pic, int *width, int *height );
 void R_LoadPNG( const char *name, byte **pic, int *width, int *height );
 void R_LoadTGA( const char *name, byte **pic, int *width, int *height );
 
+// picmip halvings R_LoadJPG may do while decoding the next images, and
+// how many it did for the last one
+void R_SetJPGPicmip( int picmip );
+int R_JPGPicmipDone( void );
+
+// picmip is what the shaders' images will most likely ask for
+void R_PrefetchJPGs( const char **names, int numNames, int budget, int picmip );
+void R_FlushPrefetchedJPGs( void );
+
+size_t R_WorkerSaveJPGToBuffer( byte *buffer, size_t bufSize, int quality,
+	int image_width, int image_height, byte *image_buffer, int padding );
+
+/*
+=============================================================
+
+SCREENSHOTS
+
+=============================================================
+*/
+
+// pixels are malloced bottom up RGB rows, padlen apart, and are freed
+// once the file is written
+void R_QueueScreenshot( const char *fileName, qboolean jpeg, int quality, qboolean gamma,
+	byte *pixels, int width, int height, int padlen );
+void R_FinishScreenshots( qboolean wait );
+
+// in each renderer's tr_image.c, called by the screenshot jobs
+void R_GammaCorrect( byte *buffer, int bufSize );
+
+/*
+=============================================================
+
+MODEL FILES
+
+=============================================================
+*/
+
+long R_ReadModelFile( const char *name, void **buf );
+void R_FreeModelFile( void *buf );
+void R_ShutdownModelCache( void );
+
 /*
 ====================================================================
 
@@ -162,6 +205,14 @@ void		GLimp_EndFrame( void );
 
 void		GLimp_LogComment( char *comment );
 void		GLimp_Minimize(void);
+void		GLimp_CheckFullscreen( void );
+
+// render thread, the GL context is current on whichever side is running
+qboolean	GLimp_SpawnRenderThread( void (*function)( void ) );
+void		GLimp_ShutdownRenderThread( void );
+void		*GLimp_RendererSleep( void );
+void		GLimp_FrontEndSleep( void );
+void		GLimp_WakeRenderer( void *data );
 
 void		GLimp_SetGamma( unsigned char red[256],
 		unsigned char green[256],
@@ -44,12 +44,23 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #  endif
 #endif
 
+#ifdef JCS_EXTENSIONS
+#  define JPEG_OUTPUT_COMPONENTS 4
+#else
+#  define JPEG_OUTPUT_COMPONENTS 3
+#endif
+
+#define JPEG_OUTPUT_ROWS 16	/* scanlines per jpeg_read_scanlines */
+#define JPEG_MAX_PICMIP 3	/* libjpeg scales down to 1/8 */
+
 /* Catching errors, as done in libjpeg's example.c */
 typedef struct q_jpeg_error_mgr_s
 {
   struct jpeg_error_mgr pub;  /* "public" fields */
 
   jmp_buf setjmp_buffer;  /* for return to caller */
+
+  qboolean worker;  /* decoding for R_PrefetchJPGs, stay quiet */
 } q_jpeg_error_mgr_t;
 
 static void R_JPGErrorExit(j_common_ptr cinfo)
@@ -59,9 +70,12 @@ static void R_JPGErrorExit(j_common_ptr cinfo)
   /* cinfo->err really points to a q_jpeg_error_mgr_s struct, so coerce pointer */
   q_jpeg_error_mgr_t *jerr = (q_jpeg_error_mgr_t *)cinfo->err;
   
-  (*cinfo->err->format_message) (cinfo, buffer);
+  if (!jerr->worker)
+  {
+    (*cinfo->err->format_message) (cinfo, buffer);
 
-  ri.Printf(PRINT_ALL, "Error: %s", buffer);
+    ri.Printf(PRINT_ALL, "Error: %s", buffer);
+  }
 
   /* Return control to the setjmp point */
   longjmp(jerr->setjmp_buffer, 1);
@@ -70,6 +84,10 @@ static void R_JPGErrorExit(j_common_ptr cinfo)
 static void R_JPGOutputMessage(j_common_ptr cinfo)
 {
   char buffer[JMSG_LENGTH_MAX];
+  q_jpeg_error_mgr_t *jerr = (q_jpeg_error_mgr_t *)cinfo->err;
+
+  if (jerr->worker)
+    return;
   
   /* Create the message */
   (*cinfo->err->format_message) (cinfo, buffer);
@@ -78,7 +96,13 @@ static void R_JPGOutputMessage(j_common_ptr cinfo)
   ri.Printf(PRINT_ALL, "%s\n", buffer);
 }
 
-void R_LoadJPG(const char *filename, unsigned char **pic, int *width, int *height)
+/*
+ * Decodes a JPEG file already in memory. On a worker thread nothing may
+ * be printed and the pixels come from malloc instead of ri.Malloc. An
+ * invalid image format is described in error and NULL is returned.
+ */
+static byte *R_DecodeJPG(const char *filename, byte *data, int len, int *width, int *height,
+  int picmip, qboolean worker, char *error, int errorSize)
 {
   /* This struct contains the JPEG decompression parameters and pointers to
    * working space (which is allocated as needed by the JPEG library).
@@ -98,28 +122,14 @@ void R_LoadJPG(const char *filename, unsigned char **pic, int *width, int *heigh
    */
   q_jpeg_error_mgr_t jerr;
   /* More stuff */
-  JSAMPARRAY buffer;		/* Output row buffer */
+  JSAMPROW rows[JPEG_OUTPUT_ROWS];	/* where the next scanlines go */
   unsigned int row_stride;	/* physical row width in output buffer */
   unsigned int pixelcount, memcount;
-  unsigned int sindex, dindex;
+  unsigned int first, count, i;
   byte *out;
-  int len;
-	union {
-		byte *b;
-		void *v;
-	} fbuffer;
   byte  *buf;
 
-  /* In this example we want to open the input file before doing anything else,
-   * so that the setjmp() error recovery below can assume the file is open.
-   * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-   * requires it in order to read binary files.
-   */
-
-  len = ri.FS_ReadFile ( ( char * ) filename, &fbuffer.v);
-  if (!fbuffer.b || len < 0) {
-	return;
-  }
+  error[0] = '\0';
 
   /* Step 1: allocate and initialize JPEG decompression object */
 
@@ -131,19 +141,20 @@ void R_LoadJPG(const char *filename, unsigned char **pic, int *width, int *heigh
   cinfo.err = jpeg_std_error(&jerr.pub);
   cinfo.err->error_exit = R_JPGErrorExit;
   cinfo.err->output_message = R_JPGOutputMessage;
+  jerr.worker = worker;
 
   /* Establish the setjmp return context for R_JPGErrorExit to use. */
   if (setjmp(jerr.setjmp_buffer))
   {
     /* If we get here, the JPEG code has signaled an error.
-     * We need to clean up the JPEG object, close the input file, and return.
+     * We need to clean up the JPEG object and return.
      */
     jpeg_destroy_decompress(&cinfo);
-    ri.FS_FreeFile(fbuffer.v);
 
     /* Append the filename to the error for easier debugging */
-    ri.Printf(PRINT_ALL, ", loading file %s\n", filename);
-    return;
+    if (!worker)
+      ri.Printf(PRINT_ALL, ", loading file %s\n", filename);
+    return NULL;
   }
 
   /* Now we can initialize the JPEG decompression object. */
@@ -151,7 +162,7 @@ void R_LoadJPG(const char *filename, unsigned char **pic, int *width, int *heigh
 
   /* Step 2: specify data source (eg, a file) */
 
-  jpeg_mem_src(&cinfo, fbuffer.b, len);
+  jpeg_mem_src(&cinfo, data, len);
 
   /* Step 3: read file parameters with jpeg_read_header() */
 
@@ -168,7 +179,19 @@ void R_LoadJPG(const char *filename, unsigned char **pic, int *width, int *heigh
    * Make sure it always converts images to RGB color space. This will
    * automatically convert 8-bit greyscale images to RGB as well.
    */
+#ifdef JCS_EXTENSIONS
+  /* libjpeg-turbo writes the RGBA itself */
+  cinfo.out_color_space = JCS_EXT_RGBA;
+#else
   cinfo.out_color_space = JCS_RGB;
+#endif
+
+  /* picmip in the DCT domain */
+  if (picmip > 0)
+  {
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 1 << picmip;
+  }
 
   /* Step 5: Start decompressor */
 
@@ -189,21 +212,26 @@ void R_LoadJPG(const char *filename, unsigned char **pic, int *width, int *heigh
 
   if(!cinfo.output_width || !cinfo.output_height
       || ((pixelcount * 4) / cinfo.output_width) / 4 != cinfo.output_height
-      || pixelcount > 0x1FFFFFFF || cinfo.output_components != 3
+      || pixelcount > 0x1FFFFFFF || cinfo.output_components != JPEG_OUTPUT_COMPONENTS
     )
   {
+    Com_sprintf(error, errorSize, "LoadJPG: %s has an invalid image format: %dx%d*4=%d, components: %d", filename,
+		    cinfo.output_width, cinfo.output_height, pixelcount * 4, cinfo.output_components);
+
     // Free the memory to make sure we don't leak memory
-    ri.FS_FreeFile (fbuffer.v);
     jpeg_destroy_decompress(&cinfo);
-  
-    ri.Error(ERR_DROP, "LoadJPG: %s has an invalid image format: %dx%d*4=%d, components: %d", filename,
-		    cinfo.output_width, cinfo.output_height, pixelcount * 4, cinfo.output_components);
+    return NULL;
   }
 
   memcount = pixelcount * 4;
-  row_stride = cinfo.output_width * cinfo.output_components;
+  row_stride = cinfo.output_width * 4;
 
-  out = ri.Malloc(memcount);
+  out = worker ? malloc(memcount) : ri.Malloc(memcount);
+  if (!out)
+  {
+    jpeg_destroy_decompress(&cinfo);
+    return NULL;
+  }
 
   *width = cinfo.output_width;
   *height = cinfo.output_height;
@@ -213,32 +241,38 @@ void R_LoadJPG(const char *filename, unsigned char **pic, int *width, int *heigh
 
   /* Here we use the library's state variable cinfo.output_scanline as the
    * loop counter, so that we don't have to keep track ourselves.
+   *
+   * The scanlines are read as many at a time as the decoder produces
+   * them, each one straight into its row of the output. RGB lands at the
+   * end of the row and is spread out to RGBA from the front, which never
+   * overwrites a pixel before it has been read.
    */
   while (cinfo.output_scanline < cinfo.output_height) {
-    /* jpeg_read_scanlines expects an array of pointers to scanlines.
-     * Here the array is only one element long, but you could ask for
-     * more than one scanline at a time if that's more convenient.
-     */
-	buf = ((out+(row_stride*cinfo.output_scanline)));
-	buffer = &buf;
-    (void) jpeg_read_scanlines(&cinfo, buffer, 1);
+    first = cinfo.output_scanline;
+    count = MIN(cinfo.output_height - first, JPEG_OUTPUT_ROWS);
+
+    for (i = 0; i < count; i++)
+      rows[i] = out + row_stride * (first + i) + (cinfo.output_width * (4 - JPEG_OUTPUT_COMPONENTS));
+
+    count = jpeg_read_scanlines(&cinfo, rows, count);
+
+#ifndef JCS_EXTENSIONS
+    for (i = 0; i < count; i++)
+    {
+      byte *src = rows[i];
+      unsigned int x;
+
+      buf = out + row_stride * (first + i);
+      for (x = 0; x < cinfo.output_width; x++, buf += 4, src += 3)
+      {
+        buf[0] = src[0];
+        buf[1] = src[1];
+        buf[2] = src[2];
+        buf[3] = 255;
+      }
+    }
+#endif
   }
-  
-  buf = out;
-
-  // Expand from RGB to RGBA
-  sindex = pixelcount * cinfo.output_components;
-  dindex = memcount;
-
-  do
-  {	
-    buf[--dindex] = 255;
-    buf[--dindex] = buf[--sindex];
-    buf[--dindex] = buf[--sindex];
-    buf[--dindex] = buf[--sindex];
-  } while(sindex);
-
-  *pic = out;
 
   /* Step 7: Finish decompression */
 
@@ -252,18 +286,236 @@ void R_LoadJPG(const char *filename, unsigned char **pic, int *width, int *heigh
   /* This is an important step since it will release a good deal of memory. */
   jpeg_destroy_decompress(&cinfo);
 
-  /* After finish_decompress, we can close the input file.
-   * Here we postpone it until after no more JPEG errors are possible,
-   * so as to simplify the setjmp error logic above.  (Actually, I don't
-   * think that jpeg_destroy can do an error exit, but why assume anything...)
-   */
-  ri.FS_FreeFile (fbuffer.v);
-
   /* At this point you may want to check to see whether any corrupt-data
    * warnings occurred (test whether jerr.pub.num_warnings is nonzero).
    */
 
   /* And we're done! */
+  return out;
+}
+
+/*
+ * Map loads spend most of their time decoding JPEGs, one after the other
+ * as shaders get parsed. R_PrefetchJPGs reads the files a map is going to
+ * use on the calling thread, decodes them on the engine worker threads and
+ * keeps the pixels until R_LoadJPG asks for them. Files that fail to
+ * decode here are simply left to R_LoadJPG, which reports the error.
+ */
+#define PREFETCH_BATCH_PER_THREAD	2
+
+typedef struct {
+  char name[MAX_QPATH];
+  byte *data;			/* file contents while decoding */
+  int len;
+  byte *pic;			/* from malloc */
+  int width, height;
+  int picmip;			/* halvings done while decoding */
+} jpgPrefetch_t;
+
+static jpgPrefetch_t *jpgPrefetch;
+static int numJpgPrefetch;
+
+/*
+ * A picmipped image gets resampled down to 1/2^r_picmip of its size on
+ * upload anyway, and libjpeg can decode it at that size for a fraction
+ * of the work. R_FindImageFile says how many halvings the image it loads
+ * may have with R_SetJPGPicmip and takes the picmip out of the upload
+ * for what R_JPGPicmipDone says was done.
+ */
+static int jpgPicmip;
+static int jpgPicmipDone;
+
+void R_SetJPGPicmip(int picmip)
+{
+  /* more than libjpeg can do is left to the upload altogether */
+  jpgPicmip = (picmip > 0 && picmip <= JPEG_MAX_PICMIP) ? picmip : 0;
+  jpgPicmipDone = 0;
+}
+
+int R_JPGPicmipDone(void)
+{
+  return jpgPicmipDone;
+}
+
+static void R_PrefetchJPGJob(void *data, int index)
+{
+  jpgPrefetch_t *entry = (jpgPrefetch_t *)data + index;
+  char error[MAX_STRING_CHARS];
+
+  entry->pic = R_DecodeJPG(entry->name, entry->data, entry->len, &entry->width, &entry->height,
+    entry->picmip, qtrue, error, sizeof(error));
+}
+
+static qboolean R_TakePrefetchedJPG(const char *filename, byte **pic, int *width, int *height)
+{
+  jpgPrefetch_t *entry;
+  int i, size;
+
+  for (i = 0, entry = jpgPrefetch; i < numJpgPrefetch; i++, entry++)
+  {
+    if (!entry->pic || entry->picmip != jpgPicmip || Q_stricmp(entry->name, filename))
+      continue;
+
+    size = entry->width * entry->height * 4;
+    *pic = ri.Malloc(size);
+    Com_Memcpy(*pic, entry->pic, size);
+    *width = entry->width;
+    *height = entry->height;
+
+    free(entry->pic);
+    entry->pic = NULL;
+    jpgPicmipDone = entry->picmip;
+    return qtrue;
+  }
+
+  return qfalse;
+}
+
+/*
+ * Which file R_LoadImage ends up loading for a shader image name, if it
+ * is a JPEG. A TGA of the same name takes precedence.
+ */
+static qboolean R_PrefetchJPGName(const char *name, char *filename, int size)
+{
+  char base[MAX_QPATH];
+  const char *ext = COM_GetExtension(name);
+
+  if (!Q_stricmp(ext, "jpg") || !Q_stricmp(ext, "jpeg"))
+  {
+    Q_strncpyz(filename, name, size);
+    return ri.FS_ReadFile(filename, NULL) > 0;
+  }
+
+  if (*ext && ri.FS_ReadFile(name, NULL) > 0)
+    return qfalse;
+
+  COM_StripExtension(name, base, sizeof(base));
+  if (ri.FS_ReadFile(va("%s.tga", base), NULL) > 0)
+    return qfalse;
+
+  Com_sprintf(filename, size, "%s.jpg", base);
+  return ri.FS_ReadFile(filename, NULL) > 0;
+}
+
+void R_PrefetchJPGs(const char **names, int numNames, int budget, int picmip)
+{
+  jpgPrefetch_t *entry;
+  char filename[MAX_QPATH];
+  int i, j, first, batch, used, count, start;
+
+  R_FlushPrefetchedJPGs();
+
+  if (budget <= 0 || !numNames || ri.Com_NumWorkers() < 2)
+    return;
+
+  start = ri.Milliseconds();
+
+  jpgPrefetch = ri.Malloc(numNames * sizeof(*jpgPrefetch));
+
+  for (i = 0; i < numNames; i++)
+  {
+    if (!R_PrefetchJPGName(names[i], filename, sizeof(filename)))
+      continue;
+
+    for (j = 0; j < numJpgPrefetch; j++)
+    {
+      if (!Q_stricmp(jpgPrefetch[j].name, filename))
+        break;
+    }
+
+    if (j == numJpgPrefetch)
+    {
+      entry = &jpgPrefetch[numJpgPrefetch++];
+      Com_Memset(entry, 0, sizeof(*entry));
+      Q_strncpyz(entry->name, filename, sizeof(entry->name));
+      entry->picmip = (picmip > 0 && picmip <= JPEG_MAX_PICMIP) ? picmip : 0;
+    }
+  }
+
+  // the filesystem isn't thread safe, so files are read here a batch at a
+  // time until the decoded pixels use up the budget
+  batch = ri.Com_NumWorkers() * PREFETCH_BATCH_PER_THREAD;
+  used = 0;
+  count = 0;
+
+  for (first = 0; first < numJpgPrefetch && used < budget; first += batch)
+  {
+    if (first + batch > numJpgPrefetch)
+      batch = numJpgPrefetch - first;
+
+    for (i = first; i < first + batch; i++)
+    {
+      entry = &jpgPrefetch[i];
+      entry->len = ri.FS_ReadFile(entry->name, (void **)&entry->data);
+      if (!entry->data || entry->len <= 0)
+        entry->len = 0;
+    }
+
+    ri.Com_RunParallel(R_PrefetchJPGJob, jpgPrefetch + first, batch);
+
+    for (i = first; i < first + batch; i++)
+    {
+      entry = &jpgPrefetch[i];
+      if (entry->data)
+      {
+        ri.FS_FreeFile(entry->data);
+        entry->data = NULL;
+      }
+
+      if (entry->pic)
+      {
+        used += entry->width * entry->height * 4;
+        count++;
+      }
+    }
+  }
+
+  ri.Printf(PRINT_DEVELOPER, "decoded %i of %i JPEGs ahead, %i KB in %i msec\n",
+    count, numJpgPrefetch, used / 1024, ri.Milliseconds() - start);
+}
+
+void R_FlushPrefetchedJPGs(void)
+{
+  int i;
+
+  for (i = 0; i < numJpgPrefetch; i++)
+  {
+    if (jpgPrefetch[i].pic)
+      free(jpgPrefetch[i].pic);
+  }
+
+  if (jpgPrefetch)
+    ri.Free(jpgPrefetch);
+
+  jpgPrefetch = NULL;
+  numJpgPrefetch = 0;
+}
+
+void R_LoadJPG(const char *filename, unsigned char **pic, int *width, int *height)
+{
+  char error[MAX_STRING_CHARS];
+  int len;
+	union {
+		byte *b;
+		void *v;
+	} fbuffer;
+
+  if (R_TakePrefetchedJPG(filename, pic, width, height))
+    return;
+
+  len = ri.FS_ReadFile ( ( char * ) filename, &fbuffer.v);
+  if (!fbuffer.b || len < 0) {
+	return;
+  }
+
+  *pic = R_DecodeJPG(filename, fbuffer.b, len, width, height, jpgPicmip, qfalse, error, sizeof(error));
+  if (*pic)
+    jpgPicmipDone = jpgPicmip;
+
+  ri.FS_FreeFile (fbuffer.v);
+
+  if (error[0])
+    ri.Error(ERR_DROP, "%s", error);
 }
 
 
@@ -321,8 +573,13 @@ static boolean
 empty_output_buffer (j_compress_ptr cinfo)
 {
   my_dest_ptr dest = (my_dest_ptr) cinfo->dest;
+  q_jpeg_error_mgr_t *jerr = (q_jpeg_error_mgr_t *)cinfo->err;
   
   jpeg_destroy_compress(cinfo);
+
+  /* a worker can't stop the game, it gives up on the image */
+  if (jerr->worker)
+    longjmp(jerr->setjmp_buffer, 1);
   
   // Make crash fatal or we would probably leak memory.
   ri.Error(ERR_FATAL, "Output buffer for encoded JPEG image has insufficient size of %d bytes",
@@ -378,14 +635,15 @@ jpegDest (j_compress_ptr cinfo, byte* outfile, int size)
 
 /*
 =================
-SaveJPGToBuffer
+R_EncodeJPG
 
 Encodes JPEG from image in image_buffer and writes to buffer.
-Expects RGB input data
+Expects RGB input data. On a worker thread nothing may be printed and 0
+is returned if the image doesn't fit into buffer
 =================
 */
-size_t RE_SaveJPGToBuffer(byte *buffer, size_t bufSize, int quality,
-    int image_width, int image_height, byte *image_buffer, int padding)
+static size_t R_EncodeJPG(byte *buffer, size_t bufSize, int quality,
+    int image_width, int image_height, byte *image_buffer, int padding, qboolean worker)
 {
   struct jpeg_compress_struct cinfo;
   q_jpeg_error_mgr_t jerr;
@@ -398,6 +656,7 @@ size_t RE_SaveJPGToBuffer(byte *buffer, size_t bufSize, int quality,
   cinfo.err = jpeg_std_error(&jerr.pub);
   cinfo.err->error_exit = R_JPGErrorExit;
   cinfo.err->output_message = R_JPGOutputMessage;
+  jerr.worker = worker;
 
   /* Establish the setjmp return context for R_JPGErrorExit to use. */
   if (setjmp(jerr.setjmp_buffer))
@@ -407,7 +666,8 @@ size_t RE_SaveJPGToBuffer(byte *buffer, size_t bufSize, int quality,
      */
     jpeg_destroy_compress(&cinfo);
 
-    ri.Printf(PRINT_ALL, "\n");
+    if (!worker)
+      ri.Printf(PRINT_ALL, "\n");
     return 0;
   }
 
@@ -461,6 +721,30 @@ size_t RE_SaveJPGToBuffer(byte *buffer, size_t bufSize, int quality,
   return outcount;
 }
 
+/*
+=================
+SaveJPGToBuffer
+=================
+*/
+size_t RE_SaveJPGToBuffer(byte *buffer, size_t bufSize, int quality,
+    int image_width, int image_height, byte *image_buffer, int padding)
+{
+  return R_EncodeJPG(buffer, bufSize, quality, image_width, image_height, image_buffer, padding, qfalse);
+}
+
+/*
+=================
+R_WorkerSaveJPGToBuffer
+
+RE_SaveJPGToBuffer for a job
+=================
+*/
+size_t R_WorkerSaveJPGToBuffer(byte *buffer, size_t bufSize, int quality,
+    int image_width, int image_height, byte *image_buffer, int padding)
+{
+  return R_EncodeJPG(buffer, bufSize, quality, image_width, image_height, image_buffer, padding, qtrue);
+}
+
 void RE_SaveJPG(char * filename, int quality, int image_width, int image_height, byte *image_buffer, int padding)
 {
   byte *out;
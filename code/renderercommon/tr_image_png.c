@@ -21,7 +21,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "tr_common.h"
 
-#include "../qcommon/puff.h"
+#if defined( __SSE2__ ) || idx64
+#include <emmintrin.h>
+#define USE_SSE2_UNFILTER
+#endif
 
 // we could limit the png size to a lower value here
 #ifndef INT_MAX
@@ -500,18 +503,112 @@ static qboolean FindChunk(struct BufferedFile *BF, uint32_t ChunkType)
 	return(qtrue);
 }
 
+/*
+ *  The length of the decompressed data, the scanlines of all passes
+ *  each with its FilterType byte. Zero if the image is too big.
+ */
+
+static uint32_t DecompressedLength(struct PNG_Chunk_IHDR *IHDR)
+{
+	/*
+	 *  WOffset, WSkip, HOffset, HSkip of the Adam7 passes
+	 */
+
+	static const uint8_t Adam7[PNG_Adam7_NumPasses][4] =
+	{
+		{0, 8, 0, 8}, {4, 8, 0, 8}, {0, 4, 4, 8}, {2, 4, 0, 4},
+		{0, 2, 2, 4}, {1, 2, 0, 2}, {0, 1, 1, 2}
+	};
+
+	uint64_t IHDR_Width, IHDR_Height;
+	uint64_t PassWidth, PassHeight, BytesPerScanline;
+	uint64_t BitsPerPixel, Length;
+	uint32_t a;
+
+	IHDR_Width  = BigLong(IHDR->Width);
+	IHDR_Height = BigLong(IHDR->Height);
+
+	switch(IHDR->ColourType)
+	{
+		case PNG_ColourType_True :
+		{
+			BitsPerPixel = IHDR->BitDepth * PNG_NumColourComponents_True;
+
+			break;
+		}
+
+		case PNG_ColourType_GreyAlpha :
+		{
+			BitsPerPixel = IHDR->BitDepth * PNG_NumColourComponents_GreyAlpha;
+
+			break;
+		}
+
+		case PNG_ColourType_TrueAlpha :
+		{
+			BitsPerPixel = IHDR->BitDepth * PNG_NumColourComponents_TrueAlpha;
+
+			break;
+		}
+
+		default :
+		{
+			/*
+			 *  Grey and Indexed are one component.
+			 */
+
+			BitsPerPixel = IHDR->BitDepth;
+
+			break;
+		}
+	}
+
+	if(IHDR->InterlaceMethod == PNG_InterlaceMethod_NonInterlaced)
+	{
+		Length = ((IHDR_Width * BitsPerPixel + 7) / 8 + 1) * IHDR_Height;
+	}
+	else
+	{
+		Length = 0;
+
+		for(a = 0; a < PNG_Adam7_NumPasses; a++)
+		{
+			PassWidth  = (IHDR_Width  + Adam7[a][1] - 1 - Adam7[a][0]) / Adam7[a][1];
+			PassHeight = (IHDR_Height + Adam7[a][3] - 1 - Adam7[a][2]) / Adam7[a][3];
+
+			BytesPerScanline = (PassWidth * BitsPerPixel + 7) / 8;
+
+			if(BytesPerScanline)
+			{
+				Length += (BytesPerScanline + 1) * PassHeight;
+			}
+		}
+	}
+
+	if(Length > INT_MAX)
+	{
+		return(0);
+	}
+
+	return((uint32_t) Length);
+}
+
 /*
  *  Decompress all IDATs
+ *
+ *  The IHDR tells how long the data is, so it is inflated once straight
+ *  into a buffer of that size. A single IDAT is inflated from where it
+ *  lies in the file buffer, only split ones get copied together first.
  */
 
-static uint32_t DecompressIDATs(struct BufferedFile *BF, uint8_t **Buffer)
+static uint32_t DecompressIDATs(struct BufferedFile *BF, uint32_t DecompressedDataLength, uint8_t **Buffer)
 {
 	uint8_t  *DecompressedData;
-	uint32_t  DecompressedDataLength;
 
 	uint8_t  *CompressedData;
 	uint8_t  *CompressedDataPtr;
 	uint32_t  CompressedDataLength;
+	uint32_t  NumChunks;
 
 	struct PNG_ChunkHeader *CH;
 
@@ -520,19 +617,13 @@ static uint32_t DecompressIDATs(struct BufferedFile *BF, uint8_t **Buffer)
 
 	int BytesToRewind;
 
-	int32_t   puffResult;
-	uint8_t  *puffDest;
-	uint32_t  puffDestLen;
-	uint8_t  *puffSrc;
-	uint32_t  puffSrcLen;
-
 	/*
 	 *  input verification
 	 */
 
-	if(!(BF && Buffer))
+	if(!(BF && Buffer && DecompressedDataLength))
 	{
-		return(-1);
+		return(0);
 	}
 
 	/*
@@ -544,6 +635,7 @@ static uint32_t DecompressIDATs(struct BufferedFile *BF, uint8_t **Buffer)
 
 	CompressedData = NULL;
 	CompressedDataLength = 0;
+	NumChunks = 0;
 
 	BytesToRewind = 0;
 
@@ -553,11 +645,11 @@ static uint32_t DecompressIDATs(struct BufferedFile *BF, uint8_t **Buffer)
 
 	if(!FindChunk(BF, PNG_ChunkType_IDAT))
 	{
-		return(-1);
+		return(0);
 	}
 
 	/*
-	 *  Count the size of the uncompressed data
+	 *  Count the size of the compressed data
 	 */
 
 	while(qtrue)
@@ -576,7 +668,7 @@ static uint32_t DecompressIDATs(struct BufferedFile *BF, uint8_t **Buffer)
 
 			BufferedFileRewind(BF, BytesToRewind);
 
-			return(-1);
+			return(0);
 		}
 
 		/*
@@ -604,29 +696,43 @@ static uint32_t DecompressIDATs(struct BufferedFile *BF, uint8_t **Buffer)
 		BytesToRewind += PNG_ChunkHeader_Size;
 
 		/*
-		 *  Skip to next chunk
+		 *  Skip to next chunk, an empty one still has its CRC.
 		 */
 
-		if(Length)
+		if(!BufferedFileSkip(BF, Length + PNG_ChunkCRC_Size))
 		{
-			if(!BufferedFileSkip(BF, Length + PNG_ChunkCRC_Size))
-			{
-				BufferedFileRewind(BF, BytesToRewind);
+			BufferedFileRewind(BF, BytesToRewind);
 
-				return(-1);
-			}
+			return(0);
+		}
 
-			BytesToRewind += Length + PNG_ChunkCRC_Size;
+		BytesToRewind += Length + PNG_ChunkCRC_Size;
+
+		if(Length)
+		{
 			CompressedDataLength += Length;
+			NumChunks++;
 		} 
 	}
 
 	BufferedFileRewind(BF, BytesToRewind);
 
-	CompressedData = ri.Malloc(CompressedDataLength);
-	if(!CompressedData)
+	/*
+	 *  The zlib header and checkvalue don't belong to the compressed data.
+	 */
+
+	if(CompressedDataLength <= PNG_ZlibHeader_Size + PNG_ZlibCheckValue_Size)
+	{
+		return(0);
+	}
+
+	if(NumChunks > 1)
 	{
-		return(-1);
+		CompressedData = ri.Malloc(CompressedDataLength);
+		if(!CompressedData)
+		{
+			return(0);
+		}
 	}
 
 	CompressedDataPtr = CompressedData;
@@ -644,9 +750,12 @@ static uint32_t DecompressIDATs(struct BufferedFile *BF, uint8_t **Buffer)
 		CH = BufferedFileRead(BF, PNG_ChunkHeader_Size);
 		if(!CH)
 		{
-			ri.Free(CompressedData); 
+			if(NumChunks > 1)
+			{
+				ri.Free(CompressedData); 
+			}
 
-			return(-1);
+			return(0);
 		}
 
 		/*
@@ -671,104 +780,101 @@ static uint32_t DecompressIDATs(struct BufferedFile *BF, uint8_t **Buffer)
 		 *  Copy the Data
 		 */
 
-		if(Length)
+		if(!Length)
+		{
+			if(!BufferedFileSkip(BF, PNG_ChunkCRC_Size))
+			{
+				if(NumChunks > 1)
+				{
+					ri.Free(CompressedData); 
+				}
+
+				return(0);
+			}
+		}
+		else
 		{
 			uint8_t *OrigCompressedData;
 
 			OrigCompressedData = BufferedFileRead(BF, Length);
 			if(!OrigCompressedData)
 			{
-				ri.Free(CompressedData); 
+				if(NumChunks > 1)
+				{
+					ri.Free(CompressedData); 
+				}
 
-				return(-1);
+				return(0);
 			}
 
 			if(!BufferedFileSkip(BF, PNG_ChunkCRC_Size))
 			{
-				ri.Free(CompressedData); 
+				if(NumChunks > 1)
+				{
+					ri.Free(CompressedData); 
+				}
 
-				return(-1);
+				return(0);
 			}
 
-			memcpy(CompressedDataPtr, OrigCompressedData, Length);
-			CompressedDataPtr += Length;
+			if(NumChunks > 1)
+			{
+				memcpy(CompressedDataPtr, OrigCompressedData, Length);
+				CompressedDataPtr += Length;
+			}
+			else
+			{
+				CompressedData = OrigCompressedData;
+			}
 		} 
 	}
 
-	/*
-	 *  Let puff() calculate the decompressed data length.
-	 */
-
-	puffDest    = NULL;
-	puffDestLen = 0;
-
-	/*
-	 *  The zlib header and checkvalue don't belong to the compressed data.
-	 */
-
-	puffSrc    = CompressedData + PNG_ZlibHeader_Size;
-	puffSrcLen = CompressedDataLength - PNG_ZlibHeader_Size - PNG_ZlibCheckValue_Size;
-
-	/*
-	 *  first puff() to calculate the size of the uncompressed data
-	 */
-
-	puffResult = puff(puffDest, &puffDestLen, puffSrc, &puffSrcLen);
-	if(!((puffResult == 0) && (puffDestLen > 0)))
-	{
-		ri.Free(CompressedData);
-
-		return(-1);
-	}
-
 	/*
 	 *  Allocate the buffer for the uncompressed data.
 	 */
 
-	DecompressedData = ri.Malloc(puffDestLen);
+	DecompressedData = ri.Malloc(DecompressedDataLength);
 	if(!DecompressedData)
 	{
-		ri.Free(CompressedData);
+		if(NumChunks > 1)
+		{
+			ri.Free(CompressedData);
+		}
 
-		return(-1);
+		return(0);
 	}
 
 	/*
-	 *  Set the input again in case something was changed by the last puff() .
+	 *  Inflate it, it has to come out at exactly the length of the image.
 	 */
 
-	puffDest   = DecompressedData;
-	puffSrc    = CompressedData + PNG_ZlibHeader_Size;
-	puffSrcLen = CompressedDataLength - PNG_ZlibHeader_Size - PNG_ZlibCheckValue_Size;
+	if(!ri.FS_Inflate(CompressedData + PNG_ZlibHeader_Size,
+			CompressedDataLength - PNG_ZlibHeader_Size - PNG_ZlibCheckValue_Size,
+			DecompressedData, DecompressedDataLength))
+	{
+		if(NumChunks > 1)
+		{
+			ri.Free(CompressedData);
+		}
 
-	/*
-	 *  decompression puff()
-	 */
+		ri.Free(DecompressedData);
 
-	puffResult = puff(puffDest, &puffDestLen, puffSrc, &puffSrcLen);
+		return(0);
+	}
 
 	/*
 	 *  The compressed data is not needed anymore.
 	 */
 
-	ri.Free(CompressedData);
-
-	/*
-	 *  Check if the last puff() was successful.
-	 */
-
-	if(!((puffResult == 0) && (puffDestLen > 0)))
+	if(NumChunks > 1)
 	{
-		ri.Free(DecompressedData);
-
-		return(-1);
+		ri.Free(CompressedData);
 	}
 
 	/*
 	 *  Set the output of this function.
 	 */
 
-	DecompressedDataLength = puffDestLen;
 	*Buffer = DecompressedData;
 
 	return(DecompressedDataLength);
@@ -784,36 +890,124 @@ static uint8_t PredictPaeth(uint8_t a, uint8_t b, uint8_t c)
 	 *  a == Left
 	 *  b == Up
 	 *  c == UpLeft
+	 *
+	 *  p = a + b - c, so the distances are taken without it,
+	 *  which leaves the compiler only selects and no branches.
 	 */
 
-	uint8_t Pr;
-	int p;
 	int pa, pb, pc;
 
-	p  = ((int) a) + ((int) b) - ((int) c);
-	pa = abs(p - ((int) a));
-	pb = abs(p - ((int) b));
-	pc = abs(p - ((int) c));
+	pa = abs(((int) b) - ((int) c));
+	pb = abs(((int) a) - ((int) c));
+	pc = abs(((int) a) + ((int) b) - 2 * ((int) c));
 
-	if((pa <= pb) && (pa <= pc))
-	{
-		Pr = a;
-	}
-	else if(pb <= pc)
+	return(((pa <= pb) && (pa <= pc)) ? a : ((pb <= pc) ? b : c));
+}
+
+#if defined(USE_SSE2_UNFILTER)
+
+/*
+ *  Load and store the 3 or 4 bytes of a pixel, the 3 byte ones can be
+ *  the last of the buffer.
+ */
+
+static ID_INLINE __m128i LoadPixel(const uint8_t *Ptr, uint32_t BytesPerPixel)
+{
+	int Pixel = 0;
+
+	memcpy(&Pixel, Ptr, BytesPerPixel);
+
+	return(_mm_cvtsi32_si128(Pixel));
+}
+
+static ID_INLINE void StorePixel(uint8_t *Ptr, __m128i Value, uint32_t BytesPerPixel)
+{
+	int Pixel = _mm_cvtsi128_si32(Value);
+
+	memcpy(Ptr, &Pixel, BytesPerPixel);
+}
+
+/*
+ *  Average and Paeth of whole RGB and RGBA pixels at once,
+ *  the rows have at least one pixel and an Up row.
+ */
+
+static void UnfilterAverageSSE2(uint8_t *Row, const uint8_t *Up, uint32_t BytesPerScanline, uint32_t BytesPerPixel)
+{
+	const __m128i One = _mm_set1_epi8(1);
+	__m128i  a, b, Avg;
+	uint32_t i;
+
+	a = _mm_setzero_si128();
+
+	for(i = 0; i < BytesPerScanline; i += BytesPerPixel)
 	{
-		Pr = b;
+		b = LoadPixel(Up + i, BytesPerPixel);
+
+		/*
+		 *  _mm_avg_epu8 rounds up, PNG rounds down.
+		 */
+
+		Avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), One));
+
+		a = _mm_add_epi8(LoadPixel(Row + i, BytesPerPixel), Avg);
+		StorePixel(Row + i, a, BytesPerPixel);
 	}
-	else
+}
+
+static void UnfilterPaethSSE2(uint8_t *Row, const uint8_t *Up, uint32_t BytesPerScanline, uint32_t BytesPerPixel)
+{
+	const __m128i Zero = _mm_setzero_si128();
+	__m128i  a, b, c, pa, pb, pc, Smallest, Pr, x;
+	uint32_t i;
+
+	a = Zero;
+	c = Zero;
+
+	for(i = 0; i < BytesPerScanline; i += BytesPerPixel)
 	{
-		Pr = c;
-	}
+		b = _mm_unpacklo_epi8(LoadPixel(Up + i, BytesPerPixel), Zero);
 
-	return(Pr);
+		/*
+		 *  the same distances as PredictPaeth in 16 bit lanes
+		 */
 
+		pa = _mm_sub_epi16(b, c);
+		pb = _mm_sub_epi16(a, c);
+		pc = _mm_add_epi16(pa, pb);
+
+		pa = _mm_max_epi16(pa, _mm_sub_epi16(Zero, pa));
+		pb = _mm_max_epi16(pb, _mm_sub_epi16(Zero, pb));
+		pc = _mm_max_epi16(pc, _mm_sub_epi16(Zero, pc));
+
+		Smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+		/*
+		 *  Ties go to a, then b.
+		 */
+
+		x  = _mm_cmpeq_epi16(Smallest, pb);
+		Pr = _mm_or_si128(_mm_and_si128(x, b), _mm_andnot_si128(x, c));
+		x  = _mm_cmpeq_epi16(Smallest, pa);
+		Pr = _mm_or_si128(_mm_and_si128(x, a), _mm_andnot_si128(x, Pr));
+
+		x = _mm_add_epi8(LoadPixel(Row + i, BytesPerPixel), _mm_packus_epi16(Pr, Pr));
+		StorePixel(Row + i, x, BytesPerPixel);
+
+		a = _mm_unpacklo_epi8(x, Zero);
+		c = b;
+	}
 }
 
+#endif
+
 /*
  *  Reverse the filters.
+ *
+ *  The FilterType is looked at once per scanline, each filter has its
+ *  own loop over the bytes. The left neighbour of a byte is BytesPerPixel
+ *  back in the same row, the first pixel of a row has none and the first
+ *  row has no row above, both count as zero.
  */
 
 static qboolean UnfilterImage(uint8_t  *DecompressedData, 
@@ -823,14 +1017,8 @@ static qboolean UnfilterImage(uint8_t  *DecompressedData,
 {
 	uint8_t   *DecompPtr;
 	uint8_t   FilterType;
-	uint8_t  *PixelLeft, *PixelUp, *PixelUpLeft;
-	uint32_t  w, h, p;
-
-	/*
-	 *  some zeros for the filters
-	 */
-
-	uint8_t Zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	uint8_t  *Up;
+	uint32_t  h, i;
 
 	/*
 	 *  input verification
@@ -874,116 +1062,132 @@ static qboolean UnfilterImage(uint8_t  *DecompressedData,
 		DecompPtr++;
 
 		/*
-		 *  Left pixel of the first byte in a scanline is zero.
+		 *  the previous scanline, plus one byte for its FilterType
 		 */
 
-		PixelLeft = Zeros;
+		Up = (h > 0) ? (DecompPtr - (BytesPerScanline + 1)) : NULL;
 
-		/*
-		 *  Set PixelUp to previous line only if we are on the second line or above.
-		 *
-		 *  Plus one byte for the FilterType
-		 */
-
-		if(h > 0)
-		{
-			PixelUp = DecompPtr - (BytesPerScanline + 1);
-		}
-		else
-		{
-			PixelUp = Zeros;
-		}
-
-		/*
-		 * The pixel left to the first pixel of the previous scanline is zero too.
-		 */
+		switch(FilterType)
+		{ 
+			case PNG_FilterType_None :
+			{
+				/*
+				 *  The bytes are unfiltered.
+				 */
 
-		PixelUpLeft = Zeros;
+				break;
+			}
 
-		/*
-		 *  Cycle trough all pixels of the scanline.
-		 */
+			case PNG_FilterType_Sub :
+			{
+				for(i = BytesPerPixel; i < BytesPerScanline; i++)
+				{
+					DecompPtr[i] += DecompPtr[i - BytesPerPixel];
+				}
 
-		for(w = 0; w < (BytesPerScanline / BytesPerPixel); w++)
-		{
-			/*
-			 *  Cycle trough the bytes of the pixel.
-			 */
+				break;
+			}
 
-			for(p = 0; p < BytesPerPixel; p++)
+			case PNG_FilterType_Up :
 			{
-				switch(FilterType)
-				{ 
-					case PNG_FilterType_None :
+				if(Up)
+				{
+					for(i = 0; i < BytesPerScanline; i++)
 					{
-						/*
-						 *  The byte is unfiltered.
-						 */
-
-						break;
+						DecompPtr[i] += Up[i];
 					}
+				}
 
-					case PNG_FilterType_Sub :
-					{
-						DecompPtr[p] += PixelLeft[p];
+				break;
+			}
 
-						break;
+			case PNG_FilterType_Average :
+			{
+				if(!Up)
+				{
+					for(i = BytesPerPixel; i < BytesPerScanline; i++)
+					{
+						DecompPtr[i] += DecompPtr[i - BytesPerPixel] / 2;
 					}
 
-					case PNG_FilterType_Up :
-					{
-						DecompPtr[p] += PixelUp[p];
+					break;
+				}
 
-						break;
-					}
+#if defined(USE_SSE2_UNFILTER)
+				if((BytesPerPixel == 3) || (BytesPerPixel == 4))
+				{
+					UnfilterAverageSSE2(DecompPtr, Up, BytesPerScanline, BytesPerPixel);
 
-					case PNG_FilterType_Average :
-					{
-						DecompPtr[p] += ((uint8_t) ((((uint16_t) PixelLeft[p]) + ((uint16_t) PixelUp[p])) / 2));
+					break;
+				}
+#endif
 
-						break;
-					}
+				for(i = 0; (i < BytesPerPixel) && (i < BytesPerScanline); i++)
+				{
+					DecompPtr[i] += Up[i] / 2;
+				}
 
-					case PNG_FilterType_Paeth :
-					{
-						DecompPtr[p] += PredictPaeth(PixelLeft[p], PixelUp[p], PixelUpLeft[p]);
+				for(; i < BytesPerScanline; i++)
+				{
+					DecompPtr[i] += ((uint8_t) ((((uint16_t) DecompPtr[i - BytesPerPixel]) + ((uint16_t) Up[i])) / 2));
+				}
 
-						break;
-					}
+				break;
+			}
+
+			case PNG_FilterType_Paeth :
+			{
+				/*
+				 *  Without a row above Paeth picks the left byte, like Sub.
+				 */
 
-					default :
+				if(!Up)
+				{
+					for(i = BytesPerPixel; i < BytesPerScanline; i++)
 					{
-						return(qfalse);
+						DecompPtr[i] += DecompPtr[i - BytesPerPixel];
 					}
+
+					break;
 				}
-			}
 
-			PixelLeft = DecompPtr;
+#if defined(USE_SSE2_UNFILTER)
+				if((BytesPerPixel == 3) || (BytesPerPixel == 4))
+				{
+					UnfilterPaethSSE2(DecompPtr, Up, BytesPerScanline, BytesPerPixel);
 
-			/*
-			 *  We only have an upleft pixel if we are on the second line or above.
-			 */
+					break;
+				}
+#endif
 
-			if(h > 0)
-			{
-				PixelUpLeft = DecompPtr - (BytesPerScanline + 1);
-			}
+				/*
+				 *  and for the first pixel the byte above, like Up.
+				 */
 
-			/*
-			 *  Skip to the next pixel.
-			 */
+				for(i = 0; (i < BytesPerPixel) && (i < BytesPerScanline); i++)
+				{
+					DecompPtr[i] += Up[i];
+				}
 
-			DecompPtr += BytesPerPixel;
+				for(; i < BytesPerScanline; i++)
+				{
+					DecompPtr[i] += PredictPaeth(DecompPtr[i - BytesPerPixel], Up[i], Up[i - BytesPerPixel]);
+				}
 
-			/*
-			 *  We only have a previous line if we are on the second line and above.
-			 */
+				break;
+			}
 
-			if(h > 0)
+			default :
 			{
-				PixelUp = DecompPtr - (BytesPerScanline + 1);
+				return(qfalse);
 			}
 		}
+
+		/*
+		 *  Skip to the next scanline.
+		 */
+
+		DecompPtr += BytesPerScanline;
 	}
 
 	return(qtrue);
@@ -1248,6 +1452,72 @@ static qboolean ConvertPixel(struct PNG_Chunk_IHDR *IHDR,
 }
 
 
+/*
+ *  Convert a whole scanline of the common 8 bit colour types at once,
+ *  qfalse leaves it to ConvertPixel.
+ */
+
+static qboolean ConvertScanline(struct PNG_Chunk_IHDR *IHDR,
+		byte                  *OutPtr,
+		uint8_t               *DecompPtr,
+		uint32_t               Width,
+		qboolean               HasTransparentColour,
+		uint8_t               *TransparentColour,
+		uint8_t               *OutPal)
+{
+	uint32_t w;
+
+	if(IHDR->BitDepth != PNG_BitDepth_8)
+	{
+		return(qfalse);
+	}
+
+	switch(IHDR->ColourType)
+	{
+		case PNG_ColourType_TrueAlpha :
+		{
+			memcpy(OutPtr, DecompPtr, Width * Q3IMAGE_BYTESPERPIXEL);
+
+			return(qtrue);
+		}
+
+		case PNG_ColourType_True :
+		{
+			/*
+			 *  True supports full transparency for one specified colour
+			 */
+
+			for(w = 0; w < Width; w++, OutPtr += Q3IMAGE_BYTESPERPIXEL, DecompPtr += PNG_NumColourComponents_True)
+			{
+				OutPtr[0] = DecompPtr[0];
+				OutPtr[1] = DecompPtr[1];
+				OutPtr[2] = DecompPtr[2];
+				OutPtr[3] = (HasTransparentColour &&
+						(TransparentColour[1] == DecompPtr[0]) &&
+						(TransparentColour[3] == DecompPtr[1]) &&
+						(TransparentColour[5] == DecompPtr[2])) ? 0x00 : 0xFF;
+			}
+
+			return(qtrue);
+		}
+
+		case PNG_ColourType_Indexed :
+		{
+			for(w = 0; w < Width; w++, OutPtr += Q3IMAGE_BYTESPERPIXEL)
+			{
+				memcpy(OutPtr, OutPal + DecompPtr[w] * Q3IMAGE_BYTESPERPIXEL, Q3IMAGE_BYTESPERPIXEL);
+			}
+
+			return(qtrue);
+		}
+
+		default :
+		{
+			return(qfalse);
+		}
+	}
+}
+
 /*
  *  Decode a non-interlaced image.
  */
@@ -1473,6 +1743,14 @@ static qboolean DecodeImageNonInterlaced(struct PNG_Chunk_IHDR *IHDR,
 
 		DecompPtr++;
 
+		if(ConvertScanline(IHDR, OutPtr, DecompPtr, IHDR_Width, HasTransparentColour, TransparentColour, OutPal))
+		{
+			OutPtr    += IHDR_Width * Q3IMAGE_BYTESPERPIXEL;
+			DecompPtr += BytesPerScanline;
+
+			continue;
+		}
+
 		/*
 		 *  Reset the pixel count.
 		 */
@@ -2386,7 +2664,7 @@ void R_LoadPNG(const char *name, byte **pic, int *width, int *height)
 	 *  Decompress all IDAT chunks
 	 */
 
-	DecompressedDataLength = DecompressIDATs(ThePNG, &DecompressedData);
+	DecompressedDataLength = DecompressIDATs(ThePNG, DecompressedLength(IHDR), &DecompressedData);
 	if(!(DecompressedDataLength && DecompressedData))
 	{
 		CloseBufferedFile(ThePNG);
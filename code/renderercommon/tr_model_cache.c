@@ -0,0 +1,254 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// tr_model_cache.c -- model files kept in memory across map changes
+
+#include "tr_common.h"
+
+/*
+Every map change shuts the renderer down without unloading it and every
+model is read again, most of them inflated from the same pk3 entries as
+the last time. The files read from pk3s are kept here, outside the hunk,
+up to r_modelCache megabytes, and handed out again as long as the pk3
+still records the same CRC and length for the name. FS_PakFileCrc opens
+the file all the same, so its pak is referenced as if it had been read.
+
+The loaders get a copy they may byte swap in place. It is malloced, not
+temp memory, which the last FS_FreeFile of the shaders and images loaded
+meanwhile would clear. The cache goes with the library on a full
+renderer shutdown.
+*/
+
+#define	MODEL_CACHE_HASH	256		// power of two
+#define	MAX_MODEL_CACHE_OUT	4		// copies handed out and not freed yet
+
+typedef struct modelFile_s {
+	char				name[MAX_QPATH];
+	unsigned			crc;
+	int					len;
+	int					lastUsed;
+	byte				*data;
+	struct modelFile_s	*next;
+} modelFile_t;
+
+static struct {
+	modelFile_t	*hash[MODEL_CACHE_HASH];
+	int			bytes;
+	int			sequence;
+
+	void		*out[MAX_MODEL_CACHE_OUT];
+} modelCache;
+
+/*
+=================
+R_ModelCacheHash
+=================
+*/
+static int R_ModelCacheHash( const char *name ) {
+	unsigned	hash;
+
+	for ( hash = 0; *name; name++ ) {
+		hash = hash * 31 + tolower( *(const unsigned char *)name );
+	}
+
+	return ( hash ^ ( hash >> 16 ) ) & ( MODEL_CACHE_HASH - 1 );
+}
+
+/*
+=================
+R_ModelCacheFree
+=================
+*/
+static void R_ModelCacheFree( modelFile_t **link ) {
+	modelFile_t	*entry = *link;
+
+	*link = entry->next;
+	modelCache.bytes -= entry->len;
+	free( entry->data );
+	free( entry );
+}
+
+/*
+=================
+R_ModelCacheTrim
+
+Drops the least recently used files until another size bytes fit
+=================
+*/
+static void R_ModelCacheTrim( int size, int budget ) {
+	modelFile_t	**link, **oldest;
+	int			i;
+
+	while ( modelCache.bytes && modelCache.bytes + size > budget ) {
+		oldest = NULL;
+		for ( i = 0; i < MODEL_CACHE_HASH; i++ ) {
+			for ( link = &modelCache.hash[i]; *link; link = &(*link)->next ) {
+				if ( !oldest || (*link)->lastUsed < (*oldest)->lastUsed ) {
+					oldest = link;
+				}
+			}
+		}
+		R_ModelCacheFree( oldest );
+	}
+}
+
+/*
+=================
+R_ModelCacheCopy
+
+A copy of data for the loader, recorded for R_FreeModelFile
+=================
+*/
+static long R_ModelCacheCopy( const byte *data, int len, void **buf ) {
+	byte	*copy;
+	int		i;
+
+	for ( i = 0; i < MAX_MODEL_CACHE_OUT; i++ ) {
+		if ( !modelCache.out[i] ) {
+			break;
+		}
+	}
+	if ( i == MAX_MODEL_CACHE_OUT ) {
+		return -1;
+	}
+
+	copy = malloc( len + 1 );
+	if ( !copy ) {
+		return -1;
+	}
+	Com_Memcpy( copy, data, len );
+
+	// guarantee that it will have a trailing 0 like FS_ReadFile
+	copy[len] = 0;
+
+	modelCache.out[i] = copy;
+	*buf = copy;
+
+	return len;
+}
+
+/*
+=================
+R_ReadModelFile
+
+ri.FS_ReadFile for model files, the buffer goes back with R_FreeModelFile
+=================
+*/
+long R_ReadModelFile( const char *name, void **buf ) {
+	modelFile_t	*entry, **link;
+	unsigned	crc;
+	int			budget, len, hash;
+	long		fileLen;
+
+	*buf = NULL;
+
+	budget = r_modelCache->integer;
+	if ( budget <= 0 || !ri.FS_PakFileCrc( name, &crc, &len ) ) {
+		return ri.FS_ReadFile( name, buf );
+	}
+	budget = budget > 1024 ? INT_MAX : budget * 1024 * 1024;
+
+	hash = R_ModelCacheHash( name );
+	for ( link = &modelCache.hash[hash]; *link; link = &(*link)->next ) {
+		entry = *link;
+		if ( Q_stricmp( entry->name, name ) ) {
+			continue;
+		}
+
+		if ( entry->crc == crc && entry->len == len ) {
+			entry->lastUsed = ++modelCache.sequence;
+			fileLen = R_ModelCacheCopy( entry->data, entry->len, buf );
+			if ( fileLen >= 0 ) {
+				return fileLen;
+			}
+			return ri.FS_ReadFile( name, buf );
+		}
+
+		// the pk3 has something else under the name now
+		R_ModelCacheFree( link );
+		break;
+	}
+
+	fileLen = ri.FS_ReadFile( name, buf );
+	if ( !*buf || fileLen != len || len > budget || strlen( name ) >= MAX_QPATH ) {
+		return fileLen;
+	}
+
+	R_ModelCacheTrim( len, budget );
+
+	entry = malloc( sizeof( *entry ) );
+	if ( !entry ) {
+		return fileLen;
+	}
+	entry->data = malloc( len );
+	if ( !entry->data ) {
+		free( entry );
+		return fileLen;
+	}
+
+	Q_strncpyz( entry->name, name, sizeof( entry->name ) );
+	entry->crc = crc;
+	entry->len = len;
+	entry->lastUsed = ++modelCache.sequence;
+	Com_Memcpy( entry->data, *buf, len );
+
+	entry->next = modelCache.hash[hash];
+	modelCache.hash[hash] = entry;
+	modelCache.bytes += len;
+
+	return fileLen;
+}
+
+/*
+=================
+R_FreeModelFile
+=================
+*/
+void R_FreeModelFile( void *buf ) {
+	int		i;
+
+	for ( i = 0; i < MAX_MODEL_CACHE_OUT; i++ ) {
+		if ( modelCache.out[i] == buf ) {
+			modelCache.out[i] = NULL;
+			free( buf );
+			return;
+		}
+	}
+
+	ri.FS_FreeFile( buf );
+}
+
+/*
+=================
+R_ShutdownModelCache
+=================
+*/
+void R_ShutdownModelCache( void ) {
+	int		i;
+
+	for ( i = 0; i < MODEL_CACHE_HASH; i++ ) {
+		while ( modelCache.hash[i] ) {
+			R_ModelCacheFree( &modelCache.hash[i] );
+		}
+	}
+
+	Com_Memset( &modelCache, 0, sizeof( modelCache ) );
+}
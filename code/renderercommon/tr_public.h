@@ -24,7 +24,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "tr_types.h"
 
-#define	REF_API_VERSION		8
+#define	REF_API_VERSION		14
 
 //
 // these are the functions exported by the refresh module
@@ -72,6 +72,8 @@ typedef struct {
 	void	(*SetColor)( const float *rgba );	// NULL = 1,1,1,1
 	void	(*DrawStretchPic) ( float x, float y, float w, float h, 
 		float s1, float t1, float s2, float t2, qhandle_t hShader );	// 0 = white
+	// a run of quads with the same shader, text one glyph per quad
+	void	(*DrawStretchPics) ( const stretchPic_t *pics, int numPics, qhandle_t hShader );
 
 	// Draw images for cinematic rendering, pass as 32 bit rgba
 	void	(*DrawStretchRaw) (int x, int y, int w, int h, int cols, int rows, const byte *data, int client, qboolean dirty);
@@ -98,7 +100,16 @@ typedef struct {
 	qboolean (*GetEntityToken)( char *buffer, int size );
 	qboolean (*inPVS)( const vec3_t p1, const vec3_t p2 );
 
-	void (*TakeVideoFrame)( int h, int w, byte* captureBuffer, byte *encodeBuffer, qboolean motionJpeg );
+	// reads back the frame being drawn, it comes out of CL_AVIVideoFrameCaptured
+	// in captureBuffer, likely a couple of frames later
+	void (*TakeVideoFrame)( int width, int height, byte *captureBuffer );
+	// hands over the frames still being read back
+	void (*FinishVideoFrames)( byte *captureBuffer );
+	size_t (*SaveJPGToBuffer)( byte *buffer, size_t bufSize, int quality,
+		int image_width, int image_height, byte *image_buffer, int padding );
+
+	// newest frame the GPU time is known for, may be NULL or return qfalse
+	qboolean (*GetGPUFrameTime)( int *frameNum, int *usec );
 } refexport_t;
 
 //
@@ -159,13 +170,22 @@ typedef struct {
 	void	(*FS_FreeFileList)( char **filelist );
 	void	(*FS_WriteFile)( const char *qpath, const void *buffer, int size );
 	qboolean (*FS_FileExists)( const char *file );
+	// raw deflate data that has to inflate to exactly dstLen bytes
+	qboolean (*FS_Inflate)( const byte *src, int srcLen, byte *dst, int dstLen );
+	qboolean (*FS_PakFileCrc)( const char *name, unsigned *crc, int *len );
+	qboolean (*FS_PureServerActive)( void );
+	// the private cache of the engine, files only read back if written there
+	long	(*FS_ReadCacheFile)( const char *name, void **buf );
+	qboolean (*FS_WriteCacheFile)( const char *name, const void *buffer, int size );
 
 	// cinematic stuff
 	void	(*CIN_UploadCinematic)(int handle);
 	int		(*CIN_PlayCinematic)( const char *arg0, int xpos, int ypos, int width, int height, int bits);
 	e_status (*CIN_RunCinematic) (int handle);
 
-	void	(*CL_WriteAVIVideoFrame)( const byte *buffer, int size );
+	// bottom up RGB rows, each followed by padding bytes, may be called
+	// from the render thread
+	void	(*CL_AVIVideoFrameCaptured)( const byte *pixels, int padding );
 
 	// input event handling
 	void	(*IN_Init)( void *windowData );
@@ -180,6 +200,25 @@ typedef struct {
 	void	(*Sys_GLimpSafeInit)( void );
 	void	(*Sys_GLimpInit)( void );
 	qboolean (*Sys_LowPhysicalMemory)( void );
+	cpuFeatures_t (*Sys_GetProcessorFeatures)( void );
+
+	// job system, jobs must not call back into the engine
+	void	(*Com_RunParallel)( void (*func)( void *data, int index ), void *data, int count );
+	int		(*Com_NumWorkers)( void );
+	int		(*Com_WorkerIndex)( void );
+	void	(*Com_ParallelRange)( const char *name, void (*func)( void *data, int start, int end ), void *data, int count, int minBatch );
+	int		(*Com_AddJobs)( const char *name, void (*func)( void *data, int index ), void *data, int count, const int *depends, int numDepends );
+	qboolean (*Com_JobsDone)( int group );
+	void	(*Com_WaitJobs)( int group );
+
+	// per thread memory given back at the end of the frame or job, or
+	// when an earlier mark is released
+	void	*(*Com_ScratchAlloc)( int size );
+	int		(*Com_ScratchMark)( void );
+	void	(*Com_ScratchRelease)( int mark );
+
+	// unscaled clock for the profiler, see Milliseconds
+	int64_t	(*Microseconds)( void );
 } refimport_t;
 
 
@@ -0,0 +1,188 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// tr_screenshot.c -- screenshots encoded behind the frame
+
+#include "tr_common.h"
+
+/*
+The back end reads the pixels and hands them to R_QueueScreenshot. A job
+gamma corrects them and makes the TGA or JPEG file in memory, and
+R_FinishScreenshots writes the ones that are done from the main thread,
+once a frame. Jobs don't touch the file system.
+
+Without workers a job only runs when it is waited for, so the screenshot
+is then encoded and written right away, as it used to be.
+*/
+
+#define	MAX_QUEUED_SCREENSHOTS	4
+
+typedef struct {
+	char		fileName[MAX_OSPATH];
+	qboolean	jpeg;
+	int			quality;
+	qboolean	gamma;
+
+	// as read back, bottom up rows of RGB, padlen bytes apart
+	byte		*pixels;
+	int			width, height, padlen;
+
+	// set by the job
+	byte		*file;
+	size_t		fileSize;
+
+	int			group;
+} queuedShot_t;
+
+static queuedShot_t	queuedShots[MAX_QUEUED_SCREENSHOTS];
+
+/*
+==================
+R_EncodeScreenshotJob
+==================
+*/
+static void R_EncodeScreenshotJob( void *data, int index ) {
+	queuedShot_t	*shot = (queuedShot_t *)data;
+	byte			*src, *dst;
+	int				linelen, x, y;
+
+	linelen = shot->width * 3;
+
+	if ( shot->gamma ) {
+		R_GammaCorrect( shot->pixels, ( linelen + shot->padlen ) * shot->height );
+	}
+
+	if ( shot->jpeg ) {
+		shot->file = malloc( linelen * shot->height );
+		if ( shot->file ) {
+			shot->fileSize = R_WorkerSaveJPGToBuffer( shot->file, linelen * shot->height, shot->quality,
+				shot->width, shot->height, shot->pixels, shot->padlen );
+		}
+		return;
+	}
+
+	shot->file = malloc( 18 + linelen * shot->height );
+	if ( !shot->file ) {
+		return;
+	}
+
+	Com_Memset( shot->file, 0, 18 );
+	shot->file[2] = 2;		// uncompressed type
+	shot->file[12] = shot->width & 255;
+	shot->file[13] = shot->width >> 8;
+	shot->file[14] = shot->height & 255;
+	shot->file[15] = shot->height >> 8;
+	shot->file[16] = 24;	// pixel size
+
+	// swap rgb to bgr and remove padding from line endings
+	src = shot->pixels;
+	dst = shot->file + 18;
+	for ( y = 0; y < shot->height; y++ ) {
+		for ( x = 0; x < shot->width; x++, src += 3, dst += 3 ) {
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
+		}
+		src += shot->padlen;
+	}
+
+	shot->fileSize = 18 + linelen * shot->height;
+}
+
+/*
+==================
+R_FinishScreenshot
+==================
+*/
+static void R_FinishScreenshot( queuedShot_t *shot ) {
+	ri.Com_WaitJobs( shot->group );
+
+	if ( shot->fileSize ) {
+		ri.FS_WriteFile( shot->fileName, shot->file, shot->fileSize );
+	} else {
+		ri.Printf( PRINT_WARNING, "Couldn't encode screenshot %s\n", shot->fileName );
+	}
+
+	free( shot->file );
+	free( shot->pixels );
+	Com_Memset( shot, 0, sizeof( *shot ) );
+}
+
+/*
+==================
+R_QueueScreenshot
+
+Takes over pixels, which have to be malloced
+==================
+*/
+void R_QueueScreenshot( const char *fileName, qboolean jpeg, int quality, qboolean gamma,
+	byte *pixels, int width, int height, int padlen ) {
+	queuedShot_t	*shot;
+	int				i;
+
+	for ( i = 0; i < MAX_QUEUED_SCREENSHOTS; i++ ) {
+		if ( !queuedShots[i].pixels ) {
+			break;
+		}
+	}
+	if ( i == MAX_QUEUED_SCREENSHOTS ) {
+		R_FinishScreenshots( qtrue );
+		i = 0;
+	}
+
+	shot = &queuedShots[i];
+	Q_strncpyz( shot->fileName, fileName, sizeof( shot->fileName ) );
+	shot->jpeg = jpeg;
+	shot->quality = quality;
+	shot->gamma = gamma;
+	shot->pixels = pixels;
+	shot->width = width;
+	shot->height = height;
+	shot->padlen = padlen;
+
+	shot->group = ri.Com_AddJobs( "screenshot", R_EncodeScreenshotJob, shot, 1, NULL, 0 );
+
+	if ( !ri.Com_NumWorkers() ) {
+		R_FinishScreenshot( shot );
+	}
+}
+
+/*
+==================
+R_FinishScreenshots
+
+Writes the screenshots that are encoded, or all of them if wait is set
+==================
+*/
+void R_FinishScreenshots( qboolean wait ) {
+	queuedShot_t	*shot;
+	int				i;
+
+	for ( i = 0, shot = queuedShots; i < MAX_QUEUED_SCREENSHOTS; i++, shot++ ) {
+		if ( !shot->pixels ) {
+			continue;
+		}
+		if ( !wait && !ri.Com_JobsDone( shot->group ) ) {
+			continue;
+		}
+		R_FinishScreenshot( shot );
+	}
+}
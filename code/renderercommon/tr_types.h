@@ -67,6 +67,14 @@ typedef struct {
 	byte		modulate[4];
 } polyVert_t;
 
+// one quad of re.DrawStretchPics, placed like DrawStretchPic but with its
+// own color rather than the one from SetColor
+typedef struct {
+	float		x, y, w, h;
+	float		s1, t1, s2, t2;
+	byte		color[4];
+} stretchPic_t;
+
 typedef struct poly_s {
 	qhandle_t			hShader;
 	int					numVerts;
@@ -215,7 +223,7 @@ typedef struct {
 	// used CDS.
 	qboolean				isFullscreen;
 	qboolean				stereoEnabled;
-	qboolean				smpActive;		// UNUSED, present for compatibility
+	qboolean				smpActive;		// dual processor, the back end runs on its own thread
 } glconfig_t;
 
 #endif	// __TR_TYPES_H
@@ -21,7 +21,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 #include "tr_local.h"
 
-backEndData_t	*backEndData;
+backEndData_t	*backEndData[SMP_FRAMES];
 backEndState_t	backEnd;
 
 
@@ -403,8 +403,13 @@ static void SetViewportAndScissor( void ) {
 	// set the window clipping
 	qglViewport( backEnd.viewParms.viewportX, backEnd.viewParms.viewportY, 
 		backEnd.viewParms.viewportWidth, backEnd.viewParms.viewportHeight );
-	qglScissor( backEnd.viewParms.viewportX, backEnd.viewParms.viewportY, 
-		backEnd.viewParms.viewportWidth, backEnd.viewParms.viewportHeight );
+	if ( backEnd.viewParms.scissorWidth ) {
+		qglScissor( backEnd.viewParms.scissorX, backEnd.viewParms.scissorY,
+			backEnd.viewParms.scissorWidth, backEnd.viewParms.scissorHeight );
+	} else {
+		qglScissor( backEnd.viewParms.viewportX, backEnd.viewParms.viewportY, 
+			backEnd.viewParms.viewportWidth, backEnd.viewParms.viewportHeight );
+	}
 }
 
 /*
@@ -495,6 +500,63 @@ void RB_BeginDrawingView (void) {
 }
 
 
+/*
+==================
+RB_OcclusionQueries
+
+Draws the bounds of the leafs queued by R_LeafOccluded against the
+depth buffer of the finished view, one query each
+==================
+*/
+#define	OCCLUSION_BOX_EXPAND	2		// keeps faces the leaf bounds share with its walls in front of them
+
+static void RB_OcclusionQueries( void ) {
+	static const int	boxFaces[24] = {
+		0, 2, 3, 1,		4, 5, 7, 6,
+		0, 1, 5, 4,		2, 6, 7, 3,
+		0, 4, 6, 2,		1, 3, 7, 5
+	};
+	GLboolean			rgba[4];
+	occlusionQuery_t	*q;
+	mnode_t				*leaf;
+	vec3_t				corners[8];
+	int					i, j;
+
+	if ( !tr.numOcclusionLeafs ) {
+		return;
+	}
+
+	GL_Bind( tr.whiteImage );
+	GL_State( 0 );
+	GL_Cull( CT_TWO_SIDED );
+
+	qglGetBooleanv( GL_COLOR_WRITEMASK, rgba );
+	qglColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+
+	for ( i = 0 ; i < tr.numOcclusionLeafs ; i++ ) {
+		q = &tr.occlusionQueries[tr.occlusionLeafs[i]];
+		leaf = q->leaf;
+
+		for ( j = 0 ; j < 8 ; j++ ) {
+			corners[j][0] = ( j & 1 ) ? leaf->maxs[0] + OCCLUSION_BOX_EXPAND : leaf->mins[0] - OCCLUSION_BOX_EXPAND;
+			corners[j][1] = ( j & 2 ) ? leaf->maxs[1] + OCCLUSION_BOX_EXPAND : leaf->mins[1] - OCCLUSION_BOX_EXPAND;
+			corners[j][2] = ( j & 4 ) ? leaf->maxs[2] + OCCLUSION_BOX_EXPAND : leaf->mins[2] - OCCLUSION_BOX_EXPAND;
+		}
+
+		qglBeginQuery( GL_SAMPLES_PASSED, q->query );
+		qglBegin( GL_QUADS );
+		for ( j = 0 ; j < 24 ; j++ ) {
+			qglVertex3fv( corners[boxFaces[j]] );
+		}
+		qglEnd();
+		qglEndQuery( GL_SAMPLES_PASSED );
+
+		q->issued = qtrue;
+	}
+
+	qglColorMask( rgba[0], rgba[1], rgba[2], rgba[3] );
+}
+
 /*
 ==================
 RB_RenderDrawSurfList
@@ -669,6 +731,10 @@ void RB_RenderDrawSurfList( drawSurf_t *drawSurfs, int numDrawSurfs ) {
 		qglDepthRange (0, 1);
 	}
 
+	if ( backEnd.viewParms.occlusionCull ) {
+		RB_OcclusionQueries();
+	}
+
 	if (r_drawSun->integer) {
 		RB_DrawSun(0.1, tr.sunShader);
 	}
@@ -901,6 +967,96 @@ const void *RB_StretchPic ( const void *data ) {
 }
 
 
+/*
+=============
+RB_StretchPics
+
+The quads of a run go into tess in one loop, the shader is looked at once
+and the overflow check only when tess is full
+=============
+*/
+const void *RB_StretchPics( const void *data ) {
+	const stretchPicsCommand_t	*cmd;
+	const stretchPic_t	*pic, *end;
+	shader_t	*shader;
+	int			numVerts, numIndexes, room;
+	glIndex_t	*indexes;
+
+	cmd = (const stretchPicsCommand_t *)data;
+	pic = (const stretchPic_t *)( cmd + 1 );
+	end = pic + cmd->numPics;
+
+	if ( !backEnd.projection2D ) {
+		RB_SetGL2D();
+	}
+
+	shader = cmd->shader;
+	if ( shader != tess.shader ) {
+		if ( tess.numIndexes ) {
+			RB_EndSurface();
+		}
+		backEnd.currentEntity = &backEnd.entity2D;
+		RB_BeginSurface( shader, 0 );
+	}
+
+	while ( pic < end ) {
+		RB_CHECKOVERFLOW( 4, 6 );
+
+		room = MIN( ( SHADER_MAX_VERTEXES - 1 - tess.numVertexes ) / 4, ( SHADER_MAX_INDEXES - 1 - tess.numIndexes ) / 6 );
+		if ( room > end - pic ) {
+			room = end - pic;
+		}
+
+		numVerts = tess.numVertexes;
+		numIndexes = tess.numIndexes;
+
+		tess.numVertexes += room * 4;
+		tess.numIndexes += room * 6;
+
+		for ( ; room > 0; room--, pic++, numVerts += 4, numIndexes += 6 ) {
+			indexes = &tess.indexes[ numIndexes ];
+			indexes[0] = numVerts + 3;
+			indexes[1] = numVerts + 0;
+			indexes[2] = numVerts + 2;
+			indexes[3] = numVerts + 2;
+			indexes[4] = numVerts + 0;
+			indexes[5] = numVerts + 1;
+
+			*(int *)tess.vertexColors[ numVerts ] =
+				*(int *)tess.vertexColors[ numVerts + 1 ] =
+				*(int *)tess.vertexColors[ numVerts + 2 ] =
+				*(int *)tess.vertexColors[ numVerts + 3 ] = *(const int *)pic->color;
+
+			tess.xyz[ numVerts ][0] = pic->x;
+			tess.xyz[ numVerts ][1] = pic->y;
+			tess.xyz[ numVerts ][2] = 0;
+			tess.texCoords[ numVerts ][0][0] = pic->s1;
+			tess.texCoords[ numVerts ][0][1] = pic->t1;
+
+			tess.xyz[ numVerts + 1 ][0] = pic->x + pic->w;
+			tess.xyz[ numVerts + 1 ][1] = pic->y;
+			tess.xyz[ numVerts + 1 ][2] = 0;
+			tess.texCoords[ numVerts + 1 ][0][0] = pic->s2;
+			tess.texCoords[ numVerts + 1 ][0][1] = pic->t1;
+
+			tess.xyz[ numVerts + 2 ][0] = pic->x + pic->w;
+			tess.xyz[ numVerts + 2 ][1] = pic->y + pic->h;
+			tess.xyz[ numVerts + 2 ][2] = 0;
+			tess.texCoords[ numVerts + 2 ][0][0] = pic->s2;
+			tess.texCoords[ numVerts + 2 ][0][1] = pic->t2;
+
+			tess.xyz[ numVerts + 3 ][0] = pic->x;
+			tess.xyz[ numVerts + 3 ][1] = pic->y + pic->h;
+			tess.xyz[ numVerts + 3 ][2] = 0;
+			tess.texCoords[ numVerts + 3 ][0][0] = pic->s1;
+			tess.texCoords[ numVerts + 3 ][0][1] = pic->t2;
+		}
+	}
+
+	return (const void *)end;
+}
+
+
 /*
 =============
 RB_DrawSurfs
@@ -1073,15 +1229,18 @@ const void	*RB_SwapBuffers( const void *data ) {
 		long sum = 0;
 		unsigned char *stencilReadback;
 
-		stencilReadback = ri.Hunk_AllocateTempMemory( glConfig.vidWidth * glConfig.vidHeight );
-		qglReadPixels( 0, 0, glConfig.vidWidth, glConfig.vidHeight, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, stencilReadback );
+		// not scratch memory, with r_smp this is the render thread
+		stencilReadback = malloc( glConfig.vidWidth * glConfig.vidHeight );
+		if ( stencilReadback ) {
+			qglReadPixels( 0, 0, glConfig.vidWidth, glConfig.vidHeight, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, stencilReadback );
 
-		for ( i = 0; i < glConfig.vidWidth * glConfig.vidHeight; i++ ) {
-			sum += stencilReadback[i];
-		}
+			for ( i = 0; i < glConfig.vidWidth * glConfig.vidHeight; i++ ) {
+				sum += stencilReadback[i];
+			}
 
-		backEnd.pc.c_overDraw += sum;
-		ri.Hunk_FreeTempMemory( stencilReadback );
+			backEnd.pc.c_overDraw += sum;
+			free( stencilReadback );
+		}
 	}
 
 
@@ -1108,6 +1267,12 @@ void RB_ExecuteRenderCommands( const void *data ) {
 
 	t1 = ri.Milliseconds ();
 
+	if ( !backEndData[1] || data == backEndData[0]->commands.cmds ) {
+		backEnd.smpFrame = 0;
+	} else {
+		backEnd.smpFrame = 1;
+	}
+
 	while ( 1 ) {
 		data = PADP(data, sizeof(void *));
 
@@ -1118,6 +1283,9 @@ void RB_ExecuteRenderCommands( const void *data ) {
 		case RC_STRETCH_PIC:
 			data = RB_StretchPic( data );
 			break;
+		case RC_STRETCH_PICS:
+			data = RB_StretchPics( data );
+			break;
 		case RC_DRAW_SURFS:
 			data = RB_DrawSurfs( data );
 			break;
@@ -1149,3 +1317,28 @@ void RB_ExecuteRenderCommands( const void *data ) {
 	}
 
 }
+
+
+/*
+================
+RB_RenderThread
+
+With r_smp the back end runs here, on batches handed over by
+R_IssueRenderCommands
+================
+*/
+void RB_RenderThread( void ) {
+	const void	*data;
+
+	// wait for either a rendering command or a quit command
+	while ( 1 ) {
+		// sleep until we have work to do
+		data = GLimp_RendererSleep();
+
+		if ( !data ) {
+			return;	// all done, renderer is shutting down
+		}
+
+		RB_ExecuteRenderCommands( data );
+	}
+}
@@ -261,6 +261,51 @@ static	void R_LoadVisibility( lump_t *l ) {
 	}
 }
 
+/*
+=================
+R_LoadClusterLeafs
+
+Lists the leafs of every cluster, so R_MarkLeaves only has to visit the
+clusters in the PVS instead of every node of the world
+=================
+*/
+static void R_LoadClusterLeafs( void ) {
+	mnode_t	*leaf;
+	int		i, cluster, numLeafs;
+	int		*fill;
+
+	s_worldData.clusterFirstLeaf = ri.Hunk_Alloc( ( s_worldData.numClusters + 1 ) * sizeof( int ), h_low );
+
+	numLeafs = 0;
+	for ( i = 0, leaf = s_worldData.nodes ; i < s_worldData.numnodes ; i++, leaf++ ) {
+		cluster = leaf->cluster;
+		if ( leaf->contents == CONTENTS_NODE || cluster < 0 || cluster >= s_worldData.numClusters ) {
+			continue;
+		}
+		s_worldData.clusterFirstLeaf[cluster + 1]++;
+		numLeafs++;
+	}
+
+	for ( i = 0 ; i < s_worldData.numClusters ; i++ ) {
+		s_worldData.clusterFirstLeaf[i + 1] += s_worldData.clusterFirstLeaf[i];
+	}
+
+	s_worldData.clusterLeafs = ri.Hunk_Alloc( ( numLeafs ? numLeafs : 1 ) * sizeof( *s_worldData.clusterLeafs ), h_low );
+
+	fill = ri.Hunk_AllocateTempMemory( ( s_worldData.numClusters + 1 ) * sizeof( int ) );
+	Com_Memcpy( fill, s_worldData.clusterFirstLeaf, ( s_worldData.numClusters + 1 ) * sizeof( int ) );
+
+	for ( i = 0, leaf = s_worldData.nodes ; i < s_worldData.numnodes ; i++, leaf++ ) {
+		cluster = leaf->cluster;
+		if ( leaf->contents == CONTENTS_NODE || cluster < 0 || cluster >= s_worldData.numClusters ) {
+			continue;
+		}
+		s_worldData.clusterLeafs[fill[cluster]++] = leaf;
+	}
+
+	ri.Hunk_FreeTempMemory( fill );
+}
+
 //===============================================================================
 
 
@@ -336,6 +381,7 @@ static void ParseFace( dsurface_t *ds, drawVert_t *verts, msurface_t *surf, int
 
 	cv = ri.Hunk_Alloc( sfaceSize, h_low );
 	cv->surfaceType = SF_FACE;
+	cv->vboFirstVertex = -1;
 	cv->numPoints = numPoints;
 	cv->numIndices = numIndexes;
 	cv->ofsIndices = ofsIndexes;
@@ -461,6 +507,7 @@ static void ParseTriSurf( dsurface_t *ds, drawVert_t *verts, msurface_t *surf, i
 	tri = ri.Hunk_Alloc( sizeof( *tri ) + numVerts * sizeof( tri->verts[0] ) 
 		+ numIndexes * sizeof( tri->indexes[0] ), h_low );
 	tri->surfaceType = SF_TRIANGLES;
+	tri->vboFirstVertex = -1;
 	tri->numVerts = numVerts;
 	tri->numIndexes = numIndexes;
 	tri->verts = (drawVert_t *)(tri + 1);
@@ -1295,6 +1342,100 @@ static	void R_LoadSurfaces( lump_t *surfs, lump_t *verts, lump_t *indexLump ) {
 		numFaces, numMeshes, numTriSurfs, numFlares );
 }
 
+/*
+===============
+R_CreateWorldVBO
+
+Every frame RB_SurfaceFace copied the vertexes of each visible face into
+tess. Faces and triangles drawn by RB_StageIteratorLightmappedMultitexture,
+most of any map, never change them, so they are put in a vertex buffer
+once and only their indexes go through tess. Curves keep the old path so
+they can still LOD.
+===============
+*/
+static void R_CreateWorldVBO( void ) {
+	msurface_t			*surf;
+	srfSurfaceFace_t	*face;
+	srfTriangles_t		*tri;
+	worldVertex_t		*verts, *v;
+	float				*point;
+	int					i, j, numVerts;
+
+	if ( !r_worldVBO->integer || !qglBindBuffer ) {
+		return;
+	}
+
+	numVerts = 0;
+	for ( i = 0, surf = s_worldData.surfaces ; i < s_worldData.numsurfaces ; i++, surf++ ) {
+		if ( surf->shader->optimalStageIteratorFunc != RB_StageIteratorLightmappedMultitexture ) {
+			continue;
+		}
+		if ( *surf->data == SF_FACE ) {
+			numVerts += ( (srfSurfaceFace_t *)surf->data )->numPoints;
+		} else if ( *surf->data == SF_TRIANGLES ) {
+			numVerts += ( (srfTriangles_t *)surf->data )->numVerts;
+		}
+	}
+
+	if ( !numVerts ) {
+		return;
+	}
+
+	verts = ri.Hunk_AllocateTempMemory( numVerts * sizeof( *verts ) );
+
+	v = verts;
+	for ( i = 0, surf = s_worldData.surfaces ; i < s_worldData.numsurfaces ; i++, surf++ ) {
+		if ( surf->shader->optimalStageIteratorFunc != RB_StageIteratorLightmappedMultitexture ) {
+			continue;
+		}
+		if ( *surf->data == SF_FACE ) {
+			face = (srfSurfaceFace_t *)surf->data;
+			face->vboFirstVertex = v - verts;
+			for ( j = 0, point = face->points[0] ; j < face->numPoints ; j++, point += VERTEXSIZE, v++ ) {
+				VectorCopy( point, v->xyz );
+				v->st[0] = point[3];
+				v->st[1] = point[4];
+				v->lightmap[0] = point[5];
+				v->lightmap[1] = point[6];
+			}
+		} else if ( *surf->data == SF_TRIANGLES ) {
+			tri = (srfTriangles_t *)surf->data;
+			tri->vboFirstVertex = v - verts;
+			for ( j = 0 ; j < tri->numVerts ; j++, v++ ) {
+				VectorCopy( tri->verts[j].xyz, v->xyz );
+				v->st[0] = tri->verts[j].st[0];
+				v->st[1] = tri->verts[j].st[1];
+				v->lightmap[0] = tri->verts[j].lightmap[0];
+				v->lightmap[1] = tri->verts[j].lightmap[1];
+			}
+		}
+	}
+
+	R_SyncRenderThread();
+	qglGenBuffers( 1, &s_worldData.vbo );
+	qglBindBuffer( GL_ARRAY_BUFFER, s_worldData.vbo );
+	qglBufferData( GL_ARRAY_BUFFER, numVerts * sizeof( *verts ), verts, GL_STATIC_DRAW );
+	qglBindBuffer( GL_ARRAY_BUFFER, 0 );
+	s_worldData.vboVertexes = numVerts;
+
+	ri.Hunk_FreeTempMemory( verts );
+
+	ri.Printf( PRINT_ALL, "...world vertex buffer of %i vertexes\n", numVerts );
+}
+
+/*
+===============
+R_DeleteWorldVBO
+===============
+*/
+void R_DeleteWorldVBO( void ) {
+	if ( s_worldData.vbo ) {
+		qglDeleteBuffers( 1, &s_worldData.vbo );
+		s_worldData.vbo = 0;
+		s_worldData.vboVertexes = 0;
+	}
+}
+
 
 
 /*
@@ -1640,6 +1781,29 @@ static	void R_LoadFogs( lump_t *l, lump_t *brushesLump, lump_t *sidesLump ) {
 }
 
 
+/*
+================
+R_LightGridDirection
+
+Decodes the lat/long direction of a light grid point
+================
+*/
+static void R_LightGridDirection( const byte *data, vec4_t dir ) {
+	int		lat, lng;
+
+	lat = data[7] * (FUNCTABLE_SIZE/256);
+	lng = data[6] * (FUNCTABLE_SIZE/256);
+
+	// decode X as cos( lat ) * sin( long )
+	// decode Y as sin( lat ) * sin( long )
+	// decode Z as cos( long )
+
+	dir[0] = tr.sinTable[(lat+(FUNCTABLE_SIZE/4))&FUNCTABLE_MASK] * tr.sinTable[lng];
+	dir[1] = tr.sinTable[lat] * tr.sinTable[lng];
+	dir[2] = tr.sinTable[(lng+(FUNCTABLE_SIZE/4))&FUNCTABLE_MASK];
+	dir[3] = 0;
+}
+
 /*
 ================
 R_LoadLightGrid
@@ -1684,6 +1848,23 @@ void R_LoadLightGrid( lump_t *l ) {
 		R_ColorShiftLightingBytes( &w->lightGridData[i*8], &w->lightGridData[i*8] );
 		R_ColorShiftLightingBytes( &w->lightGridData[i*8+3], &w->lightGridData[i*8+3] );
 	}
+
+	// decode it once instead of in every lookup, samples in walls
+	// are left zero
+	w->lightGridPoints = ri.Hunk_Alloc( numGridPoints * sizeof( *w->lightGridPoints ), h_low );
+	for ( i = 0 ; i < numGridPoints ; i++ ) {
+		const byte			*data = &w->lightGridData[i*8];
+		lightGridPoint_t	*point = &w->lightGridPoints[i];
+
+		if ( !( data[0] + data[1] + data[2] ) ) {
+			continue;
+		}
+
+		VectorSet( point->ambient, data[0], data[1], data[2] );
+		point->ambient[3] = 1.0f;
+		VectorSet( point->directed, data[3], data[4], data[5] );
+		R_LightGridDirection( data, point->dir );
+	}
 }
 
 /*
@@ -1849,14 +2030,18 @@ void RE_LoadWorldMap( const char *name ) {
 
 	// load into heap
 	R_LoadShaders( &header->lumps[LUMP_SHADERS] );
+	R_PrefetchShaderImages( s_worldData.shaders, s_worldData.numShaders );
 	R_LoadLightmaps( &header->lumps[LUMP_LIGHTMAPS] );
 	R_LoadPlanes (&header->lumps[LUMP_PLANES]);
 	R_LoadFogs( &header->lumps[LUMP_FOGS], &header->lumps[LUMP_BRUSHES], &header->lumps[LUMP_BRUSHSIDES] );
 	R_LoadSurfaces( &header->lumps[LUMP_SURFACES], &header->lumps[LUMP_DRAWVERTS], &header->lumps[LUMP_DRAWINDEXES] );
+	R_FlushPrefetchedJPGs();	// the world shaders are registered now
+	R_CreateWorldVBO();
 	R_LoadMarksurfaces (&header->lumps[LUMP_LEAFSURFACES]);
 	R_LoadNodesAndLeafs (&header->lumps[LUMP_NODES], &header->lumps[LUMP_LEAFS]);
 	R_LoadSubmodels (&header->lumps[LUMP_MODELS]);
 	R_LoadVisibility( &header->lumps[LUMP_VISIBILITY] );
+	R_LoadClusterLeafs();
 	R_LoadEntities( &header->lumps[LUMP_ENTITIES] );
 	R_LoadLightGrid( &header->lumps[LUMP_LIGHTGRID] );
 
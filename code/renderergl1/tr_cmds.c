@@ -46,6 +46,8 @@ void R_PerformanceCounters( void ) {
 		ri.Printf (PRINT_ALL, "(md3) %i sin %i sclip  %i sout %i bin %i bclip %i bout\n",
 			tr.pc.c_sphere_cull_md3_in, tr.pc.c_sphere_cull_md3_clip, tr.pc.c_sphere_cull_md3_out, 
 			tr.pc.c_box_cull_md3_in, tr.pc.c_box_cull_md3_clip, tr.pc.c_box_cull_md3_out );
+		ri.Printf (PRINT_ALL, "(occlusion) %i leafs %i entities culled\n",
+			tr.pc.c_occludedLeafs, tr.pc.c_occludedEntities );
 	} else if (r_speeds->integer == 3) {
 		ri.Printf (PRINT_ALL, "viewcluster: %i\n", tr.viewCluster );
 	} else if (r_speeds->integer == 4) {
@@ -78,7 +80,7 @@ R_IssueRenderCommands
 void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 	renderCommandList_t	*cmdList;
 
-	cmdList = &backEndData->commands;
+	cmdList = &backEndData[tr.smpFrame]->commands;
 	assert(cmdList);
 	// add an end-of-list command
 	*(int *)(cmdList->cmds + cmdList->used) = RC_END_OF_LIST;
@@ -86,6 +88,15 @@ void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 	// clear it out, in case this is a sync and not a buffer flip
 	cmdList->used = 0;
 
+	if ( glConfig.smpActive ) {
+		// sleep until the renderer has completed the previous batch,
+		// its counters are those of the previous frame
+		GLimp_FrontEndSleep();
+		if ( runPerformanceCounters ) {
+			tr.backEndMsec = backEnd.pc.msec;
+		}
+	}
+
 	if ( runPerformanceCounters ) {
 		R_PerformanceCounters();
 	}
@@ -93,7 +104,19 @@ void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 	// actually start the commands going
 	if ( !r_skipBackEnd->integer ) {
 		// let it start on the new batch
-		RB_ExecuteRenderCommands( cmdList->cmds );
+		if ( glConfig.smpActive ) {
+			GLimp_WakeRenderer( cmdList->cmds );
+			if ( tr.syncBackEnd ) {
+				R_SyncRenderThread();
+			}
+		} else {
+			RB_ExecuteRenderCommands( cmdList->cmds );
+		}
+	}
+	tr.syncBackEnd = qfalse;
+
+	if ( runPerformanceCounters && !glConfig.smpActive ) {
+		tr.backEndMsec = backEnd.pc.msec;
 	}
 }
 
@@ -110,6 +133,24 @@ void R_IssuePendingRenderCommands( void ) {
 		return;
 	}
 	R_IssueRenderCommands( qfalse );
+	R_SyncRenderThread();
+}
+
+
+/*
+====================
+R_SyncRenderThread
+
+Waits for the render thread to finish and takes the GL context back, for
+anything the front end does to GL directly. Pending commands are left in
+the list, unlike R_IssuePendingRenderCommands.
+====================
+*/
+void R_SyncRenderThread( void ) {
+	if ( !glConfig.smpActive ) {
+		return;
+	}
+	GLimp_FrontEndSleep();
 }
 
 /*
@@ -122,7 +163,7 @@ make sure there is enough command space
 void *R_GetCommandBufferReserved( int bytes, int reservedBytes ) {
 	renderCommandList_t	*cmdList;
 
-	cmdList = &backEndData->commands;
+	cmdList = &backEndData[tr.smpFrame]->commands;
 	bytes = PAD(bytes, sizeof(void *));
 
 	// always leave room for the end of list command
@@ -233,6 +274,41 @@ void RE_StretchPic ( float x, float y, float w, float h,
 	cmd->t2 = t2;
 }
 
+/*
+=============
+RE_StretchPics
+
+One command for the whole run, split only where it wouldn't fit the
+command buffer in one piece
+=============
+*/
+#define	MAX_STRETCH_PICS_CMD	256
+
+void RE_StretchPics( const stretchPic_t *pics, int numPics, qhandle_t hShader ) {
+	stretchPicsCommand_t	*cmd;
+	shader_t	*shader;
+	int			count;
+
+	if ( !tr.registered ) {
+		return;
+	}
+
+	shader = R_GetShaderByHandle( hShader );
+
+	for ( ; numPics > 0; numPics -= count, pics += count ) {
+		count = MIN( numPics, MAX_STRETCH_PICS_CMD );
+
+		cmd = R_GetCommandBuffer( sizeof( *cmd ) + count * sizeof( *pics ) );
+		if ( !cmd ) {
+			return;
+		}
+		cmd->commandId = RC_STRETCH_PICS;
+		cmd->shader = shader;
+		cmd->numPics = count;
+		Com_Memcpy( cmd + 1, pics, count * sizeof( *pics ) );
+	}
+}
+
 #define MODE_RED_CYAN	1
 #define MODE_RED_BLUE	2
 #define MODE_RED_GREEN	3
@@ -384,6 +460,8 @@ void RE_BeginFrame( stereoFrame_t stereoFrame ) {
 		{
 			if(r_anaglyphMode->modified)
 			{
+				R_SyncRenderThread();
+
 				// clear both, front and backbuffer.
 				qglColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 				qglClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -437,6 +515,7 @@ void RE_BeginFrame( stereoFrame_t stereoFrame ) {
 
 			if(r_anaglyphMode->modified)
 			{
+				R_SyncRenderThread();
 				qglColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 				r_anaglyphMode->modified = qfalse;
 			}
@@ -471,8 +550,25 @@ void RE_EndFrame( int *frontEndMsec, int *backEndMsec ) {
 	}
 	cmd->commandId = RC_SWAP_BUFFERS;
 
+	if ( glConfig.smpActive ) {
+		// the overdraw count reads back through the hunk
+		if ( r_measureOverdraw->integer ) {
+			tr.syncBackEnd = qtrue;
+		}
+
+		// the window is only changed from the main thread
+		if ( r_fullscreen->modified ) {
+			R_SyncRenderThread();
+			GLimp_CheckFullscreen();
+		}
+	}
+
 	R_IssueRenderCommands( qtrue );
 
+	// a batch with a screenshot was synced, so the back end can't be
+	// queueing one now
+	R_FinishScreenshots( qfalse );
+
 	R_InitNextFrame();
 
 	if ( frontEndMsec ) {
@@ -480,9 +576,8 @@ void RE_EndFrame( int *frontEndMsec, int *backEndMsec ) {
 	}
 	tr.frontEndMsec = 0;
 	if ( backEndMsec ) {
-		*backEndMsec = backEnd.pc.msec;
+		*backEndMsec = tr.backEndMsec;
 	}
-	backEnd.pc.msec = 0;
 }
 
 /*
@@ -490,8 +585,7 @@ void RE_EndFrame( int *frontEndMsec, int *backEndMsec ) {
 RE_TakeVideoFrame
 =============
 */
-void RE_TakeVideoFrame( int width, int height,
-		byte *captureBuffer, byte *encodeBuffer, qboolean motionJpeg )
+void RE_TakeVideoFrame( int width, int height, byte *captureBuffer )
 {
 	videoFrameCommand_t	*cmd;
 
@@ -509,6 +603,19 @@ void RE_TakeVideoFrame( int width, int height,
 	cmd->width = width;
 	cmd->height = height;
 	cmd->captureBuffer = captureBuffer;
-	cmd->encodeBuffer = encodeBuffer;
-	cmd->motionJpeg = motionJpeg;
+
+	tr.syncBackEnd = qtrue;
+}
+
+/*
+=============
+RE_FinishVideoFrames
+
+Every frame is read back by its own command, so this only has to wait for
+the last one to run
+=============
+*/
+void RE_FinishVideoFrames( byte *captureBuffer )
+{
+	R_IssuePendingRenderCommands();
 }
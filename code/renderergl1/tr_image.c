@@ -22,6 +22,14 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 // tr_image.c
 #include "tr_local.h"
 
+#if defined( __SSE2__ ) || idx64
+#include <emmintrin.h>
+#define USE_SSE2_MIPMAP
+#elif defined( __aarch64__ )
+#include <arm_neon.h>
+#define USE_NEON_MIPMAP
+#endif
+
 static byte			 s_intensitytable[256];
 static unsigned char s_gammatable[256];
 
@@ -347,51 +355,31 @@ lighting range
 */
 void R_LightScaleTexture (unsigned *in, int inwidth, int inheight, qboolean only_gamma )
 {
-	if ( only_gamma )
-	{
-		if ( !glConfig.deviceSupportsGamma )
-		{
-			int		i, c;
-			byte	*p;
-
-			p = (byte *)in;
+	byte	table[256];
+	byte	*p;
+	int		i, c;
 
-			c = inwidth*inheight;
-			for (i=0 ; i<c ; i++, p+=4)
-			{
-				p[0] = s_gammatable[p[0]];
-				p[1] = s_gammatable[p[1]];
-				p[2] = s_gammatable[p[2]];
-			}
-		}
-	}
-	else
+	// fold intensity and gamma into one lookup
+	for ( i = 0; i < 256; i++ )
 	{
-		int		i, c;
-		byte	*p;
+		c = only_gamma ? i : s_intensitytable[i];
+		table[i] = glConfig.deviceSupportsGamma ? c : s_gammatable[c];
+	}
 
-		p = (byte *)in;
+	// hardware gamma with r_intensity 1 leaves the texels alone
+	for ( i = 0; i < 256 && table[i] == i; i++ )
+		;
+	if ( i == 256 )
+		return;
 
-		c = inwidth*inheight;
+	p = (byte *)in;
 
-		if ( glConfig.deviceSupportsGamma )
-		{
-			for (i=0 ; i<c ; i++, p+=4)
-			{
-				p[0] = s_intensitytable[p[0]];
-				p[1] = s_intensitytable[p[1]];
-				p[2] = s_intensitytable[p[2]];
-			}
-		}
-		else
-		{
-			for (i=0 ; i<c ; i++, p+=4)
-			{
-				p[0] = s_gammatable[s_intensitytable[p[0]]];
-				p[1] = s_gammatable[s_intensitytable[p[1]]];
-				p[2] = s_gammatable[s_intensitytable[p[2]]];
-			}
-		}
+	c = inwidth*inheight;
+	for (i=0 ; i<c ; i++, p+=4)
+	{
+		p[0] = table[p[0]];
+		p[1] = table[p[1]];
+		p[2] = table[p[2]];
 	}
 }
 
@@ -490,7 +478,34 @@ static void R_MipMap (byte *in, int width, int height) {
 	}
 
 	for (i=0 ; i<height ; i++, in+=row) {
-		for (j=0 ; j<width ; j++, out+=4, in+=8) {
+		j = 0;
+#if defined( USE_SSE2_MIPMAP )
+		// two output pixels from four input pixels on each row
+		for ( ; j + 2 <= width ; j += 2, out += 8, in += 16 ) {
+			__m128i zero = _mm_setzero_si128();
+			__m128i a = _mm_loadu_si128( (const __m128i *)in );
+			__m128i b = _mm_loadu_si128( (const __m128i *)( in + row ) );
+			__m128i lo = _mm_add_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ) );
+			__m128i hi = _mm_add_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ) );
+
+			lo = _mm_add_epi16( lo, _mm_srli_si128( lo, 8 ) );
+			hi = _mm_add_epi16( hi, _mm_srli_si128( hi, 8 ) );
+			lo = _mm_srli_epi16( _mm_unpacklo_epi64( lo, hi ), 2 );
+			_mm_storel_epi64( (__m128i *)out, _mm_packus_epi16( lo, lo ) );
+		}
+#elif defined( USE_NEON_MIPMAP )
+		for ( ; j + 2 <= width ; j += 2, out += 8, in += 16 ) {
+			uint8x16_t a = vld1q_u8( in );
+			uint8x16_t b = vld1q_u8( in + row );
+			uint16x8_t lo = vaddl_u8( vget_low_u8( a ), vget_low_u8( b ) );
+			uint16x8_t hi = vaddl_u8( vget_high_u8( a ), vget_high_u8( b ) );
+
+			lo = vcombine_u16( vadd_u16( vget_low_u16( lo ), vget_high_u16( lo ) ),
+				vadd_u16( vget_low_u16( hi ), vget_high_u16( hi ) ) );
+			vst1_u8( out, vshrn_n_u16( lo, 2 ) );
+		}
+#endif
+		for ( ; j<width ; j++, out+=4, in+=8) {
 			out[0] = (in[0] + in[4] + in[row+0] + in[row+4])>>2;
 			out[1] = (in[1] + in[5] + in[row+1] + in[row+5])>>2;
 			out[2] = (in[2] + in[6] + in[row+2] + in[row+6])>>2;
@@ -567,6 +582,7 @@ static void Upload32( unsigned *data,
 	byte		*scan;
 	GLenum		internalFormat = GL_RGB;
 	float		rMax = 0, gMax = 0, bMax = 0;
+	qboolean	gpuMipMaps;
 
 	//
 	// convert to exact power of 2 sizes
@@ -775,9 +791,15 @@ static void Upload32( unsigned *data,
 	*pUploadHeight = scaled_height;
 	*format = internalFormat;
 
+	// let the driver build the box filtered mips from level 0
+	gpuMipMaps = mipmap && r_gpuMipMaps->integer && r_simpleMipMaps->integer && !r_colorMipLevels->integer
+		&& ( QGL_VERSION_ATLEAST( 1, 4 ) || qglesMajorVersion >= 1 );
+	if ( gpuMipMaps )
+		qglTexParameteri( GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE );
+
 	qglTexImage2D (GL_TEXTURE_2D, 0, internalFormat, scaled_width, scaled_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, scaledBuffer );
 
-	if (mipmap)
+	if (mipmap && !gpuMipMaps)
 	{
 		int		miplevel;
 
@@ -854,6 +876,9 @@ image_t *R_CreateImage( const char *name, byte *pic, int width, int height,
 		ri.Error( ERR_DROP, "R_CreateImage: MAX_DRAWIMAGES hit");
 	}
 
+	// uploads need the context
+	R_SyncRenderThread();
+
 	image = tr.images[tr.numImages] = ri.Hunk_Alloc( sizeof( image_t ), h_low );
 	qglGenTextures(1, &image->texnum);
 	tr.numImages++;
@@ -1028,6 +1053,7 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, imgFlags_t flags )
 	int		width, height;
 	byte	*pic;
 	long	hash;
+	int		picmipDone;
 
 	if (!name) {
 		return NULL;
@@ -1051,14 +1077,22 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, imgFlags_t flags )
 	}
 
 	//
-	// load the pic from disk
+	// load the pic from disk, a JPEG can be decoded picmipped already
 	//
+	R_SetJPGPicmip( ( flags & IMGFLAG_PICMIP ) ? r_picmip->integer : 0 );
 	R_LoadImage( name, &pic, &width, &height );
+	picmipDone = R_JPGPicmipDone();
+	R_SetJPGPicmip( 0 );
 	if ( pic == NULL ) {
 		return NULL;
 	}
 
-	image = R_CreateImage( ( char * ) name, pic, width, height, type, flags, 0 );
+	if ( picmipDone ) {
+		image = R_CreateImage( ( char * ) name, pic, width, height, type, flags & ~IMGFLAG_PICMIP, 0 );
+		image->flags = flags;
+	} else {
+		image = R_CreateImage( ( char * ) name, pic, width, height, type, flags, 0 );
+	}
 	ri.Free( pic );
 	return image;
 }
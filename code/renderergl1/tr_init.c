@@ -84,6 +84,7 @@ cvar_t	*r_speeds;
 cvar_t	*r_fullbright;
 cvar_t	*r_novis;
 cvar_t	*r_nocull;
+cvar_t	*r_occlusionCull;
 cvar_t	*r_facePlaneCull;
 cvar_t	*r_showcluster;
 cvar_t	*r_nocurves;
@@ -110,6 +111,8 @@ cvar_t  *r_ext_multisample;
 cvar_t	*r_drawBuffer;
 cvar_t	*r_lightmap;
 cvar_t	*r_vertexLight;
+cvar_t	*r_worldVBO;
+cvar_t	*r_smp;
 cvar_t	*r_uiFullScreen;
 cvar_t	*r_shadows;
 cvar_t	*r_flares;
@@ -132,6 +135,7 @@ cvar_t	*r_gamma;
 cvar_t	*r_intensity;
 cvar_t	*r_lockpvs;
 cvar_t	*r_noportals;
+cvar_t	*r_simd;
 cvar_t	*r_portalOnly;
 
 cvar_t	*r_subdivisions;
@@ -149,6 +153,8 @@ cvar_t	*r_mapOverBrightBits;
 
 cvar_t	*r_debugSurface;
 cvar_t	*r_simpleMipMaps;
+cvar_t	*r_gpuMipMaps;
+cvar_t	*r_prefetchImages;
 
 cvar_t	*r_showImages;
 
@@ -158,6 +164,7 @@ cvar_t	*r_debugLight;
 cvar_t	*r_debugSort;
 cvar_t	*r_printShaders;
 cvar_t	*r_saveFontData;
+cvar_t	*r_modelCache;
 
 cvar_t	*r_marksOnTriangleMeshes;
 
@@ -205,6 +212,16 @@ static void InitOpenGL( void )
 		{
 			glConfig.maxTextureSize = 0;
 		}
+
+		if ( r_smp->integer ) {
+			ri.Printf( PRINT_ALL, "Trying SMP acceleration...\n" );
+			if ( GLimp_SpawnRenderThread( RB_RenderThread ) ) {
+				ri.Printf( PRINT_ALL, "...succeeded.\n" );
+				glConfig.smpActive = qtrue;
+			} else {
+				ri.Printf( PRINT_ALL, "...failed.\n" );
+			}
+		}
 	}
 
 	// set default state
@@ -394,85 +411,33 @@ byte *RB_ReadPixels(int x, int y, int width, int height, size_t *offset, int *pa
 /* 
 ================== 
 RB_TakeScreenshot
+
+Reads the pixels for R_QueueScreenshot, which encodes and writes them
 ================== 
 */  
-void RB_TakeScreenshot(int x, int y, int width, int height, char *fileName)
+void RB_TakeScreenshot(int x, int y, int width, int height, char *fileName, qboolean jpeg)
 {
-	byte *allbuf, *buffer;
-	byte *srcptr, *destptr;
-	byte *endline, *endmem;
-	byte temp;
-	
-	int linelen, padlen;
-	size_t offset = 18, memcount;
-		
-	allbuf = RB_ReadPixels(x, y, width, height, &offset, &padlen);
-	buffer = allbuf + offset - 18;
-	
-	Com_Memset (buffer, 0, 18);
-	buffer[2] = 2;		// uncompressed type
-	buffer[12] = width & 255;
-	buffer[13] = width >> 8;
-	buffer[14] = height & 255;
-	buffer[15] = height >> 8;
-	buffer[16] = 24;	// pixel size
+	byte *pixels;
+	int linelen, padwidth;
+	GLint packAlign;
+
+	qglGetIntegerv(GL_PACK_ALIGNMENT, &packAlign);
 
-	// swap rgb to bgr and remove padding from line endings
 	linelen = width * 3;
-	
-	srcptr = destptr = allbuf + offset;
-	endmem = srcptr + (linelen + padlen) * height;
-	
-	while(srcptr < endmem)
-	{
-		endline = srcptr + linelen;
+	padwidth = PAD(linelen, packAlign);
 
-		while(srcptr < endline)
-		{
-			temp = srcptr[0];
-			*destptr++ = srcptr[2];
-			*destptr++ = srcptr[1];
-			*destptr++ = temp;
-			
-			srcptr += 3;
-		}
-		
-		// Skip the pad
-		srcptr += padlen;
+	// malloc is aligned enough for any pack alignment
+	pixels = malloc(padwidth * height);
+	if(!pixels)
+	{
+		ri.Printf(PRINT_WARNING, "Couldn't allocate screenshot %s\n", fileName);
+		return;
 	}
 
-	memcount = linelen * height;
-
-	// gamma correct
-	if(glConfig.deviceSupportsGamma)
-		R_GammaCorrect(allbuf + offset, memcount);
-
-	ri.FS_WriteFile(fileName, buffer, memcount + 18);
-
-	ri.Hunk_FreeTempMemory(allbuf);
-}
-
-/* 
-================== 
-RB_TakeScreenshotJPEG
-================== 
-*/
-
-void RB_TakeScreenshotJPEG(int x, int y, int width, int height, char *fileName)
-{
-	byte *buffer;
-	size_t offset = 0, memcount;
-	int padlen;
-
-	buffer = RB_ReadPixels(x, y, width, height, &offset, &padlen);
-	memcount = (width * 3 + padlen) * height;
+	qglReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
 
-	// gamma correct
-	if(glConfig.deviceSupportsGamma)
-		R_GammaCorrect(buffer + offset, memcount);
-
-	RE_SaveJPG(fileName, r_screenshotJpegQuality->integer, width, height, buffer + offset, padlen);
-	ri.Hunk_FreeTempMemory(buffer);
+	R_QueueScreenshot(fileName, jpeg, r_screenshotJpegQuality->integer, glConfig.deviceSupportsGamma,
+		pixels, width, height, padwidth - linelen);
 }
 
 /*
@@ -485,10 +450,7 @@ const void *RB_TakeScreenshotCmd( const void *data ) {
 	
 	cmd = (const screenshotCommand_t *)data;
 	
-	if (cmd->jpeg)
-		RB_TakeScreenshotJPEG( cmd->x, cmd->y, cmd->width, cmd->height, cmd->fileName);
-	else
-		RB_TakeScreenshot( cmd->x, cmd->y, cmd->width, cmd->height, cmd->fileName);
+	RB_TakeScreenshot( cmd->x, cmd->y, cmd->width, cmd->height, cmd->fileName, cmd->jpeg );
 	
 	return (const void *)(cmd + 1);	
 }
@@ -515,6 +477,8 @@ void R_TakeScreenshot( int x, int y, int width, int height, char *name, qboolean
 	Q_strncpyz( fileName, name, sizeof(fileName) );
 	cmd->fileName = fileName;
 	cmd->jpeg = jpeg;
+
+	tr.syncBackEnd = qtrue;
 }
 
 /* 
@@ -587,6 +551,9 @@ void R_LevelShot( void ) {
 	float		xScale, yScale;
 	int			xx, yy;
 
+	// read directly from the front end
+	R_SyncRenderThread();
+
 	Com_sprintf(checkname, sizeof(checkname), "levelshots/%s.tga", tr.world->baseName);
 
 	allsource = RB_ReadPixels(0, 0, glConfig.vidWidth, glConfig.vidHeight, &offset, &padlen);
@@ -764,7 +731,7 @@ const void *RB_TakeVideoFrameCmd( const void *data )
 	const videoFrameCommand_t	*cmd;
 	byte				*cBuf;
 	size_t				memcount, linelen;
-	int				padwidth, avipadwidth, padlen, avipadlen;
+	int				padwidth, padlen;
 	GLint packAlign;
 	
 	cmd = (const videoFrameCommand_t *)data;
@@ -776,9 +743,6 @@ const void *RB_TakeVideoFrameCmd( const void *data )
 	// Alignment stuff for glReadPixels
 	padwidth = PAD(linelen, packAlign);
 	padlen = padwidth - linelen;
-	// AVI line padding
-	avipadwidth = PAD(linelen, AVI_LINE_PADDING);
-	avipadlen = avipadwidth - linelen;
 
 	cBuf = PADP(cmd->captureBuffer, packAlign);
 		
@@ -791,42 +755,8 @@ const void *RB_TakeVideoFrameCmd( const void *data )
 	if(glConfig.deviceSupportsGamma)
 		R_GammaCorrect(cBuf, memcount);
 
-	if(cmd->motionJpeg)
-	{
-		memcount = RE_SaveJPGToBuffer(cmd->encodeBuffer, linelen * cmd->height,
-			r_aviMotionJpegQuality->integer,
-			cmd->width, cmd->height, cBuf, padlen);
-		ri.CL_WriteAVIVideoFrame(cmd->encodeBuffer, memcount);
-	}
-	else
-	{
-		byte *lineend, *memend;
-		byte *srcptr, *destptr;
-	
-		srcptr = cBuf;
-		destptr = cmd->encodeBuffer;
-		memend = srcptr + memcount;
-		
-		// swap R and B and remove line paddings
-		while(srcptr < memend)
-		{
-			lineend = srcptr + linelen;
-			while(srcptr < lineend)
-			{
-				*destptr++ = srcptr[2];
-				*destptr++ = srcptr[1];
-				*destptr++ = srcptr[0];
-				srcptr += 3;
-			}
-			
-			Com_Memset(destptr, '\0', avipadlen);
-			destptr += avipadlen;
-			
-			srcptr += padlen;
-		}
-		
-		ri.CL_WriteAVIVideoFrame(cmd->encodeBuffer, avipadwidth * cmd->height);
-	}
+	// the client encodes it
+	ri.CL_AVIVideoFrameCaptured(cBuf, padlen);
 
 	return (const void *)(cmd + 1);	
 }
@@ -918,6 +848,9 @@ void GfxInfo_f( void )
 		"fullscreen"
 	};
 
+	// the extension queries need the context
+	R_SyncRenderThread();
+
 	ri.Printf( PRINT_ALL, "\nGL_VENDOR: %s\n", glConfig.vendor_string );
 	ri.Printf( PRINT_ALL, "GL_RENDERER: %s\n", glConfig.renderer_string );
 	ri.Printf( PRINT_ALL, "GL_VERSION: %s\n", glConfig.version_string );
@@ -989,6 +922,8 @@ void GfxInfo_f( void )
 	ri.Printf( PRINT_ALL, "texture bits: %d\n", r_texturebits->integer );
 	ri.Printf( PRINT_ALL, "multitexture: %s\n", enablestrings[qglActiveTextureARB != 0] );
 	ri.Printf( PRINT_ALL, "compiled vertex arrays: %s\n", enablestrings[qglLockArraysEXT != 0 ] );
+	ri.Printf( PRINT_ALL, "world vertex buffer: %s\n", enablestrings[tr.world && tr.world->vbo] );
+	ri.Printf( PRINT_ALL, "render thread: %s\n", enablestrings[glConfig.smpActive] );
 	ri.Printf( PRINT_ALL, "texenv add: %s\n", enablestrings[glConfig.textureEnvAddAvailable != 0] );
 	ri.Printf( PRINT_ALL, "compressed textures: %s\n", enablestrings[glConfig.textureCompression!=TC_NONE] );
 	if ( r_vertexLight->integer || glConfig.hardwareType == GLHW_PERMEDIA2 )
@@ -1052,14 +987,18 @@ void R_Register( void )
 	r_customheight = ri.Cvar_Get( "r_customheight", "1024", CVAR_ARCHIVE | CVAR_LATCH );
 	r_customPixelAspect = ri.Cvar_Get( "r_customPixelAspect", "1", CVAR_ARCHIVE | CVAR_LATCH );
 	r_simpleMipMaps = ri.Cvar_Get( "r_simpleMipMaps", "1", CVAR_ARCHIVE | CVAR_LATCH );
+	r_gpuMipMaps = ri.Cvar_Get( "r_gpuMipMaps", "1", CVAR_ARCHIVE | CVAR_LATCH );
+	r_prefetchImages = ri.Cvar_Get( "r_prefetchImages", "256", CVAR_ARCHIVE );
 	r_vertexLight = ri.Cvar_Get( "r_vertexLight", "0", CVAR_ARCHIVE | CVAR_LATCH );
+	r_worldVBO = ri.Cvar_Get( "r_worldVBO", "1", CVAR_ARCHIVE | CVAR_LATCH );
+	r_occlusionCull = ri.Cvar_Get( "r_occlusionCull", "0", CVAR_ARCHIVE );
 	r_uiFullScreen = ri.Cvar_Get( "r_uifullscreen", "0", 0);
 	r_subdivisions = ri.Cvar_Get ("r_subdivisions", "4", CVAR_ARCHIVE | CVAR_LATCH);
 	r_stereoEnabled = ri.Cvar_Get( "r_stereoEnabled", "0", CVAR_ARCHIVE | CVAR_LATCH);
 	r_ignoreFastPath = ri.Cvar_Get( "r_ignoreFastPath", "1", CVAR_ARCHIVE | CVAR_LATCH );
 	r_greyscale = ri.Cvar_Get("r_greyscale", "0", CVAR_ARCHIVE | CVAR_LATCH);
 	ri.Cvar_CheckRange(r_greyscale, 0, 1, qfalse);
-	ri.Cvar_Get("r_smp", "0", CVAR_ARCHIVE | CVAR_LATCH); // unused but must exist
+	r_smp = ri.Cvar_Get( "r_smp", "0", CVAR_ARCHIVE | CVAR_LATCH );
 
 	//
 	// temporary latched variables that can only change over a restart
@@ -1114,6 +1053,7 @@ void R_Register( void )
 	r_debugSort = ri.Cvar_Get( "r_debugSort", "0", CVAR_CHEAT );
 	r_printShaders = ri.Cvar_Get( "r_printShaders", "0", 0 );
 	r_saveFontData = ri.Cvar_Get( "r_saveFontData", "0", 0 );
+	r_modelCache = ri.Cvar_Get( "r_modelCache", "64", CVAR_ARCHIVE );
 
 	r_nocurves = ri.Cvar_Get ("r_nocurves", "0", CVAR_CHEAT );
 	r_drawworld = ri.Cvar_Get ("r_drawworld", "1", CVAR_CHEAT );
@@ -1148,6 +1088,7 @@ void R_Register( void )
 	r_drawBuffer = ri.Cvar_Get( "r_drawBuffer", "GL_BACK", CVAR_CHEAT );
 	r_lockpvs = ri.Cvar_Get ("r_lockpvs", "0", CVAR_CHEAT);
 	r_noportals = ri.Cvar_Get ("r_noportals", "0", CVAR_CHEAT);
+	r_simd = ri.Cvar_Get( "r_simd", "1", CVAR_ARCHIVE | CVAR_LATCH );
 	r_shadows = ri.Cvar_Get( "cg_shadows", "1", 0 );
 
 	r_marksOnTriangleMeshes = ri.Cvar_Get("r_marksOnTriangleMeshes", "0", CVAR_ARCHIVE);
@@ -1171,6 +1112,45 @@ void R_Register( void )
 	ri.Cmd_AddCommand( "minimize", GLimp_Minimize );
 }
 
+/*
+===============
+R_InitQueries
+===============
+*/
+static void R_InitQueries( void ) {
+	int		i;
+
+	tr.occlusionQuery = ( qglGenQueries != NULL );
+	if ( !tr.occlusionQuery ) {
+		return;
+	}
+
+	for ( i = 0 ; i < MAX_OCCLUSION_QUERIES ; i++ ) {
+		qglGenQueries( 1, &tr.occlusionQueries[i].query );
+		tr.occlusionQueries[i].leaf = NULL;
+	}
+	tr.numOcclusionLeafs = 0;
+}
+
+/*
+===============
+R_ShutDownQueries
+===============
+*/
+static void R_ShutDownQueries( void ) {
+	int		i;
+
+	if ( !tr.occlusionQuery ) {
+		return;
+	}
+
+	for ( i = 0 ; i < MAX_OCCLUSION_QUERIES ; i++ ) {
+		qglDeleteQueries( 1, &tr.occlusionQueries[i].query );
+		tr.occlusionQueries[i].leaf = NULL;
+	}
+	tr.numOcclusionLeafs = 0;
+}
+
 /*
 ===============
 R_Init
@@ -1188,6 +1168,9 @@ void R_Init( void ) {
 	Com_Memset( &backEnd, 0, sizeof( backEnd ) );
 	Com_Memset( &tess, 0, sizeof( tess ) );
 
+	// the renderer has its own copy of the math table when loaded as a library
+	Q_InitMathFuncs( ri.Sys_GetProcessorFeatures() );
+
 	if(sizeof(glconfig_t) != 11332)
 		ri.Error( ERR_FATAL, "Mod ABI incompatible: sizeof(glconfig_t) == %u != 11332", (unsigned int) sizeof(glconfig_t));
 
@@ -1231,6 +1214,8 @@ void R_Init( void ) {
 
 	R_Register();
 
+	RB_InitTessCalc();
+
 	max_polys = r_maxpolys->integer;
 	if (max_polys < MAX_POLYS)
 		max_polys = MAX_POLYS;
@@ -1239,10 +1224,16 @@ void R_Init( void ) {
 	if (max_polyverts < MAX_POLYVERTS)
 		max_polyverts = MAX_POLYVERTS;
 
-	ptr = ri.Hunk_Alloc( sizeof( *backEndData ) + sizeof(srfPoly_t) * max_polys + sizeof(polyVert_t) * max_polyverts, h_low);
-	backEndData = (backEndData_t *) ptr;
-	backEndData->polys = (srfPoly_t *) ((char *) ptr + sizeof( *backEndData ));
-	backEndData->polyVerts = (polyVert_t *) ((char *) ptr + sizeof( *backEndData ) + sizeof(srfPoly_t) * max_polys);
+	// the second frame is only needed by the render thread
+	for ( i = 0 ; i < ( ( r_smp->integer || glConfig.smpActive ) ? SMP_FRAMES : 1 ) ; i++ ) {
+		ptr = ri.Hunk_Alloc( sizeof( *backEndData[i] ) + sizeof(srfPoly_t) * max_polys + sizeof(polyVert_t) * max_polyverts, h_low);
+		backEndData[i] = (backEndData_t *) ptr;
+		backEndData[i]->polys = (srfPoly_t *) ((char *) ptr + sizeof( *backEndData[i] ));
+		backEndData[i]->polyVerts = (polyVert_t *) ((char *) ptr + sizeof( *backEndData[i] ) + sizeof(srfPoly_t) * max_polys);
+	}
+	for ( ; i < SMP_FRAMES ; i++ ) {
+		backEndData[i] = NULL;
+	}
 	R_InitNextFrame();
 
 	InitOpenGL();
@@ -1257,6 +1248,8 @@ void R_Init( void ) {
 
 	R_InitFreeType();
 
+	R_InitQueries();
+
 
 	err = qglGetError();
 	if ( err != GL_NO_ERROR )
@@ -1289,13 +1282,23 @@ void RE_Shutdown( qboolean destroyWindow ) {
 
 	if ( tr.registered ) {
 		R_IssuePendingRenderCommands();
+		R_FinishScreenshots( qtrue );
+		R_ShutDownQueries();
 		R_DeleteTextures();
+		R_DeleteWorldVBO();
 	}
 
+	R_FlushPrefetchedJPGs();
+
 	R_DoneFreeType();
 
 	// shut down platform specific OpenGL stuff
 	if ( destroyWindow ) {
+		R_ShutdownModelCache();
+
+		if ( glConfig.smpActive ) {
+			GLimp_ShutdownRenderThread();
+		}
 		GLimp_Shutdown();
 
 		Com_Memset( &glConfig, 0, sizeof( glConfig ) );
@@ -1380,6 +1383,7 @@ refexport_t *GetRefAPI ( int apiVersion, refimport_t *rimp ) {
 
 	re.SetColor = RE_SetColor;
 	re.DrawStretchPic = RE_StretchPic;
+	re.DrawStretchPics = RE_StretchPics;
 	re.DrawStretchRaw = RE_StretchRaw;
 	re.UploadCinematic = RE_UploadCinematic;
 
@@ -1389,6 +1393,8 @@ refexport_t *GetRefAPI ( int apiVersion, refimport_t *rimp ) {
 	re.inPVS = R_inPVS;
 
 	re.TakeVideoFrame = RE_TakeVideoFrame;
+	re.FinishVideoFrames = RE_FinishVideoFrames;
+	re.SaveJPGToBuffer = RE_SaveJPGToBuffer;
 
 	return &re;
 }
@@ -37,7 +37,9 @@ QGL_1_1_PROCS;
 QGL_1_1_FIXED_FUNCTION_PROCS;
 QGL_DESKTOP_1_1_PROCS;
 QGL_DESKTOP_1_1_FIXED_FUNCTION_PROCS;
+QGL_1_5_PROCS;
 QGL_3_0_PROCS;
+QGL_ARB_occlusion_query_PROCS;
 #undef GLE
 
 #define GL_INDEX_TYPE		GL_UNSIGNED_INT
@@ -457,10 +459,12 @@ typedef struct {
 	vec3_t		pvsOrigin;			// may be different than or.origin for portals
 	qboolean	isPortal;			// true if this view is through a portal
 	qboolean	isMirror;			// the portal is a mirror, invert the face culling
+	qboolean	occlusionCull;		// primary view, see R_LeafOccluded
 	int			frameSceneNum;		// copied from tr.frameSceneNum
 	int			frameCount;			// copied from tr.frameCount
 	cplane_t	portalPlane;		// clip anything behind this if mirroring
 	int			viewportX, viewportY, viewportWidth, viewportHeight;
+	int			scissorX, scissorY, scissorWidth, scissorHeight;	// 0 width for the whole viewport
 	float		fovX, fovY;
 	float		projectionMatrix[16];
 	cplane_t	frustum[4];
@@ -501,6 +505,11 @@ typedef struct drawSurf_s {
 	surfaceType_t		*surface;		// any of surface*_t
 } drawSurf_t;
 
+// with r_smp the front end fills one frame while the render thread draws
+// the other, anything written per frame by one and read by the other is kept
+// twice, indexed by tr.smpFrame and backEnd.smpFrame
+#define	SMP_FRAMES			2
+
 #define	MAX_FACE_POINTS		64
 
 #define	MAX_PATCH_SIZE		32			// max dimensions of a patch mesh in map file
@@ -528,7 +537,7 @@ typedef struct srfGridMesh_s {
 	surfaceType_t	surfaceType;
 
 	// dynamic lighting information
-	int				dlightBits;
+	int				dlightBits[SMP_FRAMES];
 
 	// culling information
 	vec3_t			meshBounds[2];
@@ -558,7 +567,9 @@ typedef struct {
 	cplane_t	plane;
 
 	// dynamic lighting information
-	int			dlightBits;
+	int			dlightBits[SMP_FRAMES];
+
+	int			vboFirstVertex;		// in the world VBO, -1 if not there
 
 	// triangle definitions (no normals at points)
 	int			numPoints;
@@ -574,13 +585,15 @@ typedef struct {
 	surfaceType_t	surfaceType;
 
 	// dynamic lighting information
-	int				dlightBits;
+	int				dlightBits[SMP_FRAMES];
 
 	// culling information (FIXME: use this!)
 	vec3_t			bounds[2];
 	vec3_t			localOrigin;
 	float			radius;
 
+	int				vboFirstVertex;		// in the world VBO, -1 if not there
+
 	// triangle definitions
 	int				numIndexes;
 	int				*indexes;
@@ -589,6 +602,14 @@ typedef struct {
 	drawVert_t		*verts;
 } srfTriangles_t;
 
+// what the world VBO keeps of a vertex, everything
+// RB_StageIteratorLightmappedMultitexture uses
+typedef struct {
+	vec3_t			xyz;
+	vec2_t			st;
+	vec2_t			lightmap;
+} worldVertex_t;
+
 typedef struct {
 	vec3_t translate;
 	quat_t rotate;
@@ -694,14 +715,47 @@ typedef struct mnode_s {
 
 	msurface_t	**firstmarksurface;
 	int			nummarksurfaces;
+
+	// leaf occlusion, see R_LeafOccluded
+	int			occlusionQuery;		// 1 + index in tr.occlusionQueries while one is out
+	int			occlusionFrame;		// tr.frameCount the last result was queried in
+	qboolean	occluded;
 } mnode_t;
 
+#define	MAX_OCCLUSION_QUERIES	2048
+
+typedef struct {
+	GLuint		query;
+	mnode_t		*leaf;				// NULL if the query is free
+	int			frame;				// tr.frameCount it was queued in
+	qboolean	issued;				// drawn by the back end
+} occlusionQuery_t;
+
 typedef struct {
 	vec3_t		bounds[2];		// for culling
 	msurface_t	*firstSurface;
 	int			numSurfaces;
 } bmodel_t;
 
+// a light grid point decoded at load, each part padded to four floats
+// so the trilerp in R_LightGridSample is the same sums for all of them
+typedef struct {
+	vec4_t		ambient;		// [3] is the weight, 0 for samples in walls
+	vec4_t		directed;
+	vec4_t		dir;
+} lightGridPoint_t;
+
+#define	LIGHTGRID_CACHE_SIZE	64		// power of two
+
+// the last samples taken, see R_SetupEntityLightingGrid
+typedef struct {
+	qboolean	used;
+	vec3_t		origin;
+	vec3_t		ambientLight;
+	vec3_t		directedLight;
+	vec3_t		lightDir;
+} lightGridCache_t;
+
 typedef struct {
 	char		name[MAX_QPATH];		// ie: maps/tim_dm2.bsp
 	char		baseName[MAX_QPATH];	// ie: tim_dm2
@@ -734,6 +788,8 @@ typedef struct {
 	vec3_t		lightGridInverseSize;
 	int			lightGridBounds[3];
 	byte		*lightGridData;
+	lightGridPoint_t	*lightGridPoints;
+	lightGridCache_t	lightGridCache[LIGHTGRID_CACHE_SIZE];
 
 
 	int			numClusters;
@@ -742,8 +798,14 @@ typedef struct {
 
 	byte		*novis;			// clusterBytes of 0xff
 
+	int			*clusterFirstLeaf;	// numClusters + 1 offsets into clusterLeafs
+	mnode_t		**clusterLeafs;
+
 	char		*entityString;
 	char		*entityParsePoint;
+
+	GLuint		vbo;			// lightmapped faces, 0 if there is none
+	int			vboVertexes;
 } world_t;
 
 //======================================================================
@@ -827,6 +889,7 @@ typedef struct {
 	int		c_box_cull_md3_in, c_box_cull_md3_clip, c_box_cull_md3_out;
 
 	int		c_leafs;
+	int		c_occludedLeafs, c_occludedEntities;
 	int		c_dlightSurfaces;
 	int		c_dlightSurfacesCulled;
 } frontEndCounters_t;
@@ -870,6 +933,7 @@ typedef struct {
 	backEndCounters_t	pc;
 	qboolean	isHyperspace;
 	trRefEntity_t	*currentEntity;
+	int			smpFrame;
 	qboolean	skyRenderedThisView;	// flag for drawing sun
 
 	qboolean	projection2D;	// if qtrue, drawstretchpic doesn't need to change modes
@@ -943,6 +1007,10 @@ typedef struct {
 
 	frontEndCounters_t		pc;
 	int						frontEndMsec;		// not in pc due to clearing issue
+	int						backEndMsec;		// of the last full batch, the previous frame with r_smp
+
+	int						smpFrame;			// backEndData being filled by the front end
+	qboolean				syncBackEnd;		// the batch uses the hunk or file system, wait for it
 
 	//
 	// put large tables at the end, so most elements will be
@@ -964,6 +1032,16 @@ typedef struct {
 	int						numSkins;
 	skin_t					*skins[MAX_SKINS];
 
+	qboolean				occlusionQuery;			// GL_ARB_occlusion_query procs are there
+	occlusionQuery_t		occlusionQueries[MAX_OCCLUSION_QUERIES];
+	int						occlusionQueryCursor;
+	int						occlusionQueriesOut;
+	int						occlusionLeafs[MAX_OCCLUSION_QUERIES];	// queries queued for this frame
+	int						numOcclusionLeafs;
+	int						occlusionResetFrame;	// results queried before this are ignored
+	int						occlusionViewFrame;		// tr.frameCount of the last occlusion culled view
+	vec3_t					occlusionOrigin;
+
 	float					sinTable[FUNCTABLE_SIZE];
 	float					squareTable[FUNCTABLE_SIZE];
 	float					triangleTable[FUNCTABLE_SIZE];
@@ -1020,6 +1098,7 @@ extern	cvar_t	*r_speeds;				// various levels of information display
 extern  cvar_t	*r_detailTextures;		// enables/disables detail texturing stages
 extern	cvar_t	*r_novis;				// disable/enable usage of PVS
 extern	cvar_t	*r_nocull;
+extern	cvar_t	*r_occlusionCull;		// skip leafs and entities that GL occlusion queries found hidden
 extern	cvar_t	*r_facePlaneCull;		// enables culling of planar surfaces with back side test
 extern	cvar_t	*r_nocurves;
 extern	cvar_t	*r_showcluster;
@@ -1040,6 +1119,8 @@ extern	cvar_t	*r_offsetUnits;
 extern	cvar_t	*r_fullbright;					// avoid lightmap pass
 extern	cvar_t	*r_lightmap;					// render lightmaps only
 extern	cvar_t	*r_vertexLight;					// vertex lighting mode for better performance
+extern	cvar_t	*r_worldVBO;					// keep lightmapped world surfaces in a vertex buffer
+extern	cvar_t	*r_smp;							// run the back end on its own thread
 extern	cvar_t	*r_uiFullScreen;				// ui is running fullscreen
 
 extern	cvar_t	*r_logFile;						// number of frames to emit GL logs
@@ -1055,6 +1136,7 @@ extern	cvar_t	*r_intensity;
 
 extern	cvar_t	*r_lockpvs;
 extern	cvar_t	*r_noportals;
+extern	cvar_t	*r_simd;						// SSE2/NEON versions of the tess vertex loops
 extern	cvar_t	*r_portalOnly;
 
 extern	cvar_t	*r_subdivisions;
@@ -1072,6 +1154,8 @@ extern	cvar_t	*r_mapOverBrightBits;
 
 extern	cvar_t	*r_debugSurface;
 extern	cvar_t	*r_simpleMipMaps;
+extern	cvar_t	*r_gpuMipMaps;			// driver built mips with GL_GENERATE_MIPMAP
+extern	cvar_t	*r_prefetchImages;		// MB of JPEGs to decode on the worker threads at map load
 
 extern	cvar_t	*r_showImages;
 extern	cvar_t	*r_debugSort;
@@ -1171,6 +1255,7 @@ qhandle_t	RE_RegisterSkin( const char *name );
 void		RE_Shutdown( qboolean destroyWindow );
 
 qboolean	R_GetEntityToken( char *buffer, int size );
+void		R_DeleteWorldVBO( void );
 
 model_t		*R_AllocModel( void );
 
@@ -1201,6 +1286,7 @@ const void *RB_TakeVideoFrameCmd( const void *data );
 // tr_shader.c
 //
 shader_t	*R_FindShader( const char *name, int lightmapIndex, qboolean mipRawImage );
+void		R_PrefetchShaderImages( const dshader_t *shaders, int numShaders );
 shader_t	*R_GetShaderByHandle( qhandle_t hShader );
 shader_t	*R_GetShaderByState( int index, long *cycleTime );
 shader_t *R_FindShaderByName( const char *name );
@@ -1246,6 +1332,11 @@ typedef struct shaderCommands_s
 	int			numIndexes;
 	int			numVertexes;
 
+	// world VBO surfaces, indexes into tr.world->vbo drawn before the
+	// vertexes above, see RB_SurfaceFace
+	glIndex_t	vboIndexes[SHADER_MAX_INDEXES] QALIGN(16);
+	int			numVboIndexes;
+
 	// info extracted from current shader
 	int			numPasses;
 	void		(*currentStageIteratorFunc)( void );
@@ -1280,6 +1371,7 @@ WORLD MAP
 
 void R_AddBrushModelSurfaces( trRefEntity_t *e );
 void R_AddWorldSurfaces( void );
+qboolean R_EntityOccluded( const trRefEntity_t *ent );
 qboolean R_inPVS( const vec3_t p1, const vec3_t p2 );
 
 
@@ -1426,6 +1518,7 @@ void	R_TransformModelToClip( const vec3_t src, const float *modelMatrix, const f
 							vec4_t eye, vec4_t dst );
 void	R_TransformClipToWindow( const vec4_t clip, const viewParms_t *view, vec4_t normalized, vec4_t window );
 
+void	RB_InitTessCalc( void );
 void	RB_DeformTessGeometry( void );
 
 void	RB_CalcEnvironmentTexCoords( float *dstTexCoords );
@@ -1509,6 +1602,13 @@ typedef struct {
 	float	s2, t2;
 } stretchPicCommand_t;
 
+typedef struct {
+	int		commandId;
+	shader_t	*shader;
+	int		numPics;
+	// followed by numPics stretchPic_t
+} stretchPicsCommand_t;
+
 typedef struct {
 	int		commandId;
 	trRefdef_t	refdef;
@@ -1532,8 +1632,6 @@ typedef struct {
 	int						width;
 	int						height;
 	byte					*captureBuffer;
-	byte					*encodeBuffer;
-	qboolean			motionJpeg;
 } videoFrameCommand_t;
 
 typedef struct
@@ -1552,6 +1650,7 @@ typedef enum {
 	RC_END_OF_LIST,
 	RC_SET_COLOR,
 	RC_STRETCH_PIC,
+	RC_STRETCH_PICS,
 	RC_DRAW_SURFS,
 	RC_DRAW_BUFFER,
 	RC_SWAP_BUFFERS,
@@ -1582,27 +1681,30 @@ typedef struct {
 extern	int		max_polys;
 extern	int		max_polyverts;
 
-extern	backEndData_t	*backEndData;	// the second one may not be allocated
+extern	backEndData_t	*backEndData[SMP_FRAMES];	// the second one may not be allocated
 
 
 void *R_GetCommandBuffer( int bytes );
 void RB_ExecuteRenderCommands( const void *data );
 
 void R_IssuePendingRenderCommands( void );
+void R_SyncRenderThread( void );
+void RB_RenderThread( void );
 
 void R_AddDrawSurfCmd( drawSurf_t *drawSurfs, int numDrawSurfs );
 
 void RE_SetColor( const float *rgba );
 void RE_StretchPic ( float x, float y, float w, float h, 
 					  float s1, float t1, float s2, float t2, qhandle_t hShader );
+void RE_StretchPics( const stretchPic_t *pics, int numPics, qhandle_t hShader );
 void RE_BeginFrame( stereoFrame_t stereoFrame );
 void RE_EndFrame( int *frontEndMsec, int *backEndMsec );
 void RE_SaveJPG(char * filename, int quality, int image_width, int image_height,
                 unsigned char *image_buffer, int padding);
 size_t RE_SaveJPGToBuffer(byte *buffer, size_t bufSize, int quality,
 		          int image_width, int image_height, byte *image_buffer, int padding);
-void RE_TakeVideoFrame( int width, int height,
-		byte *captureBuffer, byte *encodeBuffer, qboolean motionJpeg );
+void RE_TakeVideoFrame( int width, int height, byte *captureBuffer );
+void RE_FinishVideoFrames( byte *captureBuffer );
 
 void R_DrawElements( int numIndexes, const glIndex_t *indexes );
 void VectorArrayNormalize( vec4_t *normals, unsigned int count );
@@ -841,12 +841,44 @@ static qboolean IsMirror( const drawSurf_t *drawSurf, int entityNum )
 	return qfalse;
 }
 
+/*
+** R_PortalScissor
+**
+** The window rectangle a portal surface covers in the current view, from
+** the normalized device coordinates of its vertexes.
+*/
+static void R_PortalScissor( const vec2_t mins, const vec2_t maxs, int scissor[4] ) {
+	const viewParms_t *vp = &tr.viewParms;
+	int		x0, y0, x1, y1;
+
+	// a pixel of slack for the rounding of the rasterizer
+	x0 = floor( ( Com_Clamp( -1, 1, mins[0] ) * 0.5f + 0.5f ) * vp->viewportWidth ) - 1;
+	y0 = floor( ( Com_Clamp( -1, 1, mins[1] ) * 0.5f + 0.5f ) * vp->viewportHeight ) - 1;
+	x1 = ceil( ( Com_Clamp( -1, 1, maxs[0] ) * 0.5f + 0.5f ) * vp->viewportWidth ) + 1;
+	y1 = ceil( ( Com_Clamp( -1, 1, maxs[1] ) * 0.5f + 0.5f ) * vp->viewportHeight ) + 1;
+
+	if ( x0 < 0 )
+		x0 = 0;
+	if ( y0 < 0 )
+		y0 = 0;
+	if ( x1 > vp->viewportWidth )
+		x1 = vp->viewportWidth;
+	if ( y1 > vp->viewportHeight )
+		y1 = vp->viewportHeight;
+
+	scissor[0] = vp->viewportX + x0;
+	scissor[1] = vp->viewportY + y0;
+	scissor[2] = x1 - x0;
+	scissor[3] = y1 - y0;
+}
+
 /*
 ** SurfIsOffscreen
 **
-** Determines if a surface is completely offscreen.
+** Determines if a surface is completely offscreen. scissor gets the window
+** rectangle it covers, 0 width if it can't be bounded.
 */
-static qboolean SurfIsOffscreen( const drawSurf_t *drawSurf, vec4_t clipDest[128] ) {
+static qboolean SurfIsOffscreen( const drawSurf_t *drawSurf, vec4_t clipDest[128], int scissor[4] ) {
 	float shortest = 100000000;
 	int entityNum;
 	int numTriangles;
@@ -857,6 +889,11 @@ static qboolean SurfIsOffscreen( const drawSurf_t *drawSurf, vec4_t clipDest[128
 	int i;
 	unsigned int pointOr = 0;
 	unsigned int pointAnd = (unsigned int)~0;
+	vec2_t mins, maxs;
+	qboolean behind = qfalse;
+
+	mins[0] = mins[1] = 1.0f;
+	maxs[0] = maxs[1] = -1.0f;
 
 	R_RotateForViewer();
 
@@ -886,6 +923,22 @@ static qboolean SurfIsOffscreen( const drawSurf_t *drawSurf, vec4_t clipDest[128
 		}
 		pointAnd &= pointFlags;
 		pointOr |= pointFlags;
+
+		// a vertex behind the viewer projects to the wrong side
+		if ( clip[3] <= 0.0f )
+		{
+			behind = qtrue;
+			continue;
+		}
+		for ( j = 0; j < 2; j++ )
+		{
+			float ndc = clip[j] / clip[3];
+
+			if ( ndc < mins[j] )
+				mins[j] = ndc;
+			if ( ndc > maxs[j] )
+				maxs[j] = ndc;
+		}
 	}
 
 	// trivially reject
@@ -894,6 +947,15 @@ static qboolean SurfIsOffscreen( const drawSurf_t *drawSurf, vec4_t clipDest[128
 		return qtrue;
 	}
 
+	if ( behind || r_portalOnly->integer )
+	{
+		scissor[0] = scissor[1] = scissor[2] = scissor[3] = 0;
+	}
+	else
+	{
+		R_PortalScissor( mins, maxs, scissor );
+	}
+
 	// determine if this surface is backfaced and also determine the distance
 	// to the nearest vertex so we can cull based on portal range.  Culling
 	// based on vertex distance isn't 100% correct (we should be checking for
@@ -948,6 +1010,7 @@ Returns qtrue if another view has been rendered
 */
 qboolean R_MirrorViewBySurface (drawSurf_t *drawSurf, int entityNum) {
 	vec4_t			clipDest[128];
+	int				scissor[4];
 	viewParms_t		newParms;
 	viewParms_t		oldParms;
 	orientation_t	surface, camera;
@@ -963,7 +1026,7 @@ qboolean R_MirrorViewBySurface (drawSurf_t *drawSurf, int entityNum) {
 	}
 
 	// trivially reject portal/mirror
-	if ( SurfIsOffscreen( drawSurf, clipDest ) ) {
+	if ( SurfIsOffscreen( drawSurf, clipDest, scissor ) ) {
 		return qfalse;
 	}
 
@@ -986,7 +1049,11 @@ qboolean R_MirrorViewBySurface (drawSurf_t *drawSurf, int entityNum) {
 	R_MirrorVector (oldParms.or.axis[1], &surface, &camera, newParms.or.axis[1]);
 	R_MirrorVector (oldParms.or.axis[2], &surface, &camera, newParms.or.axis[2]);
 
-	// OPTIMIZE: restrict the viewport on the mirrored view
+	// only the pixels under the portal surface are going to be seen
+	newParms.scissorX = scissor[0];
+	newParms.scissorY = scissor[1];
+	newParms.scissorWidth = scissor[2];
+	newParms.scissorHeight = scissor[3];
 
 	// render the mirror view
 	R_RenderView (&newParms);
@@ -1046,50 +1113,74 @@ DRAWSURF SORTING
 R_Radix
 ===============
 */
-static ID_INLINE void R_Radix( int byte, int size, drawSurf_t *source, drawSurf_t *dest )
+static ID_INLINE void R_Radix( int shift, const int *count, int size, const drawSurf_t *source, drawSurf_t *dest )
 {
-  int           count[ 256 ] = { 0 };
   int           index[ 256 ];
   int           i;
-  unsigned char *sortKey = NULL;
-  unsigned char *end = NULL;
-
-  sortKey = ( (unsigned char *)&source[ 0 ].sort ) + byte;
-  end = sortKey + ( size * sizeof( drawSurf_t ) );
-  for( ; sortKey < end; sortKey += sizeof( drawSurf_t ) )
-    ++count[ *sortKey ];
 
   index[ 0 ] = 0;
 
   for( i = 1; i < 256; ++i )
     index[ i ] = index[ i - 1 ] + count[ i - 1 ];
 
-  sortKey = ( (unsigned char *)&source[ 0 ].sort ) + byte;
-  for( i = 0; i < size; ++i, sortKey += sizeof( drawSurf_t ) )
-    dest[ index[ *sortKey ]++ ] = source[ i ];
+  for( i = 0; i < size; ++i )
+    dest[ index[ ( source[ i ].sort >> shift ) & 0xff ]++ ] = source[ i ];
 }
 
 /*
 ===============
 R_RadixSort
 
-Radix sort with 4 byte size buckets
+Radix sort with 4 byte size buckets. The counts for all four bytes are
+taken in a single pass over the keys, bytes that are the same in every
+key are skipped (usually the fog and dlight bits, and the high shader
+bits), and a view that is already in order is not touched at all.
 ===============
 */
 static void R_RadixSort( drawSurf_t *source, int size )
 {
   static drawSurf_t scratch[ MAX_DRAWSURFS ];
-#ifdef Q3_LITTLE_ENDIAN
-  R_Radix( 0, size, source, scratch );
-  R_Radix( 1, size, scratch, source );
-  R_Radix( 2, size, source, scratch );
-  R_Radix( 3, size, scratch, source );
-#else
-  R_Radix( 3, size, source, scratch );
-  R_Radix( 2, size, scratch, source );
-  R_Radix( 1, size, source, scratch );
-  R_Radix( 0, size, scratch, source );
-#endif //Q3_LITTLE_ENDIAN
+  int           count[ 4 ][ 256 ];
+  drawSurf_t    *from, *to, *swap;
+  unsigned      sort, last;
+  qboolean      sorted;
+  int           i, pass;
+
+  Com_Memset( count, 0, sizeof( count ) );
+
+  sorted = qtrue;
+  last = 0;
+  for( i = 0; i < size; ++i )
+  {
+    sort = source[ i ].sort;
+    if( sort < last )
+      sorted = qfalse;
+    last = sort;
+
+    ++count[ 0 ][ sort & 0xff ];
+    ++count[ 1 ][ ( sort >> 8 ) & 0xff ];
+    ++count[ 2 ][ ( sort >> 16 ) & 0xff ];
+    ++count[ 3 ][ sort >> 24 ];
+  }
+
+  if( sorted )
+    return;
+
+  from = source;
+  to = scratch;
+  for( pass = 0; pass < 4; ++pass )
+  {
+    if( count[ pass ][ ( source[ 0 ].sort >> ( pass * 8 ) ) & 0xff ] == size )
+      continue;
+
+    R_Radix( pass * 8, count[ pass ], size, from, to );
+    swap = from;
+    from = to;
+    to = swap;
+  }
+
+  if( from != source )
+    Com_Memcpy( source, from, size * sizeof( *source ) );
 }
 
 //==========================================================================================
@@ -1234,6 +1325,8 @@ void R_AddEntitySurfaces (void) {
 			tr.currentModel = R_GetModelByHandle( ent->e.hModel );
 			if (!tr.currentModel) {
 				R_AddDrawSurf( &entitySurface, tr.defaultShader, 0, 0 );
+			} else if ( tr.viewParms.occlusionCull && R_EntityOccluded( ent ) ) {
+				tr.pc.c_occludedEntities++;
 			} else {
 				switch ( tr.currentModel->type ) {
 				case MOD_MESH:
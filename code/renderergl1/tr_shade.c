@@ -322,6 +322,7 @@ void RB_BeginSurface( shader_t *shader, int fogNum ) {
 
 	tess.numIndexes = 0;
 	tess.numVertexes = 0;
+	tess.numVboIndexes = 0;
 	tess.shader = state;
 	tess.fogNum = fogNum;
 	tess.dlightBits = 0;		// will be OR'd in by surface functions
@@ -1182,6 +1183,52 @@ void RB_StageIteratorVertexLitTexture( void )
 	}
 }
 
+/*
+** RB_DrawWorldVBO
+**
+** The RB_StageIteratorLightmappedMultitexture pass for the surfaces in
+** the world VBO, which leaves the arrays pointing at tess again
+*/
+static void RB_DrawWorldVBO( void ) {
+	GL_State( GLS_DEFAULT );
+
+	qglBindBuffer( GL_ARRAY_BUFFER, tr.world->vbo );
+	qglVertexPointer( 3, GL_FLOAT, sizeof( worldVertex_t ), (void *)offsetof( worldVertex_t, xyz ) );
+
+	qglDisableClientState( GL_COLOR_ARRAY );
+	qglColor4f( 1, 1, 1, 1 );
+
+	GL_SelectTexture( 0 );
+	qglEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	R_BindAnimatedImage( &tess.xstages[0]->bundle[0] );
+	qglTexCoordPointer( 2, GL_FLOAT, sizeof( worldVertex_t ), (void *)offsetof( worldVertex_t, st ) );
+
+	GL_SelectTexture( 1 );
+	qglEnable( GL_TEXTURE_2D );
+	if ( r_lightmap->integer ) {
+		GL_TexEnv( GL_REPLACE );
+	} else {
+		GL_TexEnv( GL_MODULATE );
+	}
+	R_BindAnimatedImage( &tess.xstages[0]->bundle[1] );
+	qglEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	qglTexCoordPointer( 2, GL_FLOAT, sizeof( worldVertex_t ), (void *)offsetof( worldVertex_t, lightmap ) );
+
+	qglDrawElements( GL_TRIANGLES, tess.numVboIndexes, GL_INDEX_TYPE, tess.vboIndexes );
+
+	qglBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	qglTexCoordPointer( 2, GL_FLOAT, 16, tess.texCoords[0][1] );
+	qglDisable( GL_TEXTURE_2D );
+	qglDisableClientState( GL_TEXTURE_COORD_ARRAY );
+
+	GL_SelectTexture( 0 );
+	qglTexCoordPointer( 2, GL_FLOAT, 16, tess.texCoords[0][0] );
+	qglVertexPointer( 3, GL_FLOAT, 16, tess.xyz );
+	qglEnableClientState( GL_COLOR_ARRAY );
+	qglColorPointer( 4, GL_UNSIGNED_BYTE, 0, tess.constantColor255 );
+}
+
 //define	REPLACE_MODE
 
 void RB_StageIteratorLightmappedMultitexture( void ) {
@@ -1207,6 +1254,16 @@ void RB_StageIteratorLightmappedMultitexture( void ) {
 		GL_Cull(!input->shader->cullType);
 	else
 		GL_Cull(input->shader->cullType);
+
+	//
+	// surfaces in the world VBO take a pass of their own
+	//
+	if ( input->numVboIndexes ) {
+		RB_DrawWorldVBO();
+		if ( !input->numIndexes ) {
+			return;
+		}
+	}
 	
 	//
 	// set color, pointers, and lock
@@ -1299,7 +1356,7 @@ void RB_EndSurface( void ) {
 
 	input = &tess;
 
-	if (input->numIndexes == 0) {
+	if (input->numIndexes == 0 && input->numVboIndexes == 0) {
 		return;
 	}
 
@@ -1325,8 +1382,8 @@ void RB_EndSurface( void ) {
 	//
 	backEnd.pc.c_shaders++;
 	backEnd.pc.c_vertexes += tess.numVertexes;
-	backEnd.pc.c_indexes += tess.numIndexes;
-	backEnd.pc.c_totalIndexes += tess.numIndexes * tess.numPasses;
+	backEnd.pc.c_indexes += tess.numIndexes + tess.numVboIndexes;
+	backEnd.pc.c_totalIndexes += ( tess.numIndexes + tess.numVboIndexes ) * tess.numPasses;
 
 	//
 	// call off to shader specific tess end function
@@ -1344,6 +1401,7 @@ void RB_EndSurface( void ) {
 	}
 	// clear shader so we can tell we don't have any unclosed surfaces
 	tess.numIndexes = 0;
+	tess.numVboIndexes = 0;
 
 	GLimp_LogComment( "----------\n" );
 }
@@ -23,6 +23,106 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "tr_local.h"
 
+#if defined( __SSE2__ ) || idx64
+#include <emmintrin.h>
+#define USE_SSE_TESS
+#elif defined( __aarch64__ )
+#include <arm_neon.h>
+#define USE_NEON_TESS
+#endif
+
+#if defined( USE_SSE_TESS ) || defined( USE_NEON_TESS )
+#define USE_SIMD_TESS
+
+// the few 4 float operations the vertex loops below need
+#if defined( USE_SSE_TESS )
+typedef __m128 tessVec_t;
+#define TV_Load( p )			_mm_load_ps( p )
+#define TV_LoadU( p )			_mm_loadu_ps( p )
+#define TV_Store( p, v )		_mm_store_ps( p, v )
+#define TV_StoreU( p, v )		_mm_storeu_ps( p, v )
+#define TV_Splat( f )			_mm_set1_ps( f )
+#define TV_Set( x, y, z, w )	_mm_setr_ps( x, y, z, w )
+#define TV_Add( a, b )			_mm_add_ps( a, b )
+#define TV_Sub( a, b )			_mm_sub_ps( a, b )
+#define TV_Mul( a, b )			_mm_mul_ps( a, b )
+#define TV_Min( a, b )			_mm_min_ps( a, b )
+#define TV_Max( a, b )			_mm_max_ps( a, b )
+#define TV_InvSqrt( v )			_mm_div_ps( _mm_set1_ps( 1.0f ), _mm_sqrt_ps( v ) )
+#define TV_SwapPairs( v )		_mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 3, 0, 1 ) )
+
+// x, y and z of four consecutive vec4_t
+#define TV_LoadXYZ4( p, x, y, z ) do { \
+	tessVec_t w_ = _mm_load_ps( (p) + 12 ); \
+	x = _mm_load_ps( p ); y = _mm_load_ps( (p) + 4 ); z = _mm_load_ps( (p) + 8 ); \
+	_MM_TRANSPOSE4_PS( x, y, z, w_ ); \
+} while ( 0 )
+
+// a0 b0 a1 b1 ... a3 b3
+#define TV_StorePairs4( p, a, b ) do { \
+	_mm_storeu_ps( p, _mm_unpacklo_ps( a, b ) ); \
+	_mm_storeu_ps( (p) + 4, _mm_unpackhi_ps( a, b ) ); \
+} while ( 0 )
+
+// truncated and saturated to 0..255
+#define TV_StoreColor( p, v ) do { \
+	__m128i i_ = _mm_cvttps_epi32( v ); \
+	i_ = _mm_packs_epi32( i_, i_ ); \
+	*(int *)(p) = _mm_cvtsi128_si32( _mm_packus_epi16( i_, i_ ) ); \
+} while ( 0 )
+#else
+typedef float32x4_t tessVec_t;
+#define TV_Load( p )			vld1q_f32( p )
+#define TV_LoadU( p )			vld1q_f32( p )
+#define TV_Store( p, v )		vst1q_f32( p, v )
+#define TV_StoreU( p, v )		vst1q_f32( p, v )
+#define TV_Splat( f )			vdupq_n_f32( f )
+#define TV_Add( a, b )			vaddq_f32( a, b )
+#define TV_Sub( a, b )			vsubq_f32( a, b )
+#define TV_Mul( a, b )			vmulq_f32( a, b )
+#define TV_Min( a, b )			vminq_f32( a, b )
+#define TV_Max( a, b )			vmaxq_f32( a, b )
+#define TV_InvSqrt( v )			vdivq_f32( vdupq_n_f32( 1.0f ), vsqrtq_f32( v ) )
+#define TV_SwapPairs( v )		vrev64q_f32( v )
+
+static ID_INLINE tessVec_t TV_Set( float x, float y, float z, float w ) {
+	float v[4] = { x, y, z, w };
+
+	return vld1q_f32( v );
+}
+
+#define TV_LoadXYZ4( p, x, y, z ) do { \
+	float32x4x4_t v_ = vld4q_f32( p ); \
+	x = v_.val[0]; y = v_.val[1]; z = v_.val[2]; \
+} while ( 0 )
+
+#define TV_StorePairs4( p, a, b ) do { \
+	float32x4x2_t v_; \
+	v_.val[0] = a; v_.val[1] = b; \
+	vst2q_f32( p, v_ ); \
+} while ( 0 )
+
+#define TV_StoreColor( p, v ) do { \
+	uint16x4_t s_ = vqmovun_s32( vcvtq_s32_f32( v ) ); \
+	uint8x8_t b_ = vqmovn_u16( vcombine_u16( s_, s_ ) ); \
+	vst1_lane_u32( (uint32_t *)(p), vreinterpret_u32_u8( b_ ), 0 ); \
+} while ( 0 )
+#endif
+#endif
+
+// vertex loops with a SIMD version, set up by RB_InitTessCalc
+typedef struct {
+	void	(*deformVertexes)( deformStage_t *ds );
+	void	(*moveVertexes)( deformStage_t *ds );
+	void	(*environmentTexCoords)( float *st );
+	void	(*scaleTexCoords)( const float scale[2], float *st );
+	void	(*scrollTexCoords)( float scrollS, float scrollT, float *st );
+	void	(*transformTexCoords)( const texModInfo_t *tmi, float *st );
+	void	(*diffuseColor)( unsigned char *colors );
+} tessCalcFuncs_t;
+
+static tessCalcFuncs_t tessCalc;
+
 
 #define	WAVEVALUE( table, base, amplitude, phase, freq )  ((base) + table[ ( (int64_t) ( ( (phase) + tess.shaderTime * (freq) ) * FUNCTABLE_SIZE ) ) & FUNCTABLE_MASK ] * (amplitude))
 
@@ -115,7 +215,7 @@ RB_CalcDeformVertexes
 
 ========================
 */
-void RB_CalcDeformVertexes( deformStage_t *ds )
+static void RB_CalcDeformVertexes_scalar( deformStage_t *ds )
 {
 	int i;
 	vec3_t	offset;
@@ -159,6 +259,55 @@ void RB_CalcDeformVertexes( deformStage_t *ds )
 	}
 }
 
+#ifdef USE_SIMD_TESS
+static void RB_CalcDeformVertexes_simd( deformStage_t *ds )
+{
+	int i;
+	float	scale;
+	float	*xyz = ( float * ) tess.xyz;
+	float	*normal = ( float * ) tess.normal;
+	float	*table;
+	tessVec_t	mask, offset;
+
+	// leave w alone
+	mask = TV_Set( 1.0f, 1.0f, 1.0f, 0.0f );
+
+	if ( ds->deformationWave.frequency == 0 )
+	{
+		scale = EvalWaveForm( &ds->deformationWave );
+		mask = TV_Mul( mask, TV_Splat( scale ) );
+
+		for ( i = 0; i < tess.numVertexes; i++, xyz += 4, normal += 4 )
+		{
+			offset = TV_Mul( TV_Load( normal ), mask );
+			TV_Store( xyz, TV_Add( TV_Load( xyz ), offset ) );
+		}
+	}
+	else
+	{
+		table = TableForFunc( ds->deformationWave.func );
+
+		for ( i = 0; i < tess.numVertexes; i++, xyz += 4, normal += 4 )
+		{
+			float off = ( xyz[0] + xyz[1] + xyz[2] ) * ds->deformationSpread;
+
+			scale = WAVEVALUE( table, ds->deformationWave.base, 
+				ds->deformationWave.amplitude,
+				ds->deformationWave.phase + off,
+				ds->deformationWave.frequency );
+
+			offset = TV_Mul( TV_Load( normal ), TV_Mul( mask, TV_Splat( scale ) ) );
+			TV_Store( xyz, TV_Add( TV_Load( xyz ), offset ) );
+		}
+	}
+}
+#endif
+
+void RB_CalcDeformVertexes( deformStage_t *ds )
+{
+	tessCalc.deformVertexes( ds );
+}
+
 /*
 =========================
 RB_CalcDeformNormals
@@ -229,7 +378,7 @@ RB_CalcMoveVertexes
 A deformation that can move an entire surface along a wave path
 ======================
 */
-void RB_CalcMoveVertexes( deformStage_t *ds ) {
+static void RB_CalcMoveVertexes_scalar( deformStage_t *ds ) {
 	int			i;
 	float		*xyz;
 	float		*table;
@@ -251,6 +400,34 @@ void RB_CalcMoveVertexes( deformStage_t *ds ) {
 	}
 }
 
+#ifdef USE_SIMD_TESS
+static void RB_CalcMoveVertexes_simd( deformStage_t *ds ) {
+	int			i;
+	float		*xyz;
+	float		*table;
+	float		scale;
+	tessVec_t	offset;
+
+	table = TableForFunc( ds->deformationWave.func );
+
+	scale = WAVEVALUE( table, ds->deformationWave.base, 
+		ds->deformationWave.amplitude,
+		ds->deformationWave.phase,
+		ds->deformationWave.frequency );
+
+	offset = TV_Set( ds->moveVector[0] * scale, ds->moveVector[1] * scale, ds->moveVector[2] * scale, 0.0f );
+
+	xyz = ( float * ) tess.xyz;
+	for ( i = 0; i < tess.numVertexes; i++, xyz += 4 ) {
+		TV_Store( xyz, TV_Add( TV_Load( xyz ), offset ) );
+	}
+}
+#endif
+
+void RB_CalcMoveVertexes( deformStage_t *ds ) {
+	tessCalc.moveVertexes( ds );
+}
+
 
 /*
 =============
@@ -885,31 +1062,88 @@ void RB_CalcFogTexCoords( float *st ) {
 /*
 ** RB_CalcEnvironmentTexCoords
 */
-void RB_CalcEnvironmentTexCoords( float *st ) 
+static void RB_CalcEnvironmentTexCoord( const float *v, const float *normal, float *st )
 {
-	int			i;
-	float		*v, *normal;
 	vec3_t		viewer, reflected;
 	float		d;
 
-	v = tess.xyz[0];
-	normal = tess.normal[0];
+	VectorSubtract (backEnd.or.viewOrigin, v, viewer);
+	VectorNormalizeFast (viewer);
+
+	d = DotProduct (normal, viewer);
+
+	reflected[0] = normal[0]*2*d - viewer[0];
+	reflected[1] = normal[1]*2*d - viewer[1];
+	reflected[2] = normal[2]*2*d - viewer[2];
 
-	for (i = 0 ; i < tess.numVertexes ; i++, v += 4, normal += 4, st += 2 ) 
+	st[0] = 0.5 + reflected[1] * 0.5;
+	st[1] = 0.5 - reflected[2] * 0.5;
+}
+
+static void RB_CalcEnvironmentTexCoords_scalar( float *st ) 
+{
+	int			i;
+
+	for (i = 0 ; i < tess.numVertexes ; i++, st += 2 ) 
 	{
-		VectorSubtract (backEnd.or.viewOrigin, v, viewer);
-		VectorNormalizeFast (viewer);
+		RB_CalcEnvironmentTexCoord( tess.xyz[i], tess.normal[i], st );
+	}
+}
+
+#ifdef USE_SIMD_TESS
+static void RB_CalcEnvironmentTexCoords_simd( float *st ) 
+{
+	int			i, numVertexes;
+	tessVec_t	x, y, z, nx, ny, nz;
+	tessVec_t	originX, originY, originZ;
+	tessVec_t	d, half, minLength;
+
+	originX = TV_Splat( backEnd.or.viewOrigin[0] );
+	originY = TV_Splat( backEnd.or.viewOrigin[1] );
+	originZ = TV_Splat( backEnd.or.viewOrigin[2] );
+	half = TV_Splat( 0.5f );
+	minLength = TV_Splat( 1e-12f );
+
+	// four vertexes at a time, the rest one by one
+	numVertexes = tess.numVertexes & ~3;
 
-		d = DotProduct (normal, viewer);
+	for (i = 0 ; i < numVertexes ; i += 4, st += 8 ) 
+	{
+		TV_LoadXYZ4( tess.xyz[i], x, y, z );
+		TV_LoadXYZ4( tess.normal[i], nx, ny, nz );
+
+		x = TV_Sub( originX, x );
+		y = TV_Sub( originY, y );
+		z = TV_Sub( originZ, z );
+
+		// zero length stays zero like with VectorNormalizeFast
+		d = TV_Add( TV_Add( TV_Mul( x, x ), TV_Mul( y, y ) ), TV_Mul( z, z ) );
+		d = TV_InvSqrt( TV_Max( d, minLength ) );
+		x = TV_Mul( x, d );
+		y = TV_Mul( y, d );
+		z = TV_Mul( z, d );
 
-		reflected[0] = normal[0]*2*d - viewer[0];
-		reflected[1] = normal[1]*2*d - viewer[1];
-		reflected[2] = normal[2]*2*d - viewer[2];
+		d = TV_Add( TV_Add( TV_Mul( nx, x ), TV_Mul( ny, y ) ), TV_Mul( nz, z ) );
+		d = TV_Add( d, d );
+
+		// reflected[1] and reflected[2]
+		y = TV_Sub( TV_Mul( ny, d ), y );
+		z = TV_Sub( TV_Mul( nz, d ), z );
+
+		TV_StorePairs4( st, TV_Add( half, TV_Mul( y, half ) ), TV_Sub( half, TV_Mul( z, half ) ) );
+	}
 
-		st[0] = 0.5 + reflected[1] * 0.5;
-		st[1] = 0.5 - reflected[2] * 0.5;
+	for ( ; i < tess.numVertexes ; i++, st += 2 ) 
+	{
+		RB_CalcEnvironmentTexCoord( tess.xyz[i], tess.normal[i], st );
 	}
 }
+#endif
+
+void RB_CalcEnvironmentTexCoords( float *st ) 
+{
+	tessCalc.environmentTexCoords( st );
+}
 
 /*
 ** RB_CalcTurbulentTexCoords
@@ -934,7 +1168,7 @@ void RB_CalcTurbulentTexCoords( const waveForm_t *wf, float *st )
 /*
 ** RB_CalcScaleTexCoords
 */
-void RB_CalcScaleTexCoords( const float scale[2], float *st )
+static void RB_CalcScaleTexCoords_scalar( const float scale[2], float *st )
 {
 	int i;
 
@@ -945,12 +1179,66 @@ void RB_CalcScaleTexCoords( const float scale[2], float *st )
 	}
 }
 
+#ifdef USE_SIMD_TESS
+static void RB_CalcScaleTexCoords_simd( const float scale[2], float *st )
+{
+	int i;
+	tessVec_t	scales = TV_Set( scale[0], scale[1], scale[0], scale[1] );
+
+	// two vertexes at a time
+	for ( i = 0; i + 2 <= tess.numVertexes; i += 2, st += 4 )
+	{
+		TV_StoreU( st, TV_Mul( TV_LoadU( st ), scales ) );
+	}
+
+	if ( i < tess.numVertexes )
+	{
+		st[0] *= scale[0];
+		st[1] *= scale[1];
+	}
+}
+#endif
+
+void RB_CalcScaleTexCoords( const float scale[2], float *st )
+{
+	tessCalc.scaleTexCoords( scale, st );
+}
+
 /*
 ** RB_CalcScrollTexCoords
 */
-void RB_CalcScrollTexCoords( const float scrollSpeed[2], float *st )
+static void RB_CalcScrollTexCoords_scalar( float scrollS, float scrollT, float *st )
+{
+	int i;
+
+	for ( i = 0; i < tess.numVertexes; i++, st += 2 )
+	{
+		st[0] += scrollS;
+		st[1] += scrollT;
+	}
+}
+
+#ifdef USE_SIMD_TESS
+static void RB_CalcScrollTexCoords_simd( float scrollS, float scrollT, float *st )
 {
 	int i;
+	tessVec_t	scroll = TV_Set( scrollS, scrollT, scrollS, scrollT );
+
+	for ( i = 0; i + 2 <= tess.numVertexes; i += 2, st += 4 )
+	{
+		TV_StoreU( st, TV_Add( TV_LoadU( st ), scroll ) );
+	}
+
+	if ( i < tess.numVertexes )
+	{
+		st[0] += scrollS;
+		st[1] += scrollT;
+	}
+}
+#endif
+
+void RB_CalcScrollTexCoords( const float scrollSpeed[2], float *st )
+{
 	double timeScale = tess.shaderTime;
 	double adjustedScrollS, adjustedScrollT;
 
@@ -962,17 +1250,13 @@ void RB_CalcScrollTexCoords( const float scrollSpeed[2], float *st )
 	adjustedScrollS = adjustedScrollS - floor( adjustedScrollS );
 	adjustedScrollT = adjustedScrollT - floor( adjustedScrollT );
 
-	for ( i = 0; i < tess.numVertexes; i++, st += 2 )
-	{
-		st[0] += adjustedScrollS;
-		st[1] += adjustedScrollT;
-	}
+	tessCalc.scrollTexCoords( adjustedScrollS, adjustedScrollT, st );
 }
 
 /*
 ** RB_CalcTransformTexCoords
 */
-void RB_CalcTransformTexCoords( const texModInfo_t *tmi, float *st  )
+static void RB_CalcTransformTexCoords_scalar( const texModInfo_t *tmi, float *st  )
 {
 	int i;
 
@@ -986,6 +1270,40 @@ void RB_CalcTransformTexCoords( const texModInfo_t *tmi, float *st  )
 	}
 }
 
+#ifdef USE_SIMD_TESS
+static void RB_CalcTransformTexCoords_simd( const texModInfo_t *tmi, float *st  )
+{
+	int i;
+	tessVec_t	diagonal, cross, translate, v;
+
+	// s' = s * m00 + t * m10, t' = t * m11 + s * m01
+	diagonal = TV_Set( tmi->matrix[0][0], tmi->matrix[1][1], tmi->matrix[0][0], tmi->matrix[1][1] );
+	cross = TV_Set( tmi->matrix[1][0], tmi->matrix[0][1], tmi->matrix[1][0], tmi->matrix[0][1] );
+	translate = TV_Set( tmi->translate[0], tmi->translate[1], tmi->translate[0], tmi->translate[1] );
+
+	for ( i = 0; i + 2 <= tess.numVertexes; i += 2, st += 4 )
+	{
+		v = TV_LoadU( st );
+		v = TV_Add( TV_Add( TV_Mul( v, diagonal ), TV_Mul( TV_SwapPairs( v ), cross ) ), translate );
+		TV_StoreU( st, v );
+	}
+
+	if ( i < tess.numVertexes )
+	{
+		float s = st[0];
+		float t = st[1];
+
+		st[0] = s * tmi->matrix[0][0] + t * tmi->matrix[1][0] + tmi->translate[0];
+		st[1] = s * tmi->matrix[0][1] + t * tmi->matrix[1][1] + tmi->translate[1];
+	}
+}
+#endif
+
+void RB_CalcTransformTexCoords( const texModInfo_t *tmi, float *st  )
+{
+	tessCalc.transformTexCoords( tmi, st );
+}
+
 /*
 ** RB_CalcRotateTexCoords
 */
@@ -1128,6 +1446,37 @@ static void RB_CalcDiffuseColor_scalar( unsigned char *colors )
 	}
 }
 
+#ifdef USE_SIMD_TESS
+static void RB_CalcDiffuseColor_simd( unsigned char *colors )
+{
+	int				i;
+	float			*normal;
+	float			incoming;
+	trRefEntity_t	*ent;
+	tessVec_t		ambientLight, directedLight, maxLight;
+	int				numVertexes;
+	ent = backEnd.currentEntity;
+
+	// alpha comes out as 255, the ambient light is already clamped
+	ambientLight = TV_Set( ent->ambientLight[0], ent->ambientLight[1], ent->ambientLight[2], 255.0f );
+	directedLight = TV_Set( ent->directedLight[0], ent->directedLight[1], ent->directedLight[2], 0.0f );
+	maxLight = TV_Splat( 255.0f );
+
+	normal = tess.normal[0];
+
+	numVertexes = tess.numVertexes;
+	for (i = 0 ; i < numVertexes ; i++, normal += 4) {
+		incoming = DotProduct (normal, ent->lightDir);
+		if ( incoming <= 0 ) {
+			*(int *)&colors[i*4] = ent->ambientLightInt;
+			continue;
+		}
+
+		TV_StoreColor( &colors[i*4], TV_Min( TV_Add( ambientLight, TV_Mul( TV_Splat( incoming ), directedLight ) ), maxLight ) );
+	}
+}
+#endif
+
 void RB_CalcDiffuseColor( unsigned char *colors )
 {
 #if idppc_altivec
@@ -1137,6 +1486,35 @@ void RB_CalcDiffuseColor( unsigned char *colors )
 		return;
 	}
 #endif
-	RB_CalcDiffuseColor_scalar( colors );
+	tessCalc.diffuseColor( colors );
+}
+
+/*
+** RB_InitTessCalc
+**
+** Picks the scalar or SIMD versions of the vertex loops, r_simd is latched
+*/
+void RB_InitTessCalc( void )
+{
+	tessCalc.deformVertexes = RB_CalcDeformVertexes_scalar;
+	tessCalc.moveVertexes = RB_CalcMoveVertexes_scalar;
+	tessCalc.environmentTexCoords = RB_CalcEnvironmentTexCoords_scalar;
+	tessCalc.scaleTexCoords = RB_CalcScaleTexCoords_scalar;
+	tessCalc.scrollTexCoords = RB_CalcScrollTexCoords_scalar;
+	tessCalc.transformTexCoords = RB_CalcTransformTexCoords_scalar;
+	tessCalc.diffuseColor = RB_CalcDiffuseColor_scalar;
+
+#ifdef USE_SIMD_TESS
+	if ( r_simd->integer )
+	{
+		tessCalc.deformVertexes = RB_CalcDeformVertexes_simd;
+		tessCalc.moveVertexes = RB_CalcMoveVertexes_simd;
+		tessCalc.environmentTexCoords = RB_CalcEnvironmentTexCoords_simd;
+		tessCalc.scaleTexCoords = RB_CalcScaleTexCoords_simd;
+		tessCalc.scrollTexCoords = RB_CalcScrollTexCoords_simd;
+		tessCalc.transformTexCoords = RB_CalcTransformTexCoords_simd;
+		tessCalc.diffuseColor = RB_CalcDiffuseColor_simd;
+	}
+#endif
 }
 
@@ -215,6 +215,40 @@ static void RB_SurfacePolychain( srfPoly_t *p ) {
 }
 
 
+/*
+=============
+RB_AddWorldVBOSurface
+
+Surfaces in the world VBO only need their indexes added, unless this
+batch needs their vertexes in tess for dlights, fog or debug drawing
+=============
+*/
+static qboolean RB_AddWorldVBOSurface( int firstVertex, int numIndexes, const int *indexes, int dlightBits ) {
+	int		i;
+
+	if ( firstVertex < 0 || dlightBits || numIndexes >= SHADER_MAX_INDEXES ) {
+		return qfalse;
+	}
+	if ( tess.currentStageIteratorFunc != RB_StageIteratorLightmappedMultitexture ) {
+		return qfalse;
+	}
+	if ( ( tess.fogNum && tess.shader->fogPass ) || r_showtris->integer || r_shownormals->integer ) {
+		return qfalse;
+	}
+
+	if ( tess.numVboIndexes + numIndexes >= SHADER_MAX_INDEXES ) {
+		RB_EndSurface();
+		RB_BeginSurface( tess.shader, tess.fogNum );
+	}
+
+	for ( i = 0 ; i < numIndexes ; i++ ) {
+		tess.vboIndexes[ tess.numVboIndexes + i ] = firstVertex + indexes[ i ];
+	}
+	tess.numVboIndexes += numIndexes;
+
+	return qtrue;
+}
+
 /*
 =============
 RB_SurfaceTriangles
@@ -228,7 +262,12 @@ static void RB_SurfaceTriangles( srfTriangles_t *srf ) {
 	int			dlightBits;
 	qboolean	needsNormal;
 
-	dlightBits = srf->dlightBits;
+	dlightBits = srf->dlightBits[ backEnd.smpFrame ];
+
+	if ( RB_AddWorldVBOSurface( srf->vboFirstVertex, srf->numIndexes, srf->indexes, dlightBits ) ) {
+		return;
+	}
+
 	tess.dlightBits |= dlightBits;
 
 	RB_CHECKOVERFLOW( srf->numVerts, srf->numIndexes );
@@ -783,13 +822,18 @@ static void RB_SurfaceFace( srfSurfaceFace_t *surf ) {
 	int			numPoints;
 	int			dlightBits;
 
+	indices = ( unsigned * ) ( ( ( char  * ) surf ) + surf->ofsIndices );
+
+	dlightBits = surf->dlightBits[ backEnd.smpFrame ];
+
+	if ( RB_AddWorldVBOSurface( surf->vboFirstVertex, surf->numIndices, (int *)indices, dlightBits ) ) {
+		return;
+	}
+
 	RB_CHECKOVERFLOW( surf->numPoints, surf->numIndices );
 
-	dlightBits = surf->dlightBits;
 	tess.dlightBits |= dlightBits;
 
-	indices = ( unsigned * ) ( ( ( char  * ) surf ) + surf->ofsIndices );
-
 	Bob = tess.numVertexes;
 	tessIndexes = tess.indexes + tess.numIndexes;
 	for ( i = surf->numIndices-1 ; i >= 0  ; i-- ) {
@@ -877,7 +921,7 @@ static void RB_SurfaceGrid( srfGridMesh_t *cv ) {
 	int		*vDlightBits;
 	qboolean	needsNormal;
 
-	dlightBits = cv->dlightBits;
+	dlightBits = cv->dlightBits[ backEnd.smpFrame ];
 	tess.dlightBits |= dlightBits;
 
 	// determine the allowable discrepance
@@ -2,15 +2,35 @@ uniform sampler2D u_DiffuseMap;
 
 uniform int       u_AlphaTest;
 
-varying vec2      var_Tex1;
-varying vec4      var_Color;
+uniform vec4      u_DlightInfo[MAX_DLIGHTS_PER_PASS];
+uniform vec4      u_DlightColor[MAX_DLIGHTS_PER_PASS];
+uniform int       u_NumDlights;
+
+varying vec3      var_Position;
+varying vec3      var_Normal;
 
 
 void main()
 {
-	vec4 color = texture2D(u_DiffuseMap, var_Tex1);
+	vec4 color = vec4(0.0);
+
+	for (int i = 0; i < MAX_DLIGHTS_PER_PASS; i++)
+	{
+		if (i >= u_NumDlights)
+			break;
+
+		vec3 dist = u_DlightInfo[i].xyz - var_Position;
+
+		float dlightmod = step(0.0, dot(dist, var_Normal));
+		dlightmod *= clamp(2.0 * (1.0 - abs(dist.z) * u_DlightInfo[i].a), 0.0, 1.0);
+
+		vec4 light = texture2D(u_DiffuseMap, dist.xy * u_DlightInfo[i].a + vec2(0.5));
+
+		color.rgb += light.rgb * u_DlightColor[i].rgb * dlightmod;
+		color.a += light.a * dlightmod;
+	}
 
-	float alpha = color.a * var_Color.a;
+	float alpha = color.a;
 	if (u_AlphaTest == 1)
 	{
 		if (alpha == 0.0)
@@ -27,6 +47,6 @@ void main()
 			discard;
 	}
 	
-	gl_FragColor.rgb = color.rgb * var_Color.rgb;
+	gl_FragColor.rgb = color.rgb;
 	gl_FragColor.a = alpha;
 }
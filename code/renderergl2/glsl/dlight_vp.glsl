@@ -2,19 +2,16 @@ attribute vec3 attr_Position;
 attribute vec4 attr_TexCoord0;
 attribute vec3 attr_Normal;
 
-uniform vec4   u_DlightInfo;
-
 #if defined(USE_DEFORM_VERTEXES)
 uniform int    u_DeformGen;
 uniform float  u_DeformParams[5];
 uniform float  u_Time;
 #endif
 
-uniform vec4   u_Color;
 uniform mat4   u_ModelViewProjectionMatrix;
 
-varying vec2   var_Tex1;
-varying vec4   var_Color;
+varying vec3   var_Position;
+varying vec3   var_Normal;
 
 #if defined(USE_DEFORM_VERTEXES)
 vec3 DeformPosition(const vec3 pos, const vec3 normal, const vec2 st)
@@ -81,12 +78,7 @@ void main()
 #endif
 
 	gl_Position = u_ModelViewProjectionMatrix * vec4(position, 1.0);
-		
-	vec3 dist = u_DlightInfo.xyz - position;
 
-	var_Tex1 = dist.xy * u_DlightInfo.a + vec2(0.5);
-	float dlightmod = step(0.0, dot(dist, normal));
-	dlightmod *= clamp(2.0 * (1.0 - abs(dist.z) * u_DlightInfo.a), 0.0, 1.0);
-	
-	var_Color = u_Color * dlightmod;
+	var_Position = position;
+	var_Normal = normal;
 }
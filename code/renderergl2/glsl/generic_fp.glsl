@@ -1,15 +1,26 @@
+#if defined(USE_LIGHTMAP_ARRAY)
+uniform sampler2DArray u_DiffuseMap;
+#else
 uniform sampler2D u_DiffuseMap;
+#endif
 
 uniform int       u_AlphaTest;
 
 varying vec2      var_DiffuseTex;
+#if defined(USE_LIGHTMAP_ARRAY)
+varying float     var_LightmapLayer;
+#endif
 
 varying vec4      var_Color;
 
 
 void main()
 {
+#if defined(USE_LIGHTMAP_ARRAY)
+	vec4 color  = texture(u_DiffuseMap, vec3(var_DiffuseTex, var_LightmapLayer));
+#else
 	vec4 color  = texture2D(u_DiffuseMap, var_DiffuseTex);
+#endif
 
 	float alpha = color.a * var_Color.a;
 	if (u_AlphaTest == 1)
@@ -62,6 +62,10 @@ uniform mat4 u_BoneMatrix[MAX_GLSL_BONES];
 #endif
 
 varying vec2   var_DiffuseTex;
+#if defined(USE_LIGHTMAP_ARRAY)
+// lightmap s carries twice the array layer, see FatPackU
+varying float  var_LightmapLayer;
+#endif
 varying vec4   var_Color;
 
 #if defined(USE_DEFORM_VERTEXES)
@@ -122,6 +126,9 @@ vec2 GenTexCoords(int TCGen, vec3 position, vec3 normal, vec3 TCGenVector0, vec3
 	if (TCGen == TCGEN_LIGHTMAP)
 	{
 		tex = attr_TexCoord1.st;
+#if defined(USE_LIGHTMAP_ARRAY)
+		tex.s -= 2.0 * floor(tex.s * 0.5 + 0.25);
+#endif
 	}
 	else if (TCGen == TCGEN_ENVIRONMENT_MAPPED)
 	{
@@ -235,6 +242,10 @@ void main()
 	vec2 tex = attr_TexCoord0.st;
 #endif
 
+#if defined(USE_LIGHTMAP_ARRAY)
+	var_LightmapLayer = floor(attr_TexCoord1.s * 0.5 + 0.25);
+#endif
+
 #if defined(USE_TCMOD)
 	var_DiffuseTex = ModTexCoords(tex, position, u_DiffuseTexMatrix, u_DiffuseTexOffTurb);
 #else
@@ -1,6 +1,8 @@
 uniform sampler2D u_DiffuseMap;
 
-#if defined(USE_LIGHTMAP)
+#if defined(USE_LIGHTMAP_ARRAY)
+uniform sampler2DArray u_LightMap;
+#elif defined(USE_LIGHTMAP)
 uniform sampler2D u_LightMap;
 #endif
 
@@ -8,7 +10,9 @@ uniform sampler2D u_LightMap;
 uniform sampler2D u_NormalMap;
 #endif
 
-#if defined(USE_DELUXEMAP)
+#if defined(USE_DELUXEMAP) && defined(USE_LIGHTMAP_ARRAY)
+uniform sampler2DArray u_DeluxeMap;
+#elif defined(USE_DELUXEMAP)
 uniform sampler2D u_DeluxeMap;
 #endif
 
@@ -49,6 +53,10 @@ uniform int       u_AlphaTest;
 
 varying vec4      var_TexCoords;
 
+#if defined(USE_LIGHTMAP_ARRAY)
+varying float     var_LightmapLayer;
+#endif
+
 varying vec4      var_Color;
 #if (defined(USE_LIGHT) && !defined(USE_FAST_LIGHT))
 varying vec4      var_ColorAmbient;
@@ -269,7 +277,11 @@ void main()
 	lightColor = var_Color.rgb;
 
 #if defined(USE_LIGHTMAP)
+  #if defined(USE_LIGHTMAP_ARRAY)
+	vec4 lightmapColor = texture(u_LightMap, vec3(var_TexCoords.zw, var_LightmapLayer));
+  #else
 	vec4 lightmapColor = texture2D(u_LightMap, var_TexCoords.zw);
+  #endif
   #if defined(RGBM_LIGHTMAP)
 	lightmapColor.rgb *= lightmapColor.a;
   #endif
@@ -311,7 +323,11 @@ void main()
 #if defined(USE_LIGHT) && !defined(USE_FAST_LIGHT)
 	L = var_LightDir.xyz;
   #if defined(USE_DELUXEMAP)
+    #if defined(USE_LIGHTMAP_ARRAY)
+	L += (texture(u_DeluxeMap, vec3(var_TexCoords.zw, var_LightmapLayer)).xyz - vec3(0.5)) * u_EnableTextures.y;
+    #else
 	L += (texture2D(u_DeluxeMap, var_TexCoords.zw).xyz - vec3(0.5)) * u_EnableTextures.y;
+    #endif
   #endif
 	float sqrLightDist = dot(L, L);
 	L /= sqrt(sqrLightDist);
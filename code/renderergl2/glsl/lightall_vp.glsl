@@ -69,6 +69,11 @@ uniform float u_PrimaryLightRadius;
 
 varying vec4   var_TexCoords;
 
+#if defined(USE_LIGHTMAP_ARRAY)
+// lightmap s carries twice the array layer, see FatPackU
+varying float  var_LightmapLayer;
+#endif
+
 varying vec4   var_Color;
 #if defined(USE_LIGHT_VECTOR) && !defined(USE_FAST_LIGHT)
 varying vec4   var_ColorAmbient;
@@ -212,7 +217,12 @@ void main()
 #endif
 
 #if defined(USE_LIGHTMAP)
+  #if defined(USE_LIGHTMAP_ARRAY)
+	var_LightmapLayer = floor(attr_TexCoord1.s * 0.5 + 0.25);
+	var_TexCoords.zw = vec2(attr_TexCoord1.s - 2.0 * var_LightmapLayer, attr_TexCoord1.t);
+  #else
 	var_TexCoords.zw = attr_TexCoord1.st;
+  #endif
 #endif
 
 	var_Color = u_VertColor * attr_Color + u_BaseColor;
@@ -3,6 +3,8 @@ uniform sampler2D u_LevelsMap;
 
 uniform vec4      u_Color;
 
+uniform vec2      u_InvTexRes;
+uniform vec4      u_ViewInfo; // texture coordinates of the first and last texel rendered
 
 uniform vec2      u_AutoExposureMinMax;
 uniform vec3      u_ToneMinAvgMaxLinear;
@@ -24,9 +26,33 @@ float FilmicTonemap(float x)
 	return ((x*(SS*x+LA*LS)+TS*TAN)/(x*(SS*x+LS)+TS*TAD)) - TAN/TAD;
 }
 
+vec3 SampleScene(vec2 tex)
+{
+	return texture2D(u_TextureMap, clamp(tex, u_ViewInfo.xy, u_ViewInfo.zw)).rgb;
+}
+
 void main()
 {
-	vec4 color = texture2D(u_TextureMap, var_TexCoords) * u_Color;
+	vec4 color = texture2D(u_TextureMap, clamp(var_TexCoords, u_ViewInfo.xy, u_ViewInfo.zw));
+
+	// scaled up from a lower resolution, sharpen what the bilinear filtering blurred
+	// without going past the neighbours, which would ring
+	float sharpen = 1.0 - abs(dFdx(var_TexCoords.x)) / u_InvTexRes.x;
+	if (sharpen > 0.01)
+	{
+		vec3 left  = SampleScene(var_TexCoords - vec2(u_InvTexRes.x, 0.0));
+		vec3 right = SampleScene(var_TexCoords + vec2(u_InvTexRes.x, 0.0));
+		vec3 down  = SampleScene(var_TexCoords - vec2(0.0, u_InvTexRes.y));
+		vec3 up    = SampleScene(var_TexCoords + vec2(0.0, u_InvTexRes.y));
+
+		vec3 lo = min(min(min(left, right), min(down, up)), color.rgb);
+		vec3 hi = max(max(max(left, right), max(down, up)), color.rgb);
+
+		color.rgb += sharpen * (color.rgb - (left + right + down + up) * 0.25);
+		color.rgb = clamp(color.rgb, lo, hi);
+	}
+
+	color *= u_Color;
 
 #if defined(USE_PBR)
 	color.rgb *= color.rgb;
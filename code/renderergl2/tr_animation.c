@@ -181,6 +181,8 @@ R_MDRAddAnimSurfaces
 void R_MDRAddAnimSurfaces( trRefEntity_t *ent ) {
 	mdrHeader_t		*header;
 	mdrSurface_t	*surface;
+	srfVaoMdrSurface_t	*vaoSurface;
+	surfaceType_t	*drawSurf;
 	mdrLOD_t		*lod;
 	shader_t		*shader;
 	skin_t		*skin;
@@ -255,8 +257,21 @@ void R_MDRAddAnimSurfaces( trRefEntity_t *ent ) {
 
 	surface = (mdrSurface_t *)( (byte *)lod + lod->ofsSurfaces );
 
+	vaoSurface = NULL;
+	if ( tr.currentModel->mdrVaoSurfaces )
+	{
+		lod = (mdrLOD_t *)( (byte *)header + header->ofsLODs );
+		vaoSurface = tr.currentModel->mdrVaoSurfaces;
+		for ( i = 0; i < lodnum; i++ )
+		{
+			vaoSurface += lod->numSurfaces;
+			lod = (mdrLOD_t *) ((byte *) lod + lod->ofsEnd);
+		}
+	}
+
 	for ( i = 0 ; i < lod->numSurfaces ; i++ )
 	{
+		drawSurf = vaoSurface ? (surfaceType_t *)&vaoSurface[i] : (surfaceType_t *)surface;
 		
 		if(ent->e.customShader)
 			shader = R_GetShaderByHandle(ent->e.customShader);
@@ -288,7 +303,7 @@ void R_MDRAddAnimSurfaces( trRefEntity_t *ent ) {
 			&& !(ent->e.renderfx & ( RF_NOSHADOW | RF_DEPTHHACK ) )
 			&& shader->sort == SS_OPAQUE )
 		{
-			R_AddDrawSurf( (void *)surface, tr.shadowShader, 0, qfalse, qfalse, 0 );
+			R_AddDrawSurf( drawSurf, tr.shadowShader, 0, qfalse, qfalse, 0 );
 		}
 
 		// projection shadows work fine with personal models
@@ -297,11 +312,11 @@ void R_MDRAddAnimSurfaces( trRefEntity_t *ent ) {
 			&& (ent->e.renderfx & RF_SHADOW_PLANE )
 			&& shader->sort == SS_OPAQUE )
 		{
-			R_AddDrawSurf( (void *)surface, tr.projectionShadowShader, 0, qfalse, qfalse, 0 );
+			R_AddDrawSurf( drawSurf, tr.projectionShadowShader, 0, qfalse, qfalse, 0 );
 		}
 
 		if (!personalModel)
-			R_AddDrawSurf( (void *)surface, shader, fogNum, qfalse, qfalse, cubemapIndex );
+			R_AddDrawSurf( drawSurf, shader, fogNum, qfalse, qfalse, cubemapIndex );
 
 		surface = (mdrSurface_t *)( (byte *)surface + surface->ofsEnd );
 	}
@@ -423,6 +438,395 @@ void RB_MDRSurfaceAnim( mdrSurface_t *surface )
 	tess.numVertexes += surface->numVerts;
 }
 
+/*
+==============
+R_MDRInvertBone
+
+Inverts an affine 3x4 bone matrix
+==============
+*/
+static qboolean R_MDRInvertBone( const float in[3][4], float out[3][4] )
+{
+	float	det, invDet;
+	int		i;
+
+	out[0][0] = in[1][1] * in[2][2] - in[1][2] * in[2][1];
+	out[0][1] = in[0][2] * in[2][1] - in[0][1] * in[2][2];
+	out[0][2] = in[0][1] * in[1][2] - in[0][2] * in[1][1];
+	out[1][0] = in[1][2] * in[2][0] - in[1][0] * in[2][2];
+	out[1][1] = in[0][0] * in[2][2] - in[0][2] * in[2][0];
+	out[1][2] = in[0][2] * in[1][0] - in[0][0] * in[1][2];
+	out[2][0] = in[1][0] * in[2][1] - in[1][1] * in[2][0];
+	out[2][1] = in[0][1] * in[2][0] - in[0][0] * in[2][1];
+	out[2][2] = in[0][0] * in[1][1] - in[0][1] * in[1][0];
+
+	det = in[0][0] * out[0][0] + in[0][1] * out[1][0] + in[0][2] * out[2][0];
+	if ( fabs( det ) < 1e-6f )
+		return qfalse;
+
+	invDet = 1.0f / det;
+	for ( i = 0; i < 3; i++ )
+	{
+		VectorScale( out[i], invDet, out[i] );
+	}
+
+	for ( i = 0; i < 3; i++ )
+	{
+		out[i][3] = -( out[i][0] * in[0][3] + out[i][1] * in[1][3] + out[i][2] * in[2][3] );
+	}
+
+	return qtrue;
+}
+
+/*
+==============
+R_MDRBindVertex
+
+Finds the position and normal a vertex has in the first frame. Every
+weight stores its own offset in bone space, so this only works if they
+all agree, the GPU skins a single point like an IQM bind pose.
+==============
+*/
+#define	MDR_BIND_EPSILON		0.1f
+#define	MDR_BIND_NORMAL_EPSILON	0.99f
+
+static qboolean R_MDRBindVertex( const mdrHeader_t *header, const mdrFrame_t *bindFrame, const mdrVertex_t *v, vec3_t xyz, vec3_t normal )
+{
+	const mdrBone_t	*bone;
+	vec3_t			p, n;
+	int				k;
+
+	if ( v->numWeights < 1 || v->numWeights > 4 )
+		return qfalse;
+
+	for ( k = 0; k < v->numWeights; k++ )
+	{
+		if ( v->weights[k].boneIndex < 0 || v->weights[k].boneIndex >= header->numBones )
+			return qfalse;
+
+		bone = &bindFrame->bones[v->weights[k].boneIndex];
+
+		p[0] = DotProduct( bone->matrix[0], v->weights[k].offset ) + bone->matrix[0][3];
+		p[1] = DotProduct( bone->matrix[1], v->weights[k].offset ) + bone->matrix[1][3];
+		p[2] = DotProduct( bone->matrix[2], v->weights[k].offset ) + bone->matrix[2][3];
+
+		n[0] = DotProduct( bone->matrix[0], v->normal );
+		n[1] = DotProduct( bone->matrix[1], v->normal );
+		n[2] = DotProduct( bone->matrix[2], v->normal );
+		VectorNormalize( n );
+
+		if ( !k )
+		{
+			VectorCopy( p, xyz );
+			VectorCopy( n, normal );
+		}
+		else if ( Distance( p, xyz ) > MDR_BIND_EPSILON || DotProduct( n, normal ) < MDR_BIND_NORMAL_EPSILON )
+		{
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+==============
+R_MDRCreateVaoSurfaces
+
+Builds static VAOs with bone indexes and weights for GPU skinning,
+or leaves the model on RB_MDRSurfaceAnim if it can't be skinned that way
+==============
+*/
+void R_MDRCreateVaoSurfaces( model_t *mod )
+{
+	mdrHeader_t			*header = mod->modelData;
+	mdrFrame_t			*bindFrame;
+	mdrLOD_t			*lod;
+	mdrSurface_t		*surf;
+	mdrVertex_t			*v;
+	srfVaoMdrSurface_t	*vaoSurf;
+	float				(*invBones)[3][4];
+	vec3_t				xyz, normal;
+	int					numSurfaces, i, j, k, l;
+
+	if ( !glRefConfig.glslMaxAnimatedBones || header->numBones < 1 || header->numBones > glRefConfig.glslMaxAnimatedBones )
+		return;
+
+	bindFrame = (mdrFrame_t *)( (byte *)header + header->ofsFrames );
+
+	// check every vertex first so nothing is allocated for a model that stays on the CPU
+	numSurfaces = 0;
+	lod = (mdrLOD_t *)( (byte *)header + header->ofsLODs );
+	for ( l = 0; l < header->numLODs; l++ )
+	{
+		surf = (mdrSurface_t *)( (byte *)lod + lod->ofsSurfaces );
+		for ( i = 0; i < lod->numSurfaces; i++ )
+		{
+			v = (mdrVertex_t *)( (byte *)surf + surf->ofsVerts );
+			for ( j = 0; j < surf->numVerts; j++ )
+			{
+				if ( !R_MDRBindVertex( header, bindFrame, v, xyz, normal ) )
+				{
+					ri.Printf( PRINT_DEVELOPER, "R_MDRCreateVaoSurfaces: %s is skinned on the CPU\n", mod->name );
+					return;
+				}
+				v = (mdrVertex_t *)&v->weights[v->numWeights];
+			}
+			surf = (mdrSurface_t *)( (byte *)surf + surf->ofsEnd );
+		}
+		numSurfaces += lod->numSurfaces;
+		lod = (mdrLOD_t *)( (byte *)lod + lod->ofsEnd );
+	}
+
+	if ( !numSurfaces )
+		return;
+
+	invBones = ri.Hunk_Alloc( sizeof( *invBones ) * header->numBones, h_low );
+	for ( i = 0; i < header->numBones; i++ )
+	{
+		if ( !R_MDRInvertBone( (const float (*)[4])bindFrame->bones[i].matrix, invBones[i] ) )
+		{
+			ri.Printf( PRINT_DEVELOPER, "R_MDRCreateVaoSurfaces: %s is skinned on the CPU\n", mod->name );
+			return;
+		}
+	}
+
+	mod->mdrVaoSurfaces = vaoSurf = ri.Hunk_Alloc( sizeof( *vaoSurf ) * numSurfaces, h_low );
+
+	lod = (mdrLOD_t *)( (byte *)header + header->ofsLODs );
+	for ( l = 0; l < header->numLODs; l++ )
+	{
+		surf = (mdrSurface_t *)( (byte *)lod + lod->ofsSurfaces );
+		for ( i = 0; i < lod->numSurfaces; i++, vaoSurf++ )
+		{
+			uint32_t		offset_xyz, offset_st, offset_normal, offset_tangent;
+			uint32_t		offset_blendindexes, offset_blendweights, stride;
+			uint32_t		dataSize;
+			uint8_t			*data;
+			vec3_t			*positions, *normals, *sdirs, *tdirs;
+			glIndex_t		*indexes;
+			mdrTriangle_t	*tri;
+
+			offset_xyz          = 0;
+			offset_st           = offset_xyz + sizeof( float ) * 3;
+			offset_normal       = offset_st + sizeof( float ) * 2;
+			offset_tangent      = offset_normal + sizeof( int16_t ) * 4;
+			offset_blendindexes = offset_tangent + sizeof( int16_t ) * 4;
+			offset_blendweights = offset_blendindexes + sizeof( byte ) * 4;
+			stride              = offset_blendweights + sizeof( float ) * 4;
+
+			dataSize = surf->numVerts * stride;
+			data = ri.Malloc( dataSize );
+			Com_Memset( data, 0, dataSize );
+
+			positions = ri.Malloc( sizeof( *positions ) * surf->numVerts * 4 );
+			normals = positions + surf->numVerts;
+			sdirs = normals + surf->numVerts;
+			tdirs = sdirs + surf->numVerts;
+
+			indexes = ri.Malloc( sizeof( *indexes ) * surf->numTriangles * 3 );
+
+			v = (mdrVertex_t *)( (byte *)surf + surf->ofsVerts );
+			for ( j = 0; j < surf->numVerts; j++ )
+			{
+				byte	*vert = data + j * stride;
+				float	*weights = (float *)( vert + offset_blendweights );
+
+				R_MDRBindVertex( header, bindFrame, v, positions[j], normals[j] );
+				VectorClear( sdirs[j] );
+				VectorClear( tdirs[j] );
+
+				memcpy( vert + offset_xyz, positions[j], sizeof( float ) * 3 );
+				memcpy( vert + offset_st, v->texCoords, sizeof( float ) * 2 );
+				R_VaoPackNormal( (int16_t *)( vert + offset_normal ), normals[j] );
+
+				for ( k = 0; k < v->numWeights; k++ )
+				{
+					vert[offset_blendindexes + k] = v->weights[k].boneIndex;
+					weights[k] = v->weights[k].boneWeight;
+				}
+
+				v = (mdrVertex_t *)&v->weights[v->numWeights];
+			}
+
+			// tangents from the first frame
+			tri = (mdrTriangle_t *)( (byte *)surf + surf->ofsTriangles );
+			for ( j = 0; j < surf->numTriangles; j++, tri++ )
+			{
+				vec3_t		sdir, tdir;
+				const float	*t0, *t1, *t2;
+				int			*idx = tri->indexes;
+
+				t0 = (float *)( data + idx[0] * stride + offset_st );
+				t1 = (float *)( data + idx[1] * stride + offset_st );
+				t2 = (float *)( data + idx[2] * stride + offset_st );
+
+				R_CalcTexDirs( sdir, tdir, positions[idx[0]], positions[idx[1]], positions[idx[2]], t0, t1, t2 );
+
+				for ( k = 0; k < 3; k++ )
+				{
+					VectorAdd( sdir, sdirs[idx[k]], sdirs[idx[k]] );
+					VectorAdd( tdir, tdirs[idx[k]], tdirs[idx[k]] );
+				}
+
+				indexes[j * 3 + 0] = idx[0];
+				indexes[j * 3 + 1] = idx[1];
+				indexes[j * 3 + 2] = idx[2];
+			}
+
+			qmath.VectorNormalizeArray( sdirs, surf->numVerts );
+			qmath.VectorNormalizeArray( tdirs, surf->numVerts );
+
+			for ( j = 0; j < surf->numVerts; j++ )
+			{
+				vec4_t	tangent;
+
+				tangent[3] = R_CalcTangentSpace( tangent, NULL, normals[j], sdirs[j], tdirs[j] );
+				R_VaoPackTangent( (int16_t *)( data + j * stride + offset_tangent ), tangent );
+			}
+
+			vaoSurf->surfaceType = SF_VAO_MDR;
+			vaoSurf->mdrHeader = header;
+			vaoSurf->mdrSurface = surf;
+			vaoSurf->invBindBones = (float *)invBones;
+			vaoSurf->numIndexes = surf->numTriangles * 3;
+			vaoSurf->numVerts = surf->numVerts;
+
+			vaoSurf->vao = R_CreateVao( va( "staticMDRMesh_VAO '%s'", surf->name ), data, dataSize,
+				(byte *)indexes, surf->numTriangles * 3 * sizeof( indexes[0] ), VAO_USAGE_STATIC );
+
+			vaoSurf->vao->attribs[ATTR_INDEX_POSITION    ].enabled = 1;
+			vaoSurf->vao->attribs[ATTR_INDEX_TEXCOORD    ].enabled = 1;
+			vaoSurf->vao->attribs[ATTR_INDEX_NORMAL      ].enabled = 1;
+			vaoSurf->vao->attribs[ATTR_INDEX_TANGENT     ].enabled = 1;
+			vaoSurf->vao->attribs[ATTR_INDEX_BONE_INDEXES].enabled = 1;
+			vaoSurf->vao->attribs[ATTR_INDEX_BONE_WEIGHTS].enabled = 1;
+
+			vaoSurf->vao->attribs[ATTR_INDEX_POSITION    ].count = 3;
+			vaoSurf->vao->attribs[ATTR_INDEX_TEXCOORD    ].count = 2;
+			vaoSurf->vao->attribs[ATTR_INDEX_NORMAL      ].count = 4;
+			vaoSurf->vao->attribs[ATTR_INDEX_TANGENT     ].count = 4;
+			vaoSurf->vao->attribs[ATTR_INDEX_BONE_INDEXES].count = 4;
+			vaoSurf->vao->attribs[ATTR_INDEX_BONE_WEIGHTS].count = 4;
+
+			vaoSurf->vao->attribs[ATTR_INDEX_POSITION    ].type = GL_FLOAT;
+			vaoSurf->vao->attribs[ATTR_INDEX_TEXCOORD    ].type = GL_FLOAT;
+			vaoSurf->vao->attribs[ATTR_INDEX_NORMAL      ].type = GL_SHORT;
+			vaoSurf->vao->attribs[ATTR_INDEX_TANGENT     ].type = GL_SHORT;
+			vaoSurf->vao->attribs[ATTR_INDEX_BONE_INDEXES].type = GL_UNSIGNED_BYTE;
+			vaoSurf->vao->attribs[ATTR_INDEX_BONE_WEIGHTS].type = GL_FLOAT;
+
+			vaoSurf->vao->attribs[ATTR_INDEX_POSITION    ].normalized = GL_FALSE;
+			vaoSurf->vao->attribs[ATTR_INDEX_TEXCOORD    ].normalized = GL_FALSE;
+			vaoSurf->vao->attribs[ATTR_INDEX_NORMAL      ].normalized = GL_TRUE;
+			vaoSurf->vao->attribs[ATTR_INDEX_TANGENT     ].normalized = GL_TRUE;
+			vaoSurf->vao->attribs[ATTR_INDEX_BONE_INDEXES].normalized = GL_FALSE;
+			vaoSurf->vao->attribs[ATTR_INDEX_BONE_WEIGHTS].normalized = GL_FALSE;
+
+			vaoSurf->vao->attribs[ATTR_INDEX_POSITION    ].offset = offset_xyz;
+			vaoSurf->vao->attribs[ATTR_INDEX_TEXCOORD    ].offset = offset_st;
+			vaoSurf->vao->attribs[ATTR_INDEX_NORMAL      ].offset = offset_normal;
+			vaoSurf->vao->attribs[ATTR_INDEX_TANGENT     ].offset = offset_tangent;
+			vaoSurf->vao->attribs[ATTR_INDEX_BONE_INDEXES].offset = offset_blendindexes;
+			vaoSurf->vao->attribs[ATTR_INDEX_BONE_WEIGHTS].offset = offset_blendweights;
+
+			for ( k = 0; k < ATTR_INDEX_COUNT; k++ )
+			{
+				vaoSurf->vao->attribs[k].stride = stride;
+			}
+
+			Vao_SetVertexPointers( vaoSurf->vao );
+
+			ri.Free( indexes );
+			ri.Free( positions );
+			ri.Free( data );
+
+			surf = (mdrSurface_t *)( (byte *)surf + surf->ofsEnd );
+		}
+		lod = (mdrLOD_t *)( (byte *)lod + lod->ofsEnd );
+	}
+}
+
+/*
+==============
+RB_MDRSurfaceAnimVao
+==============
+*/
+void RB_MDRSurfaceAnimVao( srfVaoMdrSurface_t *surface )
+{
+	mdrHeader_t		*header = surface->mdrHeader;
+	mdrFrame_t		*frame, *oldFrame;
+	float			frontlerp, backlerp;
+	int				frameSize, i, r, c;
+
+	if (ShaderRequiresCPUDeforms(tess.shader))
+	{
+		RB_MDRSurfaceAnim(surface->mdrSurface);
+		return;
+	}
+
+	RB_EndSurface();
+	RB_BeginSurface(tess.shader, tess.fogNum, tess.cubemapIndex);
+
+	R_BindVao(surface->vao);
+
+	tess.useInternalVao = qfalse;
+
+	tess.numIndexes = surface->numIndexes;
+	tess.numVertexes = surface->numVerts;
+
+	if (backEnd.currentEntity->e.oldframe == backEnd.currentEntity->e.frame)
+	{
+		backlerp	= 0;
+		frontlerp	= 1;
+	}
+	else
+	{
+		backlerp	= backEnd.currentEntity->e.backlerp;
+		frontlerp	= 1.0f - backlerp;
+	}
+
+	frameSize = (size_t)( &((mdrFrame_t *)0)->bones[ header->numBones ] );
+
+	frame = (mdrFrame_t *)((byte *)header + header->ofsFrames +
+		backEnd.currentEntity->e.frame * frameSize );
+	oldFrame = (mdrFrame_t *)((byte *)header + header->ofsFrames +
+		backEnd.currentEntity->e.oldframe * frameSize );
+
+	// the lerped bone times the inverted first frame bone, in column-major order
+	for ( i = 0; i < header->numBones; i++ )
+	{
+		float	bone[3][4];
+		float	*inv = surface->invBindBones + i * 12;
+		float	*mat = glState.boneMatrix[i];
+
+		for ( r = 0; r < 12; r++ )
+		{
+			((float *)bone)[r] = frontlerp * ((float *)frame->bones[i].matrix)[r] + backlerp * ((float *)oldFrame->bones[i].matrix)[r];
+		}
+
+		for ( r = 0; r < 3; r++ )
+		{
+			for ( c = 0; c < 4; c++ )
+			{
+				mat[c * 4 + r] = bone[r][0] * inv[c] + bone[r][1] * inv[4 + c] + bone[r][2] * inv[8 + c];
+			}
+			mat[12 + r] += bone[r][3];
+		}
+
+		mat[3] = 0.0f;
+		mat[7] = 0.0f;
+		mat[11] = 0.0f;
+		mat[15] = 1.0f;
+	}
+
+	glState.boneAnimation = header->numBones;
+
+	RB_EndSurface();
+
+	glState.boneAnimation = 0;
+}
+
 
 #define MC_MASK_X ((1<<(MC_BITS_X))-1)
 #define MC_MASK_Y ((1<<(MC_BITS_Y))-1)
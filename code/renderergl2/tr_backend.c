@@ -49,6 +49,8 @@ void GL_BindToTMU( image_t *image, int tmu )
 	{
 		if (image->flags & IMGFLAG_CUBEMAP)
 			target = GL_TEXTURE_CUBE_MAP;
+		else if (image->flags & IMGFLAG_ARRAY)
+			target = GL_TEXTURE_2D_ARRAY_EXT;
 
 		image->frameUsed = tr.frameCount;
 		texture = image->texnum;
@@ -310,8 +312,13 @@ static void SetViewportAndScissor( void ) {
 	// set the window clipping
 	qglViewport( backEnd.viewParms.viewportX, backEnd.viewParms.viewportY, 
 		backEnd.viewParms.viewportWidth, backEnd.viewParms.viewportHeight );
-	qglScissor( backEnd.viewParms.viewportX, backEnd.viewParms.viewportY, 
-		backEnd.viewParms.viewportWidth, backEnd.viewParms.viewportHeight );
+	if ( backEnd.viewParms.scissorWidth ) {
+		qglScissor( backEnd.viewParms.scissorX, backEnd.viewParms.scissorY,
+			backEnd.viewParms.scissorWidth, backEnd.viewParms.scissorHeight );
+	} else {
+		qglScissor( backEnd.viewParms.viewportX, backEnd.viewParms.viewportY, 
+			backEnd.viewParms.viewportWidth, backEnd.viewParms.viewportHeight );
+	}
 }
 
 /*
@@ -366,6 +373,14 @@ void RB_BeginDrawingView (void) {
 	// clear relevant buffers
 	clearBits = GL_DEPTH_BUFFER_BIT;
 
+	// start from the cached depth of the static world
+	if (backEnd.viewParms.flags & VPF_SHADOWCACHELOAD)
+	{
+		FBO_FastBlit(backEnd.viewParms.shadowCacheFbo, NULL, backEnd.viewParms.targetFbo, NULL, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		FBO_Bind(backEnd.viewParms.targetFbo);
+		clearBits = 0;
+	}
+
 	if ( r_measureOverdraw->integer || r_shadows->integer == 2 )
 	{
 		clearBits |= GL_STENCIL_BUFFER_BIT;
@@ -381,7 +396,9 @@ void RB_BeginDrawingView (void) {
 		clearBits |= GL_COLOR_BUFFER_BIT;
 	}
 
-	qglClear( clearBits );
+	if ( clearBits ) {
+		qglClear( clearBits );
+	}
 
 	if ( ( backEnd.refdef.rdflags & RDF_HYPERSPACE ) )
 	{
@@ -734,6 +751,39 @@ void RE_StretchRaw (int x, int y, int w, int h, int cols, int rows, const byte *
 	RB_InstantQuad2(quadVerts, texCoords);
 }
 
+/*
+=============
+RB_UploadCinematicBuffer
+
+Copies the frame into a pixel unpack buffer, so the texture upload
+doesn't have to finish before the call returns
+=============
+*/
+static qboolean RB_UploadCinematicBuffer(GLuint texture, int cols, int rows, const byte *data)
+{
+	GLsizeiptr size = cols * rows * 4;
+	void *pixels;
+
+	if (!tr.cinematicBuffer)
+		qglGenBuffers(1, &tr.cinematicBuffer);
+
+	qglBindBuffer(GL_PIXEL_UNPACK_BUFFER, tr.cinematicBuffer);
+
+	// a new store each time, the last upload may still be reading the old one
+	qglBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	pixels = qglMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (pixels)
+	{
+		Com_Memcpy(pixels, data, size);
+		qglUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		qglTextureSubImage2DEXT(texture, GL_TEXTURE_2D, 0, 0, 0, cols, rows, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	}
+
+	qglBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	return pixels != NULL;
+}
+
 void RE_UploadCinematic (int w, int h, int cols, int rows, const byte *data, int client, qboolean dirty) {
 	GLuint texture;
 
@@ -758,7 +808,8 @@ void RE_UploadCinematic (int w, int h, int cols, int rows, const byte *data, int
 		if (dirty) {
 			// otherwise, just subimage upload it so that drivers can tell we are going to be changing
 			// it and don't try and do a texture compression
-			qglTextureSubImage2DEXT(texture, GL_TEXTURE_2D, 0, 0, 0, cols, rows, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			if (!glRefConfig.pixelBufferObject || !RB_UploadCinematicBuffer(texture, cols, rows, data))
+				qglTextureSubImage2DEXT(texture, GL_TEXTURE_2D, 0, 0, 0, cols, rows, GL_RGBA, GL_UNSIGNED_BYTE, data);
 		}
 	}
 }
@@ -867,6 +918,187 @@ const void *RB_StretchPic ( const void *data ) {
 }
 
 
+/*
+=============
+RB_StretchPics
+
+The quads of a run go into tess in one loop, the shader is looked at once
+and the overflow check only when tess is full
+=============
+*/
+const void *RB_StretchPics( const void *data ) {
+	const stretchPicsCommand_t	*cmd;
+	const stretchPic_t	*pic, *end;
+	shader_t	*shader;
+	int			numVerts, numIndexes, room;
+	glIndex_t	*indexes;
+	uint16_t	color[4];
+
+	cmd = (const stretchPicsCommand_t *)data;
+	pic = (const stretchPic_t *)( cmd + 1 );
+	end = pic + cmd->numPics;
+
+	// FIXME: HUGE hack
+	if (glRefConfig.framebufferObject)
+		FBO_Bind(backEnd.framePostProcessed ? NULL : tr.renderFbo);
+
+	RB_SetGL2D();
+
+	shader = cmd->shader;
+	if ( shader != tess.shader ) {
+		if ( tess.numIndexes ) {
+			RB_EndSurface();
+		}
+		backEnd.currentEntity = &backEnd.entity2D;
+		RB_BeginSurface( shader, 0, 0 );
+	}
+
+	while ( pic < end ) {
+		RB_CHECKOVERFLOW( 4, 6 );
+
+		room = MIN( ( SHADER_MAX_VERTEXES - 1 - tess.numVertexes ) / 4, ( SHADER_MAX_INDEXES - 1 - tess.numIndexes ) / 6 );
+		if ( room > end - pic ) {
+			room = end - pic;
+		}
+
+		numVerts = tess.numVertexes;
+		numIndexes = tess.numIndexes;
+
+		tess.numVertexes += room * 4;
+		tess.numIndexes += room * 6;
+
+		for ( ; room > 0; room--, pic++, numVerts += 4, numIndexes += 6 ) {
+			indexes = &tess.indexes[ numIndexes ];
+			indexes[0] = numVerts + 3;
+			indexes[1] = numVerts + 0;
+			indexes[2] = numVerts + 2;
+			indexes[3] = numVerts + 2;
+			indexes[4] = numVerts + 0;
+			indexes[5] = numVerts + 1;
+
+			VectorScale4( pic->color, 257, color );
+			VectorCopy4( color, tess.color[ numVerts ] );
+			VectorCopy4( color, tess.color[ numVerts + 1 ] );
+			VectorCopy4( color, tess.color[ numVerts + 2 ] );
+			VectorCopy4( color, tess.color[ numVerts + 3 ] );
+
+			tess.xyz[ numVerts ][0] = pic->x;
+			tess.xyz[ numVerts ][1] = pic->y;
+			tess.xyz[ numVerts ][2] = 0;
+			tess.texCoords[ numVerts ][0] = pic->s1;
+			tess.texCoords[ numVerts ][1] = pic->t1;
+
+			tess.xyz[ numVerts + 1 ][0] = pic->x + pic->w;
+			tess.xyz[ numVerts + 1 ][1] = pic->y;
+			tess.xyz[ numVerts + 1 ][2] = 0;
+			tess.texCoords[ numVerts + 1 ][0] = pic->s2;
+			tess.texCoords[ numVerts + 1 ][1] = pic->t1;
+
+			tess.xyz[ numVerts + 2 ][0] = pic->x + pic->w;
+			tess.xyz[ numVerts + 2 ][1] = pic->y + pic->h;
+			tess.xyz[ numVerts + 2 ][2] = 0;
+			tess.texCoords[ numVerts + 2 ][0] = pic->s2;
+			tess.texCoords[ numVerts + 2 ][1] = pic->t2;
+
+			tess.xyz[ numVerts + 3 ][0] = pic->x;
+			tess.xyz[ numVerts + 3 ][1] = pic->y + pic->h;
+			tess.xyz[ numVerts + 3 ][2] = 0;
+			tess.texCoords[ numVerts + 3 ][0] = pic->s1;
+			tess.texCoords[ numVerts + 3 ][1] = pic->t2;
+		}
+	}
+
+	return (const void *)end;
+}
+
+
+/*
+=============
+RB_OcclusionQueries
+
+Draws the bounds of the leafs queued by R_LeafOccluded against the
+depth buffer of the finished view, one query each
+=============
+*/
+#define	OCCLUSION_BOX_EXPAND	2		// keeps faces the leaf bounds share with its walls in front of them
+#define	OCCLUSION_BATCH_BOXES	MIN( SHADER_MAX_VERTEXES / 8, SHADER_MAX_INDEXES / 36 )
+
+static void RB_OcclusionQueries( void )
+{
+	static const int boxIndexes[36] = {
+		0, 2, 3, 0, 3, 1,	4, 5, 7, 4, 7, 6,
+		0, 1, 5, 0, 5, 4,	2, 6, 7, 2, 7, 3,
+		0, 4, 6, 0, 6, 2,	1, 3, 7, 1, 7, 5
+	};
+	occlusionQuery_t *q;
+	mnode_t *leaf;
+	int first, count, i, j;
+
+	if (!tr.numOcclusionLeafs)
+		return;
+
+	GLimp_LogComment("--- RB_OcclusionQueries ---\n");
+
+	if (tess.numIndexes)
+		RB_EndSurface();
+
+	qglColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	GL_State(0);
+	GL_Cull(CT_TWO_SIDED);
+	GL_BindToTMU(tr.whiteImage, TB_COLORMAP);
+
+	GLSL_BindProgram(&tr.textureColorShader);
+	GLSL_SetUniformMat4(&tr.textureColorShader, UNIFORM_MODELVIEWPROJECTIONMATRIX, glState.modelviewProjection);
+	GLSL_SetUniformVec4(&tr.textureColorShader, UNIFORM_COLOR, colorWhite);
+
+	for (first = 0; first < tr.numOcclusionLeafs; first += count)
+	{
+		count = MIN(tr.numOcclusionLeafs - first, OCCLUSION_BATCH_BOXES);
+
+		tess.numVertexes = 0;
+		tess.numIndexes = 0;
+		tess.firstIndex = 0;
+
+		for (i = 0; i < count; i++)
+		{
+			leaf = tr.occlusionQueries[tr.occlusionLeafs[first + i]].leaf;
+
+			for (j = 0; j < 8; j++)
+			{
+				VectorSet4(tess.xyz[tess.numVertexes + j],
+					(j & 1) ? leaf->maxs[0] + OCCLUSION_BOX_EXPAND : leaf->mins[0] - OCCLUSION_BOX_EXPAND,
+					(j & 2) ? leaf->maxs[1] + OCCLUSION_BOX_EXPAND : leaf->mins[1] - OCCLUSION_BOX_EXPAND,
+					(j & 4) ? leaf->maxs[2] + OCCLUSION_BOX_EXPAND : leaf->mins[2] - OCCLUSION_BOX_EXPAND,
+					1.0f);
+			}
+
+			for (j = 0; j < 36; j++)
+				tess.indexes[tess.numIndexes++] = tess.numVertexes + boxIndexes[j];
+
+			tess.numVertexes += 8;
+		}
+
+		RB_UpdateTessVao(ATTR_POSITION);
+
+		for (i = 0; i < count; i++)
+		{
+			q = &tr.occlusionQueries[tr.occlusionLeafs[first + i]];
+
+			qglBeginQuery(GL_SAMPLES_PASSED, q->query);
+			R_DrawElements(36, i * 36);
+			qglEndQuery(GL_SAMPLES_PASSED);
+
+			q->issued = qtrue;
+		}
+	}
+
+	tess.numVertexes = 0;
+	tess.numIndexes = 0;
+	tess.firstIndex = 0;
+
+	qglColorMask(!backEnd.colorMask[0], !backEnd.colorMask[1], !backEnd.colorMask[2], !backEnd.colorMask[3]);
+}
+
 /*
 =============
 RB_DrawSurfs
@@ -909,6 +1141,7 @@ const void	*RB_DrawSurfs( const void *data ) {
 		RB_RenderDrawSurfList( cmd->drawSurfs, cmd->numDrawSurfs );
 		qglColorMask(!backEnd.colorMask[0], !backEnd.colorMask[1], !backEnd.colorMask[2], !backEnd.colorMask[3]);
 		backEnd.depthFill = qfalse;
+		backEnd.depthPrepassed = !isShadowView;
 
 		if (!isShadowView)
 		{
@@ -1124,9 +1357,21 @@ const void	*RB_DrawSurfs( const void *data ) {
 		qglDisable(GL_DEPTH_CLAMP);
 	}
 
+	if (backEnd.viewParms.flags & VPF_SHADOWCACHESTORE)
+	{
+		FBO_FastBlit(backEnd.viewParms.targetFbo, NULL, backEnd.viewParms.shadowCacheFbo, NULL, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		FBO_Bind(backEnd.viewParms.targetFbo);
+	}
+
 	if (!isShadowView)
 	{
 		RB_RenderDrawSurfList( cmd->drawSurfs, cmd->numDrawSurfs );
+		backEnd.depthPrepassed = qfalse;
+
+		if (backEnd.viewParms.flags & VPF_OCCLUSIONCULL)
+		{
+			RB_OcclusionQueries();
+		}
 
 		if (r_drawSun->integer)
 		{
@@ -1169,7 +1414,10 @@ const void	*RB_DrawSurfs( const void *data ) {
 		cubemap_t *cubemap = &tr.cubemaps[backEnd.viewParms.targetFboCubemapIndex];
 
 		FBO_Bind(NULL);
-		if (cubemap && cubemap->image)
+
+		// the mips are the prefiltered roughness levels, made once the
+		// last of the six sides is in
+		if (cubemap && cubemap->image && backEnd.viewParms.targetFboLayer == 5)
 			qglGenerateTextureMipmapEXT(cubemap->image->texnum, GL_TEXTURE_CUBE_MAP);
 	}
 
@@ -1361,11 +1609,12 @@ const void	*RB_SwapBuffers( const void *data ) {
 	// we measure overdraw by reading back the stencil buffer and
 	// counting up the number of increments that have happened
 	if ( r_measureOverdraw->integer ) {
-		int i;
+		int i, mark;
 		long sum = 0;
 		unsigned char *stencilReadback;
 
-		stencilReadback = ri.Hunk_AllocateTempMemory( glConfig.vidWidth * glConfig.vidHeight );
+		mark = ri.Com_ScratchMark();
+		stencilReadback = ri.Com_ScratchAlloc( glConfig.vidWidth * glConfig.vidHeight );
 		qglReadPixels( 0, 0, glConfig.vidWidth, glConfig.vidHeight, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, stencilReadback );
 
 		for ( i = 0; i < glConfig.vidWidth * glConfig.vidHeight; i++ ) {
@@ -1373,7 +1622,7 @@ const void	*RB_SwapBuffers( const void *data ) {
 		}
 
 		backEnd.pc.c_overDraw += sum;
-		ri.Hunk_FreeTempMemory( stencilReadback );
+		ri.Com_ScratchRelease( mark );
 	}
 
 	if (glRefConfig.framebufferObject)
@@ -1393,12 +1642,19 @@ const void	*RB_SwapBuffers( const void *data ) {
 		}
 	}
 
+	// screenshots read back in the last frame
+	RB_FinishScreenshotReadbacks( qfalse );
+
+	RB_DynamicResolutionEndFrame();
+
 	if ( !glState.finishCalled ) {
 		qglFinish();
 	}
 
 	GLimp_LogComment( "***************** RB_SwapBuffers *****************\n\n\n" );
 
+	RB_TessRingEndFrame();
+
 	GLimp_EndFrame();
 
 	backEnd.framePostProcessed = qfalse;
@@ -1453,7 +1709,7 @@ const void *RB_PostProcess(const void *data)
 {
 	const postProcessCommand_t *cmd = data;
 	FBO_t *srcFbo;
-	ivec4_t srcBox, dstBox;
+	ivec4_t srcBox, dstBox, ssaoBox;
 	qboolean autoExposure;
 
 	// finish any 2D drawing if needed
@@ -1481,26 +1737,28 @@ const void *RB_PostProcess(const void *data)
 		srcFbo = tr.msaaResolveFbo;
 	}
 
-	dstBox[0] = backEnd.viewParms.viewportX;
-	dstBox[1] = backEnd.viewParms.viewportY;
-	dstBox[2] = backEnd.viewParms.viewportWidth;
-	dstBox[3] = backEnd.viewParms.viewportHeight;
+	// the scene is in the viewport, which R_DynamicResolutionViewport may
+	// have scaled down, and goes where the refdef has it on the screen
+	srcBox[0] = backEnd.viewParms.viewportX;
+	srcBox[1] = backEnd.viewParms.viewportY;
+	srcBox[2] = backEnd.viewParms.viewportWidth;
+	srcBox[3] = backEnd.viewParms.viewportHeight;
+
+	dstBox[0] = backEnd.refdef.x;
+	dstBox[1] = glConfig.vidHeight - ( backEnd.refdef.y + backEnd.refdef.height );
+	dstBox[2] = backEnd.refdef.width;
+	dstBox[3] = backEnd.refdef.height;
 
 	if (r_ssao->integer)
 	{
-		srcBox[0] = backEnd.viewParms.viewportX      * tr.screenSsaoImage->width  / (float)glConfig.vidWidth;
-		srcBox[1] = backEnd.viewParms.viewportY      * tr.screenSsaoImage->height / (float)glConfig.vidHeight;
-		srcBox[2] = backEnd.viewParms.viewportWidth  * tr.screenSsaoImage->width  / (float)glConfig.vidWidth;
-		srcBox[3] = backEnd.viewParms.viewportHeight * tr.screenSsaoImage->height / (float)glConfig.vidHeight;
+		ssaoBox[0] = backEnd.viewParms.viewportX      * tr.screenSsaoImage->width  / (float)glConfig.vidWidth;
+		ssaoBox[1] = backEnd.viewParms.viewportY      * tr.screenSsaoImage->height / (float)glConfig.vidHeight;
+		ssaoBox[2] = backEnd.viewParms.viewportWidth  * tr.screenSsaoImage->width  / (float)glConfig.vidWidth;
+		ssaoBox[3] = backEnd.viewParms.viewportHeight * tr.screenSsaoImage->height / (float)glConfig.vidHeight;
 
-		FBO_Blit(tr.screenSsaoFbo, srcBox, NULL, srcFbo, dstBox, NULL, NULL, GLS_SRCBLEND_DST_COLOR | GLS_DSTBLEND_ZERO);
+		FBO_Blit(tr.screenSsaoFbo, ssaoBox, NULL, srcFbo, srcBox, NULL, NULL, GLS_SRCBLEND_DST_COLOR | GLS_DSTBLEND_ZERO);
 	}
 
-	srcBox[0] = backEnd.viewParms.viewportX;
-	srcBox[1] = backEnd.viewParms.viewportY;
-	srcBox[2] = backEnd.viewParms.viewportWidth;
-	srcBox[3] = backEnd.viewParms.viewportHeight;
-
 	if (srcFbo)
 	{
 		if (r_hdr->integer && (r_toneMap->integer || r_forceToneMap->integer))
@@ -1510,7 +1768,8 @@ const void *RB_PostProcess(const void *data)
 		}
 		else if (r_cameraExposure->value == 0.0f)
 		{
-			FBO_FastBlit(srcFbo, srcBox, NULL, dstBox, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			FBO_FastBlit(srcFbo, srcBox, NULL, dstBox, GL_COLOR_BUFFER_BIT,
+				srcBox[2] == dstBox[2] && srcBox[3] == dstBox[3] ? GL_NEAREST : GL_LINEAR);
 		}
 		else
 		{
@@ -1525,11 +1784,12 @@ const void *RB_PostProcess(const void *data)
 		}
 	}
 
+	// the rest is on the screen already
 	if (r_drawSunRays->integer)
-		RB_SunRays(NULL, srcBox, NULL, dstBox);
+		RB_SunRays(NULL, dstBox, NULL, dstBox);
 
 	if (1)
-		RB_BokehBlur(NULL, srcBox, NULL, dstBox, backEnd.refdef.blurFactor);
+		RB_BokehBlur(NULL, dstBox, NULL, dstBox, backEnd.refdef.blurFactor);
 	else
 		RB_GaussianBlur(backEnd.refdef.blurFactor);
 
@@ -1663,6 +1923,38 @@ const void *RB_PostProcess(const void *data)
 // FIXME: put this function declaration elsewhere
 void R_SaveDDS(const char *filename, byte *pic, int width, int height, int depth);
 
+/*
+=============
+RB_SaveCubemap
+
+Writes the top level of all six sides as a dds, loading it generates
+the mips again
+=============
+*/
+void RB_SaveCubemap(cubemap_t *cubemap, const char *filename)
+{
+	FBO_t *oldFbo = glState.currentFBO;
+	int sideSize = r_cubemapSize->integer * r_cubemapSize->integer * 4;
+	byte *cubemapPixels = ri.Malloc(sideSize * 6);
+	byte *p = cubemapPixels;
+	int j;
+
+	FBO_Bind(tr.renderCubeFbo);
+
+	for (j = 0; j < 6; j++)
+	{
+		FBO_AttachImage(tr.renderCubeFbo, cubemap->image, GL_COLOR_ATTACHMENT0_EXT, j);
+		qglReadPixels(0, 0, r_cubemapSize->integer, r_cubemapSize->integer, GL_RGBA, GL_UNSIGNED_BYTE, p);
+		p += sideSize;
+	}
+
+	FBO_Bind(oldFbo);
+
+	R_SaveDDS(filename, cubemapPixels, r_cubemapSize->integer, r_cubemapSize->integer, 6);
+
+	ri.Free(cubemapPixels);
+}
+
 /*
 =============
 RB_ExportCubemaps
@@ -1686,25 +1978,12 @@ const void *RB_ExportCubemaps(const void *data)
 
 	if (cmd)
 	{
-		FBO_t *oldFbo = glState.currentFBO;
-		int sideSize = r_cubemapSize->integer * r_cubemapSize->integer * 4;
-		byte *cubemapPixels = ri.Malloc(sideSize * 6);
-		int i, j;
-
-		FBO_Bind(tr.renderCubeFbo);
+		int i;
 
 		for (i = 0; i < tr.numCubemaps; i++)
 		{
 			char filename[MAX_QPATH];
 			cubemap_t *cubemap = &tr.cubemaps[i];
-			byte *p = cubemapPixels;
-
-			for (j = 0; j < 6; j++)
-			{
-				FBO_AttachImage(tr.renderCubeFbo, cubemap->image, GL_COLOR_ATTACHMENT0_EXT, j);
-				qglReadPixels(0, 0, r_cubemapSize->integer, r_cubemapSize->integer, GL_RGBA, GL_UNSIGNED_BYTE, p);
-				p += sideSize;
-			}
 
 			if (cubemap->name[0])
 			{
@@ -1716,19 +1995,50 @@ const void *RB_ExportCubemaps(const void *data)
 				Com_sprintf(filename, MAX_QPATH, "cubemaps/%s/%03d.dds", tr.world->baseName, i);
 			}
 
-			R_SaveDDS(filename, cubemapPixels, r_cubemapSize->integer, r_cubemapSize->integer, 6);
+			RB_SaveCubemap(cubemap, filename);
 			ri.Printf(PRINT_ALL, "Saved cubemap %d as %s\n", i, filename);
 		}
-
-		FBO_Bind(oldFbo);
-
-		ri.Free(cubemapPixels);
 	}
 
 	return (const void *)(cmd + 1);
 }
 
 
+/*
+====================
+RB_ProfileCommand
+
+Switches the profiler to the stage a command is counted in
+====================
+*/
+static void RB_ProfileCommand( int commandId )
+{
+	profStage_t stage;
+
+	switch ( commandId )
+	{
+	case RC_DRAW_SURFS:
+	case RC_CAPSHADOWMAP:
+		stage = PROF_VIEWS;
+		break;
+	case RC_POSTPROCESS:
+		stage = PROF_POSTPROCESS;
+		break;
+	case RC_SWAP_BUFFERS:
+		stage = PROF_SWAP;
+		break;
+	default:
+		stage = PROF_2D;
+		break;
+	}
+
+	// batched 2D belongs to the 2D stage, the other commands flush it first anyway
+	if ( stage != PROF_2D && tess.numIndexes )
+		RB_EndSurface();
+
+	R_ProfileStage( stage );
+}
+
 /*
 ====================
 RB_ExecuteRenderCommands
@@ -1736,12 +2046,18 @@ RB_ExecuteRenderCommands
 */
 void RB_ExecuteRenderCommands( const void *data ) {
 	int		t1, t2;
+	profStage_t	stage;
 
 	t1 = ri.Milliseconds ();
+	stage = R_ProfileStage( PROF_2D );
+
+	RB_DynamicResolutionBeginFrame();
 
 	while ( 1 ) {
 		data = PADP(data, sizeof(void *));
 
+		RB_ProfileCommand( *(const int *)data );
+
 		switch ( *(const int *)data ) {
 		case RC_SET_COLOR:
 			data = RB_SetColor( data );
@@ -1749,6 +2065,9 @@ void RB_ExecuteRenderCommands( const void *data ) {
 		case RC_STRETCH_PIC:
 			data = RB_StretchPic( data );
 			break;
+		case RC_STRETCH_PICS:
+			data = RB_StretchPics( data );
+			break;
 		case RC_DRAW_SURFS:
 			data = RB_DrawSurfs( data );
 			break;
@@ -1786,6 +2105,7 @@ void RB_ExecuteRenderCommands( const void *data ) {
 				RB_EndSurface();
 
 			// stop rendering
+			R_ProfileStage( stage );
 			t2 = ri.Milliseconds ();
 			backEnd.pc.msec = t2 - t1;
 			return;
@@ -206,7 +206,7 @@ static	void R_LoadLightmaps( lump_t *l, lump_t *surfs ) {
 	int			len;
 	byte		*image;
 	int			i, j, numLightmaps, textureInternalFormat = 0;
-	int			numLightmapsPerPage = 16;
+	int			numLightmapsPerPage = 16, numPages = 0;
 	float maxIntensity = 0;
 	double sumIntensity = 0;
 
@@ -251,19 +251,32 @@ static	void R_LoadLightmaps( lump_t *l, lump_t *surfs ) {
 	{
 		int maxLightmapsPerAxis = glConfig.maxTextureSize / tr.lightmapSize;
 		int lightmapCols = 4, lightmapRows = 4;
+		int minLightmapsPerPage = numLightmaps;
+
+		// Pages that are layers of one array only have to be as big as the
+		// layer limit asks for, which saves the half of a page that doubling
+		// its size can leave empty.
+		if (tr.lightmapArray)
+			minLightmapsPerPage = (numLightmaps + glRefConfig.maxArrayTextureLayers - 1) / glRefConfig.maxArrayTextureLayers;
 
 		// Increase width at first, then height.
-		while (lightmapCols * lightmapRows < numLightmaps && lightmapCols != maxLightmapsPerAxis)
+		while (lightmapCols * lightmapRows < minLightmapsPerPage && lightmapCols != maxLightmapsPerAxis)
 			lightmapCols <<= 1;
 
-		while (lightmapCols * lightmapRows < numLightmaps && lightmapRows != maxLightmapsPerAxis)
+		while (lightmapCols * lightmapRows < minLightmapsPerPage && lightmapRows != maxLightmapsPerAxis)
 			lightmapRows <<= 1;
 
 		tr.fatLightmapCols  = lightmapCols;
 		tr.fatLightmapRows  = lightmapRows;
 		numLightmapsPerPage = lightmapCols * lightmapRows;
 
-		tr.numLightmaps = (numLightmaps + (numLightmapsPerPage - 1)) / numLightmapsPerPage;
+		numPages = (numLightmaps + (numLightmapsPerPage - 1)) / numLightmapsPerPage;
+
+		// one image for all of them, FatPackU adds twice the layer to s
+		if (tr.lightmapArray)
+			tr.numLightmaps = 1;
+		else
+			tr.numLightmaps = numPages;
 	}
 	else
 	{
@@ -291,7 +304,15 @@ static	void R_LoadLightmaps( lump_t *l, lump_t *surfs ) {
 		int width  = tr.fatLightmapCols * tr.lightmapSize;
 		int height = tr.fatLightmapRows * tr.lightmapSize;
 
-		for (i = 0; i < tr.numLightmaps; i++)
+		if (tr.lightmapArray)
+		{
+			tr.lightmaps[0] = R_CreateImageArray("_fatlightmaparray", width, height, numPages, IMGTYPE_COLORALPHA, imgFlags, textureInternalFormat);
+
+			if (tr.worldDeluxeMapping)
+				tr.deluxemaps[0] = R_CreateImageArray("_fatdeluxemaparray", width, height, numPages, IMGTYPE_DELUXE, imgFlags, GL_RGBA8);
+		}
+
+		for (i = 0; i < tr.numLightmaps && !tr.lightmapArray; i++)
 		{
 			tr.lightmaps[i] = R_CreateImage(va("_fatlightmap%d", i), NULL, width, height, IMGTYPE_COLORALPHA, imgFlags, textureInternalFormat);
 
@@ -453,7 +474,9 @@ static	void R_LoadLightmaps( lump_t *l, lump_t *surfs ) {
 				}
 			}
 
-			if (r_mergeLightmaps->integer)
+			if (tr.lightmapArray)
+				R_UpdateImageLayer(tr.lightmaps[0], image, lightmapnum, xoff, yoff, tr.lightmapSize, tr.lightmapSize, textureInternalFormat);
+			else if (r_mergeLightmaps->integer)
 				R_UpdateSubImage(tr.lightmaps[lightmapnum], image, xoff, yoff, tr.lightmapSize, tr.lightmapSize, textureInternalFormat);
 			else
 				tr.lightmaps[i] = R_CreateImage(va("*lightmap%d", i), image, tr.lightmapSize, tr.lightmapSize, IMGTYPE_COLORALPHA, imgFlags, textureInternalFormat );
@@ -482,7 +505,9 @@ static	void R_LoadLightmaps( lump_t *l, lump_t *surfs ) {
 				image[j*4+3] = 255;
 			}
 
-			if (r_mergeLightmaps->integer)
+			if (tr.lightmapArray)
+				R_UpdateImageLayer(tr.deluxemaps[0], image, lightmapnum, xoff, yoff, tr.lightmapSize, tr.lightmapSize, GL_RGBA8 );
+			else if (r_mergeLightmaps->integer)
 				R_UpdateSubImage(tr.deluxemaps[lightmapnum], image, xoff, yoff, tr.lightmapSize, tr.lightmapSize, GL_RGBA8 );
 			else
 				tr.deluxemaps[i] = R_CreateImage(va("*deluxemap%d", i), image, tr.lightmapSize, tr.lightmapSize, IMGTYPE_DELUXE, imgFlags, 0 );
@@ -507,8 +532,14 @@ static float FatPackU(float input, int lightmapnum)
 
 	if (tr.fatLightmapCols > 0)
 	{
+		int page = lightmapnum / (tr.fatLightmapCols * tr.fatLightmapRows);
+
 		lightmapnum %= (tr.fatLightmapCols * tr.fatLightmapRows);
-		return (input + (lightmapnum % tr.fatLightmapCols)) / (float)(tr.fatLightmapCols);
+		input = (input + (lightmapnum % tr.fatLightmapCols)) / (float)(tr.fatLightmapCols);
+
+		// the layer rides along in s, see USE_LIGHTMAP_ARRAY in the shaders
+		if (tr.lightmapArray)
+			input += 2.0f * page;
 	}
 
 	return input;
@@ -540,6 +571,9 @@ static int FatLightmap(int lightmapnum)
 	if (tr.worldDeluxeMapping)
 		lightmapnum >>= 1;
 
+	if (tr.lightmapArray)
+		return 0;
+
 	if (tr.fatLightmapCols > 0)
 		return lightmapnum / (tr.fatLightmapCols * tr.fatLightmapRows);
 	
@@ -590,6 +624,51 @@ static	void R_LoadVisibility( lump_t *l ) {
 	}
 }
 
+/*
+=================
+R_LoadClusterLeafs
+
+Lists the leafs of every cluster, so R_MarkLeaves only has to visit the
+clusters in the PVS instead of every node of the world
+=================
+*/
+static void R_LoadClusterLeafs( void ) {
+	mnode_t	*leaf;
+	int		i, cluster, numLeafs;
+	int		*fill;
+
+	s_worldData.clusterFirstLeaf = ri.Hunk_Alloc( ( s_worldData.numClusters + 1 ) * sizeof( int ), h_low );
+
+	numLeafs = 0;
+	for ( i = 0, leaf = s_worldData.nodes ; i < s_worldData.numnodes ; i++, leaf++ ) {
+		cluster = leaf->cluster;
+		if ( leaf->contents == CONTENTS_NODE || cluster < 0 || cluster >= s_worldData.numClusters ) {
+			continue;
+		}
+		s_worldData.clusterFirstLeaf[cluster + 1]++;
+		numLeafs++;
+	}
+
+	for ( i = 0 ; i < s_worldData.numClusters ; i++ ) {
+		s_worldData.clusterFirstLeaf[i + 1] += s_worldData.clusterFirstLeaf[i];
+	}
+
+	s_worldData.clusterLeafs = ri.Hunk_Alloc( ( numLeafs ? numLeafs : 1 ) * sizeof( *s_worldData.clusterLeafs ), h_low );
+
+	fill = ri.Hunk_AllocateTempMemory( ( s_worldData.numClusters + 1 ) * sizeof( int ) );
+	Com_Memcpy( fill, s_worldData.clusterFirstLeaf, ( s_worldData.numClusters + 1 ) * sizeof( int ) );
+
+	for ( i = 0, leaf = s_worldData.nodes ; i < s_worldData.numnodes ; i++, leaf++ ) {
+		cluster = leaf->cluster;
+		if ( leaf->contents == CONTENTS_NODE || cluster < 0 || cluster >= s_worldData.numClusters ) {
+			continue;
+		}
+		s_worldData.clusterLeafs[fill[cluster]++] = leaf;
+	}
+
+	ri.Hunk_FreeTempMemory( fill );
+}
+
 //===============================================================================
 
 
@@ -689,14 +768,73 @@ void LoadDrawVertToSrfVert(srfVert_t *s, drawVert_t *d, int realLightmapNum, flo
 
 /*
 ===============
-ParseFace
+ParseTriangles
+
+Copies the triangles of a face or triangle soup and calculates the tangent
+spaces. Runs on the worker threads, so instead of printing or dropping it
+returns the number of degenerate triangles removed, or -1 for an index
+outside the surface.
 ===============
 */
-static void ParseFace( dsurface_t *ds, drawVert_t *verts, float *hdrVertColors, msurface_t *surf, int *indexes  ) {
+static int ParseTriangles( dsurface_t *ds, srfBspSurface_t *cv, int *indexes ) {
 	int			i, j;
-	srfBspSurface_t	*cv;
 	glIndex_t  *tri;
-	int			numVerts, numIndexes, badTriangles;
+	int			numIndexes, badTriangles;
+
+	numIndexes = LittleLong(ds->numIndexes);
+
+	// copy triangles
+	badTriangles = 0;
+	indexes += LittleLong(ds->firstIndex);
+	for(i = 0, tri = cv->indexes; i < numIndexes; i += 3, tri += 3)
+	{
+		for(j = 0; j < 3; j++)
+		{
+			tri[j] = LittleLong(indexes[i + j]);
+
+			if(tri[j] >= cv->numVerts)
+			{
+				return -1;
+			}
+		}
+
+		if ((tri[0] == tri[1]) || (tri[1] == tri[2]) || (tri[0] == tri[2]))
+		{
+			tri -= 3;
+			badTriangles++;
+		}
+	}
+
+	cv->numIndexes -= badTriangles * 3;
+
+	// Calculate tangent spaces
+	{
+		srfVert_t      *dv[3];
+
+		for(i = 0, tri = cv->indexes; i < numIndexes; i += 3, tri += 3)
+		{
+			dv[0] = &cv->verts[tri[0]];
+			dv[1] = &cv->verts[tri[1]];
+			dv[2] = &cv->verts[tri[2]];
+
+			R_CalcTangentVectors(dv);
+		}
+	}
+
+	return badTriangles;
+}
+
+
+/*
+===============
+ParseFace
+
+Sets up the face, ParseFaceData fills it in later
+===============
+*/
+static void ParseFace( dsurface_t *ds, msurface_t *surf ) {
+	srfBspSurface_t	*cv;
+	int			numVerts, numIndexes;
 	int realLightmapNum;
 
 	realLightmapNum = LittleLong( ds->lightmapNum );
@@ -729,40 +867,33 @@ static void ParseFace( dsurface_t *ds, drawVert_t *verts, float *hdrVertColors,
 	cv->numVerts = numVerts;
 	cv->verts = ri.Hunk_Alloc(numVerts * sizeof(cv->verts[0]), h_low);
 
-	// copy vertexes
 	surf->cullinfo.type = CULLINFO_PLANE | CULLINFO_BOX;
-	ClearBounds(surf->cullinfo.bounds[0], surf->cullinfo.bounds[1]);
-	verts += LittleLong(ds->firstVert);
-	for(i = 0; i < numVerts; i++)
-		LoadDrawVertToSrfVert(&cv->verts[i], &verts[i], realLightmapNum, hdrVertColors ? hdrVertColors + (ds->firstVert + i) * 3 : NULL, surf->cullinfo.bounds);
 
-	// copy triangles
-	badTriangles = 0;
-	indexes += LittleLong(ds->firstIndex);
-	for(i = 0, tri = cv->indexes; i < numIndexes; i += 3, tri += 3)
-	{
-		for(j = 0; j < 3; j++)
-		{
-			tri[j] = LittleLong(indexes[i + j]);
+	surf->data = (surfaceType_t *)cv;
+}
 
-			if(tri[j] >= numVerts)
-			{
-				ri.Error(ERR_DROP, "Bad index in face surface");
-			}
-		}
 
-		if ((tri[0] == tri[1]) || (tri[1] == tri[2]) || (tri[0] == tri[2]))
-		{
-			tri -= 3;
-			badTriangles++;
-		}
-	}
+/*
+===============
+ParseFaceData
+===============
+*/
+static int ParseFaceData( dsurface_t *ds, drawVert_t *verts, float *hdrVertColors, msurface_t *surf, int *indexes ) {
+	srfBspSurface_t	*cv = (srfBspSurface_t *)surf->data;
+	vec3_t		bounds[2];
+	int			i, badTriangles;
 
-	if (badTriangles)
-	{
-		ri.Printf(PRINT_WARNING, "Face has bad triangles, originally shader %s %d tris %d verts, now %d tris\n", surf->shader->name, numIndexes / 3, numVerts, numIndexes / 3 - badTriangles);
-		cv->numIndexes -= badTriangles * 3;
-	}
+	// copy vertexes
+	ClearBounds(bounds[0], bounds[1]);
+	verts += LittleLong(ds->firstVert);
+	for(i = 0; i < cv->numVerts; i++)
+		LoadDrawVertToSrfVert(&cv->verts[i], &verts[i], LittleLong(ds->lightmapNum), hdrVertColors ? hdrVertColors + (ds->firstVert + i) * 3 : NULL, bounds);
+	VectorCopy(bounds[0], surf->cullinfo.bounds[0]);
+	VectorCopy(bounds[1], surf->cullinfo.bounds[1]);
+
+	badTriangles = ParseTriangles(ds, cv, indexes);
+	if (badTriangles < 0)
+		return badTriangles;
 
 	// take the plane information from the lightmap vector
 	for ( i = 0 ; i < 3 ; i++ ) {
@@ -773,21 +904,7 @@ static void ParseFace( dsurface_t *ds, drawVert_t *verts, float *hdrVertColors,
 	cv->cullPlane.type = PlaneTypeForNormal( cv->cullPlane.normal );
 	surf->cullinfo.plane = cv->cullPlane;
 
-	surf->data = (surfaceType_t *)cv;
-
-	// Calculate tangent spaces
-	{
-		srfVert_t      *dv[3];
-
-		for(i = 0, tri = cv->indexes; i < numIndexes; i += 3, tri += 3)
-		{
-			dv[0] = &cv->verts[tri[0]];
-			dv[1] = &cv->verts[tri[1]];
-			dv[2] = &cv->verts[tri[2]];
-
-			R_CalcTangentVectors(dv);
-		}
-	}
+	return badTriangles;
 }
 
 
@@ -860,13 +977,13 @@ static void ParseMesh ( dsurface_t *ds, drawVert_t *verts, float *hdrVertColors,
 /*
 ===============
 ParseTriSurf
+
+Sets up the triangle soup, ParseTriSurfData fills it in later
 ===============
 */
-static void ParseTriSurf( dsurface_t *ds, drawVert_t *verts, float *hdrVertColors, msurface_t *surf, int *indexes ) {
+static void ParseTriSurf( dsurface_t *ds, msurface_t *surf ) {
 	srfBspSurface_t *cv;
-	glIndex_t  *tri;
-	int             i, j;
-	int             numVerts, numIndexes, badTriangles;
+	int             numVerts, numIndexes;
 
 	// get fog volume
 	surf->fogIndex = LittleLong( ds->fogNum ) + 1;
@@ -892,54 +1009,28 @@ static void ParseTriSurf( dsurface_t *ds, drawVert_t *verts, float *hdrVertColor
 
 	surf->data = (surfaceType_t *) cv;
 
-	// copy vertexes
 	surf->cullinfo.type = CULLINFO_BOX;
-	ClearBounds(surf->cullinfo.bounds[0], surf->cullinfo.bounds[1]);
-	verts += LittleLong(ds->firstVert);
-	for(i = 0; i < numVerts; i++)
-		LoadDrawVertToSrfVert(&cv->verts[i], &verts[i], -1, hdrVertColors ? hdrVertColors + (ds->firstVert + i) * 3 : NULL, surf->cullinfo.bounds);
-
-	// copy triangles
-	badTriangles = 0;
-	indexes += LittleLong(ds->firstIndex);
-	for(i = 0, tri = cv->indexes; i < numIndexes; i += 3, tri += 3)
-	{
-		for(j = 0; j < 3; j++)
-		{
-			tri[j] = LittleLong(indexes[i + j]);
-
-			if(tri[j] >= numVerts)
-			{
-				ri.Error(ERR_DROP, "Bad index in face surface");
-			}
-		}
-
-		if ((tri[0] == tri[1]) || (tri[1] == tri[2]) || (tri[0] == tri[2]))
-		{
-			tri -= 3;
-			badTriangles++;
-		}
-	}
-
-	if (badTriangles)
-	{
-		ri.Printf(PRINT_WARNING, "Trisurf has bad triangles, originally shader %s %d tris %d verts, now %d tris\n", surf->shader->name, numIndexes / 3, numVerts, numIndexes / 3 - badTriangles);
-		cv->numIndexes -= badTriangles * 3;
-	}
+}
 
-	// Calculate tangent spaces
-	{
-		srfVert_t      *dv[3];
+/*
+===============
+ParseTriSurfData
+===============
+*/
+static int ParseTriSurfData( dsurface_t *ds, drawVert_t *verts, float *hdrVertColors, msurface_t *surf, int *indexes ) {
+	srfBspSurface_t *cv = (srfBspSurface_t *)surf->data;
+	vec3_t          bounds[2];
+	int             i;
 
-		for(i = 0, tri = cv->indexes; i < numIndexes; i += 3, tri += 3)
-		{
-			dv[0] = &cv->verts[tri[0]];
-			dv[1] = &cv->verts[tri[1]];
-			dv[2] = &cv->verts[tri[2]];
+	// copy vertexes
+	ClearBounds(bounds[0], bounds[1]);
+	verts += LittleLong(ds->firstVert);
+	for(i = 0; i < cv->numVerts; i++)
+		LoadDrawVertToSrfVert(&cv->verts[i], &verts[i], -1, hdrVertColors ? hdrVertColors + (ds->firstVert + i) * 3 : NULL, bounds);
+	VectorCopy(bounds[0], surf->cullinfo.bounds[0]);
+	VectorCopy(bounds[1], surf->cullinfo.bounds[1]);
 
-			R_CalcTangentVectors(dv);
-		}
-	}
+	return ParseTriangles(ds, cv, indexes);
 }
 
 /*
@@ -1676,10 +1767,57 @@ void R_MovePatchSurfacesToHunk(void) {
 		grid->verts = ri.Hunk_Alloc(grid->numVerts * sizeof(srfVert_t), h_low);
 		Com_Memcpy(grid->verts, copyFrom, grid->numVerts * sizeof(srfVert_t));
 		ri.Free(copyFrom);
+
+		// the lod errors are final now that the patches are stitched
+		R_CreateGridLods( grid );
 	}
 }
 
 
+// faces and triangle soups are converted in this many jobs per thread
+#define SURFACE_JOBS_PER_THREAD	4
+
+typedef struct {
+	dsurface_t	*in;
+	msurface_t	*out;
+	drawVert_t	*dv;
+	int			*indexes;
+	float		*hdrVertColors;
+	int			count;
+	int			numJobs;
+	int			*badTriangles;		// per surface, -1 for a bad index
+} surfaceJobs_t;
+
+/*
+===============
+R_LoadSurfacesJob
+
+Fills in the vertexes, triangles and tangent spaces for one range of
+faces and triangle soups. Their shaders and memory are already set up on
+the main thread, which also reports whatever went wrong.
+===============
+*/
+static void R_LoadSurfacesJob( void *data, int index ) {
+	surfaceJobs_t	*jobs = data;
+	int				i, first, last;
+
+	first = (int)( (long long)jobs->count * index / jobs->numJobs );
+	last = (int)( (long long)jobs->count * ( index + 1 ) / jobs->numJobs );
+
+	for ( i = first ; i < last ; i++ ) {
+		switch ( LittleLong( jobs->in[i].surfaceType ) ) {
+		case MST_TRIANGLE_SOUP:
+			jobs->badTriangles[i] = ParseTriSurfData( &jobs->in[i], jobs->dv, jobs->hdrVertColors, &jobs->out[i], jobs->indexes );
+			break;
+		case MST_PLANAR:
+			jobs->badTriangles[i] = ParseFaceData( &jobs->in[i], jobs->dv, jobs->hdrVertColors, &jobs->out[i], jobs->indexes );
+			break;
+		default:
+			break;
+		}
+	}
+}
+
 /*
 ===============
 R_LoadSurfaces
@@ -1692,8 +1830,9 @@ static	void R_LoadSurfaces( lump_t *surfs, lump_t *verts, lump_t *indexLump ) {
 	int			*indexes;
 	int			count;
 	int			numFaces, numMeshes, numTriSurfs, numFlares;
-	int			i;
+	int			i, numIndexes, bad;
 	float *hdrVertColors = NULL;
+	surfaceJobs_t	jobs;
 
 	numFaces = 0;
 	numMeshes = 0;
@@ -1764,6 +1903,7 @@ static	void R_LoadSurfaces( lump_t *surfs, lump_t *verts, lump_t *indexLump ) {
 		}
 	}
 
+	// loading shaders and allocating stays on this thread, in surface order
 	in = (void *)(fileBase + surfs->fileofs);
 	out = s_worldData.surfaces;
 	for ( i = 0 ; i < count ; i++, in++, out++ ) {
@@ -1773,11 +1913,11 @@ static	void R_LoadSurfaces( lump_t *surfs, lump_t *verts, lump_t *indexLump ) {
 			numMeshes++;
 			break;
 		case MST_TRIANGLE_SOUP:
-			ParseTriSurf( in, dv, hdrVertColors, out, indexes );
+			ParseTriSurf( in, out );
 			numTriSurfs++;
 			break;
 		case MST_PLANAR:
-			ParseFace( in, dv, hdrVertColors, out, indexes );
+			ParseFace( in, out );
 			numFaces++;
 			break;
 		case MST_FLARE:
@@ -1789,6 +1929,40 @@ static	void R_LoadSurfaces( lump_t *surfs, lump_t *verts, lump_t *indexLump ) {
 		}
 	}
 
+	// the vertex conversion and tangent spaces run on the worker threads
+	jobs.in = (void *)(fileBase + surfs->fileofs);
+	jobs.out = s_worldData.surfaces;
+	jobs.dv = dv;
+	jobs.indexes = indexes;
+	jobs.hdrVertColors = hdrVertColors;
+	jobs.count = count;
+	jobs.numJobs = MIN( count, ri.Com_NumWorkers() * SURFACE_JOBS_PER_THREAD );
+	jobs.badTriangles = ri.Hunk_AllocateTempMemory( count * sizeof( *jobs.badTriangles ) );
+	Com_Memset( jobs.badTriangles, 0, count * sizeof( *jobs.badTriangles ) );
+
+	ri.Com_RunParallel( R_LoadSurfacesJob, &jobs, jobs.numJobs );
+
+	in = jobs.in;
+	out = s_worldData.surfaces;
+	for ( i = 0 ; i < count ; i++, in++, out++ ) {
+		bad = jobs.badTriangles[i];
+		if ( !bad ) {
+			continue;
+		}
+
+		if ( bad < 0 ) {
+			ri.Hunk_FreeTempMemory( jobs.badTriangles );
+			ri.Error( ERR_DROP, "Bad index in face surface" );
+		}
+
+		numIndexes = LittleLong( in->numIndexes );
+		ri.Printf( PRINT_WARNING, "%s has bad triangles, originally shader %s %d tris %d verts, now %d tris\n",
+			LittleLong( in->surfaceType ) == MST_PLANAR ? "Face" : "Trisurf", out->shader->name,
+			numIndexes / 3, ((srfBspSurface_t *)out->data)->numVerts, numIndexes / 3 - bad );
+	}
+
+	ri.Hunk_FreeTempMemory( jobs.badTriangles );
+
 	if (hdrVertColors)
 	{
 		ri.FS_FreeFile(hdrVertColors);
@@ -2159,6 +2333,29 @@ static	void R_LoadFogs( lump_t *l, lump_t *brushesLump, lump_t *sidesLump ) {
 }
 
 
+/*
+================
+R_LightGridDirection
+
+Decodes the lat/long direction of a light grid point
+================
+*/
+static void R_LightGridDirection( const byte *data, vec4_t dir ) {
+	int		lat, lng;
+
+	lat = data[7] * (FUNCTABLE_SIZE/256);
+	lng = data[6] * (FUNCTABLE_SIZE/256);
+
+	// decode X as cos( lat ) * sin( long )
+	// decode Y as sin( lat ) * sin( long )
+	// decode Z as cos( long )
+
+	dir[0] = tr.sinTable[(lat+(FUNCTABLE_SIZE/4))&FUNCTABLE_MASK] * tr.sinTable[lng];
+	dir[1] = tr.sinTable[lat] * tr.sinTable[lng];
+	dir[2] = tr.sinTable[(lng+(FUNCTABLE_SIZE/4))&FUNCTABLE_MASK];
+	dir[3] = 0;
+}
+
 /*
 ================
 R_LoadLightGrid
@@ -2265,6 +2462,36 @@ void R_LoadLightGrid( lump_t *l ) {
 		if (hdrLightGrid)
 			ri.FS_FreeFile(hdrLightGrid);
 	}
+
+	// decode it once instead of in every lookup, samples in walls
+	// are left zero
+	w->lightGridPoints = ri.Hunk_Alloc( numGridPoints * sizeof( *w->lightGridPoints ), h_low );
+	for ( i = 0 ; i < numGridPoints ; i++ ) {
+		const byte			*data = &w->lightGridData[i*8];
+		lightGridPoint_t	*point = &w->lightGridPoints[i];
+
+		if (w->lightGrid16)
+		{
+			const uint16_t *data16 = &w->lightGrid16[i*6];
+
+			if (!(data16[0]+data16[1]+data16[2]+data16[3]+data16[4]+data16[5]))
+				continue;
+
+			VectorSet( point->ambient, data16[0] / 257.0f, data16[1] / 257.0f, data16[2] / 257.0f );
+			VectorSet( point->directed, data16[3] / 257.0f, data16[4] / 257.0f, data16[5] / 257.0f );
+		}
+		else
+		{
+			if (!(data[0]+data[1]+data[2]+data[3]+data[4]+data[5]))
+				continue;
+
+			VectorSet( point->ambient, data[0], data[1], data[2] );
+			VectorSet( point->directed, data[3], data[4], data[5] );
+		}
+
+		point->ambient[3] = 1.0f;
+		R_LightGridDirection( data, point->dir );
+	}
 }
 
 /*
@@ -2621,7 +2848,42 @@ void R_AssignCubemapsToWorldSurfaces(void)
 }
 
 
-void R_LoadCubemaps(void)
+/*
+=================
+R_CubemapCacheName
+
+Names the rendered copy of a cubemap kept in cubemapcache/. The name
+hashes the bsp, where the cubemap is and the settings the render depends
+on, so a rebuilt map or changed cvars render again instead of loading a
+stale copy.
+=================
+*/
+static void R_CubemapCacheName(int cubemapIndex, unsigned int mapHash, char *cacheName, int cacheNameSize)
+{
+	cubemap_t *cubemap = &tr.cubemaps[cubemapIndex];
+	const char *settings;
+	unsigned int hash;
+
+	settings = va("%d %f %f %f %d %d %d %d %d %d %d %d %d %d %g %g", cubemapIndex,
+		cubemap->origin[0], cubemap->origin[1], cubemap->origin[2],
+		r_cubemapSize->integer, r_pbr->integer, r_hdr->integer, r_mapOverBrightBits->integer, tr.overbrightBits,
+		r_normalMapping->integer, r_specularMapping->integer, r_deluxeMapping->integer, r_sunlightMode->integer,
+		r_forceSun->integer, r_greyscale->value, r_intensity->value);
+	hash = R_HashBytes(mapHash, (const byte *)settings, strlen(settings));
+
+	Com_sprintf(cacheName, cacheNameSize, "cubemapcache/%s/%03d_%08x.dds", tr.world->baseName, cubemapIndex, hash);
+}
+
+
+/*
+=================
+R_LoadCubemaps
+
+Shipped cubemaps first, then the ones rendered for this map before,
+except on a pure server, as anyone can make the cache names
+=================
+*/
+void R_LoadCubemaps(unsigned int mapHash)
 {
 	int i;
 	imgFlags_t flags = IMGFLAG_CLAMPTOEDGE | IMGFLAG_MIPMAP | IMGFLAG_NOLIGHTSCALE | IMGFLAG_CUBEMAP;
@@ -2634,11 +2896,19 @@ void R_LoadCubemaps(void)
 		Com_sprintf(filename, MAX_QPATH, "cubemaps/%s/%03d.dds", tr.world->baseName, i);
 
 		cubemap->image = R_FindImageFile(filename, IMGTYPE_COLORALPHA, flags);
+
+		if (!cubemap->image && r_cubemapCache->integer && !ri.FS_PureServerActive())
+		{
+			R_CubemapCacheName(i, mapHash, filename, sizeof(filename));
+
+			// as if rendered, see R_RenderMissingCubemaps
+			cubemap->image = R_FindImageFile(filename, IMGTYPE_COLORALPHA, flags | IMGFLAG_NO_COMPRESSION);
+		}
 	}
 }
 
 
-void R_RenderMissingCubemaps(void)
+void R_RenderMissingCubemaps(unsigned int mapHash)
 {
 	int i, j;
 	imgFlags_t flags = IMGFLAG_NO_COMPRESSION | IMGFLAG_CLAMPTOEDGE | IMGFLAG_MIPMAP | IMGFLAG_NOLIGHTSCALE | IMGFLAG_CUBEMAP;
@@ -2656,6 +2926,15 @@ void R_RenderMissingCubemaps(void)
 				R_IssuePendingRenderCommands();
 				R_InitNextFrame();
 			}
+
+			if (r_cubemapCache->integer)
+			{
+				char filename[MAX_QPATH];
+
+				R_CubemapCacheName(i, mapHash, filename, sizeof(filename));
+				RB_SaveCubemap(&tr.cubemaps[i], filename);
+				ri.Printf(PRINT_DEVELOPER, "Saved cubemap %d as %s\n", i, filename);
+			}
 		}
 	}
 }
@@ -2709,6 +2988,7 @@ void RE_LoadWorldMap( const char *name ) {
 		void *v;
 	} buffer;
 	byte		*startMarker;
+	int			fileLen;
 
 	if ( tr.worldMapLoaded ) {
 		ri.Error( ERR_DROP, "ERROR: attempted to redundantly load world map" );
@@ -2736,11 +3016,12 @@ void RE_LoadWorldMap( const char *name ) {
 
 	// reset last cascade sun direction so last shadow cascade is rerendered
 	VectorClear(tr.lastCascadeSunDirection);
+	Com_Memset(tr.sunShadowCache, 0, sizeof(tr.sunShadowCache));
 
 	tr.worldMapLoaded = qtrue;
 
 	// load it
-    ri.FS_ReadFile( name, &buffer.v );
+	fileLen = ri.FS_ReadFile( name, &buffer.v );
 	if ( !buffer.b ) {
 		ri.Error (ERR_DROP, "RE_LoadWorldMap: %s not found", name);
 	}
@@ -2775,14 +3056,17 @@ void RE_LoadWorldMap( const char *name ) {
 	// load into heap
 	R_LoadEntities( &header->lumps[LUMP_ENTITIES] );
 	R_LoadShaders( &header->lumps[LUMP_SHADERS] );
+	R_PrefetchShaderImages( s_worldData.shaders, s_worldData.numShaders );
 	R_LoadLightmaps( &header->lumps[LUMP_LIGHTMAPS], &header->lumps[LUMP_SURFACES] );
 	R_LoadPlanes (&header->lumps[LUMP_PLANES]);
 	R_LoadFogs( &header->lumps[LUMP_FOGS], &header->lumps[LUMP_BRUSHES], &header->lumps[LUMP_BRUSHSIDES] );
 	R_LoadSurfaces( &header->lumps[LUMP_SURFACES], &header->lumps[LUMP_DRAWVERTS], &header->lumps[LUMP_DRAWINDEXES] );
+	R_FlushPrefetchedJPGs();	// the world shaders are registered now
 	R_LoadMarksurfaces (&header->lumps[LUMP_LEAFSURFACES]);
 	R_LoadNodesAndLeafs (&header->lumps[LUMP_NODES], &header->lumps[LUMP_LEAFS]);
 	R_LoadSubmodels (&header->lumps[LUMP_MODELS]);
 	R_LoadVisibility( &header->lumps[LUMP_VISIBILITY] );
+	R_LoadClusterLeafs();
 	R_LoadLightGrid( &header->lumps[LUMP_LIGHTGRID] );
 
 	// determine vertex light directions
@@ -3009,8 +3293,10 @@ void RE_LoadWorldMap( const char *name ) {
 	// Render or load all cubemaps
 	if (r_cubeMapping->integer && tr.numCubemaps && glRefConfig.framebufferObject)
 	{
-		R_LoadCubemaps();
-		R_RenderMissingCubemaps();
+		unsigned int mapHash = R_HashBytes(2166136261u, buffer.b, fileLen);
+
+		R_LoadCubemaps(mapHash);
+		R_RenderMissingCubemaps(mapHash);
 	}
 
     ri.FS_FreeFile( buffer.v );
@@ -46,6 +46,8 @@ void R_PerformanceCounters( void ) {
 		ri.Printf (PRINT_ALL, "(md3) %i sin %i sclip  %i sout %i bin %i bclip %i bout\n",
 			tr.pc.c_sphere_cull_md3_in, tr.pc.c_sphere_cull_md3_clip, tr.pc.c_sphere_cull_md3_out, 
 			tr.pc.c_box_cull_md3_in, tr.pc.c_box_cull_md3_clip, tr.pc.c_box_cull_md3_out );
+		ri.Printf (PRINT_ALL, "(occlusion) %i leafs %i entities culled\n",
+			tr.pc.c_occludedLeafs, tr.pc.c_occludedEntities );
 	} else if (r_speeds->integer == 3) {
 		ri.Printf (PRINT_ALL, "viewcluster: %i\n", tr.viewCluster );
 	} else if (r_speeds->integer == 4) {
@@ -71,6 +73,10 @@ void R_PerformanceCounters( void ) {
 		ri.Printf( PRINT_ALL, "GLSL binds: %i  draws: gen %i light %i fog %i dlight %i\n",
 			backEnd.pc.c_glslShaderBinds, backEnd.pc.c_genericDraws, backEnd.pc.c_lightallDraws, backEnd.pc.c_fogDraws, backEnd.pc.c_dlightDraws);
 	}
+	else if (r_speeds->integer == 8 )
+	{
+		R_ProfilePrint();
+	}
 
 	Com_Memset( &tr.pc, 0, sizeof( tr.pc ) );
 	Com_Memset( &backEnd.pc, 0, sizeof( backEnd.pc ) );
@@ -279,6 +285,41 @@ void RE_StretchPic ( float x, float y, float w, float h,
 	cmd->t2 = t2;
 }
 
+/*
+=============
+RE_StretchPics
+
+One command for the whole run, split only where it wouldn't fit the
+command buffer in one piece
+=============
+*/
+#define	MAX_STRETCH_PICS_CMD	256
+
+void RE_StretchPics( const stretchPic_t *pics, int numPics, qhandle_t hShader ) {
+	stretchPicsCommand_t	*cmd;
+	shader_t	*shader;
+	int			count;
+
+	if ( !tr.registered ) {
+		return;
+	}
+
+	shader = R_GetShaderByHandle( hShader );
+
+	for ( ; numPics > 0; numPics -= count, pics += count ) {
+		count = MIN( numPics, MAX_STRETCH_PICS_CMD );
+
+		cmd = R_GetCommandBuffer( sizeof( *cmd ) + count * sizeof( *pics ) );
+		if ( !cmd ) {
+			return;
+		}
+		cmd->commandId = RC_STRETCH_PICS;
+		cmd->shader = shader;
+		cmd->numPics = count;
+		Com_Memcpy( cmd + 1, pics, count * sizeof( *pics ) );
+	}
+}
+
 #define MODE_RED_CYAN	1
 #define MODE_RED_BLUE	2
 #define MODE_RED_GREEN	3
@@ -536,6 +577,9 @@ void RE_EndFrame( int *frontEndMsec, int *backEndMsec ) {
 	if ( !tr.registered ) {
 		return;
 	}
+
+	R_ProfileGraph();
+
 	cmd = R_GetCommandBufferReserved( sizeof( *cmd ), 0 );
 	if ( !cmd ) {
 		return;
@@ -544,6 +588,11 @@ void RE_EndFrame( int *frontEndMsec, int *backEndMsec ) {
 
 	R_IssueRenderCommands( qtrue );
 
+	// what the screenshot jobs have encoded so far
+	R_FinishScreenshots( qfalse );
+
+	R_ProfileEndFrame();
+
 	R_InitNextFrame();
 
 	if ( frontEndMsec ) {
@@ -561,8 +610,7 @@ void RE_EndFrame( int *frontEndMsec, int *backEndMsec ) {
 RE_TakeVideoFrame
 =============
 */
-void RE_TakeVideoFrame( int width, int height,
-		byte *captureBuffer, byte *encodeBuffer, qboolean motionJpeg )
+void RE_TakeVideoFrame( int width, int height, byte *captureBuffer )
 {
 	videoFrameCommand_t	*cmd;
 
@@ -580,6 +628,19 @@ void RE_TakeVideoFrame( int width, int height,
 	cmd->width = width;
 	cmd->height = height;
 	cmd->captureBuffer = captureBuffer;
-	cmd->encodeBuffer = encodeBuffer;
-	cmd->motionJpeg = motionJpeg;
+}
+
+/*
+=============
+RE_FinishVideoFrames
+=============
+*/
+void RE_FinishVideoFrames( byte *captureBuffer )
+{
+	if( !tr.registered ) {
+		return;
+	}
+
+	R_IssuePendingRenderCommands();
+	RB_FinishVideoFrames( captureBuffer );
 }
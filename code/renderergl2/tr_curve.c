@@ -425,6 +425,88 @@ void R_CreateSurfaceGridMesh(srfBspSurface_t *grid, int width, int height,
 	//
 }
 
+/*
+=================
+R_CreateGridLods
+
+Index lists for coarser versions of the grid over the same verts, so the
+cached vertex buffer keeps one copy of them and a grid further away only
+swaps in a shorter index list. Level n keeps the rows and columns that
+pass RB_SurfaceGrid's test at an error of GRID_LOD_ERROR( n ), so grids
+stitched together still drop the same points along their edges.
+=================
+*/
+void R_CreateGridLods( srfBspSurface_t *grid ) {
+	int			widthTable[MAX_GRID_SIZE], heightTable[MAX_GRID_SIZE];
+	int			lodWidth, lodHeight, lastWidth, lastHeight;
+	int			i, j, n, numIndexes;
+	float		error;
+	glIndex_t	*indexes;
+
+	grid->lodIndexes[0] = grid->indexes;
+	grid->lodNumIndexes[0] = grid->numIndexes;
+	lastWidth = grid->width;
+	lastHeight = grid->height;
+
+	for ( n = 1 ; n < GRID_LOD_LEVELS ; n++ ) {
+		error = GRID_LOD_ERROR( n );
+
+		widthTable[0] = 0;
+		lodWidth = 1;
+		for ( i = 1 ; i < grid->width-1 ; i++ ) {
+			if ( grid->widthLodError[i] <= error ) {
+				widthTable[lodWidth++] = i;
+			}
+		}
+		widthTable[lodWidth++] = grid->width-1;
+
+		heightTable[0] = 0;
+		lodHeight = 1;
+		for ( i = 1 ; i < grid->height-1 ; i++ ) {
+			if ( grid->heightLodError[i] <= error ) {
+				heightTable[lodHeight++] = i;
+			}
+		}
+		heightTable[lodHeight++] = grid->height-1;
+
+		// the levels nest, so nothing was dropped if the counts match
+		if ( lodWidth == lastWidth && lodHeight == lastHeight ) {
+			grid->lodIndexes[n] = grid->lodIndexes[n-1];
+			grid->lodNumIndexes[n] = grid->lodNumIndexes[n-1];
+			continue;
+		}
+
+		indexes = ri.Hunk_Alloc( ( lodWidth - 1 ) * ( lodHeight - 1 ) * 6 * sizeof( glIndex_t ), h_low );
+		numIndexes = 0;
+		for ( i = 0 ; i < lodHeight - 1 ; i++ ) {
+			for ( j = 0 ; j < lodWidth - 1 ; j++ ) {
+				int		v1, v2, v3, v4;
+
+				// the same triangles as MakeMeshIndexes
+				v1 = heightTable[i] * grid->width + widthTable[j+1];
+				v2 = heightTable[i] * grid->width + widthTable[j];
+				v3 = heightTable[i+1] * grid->width + widthTable[j];
+				v4 = heightTable[i+1] * grid->width + widthTable[j+1];
+
+				indexes[numIndexes++] = v2;
+				indexes[numIndexes++] = v3;
+				indexes[numIndexes++] = v1;
+
+				indexes[numIndexes++] = v1;
+				indexes[numIndexes++] = v3;
+				indexes[numIndexes++] = v4;
+			}
+		}
+
+		grid->lodIndexes[n] = indexes;
+		grid->lodNumIndexes[n] = numIndexes;
+		lastWidth = lodWidth;
+		lastHeight = lodHeight;
+	}
+
+	grid->numLods = GRID_LOD_LEVELS;
+}
+
 /*
 =================
 R_FreeSurfaceGridMesh
@@ -0,0 +1,274 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// tr_dynres.c -- scales the scene resolution to hold a GPU frame time, see r_dynamicResolution
+
+#include "tr_local.h"
+
+/*
+With r_dynamicResolution set to a GPU frame time in msec, the views of the
+world are rendered into the lower left of tr.renderFbo, their viewport
+scaled down in both directions, and RB_PostProcess stretches them back to
+their place on the screen in the tonemap, which sharpens what the bilinear
+filtering blurs. The 2D and the views without the world are drawn after
+that, or outside the scaled scenes, at the native resolution.
+
+The GPU time of a frame is taken with two GL_TIMESTAMP queries, at the
+first render command and before the swap, so time the GPU spends waiting
+for the CPU isn't counted. They are read back DYNRES_QUERY_FRAMES frames
+late without waiting, and a frame rendered before the last change of the
+scale doesn't move it again. The scale follows the square root of how far
+the time is from the target, as the pixels go with its square.
+
+Needs GL_ARB_timer_query, frame buffer objects and r_postProcess.
+*/
+
+#define	DYNRES_QUERY_FRAMES		4		// frames of timestamps in flight
+#define	DYNRES_HEADROOM			0.9f	// of the target the time is aimed at
+#define	DYNRES_SMOOTHING		0.3f	// weight of the newest frame in the average
+#define	DYNRES_MIN_CHANGE		0.03f	// smaller corrections are left alone
+#define	DYNRES_MAX_CHANGE		0.1f	// most the scale moves in one step
+#define	DYNRES_MIN_SCALE		0.25f
+
+typedef struct {
+	GLuint		queries[2];				// start, end
+	qboolean	pending;
+	int			scaleChange;			// dynres.scaleChanges when it was rendered
+} dynresQueries_t;
+
+static struct {
+	qboolean		timerQuery;
+	dynresQueries_t	queries[DYNRES_QUERY_FRAMES];
+	int				currentQueries;
+	qboolean		frameStarted;
+
+	float			scale;
+	int				scaleChanges;
+	float			gpuMsec;			// smoothed, 0 until measured at this scale
+} dynres;
+
+/*
+===============
+R_DynamicResolutionWanted
+===============
+*/
+static qboolean R_DynamicResolutionWanted( void ) {
+	return r_dynamicResolution->value > 0.0f && dynres.timerQuery &&
+		glRefConfig.framebufferObject && r_postProcess->integer && tr.renderFbo;
+}
+
+/*
+===============
+R_DynamicResolutionSetScale
+===============
+*/
+static void R_DynamicResolutionSetScale( float scale ) {
+	if ( scale == dynres.scale ) {
+		return;
+	}
+
+	dynres.scale = scale;
+	dynres.scaleChanges++;
+	dynres.gpuMsec = 0.0f;
+
+	ri.Cvar_SetValue( "r_dynamicResolutionScale", scale );
+}
+
+/*
+===============
+R_DynamicResolutionUpdate
+
+Moves the scale towards the target with the time of a frame
+===============
+*/
+static void R_DynamicResolutionUpdate( float msec ) {
+	float	minScale, maxScale, scale, change;
+
+	if ( dynres.gpuMsec == 0.0f ) {
+		dynres.gpuMsec = msec;
+	} else {
+		dynres.gpuMsec += ( msec - dynres.gpuMsec ) * DYNRES_SMOOTHING;
+	}
+
+	maxScale = Com_Clamp( DYNRES_MIN_SCALE, 1.0f, r_dynamicResolutionMax->value );
+	minScale = Com_Clamp( DYNRES_MIN_SCALE, maxScale, r_dynamicResolutionMin->value );
+
+	change = sqrt( r_dynamicResolution->value * DYNRES_HEADROOM / MAX( dynres.gpuMsec, 0.1f ) );
+	if ( fabs( change - 1.0f ) < DYNRES_MIN_CHANGE ) {
+		change = 1.0f;
+	}
+	change = Com_Clamp( 1.0f - DYNRES_MAX_CHANGE, 1.0f + DYNRES_MAX_CHANGE, change );
+
+	scale = Com_Clamp( minScale, maxScale, dynres.scale * change );
+
+	// the pixels of the viewport don't change for less
+	if ( fabs( scale - dynres.scale ) * glConfig.vidHeight >= 1.0f || scale == minScale || scale == maxScale ) {
+		R_DynamicResolutionSetScale( scale );
+	}
+}
+
+/*
+===============
+R_DynamicResolutionResolve
+
+Picks up the frames that came back, oldest first
+===============
+*/
+static void R_DynamicResolutionResolve( void ) {
+	dynresQueries_t	*q;
+	GLuint			available;
+	GLuint64		start, end;
+	int				i;
+
+	for ( i = 1 ; i <= DYNRES_QUERY_FRAMES ; i++ ) {
+		q = &dynres.queries[( dynres.currentQueries + i ) % DYNRES_QUERY_FRAMES];
+
+		if ( !q->pending ) {
+			continue;
+		}
+
+		qglGetQueryObjectuiv( q->queries[1], GL_QUERY_RESULT_AVAILABLE, &available );
+		if ( !available ) {
+			break;		// the later ones can't be done either
+		}
+
+		q->pending = qfalse;
+
+		// it shows the old scale
+		if ( q->scaleChange != dynres.scaleChanges ) {
+			continue;
+		}
+
+		qglGetQueryObjectui64v( q->queries[0], GL_QUERY_RESULT, &start );
+		qglGetQueryObjectui64v( q->queries[1], GL_QUERY_RESULT, &end );
+
+		if ( end > start ) {
+			R_DynamicResolutionUpdate( ( end - start ) / 1000000.0f );
+		}
+	}
+}
+
+/*
+===============
+RB_DynamicResolutionBeginFrame
+
+Called whenever render commands are executed, marks the first time in a frame
+===============
+*/
+void RB_DynamicResolutionBeginFrame( void ) {
+	dynresQueries_t	*q;
+
+	if ( dynres.frameStarted || !R_DynamicResolutionWanted() ) {
+		return;
+	}
+
+	// a frame whose results never arrived is dropped, its queries reused
+	q = &dynres.queries[dynres.currentQueries];
+	q->pending = qfalse;
+	q->scaleChange = dynres.scaleChanges;
+
+	qglQueryCounter( q->queries[0], GL_TIMESTAMP );
+	dynres.frameStarted = qtrue;
+}
+
+/*
+===============
+RB_DynamicResolutionEndFrame
+
+Called before the swap, the driver may wait there for the display
+===============
+*/
+void RB_DynamicResolutionEndFrame( void ) {
+	dynresQueries_t	*q;
+
+	if ( !R_DynamicResolutionWanted() ) {
+		dynres.frameStarted = qfalse;
+		R_DynamicResolutionSetScale( 1.0f );
+		return;
+	}
+
+	if ( dynres.frameStarted ) {
+		q = &dynres.queries[dynres.currentQueries];
+		qglQueryCounter( q->queries[1], GL_TIMESTAMP );
+		q->pending = qtrue;
+
+		dynres.currentQueries = ( dynres.currentQueries + 1 ) % DYNRES_QUERY_FRAMES;
+		dynres.frameStarted = qfalse;
+	}
+
+	R_DynamicResolutionResolve();
+}
+
+/*
+===============
+R_DynamicResolutionViewport
+
+Scales the viewport of a view of the world, RB_PostProcess scales it back
+===============
+*/
+void R_DynamicResolutionViewport( viewParms_t *parms ) {
+	if ( dynres.scale >= 1.0f || !R_DynamicResolutionWanted() ) {
+		return;
+	}
+
+	parms->viewportX = parms->viewportX * dynres.scale;
+	parms->viewportY = parms->viewportY * dynres.scale;
+	parms->viewportWidth = MAX( 1, (int)( parms->viewportWidth * dynres.scale ) );
+	parms->viewportHeight = MAX( 1, (int)( parms->viewportHeight * dynres.scale ) );
+}
+
+/*
+===============
+R_InitDynamicResolution
+===============
+*/
+void R_InitDynamicResolution( void ) {
+	int		i;
+
+	Com_Memset( &dynres, 0, sizeof( dynres ) );
+	dynres.timerQuery = glRefConfig.timerQuery;
+	dynres.scale = 1.0f;
+
+	ri.Cvar_SetValue( "r_dynamicResolutionScale", 1.0f );
+
+	if ( dynres.timerQuery ) {
+		for ( i = 0 ; i < DYNRES_QUERY_FRAMES ; i++ ) {
+			qglGenQueries( 2, dynres.queries[i].queries );
+		}
+	}
+}
+
+/*
+===============
+R_ShutdownDynamicResolution
+===============
+*/
+void R_ShutdownDynamicResolution( void ) {
+	int		i;
+
+	if ( dynres.timerQuery ) {
+		for ( i = 0 ; i < DYNRES_QUERY_FRAMES ; i++ ) {
+			qglDeleteQueries( 2, dynres.queries[i].queries );
+		}
+	}
+
+	Com_Memset( &dynres, 0, sizeof( dynres ) );
+}
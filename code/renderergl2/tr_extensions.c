@@ -104,6 +104,78 @@ void GLimp_InitExtraExtensions(void)
 		ri.Printf(PRINT_ALL, result[2], extension);
 	}
 
+	// OpenGL 4.1 - GL_ARB_get_program_binary
+	extension = "GL_ARB_get_program_binary";
+	glRefConfig.programBinary = qfalse;
+	if (QGL_VERSION_ATLEAST(4, 1) || SDL_GL_ExtensionSupported(extension))
+	{
+		GLint numFormats = 0;
+
+		// some drivers expose the extension without supporting a single format
+		qglGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		glRefConfig.programBinary = r_glslCache->integer && numFormats > 0;
+
+		QGL_ARB_get_program_binary_PROCS;
+
+		ri.Printf(PRINT_ALL, result[glRefConfig.programBinary], extension);
+	}
+	else
+	{
+		ri.Printf(PRINT_ALL, result[2], extension);
+	}
+
+	// OpenGL 4.4 - GL_ARB_buffer_storage, streaming also needs GL_ARB_map_buffer_range and GL_ARB_sync
+	extension = "GL_ARB_buffer_storage";
+	glRefConfig.bufferStorage = qfalse;
+	if ((QGL_VERSION_ATLEAST(4, 4) || SDL_GL_ExtensionSupported(extension))
+		&& (q_gl_version_at_least_3_0 || SDL_GL_ExtensionSupported("GL_ARB_map_buffer_range"))
+		&& (q_gl_version_at_least_3_2 || SDL_GL_ExtensionSupported("GL_ARB_sync")))
+	{
+		glRefConfig.bufferStorage = !!r_arb_buffer_storage->integer;
+
+		QGL_ARB_buffer_storage_PROCS;
+
+		ri.Printf(PRINT_ALL, result[glRefConfig.bufferStorage], extension);
+	}
+	else
+	{
+		ri.Printf(PRINT_ALL, result[2], extension);
+	}
+
+	// OpenGL 2.1 - GL_ARB_pixel_buffer_object, for video capture readback and cinematic uploads
+	extension = "GL_ARB_pixel_buffer_object";
+	glRefConfig.pixelBufferObject = qfalse;
+	if ((QGL_VERSION_ATLEAST(2, 1) || SDL_GL_ExtensionSupported(extension))
+		&& (q_gl_version_at_least_3_0 || SDL_GL_ExtensionSupported("GL_ARB_map_buffer_range")))
+	{
+		glRefConfig.pixelBufferObject = !!r_arb_pixel_buffer_object->integer;
+
+		GLE(void *, MapBufferRange, GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+		QGL_ARB_pixel_buffer_object_PROCS;
+
+		ri.Printf(PRINT_ALL, result[glRefConfig.pixelBufferObject], extension);
+	}
+	else
+	{
+		ri.Printf(PRINT_ALL, result[2], extension);
+	}
+
+	// OpenGL 3.3 - GL_ARB_timer_query, for r_profile
+	extension = "GL_ARB_timer_query";
+	glRefConfig.timerQuery = qfalse;
+	if ((QGL_VERSION_ATLEAST(3, 3) || SDL_GL_ExtensionSupported(extension)) && q_gl_version_at_least_3_2)
+	{
+		glRefConfig.timerQuery = qtrue;
+
+		QGL_ARB_timer_query_PROCS;
+
+		ri.Printf(PRINT_ALL, result[1], extension);
+	}
+	else
+	{
+		ri.Printf(PRINT_ALL, result[2], extension);
+	}
+
 	// OpenGL 3.0 - GL_ARB_texture_float
 	extension = "GL_ARB_texture_float";
 	glRefConfig.textureFloat = qfalse;
@@ -158,6 +230,24 @@ void GLimp_InitExtraExtensions(void)
 		ri.Printf(PRINT_ALL, "...using GLSL version %s\n", version);
 	}
 
+	// OpenGL 3.0 - GL_EXT_texture_array, sampled as sampler2DArray from GLSL 1.30 up
+	extension = "GL_EXT_texture_array";
+	glRefConfig.textureArray = qfalse;
+	if (q_gl_version_at_least_3_0 && (glRefConfig.glslMajorVersion > 1 || glRefConfig.glslMinorVersion >= 30))
+	{
+		glRefConfig.textureArray = qtrue;
+
+		qglGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS_EXT, &glRefConfig.maxArrayTextureLayers);
+
+		QGL_EXT_texture_array_PROCS;
+
+		ri.Printf(PRINT_ALL, result[1], extension);
+	}
+	else
+	{
+		ri.Printf(PRINT_ALL, result[2], extension);
+	}
+
 	glRefConfig.memInfo = MI_NONE;
 
 	// GL_NVX_gpu_memory_info
@@ -229,6 +319,15 @@ void GLimp_InitExtraExtensions(void)
 		ri.Printf(PRINT_ALL, result[2], extension);
 	}
 
+	// OpenGL 1.3 - reading back what the driver compressed, not in OpenGL ES
+	glRefConfig.imageCache = qfalse;
+	if (!qglesMajorVersion && r_ext_compressed_textures->integer)
+	{
+		QGL_DESKTOP_1_3_PROCS;
+
+		glRefConfig.imageCache = r_imageCache->integer && qglGetCompressedTexImage && qglGetTexLevelParameteriv;
+	}
+
 	// GL_EXT_direct_state_access
 	extension = "GL_EXT_direct_state_access";
 	glRefConfig.directStateAccess = qfalse;
@@ -347,6 +347,17 @@ void FBO_Init(void)
 		}
 	}
 
+	if (tr.sunShadowCacheImage[0])
+	{
+		for (i = 0; i < 4; i++)
+		{
+			tr.sunShadowCacheFbo[i] = FBO_Create(va("_sunshadowcache%d", i), tr.sunShadowCacheImage[i]->width, tr.sunShadowCacheImage[i]->height);
+			FBO_CreateBuffer(tr.sunShadowCacheFbo[i], GL_RGBA8, 0, 0);
+			FBO_AttachImage(tr.sunShadowCacheFbo[i], tr.sunShadowCacheImage[i], GL_DEPTH_ATTACHMENT, 0);
+			R_CheckFBO(tr.sunShadowCacheFbo[i]);
+		}
+	}
+
 	if (tr.screenShadowImage)
 	{
 		tr.screenShadowFbo = FBO_Create("_screenshadow", tr.screenShadowImage->width, tr.screenShadowImage->height);
@@ -371,11 +382,11 @@ void FBO_Init(void)
 		R_CheckFBO(tr.calcLevelsFbo);
 	}
 
-	if (tr.targetLevelsImage)
+	if (tr.levelsPyramidImage)
 	{
-		tr.targetLevelsFbo = FBO_Create("_targetlevels", tr.targetLevelsImage->width, tr.targetLevelsImage->height);
-		FBO_AttachImage(tr.targetLevelsFbo, tr.targetLevelsImage, GL_COLOR_ATTACHMENT0, 0);
-		R_CheckFBO(tr.targetLevelsFbo);
+		tr.levelsPyramidFbo = FBO_Create("_levelspyramid", tr.levelsPyramidImage->width, tr.levelsPyramidImage->height);
+		FBO_AttachImage(tr.levelsPyramidFbo, tr.levelsPyramidImage, GL_COLOR_ATTACHMENT0, 0);
+		R_CheckFBO(tr.levelsPyramidFbo);
 	}
 
 	if (tr.quarterImage[0])
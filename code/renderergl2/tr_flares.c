@@ -40,6 +40,10 @@ After all opaque surfaces have been rendered, the depth buffer is read back for
 each flare in view.  If the point has not been obscured by a closer surface, the
 flare should be drawn.
 
+With r_flareQueries the readback is replaced by an occlusion query drawing a
+tiny quad at the flare, whose result is only picked up once the GPU has it,
+normally a frame later, so the CPU never waits on the pipeline.
+
 Surfaces that have a repeated texture should never be flagged as flaring, because
 there will only be a single flare added at the midpoint of the polygon.
 
@@ -70,6 +74,7 @@ typedef struct flare_s {
 	int			fadeTime;
 
 	qboolean	visible;			// state of last test
+	qboolean	queryIssued;		// tr.flareQueries[] result not read yet
 	float		drawIntensity;		// may be non 0 even if !visible due to fading
 
 	int			windowX, windowY;
@@ -79,8 +84,6 @@ typedef struct flare_s {
 	vec3_t		color;
 } flare_t;
 
-#define		MAX_FLARES		128
-
 flare_t		r_flareStructs[MAX_FLARES];
 flare_t		*r_activeFlares, *r_inactiveFlares;
 
@@ -189,6 +192,7 @@ void RB_AddFlare( void *surface, int fogNum, vec3_t point, vec3_t color, vec3_t
 		f->frameSceneNum = backEnd.viewParms.frameSceneNum;
 		f->inPortal = backEnd.viewParms.isPortal;
 		f->addedFrame = -1;
+		f->queryIssued = qfalse;
 	}
 
 	if ( f->addedFrame != backEnd.viewParms.frameCount - 1 ) {
@@ -267,6 +271,16 @@ FLARE BACK END
 ===============================================================================
 */
 
+// how far in front of the z buffer a flare may be hidden and still be visible
+#define FLARE_DEPTH_TOLERANCE	24
+
+// half size in pixels of the quad drawn for a flare's occlusion query
+#define FLARE_QUERY_SIZE		2
+
+static qboolean RB_FlareQueries( void ) {
+	return r_flareQueries->integer && glRefConfig.occlusionQuery;
+}
+
 /*
 ==================
 RB_TestFlare
@@ -281,30 +295,48 @@ void RB_TestFlare( flare_t *f ) {
 
 	backEnd.pc.c_flareTests++;
 
-	// doing a readpixels is as good as doing a glFinish(), so
-	// don't bother with another sync
-	glState.finishCalled = qfalse;
+	if ( RB_FlareQueries() ) {
+		GLuint		query, available, samples;
 
-	// if we're doing multisample rendering, read from the correct FBO
-	oldFbo = glState.currentFBO;
-	if (tr.msaaResolveFbo)
-	{
-		FBO_Bind(tr.msaaResolveFbo);
-	}
+		// keep the last state until the query result has arrived
+		visible = f->visible;
 
-	// read back the z buffer contents
-	qglReadPixels( f->windowX, f->windowY, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth );
+		if ( f->queryIssued ) {
+			query = tr.flareQueries[f - r_flareStructs];
 
-	// if we're doing multisample rendering, switch to the old FBO
-	if (tr.msaaResolveFbo)
-	{
-		FBO_Bind(oldFbo);
-	}
+			qglGetQueryObjectuiv( query, GL_QUERY_RESULT_AVAILABLE, &available );
+			if ( available ) {
+				qglGetQueryObjectuiv( query, GL_QUERY_RESULT, &samples );
+				visible = samples != 0;
+				f->queryIssued = qfalse;
+			}
+		}
+	} else {
+		// doing a readpixels is as good as doing a glFinish(), so
+		// don't bother with another sync
+		glState.finishCalled = qfalse;
 
-	screenZ = backEnd.viewParms.projectionMatrix[14] / 
-		( ( 2*depth - 1 ) * backEnd.viewParms.projectionMatrix[11] - backEnd.viewParms.projectionMatrix[10] );
+		// if we're doing multisample rendering, read from the correct FBO
+		oldFbo = glState.currentFBO;
+		if (tr.msaaResolveFbo)
+		{
+			FBO_Bind(tr.msaaResolveFbo);
+		}
 
-	visible = ( -f->eyeZ - -screenZ ) < 24;
+		// read back the z buffer contents
+		qglReadPixels( f->windowX, f->windowY, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth );
+
+		// if we're doing multisample rendering, switch to the old FBO
+		if (tr.msaaResolveFbo)
+		{
+			FBO_Bind(oldFbo);
+		}
+
+		screenZ = backEnd.viewParms.projectionMatrix[14] / 
+			( ( 2*depth - 1 ) * backEnd.viewParms.projectionMatrix[11] - backEnd.viewParms.projectionMatrix[10] );
+
+		visible = ( -f->eyeZ - -screenZ ) < FLARE_DEPTH_TOLERANCE;
+	}
 
 	if ( visible ) {
 		if ( !f->visible ) {
@@ -331,6 +363,110 @@ void RB_TestFlare( flare_t *f ) {
 }
 
 
+/*
+==================
+RB_IssueFlareQueries
+
+Draws a small quad pulled towards the viewer by FLARE_DEPTH_TOLERANCE for
+every flare of this view without a query in flight, the result is read by
+RB_TestFlare in a later frame.
+==================
+*/
+static void RB_IssueFlareQueries( void ) {
+	flare_t		*f;
+	flare_t		*queried[MAX_FLARES];
+	int			numQueried, i;
+	vec3_t		dir, point;
+	vec4_t		eye, clip;
+	mat4_t		matrix;
+	float		dist, depth, sizeX, sizeY;
+
+	numQueried = 0;
+	for ( f = r_activeFlares ; f ; f = f->next ) {
+		if ( f->frameSceneNum == backEnd.viewParms.frameSceneNum
+			&& f->inPortal == backEnd.viewParms.isPortal
+			&& !f->queryIssued ) {
+			queried[numQueried++] = f;
+		}
+	}
+
+	if ( !numQueried ) {
+		return;
+	}
+
+	if ( tess.numIndexes ) {
+		RB_EndSurface();
+	}
+
+	tess.numVertexes = 0;
+	tess.numIndexes = 0;
+	tess.firstIndex = 0;
+
+	sizeX = 2.0f * FLARE_QUERY_SIZE / backEnd.viewParms.viewportWidth;
+	sizeY = 2.0f * FLARE_QUERY_SIZE / backEnd.viewParms.viewportHeight;
+
+	for ( i = 0 ; i < numQueried ; i++ ) {
+		f = queried[i];
+
+		// move the point along the view ray so its depth drops by the tolerance
+		dist = -f->eyeZ;
+		depth = MAX( dist - FLARE_DEPTH_TOLERANCE, backEnd.viewParms.zNear * 2 );
+		if ( depth > dist ) {
+			depth = dist;
+		}
+		VectorSubtract( f->origin, backEnd.viewParms.or.origin, dir );
+		VectorMA( backEnd.viewParms.or.origin, depth / dist, dir, point );
+
+		R_TransformModelToClip( point, backEnd.viewParms.world.modelMatrix,
+			backEnd.viewParms.projectionMatrix, eye, clip );
+		VectorScale( clip, 1.0f / clip[3], clip );
+
+		// already in normalized device coordinates
+		VectorSet4( tess.xyz[tess.numVertexes + 0], clip[0] - sizeX, clip[1] - sizeY, clip[2], 1.0f );
+		VectorSet4( tess.xyz[tess.numVertexes + 1], clip[0] - sizeX, clip[1] + sizeY, clip[2], 1.0f );
+		VectorSet4( tess.xyz[tess.numVertexes + 2], clip[0] + sizeX, clip[1] + sizeY, clip[2], 1.0f );
+		VectorSet4( tess.xyz[tess.numVertexes + 3], clip[0] + sizeX, clip[1] - sizeY, clip[2], 1.0f );
+
+		tess.indexes[tess.numIndexes++] = tess.numVertexes + 0;
+		tess.indexes[tess.numIndexes++] = tess.numVertexes + 1;
+		tess.indexes[tess.numIndexes++] = tess.numVertexes + 2;
+		tess.indexes[tess.numIndexes++] = tess.numVertexes + 0;
+		tess.indexes[tess.numIndexes++] = tess.numVertexes + 2;
+		tess.indexes[tess.numIndexes++] = tess.numVertexes + 3;
+
+		tess.numVertexes += 4;
+	}
+
+	RB_UpdateTessVao( ATTR_POSITION );
+
+	qglColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+	GL_State( 0 );
+	GL_Cull( CT_TWO_SIDED );
+	GL_BindToTMU( tr.whiteImage, TB_COLORMAP );
+
+	Mat4Identity( matrix );
+	GLSL_BindProgram( &tr.textureColorShader );
+	GLSL_SetUniformMat4( &tr.textureColorShader, UNIFORM_MODELVIEWPROJECTIONMATRIX, matrix );
+	GLSL_SetUniformVec4( &tr.textureColorShader, UNIFORM_COLOR, colorWhite );
+
+	for ( i = 0 ; i < numQueried ; i++ ) {
+		f = queried[i];
+
+		qglBeginQuery( GL_SAMPLES_PASSED, tr.flareQueries[f - r_flareStructs] );
+		R_DrawElements( 6, i * 6 );
+		qglEndQuery( GL_SAMPLES_PASSED );
+
+		f->queryIssued = qtrue;
+	}
+
+	tess.numVertexes = 0;
+	tess.numIndexes = 0;
+	tess.firstIndex = 0;
+
+	qglColorMask( !backEnd.colorMask[0], !backEnd.colorMask[1], !backEnd.colorMask[2], !backEnd.colorMask[3] );
+}
+
+
 /*
 ==================
 RB_RenderFlare
@@ -510,8 +646,9 @@ void RB_RenderFlares (void) {
 			RB_TestFlare( f );
 			if ( f->drawIntensity ) {
 				draw = qtrue;
-			} else {
+			} else if ( !RB_FlareQueries() ) {
 				// this flare has completely faded out, so remove it from the chain
+				// (with queries it stays, so it keeps being tested)
 				*prev = f->next;
 				f->next = r_inactiveFlares;
 				r_inactiveFlares = f;
@@ -522,6 +659,10 @@ void RB_RenderFlares (void) {
 		prev = &f->next;
 	}
 
+	if ( RB_FlareQueries() ) {
+		RB_IssueFlareQueries();
+	}
+
 	if ( !draw ) {
 		return;		// none visible
 	}
@@ -104,7 +104,9 @@ static uniformInfo_t uniformsInfo[] =
 	{ "u_BaseColor", GLSL_VEC4 },
 	{ "u_VertColor", GLSL_VEC4 },
 
-	{ "u_DlightInfo",    GLSL_VEC4 },
+	{ "u_DlightInfo",    GLSL_VEC4_DLIGHTS },
+	{ "u_DlightColor",   GLSL_VEC4_DLIGHTS },
+	{ "u_NumDlights",    GLSL_INT },
 	{ "u_LightForward",  GLSL_VEC3 },
 	{ "u_LightUp",       GLSL_VEC3 },
 	{ "u_LightRight",    GLSL_VEC3 },
@@ -252,6 +254,9 @@ static void GLSL_GetShaderHeader( GLenum shaderType, const GLchar *extra, char *
 		{
 			Q_strcat(dest, size, "#define attribute in\n");
 			Q_strcat(dest, size, "#define varying out\n");
+
+			// depth prepass and lit pass use different programs, but GL_EQUAL needs the same depth
+			Q_strcat(dest, size, "invariant gl_Position;\n");
 		}
 		else
 		{
@@ -268,6 +273,9 @@ static void GLSL_GetShaderHeader( GLenum shaderType, const GLchar *extra, char *
 	{
 		Q_strcat(dest, size, "#version 120\n");
 		Q_strcat(dest, size, "#define shadow2D(a,b) shadow2D(a,b).r \n");
+
+		if(shaderType == GL_VERTEX_SHADER)
+			Q_strcat(dest, size, "invariant gl_Position;\n");
 	}
 
 	// HACK: add some macros to avoid extra uniforms and save speed and code maintenance
@@ -572,11 +580,140 @@ static int GLSL_InitGPUShader2(shaderProgram_t * program, const char *name, int
 	if(attribs & ATTR_TANGENT2)
 		qglBindAttribLocation(program->program, ATTR_INDEX_TANGENT2, "attr_Tangent2");
 
+	// must be set before linking for GLSL_SaveProgramBinary
+	if (glRefConfig.programBinary)
+		qglProgramParameteri(program->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 	GLSL_LinkProgram(program->program);
 
 	return 1;
 }
 
+/*
+Linked programs are kept in glsl/ in the private cache of the engine with
+GL_ARB_get_program_binary, so later starts skip compiling and linking every
+permutation. The game modules can't write there, and ri.FS_ReadCacheFile
+only returns files this install wrote. A file is named after the program
+and a hash of its defines and attribs, and is only used while the full
+shader sources and the GL driver strings hash the same.
+*/
+#define GLSL_CACHE_IDENT	(('C'<<24)+('L'<<16)+('S'<<8)+'G')
+#define GLSL_CACHE_VERSION	1
+
+typedef struct glslCacheHeader_s
+{
+	int ident;
+	int version;
+	unsigned int sourceHash;
+	int vpLength;
+	int fpLength;
+	GLenum binaryFormat;
+	int binaryLength;
+} glslCacheHeader_t;
+
+static unsigned int GLSL_HashString(unsigned int hash, const char *s)
+{
+	// FNV-1a
+	for (; s && *s; s++)
+	{
+		hash ^= (byte)*s;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void GLSL_CacheFileName(const char *name, int attribs, const GLchar *extra, char *dest, int size)
+{
+	unsigned int hash = GLSL_HashString(2166136261u ^ attribs, extra);
+
+	Com_sprintf(dest, size, "glsl/%s_%08x.bin", name, hash);
+}
+
+static unsigned int GLSL_SourceHash(int attribs, const char *vpCode, const char *fpCode)
+{
+	unsigned int hash = 2166136261u ^ attribs;
+
+	hash = GLSL_HashString(hash, (const char *)qglGetString(GL_VENDOR));
+	hash = GLSL_HashString(hash, (const char *)qglGetString(GL_RENDERER));
+	hash = GLSL_HashString(hash, (const char *)qglGetString(GL_VERSION));
+	hash = GLSL_HashString(hash, vpCode);
+	hash = GLSL_HashString(hash, fpCode);
+
+	return hash;
+}
+
+static int GLSL_LoadProgramBinary(shaderProgram_t *program, const char *name, int attribs, const char *filename, const char *vpCode, const char *fpCode)
+{
+	glslCacheHeader_t *header;
+	void *buffer;
+	GLint linked;
+	int size;
+
+	size = ri.FS_ReadCacheFile(filename, &buffer);
+	if (!buffer)
+		return 0;
+
+	header = buffer;
+	if (size < sizeof(*header)
+		|| header->ident != GLSL_CACHE_IDENT || header->version != GLSL_CACHE_VERSION
+		|| header->sourceHash != GLSL_SourceHash(attribs, vpCode, fpCode)
+		|| header->vpLength != strlen(vpCode) || header->fpLength != (fpCode ? strlen(fpCode) : 0)
+		|| header->binaryLength != size - sizeof(*header))
+	{
+		ri.FS_FreeFile(buffer);
+		return 0;
+	}
+
+	Q_strncpyz(program->name, name, sizeof(program->name));
+
+	program->program = qglCreateProgram();
+	program->attribs = attribs;
+
+	qglProgramBinary(program->program, header->binaryFormat, header + 1, header->binaryLength);
+
+	ri.FS_FreeFile(buffer);
+
+	// a driver update can reject binaries it saved itself
+	qglGetProgramiv(program->program, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		ri.Printf(PRINT_DEVELOPER, "...stale program binary '%s'\n", filename);
+		qglDeleteProgram(program->program);
+		program->program = 0;
+		return 0;
+	}
+
+	ri.Printf(PRINT_DEVELOPER, "...loading program binary '%s'\n", filename);
+
+	return 1;
+}
+
+static void GLSL_SaveProgramBinary(shaderProgram_t *program, const char *filename, const char *vpCode, const char *fpCode)
+{
+	glslCacheHeader_t *header;
+	GLint length = 0;
+
+	qglGetProgramiv(program->program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	header = ri.Malloc(sizeof(*header) + length);
+
+	header->ident = GLSL_CACHE_IDENT;
+	header->version = GLSL_CACHE_VERSION;
+	header->sourceHash = GLSL_SourceHash(program->attribs, vpCode, fpCode);
+	header->vpLength = strlen(vpCode);
+	header->fpLength = fpCode ? strlen(fpCode) : 0;
+
+	qglGetProgramBinary(program->program, length, &header->binaryLength, &header->binaryFormat, header + 1);
+
+	if (header->binaryLength > 0)
+		ri.FS_WriteCacheFile(filename, header, sizeof(*header) + header->binaryLength);
+
+	ri.Free(header);
+}
+
 static int GLSL_InitGPUShader(shaderProgram_t * program, const char *name,
 	int attribs, qboolean fragmentShader, const GLchar *extra, qboolean addHeader,
 	const char *fallback_vp, const char *fallback_fp)
@@ -624,6 +761,23 @@ static int GLSL_InitGPUShader(shaderProgram_t * program, const char *name,
 		}
 	}
 
+	if (glRefConfig.programBinary)
+	{
+		char filename[MAX_QPATH];
+
+		GLSL_CacheFileName(name, attribs, extra, filename, sizeof(filename));
+
+		if (GLSL_LoadProgramBinary(program, name, attribs, filename, vpCode, fragmentShader ? fpCode : NULL))
+			return 1;
+
+		result = GLSL_InitGPUShader2(program, name, attribs, vpCode, fragmentShader ? fpCode : NULL);
+
+		if (result)
+			GLSL_SaveProgramBinary(program, filename, vpCode, fragmentShader ? fpCode : NULL);
+
+		return result;
+	}
+
 	result = GLSL_InitGPUShader2(program, name, attribs, vpCode, fragmentShader ? fpCode : NULL);
 
 	return result;
@@ -671,6 +825,9 @@ void GLSL_InitUniforms(shaderProgram_t *program)
 			case GLSL_MAT16_BONEMATRIX:
 				size += sizeof(vec_t) * 16 * glRefConfig.glslMaxAnimatedBones;
 				break;
+			case GLSL_VEC4_DLIGHTS:
+				size += sizeof(vec_t) * 4 * MAX_DLIGHTS_PER_PASS;
+				break;
 			default:
 				break;
 		}
@@ -886,6 +1043,38 @@ void GLSL_SetUniformMat4BoneMatrix(shaderProgram_t *program, int uniformNum, /*c
 	qglProgramUniformMatrix4fvEXT(program->program, uniforms[uniformNum], numMatricies, GL_FALSE, &matrix[0][0]);
 }
 
+void GLSL_SetUniformVec4Dlights(shaderProgram_t *program, int uniformNum, const vec4_t *v, int numDlights)
+{
+	GLint *uniforms = program->uniforms;
+	vec_t *compare = (float *)(program->uniformBuffer + program->uniformBufferOffsets[uniformNum]);
+
+	if (uniforms[uniformNum] == -1) {
+		return;
+	}
+
+	if (uniformsInfo[uniformNum].type != GLSL_VEC4_DLIGHTS)
+	{
+		ri.Printf( PRINT_WARNING, "GLSL_SetUniformVec4Dlights: wrong type for uniform %i in program %s\n", uniformNum, program->name);
+		return;
+	}
+
+	if (numDlights > MAX_DLIGHTS_PER_PASS)
+	{
+		ri.Printf( PRINT_WARNING, "GLSL_SetUniformVec4Dlights: too many dlights (%d/%d) for uniform %i in program %s\n",
+				numDlights, MAX_DLIGHTS_PER_PASS, uniformNum, program->name);
+		return;
+	}
+
+	if (!memcmp(v, compare, numDlights * sizeof(vec4_t)))
+	{
+		return;
+	}
+
+	Com_Memcpy(compare, v, numDlights * sizeof(vec4_t));
+
+	qglProgramUniform4fvEXT(program->program, uniforms[uniformNum], numDlights, &v[0][0]);
+}
+
 void GLSL_DeleteGPUShader(shaderProgram_t *program)
 {
 	if(program->program)
@@ -935,6 +1124,11 @@ void GLSL_InitGPUShaders(void)
 		if ((i & GENERICDEF_USE_BONE_ANIMATION) && !glRefConfig.glslMaxAnimatedBones)
 			continue;
 
+		// $lightmap stages of world surfaces only
+		if ((i & GENERICDEF_USE_LIGHTMAP_ARRAY) && (!tr.lightmapArray || !(i & GENERICDEF_USE_TCGEN_AND_TCMOD)
+			|| (i & (GENERICDEF_USE_VERTEX_ANIMATION | GENERICDEF_USE_BONE_ANIMATION))))
+			continue;
+
 		attribs = ATTR_POSITION | ATTR_TEXCOORD | ATTR_LIGHTCOORD | ATTR_NORMAL | ATTR_COLOR;
 		extradefines[0] = '\0';
 
@@ -964,6 +1158,9 @@ void GLSL_InitGPUShaders(void)
 		if (i & GENERICDEF_USE_RGBAGEN)
 			Q_strcat(extradefines, 1024, "#define USE_RGBAGEN\n");
 
+		if (i & GENERICDEF_USE_LIGHTMAP_ARRAY)
+			Q_strcat(extradefines, 1024, "#define USE_LIGHTMAP_ARRAY\n");
+
 		if (!GLSL_InitGPUShader(&tr.genericShader[i], "generic", attribs, qtrue, extradefines, qtrue, fallbackShader_generic_vp, fallbackShader_generic_fp))
 		{
 			ri.Error(ERR_FATAL, "Could not load generic shader!");
@@ -1037,6 +1234,8 @@ void GLSL_InitGPUShaders(void)
 		attribs = ATTR_POSITION | ATTR_NORMAL | ATTR_TEXCOORD;
 		extradefines[0] = '\0';
 
+		Q_strcat(extradefines, 1024, va("#define MAX_DLIGHTS_PER_PASS %d\n", MAX_DLIGHTS_PER_PASS));
+
 		if (i & DLIGHTDEF_USE_DEFORM_VERTEXES)
 		{
 			Q_strcat(extradefines, 1024, "#define USE_DEFORM_VERTEXES\n");
@@ -1096,6 +1295,8 @@ void GLSL_InitGPUShaders(void)
 			{
 				case LIGHTDEF_USE_LIGHTMAP:
 					Q_strcat(extradefines, 1024, "#define USE_LIGHTMAP\n");
+					if (tr.lightmapArray)
+						Q_strcat(extradefines, 1024, "#define USE_LIGHTMAP_ARRAY\n");
 					if (r_deluxeMapping->integer && !fastLight)
 						Q_strcat(extradefines, 1024, "#define USE_DELUXEMAP\n");
 					attribs |= ATTR_LIGHTCOORD | ATTR_LIGHTDIRECTION;
@@ -1561,5 +1762,12 @@ shaderProgram_t *GLSL_GetGenericShaderProgram(int stage)
 		shaderAttribs |= GENERICDEF_USE_TCGEN_AND_TCMOD;
 	}
 
+	if (pStage->bundle[0].image[0] && (pStage->bundle[0].image[0]->flags & IMGFLAG_ARRAY)
+		&& (shaderAttribs & GENERICDEF_USE_TCGEN_AND_TCMOD)
+		&& !(shaderAttribs & (GENERICDEF_USE_VERTEX_ANIMATION | GENERICDEF_USE_BONE_ANIMATION)))
+	{
+		shaderAttribs |= GENERICDEF_USE_LIGHTMAP_ARRAY;
+	}
+
 	return &tr.genericShader[shaderAttribs];
 }
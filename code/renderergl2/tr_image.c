@@ -1254,54 +1254,82 @@ lighting range
 */
 void R_LightScaleTexture (byte *in, int inwidth, int inheight, qboolean only_gamma )
 {
-	if ( only_gamma )
+	byte	table[256];
+	byte	*p;
+	int		i, c;
+
+	// fold intensity and gamma into one lookup
+	for ( i = 0; i < 256; i++ )
 	{
-		if ( !glConfig.deviceSupportsGamma )
-		{
-			int		i, c;
-			byte	*p;
+		c = only_gamma ? i : s_intensitytable[i];
+		table[i] = glConfig.deviceSupportsGamma ? c : s_gammatable[c];
+	}
 
-			p = in;
+	// hardware gamma with r_intensity 1 leaves the texels alone
+	for ( i = 0; i < 256 && table[i] == i; i++ )
+		;
+	if ( i == 256 )
+		return;
 
-			c = inwidth*inheight;
-			for (i=0 ; i<c ; i++, p+=4)
-			{
-				p[0] = s_gammatable[p[0]];
-				p[1] = s_gammatable[p[1]];
-				p[2] = s_gammatable[p[2]];
-			}
-		}
-	}
-	else
+	p = in;
+
+	c = inwidth*inheight;
+	for (i=0 ; i<c ; i++, p+=4)
 	{
-		int		i, c;
-		byte	*p;
+		p[0] = table[p[0]];
+		p[1] = table[p[1]];
+		p[2] = table[p[2]];
+	}
+}
 
-		p = in;
 
-		c = inwidth*inheight;
+#define SRGB_COARSE_SIZE 4096
 
-		if ( glConfig.deviceSupportsGamma )
-		{
-			for (i=0 ; i<c ; i++, p+=4)
-			{
-				p[0] = s_intensitytable[p[0]];
-				p[1] = s_intensitytable[p[1]];
-				p[2] = s_intensitytable[p[2]];
-			}
-		}
-		else
-		{
-			for (i=0 ; i<c ; i++, p+=4)
-			{
-				p[0] = s_gammatable[s_intensitytable[p[0]]];
-				p[1] = s_gammatable[s_intensitytable[p[1]]];
-				p[2] = s_gammatable[s_intensitytable[p[2]]];
-			}
-		}
+static float downmipSrgbLookup[256];
+static float downmipSrgbThreshold[256];
+static byte downmipSrgbCoarse[SRGB_COARSE_SIZE];
+
+static void R_InitSrgbLookup(void)
+{
+	int x, b;
+
+	for (x = 0; x < 256; x++)
+	{
+		downmipSrgbLookup[x] = powf(x / 255.0f, 2.2f) * 0.25f;
+
+		// a hair low, so four equal samples average back to themselves
+		downmipSrgbThreshold[x] = powf(x / 255.0f, 2.2f) * 0.99999f;
+	}
+
+	for (x = 0, b = 0; x < SRGB_COARSE_SIZE; x++)
+	{
+		while (b < 255 && downmipSrgbThreshold[b + 1] <= x / (float)(SRGB_COARSE_SIZE - 1))
+			b++;
+		downmipSrgbCoarse[x] = b;
 	}
 }
 
+/*
+================
+R_LinearToSrgb
+
+Inverse of downmipSrgbLookup without a powf per channel, the coarse
+table gets within a few steps of the last threshold not above total
+================
+*/
+static ID_INLINE byte R_LinearToSrgb(float total)
+{
+	int b;
+
+	if (total >= 1.0f)
+		return 255;
+
+	b = downmipSrgbCoarse[(int)(total * (SRGB_COARSE_SIZE - 1))];
+	while (b < 255 && downmipSrgbThreshold[b + 1] <= total)
+		b++;
+
+	return b;
+}
 
 /*
 ================
@@ -1316,13 +1344,11 @@ static void R_MipMapsRGB( byte *in, int inWidth, int inHeight)
 	int x, y, c, stride;
 	const byte *in2;
 	float total;
-	static float downmipSrgbLookup[256];
 	static int downmipSrgbLookupSet = 0;
 	byte *out = in;
 
 	if (!downmipSrgbLookupSet) {
-		for (x = 0; x < 256; x++)
-			downmipSrgbLookup[x] = powf(x / 255.0f, 2.2f) * 0.25f;
+		R_InitSrgbLookup();
 		downmipSrgbLookupSet = 1;
 	}
 
@@ -1334,7 +1360,7 @@ static void R_MipMapsRGB( byte *in, int inWidth, int inHeight)
 			for (c = 3; c; c--, in++) {
 				total  = (downmipSrgbLookup[*(in)] + downmipSrgbLookup[*(in + 4)]) * 2.0f;
 
-				*out++ = (byte)(powf(total, 1.0f / 2.2f) * 255.0f);
+				*out++ = R_LinearToSrgb(total);
 			}
 			*out++ = (*(in) + *(in + 4)) >> 1; in += 5;
 		}
@@ -1352,7 +1378,7 @@ static void R_MipMapsRGB( byte *in, int inWidth, int inHeight)
 				total = downmipSrgbLookup[*(in)]  + downmipSrgbLookup[*(in + 4)]
 				      + downmipSrgbLookup[*(in2)] + downmipSrgbLookup[*(in2 + 4)];
 
-				*out++ = (byte)(powf(total, 1.0f / 2.2f) * 255.0f);
+				*out++ = R_LinearToSrgb(total);
 			}
 
 			*out++ = (*(in) + *(in + 4) + *(in2) + *(in2 + 4)) >> 2; in += 5, in2 += 5;
@@ -2014,10 +2040,35 @@ Upload32
 
 ===============
 */
+static void RawImage_Greyscale(byte *scan, int c)
+{
+	int i;
+
+	if( r_greyscale->integer )
+	{
+		for ( i = 0; i < c; i++ )
+		{
+			byte luma = LUMA(scan[i*4], scan[i*4 + 1], scan[i*4 + 2]);
+			scan[i*4] = luma;
+			scan[i*4 + 1] = luma;
+			scan[i*4 + 2] = luma;
+		}
+	}
+	else if( r_greyscale->value )
+	{
+		for ( i = 0; i < c; i++ )
+		{
+			float luma = LUMA(scan[i*4], scan[i*4 + 1], scan[i*4 + 2]);
+			scan[i*4] = LERP(scan[i*4], luma, r_greyscale->value);
+			scan[i*4 + 1] = LERP(scan[i*4 + 1], luma, r_greyscale->value);
+			scan[i*4 + 2] = LERP(scan[i*4 + 2], luma, r_greyscale->value);
+		}
+	}
+}
+
 static void Upload32(byte *data, int x, int y, int width, int height, GLenum picFormat, int numMips, image_t *image, qboolean scaled)
 {
 	int			i, c;
-	byte		*scan;
 
 	imgType_t type = image->type;
 	imgFlags_t flags = image->flags;
@@ -2029,31 +2080,9 @@ static void Upload32(byte *data, int x, int y, int width, int height, GLenum pic
 	// These operations cannot be performed on non-rgba8 images.
 	if (rgba8 && !cubemap)
 	{
-		c = width*height;
-		scan = data;
-
 		if (type == IMGTYPE_COLORALPHA)
 		{
-			if( r_greyscale->integer )
-			{
-				for ( i = 0; i < c; i++ )
-				{
-					byte luma = LUMA(scan[i*4], scan[i*4 + 1], scan[i*4 + 2]);
-					scan[i*4] = luma;
-					scan[i*4 + 1] = luma;
-					scan[i*4 + 2] = luma;
-				}
-			}
-			else if( r_greyscale->value )
-			{
-				for ( i = 0; i < c; i++ )
-				{
-					float luma = LUMA(scan[i*4], scan[i*4 + 1], scan[i*4 + 2]);
-					scan[i*4] = LERP(scan[i*4], luma, r_greyscale->value);
-					scan[i*4 + 1] = LERP(scan[i*4 + 1], luma, r_greyscale->value);
-					scan[i*4 + 2] = LERP(scan[i*4 + 2], luma, r_greyscale->value);
-				}
-			}
+			RawImage_Greyscale(data, width * height);
 
 			// This corresponds to what the OpenGL1 renderer does.
 			if (!(flags & IMGFLAG_NOLIGHTSCALE) && (scaled || mipmap))
@@ -2251,10 +2280,83 @@ void R_UpdateSubImage( image_t *image, byte *pic, int x, int y, int width, int h
 	Upload32(pic, x, y, width, height, picFormat, 0, image, qfalse);
 }
 
+
+/*
+================
+R_CreateImageArray
+
+A GL_TEXTURE_2D_ARRAY of layers width by height, without mipmaps, filled
+with R_UpdateImageLayer. GL_BindToTMU binds it to the array target, so it
+can only be sampled through a sampler2DArray.
+================
+*/
+image_t *R_CreateImageArray( const char *name, int width, int height, int layers, imgType_t type, imgFlags_t flags, int internalFormat )
+{
+	image_t    *image;
+	long        hash;
+	int         glWrapClampMode;
+	GLenum      textureTarget = GL_TEXTURE_2D_ARRAY_EXT;
+
+	if (strlen(name) >= MAX_QPATH ) {
+		ri.Error (ERR_DROP, "R_CreateImageArray: \"%s\" is too long", name);
+	}
+
+	if ( tr.numImages == MAX_DRAWIMAGES ) {
+		ri.Error( ERR_DROP, "R_CreateImageArray: MAX_DRAWIMAGES hit");
+	}
+
+	image = tr.images[tr.numImages] = ri.Hunk_Alloc( sizeof( image_t ), h_low );
+	qglGenTextures(1, &image->texnum);
+	tr.numImages++;
+
+	image->type = type;
+	image->flags = (flags & ~IMGFLAG_MIPMAP) | IMGFLAG_ARRAY;
+
+	strcpy (image->imgName, name);
+
+	image->width = image->uploadWidth = width;
+	image->height = image->uploadHeight = height;
+	image->internalFormat = internalFormat;
+
+	if (flags & IMGFLAG_CLAMPTOEDGE)
+		glWrapClampMode = GL_CLAMP_TO_EDGE;
+	else
+		glWrapClampMode = GL_REPEAT;
+
+	qglTextureImage3DEXT(image->texnum, textureTarget, 0, internalFormat, width, height, layers, 0, PixelDataFormatFromInternalFormat(internalFormat), GL_UNSIGNED_BYTE, NULL);
+
+	qglTextureParameterfEXT(image->texnum, textureTarget, GL_TEXTURE_WRAP_S, glWrapClampMode);
+	qglTextureParameterfEXT(image->texnum, textureTarget, GL_TEXTURE_WRAP_T, glWrapClampMode);
+	qglTextureParameterfEXT(image->texnum, textureTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	qglTextureParameterfEXT(image->texnum, textureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	GL_CheckErrors();
+
+	hash = generateHashValue(name);
+	image->next = hashTable[hash];
+	hashTable[hash] = image;
+
+	return image;
+}
+
+
+void R_UpdateImageLayer( image_t *image, byte *pic, int layer, int x, int y, int width, int height, GLenum picFormat )
+{
+	GLenum dataType = picFormat == GL_RGBA16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+
+	if (picFormat == GL_RGBA8 && image->type == IMGTYPE_COLORALPHA)
+		RawImage_Greyscale(pic, width * height);
+
+	qglTextureSubImage3DEXT(image->texnum, GL_TEXTURE_2D_ARRAY_EXT, 0, x, y, layer, width, height, 1, GL_RGBA, dataType, pic);
+
+	GL_CheckErrors();
+}
+
 //===================================================================
 
 // Prototype for dds loader function which isn't common to both renderers
 void R_LoadDDS(const char *filename, byte **pic, int *width, int *height, GLenum *picFormat, int *numMips);
+void R_SaveCompressedDDS(const char *filename, byte *data, int size, int width, int height, int numMips, GLenum format);
 
 typedef struct
 {
@@ -2376,6 +2478,147 @@ void R_LoadImage( const char *name, byte **pic, int *width, int *height, GLenum
 }
 
 
+unsigned int R_HashBytes(unsigned int hash, const byte *data, int length)
+{
+	// FNV-1a
+	while (length-- > 0)
+	{
+		hash ^= *data++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+=================
+R_ImageCacheName
+
+Names the driver compressed copy of an image kept in imagecache/. The
+name hashes the source file and everything that changes the texels we
+upload, so edited images and changed cvars miss instead of going stale.
+Anyone can make the name, so a cache file would replace a pure image on
+a pure server, where nothing is cached. Returns qfalse for images which
+aren't cached.
+=================
+*/
+static qboolean R_ImageCacheName( const char *name, imgType_t type, imgFlags_t flags, char *cacheName, int cacheNameSize )
+{
+	imgFlags_t normalFlags = IMGFLAG_PICMIP | IMGFLAG_MIPMAP | IMGFLAG_GENNORMALMAP;
+	char localName[ MAX_QPATH ];
+	const char *ext, *settings;
+	void *buffer = NULL;
+	unsigned int hash;
+	int i, len = 0;
+
+	if (!glRefConfig.imageCache || (flags & (IMGFLAG_CUBEMAP | IMGFLAG_NO_COMPRESSION)) || ri.FS_PureServerActive())
+		return qfalse;
+
+	// generating a normal map needs the decoded texels
+	if (r_normalMapping->integer && type == IMGTYPE_COLORALPHA && (flags & normalFlags) == normalFlags)
+		return qfalse;
+
+	// R_LoadImage prefers a shipped dds
+	COM_StripExtension(name, localName, MAX_QPATH);
+	Q_strcat(localName, MAX_QPATH, ".dds");
+	if (ri.FS_ReadFile(localName, NULL) > 0)
+		return qfalse;
+
+	// find the file R_LoadImage will load
+	Q_strncpyz(localName, name, MAX_QPATH);
+	ext = COM_GetExtension(localName);
+	if (*ext)
+	{
+		for (i = 0; i < numImageLoaders; i++)
+		{
+			if (!Q_stricmp(ext, imageLoaders[i].ext))
+			{
+				len = ri.FS_ReadFile(localName, &buffer);
+				COM_StripExtension(name, localName, MAX_QPATH);
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < numImageLoaders && !buffer; i++)
+		len = ri.FS_ReadFile(va("%s.%s", localName, imageLoaders[i].ext), &buffer);
+
+	if (!buffer)
+		return qfalse;
+
+	hash = R_HashBytes(2166136261u, buffer, len);
+	ri.FS_FreeFile(buffer);
+
+	settings = va("%s %d %d %d %d %d %d %d %g %g %g %d %d %d %d %d %d %d", name, type, flags,
+		r_picmip->integer, r_roundImagesDown->integer, r_imageUpsample->integer, r_imageUpsampleMaxSize->integer,
+		glConfig.maxTextureSize, r_greyscale->value, r_gamma->value, r_intensity->value, tr.overbrightBits,
+		r_ext_compressed_textures->integer, r_parallaxMapping->integer, glRefConfig.swizzleNormalmap,
+		r_colorMipLevels->integer, glRefConfig.textureCompression, glConfig.textureCompression);
+	hash = R_HashBytes(hash, (const byte *)settings, strlen(settings));
+
+	COM_StripExtension(name, localName, MAX_QPATH);
+	Com_sprintf(cacheName, cacheNameSize, "imagecache/%s_%08x.dds", localName, hash);
+
+	return qtrue;
+}
+
+/*
+=================
+R_SaveImageCache
+
+Reads back what the driver compressed an RGBA8 upload to
+=================
+*/
+static void R_SaveImageCache( image_t *image, const char *cacheName )
+{
+	GLint compressed = 0, internalFormat = 0, size = 0;
+	int numMips, miplevel, total, width, height;
+	byte *data;
+
+	GL_BindToTMU(image, TB_COLORMAP);
+
+	qglGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+	if (!compressed)
+		return;
+
+	qglGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+
+	numMips = 1;
+	if (image->flags & IMGFLAG_MIPMAP)
+	{
+		for (width = image->uploadWidth, height = image->uploadHeight; width > 1 || height > 1; numMips++)
+		{
+			width = MAX(1, width >> 1);
+			height = MAX(1, height >> 1);
+		}
+	}
+
+	total = 0;
+	for (miplevel = 0; miplevel < numMips; miplevel++)
+	{
+		qglGetTexLevelParameteriv(GL_TEXTURE_2D, miplevel, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+		if (size <= 0)
+			return;
+
+		total += size;
+	}
+
+	data = ri.Hunk_AllocateTempMemory(total);
+
+	total = 0;
+	for (miplevel = 0; miplevel < numMips; miplevel++)
+	{
+		qglGetTexLevelParameteriv(GL_TEXTURE_2D, miplevel, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+		qglGetCompressedTexImage(GL_TEXTURE_2D, miplevel, data + total);
+		total += size;
+	}
+
+	R_SaveCompressedDDS(cacheName, data, total, image->uploadWidth, image->uploadHeight, numMips, internalFormat);
+
+	ri.Hunk_FreeTempMemory(data);
+}
+
+
 /*
 ===============
 R_FindImageFile
@@ -2393,6 +2636,9 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, imgFlags_t flags )
 	int picNumMips;
 	long	hash;
 	imgFlags_t checkFlagsTrue, checkFlagsFalse;
+	char	cacheName[MAX_OSPATH];
+	qboolean cacheable, cached = qfalse;
+	int		picmipDone = 0;
 
 	if (!name) {
 		return NULL;
@@ -2418,7 +2664,23 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, imgFlags_t flags )
 	//
 	// load the pic from disk
 	//
-	R_LoadImage( name, &pic, &width, &height, &picFormat, &picNumMips );
+	pic = NULL;
+	cacheable = R_ImageCacheName( name, type, flags, cacheName, sizeof( cacheName ) );
+	if ( cacheable ) {
+		R_LoadDDS( cacheName, &pic, &width, &height, &picFormat, &picNumMips );
+		cached = pic != NULL;
+	}
+	if ( !cached ) {
+		// a JPEG can be decoded picmipped already, unless the upload
+		// upsamples or a normal map gets made from it
+		if ( ( flags & IMGFLAG_PICMIP ) && ( flags & IMGFLAG_MIPMAP ) && !r_imageUpsample->integer &&
+			!( r_normalMapping->integer && ( flags & IMGFLAG_GENNORMALMAP ) ) ) {
+			R_SetJPGPicmip( r_picmip->integer );
+		}
+		R_LoadImage( name, &pic, &width, &height, &picFormat, &picNumMips );
+		picmipDone = R_JPGPicmipDone();
+		R_SetJPGPicmip( 0 );
+	}
 	if ( pic == NULL ) {
 		return NULL;
 	}
@@ -2543,7 +2805,19 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, imgFlags_t flags )
 			flags &= ~IMGFLAG_MIPMAP;
 	}
 
-	image = R_CreateImage2( ( char * ) name, pic, width, height, picFormat, picNumMips, type, flags, 0 );
+	if ( cached || picmipDone ) {
+		// the cached texels are picmipped already
+		image = R_CreateImage2( ( char * ) name, pic, width, height, picFormat, picNumMips, type, flags & ~IMGFLAG_PICMIP, 0 );
+		image->flags = flags;
+		if ( !cached && cacheable && picFormat == GL_RGBA8 ) {
+			R_SaveImageCache( image, cacheName );
+		}
+	} else {
+		image = R_CreateImage2( ( char * ) name, pic, width, height, picFormat, picNumMips, type, flags, 0 );
+		if ( cacheable && picFormat == GL_RGBA8 ) {
+			R_SaveImageCache( image, cacheName );
+		}
+	}
 	ri.Free( pic );
 	return image;
 }
@@ -2784,10 +3058,22 @@ void R_CreateBuiltinImages( void ) {
 			p = data;
 
 			tr.calcLevelsImage =   R_CreateImage("*calcLevels",    p, 1, 1, IMGTYPE_COLORALPHA, IMGFLAG_NO_COMPRESSION | IMGFLAG_CLAMPTOEDGE, hdrFormat);
-			tr.targetLevelsImage = R_CreateImage("*targetLevels",  p, 1, 1, IMGTYPE_COLORALPHA, IMGFLAG_NO_COMPRESSION | IMGFLAG_CLAMPTOEDGE, hdrFormat);
 			tr.fixedLevelsImage =  R_CreateImage("*fixedLevels",   p, 1, 1, IMGTYPE_COLORALPHA, IMGFLAG_NO_COMPRESSION | IMGFLAG_CLAMPTOEDGE, hdrFormat);
 		}
 
+		// log luminance, reduced to 1x1 by generating mipmaps
+		// not IMGFLAG_MIPMAP, so r_textureMode can't turn off the mip filter
+		{
+			int size, level;
+
+			tr.levelsPyramidImage = R_CreateImage("*levelsPyramid", NULL, 256, 256, IMGTYPE_COLORALPHA, IMGFLAG_NO_COMPRESSION | IMGFLAG_CLAMPTOEDGE, GL_RGBA8);
+
+			for (size = 128, level = 1; size > 0; size >>= 1, level++)
+				qglTextureImage2DEXT(tr.levelsPyramidImage->texnum, GL_TEXTURE_2D, level, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+			qglTextureParameterfEXT(tr.levelsPyramidImage->texnum, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		}
+
 		for (x = 0; x < 2; x++)
 		{
 			tr.textureScratchImage[x] = R_CreateImage(va("*textureScratch%d", x), NULL, 256, 256, IMGTYPE_COLORALPHA, IMGFLAG_NO_COMPRESSION | IMGFLAG_CLAMPTOEDGE, GL_RGBA8);
@@ -2816,6 +3102,10 @@ void R_CreateBuiltinImages( void ) {
 				tr.sunShadowDepthImage[x] = R_CreateImage(va("*sunshadowdepth%i", x), NULL, r_shadowMapSize->integer, r_shadowMapSize->integer, IMGTYPE_COLORALPHA, IMGFLAG_NO_COMPRESSION | IMGFLAG_CLAMPTOEDGE, GL_DEPTH_COMPONENT24);
 				qglTextureParameterfEXT(tr.sunShadowDepthImage[x]->texnum, GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
 				qglTextureParameterfEXT(tr.sunShadowDepthImage[x]->texnum, GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+				// static world depth, needs a depth blit to copy it back
+				if (r_shadowCascadeCache->integer && glRefConfig.framebufferBlit)
+					tr.sunShadowCacheImage[x] = R_CreateImage(va("*sunshadowcache%i", x), NULL, r_shadowMapSize->integer, r_shadowMapSize->integer, IMGTYPE_COLORALPHA, IMGFLAG_NO_COMPRESSION | IMGFLAG_CLAMPTOEDGE, GL_DEPTH_COMPONENT24);
 			}
 
 			tr.screenShadowImage = R_CreateImage("*screenShadow", NULL, width, height, IMGTYPE_COLORALPHA, IMGFLAG_NO_COMPRESSION | IMGFLAG_CLAMPTOEDGE, GL_RGBA8);
@@ -496,3 +496,82 @@ void R_SaveDDS(const char *filename, byte *pic, int width, int height, int depth
 
 	ri.Free(data);
 }
+
+void R_SaveCompressedDDS(const char *filename, byte *pic, int picSize, int width, int height, int numMips, GLenum format)
+{
+	byte *data;
+	ddsHeader_t *ddsHeader;
+	ddsHeaderDxt10_t *ddsHeaderDxt10;
+	ui32_t dxgiFormat;
+	int size;
+
+	switch (format)
+	{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+			dxgiFormat = DXGI_FORMAT_BC1_UNORM;
+			break;
+
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+			dxgiFormat = DXGI_FORMAT_BC2_UNORM;
+			break;
+
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+			dxgiFormat = DXGI_FORMAT_BC3_UNORM;
+			break;
+
+		case GL_COMPRESSED_RED_RGTC1:
+			dxgiFormat = DXGI_FORMAT_BC4_UNORM;
+			break;
+
+		case GL_COMPRESSED_RG_RGTC2:
+			dxgiFormat = DXGI_FORMAT_BC5_UNORM;
+			break;
+
+		case GL_COMPRESSED_RGBA_BPTC_UNORM_ARB:
+			dxgiFormat = DXGI_FORMAT_BC7_UNORM;
+			break;
+
+		default:
+			// R_LoadDDS can't read it back
+			return;
+	}
+
+	size = 4 + sizeof(*ddsHeader) + sizeof(*ddsHeaderDxt10) + picSize;
+	data = ri.Malloc(size);
+
+	data[0] = 'D';
+	data[1] = 'D';
+	data[2] = 'S';
+	data[3] = ' ';
+
+	ddsHeader = (ddsHeader_t *)(data + 4);
+	memset(ddsHeader, 0, sizeof(ddsHeader_t));
+
+	ddsHeader->headerSize = 0x7c;
+	ddsHeader->flags = _DDSFLAGS_REQUIRED | _DDSFLAGS_MIPMAPCOUNT;
+	ddsHeader->height = height;
+	ddsHeader->width = width;
+	ddsHeader->numMips = numMips;
+	ddsHeader->always_0x00000020 = 0x00000020;
+	ddsHeader->caps = DDSCAPS_COMPLEX | DDSCAPS_REQUIRED;
+
+	if (numMips > 1)
+		ddsHeader->caps |= DDSCAPS_MIPMAP;
+
+	ddsHeader->pixelFormatFlags = DDSPF_FOURCC;
+	ddsHeader->fourCC = EncodeFourCC("DX10");
+
+	ddsHeaderDxt10 = (ddsHeaderDxt10_t *)(data + 4 + sizeof(*ddsHeader));
+	memset(ddsHeaderDxt10, 0, sizeof(ddsHeaderDxt10_t));
+
+	ddsHeaderDxt10->dxgiFormat = dxgiFormat;
+	ddsHeaderDxt10->dimensions = 3; // texture 2d
+	ddsHeaderDxt10->arraySize = 1;
+
+	Com_Memcpy(data + 4 + sizeof(*ddsHeader) + sizeof(*ddsHeaderDxt10), pic, picSize);
+
+	ri.FS_WriteFile(filename, data, size);
+
+	ri.Free(data);
+}
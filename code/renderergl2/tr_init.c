@@ -44,6 +44,7 @@ cvar_t  *com_altivec;
 cvar_t	*r_flareSize;
 cvar_t	*r_flareFade;
 cvar_t	*r_flareCoeff;
+cvar_t	*r_flareQueries;
 
 cvar_t	*r_railWidth;
 cvar_t	*r_railCoreWidth;
@@ -83,9 +84,14 @@ cvar_t	*r_norefresh;
 cvar_t	*r_drawentities;
 cvar_t	*r_drawworld;
 cvar_t	*r_speeds;
+cvar_t	*r_profile;
+cvar_t	*r_dynamicResolution;
+cvar_t	*r_dynamicResolutionMin;
+cvar_t	*r_dynamicResolutionMax;
 cvar_t	*r_fullbright;
 cvar_t	*r_novis;
 cvar_t	*r_nocull;
+cvar_t	*r_occlusionCull;
 cvar_t	*r_facePlaneCull;
 cvar_t	*r_showcluster;
 cvar_t	*r_nocurves;
@@ -104,11 +110,15 @@ cvar_t  *r_ext_texture_float;
 cvar_t  *r_ext_framebuffer_multisample;
 cvar_t  *r_arb_seamless_cube_map;
 cvar_t  *r_arb_vertex_array_object;
+cvar_t  *r_arb_buffer_storage;
+cvar_t  *r_arb_pixel_buffer_object;
 cvar_t  *r_ext_direct_state_access;
 
 cvar_t  *r_cameraExposure;
 
 cvar_t  *r_externalGLSL;
+cvar_t  *r_glslCache;
+cvar_t  *r_imageCache;
 
 cvar_t  *r_hdr;
 cvar_t  *r_floatLightmap;
@@ -135,6 +145,7 @@ cvar_t  *r_parallaxMapping;
 cvar_t  *r_parallaxMapShadows;
 cvar_t  *r_cubeMapping;
 cvar_t  *r_cubemapSize;
+cvar_t  *r_cubemapCache;
 cvar_t  *r_deluxeSpecular;
 cvar_t  *r_pbr;
 cvar_t  *r_baseNormalX;
@@ -144,6 +155,7 @@ cvar_t  *r_baseSpecular;
 cvar_t  *r_baseGloss;
 cvar_t  *r_glossType;
 cvar_t  *r_mergeLightmaps;
+cvar_t  *r_lightmapArray;
 cvar_t  *r_dlightMode;
 cvar_t  *r_pshadowDist;
 cvar_t  *r_imageUpsample;
@@ -162,6 +174,8 @@ cvar_t  *r_shadowMapSize;
 cvar_t  *r_shadowCascadeZNear;
 cvar_t  *r_shadowCascadeZFar;
 cvar_t  *r_shadowCascadeZBias;
+cvar_t  *r_shadowCascadeCache;
+cvar_t  *r_shadowCascadeCacheTexels;
 cvar_t  *r_ignoreDstAlpha;
 
 cvar_t	*r_ignoreGLErrors;
@@ -198,6 +212,7 @@ cvar_t	*r_gamma;
 cvar_t	*r_intensity;
 cvar_t	*r_lockpvs;
 cvar_t	*r_noportals;
+cvar_t	*r_simd;
 cvar_t	*r_portalOnly;
 
 cvar_t	*r_subdivisions;
@@ -215,6 +230,7 @@ cvar_t	*r_mapOverBrightBits;
 
 cvar_t	*r_debugSurface;
 cvar_t	*r_simpleMipMaps;
+cvar_t	*r_prefetchImages;
 
 cvar_t	*r_showImages;
 
@@ -224,6 +240,7 @@ cvar_t	*r_debugLight;
 cvar_t	*r_debugSort;
 cvar_t	*r_printShaders;
 cvar_t	*r_saveFontData;
+cvar_t	*r_modelCache;
 
 cvar_t	*r_marksOnTriangleMeshes;
 
@@ -477,88 +494,135 @@ byte *RB_ReadPixels(int x, int y, int width, int height, size_t *offset, int *pa
 	return buffer;
 }
 
-/* 
-================== 
-RB_TakeScreenshot
-================== 
-*/  
-void RB_TakeScreenshot(int x, int y, int width, int height, char *fileName)
+/*
+==================
+RB_MapScreenshotReadback
+
+Copies a screenshot out of its pixel buffer for R_QueueScreenshot
+==================
+*/
+static void RB_MapScreenshotReadback( screenshotReadback_t *read )
 {
-	byte *allbuf, *buffer;
-	byte *srcptr, *destptr;
-	byte *endline, *endmem;
-	byte temp;
-	
-	int linelen, padlen;
-	size_t offset = 18, memcount;
-		
-	allbuf = RB_ReadPixels(x, y, width, height, &offset, &padlen);
-	buffer = allbuf + offset - 18;
-	
-	Com_Memset (buffer, 0, 18);
-	buffer[2] = 2;		// uncompressed type
-	buffer[12] = width & 255;
-	buffer[13] = width >> 8;
-	buffer[14] = height & 255;
-	buffer[15] = height >> 8;
-	buffer[16] = 24;	// pixel size
+	byte	*pixels;
+	void	*mapped;
 
-	// swap rgb to bgr and remove padding from line endings
-	linelen = width * 3;
-	
-	srcptr = destptr = allbuf + offset;
-	endmem = srcptr + (linelen + padlen) * height;
-	
-	while(srcptr < endmem)
+	pixels = malloc(read->size);
+
+	qglBindBuffer(GL_PIXEL_PACK_BUFFER, read->buffer);
+	mapped = pixels ? qglMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, read->size, GL_MAP_READ_BIT) : NULL;
+	if(mapped)
 	{
-		endline = srcptr + linelen;
+		Com_Memcpy(pixels, mapped, read->size);
+		qglUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	qglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-		while(srcptr < endline)
-		{
-			temp = srcptr[0];
-			*destptr++ = srcptr[2];
-			*destptr++ = srcptr[1];
-			*destptr++ = temp;
-			
-			srcptr += 3;
-		}
-		
-		// Skip the pad
-		srcptr += padlen;
+	read->reading = qfalse;
+
+	if(!mapped)
+	{
+		ri.Printf(PRINT_WARNING, "Couldn't read back screenshot %s\n", read->fileName);
+		free(pixels);
+		return;
 	}
 
-	memcount = linelen * height;
+	R_QueueScreenshot(read->fileName, read->jpeg, read->quality, read->gamma,
+		pixels, read->width, read->height, read->padlen);
+}
 
-	// gamma correct
-	if(glConfig.deviceSupportsGamma)
-		R_GammaCorrect(allbuf + offset, memcount);
+/*
+==================
+RB_FinishScreenshotReadbacks
 
-	ri.FS_WriteFile(fileName, buffer, memcount + 18);
+Hands the screenshots read in an earlier frame, or all of them, over to
+R_QueueScreenshot
+==================
+*/
+void RB_FinishScreenshotReadbacks( qboolean all )
+{
+	screenshotReadback_t	*read;
+	int						i;
 
-	ri.Hunk_FreeTempMemory(allbuf);
+	for(i = 0, read = tr.screenshotReadbacks; i < SCREENSHOT_READBACK_BUFFERS; i++, read++)
+	{
+		if(read->reading && (all || read->frame != tr.frameCount))
+			RB_MapScreenshotReadback(read);
+	}
 }
 
 /* 
 ================== 
-RB_TakeScreenshotJPEG
-================== 
-*/
+RB_TakeScreenshot
 
-void RB_TakeScreenshotJPEG(int x, int y, int width, int height, char *fileName)
+Reads the pixels for R_QueueScreenshot, which encodes and writes them
+================== 
+*/  
+void RB_TakeScreenshot(int x, int y, int width, int height, char *fileName, qboolean jpeg)
 {
-	byte *buffer;
-	size_t offset = 0, memcount;
-	int padlen;
+	screenshotReadback_t *read;
+	byte *pixels;
+	int linelen, padwidth, i;
+	GLint packAlign;
 
-	buffer = RB_ReadPixels(x, y, width, height, &offset, &padlen);
-	memcount = (width * 3 + padlen) * height;
+	qglGetIntegerv(GL_PACK_ALIGNMENT, &packAlign);
 
-	// gamma correct
-	if(glConfig.deviceSupportsGamma)
-		R_GammaCorrect(buffer + offset, memcount);
+	linelen = width * 3;
+	padwidth = PAD(linelen, packAlign);
 
-	RE_SaveJPG(fileName, r_screenshotJpegQuality->integer, width, height, buffer + offset, padlen);
-	ri.Hunk_FreeTempMemory(buffer);
+	// into a pixel buffer that RB_FinishScreenshotReadbacks maps in the
+	// next frame, when the GPU is done with it
+	if(glRefConfig.pixelBufferObject)
+	{
+		read = NULL;
+		for(i = 0; i < SCREENSHOT_READBACK_BUFFERS; i++)
+		{
+			if(!tr.screenshotReadbacks[i].reading)
+			{
+				read = &tr.screenshotReadbacks[i];
+				break;
+			}
+			if(!read || tr.screenshotReadbacks[i].frame < read->frame)
+				read = &tr.screenshotReadbacks[i];
+		}
+		if(read->reading)
+			RB_MapScreenshotReadback(read);
+
+		if(!read->buffer)
+			qglGenBuffers(1, &read->buffer);
+
+		qglBindBuffer(GL_PIXEL_PACK_BUFFER, read->buffer);
+		if(read->size != padwidth * height)
+		{
+			read->size = padwidth * height;
+			qglBufferData(GL_PIXEL_PACK_BUFFER, read->size, NULL, GL_STREAM_READ);
+		}
+		qglReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+		qglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		read->reading = qtrue;
+		read->frame = tr.frameCount;
+		Q_strncpyz(read->fileName, fileName, sizeof(read->fileName));
+		read->jpeg = jpeg;
+		read->quality = r_screenshotJpegQuality->integer;
+		read->gamma = glConfig.deviceSupportsGamma;
+		read->width = width;
+		read->height = height;
+		read->padlen = padwidth - linelen;
+		return;
+	}
+
+	// malloc is aligned enough for any pack alignment
+	pixels = malloc(padwidth * height);
+	if(!pixels)
+	{
+		ri.Printf(PRINT_WARNING, "Couldn't allocate screenshot %s\n", fileName);
+		return;
+	}
+
+	qglReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+	R_QueueScreenshot(fileName, jpeg, r_screenshotJpegQuality->integer, glConfig.deviceSupportsGamma,
+		pixels, width, height, padwidth - linelen);
 }
 
 /*
@@ -575,10 +639,7 @@ const void *RB_TakeScreenshotCmd( const void *data ) {
 	if(tess.numIndexes)
 		RB_EndSurface();
 
-	if (cmd->jpeg)
-		RB_TakeScreenshotJPEG( cmd->x, cmd->y, cmd->width, cmd->height, cmd->fileName);
-	else
-		RB_TakeScreenshot( cmd->x, cmd->y, cmd->width, cmd->height, cmd->fileName);
+	RB_TakeScreenshot( cmd->x, cmd->y, cmd->width, cmd->height, cmd->fileName, cmd->jpeg );
 	
 	return (const void *)(cmd + 1);	
 }
@@ -873,9 +934,98 @@ void R_ExportCubemaps_f(void)
 
 //============================================================================
 
+/*
+==================
+RB_ReadVideoBuffer
+
+Hands the oldest frame in the readback ring over to the client
+==================
+*/
+static void RB_ReadVideoBuffer( byte *captureBuffer )
+{
+	byte	*cBuf;
+	void	*pixels;
+	int		linelen, padlen;
+	GLint	packAlign;
+
+	qglGetIntegerv(GL_PACK_ALIGNMENT, &packAlign);
+
+	linelen = tr.videoWidth * 3;
+	padlen = PAD(linelen, packAlign) - linelen;
+
+	cBuf = PADP(captureBuffer, packAlign);
+
+	qglBindBuffer(GL_PIXEL_PACK_BUFFER, tr.videoBuffers[tr.videoTail % VIDEO_READBACK_BUFFERS]);
+	pixels = qglMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, tr.videoBufferSize, GL_MAP_READ_BIT);
+	if(pixels)
+	{
+		Com_Memcpy(cBuf, pixels, tr.videoBufferSize);
+		qglUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	qglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	tr.videoTail++;
+
+	// a lost frame is dropped, the next one goes on
+	if(!pixels)
+		return;
+
+	if(glConfig.deviceSupportsGamma)
+		R_GammaCorrect(cBuf, tr.videoBufferSize);
+
+	ri.CL_AVIVideoFrameCaptured(cBuf, padlen);
+}
+
+/*
+==================
+RB_FinishVideoFrames
+==================
+*/
+void RB_FinishVideoFrames( byte *captureBuffer )
+{
+	while(tr.videoTail != tr.videoHead)
+		RB_ReadVideoBuffer(captureBuffer);
+}
+
+/*
+==================
+R_ShutdownPixelBuffers
+==================
+*/
+void R_ShutdownPixelBuffers( void )
+{
+	int i;
+
+	RB_FinishScreenshotReadbacks(qtrue);
+	R_FinishScreenshots(qtrue);
+
+	for(i = 0; i < SCREENSHOT_READBACK_BUFFERS; i++)
+	{
+		if(tr.screenshotReadbacks[i].buffer)
+			qglDeleteBuffers(1, &tr.screenshotReadbacks[i].buffer);
+	}
+	Com_Memset(tr.screenshotReadbacks, 0, sizeof(tr.screenshotReadbacks));
+
+	if(tr.videoBuffers[0])
+		qglDeleteBuffers(VIDEO_READBACK_BUFFERS, tr.videoBuffers);
+
+	if(tr.cinematicBuffer)
+		qglDeleteBuffers(1, &tr.cinematicBuffer);
+	tr.cinematicBuffer = 0;
+
+	Com_Memset(tr.videoBuffers, 0, sizeof(tr.videoBuffers));
+	tr.videoBufferSize = 0;
+	tr.videoHead = tr.videoTail = 0;
+	tr.videoWidth = tr.videoHeight = 0;
+}
+
 /*
 ==================
 RB_TakeVideoFrameCmd
+
+With pixel buffer objects the read goes into a ring of them and the frame
+is only mapped when the ring comes around, so the pipeline doesn't stall
+on it
 ==================
 */
 const void *RB_TakeVideoFrameCmd( const void *data )
@@ -883,7 +1033,8 @@ const void *RB_TakeVideoFrameCmd( const void *data )
 	const videoFrameCommand_t	*cmd;
 	byte				*cBuf;
 	size_t				memcount, linelen;
-	int				padwidth, avipadwidth, padlen, avipadlen;
+	int				padwidth, padlen;
+	int				i;
 	GLint packAlign;
 
 	// finish any 2D drawing if needed
@@ -899,57 +1050,54 @@ const void *RB_TakeVideoFrameCmd( const void *data )
 	// Alignment stuff for glReadPixels
 	padwidth = PAD(linelen, packAlign);
 	padlen = padwidth - linelen;
-	// AVI line padding
-	avipadwidth = PAD(linelen, AVI_LINE_PADDING);
-	avipadlen = avipadwidth - linelen;
+
+	memcount = padwidth * cmd->height;
+
+	if(glRefConfig.pixelBufferObject)
+	{
+		// a new recording, anything left of the last one was finished
+		if(cmd->width != tr.videoWidth || cmd->height != tr.videoHeight || !tr.videoBuffers[0])
+		{
+			if(!tr.videoBuffers[0])
+				qglGenBuffers(VIDEO_READBACK_BUFFERS, tr.videoBuffers);
+
+			for(i = 0; i < VIDEO_READBACK_BUFFERS; i++)
+			{
+				qglBindBuffer(GL_PIXEL_PACK_BUFFER, tr.videoBuffers[i]);
+				qglBufferData(GL_PIXEL_PACK_BUFFER, memcount, NULL, GL_STREAM_READ);
+			}
+			qglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+			tr.videoBufferSize = memcount;
+			tr.videoWidth = cmd->width;
+			tr.videoHeight = cmd->height;
+			tr.videoHead = tr.videoTail = 0;
+		}
+
+		qglBindBuffer(GL_PIXEL_PACK_BUFFER, tr.videoBuffers[tr.videoHead % VIDEO_READBACK_BUFFERS]);
+		qglReadPixels(0, 0, cmd->width, cmd->height, GL_RGB,
+			GL_UNSIGNED_BYTE, NULL);
+		qglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		tr.videoHead++;
+
+		if(tr.videoHead - tr.videoTail >= VIDEO_READBACK_BUFFERS)
+			RB_ReadVideoBuffer(cmd->captureBuffer);
+
+		return (const void *)(cmd + 1);
+	}
 
 	cBuf = PADP(cmd->captureBuffer, packAlign);
 		
 	qglReadPixels(0, 0, cmd->width, cmd->height, GL_RGB,
 		GL_UNSIGNED_BYTE, cBuf);
 
-	memcount = padwidth * cmd->height;
-
 	// gamma correct
 	if(glConfig.deviceSupportsGamma)
 		R_GammaCorrect(cBuf, memcount);
 
-	if(cmd->motionJpeg)
-	{
-		memcount = RE_SaveJPGToBuffer(cmd->encodeBuffer, linelen * cmd->height,
-			r_aviMotionJpegQuality->integer,
-			cmd->width, cmd->height, cBuf, padlen);
-		ri.CL_WriteAVIVideoFrame(cmd->encodeBuffer, memcount);
-	}
-	else
-	{
-		byte *lineend, *memend;
-		byte *srcptr, *destptr;
-	
-		srcptr = cBuf;
-		destptr = cmd->encodeBuffer;
-		memend = srcptr + memcount;
-		
-		// swap R and B and remove line paddings
-		while(srcptr < memend)
-		{
-			lineend = srcptr + linelen;
-			while(srcptr < lineend)
-			{
-				*destptr++ = srcptr[2];
-				*destptr++ = srcptr[1];
-				*destptr++ = srcptr[0];
-				srcptr += 3;
-			}
-			
-			Com_Memset(destptr, '\0', avipadlen);
-			destptr += avipadlen;
-			
-			srcptr += padlen;
-		}
-		
-		ri.CL_WriteAVIVideoFrame(cmd->encodeBuffer, avipadwidth * cmd->height);
-	}
+	// the client encodes it
+	ri.CL_AVIVideoFrameCaptured(cBuf, padlen);
 
 	return (const void *)(cmd + 1);	
 }
@@ -1190,6 +1338,8 @@ void R_Register( void )
 	r_ext_framebuffer_multisample = ri.Cvar_Get( "r_ext_framebuffer_multisample", "0", CVAR_ARCHIVE | CVAR_LATCH);
 	r_arb_seamless_cube_map = ri.Cvar_Get( "r_arb_seamless_cube_map", "0", CVAR_ARCHIVE | CVAR_LATCH);
 	r_arb_vertex_array_object = ri.Cvar_Get( "r_arb_vertex_array_object", "1", CVAR_ARCHIVE | CVAR_LATCH);
+	r_arb_buffer_storage = ri.Cvar_Get( "r_arb_buffer_storage", "1", CVAR_ARCHIVE | CVAR_LATCH);
+	r_arb_pixel_buffer_object = ri.Cvar_Get( "r_arb_pixel_buffer_object", "1", CVAR_ARCHIVE | CVAR_LATCH);
 	r_ext_direct_state_access = ri.Cvar_Get("r_ext_direct_state_access", "1", CVAR_ARCHIVE | CVAR_LATCH);
 
 	r_ext_texture_filter_anisotropic = ri.Cvar_Get( "r_ext_texture_filter_anisotropic",
@@ -1216,6 +1366,7 @@ void R_Register( void )
 	r_customheight = ri.Cvar_Get( "r_customheight", "1024", CVAR_ARCHIVE | CVAR_LATCH );
 	r_customPixelAspect = ri.Cvar_Get( "r_customPixelAspect", "1", CVAR_ARCHIVE | CVAR_LATCH );
 	r_simpleMipMaps = ri.Cvar_Get( "r_simpleMipMaps", "1", CVAR_ARCHIVE | CVAR_LATCH );
+	r_prefetchImages = ri.Cvar_Get( "r_prefetchImages", "256", CVAR_ARCHIVE );
 	r_vertexLight = ri.Cvar_Get( "r_vertexLight", "0", CVAR_ARCHIVE | CVAR_LATCH );
 	r_uiFullScreen = ri.Cvar_Get( "r_uifullscreen", "0", 0);
 	r_subdivisions = ri.Cvar_Get ("r_subdivisions", "4", CVAR_ARCHIVE | CVAR_LATCH);
@@ -1225,6 +1376,8 @@ void R_Register( void )
 	ri.Cvar_Get("r_smp", "0", CVAR_ARCHIVE | CVAR_LATCH); // unused but must exist
 
 	r_externalGLSL = ri.Cvar_Get( "r_externalGLSL", "0", CVAR_LATCH );
+	r_glslCache = ri.Cvar_Get( "r_glslCache", "1", CVAR_ARCHIVE | CVAR_LATCH );
+	r_imageCache = ri.Cvar_Get( "r_imageCache", "1", CVAR_ARCHIVE | CVAR_LATCH );
 
 	r_hdr = ri.Cvar_Get( "r_hdr", "1", CVAR_ARCHIVE | CVAR_LATCH );
 	r_floatLightmap = ri.Cvar_Get( "r_floatLightmap", "0", CVAR_ARCHIVE | CVAR_LATCH );
@@ -1244,6 +1397,7 @@ void R_Register( void )
 	r_cameraExposure = ri.Cvar_Get( "r_cameraExposure", "1", CVAR_CHEAT );
 
 	r_depthPrepass = ri.Cvar_Get( "r_depthPrepass", "1", CVAR_ARCHIVE );
+	r_occlusionCull = ri.Cvar_Get( "r_occlusionCull", "0", CVAR_ARCHIVE );
 	r_ssao = ri.Cvar_Get( "r_ssao", "0", CVAR_LATCH | CVAR_ARCHIVE );
 
 	r_normalMapping = ri.Cvar_Get( "r_normalMapping", "1", CVAR_ARCHIVE | CVAR_LATCH );
@@ -1253,6 +1407,7 @@ void R_Register( void )
 	r_parallaxMapShadows = ri.Cvar_Get( "r_parallaxMapShadows", "0", CVAR_ARCHIVE | CVAR_LATCH );
 	r_cubeMapping = ri.Cvar_Get( "r_cubeMapping", "0", CVAR_ARCHIVE | CVAR_LATCH );
 	r_cubemapSize = ri.Cvar_Get( "r_cubemapSize", "128", CVAR_ARCHIVE | CVAR_LATCH );
+	r_cubemapCache = ri.Cvar_Get( "r_cubemapCache", "1", CVAR_ARCHIVE );
 	r_deluxeSpecular = ri.Cvar_Get("r_deluxeSpecular", "0.3", CVAR_ARCHIVE | CVAR_LATCH);
 	r_pbr = ri.Cvar_Get("r_pbr", "0", CVAR_ARCHIVE | CVAR_LATCH);
 	r_baseNormalX = ri.Cvar_Get( "r_baseNormalX", "1.0", CVAR_ARCHIVE | CVAR_LATCH );
@@ -1264,6 +1419,7 @@ void R_Register( void )
 	r_dlightMode = ri.Cvar_Get( "r_dlightMode", "0", CVAR_ARCHIVE | CVAR_LATCH );
 	r_pshadowDist = ri.Cvar_Get( "r_pshadowDist", "128", CVAR_ARCHIVE );
 	r_mergeLightmaps = ri.Cvar_Get( "r_mergeLightmaps", "1", CVAR_ARCHIVE | CVAR_LATCH );
+	r_lightmapArray = ri.Cvar_Get( "r_lightmapArray", "1", CVAR_ARCHIVE | CVAR_LATCH );
 	r_imageUpsample = ri.Cvar_Get( "r_imageUpsample", "0", CVAR_ARCHIVE | CVAR_LATCH );
 	r_imageUpsampleMaxSize = ri.Cvar_Get( "r_imageUpsampleMaxSize", "1024", CVAR_ARCHIVE | CVAR_LATCH );
 	r_imageUpsampleType = ri.Cvar_Get( "r_imageUpsampleType", "1", CVAR_ARCHIVE | CVAR_LATCH );
@@ -1282,6 +1438,8 @@ void R_Register( void )
 	r_shadowCascadeZNear = ri.Cvar_Get( "r_shadowCascadeZNear", "8", CVAR_ARCHIVE | CVAR_LATCH );
 	r_shadowCascadeZFar = ri.Cvar_Get( "r_shadowCascadeZFar", "1024", CVAR_ARCHIVE | CVAR_LATCH );
 	r_shadowCascadeZBias = ri.Cvar_Get( "r_shadowCascadeZBias", "0", CVAR_ARCHIVE | CVAR_LATCH );
+	r_shadowCascadeCache = ri.Cvar_Get( "r_shadowCascadeCache", "1", CVAR_ARCHIVE | CVAR_LATCH );
+	r_shadowCascadeCacheTexels = ri.Cvar_Get( "r_shadowCascadeCacheTexels", "64", CVAR_ARCHIVE );
 	r_ignoreDstAlpha = ri.Cvar_Get( "r_ignoreDstAlpha", "1", CVAR_ARCHIVE | CVAR_LATCH );
 
 	//
@@ -1336,6 +1494,7 @@ void R_Register( void )
 	r_debugSort = ri.Cvar_Get( "r_debugSort", "0", CVAR_CHEAT );
 	r_printShaders = ri.Cvar_Get( "r_printShaders", "0", 0 );
 	r_saveFontData = ri.Cvar_Get( "r_saveFontData", "0", 0 );
+	r_modelCache = ri.Cvar_Get( "r_modelCache", "64", CVAR_ARCHIVE );
 
 	r_nocurves = ri.Cvar_Get ("r_nocurves", "0", CVAR_CHEAT );
 	r_drawworld = ri.Cvar_Get ("r_drawworld", "1", CVAR_CHEAT );
@@ -1345,6 +1504,7 @@ void R_Register( void )
 	r_flareSize = ri.Cvar_Get ("r_flareSize", "40", CVAR_CHEAT);
 	r_flareFade = ri.Cvar_Get ("r_flareFade", "7", CVAR_CHEAT);
 	r_flareCoeff = ri.Cvar_Get ("r_flareCoeff", FLARE_STDCOEFF, CVAR_CHEAT);
+	r_flareQueries = ri.Cvar_Get ("r_flareQueries", "1", CVAR_ARCHIVE);
 
 	r_skipBackEnd = ri.Cvar_Get ("r_skipBackEnd", "0", CVAR_CHEAT);
 
@@ -1357,6 +1517,11 @@ void R_Register( void )
 	r_novis = ri.Cvar_Get ("r_novis", "0", CVAR_CHEAT);
 	r_showcluster = ri.Cvar_Get ("r_showcluster", "0", CVAR_CHEAT);
 	r_speeds = ri.Cvar_Get ("r_speeds", "0", CVAR_CHEAT);
+	r_profile = ri.Cvar_Get( "r_profile", "0", CVAR_ARCHIVE );
+	r_dynamicResolution = ri.Cvar_Get( "r_dynamicResolution", "0", CVAR_ARCHIVE );
+	r_dynamicResolutionMin = ri.Cvar_Get( "r_dynamicResolutionMin", "0.5", CVAR_ARCHIVE );
+	r_dynamicResolutionMax = ri.Cvar_Get( "r_dynamicResolutionMax", "1", CVAR_ARCHIVE );
+	ri.Cvar_Get( "r_dynamicResolutionScale", "1", CVAR_ROM );
 	r_verbose = ri.Cvar_Get( "r_verbose", "0", CVAR_CHEAT );
 	r_logFile = ri.Cvar_Get( "r_logFile", "0", CVAR_CHEAT );
 	r_debugSurface = ri.Cvar_Get ("r_debugSurface", "0", CVAR_CHEAT);
@@ -1370,6 +1535,7 @@ void R_Register( void )
 	r_drawBuffer = ri.Cvar_Get( "r_drawBuffer", "GL_BACK", CVAR_CHEAT );
 	r_lockpvs = ri.Cvar_Get ("r_lockpvs", "0", CVAR_CHEAT);
 	r_noportals = ri.Cvar_Get ("r_noportals", "0", CVAR_CHEAT);
+	r_simd = ri.Cvar_Get( "r_simd", "1", CVAR_ARCHIVE | CVAR_LATCH );
 	r_shadows = ri.Cvar_Get( "cg_shadows", "1", 0 );
 
 	r_marksOnTriangleMeshes = ri.Cvar_Get("r_marksOnTriangleMeshes", "0", CVAR_ARCHIVE);
@@ -1393,24 +1559,47 @@ void R_Register( void )
 	ri.Cmd_AddCommand( "minimize", GLimp_Minimize );
 	ri.Cmd_AddCommand( "gfxmeminfo", GfxMemInfo_f );
 	ri.Cmd_AddCommand( "exportCubemaps", R_ExportCubemaps_f );
+	ri.Cmd_AddCommand( "profiledump", R_ProfileDump_f );
 }
 
 void R_InitQueries(void)
 {
+	int i;
+
 	if (!glRefConfig.occlusionQuery)
 		return;
 
 	if (r_drawSunRays->integer)
 		qglGenQueries(ARRAY_LEN(tr.sunFlareQuery), tr.sunFlareQuery);
+
+	for (i = 0; i < MAX_OCCLUSION_QUERIES; i++)
+	{
+		qglGenQueries(1, &tr.occlusionQueries[i].query);
+		tr.occlusionQueries[i].leaf = NULL;
+	}
+	tr.numOcclusionLeafs = 0;
+
+	qglGenQueries(ARRAY_LEN(tr.flareQueries), tr.flareQueries);
 }
 
 void R_ShutDownQueries(void)
 {
+	int i;
+
 	if (!glRefConfig.occlusionQuery)
 		return;
 
 	if (r_drawSunRays->integer)
 		qglDeleteQueries(ARRAY_LEN(tr.sunFlareQuery), tr.sunFlareQuery);
+
+	for (i = 0; i < MAX_OCCLUSION_QUERIES; i++)
+	{
+		qglDeleteQueries(1, &tr.occlusionQueries[i].query);
+		tr.occlusionQueries[i].leaf = NULL;
+	}
+	tr.numOcclusionLeafs = 0;
+
+	qglDeleteQueries(ARRAY_LEN(tr.flareQueries), tr.flareQueries);
 }
 
 /*
@@ -1430,6 +1619,9 @@ void R_Init( void ) {
 	Com_Memset( &backEnd, 0, sizeof( backEnd ) );
 	Com_Memset( &tess, 0, sizeof( tess ) );
 
+	// the renderer has its own copy of the math table when loaded as a library
+	Q_InitMathFuncs( ri.Sys_GetProcessorFeatures() );
+
 	if(sizeof(glconfig_t) != 11332)
 		ri.Error( ERR_FATAL, "Mod ABI incompatible: sizeof(glconfig_t) == %u != 11332", (unsigned int) sizeof(glconfig_t));
 
@@ -1473,6 +1665,8 @@ void R_Init( void ) {
 
 	R_Register();
 
+	RB_InitTessCalc();
+
 	max_polys = r_maxpolys->integer;
 	if (max_polys < MAX_POLYS)
 		max_polys = MAX_POLYS;
@@ -1494,6 +1688,9 @@ void R_Init( void ) {
 	if (glRefConfig.framebufferObject)
 		FBO_Init();
 
+	// the r_lightmap views bind lightmaps where 2D textures are sampled
+	tr.lightmapArray = r_lightmapArray->integer && r_mergeLightmaps->integer && glRefConfig.textureArray && !r_lightmap->integer;
+
 	GLSL_InitGPUShaders();
 
 	R_InitVaos();
@@ -1508,6 +1705,10 @@ void R_Init( void ) {
 
 	R_InitQueries();
 
+	R_InitProfile();
+
+	R_InitDynamicResolution();
+
 
 	err = qglGetError();
 	if ( err != GL_NO_ERROR )
@@ -1538,11 +1739,15 @@ void RE_Shutdown( qboolean destroyWindow ) {
 	ri.Cmd_RemoveCommand( "minimize" );
 	ri.Cmd_RemoveCommand( "gfxmeminfo" );
 	ri.Cmd_RemoveCommand( "exportCubemaps" );
+	ri.Cmd_RemoveCommand( "profiledump" );
 
 
 	if ( tr.registered ) {
 		R_IssuePendingRenderCommands();
+		R_ShutdownProfile();
+		R_ShutdownDynamicResolution();
 		R_ShutDownQueries();
+		R_ShutdownPixelBuffers();
 		if (glRefConfig.framebufferObject)
 			FBO_Shutdown();
 		R_DeleteTextures();
@@ -1550,10 +1755,14 @@ void RE_Shutdown( qboolean destroyWindow ) {
 		GLSL_ShutdownGPUShaders();
 	}
 
+	R_FlushPrefetchedJPGs();
+
 	R_DoneFreeType();
 
 	// shut down platform specific OpenGL stuff
 	if ( destroyWindow ) {
+		R_ShutdownModelCache();
+
 		GLimp_Shutdown();
 
 		Com_Memset( &glConfig, 0, sizeof( glConfig ) );
@@ -1639,6 +1848,7 @@ refexport_t *GetRefAPI ( int apiVersion, refimport_t *rimp ) {
 
 	re.SetColor = RE_SetColor;
 	re.DrawStretchPic = RE_StretchPic;
+	re.DrawStretchPics = RE_StretchPics;
 	re.DrawStretchRaw = RE_StretchRaw;
 	re.UploadCinematic = RE_UploadCinematic;
 
@@ -1648,6 +1858,9 @@ refexport_t *GetRefAPI ( int apiVersion, refimport_t *rimp ) {
 	re.inPVS = R_inPVS;
 
 	re.TakeVideoFrame = RE_TakeVideoFrame;
+	re.FinishVideoFrames = RE_FinishVideoFrames;
+	re.SaveJPGToBuffer = RE_SaveJPGToBuffer;
+	re.GetGPUFrameTime = R_ProfileGPUFrameTime;
 
 	return &re;
 }
@@ -123,159 +123,127 @@ extern	cvar_t	*r_debugLight;
 
 /*
 =================
-R_SetupEntityLightingGrid
+R_LightGridSample
 
+Trilerps the light grid decoded by R_LoadLightGrid, before r_ambientScale
+and r_directedScale. Samples in walls have no weight and those past the
+edges of the grid are ignored.
 =================
 */
-static void R_SetupEntityLightingGrid( trRefEntity_t *ent, world_t *world ) {
+static void R_LightGridSample( const world_t *world, const vec3_t point, vec3_t ambientLight, vec3_t directedLight, vec3_t lightDir ) {
 	vec3_t	lightOrigin;
 	int		pos[3];
-	int		i, j;
-	byte	*gridData;
-	float	frac[3];
-	int		gridStep[3];
-	vec3_t	direction;
+	int		i, k;
+	float	frac[3][2];
+	int		gridStride[3], gridStep[3];
+	const lightGridPoint_t	*gridData;
+	vec4_t	ambient, directed, direction;
 	float	totalFactor;
 
-	if ( ent->e.renderfx & RF_LIGHTING_ORIGIN ) {
-		// separate lightOrigins are needed so an object that is
-		// sinking into the ground can still be lit, and so
-		// multi-part models can be lit identically
-		VectorCopy( ent->e.lightingOrigin, lightOrigin );
-	} else {
-		VectorCopy( ent->e.origin, lightOrigin );
-	}
+	gridStride[0] = 1;
+	gridStride[1] = world->lightGridBounds[0];
+	gridStride[2] = world->lightGridBounds[0] * world->lightGridBounds[1];
 
-	VectorSubtract( lightOrigin, world->lightGridOrigin, lightOrigin );
+	VectorSubtract( point, world->lightGridOrigin, lightOrigin );
 	for ( i = 0 ; i < 3 ; i++ ) {
 		float	v;
 
 		v = lightOrigin[i]*world->lightGridInverseSize[i];
 		pos[i] = floor( v );
-		frac[i] = v - pos[i];
+		frac[i][1] = v - pos[i];
+		frac[i][0] = 1.0f - frac[i][1];
 		if ( pos[i] < 0 ) {
 			pos[i] = 0;
 		} else if ( pos[i] > world->lightGridBounds[i] - 1 ) {
 			pos[i] = world->lightGridBounds[i] - 1;
 		}
+
+		gridStep[i] = gridStride[i];
+		if ( pos[i] + 1 > world->lightGridBounds[i] - 1 ) {
+			// ignore values outside lightgrid
+			frac[i][1] = 0;
+			gridStep[i] = 0;
+		}
 	}
 
-	VectorClear( ent->ambientLight );
-	VectorClear( ent->directedLight );
-	VectorClear( direction );
+	assert( world->lightGridPoints ); // NULL with -nolight maps
 
-	assert( world->lightGridData ); // NULL with -nolight maps
+	gridData = world->lightGridPoints + pos[0] * gridStride[0]
+		+ pos[1] * gridStride[1] + pos[2] * gridStride[2];
 
-	// trilerp the light value
-	gridStep[0] = 8;
-	gridStep[1] = 8 * world->lightGridBounds[0];
-	gridStep[2] = 8 * world->lightGridBounds[0] * world->lightGridBounds[1];
-	gridData = world->lightGridData + pos[0] * gridStep[0]
-		+ pos[1] * gridStep[1] + pos[2] * gridStep[2];
+	for ( k = 0 ; k < 4 ; k++ ) {
+		ambient[k] = directed[k] = direction[k] = 0;
+	}
 
-	totalFactor = 0;
+	// trilerp the light value, the weights sum into ambient[3]
 	for ( i = 0 ; i < 8 ; i++ ) {
+		const lightGridPoint_t	*data;
 		float	factor;
-		byte	*data;
-		int		lat, lng;
-		vec3_t	normal;
-		#if idppc
-		float d0, d1, d2, d3, d4, d5;
-		#endif
-		factor = 1.0;
-		data = gridData;
-		for ( j = 0 ; j < 3 ; j++ ) {
-			if ( i & (1<<j) ) {
-				if ( pos[j] + 1 > world->lightGridBounds[j] - 1 ) {
-					break; // ignore values outside lightgrid
-				}
-				factor *= frac[j];
-				data += gridStep[j];
-			} else {
-				factor *= (1.0f - frac[j]);
-			}
-		}
 
-		if ( j != 3 ) {
-			continue;
-		}
+		factor = frac[0][i & 1] * frac[1][( i >> 1 ) & 1] * frac[2][i >> 2];
+		data = gridData + ( i & 1 ) * gridStep[0]
+			+ ( ( i >> 1 ) & 1 ) * gridStep[1] + ( i >> 2 ) * gridStep[2];
 
-		if (world->lightGrid16)
-		{
-			uint16_t *data16 = world->lightGrid16 + (int)(data - world->lightGridData) / 8 * 6;
-			if (!(data16[0]+data16[1]+data16[2]+data16[3]+data16[4]+data16[5])) {
-				continue;	// ignore samples in walls
-			}
+		for ( k = 0 ; k < 4 ; k++ ) {
+			ambient[k] += factor * data->ambient[k];
+			directed[k] += factor * data->directed[k];
+			direction[k] += factor * data->dir[k];
 		}
-		else
-		{
-			if (!(data[0]+data[1]+data[2]+data[3]+data[4]+data[5]) ) {
-				continue;	// ignore samples in walls
-			}
-		}
-		totalFactor += factor;
-		#if idppc
-		d0 = data[0]; d1 = data[1]; d2 = data[2];
-		d3 = data[3]; d4 = data[4]; d5 = data[5];
-
-		ent->ambientLight[0] += factor * d0;
-		ent->ambientLight[1] += factor * d1;
-		ent->ambientLight[2] += factor * d2;
-
-		ent->directedLight[0] += factor * d3;
-		ent->directedLight[1] += factor * d4;
-		ent->directedLight[2] += factor * d5;
-		#else
-		if (world->lightGrid16)
-		{
-			// FIXME: this is hideous
-			uint16_t *data16 = world->lightGrid16 + (int)(data - world->lightGridData) / 8 * 6;
-
-			ent->ambientLight[0] += factor * data16[0] / 257.0f;
-			ent->ambientLight[1] += factor * data16[1] / 257.0f;
-			ent->ambientLight[2] += factor * data16[2] / 257.0f;
+	}
 
-			ent->directedLight[0] += factor * data16[3] / 257.0f;
-			ent->directedLight[1] += factor * data16[4] / 257.0f;
-			ent->directedLight[2] += factor * data16[5] / 257.0f;
-		}
-		else
-		{
-			ent->ambientLight[0] += factor * data[0];
-			ent->ambientLight[1] += factor * data[1];
-			ent->ambientLight[2] += factor * data[2];
+	totalFactor = ambient[3];
+	if ( totalFactor > 0 && totalFactor < 0.99 ) {
+		totalFactor = 1.0f / totalFactor;
+		VectorScale( ambient, totalFactor, ambient );
+		VectorScale( directed, totalFactor, directed );
+	}
 
-			ent->directedLight[0] += factor * data[3];
-			ent->directedLight[1] += factor * data[4];
-			ent->directedLight[2] += factor * data[5];
-		}
-		#endif
-		lat = data[7];
-		lng = data[6];
-		lat *= (FUNCTABLE_SIZE/256);
-		lng *= (FUNCTABLE_SIZE/256);
+	VectorCopy( ambient, ambientLight );
+	VectorCopy( directed, directedLight );
+	VectorNormalize2( direction, lightDir );
+}
 
-		// decode X as cos( lat ) * sin( long )
-		// decode Y as sin( lat ) * sin( long )
-		// decode Z as cos( long )
+/*
+=================
+R_SetupEntityLightingGrid
 
-		normal[0] = tr.sinTable[(lat+(FUNCTABLE_SIZE/4))&FUNCTABLE_MASK] * tr.sinTable[lng];
-		normal[1] = tr.sinTable[lat] * tr.sinTable[lng];
-		normal[2] = tr.sinTable[(lng+(FUNCTABLE_SIZE/4))&FUNCTABLE_MASK];
+Entities that haven't moved since the last frame, and the parts of a
+model sharing a lightingOrigin, find their sample in a small cache
+keyed by the exact origin.
+=================
+*/
+static void R_SetupEntityLightingGrid( trRefEntity_t *ent, world_t *world ) {
+	vec3_t	lightOrigin;
+	lightGridCache_t	*entry;
+	floatint_t	bits[3];
+	unsigned	hash;
+	int		i;
 
-		VectorMA( direction, factor, normal, direction );
+	if ( ent->e.renderfx & RF_LIGHTING_ORIGIN ) {
+		// separate lightOrigins are needed so an object that is
+		// sinking into the ground can still be lit, and so
+		// multi-part models can be lit identically
+		VectorCopy( ent->e.lightingOrigin, lightOrigin );
+	} else {
+		VectorCopy( ent->e.origin, lightOrigin );
 	}
 
-	if ( totalFactor > 0 && totalFactor < 0.99 ) {
-		totalFactor = 1.0f / totalFactor;
-		VectorScale( ent->ambientLight, totalFactor, ent->ambientLight );
-		VectorScale( ent->directedLight, totalFactor, ent->directedLight );
+	hash = 0;
+	for ( i = 0 ; i < 3 ; i++ ) {
+		bits[i].f = lightOrigin[i];
+		hash = ( hash ^ bits[i].ui ) * 16777619u;
 	}
+	entry = &world->lightGridCache[( hash ^ ( hash >> 15 ) ) & ( LIGHTGRID_CACHE_SIZE - 1 )];
 
-	VectorScale( ent->ambientLight, r_ambientScale->value, ent->ambientLight );
-	VectorScale( ent->directedLight, r_directedScale->value, ent->directedLight );
+	if ( !entry->used || !VectorCompare( entry->origin, lightOrigin ) ) {
+		R_LightGridSample( world, lightOrigin, entry->ambientLight, entry->directedLight, entry->lightDir );
+		VectorCopy( lightOrigin, entry->origin );
+		entry->used = qtrue;
+	}
 
-	VectorNormalize2( direction, ent->lightDir );
+	VectorScale( entry->ambientLight, r_ambientScale->value, ent->ambientLight );
+	VectorScale( entry->directedLight, r_directedScale->value, ent->directedLight );
+	VectorCopy( entry->lightDir, ent->lightDir );
 }
 
 
@@ -40,12 +40,18 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 QGL_1_1_PROCS;
 QGL_DESKTOP_1_1_PROCS;
 QGL_1_3_PROCS;
+QGL_DESKTOP_1_3_PROCS;
 QGL_1_5_PROCS;
 QGL_2_0_PROCS;
 QGL_3_0_PROCS;
 QGL_ARB_occlusion_query_PROCS;
 QGL_ARB_framebuffer_object_PROCS;
 QGL_ARB_vertex_array_object_PROCS;
+QGL_ARB_get_program_binary_PROCS;
+QGL_ARB_buffer_storage_PROCS;
+QGL_ARB_pixel_buffer_object_PROCS;
+QGL_ARB_timer_query_PROCS;
+QGL_EXT_texture_array_PROCS;
 QGL_EXT_direct_state_access_PROCS;
 #undef GLE
 
@@ -139,12 +145,16 @@ typedef struct vao_s
 
 	uint32_t        vertexesVBO;
 	int             vertexesSize;	// amount of memory data allocated for all vertices in bytes
+	int             vertexesOffset;	// byte offset of the vertices in a shared model buffer
+	qboolean        sharedBuffers;	// the buffers belong to a model buffer VAO
 	vaoAttrib_t     attribs[VAO_MAX_ATTRIBS];
 
 	uint32_t        frameSize;      // bytes to skip per frame when doing vertex animation
 
 	uint32_t        indexesIBO;
 	int             indexesSize;	// amount of memory data allocated for all triangles in bytes
+	int             indexesOffset;	// byte offset of the indexes last streamed into the tess VAO,
+									// or in a shared model buffer
 } vao_t;
 
 //===============================================================================
@@ -555,8 +565,9 @@ enum
 	GENERICDEF_USE_FOG              = 0x0008,
 	GENERICDEF_USE_RGBAGEN          = 0x0010,
 	GENERICDEF_USE_BONE_ANIMATION   = 0x0020,
-	GENERICDEF_ALL                  = 0x003F,
-	GENERICDEF_COUNT                = 0x0040,
+	GENERICDEF_USE_LIGHTMAP_ARRAY   = 0x0040,
+	GENERICDEF_ALL                  = 0x007F,
+	GENERICDEF_COUNT                = 0x0080,
 };
 
 enum
@@ -575,6 +586,9 @@ enum
 	DLIGHTDEF_COUNT                = 0x0002,
 };
 
+// lights summed by one pass of the dlight shader
+#define MAX_DLIGHTS_PER_PASS 8
+
 enum
 {
 	LIGHTDEF_USE_LIGHTMAP        = 0x0001,
@@ -607,7 +621,8 @@ enum
 	GLSL_VEC3,
 	GLSL_VEC4,
 	GLSL_MAT16,
-	GLSL_MAT16_BONEMATRIX
+	GLSL_MAT16_BONEMATRIX,
+	GLSL_VEC4_DLIGHTS
 };
 
 typedef enum
@@ -654,6 +669,8 @@ typedef enum
 	UNIFORM_VERTCOLOR,
 
 	UNIFORM_DLIGHTINFO,
+	UNIFORM_DLIGHTCOLOR,
+	UNIFORM_NUMDLIGHTS,
 	UNIFORM_LIGHTFORWARD,
 	UNIFORM_LIGHTUP,
 	UNIFORM_LIGHTRIGHT,
@@ -813,9 +830,19 @@ typedef enum {
 	VPF_ORTHOGRAPHIC    = 0x10,
 	VPF_USESUNLIGHT     = 0x20,
 	VPF_FARPLANEFRUSTUM = 0x40,
-	VPF_NOCUBEMAPS      = 0x80
+	VPF_NOCUBEMAPS      = 0x80,
+	VPF_OCCLUSIONCULL   = 0x100,
+	VPF_SHADOWCACHESTORE = 0x200,	// copy the depth to shadowCacheFbo after drawing
+	VPF_SHADOWCACHELOAD  = 0x400	// start from the depth in shadowCacheFbo instead of clearing
 } viewParmFlags_t;
 
+// the static world depth of a sun shadow cascade, kept while the bounds and sun don't move
+typedef struct {
+	qboolean	valid;
+	vec3_t		lightDir;
+	vec3_t		bounds[2];
+} sunShadowCache_t;
+
 typedef struct {
 	orientationr_t	or;
 	orientationr_t	world;
@@ -827,9 +854,11 @@ typedef struct {
 	int			frameCount;			// copied from tr.frameCount
 	cplane_t	portalPlane;		// clip anything behind this if mirroring
 	int			viewportX, viewportY, viewportWidth, viewportHeight;
+	int			scissorX, scissorY, scissorWidth, scissorHeight;	// 0 width for the whole viewport
 	FBO_t		*targetFbo;
 	int         targetFboLayer;
 	int         targetFboCubemapIndex;
+	FBO_t		*shadowCacheFbo;
 	float		fovX, fovY;
 	float		projectionMatrix[16];
 	cplane_t	frustum[5];
@@ -864,6 +893,7 @@ typedef enum {
 	SF_ENTITY,				// beams, rails, lightning, etc that can be determined by entity
 	SF_VAO_MDVMESH,
 	SF_VAO_IQM,
+	SF_VAO_MDR,
 
 	SF_NUM_SURFACE_TYPES,
 	SF_MAX = 0x7fffffff			// ensures that sizeof( surfaceType_t ) == sizeof( int )
@@ -879,6 +909,10 @@ typedef struct drawSurf_s {
 
 #define	MAX_PATCH_SIZE		32			// max dimensions of a patch mesh in map file
 #define	MAX_GRID_SIZE		65			// max dimensions of a grid mesh in memory
+#define	GRID_LOD_LEVELS		8			// index lists built for each grid
+
+// the lod error a grid lod is built for, level 0 is the full grid
+#define	GRID_LOD_ERROR(n)	( 4.0f / ( 1 << (n) ) )
 
 // when cgame directly specifies a polygon, it becomes a srfPoly_t
 // as soon as it is called
@@ -888,6 +922,7 @@ typedef struct srfPoly_s {
 	int				fogIndex;
 	int				numVerts;
 	polyVert_t		*verts;
+	vec3_t			bounds[2];
 } srfPoly_t;
 
 
@@ -952,6 +987,11 @@ typedef struct srfBspSurface_s
 	int				width, height;
 	float			*widthLodError;
 	float			*heightLodError;
+
+	// coarser index lists over the same verts, see R_CreateGridLods
+	int				numLods;
+	int				lodNumIndexes[GRID_LOD_LEVELS];
+	glIndex_t		*lodIndexes[GRID_LOD_LEVELS];
 } srfBspSurface_t;
 
 typedef struct {
@@ -1029,6 +1069,22 @@ typedef struct srfVaoIQModel_s
 	vao_t          *vao;
 } srfVaoIQModel_t;
 
+typedef struct srfVaoMdrSurface_s
+{
+	surfaceType_t   surfaceType;
+
+	mdrHeader_t    *mdrHeader;
+	mdrSurface_t   *mdrSurface;
+	float          *invBindBones;	// 3x4 per bone, the first frame inverted
+
+	// backEnd stats
+	int             numIndexes;
+	int             numVerts;
+
+	// static render data
+	vao_t          *vao;
+} srfVaoMdrSurface_t;
+
 typedef struct srfVaoMdvMesh_s
 {
 	surfaceType_t   surfaceType;
@@ -1132,14 +1188,65 @@ typedef struct mnode_s {
 
 	int         firstmarksurface;
 	int			nummarksurfaces;
+
+	// leaf occlusion, see R_LeafOccluded
+	int			occlusionQuery;		// 1 + index in tr.occlusionQueries while one is out
+	int			occlusionFrame;		// tr.frameCount the last result was queried in
+	qboolean	occluded;
 } mnode_t;
 
+#define	MAX_OCCLUSION_QUERIES	2048
+
+#define	MAX_FLARES				128
+
+#define	VIDEO_READBACK_BUFFERS	3		// a video frame comes out two frames after it was taken
+#define	SCREENSHOT_READBACK_BUFFERS	2	// a screenshot is mapped in the next frame
+
+typedef struct {
+	GLuint		buffer;
+	int			size;
+	qboolean	reading;
+	int			frame;				// tr.frameCount it was read in
+
+	char		fileName[MAX_OSPATH];
+	qboolean	jpeg;
+	int			quality;
+	qboolean	gamma;
+	int			width, height, padlen;
+} screenshotReadback_t;
+
+typedef struct {
+	GLuint		query;
+	mnode_t		*leaf;				// NULL if the query is free
+	int			frame;				// tr.frameCount it was queued in
+	qboolean	issued;				// drawn by the back end
+} occlusionQuery_t;
+
 typedef struct {
 	vec3_t		bounds[2];		// for culling
 	int	        firstSurface;
 	int			numSurfaces;
 } bmodel_t;
 
+// a light grid point decoded at load, each part padded to four floats
+// so the trilerp in R_LightGridSample is the same sums for all of them
+typedef struct {
+	vec4_t		ambient;		// [3] is the weight, 0 for samples in walls
+	vec4_t		directed;
+	vec4_t		dir;
+} lightGridPoint_t;
+
+#define	LIGHTGRID_CACHE_SIZE	64		// power of two
+
+// the last samples taken, see R_SetupEntityLightingGrid
+typedef struct {
+	qboolean	used;
+	vec3_t		origin;
+	vec3_t		ambientLight;
+	vec3_t		directedLight;
+	vec3_t		lightDir;
+} lightGridCache_t;
+
 typedef struct {
 	char		name[MAX_QPATH];		// ie: maps/tim_dm2.bsp
 	char		baseName[MAX_QPATH];	// ie: tim_dm2
@@ -1179,12 +1286,17 @@ typedef struct {
 	int			lightGridBounds[3];
 	byte		*lightGridData;
 	uint16_t	*lightGrid16;
+	lightGridPoint_t	*lightGridPoints;
+	lightGridCache_t	lightGridCache[LIGHTGRID_CACHE_SIZE];
 
 
 	int			numClusters;
 	int			clusterBytes;
 	const byte	*vis;			// may be passed in by CM_LoadMap to save space
 
+	int			*clusterFirstLeaf;	// numClusters + 1 offsets into clusterLeafs
+	mnode_t		**clusterLeafs;
+
 	char		*entityString;
 	char		*entityParsePoint;
 } world_t;
@@ -1282,6 +1394,7 @@ typedef struct model_s {
 	bmodel_t	*bmodel;		// only if type == MOD_BRUSH
 	mdvModel_t	*mdv[MD3_MAX_LODS];	// only if type == MOD_MESH
 	void	*modelData;			// only if type == (MOD_MDR | MOD_IQM)
+	srfVaoMdrSurface_t	*mdrVaoSurfaces;	// surfaces of all LODs in order, if the MDR is GPU skinned
 
 	int			 numLods;
 } model_t;
@@ -1352,6 +1465,7 @@ typedef struct {
 	int		c_box_cull_md3_in, c_box_cull_md3_clip, c_box_cull_md3_out;
 
 	int		c_leafs;
+	int		c_occludedLeafs, c_occludedEntities;
 	int		c_dlightSurfaces;
 	int		c_dlightSurfacesCulled;
 } frontEndCounters_t;
@@ -1421,7 +1535,15 @@ typedef struct {
 	qboolean depthClamp;
 	qboolean seamlessCubeMap;
 
+	qboolean textureArray;
+	int maxArrayTextureLayers;
+
 	qboolean vertexArrayObject;
+	qboolean bufferStorage;
+	qboolean pixelBufferObject;
+	qboolean timerQuery;
+	qboolean programBinary;
+	qboolean imageCache;
 	qboolean directStateAccess;
 } glRefConfig_t;
 
@@ -1474,6 +1596,7 @@ typedef struct {
 	qboolean    colorMask[4];
 	qboolean    framePostProcessed;
 	qboolean    depthFill;
+	qboolean    depthPrepassed;	// opaque depth is in, their first stages draw with GL_EQUAL
 } backEndState_t;
 
 /*
@@ -1525,9 +1648,10 @@ typedef struct {
 	image_t					*textureScratchImage[2];
 	image_t                 *quarterImage[2];
 	image_t					*calcLevelsImage;
-	image_t					*targetLevelsImage;
+	image_t					*levelsPyramidImage;
 	image_t					*fixedLevelsImage;
 	image_t					*sunShadowDepthImage[4];
+	image_t					*sunShadowCacheImage[4];
 	image_t                 *screenShadowImage;
 	image_t                 *screenSsaoImage;
 	image_t					*hdrDepthImage;
@@ -1544,8 +1668,9 @@ typedef struct {
 	FBO_t					*textureScratchFbo[2];
 	FBO_t                   *quarterFbo[2];
 	FBO_t					*calcLevelsFbo;
-	FBO_t					*targetLevelsFbo;
+	FBO_t					*levelsPyramidFbo;
 	FBO_t					*sunShadowFbo[4];
+	FBO_t					*sunShadowCacheFbo[4];
 	FBO_t					*screenShadowFbo;
 	FBO_t					*screenSsaoFbo;
 	FBO_t					*hdrDepthFbo;
@@ -1566,6 +1691,7 @@ typedef struct {
 
 	int						fatLightmapCols;
 	int						fatLightmapRows;
+	qboolean				lightmapArray;		// fat lightmaps are layers of lightmaps[0]
 
 	int                     numCubemaps;
 	cubemap_t               *cubemaps;
@@ -1617,6 +1743,7 @@ typedef struct {
 	vec3_t					sunDirection;
 	vec3_t                  lastCascadeSunDirection;
 	float                   lastCascadeSunMvp[16];
+	sunShadowCache_t        sunShadowCache[4];
 
 	frontEndCounters_t		pc;
 	int						frontEndMsec;		// not in pc due to clearing issue
@@ -1651,6 +1778,28 @@ typedef struct {
 	int						sunFlareQueryIndex;
 	qboolean				sunFlareQueryActive[2];
 
+	occlusionQuery_t		occlusionQueries[MAX_OCCLUSION_QUERIES];
+	int						occlusionQueryCursor;
+	int						occlusionQueriesOut;
+	int						occlusionLeafs[MAX_OCCLUSION_QUERIES];	// queries queued for this frame
+	int						numOcclusionLeafs;
+	int						occlusionResetFrame;	// results queried before this are ignored
+	int						occlusionViewFrame;		// tr.frameCount of the last occlusion culled view
+	vec3_t					occlusionOrigin;
+
+	GLuint					flareQueries[MAX_FLARES];
+
+	// video frames being read back, oldest at videoTail
+	GLuint					videoBuffers[VIDEO_READBACK_BUFFERS];
+	int						videoBufferSize;
+	int						videoHead, videoTail;
+	int						videoWidth, videoHeight;
+
+	screenshotReadback_t	screenshotReadbacks[SCREENSHOT_READBACK_BUFFERS];
+
+	// cinematic frames go up through this, orphaned on every upload
+	GLuint					cinematicBuffer;
+
 	float					sinTable[FUNCTABLE_SIZE];
 	float					squareTable[FUNCTABLE_SIZE];
 	float					triangleTable[FUNCTABLE_SIZE];
@@ -1672,6 +1821,7 @@ extern cvar_t	*r_flareFade;
 // coefficient for the flare intensity falloff function.
 #define FLARE_STDCOEFF "150"
 extern cvar_t	*r_flareCoeff;
+extern cvar_t	*r_flareQueries;
 
 extern cvar_t	*r_railWidth;
 extern cvar_t	*r_railCoreWidth;
@@ -1699,9 +1849,14 @@ extern	cvar_t	*r_norefresh;			// bypasses the ref rendering
 extern	cvar_t	*r_drawentities;		// disable/enable entity rendering
 extern	cvar_t	*r_drawworld;			// disable/enable world rendering
 extern	cvar_t	*r_speeds;				// various levels of information display
+extern	cvar_t	*r_profile;				// 1 = record frame timings for profiledump, 2 = also draw them
+extern	cvar_t	*r_dynamicResolution;	// GPU msec to hold by scaling the scene resolution, 0 = off
+extern	cvar_t	*r_dynamicResolutionMin;	// bounds of the scale
+extern	cvar_t	*r_dynamicResolutionMax;
 extern  cvar_t	*r_detailTextures;		// enables/disables detail texturing stages
 extern	cvar_t	*r_novis;				// disable/enable usage of PVS
 extern	cvar_t	*r_nocull;
+extern	cvar_t	*r_occlusionCull;		// skip leafs and entities that GL occlusion queries found hidden
 extern	cvar_t	*r_facePlaneCull;		// enables culling of planar surfaces with back side test
 extern	cvar_t	*r_nocurves;
 extern	cvar_t	*r_showcluster;
@@ -1714,6 +1869,8 @@ extern  cvar_t  *r_ext_texture_float;
 extern  cvar_t  *r_ext_framebuffer_multisample;
 extern  cvar_t  *r_arb_seamless_cube_map;
 extern  cvar_t  *r_arb_vertex_array_object;
+extern  cvar_t  *r_arb_buffer_storage;
+extern  cvar_t  *r_arb_pixel_buffer_object;
 extern  cvar_t  *r_ext_direct_state_access;
 
 extern	cvar_t	*r_nobind;						// turns off binding to appropriate textures
@@ -1744,6 +1901,7 @@ extern	cvar_t	*r_intensity;
 
 extern	cvar_t	*r_lockpvs;
 extern	cvar_t	*r_noportals;
+extern	cvar_t	*r_simd;						// SSE2/NEON versions of the CPU deforms
 extern	cvar_t	*r_portalOnly;
 
 extern	cvar_t	*r_subdivisions;
@@ -1753,6 +1911,8 @@ extern	cvar_t	*r_skipBackEnd;
 extern	cvar_t	*r_anaglyphMode;
 
 extern  cvar_t  *r_externalGLSL;
+extern  cvar_t  *r_glslCache;
+extern  cvar_t  *r_imageCache;
 
 extern  cvar_t  *r_hdr;
 extern  cvar_t  *r_floatLightmap;
@@ -1781,6 +1941,7 @@ extern  cvar_t  *r_parallaxMapping;
 extern  cvar_t  *r_parallaxMapShadows;
 extern  cvar_t  *r_cubeMapping;
 extern  cvar_t  *r_cubemapSize;
+extern  cvar_t  *r_cubemapCache;
 extern  cvar_t  *r_deluxeSpecular;
 extern  cvar_t  *r_pbr;
 extern  cvar_t  *r_baseNormalX;
@@ -1792,6 +1953,7 @@ extern  cvar_t  *r_glossType;
 extern  cvar_t  *r_dlightMode;
 extern  cvar_t  *r_pshadowDist;
 extern  cvar_t  *r_mergeLightmaps;
+extern  cvar_t  *r_lightmapArray;
 extern  cvar_t  *r_imageUpsample;
 extern  cvar_t  *r_imageUpsampleMaxSize;
 extern  cvar_t  *r_imageUpsampleType;
@@ -1808,6 +1970,8 @@ extern  cvar_t  *r_shadowMapSize;
 extern  cvar_t  *r_shadowCascadeZNear;
 extern  cvar_t  *r_shadowCascadeZFar;
 extern  cvar_t  *r_shadowCascadeZBias;
+extern  cvar_t  *r_shadowCascadeCache;
+extern  cvar_t  *r_shadowCascadeCacheTexels;
 extern  cvar_t  *r_ignoreDstAlpha;
 
 extern	cvar_t	*r_greyscale;
@@ -1819,6 +1983,7 @@ extern	cvar_t	*r_mapOverBrightBits;
 
 extern	cvar_t	*r_debugSurface;
 extern	cvar_t	*r_simpleMipMaps;
+extern	cvar_t	*r_prefetchImages;		// MB of JPEGs to decode on the worker threads at map load
 
 extern	cvar_t	*r_showImages;
 extern	cvar_t	*r_debugSort;
@@ -1963,6 +2128,8 @@ model_t		*R_AllocModel( void );
 
 void    	R_Init( void );
 void		R_UpdateSubImage( image_t *image, byte *pic, int x, int y, int width, int height, GLenum picFormat );
+image_t		*R_CreateImageArray( const char *name, int width, int height, int layers, imgType_t type, imgFlags_t flags, int internalFormat );
+void		R_UpdateImageLayer( image_t *image, byte *pic, int layer, int x, int y, int width, int height, GLenum picFormat );
 
 void		R_SetColorMappings( void );
 void		R_GammaCorrect( byte *buffer, int bufSize );
@@ -1978,17 +2145,23 @@ float	R_FogFactor( float s, float t );
 void	R_InitImages( void );
 void	R_DeleteTextures( void );
 int		R_SumOfUsedImages( void );
+unsigned int R_HashBytes( unsigned int hash, const byte *data, int length );
 void	R_InitSkins( void );
 skin_t	*R_GetSkinByHandle( qhandle_t hSkin );
 
 int R_ComputeLOD( trRefEntity_t *ent );
 
 const void *RB_TakeVideoFrameCmd( const void *data );
+void RB_FinishVideoFrames( byte *captureBuffer );
+void RB_FinishScreenshotReadbacks( qboolean all );
+void RB_SaveCubemap( cubemap_t *cubemap, const char *filename );
+void R_ShutdownPixelBuffers( void );
 
 //
 // tr_shader.c
 //
 shader_t	*R_FindShader( const char *name, int lightmapIndex, qboolean mipRawImage );
+void		R_PrefetchShaderImages( const dshader_t *shaders, int numShaders );
 shader_t	*R_GetShaderByHandle( qhandle_t hShader );
 shader_t	*R_GetShaderByState( int index, long *cycleTime );
 shader_t *R_FindShaderByName( const char *name );
@@ -2091,6 +2264,7 @@ WORLD MAP
 
 void R_AddBrushModelSurfaces( trRefEntity_t *e );
 void R_AddWorldSurfaces( void );
+qboolean R_EntityOccluded( const trRefEntity_t *ent );
 qboolean R_inPVS( const vec3_t p1, const vec3_t p2 );
 
 
@@ -2111,6 +2285,51 @@ void RB_RenderFlares (void);
 /*
 ============================================================
 
+PROFILING, see tr_profile.c
+
+============================================================
+*/
+
+// where a frame's time goes, front end stages are CPU only
+typedef enum {
+	PROF_ENGINE,		// outside the renderer: client, cgame, input, sound
+	PROF_SCENE,			// RE_RenderScene besides the stages below
+	PROF_WORLD,			// R_AddWorldSurfaces
+	PROF_ENTITIES,		// R_AddPolygonSurfaces and R_AddEntitySurfaces
+	PROF_SORT,			// R_RadixSort of the draw surfaces
+	PROF_VIEWS,			// back end RC_DRAW_SURFS and RC_CAPSHADOWMAP
+	PROF_POSTPROCESS,	// back end RC_POSTPROCESS
+	PROF_2D,			// every other back end command
+	PROF_SWAP,			// back end RC_SWAP_BUFFERS, includes the driver's present
+	PROF_NUM_STAGES
+} profStage_t;
+
+void R_InitProfile( void );
+void R_ShutdownProfile( void );
+profStage_t R_ProfileStage( profStage_t stage );
+void R_ProfileEndFrame( void );
+void R_ProfileGraph( void );
+void R_ProfilePrint( void );
+void R_ProfileDump_f( void );
+qboolean R_ProfileGPUFrameTime( int *frameNum, int *usec );
+
+/*
+============================================================
+
+DYNAMIC RESOLUTION, see tr_dynres.c
+
+============================================================
+*/
+
+void R_InitDynamicResolution( void );
+void R_ShutdownDynamicResolution( void );
+void RB_DynamicResolutionBeginFrame( void );
+void RB_DynamicResolutionEndFrame( void );
+void R_DynamicResolutionViewport( viewParms_t *parms );
+
+/*
+============================================================
+
 LIGHTS
 
 ============================================================
@@ -2164,6 +2383,7 @@ void R_SubdividePatchToGrid( srfBspSurface_t *grid, int width, int height,
 								srfVert_t points[MAX_PATCH_SIZE*MAX_PATCH_SIZE] );
 void R_GridInsertColumn( srfBspSurface_t *grid, int column, int row, vec3_t point, float loderror );
 void R_GridInsertRow( srfBspSurface_t *grid, int row, int column, vec3_t point, float loderror );
+void R_CreateGridLods( srfBspSurface_t *grid );
 
 /*
 ============================================================
@@ -2193,6 +2413,7 @@ void R_VaoUnpackNormal(vec3_t v, int16_t *pack);
 
 vao_t          *R_CreateVao(const char *name, byte *vertexes, int vertexesSize, byte *indexes, int indexesSize, vaoUsage_t usage);
 vao_t          *R_CreateVao2(const char *name, int numVertexes, srfVert_t *verts, int numIndexes, glIndex_t *inIndexes);
+vao_t          *R_CreateModelVao(const char *name, byte *vertexes, int vertexesSize, byte *indexes, int indexesSize);
 
 void            R_BindVao(vao_t *vao);
 void            R_BindNullVao(void);
@@ -2204,6 +2425,7 @@ void            R_ShutdownVaos(void);
 void            R_VaoList_f(void);
 
 void            RB_UpdateTessVao(unsigned int attribBits);
+void            RB_TessRingEndFrame(void);
 
 void VaoCache_Commit(void);
 void VaoCache_Init(void);
@@ -2235,6 +2457,7 @@ void GLSL_SetUniformVec3(shaderProgram_t *program, int uniformNum, const vec3_t
 void GLSL_SetUniformVec4(shaderProgram_t *program, int uniformNum, const vec4_t v);
 void GLSL_SetUniformMat4(shaderProgram_t *program, int uniformNum, const mat4_t matrix);
 void GLSL_SetUniformMat4BoneMatrix(shaderProgram_t *program, int uniformNum, /*const*/ mat4_t *matrix, int numMatricies);
+void GLSL_SetUniformVec4Dlights(shaderProgram_t *program, int uniformNum, const vec4_t *v, int numDlights);
 
 shaderProgram_t *GLSL_GetGenericShaderProgram(int stage);
 
@@ -2286,10 +2509,13 @@ ANIMATED MODELS
 
 void R_MDRAddAnimSurfaces( trRefEntity_t *ent );
 void RB_MDRSurfaceAnim( mdrSurface_t *surface );
+void R_MDRCreateVaoSurfaces( model_t *mod );
+void RB_MDRSurfaceAnimVao( srfVaoMdrSurface_t *surface );
 qboolean R_LoadIQM (model_t *mod, void *buffer, int filesize, const char *name );
 void R_AddIQMSurfaces( trRefEntity_t *ent );
 void RB_IQMSurfaceAnim( surfaceType_t *surface );
 void RB_IQMSurfaceAnimVao( srfVaoIQModel_t *surface );
+void R_ClearIQMPoseCache( void );
 int R_IQMLerpTag( orientation_t *tag, iqmData_t *data,
                   int startFrame, int endFrame,
                   float frac, const char *tagName );
@@ -2302,6 +2528,7 @@ void	R_TransformModelToClip( const vec3_t src, const float *modelMatrix, const f
 							vec4_t eye, vec4_t dst );
 void	R_TransformClipToWindow( const vec4_t clip, const viewParms_t *view, vec4_t normalized, vec4_t window );
 
+void	RB_InitTessCalc( void );
 void	RB_DeformTessGeometry( void );
 
 void	RB_CalcFogTexCoords( float *dstTexCoords );
@@ -2378,6 +2605,13 @@ typedef struct {
 	float	s2, t2;
 } stretchPicCommand_t;
 
+typedef struct {
+	int		commandId;
+	shader_t	*shader;
+	int		numPics;
+	// followed by numPics stretchPic_t
+} stretchPicsCommand_t;
+
 typedef struct {
 	int		commandId;
 	trRefdef_t	refdef;
@@ -2401,8 +2635,6 @@ typedef struct {
 	int						width;
 	int						height;
 	byte					*captureBuffer;
-	byte					*encodeBuffer;
-	qboolean			motionJpeg;
 } videoFrameCommand_t;
 
 typedef struct
@@ -2437,6 +2669,7 @@ typedef enum {
 	RC_END_OF_LIST,
 	RC_SET_COLOR,
 	RC_STRETCH_PIC,
+	RC_STRETCH_PICS,
 	RC_DRAW_SURFS,
 	RC_DRAW_BUFFER,
 	RC_SWAP_BUFFERS,
@@ -2486,14 +2719,15 @@ void R_AddPostProcessCmd (void);
 void RE_SetColor( const float *rgba );
 void RE_StretchPic ( float x, float y, float w, float h, 
 					  float s1, float t1, float s2, float t2, qhandle_t hShader );
+void RE_StretchPics( const stretchPic_t *pics, int numPics, qhandle_t hShader );
 void RE_BeginFrame( stereoFrame_t stereoFrame );
 void RE_EndFrame( int *frontEndMsec, int *backEndMsec );
 void RE_SaveJPG(char * filename, int quality, int image_width, int image_height,
                 unsigned char *image_buffer, int padding);
 size_t RE_SaveJPGToBuffer(byte *buffer, size_t bufSize, int quality,
 		          int image_width, int image_height, byte *image_buffer, int padding);
-void RE_TakeVideoFrame( int width, int height,
-		byte *captureBuffer, byte *encodeBuffer, qboolean motionJpeg );
+void RE_TakeVideoFrame( int width, int height, byte *captureBuffer );
+void RE_FinishVideoFrames( byte *captureBuffer );
 
 
 #endif //TR_LOCAL_H
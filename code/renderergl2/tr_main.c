@@ -290,26 +290,23 @@ Returns CULL_IN, CULL_CLIP, or CULL_OUT
 */
 int R_CullBox(vec3_t worldBounds[2]) {
 	int             i;
-	cplane_t       *frust;
 	qboolean        anyClip;
-	int             r, numPlanes;
+	int             sides[5], numPlanes;
 
 	numPlanes = (tr.viewParms.flags & VPF_FARPLANEFRUSTUM) ? 5 : 4;
 
 	// check against frustum planes
+	qmath.BoxOnPlaneSides(worldBounds[0], worldBounds[1], tr.viewParms.frustum, numPlanes, sides);
+
 	anyClip = qfalse;
 	for(i = 0; i < numPlanes; i++)
 	{
-		frust = &tr.viewParms.frustum[i];
-
-		r = BoxOnPlaneSide(worldBounds[0], worldBounds[1], frust);
-
-		if(r == 2)
+		if(sides[i] == 2)
 		{
 			// completely outside frustum
 			return CULL_OUT;
 		}
-		if(r == 3)
+		if(sides[i] == 3)
 		{
 			anyClip = qtrue;
 		}
@@ -1191,12 +1188,44 @@ static qboolean IsMirror( const drawSurf_t *drawSurf, int entityNum )
 	return qfalse;
 }
 
+/*
+** R_PortalScissor
+**
+** The window rectangle a portal surface covers in the current view, from
+** the normalized device coordinates of its vertexes.
+*/
+static void R_PortalScissor( const vec2_t mins, const vec2_t maxs, int scissor[4] ) {
+	const viewParms_t *vp = &tr.viewParms;
+	int		x0, y0, x1, y1;
+
+	// a pixel of slack for the rounding of the rasterizer
+	x0 = floor( ( Com_Clamp( -1, 1, mins[0] ) * 0.5f + 0.5f ) * vp->viewportWidth ) - 1;
+	y0 = floor( ( Com_Clamp( -1, 1, mins[1] ) * 0.5f + 0.5f ) * vp->viewportHeight ) - 1;
+	x1 = ceil( ( Com_Clamp( -1, 1, maxs[0] ) * 0.5f + 0.5f ) * vp->viewportWidth ) + 1;
+	y1 = ceil( ( Com_Clamp( -1, 1, maxs[1] ) * 0.5f + 0.5f ) * vp->viewportHeight ) + 1;
+
+	if ( x0 < 0 )
+		x0 = 0;
+	if ( y0 < 0 )
+		y0 = 0;
+	if ( x1 > vp->viewportWidth )
+		x1 = vp->viewportWidth;
+	if ( y1 > vp->viewportHeight )
+		y1 = vp->viewportHeight;
+
+	scissor[0] = vp->viewportX + x0;
+	scissor[1] = vp->viewportY + y0;
+	scissor[2] = x1 - x0;
+	scissor[3] = y1 - y0;
+}
+
 /*
 ** SurfIsOffscreen
 **
-** Determines if a surface is completely offscreen.
+** Determines if a surface is completely offscreen. scissor gets the window
+** rectangle it covers, 0 width if it can't be bounded.
 */
-static qboolean SurfIsOffscreen( const drawSurf_t *drawSurf, vec4_t clipDest[128] ) {
+static qboolean SurfIsOffscreen( const drawSurf_t *drawSurf, vec4_t clipDest[128], int scissor[4] ) {
 	float shortest = 100000000;
 	int entityNum;
 	int numTriangles;
@@ -1208,6 +1237,11 @@ static qboolean SurfIsOffscreen( const drawSurf_t *drawSurf, vec4_t clipDest[128
 	int i;
 	unsigned int pointOr = 0;
 	unsigned int pointAnd = (unsigned int)~0;
+	vec2_t mins, maxs;
+	qboolean behind = qfalse;
+
+	mins[0] = mins[1] = 1.0f;
+	maxs[0] = maxs[1] = -1.0f;
 
 	R_RotateForViewer();
 
@@ -1237,6 +1271,22 @@ static qboolean SurfIsOffscreen( const drawSurf_t *drawSurf, vec4_t clipDest[128
 		}
 		pointAnd &= pointFlags;
 		pointOr |= pointFlags;
+
+		// a vertex behind the viewer projects to the wrong side
+		if ( clip[3] <= 0.0f )
+		{
+			behind = qtrue;
+			continue;
+		}
+		for ( j = 0; j < 2; j++ )
+		{
+			float ndc = clip[j] / clip[3];
+
+			if ( ndc < mins[j] )
+				mins[j] = ndc;
+			if ( ndc > maxs[j] )
+				maxs[j] = ndc;
+		}
 	}
 
 	// trivially reject
@@ -1245,6 +1295,15 @@ static qboolean SurfIsOffscreen( const drawSurf_t *drawSurf, vec4_t clipDest[128
 		return qtrue;
 	}
 
+	if ( behind || r_portalOnly->integer )
+	{
+		scissor[0] = scissor[1] = scissor[2] = scissor[3] = 0;
+	}
+	else
+	{
+		R_PortalScissor( mins, maxs, scissor );
+	}
+
 	// determine if this surface is backfaced and also determine the distance
 	// to the nearest vertex so we can cull based on portal range.  Culling
 	// based on vertex distance isn't 100% correct (we should be checking for
@@ -1302,6 +1361,7 @@ Returns qtrue if another view has been rendered
 */
 qboolean R_MirrorViewBySurface (drawSurf_t *drawSurf, int entityNum) {
 	vec4_t			clipDest[128];
+	int				scissor[4];
 	viewParms_t		newParms;
 	viewParms_t		oldParms;
 	orientation_t	surface, camera;
@@ -1317,7 +1377,7 @@ qboolean R_MirrorViewBySurface (drawSurf_t *drawSurf, int entityNum) {
 	}
 
 	// trivially reject portal/mirror
-	if ( SurfIsOffscreen( drawSurf, clipDest ) ) {
+	if ( SurfIsOffscreen( drawSurf, clipDest, scissor ) ) {
 		return qfalse;
 	}
 
@@ -1345,7 +1405,11 @@ qboolean R_MirrorViewBySurface (drawSurf_t *drawSurf, int entityNum) {
 	R_MirrorVector (oldParms.or.axis[1], &surface, &camera, newParms.or.axis[1]);
 	R_MirrorVector (oldParms.or.axis[2], &surface, &camera, newParms.or.axis[2]);
 
-	// OPTIMIZE: restrict the viewport on the mirrored view
+	// only the pixels under the portal surface are going to be seen
+	newParms.scissorX = scissor[0];
+	newParms.scissorY = scissor[1];
+	newParms.scissorWidth = scissor[2];
+	newParms.scissorHeight = scissor[3];
 
 	// render the mirror view
 	R_RenderView (&newParms);
@@ -1405,50 +1469,74 @@ DRAWSURF SORTING
 R_Radix
 ===============
 */
-static ID_INLINE void R_Radix( int byte, int size, drawSurf_t *source, drawSurf_t *dest )
+static ID_INLINE void R_Radix( int shift, const int *count, int size, const drawSurf_t *source, drawSurf_t *dest )
 {
-  int           count[ 256 ] = { 0 };
   int           index[ 256 ];
   int           i;
-  unsigned char *sortKey = NULL;
-  unsigned char *end = NULL;
-
-  sortKey = ( (unsigned char *)&source[ 0 ].sort ) + byte;
-  end = sortKey + ( size * sizeof( drawSurf_t ) );
-  for( ; sortKey < end; sortKey += sizeof( drawSurf_t ) )
-    ++count[ *sortKey ];
 
   index[ 0 ] = 0;
 
   for( i = 1; i < 256; ++i )
     index[ i ] = index[ i - 1 ] + count[ i - 1 ];
 
-  sortKey = ( (unsigned char *)&source[ 0 ].sort ) + byte;
-  for( i = 0; i < size; ++i, sortKey += sizeof( drawSurf_t ) )
-    dest[ index[ *sortKey ]++ ] = source[ i ];
+  for( i = 0; i < size; ++i )
+    dest[ index[ ( source[ i ].sort >> shift ) & 0xff ]++ ] = source[ i ];
 }
 
 /*
 ===============
 R_RadixSort
 
-Radix sort with 4 byte size buckets
+Radix sort with 4 byte size buckets. The counts for all four bytes are
+taken in a single pass over the keys, bytes that are the same in every
+key are skipped (usually the fog and dlight bits, and the high shader
+bits), and a view that is already in order is not touched at all.
 ===============
 */
 static void R_RadixSort( drawSurf_t *source, int size )
 {
   static drawSurf_t scratch[ MAX_DRAWSURFS ];
-#ifdef Q3_LITTLE_ENDIAN
-  R_Radix( 0, size, source, scratch );
-  R_Radix( 1, size, scratch, source );
-  R_Radix( 2, size, source, scratch );
-  R_Radix( 3, size, scratch, source );
-#else
-  R_Radix( 3, size, source, scratch );
-  R_Radix( 2, size, scratch, source );
-  R_Radix( 1, size, source, scratch );
-  R_Radix( 0, size, scratch, source );
-#endif //Q3_LITTLE_ENDIAN
+  int           count[ 4 ][ 256 ];
+  drawSurf_t    *from, *to, *swap;
+  unsigned      sort, last;
+  qboolean      sorted;
+  int           i, pass;
+
+  Com_Memset( count, 0, sizeof( count ) );
+
+  sorted = qtrue;
+  last = 0;
+  for( i = 0; i < size; ++i )
+  {
+    sort = source[ i ].sort;
+    if( sort < last )
+      sorted = qfalse;
+    last = sort;
+
+    ++count[ 0 ][ sort & 0xff ];
+    ++count[ 1 ][ ( sort >> 8 ) & 0xff ];
+    ++count[ 2 ][ ( sort >> 16 ) & 0xff ];
+    ++count[ 3 ][ sort >> 24 ];
+  }
+
+  if( sorted )
+    return;
+
+  from = source;
+  to = scratch;
+  for( pass = 0; pass < 4; ++pass )
+  {
+    if( count[ pass ][ ( source[ 0 ].sort >> ( pass * 8 ) ) & 0xff ] == size )
+      continue;
+
+    R_Radix( pass * 8, count[ pass ], size, from, to );
+    swap = from;
+    from = to;
+    to = swap;
+  }
+
+  if( from != source )
+    Com_Memcpy( source, from, size * sizeof( *source ) );
 }
 
 //==========================================================================================
@@ -1501,6 +1589,7 @@ void R_SortDrawSurfs( drawSurf_t *drawSurfs, int numDrawSurfs ) {
 	int				dlighted;
 	int             pshadowed;
 	int				i;
+	profStage_t		stage;
 
 	//ri.Printf(PRINT_ALL, "firstDrawSurf %d numDrawSurfs %d\n", (int)(drawSurfs - tr.refdef.drawSurfs), numDrawSurfs);
 
@@ -1512,7 +1601,9 @@ void R_SortDrawSurfs( drawSurf_t *drawSurfs, int numDrawSurfs ) {
 	}
 
 	// sort the drawsurfs by sort type, then orientation, then shader
+	stage = R_ProfileStage( PROF_SORT );
 	R_RadixSort( drawSurfs, numDrawSurfs );
+	R_ProfileStage( stage );
 
 	// skip pass through drawing if rendering a shadow map
 	if (tr.viewParms.flags & (VPF_SHADOWMAP | VPF_DEPTHSHADOW))
@@ -1597,6 +1688,8 @@ static void R_AddEntitySurface (int entityNum)
 		tr.currentModel = R_GetModelByHandle( ent->e.hModel );
 		if (!tr.currentModel) {
 			R_AddDrawSurf( &entitySurface, tr.defaultShader, 0, 0, 0, 0 /*cubeMap*/  );
+		} else if ( (tr.viewParms.flags & VPF_OCCLUSIONCULL) && R_EntityOccluded( ent ) ) {
+			tr.pc.c_occludedEntities++;
 		} else {
 			switch ( tr.currentModel->type ) {
 			case MOD_MESH:
@@ -1651,8 +1744,12 @@ R_GenerateDrawSurfs
 ====================
 */
 void R_GenerateDrawSurfs( void ) {
+	profStage_t	stage;
+
+	stage = R_ProfileStage( PROF_WORLD );
 	R_AddWorldSurfaces ();
 
+	R_ProfileStage( PROF_ENTITIES );
 	R_AddPolygonSurfaces();
 
 	// set the projection matrix with the minimum zfar
@@ -1671,6 +1768,7 @@ void R_GenerateDrawSurfs( void ) {
 	R_SetupProjectionZ (&tr.viewParms);
 
 	R_AddEntitySurfaces ();
+	R_ProfileStage( stage );
 }
 
 /*
@@ -2202,6 +2300,47 @@ static float CalcSplit(float n, float f, float i, float m)
 }
 
 
+/*
+================
+R_AddSunShadowView
+
+Adds the world and/or the entities of one sun shadow cascade
+================
+*/
+static void R_AddSunShadowView(const viewParms_t *shadowParms, vec3_t lightviewBounds[2], qboolean world, qboolean entities)
+{
+	int firstDrawSurf;
+
+	tr.viewCount++;
+
+	tr.viewParms = *shadowParms;
+	tr.viewParms.frameSceneNum = tr.frameSceneNum;
+	tr.viewParms.frameCount = tr.frameCount;
+
+	firstDrawSurf = tr.refdef.numDrawSurfs;
+
+	tr.viewCount++;
+
+	// set viewParms.world
+	R_RotateForViewer ();
+
+	R_SetupProjectionOrtho(&tr.viewParms, lightviewBounds);
+
+	if (world)
+	{
+		R_AddWorldSurfaces ();
+	}
+
+	if (entities)
+	{
+		R_AddPolygonSurfaces();
+
+		R_AddEntitySurfaces ();
+	}
+
+	R_SortDrawSurfs( tr.refdef.drawSurfs + firstDrawSurf, tr.refdef.numDrawSurfs - firstDrawSurf );
+}
+
 void R_RenderSunShadowMaps(const refdef_t *fd, int level)
 {
 	viewParms_t		shadowParms;
@@ -2212,6 +2351,7 @@ void R_RenderSunShadowMaps(const refdef_t *fd, int level)
 	float viewZNear, viewZFar;
 	vec3_t lightviewBounds[2];
 	qboolean lightViewIndependentOfCameraView = qfalse;
+	qboolean cacheStatic = (r_shadowCascadeCache->integer && tr.sunShadowCacheFbo[level]);
 
 	if (r_forceSun->integer == 2)
 	{
@@ -2273,15 +2413,18 @@ void R_RenderSunShadowMaps(const refdef_t *fd, int level)
 			break;
 	}
 	
-	if (level != 3)
-		VectorCopy(fd->vieworg, lightOrigin);
-	else
+	// cached cascades need a light view that doesn't follow the camera
+	if (level == 3)
 		VectorCopy(tr.world->lightGridOrigin, lightOrigin);
+	else if (cacheStatic)
+		VectorClear(lightOrigin);
+	else
+		VectorCopy(fd->vieworg, lightOrigin);
 
 	// Make up a projection
 	VectorScale(lightDir, -1.0f, lightViewAxis[0]);
 
-	if (level == 3 || lightViewIndependentOfCameraView)
+	if (level == 3 || lightViewIndependentOfCameraView || cacheStatic)
 	{
 		// Use world up as light view up
 		VectorSet(lightViewAxis[2], 0, 0, 1);
@@ -2301,7 +2444,7 @@ void R_RenderSunShadowMaps(const refdef_t *fd, int level)
 	// Check if too close to parallel to light direction
 	if (fabsf(DotProduct(lightViewAxis[2], lightViewAxis[0])) > 0.9f)
 	{
-		if (level == 3 || lightViewIndependentOfCameraView)
+		if (level == 3 || lightViewIndependentOfCameraView || cacheStatic)
 		{
 			// Use world left as light view up
 			VectorSet(lightViewAxis[2], 0, 1, 0);
@@ -2338,7 +2481,41 @@ void R_RenderSunShadowMaps(const refdef_t *fd, int level)
 
 		ClearBounds(lightviewBounds[0], lightviewBounds[1]);
 
-		if (level != 3)
+		if (level != 3 && cacheStatic)
+		{
+			// fit the slice in a sphere so the bounds don't change as the view turns,
+			// then grow it by r_shadowCascadeCacheTexels and snap it to a grid of
+			// that many texels so it only changes when the view crosses a grid line
+			float mid, radius, farRadius, step, extent;
+			int width = tr.sunShadowFbo[level]->width;
+			int texels = CLAMP(r_shadowCascadeCacheTexels->integer, 1, width / 2);
+			int i;
+
+			mid = (splitZNear + splitZFar) * 0.5f;
+
+			lx = splitZNear * tan(fd->fov_x * M_PI / 360.0f);
+			ly = splitZNear * tan(fd->fov_y * M_PI / 360.0f);
+			radius = sqrt((mid - splitZNear) * (mid - splitZNear) + lx * lx + ly * ly);
+
+			lx = splitZFar * tan(fd->fov_x * M_PI / 360.0f);
+			ly = splitZFar * tan(fd->fov_y * M_PI / 360.0f);
+			farRadius = sqrt((splitZFar - mid) * (splitZFar - mid) + lx * lx + ly * ly);
+
+			radius = MAX(radius, farRadius);
+
+			VectorMA(fd->vieworg, mid, fd->viewaxis[0], point);
+			Mat4Transform(lightViewMatrix, point, lightViewPoint);
+
+			step = 2.0f * radius * texels / (width - texels);
+			extent = 2.0f * radius + step;
+
+			for (i = 0; i < 3; i++)
+			{
+				lightviewBounds[0][i] = floor((lightViewPoint[i] - radius) / step) * step;
+				lightviewBounds[1][i] = lightviewBounds[0][i] + extent;
+			}
+		}
+		else if (level != 3)
 		{
 			// add view near plane
 			lx = splitZNear * tan(fd->fov_x * M_PI / 360.0f);
@@ -2483,8 +2660,6 @@ void R_RenderSunShadowMaps(const refdef_t *fd, int level)
 	}
 
 	{
-		int firstDrawSurf;
-
 		Com_Memset( &shadowParms, 0, sizeof( shadowParms ) );
 
 		if (glRefConfig.framebufferObject)
@@ -2519,29 +2694,36 @@ void R_RenderSunShadowMaps(const refdef_t *fd, int level)
 
 		VectorCopy(lightOrigin, shadowParms.pvsOrigin );
 
+		if (cacheStatic)
 		{
-			tr.viewCount++;
-
-			tr.viewParms = shadowParms;
-			tr.viewParms.frameSceneNum = tr.frameSceneNum;
-			tr.viewParms.frameCount = tr.frameCount;
-
-			firstDrawSurf = tr.refdef.numDrawSurfs;
+			sunShadowCache_t *cache = &tr.sunShadowCache[level];
 
-			tr.viewCount++;
-
-			// set viewParms.world
-			R_RotateForViewer ();
-
-			R_SetupProjectionOrtho(&tr.viewParms, lightviewBounds);
-
-			R_AddWorldSurfaces ();
+			// a point outside the world has no pvs, so the cached world doesn't depend on the view cluster
+			if (level != 3)
+				VectorSet(shadowParms.pvsOrigin, tr.world->nodes[0].mins[0] - 64, tr.world->nodes[0].mins[1] - 64, tr.world->nodes[0].mins[2] - 64);
 
-			R_AddPolygonSurfaces();
+			shadowParms.shadowCacheFbo = tr.sunShadowCacheFbo[level];
 
-			R_AddEntitySurfaces ();
+			if (!cache->valid || tr.refdef.areamaskModified || !VectorCompare(cache->lightDir, lightDir)
+				|| !VectorCompare(cache->bounds[0], lightviewBounds[0]) || !VectorCompare(cache->bounds[1], lightviewBounds[1]))
+			{
+				shadowParms.flags |= VPF_SHADOWCACHESTORE;
+				R_AddSunShadowView(&shadowParms, lightviewBounds, qtrue, qfalse);
+				shadowParms.flags &= ~VPF_SHADOWCACHESTORE;
+
+				cache->valid = qtrue;
+				VectorCopy(lightDir, cache->lightDir);
+				VectorCopy(lightviewBounds[0], cache->bounds[0]);
+				VectorCopy(lightviewBounds[1], cache->bounds[1]);
+			}
 
-			R_SortDrawSurfs( tr.refdef.drawSurfs + firstDrawSurf, tr.refdef.numDrawSurfs - firstDrawSurf );
+			// entities go on top of the cached world every frame
+			shadowParms.flags |= VPF_SHADOWCACHELOAD;
+			R_AddSunShadowView(&shadowParms, lightviewBounds, qfalse, qtrue);
+		}
+		else
+		{
+			R_AddSunShadowView(&shadowParms, lightviewBounds, qtrue, qtrue);
 		}
 
 		Mat4Multiply(tr.viewParms.projectionMatrix, tr.viewParms.world.modelMatrix, tr.refdef.sunShadowMvp[level]);
@@ -249,6 +249,29 @@ void R_AddMarkFragments(int numClipPoints, vec3_t clipPoints[2][MAX_VERTS_ON_POL
 	(*returnedFragments)++;
 }
 
+/*
+=================
+R_MarkTriangleCulled
+
+All three points are outside one side of the box, so chopping
+the triangle with the mark planes can't leave anything
+=================
+*/
+static qboolean R_MarkTriangleCulled( vec3_t points[3], const vec3_t mins, const vec3_t maxs ) {
+	int		j;
+
+	for ( j = 0 ; j < 3 ; j++ ) {
+		if ( points[0][j] < mins[j] && points[1][j] < mins[j] && points[2][j] < mins[j] ) {
+			return qtrue;
+		}
+		if ( points[0][j] > maxs[j] && points[1][j] > maxs[j] && points[2][j] > maxs[j] ) {
+			return qtrue;
+		}
+	}
+
+	return qfalse;
+}
+
 /*
 =================
 R_MarkFragments
@@ -274,6 +297,7 @@ int R_MarkFragments( int numPoints, const vec3_t *points, const vec3_t projectio
 	vec3_t			normal;
 	vec3_t			projectionDir;
 	vec3_t			v1, v2;
+	vec3_t			cullMins, cullMaxs;
 
 	if (numPoints <= 0) {
 		return 0;
@@ -315,6 +339,23 @@ int R_MarkFragments( int numPoints, const vec3_t *points, const vec3_t projectio
 	dists[numPoints+1] = DotProduct(normals[numPoints+1], points[0]) - 20;
 	numPlanes = numPoints + 2;
 
+	// bounds of the prism the planes cut out, the ends of each point's
+	// projection line between the near and far planes
+	ClearBounds( cullMins, cullMaxs );
+	for ( i = 0 ; i < numPoints ; i++ ) {
+		vec3_t	temp;
+		float	d = DotProduct( normals[numPoints], points[i] );
+
+		VectorMA( points[i], dists[numPoints] - d, normals[numPoints], temp );
+		AddPointToBounds( temp, cullMins, cullMaxs );
+		VectorMA( points[i], -dists[numPoints+1] - d, normals[numPoints], temp );
+		AddPointToBounds( temp, cullMins, cullMaxs );
+	}
+	for ( j = 0 ; j < 3 ; j++ ) {
+		cullMins[j] -= 1.0f;
+		cullMaxs[j] += 1.0f;
+	}
+
 	numsurfaces = 0;
 	R_BoxSurfaces_r(tr.world->nodes, mins, maxs, surfaces, 64, &numsurfaces, projectionDir);
 	//assert(numsurfaces <= 64);
@@ -370,7 +411,7 @@ int R_MarkFragments( int numPoints, const vec3_t *points, const vec3_t projectio
 					VectorSubtract(clipPoints[0][2], clipPoints[0][1], v2);
 					CrossProduct(v1, v2, normal);
 					VectorNormalizeFast(normal);
-					if (DotProduct(normal, projectionDir) < -0.1) {
+					if (DotProduct(normal, projectionDir) < -0.1 && !R_MarkTriangleCulled(clipPoints[0], cullMins, cullMaxs)) {
 						// add the fragments of this triangle
 						R_AddMarkFragments(numClipPoints, clipPoints,
 										   numPlanes, normals, dists,
@@ -397,7 +438,7 @@ int R_MarkFragments( int numPoints, const vec3_t *points, const vec3_t projectio
 					VectorSubtract(clipPoints[0][2], clipPoints[0][1], v2);
 					CrossProduct(v1, v2, normal);
 					VectorNormalizeFast(normal);
-					if (DotProduct(normal, projectionDir) < -0.05) {
+					if (DotProduct(normal, projectionDir) < -0.05 && !R_MarkTriangleCulled(clipPoints[0], cullMins, cullMaxs)) {
 						// add the fragments of this triangle
 						R_AddMarkFragments(numClipPoints, clipPoints,
 										   numPlanes, normals, dists,
@@ -429,6 +470,10 @@ int R_MarkFragments( int numPoints, const vec3_t *points, const vec3_t projectio
 					VectorMA(v, MARKER_OFFSET, surf->cullPlane.normal, clipPoints[0][j]);
 				}
 
+				if ( R_MarkTriangleCulled( clipPoints[0], cullMins, cullMaxs ) ) {
+					continue;
+				}
+
 				// add the fragments of this face
 				R_AddMarkFragments( 3 , clipPoints,
 								   numPlanes, normals, dists,
@@ -454,6 +499,10 @@ int R_MarkFragments( int numPoints, const vec3_t *points, const vec3_t projectio
 					VectorMA(v, MARKER_OFFSET, fNormal, clipPoints[0][j]);
 				}
 
+				if ( R_MarkTriangleCulled( clipPoints[0], cullMins, cullMaxs ) ) {
+					continue;
+				}
+
 				// add the fragments of this face
 				R_AddMarkFragments(3, clipPoints,
 								   numPlanes, normals, dists,
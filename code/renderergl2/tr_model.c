@@ -67,7 +67,7 @@ qhandle_t R_RegisterMD3(const char *name, model_t *mod)
 		else
 			Com_sprintf(namebuf, sizeof(namebuf), "%s.%s", filename, fext);
 
-		size = ri.FS_ReadFile( namebuf, &buf.v );
+		size = R_ReadModelFile( namebuf, &buf.v );
 		if(!buf.u)
 			continue;
 		
@@ -77,7 +77,7 @@ qhandle_t R_RegisterMD3(const char *name, model_t *mod)
 		else
 			ri.Printf(PRINT_WARNING,"R_RegisterMD3: unknown fileid for %s\n", name);
 		
-		ri.FS_FreeFile(buf.v);
+		R_FreeModelFile(buf.v);
 
 		if(loaded)
 		{
@@ -124,7 +124,7 @@ qhandle_t R_RegisterMDR(const char *name, model_t *mod)
 	qboolean loaded = qfalse;
 	int filesize;
 
-	filesize = ri.FS_ReadFile(name, (void **) &buf.v);
+	filesize = R_ReadModelFile(name, (void **) &buf.v);
 	if(!buf.u)
 	{
 		mod->type = MOD_BAD;
@@ -135,7 +135,7 @@ qhandle_t R_RegisterMDR(const char *name, model_t *mod)
 	if(ident == MDR_IDENT)
 		loaded = R_LoadMDR(mod, buf.u, filesize, name);
 
-	ri.FS_FreeFile (buf.v);
+	R_FreeModelFile(buf.v);
 	
 	if(!loaded)
 	{
@@ -161,7 +161,7 @@ qhandle_t R_RegisterIQM(const char *name, model_t *mod)
 	qboolean loaded = qfalse;
 	int filesize;
 
-	filesize = ri.FS_ReadFile(name, (void **) &buf.v);
+	filesize = R_ReadModelFile(name, (void **) &buf.v);
 	if(!buf.u)
 	{
 		mod->type = MOD_BAD;
@@ -170,7 +170,7 @@ qhandle_t R_RegisterIQM(const char *name, model_t *mod)
 	
 	loaded = R_LoadIQM(mod, buf.u, filesize, name);
 
-	ri.FS_FreeFile (buf.v);
+	R_FreeModelFile(buf.v);
 	
 	if(!loaded)
 	{
@@ -764,7 +764,12 @@ static qboolean R_LoadMD3(model_t * mod, int lod, void *buffer, int bufferSize,
 			vaoSurf->numIndexes = surf->numIndexes;
 			vaoSurf->numVerts = surf->numVerts;
 			
-			vaoSurf->vao = R_CreateVao(va("staticMD3Mesh_VAO '%s'", surf->name), data, dataSize, (byte *)surf->indexes, surf->numIndexes * sizeof(*surf->indexes), VAO_USAGE_STATIC);
+			vaoSurf->vao = R_CreateModelVao(va("staticMD3Mesh_VAO '%s'", surf->name), data, dataSize, (byte *)surf->indexes, surf->numIndexes * sizeof(*surf->indexes));
+
+			offset_xyz     += vaoSurf->vao->vertexesOffset;
+			offset_st      += vaoSurf->vao->vertexesOffset;
+			offset_normal  += vaoSurf->vao->vertexesOffset;
+			offset_tangent += vaoSurf->vao->vertexesOffset;
 
 			vaoSurf->vao->attribs[ATTR_INDEX_POSITION].enabled = 1;
 			vaoSurf->vao->attribs[ATTR_INDEX_TEXCOORD].enabled = 1;
@@ -1151,6 +1156,8 @@ static qboolean R_LoadMDR( model_t *mod, void *buffer, int filesize, const char
 	// And finally we know the real offset to the end.
 	mdr->ofsEnd = (int)((byte *) tag - (byte *) mdr);
 
+	R_MDRCreateVaoSurfaces(mod);
+
 	// phew! we're done.
 	
 	return qtrue;
@@ -1199,6 +1206,9 @@ void R_ModelInit( void ) {
 
 	mod = R_AllocModel();
 	mod->type = MOD_BAD;
+
+	// cached poses point at models of the last registration
+	R_ClearIQMPoseCache();
 }
 
 
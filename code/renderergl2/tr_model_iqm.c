@@ -1653,6 +1653,77 @@ void RB_IQMSurfaceAnim( surfaceType_t *surface ) {
 	tess.numVertexes += surf->num_vertexes;
 }
 
+/*
+=================
+R_IQMPoseMatrices
+
+The bone matrices only depend on the model and its animation state, so
+they are shared by all surfaces of an entity, by every pass it is drawn
+in, and by entities that happen to be in the same frame
+=================
+*/
+#define	POSE_CACHE_SIZE		32
+
+typedef struct {
+	const iqmData_t	*data;
+	int				frame, oldframe;
+	float			backlerp;
+	mat4_t			boneMatrix[IQM_MAX_JOINTS];
+} iqmPoseCache_t;
+
+static iqmPoseCache_t	poseCache[POSE_CACHE_SIZE];
+static int				poseCacheNext;
+
+void R_ClearIQMPoseCache( void ) {
+	Com_Memset( poseCache, 0, sizeof( poseCache ) );
+	poseCacheNext = 0;
+}
+
+static const mat4_t *R_IQMPoseMatrices( iqmData_t *data, int frame, int oldframe, float backlerp ) {
+	float			jointMats[IQM_MAX_JOINTS * 12];
+	iqmPoseCache_t	*pose;
+	int				i;
+
+	for ( i = 0, pose = poseCache; i < POSE_CACHE_SIZE; i++, pose++ ) {
+		if ( pose->data == data && pose->frame == frame && pose->oldframe == oldframe && pose->backlerp == backlerp ) {
+			return (const mat4_t *)pose->boneMatrix;
+		}
+	}
+
+	pose = &poseCache[poseCacheNext];
+	poseCacheNext = ( poseCacheNext + 1 ) % POSE_CACHE_SIZE;
+
+	pose->data = data;
+	pose->frame = frame;
+	pose->oldframe = oldframe;
+	pose->backlerp = backlerp;
+
+	// compute interpolated joint matrices
+	ComputePoseMats( data, frame, oldframe, backlerp, jointMats );
+
+	// convert row-major order 3x4 matrix to column-major order 4x4 matrix
+	for ( i = 0; i < data->num_poses; i++ ) {
+		pose->boneMatrix[i][0] = jointMats[i*12+0];
+		pose->boneMatrix[i][1] = jointMats[i*12+4];
+		pose->boneMatrix[i][2] = jointMats[i*12+8];
+		pose->boneMatrix[i][3] = 0.0f;
+		pose->boneMatrix[i][4] = jointMats[i*12+1];
+		pose->boneMatrix[i][5] = jointMats[i*12+5];
+		pose->boneMatrix[i][6] = jointMats[i*12+9];
+		pose->boneMatrix[i][7] = 0.0f;
+		pose->boneMatrix[i][8] = jointMats[i*12+2];
+		pose->boneMatrix[i][9] = jointMats[i*12+6];
+		pose->boneMatrix[i][10] = jointMats[i*12+10];
+		pose->boneMatrix[i][11] = 0.0f;
+		pose->boneMatrix[i][12] = jointMats[i*12+3];
+		pose->boneMatrix[i][13] = jointMats[i*12+7];
+		pose->boneMatrix[i][14] = jointMats[i*12+11];
+		pose->boneMatrix[i][15] = 1.0f;
+	}
+
+	return (const mat4_t *)pose->boneMatrix;
+}
+
 /*
 =================
 RB_IQMSurfaceAnimVao
@@ -1685,34 +1756,12 @@ void RB_IQMSurfaceAnimVao(srfVaoIQModel_t * surface)
 	glState.boneAnimation = data->num_poses;
 
 	if ( glState.boneAnimation ) {
-		float		jointMats[IQM_MAX_JOINTS * 12];
 		int			frame = data->num_frames ? backEnd.currentEntity->e.frame % data->num_frames : 0;
 		int			oldframe = data->num_frames ? backEnd.currentEntity->e.oldframe % data->num_frames : 0;
 		float		backlerp = backEnd.currentEntity->e.backlerp;
-		int i;
 
-		// compute interpolated joint matrices
-		ComputePoseMats( surface->iqmData, frame, oldframe, backlerp, jointMats );
-
-		// convert row-major order 3x4 matrix to column-major order 4x4 matrix
-		for ( i = 0; i < data->num_poses; i++ ) {
-			glState.boneMatrix[i][0] = jointMats[i*12+0];
-			glState.boneMatrix[i][1] = jointMats[i*12+4];
-			glState.boneMatrix[i][2] = jointMats[i*12+8];
-			glState.boneMatrix[i][3] = 0.0f;
-			glState.boneMatrix[i][4] = jointMats[i*12+1];
-			glState.boneMatrix[i][5] = jointMats[i*12+5];
-			glState.boneMatrix[i][6] = jointMats[i*12+9];
-			glState.boneMatrix[i][7] = 0.0f;
-			glState.boneMatrix[i][8] = jointMats[i*12+2];
-			glState.boneMatrix[i][9] = jointMats[i*12+6];
-			glState.boneMatrix[i][10] = jointMats[i*12+10];
-			glState.boneMatrix[i][11] = 0.0f;
-			glState.boneMatrix[i][12] = jointMats[i*12+3];
-			glState.boneMatrix[i][13] = jointMats[i*12+7];
-			glState.boneMatrix[i][14] = jointMats[i*12+11];
-			glState.boneMatrix[i][15] = 1.0f;
-		}
+		Com_Memcpy( glState.boneMatrix, R_IQMPoseMatrices( data, frame, oldframe, backlerp ),
+			data->num_poses * sizeof( mat4_t ) );
 	}
 
 	RB_EndSurface();
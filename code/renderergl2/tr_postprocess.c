@@ -24,49 +24,27 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 void RB_ToneMap(FBO_t *hdrFbo, ivec4_t hdrBox, FBO_t *ldrFbo, ivec4_t ldrBox, int autoExposure)
 {
-	ivec4_t srcBox, dstBox;
 	vec4_t color;
 	static int lastFrameCount = 0;
 
 	if (autoExposure)
 	{
+		vec4_t srcTexCorners;
+
 		if (lastFrameCount == 0 || tr.frameCount < lastFrameCount || tr.frameCount - lastFrameCount > 5)
 		{
 			// determine average log luminance
-			FBO_t *srcFbo, *dstFbo, *tmp;
-			int size = 256;
-
 			lastFrameCount = tr.frameCount;
 
-			VectorSet4(dstBox, 0, 0, size, size);
-
-			FBO_Blit(hdrFbo, hdrBox, NULL, tr.textureScratchFbo[0], dstBox, &tr.calclevels4xShader[0], NULL, 0);
-
-			srcFbo = tr.textureScratchFbo[0];
-			dstFbo = tr.textureScratchFbo[1];
-
-			// downscale to 1x1 texture
-			while (size > 1)
-			{
-				VectorSet4(srcBox, 0, 0, size, size);
-				//size >>= 2;
-				size >>= 1;
-				VectorSet4(dstBox, 0, 0, size, size);
-
-				if (size == 1)
-					dstFbo = tr.targetLevelsFbo;
+			FBO_Blit(hdrFbo, hdrBox, NULL, tr.levelsPyramidFbo, NULL, &tr.calclevels4xShader[0], NULL, 0);
 
-				//FBO_Blit(targetFbo, srcBox, NULL, tr.textureScratchFbo[nextScratch], dstBox, &tr.calclevels4xShader[1], NULL, 0);
-				FBO_FastBlit(srcFbo, srcBox, dstFbo, dstBox, GL_COLOR_BUFFER_BIT, GL_LINEAR);
-
-				tmp = srcFbo;
-				srcFbo = dstFbo;
-				dstFbo = tmp;
-			}
+			// downscale to 1x1 in one go instead of a blit per level
+			qglGenerateTextureMipmapEXT(tr.levelsPyramidImage->texnum, GL_TEXTURE_2D);
 		}
 
 		// blend with old log luminance for gradual change
-		VectorSet4(srcBox, 0, 0, 0, 0);
+		// the whole 256x256 texture on one pixel samples the 1x1 mip
+		VectorSet4(srcTexCorners, 0.0f, 0.0f, 1.0f, 1.0f);
 
 		color[0] = 
 		color[1] =
@@ -76,7 +54,7 @@ void RB_ToneMap(FBO_t *hdrFbo, ivec4_t hdrBox, FBO_t *ldrFbo, ivec4_t ldrBox, in
 		else
 			color[3] = 0.1f;
 
-		FBO_Blit(tr.targetLevelsFbo, srcBox, NULL, tr.calcLevelsFbo, NULL,  NULL, color, GLS_SRCBLEND_SRC_ALPHA | GLS_DSTBLEND_ONE_MINUS_SRC_ALPHA);
+		FBO_BlitFromTexture(tr.levelsPyramidImage, srcTexCorners, NULL, tr.calcLevelsFbo, NULL, NULL, color, GLS_SRCBLEND_SRC_ALPHA | GLS_DSTBLEND_ONE_MINUS_SRC_ALPHA | GLS_DEPTHTEST_DISABLE);
 	}
 
 	// tonemap
@@ -85,6 +63,20 @@ void RB_ToneMap(FBO_t *hdrFbo, ivec4_t hdrBox, FBO_t *ldrFbo, ivec4_t ldrBox, in
 	color[2] = pow(2, r_cameraExposure->value - autoExposure); //exp2(r_cameraExposure->value);
 	color[3] = 1.0f;
 
+	// texels outside hdrBox weren't rendered this frame when it is scaled
+	// down, keep the filtering off them
+	{
+		vec4_t texBox;
+
+		texBox[0] = (hdrBox[0] + 0.5f) / hdrFbo->width;
+		texBox[1] = (hdrBox[1] + 0.5f) / hdrFbo->height;
+		texBox[2] = (hdrBox[0] + hdrBox[2] - 0.5f) / hdrFbo->width;
+		texBox[3] = (hdrBox[1] + hdrBox[3] - 0.5f) / hdrFbo->height;
+
+		GLSL_BindProgram(&tr.tonemapShader);
+		GLSL_SetUniformVec4(&tr.tonemapShader, UNIFORM_VIEWINFO, texBox);
+	}
+
 	if (autoExposure)
 		GL_BindToTMU(tr.calcLevelsImage,  TB_LEVELSMAP);
 	else
@@ -340,15 +332,14 @@ void RB_SunRays(FBO_t *srcFbo, ivec4_t srcBox, FBO_t *dstFbo, ivec4_t dstBox)
 	{
 		float mul = 1.f;
 		ivec4_t rayBox, quarterBox;
-		int srcWidth  = srcFbo ? srcFbo->width  : glConfig.vidWidth;
-		int srcHeight = srcFbo ? srcFbo->height : glConfig.vidHeight;
 
 		VectorSet4(color, mul, mul, mul, 1);
 
-		rayBox[0] = srcBox[0] * tr.sunRaysFbo->width  / srcWidth;
-		rayBox[1] = srcBox[1] * tr.sunRaysFbo->height / srcHeight;
-		rayBox[2] = srcBox[2] * tr.sunRaysFbo->width  / srcWidth;
-		rayBox[3] = srcBox[3] * tr.sunRaysFbo->height / srcHeight;
+		// the sun was drawn in the viewport, which may be scaled down from srcBox
+		rayBox[0] = backEnd.viewParms.viewportX      * tr.sunRaysFbo->width  / glConfig.vidWidth;
+		rayBox[1] = backEnd.viewParms.viewportY      * tr.sunRaysFbo->height / glConfig.vidHeight;
+		rayBox[2] = backEnd.viewParms.viewportWidth  * tr.sunRaysFbo->width  / glConfig.vidWidth;
+		rayBox[3] = backEnd.viewParms.viewportHeight * tr.sunRaysFbo->height / glConfig.vidHeight;
 
 		quarterBox[0] = 0;
 		quarterBox[1] = tr.quarterFbo[0]->height;
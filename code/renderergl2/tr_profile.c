@@ -0,0 +1,592 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// tr_profile.c -- per stage CPU and GPU frame timings, see r_profile
+
+#include "tr_local.h"
+
+/*
+The renderer is always in exactly one profStage_t, R_ProfileStage switches
+it and charges the time since the last switch to the stage being left, so
+nested work (a portal view rendered from inside R_SortDrawSurfs, say) is
+never counted twice.
+
+With GL_ARB_timer_query every switch also drops a GL_TIMESTAMP query into
+the command stream. The GPU time between two timestamps belongs to the
+stage that was entered at the first one; GPU time charged to PROF_ENGINE
+is the GPU waiting for the CPU. Results are read back PROF_QUERY_FRAMES
+frames late without ever waiting on them.
+
+Frame to photon latency is estimated from about when the input of the
+frame was sampled, the end of the previous frame, until the GPU finished
+the swap, plus half a refresh of scanout.
+*/
+
+#define PROF_MAX_MARKS		128		// timestamps per frame, later stage switches go uncounted on the GPU
+#define PROF_QUERY_FRAMES	4		// frames of timestamps in flight
+#define PROF_HISTORY		256		// frames kept for the graph and profiledump
+#define PROF_GRAPH_FRAMES	64		// a quad per frame and stage in the command buffer
+#define PROF_GRAPH_MSEC		50		// full height of a graph
+
+typedef struct {
+	int			frameCount;
+	int			cpuTotal;					// microseconds
+	int			cpu[PROF_NUM_STAGES];
+	qboolean	gpuValid;
+	int			gpuTotal;
+	int			gpu[PROF_NUM_STAGES];
+	int			latency;					// -1 if unknown
+} profFrame_t;
+
+typedef struct {
+	GLuint		queries[PROF_MAX_MARKS];
+	profStage_t	stages[PROF_MAX_MARKS];		// stage entered at each timestamp
+	int			numMarks;
+	qboolean	pending;
+	int			frame;						// prof.numFrames of the frame
+	int64_t		inputTime;					// all on the ri.Microseconds clock
+	int64_t		cpuEnd;
+	GLint64		gpuEnd;						// GL_TIMESTAMP read at cpuEnd
+} profQueries_t;
+
+static struct {
+	qboolean		active;					// recording the current frame
+	qboolean		timerQuery;
+	profStage_t		stage;
+	int64_t			mark;
+	int64_t			frameStart;
+	int				cpu[PROF_NUM_STAGES];
+
+	profQueries_t	queries[PROF_QUERY_FRAMES];
+	int				currentQueries;
+
+	profFrame_t		history[PROF_HISTORY];
+	int				numFrames;
+
+	qhandle_t		graphShader;
+} prof;
+
+static const char *profStageNames[PROF_NUM_STAGES] = {
+	"engine", "scene", "world", "entities", "sort", "views", "postprocess", "2d", "swap"
+};
+
+static const vec4_t profStageColors[PROF_NUM_STAGES] = {
+	{ 0.5f, 0.5f, 0.5f, 0.8f },
+	{ 0.6f, 0.3f, 0.9f, 0.8f },
+	{ 0.2f, 0.8f, 0.2f, 0.8f },
+	{ 0.9f, 0.9f, 0.2f, 0.8f },
+	{ 0.9f, 0.5f, 0.1f, 0.8f },
+	{ 0.2f, 0.5f, 1.0f, 0.8f },
+	{ 0.1f, 0.9f, 0.9f, 0.8f },
+	{ 1.0f, 0.4f, 0.7f, 0.8f },
+	{ 1.0f, 0.2f, 0.2f, 0.8f }
+};
+
+static qboolean R_ProfileWanted( void ) {
+	return r_profile->integer || r_speeds->integer == 8;
+}
+
+/*
+===============
+R_ProfileTimestamp
+===============
+*/
+static void R_ProfileTimestamp( profStage_t stage ) {
+	profQueries_t	*q = &prof.queries[prof.currentQueries];
+
+	if ( q->numMarks >= PROF_MAX_MARKS ) {
+		return;
+	}
+
+	qglQueryCounter( q->queries[q->numMarks], GL_TIMESTAMP );
+	q->stages[q->numMarks++] = stage;
+}
+
+/*
+===============
+R_ProfileStage
+
+Enters stage and returns the previous one, for the caller to go back to
+===============
+*/
+profStage_t R_ProfileStage( profStage_t stage ) {
+	profStage_t	old = prof.stage;
+	int64_t		now;
+
+	if ( stage == old ) {
+		return old;
+	}
+
+	prof.stage = stage;
+
+	if ( !prof.active ) {
+		return old;
+	}
+
+	now = ri.Microseconds();
+	prof.cpu[old] += now - prof.mark;
+	prof.mark = now;
+
+	if ( prof.timerQuery ) {
+		R_ProfileTimestamp( stage );
+	}
+
+	return old;
+}
+
+/*
+===============
+R_ProfileResolve
+
+Picks up the timestamps that came back, oldest frame first
+===============
+*/
+static void R_ProfileResolve( void ) {
+	profQueries_t	*q;
+	profFrame_t		*frame;
+	GLuint			available;
+	GLuint64		start, prev, t;
+	int				i, j;
+
+	for ( i = 1 ; i <= PROF_QUERY_FRAMES ; i++ ) {
+		q = &prof.queries[( prof.currentQueries + i ) % PROF_QUERY_FRAMES];
+
+		if ( !q->pending ) {
+			continue;
+		}
+
+		qglGetQueryObjectuiv( q->queries[q->numMarks - 1], GL_QUERY_RESULT_AVAILABLE, &available );
+		if ( !available ) {
+			break;		// the later ones can't be done either
+		}
+
+		q->pending = qfalse;
+
+		// fell out of the history while waiting
+		if ( prof.numFrames - q->frame > PROF_HISTORY ) {
+			continue;
+		}
+
+		frame = &prof.history[q->frame % PROF_HISTORY];
+
+		qglGetQueryObjectui64v( q->queries[0], GL_QUERY_RESULT, &start );
+		prev = start;
+		for ( j = 1 ; j < q->numMarks ; j++ ) {
+			qglGetQueryObjectui64v( q->queries[j], GL_QUERY_RESULT, &t );
+			frame->gpu[q->stages[j - 1]] += ( t - prev ) / 1000;
+			prev = t;
+		}
+
+		frame->gpuValid = qtrue;
+		frame->gpuTotal = ( prev - start ) / 1000;
+
+		// when the GPU finished the swap, on the CPU clock
+		frame->latency = q->cpuEnd + ( (GLint64)prev - q->gpuEnd ) / 1000 - q->inputTime;
+		if ( glConfig.displayFrequency > 0 ) {
+			frame->latency += 500000 / glConfig.displayFrequency;
+		}
+	}
+}
+
+/*
+===============
+R_ProfileEndFrame
+
+Called once the swap has been issued, closes the frame and starts the next
+===============
+*/
+void R_ProfileEndFrame( void ) {
+	profFrame_t		*frame;
+	profQueries_t	*q;
+	int64_t			now;
+	int				i;
+
+	now = ri.Microseconds();
+
+	if ( prof.active ) {
+		prof.cpu[prof.stage] += now - prof.mark;
+
+		frame = &prof.history[prof.numFrames % PROF_HISTORY];
+		Com_Memset( frame, 0, sizeof( *frame ) );
+		frame->frameCount = tr.frameCount;
+		frame->cpuTotal = now - prof.frameStart;
+		for ( i = 0 ; i < PROF_NUM_STAGES ; i++ ) {
+			frame->cpu[i] = prof.cpu[i];
+		}
+		frame->latency = -1;
+
+		if ( prof.timerQuery ) {
+			q = &prof.queries[prof.currentQueries];
+
+			// closing timestamp
+			R_ProfileTimestamp( prof.stage );
+
+			if ( q->numMarks >= 2 ) {
+				qglGetInteger64v( GL_TIMESTAMP, &q->gpuEnd );
+				q->cpuEnd = ri.Microseconds();
+				q->inputTime = prof.frameStart;
+				q->frame = prof.numFrames;
+				q->pending = qtrue;
+			}
+		}
+
+		prof.numFrames++;
+	}
+
+	if ( prof.timerQuery ) {
+		R_ProfileResolve();
+	}
+
+	prof.active = R_ProfileWanted();
+	prof.frameStart = prof.mark = now;
+	Com_Memset( prof.cpu, 0, sizeof( prof.cpu ) );
+
+	if ( prof.active && prof.timerQuery ) {
+		prof.currentQueries = ( prof.currentQueries + 1 ) % PROF_QUERY_FRAMES;
+
+		// a frame whose results never arrived is dropped, its queries reused
+		q = &prof.queries[prof.currentQueries];
+		q->pending = qfalse;
+		q->numMarks = 0;
+
+		R_ProfileTimestamp( prof.stage );
+	}
+}
+
+/*
+===============
+R_ProfileLastFrame
+
+The newest frame that has GPU times if gpu, NULL if there isn't one
+===============
+*/
+static const profFrame_t *R_ProfileLastFrame( qboolean gpu ) {
+	const profFrame_t	*frame;
+	int					i;
+
+	for ( i = 1 ; i <= PROF_QUERY_FRAMES + 1 && i <= prof.numFrames ; i++ ) {
+		frame = &prof.history[( prof.numFrames - i ) % PROF_HISTORY];
+		if ( !gpu || frame->gpuValid ) {
+			return frame;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+===============
+R_ProfilePrint
+
+r_speeds 8
+===============
+*/
+void R_ProfilePrint( void ) {
+	const profFrame_t	*frame;
+	char				line[MAX_STRING_CHARS];
+	int					i;
+
+	frame = R_ProfileLastFrame( qfalse );
+	if ( !frame ) {
+		return;
+	}
+
+	Com_sprintf( line, sizeof( line ), "cpu %.2f:", frame->cpuTotal / 1000.0f );
+	for ( i = 0 ; i < PROF_NUM_STAGES ; i++ ) {
+		Q_strcat( line, sizeof( line ), va( " %s %.2f", profStageNames[i], frame->cpu[i] / 1000.0f ) );
+	}
+	ri.Printf( PRINT_ALL, "%s\n", line );
+
+	frame = R_ProfileLastFrame( qtrue );
+	if ( !frame ) {
+		return;
+	}
+
+	Com_sprintf( line, sizeof( line ), "gpu %.2f: idle %.2f", frame->gpuTotal / 1000.0f, frame->gpu[PROF_ENGINE] / 1000.0f );
+	for ( i = PROF_VIEWS ; i < PROF_NUM_STAGES ; i++ ) {
+		Q_strcat( line, sizeof( line ), va( " %s %.2f", profStageNames[i], frame->gpu[i] / 1000.0f ) );
+	}
+	Q_strcat( line, sizeof( line ), va( ", latency ~%.1f", frame->latency / 1000.0f ) );
+	ri.Printf( PRINT_ALL, "%s\n", line );
+}
+
+/*
+===============
+R_ProfileGPUFrameTime
+
+For the client's benchmark, the GPU time of the newest frame that has one,
+leaving out the idle time waiting on the engine
+===============
+*/
+qboolean R_ProfileGPUFrameTime( int *frameNum, int *usec ) {
+	const profFrame_t	*frame;
+
+	frame = R_ProfileLastFrame( qtrue );
+	if ( !frame ) {
+		return qfalse;
+	}
+
+	*frameNum = frame->frameCount;
+	*usec = frame->gpuTotal - frame->gpu[PROF_ENGINE];
+	return qtrue;
+}
+
+/*
+===============
+R_ProfileGraphBar
+
+Stacked stage times of one frame, growing up from y
+===============
+*/
+static void R_ProfileGraphBar( float x, float y, float width, float scale, const int *times ) {
+	float	height;
+	int		i;
+
+	for ( i = 0 ; i < PROF_NUM_STAGES ; i++ ) {
+		if ( times[i] <= 0 ) {
+			continue;
+		}
+
+		height = times[i] * scale;
+		y -= height;
+
+		RE_SetColor( profStageColors[i] );
+		RE_StretchPic( x, y, width, height, 0, 0, 1, 1, prof.graphShader );
+	}
+}
+
+/*
+===============
+R_ProfileGraph
+
+r_profile 2, CPU in the upper graph and GPU in the lower one, one column
+per frame, queued as 2D before the swap of the frame
+===============
+*/
+void R_ProfileGraph( void ) {
+	static const vec4_t	background = { 0.0f, 0.0f, 0.0f, 0.5f };
+	static const vec4_t	refreshLine = { 1.0f, 1.0f, 1.0f, 0.8f };
+	const profFrame_t	*frame;
+	float				x, height, width, scale, cpuBase, gpuBase;
+	int					i, numFrames;
+
+	if ( r_profile->integer < 2 || !prof.numFrames ) {
+		return;
+	}
+
+	width = glConfig.vidWidth / 2.0f / PROF_GRAPH_FRAMES;
+	height = glConfig.vidHeight / 4.0f;
+	scale = height / ( PROF_GRAPH_MSEC * 1000.0f );
+	cpuBase = glConfig.vidHeight - height - 4;
+	gpuBase = glConfig.vidHeight;
+
+	RE_SetColor( background );
+	RE_StretchPic( 0, glConfig.vidHeight - 2 * height - 4, PROF_GRAPH_FRAMES * width, 2 * height + 4, 0, 0, 1, 1, prof.graphShader );
+
+	numFrames = MIN( prof.numFrames, PROF_GRAPH_FRAMES );
+	for ( i = 0 ; i < numFrames ; i++ ) {
+		frame = &prof.history[( prof.numFrames - numFrames + i ) % PROF_HISTORY];
+		x = i * width;
+
+		R_ProfileGraphBar( x, cpuBase, width, scale, frame->cpu );
+
+		if ( frame->gpuValid ) {
+			R_ProfileGraphBar( x, gpuBase, width, scale, frame->gpu );
+		}
+	}
+
+	// the time a frame has at the display's refresh rate
+	if ( glConfig.displayFrequency > 0 ) {
+		RE_SetColor( refreshLine );
+		RE_StretchPic( 0, cpuBase - 1000000.0f / glConfig.displayFrequency * scale, PROF_GRAPH_FRAMES * width, 1, 0, 0, 1, 1, prof.graphShader );
+		RE_StretchPic( 0, gpuBase - 1000000.0f / glConfig.displayFrequency * scale, PROF_GRAPH_FRAMES * width, 1, 0, 0, 1, 1, prof.graphShader );
+	}
+
+	RE_SetColor( NULL );
+}
+
+/*
+===============
+R_ProfileDump_f
+
+profiledump [file], the recorded frames as CSV, or as JSON if the name
+ends in .json
+===============
+*/
+void R_ProfileDump_f( void ) {
+	const profFrame_t	*frame;
+	char			filename[MAX_QPATH];
+	char			*buffer;
+	int				size, len, first, numFrames, i, j;
+	int64_t			cpuSum, gpuSum, latencySum;
+	int				cpuMax, gpuMax, latencyMax, gpuFrames, latencyFrames;
+	qboolean		json;
+
+	if ( ri.Cmd_Argc() > 2 ) {
+		ri.Printf( PRINT_ALL, "usage: profiledump [file]\n" );
+		return;
+	}
+
+	numFrames = MIN( prof.numFrames, PROF_HISTORY );
+	if ( !numFrames ) {
+		ri.Printf( PRINT_ALL, "No frames recorded, set r_profile 1 first\n" );
+		return;
+	}
+
+	Q_strncpyz( filename, ri.Cmd_Argc() > 1 ? ri.Cmd_Argv( 1 ) : "profile.csv", sizeof( filename ) );
+	len = strlen( filename );
+	json = len > 5 && !Q_stricmp( filename + len - 5, ".json" );
+
+	size = ( numFrames + 2 ) * 64 * ( PROF_NUM_STAGES + 2 );
+	buffer = ri.Malloc( size );
+	len = 0;
+
+	if ( json ) {
+		len += Com_sprintf( buffer + len, size - len, "{\n\t\"stages\": [" );
+		for ( j = 0 ; j < PROF_NUM_STAGES ; j++ ) {
+			len += Com_sprintf( buffer + len, size - len, "%s\"%s\"", j ? ", " : "", profStageNames[j] );
+		}
+		len += Com_sprintf( buffer + len, size - len, "],\n\t\"frames\": [\n" );
+	} else {
+		len += Com_sprintf( buffer + len, size - len, "frame,cpu" );
+		for ( j = 0 ; j < PROF_NUM_STAGES ; j++ ) {
+			len += Com_sprintf( buffer + len, size - len, ",cpu_%s", profStageNames[j] );
+		}
+		len += Com_sprintf( buffer + len, size - len, ",gpu" );
+		for ( j = 0 ; j < PROF_NUM_STAGES ; j++ ) {
+			len += Com_sprintf( buffer + len, size - len, ",gpu_%s", j == PROF_ENGINE ? "idle" : profStageNames[j] );
+		}
+		len += Com_sprintf( buffer + len, size - len, ",latency\n" );
+	}
+
+	cpuSum = gpuSum = latencySum = 0;
+	cpuMax = gpuMax = latencyMax = 0;
+	gpuFrames = latencyFrames = 0;
+
+	// times in milliseconds, unknown GPU times and latencies empty or null
+	first = prof.numFrames - numFrames;
+	for ( i = 0 ; i < numFrames ; i++ ) {
+		frame = &prof.history[( first + i ) % PROF_HISTORY];
+
+		if ( json ) {
+			len += Com_sprintf( buffer + len, size - len, "\t\t{ \"frame\": %d, \"cpu\": %.3f, \"cpuStages\": [",
+				frame->frameCount, frame->cpuTotal / 1000.0f );
+			for ( j = 0 ; j < PROF_NUM_STAGES ; j++ ) {
+				len += Com_sprintf( buffer + len, size - len, "%s%.3f", j ? ", " : "", frame->cpu[j] / 1000.0f );
+			}
+			if ( frame->gpuValid ) {
+				len += Com_sprintf( buffer + len, size - len, "], \"gpu\": %.3f, \"gpuStages\": [", frame->gpuTotal / 1000.0f );
+				for ( j = 0 ; j < PROF_NUM_STAGES ; j++ ) {
+					len += Com_sprintf( buffer + len, size - len, "%s%.3f", j ? ", " : "", frame->gpu[j] / 1000.0f );
+				}
+				len += Com_sprintf( buffer + len, size - len, "], \"latency\": %.3f }", frame->latency / 1000.0f );
+			} else {
+				len += Com_sprintf( buffer + len, size - len, "], \"gpu\": null, \"gpuStages\": null, \"latency\": null }" );
+			}
+			len += Com_sprintf( buffer + len, size - len, "%s\n", i < numFrames - 1 ? "," : "" );
+		} else {
+			len += Com_sprintf( buffer + len, size - len, "%d,%.3f", frame->frameCount, frame->cpuTotal / 1000.0f );
+			for ( j = 0 ; j < PROF_NUM_STAGES ; j++ ) {
+				len += Com_sprintf( buffer + len, size - len, ",%.3f", frame->cpu[j] / 1000.0f );
+			}
+			if ( frame->gpuValid ) {
+				len += Com_sprintf( buffer + len, size - len, ",%.3f", frame->gpuTotal / 1000.0f );
+				for ( j = 0 ; j < PROF_NUM_STAGES ; j++ ) {
+					len += Com_sprintf( buffer + len, size - len, ",%.3f", frame->gpu[j] / 1000.0f );
+				}
+				len += Com_sprintf( buffer + len, size - len, ",%.3f\n", frame->latency / 1000.0f );
+			} else {
+				for ( j = 0 ; j < PROF_NUM_STAGES + 2 ; j++ ) {
+					len += Com_sprintf( buffer + len, size - len, "," );
+				}
+				len += Com_sprintf( buffer + len, size - len, "\n" );
+			}
+		}
+
+		cpuSum += frame->cpuTotal;
+		cpuMax = MAX( cpuMax, frame->cpuTotal );
+		if ( frame->gpuValid ) {
+			gpuSum += frame->gpuTotal;
+			gpuMax = MAX( gpuMax, frame->gpuTotal );
+			gpuFrames++;
+
+			if ( frame->latency >= 0 ) {
+				latencySum += frame->latency;
+				latencyMax = MAX( latencyMax, frame->latency );
+				latencyFrames++;
+			}
+		}
+	}
+
+	if ( json ) {
+		len += Com_sprintf( buffer + len, size - len, "\t]\n}\n" );
+	}
+
+	ri.FS_WriteFile( filename, buffer, len );
+	ri.Free( buffer );
+
+	ri.Printf( PRINT_ALL, "Wrote %d frames to %s\n", numFrames, filename );
+	ri.Printf( PRINT_ALL, "cpu avg %.2f max %.2f msec\n", cpuSum / 1000.0f / numFrames, cpuMax / 1000.0f );
+	if ( gpuFrames ) {
+		ri.Printf( PRINT_ALL, "gpu avg %.2f max %.2f msec\n", gpuSum / 1000.0f / gpuFrames, gpuMax / 1000.0f );
+	}
+	if ( latencyFrames ) {
+		ri.Printf( PRINT_ALL, "latency avg %.1f max %.1f msec (estimated)\n", latencySum / 1000.0f / latencyFrames, latencyMax / 1000.0f );
+	}
+}
+
+/*
+===============
+R_InitProfile
+===============
+*/
+void R_InitProfile( void ) {
+	int		i;
+
+	Com_Memset( &prof, 0, sizeof( prof ) );
+	prof.stage = PROF_ENGINE;
+	prof.timerQuery = glRefConfig.timerQuery;
+
+	if ( prof.timerQuery ) {
+		for ( i = 0 ; i < PROF_QUERY_FRAMES ; i++ ) {
+			qglGenQueries( PROF_MAX_MARKS, prof.queries[i].queries );
+		}
+	}
+
+	prof.graphShader = R_FindShader( "*white", LIGHTMAP_2D, qfalse )->index;
+}
+
+/*
+===============
+R_ShutdownProfile
+===============
+*/
+void R_ShutdownProfile( void ) {
+	int		i;
+
+	if ( prof.timerQuery ) {
+		for ( i = 0 ; i < PROF_QUERY_FRAMES ; i++ ) {
+			qglDeleteQueries( PROF_MAX_MARKS, prof.queries[i].queries );
+		}
+	}
+
+	Com_Memset( &prof, 0, sizeof( prof ) );
+}
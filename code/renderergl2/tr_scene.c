@@ -98,6 +98,11 @@ void R_AddPolygonSurfaces( void ) {
 	fogMask = -((tr.refdef.rdflags & RDF_NOFOG) == 0);
 
 	for ( i = 0, poly = tr.refdef.polys; i < tr.refdef.numPolys ; i++, poly++ ) {
+		// marks and particles all over the map, most of them aren't in this view
+		if ( !r_nocull->integer && R_CullBox( poly->bounds ) == CULL_OUT ) {
+			continue;
+		}
+
 		sh = R_GetShaderByHandle( poly->hShader );
 		R_AddDrawSurf( ( void * )poly, sh, poly->fogIndex & fogMask, qfalse, qfalse, 0 /*cubeMap*/  );
 	}
@@ -114,7 +119,6 @@ void RE_AddPolyToScene( qhandle_t hShader, int numVerts, const polyVert_t *verts
 	int			i, j;
 	int			fogIndex;
 	fog_t		*fog;
-	vec3_t		bounds[2];
 
 	if ( !tr.registered ) {
 		return;
@@ -157,6 +161,13 @@ void RE_AddPolyToScene( qhandle_t hShader, int numVerts, const polyVert_t *verts
 		r_numpolys++;
 		r_numpolyverts += numVerts;
 
+		// for view culling and fog
+		VectorCopy( poly->verts[0].xyz, poly->bounds[0] );
+		VectorCopy( poly->verts[0].xyz, poly->bounds[1] );
+		for ( i = 1 ; i < poly->numVerts ; i++ ) {
+			AddPointToBounds( poly->verts[i].xyz, poly->bounds[0], poly->bounds[1] );
+		}
+
 		// if no world is loaded
 		if ( tr.world == NULL ) {
 			fogIndex = 0;
@@ -166,11 +177,8 @@ void RE_AddPolyToScene( qhandle_t hShader, int numVerts, const polyVert_t *verts
 			fogIndex = 0;
 		} else {
 			// find which fog volume the poly is in
-			VectorCopy( poly->verts[0].xyz, bounds[0] );
-			VectorCopy( poly->verts[0].xyz, bounds[1] );
-			for ( i = 1 ; i < poly->numVerts ; i++ ) {
-				AddPointToBounds( poly->verts[i].xyz, bounds[0], bounds[1] );
-			}
+			vec3_t *bounds = poly->bounds;
+
 			for ( fogIndex = 1 ; fogIndex < tr.world->numfogs ; fogIndex++ ) {
 				fog = &tr.world->fogs[fogIndex]; 
 				if ( bounds[1][0] >= fog->bounds[0][0]
@@ -458,6 +466,7 @@ to handle mirrors,
 void RE_RenderScene( const refdef_t *fd ) {
 	viewParms_t		parms;
 	int				startTime;
+	profStage_t		stage;
 
 	if ( !tr.registered ) {
 		return;
@@ -469,6 +478,7 @@ void RE_RenderScene( const refdef_t *fd ) {
 	}
 
 	startTime = ri.Milliseconds();
+	stage = R_ProfileStage( PROF_SCENE );
 
 	if (!tr.world && !( fd->rdflags & RDF_NOWORLDMODEL ) ) {
 		ri.Error (ERR_DROP, "R_RenderScene: NULL worldmodel");
@@ -505,7 +515,8 @@ void RE_RenderScene( const refdef_t *fd ) {
 		}
 
 		// only rerender last cascade if sun has changed position
-		if (r_forceSun->integer == 2 || !VectorCompare(tr.refdef.sunDir, tr.lastCascadeSunDirection))
+		// the cascade cache keeps its world and redraws the entities instead
+		if (tr.sunShadowCacheFbo[3] || r_forceSun->integer == 2 || !VectorCompare(tr.refdef.sunDir, tr.lastCascadeSunDirection))
 		{
 			VectorCopy(tr.refdef.sunDir, tr.lastCascadeSunDirection);
 			R_RenderSunShadowMaps(fd, 3);
@@ -562,6 +573,20 @@ void RE_RenderScene( const refdef_t *fd ) {
 		parms.flags = VPF_USESUNLIGHT;
 	}
 
+	// only the first world view of a frame is occlusion culled,
+	// the queries are kept for one point of view
+	if ( r_occlusionCull->integer && glRefConfig.occlusionQuery && tr.world
+		&& !( fd->rdflags & RDF_NOWORLDMODEL ) && tr.occlusionViewFrame != tr.frameCount )
+	{
+		parms.flags |= VPF_OCCLUSIONCULL;
+		tr.occlusionViewFrame = tr.frameCount;
+	}
+
+	if ( !( fd->rdflags & RDF_NOWORLDMODEL ) )
+	{
+		R_DynamicResolutionViewport( &parms );
+	}
+
 	R_RenderView( &parms );
 
 	if(!( fd->rdflags & RDF_NOWORLDMODEL ))
@@ -569,5 +594,6 @@ void RE_RenderScene( const refdef_t *fd ) {
 
 	RE_EndScene();
 
+	R_ProfileStage( stage );
 	tr.frontEndMsec += ri.Milliseconds() - startTime;
 }
@@ -40,7 +40,9 @@ R_DrawElements
 
 void R_DrawElements( int numIndexes, int firstIndex )
 {
-	qglDrawElements(GL_TRIANGLES, numIndexes, GL_INDEX_TYPE, BUFFER_OFFSET(firstIndex * sizeof(glIndex_t)));
+	int indexesOffset = glState.currentVao ? glState.currentVao->indexesOffset : 0;
+
+	qglDrawElements(GL_TRIANGLES, numIndexes, GL_INDEX_TYPE, BUFFER_OFFSET(indexesOffset + firstIndex * sizeof(glIndex_t)));
 }
 
 
@@ -318,11 +320,61 @@ static void ComputeDeformValues(int *deformGen, vec5_t deformParams)
 }
 
 
+/*
+===================
+DrawDlightBatch
+
+Adds up to MAX_DLIGHTS_PER_PASS lights with the same blend in one pass
+===================
+*/
+static void DrawDlightBatch( int numDlights, const vec4_t *infos, const vec4_t *colors, qboolean additive, int deformGen, vec5_t deformParams ) {
+	shaderProgram_t *sp;
+
+	sp = &tr.dlightShader[deformGen == DGEN_NONE ? 0 : 1];
+
+	backEnd.pc.c_dlightDraws++;
+
+	GLSL_BindProgram(sp);
+
+	GLSL_SetUniformMat4(sp, UNIFORM_MODELVIEWPROJECTIONMATRIX, glState.modelviewProjection);
+
+	GLSL_SetUniformFloat(sp, UNIFORM_VERTEXLERP, glState.vertexAttribsInterpolation);
+
+	GLSL_SetUniformInt(sp, UNIFORM_DEFORMGEN, deformGen);
+	if (deformGen != DGEN_NONE)
+	{
+		GLSL_SetUniformFloat5(sp, UNIFORM_DEFORMPARAMS, deformParams);
+		GLSL_SetUniformFloat(sp, UNIFORM_TIME, tess.shaderTime);
+	}
+
+	GLSL_SetUniformInt(sp, UNIFORM_NUMDLIGHTS, numDlights);
+	GLSL_SetUniformVec4Dlights(sp, UNIFORM_DLIGHTINFO, infos, numDlights);
+	GLSL_SetUniformVec4Dlights(sp, UNIFORM_DLIGHTCOLOR, colors, numDlights);
+
+	GL_BindToTMU( tr.dlightImage, TB_COLORMAP );
+
+	// include GLS_DEPTHFUNC_EQUAL so alpha tested surfaces don't add light
+	// where they aren't rendered
+	if ( additive ) {
+		GL_State( GLS_ATEST_GT_0 | GLS_SRCBLEND_ONE | GLS_DSTBLEND_ONE | GLS_DEPTHFUNC_EQUAL );
+	}
+	else {
+		GL_State( GLS_ATEST_GT_0 | GLS_SRCBLEND_DST_COLOR | GLS_DSTBLEND_ONE | GLS_DEPTHFUNC_EQUAL );
+	}
+
+	GLSL_SetUniformInt(sp, UNIFORM_ALPHATEST, 1);
+
+	R_DrawElements(tess.numIndexes, tess.firstIndex);
+
+	backEnd.pc.c_totalIndexes += tess.numIndexes;
+	backEnd.pc.c_dlightIndexes += tess.numIndexes;
+	backEnd.pc.c_dlightVertexes += tess.numVertexes;
+}
+
 static void ProjectDlightTexture( void ) {
-	int		l;
-	vec3_t	origin;
-	float	scale;
-	float	radius;
+	int		l, additive, numDlights;
+	vec4_t	infos[MAX_DLIGHTS_PER_PASS];
+	vec4_t	colors[MAX_DLIGHTS_PER_PASS];
 	int deformGen;
 	vec5_t deformParams;
 
@@ -332,67 +384,37 @@ static void ProjectDlightTexture( void ) {
 
 	ComputeDeformValues(&deformGen, deformParams);
 
-	for ( l = 0 ; l < backEnd.refdef.num_dlights ; l++ ) {
-		dlight_t	*dl;
-		shaderProgram_t *sp;
-		vec4_t vector;
+	// additive and modulating lights blend differently, so they're batched apart
+	for ( additive = 0 ; additive < 2 ; additive++ ) {
+		numDlights = 0;
 
-		if ( !( tess.dlightBits & ( 1 << l ) ) ) {
-			continue;	// this surface definitely doesn't have any of this light
-		}
+		for ( l = 0 ; l < backEnd.refdef.num_dlights ; l++ ) {
+			dlight_t	*dl;
 
-		dl = &backEnd.refdef.dlights[l];
-		VectorCopy( dl->transformed, origin );
-		radius = dl->radius;
-		scale = 1.0f / radius;
+			if ( !( tess.dlightBits & ( 1 << l ) ) ) {
+				continue;	// this surface definitely doesn't have any of this light
+			}
 
-		sp = &tr.dlightShader[deformGen == DGEN_NONE ? 0 : 1];
+			dl = &backEnd.refdef.dlights[l];
+			if ( !dl->additive != !additive ) {
+				continue;
+			}
 
-		backEnd.pc.c_dlightDraws++;
+			VectorCopy( dl->transformed, infos[numDlights] );
+			infos[numDlights][3] = 1.0f / dl->radius;
 
-		GLSL_BindProgram(sp);
+			VectorCopy( dl->color, colors[numDlights] );
+			colors[numDlights][3] = 1.0f;
 
-		GLSL_SetUniformMat4(sp, UNIFORM_MODELVIEWPROJECTIONMATRIX, glState.modelviewProjection);
-
-		GLSL_SetUniformFloat(sp, UNIFORM_VERTEXLERP, glState.vertexAttribsInterpolation);
-		
-		GLSL_SetUniformInt(sp, UNIFORM_DEFORMGEN, deformGen);
-		if (deformGen != DGEN_NONE)
-		{
-			GLSL_SetUniformFloat5(sp, UNIFORM_DEFORMPARAMS, deformParams);
-			GLSL_SetUniformFloat(sp, UNIFORM_TIME, tess.shaderTime);
+			if ( ++numDlights == MAX_DLIGHTS_PER_PASS ) {
+				DrawDlightBatch( numDlights, infos, colors, additive, deformGen, deformParams );
+				numDlights = 0;
+			}
 		}
 
-		vector[0] = dl->color[0];
-		vector[1] = dl->color[1];
-		vector[2] = dl->color[2];
-		vector[3] = 1.0f;
-		GLSL_SetUniformVec4(sp, UNIFORM_COLOR, vector);
-
-		vector[0] = origin[0];
-		vector[1] = origin[1];
-		vector[2] = origin[2];
-		vector[3] = scale;
-		GLSL_SetUniformVec4(sp, UNIFORM_DLIGHTINFO, vector);
-	  
-		GL_BindToTMU( tr.dlightImage, TB_COLORMAP );
-
-		// include GLS_DEPTHFUNC_EQUAL so alpha tested surfaces don't add light
-		// where they aren't rendered
-		if ( dl->additive ) {
-			GL_State( GLS_ATEST_GT_0 | GLS_SRCBLEND_ONE | GLS_DSTBLEND_ONE | GLS_DEPTHFUNC_EQUAL );
+		if ( numDlights ) {
+			DrawDlightBatch( numDlights, infos, colors, additive, deformGen, deformParams );
 		}
-		else {
-			GL_State( GLS_ATEST_GT_0 | GLS_SRCBLEND_DST_COLOR | GLS_DSTBLEND_ONE | GLS_DEPTHFUNC_EQUAL );
-		}
-
-		GLSL_SetUniformInt(sp, UNIFORM_ALPHATEST, 1);
-
-		R_DrawElements(tess.numIndexes, tess.firstIndex);
-
-		backEnd.pc.c_totalIndexes += tess.numIndexes;
-		backEnd.pc.c_dlightIndexes += tess.numIndexes;
-		backEnd.pc.c_dlightVertexes += tess.numVertexes;
 	}
 }
 
@@ -979,6 +1001,7 @@ static unsigned int RB_CalcShaderVertexAttribs( shaderCommands_t *input )
 static void RB_IterateStagesGeneric( shaderCommands_t *input )
 {
 	int stage;
+	unsigned int stateBits;
 	
 	vec4_t fogDistanceVector, fogDepthVector = {0, 0, 0, 0};
 	float eyeT = 0;
@@ -1118,7 +1141,17 @@ static void RB_IterateStagesGeneric( shaderCommands_t *input )
 			GLSL_SetUniformFloat(sp, UNIFORM_FOGEYET, eyeT);
 		}
 
-		GL_State( pStage->stateBits );
+		stateBits = pStage->stateBits;
+
+		// the prepass drew this stage's depth already, so only the front
+		// fragment gets through and there's nothing to write
+		if (backEnd.depthPrepassed && stage == 0 && input->shader->sort == SS_OPAQUE
+			&& (stateBits & GLS_DEPTHMASK_TRUE) && !(stateBits & (GLS_DEPTHFUNC_BITS | GLS_DEPTHTEST_DISABLE)))
+		{
+			stateBits = (stateBits & ~GLS_DEPTHMASK_TRUE) | GLS_DEPTHFUNC_EQUAL;
+		}
+
+		GL_State( stateBits );
 		if ((pStage->stateBits & GLS_ATEST_BITS) == GLS_ATEST_GT_0)
 		{
 			GLSL_SetUniformInt(sp, UNIFORM_ALPHATEST, 1);
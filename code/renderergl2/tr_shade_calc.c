@@ -23,6 +23,56 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "tr_local.h"
 
+#if defined( __SSE2__ ) || idx64
+#include <emmintrin.h>
+#define USE_SSE_TESS
+#elif defined( __aarch64__ )
+#include <arm_neon.h>
+#define USE_NEON_TESS
+#endif
+
+#if defined( USE_SSE_TESS ) || defined( USE_NEON_TESS )
+#define USE_SIMD_TESS
+
+// the few 4 float operations the vertex loops below need
+#if defined( USE_SSE_TESS )
+typedef __m128 tessVec_t;
+#define TV_Load( p )			_mm_load_ps( p )
+#define TV_Store( p, v )		_mm_store_ps( p, v )
+#define TV_Splat( f )			_mm_set1_ps( f )
+#define TV_Set( x, y, z, w )	_mm_setr_ps( x, y, z, w )
+#define TV_Add( a, b )			_mm_add_ps( a, b )
+#define TV_Mul( a, b )			_mm_mul_ps( a, b )
+
+// the four int16_t of a packed normal, not yet scaled by 1 / 32767
+#define TV_LoadNormal( p )		_mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( \
+	_mm_loadl_epi64( (const __m128i *)(p) ), _mm_loadl_epi64( (const __m128i *)(p) ) ), 16 ) )
+#else
+typedef float32x4_t tessVec_t;
+#define TV_Load( p )			vld1q_f32( p )
+#define TV_Store( p, v )		vst1q_f32( p, v )
+#define TV_Splat( f )			vdupq_n_f32( f )
+#define TV_Add( a, b )			vaddq_f32( a, b )
+#define TV_Mul( a, b )			vmulq_f32( a, b )
+#define TV_LoadNormal( p )		vcvtq_f32_s32( vmovl_s16( vld1_s16( p ) ) )
+
+static ID_INLINE tessVec_t TV_Set( float x, float y, float z, float w ) {
+	float v[4] = { x, y, z, w };
+
+	return vld1q_f32( v );
+}
+#endif
+#endif
+
+// vertex loops with a SIMD version, set up by RB_InitTessCalc
+typedef struct {
+	void	(*deformVertexes)( deformStage_t *ds );
+	void	(*bulgeVertexes)( deformStage_t *ds );
+	void	(*moveVertexes)( deformStage_t *ds );
+} tessCalcFuncs_t;
+
+static tessCalcFuncs_t tessCalc;
+
 
 #define	WAVEVALUE( table, base, amplitude, phase, freq )  ((base) + table[ ( (int64_t) ( ( (phase) + tess.shaderTime * (freq) ) * FUNCTABLE_SIZE ) ) & FUNCTABLE_MASK ] * (amplitude))
 
@@ -107,7 +157,7 @@ RB_CalcDeformVertexes
 
 ========================
 */
-void RB_CalcDeformVertexes( deformStage_t *ds )
+static void RB_CalcDeformVertexes_scalar( deformStage_t *ds )
 {
 	int i;
 	vec3_t	offset;
@@ -151,6 +201,55 @@ void RB_CalcDeformVertexes( deformStage_t *ds )
 	}
 }
 
+#ifdef USE_SIMD_TESS
+static void RB_CalcDeformVertexes_simd( deformStage_t *ds )
+{
+	int i;
+	float	scale;
+	float	*xyz = ( float * ) tess.xyz;
+	int16_t	*normal = tess.normal[0];
+	float	*table;
+	tessVec_t	mask, offset;
+
+	// unpacks the normal and leaves w alone
+	mask = TV_Set( 1.0f / 32767.0f, 1.0f / 32767.0f, 1.0f / 32767.0f, 0.0f );
+
+	if ( ds->deformationWave.frequency == 0 )
+	{
+		scale = EvalWaveForm( &ds->deformationWave );
+		mask = TV_Mul( mask, TV_Splat( scale ) );
+
+		for ( i = 0; i < tess.numVertexes; i++, xyz += 4, normal += 4 )
+		{
+			offset = TV_Mul( TV_LoadNormal( normal ), mask );
+			TV_Store( xyz, TV_Add( TV_Load( xyz ), offset ) );
+		}
+	}
+	else
+	{
+		table = TableForFunc( ds->deformationWave.func );
+
+		for ( i = 0; i < tess.numVertexes; i++, xyz += 4, normal += 4 )
+		{
+			float off = ( xyz[0] + xyz[1] + xyz[2] ) * ds->deformationSpread;
+
+			scale = WAVEVALUE( table, ds->deformationWave.base, 
+				ds->deformationWave.amplitude,
+				ds->deformationWave.phase + off,
+				ds->deformationWave.frequency );
+
+			offset = TV_Mul( TV_LoadNormal( normal ), TV_Mul( mask, TV_Splat( scale ) ) );
+			TV_Store( xyz, TV_Add( TV_Load( xyz ), offset ) );
+		}
+	}
+}
+#endif
+
+void RB_CalcDeformVertexes( deformStage_t *ds )
+{
+	tessCalc.deformVertexes( ds );
+}
+
 /*
 =========================
 RB_CalcDeformNormals
@@ -196,7 +295,7 @@ RB_CalcBulgeVertexes
 
 ========================
 */
-void RB_CalcBulgeVertexes( deformStage_t *ds ) {
+static void RB_CalcBulgeVertexes_scalar( deformStage_t *ds ) {
 	int i;
 	const float *st = ( const float * ) tess.texCoords[0];
 	float		*xyz = ( float * ) tess.xyz;
@@ -222,6 +321,37 @@ void RB_CalcBulgeVertexes( deformStage_t *ds ) {
 	}
 }
 
+#ifdef USE_SIMD_TESS
+static void RB_CalcBulgeVertexes_simd( deformStage_t *ds ) {
+	int i;
+	const float *st = ( const float * ) tess.texCoords[0];
+	float		*xyz = ( float * ) tess.xyz;
+	int16_t	*normal = tess.normal[0];
+	double		now;
+	tessVec_t	mask, offset;
+
+	now = backEnd.refdef.time * 0.001 * ds->bulgeSpeed;
+
+	mask = TV_Set( 1.0f / 32767.0f, 1.0f / 32767.0f, 1.0f / 32767.0f, 0.0f );
+
+	for ( i = 0; i < tess.numVertexes; i++, xyz += 4, st += 2, normal += 4 ) {
+		int64_t off;
+		float scale;
+
+		off = (float)( FUNCTABLE_SIZE / (M_PI*2) ) * ( st[0] * ds->bulgeWidth + now );
+
+		scale = tr.sinTable[ off & FUNCTABLE_MASK ] * ds->bulgeHeight;
+
+		offset = TV_Mul( TV_LoadNormal( normal ), TV_Mul( mask, TV_Splat( scale ) ) );
+		TV_Store( xyz, TV_Add( TV_Load( xyz ), offset ) );
+	}
+}
+#endif
+
+void RB_CalcBulgeVertexes( deformStage_t *ds ) {
+	tessCalc.bulgeVertexes( ds );
+}
+
 
 /*
 ======================
@@ -230,7 +360,7 @@ RB_CalcMoveVertexes
 A deformation that can move an entire surface along a wave path
 ======================
 */
-void RB_CalcMoveVertexes( deformStage_t *ds ) {
+static void RB_CalcMoveVertexes_scalar( deformStage_t *ds ) {
 	int			i;
 	float		*xyz;
 	float		*table;
@@ -252,6 +382,34 @@ void RB_CalcMoveVertexes( deformStage_t *ds ) {
 	}
 }
 
+#ifdef USE_SIMD_TESS
+static void RB_CalcMoveVertexes_simd( deformStage_t *ds ) {
+	int			i;
+	float		*xyz;
+	float		*table;
+	float		scale;
+	tessVec_t	offset;
+
+	table = TableForFunc( ds->deformationWave.func );
+
+	scale = WAVEVALUE( table, ds->deformationWave.base, 
+		ds->deformationWave.amplitude,
+		ds->deformationWave.phase,
+		ds->deformationWave.frequency );
+
+	offset = TV_Set( ds->moveVector[0] * scale, ds->moveVector[1] * scale, ds->moveVector[2] * scale, 0.0f );
+
+	xyz = ( float * ) tess.xyz;
+	for ( i = 0; i < tess.numVertexes; i++, xyz += 4 ) {
+		TV_Store( xyz, TV_Add( TV_Load( xyz ), offset ) );
+	}
+}
+#endif
+
+void RB_CalcMoveVertexes( deformStage_t *ds ) {
+	tessCalc.moveVertexes( ds );
+}
+
 
 /*
 =============
@@ -594,6 +752,27 @@ void RB_DeformTessGeometry( void ) {
 	}
 }
 
+/*
+=====================
+RB_InitTessCalc
+
+Picks the scalar or SIMD versions of the CPU deforms, r_simd is latched
+=====================
+*/
+void RB_InitTessCalc( void ) {
+	tessCalc.deformVertexes = RB_CalcDeformVertexes_scalar;
+	tessCalc.bulgeVertexes = RB_CalcBulgeVertexes_scalar;
+	tessCalc.moveVertexes = RB_CalcMoveVertexes_scalar;
+
+#ifdef USE_SIMD_TESS
+	if ( r_simd->integer ) {
+		tessCalc.deformVertexes = RB_CalcDeformVertexes_simd;
+		tessCalc.bulgeVertexes = RB_CalcBulgeVertexes_simd;
+		tessCalc.moveVertexes = RB_CalcMoveVertexes_simd;
+	}
+#endif
+}
+
 /*
 ====================================================================
 
@@ -23,7 +23,50 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 // tr_shader.c -- this file deals with the parsing and definition of shaders
 
-static char *s_shaderText;
+/*
+All the .shader files are indexed by shader name, the text of a file is
+only loaded when one of its shaders is looked up. The index is kept in
+SHADER_INDEX_FILE and reused while the list of shader files and their
+lengths stay the same, so a start doesn't read and tokenize the scripts
+of every map ever downloaded.
+*/
+#define	SHADER_INDEX_FILE		"shaderindex.dat"
+#define	SHADER_INDEX_IDENT		(('X'<<24)+('I'<<16)+('H'<<8)+'S')
+#define	SHADER_INDEX_VERSION	1
+
+typedef struct {
+	int		ident;
+	int		version;
+	int		numFiles;
+	int		numEntries;
+	int		namesSize;
+} shaderIndexHeader_t;
+
+typedef struct {
+	char	name[MAX_QPATH];
+	int		length;				// as FS_ReadFile reported it
+	int		firstEntry;
+	int		numEntries;
+} shaderIndexFile_t;
+
+typedef struct {
+	int		file;
+	int		name;				// into shaderTextNames
+	int		offset;				// in the file text, where parsing the name starts
+} shaderTextEntry_t;
+
+typedef struct {
+	char	name[MAX_QPATH];
+	int		firstEntry;
+	int		numEntries;
+	char	*text;				// NULL until loaded
+	int		textLength;
+} shaderTextFile_t;
+
+static shaderTextFile_t		*shaderTextFiles;
+static shaderTextEntry_t	*shaderTextEntries;
+static char					*shaderTextNames;
+static qboolean				shaderIndexStale;
 
 // the shader is parsed into these global variables, then copied into
 // dynamically allocated memory if it is valid.
@@ -35,7 +78,7 @@ static	texModInfo_t	texMods[MAX_SHADER_STAGES][TR_MAX_TEXMODS];
 static	shader_t*		hashTable[FILE_HASH_SIZE];
 
 #define MAX_SHADERTEXT_HASH		2048
-static char **shaderTextHashTable[MAX_SHADERTEXT_HASH];
+static shaderTextEntry_t **shaderTextHashTable[MAX_SHADERTEXT_HASH];
 
 /*
 ================
@@ -2666,6 +2709,12 @@ static void FixRenderCommandList( int newShader ) {
 				curCmd = (const void *)(sp_cmd + 1);
 				break;
 				}
+			case RC_STRETCH_PICS:
+				{
+				const stretchPicsCommand_t *sps_cmd = (const stretchPicsCommand_t *)curCmd;
+				curCmd = (const void *)((const stretchPic_t *)(sps_cmd + 1) + sps_cmd->numPics);
+				break;
+				}
 			case RC_DRAW_SURFS:
 				{
 				int i;
@@ -3117,12 +3166,68 @@ static shader_t *FinishShader( void ) {
 
 //========================================================================================
 
+/*
+====================
+R_ShaderFileText
+
+Shader files are only read once one of their shaders is looked up
+====================
+*/
+static char *R_ShaderFileText( int fileNum ) {
+	shaderTextFile_t	*file = &shaderTextFiles[fileNum];
+	char				*buffer;
+	int					len;
+
+	if ( !file->text ) {
+		len = ri.FS_ReadFile( file->name, (void **)&buffer );
+		if ( !buffer ) {
+			ri.Printf( PRINT_WARNING, "WARNING: Couldn't load %s\n", file->name );
+			file->text = "";
+			file->textLength = 0;
+			return file->text;
+		}
+
+		file->text = ri.Hunk_Alloc( len + 1, h_low );
+		Com_Memcpy( file->text, buffer, len );
+		file->text[len] = '\0';
+		file->textLength = len;
+		ri.FS_FreeFile( buffer );
+	}
+
+	return file->text;
+}
+
+/*
+====================
+FindShaderInFile
+
+Slow path for an index that went stale without the file length changing
+====================
+*/
+static char *FindShaderInFile( const char *shadername, int fileNum ) {
+	char	*token, *p;
+
+	p = R_ShaderFileText( fileNum );
+
+	while ( 1 ) {
+		token = COM_ParseExt( &p, qtrue );
+		if ( !token[0] ) {
+			return NULL;
+		}
+
+		if ( !Q_stricmp( token, shadername ) ) {
+			return p;
+		}
+
+		SkipBracedSection( &p, 0 );
+	}
+}
+
 /*
 ====================
 FindShaderInShaderText
 
-Scans the combined text description of all the shader files for
-the given shader name.
+Looks the given shader name up in the index of all the shader files.
 
 return NULL if not found
 
@@ -3130,48 +3235,123 @@ If found, it will return a valid shader
 =====================
 */
 static char *FindShaderInShaderText( const char *shadername ) {
-
-	char *token, *p;
+	shaderTextEntry_t	*entry;
+	char	*token, *p;
 
 	int i, hash;
 
 	hash = generateHashValue(shadername, MAX_SHADERTEXT_HASH);
 
-	if(shaderTextHashTable[hash])
-	{
-		for (i = 0; shaderTextHashTable[hash][i]; i++)
-		{
-			p = shaderTextHashTable[hash][i];
-			token = COM_ParseExt(&p, qtrue);
-		
-			if(!Q_stricmp(token, shadername))
+	if ( !shaderTextHashTable[hash] ) {
+		return NULL;
+	}
+
+	for ( i = 0; shaderTextHashTable[hash][i]; i++ ) {
+		entry = shaderTextHashTable[hash][i];
+		if ( Q_stricmp( shaderTextNames + entry->name, shadername ) ) {
+			continue;
+		}
+
+		p = R_ShaderFileText( entry->file );
+		if ( entry->offset < shaderTextFiles[entry->file].textLength ) {
+			p += entry->offset;
+			token = COM_ParseExt( &p, qtrue );
+			if ( !Q_stricmp( token, shadername ) ) {
 				return p;
+			}
+		}
+
+		// have the next start rebuild the index
+		if ( !shaderIndexStale ) {
+			ri.Printf( PRINT_DEVELOPER, "%s is out of date\n", SHADER_INDEX_FILE );
+			ri.FS_WriteFile( SHADER_INDEX_FILE, "", 0 );
+			shaderIndexStale = qtrue;
+		}
+
+		p = FindShaderInFile( shadername, entry->file );
+		if ( p ) {
+			return p;
 		}
 	}
 
-	p = s_shaderText;
+	return NULL;
+}
 
-	if ( !p ) {
-		return NULL;
+/*
+===============
+R_PrefetchShaderImages
+
+Has the JPEGs the given shaders reference decoded on the worker threads
+before the shaders get registered one by one. A shader without a script
+loads the image of the same name.
+===============
+*/
+#define	MAX_PREFETCH_IMAGES		4096
+
+void R_PrefetchShaderImages( const dshader_t *shaders, int numShaders ) {
+	char		strippedName[MAX_QPATH];
+	char		(*names)[MAX_QPATH];
+	const char	**list;
+	char		*p, *token;
+	int			i, numNames, depth;
+
+	if ( r_prefetchImages->integer <= 0 ) {
+		return;
 	}
 
-	// look for label
-	while ( 1 ) {
-		token = COM_ParseExt( &p, qtrue );
-		if ( token[0] == 0 ) {
-			break;
-		}
+	names = ri.Hunk_AllocateTempMemory( MAX_PREFETCH_IMAGES * sizeof( *names ) );
+	list = ri.Hunk_AllocateTempMemory( MAX_PREFETCH_IMAGES * sizeof( *list ) );
+	numNames = 0;
 
-		if ( !Q_stricmp( token, shadername ) ) {
-			return p;
+	for ( i = 0 ; i < numShaders && numNames < MAX_PREFETCH_IMAGES ; i++ ) {
+		COM_StripExtension( shaders[i].shader, strippedName, sizeof( strippedName ) );
+
+		p = FindShaderInShaderText( strippedName );
+		if ( !p ) {
+			Q_strncpyz( names[numNames++], shaders[i].shader, MAX_QPATH );
+			continue;
 		}
-		else {
-			// skip the definition
-			SkipBracedSection( &p, 0 );
+
+		depth = 0;
+		while ( numNames < MAX_PREFETCH_IMAGES ) {
+			token = COM_ParseExt( &p, qtrue );
+			if ( !token[0] ) {
+				break;
+			}
+
+			if ( token[0] == '{' ) {
+				depth++;
+			} else if ( token[0] == '}' ) {
+				if ( --depth <= 0 ) {
+					break;
+				}
+			} else if ( !Q_stricmp( token, "map" ) || !Q_stricmp( token, "clampmap" ) ) {
+				token = COM_ParseExt( &p, qfalse );
+				if ( token[0] && token[0] != '$' ) {
+					Q_strncpyz( names[numNames++], token, MAX_QPATH );
+				}
+			} else if ( !Q_stricmp( token, "animMap" ) ) {
+				COM_ParseExt( &p, qfalse );		// frequency
+				while ( numNames < MAX_PREFETCH_IMAGES ) {
+					token = COM_ParseExt( &p, qfalse );
+					if ( !token[0] ) {
+						break;
+					}
+					Q_strncpyz( names[numNames++], token, MAX_QPATH );
+				}
+			}
 		}
 	}
 
-	return NULL;
+	for ( i = 0 ; i < numNames ; i++ ) {
+		list[i] = names[i];
+	}
+
+	R_PrefetchJPGs( list, numNames, r_prefetchImages->integer * 1024 * 1024,
+		r_imageUpsample->integer ? 0 : r_picmip->integer );
+
+	ri.Hunk_FreeTempMemory( list );
+	ri.Hunk_FreeTempMemory( names );
 }
 
 
@@ -3647,28 +3827,250 @@ void	R_ShaderList_f (void) {
 	ri.Printf (PRINT_ALL, "------------------\n");
 }
 
+/*
+====================
+R_LoadShaderIndex
+
+Uses SHADER_INDEX_FILE if it was built from exactly the given files
+====================
+*/
+static qboolean R_LoadShaderIndex( char (*names)[MAX_QPATH], const int *lengths, int numFiles ) {
+	shaderIndexHeader_t	*header;
+	shaderIndexFile_t	*files;
+	shaderTextEntry_t	*entries;
+	char				*buffer, *namesText;
+	int					i, len;
+
+	len = ri.FS_ReadFile( SHADER_INDEX_FILE, (void **)&buffer );
+	if ( !buffer ) {
+		return qfalse;
+	}
+
+	header = (shaderIndexHeader_t *)buffer;
+	if ( len < sizeof( *header ) || header->ident != SHADER_INDEX_IDENT || header->version != SHADER_INDEX_VERSION
+		|| header->numFiles != numFiles || header->numEntries < 0 || header->namesSize <= 0
+		|| header->numEntries > len / sizeof( *entries ) || header->namesSize > len
+		|| len != sizeof( *header ) + numFiles * sizeof( *files ) + header->numEntries * sizeof( *entries ) + header->namesSize ) {
+		ri.FS_FreeFile( buffer );
+		return qfalse;
+	}
+
+	files = (shaderIndexFile_t *)( header + 1 );
+	entries = (shaderTextEntry_t *)( files + numFiles );
+	namesText = (char *)( entries + header->numEntries );
+
+	for ( i = 0; i < numFiles; i++ ) {
+		if ( Q_stricmp( files[i].name, names[i] ) || files[i].length != lengths[i]
+			|| files[i].firstEntry < 0 || files[i].numEntries < 0
+			|| files[i].firstEntry + files[i].numEntries > header->numEntries ) {
+			ri.FS_FreeFile( buffer );
+			return qfalse;
+		}
+	}
+
+	for ( i = 0; i < header->numEntries; i++ ) {
+		if ( entries[i].file < 0 || entries[i].file >= numFiles || entries[i].offset < 0
+			|| entries[i].name < 0 || entries[i].name >= header->namesSize ) {
+			ri.FS_FreeFile( buffer );
+			return qfalse;
+		}
+	}
+
+	if ( namesText[header->namesSize - 1] ) {
+		ri.FS_FreeFile( buffer );
+		return qfalse;
+	}
+
+	for ( i = 0; i < numFiles; i++ ) {
+		shaderTextFiles[i].firstEntry = files[i].firstEntry;
+		shaderTextFiles[i].numEntries = files[i].numEntries;
+	}
+
+	shaderTextEntries = ri.Hunk_Alloc( header->numEntries * sizeof( *entries ) + 1, h_low );
+	Com_Memcpy( shaderTextEntries, entries, header->numEntries * sizeof( *entries ) );
+
+	shaderTextNames = ri.Hunk_Alloc( header->namesSize, h_low );
+	Com_Memcpy( shaderTextNames, namesText, header->namesSize );
+
+	ri.FS_FreeFile( buffer );
+
+	return qtrue;
+}
+
+/*
+====================
+R_IndexShaderFiles
+
+Loads all the shader files, indexes their shaders and saves the index
+=====================
+*/
+static void R_IndexShaderFiles( char (*names)[MAX_QPATH], const int *lengths, int numFiles ) {
+	shaderTextEntry_t	*entries = NULL, *newEntries;
+	shaderIndexHeader_t	*header;
+	shaderIndexFile_t	*files;
+	shaderTextFile_t	*file;
+	char	*namesText = NULL, *newNames, *buffer, *p, *oldp, *token;
+	int		maxEntries = 0, numEntries = 0, maxNames = 0, namesSize = 0, fileNames;
+	int		i, len, size, shaderLine;
+	char	shaderName[MAX_QPATH];
+
+	for ( i = 0; i < numFiles; i++ )
+	{
+		file = &shaderTextFiles[i];
+		file->firstEntry = numEntries;
+		fileNames = namesSize;
+
+		ri.Printf( PRINT_DEVELOPER, "...loading '%s'\n", names[i] );
+		len = ri.FS_ReadFile( names[i], (void **)&buffer );
+
+		if ( !buffer )
+			ri.Error( ERR_DROP, "Couldn't load %s", names[i] );
+
+		// Do a simple check on the shader structure in that file to make sure one bad shader file cannot fuck up all other shaders.
+		p = buffer;
+		COM_BeginParseSession( names[i] );
+		while ( 1 )
+		{
+			oldp = p;
+			token = COM_ParseExt( &p, qtrue );
+
+			if ( !*token )
+				break;
+
+			Q_strncpyz( shaderName, token, sizeof( shaderName ) );
+			shaderLine = COM_GetCurrentParseLine();
+
+			token = COM_ParseExt( &p, qtrue );
+			if ( token[0] != '{' || token[1] != '\0' )
+			{
+				ri.Printf( PRINT_WARNING, "WARNING: Ignoring shader file %s. Shader \"%s\" on line %d missing opening brace",
+							names[i], shaderName, shaderLine );
+				if ( token[0] )
+				{
+					ri.Printf( PRINT_WARNING, " (found \"%s\" on line %d)", token, COM_GetCurrentParseLine() );
+				}
+				ri.Printf( PRINT_WARNING, ".\n" );
+				numEntries = file->firstEntry;
+				namesSize = fileNames;
+				break;
+			}
+
+			if ( !SkipBracedSection( &p, 1 ) )
+			{
+				ri.Printf( PRINT_WARNING, "WARNING: Ignoring shader file %s. Shader \"%s\" on line %d missing closing brace.\n",
+							names[i], shaderName, shaderLine );
+				numEntries = file->firstEntry;
+				namesSize = fileNames;
+				break;
+			}
+
+			if ( numEntries == maxEntries ) {
+				maxEntries = maxEntries ? maxEntries * 2 : 1024;
+				newEntries = ri.Malloc( maxEntries * sizeof( *entries ) );
+				if ( entries ) {
+					Com_Memcpy( newEntries, entries, numEntries * sizeof( *entries ) );
+					ri.Free( entries );
+				}
+				entries = newEntries;
+			}
+
+			if ( namesSize + MAX_QPATH > maxNames ) {
+				maxNames = maxNames ? maxNames * 2 : 16384;
+				newNames = ri.Malloc( maxNames );
+				if ( namesText ) {
+					Com_Memcpy( newNames, namesText, namesSize );
+					ri.Free( namesText );
+				}
+				namesText = newNames;
+			}
+
+			entries[numEntries].file = i;
+			entries[numEntries].name = namesSize;
+			entries[numEntries].offset = oldp - buffer;
+			numEntries++;
+
+			Q_strncpyz( namesText + namesSize, shaderName, MAX_QPATH );
+			namesSize += strlen( shaderName ) + 1;
+		}
+
+		file->numEntries = numEntries - file->firstEntry;
+
+		// keep the text, most of it is about to be looked up anyway
+		file->text = ri.Hunk_Alloc( len + 1, h_low );
+		Com_Memcpy( file->text, buffer, len );
+		file->text[len] = '\0';
+		file->textLength = len;
+
+		ri.FS_FreeFile( buffer );
+	}
+
+	shaderTextEntries = ri.Hunk_Alloc( numEntries * sizeof( *entries ) + 1, h_low );
+	shaderTextNames = ri.Hunk_Alloc( namesSize + 1, h_low );
+	if ( numEntries ) {
+		Com_Memcpy( shaderTextEntries, entries, numEntries * sizeof( *entries ) );
+		Com_Memcpy( shaderTextNames, namesText, namesSize );
+	}
+	namesSize++;
+
+	// save the index for the next start
+	size = sizeof( *header ) + numFiles * sizeof( *files ) + numEntries * sizeof( *entries ) + namesSize;
+	buffer = ri.Malloc( size );
+
+	header = (shaderIndexHeader_t *)buffer;
+	header->ident = SHADER_INDEX_IDENT;
+	header->version = SHADER_INDEX_VERSION;
+	header->numFiles = numFiles;
+	header->numEntries = numEntries;
+	header->namesSize = namesSize;
+
+	files = (shaderIndexFile_t *)( header + 1 );
+	for ( i = 0; i < numFiles; i++ ) {
+		Com_Memset( files[i].name, 0, sizeof( files[i].name ) );
+		Q_strncpyz( files[i].name, names[i], sizeof( files[i].name ) );
+		files[i].length = lengths[i];
+		files[i].firstEntry = shaderTextFiles[i].firstEntry;
+		files[i].numEntries = shaderTextFiles[i].numEntries;
+	}
+
+	Com_Memcpy( files + numFiles, shaderTextEntries, numEntries * sizeof( *entries ) );
+	Com_Memcpy( (shaderTextEntry_t *)( files + numFiles ) + numEntries, shaderTextNames, namesSize );
+
+	ri.FS_WriteFile( SHADER_INDEX_FILE, buffer, size );
+
+	ri.Free( buffer );
+	if ( entries ) {
+		ri.Free( entries );
+	}
+	if ( namesText ) {
+		ri.Free( namesText );
+	}
+}
+
 /*
 ====================
 ScanAndLoadShaderFiles
 
-Finds and loads all .shader files, combining them into
-a single large text block that can be scanned for shader names
+Finds all .shader files and indexes the shaders in them by name
 =====================
 */
 #define	MAX_SHADER_FILES	4096
 static void ScanAndLoadShaderFiles( void )
 {
 	char **shaderFiles;
-	char *buffers[MAX_SHADER_FILES] = {NULL};
-	char *p;
+	char (*names)[MAX_QPATH];
+	int *lengths;
 	int numShaderFiles;
-	int i;
-	char *oldp, *token, *hashMem, *textEnd;
+	int i, j;
+	char *hashMem;
 	int shaderTextHashTableSizes[MAX_SHADERTEXT_HASH], hash, size;
-	char shaderName[MAX_QPATH];
-	int shaderLine;
+	shaderTextEntry_t *entry;
+
+	shaderTextFiles = NULL;
+	shaderTextEntries = NULL;
+	shaderTextNames = NULL;
+	shaderIndexStale = qfalse;
+	Com_Memset( shaderTextHashTable, 0, sizeof( shaderTextHashTable ) );
 
-	long sum = 0, summand;
 	// scan for shader files
 	shaderFiles = ri.FS_ListFiles( "scripts", ".shader", &numShaderFiles );
 
@@ -3682,142 +4084,71 @@ static void ScanAndLoadShaderFiles( void )
 		numShaderFiles = MAX_SHADER_FILES;
 	}
 
-	// load and parse shader files
+	names = ri.Hunk_AllocateTempMemory( numShaderFiles * sizeof( *names ) );
+	lengths = ri.Hunk_AllocateTempMemory( numShaderFiles * sizeof( *lengths ) );
+	shaderTextFiles = ri.Hunk_Alloc( numShaderFiles * sizeof( *shaderTextFiles ), h_low );
+
 	for ( i = 0; i < numShaderFiles; i++ )
 	{
-		char filename[MAX_QPATH];
-
 		// look for a .mtr file first
 		{
 			char *ext;
-			Com_sprintf( filename, sizeof( filename ), "scripts/%s", shaderFiles[i] );
-			if ( (ext = strrchr(filename, '.')) )
+			Com_sprintf( names[i], sizeof( names[i] ), "scripts/%s", shaderFiles[i] );
+			if ( (ext = strrchr(names[i], '.')) )
 			{
 				strcpy(ext, ".mtr");
 			}
 
-			if ( ri.FS_ReadFile( filename, NULL ) <= 0 )
+			if ( ri.FS_ReadFile( names[i], NULL ) <= 0 )
 			{
-				Com_sprintf( filename, sizeof( filename ), "scripts/%s", shaderFiles[i] );
+				Com_sprintf( names[i], sizeof( names[i] ), "scripts/%s", shaderFiles[i] );
 			}
 		}
-		
-		ri.Printf( PRINT_DEVELOPER, "...loading '%s'\n", filename );
-		summand = ri.FS_ReadFile( filename, (void **)&buffers[i] );
-		
-		if ( !buffers[i] )
-			ri.Error( ERR_DROP, "Couldn't load %s", filename );
-		
-		// Do a simple check on the shader structure in that file to make sure one bad shader file cannot fuck up all other shaders.
-		p = buffers[i];
-		COM_BeginParseSession(filename);
-		while(1)
-		{
-			token = COM_ParseExt(&p, qtrue);
-			
-			if(!*token)
-				break;
-
-			Q_strncpyz(shaderName, token, sizeof(shaderName));
-			shaderLine = COM_GetCurrentParseLine();
-
-			token = COM_ParseExt(&p, qtrue);
-			if(token[0] != '{' || token[1] != '\0')
-			{
-				ri.Printf(PRINT_WARNING, "WARNING: Ignoring shader file %s. Shader \"%s\" on line %d missing opening brace",
-							filename, shaderName, shaderLine);
-				if (token[0])
-				{
-					ri.Printf(PRINT_WARNING, " (found \"%s\" on line %d)", token, COM_GetCurrentParseLine());
-				}
-				ri.Printf(PRINT_WARNING, ".\n");
-				ri.FS_FreeFile(buffers[i]);
-				buffers[i] = NULL;
-				break;
-			}
-
-			if(!SkipBracedSection(&p, 1))
-			{
-				ri.Printf(PRINT_WARNING, "WARNING: Ignoring shader file %s. Shader \"%s\" on line %d missing closing brace.\n",
-							filename, shaderName, shaderLine);
-				ri.FS_FreeFile(buffers[i]);
-				buffers[i] = NULL;
-				break;
-			}
-		}
-			
-		
-		if (buffers[i])
-			sum += summand;		
+		lengths[i] = ri.FS_ReadFile( names[i], NULL );
+		Q_strncpyz( shaderTextFiles[i].name, names[i], sizeof( shaderTextFiles[i].name ) );
 	}
 
-	// build single large buffer
-	s_shaderText = ri.Hunk_Alloc( sum + numShaderFiles*2, h_low );
-	s_shaderText[ 0 ] = '\0';
-	textEnd = s_shaderText;
- 
-	// free in reverse order, so the temp files are all dumped
-	for ( i = numShaderFiles - 1; i >= 0 ; i-- )
-	{
-		if ( !buffers[i] )
-			continue;
+	// free up memory
+	ri.FS_FreeFileList( shaderFiles );
 
-		strcat( textEnd, buffers[i] );
-		strcat( textEnd, "\n" );
-		textEnd += strlen( textEnd );
-		ri.FS_FreeFile( buffers[i] );
+	if ( !R_LoadShaderIndex( names, lengths, numShaderFiles ) ) {
+		R_IndexShaderFiles( names, lengths, numShaderFiles );
 	}
 
-	COM_Compress( s_shaderText );
-
-	// free up memory
-	ri.FS_FreeFileList( shaderFiles );
+	ri.Hunk_FreeTempMemory( lengths );
+	ri.Hunk_FreeTempMemory( names );
 
 	Com_Memset(shaderTextHashTableSizes, 0, sizeof(shaderTextHashTableSizes));
 	size = 0;
 
-	p = s_shaderText;
-	// look for shader names
-	while ( 1 ) {
-		token = COM_ParseExt( &p, qtrue );
-		if ( token[0] == 0 ) {
-			break;
+	for ( i = 0; i < numShaderFiles; i++ ) {
+		for ( j = 0; j < shaderTextFiles[i].numEntries; j++ ) {
+			entry = &shaderTextEntries[shaderTextFiles[i].firstEntry + j];
+			hash = generateHashValue(shaderTextNames + entry->name, MAX_SHADERTEXT_HASH);
+			shaderTextHashTableSizes[hash]++;
+			size++;
 		}
-
-		hash = generateHashValue(token, MAX_SHADERTEXT_HASH);
-		shaderTextHashTableSizes[hash]++;
-		size++;
-		SkipBracedSection(&p, 0);
 	}
 
 	size += MAX_SHADERTEXT_HASH;
 
-	hashMem = ri.Hunk_Alloc( size * sizeof(char *), h_low );
+	hashMem = ri.Hunk_Alloc( size * sizeof(shaderTextEntry_t *), h_low );
 
 	for (i = 0; i < MAX_SHADERTEXT_HASH; i++) {
-		shaderTextHashTable[i] = (char **) hashMem;
-		hashMem = ((char *) hashMem) + ((shaderTextHashTableSizes[i] + 1) * sizeof(char *));
+		shaderTextHashTable[i] = (shaderTextEntry_t **) hashMem;
+		hashMem = ((char *) hashMem) + ((shaderTextHashTableSizes[i] + 1) * sizeof(shaderTextEntry_t *));
 	}
 
 	Com_Memset(shaderTextHashTableSizes, 0, sizeof(shaderTextHashTableSizes));
 
-	p = s_shaderText;
-	// look for shader names
-	while ( 1 ) {
-		oldp = p;
-		token = COM_ParseExt( &p, qtrue );
-		if ( token[0] == 0 ) {
-			break;
+	// later files win, as they did when the files were combined in reverse order
+	for ( i = numShaderFiles - 1; i >= 0; i-- ) {
+		for ( j = 0; j < shaderTextFiles[i].numEntries; j++ ) {
+			entry = &shaderTextEntries[shaderTextFiles[i].firstEntry + j];
+			hash = generateHashValue(shaderTextNames + entry->name, MAX_SHADERTEXT_HASH);
+			shaderTextHashTable[hash][shaderTextHashTableSizes[hash]++] = entry;
 		}
-
-		hash = generateHashValue(token, MAX_SHADERTEXT_HASH);
-		shaderTextHashTable[hash][shaderTextHashTableSizes[hash]++] = oldp;
-
-		SkipBracedSection(&p, 0);
 	}
-
-	return;
-
 }
 
 
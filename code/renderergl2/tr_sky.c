@@ -238,6 +238,31 @@ static void ClipSkyPolygon (int nump, vec3_t vecs, int stage)
 	ClipSkyPolygon (newc[1], newv[1][0], stage+1);
 }
 
+/*
+================
+SkyClipSides
+
+Bits 0-5 for the sky_clip planes v is in front of, 8-13 for those it is behind
+================
+*/
+static int SkyClipSides( const vec3_t v )
+{
+	float	d;
+	int		i, sides;
+
+	sides = 0;
+	for ( i = 0; i < 6; i++ )
+	{
+		d = DotProduct( v, sky_clip[i] );
+		if ( d > ON_EPSILON )
+			sides |= 1 << i;
+		else if ( d < -ON_EPSILON )
+			sides |= 256 << i;
+	}
+
+	return sides;
+}
+
 /*
 ==============
 ClearSkyBox
@@ -260,19 +285,28 @@ RB_ClipSkyPolygons
 void RB_ClipSkyPolygons( shaderCommands_t *input )
 {
 	vec3_t		p[5];	// need one extra point for clipping
-	int			i, j;
+	int			i, j, sides, front, back;
 
 	ClearSkyBox();
 
 	for ( i = 0; i < input->numIndexes; i += 3 )
 	{
+		front = back = 0;
 		for (j = 0 ; j < 3 ; j++) 
 		{
 			VectorSubtract( input->xyz[input->indexes[i+j]],
 							backEnd.viewParms.or.origin, 
 							p[j] );
+			sides = SkyClipSides( p[j] );
+			front |= sides;
+			back |= sides >> 8;
 		}
-		ClipSkyPolygon( 3, p[0], 0 );
+
+		// a triangle inside one face comes out of the clipping as it went in
+		if ( !( front & back & 63 ) )
+			AddSkyPolygon( 3, p[0] );
+		else
+			ClipSkyPolygon( 3, p[0], 0 );
 	}
 }
 
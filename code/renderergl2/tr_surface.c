@@ -955,9 +955,29 @@ static void RB_SurfaceGrid( srfBspSurface_t *srf ) {
 	int		numVertexes;
 	int		dlightBits;
 	int     pshadowBits;
+	int		lod;
 	//int		*vDlightBits;
 
-	if (RB_SurfaceVaoCached(srf->numVerts, srf->verts, srf->numIndexes,
+	// determine the allowable discrepance
+	lodError = LodErrorForVolume( srf->lodOrigin, srf->lodRadius );
+
+	// the cached path draws the coarsest lod built at load that is
+	// still at least as fine as lodError asks for
+	if (srf->numLods)
+	{
+		for ( lod = srf->numLods - 1 ; lod > 0 ; lod-- ) {
+			if ( GRID_LOD_ERROR( lod ) >= lodError ) {
+				break;
+			}
+		}
+
+		if (RB_SurfaceVaoCached(srf->numVerts, srf->verts, srf->lodNumIndexes[lod],
+			srf->lodIndexes[lod], srf->dlightBits, srf->pshadowBits))
+		{
+			return;
+		}
+	}
+	else if (RB_SurfaceVaoCached(srf->numVerts, srf->verts, srf->numIndexes,
 		srf->indexes, srf->dlightBits, srf->pshadowBits))
 	{
 		return;
@@ -971,9 +991,6 @@ static void RB_SurfaceGrid( srfBspSurface_t *srf ) {
 	pshadowBits = srf->pshadowBits;
 	tess.pshadowBits |= pshadowBits;
 
-	// determine the allowable discrepance
-	lodError = LodErrorForVolume( srf->lodOrigin, srf->lodRadius );
-
 	// determine which rows and columns of the subdivision
 	// we are actually going to use
 	widthTable[0] = 0;
@@ -1314,4 +1331,5 @@ void (*rb_surfaceTable[SF_NUM_SURFACE_TYPES])( void *) = {
 	(void(*)(void*))RB_SurfaceEntity,		// SF_ENTITY
 	(void(*)(void*))RB_SurfaceVaoMdvMesh,   // SF_VAO_MDVMESH
 	(void(*)(void*))RB_IQMSurfaceAnimVao,   // SF_VAO_IQM
+	(void(*)(void*))RB_MDRSurfaceAnimVao,   // SF_VAO_MDR
 };
@@ -168,6 +168,110 @@ vao_t *R_CreateVao(const char *name, byte *vertexes, int vertexesSize, byte *ind
 	return vao;
 }
 
+/*
+Static model VAOs share a few large buffers instead of two buffer objects
+each, filled front to back as models register. The VAO of each model
+buffer owns the buffers, the model VAOs only point into them at
+vertexesOffset and indexesOffset, so the indexes stay relative to the
+surface.
+*/
+#define MAX_MODEL_BUFFERS		16
+#define MODEL_BUFFER_VERTEXES	(8 * 1024 * 1024)
+#define MODEL_BUFFER_INDEXES	(2 * 1024 * 1024)
+
+static struct
+{
+	vao_t *buffers[MAX_MODEL_BUFFERS];
+	int numBuffers;
+
+	int vertexesUsed;
+	int indexesUsed;
+}
+modelBuffers;
+
+/*
+============
+R_CreateModelVao
+
+A static VAO in a shared model buffer, the caller adds vertexesOffset to
+the attrib offsets
+============
+*/
+vao_t *R_CreateModelVao(const char *name, byte *vertexes, int vertexesSize, byte *indexes, int indexesSize)
+{
+	vao_t          *buffer, *vao;
+	int             vertexesOffset, indexesOffset;
+
+	if (vertexesSize > MODEL_BUFFER_VERTEXES || indexesSize > MODEL_BUFFER_INDEXES)
+		return R_CreateVao(name, vertexes, vertexesSize, indexes, indexesSize, VAO_USAGE_STATIC);
+
+	if(strlen(name) >= MAX_QPATH)
+	{
+		ri.Error(ERR_DROP, "R_CreateModelVao: \"%s\" is too long", name);
+	}
+
+	vertexesOffset = PAD(modelBuffers.vertexesUsed, 16);
+	indexesOffset = PAD(modelBuffers.indexesUsed, 16);
+
+	if (!modelBuffers.numBuffers || vertexesOffset + vertexesSize > MODEL_BUFFER_VERTEXES
+		|| indexesOffset + indexesSize > MODEL_BUFFER_INDEXES)
+	{
+		if (modelBuffers.numBuffers == MAX_MODEL_BUFFERS)
+			return R_CreateVao(name, vertexes, vertexesSize, indexes, indexesSize, VAO_USAGE_STATIC);
+
+		modelBuffers.buffers[modelBuffers.numBuffers] = R_CreateVao(va("modelBuffer%d_VAO", modelBuffers.numBuffers),
+			NULL, MODEL_BUFFER_VERTEXES, NULL, MODEL_BUFFER_INDEXES, VAO_USAGE_STATIC);
+		modelBuffers.numBuffers++;
+
+		vertexesOffset = indexesOffset = 0;
+	}
+
+	buffer = modelBuffers.buffers[modelBuffers.numBuffers - 1];
+	modelBuffers.vertexesUsed = vertexesOffset + vertexesSize;
+	modelBuffers.indexesUsed = indexesOffset + indexesSize;
+
+	if ( tr.numVaos == MAX_VAOS ) {
+		ri.Error( ERR_DROP, "R_CreateModelVao: MAX_VAOS hit");
+	}
+
+	R_IssuePendingRenderCommands();
+
+	vao = tr.vaos[tr.numVaos] = ri.Hunk_Alloc(sizeof(*vao), h_low);
+	tr.numVaos++;
+
+	memset(vao, 0, sizeof(*vao));
+
+	Q_strncpyz(vao->name, name, sizeof(vao->name));
+	vao->sharedBuffers = qtrue;
+
+	if (glRefConfig.vertexArrayObject)
+	{
+		qglGenVertexArrays(1, &vao->vao);
+		qglBindVertexArray(vao->vao);
+	}
+
+	vao->vertexesVBO = buffer->vertexesVBO;
+	vao->vertexesSize = vertexesSize;
+	vao->vertexesOffset = vertexesOffset;
+
+	qglBindBuffer(GL_ARRAY_BUFFER, vao->vertexesVBO);
+	qglBufferSubData(GL_ARRAY_BUFFER, vertexesOffset, vertexesSize, vertexes);
+
+	vao->indexesIBO = buffer->indexesIBO;
+	vao->indexesSize = indexesSize;
+	vao->indexesOffset = indexesOffset;
+
+	// bound with the VAO, so it keeps the binding
+	qglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vao->indexesIBO);
+	qglBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexesOffset, indexesSize, indexes);
+
+	glState.currentVao = vao;
+
+	GL_CheckErrors();
+
+	return vao;
+}
+
 /*
 ============
 R_CreateVao2
@@ -410,6 +514,157 @@ void R_BindNullVao(void)
 }
 
 
+/*
+With GL_ARB_buffer_storage the tess VAO streams its vertexes and indexes
+through persistently mapped buffers instead of orphaning them with
+glBufferData before every dynamic draw. Both buffers are split into
+TESS_RING_REGIONS regions written front to back. A region is fenced when
+it is left, at the end of a frame or when it fills up, and the fence is
+waited on before the region is written again.
+*/
+#define TESS_RING_REGIONS		3
+#define TESS_RING_VERTEXES_SIZE	(4 * 1024 * 1024)	// per region
+#define TESS_RING_INDEXES_SIZE	(1024 * 1024)		// per region
+#define TESS_RING_ALIGN			16
+
+static struct
+{
+	qboolean active;
+
+	byte *vertexes;
+	byte *indexes;
+
+	int region;
+	int vertexesUsed;
+	int indexesUsed;
+
+	GLsync fences[TESS_RING_REGIONS];
+}
+tessRing;
+
+/*
+============
+R_InitTessRing
+
+Replaces the buffers R_CreateVao gave the tess VAO, which is still bound
+============
+*/
+static void R_InitTessRing(void)
+{
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	int vertexesSize = tess.vao->vertexesSize;
+	int indexesSize = tess.vao->indexesSize;
+
+	Com_Memset(&tessRing, 0, sizeof(tessRing));
+
+	if (!glRefConfig.bufferStorage)
+		return;
+
+	qglDeleteBuffers(1, &tess.vao->vertexesVBO);
+	qglDeleteBuffers(1, &tess.vao->indexesIBO);
+
+	tess.vao->vertexesSize = TESS_RING_VERTEXES_SIZE * TESS_RING_REGIONS;
+	qglGenBuffers(1, &tess.vao->vertexesVBO);
+	qglBindBuffer(GL_ARRAY_BUFFER, tess.vao->vertexesVBO);
+	qglBufferStorage(GL_ARRAY_BUFFER, tess.vao->vertexesSize, NULL, flags);
+	tessRing.vertexes = qglMapBufferRange(GL_ARRAY_BUFFER, 0, tess.vao->vertexesSize, flags);
+
+	tess.vao->indexesSize = TESS_RING_INDEXES_SIZE * TESS_RING_REGIONS;
+	qglGenBuffers(1, &tess.vao->indexesIBO);
+	qglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tess.vao->indexesIBO);
+	qglBufferStorage(GL_ELEMENT_ARRAY_BUFFER, tess.vao->indexesSize, NULL, flags);
+	tessRing.indexes = qglMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, tess.vao->indexesSize, flags);
+
+	if (tessRing.vertexes && tessRing.indexes)
+	{
+		tessRing.active = qtrue;
+		ri.Printf(PRINT_ALL, "streaming tess geometry through %i mapped regions\n", TESS_RING_REGIONS);
+		return;
+	}
+
+	ri.Printf(PRINT_WARNING, "R_InitTessRing: couldn't map buffers, orphaning them instead\n");
+
+	// immutable storage can't be orphaned, go back to plain buffers
+	qglDeleteBuffers(1, &tess.vao->vertexesVBO);
+	qglDeleteBuffers(1, &tess.vao->indexesIBO);
+
+	Com_Memset(&tessRing, 0, sizeof(tessRing));
+
+	tess.vao->vertexesSize = vertexesSize;
+	qglGenBuffers(1, &tess.vao->vertexesVBO);
+	qglBindBuffer(GL_ARRAY_BUFFER, tess.vao->vertexesVBO);
+	qglBufferData(GL_ARRAY_BUFFER, vertexesSize, NULL, GL_DYNAMIC_DRAW);
+
+	tess.vao->indexesSize = indexesSize;
+	qglGenBuffers(1, &tess.vao->indexesIBO);
+	qglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tess.vao->indexesIBO);
+	qglBufferData(GL_ELEMENT_ARRAY_BUFFER, indexesSize, NULL, GL_DYNAMIC_DRAW);
+}
+
+/*
+============
+R_ShutdownTessRing
+
+The buffers are unmapped when R_ShutdownVaos deletes them
+============
+*/
+static void R_ShutdownTessRing(void)
+{
+	int i;
+
+	for (i = 0; i < TESS_RING_REGIONS; i++)
+	{
+		if (tessRing.fences[i])
+			qglDeleteSync(tessRing.fences[i]);
+	}
+
+	Com_Memset(&tessRing, 0, sizeof(tessRing));
+}
+
+/*
+============
+RB_TessRingNextRegion
+============
+*/
+static void RB_TessRingNextRegion(void)
+{
+	GLsync fence;
+
+	tessRing.fences[tessRing.region] = qglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	tessRing.region = (tessRing.region + 1) % TESS_RING_REGIONS;
+	tessRing.vertexesUsed = 0;
+	tessRing.indexesUsed = 0;
+
+	fence = tessRing.fences[tessRing.region];
+	if (fence)
+	{
+		GLenum status;
+
+		do
+		{
+			status = qglClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000 * 1000 * 1000);
+		}
+		while (status == GL_TIMEOUT_EXPIRED);
+
+		qglDeleteSync(fence);
+		tessRing.fences[tessRing.region] = NULL;
+	}
+}
+
+/*
+============
+RB_TessRingEndFrame
+
+Called from RB_SwapBuffers, so a frame never shares a region with the next
+============
+*/
+void RB_TessRingEndFrame(void)
+{
+	if (tessRing.active && (tessRing.vertexesUsed || tessRing.indexesUsed))
+		RB_TessRingNextRegion();
+}
+
 /*
 ============
 R_InitVaos
@@ -424,6 +679,8 @@ void R_InitVaos(void)
 
 	tr.numVaos = 0;
 
+	Com_Memset(&modelBuffers, 0, sizeof(modelBuffers));
+
 	vertexesSize  = sizeof(tess.xyz[0]);
 	vertexesSize += sizeof(tess.normal[0]);
 	vertexesSize += sizeof(tess.tangent[0]);
@@ -437,6 +694,8 @@ void R_InitVaos(void)
 
 	tess.vao = R_CreateVao("tessVertexArray_VAO", NULL, vertexesSize, NULL, indexesSize, VAO_USAGE_DYNAMIC);
 
+	R_InitTessRing();
+
 	offset = 0;
 
 	tess.vao->attribs[ATTR_INDEX_POSITION      ].enabled = 1;
@@ -518,6 +777,8 @@ void R_ShutdownVaos(void)
 
 	R_BindNullVao();
 
+	R_ShutdownTessRing();
+
 	for(i = 0; i < tr.numVaos; i++)
 	{
 		vao = tr.vaos[i];
@@ -525,6 +786,10 @@ void R_ShutdownVaos(void)
 		if(vao->vao)
 			qglDeleteVertexArrays(1, &vao->vao);
 
+		// the model buffer VAO deletes those
+		if(vao->sharedBuffers)
+			continue;
+
 		if(vao->vertexesVBO)
 		{
 			qglDeleteBuffers(1, &vao->vertexesVBO);
@@ -537,6 +802,8 @@ void R_ShutdownVaos(void)
 	}
 
 	tr.numVaos = 0;
+
+	Com_Memset(&modelBuffers, 0, sizeof(modelBuffers));
 }
 
 /*
@@ -561,7 +828,9 @@ void R_VaoList_f(void)
 		ri.Printf(PRINT_ALL, "%d.%02d MB %s\n", vao->vertexesSize / (1024 * 1024),
 				  (vao->vertexesSize % (1024 * 1024)) * 100 / (1024 * 1024), vao->name);
 
-		vertexesSize += vao->vertexesSize;
+		// counted with their model buffer
+		if (!vao->sharedBuffers)
+			vertexesSize += vao->vertexesSize;
 	}
 
 	for(i = 0; i < tr.numVaos; i++)
@@ -571,7 +840,8 @@ void R_VaoList_f(void)
 		ri.Printf(PRINT_ALL, "%d.%02d MB %s\n", vao->indexesSize / (1024 * 1024),
 				  (vao->indexesSize % (1024 * 1024)) * 100 / (1024 * 1024), vao->name);
 
-		indexesSize += vao->indexesSize;
+		if (!vao->sharedBuffers)
+			indexesSize += vao->indexesSize;
 	}
 
 	ri.Printf(PRINT_ALL, " %i total VAOs\n", tr.numVaos);
@@ -603,10 +873,9 @@ void RB_UpdateTessVao(unsigned int attribBits)
 		int attribIndex;
 		int attribUpload;
 
-		R_BindVao(tess.vao);
+		int indexesSize = tess.numIndexes * sizeof(tess.indexes[0]);
 
-		// orphan old vertex buffer so we don't stall on it
-		qglBufferData(GL_ARRAY_BUFFER, tess.vao->vertexesSize, NULL, GL_DYNAMIC_DRAW);
+		R_BindVao(tess.vao);
 
 		// if nothing to set, set everything
 		if(!(attribBits & ATTR_BITS))
@@ -614,12 +883,42 @@ void RB_UpdateTessVao(unsigned int attribBits)
 
 		attribUpload = attribBits;
 
+		if (tessRing.active)
+		{
+			int vertexesSize = 0;
+
+			for (attribIndex = 0; attribIndex < ATTR_INDEX_COUNT; attribIndex++)
+			{
+				if (attribUpload & (1 << attribIndex))
+					vertexesSize += PAD(tess.numVertexes * tess.vao->attribs[attribIndex].stride, TESS_RING_ALIGN);
+			}
+
+			if (tessRing.vertexesUsed + vertexesSize > TESS_RING_VERTEXES_SIZE || tessRing.indexesUsed + indexesSize > TESS_RING_INDEXES_SIZE)
+				RB_TessRingNextRegion();
+		}
+		else
+		{
+			// orphan old vertex buffer so we don't stall on it
+			qglBufferData(GL_ARRAY_BUFFER, tess.vao->vertexesSize, NULL, GL_DYNAMIC_DRAW);
+		}
+
 		for (attribIndex = 0; attribIndex < ATTR_INDEX_COUNT; attribIndex++)
 		{
 			uint32_t attribBit = 1 << attribIndex;
 			vaoAttrib_t *vAtb = &tess.vao->attribs[attribIndex];
 
-			if (attribUpload & attribBit)
+			if ((attribUpload & attribBit) && tessRing.active)
+			{
+				int size = tess.numVertexes * vAtb->stride;
+				int offset = tessRing.region * TESS_RING_VERTEXES_SIZE + tessRing.vertexesUsed;
+
+				// the attrib moves with every upload, so its pointer is always set
+				Com_Memcpy(tessRing.vertexes + offset, tess.attribPointers[attribIndex], size);
+				qglVertexAttribPointer(attribIndex, vAtb->count, vAtb->type, vAtb->normalized, vAtb->stride, BUFFER_OFFSET(offset));
+
+				tessRing.vertexesUsed += PAD(size, TESS_RING_ALIGN);
+			}
+			else if (attribUpload & attribBit)
 			{
 				// note: tess has a VBO where stride == size
 				qglBufferSubData(GL_ARRAY_BUFFER, vAtb->offset, tess.numVertexes * vAtb->stride, tess.attribPointers[attribIndex]);
@@ -627,7 +926,7 @@ void RB_UpdateTessVao(unsigned int attribBits)
 
 			if (attribBits & attribBit)
 			{
-				if (!glRefConfig.vertexArrayObject)
+				if (!glRefConfig.vertexArrayObject && !tessRing.active)
 					qglVertexAttribPointer(attribIndex, vAtb->count, vAtb->type, vAtb->normalized, vAtb->stride, BUFFER_OFFSET(vAtb->offset));
 
 				if (!(glState.vertexAttribsEnabled & attribBit))
@@ -646,10 +945,21 @@ void RB_UpdateTessVao(unsigned int attribBits)
 			}
 		}
 
-		// orphan old index buffer so we don't stall on it
-		qglBufferData(GL_ELEMENT_ARRAY_BUFFER, tess.vao->indexesSize, NULL, GL_DYNAMIC_DRAW);
+		if (tessRing.active)
+		{
+			tess.vao->indexesOffset = tessRing.region * TESS_RING_INDEXES_SIZE + tessRing.indexesUsed;
+
+			Com_Memcpy(tessRing.indexes + tess.vao->indexesOffset, tess.indexes, indexesSize);
+
+			tessRing.indexesUsed += indexesSize;
+		}
+		else
+		{
+			// orphan old index buffer so we don't stall on it
+			qglBufferData(GL_ELEMENT_ARRAY_BUFFER, tess.vao->indexesSize, NULL, GL_DYNAMIC_DRAW);
 
-		qglBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, tess.numIndexes * sizeof(tess.indexes[0]), tess.indexes);
+			qglBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexesSize, tess.indexes);
+		}
 	}
 }
 
@@ -703,6 +1013,28 @@ typedef struct buffered_s
 }
 buffered_t;
 
+// surface vertexes already in the vertex buffer, and batches already in
+// the index buffer, found by hashing instead of searching every batch
+#define VAOCACHE_VERTEX_SETS (VAOCACHE_MAX_SURFACES * 2)
+#define VAOCACHE_BATCH_SETS (VAOCACHE_MAX_BATCHES * 2)
+
+typedef struct vertexSet_s
+{
+	srfVert_t *vertexes;
+	int numVerts;
+	int bufferOffset;
+	int generation;
+}
+vertexSet_t;
+
+typedef struct batchSet_s
+{
+	int batch;
+	int firstSurface;
+	int generation;
+}
+batchSet_t;
+
 static struct
 {
 	vao_t *vao;
@@ -714,48 +1046,110 @@ static struct
 
 	int vertexOffset;
 	int indexOffset;
+
+	vertexSet_t vertexSets[VAOCACHE_VERTEX_SETS];
+	int numVertexSets;
+	int vertexGeneration;
+
+	batchSet_t batchSets[VAOCACHE_BATCH_SETS];
+	int batchGeneration;
 }
 vc;
 
-void VaoCache_Commit(void)
+static ID_INLINE unsigned VaoCache_HashPointer(const void *p)
 {
-	buffered_t *indexSet;
-	int *batchLength;
-	queuedSurface_t *surf, *end = vcq.surfaces + vcq.numSurfaces;
+	uintptr_t v = (uintptr_t)p;
 
-	R_BindVao(vc.vao);
+	v ^= v >> 17;
+	v *= 0x9e3779b1u;
+	return (unsigned)(v ^ (v >> 15));
+}
+
+static ID_INLINE unsigned VaoCache_BatchHash(const queuedSurface_t *first, int numSurfaces)
+{
+	return (VaoCache_HashPointer(first->indexes) + numSurfaces * 0x85ebca6bu) & (VAOCACHE_BATCH_SETS - 1);
+}
+
+/*
+Returns the vertex set of verts, or the empty slot to store it in
+*/
+static vertexSet_t *VaoCache_FindVertexSet(srfVert_t *verts)
+{
+	unsigned hash = VaoCache_HashPointer(verts) & (VAOCACHE_VERTEX_SETS - 1);
+	vertexSet_t *set;
 
-	// Search for a matching batch
-	// FIXME: Use faster search
-	indexSet = vc.surfaceIndexSets;
-	batchLength = vc.batchLengths;
-	for (; batchLength < vc.batchLengths + vc.numBatches; batchLength++)
+	for (;;)
 	{
-		if (*batchLength == vcq.numSurfaces)
-		{
-			buffered_t *indexSet2 = indexSet;
-			for (surf = vcq.surfaces; surf < end; surf++, indexSet2++)
-			{
-				if (surf->indexes != indexSet2->data || (surf->numIndexes * sizeof(glIndex_t)) != indexSet2->size)
-					break;
-			}
+		set = vc.vertexSets + hash;
+		if (set->generation != vc.vertexGeneration || set->vertexes == verts)
+			return set;
+		hash = (hash + 1) & (VAOCACHE_VERTEX_SETS - 1);
+	}
+}
+
+/*
+Returns the first surface index set of a batch matching the queue, or NULL
+*/
+static buffered_t *VaoCache_FindBatch(void)
+{
+	unsigned hash = VaoCache_BatchHash(vcq.surfaces, vcq.numSurfaces);
+	queuedSurface_t *surf, *end = vcq.surfaces + vcq.numSurfaces;
+	batchSet_t *set;
+
+	for (;;)
+	{
+		buffered_t *indexSet;
+
+		set = vc.batchSets + hash;
+		if (set->generation != vc.batchGeneration)
+			return NULL;
 
-			if (surf == end)
+		hash = (hash + 1) & (VAOCACHE_BATCH_SETS - 1);
+
+		if (vc.batchLengths[set->batch] != vcq.numSurfaces)
+			continue;
+
+		indexSet = vc.surfaceIndexSets + set->firstSurface;
+		for (surf = vcq.surfaces; surf < end; surf++, indexSet++)
+		{
+			if (surf->indexes != indexSet->data || (surf->numIndexes * sizeof(glIndex_t)) != indexSet->size)
 				break;
 		}
 
-		indexSet += *batchLength;
+		if (surf == end)
+			return vc.surfaceIndexSets + set->firstSurface;
 	}
+}
+
+static void VaoCache_AddBatch(int batch, int firstSurface)
+{
+	unsigned hash = VaoCache_BatchHash(vcq.surfaces, vcq.numSurfaces);
+
+	while (vc.batchSets[hash].generation == vc.batchGeneration)
+		hash = (hash + 1) & (VAOCACHE_BATCH_SETS - 1);
+
+	vc.batchSets[hash].batch = batch;
+	vc.batchSets[hash].firstSurface = firstSurface;
+	vc.batchSets[hash].generation = vc.batchGeneration;
+}
+
+void VaoCache_Commit(void)
+{
+	buffered_t *indexSet;
+	int *batchLength;
+	queuedSurface_t *surf, *end = vcq.surfaces + vcq.numSurfaces;
+
+	R_BindVao(vc.vao);
+
+	indexSet = VaoCache_FindBatch();
 
 	// If found, use it
-	if (indexSet < vc.surfaceIndexSets + vc.numSurfaces)
+	if (indexSet)
 	{
 		tess.firstIndex = indexSet->bufferOffset / sizeof(glIndex_t);
-		//ri.Printf(PRINT_ALL, "firstIndex %d numIndexes %d as %d\n", tess.firstIndex, tess.numIndexes, (int)(batchLength - vc.batchLengths));
-		//ri.Printf(PRINT_ALL, "vc.numSurfaces %d vc.numBatches %d\n", vc.numSurfaces, vc.numBatches);
 	}
-	// If not, rebuffer the batch
-	// FIXME: keep track of the vertexes so we don't have to reupload them every time
+	// If not, rebuffer the indexes of the batch, and the vertexes of the
+	// surfaces that aren't in the vertex buffer yet
 	else
 	{
 		srfVert_t *dstVertex = vcq.vertexes;
@@ -763,6 +1157,7 @@ void VaoCache_Commit(void)
 
 		batchLength = vc.batchLengths + vc.numBatches;
 		*batchLength = vcq.numSurfaces;
+		VaoCache_AddBatch(vc.numBatches, vc.numSurfaces);
 		vc.numBatches++;
 
 		tess.firstIndex = vc.indexOffset / sizeof(glIndex_t);
@@ -773,12 +1168,32 @@ void VaoCache_Commit(void)
 			glIndex_t *srcIndex = surf->indexes;
 			int vertexesSize = surf->numVerts * sizeof(srfVert_t);
 			int indexesSize = surf->numIndexes * sizeof(glIndex_t);
-			int i, indexOffset = (vc.vertexOffset + vcq.vertexCommitSize) / sizeof(srfVert_t);
+			vertexSet_t *vertexSet = VaoCache_FindVertexSet(surf->vertexes);
+			int i, indexOffset;
+
+			if (vertexSet->generation == vc.vertexGeneration && vertexSet->numVerts == surf->numVerts)
+			{
+				indexOffset = vertexSet->bufferOffset / sizeof(srfVert_t);
+			}
+			else
+			{
+				indexOffset = (vc.vertexOffset + vcq.vertexCommitSize) / sizeof(srfVert_t);
 
-			Com_Memcpy(dstVertex, surf->vertexes, vertexesSize);
-			dstVertex += surf->numVerts;
+				// keep the table at most half full
+				if (vertexSet->generation != vc.vertexGeneration && vc.numVertexSets < VAOCACHE_VERTEX_SETS / 2)
+				{
+					vertexSet->vertexes = surf->vertexes;
+					vertexSet->numVerts = surf->numVerts;
+					vertexSet->bufferOffset = vc.vertexOffset + vcq.vertexCommitSize;
+					vertexSet->generation = vc.vertexGeneration;
+					vc.numVertexSets++;
+				}
 
-			vcq.vertexCommitSize += vertexesSize;
+				Com_Memcpy(dstVertex, surf->vertexes, vertexesSize);
+				dstVertex += surf->numVerts;
+
+				vcq.vertexCommitSize += vertexesSize;
+			}
 
 			indexSet = vc.surfaceIndexSets + vc.numSurfaces;
 			indexSet->data = surf->indexes;
@@ -792,8 +1207,6 @@ void VaoCache_Commit(void)
 			vcq.indexCommitSize += indexesSize;
 		}
 
-		//ri.Printf(PRINT_ALL, "committing %d to %d, %d to %d as %d\n", vcq.vertexCommitSize, vc.vertexOffset, vcq.indexCommitSize, vc.indexOffset, (int)(batchLength - vc.batchLengths));
-
 		if (vcq.vertexCommitSize)
 		{
 			qglBindBuffer(GL_ARRAY_BUFFER, vc.vao->vertexesVBO);
@@ -868,6 +1281,9 @@ void VaoCache_Init(void)
 	vc.numBatches = 0;
 	vc.vertexOffset = 0;
 	vc.indexOffset = 0;
+	vc.numVertexSets = 0;
+	vc.vertexGeneration++;
+	vc.batchGeneration++;
 	vcq.vertexCommitSize = 0;
 	vcq.indexCommitSize = 0;
 	vcq.numSurfaces = 0;
@@ -936,6 +1352,8 @@ void VaoCache_RecycleVertexBuffer(void)
 	qglBindBuffer(GL_ARRAY_BUFFER, vc.vao->vertexesVBO);
 	qglBufferData(GL_ARRAY_BUFFER, vc.vao->vertexesSize, NULL, GL_DYNAMIC_DRAW);
 	vc.vertexOffset = 0;
+	vc.numVertexSets = 0;
+	vc.vertexGeneration++;
 }
 
 void VaoCache_RecycleIndexBuffer(void)
@@ -945,6 +1363,7 @@ void VaoCache_RecycleIndexBuffer(void)
 	vc.indexOffset = 0;
 	vc.numSurfaces = 0;
 	vc.numBatches = 0;
+	vc.batchGeneration++;
 }
 
 void VaoCache_InitQueue(void)
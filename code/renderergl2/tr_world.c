@@ -394,6 +394,206 @@ void R_AddBrushModelSurfaces ( trRefEntity_t *ent ) {
 */
 
 
+/*
+=============================================================================
+
+OCCLUSION CULLING
+
+The bounds of every leaf the primary view reaches are drawn against the
+finished depth buffer inside a GL occlusion query, see RB_OcclusionQueries.
+Results are read back when the GPU has them, typically a frame or two
+later, so a leaf that comes out from behind a wall can be missing for that
+long. Results older than OCCLUSION_RESULT_FRAMES are not trusted, and all
+of them are dropped when the view jumps.
+
+=============================================================================
+*/
+
+#define	OCCLUSION_RESULT_FRAMES	3
+#define	OCCLUSION_MAX_MOVE		64		// per frame, more is a teleport or a new follow target
+#define	OCCLUSION_NEAR_DIST		32		// leaf bounds this close to the view are always visible
+
+/*
+================
+R_OcclusionResults
+
+Collects the query results that have arrived since the last frame
+================
+*/
+static void R_OcclusionResults( void ) {
+	occlusionQuery_t	*q;
+	GLuint				available, samples;
+	int					i;
+
+	if ( Distance( tr.viewParms.or.origin, tr.occlusionOrigin ) > OCCLUSION_MAX_MOVE ) {
+		tr.occlusionResetFrame = tr.frameCount;
+	}
+	VectorCopy( tr.viewParms.or.origin, tr.occlusionOrigin );
+
+	tr.numOcclusionLeafs = 0;
+
+	for ( i = 0, q = tr.occlusionQueries ; i < MAX_OCCLUSION_QUERIES && tr.occlusionQueriesOut ; i++, q++ ) {
+		if ( !q->leaf ) {
+			continue;
+		}
+
+		if ( q->issued ) {
+			qglGetQueryObjectuiv( q->query, GL_QUERY_RESULT_AVAILABLE, &available );
+			if ( !available ) {
+				continue;
+			}
+
+			qglGetQueryObjectuiv( q->query, GL_QUERY_RESULT, &samples );
+			q->leaf->occluded = !samples;
+			q->leaf->occlusionFrame = q->frame;
+		}
+
+		// a query that never reached the back end is just dropped
+		q->leaf->occlusionQuery = 0;
+		q->leaf = NULL;
+		tr.occlusionQueriesOut--;
+	}
+}
+
+/*
+================
+R_LeafOcclusionValid
+================
+*/
+static qboolean R_LeafOcclusionValid( const mnode_t *leaf ) {
+	return leaf->occluded && leaf->occlusionFrame >= tr.occlusionResetFrame
+		&& tr.frameCount - leaf->occlusionFrame <= OCCLUSION_RESULT_FRAMES;
+}
+
+/*
+================
+R_LeafOccluded
+
+Queues a new query for the leaf unless one is still out, and returns
+the last result
+================
+*/
+static qboolean R_LeafOccluded( mnode_t *leaf ) {
+	occlusionQuery_t	*q;
+	int					i, index;
+
+	// the bounds could be clipped by the near plane
+	for ( i = 0 ; i < 3 ; i++ ) {
+		if ( tr.viewParms.or.origin[i] < leaf->mins[i] - OCCLUSION_NEAR_DIST
+			|| tr.viewParms.or.origin[i] > leaf->maxs[i] + OCCLUSION_NEAR_DIST ) {
+			break;
+		}
+	}
+	if ( i == 3 ) {
+		leaf->occluded = qfalse;
+		return qfalse;
+	}
+
+	if ( !leaf->occlusionQuery && tr.occlusionQueriesOut < MAX_OCCLUSION_QUERIES ) {
+		for ( i = 0 ; i < MAX_OCCLUSION_QUERIES ; i++ ) {
+			index = ( tr.occlusionQueryCursor + i ) % MAX_OCCLUSION_QUERIES;
+			q = &tr.occlusionQueries[index];
+			if ( !q->leaf ) {
+				q->leaf = leaf;
+				q->frame = tr.frameCount;
+				q->issued = qfalse;
+				leaf->occlusionQuery = index + 1;
+				tr.occlusionLeafs[tr.numOcclusionLeafs++] = index;
+				tr.occlusionQueriesOut++;
+				tr.occlusionQueryCursor = index + 1;
+				break;
+			}
+		}
+	}
+
+	return R_LeafOcclusionValid( leaf );
+}
+
+/*
+================
+R_BoxOccluded_r
+================
+*/
+static qboolean R_BoxOccluded_r( mnode_t *node, vec3_t mins, vec3_t maxs ) {
+	int		side;
+
+	while ( node->contents == -1 ) {
+		side = BoxOnPlaneSide( mins, maxs, node->plane );
+		if ( side == 1 ) {
+			node = node->children[0];
+		} else if ( side == 2 ) {
+			node = node->children[1];
+		} else {
+			if ( !R_BoxOccluded_r( node->children[0], mins, maxs ) ) {
+				return qfalse;
+			}
+			node = node->children[1];
+		}
+	}
+
+	// nothing in a solid leaf can be seen
+	if ( node->cluster == -1 ) {
+		return qtrue;
+	}
+
+	return R_LeafOcclusionValid( node );
+}
+
+/*
+================
+R_EntityOccluded
+
+A model is hidden if every leaf its bounding sphere touches is
+================
+*/
+qboolean R_EntityOccluded( const trRefEntity_t *ent ) {
+	vec3_t		mins, maxs;
+	float		radius, scale;
+	int			i;
+
+	if ( ent->e.renderfx & ( RF_FIRST_PERSON | RF_DEPTHHACK ) ) {
+		return qfalse;
+	}
+
+	if ( tr.currentModel->type == MOD_MESH ) {
+		mdvModel_t	*model = tr.currentModel->mdv[0];
+		mdvFrame_t	*frame, *oldFrame;
+
+		if ( ent->e.frame < 0 || ent->e.frame >= model->numFrames
+			|| ent->e.oldframe < 0 || ent->e.oldframe >= model->numFrames ) {
+			return qfalse;
+		}
+		frame = model->frames + ent->e.frame;
+		oldFrame = model->frames + ent->e.oldframe;
+
+		radius = MAX( frame->radius + VectorLength( frame->localOrigin ),
+			oldFrame->radius + VectorLength( oldFrame->localOrigin ) );
+	} else {
+		R_ModelBounds( ent->e.hModel, mins, maxs );
+		radius = RadiusFromBounds( mins, maxs );
+	}
+
+	if ( radius <= 0 ) {
+		return qfalse;
+	}
+
+	if ( ent->e.nonNormalizedAxes ) {
+		scale = 0;
+		for ( i = 0 ; i < 3 ; i++ ) {
+			scale = MAX( scale, VectorLength( ent->e.axis[i] ) );
+		}
+		radius *= scale;
+	}
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		mins[i] = ent->e.origin[i] - radius;
+		maxs[i] = ent->e.origin[i] + radius;
+	}
+
+	return R_BoxOccluded_r( tr.world->nodes, mins, maxs );
+}
+
+
 /*
 ================
 R_RecursiveWorldNode
@@ -414,56 +614,21 @@ static void R_RecursiveWorldNode( mnode_t *node, uint32_t planeBits, uint32_t dl
 		// if the bounding volume is outside the frustum, nothing
 		// inside can be visible OPTIMIZE: don't do this all the way to leafs?
 
-		if ( !r_nocull->integer ) {
-			int		r;
+		if ( !r_nocull->integer && planeBits ) {
+			int		sides[5];
+			int		i;
+			int		numPlanes = ( planeBits & 16 ) ? 5 : 4;
 
-			if ( planeBits & 1 ) {
-				r = BoxOnPlaneSide(node->mins, node->maxs, &tr.viewParms.frustum[0]);
-				if (r == 2) {
-					return;						// culled
+			qmath.BoxOnPlaneSides( node->mins, node->maxs, tr.viewParms.frustum, numPlanes, sides );
+			for ( i = 0 ; i < numPlanes ; i++ ) {
+				if ( !( planeBits & ( 1 << i ) ) ) {
+					continue;
 				}
-				if ( r == 1 ) {
-					planeBits &= ~1;			// all descendants will also be in front
-				}
-			}
-
-			if ( planeBits & 2 ) {
-				r = BoxOnPlaneSide(node->mins, node->maxs, &tr.viewParms.frustum[1]);
-				if (r == 2) {
+				if ( sides[i] == 2 ) {
 					return;						// culled
 				}
-				if ( r == 1 ) {
-					planeBits &= ~2;			// all descendants will also be in front
-				}
-			}
-
-			if ( planeBits & 4 ) {
-				r = BoxOnPlaneSide(node->mins, node->maxs, &tr.viewParms.frustum[2]);
-				if (r == 2) {
-					return;						// culled
-				}
-				if ( r == 1 ) {
-					planeBits &= ~4;			// all descendants will also be in front
-				}
-			}
-
-			if ( planeBits & 8 ) {
-				r = BoxOnPlaneSide(node->mins, node->maxs, &tr.viewParms.frustum[3]);
-				if (r == 2) {
-					return;						// culled
-				}
-				if ( r == 1 ) {
-					planeBits &= ~8;			// all descendants will also be in front
-				}
-			}
-
-			if ( planeBits & 16 ) {
-				r = BoxOnPlaneSide(node->mins, node->maxs, &tr.viewParms.frustum[4]);
-				if (r == 2) {
-					return;						// culled
-				}
-				if ( r == 1 ) {
-					planeBits &= ~16;			// all descendants will also be in front
+				if ( sides[i] == 1 ) {
+					planeBits &= ~( 1 << i );	// all descendants will also be in front
 				}
 			}
 		}
@@ -559,6 +724,11 @@ static void R_RecursiveWorldNode( mnode_t *node, uint32_t planeBits, uint32_t dl
 			tr.viewParms.visBounds[1][2] = node->maxs[2];
 		}
 
+		if ( ( tr.viewParms.flags & VPF_OCCLUSIONCULL ) && R_LeafOccluded( node ) ) {
+			tr.pc.c_occludedLeafs++;
+			return;
+		}
+
 		// add surfaces
 		view = tr.world->marksurfaces + node->firstmarksurface;
 
@@ -705,30 +875,37 @@ static void R_MarkLeaves (void) {
 	}
 
 	vis = R_ClusterPVS(tr.visClusters[tr.visIndex]);
-	
-	for (i=0,leaf=tr.world->nodes ; i<tr.world->numnodes ; i++, leaf++) {
-		cluster = leaf->cluster;
-		if ( cluster < 0 || cluster >= tr.world->numClusters ) {
-			continue;
-		}
 
-		// check general pvs
-		if ( vis && !(vis[cluster>>3] & (1<<(cluster&7))) ) {
-			continue;
-		}
+	for ( cluster = 0 ; cluster < tr.world->numClusters ; cluster++ ) {
+		if ( vis ) {
+			// skip eight clusters at a time outside the pvs
+			if ( !( cluster & 7 ) && !vis[cluster>>3] ) {
+				cluster += 7;
+				continue;
+			}
 
-		// check for door connection
-		if ( (tr.refdef.areamask[leaf->area>>3] & (1<<(leaf->area&7)) ) ) {
-			continue;		// not visible
+			// check general pvs
+			if ( !(vis[cluster>>3] & (1<<(cluster&7))) ) {
+				continue;
+			}
 		}
 
-		parent = leaf;
-		do {
-			if(parent->visCounts[tr.visIndex] == tr.visCounts[tr.visIndex])
-				break;
-			parent->visCounts[tr.visIndex] = tr.visCounts[tr.visIndex];
-			parent = parent->parent;
-		} while (parent);
+		for ( i = tr.world->clusterFirstLeaf[cluster] ; i < tr.world->clusterFirstLeaf[cluster + 1] ; i++ ) {
+			leaf = tr.world->clusterLeafs[i];
+
+			// check for door connection
+			if ( (tr.refdef.areamask[leaf->area>>3] & (1<<(leaf->area&7)) ) ) {
+				continue;		// not visible
+			}
+
+			parent = leaf;
+			do {
+				if(parent->visCounts[tr.visIndex] == tr.visCounts[tr.visIndex])
+					break;
+				parent->visCounts[tr.visIndex] = tr.visCounts[tr.visIndex];
+				parent = parent->parent;
+			} while (parent);
+		}
 	}
 }
 
@@ -770,6 +947,10 @@ void R_AddWorldSurfaces (void) {
 
 	planeBits = (tr.viewParms.flags & VPF_FARPLANEFRUSTUM) ? 31 : 15;
 
+	if ( tr.viewParms.flags & VPF_OCCLUSIONCULL ) {
+		R_OcclusionResults ();
+	}
+
 	if ( tr.viewParms.flags & VPF_DEPTHSHADOW )
 	{
 		dlightBits = 0;
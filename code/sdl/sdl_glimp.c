@@ -48,6 +48,16 @@ typedef enum
 SDL_Window *SDL_window = NULL;
 static SDL_GLContext SDL_glContext = NULL;
 
+static SDL_mutex *smpMutex = NULL;
+static SDL_cond *renderCommandsEvent = NULL;
+static SDL_cond *renderCompletedEvent = NULL;
+static SDL_Thread *renderThread = NULL;
+static void (*renderThreadFunction)( void ) = NULL;
+static void *smpData = NULL;
+static qboolean smpDataReady = qfalse;
+static qboolean renderThreadActive = qfalse;
+static qboolean frontEndOwnsContext = qtrue;
+
 cvar_t *r_allowSoftwareGL; // Don't abort out if a hardware visual can't be obtained
 cvar_t *r_allowResize; // make window resizable
 cvar_t *r_centerWindow;
@@ -76,12 +86,18 @@ QGL_DESKTOP_1_1_FIXED_FUNCTION_PROCS;
 QGL_ES_1_1_PROCS;
 QGL_ES_1_1_FIXED_FUNCTION_PROCS;
 QGL_1_3_PROCS;
+QGL_DESKTOP_1_3_PROCS;
 QGL_1_5_PROCS;
 QGL_2_0_PROCS;
 QGL_3_0_PROCS;
 QGL_ARB_occlusion_query_PROCS;
 QGL_ARB_framebuffer_object_PROCS;
 QGL_ARB_vertex_array_object_PROCS;
+QGL_ARB_get_program_binary_PROCS;
+QGL_ARB_buffer_storage_PROCS;
+QGL_ARB_pixel_buffer_object_PROCS;
+QGL_ARB_timer_query_PROCS;
+QGL_EXT_texture_array_PROCS;
 QGL_EXT_direct_state_access_PROCS;
 #undef GLE
 
@@ -291,6 +307,11 @@ static qboolean GLimp_GetProcAddresses( qboolean fixedFunction ) {
 			QGL_1_1_FIXED_FUNCTION_PROCS;
 			QGL_DESKTOP_1_1_PROCS;
 			QGL_DESKTOP_1_1_FIXED_FUNCTION_PROCS;
+			// vertex buffers for the world and occlusion culling, optional
+			if ( QGL_VERSION_ATLEAST( 1, 5 ) ) {
+				QGL_1_5_PROCS;
+				QGL_ARB_occlusion_query_PROCS;
+			}
 		} else if ( qglesMajorVersion == 1 && qglesMinorVersion >= 1 ) {
 			// OpenGL ES 1.1 (2.0 is not backward compatible)
 			QGL_1_1_PROCS;
@@ -353,12 +374,18 @@ static void GLimp_ClearProcAddresses( void ) {
 	QGL_ES_1_1_PROCS;
 	QGL_ES_1_1_FIXED_FUNCTION_PROCS;
 	QGL_1_3_PROCS;
+	QGL_DESKTOP_1_3_PROCS;
 	QGL_1_5_PROCS;
 	QGL_2_0_PROCS;
 	QGL_3_0_PROCS;
 	QGL_ARB_occlusion_query_PROCS;
 	QGL_ARB_framebuffer_object_PROCS;
 	QGL_ARB_vertex_array_object_PROCS;
+	QGL_ARB_get_program_binary_PROCS;
+	QGL_ARB_buffer_storage_PROCS;
+	QGL_ARB_pixel_buffer_object_PROCS;
+	QGL_ARB_timer_query_PROCS;
+	QGL_EXT_texture_array_PROCS;
 	QGL_EXT_direct_state_access_PROCS;
 
 	qglActiveTextureARB = NULL;
@@ -1115,6 +1142,22 @@ void GLimp_EndFrame( void )
 		SDL_GL_SwapWindow( SDL_window );
 	}
 
+	// the render thread leaves the window to the front end
+	if ( !renderThread )
+	{
+		GLimp_CheckFullscreen( );
+	}
+}
+
+/*
+===============
+GLimp_CheckFullscreen
+
+Applies a changed r_fullscreen, from the main thread
+===============
+*/
+void GLimp_CheckFullscreen( void )
+{
 	if( r_fullscreen->modified )
 	{
 		int         fullscreen;
@@ -1148,3 +1191,199 @@ void GLimp_EndFrame( void )
 		r_fullscreen->modified = qfalse;
 	}
 }
+
+/*
+===========================================================
+
+SMP acceleration
+
+The back end runs on its own thread while the main thread builds the
+next frame. A GL context is only current on one thread at a time, so
+it is handed over with every batch: the render thread releases it before
+it goes to sleep, the front end takes it back when it needs GL itself.
+
+===========================================================
+*/
+
+/*
+===============
+GLimp_RenderThreadWrapper
+===============
+*/
+static int GLimp_RenderThreadWrapper( void *arg )
+{
+	renderThreadFunction( );
+	return 0;
+}
+
+/*
+===============
+GLimp_DestroyRenderThreadObjects
+===============
+*/
+static void GLimp_DestroyRenderThreadObjects( void )
+{
+	if ( renderCommandsEvent )
+	{
+		SDL_DestroyCond( renderCommandsEvent );
+		renderCommandsEvent = NULL;
+	}
+	if ( renderCompletedEvent )
+	{
+		SDL_DestroyCond( renderCompletedEvent );
+		renderCompletedEvent = NULL;
+	}
+	if ( smpMutex )
+	{
+		SDL_DestroyMutex( smpMutex );
+		smpMutex = NULL;
+	}
+}
+
+/*
+===============
+GLimp_SpawnRenderThread
+===============
+*/
+qboolean GLimp_SpawnRenderThread( void (*function)( void ) )
+{
+	smpMutex = SDL_CreateMutex( );
+	renderCommandsEvent = SDL_CreateCond( );
+	renderCompletedEvent = SDL_CreateCond( );
+
+	if ( !smpMutex || !renderCommandsEvent || !renderCompletedEvent )
+	{
+		ri.Printf( PRINT_ALL, "GLimp_SpawnRenderThread: %s\n", SDL_GetError( ) );
+		GLimp_DestroyRenderThreadObjects( );
+		return qfalse;
+	}
+
+	renderThreadFunction = function;
+	smpData = NULL;
+	smpDataReady = qfalse;
+	frontEndOwnsContext = qtrue;
+
+	// active until it first goes to sleep
+	renderThreadActive = qtrue;
+
+	renderThread = SDL_CreateThread( GLimp_RenderThreadWrapper, "render", NULL );
+	if ( !renderThread )
+	{
+		ri.Printf( PRINT_ALL, "SDL_CreateThread failed: %s\n", SDL_GetError( ) );
+		renderThreadActive = qfalse;
+		GLimp_DestroyRenderThreadObjects( );
+		return qfalse;
+	}
+
+	return qtrue;
+}
+
+/*
+===============
+GLimp_ShutdownRenderThread
+===============
+*/
+void GLimp_ShutdownRenderThread( void )
+{
+	if ( !renderThread )
+	{
+		return;
+	}
+
+	GLimp_FrontEndSleep( );
+	GLimp_WakeRenderer( NULL );
+
+	SDL_WaitThread( renderThread, NULL );
+	renderThread = NULL;
+	renderThreadActive = qfalse;
+
+	SDL_GL_MakeCurrent( SDL_window, SDL_glContext );
+	frontEndOwnsContext = qtrue;
+
+	GLimp_DestroyRenderThreadObjects( );
+}
+
+/*
+===============
+GLimp_RendererSleep
+
+Called on the render thread, returns the next batch or NULL to quit
+===============
+*/
+void *GLimp_RendererSleep( void )
+{
+	void *data;
+
+	SDL_GL_MakeCurrent( SDL_window, NULL );
+
+	SDL_LockMutex( smpMutex );
+
+	renderThreadActive = qfalse;
+	SDL_CondSignal( renderCompletedEvent );
+
+	while ( !smpDataReady )
+	{
+		SDL_CondWait( renderCommandsEvent, smpMutex );
+	}
+
+	data = smpData;
+	smpDataReady = qfalse;
+
+	SDL_UnlockMutex( smpMutex );
+
+	if ( data )
+	{
+		SDL_GL_MakeCurrent( SDL_window, SDL_glContext );
+	}
+
+	return data;
+}
+
+/*
+===============
+GLimp_FrontEndSleep
+
+Waits for the render thread to go idle and makes the context current on
+the main thread
+===============
+*/
+void GLimp_FrontEndSleep( void )
+{
+	SDL_LockMutex( smpMutex );
+	while ( renderThreadActive )
+	{
+		SDL_CondWait( renderCompletedEvent, smpMutex );
+	}
+	SDL_UnlockMutex( smpMutex );
+
+	if ( !frontEndOwnsContext )
+	{
+		SDL_GL_MakeCurrent( SDL_window, SDL_glContext );
+		frontEndOwnsContext = qtrue;
+	}
+}
+
+/*
+===============
+GLimp_WakeRenderer
+
+Hands a batch to the idle render thread, see GLimp_FrontEndSleep
+===============
+*/
+void GLimp_WakeRenderer( void *data )
+{
+	if ( frontEndOwnsContext )
+	{
+		SDL_GL_MakeCurrent( SDL_window, NULL );
+		frontEndOwnsContext = qfalse;
+	}
+
+	SDL_LockMutex( smpMutex );
+
+	smpData = data;
+	smpDataReady = qtrue;
+	renderThreadActive = qtrue;
+	SDL_CondSignal( renderCommandsEvent );
+
+	SDL_UnlockMutex( smpMutex );
+}
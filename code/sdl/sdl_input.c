@@ -43,6 +43,7 @@ static qboolean mouseActive = qfalse;
 
 static cvar_t *in_mouse             = NULL;
 static cvar_t *in_nograb;
+static cvar_t *in_mouseSampling     = NULL;
 
 static cvar_t *in_joystick          = NULL;
 static cvar_t *in_joystickThreshold = NULL;
@@ -52,6 +53,7 @@ static cvar_t *in_joystickUseAnalog = NULL;
 static int vidRestartTime = 0;
 
 static int in_eventTime = 0;
+static int in_lastMotionTime = 0;
 
 static SDL_Window *SDL_window = NULL;
 
@@ -999,6 +1001,61 @@ static void IN_JoyMove( void )
 	stick_state.oldaxes = axes;
 }
 
+/*
+===============
+IN_QueueMotion
+
+Stamped with when SDL got it rather than when the frame got to it
+===============
+*/
+static void IN_QueueMotion( const SDL_MouseMotionEvent *motion, int ticksToMsec )
+{
+	int time;
+
+	if( !motion->xrel && !motion->yrel )
+		return;
+
+	time = motion->timestamp + ticksToMsec;
+	if( time - in_eventTime < 0 )
+		time = in_eventTime;
+	if( time - in_lastMotionTime < 0 )
+		time = in_lastMotionTime;
+	in_lastMotionTime = time;
+
+	Com_QueueEvent( time, SE_MOUSE, motion->xrel, motion->yrel, 0, NULL );
+}
+
+/*
+===============
+IN_SampleMouse
+
+SDL has to pump events on the thread that owns the window, so rather than
+reading the mouse on a thread of its own, Com_Frame calls this while it
+waits for the next frame and sleeps no more than a msec in between.
+Returns qfalse when it has nothing to sample.
+===============
+*/
+qboolean IN_SampleMouse( void )
+{
+	SDL_Event e[32];
+	int i, n, ticksToMsec;
+
+	if( !mouseActive || !in_mouseSampling->integer )
+		return qfalse;
+
+	SDL_PumpEvents( );
+	ticksToMsec = Sys_Milliseconds( ) - SDL_GetTicks( );
+
+	while( ( n = SDL_PeepEvents( e, ARRAY_LEN( e ), SDL_GETEVENT,
+		SDL_MOUSEMOTION, SDL_MOUSEMOTION ) ) > 0 )
+	{
+		for( i = 0; i < n; i++ )
+			IN_QueueMotion( &e[i].motion, ticksToMsec );
+	}
+
+	return qtrue;
+}
+
 /*
 ===============
 IN_ProcessEvents
@@ -1009,10 +1066,14 @@ static void IN_ProcessEvents( void )
 	SDL_Event e;
 	keyNum_t key = 0;
 	static keyNum_t lastKeyDown = 0;
+	int ticksToMsec;
 
 	if( !SDL_WasInit( SDL_INIT_VIDEO ) )
 			return;
 
+	SDL_PumpEvents( );
+	ticksToMsec = Sys_Milliseconds( ) - SDL_GetTicks( );
+
 	while( SDL_PollEvent( &e ) )
 	{
 		switch( e.type )
@@ -1091,11 +1152,7 @@ static void IN_ProcessEvents( void )
 
 			case SDL_MOUSEMOTION:
 				if( mouseActive )
-				{
-					if( !e.motion.xrel && !e.motion.yrel )
-						break;
-					Com_QueueEvent( in_eventTime, SE_MOUSE, e.motion.xrel, e.motion.yrel, 0, NULL );
-				}
+					IN_QueueMotion( &e.motion, ticksToMsec );
 				break;
 
 			case SDL_MOUSEBUTTONDOWN:
@@ -1258,6 +1315,7 @@ void IN_Init( void *windowData )
 	// mouse variables
 	in_mouse = Cvar_Get( "in_mouse", "1", CVAR_ARCHIVE );
 	in_nograb = Cvar_Get( "in_nograb", "0", CVAR_ARCHIVE );
+	in_mouseSampling = Cvar_Get( "in_mouseSampling", "1", CVAR_ARCHIVE );
 
 	in_joystick = Cvar_Get( "in_joystick", "0", CVAR_ARCHIVE|CVAR_LATCH );
 	in_joystickThreshold = Cvar_Get( "joy_threshold", "0.15", CVAR_ARCHIVE );
@@ -78,6 +78,9 @@ static void SNDDMA_AudioCallback(void *userdata, Uint8 *stream, int len)
 		int len1 = len;
 		int len2 = 0;
 
+		/* with s_threadedMix, this is where the mixing happens. */
+		S_Base_MixThread(dmapos / dma.channels, len / (dma.samplebits/8) / dma.channels);
+
 		if (len1 > tobufend)
 		{
 			len1 = tobufend;
@@ -36,15 +36,23 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #ifdef USE_VOIP
 #define VOIP_QUEUE_LENGTH 64
 
+// what the client encodes into one packet, so any packet fits a voice datagram
+#define VOIP_MAX_PACKET_SIZE	1024
+
+// voice datagrams stay below the netchan fragment size when they can
+#define VOIP_DATAGRAM_SIZE		1200
+
+// one per incoming packet, shared by the queues of all its recipients
 typedef struct voipServerPacket_s
 {
+	int	refCount;
 	int	generation;
 	int	sequence;
 	int	frames;
 	int	len;
 	int	sender;
 	int	flags;
-	byte data[4000];
+	byte data[VOIP_MAX_PACKET_SIZE];
 } voipServerPacket_t;
 #endif
 
@@ -62,13 +70,13 @@ typedef struct skeetInfo_s {
 typedef struct svEntity_s {
 	struct worldSector_s *worldSector;
 	struct svEntity_s *nextEntityInWorldSector;
+	struct svEntity_s *prevEntityInWorldSector;
 	
 	entityState_t	baseline;		// for delta compression of initial sighting
 	int			numClusters;		// if -1, use headnode instead
 	int			clusternums[MAX_ENT_CLUSTERS];
 	int			lastCluster;		// if all the clusters don't fit in clusternums
 	int			areanum, areanum2;
-	int			snapshotCounter;	// used to prevent double adding from portal views
 #ifdef USE_SKEETMOD
 	skeetInfo_t	skeetInfo;
 #endif
@@ -89,7 +97,6 @@ typedef struct {
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=475
 	// the serverId associated with the current checksumFeed (always <= serverId)
 	int				checksumFeedServerId;	
-	int				snapshotCounter;	// incremented for each snapshot built
 	int				timeResidual;		// <= 1000 / sv_frame->value
 	int				nextFrameTime;		// when time > nextFrameTime, process world
 	char			*configstrings[MAX_CONFIGSTRINGS];
@@ -122,11 +129,11 @@ typedef struct {
 	byte			areabits[MAX_MAP_AREA_BYTES];		// portalarea visibility bits
 	playerState_t	ps;
 	int				num_entities;
-	int				first_entity;		// into the circular sv_packet_entities[]
+	unsigned		first_entity;		// into the client's ring, see SV_SnapshotEntity
 										// the entities MUST be in increasing state number
 										// order, otherwise the delta compression will fail
-	int				messageSent;		// time the message was transmitted
-	int				messageAcked;		// time the message was acked
+	int64_t			messageSent;		// Sys_Microseconds the message was transmitted
+	int64_t			messageAcked;		// Sys_Microseconds the ack was read, 0 if not yet
 	int				messageSize;		// used to rate drop packets
 } clientSnapshot_t;
 
@@ -148,12 +155,34 @@ typedef struct netchan_buffer_s {
 	struct netchan_buffer_s *next;
 } netchan_buffer_t;
 
+// a client's connection over the last whole second, see SV_NetStatsFrame
+typedef struct {
+	int64_t			windowStart;		// Sys_Microseconds
+	int				packetsIn;			// the client_t totals when the window started
+	int				packetsLost;
+	int				snapshots;
+	int				choked;
+	int64_t			bytesIn;
+	int64_t			bytesOut;
+
+	float			loss;				// of the client's packets, 0 - 1
+	float			choke;				// of the snapshots due, held back by rate or fragments
+	int				bytesInRate;		// per second
+	int				bytesOutRate;
+
+	int64_t			lastRtt;			// usec
+	float			jitter;				// usec, mean RTT change as in RFC 3550
+} clientNetStats_t;
+
 typedef struct client_s {
 	clientState_t	state;
 	char			userinfo[MAX_INFO_STRING];		// name, etc
 	char			userinfobuffer[MAX_INFO_STRING]; //used for buffering of user info
+	qboolean		userinfoQueued;		// in svs.userinfoPending until userinfobuffer is applied
 
-	char			reliableCommands[MAX_RELIABLE_COMMANDS][MAX_STRING_CHARS];
+	// reliableCommands and frames are the bulk of a client and are only
+	// allocated once a slot is used, see SV_AllocClientStorage
+	char			(*reliableCommands)[MAX_STRING_CHARS];	// MAX_RELIABLE_COMMANDS
 	int				reliableSequence;		// last added reliable message, not necessarily sent or acknowledged yet
 	int				reliableAcknowledge;	// last acknowledged reliable message
 	int				reliableSent;			// last sent reliable message, not necessarily acknowledged yet
@@ -176,11 +205,24 @@ typedef struct client_s {
 	int				lastConnectTime;	// svs.time when connection started
 	int				lastSnapshotTime;	// svs.time of last sent snapshot
 	qboolean		rateDelayed;		// true if nextSnapshotTime was set based on rate instead of snapshotMsec
+	int				rateTokens;			// bytes that may still be sent, see SV_RateMsec
+	int64_t			rateTime;			// Sys_Microseconds of the last refill
+	int				packetsIn;			// totals since the connect, for sv_metrics
+	int				packetsLost;
+	int				packetsOut;
+	int64_t			bytesIn;
+	int64_t			bytesOut;
+	int				snapshotsSent;
+	int				snapshotsChoked;	// server frames a due snapshot was held back
+	clientNetStats_t	netStats;
 	int				timeoutCount;		// must timeout a few frames in a row so debugging doesn't break
-	clientSnapshot_t	frames[PACKET_BACKUP];	// updates can be delta'd from here
+	clientSnapshot_t	*frames;			// PACKET_BACKUP, updates can be delta'd from here
+	unsigned		nextSnapshotEntities;	// next of the client's snapshotEntities to use, wraps
+	int				lastSnapshotSequence;	// netchan sequence of the last snapshot stored
 	int				ping;
 	int				rate;				// bytes / second
 	int				snapshotMsec;		// requests a snapshot every snapshotMsec unless rate choked
+	int				snapshotAdaptMsec;	// longer than snapshotMsec if the connection can't keep up, see SV_AdaptSnapshotRate
 	int				pureAuthentic;
 	qboolean  gotCP; // TTimo - additional flag to distinguish between a bad pure checksum, and no cp command at all
 	netchan_t		netchan;
@@ -193,11 +235,13 @@ typedef struct client_s {
 	netchan_buffer_t *netchan_start_queue;
 	netchan_buffer_t **netchan_end_queue;
 
-	qboolean	demo_recording;	// are we currently recording this client?
-	fileHandle_t	demo_file;	// the file we are writing the demo to
+	qboolean	demo_recording;	// are we currently recording this client? see sv_demo.c
 	qboolean	demo_waiting;	// are we still waiting for the first non-delta frame?
 	int		demo_backoff;	// how many packets (-1 actually) between non-delta frames?
 	int		demo_deltas;	// how many delta frames did we let through so far?
+	qboolean	demo_indexed;	// writing keyframes for seeking, see DEMO_KEYFRAME
+	qboolean	demo_keyframe;	// put one in front of the full snapshot being sent
+	int		demo_keyframeTime;	// sv.time of the last keyframe
 
 #ifdef USE_VOIP
 	qboolean hasVoip;
@@ -210,6 +254,7 @@ typedef struct client_s {
 
 	int				oldServerTime;
 	qboolean		csUpdated[MAX_CONFIGSTRINGS];
+	qboolean		csDelta;			// client understands "csd" configstring deltas
 	
 #ifdef LEGACY_PROTOCOL
 	qboolean		compat;
@@ -253,18 +298,21 @@ typedef struct {
 	qboolean	initialized;				// sv_init has completed
 
 	int			time;						// will be strictly increasing across level changes
-	int			msgTime;					// will be used as precise sent time
 
 	int			snapFlagServerBit;			// ^= SNAPFLAG_SERVERCOUNT every SV_SpawnServer()
 
 	client_t	*clients;					// [sv_maxclients->integer];
-	int			numSnapshotEntities;		// sv_maxclients->integer*PACKET_BACKUP*MAX_SNAPSHOT_ENTITIES
-	int			nextSnapshotEntities;		// next snapshotEntities to use
-	entityState_t	*snapshotEntities;		// [numSnapshotEntities]
+	int			numSnapshotEntities;		// per client, PACKET_BACKUP*MAX_SNAPSHOT_ENTITIES, a power of two
+	entityState_t	*snapshotEntities;		// [sv_maxclients->integer][numSnapshotEntities]
 	int			nextHeartbeatTime;
 	challenge_t	challenges[MAX_CHALLENGES];	// to prevent invalid IPs from connecting
 	netadr_t	redirectAddress;			// for rcon return messages
-	int			masterResolveTime[MAX_MASTER_SERVERS]; // next svs.time that server should do dns lookup for master server
+
+	qboolean	idle;						// no players for sv_idleTime
+	int			lastPlayerTime;				// Sys_Milliseconds with a player on
+
+	int			userinfoPending[MAX_CLIENTS];	// clients with a held back userinfo, see SV_CheckClientUserinfoTimer
+	int			numUserinfoPending;
 } serverStatic_t;
 
 
@@ -294,7 +342,7 @@ typedef struct {
 // This value takes into account increments due to the presence of '$'.
 #define MAX_SAY_STRLEN 256
 
-#define SERVER_MAXBANS	1024
+#define SERVER_MAXBANS	65536
 // Structure for managing bans
 typedef struct
 {
@@ -312,6 +360,9 @@ extern	server_t		sv;					// cleared each map
 extern	vm_t			*gvm;				// game virtual machine
 
 extern	cvar_t	*sv_fps;
+extern	cvar_t	*sv_idleTime;
+extern	cvar_t	*sv_idleFps;
+extern	cvar_t	*sv_idlePause;
 extern	cvar_t	*sv_timeout;
 extern	cvar_t	*sv_zombietime;
 extern	cvar_t	*sv_rconPassword;
@@ -340,13 +391,38 @@ extern	cvar_t	*sv_floodProtect;
 extern	cvar_t	*sv_lanForceRate;
 extern	cvar_t	*sv_banFile;
 extern	cvar_t	*sv_clientsPerIp;
-
-extern	serverBan_t serverBans[SERVER_MAXBANS];
+extern	cvar_t	*sv_deltaCache;
+extern	cvar_t	*sv_snapshotBudget;
+extern	cvar_t	*sv_snapshotAdapt;
+extern	cvar_t	*sv_worldIndex;
+extern	cvar_t	*sv_traceCache;
+extern	cvar_t	*sv_profile;
+extern	cvar_t	*sv_loadTestResults;
+extern	cvar_t	*sv_benchDemo;
+extern	cvar_t	*sv_benchMaps;
+extern	cvar_t	*sv_benchResults;
+extern	cvar_t	*sv_benchBaseline;
+extern	cvar_t	*sv_benchTolerance;
+extern	cvar_t	*sv_benchMsec;
+extern	cvar_t	*sv_csDelta;
+extern	cvar_t	*sv_mtu;
+extern	cvar_t	*sv_logFlushMsec;
+extern	cvar_t	*sv_logBufferSize;
+extern	cvar_t	*sv_demoBufferSize;
+extern	cvar_t	*sv_demoKeyframes;
+extern	cvar_t	*sv_mapPrefetch;
+extern	cvar_t	*sv_antilag;
+extern	cvar_t	*sv_gamestateLimit;
+extern	cvar_t	*sv_httpPort;
+extern	cvar_t	*sv_httpMaxConnections;
+extern	cvar_t	*sv_metrics;
+
+extern	serverBan_t *serverBans;
 extern	int serverBansCount;
 
 extern	cvar_t	*sv_demonotice;			// notice to print to a client being recorded server-side
 extern	cvar_t	*sv_demofolder;			// define the server-side demo folder name
-extern	cvar_t	*sv_autoRecordDemo;		// automatically create a server demo of every player that connects
+extern	cvar_t	*sv_autoRecordDemo;		// 1: a server demo of every player that connects, 2: a world demo of every map
 extern	cvar_t	*sv_sayprefix;
 extern	cvar_t	*sv_tellprefix;
 extern	cvar_t	*sv_teamSwitch;			// allow players to switch teams (0, Default = players must wait 5 seconds to switch, 1 = no restriction)
@@ -380,25 +456,37 @@ extern	cvar_t	*sv_skeetfansize;		// spread of the skeet launcher (defaults to 14
 //
 typedef struct leakyBucket_s leakyBucket_t;
 struct leakyBucket_s {
-	netadrtype_t	type;
-
-	union {
-		byte	_4[4];
-		byte	_6[16];
-	} ipv;
-
-	int						lastTime;
+	int				lastTime;
+	byte			key[8];		// IPv4 address or IPv6 /64 prefix
+	byte			type;		// netadrtype_t
+	byte			command;	// svcCommand_t the bucket limits
 	signed char		burst;
-
-	long					hash;
-
-	leakyBucket_t *prev, *next;
+	byte			unused;
 };
 
+// connectionless commands that get their own per address buckets
+typedef enum {
+	SVC_OTHER,
+	SVC_GETSTATUS,
+	SVC_GETINFO,
+	SVC_GETCHALLENGE,
+	SVC_CONNECT,
+	SVC_RCON,
+	SVC_MTUPROBE,
+	SVC_NUM_COMMANDS
+} svcCommand_t;
+
 extern leakyBucket_t outboundLeakyBucket;
 
 qboolean	SVC_RateLimit( leakyBucket_t *bucket, int burst, int period );
 qboolean	SVC_RateLimitAddress( netadr_t from, int burst, int period );
+void		SVC_PacketStats_f( void );
+const char	*SVC_CommandCounts( int command, int *accepted, int *dropped );
+void		SVC_InvalidateResponses( void );
+
+void		SV_InfoCvarChanged( cvar_t *var );
+void		SV_RebuildInfoStrings( void );
+const char	*SV_InfoString( int bit );
 
 void		SV_FinalMessage (char *message);
 void QDECL	SV_SendServerCommand( client_t *cl, const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
@@ -409,7 +497,11 @@ void		SV_RemoveOperatorCommands (void);
 
 
 void		SV_MasterShutdown (void);
+int			SV_ClientRate(client_t *client);
+void		SV_NetStatsRtt( client_t *cl, int64_t rtt );
 int			SV_RateMsec(client_t *client);
+int			SV_MaxPacketLength( netadr_t adr );
+void		SV_RateSent(client_t *client);
 
 
 //
@@ -425,6 +517,166 @@ float		SV_XORShiftRandRange(float min, float max);
 void		SV_XORShiftRandSeed(unsigned int seed);
 
 
+//
+// sv_demo.c
+//
+#define	WORLDDEMO_VERSION		1
+#define	WORLDDEMO_MAX_USERCMDS	64		// per client and frame, the rest are dropped
+
+// world demo records, see sv_demo.c
+typedef enum {
+	wd_bad,
+	wd_gamestate,		// time, configstrings, baselines
+	wd_configstring,	// index, string
+	wd_command,			// client or -1 for everyone, command
+	wd_frame			// time, entities, entity flags, clients
+} worldDemoRecord_t;
+
+qboolean	SVD_OpenWriter( client_t *client, const char *path );
+void		SVD_WriteData( const client_t *client, const void *data, int length );
+qboolean	SVD_AddKeyframe( const client_t *client, int serverTime );
+void		SVD_WriteIndex( const client_t *client );
+void		SVD_CloseWriter( client_t *client );
+void		SVD_WriterFrame( void );
+void		SVD_ShutdownWriter( void );
+void		SVD_StartWorldDemo( const char *name );
+void		SVD_StopWorldDemo( void );
+void		SVD_WorldConfigstring( int index, const char *value );
+void		SVD_WorldCommand( int clientNum, const char *text );
+void		SVD_WorldUsercmd( const client_t *client, const usercmd_t *cmd );
+void		SVD_WorldDemoFrame( void );
+void		SV_StartWorldDemo_f( void );
+void		SV_StopWorldDemo_f( void );
+
+
+//
+// sv_bans.c
+//
+qboolean	SV_IsBanned( const netadr_t *from );
+void		SV_RebuildBanTrie( void );
+qboolean	SV_ReserveBans( int count );
+void		SV_LoadBans( void );
+qboolean	SV_FinishLoadingBans( qboolean block );
+void		SV_BansFrame( void );
+void		SV_ShutdownBans( void );
+
+
+//
+// sv_log.c
+//
+void		SV_LogWrite( const char *text, int length );
+void		SV_LogFrame( void );
+void		SV_LogCheckRotate( void );
+void		SV_LogRotate_f( void );
+void		SV_LogShutdown( void );
+
+
+//
+// sv_prefetch.c
+//
+void		SV_PrefetchFrame( void );
+void		SV_PrefetchMapChange( const char *map );
+void		SV_Prefetch_f( void );
+void		SV_PrefetchShutdown( void );
+
+
+//
+// sv_http.c
+//
+void		SV_HttpFrame( void );
+void		SV_HttpSetFiles( void );
+void		SV_HttpInfo_f( void );
+void		SV_HttpShutdown( void );
+void		SV_HttpSetMetrics( const char *text, int length );
+
+
+//
+// sv_metrics.c
+//
+typedef enum {
+	SVM_PACKETS_IN,
+	SVM_BYTES_IN,
+	SVM_PACKETS_LOST,		// sequence gaps Netchan_Process saw
+	SVM_PACKETS_OUT,
+	SVM_BYTES_OUT,
+	SVM_RELIABLE_OVERFLOWS,
+	SVM_SNAPSHOT_OVERFLOWS,
+	SVM_NUM_METRICS
+} svMetric_t;
+
+extern	int64_t	svMetrics[SVM_NUM_METRICS];
+
+int64_t		SV_MetricsStart( void );
+void		SV_MetricsFrame( int64_t start, int frameMsec );
+
+
+//
+// sv_profile.c
+//
+typedef enum {
+	SVPROF_CALCPINGS,
+	SVPROF_GAME,
+	SVPROF_TIMEOUTS,
+	SVPROF_SEND,
+	SVPROF_HEARTBEAT,
+	SVPROF_SKEET,
+	SVPROF_FRAME,			// all of SV_Frame after the early outs
+	SVPROF_NUM_STAGES
+} svProfileStage_t;
+
+void		SV_ProfileReset( void );
+int64_t		SV_ProfileStart( void );
+void		SV_ProfileEnd( svProfileStage_t stage, int64_t start );
+void		SV_ProfileFrame( int64_t start, int frameMsec );
+int			SV_ProfileSummary( svProfileStage_t stage, int *mean, int *p99, int *max );
+int			SV_ProfileOverBudget( void );
+void		SV_ProfileStats_f( void );
+
+
+//
+// sv_loadtest.c
+//
+void		SV_LoadTestFrame( int msec );
+void		SV_LoadTestShutdown( void );
+void		SV_LoadTest_f( void );
+
+
+//
+// sv_capture.c
+//
+typedef enum {
+	SVCAP_CHALLENGE,
+	SVCAP_CHECKSUMFEED,
+	SVCAP_SERVERID,
+	SVCAP_TIME				// svs.time when a map starts
+} svCaptureValue_t;
+
+void		SV_CaptureSpawn( const char *mapname );
+int			SV_CaptureValue( svCaptureValue_t kind, int value );
+void		SV_CapturePacket( const netadr_t *from, const msg_t *msg );
+void		SV_CaptureFrame( int msec );
+void		SV_CaptureShutdown( void );
+void		SV_Capture_f( void );
+void		SV_Replay_f( void );
+
+
+//
+// sv_bench.c
+//
+void		SV_MicroBench_f( void );
+
+
+//
+// sv_auth.c
+//
+#ifdef USE_AUTH
+int			SV_AuthStringToAdr( const char *s, netadr_t *a );
+void		SV_AuthSendPacket( netsrc_t sock, int length, const void *data, const char *destination );
+qboolean	SV_AuthPacketFromServer( netadr_t from );
+void		SV_AuthInfo_f( void );
+#endif
+
+
 //
 // sv_skeetshoot.c
 //
@@ -440,7 +692,8 @@ void		SV_SkeetBackupPowerups(client_t *cl);
 void		SV_SkeetRestorePowerups(client_t *cl);
 void		SV_SkeetScore(client_t *cl, playerState_t *ps, trace_t *tr);
 void		SV_SkeetClientEvents(client_t *cl);
-qboolean	SV_SkeetShoot(client_t *cl, playerState_t *ps);
+void		SV_SkeetShoot(client_t *cl, playerState_t *ps);
+void		SV_SkeetShootFrame(void);
 #endif
 
 //
@@ -468,8 +721,16 @@ void		SV_DirectConnect( netadr_t from );
 void		SV_ExecuteClientMessage( client_t *cl, msg_t *msg );
 void		SV_UserinfoChanged( client_t *cl );
 
+void		SV_SendClientGameState( client_t *client );
+void		SV_WriteGamestate( msg_t *msg );
+void		SV_InvalidateGamestate( int index );
 void		SV_ClientEnterWorld( client_t *client, usercmd_t *cmd );
 void		SV_FreeClient(client_t *client);
+#ifdef USE_VOIP
+void		SV_ReleaseVoipPacket( voipServerPacket_t *packet );
+#endif
+void		SV_AllocClientStorage( client_t *client );
+void		SV_FreeClientStorage( client_t *client );
 void		SV_DropClient( client_t *drop, const char *reason );
 
 #ifdef USE_AUTH
@@ -481,13 +742,17 @@ void		SV_ClientThink (client_t *cl, usercmd_t *cmd);
 
 int			SV_SendQueuedMessages(void);
 void		SV_UpdateUserinfo_f( client_t *cl );
+void		SV_CheckClientUserinfoTimer( void );
 
 
 //
 // sv_ccmds.c
 //
 void		SV_Heartbeat_f( void );
-void		SVD_WriteDemoFile(const client_t*, const msg_t*);
+void		SV_ReapZygoteChildren( void );
+void		SVD_WriteDemoFile(const client_t*, msg_t*);
+qboolean	SVD_KeyframeDue(const client_t *client);
+void		SVD_WriteKeyframe(client_t *client);
 void		SV_StartRecordOne(client_t *client, char *filename);
 
 //
@@ -499,7 +764,9 @@ void		SV_WriteFrameToClient (client_t *client, msg_t *msg);
 void		SV_SendMessageToClient( msg_t *msg, client_t *client );
 void		SV_SendClientMessages( void );
 void		SV_SendClientSnapshot( client_t *client );
-void		SV_CheckClientUserinfoTimer( void );
+entityState_t	*SV_SnapshotEntity( client_t *client, unsigned index );
+int			SV_SnapshotMsec( client_t *client );
+void		SV_AdaptSnapshotRate( client_t *client, int snapshots );
 
 //
 // sv_game.c
@@ -523,6 +790,7 @@ void		SV_BotFreeClient( int clientNum );
 
 void		SV_BotInitCvars(void);
 int			SV_BotLibSetup( void );
+void		SV_BotRoutingInfo_f( void );
 int			SV_BotLibShutdown( void );
 int			SV_BotGetSnapshotEntity( int client, int ent );
 int			SV_BotGetConsoleMessage( int client, char *buf, int size );
@@ -586,6 +854,19 @@ void		SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs,
 void		SV_ClipToEntity( trace_t *trace, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int entityNum, int contentmask, int capsule );
 // clip to a specific entity
 
+void		SV_InvalidateTraceCache( void );
+void		SV_TraceCacheStats( void );
+// per frame memoization of SV_Trace, see sv_traceCache
+
+//
+// sv_antilag.c
+//
+void		SV_ClearEntityHistory( void );
+void		SV_RecordEntityHistory( void );
+qboolean	SV_EntityBoundsAtTime( int entityNum, int time, vec3_t absmin, vec3_t absmax );
+void		SV_TraceAtTime( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule, int time );
+// SV_Trace against the entities as they were at the given sv.time, see sv_antilag
+
 //
 // sv_net_chan.c
 //
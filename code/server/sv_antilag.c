@@ -0,0 +1,310 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_antilag.c -- entity position history for lag compensated traces
+
+#include "server.h"
+
+/*
+After every GAME_RUN_FRAME the bounding box of each entity that is not a
+brush model is recorded in a ring of ENTITY_HISTORY samples.
+SV_TraceAtTime moves the entities near the trace back to where they were
+at the given server time, traces, and puts them back, so the game does
+not have to keep the history itself.
+*/
+
+#define	ENTITY_HISTORY		32		// must be a power of two
+
+typedef struct {
+	int			time;
+	qboolean	linked;
+	vec3_t		origin;
+	vec3_t		mins, maxs;
+} entityPosition_t;
+
+typedef struct {
+	int					head;			// the most recent sample
+	int					count;
+	entityPosition_t	samples[ENTITY_HISTORY];
+} entityHistory_t;
+
+typedef struct {
+	sharedEntity_t		*gEnt;
+	entityPosition_t	current;
+	int					linkcount;
+} entityRewind_t;
+
+static entityHistory_t	svHistory[MAX_GENTITIES];
+static entityRewind_t	svRewind[MAX_GENTITIES];
+
+/*
+==================
+SV_ClearEntityHistory
+==================
+*/
+void SV_ClearEntityHistory( void ) {
+	int		i;
+
+	for ( i = 0 ; i < MAX_GENTITIES ; i++ ) {
+		svHistory[i].count = 0;
+	}
+}
+
+/*
+==================
+SV_GetEntityPosition
+==================
+*/
+static void SV_GetEntityPosition( const sharedEntity_t *gEnt, entityPosition_t *pos ) {
+	pos->linked = gEnt->r.linked;
+	VectorCopy( gEnt->r.currentOrigin, pos->origin );
+	VectorCopy( gEnt->r.mins, pos->mins );
+	VectorCopy( gEnt->r.maxs, pos->maxs );
+}
+
+/*
+==================
+SV_RecordEntityHistory
+
+Called right after GAME_RUN_FRAME
+==================
+*/
+void SV_RecordEntityHistory( void ) {
+	int				i;
+	sharedEntity_t	*gEnt;
+	entityHistory_t	*hist;
+	entityPosition_t *pos;
+
+	if ( !sv_antilag->integer ) {
+		return;
+	}
+
+	for ( i = 0, hist = svHistory ; i < sv.num_entities ; i++, hist++ ) {
+		gEnt = SV_GentityNum( i );
+		if ( gEnt->r.bmodel || ( !gEnt->r.linked && !hist->count ) ) {
+			hist->count = 0;
+			continue;
+		}
+
+		// a map_restart starts the clock over
+		if ( hist->count && hist->samples[hist->head].time >= sv.time ) {
+			hist->count = 0;
+		}
+
+		hist->head = ( hist->head + 1 ) & ( ENTITY_HISTORY - 1 );
+		if ( hist->count < ENTITY_HISTORY ) {
+			hist->count++;
+		}
+
+		pos = &hist->samples[hist->head];
+		pos->time = sv.time;
+		SV_GetEntityPosition( gEnt, pos );
+	}
+	for ( ; i < MAX_GENTITIES ; i++, hist++ ) {
+		hist->count = 0;
+	}
+}
+
+/*
+==================
+SV_EntityPositionAtTime
+
+Interpolates between the two samples around time, clamped to the oldest
+sample. Returns qfalse if the entity has no history.
+==================
+*/
+static qboolean SV_EntityPositionAtTime( const entityHistory_t *hist, int time, entityPosition_t *pos ) {
+	const entityPosition_t	*older, *newer;
+	float	frac;
+	int		i;
+
+	if ( !hist->count ) {
+		return qfalse;
+	}
+
+	newer = &hist->samples[hist->head];
+	if ( time >= newer->time ) {
+		*pos = *newer;
+		return qtrue;
+	}
+
+	for ( i = 1 ; i < hist->count ; i++ ) {
+		older = &hist->samples[( hist->head - i ) & ( ENTITY_HISTORY - 1 )];
+		if ( older->time <= time ) {
+			// only blend positions the entity had while linked in both
+			if ( !older->linked || !newer->linked ) {
+				*pos = ( time - older->time < newer->time - time ) ? *older : *newer;
+				return qtrue;
+			}
+			frac = (float)( time - older->time ) / ( newer->time - older->time );
+			pos->time = time;
+			pos->linked = qtrue;
+			pos->origin[0] = older->origin[0] + frac * ( newer->origin[0] - older->origin[0] );
+			pos->origin[1] = older->origin[1] + frac * ( newer->origin[1] - older->origin[1] );
+			pos->origin[2] = older->origin[2] + frac * ( newer->origin[2] - older->origin[2] );
+			VectorCopy( newer->mins, pos->mins );
+			VectorCopy( newer->maxs, pos->maxs );
+			return qtrue;
+		}
+		newer = older;
+	}
+
+	*pos = *newer;
+	return qtrue;
+}
+
+/*
+==================
+SV_EntityBoundsAtTime
+
+Absolute bounds of the entity as SV_TraceAtTime would see it, returns
+qfalse if it was not linked at that time
+==================
+*/
+qboolean SV_EntityBoundsAtTime( int entityNum, int time, vec3_t absmin, vec3_t absmax ) {
+	entityPosition_t	then;
+	sharedEntity_t		*gEnt;
+
+	gEnt = SV_GentityNum( entityNum );
+	if ( !sv_antilag->integer || time >= sv.time || gEnt->r.bmodel
+		|| !SV_EntityPositionAtTime( &svHistory[entityNum], time, &then ) ) {
+		VectorCopy( gEnt->r.absmin, absmin );
+		VectorCopy( gEnt->r.absmax, absmax );
+		return gEnt->r.linked;
+	}
+
+	VectorAdd( then.origin, then.mins, absmin );
+	VectorAdd( then.origin, then.maxs, absmax );
+	return then.linked;
+}
+
+/*
+==================
+SV_PositionInBounds
+==================
+*/
+static qboolean SV_PositionInBounds( const entityPosition_t *pos, const vec3_t mins, const vec3_t maxs ) {
+	int		i;
+
+	if ( !pos->linked ) {
+		return qfalse;
+	}
+	for ( i = 0 ; i < 3 ; i++ ) {
+		if ( pos->origin[i] + pos->mins[i] > maxs[i] || pos->origin[i] + pos->maxs[i] < mins[i] ) {
+			return qfalse;
+		}
+	}
+	return qtrue;
+}
+
+/*
+==================
+SV_SetEntityPosition
+==================
+*/
+static void SV_SetEntityPosition( sharedEntity_t *gEnt, const entityPosition_t *pos ) {
+	if ( gEnt->r.linked ) {
+		SV_UnlinkEntity( gEnt );
+	}
+	VectorCopy( pos->origin, gEnt->r.currentOrigin );
+	VectorCopy( pos->mins, gEnt->r.mins );
+	VectorCopy( pos->maxs, gEnt->r.maxs );
+	if ( pos->linked ) {
+		SV_LinkEntity( gEnt );
+	}
+}
+
+/*
+==================
+SV_TraceAtTime
+
+Like SV_Trace, against the entities as they were at the given server time.
+passEntityNum is never moved.
+==================
+*/
+void SV_TraceAtTime( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule, int time ) {
+	vec3_t			boxmins, boxmaxs;
+	entityPosition_t then;
+	entityRewind_t	*rewind;
+	sharedEntity_t	*gEnt;
+	int				numRewound;
+	int				i;
+
+	if ( !sv_antilag->integer || time >= sv.time ) {
+		SV_Trace( results, start, mins, maxs, end, passEntityNum, contentmask, capsule );
+		return;
+	}
+
+	// only the entities that are or were in the way need to be moved
+	for ( i = 0 ; i < 3 ; i++ ) {
+		if ( end[i] > start[i] ) {
+			boxmins[i] = start[i] - 1;
+			boxmaxs[i] = end[i] + 1;
+		} else {
+			boxmins[i] = end[i] - 1;
+			boxmaxs[i] = start[i] + 1;
+		}
+		if ( mins ) {
+			boxmins[i] += mins[i];
+		}
+		if ( maxs ) {
+			boxmaxs[i] += maxs[i];
+		}
+	}
+
+	numRewound = 0;
+	for ( i = 0 ; i < sv.num_entities ; i++ ) {
+		if ( i == passEntityNum ) {
+			continue;
+		}
+		if ( !SV_EntityPositionAtTime( &svHistory[i], time, &then ) ) {
+			continue;
+		}
+
+		gEnt = SV_GentityNum( i );
+		rewind = &svRewind[numRewound];
+		SV_GetEntityPosition( gEnt, &rewind->current );
+
+		if ( then.linked == rewind->current.linked
+			&& VectorCompare( then.origin, rewind->current.origin )
+			&& VectorCompare( then.mins, rewind->current.mins )
+			&& VectorCompare( then.maxs, rewind->current.maxs ) ) {
+			continue;
+		}
+		if ( !SV_PositionInBounds( &then, boxmins, boxmaxs )
+			&& !SV_PositionInBounds( &rewind->current, boxmins, boxmaxs ) ) {
+			continue;
+		}
+
+		rewind->gEnt = gEnt;
+		rewind->linkcount = gEnt->r.linkcount;
+		SV_SetEntityPosition( gEnt, &then );
+		numRewound++;
+	}
+
+	SV_Trace( results, start, mins, maxs, end, passEntityNum, contentmask, capsule );
+
+	for ( i = numRewound - 1 ; i >= 0 ; i-- ) {
+		rewind = &svRewind[i];
+		SV_SetEntityPosition( rewind->gEnt, &rewind->current );
+		rewind->gEnt->r.linkcount = rewind->linkcount;
+	}
+}
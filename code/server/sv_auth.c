@@ -0,0 +1,202 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_auth.c -- auth server addresses and statistics
+
+#include "server.h"
+
+#ifdef USE_AUTH
+
+/*
+The auth exchange itself runs in the game module, which sends through
+G_NET_SENDPACKET and gets the AUTH:SV replies passed back. Both used to
+resolve the auth server name for every packet, stalling the whole server
+for as long as the lookup took, and for the full resolver timeout while
+DNS was down. Names now go through NET_ResolveAsync, which looks them up
+again on its thread every AUTH_RESOLVE_MSEC and has the last address in
+the meantime. Until the first answer is in, the packets are dropped.
+*/
+
+#define	MAX_AUTH_ADDRESSES	4
+#define	AUTH_RESOLVE_MSEC	( 30 * 60 * 1000 )
+
+typedef struct {
+	char		name[MAX_OSPATH];
+	netadr_t	adr;
+	int			result;				// of NET_StringToAdr, -1 while not answered
+	int			resolveTime;		// Sys_Milliseconds of the answer
+	int			lastUsed;
+} authAddress_t;
+
+typedef struct {
+	authAddress_t	addresses[MAX_AUTH_ADDRESSES];
+
+	int			resolves;
+	int			lookups;
+
+	int			packetsSent;
+	int			repliesReceived;
+	int			pendingSince;		// first packet sent since the last reply
+	int			replyMsec;
+	int			maxReplyMsec;
+	int			repliesTimed;
+	int			lastReply;
+} svAuth_t;
+
+static svAuth_t	svAuth;
+
+/*
+==================
+SV_AuthResolve
+==================
+*/
+static int SV_AuthResolve( const char *name, netadr_t *adr ) {
+	authAddress_t	*entry, *oldest;
+	int				i, now, answerTime;
+
+	now = Sys_Milliseconds();
+	svAuth.lookups++;
+
+	oldest = NULL;
+	for ( i = 0, entry = svAuth.addresses ; i < MAX_AUTH_ADDRESSES ; i++, entry++ ) {
+		if ( entry->name[0] && !strcmp( entry->name, name ) ) {
+			break;
+		}
+		if ( !oldest || entry->lastUsed < oldest->lastUsed ) {
+			oldest = entry;
+		}
+	}
+
+	if ( i == MAX_AUTH_ADDRESSES ) {
+		entry = oldest;
+		Q_strncpyz( entry->name, name, sizeof( entry->name ) );
+		entry->resolveTime = 0;
+		entry->result = -1;
+	}
+	entry->lastUsed = now;
+
+	entry->result = NET_ResolveAsync( name, &entry->adr, NA_IP, AUTH_RESOLVE_MSEC, &answerTime );
+	if ( entry->result > 0 && answerTime != entry->resolveTime ) {
+		entry->resolveTime = answerTime;
+		svAuth.resolves++;
+	}
+
+	*adr = entry->adr;
+	return entry->result > 0 ? entry->result : 0;
+}
+
+/*
+==================
+SV_AuthStringToAdr
+
+G_NET_STRINGTOADR
+==================
+*/
+int SV_AuthStringToAdr( const char *s, netadr_t *a ) {
+	return SV_AuthResolve( s, a );
+}
+
+/*
+==================
+SV_AuthSendPacket
+
+G_NET_SENDPACKET
+==================
+*/
+void SV_AuthSendPacket( netsrc_t sock, int length, const void *data, const char *destination ) {
+	netadr_t	to;
+
+	if ( !SV_AuthResolve( destination, &to ) ) {
+		return;
+	}
+	NET_SendPacket( sock, length, data, to );
+
+	svAuth.packetsSent++;
+	if ( !svAuth.pendingSince ) {
+		svAuth.pendingSince = Sys_Milliseconds();
+	}
+}
+
+/*
+==================
+SV_AuthPacketFromServer
+
+Checks an AUTH:SV packet came from sv_authServerIP, and times the reply
+==================
+*/
+qboolean SV_AuthPacketFromServer( netadr_t from ) {
+	netadr_t	authServer;
+	int			msec;
+
+	if ( !SV_AuthResolve( sv_authServerIP->string, &authServer ) || !NET_CompareBaseAdr( from, authServer ) ) {
+		return qfalse;
+	}
+
+	svAuth.repliesReceived++;
+	svAuth.lastReply = Sys_Milliseconds();
+	if ( svAuth.pendingSince ) {
+		msec = svAuth.lastReply - svAuth.pendingSince;
+		svAuth.replyMsec += msec;
+		svAuth.repliesTimed++;
+		if ( msec > svAuth.maxReplyMsec ) {
+			svAuth.maxReplyMsec = msec;
+		}
+		svAuth.pendingSince = 0;
+	}
+	return qtrue;
+}
+
+/*
+==================
+SV_AuthInfo_f
+==================
+*/
+void SV_AuthInfo_f( void ) {
+	authAddress_t	*entry;
+	int				i, now;
+
+	now = Sys_Milliseconds();
+
+	for ( i = 0, entry = svAuth.addresses ; i < MAX_AUTH_ADDRESSES ; i++, entry++ ) {
+		if ( !entry->name[0] ) {
+			continue;
+		}
+		if ( entry->result > 0 ) {
+			Com_Printf( "%s: %s, resolved %i s ago\n", entry->name,
+				NET_AdrToStringwPort( entry->adr ), ( now - entry->resolveTime ) / 1000 );
+		} else {
+			Com_Printf( "%s: %s\n", entry->name, entry->result ? "resolving" : "unresolved" );
+		}
+	}
+
+	Com_Printf( "%i lookups, %i resolves\n", svAuth.lookups, svAuth.resolves );
+	Com_Printf( "%i packets sent, %i replies, %i msec average reply, %i msec max\n",
+		svAuth.packetsSent, svAuth.repliesReceived,
+		svAuth.repliesTimed ? svAuth.replyMsec / svAuth.repliesTimed : 0, svAuth.maxReplyMsec );
+	if ( svAuth.lastReply ) {
+		Com_Printf( "last reply %i s ago\n", ( now - svAuth.lastReply ) / 1000 );
+	}
+	if ( svAuth.pendingSince ) {
+		Com_Printf( "waiting %i msec for a reply\n", now - svAuth.pendingSince );
+	}
+}
+
+#endif
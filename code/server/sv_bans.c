@@ -0,0 +1,693 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_bans.c -- ban lookups through a prefix trie, and loading sv_banFile from a thread
+
+#include "server.h"
+
+/*
+serverBans[] is still the list the ban commands edit and sv_banFile
+holds. SV_IsBanned looks addresses up in a binary radix trie built from
+it, so a connect takes one step per prefix on the way down instead of a
+compare against every entry. Bans and exceptions share the trie, each
+node flags which of them end at its prefix.
+
+rehashbans reads and parses the file on a thread into a new list and
+trie, and SV_BansFrame swaps them in once they are ready. The thread
+only takes numeric addresses, lines that need a lookup are parsed with
+NET_StringToAdr on the main thread afterwards. The list and trie are
+malloc'd because of that, the zone can't be used off the main thread.
+*/
+
+#define	BANTRIE_BAN			1
+#define	BANTRIE_EXCEPTION	2
+
+#define	BANTRIE_IP			0			// root node of each address type
+#define	BANTRIE_IP6			1
+
+typedef struct {
+	byte		addr[16];				// bits past the prefix are zero
+	int			bits;
+	int			child[2];
+	int			flags;
+} banNode_t;
+
+typedef struct {
+	banNode_t	*nodes;
+	int			numNodes;
+	int			maxNodes;
+	int			loopback;				// flags of NA_LOOPBACK entries
+} banTrie_t;
+
+typedef struct {
+	FILE		*file;
+	char		*text;
+	int			*unparsed;				// offsets of lines left to the main thread
+	int			numUnparsed;
+
+	serverBan_t	*bans;
+	int			numBans;
+	banTrie_t	trie;
+
+	qboolean	active;
+	sysThread_t	*thread;				// NULL if the loader ran right away
+	sysMutex_t	*lock;
+	qboolean	done;
+} banLoader_t;
+
+static banTrie_t	serverBanTrie;
+static int			serverBansSize;
+static banLoader_t	banLoader;
+
+/*
+==================
+SV_BanBit
+==================
+*/
+static int SV_BanBit( const byte *addr, int bit ) {
+	return ( addr[bit >> 3] >> ( 7 - ( bit & 7 ) ) ) & 1;
+}
+
+/*
+==================
+SV_BanCommonBits
+
+Length of the common prefix of a and b, up to max bits
+==================
+*/
+static int SV_BanCommonBits( const byte *a, const byte *b, int max ) {
+	int		bits;
+
+	for ( bits = 0 ; bits + 8 <= max && a[bits >> 3] == b[bits >> 3] ; bits += 8 ) {
+	}
+	while ( bits < max && SV_BanBit( a, bits ) == SV_BanBit( b, bits ) ) {
+		bits++;
+	}
+	return bits;
+}
+
+/*
+==================
+SV_BanTrieFree
+==================
+*/
+static void SV_BanTrieFree( banTrie_t *trie ) {
+	free( trie->nodes );
+	Com_Memset( trie, 0, sizeof( *trie ) );
+}
+
+/*
+==================
+SV_BanTrieNode
+==================
+*/
+static int SV_BanTrieNode( banTrie_t *trie, const byte *addr, int bits, int flags ) {
+	banNode_t	*node;
+	int			i;
+
+	node = &trie->nodes[trie->numNodes];
+	Com_Memset( node->addr, 0, sizeof( node->addr ) );
+	for ( i = 0 ; i < bits ; i++ ) {
+		if ( SV_BanBit( addr, i ) ) {
+			node->addr[i >> 3] |= 0x80 >> ( i & 7 );
+		}
+	}
+	node->bits = bits;
+	node->child[0] = node->child[1] = -1;
+	node->flags = flags;
+
+	return trie->numNodes++;
+}
+
+/*
+==================
+SV_BanTrieInit
+
+Room for count entries, every one of them adds two nodes at most
+==================
+*/
+static qboolean SV_BanTrieInit( banTrie_t *trie, int count ) {
+	byte	none[16];
+
+	Com_Memset( trie, 0, sizeof( *trie ) );
+	trie->maxNodes = 2 + 2 * count;
+	trie->nodes = malloc( trie->maxNodes * sizeof( *trie->nodes ) );
+	if ( !trie->nodes ) {
+		return qfalse;
+	}
+
+	Com_Memset( none, 0, sizeof( none ) );
+	SV_BanTrieNode( trie, none, 0, 0 );		// BANTRIE_IP
+	SV_BanTrieNode( trie, none, 0, 0 );		// BANTRIE_IP6
+	return qtrue;
+}
+
+/*
+==================
+SV_BanTrieInsert
+==================
+*/
+static void SV_BanTrieInsert( banTrie_t *trie, const serverBan_t *ban ) {
+	const byte	*addr;
+	banNode_t	*node, *child;
+	int			n, c, bit, bits, common, flag, split;
+
+	flag = ban->isexception ? BANTRIE_EXCEPTION : BANTRIE_BAN;
+
+	if ( ban->ip.type == NA_LOOPBACK ) {
+		trie->loopback |= flag;
+		return;
+	}
+	if ( ban->ip.type == NA_IP ) {
+		n = BANTRIE_IP;
+		addr = ban->ip.ip;
+		bits = ban->subnet;
+	} else if ( ban->ip.type == NA_IP6 ) {
+		n = BANTRIE_IP6;
+		addr = ban->ip.ip6;
+		bits = ban->subnet;
+	} else {
+		return;
+	}
+	if ( trie->numNodes + 2 > trie->maxNodes ) {
+		return;
+	}
+
+	while ( 1 ) {
+		// addr matches the prefix of node n, which is no longer than bits
+		node = &trie->nodes[n];
+		if ( node->bits == bits ) {
+			node->flags |= flag;
+			return;
+		}
+
+		bit = SV_BanBit( addr, node->bits );
+		c = node->child[bit];
+		if ( c == -1 ) {
+			c = SV_BanTrieNode( trie, addr, bits, flag );
+			trie->nodes[n].child[bit] = c;
+			return;
+		}
+
+		child = &trie->nodes[c];
+		common = SV_BanCommonBits( addr, child->addr, MIN( bits, child->bits ) );
+		if ( common == child->bits ) {
+			n = c;
+			continue;
+		}
+
+		// the new prefix ends or branches off above the child
+		if ( common == bits ) {
+			split = SV_BanTrieNode( trie, addr, bits, flag );
+		} else {
+			split = SV_BanTrieNode( trie, addr, common, 0 );
+			trie->nodes[split].child[SV_BanBit( addr, common )] = SV_BanTrieNode( trie, addr, bits, flag );
+		}
+		trie->nodes[split].child[SV_BanBit( trie->nodes[c].addr, common )] = c;
+		trie->nodes[n].child[bit] = split;
+		return;
+	}
+}
+
+/*
+==================
+SV_BanTrieMatch
+
+Returns the flags of every prefix from the trie that from is in
+==================
+*/
+static int SV_BanTrieMatch( const banTrie_t *trie, const netadr_t *from ) {
+	const banNode_t	*node;
+	const byte		*addr;
+	int				n, maxBits, flags;
+
+	if ( !trie->nodes ) {
+		return 0;
+	}
+
+	if ( from->type == NA_LOOPBACK ) {
+		return trie->loopback;
+	}
+	if ( from->type == NA_IP ) {
+		n = BANTRIE_IP;
+		addr = from->ip;
+		maxBits = 32;
+	} else if ( from->type == NA_IP6 ) {
+		n = BANTRIE_IP6;
+		addr = from->ip6;
+		maxBits = 128;
+	} else {
+		return 0;
+	}
+
+	flags = 0;
+	while ( 1 ) {
+		node = &trie->nodes[n];
+		flags |= node->flags;
+
+		if ( node->bits >= maxBits ) {
+			break;
+		}
+		n = node->child[SV_BanBit( addr, node->bits )];
+		if ( n == -1 || SV_BanCommonBits( addr, trie->nodes[n].addr, trie->nodes[n].bits ) < trie->nodes[n].bits ) {
+			break;
+		}
+	}
+
+	return flags;
+}
+
+/*
+==================
+SV_IsBanned
+
+Check whether a certain address is banned
+==================
+*/
+qboolean SV_IsBanned( const netadr_t *from ) {
+	int		flags;
+
+	flags = SV_BanTrieMatch( &serverBanTrie, from );
+
+	// an exception overrides any ban
+	return ( flags & ( BANTRIE_BAN | BANTRIE_EXCEPTION ) ) == BANTRIE_BAN;
+}
+
+/*
+==================
+SV_RebuildBanTrie
+
+Called after every change to serverBans
+==================
+*/
+void SV_RebuildBanTrie( void ) {
+	int		i;
+
+	SV_BanTrieFree( &serverBanTrie );
+	if ( !SV_BanTrieInit( &serverBanTrie, serverBansCount ) ) {
+		Com_Printf( "WARNING: out of memory for the ban trie, no bans are checked\n" );
+		return;
+	}
+
+	for ( i = 0 ; i < serverBansCount ; i++ ) {
+		SV_BanTrieInsert( &serverBanTrie, &serverBans[i] );
+	}
+}
+
+/*
+==================
+SV_ReserveBans
+
+Makes room for count entries in serverBans
+==================
+*/
+qboolean SV_ReserveBans( int count ) {
+	serverBan_t	*bans;
+	int			size;
+
+	if ( count <= serverBansSize ) {
+		return qtrue;
+	}
+	if ( count > SERVER_MAXBANS ) {
+		return qfalse;
+	}
+
+	size = serverBansSize ? serverBansSize : 256;
+	while ( size < count ) {
+		size *= 2;
+	}
+	if ( size > SERVER_MAXBANS ) {
+		size = SERVER_MAXBANS;
+	}
+
+	bans = realloc( serverBans, size * sizeof( *serverBans ) );
+	if ( !bans ) {
+		return qfalse;
+	}
+	serverBans = bans;
+	serverBansSize = size;
+	return qtrue;
+}
+
+/*
+==================
+SV_ParseBanAddress
+
+Numeric addresses only, so it can run off the main thread
+==================
+*/
+static qboolean SV_ParseBanAddress( const char *s, netadr_t *adr ) {
+	int		groups[8], numGroups, gap, value, digits, i, c;
+	const char	*p;
+
+	Com_Memset( adr, 0, sizeof( *adr ) );
+
+	if ( !strcmp( s, "localhost" ) ) {
+		adr->type = NA_LOOPBACK;
+		return qtrue;
+	}
+
+	if ( !strchr( s, ':' ) ) {
+		for ( i = 0, p = s ; i < 4 ; i++ ) {
+			value = digits = 0;
+			for ( ; *p >= '0' && *p <= '9' ; p++, digits++ ) {
+				value = value * 10 + *p - '0';
+			}
+			if ( !digits || digits > 3 || value > 255 || *p != ( i < 3 ? '.' : '\0' ) ) {
+				return qfalse;
+			}
+			adr->ip[i] = value;
+			p++;
+		}
+		adr->type = NA_IP;
+		return qtrue;
+	}
+
+	numGroups = 0;
+	gap = -1;
+	p = s;
+	if ( p[0] == ':' && p[1] == ':' ) {
+		gap = 0;
+		p += 2;
+	}
+	while ( *p ) {
+		value = digits = 0;
+		while ( 1 ) {
+			c = *p;
+			if ( c >= '0' && c <= '9' ) {
+				c -= '0';
+			} else if ( c >= 'a' && c <= 'f' ) {
+				c -= 'a' - 10;
+			} else if ( c >= 'A' && c <= 'F' ) {
+				c -= 'A' - 10;
+			} else {
+				break;
+			}
+			value = value * 16 + c;
+			digits++;
+			p++;
+		}
+		if ( !digits || digits > 4 || numGroups == 8 ) {
+			return qfalse;
+		}
+		groups[numGroups++] = value;
+
+		if ( !*p ) {
+			break;
+		}
+		if ( *p != ':' ) {
+			return qfalse;		// scope ids, embedded IPv4 and the like
+		}
+		p++;
+		if ( *p == ':' ) {
+			if ( gap != -1 ) {
+				return qfalse;
+			}
+			gap = numGroups;
+			p++;
+		} else if ( !*p ) {
+			return qfalse;
+		}
+	}
+
+	if ( gap == -1 ? numGroups != 8 : numGroups > 7 ) {
+		return qfalse;
+	}
+
+	for ( i = 0 ; i < numGroups ; i++ ) {
+		c = ( gap != -1 && i >= gap ) ? i + 8 - numGroups : i;
+		adr->ip6[c * 2] = groups[i] >> 8;
+		adr->ip6[c * 2 + 1] = groups[i] & 0xff;
+	}
+	adr->type = NA_IP6;
+	return qtrue;
+}
+
+/*
+==================
+SV_ParseBanLine
+
+"<isexception> <address> <subnet>", as SV_WriteBans writes them.
+Returns qfalse if the address wasn't taken.
+==================
+*/
+static qboolean SV_ParseBanLine( const char *line, serverBan_t *ban, qboolean resolve ) {
+	char		address[NET_ADDRSTRMAXLEN];
+	const char	*p;
+	int			i;
+
+	p = line + 2;
+	for ( i = 0 ; *p && *p != ' ' && i < sizeof( address ) - 1 ; i++ ) {
+		address[i] = *p++;
+	}
+	address[i] = 0;
+
+	if ( resolve ) {
+		if ( !NET_StringToAdr( address, &ban->ip, NA_UNSPEC ) ) {
+			return qfalse;
+		}
+	} else if ( !SV_ParseBanAddress( address, &ban->ip ) ) {
+		return qfalse;
+	}
+
+	ban->isexception = ( line[0] != '0' );
+	ban->subnet = atoi( p );
+
+	if ( ban->ip.type == NA_IP && ( ban->subnet < 1 || ban->subnet > 32 ) ) {
+		ban->subnet = 32;
+	} else if ( ban->ip.type == NA_IP6 && ( ban->subnet < 1 || ban->subnet > 128 ) ) {
+		ban->subnet = 128;
+	}
+	return qtrue;
+}
+
+/*
+==================
+SV_BanLoaderThread
+==================
+*/
+static void SV_BanLoaderThread( void *arg ) {
+	banLoader_t	*loader = arg;
+	char		*text, *curpos, *maskpos, *newlinepos, *endpos;
+	long		length;
+	int			lines;
+
+	if ( fseek( loader->file, 0, SEEK_END ) || ( length = ftell( loader->file ) ) < 0
+		|| length > 0x7fffffff || fseek( loader->file, 0, SEEK_SET ) ) {
+		length = 0;
+	}
+
+	text = loader->text = malloc( length + 1 );
+	if ( text ) {
+		length = fread( text, 1, length, loader->file );
+		endpos = text + length;
+
+		for ( lines = 0, curpos = text ; curpos < endpos ; curpos++ ) {
+			if ( *curpos == '\n' ) {
+				lines++;
+			}
+		}
+		if ( lines > SERVER_MAXBANS ) {
+			lines = SERVER_MAXBANS;
+		}
+
+		loader->bans = malloc( lines * sizeof( *loader->bans ) + 1 );
+		loader->unparsed = malloc( lines * sizeof( *loader->unparsed ) + 1 );
+
+		if ( loader->bans && loader->unparsed && SV_BanTrieInit( &loader->trie, lines ) ) {
+			// the same line format rehashbans always read
+			curpos = text;
+			while ( loader->numBans + loader->numUnparsed < lines && curpos + 2 < endpos ) {
+				for ( maskpos = curpos + 2 ; maskpos < endpos && *maskpos != ' ' ; maskpos++ ) {
+				}
+				if ( maskpos + 1 >= endpos ) {
+					break;
+				}
+				for ( newlinepos = maskpos ; newlinepos < endpos && *newlinepos != '\n' ; newlinepos++ ) {
+				}
+				if ( newlinepos >= endpos ) {
+					break;
+				}
+				*newlinepos = '\0';
+
+				if ( SV_ParseBanLine( curpos, &loader->bans[loader->numBans], qfalse ) ) {
+					SV_BanTrieInsert( &loader->trie, &loader->bans[loader->numBans] );
+					loader->numBans++;
+				} else {
+					loader->unparsed[loader->numUnparsed++] = curpos - text;
+				}
+
+				curpos = newlinepos + 1;
+			}
+		}
+	}
+
+	fclose( loader->file );
+	loader->file = NULL;
+
+	if ( loader->lock ) {
+		Sys_LockMutex( loader->lock );
+	}
+	loader->done = qtrue;
+	if ( loader->lock ) {
+		Sys_UnlockMutex( loader->lock );
+	}
+}
+
+/*
+==================
+SV_FreeBanLoader
+==================
+*/
+static void SV_FreeBanLoader( void ) {
+	if ( banLoader.lock ) {
+		Sys_DestroyMutex( banLoader.lock );
+	}
+	free( banLoader.text );
+	free( banLoader.unparsed );
+	free( banLoader.bans );
+	SV_BanTrieFree( &banLoader.trie );
+
+	Com_Memset( &banLoader, 0, sizeof( banLoader ) );
+}
+
+/*
+==================
+SV_FinishLoadingBans
+
+Swaps the loaded list in. Waits for the loader if block is set,
+otherwise returns qfalse while it is still running.
+==================
+*/
+qboolean SV_FinishLoadingBans( qboolean block ) {
+	serverBan_t	ban;
+	qboolean	done;
+	int			i;
+
+	if ( !banLoader.active ) {
+		return qtrue;
+	}
+
+	if ( banLoader.thread ) {
+		if ( !block ) {
+			Sys_LockMutex( banLoader.lock );
+			done = banLoader.done;
+			Sys_UnlockMutex( banLoader.lock );
+			if ( !done ) {
+				return qfalse;
+			}
+		}
+
+		Sys_JoinThread( banLoader.thread );
+		banLoader.thread = NULL;
+	}
+
+	if ( !banLoader.trie.nodes ) {
+		Com_Printf( "WARNING: couldn't load the bans from %s\n", sv_banFile->string );
+		SV_FreeBanLoader();
+		return qtrue;
+	}
+
+	free( serverBans );
+	serverBans = banLoader.bans;
+	serverBansCount = banLoader.numBans;
+	serverBansSize = banLoader.numBans + banLoader.numUnparsed;
+	banLoader.bans = NULL;
+
+	SV_BanTrieFree( &serverBanTrie );
+	serverBanTrie = banLoader.trie;
+	banLoader.trie.nodes = NULL;
+
+	// the rest may need a lookup, the trie has room for them
+	for ( i = 0 ; i < banLoader.numUnparsed ; i++ ) {
+		if ( SV_ParseBanLine( banLoader.text + banLoader.unparsed[i], &ban, qtrue ) ) {
+			serverBans[serverBansCount++] = ban;
+			SV_BanTrieInsert( &serverBanTrie, &ban );
+		}
+	}
+
+	SV_FreeBanLoader();
+
+	Com_DPrintf( "Loaded %i bans and exceptions\n", serverBansCount );
+	return qtrue;
+}
+
+/*
+==================
+SV_LoadBans
+
+Starts reading sv_banFile on a thread, or reads it right away if there
+are no threads.
+==================
+*/
+void SV_LoadBans( void ) {
+	char	filepath[MAX_QPATH];
+	FILE	*file;
+
+	SV_FinishLoadingBans( qtrue );
+
+	if ( !sv_banFile->string[0] ) {
+		serverBansCount = 0;
+		SV_RebuildBanTrie();
+		return;
+	}
+
+	Com_sprintf( filepath, sizeof( filepath ), "%s/%s", FS_GetCurrentGameDir(), sv_banFile->string );
+
+	file = FS_SV_FOpenRawFileRead( filepath );
+	if ( !file ) {
+		serverBansCount = 0;
+		SV_RebuildBanTrie();
+		return;
+	}
+
+	banLoader.active = qtrue;
+	banLoader.file = file;
+	banLoader.lock = Sys_CreateMutex();
+	if ( banLoader.lock ) {
+		banLoader.thread = Sys_CreateThread( SV_BanLoaderThread, &banLoader );
+	}
+
+	if ( !banLoader.thread ) {
+		SV_BanLoaderThread( &banLoader );
+		SV_FinishLoadingBans( qtrue );
+	}
+}
+
+/*
+==================
+SV_BansFrame
+==================
+*/
+void SV_BansFrame( void ) {
+	SV_FinishLoadingBans( qfalse );
+}
+
+/*
+==================
+SV_ShutdownBans
+
+The bans themselves stay until the next rehashbans
+==================
+*/
+void SV_ShutdownBans( void ) {
+	SV_FinishLoadingBans( qtrue );
+}
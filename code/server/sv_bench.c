@@ -0,0 +1,1141 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_bench.c -- microbenchmarks of the message, huffman and collision code, see microbench
+
+#include "server.h"
+
+/*
+microbench times the primitives every snapshot and every trace goes
+through, each on its own: the entity and playerstate delta coding of
+msg.c, Huff_Compress and Huff_Decompress, and CM_BoxTrace and
+CM_PointContents on every map of sv_benchMaps.
+
+The deltas are the ones of a real game, read from the world demo in
+sv_benchDemo: every entity against its state in the frame before, or its
+baseline when it came in, and every playerstate against the one before.
+The configstrings of the demo are what gets huffman coded. Without a demo
+made up ones are used. On the map the demo was recorded on, the traces
+start from where its players were, elsewhere from random empty spots.
+
+Each benchmark runs passes over its data for sv_benchMsec and keeps the
+fastest, giving ns/op and what one op took on the wire. The results are
+written to sv_benchResults, and when sv_benchBaseline names an earlier
+results file, anything that got sv_benchTolerance percent slower or any
+bigger is a regression. "microbench quit" is for scripts such as "make
+microbench": it quits once done, with an error if anything regressed.
+*/
+
+#define	BENCH_MAX_ENTITY_DELTAS		8192
+#define	BENCH_MAX_PLAYER_DELTAS		1024
+#define	BENCH_MAX_TEXTS				64
+#define	BENCH_TEXT_SIZE				1024		// about a connect packet
+#define	BENCH_MAX_TRACES			4096
+#define	BENCH_MAX_RESULTS			64
+#define	BENCH_STREAM_SIZE			( 2 * 1024 * 1024 )
+#define	BENCH_DELTA_MAX				4096		// more than any one delta can take
+#define	BENCH_MIN_PASSES			3
+
+#define	BENCH_SYNTH_ENTITIES		96
+#define	BENCH_SYNTH_PLAYERS			12
+#define	BENCH_SYNTH_FRAMES			80
+
+typedef struct {
+	entityState_t	from, to;
+	qboolean		force;			// it came in against its baseline
+} svBenchEntityDelta_t;
+
+typedef struct {
+	playerState_t	from, to;
+} svBenchPlayerDelta_t;
+
+typedef struct {
+	char			bench[32];
+	char			subject[MAX_QPATH];
+	float			nsPerOp;
+	float			bytesPerOp;
+	int				ops;
+} svBenchResult_t;
+
+// what the world demo reader keeps between frames
+typedef struct {
+	entityState_t	baselines[MAX_GENTITIES];
+	entityState_t	entities[MAX_GENTITIES];
+	qboolean		present[MAX_GENTITIES];
+	playerState_t	ps[MAX_CLIENTS];
+	qboolean		active[MAX_CLIENTS];
+	usercmd_t		lastCmd[MAX_CLIENTS];
+} svBenchDemoState_t;
+
+static struct {
+	char					source[MAX_QPATH];		// the demo, or "synthetic"
+	char					mapname[MAX_QPATH];		// it was recorded on
+
+	svBenchEntityDelta_t	*entities;
+	int						numEntities;
+	svBenchPlayerDelta_t	*players;
+	int						numPlayers;
+
+	byte					*texts;					// BENCH_MAX_TEXTS of BENCH_TEXT_SIZE
+	int						textLengths[BENCH_MAX_TEXTS];
+	byte					*compressed;			// the same, huffman coded
+	int						compressedLengths[BENCH_MAX_TEXTS];
+	int						numTexts;
+
+	byte					*stream;				// written to by the write benchmarks
+	byte					*encoded;				// read by the read benchmarks
+	int						encodedSize;
+	int						*encodedEntities;		// the deltas in it, unchanged ones write nothing
+	int						numEncoded;
+
+	vec3_t					traceStarts[BENCH_MAX_TRACES];
+	vec3_t					traceEnds[BENCH_MAX_TRACES];
+	vec3_t					shotEnds[BENCH_MAX_TRACES];
+	vec3_t					points[BENCH_MAX_TRACES];
+	int						numTraces;
+
+	svBenchResult_t			results[BENCH_MAX_RESULTS];
+	int						numResults;
+	int						failures;				// wrong results, not slow ones
+} svBench;
+
+static vec3_t	benchPlayerMins = { -15, -15, -24 };
+static vec3_t	benchPlayerMaxs = { 15, 15, 32 };
+
+/*
+==================
+SV_BenchAddText
+
+Configstrings are packed into packet sized texts
+==================
+*/
+static void SV_BenchAddText( const char *s ) {
+	int		len, *cur;
+
+	len = strlen( s ) + 1;
+	if ( len > BENCH_TEXT_SIZE ) {
+		len = BENCH_TEXT_SIZE;
+	}
+
+	if ( !svBench.numTexts || svBench.textLengths[svBench.numTexts - 1] + len > BENCH_TEXT_SIZE ) {
+		if ( svBench.numTexts == BENCH_MAX_TEXTS ) {
+			return;
+		}
+		svBench.textLengths[svBench.numTexts++] = 0;
+	}
+
+	cur = &svBench.textLengths[svBench.numTexts - 1];
+	Com_Memcpy( svBench.texts + ( svBench.numTexts - 1 ) * BENCH_TEXT_SIZE + *cur, s, len - 1 );
+	svBench.texts[( svBench.numTexts - 1 ) * BENCH_TEXT_SIZE + *cur + len - 1] = '\n';
+	*cur += len;
+}
+
+/*
+==================
+SV_BenchReadGamestate
+==================
+*/
+static void SV_BenchReadGamestate( msg_t *msg, svBenchDemoState_t *ds ) {
+	entityState_t	nullstate;
+	char			*s;
+	int				i;
+
+	MSG_ReadLong( msg );
+
+	while ( msg->readcount <= msg->cursize ) {
+		i = MSG_ReadShort( msg );
+		if ( i < 0 || i >= MAX_CONFIGSTRINGS ) {
+			break;
+		}
+		s = MSG_ReadBigString( msg );
+		if ( i == CS_SERVERINFO ) {
+			Q_strncpyz( svBench.mapname, Info_ValueForKey( s, "mapname" ), sizeof( svBench.mapname ) );
+		}
+		SV_BenchAddText( s );
+	}
+
+	Com_Memset( &nullstate, 0, sizeof( nullstate ) );
+	while ( msg->readcount <= msg->cursize ) {
+		i = MSG_ReadBits( msg, GENTITYNUM_BITS );
+		if ( i < 0 || i >= MAX_GENTITIES - 1 ) {
+			break;
+		}
+		MSG_ReadDeltaEntity( msg, &nullstate, &ds->baselines[i], i );
+	}
+}
+
+/*
+==================
+SV_BenchReadEntities
+
+Keeps every delta of the frame, like SV_EmitPacketEntities would write it
+==================
+*/
+static void SV_BenchReadEntities( msg_t *msg, svBenchDemoState_t *ds ) {
+	svBenchEntityDelta_t	*d;
+	entityState_t			*from, to;
+	qboolean				changed[MAX_GENTITIES];
+	int						num;
+
+	Com_Memset( changed, 0, sizeof( changed ) );
+
+	while ( msg->readcount <= msg->cursize ) {
+		num = MSG_ReadBits( msg, GENTITYNUM_BITS );
+		if ( num < 0 || num >= MAX_GENTITIES - 1 ) {
+			break;
+		}
+
+		from = ds->present[num] ? &ds->entities[num] : &ds->baselines[num];
+		MSG_ReadDeltaEntity( msg, from, &to, num );
+		changed[num] = qtrue;
+		if ( to.number == MAX_GENTITIES - 1 ) {
+			ds->present[num] = qfalse;
+			continue;
+		}
+
+		if ( svBench.numEntities < BENCH_MAX_ENTITY_DELTAS ) {
+			d = &svBench.entities[svBench.numEntities++];
+			d->from = *from;
+			d->to = to;
+			d->force = !ds->present[num];
+		}
+
+		ds->entities[num] = to;
+		ds->present[num] = qtrue;
+	}
+
+	// the ones that didn't change are compared all the same
+	for ( num = 0 ; num < MAX_GENTITIES - 1 && svBench.numEntities < BENCH_MAX_ENTITY_DELTAS ; num++ ) {
+		if ( ds->present[num] && !changed[num] ) {
+			d = &svBench.entities[svBench.numEntities++];
+			d->from = d->to = ds->entities[num];
+			d->force = qfalse;
+		}
+	}
+
+	// svFlags and singleClient changes
+	while ( msg->readcount <= msg->cursize ) {
+		num = MSG_ReadBits( msg, GENTITYNUM_BITS );
+		if ( num < 0 || num >= MAX_GENTITIES - 1 ) {
+			break;
+		}
+		MSG_ReadLong( msg );
+		MSG_ReadLong( msg );
+	}
+}
+
+/*
+==================
+SV_BenchReadClients
+==================
+*/
+static void SV_BenchReadClients( msg_t *msg, svBenchDemoState_t *ds ) {
+	qboolean			seen[MAX_CLIENTS];
+	svBenchPlayerDelta_t	*d;
+	playerState_t		to;
+	usercmd_t			cmd;
+	int					i, j, numCmds;
+
+	Com_Memset( seen, 0, sizeof( seen ) );
+
+	while ( msg->readcount <= msg->cursize ) {
+		i = MSG_ReadByte( msg );
+		if ( i < 0 || i >= MAX_CLIENTS ) {
+			break;		// 255 ends the list
+		}
+
+		MSG_ReadDeltaPlayerstate( msg, ds->active[i] ? &ds->ps[i] : NULL, &to );
+		if ( ds->active[i] && svBench.numPlayers < BENCH_MAX_PLAYER_DELTAS ) {
+			d = &svBench.players[svBench.numPlayers++];
+			d->from = ds->ps[i];
+			d->to = to;
+		}
+		ds->ps[i] = to;
+
+		if ( !ds->active[i] ) {
+			Com_Memset( &ds->lastCmd[i], 0, sizeof( ds->lastCmd[i] ) );
+		}
+		ds->active[i] = seen[i] = qtrue;
+
+		numCmds = MSG_ReadByte( msg );
+		for ( j = 0 ; j < numCmds ; j++ ) {
+			MSG_ReadDeltaUsercmdKey( msg, 0, &ds->lastCmd[i], &cmd );
+			ds->lastCmd[i] = cmd;
+		}
+	}
+
+	Com_Memcpy( ds->active, seen, sizeof( ds->active ) );
+}
+
+/*
+==================
+SV_BenchReadDemo
+
+Takes the deltas of a world demo until there are enough of them
+==================
+*/
+static qboolean SV_BenchReadDemo( const char *name ) {
+	svBenchDemoState_t	*ds;
+	union {
+		byte	*b;
+		void	*v;
+	} buffer;
+	char		path[MAX_QPATH];
+	msg_t		msg;
+	int			length, offset, size, type;
+
+	Q_strncpyz( path, name, sizeof( path ) );
+	length = FS_ReadFile( path, &buffer.v );
+	if ( length <= 0 ) {
+		Com_sprintf( path, sizeof( path ), "%s/%s", sv_demofolder->string, name );
+		length = FS_ReadFile( path, &buffer.v );
+	}
+	if ( length <= 0 ) {
+		Com_sprintf( path, sizeof( path ), "%s/%s.wdm_%d", sv_demofolder->string, name, PROTOCOL_VERSION );
+		length = FS_ReadFile( path, &buffer.v );
+	}
+	if ( length <= 0 ) {
+		Com_Printf( "microbench: couldn't find the world demo %s\n", name );
+		return qfalse;
+	}
+
+	// "WDMO", version, protocol, modversion, maxclients, checksumFeed
+	if ( length < 16 || memcmp( buffer.b, "WDMO", 4 ) || LittleLong( ( (int *)buffer.b )[1] ) != WORLDDEMO_VERSION ) {
+		Com_Printf( "microbench: %s isn't a version %i world demo\n", path, WORLDDEMO_VERSION );
+		FS_FreeFile( buffer.v );
+		return qfalse;
+	}
+	offset = 16 + LittleLong( ( (int *)buffer.b )[3] ) + 8;
+
+	ds = Z_Malloc( sizeof( *ds ) );
+
+	while ( offset + 4 <= length ) {
+		size = LittleLong( *(int *)( buffer.b + offset ) );
+		offset += 4;
+		if ( size < 0 || size > length - offset ) {
+			break;		// the end marker, or cut off
+		}
+
+		MSG_Init( &msg, buffer.b + offset, size );
+		msg.cursize = size;
+		MSG_Bitstream( &msg );
+		offset += size;
+
+		type = MSG_ReadByte( &msg );
+		if ( type == wd_gamestate ) {
+			SV_BenchReadGamestate( &msg, ds );
+		} else if ( type == wd_frame ) {
+			MSG_ReadLong( &msg );
+			SV_BenchReadEntities( &msg, ds );
+			SV_BenchReadClients( &msg, ds );
+		}
+
+		if ( svBench.numEntities == BENCH_MAX_ENTITY_DELTAS && svBench.numPlayers == BENCH_MAX_PLAYER_DELTAS ) {
+			break;
+		}
+	}
+
+	Z_Free( ds );
+	FS_FreeFile( buffer.v );
+
+	if ( !svBench.numEntities || !svBench.numPlayers ) {
+		Com_Printf( "microbench: %s has no frames with players in them\n", path );
+		return qfalse;
+	}
+
+	Q_strncpyz( svBench.source, COM_SkipPath( path ), sizeof( svBench.source ) );
+	return qtrue;
+}
+
+/*
+==================
+SV_BenchSynthesize
+
+Made up deltas for when there is no demo: players running about and
+shooting, and projectiles and movers around them
+==================
+*/
+static void SV_BenchSynthesize( void ) {
+	static const char *weapons[] = { "ut_weapon_ak103", "ut_weapon_m4", "ut_weapon_spas12", "ut_weapon_de" };
+	entityState_t	ents[BENCH_SYNTH_ENTITIES], to;
+	playerState_t	ps[BENCH_SYNTH_PLAYERS], pto;
+	int				seed = 0x5eed, frame, i, j;
+
+	Com_Memset( ents, 0, sizeof( ents ) );
+	for ( i = 0 ; i < BENCH_SYNTH_ENTITIES ; i++ ) {
+		ents[i].number = i;
+		if ( i < BENCH_SYNTH_PLAYERS ) {
+			ents[i].eType = ET_PLAYER;
+			ents[i].pos.trType = TR_INTERPOLATE;
+			ents[i].clientNum = i;
+			ents[i].modelindex2 = 1 + ( i & 3 );
+		} else if ( i < BENCH_SYNTH_ENTITIES / 2 ) {
+			ents[i].eType = ET_MISSILE;
+			ents[i].pos.trType = TR_GRAVITY;
+			ents[i].weapon = 1 + ( i & 7 );
+		} else {
+			ents[i].eType = ET_MOVER;
+			ents[i].pos.trType = TR_STATIONARY;
+			ents[i].modelindex = i;
+		}
+		for ( j = 0 ; j < 3 ; j++ ) {
+			ents[i].pos.trBase[j] = (int)( Q_crandom( &seed ) * 2048 );
+		}
+	}
+
+	Com_Memset( ps, 0, sizeof( ps ) );
+	for ( i = 0 ; i < BENCH_SYNTH_PLAYERS ; i++ ) {
+		ps[i].clientNum = i;
+		ps[i].pm_type = PM_NORMAL;
+		ps[i].stats[STAT_HEALTH] = 100;
+		ps[i].weapon = 1 + ( i & 7 );
+		ps[i].ammo[ps[i].weapon] = 30;
+		VectorCopy( ents[i].pos.trBase, ps[i].origin );
+	}
+
+	for ( frame = 0 ; frame < BENCH_SYNTH_FRAMES ; frame++ ) {
+		for ( i = 0 ; i < BENCH_SYNTH_ENTITIES && svBench.numEntities < BENCH_MAX_ENTITY_DELTAS ; i++ ) {
+			to = ents[i];
+			if ( to.eType == ET_PLAYER ) {
+				to.pos.trTime = frame * 50;
+				for ( j = 0 ; j < 3 ; j++ ) {
+					to.pos.trBase[j] += Q_crandom( &seed ) * 16;
+					to.pos.trDelta[j] = Q_crandom( &seed ) * 320;
+				}
+				to.apos.trBase[YAW] = AngleNormalize360( to.apos.trBase[YAW] + Q_crandom( &seed ) * 20 );
+				to.apos.trBase[PITCH] = Q_crandom( &seed ) * 60;
+				to.legsAnim = Q_rand( &seed ) & 63;
+				to.torsoAnim = Q_rand( &seed ) & 63;
+				if ( !( Q_rand( &seed ) & 7 ) ) {
+					to.event = ( to.event + 1 ) & 255;
+					to.eventParm = Q_rand( &seed ) & 255;
+				}
+			} else if ( to.eType == ET_MISSILE ) {
+				if ( !( Q_rand( &seed ) & 15 ) ) {
+					to.pos.trTime = frame * 50;
+					for ( j = 0 ; j < 3 ; j++ ) {
+						to.pos.trDelta[j] = Q_crandom( &seed ) * 800;
+					}
+				}
+			} else if ( !( Q_rand( &seed ) & 31 ) ) {
+				to.pos.trType = to.pos.trType == TR_STATIONARY ? TR_LINEAR_STOP : TR_STATIONARY;
+				to.pos.trTime = frame * 50;
+			}
+
+			svBench.entities[svBench.numEntities].from = ents[i];
+			svBench.entities[svBench.numEntities].to = to;
+			svBench.entities[svBench.numEntities].force = !frame;
+			svBench.numEntities++;
+			ents[i] = to;
+		}
+
+		for ( i = 0 ; i < BENCH_SYNTH_PLAYERS && svBench.numPlayers < BENCH_MAX_PLAYER_DELTAS ; i++ ) {
+			pto = ps[i];
+			pto.commandTime = frame * 50;
+			for ( j = 0 ; j < 3 ; j++ ) {
+				pto.velocity[j] = Q_crandom( &seed ) * 320;
+				pto.origin[j] += pto.velocity[j] * 0.05f;
+			}
+			pto.viewangles[YAW] = AngleNormalize360( pto.viewangles[YAW] + Q_crandom( &seed ) * 20 );
+			pto.viewangles[PITCH] = Q_crandom( &seed ) * 60;
+			pto.bobCycle = ( pto.bobCycle + 9 ) & 255;
+			pto.weaponTime = Q_rand( &seed ) & 127;
+			if ( !( Q_rand( &seed ) & 3 ) && pto.ammo[pto.weapon] > 0 ) {
+				pto.ammo[pto.weapon]--;
+			}
+			if ( !( Q_rand( &seed ) & 15 ) ) {
+				pto.stats[STAT_HEALTH] -= Q_rand( &seed ) % 20;
+				pto.damageEvent++;
+			}
+
+			svBench.players[svBench.numPlayers].from = ps[i];
+			svBench.players[svBench.numPlayers].to = pto;
+			svBench.numPlayers++;
+			ps[i] = pto;
+		}
+	}
+
+	// what connecting clients and a gamestate send
+	for ( i = 0 ; i < BENCH_MAX_TEXTS / 2 ; i++ ) {
+		SV_BenchAddText( va( "connect \"\\name\\player%i\\rate\\25000\\snaps\\20\\cl_guid\\%08X%08X%08X%08X"
+			"\\racered\\%i\\raceblue\\%i\\funred\\ninja,caphat\\cg_rgb\\128 128 128\\gear\\GZAAVWT"
+			"\\weapmodes\\0000011022000002000200000000\\authc\\0\\cl_anonymous\\0\\ut_timenudge\\0"
+			"\\protocol\\%i\\qport\\%i\"", i, Q_rand( &seed ), Q_rand( &seed ), Q_rand( &seed ),
+			Q_rand( &seed ), i & 3, ( i >> 2 ) & 3, PROTOCOL_VERSION, Q_rand( &seed ) & 0xffff ) );
+		SV_BenchAddText( va( "\\model\\%s\\hmodel\\%s\\t\\%i\\n\\player%i", weapons[i & 3], weapons[( i + 1 ) & 3], i & 1, i ) );
+	}
+
+	Q_strncpyz( svBench.source, "synthetic", sizeof( svBench.source ) );
+	svBench.mapname[0] = 0;
+}
+
+/*
+==================
+SV_BenchAddResult
+==================
+*/
+static void SV_BenchAddResult( const char *name, const char *subject, float nsPerOp, float bytesPerOp, int ops ) {
+	svBenchResult_t	*r;
+
+	Com_Printf( "%-22s %-22s %10.1f %9.2f %8i\n", name, subject, nsPerOp, bytesPerOp, ops );
+
+	if ( svBench.numResults == BENCH_MAX_RESULTS ) {
+		return;
+	}
+	r = &svBench.results[svBench.numResults++];
+	Q_strncpyz( r->bench, name, sizeof( r->bench ) );
+	Q_strncpyz( r->subject, subject, sizeof( r->subject ) );
+	r->nsPerOp = nsPerOp;
+	r->bytesPerOp = bytesPerOp;
+	r->ops = ops;
+}
+
+/*
+==================
+SV_BenchRun
+
+Runs passes of a benchmark for sv_benchMsec and keeps the fastest one. A
+pass returns the ops it did and adds the bytes they took.
+==================
+*/
+static void SV_BenchRun( const char *name, const char *subject, int (*pass)( int *bytes ) ) {
+	int64_t		begin, start, usec, best;
+	int			passes, ops, bytes;
+
+	best = -1;
+	ops = bytes = 0;
+	begin = Sys_Microseconds();
+	for ( passes = 0 ; passes < BENCH_MIN_PASSES || Sys_Microseconds() - begin < sv_benchMsec->integer * 1000 ; passes++ ) {
+		bytes = 0;
+		start = Sys_Microseconds();
+		ops = pass( &bytes );
+		usec = Sys_Microseconds() - start;
+		if ( !ops ) {
+			return;
+		}
+		if ( best < 0 || usec < best ) {
+			best = usec;
+		}
+	}
+
+	SV_BenchAddResult( name, subject, best * 1000.0f / ops, (float)bytes / ops, ops );
+}
+
+/*
+==================
+SV_BenchWriteEntities
+==================
+*/
+static int SV_BenchWriteEntities( int *bytes ) {
+	svBenchEntityDelta_t	*d;
+	msg_t					msg;
+	int						i;
+
+	MSG_Init( &msg, svBench.stream, BENCH_STREAM_SIZE );
+	MSG_Bitstream( &msg );
+
+	for ( i = 0, d = svBench.entities ; i < svBench.numEntities ; i++, d++ ) {
+		if ( msg.cursize > BENCH_STREAM_SIZE - BENCH_DELTA_MAX ) {
+			*bytes += msg.cursize;
+			MSG_Clear( &msg );
+		}
+		MSG_WriteDeltaEntity( &msg, &d->from, &d->to, d->force );
+	}
+	*bytes += msg.cursize;
+
+	return svBench.numEntities;
+}
+
+/*
+==================
+SV_BenchEncodeEntities
+
+The stream the read benchmark reads, only what changed is in it
+==================
+*/
+static void SV_BenchEncodeEntities( void ) {
+	svBenchEntityDelta_t	*d;
+	msg_t					msg;
+	int						i, bit;
+
+	MSG_Init( &msg, svBench.encoded, BENCH_STREAM_SIZE );
+	MSG_Bitstream( &msg );
+
+	svBench.numEncoded = 0;
+	for ( i = 0, d = svBench.entities ; i < svBench.numEntities ; i++, d++ ) {
+		if ( msg.cursize > BENCH_STREAM_SIZE - BENCH_DELTA_MAX ) {
+			break;
+		}
+		bit = msg.bit;
+		MSG_WriteDeltaEntity( &msg, &d->from, &d->to, d->force );
+		if ( msg.bit != bit ) {
+			svBench.encodedEntities[svBench.numEncoded++] = i;
+		}
+	}
+	svBench.encodedSize = msg.cursize;
+}
+
+/*
+==================
+SV_BenchReadEntityStream
+==================
+*/
+static int SV_BenchReadEntityStream( int *bytes ) {
+	entityState_t	to;
+	msg_t			msg;
+	int				i, num;
+
+	MSG_Init( &msg, svBench.encoded, BENCH_STREAM_SIZE );
+	msg.cursize = svBench.encodedSize;
+	MSG_Bitstream( &msg );
+
+	for ( i = 0 ; i < svBench.numEncoded ; i++ ) {
+		num = MSG_ReadBits( &msg, GENTITYNUM_BITS );
+		MSG_ReadDeltaEntity( &msg, &svBench.entities[svBench.encodedEntities[i]].from, &to, num );
+	}
+	*bytes += svBench.encodedSize;
+
+	return svBench.numEncoded;
+}
+
+/*
+==================
+SV_BenchWritePlayers
+==================
+*/
+static int SV_BenchWritePlayers( int *bytes ) {
+	svBenchPlayerDelta_t	*d;
+	msg_t					msg;
+	int						i;
+
+	MSG_Init( &msg, svBench.stream, BENCH_STREAM_SIZE );
+	MSG_Bitstream( &msg );
+
+	for ( i = 0, d = svBench.players ; i < svBench.numPlayers ; i++, d++ ) {
+		if ( msg.cursize > BENCH_STREAM_SIZE - BENCH_DELTA_MAX ) {
+			*bytes += msg.cursize;
+			MSG_Clear( &msg );
+		}
+		MSG_WriteDeltaPlayerstate( &msg, &d->from, &d->to );
+	}
+	*bytes += msg.cursize;
+
+	return svBench.numPlayers;
+}
+
+/*
+==================
+SV_BenchEncodePlayers
+==================
+*/
+static void SV_BenchEncodePlayers( void ) {
+	svBenchPlayerDelta_t	*d;
+	msg_t					msg;
+	int						i;
+
+	MSG_Init( &msg, svBench.encoded, BENCH_STREAM_SIZE );
+	MSG_Bitstream( &msg );
+
+	svBench.numEncoded = 0;
+	for ( i = 0, d = svBench.players ; i < svBench.numPlayers ; i++, d++ ) {
+		if ( msg.cursize > BENCH_STREAM_SIZE - BENCH_DELTA_MAX ) {
+			break;
+		}
+		MSG_WriteDeltaPlayerstate( &msg, &d->from, &d->to );
+		svBench.numEncoded++;
+	}
+	svBench.encodedSize = msg.cursize;
+}
+
+/*
+==================
+SV_BenchReadPlayerStream
+==================
+*/
+static int SV_BenchReadPlayerStream( int *bytes ) {
+	playerState_t	to;
+	msg_t			msg;
+	int				i;
+
+	MSG_Init( &msg, svBench.encoded, BENCH_STREAM_SIZE );
+	msg.cursize = svBench.encodedSize;
+	MSG_Bitstream( &msg );
+
+	for ( i = 0 ; i < svBench.numEncoded ; i++ ) {
+		MSG_ReadDeltaPlayerstate( &msg, &svBench.players[i].from, &to );
+	}
+	*bytes += svBench.encodedSize;
+
+	return svBench.numEncoded;
+}
+
+/*
+==================
+SV_BenchCompress
+
+bytes/op of both huffman benchmarks is the compressed size
+==================
+*/
+static int SV_BenchCompress( int *bytes ) {
+	msg_t	msg;
+	int		i;
+
+	for ( i = 0 ; i < svBench.numTexts ; i++ ) {
+		MSG_Init( &msg, svBench.stream, MAX_MSGLEN );
+		Com_Memcpy( svBench.stream, svBench.texts + i * BENCH_TEXT_SIZE, svBench.textLengths[i] );
+		msg.cursize = svBench.textLengths[i];
+		Huff_Compress( &msg, 0 );
+		*bytes += msg.cursize;
+	}
+
+	return svBench.numTexts;
+}
+
+/*
+==================
+SV_BenchDecompress
+==================
+*/
+static int SV_BenchDecompress( int *bytes ) {
+	msg_t	msg;
+	int		i;
+
+	for ( i = 0 ; i < svBench.numTexts ; i++ ) {
+		MSG_Init( &msg, svBench.stream, MAX_MSGLEN );
+		Com_Memcpy( svBench.stream, svBench.compressed + i * 2 * BENCH_TEXT_SIZE, svBench.compressedLengths[i] );
+		msg.cursize = svBench.compressedLengths[i];
+		Huff_Decompress( &msg, 0 );
+		*bytes += svBench.compressedLengths[i];
+	}
+
+	return svBench.numTexts;
+}
+
+/*
+==================
+SV_BenchPrepareHuffman
+
+Compresses every text once and checks that it comes back the same
+==================
+*/
+static qboolean SV_BenchPrepareHuffman( void ) {
+	msg_t	msg;
+	int		i;
+
+	for ( i = 0 ; i < svBench.numTexts ; i++ ) {
+		MSG_Init( &msg, svBench.stream, MAX_MSGLEN );
+		Com_Memcpy( svBench.stream, svBench.texts + i * BENCH_TEXT_SIZE, svBench.textLengths[i] );
+		msg.cursize = svBench.textLengths[i];
+		Huff_Compress( &msg, 0 );
+		if ( msg.cursize > 2 * BENCH_TEXT_SIZE ) {
+			return qfalse;
+		}
+		Com_Memcpy( svBench.compressed + i * 2 * BENCH_TEXT_SIZE, svBench.stream, msg.cursize );
+		svBench.compressedLengths[i] = msg.cursize;
+
+		Huff_Decompress( &msg, 0 );
+		if ( msg.cursize != svBench.textLengths[i] ||
+			memcmp( svBench.stream, svBench.texts + i * BENCH_TEXT_SIZE, msg.cursize ) ) {
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+SV_BenchBoxTraces
+
+Players moving
+==================
+*/
+static int SV_BenchBoxTraces( int *bytes ) {
+	trace_t	tr;
+	int		i;
+
+	for ( i = 0 ; i < svBench.numTraces ; i++ ) {
+		CM_BoxTrace( &tr, svBench.traceStarts[i], svBench.traceEnds[i], benchPlayerMins, benchPlayerMaxs,
+			0, MASK_PLAYERSOLID, qfalse );
+	}
+
+	return svBench.numTraces;
+}
+
+/*
+==================
+SV_BenchPointTraces
+
+Players shooting
+==================
+*/
+static int SV_BenchPointTraces( int *bytes ) {
+	trace_t	tr;
+	int		i;
+
+	for ( i = 0 ; i < svBench.numTraces ; i++ ) {
+		CM_BoxTrace( &tr, svBench.traceStarts[i], svBench.shotEnds[i], vec3_origin, vec3_origin,
+			0, MASK_SHOT, qfalse );
+	}
+
+	return svBench.numTraces;
+}
+
+/*
+==================
+SV_BenchPointContents
+==================
+*/
+static int SV_BenchPointContents( int *bytes ) {
+	int		i;
+
+	for ( i = 0 ; i < svBench.numTraces ; i++ ) {
+		CM_PointContents( svBench.points[i], 0 );
+	}
+
+	return svBench.numTraces;
+}
+
+/*
+==================
+SV_BenchPlaceTraces
+
+From where the players of the demo were when it was recorded on the map,
+from random spots out of the solid otherwise
+==================
+*/
+static void SV_BenchPlaceTraces( const char *map ) {
+	vec3_t		mins, maxs, dir, p;
+	qboolean	recorded;
+	int			seed = 0x7ace, i, j, tries;
+
+	CM_ModelBounds( 0, mins, maxs );
+	recorded = !Q_stricmp( map, svBench.mapname );
+
+	svBench.numTraces = 0;
+	for ( tries = 0 ; svBench.numTraces < BENCH_MAX_TRACES && tries < BENCH_MAX_TRACES * 16 ; tries++ ) {
+		if ( recorded ) {
+			VectorCopy( svBench.players[tries % svBench.numPlayers].to.origin, p );
+		} else {
+			for ( j = 0 ; j < 3 ; j++ ) {
+				p[j] = mins[j] + Q_random( &seed ) * ( maxs[j] - mins[j] );
+			}
+			if ( CM_PointContents( p, 0 ) & MASK_PLAYERSOLID ) {
+				continue;
+			}
+		}
+
+		i = svBench.numTraces++;
+		VectorCopy( p, svBench.traceStarts[i] );
+		dir[0] = Q_crandom( &seed );
+		dir[1] = Q_crandom( &seed );
+		dir[2] = Q_crandom( &seed ) * 0.25f;
+		VectorNormalize( dir );
+		VectorMA( p, 16 + Q_random( &seed ) * 240, dir, svBench.traceEnds[i] );
+		VectorMA( p, 8192, dir, svBench.shotEnds[i] );
+
+		// about as many in the solid as out of it
+		for ( j = 0 ; j < 3 ; j++ ) {
+			svBench.points[i][j] = recorded ? p[j] + Q_crandom( &seed ) * 128 :
+				mins[j] + Q_random( &seed ) * ( maxs[j] - mins[j] );
+		}
+	}
+}
+
+/*
+==================
+SV_BenchMap
+==================
+*/
+static void SV_BenchMap( const char *map ) {
+	SV_BenchPlaceTraces( map );
+	if ( !svBench.numTraces ) {
+		Com_Printf( "microbench: no room for traces on %s\n", map );
+		return;
+	}
+
+	SV_BenchRun( "cm_trace_box", map, SV_BenchBoxTraces );
+	SV_BenchRun( "cm_trace_point", map, SV_BenchPointTraces );
+	SV_BenchRun( "cm_point_contents", map, SV_BenchPointContents );
+}
+
+/*
+==================
+SV_BenchMaps
+
+An idle dedicated server loads each of sv_benchMaps for it, a running one
+can only trace on the map it has.
+==================
+*/
+static void SV_BenchMaps( void ) {
+	char	*text, *token;
+	char	path[MAX_QPATH];
+	int		checksum;
+
+	if ( com_sv_running->integer ) {
+		if ( sv_benchMaps->string[0] ) {
+			Com_Printf( "microbench: the server is running, only %s is traced on\n", sv_mapname->string );
+		}
+		SV_BenchMap( sv_mapname->string );
+		return;
+	}
+
+	if ( !sv_benchMaps->string[0] ) {
+		return;
+	}
+
+	if ( !com_dedicated->integer ) {
+		Com_Printf( "microbench: only a dedicated server can load sv_benchMaps\n" );
+		return;
+	}
+
+	text = sv_benchMaps->string;
+	while ( 1 ) {
+		token = COM_Parse( &text );
+		if ( !token[0] ) {
+			break;
+		}
+
+		Com_sprintf( path, sizeof( path ), "maps/%s.bsp", token );
+		if ( FS_ReadFile( path, NULL ) <= 0 ) {
+			Com_Printf( "microbench: couldn't find %s\n", path );
+			continue;
+		}
+
+		Hunk_Clear();
+		CM_ClearMap();
+		CM_LoadMap( path, qfalse, &checksum );
+		SV_BenchMap( COM_SkipPath( token ) );
+	}
+
+	Hunk_Clear();
+	CM_ClearMap();
+}
+
+/*
+==================
+SV_BenchParseResult
+
+One line of a results file, qfalse at the end of it
+==================
+*/
+static qboolean SV_BenchParseResult( char **text, svBenchResult_t *r ) {
+	char	*token;
+
+	while ( 1 ) {
+		token = COM_ParseExt( text, qtrue );
+		if ( !token[0] ) {
+			return qfalse;
+		}
+		if ( token[0] != '#' ) {
+			break;
+		}
+		SkipRestOfLine( text );
+	}
+
+	Com_Memset( r, 0, sizeof( *r ) );
+	Q_strncpyz( r->bench, token, sizeof( r->bench ) );
+	Q_strncpyz( r->subject, COM_ParseExt( text, qfalse ), sizeof( r->subject ) );
+	r->nsPerOp = atof( COM_ParseExt( text, qfalse ) );
+	r->bytesPerOp = atof( COM_ParseExt( text, qfalse ) );
+	r->ops = atoi( COM_ParseExt( text, qfalse ) );
+	SkipRestOfLine( text );
+
+	return qtrue;
+}
+
+/*
+==================
+SV_BenchCompareBaseline
+
+Returns the number of benchmarks that regressed against sv_benchBaseline
+==================
+*/
+static int SV_BenchCompareBaseline( fileHandle_t f ) {
+	svBenchResult_t	base, *r;
+	union {
+		char	*c;
+		void	*v;
+	} buffer;
+	char			*text, *line;
+	float			change;
+	int				i, regressions;
+	qboolean		found, regressed;
+
+	if ( !sv_benchBaseline->string[0] ) {
+		return 0;
+	}
+
+	if ( FS_ReadFile( sv_benchBaseline->string, &buffer.v ) <= 0 ) {
+		Com_Printf( "microbench: couldn't read baseline %s\n", sv_benchBaseline->string );
+		return 0;
+	}
+
+	Com_Printf( "Against baseline %s (%s%% tolerance):\n", sv_benchBaseline->string, sv_benchTolerance->string );
+	if ( f ) {
+		FS_Printf( f, "# against baseline %s (%s%% tolerance): baseline_ns current_ns change baseline_bytes current_bytes\n",
+			sv_benchBaseline->string, sv_benchTolerance->string );
+	}
+
+	regressions = 0;
+	for ( i = 0, r = svBench.results ; i < svBench.numResults ; i++, r++ ) {
+		found = qfalse;
+		text = buffer.c;
+		while ( SV_BenchParseResult( &text, &base ) ) {
+			if ( !Q_stricmp( base.bench, r->bench ) && !Q_stricmp( base.subject, r->subject ) ) {
+				found = qtrue;
+				break;
+			}
+		}
+
+		if ( !found || base.nsPerOp <= 0.0f ) {
+			line = va( "  %-22s %-22s not in the baseline\n", r->bench, r->subject );
+		} else {
+			// the same data encodes to the same size, any growth is real
+			change = 100.0f * ( r->nsPerOp - base.nsPerOp ) / base.nsPerOp;
+			regressed = change > sv_benchTolerance->value || r->bytesPerOp > base.bytesPerOp + 0.005f;
+			if ( regressed ) {
+				regressions++;
+			}
+			line = va( "%s  %-22s %-22s %10.1f %10.1f %+7.1f%% %9.2f %9.2f%s\n", regressed ? S_COLOR_RED : "",
+				r->bench, r->subject, base.nsPerOp, r->nsPerOp, change, base.bytesPerOp, r->bytesPerOp,
+				regressed ? "  REGRESSION" : "" );
+		}
+
+		Com_Printf( "%s", line );
+		if ( f ) {
+			FS_Printf( f, "#%s", line[0] == Q_COLOR_ESCAPE ? line + 2 : line );
+		}
+	}
+
+	FS_FreeFile( buffer.v );
+
+	return regressions;
+}
+
+/*
+==================
+SV_BenchFinish
+
+Writes the results and compares them, returns the number of regressions
+==================
+*/
+static int SV_BenchFinish( void ) {
+	fileHandle_t	f;
+	qtime_t			now;
+	svBenchResult_t	*r;
+	int				i, regressions;
+
+	f = FS_FOpenFileWrite( sv_benchResults->string );
+	if ( !f ) {
+		Com_Printf( "Couldn't open %s for writing\n", sv_benchResults->string );
+	} else {
+		Com_RealTime( &now );
+		FS_Printf( f, "# microbench %04d-%02d-%02d %02d:%02d:%02d, deltas from %s\n",
+			1900 + now.tm_year, 1 + now.tm_mon, now.tm_mday, now.tm_hour, now.tm_min, now.tm_sec,
+			svBench.source );
+		FS_Printf( f, "# bench subject ns_per_op bytes_per_op ops\n" );
+		for ( i = 0, r = svBench.results ; i < svBench.numResults ; i++, r++ ) {
+			FS_Printf( f, "%s %s %.1f %.2f %i\n", r->bench, r->subject, r->nsPerOp, r->bytesPerOp, r->ops );
+		}
+	}
+
+	regressions = SV_BenchCompareBaseline( f ) + svBench.failures;
+
+	if ( f ) {
+		FS_FCloseFile( f );
+		Com_Printf( "%s written\n", sv_benchResults->string );
+	}
+
+	if ( sv_benchBaseline->string[0] ) {
+		Com_Printf( "%d of %d benchmarks regressed\n", regressions - svBench.failures, svBench.numResults );
+	}
+
+	return regressions;
+}
+
+/*
+==================
+SV_MicroBench_f
+==================
+*/
+void SV_MicroBench_f( void ) {
+	qboolean	quit;
+	int			regressions;
+
+	quit = !Q_stricmp( Cmd_Argv( 1 ), "quit" );
+	if ( Cmd_Argc() > 2 || ( Cmd_Argc() == 2 && !quit ) ) {
+		Com_Printf( "usage: microbench [quit]\n" );
+		return;
+	}
+
+	Com_Memset( &svBench, 0, sizeof( svBench ) );
+	svBench.entities = Z_Malloc( BENCH_MAX_ENTITY_DELTAS * sizeof( *svBench.entities ) );
+	svBench.players = Z_Malloc( BENCH_MAX_PLAYER_DELTAS * sizeof( *svBench.players ) );
+	svBench.texts = Z_Malloc( BENCH_MAX_TEXTS * BENCH_TEXT_SIZE );
+	svBench.compressed = Z_Malloc( BENCH_MAX_TEXTS * 2 * BENCH_TEXT_SIZE );
+	svBench.stream = Z_Malloc( BENCH_STREAM_SIZE );
+	svBench.encoded = Z_Malloc( BENCH_STREAM_SIZE );
+	svBench.encodedEntities = Z_Malloc( BENCH_MAX_ENTITY_DELTAS * sizeof( *svBench.encodedEntities ) );
+
+	if ( !sv_benchDemo->string[0] || !SV_BenchReadDemo( sv_benchDemo->string ) ) {
+		svBench.numEntities = svBench.numPlayers = svBench.numTexts = 0;
+		SV_BenchSynthesize();
+	}
+
+	Com_Printf( "microbench: %i entity and %i playerstate deltas from %s, %s ms a benchmark\n",
+		svBench.numEntities, svBench.numPlayers, svBench.source, sv_benchMsec->string );
+	Com_Printf( "%-22s %-22s %10s %9s %8s\n", "bench", "subject", "ns/op", "bytes/op", "ops" );
+
+	SV_BenchRun( "msg_write_entity", svBench.source, SV_BenchWriteEntities );
+	SV_BenchEncodeEntities();
+	SV_BenchRun( "msg_read_entity", svBench.source, SV_BenchReadEntityStream );
+	SV_BenchRun( "msg_write_playerstate", svBench.source, SV_BenchWritePlayers );
+	SV_BenchEncodePlayers();
+	SV_BenchRun( "msg_read_playerstate", svBench.source, SV_BenchReadPlayerStream );
+
+	if ( SV_BenchPrepareHuffman() ) {
+		SV_BenchRun( "huff_compress", svBench.source, SV_BenchCompress );
+		SV_BenchRun( "huff_decompress", svBench.source, SV_BenchDecompress );
+	} else {
+		Com_Printf( S_COLOR_RED "microbench: huffman coding didn't give back what it was given\n" );
+		svBench.failures++;
+	}
+
+	SV_BenchMaps();
+
+	regressions = SV_BenchFinish();
+
+	Z_Free( svBench.entities );
+	Z_Free( svBench.players );
+	Z_Free( svBench.texts );
+	Z_Free( svBench.compressed );
+	Z_Free( svBench.stream );
+	Z_Free( svBench.encoded );
+	Z_Free( svBench.encodedEntities );
+
+	if ( quit ) {
+		if ( regressions ) {
+			Com_Error( ERR_FATAL, "microbench: %i regressions", regressions );
+		}
+		Cbuf_AddText( "quit\n" );
+	}
+}
@@ -38,6 +38,8 @@ int bot_maxdebugpolys;
 extern botlib_export_t	*botlib_export;
 int	bot_enable;
 
+static cvar_t	*bot_parallelRoutes;
+
 
 /*
 ==================
@@ -60,6 +62,7 @@ int SV_BotAllocateClient(void) {
 		return -1;
 	}
 
+	SV_AllocClientStorage( cl );
 	cl->gentity = SV_GentityNum( i );
 	cl->gentity->s.number = i;
 	cl->state = CS_ACTIVE;
@@ -306,10 +309,16 @@ BotImport_HunkAlloc
 =================
 */
 static void *BotImport_HunkAlloc( int size ) {
+	memClass_t	oldClass;
+	void		*ptr;
+
 	if( Hunk_CheckMark() ) {
 		Com_Error( ERR_DROP, "SV_Bot_HunkAlloc: Alloc with marks already set" );
 	}
-	return Hunk_Alloc( size, h_high );
+	oldClass = Com_SetMemClass( MEMCLASS_BOTLIB );
+	ptr = Hunk_Alloc( size, h_high );
+	Com_SetMemClass( oldClass );
+	return ptr;
 }
 
 /*
@@ -418,6 +427,42 @@ static void BotImport_DebugLineShow(int line, vec3_t start, vec3_t end, int colo
 	BotImport_DebugPolygonShow(line, color, 4, points);
 }
 
+/*
+==================
+BotImport_CreateMutex
+==================
+*/
+static void *BotImport_CreateMutex( void ) {
+	return Sys_CreateMutex();
+}
+
+/*
+==================
+BotImport_DestroyMutex
+==================
+*/
+static void BotImport_DestroyMutex( void *mutex ) {
+	Sys_DestroyMutex( (sysMutex_t *)mutex );
+}
+
+/*
+==================
+BotImport_LockMutex
+==================
+*/
+static void BotImport_LockMutex( void *mutex ) {
+	Sys_LockMutex( (sysMutex_t *)mutex );
+}
+
+/*
+==================
+BotImport_UnlockMutex
+==================
+*/
+static void BotImport_UnlockMutex( void *mutex ) {
+	Sys_UnlockMutex( (sysMutex_t *)mutex );
+}
+
 /*
 ==================
 SV_BotClientCommand
@@ -436,9 +481,36 @@ void SV_BotFrame( int time ) {
 	if (!bot_enable) return;
 	//NOTE: maybe the game is already shutdown
 	if (!gvm) return;
+	// the routes the bots are about to ask for are built on the worker
+	// threads, the game then finds them in the routing cache
+	if ( bot_parallelRoutes->integer && botlib_export ) {
+		botlib_export->BotLibPrefetchRoutes();
+	}
 	VM_Call( gvm, BOTAI_START_FRAME, time );
 }
 
+/*
+==================
+SV_BotRoutingInfo_f
+
+Prints the bot routing cache statistics
+==================
+*/
+void SV_BotRoutingInfo_f( void ) {
+	if ( !botlib_export || !bot_enable ) {
+		Com_Printf( "Bots are not enabled.\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		botlib_export->BotLibRoutingInfo( qtrue );
+		Com_Printf( "Routing cache statistics reset.\n" );
+		return;
+	}
+
+	botlib_export->BotLibRoutingInfo( qfalse );
+}
+
 /*
 ===============
 SV_BotLibSetup
@@ -455,6 +527,9 @@ int SV_BotLibSetup( void ) {
 	}
 
 	botlib_export->BotLibVarSet( "basegame", com_basegame->string );
+	botlib_export->BotLibVarSet( "max_routingcache", Cvar_VariableString( "bot_maxRoutingCache" ) );
+	botlib_export->BotLibVarSet( "routingtable", Cvar_VariableString( "bot_routingTable" ) );
+	botlib_export->BotLibVarSet( "routingtable_maxareas", Cvar_VariableString( "bot_routingTableMaxAreas" ) );
 
 	return botlib_export->BotLibSetup();
 }
@@ -513,6 +588,10 @@ void SV_BotInitCvars(void) {
 	Cvar_Get("bot_interbreedbots", "10", CVAR_CHEAT);	//number of bots used for interbreeding
 	Cvar_Get("bot_interbreedcycle", "20", CVAR_CHEAT);	//bot interbreeding cycle
 	Cvar_Get("bot_interbreedwrite", "", CVAR_CHEAT);	//write interbreeded bots to this file
+	bot_parallelRoutes = Cvar_Get("bot_parallelRoutes", "0", 0);	//build bot routes on worker threads
+	Cvar_Get("bot_maxRoutingCache", "12288", 0);		//routing cache budget in KB
+	Cvar_Get("bot_routingTable", "0", 0);				//precompute all routes on small maps
+	Cvar_Get("bot_routingTableMaxAreas", "1024", 0);	//maximum number of areas for the routing table
 }
 
 /*
@@ -558,6 +637,15 @@ void SV_BotInitBotLib(void) {
 	botlib_import.DebugPolygonCreate = BotImport_DebugPolygonCreate;
 	botlib_import.DebugPolygonDelete = BotImport_DebugPolygonDelete;
 
+	//worker threads
+	botlib_import.RunParallel = Com_RunParallel;
+	botlib_import.NumWorkers = Com_NumWorkers;
+	botlib_import.WorkerIndex = Com_WorkerIndex;
+	botlib_import.CreateMutex = BotImport_CreateMutex;
+	botlib_import.DestroyMutex = BotImport_DestroyMutex;
+	botlib_import.LockMutex = BotImport_LockMutex;
+	botlib_import.UnlockMutex = BotImport_UnlockMutex;
+
 	botlib_export = (botlib_export_t *)GetBotLibAPI( BOTLIB_API_VERSION, &botlib_import );
 	assert(botlib_export); 	// somehow we end up with a zero import.
 }
@@ -609,7 +697,7 @@ int EntityInPVS( int client, int entityNum ) {
 	cl = &svs.clients[client];
 	frame = &cl->frames[cl->netchan.outgoingSequence & PACKET_MASK];
 	for ( i = 0; i < frame->num_entities; i++ )	{
-		if ( svs.snapshotEntities[(frame->first_entity + i) % svs.numSnapshotEntities].number == entityNum ) {
+		if ( SV_SnapshotEntity( cl, frame->first_entity + i )->number == entityNum ) {
 			return qtrue;
 		}
 	}
@@ -631,6 +719,6 @@ int SV_BotGetSnapshotEntity( int client, int sequence ) {
 	if (sequence < 0 || sequence >= frame->num_entities) {
 		return -1;
 	}
-	return svs.snapshotEntities[(frame->first_entity + sequence) % svs.numSnapshotEntities].number;
+	return SV_SnapshotEntity( cl, frame->first_entity + sequence )->number;
 }
 
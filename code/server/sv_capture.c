@@ -0,0 +1,909 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_capture.c -- inbound packets recorded and fed back in, see svcapture
+
+#include "server.h"
+
+/*
+svcapture writes everything that reaches the server from outside, from
+the next map on: every packet SV_PacketEvent gets with its address and
+the time it came off the socket, the console input, the msec of every
+SV_Frame, and the cvars once the game has registered its own. The few
+numbers the engine makes up, challenges, the checksum feed, the server
+id and svs.time at a map start, are recorded where they are made.
+
+svreplay starts the map again with those cvars and the sockets closed,
+and runs a frame for every recorded one as fast as it goes, handing the
+packets and console lines of the frame in before it and the recorded
+numbers where the server asks for new ones, so the clients' challenges,
+pure checksums and serverIds still match. SV_Frame is measured with
+sv_profile throughout and the result printed and added to a csv next to
+the capture, one row per replay.
+
+The engine side is the same every time, the game VM's own randomness
+isn't, so a long replay drifts from what happened. It stays a faithful
+load: the same clients sending the same usercmds at the same rate.
+
+Every record is a type byte, the varint length of the rest and the rest,
+numbers in it as varints.
+*/
+
+#define	CAPTURE_FOLDER		"captures"
+#define	CAPTURE_MAGIC		"Q3SVCAP1"
+#define	CAPTURE_MAX_RECORD	( MAX_MSGLEN + 256 )
+#define	CAPTURE_MAX_VALUES	32
+
+typedef enum {
+	CAP_BAD,
+	CAP_CVAR,			// name, value
+	CAP_SPAWN,			// map name
+	CAP_VALUE,			// svCaptureValue_t, value
+	CAP_PACKET,			// usec since the last packet, address, data
+	CAP_CONSOLE,		// text
+	CAP_FRAME			// msec
+} captureRecord_t;
+
+static struct {
+	qboolean		pending;			// starts with the next map
+	qboolean		cvarsPending;		// written with the first frame
+	char			name[MAX_QPATH];
+	FILE			*file;
+
+	int64_t			lastPacket;			// NET_PacketTime of the last one written
+	int				packets;
+	int				frames;
+	int64_t			bytes;
+
+	byte			record[CAPTURE_MAX_RECORD];
+	int				recordLen;
+} capture;
+
+static struct {
+	qboolean		active;
+	qboolean		quit;
+	char			name[MAX_QPATH];
+	char			savedProfile[MAX_CVAR_VALUE_STRING];
+	FILE			*file;
+
+	// the next record, read ahead
+	qboolean		peeked;
+	captureRecord_t	type;
+	byte			data[CAPTURE_MAX_RECORD];
+	int				len, pos;
+
+	// recorded numbers read before the server asked for them
+	svCaptureValue_t	valueKinds[CAPTURE_MAX_VALUES];
+	int				values[CAPTURE_MAX_VALUES];
+	int				numValues;
+	int				missedValues;
+
+	int64_t			startTime;
+	int64_t			packetTime;			// recorded, since the first packet
+	int64_t			playedMsec;
+	int				frames;
+	int				packets;
+	int				maps;
+} replay;
+
+static qboolean SV_ReplayPeek( void );
+static qboolean SV_ReplayPeekValue( svCaptureValue_t kind, int *value );
+
+/*
+===============================================================================
+
+CAPTURE
+
+===============================================================================
+*/
+
+/*
+==================
+SV_CapturePutInt
+==================
+*/
+static void SV_CapturePutInt( unsigned int v ) {
+	while ( v >= 0x80 && capture.recordLen < CAPTURE_MAX_RECORD ) {
+		capture.record[capture.recordLen++] = ( v & 0x7f ) | 0x80;
+		v >>= 7;
+	}
+	if ( capture.recordLen < CAPTURE_MAX_RECORD ) {
+		capture.record[capture.recordLen++] = v;
+	}
+}
+
+/*
+==================
+SV_CapturePutData
+==================
+*/
+static void SV_CapturePutData( const void *data, int len ) {
+	len = MIN( len, CAPTURE_MAX_RECORD - capture.recordLen );
+	Com_Memcpy( capture.record + capture.recordLen, data, len );
+	capture.recordLen += len;
+}
+
+/*
+==================
+SV_CapturePutString
+==================
+*/
+static void SV_CapturePutString( const char *s ) {
+	int		len = strlen( s );
+
+	SV_CapturePutInt( len );
+	SV_CapturePutData( s, len );
+}
+
+/*
+==================
+SV_CaptureWrite
+
+Writes the record put together since the last one
+==================
+*/
+static void SV_CaptureWrite( captureRecord_t type ) {
+	byte	header[6];
+	int		len, v;
+
+	header[0] = type;
+	len = 1;
+	for ( v = capture.recordLen; v >= 0x80; v >>= 7 ) {
+		header[len++] = ( v & 0x7f ) | 0x80;
+	}
+	header[len++] = v;
+
+	if ( fwrite( header, len, 1, capture.file ) != 1 ||
+		( capture.recordLen && fwrite( capture.record, capture.recordLen, 1, capture.file ) != 1 ) ) {
+		Com_Printf( "svcapture: couldn't write to %s, stopped\n", capture.name );
+		fclose( capture.file );
+		capture.file = NULL;
+	} else {
+		capture.bytes += len + capture.recordLen;
+	}
+
+	capture.recordLen = 0;
+}
+
+/*
+==================
+SV_CaptureCvar
+==================
+*/
+static void SV_CaptureCvar( const char *name ) {
+	// the map command sets sv_cheats, svreplay picks it by it
+	if ( ( Cvar_Flags( name ) & ( CVAR_ROM | CVAR_INIT | CVAR_PROTECTED ) ) && Q_stricmp( name, "sv_cheats" ) ) {
+		return;
+	}
+
+	// the sockets and the file system are the replaying server's own
+	if ( !Q_stricmpn( name, "net_", 4 ) || !Q_stricmpn( name, "fs_", 3 ) || !Q_stricmp( name, "sv_profile" ) ) {
+		return;
+	}
+
+	SV_CapturePutString( name );
+	SV_CapturePutString( Cvar_VariableString( name ) );
+	SV_CaptureWrite( CAP_CVAR );
+}
+
+/*
+==================
+SV_CaptureClose
+==================
+*/
+static void SV_CaptureClose( void ) {
+	if ( capture.file ) {
+		fclose( capture.file );
+		Com_Printf( "svcapture: %s closed, %i frames, %i packets, %lli KB\n",
+			capture.name, capture.frames, capture.packets, (long long)( capture.bytes >> 10 ) );
+	}
+
+	capture.file = NULL;
+	capture.pending = qfalse;
+}
+
+/*
+==================
+SV_CaptureSpawn
+
+Called by SV_SpawnServer before any of the numbers are made up, a pending
+capture starts here.
+==================
+*/
+void SV_CaptureSpawn( const char *mapname ) {
+	// started in SV_Frame, after its frame record
+	if ( replay.active ) {
+		if ( SV_ReplayPeek() && replay.type == CAP_SPAWN ) {
+			replay.peeked = qfalse;
+			replay.maps++;
+		}
+		return;
+	}
+
+	if ( capture.pending ) {
+		capture.pending = qfalse;
+
+		capture.file = FS_FOpenRawFileWrite( capture.name );
+		if ( !capture.file ) {
+			Com_Printf( "svcapture: couldn't open %s for writing\n", capture.name );
+			return;
+		}
+
+		if ( fwrite( CAPTURE_MAGIC, 8, 1, capture.file ) != 1 ) {
+			SV_CaptureClose();
+			return;
+		}
+
+		capture.cvarsPending = qtrue;
+		capture.lastPacket = 0;
+		capture.packets = capture.frames = 0;
+		capture.bytes = 8;
+		capture.recordLen = 0;
+
+		Com_Printf( "svcapture: recording to %s\n", capture.name );
+	}
+
+	if ( capture.file ) {
+		SV_CapturePutString( mapname );
+		SV_CaptureWrite( CAP_SPAWN );
+	}
+}
+
+/*
+==================
+SV_CaptureValue
+
+Everything the engine makes up that clients answer with goes through here:
+it is recorded when capturing and replaced by the recorded one when replaying.
+==================
+*/
+int SV_CaptureValue( svCaptureValue_t kind, int value ) {
+	int		i;
+
+	if ( capture.file ) {
+		SV_CapturePutInt( kind );
+		SV_CapturePutInt( value );
+		SV_CaptureWrite( CAP_VALUE );
+		return value;
+	}
+
+	if ( !replay.active ) {
+		return value;
+	}
+
+	for ( i = 0; i < replay.numValues; i++ ) {
+		if ( replay.valueKinds[i] == kind ) {
+			value = replay.values[i];
+			replay.numValues--;
+			memmove( replay.valueKinds + i, replay.valueKinds + i + 1, ( replay.numValues - i ) * sizeof( replay.valueKinds[0] ) );
+			memmove( replay.values + i, replay.values + i + 1, ( replay.numValues - i ) * sizeof( replay.values[0] ) );
+			return value;
+		}
+	}
+
+	// made up in SV_Frame, after its frame record
+	if ( SV_ReplayPeekValue( kind, &value ) ) {
+		return value;
+	}
+
+	replay.missedValues++;
+	return value;
+}
+
+/*
+==================
+SV_CapturePacket
+
+Called by SV_PacketEvent before it looks at the packet
+==================
+*/
+void SV_CapturePacket( const netadr_t *from, const msg_t *msg ) {
+	int64_t		now;
+
+	if ( !capture.file ) {
+		return;
+	}
+
+	now = NET_PacketTime();
+	if ( !capture.lastPacket || now < capture.lastPacket ) {
+		capture.lastPacket = now;
+	}
+	SV_CapturePutInt( (unsigned int)( now - capture.lastPacket ) );
+	capture.lastPacket = now;
+
+	SV_CapturePutInt( from->type );
+	switch ( from->type ) {
+	case NA_IP:
+		SV_CapturePutData( from->ip, sizeof( from->ip ) );
+		break;
+	case NA_IP6:
+		SV_CapturePutData( from->ip6, sizeof( from->ip6 ) );
+		SV_CapturePutInt( from->scope_id );
+		break;
+	default:
+		break;
+	}
+	SV_CapturePutInt( BigShort( from->port ) & 0xffff );
+
+	SV_CapturePutInt( msg->cursize );
+	SV_CapturePutData( msg->data, msg->cursize );
+	SV_CaptureWrite( CAP_PACKET );
+
+	capture.packets++;
+}
+
+/*
+==================
+SV_CaptureConsole
+
+A line typed into the server console
+==================
+*/
+void SV_CaptureConsole( const char *text ) {
+	if ( !capture.file ) {
+		return;
+	}
+
+	// stopping the capture isn't part of it
+	if ( !Q_stricmpn( text, "svcapture", 9 ) ) {
+		return;
+	}
+
+	SV_CapturePutString( text );
+	SV_CaptureWrite( CAP_CONSOLE );
+}
+
+/*
+==================
+SV_CaptureFrame
+
+Called by SV_Frame once it knows a map is running
+==================
+*/
+void SV_CaptureFrame( int msec ) {
+	if ( !capture.file ) {
+		return;
+	}
+
+	// the game's cvars are registered by now
+	if ( capture.cvarsPending ) {
+		capture.cvarsPending = qfalse;
+		Cvar_CommandCompletion( SV_CaptureCvar );
+		if ( !capture.file ) {
+			return;
+		}
+	}
+
+	SV_CapturePutInt( msec );
+	SV_CaptureWrite( CAP_FRAME );
+
+	capture.frames++;
+}
+
+/*
+===============================================================================
+
+REPLAY
+
+===============================================================================
+*/
+
+/*
+==================
+SV_ReplayGetInt
+==================
+*/
+static unsigned int SV_ReplayGetInt( void ) {
+	unsigned int	v = 0;
+	int				shift;
+
+	for ( shift = 0; replay.pos < replay.len && shift < 32; shift += 7 ) {
+		v |= ( replay.data[replay.pos] & 0x7f ) << shift;
+		if ( !( replay.data[replay.pos++] & 0x80 ) ) {
+			break;
+		}
+	}
+
+	return v;
+}
+
+/*
+==================
+SV_ReplayGetData
+==================
+*/
+static int SV_ReplayGetData( void *buf, unsigned int len, int size ) {
+	len = MIN( len, replay.len - replay.pos );
+	len = MIN( len, size );
+	Com_Memcpy( buf, replay.data + replay.pos, len );
+	replay.pos += len;
+	return len;
+}
+
+/*
+==================
+SV_ReplayGetString
+==================
+*/
+static void SV_ReplayGetString( char *buf, int size ) {
+	int		len;
+
+	len = SV_ReplayGetData( buf, SV_ReplayGetInt(), size - 1 );
+	buf[len] = '\0';
+}
+
+/*
+==================
+SV_ReplayPeek
+
+Reads the next record if it hasn't been, qfalse at the end of the file
+==================
+*/
+static qboolean SV_ReplayPeek( void ) {
+	int		c, shift;
+
+	if ( replay.peeked ) {
+		return qtrue;
+	}
+	if ( !replay.file ) {
+		return qfalse;
+	}
+
+	c = fgetc( replay.file );
+	if ( c == EOF ) {
+		return qfalse;
+	}
+	replay.type = c;
+
+	replay.len = 0;
+	for ( shift = 0; shift < 28; shift += 7 ) {
+		c = fgetc( replay.file );
+		if ( c == EOF ) {
+			return qfalse;
+		}
+		replay.len |= ( c & 0x7f ) << shift;
+		if ( !( c & 0x80 ) ) {
+			break;
+		}
+	}
+
+	if ( replay.len > CAPTURE_MAX_RECORD ) {
+		Com_Printf( "svreplay: %s is corrupt\n", replay.name );
+		return qfalse;
+	}
+	if ( replay.len && fread( replay.data, replay.len, 1, replay.file ) != 1 ) {
+		return qfalse;
+	}
+
+	replay.pos = 0;
+	replay.peeked = qtrue;
+	return qtrue;
+}
+
+/*
+==================
+SV_ReplayPeekValue
+
+Takes the number if the next record is one of kind
+==================
+*/
+static qboolean SV_ReplayPeekValue( svCaptureValue_t kind, int *value ) {
+	if ( !SV_ReplayPeek() || replay.type != CAP_VALUE ) {
+		return qfalse;
+	}
+
+	if ( SV_ReplayGetInt() != kind ) {
+		replay.pos = 0;
+		return qfalse;
+	}
+
+	*value = SV_ReplayGetInt();
+	replay.peeked = qfalse;
+	return qtrue;
+}
+
+/*
+==================
+SV_ReplayQueueValue
+==================
+*/
+static void SV_ReplayQueueValue( void ) {
+	if ( replay.numValues == CAPTURE_MAX_VALUES ) {
+		replay.missedValues++;
+		return;
+	}
+
+	replay.valueKinds[replay.numValues] = SV_ReplayGetInt();
+	replay.values[replay.numValues] = SV_ReplayGetInt();
+	replay.numValues++;
+}
+
+/*
+==================
+SV_ReplayPacket
+==================
+*/
+static void SV_ReplayPacket( void ) {
+	static byte	buf[MAX_MSGLEN];
+	netadr_t	from;
+	msg_t		msg;
+
+	replay.packetTime += SV_ReplayGetInt();
+
+	Com_Memset( &from, 0, sizeof( from ) );
+	from.type = SV_ReplayGetInt();
+	switch ( from.type ) {
+	case NA_IP:
+		SV_ReplayGetData( from.ip, sizeof( from.ip ), sizeof( from.ip ) );
+		break;
+	case NA_IP6:
+		SV_ReplayGetData( from.ip6, sizeof( from.ip6 ), sizeof( from.ip6 ) );
+		from.scope_id = SV_ReplayGetInt();
+		break;
+	default:
+		break;
+	}
+	from.port = BigShort( SV_ReplayGetInt() );
+
+	MSG_Init( &msg, buf, sizeof( buf ) );
+	msg.cursize = SV_ReplayGetData( buf, SV_ReplayGetInt(), sizeof( buf ) );
+
+	replay.packets++;
+	if ( com_sv_running->integer ) {
+		SV_PacketEvent( from, &msg );
+	}
+}
+
+/*
+==================
+SV_ReplayFinish
+
+Prints the frame times, adds them to the csv and takes the server down
+==================
+*/
+static void SV_ReplayFinish( const char *why, qboolean shutdown ) {
+	fileHandle_t	f;
+	char			path[MAX_QPATH];
+	int				frames, overBudget;
+	int				frameMean, frameP99, frameMax, gameMean, sendMean, p99, max;
+	float			seconds, speedup;
+
+	replay.active = qfalse;
+	if ( replay.file ) {
+		fclose( replay.file );
+		replay.file = NULL;
+	}
+
+	frames = SV_ProfileSummary( SVPROF_FRAME, &frameMean, &frameP99, &frameMax );
+	overBudget = SV_ProfileOverBudget();
+	SV_ProfileSummary( SVPROF_GAME, &gameMean, &p99, &max );
+	SV_ProfileSummary( SVPROF_SEND, &sendMean, &p99, &max );
+	seconds = ( Sys_Microseconds() - replay.startTime ) * 0.000001f;
+	speedup = seconds > 0.0f ? replay.playedMsec * 0.001f / seconds : 0.0f;
+
+	Com_Printf( "svreplay %s: %s\n", replay.name, why );
+	Com_Printf( "%i frames over %i maps, %i packets, %.1f s of play (%.1f s of packets) in %.1f s, %.1fx\n",
+		replay.frames, replay.maps, replay.packets, replay.playedMsec * 0.001f,
+		replay.packetTime * 0.000001f, seconds, speedup );
+	Com_Printf( "frame %i/%i/%i usec mean/p99/max, game %i, send %i usec mean, %i of %i over budget\n",
+		frameMean, frameP99, frameMax, gameMean, sendMean, overBudget, frames );
+	if ( replay.missedValues ) {
+		Com_Printf( "%i numbers the server made up weren't in the capture, the replay went its own way\n",
+			replay.missedValues );
+	}
+
+	Com_sprintf( path, sizeof( path ), CAPTURE_FOLDER "/%s.csv", replay.name );
+	if ( !FS_FileExists( path ) ) {
+		f = FS_FOpenFileWrite( path );
+		if ( f ) {
+			FS_Printf( f, "version,frames,frame_mean_usec,frame_p99_usec,frame_max_usec,over_budget,"
+				"game_mean_usec,send_mean_usec,play_seconds,replay_seconds,speedup,missed_values\n" );
+		}
+	} else {
+		f = FS_FOpenFileAppend( path );
+	}
+	if ( f ) {
+		FS_Printf( f, "\"%s\",%i,%i,%i,%i,%i,%i,%i,%.1f,%.1f,%.2f,%i\n",
+			Q3_VERSION, frames, frameMean, frameP99, frameMax, overBudget,
+			gameMean, sendMean, replay.playedMsec * 0.001f, seconds, speedup, replay.missedValues );
+		FS_FCloseFile( f );
+	}
+
+	Cvar_Set( "sv_profile", replay.savedProfile );
+
+	if ( shutdown ) {
+		SV_Shutdown( "replay over" );
+	}
+
+	NET_Config( qtrue );
+
+	if ( replay.quit ) {
+		Cbuf_AddText( "quit\n" );
+	}
+}
+
+/*
+==================
+SV_Replaying
+==================
+*/
+qboolean SV_Replaying( void ) {
+	return replay.active;
+}
+
+/*
+==================
+SV_ReplayEvents
+
+Called by Com_Frame after its own events. Hands in the packets and console
+lines of the next recorded frame and returns its msec, -1 if not replaying.
+==================
+*/
+int SV_ReplayEvents( void ) {
+	char	text[MAX_STRING_CHARS];
+	int		msec;
+
+	if ( !replay.active ) {
+		return -1;
+	}
+
+	while ( SV_ReplayPeek() ) {
+		replay.peeked = qfalse;
+
+		switch ( replay.type ) {
+		case CAP_PACKET:
+			SV_ReplayPacket();
+			break;
+
+		case CAP_CONSOLE:
+			SV_ReplayGetString( text, sizeof( text ) );
+			Cbuf_AddText( text );
+			Cbuf_AddText( "\n" );
+			break;
+
+		case CAP_VALUE:
+			SV_ReplayQueueValue();
+			break;
+
+		case CAP_SPAWN:
+			replay.maps++;
+			break;
+
+		case CAP_FRAME:
+			msec = SV_ReplayGetInt();
+			replay.frames++;
+			replay.playedMsec += msec;
+			return msec;
+
+		default:
+			// cvars only come before the first frame
+			break;
+		}
+
+		// the capture shut the server down
+		if ( !replay.active ) {
+			return -1;
+		}
+	}
+
+	SV_ReplayFinish( "done", qtrue );
+	return -1;
+}
+
+/*
+==================
+SV_ReplayStart
+
+Sets the cvars and starts the first map, leaving its first frame to be read
+==================
+*/
+static qboolean SV_ReplayStart( void ) {
+	char	name[MAX_CVAR_VALUE_STRING], value[MAX_CVAR_VALUE_STRING];
+	char	mapname[MAX_QPATH];
+	char	magic[8];
+
+	if ( fread( magic, sizeof( magic ), 1, replay.file ) != 1 || memcmp( magic, CAPTURE_MAGIC, sizeof( magic ) ) ) {
+		Com_Printf( "svreplay: %s isn't a capture\n", replay.name );
+		return qfalse;
+	}
+
+	mapname[0] = '\0';
+	while ( SV_ReplayPeek() && replay.type != CAP_FRAME ) {
+		replay.peeked = qfalse;
+
+		switch ( replay.type ) {
+		case CAP_SPAWN:
+			SV_ReplayGetString( mapname, sizeof( mapname ) );
+			break;
+		case CAP_VALUE:
+			SV_ReplayQueueValue();
+			break;
+		case CAP_CVAR:
+			SV_ReplayGetString( name, sizeof( name ) );
+			SV_ReplayGetString( value, sizeof( value ) );
+			Cvar_Set( name, value );
+			break;
+		default:
+			break;
+		}
+	}
+
+	if ( !mapname[0] || !replay.peeked ) {
+		Com_Printf( "svreplay: %s has no frames\n", replay.name );
+		return qfalse;
+	}
+
+	// nothing goes out to the recorded addresses and nobody else gets in
+	NET_Config( qfalse );
+
+	// the first frame record stays peeked through the map start
+	Cbuf_ExecuteText( EXEC_NOW, va( "%s %s\n", Cvar_VariableIntegerValue( "sv_cheats" ) ? "devmap" : "map", mapname ) );
+
+	if ( !com_sv_running->integer ) {
+		NET_Config( qtrue );
+		Com_Printf( "svreplay: couldn't start %s\n", mapname );
+		return qfalse;
+	}
+
+	replay.maps = 1;
+	return qtrue;
+}
+
+/*
+==================
+SV_CaptureShutdown
+
+The server is going down, a capture ends with it
+==================
+*/
+void SV_CaptureShutdown( void ) {
+	SV_CaptureClose();
+
+	if ( replay.active ) {
+		SV_ReplayFinish( "stopped by the server shutting down", qfalse );
+	}
+}
+
+/*
+==================
+SV_Capture_f
+
+svcapture <name>
+svcapture stop
+==================
+*/
+void SV_Capture_f( void ) {
+	int		i;
+
+	if ( Cmd_Argc() != 2 ) {
+		Com_Printf( "svcapture <name>\nsvcapture stop\n" );
+		if ( capture.file ) {
+			Com_Printf( "recording %s, %i frames, %i packets\n", capture.name, capture.frames, capture.packets );
+		} else if ( capture.pending ) {
+			Com_Printf( "%s starts with the next map\n", capture.name );
+		}
+		return;
+	}
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "stop" ) ) {
+		if ( !capture.file && !capture.pending ) {
+			Com_Printf( "No capture is running\n" );
+		}
+		SV_CaptureClose();
+		return;
+	}
+
+	if ( capture.file || capture.pending ) {
+		Com_Printf( "A capture is already running, svcapture stop first\n" );
+		return;
+	}
+	if ( replay.active ) {
+		Com_Printf( "Can't capture a replay\n" );
+		return;
+	}
+
+	// their connections wouldn't be in the capture
+	if ( com_sv_running->integer ) {
+		for ( i = 0; i < sv_maxclients->integer; i++ ) {
+			if ( svs.clients[i].state >= CS_CONNECTED && svs.clients[i].netchan.remoteAddress.type != NA_BOT ) {
+				Com_Printf( "svcapture has to start before anyone connects, e.g. on the command line before the map\n" );
+				return;
+			}
+		}
+	}
+
+	Com_sprintf( capture.name, sizeof( capture.name ), CAPTURE_FOLDER "/%s", Cmd_Argv( 1 ) );
+	COM_DefaultExtension( capture.name, sizeof( capture.name ), ".svcap" );
+	capture.pending = qtrue;
+
+	Com_Printf( "svcapture: %s starts with the next map\n", capture.name );
+}
+
+/*
+==================
+SV_Replay_f
+
+svreplay <name> [quit]
+==================
+*/
+void SV_Replay_f( void ) {
+	char	path[MAX_OSPATH];
+	int		i;
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "svreplay <name> [quit]\n" );
+		if ( replay.active ) {
+			Com_Printf( "replaying %s, %i frames, %i packets\n", replay.name, replay.frames, replay.packets );
+		}
+		return;
+	}
+
+	if ( !com_dedicated->integer ) {
+		Com_Printf( "svreplay only runs on a dedicated server\n" );
+		return;
+	}
+	if ( replay.active ) {
+		Com_Printf( "A replay is already running\n" );
+		return;
+	}
+	if ( capture.file || capture.pending ) {
+		Com_Printf( "Can't replay while capturing, svcapture stop first\n" );
+		return;
+	}
+
+	if ( com_sv_running->integer ) {
+		for ( i = 0; i < sv_maxclients->integer; i++ ) {
+			if ( svs.clients[i].state >= CS_CONNECTED && svs.clients[i].netchan.remoteAddress.type != NA_BOT ) {
+				Com_Printf( "svreplay needs a server nobody is on\n" );
+				return;
+			}
+		}
+	}
+
+	Com_Memset( &replay, 0, sizeof( replay ) );
+	Q_strncpyz( replay.name, Cmd_Argv( 1 ), sizeof( replay.name ) );
+	COM_StripExtension( replay.name, replay.name, sizeof( replay.name ) );
+	replay.quit = !Q_stricmp( Cmd_Argv( 2 ), "quit" );
+
+	Com_sprintf( path, sizeof( path ), "%s/" CAPTURE_FOLDER "/%s.svcap", FS_GetCurrentGameDir(), replay.name );
+	replay.file = FS_SV_FOpenRawFileRead( path );
+	if ( !replay.file ) {
+		Com_Printf( "svreplay: couldn't open %s\n", path );
+		return;
+	}
+
+	// SV_CaptureValue and SV_CaptureSpawn take from the file from here
+	replay.active = qtrue;
+
+	if ( !SV_ReplayStart() ) {
+		replay.active = qfalse;
+		fclose( replay.file );
+		replay.file = NULL;
+		return;
+	}
+
+	Q_strncpyz( replay.savedProfile, sv_profile->string, sizeof( replay.savedProfile ) );
+	Cvar_Set( "sv_profile", "1" );
+	SV_ProfileReset();
+	replay.startTime = Sys_Microseconds();
+
+	Com_Printf( "svreplay: %s on %s\n", path, sv_mapname->string );
+}
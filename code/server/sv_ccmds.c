@@ -175,17 +175,6 @@ static client_t *SV_GetPlayerByNum( void ) {
 	return cl;
 }
 
-/*
-==================
-SV_AlphaSort
-
-Array sorting comparison function (alphabetical sort).
-==================
-*/
-static int QDECL SV_AlphaSort(const void *a, const void *b) {
-    return strcmp(*(const char **) a, *(const char **) b);
-}
-
 /*
 ==================
 SV_GetMapSoundingLike
@@ -196,13 +185,9 @@ Retrieve a full map name given a substring of it.
 static void SV_GetMapSoundingLike(char *dest, const char *src, int destsize) {
 
 	int  i;
-	int  len = 0;
-	int  num = 0;
-	int  mapNum;
-	char *ptr;
-	char *matches[MAX_MAPLIST_SIZE];
+	int  num;
+	const char *matches[MAX_MAPLIST_SIZE];
 	char expanded[MAX_QPATH];
-	static char mapList[MAX_MAPLIST_STRING];
 
 	Com_sprintf(expanded, sizeof(expanded), "maps/%s.bsp", src);
 	if (FS_FOpenFileRead(expanded, NULL, qfalse) > 0) {
@@ -210,34 +195,31 @@ static void SV_GetMapSoundingLike(char *dest, const char *src, int destsize) {
 		return;
 	}
 
-	if (!(mapNum = FS_GetFileList("maps", ".bsp", mapList, sizeof(mapList)))) {
-		Com_Printf("Failed to retrieve available maps!\n");
-		*dest = 0;
-		return;
-	}
-
-	ptr = mapList;
-	for (i = 0; i < mapNum && num < MAX_MAPLIST_SIZE; i++, ptr += len + 1) {
-		len = (int) strlen(ptr);
-		COM_StripExtension(ptr, ptr, MAX_QPATH);
-		if (Q_stristr(ptr, src)) {
-			matches[num] = ptr;
-			num++;
-		}
+	num = FS_FindMaps(src, matches, MAX_MAPLIST_SIZE);
+	if (!num) {
+		// a loose .bsp may have turned up since the catalog was made
+		FS_RefreshMapCatalog();
+		num = FS_FindMaps(src, matches, MAX_MAPLIST_SIZE);
 	}
 
 	if (!num) {
-		Com_Printf("No map found matching %s.\n", src);
+		num = FS_SimilarMaps(src, matches, MAX_MAPLIST_SIZE);
+		if (!num) {
+			Com_Printf("No map found matching %s.\n", src);
+		} else {
+			Com_Printf("No map found matching %s, did you mean:\n", src);
+			for (i = 0; i < num; i++) {
+				Com_Printf(" - [%s]\n", matches[i]);
+			}
+		}
 		*dest = 0;
 		return;
 	}
 
 	if (num > 1) {
 
-	qsort(matches, (size_t) num, sizeof(char *), SV_AlphaSort);
-
 		Com_Printf("Found %d maps matching %s:\n", num, src);
-		for (i = 0; i < num; i++) {
+		for (i = 0; i < num && i < MAX_MAPLIST_SIZE; i++) {
 			Com_Printf(" - [%s]\n", matches[i]);
 		}
 
@@ -394,7 +376,7 @@ static void SV_MapRestart_f( void ) {
 
 	// generate a new serverid	
 	// TTimo - don't update restartedserverId there, otherwise we won't deal correctly with multiple map_restart
-	sv.serverId = com_frameTime;
+	sv.serverId = SV_CaptureValue( SVCAP_SERVERID, com_frameTime );
 	Cvar_Set( "sv_serverid", va("%i", sv.serverId ) );
 
 	// if a map_restart occurs while a client is changing maps, we need
@@ -425,6 +407,8 @@ static void SV_MapRestart_f( void ) {
 	sv.state = SS_GAME;
 	sv.restarting = qfalse;
 
+	SV_PrefetchMapChange( NULL );
+
 	// connect and begin all the clients
 	for (i=0 ; i<sv_maxclients->integer ; i++) {
 		client = &svs.clients[i];
@@ -653,87 +637,17 @@ static void SV_KickNum_f( void ) {
 ==================
 SV_RehashBans_f
 
-Load saved bans from file.
+Load saved bans from file, see SV_LoadBans.
 ==================
 */
 static void SV_RehashBans_f(void)
 {
-	int index, filelen;
-	fileHandle_t readfrom;
-	char *textbuf, *curpos, *maskpos, *newlinepos, *endpos;
-	char filepath[MAX_QPATH];
-	
 	// make sure server is running
 	if ( !com_sv_running->integer ) {
 		return;
 	}
-	
-	serverBansCount = 0;
-	
-	if(!sv_banFile->string || !*sv_banFile->string)
-		return;
-
-	Com_sprintf(filepath, sizeof(filepath), "%s/%s", FS_GetCurrentGameDir(), sv_banFile->string);
 
-	if((filelen = FS_SV_FOpenFileRead(filepath, &readfrom)) >= 0)
-	{
-		if(filelen < 2)
-		{
-			// Don't bother if file is too short.
-			FS_FCloseFile(readfrom);
-			return;
-		}
-
-		curpos = textbuf = Z_Malloc(filelen);
-		
-		filelen = FS_Read(textbuf, filelen, readfrom);
-		FS_FCloseFile(readfrom);
-		
-		endpos = textbuf + filelen;
-		
-		for(index = 0; index < SERVER_MAXBANS && curpos + 2 < endpos; index++)
-		{
-			// find the end of the address string
-			for(maskpos = curpos + 2; maskpos < endpos && *maskpos != ' '; maskpos++);
-			
-			if(maskpos + 1 >= endpos)
-				break;
-
-			*maskpos = '\0';
-			maskpos++;
-			
-			// find the end of the subnet specifier
-			for(newlinepos = maskpos; newlinepos < endpos && *newlinepos != '\n'; newlinepos++);
-			
-			if(newlinepos >= endpos)
-				break;
-			
-			*newlinepos = '\0';
-			
-			if(NET_StringToAdr(curpos + 2, &serverBans[index].ip, NA_UNSPEC))
-			{
-				serverBans[index].isexception = (curpos[0] != '0');
-				serverBans[index].subnet = atoi(maskpos);
-				
-				if(serverBans[index].ip.type == NA_IP &&
-				   (serverBans[index].subnet < 1 || serverBans[index].subnet > 32))
-				{
-					serverBans[index].subnet = 32;
-				}
-				else if(serverBans[index].ip.type == NA_IP6 &&
-					(serverBans[index].subnet < 1 || serverBans[index].subnet > 128))
-				{
-					serverBans[index].subnet = 128;
-				}
-			}
-			
-			curpos = newlinepos + 1;
-		}
-			
-		serverBansCount = index;
-		
-		Z_Free(textbuf);
-	}
+	SV_LoadBans();
 }
 
 /*
@@ -784,7 +698,7 @@ static qboolean SV_DelBanEntryFromList(int index)
 {
 	if(index == serverBansCount - 1)
 		serverBansCount--;
-	else if(index < ARRAY_LEN(serverBans) - 1)
+	else if(index < SERVER_MAXBANS - 1)
 	{
 		memmove(serverBans + index, serverBans + index + 1, (serverBansCount - index - 1) * sizeof(*serverBans));
 		serverBansCount--;
@@ -870,7 +784,10 @@ static void SV_AddBanToList(qboolean isexception)
 		return;
 	}
 
-	if(serverBansCount >= ARRAY_LEN(serverBans))
+	// edits go to the list a rehashbans is loading
+	SV_FinishLoadingBans(qtrue);
+
+	if(!SV_ReserveBans(serverBansCount + 1))
 	{
 		Com_Printf ("Error: Maximum number of bans/exceptions exceeded.\n");
 		return;
@@ -978,6 +895,7 @@ static void SV_AddBanToList(qboolean isexception)
 	
 	serverBansCount++;
 	
+	SV_RebuildBanTrie();
 	SV_WriteBans();
 
 	Com_Printf("Added %s: %s/%d\n", isexception ? "ban exception" : "ban",
@@ -1010,6 +928,8 @@ static void SV_DelBanFromList(qboolean isexception)
 		return;
 	}
 
+	SV_FinishLoadingBans(qtrue);
+
 	banstring = Cmd_Argv(1);
 	
 	if(strchr(banstring, '.') || strchr(banstring, ':'))
@@ -1072,6 +992,7 @@ static void SV_DelBanFromList(qboolean isexception)
 		}
 	}
 	
+	SV_RebuildBanTrie();
 	SV_WriteBans();
 }
 
@@ -1095,6 +1016,8 @@ static void SV_ListBans_f(void)
 		return;
 	}
 	
+	SV_FinishLoadingBans(qtrue);
+
 	// List all bans
 	for(index = count = 0; index < serverBansCount; index++)
 	{
@@ -1137,7 +1060,10 @@ static void SV_FlushBans_f(void)
 		return;
 	}
 
+	SV_FinishLoadingBans(qtrue);
+
 	serverBansCount = 0;
+	SV_RebuildBanTrie();
 	
 	// empty the ban file.
 	SV_WriteBans();
@@ -1165,9 +1091,54 @@ static void SV_ExceptDel_f(void)
 	SV_DelBanFromList(qtrue);
 }
 
+/*
+================
+SV_StatusNet
+
+The connection of every client over the last second. Loss and jitter
+come from the client's line, choke means snapshots waited on its rate
+or on fragments, a slow server shows in none of them but in the pings
+of everybody rising together.
+================
+*/
+static void SV_StatusNet(void) {
+
+	int               i;
+	client_t          *cl;
+	clientNetStats_t  *stats;
+	int               ping;
+	char              name[MAX_NAME_LENGTH];
+
+	Com_Printf("num ping jitter  loss choke  in KB/s out KB/s  rate name\n");
+	Com_Printf("--- ---- ------ ----- ----- -------- -------- ----- ---------------\n");
+
+	for (i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++) {
+
+		if (cl->state < CS_CONNECTED || cl->netchan.remoteAddress.type == NA_BOT) {
+			continue;
+		}
+		stats = &cl->netStats;
+
+		ping = cl->ping < 9999 ? cl->ping : 9999;
+
+		Q_strncpyz(name, cl->name, sizeof(name));
+		Q_CleanStr(name);
+
+		Com_Printf("%3i %4i %6.1f %4.1f%% %4.1f%% %8.1f %8.1f %5i %s^7\n", i, ping,
+			stats->jitter * 0.001f, stats->loss * 100.0f, stats->choke * 100.0f,
+			stats->bytesInRate / 1024.0f, stats->bytesOutRate / 1024.0f,
+			SV_ClientRate(cl), name);
+	}
+
+	Com_Printf("\n");
+
+}
+
 /*
 ================
 SV_Status_f
+
+status [net]
 ================
 */
 static void SV_Status_f(void) {
@@ -1184,6 +1155,11 @@ static void SV_Status_f(void) {
 		return;
 	}
 
+	if (!Q_stricmp(Cmd_Argv(1), "net")) {
+		SV_StatusNet();
+		return;
+	}
+
 	Com_Printf("map: %s\n", sv_mapname->string);
 	Com_Printf("num score ping name            lastmsg address               qport rate \n");
 	Com_Printf("--- ----- ---- --------------- ------- --------------------- ----- -----\n");
@@ -1340,7 +1316,7 @@ static void SV_Serverinfo_f( void ) {
 	}
 
 	Com_Printf ("Server info settings:\n");
-	Info_Print ( Cvar_InfoString( CVAR_SERVERINFO ) );
+	Info_Print ( SV_InfoString( CVAR_SERVERINFO ) );
 }
 
 
@@ -1359,7 +1335,7 @@ static void SV_Systeminfo_f( void ) {
 	}
 
 	Com_Printf ("System info settings:\n");
-	Info_Print ( Cvar_InfoString_Big( CVAR_SYSTEMINFO ) );
+	Info_Print ( SV_InfoString( CVAR_SYSTEMINFO ) );
 }
 
 
@@ -1395,6 +1371,149 @@ static void SV_DumpUser_f( void ) {
 }
 
 
+#define	MAX_ZYGOTE_CHILDREN	64
+
+typedef struct {
+	int		pid;
+	int		port;
+} zygoteChild_t;
+
+static zygoteChild_t	zygoteChildren[MAX_ZYGOTE_CHILDREN];
+static int				numZygoteChildren;
+
+/*
+=================
+SV_ReapZygoteChildren
+
+Called every frame, collects the forked servers that exited
+=================
+*/
+void SV_ReapZygoteChildren( void ) {
+	int		i;
+
+	for ( i = 0 ; i < numZygoteChildren ; i++ ) {
+		if ( !Sys_ChildExited( zygoteChildren[i].pid ) ) {
+			continue;
+		}
+
+		Com_Printf( "Forked server %i for port %i exited\n", zygoteChildren[i].pid, zygoteChildren[i].port );
+		zygoteChildren[i--] = zygoteChildren[--numZygoteChildren];
+	}
+}
+
+/*
+=================
+SV_Zygote_f
+
+zygote <port> [<port> ...]
+
+Forks a dedicated server for each port once this one has its map up,
+so hosts running many instances over the same paks load them, the map
+and the compiled game once and share the pages copy on write. Run it
+from the command line after the map, "+map ut4_abbey +zygote 27961".
+
+Nothing may be running on another thread across fork(), so the workers
+and the subsystem threads are taken down first, they are started again
+as they are used, and what the files have buffered is written out. Each
+child opens its own port and log, qconsole_<port>.log, and runs
+zygote_<port>.cfg if there is one, for a hostname, g_log and the like; a
+map_restart there picks up latched settings. The children that exit are
+reaped by SV_ReapZygoteChildren.
+=================
+*/
+static void SV_Zygote_f( void ) {
+	static qboolean	forked;
+	int				ports[MAX_ZYGOTE_CHILDREN];
+	int				i, numPorts, pid, child;
+	char			cfg[MAX_QPATH];
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "Usage: zygote <port> [<port> ...]\n" );
+		return;
+	}
+
+	if ( !com_dedicated->integer || !com_sv_running->integer || sv.state != SS_GAME ) {
+		Com_Printf( "zygote needs a dedicated server with a map running\n" );
+		return;
+	}
+
+	if ( forked ) {
+		Com_Printf( "This server was forked already\n" );
+		return;
+	}
+
+	for ( i = 0 ; i < sv_maxclients->integer ; i++ ) {
+		if ( svs.clients[i].state >= CS_CONNECTED ) {
+			Com_Printf( "zygote can't fork with clients connected\n" );
+			return;
+		}
+	}
+
+	numPorts = 0;
+	for ( i = 1 ; i < Cmd_Argc() && numPorts < MAX_ZYGOTE_CHILDREN ; i++ ) {
+		ports[numPorts] = atoi( Cmd_Argv( i ) );
+		if ( ports[numPorts] <= 0 || ports[numPorts] > 0xffff ) {
+			Com_Printf( "Bad port %s\n", Cmd_Argv( i ) );
+			return;
+		}
+		numPorts++;
+	}
+
+	// the threads, the sockets and the files written don't survive the fork
+	SVD_StopWorldDemo();
+	SVD_ShutdownWriter();
+	SV_LogShutdown();
+	SV_PrefetchShutdown();
+	SV_HttpShutdown();
+	SV_ShutdownBans();
+	NET_ResolverShutdown();
+	NET_Config( qfalse );
+	Com_ShutdownWorkers();
+
+	forked = qtrue;
+	child = 0;
+
+	for ( i = 0 ; i < numPorts ; i++ ) {
+		pid = Sys_Fork();
+		if ( pid < 0 ) {
+			Com_Printf( "WARNING: couldn't fork the server for port %i\n", ports[i] );
+			break;
+		}
+		if ( !pid ) {
+			child = ports[i];
+			numZygoteChildren = 0;
+			break;
+		}
+		Com_Printf( "Forked process %i for port %i\n", pid, ports[i] );
+
+		zygoteChildren[numZygoteChildren].pid = pid;
+		zygoteChildren[numZygoteChildren].port = ports[i];
+		numZygoteChildren++;
+	}
+
+	Com_InitWorkers();
+
+	if ( child ) {
+		FS_ReopenPaks();
+
+		// the parent keeps writing the log they shared
+		Com_ForkLogfile( va( "_%i", child ) );
+
+		Cvar_Set( "net_port", va( "%i", child ) );
+		Cvar_Set( "net_port6", va( "%i", child ) );
+
+		// tell the masters about the new port straight away
+		svs.nextHeartbeatTime = -9999999;
+
+		Com_sprintf( cfg, sizeof( cfg ), "zygote_%i.cfg", child );
+		if ( FS_ReadFile( cfg, NULL ) > 0 ) {
+			Cbuf_AddText( va( "exec %s\n", cfg ) );
+		}
+	}
+
+	NET_Config( qtrue );
+}
+
 /*
 =================
 SV_KillServer
@@ -1406,33 +1525,75 @@ static void SV_KillServer_f( void ) {
 
 //===========================================================
 
+/*
+Write the gamestate as a demo record, the one a demo starts with or a
+keyframe (see DEMO_KEYFRAME).
+
+This is mostly ripped from sv_client.c/SV_SendClientGameState
+and cl_main.c/CL_Record_f.
+*/
+static void SVD_WriteGamestate(const client_t *client, qboolean keyframe) {
+
+    int             len, mark;
+    msg_t           msg;
+
+    mark = Com_ScratchMark();
+    MSG_Init(&msg, Com_ScratchAlloc(MAX_MSGLEN), MAX_MSGLEN);
+    MSG_Bitstream(&msg); // XXX server code doesn't do this, client code does
+    MSG_WriteLong(&msg, client->lastClientCommand); // TODO: or is it client->reliableSequence?
+    MSG_WriteByte(&msg, svc_gamestate);
+    MSG_WriteLong(&msg, client->reliableSequence);
+
+    SV_WriteGamestate(&msg);
+
+    MSG_WriteByte(&msg, svc_EOF);
+    MSG_WriteLong(&msg, client - svs.clients);
+    MSG_WriteLong(&msg, sv.checksumFeed);
+    MSG_WriteByte(&msg, svc_EOF); // XXX server code doesn't do this, SV_Netchan_Transmit adds it!
+
+    len = LittleLong(client->netchan.outgoingSequence - 1);
+    SVD_WriteData(client, &len, 4);
+
+#ifdef USE_DEMO_FORMAT_42
+    if (keyframe) {
+        len = LittleLong(DEMO_KEYFRAME);
+        SVD_WriteData(client, &len, 4);
+    }
+#endif
+
+    len = LittleLong (msg.cursize);
+    SVD_WriteData(client, &len, 4);
+    SVD_WriteData(client, msg.data, msg.cursize);
+
+#ifdef USE_DEMO_FORMAT_42
+    // add size of packet in the end for backward play /* holblin */
+    SVD_WriteData(client, &len, 4);
+#endif
+
+    Com_ScratchRelease(mark);
+}
+
 /*
 Start a server-side demo.
 
 This does it all, create the file and adjust the demo-related
 stuff in client_t.
-
-This is mostly ripped from sv_client.c/SV_SendClientGameState
-and cl_main.c/CL_Record_f.
 */
 static void SVD_StartDemoFile(client_t *client, const char *path) {
 
-    int             i, len;
-    entityState_t   *base, nullstate;
-    msg_t           msg;
-    byte            buffer[MAX_MSGLEN];
-    fileHandle_t    file;
 #ifdef USE_DEMO_FORMAT_42
     char            *s;
-    int             v, size;
+    int             v, size, len;
 #endif
 
     Com_DPrintf("SVD_StartDemoFile\n");
     assert(!client->demo_recording);
 
     // create the demo file and write the necessary header
-    file = FS_FOpenFileWrite(path);
-    assert(file != 0);
+    if (!SVD_OpenWriter(client, path)) {
+        Com_Printf("WARNING: couldn't open %s for the server demo of %s\n", path, client->name);
+        return;
+    }
 
     /* File_write_header_demo // ADD this fx */
     /* HOLBLIN  entete demo */
@@ -1442,108 +1603,114 @@ static void SVD_StartDemoFile(client_t *client, const char *path) {
 
     size = strlen(s);
     len = LittleLong(size);
-    FS_Write(&len, 4, file);
-    FS_Write(s, size, file);
+    SVD_WriteData(client, &len, 4);
+    SVD_WriteData(client, s, size);
 
-    v = LittleLong(DEMO_VERSION);
-    FS_Write (&v, 4, file);
+    // without keyframes it stays readable by older clients
+    client->demo_indexed = sv_demoKeyframes->integer > 0;
+    v = LittleLong(client->demo_indexed ? DEMO_VERSION_INDEXED : DEMO_VERSION);
+    SVD_WriteData(client, &v, 4);
 
     len = 0;
     len = LittleLong(len);
-    FS_Write(&len, 4, file);
-    FS_Write(&len, 4, file);
+    SVD_WriteData(client, &len, 4);
+    SVD_WriteData(client, &len, 4);
+
+    // the gamestate is the first keyframe
+    if (client->demo_indexed) {
+        SVD_AddKeyframe(client, sv.time);
+    }
+#else
+    client->demo_indexed = qfalse;
 #endif
     /* END HOLBLIN  entete demo */
 
-    MSG_Init(&msg, buffer, sizeof(buffer));
-    MSG_Bitstream(&msg); // XXX server code doesn't do this, client code does
-    MSG_WriteLong(&msg, client->lastClientCommand); // TODO: or is it client->reliableSequence?
-    MSG_WriteByte(&msg, svc_gamestate);
-    MSG_WriteLong(&msg, client->reliableSequence);
+    SVD_WriteGamestate(client, qfalse);
 
-    for (i = 0; i < MAX_CONFIGSTRINGS; i++) {
-        if (sv.configstrings[i][0]) {
-            MSG_WriteByte(&msg, svc_configstring);
-            MSG_WriteShort(&msg, i);
-            MSG_WriteBigString(&msg, sv.configstrings[i]);
-        }
-    }
+    // adjust client_t to reflect demo started
+    client->demo_recording = qtrue;
+    client->demo_waiting = qtrue;
+    client->demo_backoff = 1;
+    client->demo_deltas = 0;
+    client->demo_keyframe = qfalse;
+    client->demo_keyframeTime = sv.time;
+}
 
-    Com_Memset(&nullstate, 0, sizeof(nullstate));
-    for (i = 0 ; i < MAX_GENTITIES; i++) {
-        base = &sv.svEntities[i].baseline;
-        if (!base->number) {
-            continue;
-        }
-        MSG_WriteByte(&msg, svc_baseline);
-        MSG_WriteDeltaEntity(&msg, &nullstate, base, qtrue);
-    }
+/*
+Is it time to force a full snapshot with a keyframe in front of it?
+*/
+qboolean SVD_KeyframeDue(const client_t *client) {
 
-    MSG_WriteByte(&msg, svc_EOF);
-    MSG_WriteLong(&msg, client - svs.clients);
-    MSG_WriteLong(&msg, sv.checksumFeed);
-    MSG_WriteByte(&msg, svc_EOF); // XXX server code doesn't do this, SV_Netchan_Transmit adds it!
+    if (!client->demo_recording || client->demo_waiting || !client->demo_indexed) {
+        return qfalse;
+    }
 
-    len = LittleLong(client->netchan.outgoingSequence - 1);
-    FS_Write(&len, 4, file);
+    if (sv_demoKeyframes->integer <= 0) {
+        return qfalse;
+    }
 
-    len = LittleLong (msg.cursize);
-    FS_Write(&len, 4, file);
-    FS_Write(msg.data, msg.cursize, file);
+    return sv.time - client->demo_keyframeTime >= sv_demoKeyframes->integer * 1000;
+}
 
-#ifdef USE_DEMO_FORMAT_42
-    // add size of packet in the end for backward play /* holblin */
-    FS_Write(&len, 4, file);
-#endif
+/*
+Write a keyframe in front of the full snapshot SV_WriteSnapshotToClient
+was asked for. The gamestate has every configstring up to the client's
+reliableSequence, so the commands in that snapshot are all older.
+*/
+void SVD_WriteKeyframe(client_t *client) {
 
-    FS_Flush(file);
+    client->demo_keyframe = qfalse;
+    client->demo_keyframeTime = sv.time;
 
-    // adjust client_t to reflect demo started
-    client->demo_recording = qtrue;
-    client->demo_file = file;
-    client->demo_waiting = qtrue;
-    client->demo_backoff = 1;
-    client->demo_deltas = 0;
+    // once the index is full the rest of the demo seeks from its last one
+    if (SVD_AddKeyframe(client, sv.time)) {
+        SVD_WriteGamestate(client, qtrue);
+    }
 }
 
 /*
 Write a message to a server-side demo file.
+
+The data is buffered and written from the demo writer thread, see sv_demo.c.
 */
-void SVD_WriteDemoFile(const client_t *client, const msg_t *msg) {
+void SVD_WriteDemoFile(const client_t *client, msg_t *msg) {
 
     int len;
-    msg_t cmsg;
-    byte cbuf[MAX_MSGLEN];
-    fileHandle_t file = client->demo_file;
+    int cursize, bit;
+    qboolean overflowed;
 
     if (*(int *)msg->data == -1) { // TODO: do we need this?
         Com_DPrintf("Ignored connectionless packet, not written to demo!\n");
         return;
     }
 
-    // TODO: we only copy because we want to add svc_EOF; can we add it and then
-    // "back off" from it, thus avoiding the copy?
-    MSG_Copy(&cmsg, cbuf, sizeof(cbuf), (msg_t*) msg);
-    MSG_WriteByte(&cmsg, svc_EOF); // XXX server code doesn't do this, SV_Netchan_Transmit adds it!
+    // add the svc_EOF that SV_Netchan_Transmit adds and back off from it
+    // again afterwards, the netchan writes the very same bits over it
+    cursize = msg->cursize;
+    bit = msg->bit;
+    overflowed = msg->overflowed;
+    MSG_WriteByte(msg, svc_EOF);
 
     // TODO: the headerbytes stuff done in the client seems unnecessary
     // here because we get the packet *before* the netchan has it's way
     // with it; just not sure that's really true :-/
 
     len = LittleLong(client->netchan.outgoingSequence);
-    FS_Write(&len, 4, file);
+    SVD_WriteData(client, &len, 4);
 
-    len = LittleLong(cmsg.cursize);
-    FS_Write(&len, 4, file);
+    len = LittleLong(msg->cursize);
+    SVD_WriteData(client, &len, 4);
 
-    FS_Write(cmsg.data, cmsg.cursize, file); // XXX don't use len!
+    SVD_WriteData(client, msg->data, msg->cursize); // XXX don't use len!
 
 #ifdef USE_DEMO_FORMAT_42
     // add size of packet in the end for backward play /* holblin */
-    FS_Write(&len, 4, file);
+    SVD_WriteData(client, &len, 4);
 #endif
 
-    FS_Flush(file);
+    msg->cursize = cursize;
+    msg->bit = bit;
+    msg->overflowed = overflowed;
 }
 
 /*
@@ -1555,23 +1722,26 @@ in client_t again.
 static void SVD_StopDemoFile(client_t *client) {
 
     int marker = -1;
-    fileHandle_t file = client->demo_file;
 
     Com_DPrintf("SVD_StopDemoFile\n");
     assert(client->demo_recording);
 
     // write the necessary trailer and close the demo file
-    FS_Write(&marker, 4, file);
-    FS_Write(&marker, 4, file);
-    FS_Flush(file);
-    FS_FCloseFile(file);
+    SVD_WriteData(client, &marker, 4);
+    SVD_WriteData(client, &marker, 4);
+    // the seek index goes after the end
+    if (client->demo_indexed) {
+        SVD_WriteIndex(client);
+    }
+    SVD_CloseWriter(client);
 
     // adjust client_t to reflect demo stopped
     client->demo_recording = qfalse;
-    client->demo_file = -1;
     client->demo_waiting = qfalse;
     client->demo_backoff = 1;
     client->demo_deltas = 0;
+    client->demo_indexed = qfalse;
+    client->demo_keyframe = qfalse;
 }
 
 /*
@@ -1683,6 +1853,9 @@ void SV_StartRecordOne(client_t *client, char *filename) {
 
     SV_NameServerDemo(path, sizeof(path), client, filename);
     SVD_StartDemoFile(client, path);
+    if (!client->demo_recording) {
+        return;
+    }
 
     if(sv_demonotice->string) {
         SV_SendServerCommand(client, "print \"%s\"\n", sv_demonotice->string);
@@ -1856,7 +2029,7 @@ SV_CompleteMapName
 */
 static void SV_CompleteMapName( char *args, int argNum ) {
 	if( argNum == 2 ) {
-		Field_CompleteFilename( "maps", "bsp", qtrue, qtrue, qtrue );
+		Field_CompleteMapName( );
 	}
 }
 
@@ -1922,6 +2095,19 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand ("dumpuser", SV_DumpUser_f);
 	Cmd_AddCommand ("map_restart", SV_MapRestart_f);
 	Cmd_AddCommand ("sectorlist", SV_SectorList_f);
+	Cmd_AddCommand ("profilestats", SV_ProfileStats_f);
+	Cmd_AddCommand ("loadtest", SV_LoadTest_f);
+	Cmd_AddCommand ("svcapture", SV_Capture_f);
+	Cmd_AddCommand ("svreplay", SV_Replay_f);
+	Cmd_AddCommand ("microbench", SV_MicroBench_f);
+	Cmd_AddCommand ("botroutinginfo", SV_BotRoutingInfo_f);
+#ifdef USE_AUTH
+	Cmd_AddCommand ("authinfo", SV_AuthInfo_f);
+#endif
+	Cmd_AddCommand ("packetstats", SVC_PacketStats_f);
+	Cmd_AddCommand ("logrotate", SV_LogRotate_f);
+	Cmd_AddCommand ("prefetchmap", SV_Prefetch_f);
+	Cmd_AddCommand ("httpinfo", SV_HttpInfo_f);
 	Cmd_AddCommand ("map", SV_Map_f);
 	Cmd_SetCommandCompletionFunc( "map", SV_CompleteMapName );
 #ifndef PRE_RELEASE_DEMO
@@ -1933,6 +2119,7 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_SetCommandCompletionFunc( "spdevmap", SV_CompleteMapName );
 #endif
 	Cmd_AddCommand ("killserver", SV_KillServer_f);
+	Cmd_AddCommand ("zygote", SV_Zygote_f);
 	if( com_dedicated->integer ) {
 		Cmd_AddCommand ("say", SV_ConSay_f);
 		Cmd_AddCommand ("tell", SV_ConTell_f);
@@ -1941,6 +2128,8 @@ void SV_AddOperatorCommands( void ) {
 		Cmd_SetCommandCompletionFunc( "sayto", SV_CompletePlayerName );
 		Cmd_AddCommand("startserverdemo", SV_StartServerDemo_f);
 		Cmd_AddCommand("stopserverdemo", SV_StopServerDemo_f);
+		Cmd_AddCommand("startworlddemo", SV_StartWorldDemo_f);
+		Cmd_AddCommand("stopworlddemo", SV_StopWorldDemo_f);
 	}
 	
 	Cmd_AddCommand("rehashbans", SV_RehashBans_f);
@@ -1972,9 +2161,24 @@ void SV_RemoveOperatorCommands( void ) {
 	Cmd_RemoveCommand ("dumpuser");
 	Cmd_RemoveCommand ("map_restart");
 	Cmd_RemoveCommand ("sectorlist");
+	Cmd_RemoveCommand ("profilestats");
+	Cmd_RemoveCommand ("loadtest");
+	Cmd_RemoveCommand ("svcapture");
+	Cmd_RemoveCommand ("svreplay");
+	Cmd_RemoveCommand ("microbench");
+	Cmd_RemoveCommand ("botroutinginfo");
+#ifdef USE_AUTH
+	Cmd_RemoveCommand ("authinfo");
+#endif
+	Cmd_RemoveCommand ("packetstats");
+	Cmd_RemoveCommand ("logrotate");
+	Cmd_RemoveCommand ("prefetchmap");
+	Cmd_RemoveCommand ("httpinfo");
 	Cmd_RemoveCommand ("say");
 	Cmd_RemoveCommand ("startserverdemo");
 	Cmd_RemoveCommand ("stopserverdemo");
+	Cmd_RemoveCommand ("startworlddemo");
+	Cmd_RemoveCommand ("stopworlddemo");
 #endif
 }
 
@@ -65,13 +65,6 @@ void SV_GetChallenge(netadr_t from)
 		return;
 	}
 
-	// Prevent using getchallenge as an amplifier
-	if ( SVC_RateLimitAddress( from, 10, 1000 ) ) {
-		Com_DPrintf( "SV_GetChallenge: rate limit from %s exceeded, dropping request\n",
-			NET_AdrToString( from ) );
-		return;
-	}
-
 	// Allow getchallenge to be DoSed relatively easily, but prevent
 	// excess outbound bandwidth usage when being flooded inbound
 	if ( SVC_RateLimit( &outboundLeakyBucket, 10, 100 ) ) {
@@ -137,7 +130,7 @@ void SV_GetChallenge(netadr_t from)
 	}
 
 	// always generate a new challenge number, so the client cannot circumvent sv_maxping
-	challenge->challenge = ( ((unsigned int)rand() << 16) ^ (unsigned int)rand() ) ^ svs.time;
+	challenge->challenge = SV_CaptureValue( SVCAP_CHALLENGE, ( ((unsigned int)rand() << 16) ^ (unsigned int)rand() ) ^ svs.time );
 	challenge->wasrefused = qfalse;
 	challenge->time = svs.time;
 	challenge->pingTime = svs.time;
@@ -145,40 +138,6 @@ void SV_GetChallenge(netadr_t from)
 			   challenge->challenge, clientChallenge, com_protocol->integer);
 }
 
-/*
-==================
-SV_IsBanned
-
-Check whether a certain address is banned
-==================
-*/
-
-static qboolean SV_IsBanned(netadr_t *from, qboolean isexception)
-{
-	int index;
-	serverBan_t *curban;
-	
-	if(!isexception)
-	{
-		// If this is a query for a ban, first check whether the client is excepted
-		if(SV_IsBanned(from, qtrue))
-			return qfalse;
-	}
-	
-	for(index = 0; index < serverBansCount; index++)
-	{
-		curban = &serverBans[index];
-		
-		if(curban->isexception == isexception)
-		{
-			if(NET_CompareBaseAdrMask(curban->ip, *from, curban->subnet))
-				return qtrue;
-		}
-	}
-	
-	return qfalse;
-}
-
 /*
 ==================
 SV_DirectConnect
@@ -189,6 +148,7 @@ A "connect" OOB command has been received
 
 void SV_DirectConnect( netadr_t from ) {
 	char		userinfo[MAX_INFO_STRING];
+	infoString_t	info;
 	int			i;
 	client_t	*cl, *newcl;
 	client_t	temp;
@@ -197,7 +157,7 @@ void SV_DirectConnect( netadr_t from ) {
 	int			version;
 	int			qport;
 	int			challenge;
-	char		*password;
+	const char	*password;
 	int			startIndex;
 	intptr_t		denied;
 	int			count;
@@ -210,15 +170,16 @@ void SV_DirectConnect( netadr_t from ) {
 	Com_DPrintf ("SVC_DirectConnect ()\n");
 	
 	// Check whether this client is banned.
-	if(SV_IsBanned(&from, qfalse))
+	if(SV_IsBanned(&from))
 	{
 		NET_OutOfBandPrint(NS_SERVER, from, "print\nYou are banned from this server.\n");
 		return;
 	}
 
 	Q_strncpyz( userinfo, Cmd_Argv(1), sizeof(userinfo) );
+	Info_Parse( &info, userinfo, MAX_INFO_STRING );
 
-	version = atoi(Info_ValueForKey(userinfo, "protocol"));
+	version = atoi(Info_Find(&info, "protocol"));
 	
 #ifdef LEGACY_PROTOCOL
 	if(version > 0 && com_legacyprotocol->integer == version)
@@ -235,8 +196,8 @@ void SV_DirectConnect( netadr_t from ) {
 		}
 	}
 
-	challenge = atoi( Info_ValueForKey( userinfo, "challenge" ) );
-	qport = atoi( Info_ValueForKey( userinfo, "qport" ) );
+	challenge = atoi( Info_Find( &info, "challenge" ) );
+	qport = atoi( Info_Find( &info, "qport" ) );
 
 	// quick reject
 	for (i=0,cl=svs.clients ; i < sv_maxclients->integer ; i++,cl++) {
@@ -256,7 +217,7 @@ void SV_DirectConnect( netadr_t from ) {
 	}
 	
 	// don't let "ip" overflow userinfo string
-	if ( NET_IsLocalAddress (from) )
+	if ( NET_IsLocalAddress (from) || from.type == NA_LOADTEST )
 		ip = "localhost";
 	else
 		ip = (char *)NET_AdrToStringwPort( from );
@@ -266,10 +227,11 @@ void SV_DirectConnect( netadr_t from ) {
 			"Try removing setu cvars from your config.\n" );
 		return;
 	}
-	Info_SetValueForKey( userinfo, "ip", ip );
+	Info_Set( &info, "ip", ip );
+	Q_strncpyz( userinfo, Info_String( &info ), sizeof(userinfo) );
 
-	// see if the challenge is valid (LAN clients don't need to challenge)
-	if (!NET_IsLocalAddress(from))
+	// see if the challenge is valid (LAN and loadtest clients don't need to challenge)
+	if (!NET_IsLocalAddress(from) && from.type != NA_LOADTEST)
 	{
 		int ping;
 		challenge_t *challengeptr;
@@ -371,7 +333,7 @@ void SV_DirectConnect( netadr_t from ) {
 	// servers so we can play without having to kick people.
 
 	// check for privateClient password
-	password = Info_ValueForKey( userinfo, "password" );
+	password = Info_Find( &info, "password" );
 	if ( *password && !strcmp( password, sv_privatePassword->string ) ) {
 		startIndex = 0;
 	} else {
@@ -422,7 +384,10 @@ gotnewcl:
 	// build a new connection
 	// accept the new client
 	// this is the only place a client_t is ever initialized
+	temp.reliableCommands = newcl->reliableCommands;
+	temp.frames = newcl->frames;
 	*newcl = temp;
+	SV_AllocClientStorage( newcl );
 	clientNum = newcl - svs.clients;
 	ent = SV_GentityNum( clientNum );
 	newcl->gentity = ent;
@@ -442,10 +407,11 @@ gotnewcl:
 
 	// clear server-side demo recording
 	newcl->demo_recording = qfalse;
-	newcl->demo_file = -1;
 	newcl->demo_waiting = qfalse;
 	newcl->demo_backoff = 1;
 	newcl->demo_deltas = 0;
+	newcl->demo_indexed = qfalse;
+	newcl->demo_keyframe = qfalse;
 	
 	// save the userinfo
 	Q_strncpyz( newcl->userinfo, userinfo, sizeof(newcl->userinfo) );
@@ -502,16 +468,15 @@ Destructor for data allocated in a client structure
 void SV_FreeClient(client_t *client)
 {
 #ifdef USE_VOIP
-	int index;
+	int i;
 	
-	for(index = client->queuedVoipIndex; index < client->queuedVoipPackets; index++)
+	for(i = 0; i < client->queuedVoipPackets; i++)
 	{
-		index %= ARRAY_LEN(client->voipPacket);
-		
-		Z_Free(client->voipPacket[index]);
+		SV_ReleaseVoipPacket(client->voipPacket[(client->queuedVoipIndex + i) % ARRAY_LEN(client->voipPacket)]);
 	}
 	
 	client->queuedVoipPackets = 0;
+	client->queuedVoipIndex = 0;
 #endif
 
 	SV_Netchan_FreeQueue(client);
@@ -519,6 +484,44 @@ void SV_FreeClient(client_t *client)
 
 void SV_StopRecordOne(client_t *client);
 
+/*
+=====================
+SV_AllocClientStorage
+
+Gives a slot its reliable command and snapshot buffers, cleared. They are
+kept for whoever gets the slot next, so only slots that have never been
+used, usually most of them on a server with a high sv_maxclients, go
+without.
+=====================
+*/
+void SV_AllocClientStorage( client_t *client ) {
+	int		size;
+
+	size = MAX_RELIABLE_COMMANDS * sizeof( client->reliableCommands[0] );
+
+	if ( !client->reliableCommands ) {
+		client->reliableCommands = Z_Malloc( size + PACKET_BACKUP * sizeof( client->frames[0] ) );
+		client->frames = (clientSnapshot_t *)( (byte *)client->reliableCommands + size );
+		return;
+	}
+
+	Com_Memset( client->reliableCommands, 0, size );
+	Com_Memset( client->frames, 0, PACKET_BACKUP * sizeof( client->frames[0] ) );
+}
+
+/*
+=====================
+SV_FreeClientStorage
+=====================
+*/
+void SV_FreeClientStorage( client_t *client ) {
+	if ( client->reliableCommands ) {
+		Z_Free( client->reliableCommands );
+	}
+	client->reliableCommands = NULL;
+	client->frames = NULL;
+}
+
 /*
 =====================
 SV_DropClient
@@ -682,6 +685,162 @@ void SV_Auth_DropClient(client_t *drop, const char *reason, const char *message)
 }
 #endif
 
+/*
+=============================================================================
+
+Gamestate cache
+
+Every client connecting to a map is sent the same configstrings and
+baselines, and a map change on a full server encoded them once for each.
+The encoded bits of each configstring and of the baselines together are
+kept and copied into every gamestate message, a configstring that
+changes is encoded again the next time it is needed, the baselines once
+SV_CreateBaseline has made new ones.
+
+=============================================================================
+*/
+
+typedef struct {
+	byte	*data;			// Z_Malloc'd, NULL until encoded
+	int		bits;
+} gamestateBits_t;
+
+static struct {
+	gamestateBits_t	configstrings[MAX_CONFIGSTRINGS];
+	gamestateBits_t	baselines;
+	byte			scratch[MAX_MSGLEN];
+} svGamestate;
+
+/*
+================
+SV_FreeGamestateBits
+================
+*/
+static void SV_FreeGamestateBits( gamestateBits_t *bits ) {
+	if ( bits->data ) {
+		Z_Free( bits->data );
+	}
+	bits->data = NULL;
+	bits->bits = 0;
+}
+
+/*
+================
+SV_InvalidateGamestate
+
+For a changed configstring, -1 for the baselines and everything
+================
+*/
+void SV_InvalidateGamestate( int index ) {
+	int		i;
+
+	if ( index >= 0 && index < MAX_CONFIGSTRINGS ) {
+		SV_FreeGamestateBits( &svGamestate.configstrings[index] );
+		return;
+	}
+
+	for ( i = 0 ; i < MAX_CONFIGSTRINGS ; i++ ) {
+		SV_FreeGamestateBits( &svGamestate.configstrings[i] );
+	}
+	SV_FreeGamestateBits( &svGamestate.baselines );
+}
+
+/*
+================
+SV_WriteGamestateConfigstring
+================
+*/
+static void SV_WriteGamestateConfigstring( msg_t *msg, int index ) {
+	MSG_WriteByte( msg, svc_configstring );
+	MSG_WriteShort( msg, index );
+	MSG_WriteBigString( msg, sv.configstrings[index] );
+}
+
+/*
+================
+SV_WriteGamestateBaselines
+================
+*/
+static void SV_WriteGamestateBaselines( msg_t *msg ) {
+	entityState_t	*base, nullstate;
+	int				i;
+
+	Com_Memset( &nullstate, 0, sizeof( nullstate ) );
+	for ( i = 0 ; i < MAX_GENTITIES; i++ ) {
+		base = &sv.svEntities[i].baseline;
+		if ( !base->number ) {
+			continue;
+		}
+		MSG_WriteByte( msg, svc_baseline );
+		MSG_WriteDeltaEntity( msg, &nullstate, base, qtrue );
+	}
+}
+
+/*
+================
+SV_CacheGamestateBits
+
+Encodes a part of the gamestate on its own, qfalse if it doesn't fit
+================
+*/
+static qboolean SV_CacheGamestateBits( gamestateBits_t *bits, int index ) {
+	msg_t	part;
+	int		bytes;
+
+	MSG_Init( &part, svGamestate.scratch, sizeof( svGamestate.scratch ) );
+	part.allowoverflow = qtrue;
+
+	if ( index >= 0 ) {
+		SV_WriteGamestateConfigstring( &part, index );
+	} else {
+		SV_WriteGamestateBaselines( &part );
+	}
+
+	if ( part.overflowed ) {
+		return qfalse;
+	}
+
+	bytes = ( part.bit + 7 ) >> 3;
+	bits->data = Z_Malloc( bytes ? bytes : 1 );
+	Com_Memcpy( bits->data, part.data, bytes );
+	bits->bits = part.bit;
+
+	return qtrue;
+}
+
+/*
+================
+SV_WriteGamestate
+
+The configstrings and baselines of a gamestate message, as
+SV_SendClientGameState and server side demos write them
+================
+*/
+void SV_WriteGamestate( msg_t *msg ) {
+	gamestateBits_t	*bits;
+	int				i;
+
+	for ( i = 0 ; i < MAX_CONFIGSTRINGS ; i++ ) {
+		if ( !sv.configstrings[i][0] ) {
+			continue;
+		}
+
+		bits = &svGamestate.configstrings[i];
+		if ( bits->data || SV_CacheGamestateBits( bits, i ) ) {
+			MSG_WriteBitstream( msg, bits->data, bits->bits );
+		} else {
+			SV_WriteGamestateConfigstring( msg, i );
+		}
+	}
+
+	bits = &svGamestate.baselines;
+	if ( bits->data || SV_CacheGamestateBits( bits, -1 ) ) {
+		MSG_WriteBitstream( msg, bits->data, bits->bits );
+	} else {
+		SV_WriteGamestateBaselines( msg );
+	}
+}
+
 /*
 ================
 SV_SendClientGameState
@@ -693,11 +852,9 @@ It will be resent if the client acknowledges a later message but has
 the wrong gamestate.
 ================
 */
-static void SV_SendClientGameState( client_t *client ) {
-	int			start;
-	entityState_t	*base, nullstate;
+void SV_SendClientGameState( client_t *client ) {
 	msg_t		msg;
-	byte		msgBuffer[MAX_MSGLEN];
+	int			mark;
 
  	Com_DPrintf ("SV_SendClientGameState() for %s\n", client->name);
 	Com_DPrintf( "Going from CS_CONNECTED to CS_PRIMED for %s\n", client->name );
@@ -710,7 +867,8 @@ static void SV_SendClientGameState( client_t *client ) {
 	// gamestate message was not just sent, forcing a retransmit
 	client->gamestateMessageNum = client->netchan.outgoingSequence;
 
-	MSG_Init( &msg, msgBuffer, sizeof( msgBuffer ) );
+	mark = Com_ScratchMark();
+	MSG_Init( &msg, Com_ScratchAlloc( MAX_MSGLEN ), MAX_MSGLEN );
 
 	// NOTE, MRE: all server->client messages now acknowledge
 	// let the client know which reliable clientCommands we have received
@@ -726,25 +884,8 @@ static void SV_SendClientGameState( client_t *client ) {
 	MSG_WriteByte( &msg, svc_gamestate );
 	MSG_WriteLong( &msg, client->reliableSequence );
 
-	// write the configstrings
-	for ( start = 0 ; start < MAX_CONFIGSTRINGS ; start++ ) {
-		if (sv.configstrings[start][0]) {
-			MSG_WriteByte( &msg, svc_configstring );
-			MSG_WriteShort( &msg, start );
-			MSG_WriteBigString( &msg, sv.configstrings[start] );
-		}
-	}
-
-	// write the baselines
-	Com_Memset( &nullstate, 0, sizeof( nullstate ) );
-	for ( start = 0 ; start < MAX_GENTITIES; start++ ) {
-		base = &sv.svEntities[start].baseline;
-		if ( !base->number ) {
-			continue;
-		}
-		MSG_WriteByte( &msg, svc_baseline );
-		MSG_WriteDeltaEntity( &msg, &nullstate, base, qtrue );
-	}
+	// write the configstrings and the baselines
+	SV_WriteGamestate( &msg );
 
 	MSG_WriteByte( &msg, svc_EOF );
 
@@ -755,6 +896,41 @@ static void SV_SendClientGameState( client_t *client ) {
 
 	// deliver this to the client
 	SV_SendMessageToClient( &msg, client );
+
+	Com_ScratchRelease( mark );
+}
+
+
+/*
+================
+SV_GameStateSlotFree
+
+sv_gamestateLimit caps how many clients are sent a gamestate at once, so
+a map change on a full server doesn't push every gamestate in the same
+frames.  A client counts until the last fragment of its gamestate is out,
+the fragments themselves are paced by SV_RateMsec.  Clients that have to
+wait ask again with every packet they send.
+================
+*/
+static qboolean SV_GameStateSlotFree( client_t *client ) {
+	client_t	*cl;
+	int			i, sending;
+
+	if ( sv_gamestateLimit->integer <= 0 || client->netchan.remoteAddress.type == NA_LOOPBACK ) {
+		return qtrue;
+	}
+
+	sending = 0;
+	for ( i = 0, cl = svs.clients ; i < sv_maxclients->integer ; i++, cl++ ) {
+		if ( cl == client || cl->state != CS_PRIMED ) {
+			continue;
+		}
+		if ( cl->netchan.unsentFragments || cl->netchan_start_queue ) {
+			sending++;
+		}
+	}
+
+	return sending < sv_gamestateLimit->integer;
 }
 
 
@@ -770,7 +946,7 @@ void SV_ClientEnterWorld( client_t *client, usercmd_t *cmd ) {
 	Com_DPrintf( "Going from CS_PRIMED to CS_ACTIVE for %s\n", client->name );
 	client->state = CS_ACTIVE;
 
-	if (sv_autoRecordDemo->integer && client->netchan.remoteAddress.type != NA_BOT) {
+	if (sv_autoRecordDemo->integer == 1 && client->netchan.remoteAddress.type != NA_BOT) {
 		SV_StartRecordOne(client, NULL);
 	}
 
@@ -831,12 +1007,18 @@ Return the shortest time interval for sending next packet to client
 
 int SV_SendQueuedMessages(void)
 {
+	static int start;
 	int i, retval = -1, nextFragT;
 	client_t *cl;
 	
+	// start with a different client every round so the first slots
+	// don't always get their fragments out first
+	if(++start >= sv_maxclients->integer)
+		start = 0;
+
 	for(i=0; i < sv_maxclients->integer; i++)
 	{
-		cl = &svs.clients[i];
+		cl = &svs.clients[(start + i) % sv_maxclients->integer];
 		
 		if(cl->state)
 		{
@@ -1037,72 +1219,153 @@ static void SV_ResetPureClient_f( client_t *cl ) {
 	cl->gotCP = qfalse;
 }
 
+// the keys SV_UserinfoChanged looks at
+#define	USERINFO_NAME		1
+#define	USERINFO_RATE		2
+#define	USERINFO_HANDICAP	4
+#define	USERINFO_SNAPS		8
+#define	USERINFO_VOIP		16
+#define	USERINFO_CSDELTA	32
+#define	USERINFO_PMTU		64
+#define	USERINFO_OTHER		128			// a key only the game reads
+#define	USERINFO_ALL		255
+
 /*
 =================
-SV_UserinfoChanged
+SV_UserinfoKeyFlag
+=================
+*/
+static int SV_UserinfoKeyFlag( const char *key ) {
+	static const struct {
+		const char	*key;
+		int			flag;
+	} keys[] = {
+		{ "name", USERINFO_NAME },
+		{ "rate", USERINFO_RATE },
+		{ "handicap", USERINFO_HANDICAP },
+		{ "snaps", USERINFO_SNAPS },
+		{ "cl_voipProtocol", USERINFO_VOIP },
+		{ "cl_csDelta", USERINFO_CSDELTA },
+		{ "cl_pmtu", USERINFO_PMTU }
+	};
+	int		i;
+
+	for ( i = 0 ; i < ARRAY_LEN( keys ) ; i++ ) {
+		if ( !Q_stricmp( key, keys[i].key ) ) {
+			return keys[i].flag;
+		}
+	}
+	return USERINFO_OTHER;
+}
+
+/*
+=================
+SV_UserinfoChanges
+
+Which of the keys differ between two userinfo strings, 0 if none do.
+The "ip" the server puts in doesn't count.
+=================
+*/
+static int SV_UserinfoChanges( const infoString_t *from, const infoString_t *to ) {
+	const infoString_t	*a, *b;
+	const char			*key, *value;
+	int					i, pass, changes;
+
+	changes = 0;
+
+	// every key of one that the other doesn't have the same, both ways
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		a = pass ? to : from;
+		b = pass ? from : to;
+
+		for ( i = 0 ; i < a->numPairs ; i++ ) {
+			if ( !Info_GetPair( a, i, &key, &value ) || !Q_stricmp( key, "ip" ) ) {
+				continue;
+			}
+			if ( strcmp( value, Info_Find( b, key ) ) ) {
+				changes |= SV_UserinfoKeyFlag( key );
+			}
+		}
+	}
+
+	return changes;
+}
+
+/*
+=================
+SV_ApplyUserinfo
 
 Pull specific info from a newly changed userinfo string
-into a more C friendly form.
+into a more C friendly form, only for the keys in changes.
 =================
 */
-void SV_UserinfoChanged( client_t *cl ) {
-	char	*val;
+static void SV_ApplyUserinfo( client_t *cl, const infoString_t *info, int changes ) {
+	const char	*val;
 	char	*ip;
 	int		i;
 	int	len;
 	const int maxRate = 100000;
 
 	// name for C code
-	Q_strncpyz( cl->name, Info_ValueForKey (cl->userinfo, "name"), sizeof(cl->name) );
+	if ( changes & USERINFO_NAME ) {
+		Q_strncpyz( cl->name, Info_Find( info, "name" ), sizeof(cl->name) );
+	}
 
 	// rate command
+	if ( changes & USERINFO_RATE ) {
+		// if the client is on the same subnet as the server and we aren't running an
+		// internet public server, assume they don't need a rate choke
+		if ( Sys_IsLANAddress( cl->netchan.remoteAddress ) && com_dedicated->integer != 2 && sv_lanForceRate->integer == 1) {
+			cl->rate = maxRate;	// lans should not rate limit
+		} else {
+			val = Info_Find( info, "rate" );
+			if (strlen(val)) {
+				i = atoi(val);
+				cl->rate = i;
+				if (cl->rate < 1000) {
+					cl->rate = 1000;
+				} else if (cl->rate > maxRate) {
+					cl->rate = maxRate;
+				}
+			} else {
+				cl->rate = 5000; // was 3000
+			}
+		}
+	}
 
-	// if the client is on the same subnet as the server and we aren't running an
-	// internet public server, assume they don't need a rate choke
-	if ( Sys_IsLANAddress( cl->netchan.remoteAddress ) && com_dedicated->integer != 2 && sv_lanForceRate->integer == 1) {
-		cl->rate = maxRate;	// lans should not rate limit
-	} else {
-		val = Info_ValueForKey (cl->userinfo, "rate");
+	if ( changes & USERINFO_HANDICAP ) {
+		val = Info_Find( info, "handicap" );
 		if (strlen(val)) {
 			i = atoi(val);
-			cl->rate = i;
-			if (cl->rate < 1000) {
-				cl->rate = 1000;
-			} else if (cl->rate > maxRate) {
-				cl->rate = maxRate;
+			if (i<=0 || i>100 || strlen(val) > 4) {
+				Info_SetValueForKey( cl->userinfo, "handicap", "100" );
 			}
-		} else {
-			cl->rate = 5000; // was 3000
-		}
-	}
-	val = Info_ValueForKey (cl->userinfo, "handicap");
-	if (strlen(val)) {
-		i = atoi(val);
-		if (i<=0 || i>100 || strlen(val) > 4) {
-			Info_SetValueForKey( cl->userinfo, "handicap", "100" );
 		}
 	}
 
 	// snaps command
-	val = Info_ValueForKey( cl->userinfo, "snaps" );
-	if ( val[0] )
-		i = atoi( val );
-	else
-		i = sv_fps->integer; // was 20, hardcoded
+	if ( changes & USERINFO_SNAPS ) {
+		val = Info_Find( info, "snaps" );
+		if ( val[0] )
+			i = atoi( val );
+		else
+			i = sv_fps->integer; // was 20, hardcoded
 
-	// range check
-	if ( i < 1 )
-		i = 1;
-	else if ( i > sv_fps->integer )
-		i = sv_fps->integer;
+		// range check
+		if ( i < 1 )
+			i = 1;
+		else if ( i > sv_fps->integer )
+			i = sv_fps->integer;
 
-	i = 1000 / i; // from FPS to milliseconds
-	
-	if ( i != cl->snapshotMsec )
-	{
-		// Reset last sent snapshot so we avoid desync between server frame time and snapshot send time
-		cl->lastSnapshotTime = 0;
-		cl->snapshotMsec = i;		
+		i = 1000 / i; // from FPS to milliseconds
+
+		if ( i != cl->snapshotMsec )
+		{
+			// Reset last sent snapshot so we avoid desync between server frame time and snapshot send time
+			cl->lastSnapshotTime = 0;
+			cl->snapshotMsec = i;
+			cl->snapshotAdaptMsec = 0;
+		}
 	}
 	
 #ifdef USE_VOIP
@@ -1111,12 +1374,26 @@ void SV_UserinfoChanged( client_t *cl ) {
 		cl->hasVoip = qfalse;
 	else
 #endif
+	if ( changes & USERINFO_VOIP )
 	{
-		val = Info_ValueForKey(cl->userinfo, "cl_voipProtocol");
+		val = Info_Find( info, "cl_voipProtocol" );
 		cl->hasVoip = !Q_stricmp( val, "opus" );
 	}
 #endif
 
+	if ( changes & USERINFO_CSDELTA ) {
+		val = Info_Find( info, "cl_csDelta" );
+		cl->csDelta = ( atoi( val ) >= 1 );
+	}
+
+	// the largest datagram that made it to the client and back, the
+	// netchan keeps to MAX_PACKETLEN without it
+	if ( changes & USERINFO_PMTU ) {
+		val = Info_Find( info, "cl_pmtu" );
+		i = MIN( atoi( val ), SV_MaxPacketLength( cl->netchan.remoteAddress ) );
+		Netchan_SetPacketLength( &cl->netchan, i );
+	}
+
 	// TTimo
 	// maintain the IP information
 	// the banning code relies on this being consistently present
@@ -1137,27 +1414,115 @@ void SV_UserinfoChanged( client_t *cl ) {
 		Info_SetValueForKey( cl->userinfo, "ip", ip );
 }
 
+/*
+=================
+SV_UserinfoChanged
+
+Everything from a client's userinfo, for a new client
+=================
+*/
+void SV_UserinfoChanged( client_t *cl ) {
+	infoString_t	info;
+
+	Info_Parse( &info, cl->userinfo, MAX_INFO_STRING );
+	SV_ApplyUserinfo( cl, &info, USERINFO_ALL );
+}
+
+/*
+==================
+SV_SetClientUserinfo
+
+A userinfo the client sent. If nothing but the ip differs from what the
+client already has, the game isn't told.
+==================
+*/
+static void SV_SetClientUserinfo( client_t *cl, const char *info ) {
+	char			userinfo[MAX_INFO_STRING];
+	infoString_t	from, to;
+	int				changes;
+
+	// info may be the userinfobuffer
+	Q_strncpyz( userinfo, info, sizeof(userinfo) );
+	cl->userinfobuffer[0] = 0;
+
+	Info_Parse( &from, cl->userinfo, MAX_INFO_STRING );
+	Info_Parse( &to, userinfo, MAX_INFO_STRING );
+	changes = SV_UserinfoChanges( &from, &to );
+	if ( !changes ) {
+		return;
+	}
+
+	cl->nextReliableUserTime = svs.time + 5000;
+
+	Q_strncpyz( cl->userinfo, userinfo, sizeof(cl->userinfo) );
+
+	SV_ApplyUserinfo( cl, &to, changes );
+	// call prog code to allow overrides
+	VM_Call( gvm, GAME_CLIENT_USERINFO_CHANGED, cl - svs.clients );
+}
 
 /*
 ==================
 SV_UpdateUserinfo_f
+
+Past sv_floodProtect a change is held back, the latest one replacing the
+one before, and the client queued for SV_CheckClientUserinfoTimer
 ==================
 */
 void SV_UpdateUserinfo_f( client_t *cl ) {
 	if ( (sv_floodProtect->integer) && (cl->state >= CS_ACTIVE) && (svs.time < cl->nextReliableUserTime) ) {
 		Q_strncpyz( cl->userinfobuffer, Cmd_Argv(1), sizeof(cl->userinfobuffer) );
-		SV_SendServerCommand(cl, "print \"^7Command ^1delayed^7 due to sv_floodprotect.\"");
+
+		// told once, not for every change a spammer sends in the meantime
+		if ( !cl->userinfoQueued && svs.numUserinfoPending < MAX_CLIENTS ) {
+			cl->userinfoQueued = qtrue;
+			svs.userinfoPending[svs.numUserinfoPending++] = cl - svs.clients;
+			SV_SendServerCommand(cl, "print \"^7Command ^1delayed^7 due to sv_floodprotect.\"");
+		}
 		return;
 	}
 
-	cl->userinfobuffer[0] = 0;
-	cl->nextReliableUserTime = svs.time + 5000;
+	SV_SetClientUserinfo( cl, Cmd_Argv(1) );
+}
 
-	Q_strncpyz( cl->userinfo, Cmd_Argv(1), sizeof(cl->userinfo) );
+/*
+==================
+SV_CheckClientUserinfoTimer
 
-	SV_UserinfoChanged( cl );
-	// call prog code to allow overrides
-	VM_Call( gvm, GAME_CLIENT_USERINFO_CHANGED, cl - svs.clients );
+Applies the held back userinfo of the queued clients whose time has come
+==================
+*/
+void SV_CheckClientUserinfoTimer( void ) {
+	client_t	*cl;
+	int			i, n;
+
+	for ( i = 0 ; i < svs.numUserinfoPending ; ) {
+		n = svs.userinfoPending[i];
+		cl = &svs.clients[n];
+
+		// gone, or the slot was taken by a new client since
+		if ( n >= sv_maxclients->integer || !cl->userinfoQueued || cl->state < CS_ACTIVE || !sv_floodProtect->integer ) {
+			if ( n < sv_maxclients->integer && cl->userinfoQueued ) {
+				cl->userinfoQueued = qfalse;
+				if ( cl->state >= CS_ACTIVE && cl->userinfobuffer[0] ) {
+					SV_SetClientUserinfo( cl, cl->userinfobuffer );
+				}
+			}
+			svs.userinfoPending[i] = svs.userinfoPending[--svs.numUserinfoPending];
+			continue;
+		}
+
+		if ( svs.time < cl->nextReliableUserTime ) {
+			i++;
+			continue;
+		}
+
+		cl->userinfoQueued = qfalse;
+		svs.userinfoPending[i] = svs.userinfoPending[--svs.numUserinfoPending];
+		if ( cl->userinfobuffer[0] ) {
+			SV_SetClientUserinfo( cl, cl->userinfobuffer );
+		}
+	}
 }
 
 
@@ -1396,6 +1761,8 @@ void SV_ClientThink (client_t *cl, usercmd_t *cmd) {
 		return;		// may have been kicked during the last usercmd
 	}
 
+	SVD_WorldUsercmd( cl, cmd );
+
 #ifdef USE_SKEETMOD
 	SV_SkeetBackupPowerups(cl);
 #endif
@@ -1426,6 +1793,7 @@ static void SV_UserMove( client_t *cl, msg_t *msg, qboolean delta ) {
 	usercmd_t	nullcmd;
 	usercmd_t	cmds[MAX_PACKET_USERCMDS];
 	usercmd_t	*cmd, *oldcmd;
+	clientSnapshot_t	*frame;
 
 	if ( delta ) {
 		cl->deltaMessage = cl->messageAcknowledge;
@@ -1461,8 +1829,11 @@ static void SV_UserMove( client_t *cl, msg_t *msg, qboolean delta ) {
 	}
 
 	// save time for ping calculation, only in the first acknowledge
-	if ( cl->frames[ cl->messageAcknowledge & PACKET_MASK ].messageAcked == 0 )
-		cl->frames[ cl->messageAcknowledge & PACKET_MASK ].messageAcked = Sys_Milliseconds();
+	frame = &cl->frames[ cl->messageAcknowledge & PACKET_MASK ];
+	if ( frame->messageAcked == 0 ) {
+		frame->messageAcked = NET_PacketTime();
+		SV_NetStatsRtt( cl, frame->messageAcked - frame->messageSent );
+	}
 
 	// TTimo
 	// catch the no-cp-yet situation before SV_ClientEnterWorld
@@ -1539,6 +1910,19 @@ static qboolean SV_ShouldIgnoreVoipSender(const client_t *cl)
 	return qfalse;  // don't ignore.
 }
 
+/*
+==================
+SV_ReleaseVoipPacket
+
+Drops one queue's reference, the last one frees the packet
+==================
+*/
+void SV_ReleaseVoipPacket(voipServerPacket_t *packet)
+{
+	if (--packet->refCount <= 0)
+		Z_Free(packet);
+}
+
 static
 void SV_UserVoip(client_t *cl, msg_t *msg, qboolean ignoreData)
 {
@@ -1548,6 +1932,7 @@ void SV_UserVoip(client_t *cl, msg_t *msg, qboolean ignoreData)
 	byte encoded[sizeof(cl->voipPacket[0]->data)];
 	client_t *client = NULL;
 	voipServerPacket_t *packet = NULL;
+	voipServerPacket_t *shared[2] = { NULL, NULL };
 	int i;
 
 	sender = cl - svs.clients;
@@ -1610,14 +1995,22 @@ void SV_UserVoip(client_t *cl, msg_t *msg, qboolean ignoreData)
 			continue;  // no room for another packet right now.
 		}
 
-		packet = Z_Malloc(sizeof(*packet));
-		packet->sender = sender;
-		packet->frames = frames;
-		packet->len = packetsize;
-		packet->generation = generation;
-		packet->sequence = sequence;
-		packet->flags = flags;
-		memcpy(packet->data, encoded, packetsize);
+		// only VOIP_DIRECT differs between recipients, so there is
+		// one copy for each of the two and the queues share them
+		if (!shared[!!(flags & VOIP_DIRECT)]) {
+			packet = Z_Malloc(sizeof(*packet));
+			packet->refCount = 0;
+			packet->sender = sender;
+			packet->frames = frames;
+			packet->len = packetsize;
+			packet->generation = generation;
+			packet->sequence = sequence;
+			packet->flags = flags;
+			memcpy(packet->data, encoded, packetsize);
+			shared[!!(flags & VOIP_DIRECT)] = packet;
+		}
+		packet = shared[!!(flags & VOIP_DIRECT)];
+		packet->refCount++;
 
 		client->voipPacket[(client->queuedVoipIndex + client->queuedVoipPackets) % ARRAY_LEN(client->voipPacket)] = packet;
 		client->queuedVoipPackets++;
@@ -1685,6 +2078,10 @@ void SV_ExecuteClientMessage( client_t *cl, msg_t *msg ) {
 		// if we can tell that the client has dropped the last
 		// gamestate we sent them, resend it
 		if ( cl->state != CS_ACTIVE && cl->messageAcknowledge > cl->gamestateMessageNum ) {
+			if ( !SV_GameStateSlotFree( cl ) ) {
+				Com_DPrintf( "%s : gamestate deferred, sv_gamestateLimit reached\n", cl->name );
+				return;
+			}
 			Com_DPrintf( "%s : dropped gamestate, resending\n", cl->name );
 			SV_SendClientGameState( cl );
 		}
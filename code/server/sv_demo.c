@@ -0,0 +1,797 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_demo.c -- writes server side demos from a thread, and records world demos
+
+#include "server.h"
+
+/*
+Every recorded client gets a pair of buffers. Demo data is appended to
+the pending one on the main thread, and once a frame the writer thread
+swaps out everything pending and writes it, so recording never waits on
+the disk. If a buffer fills before the writer gets to it, or there is
+no writer thread, the main thread writes it out itself.
+*/
+
+typedef struct {
+	FILE			*file;
+	byte			*pending;
+	byte			*writing;
+	int				pendingLength;
+	int				bufferSize;
+	qboolean		failed;			// set by the writer, reported by SVD_WriterFrame
+
+	int				offset;			// bytes written so far, main thread only
+	demoKeyframe_t	*index;			// keyframes for the seek index, see DEMO_KEYFRAME
+	int				keyframes;
+} svDemoWriter_t;
+
+#define	SVD_WORLD_WRITER	MAX_CLIENTS
+
+static svDemoWriter_t	svDemoWriters[MAX_CLIENTS + 1];	// one per client, and the world demo
+
+static sysMutex_t		*svDemoLock;			// pending buffers
+static sysMutex_t		*svDemoIOLock;			// files and writing buffers
+static sysSemaphore_t	*svDemoWake;
+static sysThread_t		*svDemoThread;
+static qboolean			svDemoQuit;
+static qboolean			svDemoStarted;
+
+/*
+==================
+SVD_DrainWriter
+
+Writes out what is pending for one client, on either thread.
+==================
+*/
+static void SVD_DrainWriter( svDemoWriter_t *writer ) {
+	byte	*swap;
+	int		length;
+
+	if ( svDemoIOLock ) {
+		Sys_LockMutex( svDemoIOLock );
+		Sys_LockMutex( svDemoLock );
+	}
+
+	swap = writer->writing;
+	writer->writing = writer->pending;
+	writer->pending = swap;
+	length = writer->pendingLength;
+	writer->pendingLength = 0;
+
+	if ( svDemoIOLock ) {
+		Sys_UnlockMutex( svDemoLock );
+	}
+
+	if ( length && writer->file ) {
+		if ( fwrite( writer->writing, 1, length, writer->file ) != length ) {
+			writer->failed = qtrue;
+		}
+	}
+
+	if ( svDemoIOLock ) {
+		Sys_UnlockMutex( svDemoIOLock );
+	}
+}
+
+/*
+==================
+SVD_WriterThread
+==================
+*/
+static void SVD_WriterThread( void *arg ) {
+	int		i;
+
+	while ( 1 ) {
+		Sys_WaitSemaphore( svDemoWake );
+
+		if ( svDemoQuit ) {
+			break;
+		}
+
+		for ( i = 0 ; i < ARRAY_LEN( svDemoWriters ) ; i++ ) {
+			if ( svDemoWriters[i].pendingLength ) {
+				SVD_DrainWriter( &svDemoWriters[i] );
+			}
+		}
+	}
+}
+
+/*
+==================
+SVD_StartWriterThread
+
+Demos are written from SVD_WriterFrame if anything fails.
+==================
+*/
+static void SVD_StartWriterThread( void ) {
+	svDemoStarted = qtrue;
+
+	svDemoLock = Sys_CreateMutex();
+	svDemoIOLock = Sys_CreateMutex();
+	svDemoWake = Sys_CreateSemaphore();
+
+	if ( svDemoLock && svDemoIOLock && svDemoWake ) {
+		svDemoThread = Sys_CreateThread( SVD_WriterThread, NULL );
+		if ( svDemoThread ) {
+			return;
+		}
+	}
+
+	Com_Printf( "WARNING: couldn't start the demo writer thread\n" );
+
+	if ( svDemoWake ) {
+		Sys_DestroySemaphore( svDemoWake );
+	}
+	if ( svDemoIOLock ) {
+		Sys_DestroyMutex( svDemoIOLock );
+	}
+	if ( svDemoLock ) {
+		Sys_DestroyMutex( svDemoLock );
+	}
+	svDemoWake = NULL;
+	svDemoIOLock = NULL;
+	svDemoLock = NULL;
+}
+
+/*
+==================
+SVD_OpenFile
+==================
+*/
+static qboolean SVD_OpenFile( svDemoWriter_t *writer, const char *path ) {
+	int		size;
+
+	if ( !svDemoStarted ) {
+		SVD_StartWriterThread();
+	}
+
+	writer->file = FS_FOpenRawFileWrite( path );
+	if ( !writer->file ) {
+		return qfalse;
+	}
+
+	// room for a few frames of full snapshots
+	size = sv_demoBufferSize->integer * 1024;
+	if ( size < MAX_MSGLEN * 2 ) {
+		size = MAX_MSGLEN * 2;
+	}
+	writer->pending = Z_Malloc( size );
+	writer->writing = Z_Malloc( size );
+	writer->pendingLength = 0;
+	writer->bufferSize = size;
+	writer->failed = qfalse;
+	writer->offset = 0;
+	writer->keyframes = 0;
+
+	return qtrue;
+}
+
+/*
+==================
+SVD_Write
+==================
+*/
+static void SVD_Write( svDemoWriter_t *writer, const void *data, int length ) {
+	if ( !writer->file ) {
+		return;
+	}
+
+	writer->offset += length;
+
+	if ( svDemoLock ) {
+		Sys_LockMutex( svDemoLock );
+	}
+
+	while ( writer->pendingLength + length > writer->bufferSize ) {
+		int		room = writer->bufferSize - writer->pendingLength;
+
+		// the writer fell behind, catch up here
+		Com_Memcpy( writer->pending + writer->pendingLength, data, room );
+		writer->pendingLength += room;
+		data = (const byte *)data + room;
+		length -= room;
+
+		if ( svDemoLock ) {
+			Sys_UnlockMutex( svDemoLock );
+		}
+		SVD_DrainWriter( writer );
+		if ( svDemoLock ) {
+			Sys_LockMutex( svDemoLock );
+		}
+	}
+
+	Com_Memcpy( writer->pending + writer->pendingLength, data, length );
+	writer->pendingLength += length;
+
+	if ( svDemoLock ) {
+		Sys_UnlockMutex( svDemoLock );
+	}
+}
+
+/*
+==================
+SVD_CloseFile
+
+Finishes writing on the main thread and closes the file.
+==================
+*/
+static void SVD_CloseFile( svDemoWriter_t *writer, const char *name ) {
+	if ( !writer->file ) {
+		return;
+	}
+
+	SVD_DrainWriter( writer );
+
+	if ( writer->failed ) {
+		Com_Printf( "WARNING: server demo of %s is incomplete, writing failed\n", name );
+	}
+
+	if ( svDemoIOLock ) {
+		Sys_LockMutex( svDemoIOLock );
+	}
+	fclose( writer->file );
+	writer->file = NULL;
+	Z_Free( writer->pending );
+	Z_Free( writer->writing );
+	writer->pending = NULL;
+	writer->writing = NULL;
+	if ( writer->index ) {
+		Z_Free( writer->index );
+		writer->index = NULL;
+	}
+	writer->keyframes = 0;
+	writer->pendingLength = 0;
+	writer->bufferSize = 0;
+	if ( svDemoIOLock ) {
+		Sys_UnlockMutex( svDemoIOLock );
+	}
+}
+
+/*
+==================
+SVD_OpenWriter
+==================
+*/
+qboolean SVD_OpenWriter( client_t *client, const char *path ) {
+	return SVD_OpenFile( &svDemoWriters[client - svs.clients], path );
+}
+
+/*
+==================
+SVD_WriteData
+==================
+*/
+void SVD_WriteData( const client_t *client, const void *data, int length ) {
+	SVD_Write( &svDemoWriters[client - svs.clients], data, length );
+}
+
+/*
+==================
+SVD_AddKeyframe
+
+Notes a keyframe about to be written, qfalse once the index is full
+==================
+*/
+qboolean SVD_AddKeyframe( const client_t *client, int serverTime ) {
+	svDemoWriter_t	*writer = &svDemoWriters[client - svs.clients];
+
+	if ( !writer->file || writer->keyframes >= MAX_DEMO_KEYFRAMES ) {
+		return qfalse;
+	}
+
+	if ( !writer->index ) {
+		writer->index = Z_Malloc( MAX_DEMO_KEYFRAMES * sizeof( *writer->index ) );
+	}
+
+	writer->index[writer->keyframes].serverTime = serverTime;
+	writer->index[writer->keyframes].offset = writer->offset;
+	writer->keyframes++;
+
+	return qtrue;
+}
+
+/*
+==================
+SVD_WriteIndex
+
+The seek index after the end of the demo
+==================
+*/
+void SVD_WriteIndex( const client_t *client ) {
+	svDemoWriter_t	*writer = &svDemoWriters[client - svs.clients];
+	int				i, v;
+
+	for ( i = 0 ; i < writer->keyframes ; i++ ) {
+		v = LittleLong( writer->index[i].serverTime );
+		SVD_Write( writer, &v, 4 );
+		v = LittleLong( writer->index[i].offset );
+		SVD_Write( writer, &v, 4 );
+	}
+
+	v = LittleLong( writer->keyframes );
+	SVD_Write( writer, &v, 4 );
+	v = LittleLong( DEMO_INDEX_MAGIC );
+	SVD_Write( writer, &v, 4 );
+}
+
+/*
+==================
+SVD_CloseWriter
+==================
+*/
+void SVD_CloseWriter( client_t *client ) {
+	SVD_CloseFile( &svDemoWriters[client - svs.clients], client->name );
+}
+
+/*
+==================
+SVD_WriterFrame
+
+Hands the demo data of this frame to the writer.
+==================
+*/
+void SVD_WriterFrame( void ) {
+	int		i;
+	qboolean	pending = qfalse;
+
+	for ( i = 0 ; i < ARRAY_LEN( svDemoWriters ) ; i++ ) {
+		if ( svDemoWriters[i].file && svDemoWriters[i].pendingLength ) {
+			pending = qtrue;
+
+			if ( !svDemoThread ) {
+				SVD_DrainWriter( &svDemoWriters[i] );
+			}
+		}
+	}
+
+	if ( pending && svDemoThread ) {
+		Sys_PostSemaphore( svDemoWake );
+	}
+}
+
+/*
+==================
+SVD_ShutdownWriter
+
+Demos have been stopped by now, this only takes down the thread.
+==================
+*/
+void SVD_ShutdownWriter( void ) {
+	if ( svDemoThread ) {
+		svDemoQuit = qtrue;
+		Sys_PostSemaphore( svDemoWake );
+		Sys_JoinThread( svDemoThread );
+		svDemoThread = NULL;
+		svDemoQuit = qfalse;
+
+		Sys_DestroySemaphore( svDemoWake );
+		Sys_DestroyMutex( svDemoIOLock );
+		Sys_DestroyMutex( svDemoLock );
+		svDemoWake = NULL;
+		svDemoIOLock = NULL;
+		svDemoLock = NULL;
+	}
+
+	svDemoStarted = qfalse;
+}
+
+/*
+==============================================================================
+
+WORLD DEMOS
+
+A world demo records a whole match once, instead of a demo per client:
+the full entity set every frame, and the playerstate and usercmds of
+every active client. Demos from the point of view of any player can be
+cut from it offline.
+
+The file starts with a plain header
+
+	"WDMO", version, PROTOCOL_VERSION, modversion length and text,
+	sv_maxclients, checksumFeed
+
+followed by records, each a length and a huffman bitstream starting
+with a wd_* type, and ends with a -1 length.
+==============================================================================
+*/
+
+typedef struct {
+	qboolean		recording;
+	char			path[MAX_OSPATH];
+	int				lastTime;
+	int				frames;
+	int				droppedCommands;
+
+	// what the last frame was delta compressed to
+	qboolean		present[MAX_GENTITIES];
+	entityState_t	entities[MAX_GENTITIES];
+	int				svFlags[MAX_GENTITIES];
+	int				singleClient[MAX_GENTITIES];
+	int				numEntities;
+
+	qboolean		active[MAX_CLIENTS];
+	playerState_t	ps[MAX_CLIENTS];
+	usercmd_t		lastCmd[MAX_CLIENTS];
+
+	// usercmds received since the last frame
+	usercmd_t		cmds[MAX_CLIENTS][WORLDDEMO_MAX_USERCMDS];
+	int				numCmds[MAX_CLIENTS];
+} svWorldDemo_t;
+
+static svWorldDemo_t	svWorldDemo;
+static byte				svWorldDemoBuffer[MAX_MSGLEN * 8];
+
+/*
+==================
+SVD_WorldBegin
+==================
+*/
+static void SVD_WorldBegin( msg_t *msg, worldDemoRecord_t type ) {
+	MSG_Init( msg, svWorldDemoBuffer, sizeof( svWorldDemoBuffer ) );
+	MSG_Bitstream( msg );
+	MSG_WriteByte( msg, type );
+}
+
+/*
+==================
+SVD_WorldEnd
+==================
+*/
+static void SVD_WorldEnd( msg_t *msg ) {
+	int		len;
+
+	if ( msg->overflowed ) {
+		Com_Printf( "WARNING: world demo record overflowed, stopping %s\n", svWorldDemo.path );
+		SVD_StopWorldDemo();
+		return;
+	}
+
+	len = LittleLong( msg->cursize );
+	SVD_Write( &svDemoWriters[SVD_WORLD_WRITER], &len, 4 );
+	SVD_Write( &svDemoWriters[SVD_WORLD_WRITER], msg->data, msg->cursize );
+}
+
+/*
+==================
+SVD_WorldGamestate
+==================
+*/
+static void SVD_WorldGamestate( void ) {
+	msg_t			msg;
+	entityState_t	nullstate, *base;
+	int				i;
+
+	SVD_WorldBegin( &msg, wd_gamestate );
+	MSG_WriteLong( &msg, sv.time );
+
+	for ( i = 0 ; i < MAX_CONFIGSTRINGS ; i++ ) {
+		if ( sv.configstrings[i][0] ) {
+			MSG_WriteShort( &msg, i );
+			MSG_WriteBigString( &msg, sv.configstrings[i] );
+		}
+	}
+	MSG_WriteShort( &msg, MAX_CONFIGSTRINGS );
+
+	Com_Memset( &nullstate, 0, sizeof( nullstate ) );
+	for ( i = 0 ; i < MAX_GENTITIES ; i++ ) {
+		base = &sv.svEntities[i].baseline;
+		if ( !base->number ) {
+			continue;
+		}
+		MSG_WriteDeltaEntity( &msg, &nullstate, base, qtrue );
+	}
+	MSG_WriteBits( &msg, MAX_GENTITIES - 1, GENTITYNUM_BITS );
+
+	SVD_WorldEnd( &msg );
+}
+
+/*
+==================
+SVD_StartWorldDemo
+
+A NULL name picks one from the date and the map.
+==================
+*/
+void SVD_StartWorldDemo( const char *name ) {
+	svDemoWriter_t	*writer = &svDemoWriters[SVD_WORLD_WRITER];
+	qtime_t			now;
+	const char		*modversion;
+	int				v;
+
+	if ( svWorldDemo.recording ) {
+		Com_Printf( "Already recording the world demo %s\n", svWorldDemo.path );
+		return;
+	}
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Can't record a world demo while the map is loading\n" );
+		return;
+	}
+
+	Com_Memset( &svWorldDemo, 0, sizeof( svWorldDemo ) );
+
+	if ( name && name[0] ) {
+		Com_sprintf( svWorldDemo.path, sizeof( svWorldDemo.path ), "%s/%s.wdm_%d",
+			sv_demofolder->string, name, PROTOCOL_VERSION );
+	} else {
+		Com_RealTime( &now );
+		Com_sprintf( svWorldDemo.path, sizeof( svWorldDemo.path ), "%s/%.4d-%.2d-%.2d_%.2d-%.2d-%.2d_%s.wdm_%d",
+			sv_demofolder->string, now.tm_year + 1900, now.tm_mon + 1, now.tm_mday,
+			now.tm_hour, now.tm_min, now.tm_sec, sv_mapname->string, PROTOCOL_VERSION );
+	}
+
+	if ( !SVD_OpenFile( writer, svWorldDemo.path ) ) {
+		Com_Printf( "WARNING: couldn't open %s for the world demo\n", svWorldDemo.path );
+		return;
+	}
+
+	SVD_Write( writer, "WDMO", 4 );
+	v = LittleLong( WORLDDEMO_VERSION );
+	SVD_Write( writer, &v, 4 );
+	v = LittleLong( PROTOCOL_VERSION );
+	SVD_Write( writer, &v, 4 );
+	modversion = Cvar_VariableString( "g_modversion" );
+	v = LittleLong( strlen( modversion ) );
+	SVD_Write( writer, &v, 4 );
+	SVD_Write( writer, modversion, strlen( modversion ) );
+	v = LittleLong( sv_maxclients->integer );
+	SVD_Write( writer, &v, 4 );
+	v = LittleLong( sv.checksumFeed );
+	SVD_Write( writer, &v, 4 );
+
+	svWorldDemo.recording = qtrue;
+	svWorldDemo.lastTime = -1;
+	SVD_WorldGamestate();
+
+	Com_Printf( "Recording world demo %s\n", svWorldDemo.path );
+}
+
+/*
+==================
+SVD_StopWorldDemo
+==================
+*/
+void SVD_StopWorldDemo( void ) {
+	int		marker = -1;
+
+	if ( !svWorldDemo.recording ) {
+		return;
+	}
+	svWorldDemo.recording = qfalse;
+
+	SVD_Write( &svDemoWriters[SVD_WORLD_WRITER], &marker, 4 );
+	SVD_CloseFile( &svDemoWriters[SVD_WORLD_WRITER], "the world" );
+
+	Com_Printf( "Stopped world demo %s after %i frames\n", svWorldDemo.path, svWorldDemo.frames );
+	if ( svWorldDemo.droppedCommands ) {
+		Com_Printf( "%i usercmds didn't fit in their frame and were left out\n", svWorldDemo.droppedCommands );
+	}
+}
+
+/*
+==================
+SVD_WorldConfigstring
+==================
+*/
+void SVD_WorldConfigstring( int index, const char *value ) {
+	msg_t	msg;
+
+	if ( !svWorldDemo.recording ) {
+		return;
+	}
+
+	SVD_WorldBegin( &msg, wd_configstring );
+	MSG_WriteShort( &msg, index );
+	MSG_WriteBigString( &msg, value );
+	SVD_WorldEnd( &msg );
+}
+
+/*
+==================
+SVD_WorldCommand
+
+Commands from the game, a clientNum of -1 goes to everyone.
+==================
+*/
+void SVD_WorldCommand( int clientNum, const char *text ) {
+	msg_t	msg;
+
+	if ( !svWorldDemo.recording ) {
+		return;
+	}
+
+	SVD_WorldBegin( &msg, wd_command );
+	MSG_WriteShort( &msg, clientNum );
+	MSG_WriteBigString( &msg, text );
+	SVD_WorldEnd( &msg );
+}
+
+/*
+==================
+SVD_WorldUsercmd
+==================
+*/
+void SVD_WorldUsercmd( const client_t *client, const usercmd_t *cmd ) {
+	int		clientNum = client - svs.clients;
+
+	if ( !svWorldDemo.recording ) {
+		return;
+	}
+
+	if ( svWorldDemo.numCmds[clientNum] >= WORLDDEMO_MAX_USERCMDS ) {
+		svWorldDemo.droppedCommands++;
+		return;
+	}
+
+	svWorldDemo.cmds[clientNum][svWorldDemo.numCmds[clientNum]++] = *cmd;
+}
+
+/*
+==================
+SVD_WorldEntities
+
+Deltas every entity any client could be sent against the last frame,
+like SV_EmitPacketEntities, then the flags that decide who gets them.
+==================
+*/
+static void SVD_WorldEntities( msg_t *msg ) {
+	sharedEntity_t	*ent;
+	entityState_t	state;
+	int				e, numEntities;
+	qboolean		present;
+
+	ent = NULL;
+
+	numEntities = MAX( sv.num_entities, svWorldDemo.numEntities );
+
+	for ( e = 0 ; e < numEntities ; e++ ) {
+		present = qfalse;
+		if ( e < sv.num_entities ) {
+			ent = SV_GentityNum( e );
+			present = ent->r.linked && !( ent->r.svFlags & SVF_NOCLIENT );
+		}
+
+		if ( present ) {
+			state = ent->s;
+			state.number = e;
+			if ( svWorldDemo.present[e] ) {
+				MSG_WriteDeltaEntity( msg, &svWorldDemo.entities[e], &state, qfalse );
+			} else {
+				MSG_WriteDeltaEntity( msg, &sv.svEntities[e].baseline, &state, qtrue );
+			}
+			svWorldDemo.entities[e] = state;
+		} else if ( svWorldDemo.present[e] ) {
+			MSG_WriteDeltaEntity( msg, &svWorldDemo.entities[e], NULL, qtrue );
+		}
+		svWorldDemo.present[e] = present;
+	}
+	MSG_WriteBits( msg, MAX_GENTITIES - 1, GENTITYNUM_BITS );
+	svWorldDemo.numEntities = sv.num_entities;
+
+	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		if ( !svWorldDemo.present[e] ) {
+			continue;
+		}
+		ent = SV_GentityNum( e );
+		if ( ent->r.svFlags == svWorldDemo.svFlags[e] && ent->r.singleClient == svWorldDemo.singleClient[e] ) {
+			continue;
+		}
+		MSG_WriteBits( msg, e, GENTITYNUM_BITS );
+		MSG_WriteLong( msg, ent->r.svFlags );
+		MSG_WriteLong( msg, ent->r.singleClient );
+		svWorldDemo.svFlags[e] = ent->r.svFlags;
+		svWorldDemo.singleClient[e] = ent->r.singleClient;
+	}
+	MSG_WriteBits( msg, MAX_GENTITIES - 1, GENTITYNUM_BITS );
+}
+
+/*
+==================
+SVD_WorldClients
+
+The playerstate of every active client against its last one, and the
+usercmds that came in since. A client missing from a frame is gone.
+==================
+*/
+static void SVD_WorldClients( msg_t *msg ) {
+	client_t	*cl;
+	int			i, j;
+
+	for ( i = 0, cl = svs.clients ; i < sv_maxclients->integer ; i++, cl++ ) {
+		if ( cl->state != CS_ACTIVE ) {
+			svWorldDemo.active[i] = qfalse;
+			svWorldDemo.numCmds[i] = 0;
+			continue;
+		}
+
+		MSG_WriteByte( msg, i );
+		MSG_WriteDeltaPlayerstate( msg, svWorldDemo.active[i] ? &svWorldDemo.ps[i] : NULL, SV_GameClientNum( i ) );
+		svWorldDemo.ps[i] = *SV_GameClientNum( i );
+
+		if ( !svWorldDemo.active[i] ) {
+			Com_Memset( &svWorldDemo.lastCmd[i], 0, sizeof( svWorldDemo.lastCmd[i] ) );
+			svWorldDemo.active[i] = qtrue;
+		}
+
+		MSG_WriteByte( msg, svWorldDemo.numCmds[i] );
+		for ( j = 0 ; j < svWorldDemo.numCmds[i] ; j++ ) {
+			MSG_WriteDeltaUsercmdKey( msg, 0, &svWorldDemo.lastCmd[i], &svWorldDemo.cmds[i][j] );
+			svWorldDemo.lastCmd[i] = svWorldDemo.cmds[i][j];
+		}
+		svWorldDemo.numCmds[i] = 0;
+	}
+	MSG_WriteByte( msg, 255 );
+}
+
+/*
+==================
+SVD_WorldDemoFrame
+
+Records the world once per game frame.
+==================
+*/
+void SVD_WorldDemoFrame( void ) {
+	msg_t	msg;
+
+	if ( !svWorldDemo.recording || sv.state != SS_GAME || sv.time == svWorldDemo.lastTime ) {
+		return;
+	}
+	svWorldDemo.lastTime = sv.time;
+
+	SVD_WorldBegin( &msg, wd_frame );
+	MSG_WriteLong( &msg, sv.time );
+	SVD_WorldEntities( &msg );
+	SVD_WorldClients( &msg );
+	SVD_WorldEnd( &msg );
+
+	svWorldDemo.frames++;
+}
+
+/*
+==================
+SV_StartWorldDemo_f
+
+startworlddemo [<name>]
+==================
+*/
+void SV_StartWorldDemo_f( void ) {
+	if ( !com_sv_running->integer ) {
+		Com_Printf( "startworlddemo: Server not running\n" );
+		return;
+	}
+
+	SVD_StartWorldDemo( Cmd_Argc() > 1 ? Cmd_Argv( 1 ) : NULL );
+}
+
+/*
+==================
+SV_StopWorldDemo_f
+==================
+*/
+void SV_StopWorldDemo_f( void ) {
+	if ( !svWorldDemo.recording ) {
+		Com_Printf( "stopworlddemo: no world demo is being recorded\n" );
+		return;
+	}
+
+	SVD_StopWorldDemo();
+}
@@ -76,11 +76,13 @@ Sends a command string to a client
 */
 void SV_GameSendServerCommand( int clientNum, const char *text ) {
 	if ( clientNum == -1 ) {
+		SVD_WorldCommand( clientNum, text );
 		SV_SendServerCommand( NULL, "%s", text );
 	} else {
 		if ( clientNum < 0 || clientNum >= sv_maxclients->integer ) {
 			return;
 		}
+		SVD_WorldCommand( clientNum, text );
 #ifdef USE_SKEETMOD
 		SV_SkeetParseGameServerCommand(clientNum, text);
 #endif
@@ -260,7 +262,7 @@ void SV_GetServerinfo( char *buffer, int bufferSize ) {
 	if ( bufferSize < 1 ) {
 		Com_Error( ERR_DROP, "SV_GetServerinfo: bufferSize == %i", bufferSize );
 	}
-	Q_strncpyz( buffer, Cvar_InfoString( CVAR_SERVERINFO ), bufferSize );
+	Q_strncpyz( buffer, SV_InfoString( CVAR_SERVERINFO ), bufferSize );
 }
 
 /*
@@ -293,6 +295,25 @@ void SV_GetUsercmd( int clientNum, usercmd_t *cmd ) {
 	*cmd = svs.clients[clientNum].lastUsercmd;
 }
 
+/*
+===============
+SV_GetEntityToken
+
+Next token of the entity spawn text, qfalse once it is all parsed
+===============
+*/
+static qboolean SV_GetEntityToken( char *buffer, int bufferSize ) {
+	const char	*s;
+
+	s = COM_Parse( &sv.entityParsePoint );
+	Q_strncpyz( buffer, s, bufferSize );
+	if ( !sv.entityParsePoint && !s[0] ) {
+		return qfalse;
+	} else {
+		return qtrue;
+	}
+}
+
 //==============================================
 
 static int	FloatAsInt( float f ) {
@@ -301,6 +322,144 @@ static int	FloatAsInt( float f ) {
 	return fi.i;
 }
 
+/*
+====================
+Direct syscalls
+
+The calls the game makes many times a frame skip the SV_GameSystemCalls
+switch, and only get the arguments they take copied.
+====================
+*/
+static vmSyscall_t	svGameSyscalls[BOTLIB_SETUP];
+
+static intptr_t SV_GameLinkEntity( intptr_t *args ) {
+	SV_LinkEntity( VMA(1) );
+	return 0;
+}
+
+static intptr_t SV_GameUnlinkEntity( intptr_t *args ) {
+	SV_UnlinkEntity( VMA(1) );
+	return 0;
+}
+
+static intptr_t SV_GameAreaEntities( intptr_t *args ) {
+	return SV_AreaEntities( VMA(1), VMA(2), VMA(3), args[4] );
+}
+
+static intptr_t SV_GameEntityContact( intptr_t *args ) {
+	return SV_EntityContact( VMA(1), VMA(2), VMA(3), /*int capsule*/ qfalse );
+}
+
+static intptr_t SV_GameTrace( intptr_t *args ) {
+	SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qfalse );
+	return 0;
+}
+
+static intptr_t SV_GameTraceCapsule( intptr_t *args ) {
+	SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qtrue );
+	return 0;
+}
+
+static intptr_t SV_GameTraceAtTime( intptr_t *args ) {
+	SV_TraceAtTime( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qfalse, args[8] );
+	return 0;
+}
+
+static intptr_t SV_GamePointContents( intptr_t *args ) {
+	return SV_PointContents( VMA(1), args[2] );
+}
+
+static intptr_t SV_GameInPVS( intptr_t *args ) {
+	return SV_inPVS( VMA(1), VMA(2) );
+}
+
+static intptr_t SV_GameGetUsercmd( intptr_t *args ) {
+	SV_GetUsercmd( args[1], VMA(2) );
+	return 0;
+}
+
+static void SV_AddGameSyscall( int num, intptr_t (*func)( intptr_t *args ), int numArgs ) {
+	svGameSyscalls[num].func = func;
+	svGameSyscalls[num].numArgs = numArgs;
+}
+
+static void SV_InitGameSyscalls( void ) {
+	SV_AddGameSyscall( G_LINKENTITY, SV_GameLinkEntity, 1 );
+	SV_AddGameSyscall( G_UNLINKENTITY, SV_GameUnlinkEntity, 1 );
+	SV_AddGameSyscall( G_ENTITIES_IN_BOX, SV_GameAreaEntities, 4 );
+	SV_AddGameSyscall( G_ENTITY_CONTACT, SV_GameEntityContact, 3 );
+	SV_AddGameSyscall( G_TRACE, SV_GameTrace, 7 );
+	SV_AddGameSyscall( G_TRACECAPSULE, SV_GameTraceCapsule, 7 );
+	SV_AddGameSyscall( G_TRACE_AT_TIME, SV_GameTraceAtTime, 8 );
+	SV_AddGameSyscall( G_POINT_CONTENTS, SV_GamePointContents, 2 );
+	SV_AddGameSyscall( G_IN_PVS, SV_GameInPVS, 2 );
+	SV_AddGameSyscall( G_GET_USERCMD, SV_GameGetUsercmd, 2 );
+}
+
+/*
+====================
+Native game API
+
+The G_GET_NATIVE_API table, the engine functions themselves where the
+types line up
+====================
+*/
+static sharedEntity_t	svNativeEntities[MAX_GENTITIES];
+
+static void SV_NativePrint( const char *string ) {
+	Com_Printf( "%s", string );
+}
+
+static void SV_NativeError( const char *string ) {
+	Com_Error( ERR_DROP, "%s", string );
+}
+
+static sharedEntity_t *SV_NativeGetEntities( void ) {
+	return svNativeEntities;
+}
+
+static const gameNativeApi_t svGameNativeApi = {
+	GAME_NATIVE_API_VERSION,
+
+	SV_NativePrint,
+	SV_NativeError,
+	Sys_Milliseconds,
+
+	Cvar_Register,
+	Cvar_Update,
+	Cvar_SetSafe,
+	Cvar_VariableIntegerValue,
+	Cvar_VariableStringBuffer,
+	Cmd_Argc,
+	Cmd_ArgvBuffer,
+	Cbuf_ExecuteText,
+
+	SV_LocateGameData,
+	SV_NativeGetEntities,
+	SV_GameDropClient,
+	SV_GameSendServerCommand,
+	SV_SetConfigstring,
+	SV_GetConfigstring,
+	SV_SetUserinfo,
+	SV_GetUserinfo,
+	SV_GetServerinfo,
+	SV_GetUsercmd,
+	SV_GetEntityToken,
+
+	SV_LinkEntity,
+	SV_UnlinkEntity,
+	SV_SetBrushModel,
+	SV_AreaEntities,
+	SV_EntityContact,
+	SV_Trace,
+	SV_TraceAtTime,
+	SV_PointContents,
+	SV_inPVS,
+	SV_inPVSIgnorePortals,
+	SV_AdjustAreaPortalState,
+	CM_AreasConnected
+};
+
 /*
 ====================
 SV_GameSystemCalls
@@ -374,30 +533,28 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		SV_GameSendServerCommand( args[1], VMA(2) );
 		return 0;
 	case G_LINKENTITY:
-		SV_LinkEntity( VMA(1) );
-		return 0;
+		return SV_GameLinkEntity( args );
 	case G_UNLINKENTITY:
-		SV_UnlinkEntity( VMA(1) );
-		return 0;
+		return SV_GameUnlinkEntity( args );
 	case G_ENTITIES_IN_BOX:
-		return SV_AreaEntities( VMA(1), VMA(2), VMA(3), args[4] );
+		return SV_GameAreaEntities( args );
 	case G_ENTITY_CONTACT:
-		return SV_EntityContact( VMA(1), VMA(2), VMA(3), /*int capsule*/ qfalse );
+		return SV_GameEntityContact( args );
 	case G_ENTITY_CONTACTCAPSULE:
 		return SV_EntityContact( VMA(1), VMA(2), VMA(3), /*int capsule*/ qtrue );
 	case G_TRACE:
-		SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qfalse );
-		return 0;
+		return SV_GameTrace( args );
 	case G_TRACECAPSULE:
-		SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qtrue );
-		return 0;
+		return SV_GameTraceCapsule( args );
+	case G_TRACE_AT_TIME:
+		return SV_GameTraceAtTime( args );
 	case G_POINT_CONTENTS:
-		return SV_PointContents( VMA(1), args[2] );
+		return SV_GamePointContents( args );
 	case G_SET_BRUSH_MODEL:
 		SV_SetBrushModel( VMA(1), VMA(2) );
 		return 0;
 	case G_IN_PVS:
-		return SV_inPVS( VMA(1), VMA(2) );
+		return SV_GameInPVS( args );
 	case G_IN_PVS_IGNORE_PORTALS:
 		return SV_inPVSIgnorePortals( VMA(1), VMA(2) );
 
@@ -429,20 +586,9 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		return 0;
 
 	case G_GET_USERCMD:
-		SV_GetUsercmd( args[1], VMA(2) );
-		return 0;
+		return SV_GameGetUsercmd( args );
 	case G_GET_ENTITY_TOKEN:
-		{
-			const char	*s;
-
-			s = COM_Parse( &sv.entityParsePoint );
-			Q_strncpyz( VMA(1), s, args[2] );
-			if ( !sv.entityParsePoint && !s[0] ) {
-				return qfalse;
-			} else {
-				return qtrue;
-			}
-		}
+		return SV_GetEntityToken( VMA(1), args[2] );
 
 	case G_DEBUG_POLYGON_CREATE:
 		return BotImport_DebugPolygonCreate( args[1], args[2], VMA(3) );
@@ -455,6 +601,13 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		Q_SnapVector(VMA(1));
 		return 0;
 
+	case G_GET_NATIVE_API:
+		// a QVM couldn't use the pointers
+		if ( !VM_IsNative( gvm ) || args[1] < 2 || args[1] > GAME_NATIVE_API_VERSION ) {
+			return 0;
+		}
+		return (intptr_t)&svGameNativeApi;
+
 		//====================================
 
 	case BOTLIB_SETUP:
@@ -483,6 +636,8 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		return botlib_export->BotLibLoadMap( VMA(1) );
 	case BOTLIB_UPDATENTITY:
 		return botlib_export->BotLibUpdateEntity( args[1], VMA(2) );
+	case BOTLIB_UPDATEENTITIES:
+		return botlib_export->BotLibUpdateEntities( args[1], VMA(2), VMA(3) );
 	case BOTLIB_TEST:
 		return botlib_export->Test( args[1], VMA(2), VMA(3), VMA(4) );
 
@@ -553,6 +708,9 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case BOTLIB_AAS_PREDICT_CLIENT_MOVEMENT:
 		return botlib_export->aas.AAS_PredictClientMovement( VMA(1), args[2], VMA(3), args[4], args[5],
 			VMA(6), VMA(7), args[8], args[9], VMF(10), args[11], args[12], args[13] );
+	case BOTLIB_AAS_PREDICT_CLIENT_MOVEMENTS:
+		return botlib_export->aas.AAS_PredictClientMovements( VMA(1), args[2], VMA(3), args[4], args[5],
+			VMA(6), args[7], args[8], VMF(9), args[10], args[11] );
 
 	case BOTLIB_EA_SAY:
 		botlib_export->ea.EA_Say( args[1], VMA(2) );
@@ -828,16 +986,10 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 
 #ifdef USE_AUTH
     case G_NET_STRINGTOADR:
-		return NET_StringToAdr(VMA(1), VMA(2), NA_IP);
+		return SV_AuthStringToAdr(VMA(1), VMA(2));
 
 	case G_NET_SENDPACKET:
-		{
-			netadr_t addr;
-			const char * destination = VMA(4);
-
-			NET_StringToAdr(destination, &addr , NA_IP);
-			NET_SendPacket(args[1], args[2], VMA(3), addr);
-		}
+		SV_AuthSendPacket(args[1], args[2], VMA(3), VMA(4));
 		return 0;
 
 	//case G_SYS_STARTPROCESS:
@@ -999,6 +1151,11 @@ void SV_InitGameProgs( void ) {
 		Com_Error( ERR_FATAL, "VM_Create on game failed" );
 	}
 
+	if ( !svGameSyscalls[G_TRACE].func ) {
+		SV_InitGameSyscalls();
+	}
+	VM_SetSyscalls( gvm, svGameSyscalls, ARRAY_LEN( svGameSyscalls ) );
+
 	SV_InitGameVM( qfalse );
 }
 
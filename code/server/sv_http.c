@@ -0,0 +1,905 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_http.c -- serves the referenced pk3s over HTTP for sv_dlURL
+
+#include "server.h"
+
+/*
+With sv_httpPort set, a thread answers HTTP GET and HEAD requests for
+/gamename/basename.pk3, which is the URL a client builds from sv_dlURL
+and sv_referencedPakNames, so sv_dlURL can be set to http://host:port
+instead of running a separate web server. Only the pk3s referenced by
+the current map are served, the list is swapped in by SV_SpawnServer.
+The port goes in the serverinfo as sv_dlPort, with no sv_dlURL clients
+download from the address they are connected to.
+
+The thread polls all connections itself, non-blocking, so a slow client
+never holds up the others. Single byte ranges are honoured so downloads
+can resume. There is no keep-alive, every response closes the connection.
+Past sv_httpMaxConnections new connections get a 503.
+
+With sv_metrics set, /metrics answers with the text sv_metrics.c last
+handed over and the counters of this server. The body is copied for the
+connection with malloc, the zone is only for the main thread.
+*/
+
+#ifndef _WIN32
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define	MSG_NOSIGNAL		0
+#endif
+
+#define	MAX_HTTP_CONNECTIONS	64
+#define	MAX_HTTP_FILES			64
+#define	HTTP_REQUEST_SIZE		2048
+#define	HTTP_HEADER_SIZE		512
+#define	HTTP_CHUNK				( 64 * 1024 )
+#define	HTTP_TIMEOUT_MSEC		30000		// without any progress
+#define	HTTP_POLL_MSEC			100			// how quickly the thread sees quit
+#define	HTTP_METRICS_EXTRA		1024		// for the counters added to /metrics
+
+typedef struct {
+	char		name[MAX_QPATH];			// gamename/basename.pk3
+	char		ospath[MAX_OSPATH];
+} httpFile_t;
+
+typedef enum {
+	HTTP_REQUEST,
+	HTTP_HEADER,
+	HTTP_BODY
+} httpState_t;
+
+typedef struct {
+	int			sock;
+	httpState_t	state;
+	int			lastActive;					// Sys_Milliseconds
+
+	char		request[HTTP_REQUEST_SIZE];
+	int			requestLength;
+
+	char		header[HTTP_HEADER_SIZE];
+	int			headerLength;
+	int			headerSent;
+
+	int			fd;
+	off_t		offset;
+	off_t		end;						// one past the last byte to send
+
+	char		*body;						// instead of fd, malloced
+	int			bodyLength;
+	int			bodySent;
+} httpConnection_t;
+
+typedef struct {
+	sysThread_t			*thread;
+	int					listenSock;
+	int					port;
+
+	httpConnection_t	connections[MAX_HTTP_CONNECTIONS];
+	int					numConnections;
+	char				*buffer;			// for the copy without sendfile
+
+	// under mutex
+	sysMutex_t			*mutex;
+	qboolean			quit;
+	int					maxConnections;
+	httpFile_t			files[MAX_HTTP_FILES];
+	int					numFiles;
+	char				*metrics;			// from sv_metrics.c, Z_Malloced by the main thread
+	int					metricsLength;
+	int					metricsSize;
+
+	int					active;				// connections
+
+	int					requests;
+	int					refused;
+	int					notFound;
+	int					badRequests;
+	int					timeouts;
+	int					completed;
+	int64_t				bytesSent;
+} svHttp_t;
+
+static svHttp_t	svHttp = { NULL, -1 };
+
+/*
+==================
+SV_HttpClose
+==================
+*/
+static void SV_HttpClose( httpConnection_t *conn ) {
+	if ( conn->fd >= 0 ) {
+		close( conn->fd );
+	}
+	free( conn->body );
+	close( conn->sock );
+
+	*conn = svHttp.connections[--svHttp.numConnections];
+}
+
+/*
+==================
+SV_HttpRespond
+
+Queues the status line and headers, and the body from offset to end
+if fd is open
+==================
+*/
+static void SV_HttpRespond( httpConnection_t *conn, const char *status, const char *extra, off_t length ) {
+	conn->headerLength = Com_sprintf( conn->header, sizeof( conn->header ),
+		"HTTP/1.1 %s\r\n"
+		"Server: " PRODUCT_NAME "\r\n"
+		"Content-Length: %lld\r\n"
+		"%s"
+		"Connection: close\r\n"
+		"\r\n", status, (long long)length, extra );
+	conn->headerSent = 0;
+	conn->state = HTTP_HEADER;
+}
+
+/*
+==================
+SV_HttpFindHeader
+
+Returns the value of the named header line, or NULL
+==================
+*/
+static const char *SV_HttpFindHeader( const char *request, const char *name ) {
+	const char	*line;
+	int			len;
+
+	len = strlen( name );
+	for ( line = strstr( request, "\r\n" ) ; line && line[2] ; line = strstr( line + 2, "\r\n" ) ) {
+		if ( !Q_stricmpn( line + 2, name, len ) && line[2 + len] == ':' ) {
+			line += 3 + len;
+			while ( *line == ' ' || *line == '\t' ) {
+				line++;
+			}
+			return line;
+		}
+	}
+	return NULL;
+}
+
+/*
+==================
+SV_HttpParseRange
+
+Reads a single range, bytes=first-last, bytes=first- or bytes=-suffix.
+Returns -1 if it can't be satisfied, 0 if it is not understood and
+should be ignored, 1 if [first, end) should be sent.
+==================
+*/
+static int SV_HttpParseRange( const char *value, off_t size, off_t *first, off_t *end ) {
+	long long	a, b;
+	char		*p;
+
+	if ( Q_stricmpn( value, "bytes=", 6 ) ) {
+		return 0;
+	}
+	value += 6;
+
+	if ( *value == '-' ) {
+		b = strtoll( value + 1, &p, 10 );
+		if ( p == value + 1 || ( *p && *p != '\r' ) ) {
+			return 0;
+		}
+		if ( b <= 0 ) {
+			return -1;
+		}
+		*first = b < size ? size - b : 0;
+		*end = size;
+		return 1;
+	}
+
+	a = strtoll( value, &p, 10 );
+	if ( p == value || *p != '-' ) {
+		return 0;
+	}
+	value = p + 1;
+	if ( !*value || *value == '\r' ) {
+		b = size - 1;
+	} else {
+		b = strtoll( value, &p, 10 );
+		if ( p == value || ( *p && *p != '\r' ) || b < a ) {
+			return 0;
+		}
+		if ( b >= size ) {
+			b = size - 1;
+		}
+	}
+
+	if ( a >= size ) {
+		return -1;
+	}
+	*first = a;
+	*end = b + 1;
+	return 1;
+}
+
+/*
+==================
+SV_HttpMetrics
+
+The sv_metrics text, then the counters only this thread knows
+==================
+*/
+static void SV_HttpMetrics( httpConnection_t *conn, qboolean head ) {
+	int		size;
+
+	Sys_LockMutex( svHttp.mutex );
+
+	if ( !svHttp.metricsLength ) {
+		svHttp.notFound++;
+		Sys_UnlockMutex( svHttp.mutex );
+		SV_HttpRespond( conn, "404 Not Found", "", 0 );
+		return;
+	}
+
+	size = svHttp.metricsLength + HTTP_METRICS_EXTRA;
+	conn->body = malloc( size );
+	if ( !conn->body ) {
+		Sys_UnlockMutex( svHttp.mutex );
+		SV_HttpRespond( conn, "503 Service Unavailable", "", 0 );
+		return;
+	}
+
+	Com_Memcpy( conn->body, svHttp.metrics, svHttp.metricsLength );
+	conn->bodyLength = svHttp.metricsLength;
+	conn->bodyLength += Com_sprintf( conn->body + conn->bodyLength, size - conn->bodyLength,
+		"# HELP urt_http_connections HTTP connections open\n"
+		"# TYPE urt_http_connections gauge\n"
+		"urt_http_connections %i\n"
+		"# HELP urt_http_requests_total HTTP requests, by how they ended\n"
+		"# TYPE urt_http_requests_total counter\n"
+		"urt_http_requests_total{result=\"completed\"} %i\n"
+		"urt_http_requests_total{result=\"not_found\"} %i\n"
+		"urt_http_requests_total{result=\"bad\"} %i\n"
+		"urt_http_requests_total{result=\"refused\"} %i\n"
+		"urt_http_requests_total{result=\"timeout\"} %i\n"
+		"# HELP urt_http_sent_bytes_total pk3 bytes sent over HTTP\n"
+		"# TYPE urt_http_sent_bytes_total counter\n"
+		"urt_http_sent_bytes_total %lld\n",
+		svHttp.numConnections, svHttp.completed, svHttp.notFound, svHttp.badRequests,
+		svHttp.refused, svHttp.timeouts, (long long)svHttp.bytesSent );
+
+	Sys_UnlockMutex( svHttp.mutex );
+
+	SV_HttpRespond( conn, "200 OK", "Content-Type: text/plain; version=0.0.4\r\n", conn->bodyLength );
+
+	if ( head ) {
+		free( conn->body );
+		conn->body = NULL;
+	}
+}
+
+/*
+==================
+SV_HttpHandleRequest
+
+Called once the whole request header is in
+==================
+*/
+static void SV_HttpHandleRequest( httpConnection_t *conn ) {
+	char		ospath[MAX_OSPATH];
+	char		extra[128];
+	char		*method, *path, *p;
+	const char	*range;
+	struct stat	st;
+	off_t		first, end;
+	qboolean	head;
+	int			i, result;
+
+	Sys_LockMutex( svHttp.mutex );
+	svHttp.requests++;
+	Sys_UnlockMutex( svHttp.mutex );
+
+	// request line
+	method = conn->request;
+	path = strchr( method, ' ' );
+	if ( !path ) {
+		goto badRequest;
+	}
+	*path++ = 0;
+	p = strchr( path, ' ' );
+	if ( !p ) {
+		goto badRequest;
+	}
+	*p = 0;
+	if ( ( p = strchr( path, '?' ) ) != NULL ) {
+		*p = 0;
+	}
+	// keep the rest of the request, starting at the first header line
+	range = SV_HttpFindHeader( path + strlen( path ) + 1, "Range" );
+
+	if ( !strcmp( method, "HEAD" ) ) {
+		head = qtrue;
+	} else if ( !strcmp( method, "GET" ) ) {
+		head = qfalse;
+	} else {
+		SV_HttpRespond( conn, "405 Method Not Allowed", "Allow: GET, HEAD\r\n", 0 );
+		return;
+	}
+
+	if ( *path != '/' ) {
+		goto badRequest;
+	}
+	path++;
+
+	if ( !strcmp( path, "metrics" ) ) {
+		SV_HttpMetrics( conn, head );
+		return;
+	}
+
+	// only the names in the list, from files the server already has open
+	ospath[0] = 0;
+	Sys_LockMutex( svHttp.mutex );
+	for ( i = 0 ; i < svHttp.numFiles ; i++ ) {
+		if ( !Q_stricmp( svHttp.files[i].name, path ) ) {
+			Q_strncpyz( ospath, svHttp.files[i].ospath, sizeof( ospath ) );
+			break;
+		}
+	}
+	if ( !ospath[0] ) {
+		svHttp.notFound++;
+	}
+	Sys_UnlockMutex( svHttp.mutex );
+
+	if ( !ospath[0] || ( conn->fd = open( ospath, O_RDONLY ) ) < 0 ) {
+		SV_HttpRespond( conn, "404 Not Found", "", 0 );
+		return;
+	}
+	if ( fstat( conn->fd, &st ) < 0 ) {
+		close( conn->fd );
+		conn->fd = -1;
+		SV_HttpRespond( conn, "404 Not Found", "", 0 );
+		return;
+	}
+
+	result = range ? SV_HttpParseRange( range, st.st_size, &first, &end ) : 0;
+	if ( result < 0 ) {
+		close( conn->fd );
+		conn->fd = -1;
+		Com_sprintf( extra, sizeof( extra ), "Content-Range: bytes */%lld\r\n", (long long)st.st_size );
+		SV_HttpRespond( conn, "416 Range Not Satisfiable", extra, 0 );
+		return;
+	}
+
+	if ( result > 0 ) {
+		Com_sprintf( extra, sizeof( extra ),
+			"Content-Type: application/octet-stream\r\n"
+			"Content-Range: bytes %lld-%lld/%lld\r\n",
+			(long long)first, (long long)( end - 1 ), (long long)st.st_size );
+		SV_HttpRespond( conn, "206 Partial Content", extra, end - first );
+	} else {
+		first = 0;
+		end = st.st_size;
+		SV_HttpRespond( conn, "200 OK",
+			"Content-Type: application/octet-stream\r\n"
+			"Accept-Ranges: bytes\r\n", end );
+	}
+
+	if ( head ) {
+		close( conn->fd );
+		conn->fd = -1;
+		return;
+	}
+	conn->offset = first;
+	conn->end = end;
+	return;
+
+badRequest:
+	Sys_LockMutex( svHttp.mutex );
+	svHttp.badRequests++;
+	Sys_UnlockMutex( svHttp.mutex );
+	SV_HttpRespond( conn, "400 Bad Request", "", 0 );
+}
+
+/*
+==================
+SV_HttpRead
+
+Returns qfalse if the connection should be closed
+==================
+*/
+static qboolean SV_HttpRead( httpConnection_t *conn ) {
+	int		length;
+
+	length = recv( conn->sock, conn->request + conn->requestLength,
+		sizeof( conn->request ) - 1 - conn->requestLength, 0 );
+	if ( length < 0 ) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+	if ( length == 0 ) {
+		return qfalse;
+	}
+
+	conn->requestLength += length;
+	conn->request[conn->requestLength] = 0;
+
+	if ( strstr( conn->request, "\r\n\r\n" ) ) {
+		SV_HttpHandleRequest( conn );
+	} else if ( conn->requestLength == sizeof( conn->request ) - 1 ) {
+		Sys_LockMutex( svHttp.mutex );
+		svHttp.badRequests++;
+		Sys_UnlockMutex( svHttp.mutex );
+		SV_HttpRespond( conn, "400 Bad Request", "", 0 );
+	}
+	return qtrue;
+}
+
+/*
+==================
+SV_HttpWrite
+
+Returns qfalse if the connection should be closed
+==================
+*/
+static qboolean SV_HttpWrite( httpConnection_t *conn ) {
+	ssize_t		length;
+	size_t		chunk;
+
+	if ( conn->state == HTTP_HEADER ) {
+		length = send( conn->sock, conn->header + conn->headerSent,
+			conn->headerLength - conn->headerSent, MSG_NOSIGNAL );
+		if ( length < 0 ) {
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+		conn->headerSent += length;
+		if ( conn->headerSent < conn->headerLength ) {
+			return qtrue;
+		}
+		if ( conn->fd < 0 && !conn->body ) {
+			return qfalse;
+		}
+		conn->state = HTTP_BODY;
+	}
+
+	if ( conn->body ) {
+		length = send( conn->sock, conn->body + conn->bodySent,
+			conn->bodyLength - conn->bodySent, MSG_NOSIGNAL );
+		if ( length < 0 ) {
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+		conn->bodySent += length;
+		return conn->bodySent < conn->bodyLength;
+	}
+
+	chunk = conn->end - conn->offset;
+	if ( chunk > HTTP_CHUNK ) {
+		chunk = HTTP_CHUNK;
+	}
+
+#ifdef __linux__
+	length = sendfile( conn->sock, conn->fd, &conn->offset, chunk );
+#else
+	length = pread( conn->fd, svHttp.buffer, chunk, conn->offset );
+	if ( length > 0 ) {
+		length = send( conn->sock, svHttp.buffer, length, MSG_NOSIGNAL );
+		if ( length > 0 ) {
+			conn->offset += length;
+		}
+	} else if ( length == 0 ) {
+		// the file got shorter
+		return qfalse;
+	}
+#endif
+	if ( length < 0 ) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+	if ( length == 0 ) {
+		return qfalse;
+	}
+
+	Sys_LockMutex( svHttp.mutex );
+	svHttp.bytesSent += length;
+	if ( conn->offset >= conn->end ) {
+		svHttp.completed++;
+	}
+	Sys_UnlockMutex( svHttp.mutex );
+
+	return conn->offset < conn->end;
+}
+
+/*
+==================
+SV_HttpAccept
+==================
+*/
+static void SV_HttpAccept( void ) {
+	httpConnection_t	*conn;
+	static const char	busy[] = "HTTP/1.1 503 Service Unavailable\r\n"
+		"Content-Length: 0\r\nRetry-After: 5\r\nConnection: close\r\n\r\n";
+	int					sock, maxConnections;
+
+	Sys_LockMutex( svHttp.mutex );
+	maxConnections = svHttp.maxConnections;
+	Sys_UnlockMutex( svHttp.mutex );
+
+	while ( ( sock = accept( svHttp.listenSock, NULL, NULL ) ) >= 0 ) {
+		if ( svHttp.numConnections >= maxConnections || svHttp.numConnections == MAX_HTTP_CONNECTIONS ) {
+			// fits in any socket buffer, no need to wait for it
+			send( sock, busy, sizeof( busy ) - 1, MSG_NOSIGNAL );
+			close( sock );
+			Sys_LockMutex( svHttp.mutex );
+			svHttp.refused++;
+			Sys_UnlockMutex( svHttp.mutex );
+			continue;
+		}
+
+		fcntl( sock, F_SETFL, fcntl( sock, F_GETFL, 0 ) | O_NONBLOCK );
+
+		conn = &svHttp.connections[svHttp.numConnections++];
+		Com_Memset( conn, 0, sizeof( *conn ) );
+		conn->sock = sock;
+		conn->fd = -1;
+		conn->state = HTTP_REQUEST;
+		conn->lastActive = Sys_Milliseconds();
+	}
+}
+
+/*
+==================
+SV_HttpThread
+==================
+*/
+static void SV_HttpThread( void *arg ) {
+	struct pollfd		fds[MAX_HTTP_CONNECTIONS + 1];
+	httpConnection_t	*conn;
+	sigset_t			set;
+	qboolean			keep, quit;
+	int					i, now;
+
+	// a client hanging up mid send must not kill the server
+	sigemptyset( &set );
+	sigaddset( &set, SIGPIPE );
+	pthread_sigmask( SIG_BLOCK, &set, NULL );
+
+	while ( 1 ) {
+		Sys_LockMutex( svHttp.mutex );
+		quit = svHttp.quit;
+		svHttp.active = svHttp.numConnections;
+		Sys_UnlockMutex( svHttp.mutex );
+		if ( quit ) {
+			break;
+		}
+
+		fds[0].fd = svHttp.listenSock;
+		fds[0].events = POLLIN;
+		for ( i = 0, conn = svHttp.connections ; i < svHttp.numConnections ; i++, conn++ ) {
+			fds[i + 1].fd = conn->sock;
+			fds[i + 1].events = conn->state == HTTP_REQUEST ? POLLIN : POLLOUT;
+		}
+
+		if ( poll( fds, svHttp.numConnections + 1, HTTP_POLL_MSEC ) < 0 ) {
+			continue;
+		}
+
+		now = Sys_Milliseconds();
+
+		// backwards, SV_HttpClose moves the last connection into the hole
+		for ( i = svHttp.numConnections - 1 ; i >= 0 ; i-- ) {
+			conn = &svHttp.connections[i];
+			keep = qtrue;
+
+			if ( fds[i + 1].revents & ( POLLERR | POLLNVAL ) ) {
+				keep = qfalse;
+			} else if ( fds[i + 1].revents & ( POLLIN | POLLOUT | POLLHUP ) ) {
+				if ( conn->state == HTTP_REQUEST ) {
+					keep = SV_HttpRead( conn );
+				} else {
+					keep = SV_HttpWrite( conn );
+				}
+				conn->lastActive = now;
+			} else if ( now - conn->lastActive > HTTP_TIMEOUT_MSEC ) {
+				Sys_LockMutex( svHttp.mutex );
+				svHttp.timeouts++;
+				Sys_UnlockMutex( svHttp.mutex );
+				keep = qfalse;
+			}
+
+			if ( !keep ) {
+				SV_HttpClose( conn );
+			}
+		}
+
+		if ( fds[0].revents & POLLIN ) {
+			SV_HttpAccept();
+		}
+	}
+
+	while ( svHttp.numConnections ) {
+		SV_HttpClose( &svHttp.connections[0] );
+	}
+}
+
+/*
+==================
+SV_HttpStop
+==================
+*/
+static void SV_HttpStop( void ) {
+	if ( svHttp.thread ) {
+		Sys_LockMutex( svHttp.mutex );
+		svHttp.quit = qtrue;
+		Sys_UnlockMutex( svHttp.mutex );
+
+		Sys_JoinThread( svHttp.thread );
+		svHttp.thread = NULL;
+		svHttp.quit = qfalse;
+		svHttp.active = 0;
+	}
+	if ( svHttp.listenSock >= 0 ) {
+		close( svHttp.listenSock );
+		svHttp.listenSock = -1;
+	}
+	if ( svHttp.buffer ) {
+		Z_Free( svHttp.buffer );
+		svHttp.buffer = NULL;
+	}
+	if ( svHttp.metrics ) {
+		Z_Free( svHttp.metrics );
+		svHttp.metrics = NULL;
+	}
+	svHttp.metricsLength = 0;
+	svHttp.metricsSize = 0;
+	if ( svHttp.port ) {
+		Cvar_Set( "sv_dlPort", "" );
+	}
+	svHttp.port = 0;
+}
+
+/*
+==================
+SV_HttpStart
+==================
+*/
+static void SV_HttpStart( int port ) {
+	struct sockaddr_in	address;
+	const char			*ip;
+	int					sock, yes;
+
+	Com_Memset( &address, 0, sizeof( address ) );
+	address.sin_family = AF_INET;
+	address.sin_port = htons( port );
+	address.sin_addr.s_addr = INADDR_ANY;
+
+	// same interface as the game port if it's given as an address
+	ip = Cvar_VariableString( "net_ip" );
+	if ( ip[0] && inet_pton( AF_INET, ip, &address.sin_addr ) != 1 ) {
+		address.sin_addr.s_addr = INADDR_ANY;
+	}
+
+	sock = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+	if ( sock < 0 ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: HTTP server: socket: %s\n", strerror( errno ) );
+		return;
+	}
+
+	yes = 1;
+	setsockopt( sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof( yes ) );
+
+	if ( bind( sock, (struct sockaddr *)&address, sizeof( address ) ) < 0 || listen( sock, 16 ) < 0 ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: HTTP server: can't listen on port %i: %s\n", port, strerror( errno ) );
+		close( sock );
+		return;
+	}
+	fcntl( sock, F_SETFL, fcntl( sock, F_GETFL, 0 ) | O_NONBLOCK );
+
+	if ( !svHttp.mutex ) {
+		svHttp.mutex = Sys_CreateMutex();
+	}
+	svHttp.listenSock = sock;
+	svHttp.port = port;
+	svHttp.maxConnections = sv_httpMaxConnections->integer;
+	svHttp.buffer = Z_Malloc( HTTP_CHUNK );
+
+	svHttp.thread = Sys_CreateThread( SV_HttpThread, NULL );
+	if ( !svHttp.thread ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: HTTP server: no thread\n" );
+		SV_HttpStop();
+		return;
+	}
+
+	Cvar_Set( "sv_dlPort", va( "%i", port ) );
+
+	Com_Printf( "HTTP server listening on port %i\n", port );
+}
+
+/*
+==================
+SV_HttpFrame
+
+Starts, stops or moves the server when sv_httpPort changes
+==================
+*/
+void SV_HttpFrame( void ) {
+	if ( svHttp.thread && sv_httpMaxConnections->modified ) {
+		sv_httpMaxConnections->modified = qfalse;
+		Sys_LockMutex( svHttp.mutex );
+		svHttp.maxConnections = sv_httpMaxConnections->integer;
+		Sys_UnlockMutex( svHttp.mutex );
+	}
+
+	if ( !sv_httpPort->modified ) {
+		return;
+	}
+	sv_httpPort->modified = qfalse;
+
+	if ( sv_httpPort->integer == svHttp.port ) {
+		return;
+	}
+
+	SV_HttpStop();
+	if ( sv_httpPort->integer > 0 && sv_httpPort->integer < 65536 ) {
+		SV_HttpStart( sv_httpPort->integer );
+	}
+}
+
+/*
+==================
+SV_HttpSetFiles
+
+Serves the pk3s in sv_referencedPakNames from now on
+==================
+*/
+void SV_HttpSetFiles( void ) {
+	char		names[BIG_INFO_STRING];
+	char		*p;
+	const char	*token, *ospath;
+	int			numFiles;
+
+	if ( !svHttp.mutex ) {
+		svHttp.mutex = Sys_CreateMutex();
+	}
+
+	Sys_LockMutex( svHttp.mutex );
+
+	numFiles = 0;
+	Cvar_VariableStringBuffer( "sv_referencedPakNames", names, sizeof( names ) );
+	p = names;
+	while ( numFiles < MAX_HTTP_FILES ) {
+		token = COM_Parse( &p );
+		if ( !token[0] ) {
+			break;
+		}
+		ospath = FS_PakFilename( token );
+		if ( !ospath ) {
+			continue;
+		}
+		Com_sprintf( svHttp.files[numFiles].name, sizeof( svHttp.files[0].name ), "%s.pk3", token );
+		Q_strncpyz( svHttp.files[numFiles].ospath, ospath, sizeof( svHttp.files[0].ospath ) );
+		numFiles++;
+	}
+	svHttp.numFiles = numFiles;
+
+	Sys_UnlockMutex( svHttp.mutex );
+}
+
+/*
+==================
+SV_HttpSetMetrics
+
+Serves text on /metrics from now on, NULL for a 404
+==================
+*/
+void SV_HttpSetMetrics( const char *text, int length ) {
+	if ( !svHttp.thread ) {
+		return;
+	}
+
+	Sys_LockMutex( svHttp.mutex );
+
+	if ( length > svHttp.metricsSize ) {
+		if ( svHttp.metrics ) {
+			Z_Free( svHttp.metrics );
+		}
+		// room to grow before the next reallocation
+		svHttp.metricsSize = length + length / 2;
+		svHttp.metrics = Z_Malloc( svHttp.metricsSize );
+	}
+	if ( length ) {
+		Com_Memcpy( svHttp.metrics, text, length );
+	}
+	svHttp.metricsLength = length;
+
+	Sys_UnlockMutex( svHttp.mutex );
+}
+
+/*
+==================
+SV_HttpInfo_f
+==================
+*/
+void SV_HttpInfo_f( void ) {
+	int		i;
+
+	if ( !svHttp.thread ) {
+		Com_Printf( "HTTP server not running, set sv_httpPort\n" );
+		return;
+	}
+
+	Sys_LockMutex( svHttp.mutex );
+	Com_Printf( "HTTP server on port %i, %i connections, %i files:\n", svHttp.port, svHttp.active, svHttp.numFiles );
+	for ( i = 0 ; i < svHttp.numFiles ; i++ ) {
+		Com_Printf( "  %s\n", svHttp.files[i].name );
+	}
+	Com_Printf( "%i requests, %i completed, %i not found, %i bad, %i refused, %i timed out\n",
+		svHttp.requests, svHttp.completed, svHttp.notFound, svHttp.badRequests, svHttp.refused, svHttp.timeouts );
+	Com_Printf( "%lld KB sent\n", (long long)( svHttp.bytesSent / 1024 ) );
+	Sys_UnlockMutex( svHttp.mutex );
+}
+
+/*
+==================
+SV_HttpShutdown
+==================
+*/
+void SV_HttpShutdown( void ) {
+	SV_HttpStop();
+
+	// started again by the next SV_HttpFrame
+	if ( sv_httpPort ) {
+		sv_httpPort->modified = qtrue;
+	}
+}
+
+#else
+
+void SV_HttpFrame( void ) {
+	if ( sv_httpPort->modified ) {
+		sv_httpPort->modified = qfalse;
+		if ( sv_httpPort->integer ) {
+			Com_Printf( S_COLOR_YELLOW "WARNING: the HTTP server isn't supported on this platform\n" );
+		}
+	}
+}
+
+void SV_HttpSetFiles( void ) {
+}
+
+void SV_HttpSetMetrics( const char *text, int length ) {
+}
+
+void SV_HttpInfo_f( void ) {
+	Com_Printf( "The HTTP server isn't supported on this platform\n" );
+}
+
+void SV_HttpShutdown( void ) {
+}
+
+#endif
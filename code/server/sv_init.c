@@ -70,6 +70,60 @@ static void SV_SendConfigstring(client_t *client, int index)
 	}
 }
 
+/*
+===============
+SV_ConfigstringDeltaSafe
+
+A client only ends up with the same string as the server when
+it survives quoting and MSG_WriteString unchanged, and deltas
+are only correct against an identical copy.
+===============
+*/
+static qboolean SV_ConfigstringDeltaSafe( const char *s ) {
+	for ( ; *s ; s++ ) {
+		if ( *s == '"' || *s == '%' || *(const byte *)s > 127 ) {
+			return qfalse;
+		}
+	}
+	return qtrue;
+}
+
+/*
+===============
+SV_ConfigstringDelta
+
+Finds the part of a configstring that changed, so it can go out as
+"csd <index> <prefix> <suffix> <middle>": keep prefix chars from the
+front of the old string and suffix chars from its end, and put middle
+in between. Returns qfalse when the full string is as good.
+===============
+*/
+static qboolean SV_ConfigstringDelta( const char *old, const char *val, int *prefix, int *suffix ) {
+	int		oldLen, valLen, pre, suf;
+
+	if ( !SV_ConfigstringDeltaSafe( old ) || !SV_ConfigstringDeltaSafe( val ) ) {
+		return qfalse;
+	}
+
+	oldLen = strlen( old );
+	valLen = strlen( val );
+
+	for ( pre = 0 ; pre < oldLen && pre < valLen && old[pre] == val[pre] ; pre++ ) {
+	}
+	for ( suf = 0 ; suf < oldLen - pre && suf < valLen - pre &&
+		old[oldLen - 1 - suf] == val[valLen - 1 - suf] ; suf++ ) {
+	}
+
+	// the numbers cost about as much as a short string
+	if ( valLen - pre - suf + 16 >= valLen || valLen - pre - suf >= MAX_STRING_CHARS - 48 ) {
+		return qfalse;
+	}
+
+	*prefix = pre;
+	*suffix = suf;
+	return qtrue;
+}
+
 /*
 ===============
 SV_UpdateConfigstrings
@@ -106,6 +160,9 @@ SV_SetConfigstring
 void SV_SetConfigstring (int index, const char *val) {
 	int		i;
 	client_t	*client;
+	char		*old;
+	qboolean	delta;
+	int			prefix, suffix;
 
 	if ( index < 0 || index >= MAX_CONFIGSTRINGS ) {
 		Com_Error (ERR_DROP, "SV_SetConfigstring: bad index %i", index);
@@ -120,13 +177,16 @@ void SV_SetConfigstring (int index, const char *val) {
 		return;
 	}
 
-	// change the string in sv
-	Z_Free( sv.configstrings[index] );
+	// change the string in sv, the old one is the base for deltas
+	old = sv.configstrings[index];
 	sv.configstrings[index] = CopyString( val );
+	SVD_WorldConfigstring( index, val );
+	SV_InvalidateGamestate( index );
 
 	// send it to all the clients if we aren't
 	// spawning a new server
 	if ( sv.state == SS_GAME || sv.restarting ) {
+		delta = sv_csDelta->integer && SV_ConfigstringDelta( old, val, &prefix, &suffix );
 
 		// send the data to all relevant clients
 		for (i = 0, client = svs.clients; i < sv_maxclients->integer ; i++, client++) {
@@ -139,10 +199,20 @@ void SV_SetConfigstring (int index, const char *val) {
 			if ( index == CS_SERVERINFO && client->gentity && (client->gentity->r.svFlags & SVF_NOSERVERINFO) ) {
 				continue;
 			}
+
+			// a client that skipped an update has no base to apply a delta to,
+			// and server side demos should stay playable by any client
+			if ( delta && client->csDelta && !client->demo_recording && index != CS_SERVERINFO ) {
+				SV_SendServerCommand( client, "csd %i %i %i \"%.*s\"\n", index, prefix, suffix,
+					(int)strlen( val ) - prefix - suffix, val + prefix );
+				continue;
+			}
 		
 			SV_SendConfigstring(client, index);
 		}
 	}
+
+	Z_Free( old );
 }
 
 /*
@@ -230,6 +300,8 @@ static void SV_CreateBaseline( void ) {
 		//
 		sv.svEntities[entnum].baseline = svent->s;
 	}
+
+	SV_InvalidateGamestate( -1 );
 }
 
 
@@ -271,10 +343,10 @@ static void SV_Startup( void ) {
 
 	svs.clients = Z_Malloc (sizeof(client_t) * sv_maxclients->integer );
 	if ( com_dedicated->integer ) {
-		svs.numSnapshotEntities = sv_maxclients->integer * PACKET_BACKUP * MAX_SNAPSHOT_ENTITIES;
+		svs.numSnapshotEntities = PACKET_BACKUP * MAX_SNAPSHOT_ENTITIES;
 	} else {
 		// we don't need nearly as many when playing locally
-		svs.numSnapshotEntities = sv_maxclients->integer * 4 * MAX_SNAPSHOT_ENTITIES;
+		svs.numSnapshotEntities = 4 * MAX_SNAPSHOT_ENTITIES;
 	}
 	svs.initialized = qtrue;
 
@@ -330,7 +402,12 @@ void SV_ChangeMaxClients( void ) {
 		}
 	}
 
-	// free old clients arrays
+	// free old clients arrays, and the storage of the slots that go
+	for ( i = 0 ; i < oldMaxClients ; i++ ) {
+		if ( i >= count || svs.clients[i].state < CS_CONNECTED ) {
+			SV_FreeClientStorage( &svs.clients[i] );
+		}
+	}
 	Z_Free( svs.clients );
 
 	// allocate new clients
@@ -349,10 +426,10 @@ void SV_ChangeMaxClients( void ) {
 	
 	// allocate new snapshot entities
 	if ( com_dedicated->integer ) {
-		svs.numSnapshotEntities = sv_maxclients->integer * PACKET_BACKUP * MAX_SNAPSHOT_ENTITIES;
+		svs.numSnapshotEntities = PACKET_BACKUP * MAX_SNAPSHOT_ENTITIES;
 	} else {
 		// we don't need nearly as many when playing locally
-		svs.numSnapshotEntities = sv_maxclients->integer * 4 * MAX_SNAPSHOT_ENTITIES;
+		svs.numSnapshotEntities = 4 * MAX_SNAPSHOT_ENTITIES;
 	}
 }
 
@@ -370,6 +447,8 @@ static void SV_ClearServer(void) {
 		}
 	}
 	Com_Memset (&sv, 0, sizeof(sv));
+	SV_ClearEntityHistory();
+	SV_InvalidateGamestate( -1 );
 }
 
 /*
@@ -586,10 +665,19 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	qboolean	isBot;
 	char		systemInfo[16384];
 	const char	*p;
+	memClass_t	oldClass;
+
+	// a world demo ends with its map
+	SVD_StopWorldDemo();
+
+	SV_PrefetchMapChange( server );
 
 	// shut down the existing game if it is running
 	SV_ShutdownGameProgs();
 
+	// the game has let go of g_log, so it can be rotated now
+	SV_LogCheckRotate();
+
 	Com_Printf ("------ Server Initialization ------\n");
 	Com_Printf ("Server: %s\n",server);
 
@@ -622,12 +710,15 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 		}
 	}
 
+	// a pending svcapture starts here, a replay takes the time it had
+	SV_CaptureSpawn( server );
+	svs.time = SV_CaptureValue( SVCAP_TIME, svs.time );
+
 	// clear pak references
 	FS_ClearPakReferences(0);
 
 	// allocate the snapshot entities on the hunk
-	svs.snapshotEntities = Hunk_Alloc( sizeof(entityState_t)*svs.numSnapshotEntities, h_high );
-	svs.nextSnapshotEntities = 0;
+	svs.snapshotEntities = Hunk_Alloc( sizeof(entityState_t)*svs.numSnapshotEntities*sv_maxclients->integer, h_high );
 
 	// toggle the server bit so clients can detect that a
 	// server has changed
@@ -655,11 +746,13 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	Cvar_Set("cl_paused", "0");
 
 	// get a new checksum feed and restart the file system
-	sv.checksumFeed = ( ((unsigned int)rand() << 16) ^ (unsigned int)rand() ) ^ Com_Milliseconds();
+	sv.checksumFeed = SV_CaptureValue( SVCAP_CHECKSUMFEED, ( ((unsigned int)rand() << 16) ^ (unsigned int)rand() ) ^ Com_Milliseconds() );
 	FS_SetMapName(server);
 	FS_Restart( sv.checksumFeed );
 
+	oldClass = Com_SetMemClass( MEMCLASS_CM );
 	CM_LoadMap( va("maps/%s.bsp", server), qfalse, &checksum );
+	Com_SetMemClass( oldClass );
 
 	// set serverinfo visible name
 	Cvar_Set( "mapname", server );
@@ -667,13 +760,16 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	Cvar_Set( "sv_mapChecksum", va("%i",checksum) );
 
 	// serverid should be different each time
-	sv.serverId = com_frameTime;
+	sv.serverId = SV_CaptureValue( SVCAP_SERVERID, com_frameTime );
 	sv.restartedServerId = sv.serverId; // I suppose the init here is just to be safe
 	sv.checksumFeedServerId = sv.serverId;
 	Cvar_Set( "sv_serverid", va("%i", sv.serverId ) );
 
 	// clear physics interaction links
 	SV_ClearWorld ();
+
+	// per map timings
+	SV_ProfileReset();
 	
 	// media configstring setting should be done during
 	// the loading stage, so connected clients don't have
@@ -755,6 +851,10 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	sv.time += 100;
 	svs.time += 100;
 
+	// every map gets sv_idleTime to be joined before going idle
+	svs.idle = qfalse;
+	svs.lastPlayerTime = Sys_Milliseconds();
+
 	if ( sv_pure->integer ) {
 		// we need to touch the cgame and ui qvm because they could be in
 		// separate pk3 files and the client will need to download the pk3
@@ -796,9 +896,11 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	Cvar_Set( "sv_referencedPaks", p );
 	p = FS_ReferencedPakNames();
 	Cvar_Set( "sv_referencedPakNames", p );
+	SV_HttpSetFiles();
 
 	// save systeminfo and serverinfo strings
-	Q_strncpyz( systemInfo, Cvar_InfoString_Big( CVAR_SYSTEMINFO ), sizeof( systemInfo ) );
+	SV_RebuildInfoStrings();
+	Q_strncpyz( systemInfo, SV_InfoString( CVAR_SYSTEMINFO ), sizeof( systemInfo ) );
 
 	{
 		const char *t,*tt;
@@ -822,11 +924,8 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 		}
 	}
 
-	cvar_modifiedFlags &= ~CVAR_SYSTEMINFO;
 	SV_SetConfigstring( CS_SYSTEMINFO, systemInfo );
-
-	SV_SetConfigstring( CS_SERVERINFO, Cvar_InfoString( CVAR_SERVERINFO ) );
-	cvar_modifiedFlags &= ~CVAR_SERVERINFO;
+	SV_SetConfigstring( CS_SERVERINFO, SV_InfoString( CVAR_SERVERINFO ) );
 
 	// any media configstring setting now should issue a warning
 	// and any configstring changes should be reliably transmitted
@@ -837,6 +936,10 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	SV_SkeetInit();
 #endif
 
+	if ( sv_autoRecordDemo->integer == 2 ) {
+		SVD_StartWorldDemo( NULL );
+	}
+
 	// send a heartbeat now so the master will get up to date info
 	SV_Heartbeat_f();
 
@@ -866,6 +969,10 @@ void SV_Init (void)
 
 	SV_AddOperatorCommands ();
 
+	// keep the infostrings current from here on
+	Cvar_SubscribeFlags( CVAR_SERVERINFO | CVAR_SYSTEMINFO, SV_InfoCvarChanged );
+	SV_RebuildInfoStrings();
+
 	// serverinfo vars
 	Cvar_Get ("dmflags", "0", CVAR_ARCHIVE);
 	Cvar_Get ("fraglimit", "20", CVAR_SERVERINFO);
@@ -902,12 +1009,19 @@ void SV_Init (void)
 	sv_rconPassword = Cvar_Get ("rconPassword", "", CVAR_TEMP );
 	sv_privatePassword = Cvar_Get ("sv_privatePassword", "", CVAR_TEMP );
 	sv_fps = Cvar_Get ("sv_fps", "20", CVAR_TEMP );
+	sv_idleTime = Cvar_Get( "sv_idleTime", "0", CVAR_ARCHIVE );
+	sv_idleFps = Cvar_Get( "sv_idleFps", "1", CVAR_ARCHIVE );
+	Cvar_CheckRange( sv_idleFps, 1, 1000, qtrue );
+	sv_idlePause = Cvar_Get( "sv_idlePause", "0", CVAR_ARCHIVE );
 	sv_timeout = Cvar_Get ("sv_timeout", "200", CVAR_TEMP );
 	sv_zombietime = Cvar_Get ("sv_zombietime", "2", CVAR_TEMP );
 	Cvar_Get ("nextmap", "", CVAR_TEMP );
 	Cvar_Get ("sv_cheatMode", "0", CVAR_TEMP );
 
 	Cvar_Get ("sv_dlURL", "", CVAR_SERVERINFO | CVAR_ARCHIVE);
+	// the port of the HTTP server in sv_http.c while it runs, for clients
+	// to download from when sv_dlURL isn't set
+	Cvar_Get ("sv_dlPort", "", CVAR_SERVERINFO | CVAR_ROM);
 	
 	sv_master[0] = Cvar_Get("sv_master1", MASTER_SERVER_NAME, 0);
 	sv_master[1] = Cvar_Get("sv_master2", "master.ioquake3.org", 0);
@@ -921,6 +1035,33 @@ void SV_Init (void)
 	sv_mapChecksum = Cvar_Get ("sv_mapChecksum", "", CVAR_ROM);
 	sv_lanForceRate = Cvar_Get ("sv_lanForceRate", "1", CVAR_ARCHIVE );
 	sv_banFile = Cvar_Get("sv_banFile", "serverbans.dat", CVAR_ARCHIVE);
+	sv_deltaCache = Cvar_Get("sv_deltaCache", "1", CVAR_ARCHIVE);
+	sv_snapshotBudget = Cvar_Get("sv_snapshotBudget", "0", CVAR_ARCHIVE);
+	Cvar_SetDescription(sv_snapshotBudget, "Keep the snapshots of rate limited clients to what their rate allows. "
+		"Players more than 1024 units away can then be seen frozen for up to a second");
+	sv_snapshotAdapt = Cvar_Get("sv_snapshotAdapt", "1", CVAR_ARCHIVE);
+	sv_worldIndex = Cvar_Get("sv_worldIndex", "0", CVAR_ARCHIVE);
+	sv_traceCache = Cvar_Get("sv_traceCache", "0", CVAR_ARCHIVE);
+	sv_profile = Cvar_Get("sv_profile", "0", 0);
+	sv_loadTestResults = Cvar_Get("sv_loadTestResults", "loadtest.csv", CVAR_ARCHIVE);
+	sv_benchDemo = Cvar_Get("sv_benchDemo", "", CVAR_ARCHIVE);
+	sv_benchMaps = Cvar_Get("sv_benchMaps", "", CVAR_ARCHIVE);
+	sv_benchResults = Cvar_Get("sv_benchResults", "microbench.txt", CVAR_ARCHIVE);
+	sv_benchBaseline = Cvar_Get("sv_benchBaseline", "", CVAR_ARCHIVE);
+	sv_benchTolerance = Cvar_Get("sv_benchTolerance", "5", CVAR_ARCHIVE);
+	sv_benchMsec = Cvar_Get("sv_benchMsec", "250", CVAR_ARCHIVE);
+	sv_csDelta = Cvar_Get("sv_csDelta", "1", CVAR_ARCHIVE);
+	sv_mtu = Cvar_Get("sv_mtu", "9000", CVAR_ARCHIVE);
+	sv_logFlushMsec = Cvar_Get("sv_logFlushMsec", "1000", CVAR_ARCHIVE);
+	sv_logBufferSize = Cvar_Get("sv_logBufferSize", "64", CVAR_ARCHIVE);
+	sv_demoBufferSize = Cvar_Get("sv_demoBufferSize", "256", CVAR_ARCHIVE);
+	sv_demoKeyframes = Cvar_Get("sv_demoKeyframes", "30", CVAR_ARCHIVE);
+	sv_mapPrefetch = Cvar_Get("sv_mapPrefetch", "30", CVAR_ARCHIVE);
+	sv_antilag = Cvar_Get("sv_antilag", "1", CVAR_ARCHIVE);
+	sv_gamestateLimit = Cvar_Get("sv_gamestateLimit", "8", CVAR_ARCHIVE);
+	sv_httpPort = Cvar_Get("sv_httpPort", "0", CVAR_ARCHIVE);
+	sv_httpMaxConnections = Cvar_Get("sv_httpMaxConnections", "16", CVAR_ARCHIVE);
+	sv_metrics = Cvar_Get("sv_metrics", "0", CVAR_ARCHIVE);
 
 	sv_demonotice = Cvar_Get ("sv_demonotice", "Smile! You're on camera!", CVAR_ARCHIVE);
 	sv_demofolder = Cvar_Get ("sv_demofolder", "serverdemos", CVAR_INIT | CVAR_PROTECTED );
@@ -1012,6 +1153,9 @@ void SV_Shutdown( char *finalmsg ) {
 	// stop server-side demos (if any)
 	if (com_dedicated->integer)
 		Cbuf_ExecuteText(EXEC_NOW, "stopserverdemo all");
+	SVD_StopWorldDemo();
+	SV_LoadTestShutdown();
+	SV_CaptureShutdown();
 	
 	if ( svs.clients && !com_errorEntered ) {
 		SV_FinalMessage( finalmsg );
@@ -1020,6 +1164,11 @@ void SV_Shutdown( char *finalmsg ) {
 	SV_RemoveOperatorCommands();
 	SV_MasterShutdown();
 	SV_ShutdownGameProgs();
+	SV_LogShutdown();
+	SVD_ShutdownWriter();
+	SV_PrefetchShutdown();
+	SV_HttpShutdown();
+	SV_ShutdownBans();
 
 	// free current level
 	SV_ClearServer();
@@ -1030,7 +1179,10 @@ void SV_Shutdown( char *finalmsg ) {
 		int index;
 		
 		for(index = 0; index < sv_maxclients->integer; index++)
+		{
 			SV_FreeClient(&svs.clients[index]);
+			SV_FreeClientStorage(&svs.clients[index]);
+		}
 		
 		Z_Free(svs.clients);
 	}
@@ -0,0 +1,830 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_loadtest.c -- simulated clients to size a server with, see loadtest
+
+#include "server.h"
+
+/*
+The simulated clients only exist on the server. They connect through
+SV_DirectConnect, are sent a gamestate and enter the world like anyone
+else, and get every snapshot built, encoded and handed to a netchan whose
+NA_LOADTEST address NET_SendPacket drops. Instead of packets coming back
+they get, once a frame, an acknowledge of everything sent before it and
+the usercmds since the last frame, replayed from a world demo or made up.
+
+The clients are added a step at a time up to the maximum, and at every
+step SV_Frame is measured with sv_profile for a while, along with the
+message bytes the server sent them: one row of the table written to
+sv_loadTestResults.
+*/
+
+#define	LOADTEST_CONNECT_MSEC	30000	// for every client of a step to enter the world
+#define	LOADTEST_WARMUP_MSEC	3000	// after that, before measuring
+#define	LOADTEST_MAX_STEPS		64
+#define	LOADTEST_CMD_MSEC		8		// made up usercmds come from a 125 fps client
+
+typedef enum {
+	LT_IDLE,
+	LT_CONNECTING,
+	LT_WARMUP,
+	LT_MEASURING
+} loadTestState_t;
+
+typedef struct {
+	int			clientNum;			// -1 once it went away
+	int			port;				// tells it from whoever gets the slot next
+	int			reliableSent;		// reliableSequence when the last frame was sent
+	int			countedSequence;	// outgoing messages before this are counted
+	usercmd_t	cmd;				// the last one it thought with
+	qboolean	joined;
+} loadTestClient_t;
+
+typedef struct {
+	int			clients;
+	int			frames;
+	int			frameMean, frameP99, frameMax;
+	int			overBudget;
+	int			gameMean;
+	int			sendMean;
+	int			thinkMean;
+	float		kbps;
+} loadTestStep_t;
+
+static struct {
+	loadTestState_t		state;
+	int					maxClients;
+	int					step;
+	int					measureMsec;
+	int					target;				// clients wanted for this step
+	int					stateTime;			// svs.time the state was entered
+	char				savedProfile[MAX_CVAR_VALUE_STRING];
+
+	loadTestClient_t	clients[MAX_CLIENTS];
+	int					numClients;
+	int					nextPort;
+
+	// what is being measured
+	int64_t				bytes;
+	int64_t				thinkUsec;
+	int					thinkFrames;
+
+	loadTestStep_t		steps[LOADTEST_MAX_STEPS];
+	int					numSteps;
+} lt;
+
+// usercmds replayed from a world demo, see sv_demo.c for the format
+static struct {
+	fileHandle_t		file;
+	char				path[MAX_QPATH];
+	int					framesRead;			// since the file was opened
+	qboolean			pending;			// a frame read ahead waits in cmds
+	int					time;				// recorded time of that frame
+	int					startTime;			// recorded time of the first frame
+	int					playStart;			// sv.time it is replayed from
+
+	qboolean			active[MAX_CLIENTS];
+	usercmd_t			last[MAX_CLIENTS];
+	usercmd_t			cmds[MAX_CLIENTS][WORLDDEMO_MAX_USERCMDS];
+	int					numCmds[MAX_CLIENTS];
+	int					players[MAX_CLIENTS];	// recorded clients in the frame
+	int					numPlayers;
+} ltDemo;
+
+static byte		ltDemoBuffer[MAX_MSGLEN * 8];
+
+/*
+==================
+SV_LoadTestCloseDemo
+==================
+*/
+static void SV_LoadTestCloseDemo( void ) {
+	if ( ltDemo.file ) {
+		FS_FCloseFile( ltDemo.file );
+	}
+	ltDemo.file = 0;
+}
+
+/*
+==================
+SV_LoadTestOpenDemo
+
+Takes a path, or a name in sv_demofolder with or without the extension
+==================
+*/
+static qboolean SV_LoadTestOpenDemo( const char *demoName ) {
+	char	name[MAX_QPATH];
+	char	header[4];
+	int		v, length;
+
+	Q_strncpyz( name, demoName, sizeof( name ) );
+
+	SV_LoadTestCloseDemo();
+	Com_Memset( &ltDemo, 0, sizeof( ltDemo ) );
+
+	Q_strncpyz( ltDemo.path, name, sizeof( ltDemo.path ) );
+	if ( FS_FOpenFileRead( ltDemo.path, &ltDemo.file, qtrue ) < 0 || !ltDemo.file ) {
+		Com_sprintf( ltDemo.path, sizeof( ltDemo.path ), "%s/%s", sv_demofolder->string, name );
+		if ( FS_FOpenFileRead( ltDemo.path, &ltDemo.file, qtrue ) < 0 || !ltDemo.file ) {
+			Com_sprintf( ltDemo.path, sizeof( ltDemo.path ), "%s/%s.wdm_%d", sv_demofolder->string, name, PROTOCOL_VERSION );
+			if ( FS_FOpenFileRead( ltDemo.path, &ltDemo.file, qtrue ) < 0 || !ltDemo.file ) {
+				Com_Printf( "loadtest: couldn't find the world demo %s\n", name );
+				ltDemo.file = 0;
+				return qfalse;
+			}
+		}
+	}
+
+	// "WDMO", version, protocol, modversion, maxclients, checksumFeed
+	if ( FS_Read( header, 4, ltDemo.file ) != 4 || memcmp( header, "WDMO", 4 ) ) {
+		Com_Printf( "loadtest: %s isn't a world demo\n", ltDemo.path );
+		SV_LoadTestCloseDemo();
+		return qfalse;
+	}
+
+	FS_Read( &v, 4, ltDemo.file );
+	if ( LittleLong( v ) != WORLDDEMO_VERSION ) {
+		Com_Printf( "loadtest: %s is world demo version %i, not %i\n", ltDemo.path, LittleLong( v ), WORLDDEMO_VERSION );
+		SV_LoadTestCloseDemo();
+		return qfalse;
+	}
+
+	FS_Read( &v, 4, ltDemo.file );
+	FS_Read( &length, 4, ltDemo.file );
+	length = LittleLong( length );
+	if ( length < 0 || length > sizeof( ltDemoBuffer ) || FS_Read( ltDemoBuffer, length, ltDemo.file ) != length ) {
+		Com_Printf( "loadtest: %s is truncated\n", ltDemo.path );
+		SV_LoadTestCloseDemo();
+		return qfalse;
+	}
+	FS_Read( &v, 4, ltDemo.file );
+	FS_Read( &v, 4, ltDemo.file );
+
+	return qtrue;
+}
+
+/*
+==================
+SV_LoadTestSkipEntities
+
+The entity deltas of a frame are only in the way, read them against
+anything to get past them
+==================
+*/
+static void SV_LoadTestSkipEntities( msg_t *msg ) {
+	entityState_t	from, to;
+	int				num;
+
+	Com_Memset( &from, 0, sizeof( from ) );
+
+	while ( msg->readcount <= msg->cursize ) {
+		num = MSG_ReadBits( msg, GENTITYNUM_BITS );
+		if ( num == MAX_GENTITIES - 1 ) {
+			break;
+		}
+		MSG_ReadDeltaEntity( msg, &from, &to, num );
+	}
+
+	// svFlags and singleClient changes
+	while ( msg->readcount <= msg->cursize ) {
+		num = MSG_ReadBits( msg, GENTITYNUM_BITS );
+		if ( num == MAX_GENTITIES - 1 ) {
+			break;
+		}
+		MSG_ReadLong( msg );
+		MSG_ReadLong( msg );
+	}
+}
+
+/*
+==================
+SV_LoadTestReadClients
+==================
+*/
+static void SV_LoadTestReadClients( msg_t *msg ) {
+	static playerState_t	ps;
+	qboolean				seen[MAX_CLIENTS];
+	usercmd_t				cmd;
+	int						i, j, numCmds;
+
+	Com_Memset( seen, 0, sizeof( seen ) );
+	ltDemo.numPlayers = 0;
+
+	while ( msg->readcount <= msg->cursize ) {
+		i = MSG_ReadByte( msg );
+		if ( i < 0 || i >= MAX_CLIENTS ) {
+			break;		// 255 ends the list
+		}
+
+		MSG_ReadDeltaPlayerstate( msg, NULL, &ps );
+
+		// the usercmds of a client are delta compressed from its first frame on
+		if ( !ltDemo.active[i] ) {
+			Com_Memset( &ltDemo.last[i], 0, sizeof( ltDemo.last[i] ) );
+		}
+		seen[i] = qtrue;
+
+		numCmds = MSG_ReadByte( msg );
+		for ( j = 0 ; j < numCmds ; j++ ) {
+			MSG_ReadDeltaUsercmdKey( msg, 0, &ltDemo.last[i], &cmd );
+			ltDemo.last[i] = cmd;
+			if ( j < WORLDDEMO_MAX_USERCMDS ) {
+				ltDemo.cmds[i][j] = cmd;
+			}
+		}
+		ltDemo.numCmds[i] = MIN( numCmds, WORLDDEMO_MAX_USERCMDS );
+		ltDemo.players[ltDemo.numPlayers++] = i;
+	}
+
+	Com_Memcpy( ltDemo.active, seen, sizeof( ltDemo.active ) );
+}
+
+/*
+==================
+SV_LoadTestReadFrame
+
+Reads on to the next wd_frame record, qfalse at the end of the demo
+==================
+*/
+static qboolean SV_LoadTestReadFrame( void ) {
+	msg_t	msg;
+	int		length;
+
+	while ( 1 ) {
+		if ( FS_Read( &length, 4, ltDemo.file ) != 4 ) {
+			return qfalse;
+		}
+		length = LittleLong( length );
+		if ( length < 0 || length > sizeof( ltDemoBuffer ) ) {
+			return qfalse;
+		}
+		if ( FS_Read( ltDemoBuffer, length, ltDemo.file ) != length ) {
+			return qfalse;
+		}
+
+		MSG_Init( &msg, ltDemoBuffer, sizeof( ltDemoBuffer ) );
+		msg.cursize = length;
+		MSG_Bitstream( &msg );
+
+		if ( MSG_ReadByte( &msg ) != wd_frame ) {
+			continue;
+		}
+
+		ltDemo.time = MSG_ReadLong( &msg );
+		SV_LoadTestSkipEntities( &msg );
+		SV_LoadTestReadClients( &msg );
+		ltDemo.framesRead++;
+		return qtrue;
+	}
+}
+
+/*
+==================
+SV_LoadTestThink
+==================
+*/
+static void SV_LoadTestThink( loadTestClient_t *sim, client_t *cl, usercmd_t *cmd ) {
+	// like SV_UserMove, older ones have been run already
+	if ( cmd->serverTime <= cl->lastUsercmd.serverTime ) {
+		return;
+	}
+
+	sim->cmd = *cmd;
+	SV_ClientThink( cl, cmd );
+}
+
+/*
+==================
+SV_LoadTestReplay
+
+Plays the recorded frames that are due, each simulated client taking the
+usercmds of one of the recorded ones. Returns qfalse if the demo is of no
+use, the clients make theirs up from then on.
+==================
+*/
+static qboolean SV_LoadTestReplay( void ) {
+	loadTestClient_t	*sim;
+	client_t			*cl;
+	usercmd_t			cmd;
+	int					i, j, player, offset;
+	qboolean			looped = qfalse;
+
+	while ( 1 ) {
+		if ( !ltDemo.pending ) {
+			if ( !SV_LoadTestReadFrame() ) {
+				if ( !ltDemo.framesRead ) {
+					Com_Printf( "loadtest: no usercmds in %s, making them up\n", ltDemo.path );
+					SV_LoadTestCloseDemo();
+					return qfalse;
+				}
+
+				// loop it, a demo of a frame or two only once a server frame
+				if ( looped ) {
+					return qtrue;
+				}
+				if ( !SV_LoadTestOpenDemo( ltDemo.path ) ) {
+					return qfalse;
+				}
+				looped = qtrue;
+				continue;
+			}
+
+			if ( ltDemo.framesRead == 1 ) {
+				ltDemo.startTime = ltDemo.time;
+				ltDemo.playStart = sv.time;
+			}
+			ltDemo.pending = qtrue;
+		}
+
+		if ( ltDemo.time - ltDemo.startTime > sv.time - ltDemo.playStart ) {
+			return qtrue;
+		}
+		ltDemo.pending = qfalse;
+
+		if ( !ltDemo.numPlayers ) {
+			continue;
+		}
+
+		offset = ltDemo.playStart - ltDemo.startTime;
+		for ( i = 0, sim = lt.clients ; i < lt.numClients ; i++, sim++ ) {
+			if ( sim->clientNum < 0 ) {
+				continue;
+			}
+			cl = &svs.clients[sim->clientNum];
+			if ( cl->state != CS_ACTIVE ) {
+				continue;
+			}
+
+			player = ltDemo.players[i % ltDemo.numPlayers];
+			for ( j = 0 ; j < ltDemo.numCmds[player] ; j++ ) {
+				cmd = ltDemo.cmds[player][j];
+				cmd.serverTime += offset;
+				SV_LoadTestThink( sim, cl, &cmd );
+			}
+		}
+	}
+}
+
+/*
+==================
+SV_LoadTestMakeCmds
+
+Runs and strafes in a slow circle, jumping and shooting now and then, at
+LOADTEST_CMD_MSEC up to sv.time
+==================
+*/
+static void SV_LoadTestMakeCmds( loadTestClient_t *sim, client_t *cl, int index ) {
+	usercmd_t	cmd;
+	int			t, phase;
+
+	t = sim->cmd.serverTime;
+	if ( t < sv.time - 100 || t > sv.time ) {
+		t = sv.time - LOADTEST_CMD_MSEC;
+	}
+
+	cmd = sim->cmd;
+	cmd.weapon = SV_GameClientNum( sim->clientNum )->weapon;
+
+	for ( t += LOADTEST_CMD_MSEC ; t <= sv.time ; t += LOADTEST_CMD_MSEC ) {
+		phase = t + index * 337;
+
+		cmd.serverTime = t;
+		cmd.angles[YAW] = ANGLE2SHORT( ( phase / 16 ) % 360 );
+		cmd.forwardmove = 127;
+		cmd.rightmove = ( phase / 1000 ) & 1 ? 127 : -127;
+		cmd.upmove = ( phase % 1200 ) < 100 ? 127 : 0;
+		cmd.buttons = ( phase % 3000 ) < 600 ? BUTTON_ATTACK : 0;
+
+		SV_LoadTestThink( sim, cl, &cmd );
+	}
+}
+
+/*
+==================
+SV_LoadTestClient
+
+The slot of a simulated client, NULL once it was dropped
+==================
+*/
+static client_t *SV_LoadTestClient( loadTestClient_t *sim ) {
+	client_t	*cl;
+
+	if ( sim->clientNum < 0 ) {
+		return NULL;
+	}
+
+	cl = &svs.clients[sim->clientNum];
+	if ( cl->state == CS_FREE || cl->state == CS_ZOMBIE
+		|| cl->netchan.remoteAddress.type != NA_LOADTEST || cl->netchan.remoteAddress.port != sim->port ) {
+		sim->clientNum = -1;
+		return NULL;
+	}
+
+	return cl;
+}
+
+/*
+==================
+SV_LoadTestClientFrame
+
+Does what a client's packets would: moves it on through the connection
+and acknowledges what was sent to it. qfalse if it is gone.
+==================
+*/
+static qboolean SV_LoadTestClientFrame( loadTestClient_t *sim, int index ) {
+	client_t	*cl;
+	usercmd_t	cmd;
+	int			sequence;
+
+	cl = SV_LoadTestClient( sim );
+	if ( !cl ) {
+		return qfalse;
+	}
+
+	cl->lastPacketTime = svs.time;
+
+	// message bytes sent since the last frame
+	sequence = sim->countedSequence;
+	if ( sequence < cl->netchan.outgoingSequence - PACKET_BACKUP ) {
+		sequence = cl->netchan.outgoingSequence - PACKET_BACKUP;
+	}
+	for ( ; sequence < cl->netchan.outgoingSequence ; sequence++ ) {
+		lt.bytes += cl->frames[sequence & PACKET_MASK].messageSize;
+	}
+	sim->countedSequence = cl->netchan.outgoingSequence;
+
+	// everything sent before this frame got there
+	cl->messageAcknowledge = cl->netchan.outgoingSequence - 1;
+	if ( cl->frames[cl->messageAcknowledge & PACKET_MASK].messageAcked == 0 ) {
+		cl->frames[cl->messageAcknowledge & PACKET_MASK].messageAcked = Sys_Microseconds();
+	}
+	cl->reliableAcknowledge = sim->reliableSent;
+	sim->reliableSent = cl->reliableSequence;
+
+	switch ( cl->state ) {
+	case CS_CONNECTED:
+		// a new connection, or a map change
+		SV_SendClientGameState( cl );
+		return qtrue;
+
+	case CS_PRIMED:
+		// wait for the last fragment of the gamestate to go out
+		if ( cl->netchan.unsentFragments || cl->netchan_start_queue ) {
+			return qtrue;
+		}
+		cmd = sim->cmd;
+		cmd.serverTime = sv.time;
+		SV_ClientEnterWorld( cl, &cmd );
+		sim->cmd = cmd;
+		sim->joined = qfalse;
+		return qtrue;
+
+	default:
+		break;
+	}
+
+	cl->deltaMessage = cl->messageAcknowledge;
+
+	if ( !sim->joined ) {
+		SV_ExecuteClientCommand( cl, ( index & 1 ) ? "team blue" : "team red", qtrue );
+		sim->joined = qtrue;
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+SV_LoadTestConnect
+
+One more simulated client, qfalse if the server wouldn't take it
+==================
+*/
+static qboolean SV_LoadTestConnect( void ) {
+	char				userinfo[MAX_INFO_STRING];
+	loadTestClient_t	*sim;
+	client_t			*cl;
+	netadr_t			adr;
+	int					i, port;
+
+	for ( i = 0, sim = lt.clients ; i < lt.numClients ; i++, sim++ ) {
+		if ( sim->clientNum < 0 ) {
+			break;
+		}
+	}
+	if ( i == MAX_CLIENTS ) {
+		return qfalse;
+	}
+
+	port = ++lt.nextPort & 0xffff;
+
+	Com_Memset( &adr, 0, sizeof( adr ) );
+	adr.type = NA_LOADTEST;
+	adr.port = port;
+
+	Com_sprintf( userinfo, sizeof( userinfo ),
+		"\\name\\loadtest%i\\rate\\25000\\snaps\\20\\protocol\\%i\\qport\\%i\\challenge\\0\\cl_guid\\%032X",
+		port, com_protocol->integer, port, port );
+
+	Cmd_TokenizeString( va( "connect \"%s\"", userinfo ) );
+	SV_DirectConnect( adr );
+
+	for ( i = 0, cl = svs.clients ; i < sv_maxclients->integer ; i++, cl++ ) {
+		if ( cl->state == CS_CONNECTED && cl->netchan.remoteAddress.type == NA_LOADTEST
+			&& cl->netchan.remoteAddress.port == port ) {
+			break;
+		}
+	}
+	if ( i == sv_maxclients->integer ) {
+		return qfalse;
+	}
+
+	Com_Memset( sim, 0, sizeof( *sim ) );
+	sim->clientNum = i;
+	sim->port = port;
+	sim->reliableSent = cl->reliableSequence;
+	sim->countedSequence = cl->netchan.outgoingSequence;
+	if ( sim == &lt.clients[lt.numClients] ) {
+		lt.numClients++;
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+SV_LoadTestRecord
+==================
+*/
+static void SV_LoadTestRecord( int clients, int msec ) {
+	loadTestStep_t	*s;
+	int				p99, max;
+
+	s = &lt.steps[lt.numSteps++];
+	s->clients = clients;
+	s->frames = SV_ProfileSummary( SVPROF_FRAME, &s->frameMean, &s->frameP99, &s->frameMax );
+	s->overBudget = SV_ProfileOverBudget();
+	SV_ProfileSummary( SVPROF_GAME, &s->gameMean, &p99, &max );
+	SV_ProfileSummary( SVPROF_SEND, &s->sendMean, &p99, &max );
+	s->thinkMean = lt.thinkFrames ? (int)( lt.thinkUsec / lt.thinkFrames ) : 0;
+	s->kbps = msec > 0 ? lt.bytes * 8.0f / msec : 0.0f;
+
+	Com_Printf( "loadtest: %i clients, frame %i/%i/%i usec mean/p99/max, %i of %i over budget, %.0f kbit/s\n",
+		s->clients, s->frameMean, s->frameP99, s->frameMax, s->overBudget, s->frames, s->kbps );
+}
+
+/*
+==================
+SV_LoadTestFinish
+
+Prints and writes the table, if drop the simulated clients are kicked
+==================
+*/
+static void SV_LoadTestFinish( const char *why, qboolean drop ) {
+	loadTestClient_t	*sim;
+	loadTestStep_t		*s;
+	client_t			*cl;
+	fileHandle_t		f;
+	int					i;
+
+	Com_Printf( "loadtest %s\n", why );
+
+	if ( lt.numSteps ) {
+		Com_Printf( "clients   frames  mean usec   p99 usec   max usec  over  game usec  send usec think usec    kbit/s  per client\n" );
+		for ( i = 0, s = lt.steps ; i < lt.numSteps ; i++, s++ ) {
+			Com_Printf( "%7i %8i %10i %10i %10i %5i %10i %10i %10i %9.0f %11.1f\n",
+				s->clients, s->frames, s->frameMean, s->frameP99, s->frameMax, s->overBudget,
+				s->gameMean, s->sendMean, s->thinkMean, s->kbps, s->clients ? s->kbps / s->clients : 0.0f );
+		}
+
+		f = FS_FOpenFileWrite( sv_loadTestResults->string );
+		if ( f ) {
+			FS_Printf( f, "# map %s, sv_fps %i, usercmds %s\n", sv_mapname->string, sv_fps->integer,
+				ltDemo.file ? ltDemo.path : "made up" );
+			FS_Printf( f, "clients,frames,frame_mean_usec,frame_p99_usec,frame_max_usec,over_budget,"
+				"game_mean_usec,send_mean_usec,think_mean_usec,msg_kbps,msg_kbps_per_client\n" );
+			for ( i = 0, s = lt.steps ; i < lt.numSteps ; i++, s++ ) {
+				FS_Printf( f, "%i,%i,%i,%i,%i,%i,%i,%i,%i,%.1f,%.2f\n",
+					s->clients, s->frames, s->frameMean, s->frameP99, s->frameMax, s->overBudget,
+					s->gameMean, s->sendMean, s->thinkMean, s->kbps, s->clients ? s->kbps / s->clients : 0.0f );
+			}
+			FS_FCloseFile( f );
+			Com_Printf( "%s written\n", sv_loadTestResults->string );
+		} else {
+			Com_Printf( "Couldn't open %s for writing\n", sv_loadTestResults->string );
+		}
+	}
+
+	if ( drop ) {
+		for ( i = 0, sim = lt.clients ; i < lt.numClients ; i++, sim++ ) {
+			cl = SV_LoadTestClient( sim );
+			if ( cl ) {
+				SV_DropClient( cl, "load test over" );
+			}
+		}
+	}
+
+	SV_LoadTestCloseDemo();
+	Cvar_Set( "sv_profile", lt.savedProfile );
+	lt.state = LT_IDLE;
+	lt.numClients = 0;
+}
+
+/*
+==================
+SV_LoadTestFrame
+
+Called at the start of SV_Frame, where client packets would have come in
+==================
+*/
+void SV_LoadTestFrame( int msec ) {
+	loadTestClient_t	*sim;
+	int64_t				start;
+	int					i, alive, active;
+
+	if ( lt.state == LT_IDLE ) {
+		return;
+	}
+
+	start = Sys_Microseconds();
+
+	alive = active = 0;
+	for ( i = 0, sim = lt.clients ; i < lt.numClients ; i++, sim++ ) {
+		if ( !SV_LoadTestClientFrame( sim, i ) ) {
+			continue;
+		}
+		alive++;
+		if ( svs.clients[sim->clientNum].state == CS_ACTIVE ) {
+			active++;
+		}
+	}
+
+	if ( !ltDemo.file || !SV_LoadTestReplay() ) {
+		for ( i = 0, sim = lt.clients ; i < lt.numClients ; i++, sim++ ) {
+			if ( sim->clientNum >= 0 && svs.clients[sim->clientNum].state == CS_ACTIVE ) {
+				SV_LoadTestMakeCmds( sim, &svs.clients[sim->clientNum], i );
+			}
+		}
+	}
+
+	if ( lt.state == LT_MEASURING ) {
+		lt.thinkUsec += Sys_Microseconds() - start;
+		lt.thinkFrames++;
+	}
+
+	switch ( lt.state ) {
+	case LT_CONNECTING:
+		while ( alive < lt.target ) {
+			if ( !SV_LoadTestConnect() ) {
+				Com_Printf( "loadtest: the server took no more than %i clients\n", alive );
+				lt.target = lt.maxClients = alive;
+				break;
+			}
+			alive++;
+		}
+
+		if ( active >= lt.target && lt.target > 0 ) {
+			lt.state = LT_WARMUP;
+			lt.stateTime = svs.time;
+		} else if ( svs.time - lt.stateTime > LOADTEST_CONNECT_MSEC ) {
+			Com_Printf( "loadtest: only %i of %i clients entered the world\n", active, lt.target );
+			if ( active ) {
+				lt.state = LT_WARMUP;
+				lt.stateTime = svs.time;
+			} else {
+				SV_LoadTestFinish( "gave up", qtrue );
+			}
+		}
+		break;
+
+	case LT_WARMUP:
+		if ( svs.time - lt.stateTime >= LOADTEST_WARMUP_MSEC ) {
+			SV_ProfileReset();
+			lt.bytes = 0;
+			lt.thinkUsec = 0;
+			lt.thinkFrames = 0;
+			lt.state = LT_MEASURING;
+			lt.stateTime = svs.time;
+		}
+		break;
+
+	case LT_MEASURING:
+		if ( svs.time - lt.stateTime >= lt.measureMsec ) {
+			SV_LoadTestRecord( active, svs.time - lt.stateTime );
+
+			if ( lt.target >= lt.maxClients || lt.numSteps == LOADTEST_MAX_STEPS ) {
+				SV_LoadTestFinish( "done", qtrue );
+			} else {
+				lt.target = MIN( lt.target + lt.step, lt.maxClients );
+				lt.state = LT_CONNECTING;
+				lt.stateTime = svs.time;
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+/*
+==================
+SV_LoadTestShutdown
+
+The server is going down and takes the clients with it
+==================
+*/
+void SV_LoadTestShutdown( void ) {
+	if ( lt.state != LT_IDLE ) {
+		SV_LoadTestFinish( "stopped by the server shutting down", qfalse );
+	}
+}
+
+/*
+==================
+SV_LoadTest_f
+
+loadtest <clients> [step] [seconds] [worlddemo]
+loadtest stop
+==================
+*/
+void SV_LoadTest_f( void ) {
+	int		max, step, seconds;
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "stop" ) ) {
+		if ( lt.state == LT_IDLE ) {
+			Com_Printf( "No load test is running\n" );
+		} else {
+			SV_LoadTestFinish( "stopped", qtrue );
+		}
+		return;
+	}
+
+	max = atoi( Cmd_Argv( 1 ) );
+	if ( max <= 0 ) {
+		Com_Printf( "loadtest <clients> [step] [seconds] [worlddemo]\n"
+			"loadtest stop\n" );
+		if ( lt.state != LT_IDLE ) {
+			Com_Printf( "running, %i of %i clients, %i steps measured\n", lt.target, lt.maxClients, lt.numSteps );
+		}
+		return;
+	}
+
+	if ( lt.state != LT_IDLE ) {
+		Com_Printf( "A load test is already running, loadtest stop first\n" );
+		return;
+	}
+
+	if ( max > sv_maxclients->integer ) {
+		max = sv_maxclients->integer;
+	}
+
+	step = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : max;
+	if ( step <= 0 || step > max ) {
+		step = max;
+	}
+
+	seconds = Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : 30;
+	if ( seconds < 1 ) {
+		seconds = 1;
+	}
+
+	ltDemo.file = 0;
+	if ( Cmd_Argc() > 4 && !SV_LoadTestOpenDemo( Cmd_Argv( 4 ) ) ) {
+		return;
+	}
+
+	Com_Memset( lt.clients, 0, sizeof( lt.clients ) );
+	lt.numClients = 0;
+	lt.numSteps = 0;
+	lt.maxClients = max;
+	lt.step = step;
+	lt.measureMsec = seconds * 1000;
+	lt.target = step;
+	lt.state = LT_CONNECTING;
+	lt.stateTime = svs.time;
+
+	Q_strncpyz( lt.savedProfile, sv_profile->string, sizeof( lt.savedProfile ) );
+	Cvar_Set( "sv_profile", "1" );
+
+	Com_Printf( "loadtest: up to %i clients in steps of %i, measuring %i seconds each, %s usercmds\n",
+		max, step, seconds, ltDemo.file ? ltDemo.path : "made up" );
+}
@@ -0,0 +1,401 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_log.c -- buffered writer behind SV_LogPrintf
+
+#include "server.h"
+
+/*
+Lines are appended to a pending buffer on the main thread. Every
+sv_logFlushMsec, or when the buffer is half full, a writer thread swaps
+it with the one it writes from, so the main thread never waits on the
+disk. Without threads the same buffers are written out in SV_LogFrame.
+g_logSync 1 writes every line through as it comes, like before, but
+without opening and closing the file for it.
+*/
+
+typedef struct {
+	char			name[MAX_QPATH];
+	FILE			*file;
+
+	sysMutex_t		*lock;			// pending and pendingLength
+	sysMutex_t		*ioLock;		// file and writing
+	sysSemaphore_t	*wake;
+	sysThread_t		*thread;
+	qboolean		quit;
+
+	char			*pending;
+	char			*writing;
+	int				pendingLength;
+	int				bufferSize;
+	int				lastFlush;
+
+	qboolean		failed;			// set by the writer, reported by SV_LogFrame
+	qboolean		rotate;
+} svLog_t;
+
+static svLog_t	svLog;
+
+/*
+==================
+SV_LogDrain
+
+Writes out everything pending. Runs on the writer thread, or on the
+main thread when the buffer fills up or there is no writer.
+==================
+*/
+static void SV_LogDrain( void ) {
+	char	*swap;
+	int		length;
+
+	if ( svLog.ioLock ) {
+		Sys_LockMutex( svLog.ioLock );
+		Sys_LockMutex( svLog.lock );
+	}
+
+	swap = svLog.writing;
+	svLog.writing = svLog.pending;
+	svLog.pending = swap;
+	length = svLog.pendingLength;
+	svLog.pendingLength = 0;
+
+	if ( svLog.ioLock ) {
+		Sys_UnlockMutex( svLog.lock );
+	}
+
+	if ( length && svLog.file ) {
+		if ( fwrite( svLog.writing, 1, length, svLog.file ) != length ) {
+			svLog.failed = qtrue;
+		}
+		fflush( svLog.file );
+	}
+
+	if ( svLog.ioLock ) {
+		Sys_UnlockMutex( svLog.ioLock );
+	}
+}
+
+/*
+==================
+SV_LogThread
+==================
+*/
+static void SV_LogThread( void *arg ) {
+	while ( 1 ) {
+		Sys_WaitSemaphore( svLog.wake );
+
+		if ( svLog.quit ) {
+			break;
+		}
+
+		SV_LogDrain();
+	}
+}
+
+/*
+==================
+SV_LogStartThread
+
+Falls back to writing from SV_LogFrame if anything fails.
+==================
+*/
+static void SV_LogStartThread( void ) {
+	svLog.lock = Sys_CreateMutex();
+	svLog.ioLock = Sys_CreateMutex();
+	svLog.wake = Sys_CreateSemaphore();
+
+	if ( svLog.lock && svLog.ioLock && svLog.wake ) {
+		svLog.thread = Sys_CreateThread( SV_LogThread, NULL );
+		if ( svLog.thread ) {
+			return;
+		}
+	}
+
+	Com_Printf( "WARNING: couldn't start the log writer thread\n" );
+
+	if ( svLog.wake ) {
+		Sys_DestroySemaphore( svLog.wake );
+	}
+	if ( svLog.ioLock ) {
+		Sys_DestroyMutex( svLog.ioLock );
+	}
+	if ( svLog.lock ) {
+		Sys_DestroyMutex( svLog.lock );
+	}
+	svLog.wake = NULL;
+	svLog.ioLock = NULL;
+	svLog.lock = NULL;
+}
+
+/*
+==================
+SV_LogClose
+==================
+*/
+static void SV_LogClose( void ) {
+	if ( !svLog.file ) {
+		return;
+	}
+
+	SV_LogDrain();
+
+	if ( svLog.ioLock ) {
+		Sys_LockMutex( svLog.ioLock );
+	}
+	fclose( svLog.file );
+	svLog.file = NULL;
+	svLog.name[0] = 0;
+	if ( svLog.ioLock ) {
+		Sys_UnlockMutex( svLog.ioLock );
+	}
+}
+
+/*
+==================
+SV_LogOpen
+==================
+*/
+static void SV_LogOpen( const char *filename ) {
+	FILE	*file;
+	int		size;
+
+	SV_LogClose();
+
+	file = FS_FOpenRawFileAppend( filename );
+	if ( !file ) {
+		return;
+	}
+
+	// the buffers are only resized while nothing is pending
+	size = sv_logBufferSize->integer * 1024;
+	if ( size < MAX_STRING_CHARS ) {
+		size = MAX_STRING_CHARS;
+	}
+	if ( size != svLog.bufferSize ) {
+		if ( svLog.ioLock ) {
+			Sys_LockMutex( svLog.ioLock );
+		}
+		if ( svLog.pending ) {
+			Z_Free( svLog.pending );
+			Z_Free( svLog.writing );
+		}
+		svLog.pending = Z_Malloc( size );
+		svLog.writing = Z_Malloc( size );
+		svLog.bufferSize = size;
+		if ( svLog.ioLock ) {
+			Sys_UnlockMutex( svLog.ioLock );
+		}
+	}
+
+	if ( !svLog.thread && !svLog.lock ) {
+		SV_LogStartThread();
+	}
+
+	if ( svLog.ioLock ) {
+		Sys_LockMutex( svLog.ioLock );
+	}
+	svLog.file = file;
+	Q_strncpyz( svLog.name, filename, sizeof( svLog.name ) );
+	svLog.lastFlush = Sys_Milliseconds();
+	if ( svLog.ioLock ) {
+		Sys_UnlockMutex( svLog.ioLock );
+	}
+}
+
+/*
+==================
+SV_LogKick
+
+Hands what is pending to the writer.
+==================
+*/
+static void SV_LogKick( void ) {
+	svLog.lastFlush = Sys_Milliseconds();
+
+	if ( svLog.thread ) {
+		Sys_PostSemaphore( svLog.wake );
+	} else {
+		SV_LogDrain();
+	}
+}
+
+/*
+==================
+SV_LogWrite
+==================
+*/
+void SV_LogWrite( const char *text, int length ) {
+	const char	*filename;
+	int			pending;
+
+	filename = Cvar_VariableString( "g_log" );
+	if ( !filename[0] ) {
+		SV_LogClose();
+		return;
+	}
+
+	if ( !svLog.file || Q_stricmp( svLog.name, filename ) ) {
+		SV_LogOpen( filename );
+		if ( !svLog.file ) {
+			return;
+		}
+	}
+
+	if ( length > svLog.bufferSize ) {
+		length = svLog.bufferSize;
+	}
+
+	if ( svLog.lock ) {
+		Sys_LockMutex( svLog.lock );
+	}
+	if ( svLog.pendingLength + length > svLog.bufferSize ) {
+		// the writer fell behind, catch up here
+		if ( svLog.lock ) {
+			Sys_UnlockMutex( svLog.lock );
+		}
+		SV_LogDrain();
+		if ( svLog.lock ) {
+			Sys_LockMutex( svLog.lock );
+		}
+	}
+	Com_Memcpy( svLog.pending + svLog.pendingLength, text, length );
+	svLog.pendingLength += length;
+	pending = svLog.pendingLength;
+	if ( svLog.lock ) {
+		Sys_UnlockMutex( svLog.lock );
+	}
+
+	if ( Cvar_VariableIntegerValue( "g_logSync" ) ) {
+		SV_LogDrain();
+	} else if ( pending >= svLog.bufferSize / 2 ) {
+		SV_LogKick();
+	}
+}
+
+/*
+==================
+SV_LogFrame
+
+Flushes the log every sv_logFlushMsec.
+==================
+*/
+void SV_LogFrame( void ) {
+	int		pending;
+
+	if ( svLog.failed ) {
+		svLog.failed = qfalse;
+		Com_Printf( "WARNING: couldn't write to the log file %s\n", svLog.name );
+	}
+
+	if ( !svLog.file ) {
+		return;
+	}
+
+	if ( svLog.lock ) {
+		Sys_LockMutex( svLog.lock );
+	}
+	pending = svLog.pendingLength;
+	if ( svLog.lock ) {
+		Sys_UnlockMutex( svLog.lock );
+	}
+
+	if ( pending && Sys_Milliseconds() - svLog.lastFlush >= sv_logFlushMsec->integer ) {
+		SV_LogKick();
+	}
+}
+
+/*
+==================
+SV_LogCheckRotate
+
+Called between maps, when the game module has its log closed too.
+The current log is renamed with the date and a fresh one is started.
+==================
+*/
+void SV_LogCheckRotate( void ) {
+	const char	*filename;
+	char		rotated[MAX_QPATH];
+	qtime_t		now;
+
+	if ( !svLog.rotate ) {
+		return;
+	}
+	svLog.rotate = qfalse;
+
+	filename = Cvar_VariableString( "g_log" );
+	if ( !filename[0] ) {
+		return;
+	}
+
+	SV_LogClose();
+
+	Com_RealTime( &now );
+	Com_sprintf( rotated, sizeof( rotated ), "%s.%04i%02i%02i-%02i%02i%02i", filename,
+		1900 + now.tm_year, 1 + now.tm_mon, now.tm_mday, now.tm_hour, now.tm_min, now.tm_sec );
+
+	FS_Rename( filename, rotated );
+	Com_Printf( "Rotated log %s to %s\n", filename, rotated );
+}
+
+/*
+==================
+SV_LogRotate_f
+==================
+*/
+void SV_LogRotate_f( void ) {
+	if ( !Cvar_VariableString( "g_log" )[0] ) {
+		Com_Printf( "g_log is not set\n" );
+		return;
+	}
+
+	svLog.rotate = qtrue;
+	Com_Printf( "%s will be rotated when the next map starts\n", Cvar_VariableString( "g_log" ) );
+}
+
+/*
+==================
+SV_LogShutdown
+==================
+*/
+void SV_LogShutdown( void ) {
+	if ( svLog.thread ) {
+		svLog.quit = qtrue;
+		Sys_PostSemaphore( svLog.wake );
+		Sys_JoinThread( svLog.thread );
+		svLog.thread = NULL;
+
+		Sys_DestroySemaphore( svLog.wake );
+		Sys_DestroyMutex( svLog.ioLock );
+		Sys_DestroyMutex( svLog.lock );
+		svLog.wake = NULL;
+		svLog.ioLock = NULL;
+		svLog.lock = NULL;
+	}
+
+	SV_LogClose();
+
+	if ( svLog.pending ) {
+		Z_Free( svLog.pending );
+		Z_Free( svLog.writing );
+	}
+
+	Com_Memset( &svLog, 0, sizeof( svLog ) );
+}
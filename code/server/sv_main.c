@@ -27,6 +27,9 @@ server_t		sv;						// local server
 vm_t			*gvm = NULL;			// game virtual machine
 
 cvar_t	*sv_fps = NULL;					// time rate for running non-clients
+cvar_t	*sv_idleTime;					// seconds without players before a dedicated server idles
+cvar_t	*sv_idleFps;					// frames a second while idle
+cvar_t	*sv_idlePause;					// no game frames at all while idle
 cvar_t	*sv_timeout;					// seconds without any message
 cvar_t	*sv_zombietime;					// seconds to sink messages after disconnect
 cvar_t	*sv_rconPassword;				// password for remote server commands
@@ -55,12 +58,37 @@ cvar_t	*sv_newpurelist;
 cvar_t	*sv_lanForceRate;				// dedicated 1 (LAN) server forces local client rates to 99999 (bug #491)
 cvar_t	*sv_banFile;
 cvar_t	*sv_clientsPerIp;
-
-serverBan_t serverBans[SERVER_MAXBANS];
+cvar_t	*sv_deltaCache;					// share encoded entity deltas between clients
+cvar_t	*sv_snapshotBudget;				// spread the entity updates of rate limited clients over snapshots
+cvar_t	*sv_snapshotAdapt;				// fit each client's snapshot rate to its connection, spread clients over frames
+cvar_t	*sv_worldIndex;					// 0 = sector tree, 1 = loose grid, read on map load
+cvar_t	*sv_traceCache;					// reuse identical SV_Trace results within a game frame
+cvar_t	*sv_profile;					// time the SV_Frame stages, see profilestats
+cvar_t	*sv_loadTestResults;			// where loadtest writes its table
+cvar_t	*sv_benchDemo;					// world demo microbench takes its deltas from
+cvar_t	*sv_benchMaps;					// maps microbench traces on
+cvar_t	*sv_benchResults;
+cvar_t	*sv_benchBaseline;				// results to compare microbench against
+cvar_t	*sv_benchTolerance;				// percent slower before it's a regression
+cvar_t	*sv_benchMsec;					// each microbenchmark runs for this long
+cvar_t	*sv_csDelta;					// send configstring changes as deltas to clients that take them
+cvar_t	*sv_mtu;						// largest link MTU to fill with datagrams to clients that probed for it
+cvar_t	*sv_logFlushMsec;				// how long SV_LogPrintf lines may wait before they are written
+cvar_t	*sv_logBufferSize;				// kilobytes of SV_LogPrintf lines held back at most
+cvar_t	*sv_demoBufferSize;				// kilobytes of server demo data buffered per recorded client
+cvar_t	*sv_demoKeyframes;				// seconds between seek keyframes in server demos, 0 for none
+cvar_t	*sv_mapPrefetch;				// seconds before the timelimit to start reading the next map
+cvar_t	*sv_antilag;					// record entity positions for SV_TraceAtTime
+cvar_t	*sv_gamestateLimit;				// clients a gamestate is sent to at the same time, 0 = no limit
+cvar_t	*sv_httpPort;					// TCP port to serve the referenced pk3s over HTTP on, 0 = off
+cvar_t	*sv_httpMaxConnections;			// HTTP downloads at the same time
+cvar_t	*sv_metrics;					// Prometheus metrics on sv_httpPort/metrics
+
+serverBan_t *serverBans;
 int serverBansCount = 0;
 cvar_t	*sv_demonotice;					// notice to print to a client being recorded server-side
 cvar_t	*sv_demofolder;					// define the server-side demo folder name
-cvar_t	*sv_autoRecordDemo;				// automatically create a server demo of every player that connects
+cvar_t	*sv_autoRecordDemo;				// 1: automatically create a server demo of every player that connects, 2: record a world demo of every map
 cvar_t	*sv_tellprefix;
 cvar_t	*sv_sayprefix;
 cvar_t	*sv_teamSwitch;					// allow players to switch teams (0, Default = players must wait 5 seconds to switch, 1 = no restriction)
@@ -123,35 +151,123 @@ static char	*SV_ExpandNewlines( char *in ) {
 
 /*
 ======================
-SV_ReplacePendingServerCommands
+SV_PendingServerCommandBytes
+
+Bytes of reliable commands the client has not acknowledged yet
+======================
+*/
+static int SV_PendingServerCommandBytes( client_t *client ) {
+	int		i, bytes;
+
+	bytes = 0;
+	for ( i = client->reliableAcknowledge + 1 ; i <= client->reliableSequence ; i++ ) {
+		bytes += strlen( client->reliableCommands[ i & ( MAX_RELIABLE_COMMANDS - 1 ) ] );
+	}
+	return bytes;
+}
+
+/*
+======================
+SV_ConfigstringCommand
+
+Returns the configstring index a cs, csd or bcs command updates, or -1.
+Sets full when the command starts a whole new value.
+======================
+*/
+static int SV_ConfigstringCommand( const char *cmd, qboolean *full ) {
+	if ( !Q_strncmp( cmd, "cs ", 3 ) ) {
+		*full = qtrue;
+		return atoi( cmd + 3 );
+	}
+	if ( !Q_strncmp( cmd, "bcs0 ", 5 ) ) {
+		*full = qtrue;
+		return atoi( cmd + 5 );
+	}
+
+	*full = qfalse;
+	if ( !Q_strncmp( cmd, "csd ", 4 ) ) {
+		return atoi( cmd + 4 );
+	}
+	if ( !Q_strncmp( cmd, "bcs1 ", 5 ) || !Q_strncmp( cmd, "bcs2 ", 5 ) ) {
+		return atoi( cmd + 5 );
+	}
+	return -1;
+}
+
+/*
+======================
+SV_IsScoresCommand
+======================
+*/
+static qboolean SV_IsScoresCommand( const char *cmd ) {
+	return !Q_strncmp( cmd, "scores", 6 ) && ( cmd[6] == ' ' || cmd[6] == '\0' );
+}
+
+/*
+======================
+SV_RemovePendingServerCommand
+
+Takes out a command that has not been sent yet, the ones after it
+move down so the client still sees an unbroken sequence
+======================
+*/
+static void SV_RemovePendingServerCommand( client_t *client, int sequence ) {
+	int		i;
+
+	for ( i = sequence ; i < client->reliableSequence ; i++ ) {
+		Q_strncpyz( client->reliableCommands[ i & ( MAX_RELIABLE_COMMANDS - 1 ) ],
+			client->reliableCommands[ ( i + 1 ) & ( MAX_RELIABLE_COMMANDS - 1 ) ],
+			sizeof( client->reliableCommands[ 0 ] ) );
+	}
+	client->reliableSequence--;
+}
+
+/*
+======================
+SV_CoalesceServerCommand
+
+Drops pending commands the new one supersedes: older values of the
+same configstring and older scoreboards. Prints are left alone, game
+code may count on getting them one by one.
 
-FIXME: This is ugly
+Only commands that have not gone out yet are touched, the client
+may already hold anything up to reliableSent.
 ======================
 */
-#if 0 // unused
-static int SV_ReplacePendingServerCommands( client_t *client, const char *cmd ) {
-	int i, index, csnum1, csnum2;
-
-	for ( i = client->reliableSent+1; i <= client->reliableSequence; i++ ) {
-		index = i & ( MAX_RELIABLE_COMMANDS - 1 );
-		//
-		if ( !Q_strncmp(cmd, client->reliableCommands[ index ], strlen("cs")) ) {
-			sscanf(cmd, "cs %i", &csnum1);
-			sscanf(client->reliableCommands[ index ], "cs %i", &csnum2);
-			if ( csnum1 == csnum2 ) {
-				Q_strncpyz( client->reliableCommands[ index ], cmd, sizeof( client->reliableCommands[ index ] ) );
-				/*
-				if ( client->netchan.remoteAddress.type != NA_BOT ) {
-					Com_Printf( "WARNING: client %i removed double pending config string %i: %s\n", client-svs.clients, csnum1, cmd );
-				}
-				*/
-				return qtrue;
+static void SV_CoalesceServerCommand( client_t *client, const char *cmd ) {
+	int			first, i, index, csIndex;
+	qboolean	full, pendingFull;
+
+	first = client->reliableSent;
+	if ( client->reliableAcknowledge > first ) {
+		first = client->reliableAcknowledge;
+	}
+	first++;
+
+	if ( first > client->reliableSequence ) {
+		return;
+	}
+
+	csIndex = SV_ConfigstringCommand( cmd, &full );
+	if ( csIndex >= 0 && full ) {
+		// a whole new value, a delta has to build on what went before
+		for ( i = client->reliableSequence ; i >= first ; i-- ) {
+			index = SV_ConfigstringCommand( client->reliableCommands[ i & ( MAX_RELIABLE_COMMANDS - 1 ) ], &pendingFull );
+			if ( index == csIndex ) {
+				SV_RemovePendingServerCommand( client, i );
+			}
+		}
+		return;
+	}
+
+	if ( SV_IsScoresCommand( cmd ) ) {
+		for ( i = client->reliableSequence ; i >= first ; i-- ) {
+			if ( SV_IsScoresCommand( client->reliableCommands[ i & ( MAX_RELIABLE_COMMANDS - 1 ) ] ) ) {
+				SV_RemovePendingServerCommand( client, i );
 			}
 		}
 	}
-	return qfalse;
 }
-#endif
 
 /*
 ======================
@@ -164,27 +280,26 @@ not have future snapshot_t executed before it is executed
 void SV_AddServerCommand( client_t *client, const char *cmd ) {
 	int		index, i;
 
-	// this is very ugly but it's also a waste to for instance send multiple config string updates
-	// for the same config string index in one snapshot
-//	if ( SV_ReplacePendingServerCommands( client, cmd ) ) {
-//		return;
-//	}
-
 	// do not send commands until the gamestate has been sent
 	if( client->state < CS_PRIMED )
 		return;
 
+	// it's a waste to for instance send multiple config string updates
+	// for the same config string index in one snapshot
+	SV_CoalesceServerCommand( client, cmd );
+
 	client->reliableSequence++;
 	// if we would be losing an old command that hasn't been acknowledged,
 	// we must drop the connection
 	// we check == instead of >= so a broadcast print added by SV_DropClient()
 	// doesn't cause a recursive drop client
 	if ( client->reliableSequence - client->reliableAcknowledge == MAX_RELIABLE_COMMANDS + 1 ) {
-		Com_Printf( "===== pending server commands =====\n" );
+		Com_Printf( "===== pending server commands (%i bytes) =====\n", SV_PendingServerCommandBytes( client ) );
 		for ( i = client->reliableAcknowledge + 1 ; i <= client->reliableSequence ; i++ ) {
 			Com_Printf( "cmd %5d: %s\n", i, client->reliableCommands[ i & (MAX_RELIABLE_COMMANDS-1) ] );
 		}
 		Com_Printf( "cmd %5d: %s\n", i, cmd );
+		svMetrics[SVM_RELIABLE_OVERFLOWS]++;
 		SV_DropClient( client, "Server command overflow" );
 		return;
 	}
@@ -258,12 +373,48 @@ but not on every player enter or exit.
 */
 #define	HEARTBEAT_MSEC	300*1000
 #define	MASTERDNS_MSEC	24*60*60*1000
+
+/*
+================
+SV_MasterResolve
+
+The name is looked up again on the resolver thread once a day, or right
+away when maxAge is 0, the last address is used until the answer is in
+================
+*/
+static int SV_MasterResolve(int master, netadrtype_t family, netadr_t *adr, int maxAge)
+{
+	static int	answered[MAX_MASTER_SERVERS][2];
+	int			res, answerTime, v6;
+
+	v6 = (family == NA_IP6);
+
+	res = NET_ResolveAsync(sv_master[master]->string, adr, family, maxAge, &answerTime);
+
+	if(res == 2)
+	{
+		// if no port was specified, use the default master port
+		adr->port = BigShort(PORT_MASTER);
+	}
+
+	if(res > 0 && answerTime != answered[master][v6])
+	{
+		answered[master][v6] = answerTime;
+		Com_Printf( "%s resolved to %s\n", sv_master[master]->string, NET_AdrToStringwPort(*adr));
+	}
+
+	return res;
+}
+
 void SV_MasterHeartbeat(const char *message)
 {
-	static netadr_t	adr[MAX_MASTER_SERVERS][2]; // [2] for v4 and v6 address for the same address string.
+	static qboolean	pending[MAX_MASTER_SERVERS];	// due, but no address known yet
+	netadr_t	adr[2]; // [2] for v4 and v6 address for the same address string.
 	int			i;
-	int			res;
+	int			res[2];
 	int			netenabled;
+	int			maxAge;
+	qboolean	due;
 
 	netenabled = Cvar_VariableIntegerValue("net_enabled");
 
@@ -271,82 +422,68 @@ void SV_MasterHeartbeat(const char *message)
 	if (!com_dedicated || com_dedicated->integer != 2 || !(netenabled & (NET_ENABLEV4 | NET_ENABLEV6)))
 		return;		// only dedicated servers send heartbeats
 
-	// if not time yet, don't send anything
-	if ( svs.time < svs.nextHeartbeatTime )
-		return;
-
 	if ( !Q_stricmp( com_gamename->string, LEGACY_MASTER_GAMENAME ) )
 		message = LEGACY_HEARTBEAT_FOR_MASTER;
 
-	svs.nextHeartbeatTime = svs.time + HEARTBEAT_MSEC;
+	// if not time yet, only send to masters whose names just resolved
+	due = ( svs.time >= svs.nextHeartbeatTime );
+
+	if ( due )
+	{
+		svs.nextHeartbeatTime = svs.time + HEARTBEAT_MSEC;
 
 #ifdef USE_AUTH
-	VM_Call( gvm, GAME_AUTHSERVER_HEARTBEAT );
+		VM_Call( gvm, GAME_AUTHSERVER_HEARTBEAT );
 #endif
+	}
 
 	// send to group masters
 	for (i = 0; i < MAX_MASTER_SERVERS; i++)
 	{
 		if(!sv_master[i]->string[0])
+		{
+			pending[i] = qfalse;
+			continue;
+		}
+
+		if(!due && !pending[i] && !sv_master[i]->modified)
 			continue;
 
-		// see if we haven't already resolved the name or if it's been over 24 hours
-		// resolving usually causes hitches on win95, so only do it when needed
-		if (sv_master[i]->modified || svs.time > svs.masterResolveTime[i])
+		maxAge = MASTERDNS_MSEC;
+		if(sv_master[i]->modified)
 		{
 			sv_master[i]->modified = qfalse;
-			svs.masterResolveTime[i] = svs.time + MASTERDNS_MSEC;
-			
-			if(netenabled & NET_ENABLEV4)
-			{
-				Com_Printf("Resolving %s (IPv4)\n", sv_master[i]->string);
-				res = NET_StringToAdr(sv_master[i]->string, &adr[i][0], NA_IP);
-
-				if(res == 2)
-				{
-					// if no port was specified, use the default master port
-					adr[i][0].port = BigShort(PORT_MASTER);
-				}
-				
-				if(res)
-					Com_Printf( "%s resolved to %s\n", sv_master[i]->string, NET_AdrToStringwPort(adr[i][0]));
-				else
-					Com_Printf( "%s has no IPv4 address.\n", sv_master[i]->string);
-			}
-			
-			if(netenabled & NET_ENABLEV6)
-			{
-				Com_Printf("Resolving %s (IPv6)\n", sv_master[i]->string);
-				res = NET_StringToAdr(sv_master[i]->string, &adr[i][1], NA_IP6);
-
-				if(res == 2)
-				{
-					// if no port was specified, use the default master port
-					adr[i][1].port = BigShort(PORT_MASTER);
-				}
-				
-				if(res)
-					Com_Printf( "%s resolved to %s\n", sv_master[i]->string, NET_AdrToStringwPort(adr[i][1]));
-				else
-					Com_Printf( "%s has no IPv6 address.\n", sv_master[i]->string);
-			}
+			maxAge = 0;
 		}
 
-		if(adr[i][0].type == NA_BAD && adr[i][1].type == NA_BAD)
+		adr[0].type = adr[1].type = NA_BAD;
+		res[0] = res[1] = 0;
+
+		if(netenabled & NET_ENABLEV4)
+			res[0] = SV_MasterResolve(i, NA_IP, &adr[0], maxAge);
+		if(netenabled & NET_ENABLEV6)
+			res[1] = SV_MasterResolve(i, NA_IP6, &adr[1], maxAge);
+
+		if(!due && !pending[i])
+			continue;
+
+		if(adr[0].type == NA_BAD && adr[1].type == NA_BAD)
 		{
+			// wait for the first answer
+			pending[i] = (res[0] < 0 || res[1] < 0);
 			continue;
 		}
-
+		pending[i] = qfalse;
 
 		Com_Printf ("Sending heartbeat to %s\n", sv_master[i]->string );
 
 		// this command should be changed if the server info / status format
 		// ever incompatably changes
 
-		if(adr[i][0].type != NA_BAD)
-			NET_OutOfBandPrint( NS_SERVER, adr[i][0], "heartbeat %s\n", message);
-		if(adr[i][1].type != NA_BAD)
-			NET_OutOfBandPrint( NS_SERVER, adr[i][1], "heartbeat %s\n", message);
+		if(adr[0].type != NA_BAD)
+			NET_OutOfBandPrint( NS_SERVER, adr[0], "heartbeat %s\n", message);
+		if(adr[1].type != NA_BAD)
+			NET_OutOfBandPrint( NS_SERVER, adr[1], "heartbeat %s\n", message);
 	}
 }
 
@@ -384,39 +521,83 @@ CONNECTIONLESS COMMANDS
 ==============================================================================
 */
 
+/*
+Per address buckets live in a set associative table: the address, with
+IPv6 aggregated to its /64 since anyone owns a whole one, and the command
+pick a set of BUCKET_WAYS buckets, which is the only place a bucket for
+them can be. A lookup touches two cache lines whatever the load, a bucket
+that has drained is free for reuse as it is found, and a full set gives
+up its least recently used bucket. A flood of spoofed addresses can then
+only make some other addresses start over with an empty bucket, where the
+old table, once full, refused everyone until buckets expired.
+*/
+
 // This is deliberately quite large to make it more of an effort to DoS
-#define MAX_BUCKETS			16384
-#define MAX_HASHES			1024
+#define BUCKET_WAYS			8
+#define MAX_BUCKET_SETS		8192
 
-static leakyBucket_t buckets[ MAX_BUCKETS ];
-static leakyBucket_t *bucketHashes[ MAX_HASHES ];
+static leakyBucket_t buckets[ MAX_BUCKET_SETS ][ BUCKET_WAYS ];
 leakyBucket_t outboundLeakyBucket;
 
+typedef struct {
+	int			lookups;
+	int			found;
+	int			reused;		// empty or drained
+	int			evicted;	// still holding a burst
+} svcBucketStats_t;
+
+static svcBucketStats_t	svcBucketStats;
+
+typedef struct {
+	const char	*name;
+	int			length;
+	int			burst;		// 0 only counts the command
+	int			period;
+	int			accepted;
+	int			dropped;
+} svcCommandLimit_t;
+
+static svcCommandLimit_t svcCommandLimits[ SVC_NUM_COMMANDS ] = {
+	{ "other",			5,	0,	0 },
+	{ "getstatus",		9,	10,	1000 },
+	{ "getinfo",		7,	10,	1000 },
+	{ "getchallenge",	12,	10,	1000 },
+	{ "connect",		7,	0,	0 },
+	{ "rcon",			4,	10,	1000 },
+	{ "mtuprobe",		8,	10,	1000 }
+};
+
 /*
 ================
-SVC_HashForAddress
+SVC_BucketKey
 ================
 */
-static long SVC_HashForAddress( netadr_t address ) {
-	byte 		*ip = NULL;
-	size_t	size = 0;
-	int			i;
-	long		hash = 0;
+static void SVC_BucketKey( netadr_t address, byte *key ) {
+	Com_Memset( key, 0, 8 );
 
 	switch ( address.type ) {
-		case NA_IP:  ip = address.ip;  size = 4; break;
-		case NA_IP6: ip = address.ip6; size = 16; break;
+		case NA_IP:  Com_Memcpy( key, address.ip, 4 );  break;
+		case NA_IP6: Com_Memcpy( key, address.ip6, 8 ); break;
 		default: break;
 	}
+}
 
-	for ( i = 0; i < size; i++ ) {
-		hash += (long)( ip[ i ] ) * ( i + 119 );
-	}
+/*
+================
+SVC_BucketSet
+================
+*/
+static leakyBucket_t *SVC_BucketSet( const byte *key, netadrtype_t type, svcCommand_t command ) {
+	unsigned	hash = 2166136261u;
+	int			i;
 
-	hash = ( hash ^ ( hash >> 10 ) ^ ( hash >> 20 ) );
-	hash &= ( MAX_HASHES - 1 );
+	for ( i = 0; i < 8; i++ ) {
+		hash = ( hash ^ key[ i ] ) * 16777619u;
+	}
+	hash = ( hash ^ ( type << 8 | command ) ) * 16777619u;
+	hash ^= hash >> 15;
 
-	return hash;
+	return buckets[ hash & ( MAX_BUCKET_SETS - 1 ) ];
 }
 
 /*
@@ -426,80 +607,59 @@ SVC_BucketForAddress
 Find or allocate a bucket for an address
 ================
 */
-static leakyBucket_t *SVC_BucketForAddress( netadr_t address, int burst, int period ) {
-	leakyBucket_t	*bucket = NULL;
-	int						i;
-	long					hash = SVC_HashForAddress( address );
-	int						now = Sys_Milliseconds();
-
-	for ( bucket = bucketHashes[ hash ]; bucket; bucket = bucket->next ) {
-		switch ( bucket->type ) {
-			case NA_IP:
-				if ( memcmp( bucket->ipv._4, address.ip, 4 ) == 0 ) {
-					return bucket;
-				}
-				break;
-
-			case NA_IP6:
-				if ( memcmp( bucket->ipv._6, address.ip6, 16 ) == 0 ) {
-					return bucket;
-				}
-				break;
-
-			default:
-				break;
-		}
-	}
-
-	for ( i = 0; i < MAX_BUCKETS; i++ ) {
-		int interval;
+static leakyBucket_t *SVC_BucketForAddress( netadr_t address, svcCommand_t command, int burst, int period ) {
+	leakyBucket_t	*set, *bucket, *slot, *oldest;
+	byte			key[ 8 ];
+	int				i, interval;
+	int				now = Sys_Milliseconds();
 
-		bucket = &buckets[ i ];
-		interval = now - bucket->lastTime;
-
-		// Reclaim expired buckets
-		if ( bucket->lastTime > 0 && ( interval > ( burst * period ) ||
-					interval < 0 ) ) {
-			if ( bucket->prev != NULL ) {
-				bucket->prev->next = bucket->next;
-			} else {
-				bucketHashes[ bucket->hash ] = bucket->next;
-			}
-			
-			if ( bucket->next != NULL ) {
-				bucket->next->prev = bucket->prev;
-			}
+	SVC_BucketKey( address, key );
+	set = SVC_BucketSet( key, address.type, command );
+	svcBucketStats.lookups++;
 
-			Com_Memset( bucket, 0, sizeof( leakyBucket_t ) );
-		}
+	slot = oldest = NULL;
+	for ( i = 0; i < BUCKET_WAYS; i++ ) {
+		bucket = &set[ i ];
 
 		if ( bucket->type == NA_BAD ) {
-			bucket->type = address.type;
-			switch ( address.type ) {
-				case NA_IP:  Com_Memcpy( bucket->ipv._4, address.ip, 4 );   break;
-				case NA_IP6: Com_Memcpy( bucket->ipv._6, address.ip6, 16 ); break;
-				default: break;
+			// buckets are never emptied, nothing is past this one
+			if ( !slot ) {
+				slot = bucket;
 			}
+			break;
+		}
 
-			bucket->lastTime = now;
-			bucket->burst = 0;
-			bucket->hash = hash;
-
-			// Add to the head of the relevant hash chain
-			bucket->next = bucketHashes[ hash ];
-			if ( bucketHashes[ hash ] != NULL ) {
-				bucketHashes[ hash ]->prev = bucket;
-			}
+		if ( bucket->type == address.type && bucket->command == command &&
+			!memcmp( bucket->key, key, sizeof( key ) ) ) {
+			svcBucketStats.found++;
+			return bucket;
+		}
 
-			bucket->prev = NULL;
-			bucketHashes[ hash ] = bucket;
+		// drained buckets hold nothing worth keeping
+		interval = now - bucket->lastTime;
+		if ( !slot && ( interval >= bucket->burst * period || interval < 0 ) ) {
+			slot = bucket;
+		}
 
-			return bucket;
+		if ( !oldest || bucket->lastTime - oldest->lastTime < 0 ) {
+			oldest = bucket;
 		}
 	}
 
-	// Couldn't allocate a bucket for this address
-	return NULL;
+	if ( slot ) {
+		svcBucketStats.reused++;
+	} else {
+		slot = oldest;
+		svcBucketStats.evicted++;
+	}
+
+	Com_Memcpy( slot->key, key, sizeof( key ) );
+	slot->type = address.type;
+	slot->command = command;
+	slot->lastTime = now;
+	slot->burst = 0;
+
+	return slot;
 }
 
 /*
@@ -529,20 +689,476 @@ qboolean SVC_RateLimit( leakyBucket_t *bucket, int burst, int period ) {
 		}
 	}
 
-	return qtrue;
+	return qtrue;
+}
+
+/*
+================
+SVC_RateLimitAddress
+
+Rate limit for a particular address
+================
+*/
+qboolean SVC_RateLimitAddress( netadr_t from, int burst, int period ) {
+	leakyBucket_t *bucket = SVC_BucketForAddress( from, SVC_OTHER, burst, period );
+
+	return SVC_RateLimit( bucket, burst, period );
+}
+
+/*
+================
+SVC_CommandForName
+================
+*/
+static svcCommand_t SVC_CommandForName( const char *name ) {
+	int		i;
+
+	for ( i = SVC_OTHER + 1; i < SVC_NUM_COMMANDS; i++ ) {
+		if ( !Q_stricmp( name, svcCommandLimits[ i ].name ) ) {
+			return i;
+		}
+	}
+
+	return SVC_OTHER;
+}
+
+/*
+================
+SVC_CommandForPacket
+
+Looks at the first word of a connectionless packet without
+tokenizing it. Anything unusual, like quoting or leading
+whitespace, comes back as SVC_OTHER and is checked again
+once the packet has been parsed.
+================
+*/
+static svcCommand_t SVC_CommandForPacket( msg_t *msg ) {
+	const char	*text = (const char *)&msg->data[ 4 ];
+	int			length = msg->cursize - 4;
+	int			i;
+
+	for ( i = SVC_OTHER + 1; i < SVC_NUM_COMMANDS; i++ ) {
+		const svcCommandLimit_t *limit = &svcCommandLimits[ i ];
+
+		if ( length < limit->length || Q_stricmpn( text, limit->name, limit->length ) ) {
+			continue;
+		}
+
+		// the word has to end there, "getinfox" is not getinfo
+		if ( length == limit->length || (unsigned char)text[ limit->length ] <= ' ' ) {
+			return i;
+		}
+	}
+
+	return SVC_OTHER;
+}
+
+/*
+================
+SVC_RateLimitCommand
+
+Per address limit for one connectionless command,
+returns qtrue when the packet should be dropped.
+================
+*/
+static qboolean SVC_RateLimitCommand( netadr_t from, svcCommand_t command ) {
+	svcCommandLimit_t	*limit = &svcCommandLimits[ command ];
+	leakyBucket_t		*bucket;
+
+	if ( limit->burst ) {
+		bucket = SVC_BucketForAddress( from, command, limit->burst, limit->period );
+
+		if ( SVC_RateLimit( bucket, limit->burst, limit->period ) ) {
+			limit->dropped++;
+			return qtrue;
+		}
+	}
+
+	limit->accepted++;
+	return qfalse;
+}
+
+/*
+================
+SVC_CommandCounts
+
+How many of a connectionless command were let through and dropped,
+NULL past the last command
+================
+*/
+const char *SVC_CommandCounts( int command, int *accepted, int *dropped ) {
+	if ( command < 0 || command >= SVC_NUM_COMMANDS ) {
+		return NULL;
+	}
+
+	*accepted = svcCommandLimits[ command ].accepted;
+	*dropped = svcCommandLimits[ command ].dropped;
+	return svcCommandLimits[ command ].name;
+}
+
+/*
+================
+SVC_PacketStats_f
+
+packetstats [reset]
+================
+*/
+void SVC_PacketStats_f( void ) {
+	int		i;
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		for ( i = 0; i < SVC_NUM_COMMANDS; i++ ) {
+			svcCommandLimits[ i ].accepted = 0;
+			svcCommandLimits[ i ].dropped = 0;
+		}
+		Com_Memset( &svcBucketStats, 0, sizeof( svcBucketStats ) );
+		Com_Printf( "packet stats cleared\n" );
+		return;
+	}
+
+	Com_Printf( "command        accepted    dropped  limit\n" );
+	for ( i = 0; i < SVC_NUM_COMMANDS; i++ ) {
+		const svcCommandLimit_t *limit = &svcCommandLimits[ i ];
+
+		if ( limit->burst ) {
+			Com_Printf( "%-12s %10i %10i  %i per %i msec\n", limit->name,
+				limit->accepted, limit->dropped, limit->burst, limit->period );
+		} else {
+			Com_Printf( "%-12s %10i %10i  none\n", limit->name,
+				limit->accepted, limit->dropped );
+		}
+	}
+
+	Com_Printf( "buckets: %i lookups, %i found, %i reused, %i evicted\n",
+		svcBucketStats.lookups, svcBucketStats.found,
+		svcBucketStats.reused, svcBucketStats.evicted );
+}
+
+/*
+==============================================================================
+
+INFOSTRINGS
+
+The serverinfo and systeminfo strings are kept up to date one cvar at a
+time through a cvar subscription, instead of being rebuilt from every
+cvar whenever one of them changes.  SV_Frame sends whichever changed.
+
+==============================================================================
+*/
+
+static char		sv_serverInfo[MAX_INFO_STRING];
+static char		sv_systemInfo[BIG_INFO_STRING];
+static int		sv_infoChanged;		// CVAR_SERVERINFO and CVAR_SYSTEMINFO bits
+
+/*
+================
+SV_InfoCvarChanged
+================
+*/
+void SV_InfoCvarChanged( cvar_t *var ) {
+	int		length;
+
+	length = strlen( sv_serverInfo );
+	if ( var->flags & CVAR_SERVERINFO ) {
+		Info_SetValueForKey( sv_serverInfo, var->name, var->string );
+		sv_infoChanged |= CVAR_SERVERINFO;
+	} else {
+		Info_RemoveKey( sv_serverInfo, var->name );
+		if ( strlen( sv_serverInfo ) != length ) {
+			sv_infoChanged |= CVAR_SERVERINFO;
+		}
+	}
+
+	length = strlen( sv_systemInfo );
+	if ( var->flags & CVAR_SYSTEMINFO ) {
+		Info_SetValueForKey_Big( sv_systemInfo, var->name, var->string );
+		sv_infoChanged |= CVAR_SYSTEMINFO;
+	} else {
+		Info_RemoveKey_Big( sv_systemInfo, var->name );
+		if ( strlen( sv_systemInfo ) != length ) {
+			sv_infoChanged |= CVAR_SYSTEMINFO;
+		}
+	}
+
+	if ( sv_infoChanged & CVAR_SERVERINFO ) {
+		SVC_InvalidateResponses();
+	}
+}
+
+/*
+================
+SV_RebuildInfoStrings
+
+Composes both strings from all the cvars again
+================
+*/
+void SV_RebuildInfoStrings( void ) {
+	Q_strncpyz( sv_serverInfo, Cvar_InfoString( CVAR_SERVERINFO ), sizeof( sv_serverInfo ) );
+	Q_strncpyz( sv_systemInfo, Cvar_InfoString_Big( CVAR_SYSTEMINFO ), sizeof( sv_systemInfo ) );
+	sv_infoChanged = 0;
+	SVC_InvalidateResponses();
+}
+
+/*
+================
+SV_InfoString
+
+The current CVAR_SERVERINFO or CVAR_SYSTEMINFO string
+================
+*/
+const char *SV_InfoString( int bit ) {
+	return bit == CVAR_SYSTEMINFO ? sv_systemInfo : sv_serverInfo;
+}
+
+/*
+==============================================================================
+
+STATUS AND INFO RESPONSE CACHE
+
+Server browsers poll getstatus and getinfo far more often than anything
+in them changes, so the response bodies are kept composed and only the
+challenge is put in per request. The serverinfo part is thrown away when
+serverinfo cvars change, the player part when a client's presence, name,
+score or ping differ from what was composed.
+
+==============================================================================
+*/
+
+typedef struct {
+	qboolean	present;
+	qboolean	bot;
+	int			score;
+	int			ping;
+	char		name[MAX_NAME_LENGTH];
+} svcPlayerState_t;
+
+typedef struct {
+	qboolean			infoValid;
+	char				serverInfo[MAX_INFO_STRING];	// getstatus
+	char				info[MAX_INFO_STRING];			// getinfo, everything but the challenge
+
+	qboolean			playersValid;
+	int					numClients;
+	svcPlayerState_t	players[MAX_CLIENTS];
+	char				playerList[MAX_MSGLEN];
+	int					count, humans;
+} svcResponseCache_t;
+
+static svcResponseCache_t	svcCache;
+
+/*
+================
+SVC_InvalidateResponses
+
+Called when serverinfo cvars change or a new map starts.
+================
+*/
+void SVC_InvalidateResponses( void ) {
+	svcCache.infoValid = qfalse;
+	svcCache.playersValid = qfalse;
+}
+
+/*
+================
+SVC_UpdatePlayers
+
+Recomposes the player list if any client changed since it was built.
+================
+*/
+static void SVC_UpdatePlayers( void ) {
+	char				player[1024];
+	int					i;
+	client_t			*cl;
+	playerState_t		*ps;
+	svcPlayerState_t	*state;
+	qboolean			changed, full;
+	int					listLength, playerLength;
+	int					count, humans;
+
+	changed = !svcCache.playersValid || svcCache.numClients != sv_maxclients->integer;
+
+	for ( i = 0 ; i < sv_maxclients->integer && !changed ; i++ ) {
+		cl = &svs.clients[i];
+		state = &svcCache.players[i];
+
+		if ( cl->state < CS_CONNECTED ) {
+			changed = state->present;
+			continue;
+		}
+
+		ps = SV_GameClientNum( i );
+		changed = !state->present || state->score != ps->persistant[PERS_SCORE] ||
+			state->ping != cl->ping || strcmp( state->name, cl->name );
+	}
+
+	if ( !changed ) {
+		return;
+	}
+
+	count = svcCache.count;
+	humans = svcCache.humans;
+
+	svcCache.playersValid = qtrue;
+	svcCache.numClients = sv_maxclients->integer;
+	svcCache.playerList[0] = 0;
+	svcCache.count = svcCache.humans = 0;
+	listLength = 0;
+	full = qfalse;
+
+	for ( i = 0 ; i < sv_maxclients->integer ; i++ ) {
+		cl = &svs.clients[i];
+		state = &svcCache.players[i];
+
+		if ( cl->state < CS_CONNECTED ) {
+			state->present = qfalse;
+			continue;
+		}
+
+		ps = SV_GameClientNum( i );
+		state->present = qtrue;
+		state->bot = ( cl->netchan.remoteAddress.type == NA_BOT );
+		state->score = ps->persistant[PERS_SCORE];
+		state->ping = cl->ping;
+		Q_strncpyz( state->name, cl->name, sizeof( state->name ) );
+
+		// don't count privateclients
+		if ( i >= sv_privateClients->integer ) {
+			svcCache.count++;
+		}
+		if ( !state->bot ) {
+			svcCache.humans++;
+		}
+
+		Com_sprintf (player, sizeof(player), "%i %i \"%s\"\n", 
+			state->score, state->ping, state->name);
+		playerLength = strlen(player);
+		if (full || listLength + playerLength >= sizeof(svcCache.playerList) ) {
+			full = qtrue;		// can't hold any more
+			continue;
+		}
+		strcpy (svcCache.playerList + listLength, player);
+		listLength += playerLength;
+	}
+
+	// the client counts are part of the getinfo response
+	if ( svcCache.count != count || svcCache.humans != humans ) {
+		svcCache.infoValid = qfalse;
+	}
+}
+
+/*
+================
+SVC_UpdateInfo
+================
+*/
+static void SVC_UpdateInfo( void ) {
+	static infoString_t	info;
+	char	*gamedir;
+
+	if ( svcCache.infoValid ) {
+		return;
+	}
+	svcCache.infoValid = qtrue;
+
+	Q_strncpyz( svcCache.serverInfo, sv_serverInfo, sizeof( svcCache.serverInfo ) );
+
+	Info_Init( &info, MAX_INFO_STRING );
+
+	Info_Set( &info, "gamename", com_gamename->string );
+
+#ifdef LEGACY_PROTOCOL
+	if(com_legacyprotocol->integer > 0)
+		Info_Set(&info, "protocol", va("%i", com_legacyprotocol->integer));
+	else
+#endif
+		Info_Set(&info, "protocol", va("%i", com_protocol->integer));
+
+	Info_Set( &info, "hostname", sv_hostname->string );
+	Info_Set( &info, "mapname", sv_mapname->string );
+	Info_Set( &info, "clients", va("%i", svcCache.count) );
+	Info_Set( &info, "bots", va("%i", svcCache.count - svcCache.humans));
+	Info_Set( &info, "sv_maxclients", 
+		va("%i", sv_maxclients->integer - sv_privateClients->integer ) );
+	Info_Set( &info, "gametype", va("%i", sv_gametype->integer ) );
+	Info_Set( &info, "pure", va("%i", sv_pure->integer ) );
+
+	// UrT checks for "password" instead of "g_needpass"
+	if (Cvar_VariableValue("g_needpass") == 1)
+		Info_Set(&info, "password", "1");
+
+#ifdef USE_AUTH
+	Info_Set( &info, "auth", Cvar_VariableString("auth") );
+#endif
+
+#ifdef USE_VOIP
+	if (sv_voipProtocol->string && *sv_voipProtocol->string) {
+		Info_Set( &info, "voip", sv_voipProtocol->string );
+	}
+#endif
+
+	if( sv_minPing->integer ) {
+		Info_Set( &info, "minPing", va("%i", sv_minPing->integer) );
+	}
+	if( sv_maxPing->integer ) {
+		Info_Set( &info, "maxPing", va("%i", sv_maxPing->integer) );
+	}
+	gamedir = Cvar_VariableString( "fs_game" );
+	if( *gamedir ) {
+		Info_Set( &info, "game", gamedir );
+	}
+
+	Info_Set(&info, "modversion", Cvar_VariableString("g_modversion"));
+
+	Q_strncpyz( svcCache.info, Info_String( &info ), sizeof( svcCache.info ) );
+}
+
+/*
+================
+SVC_ChallengeKey
+
+The "\challenge\<value>" pair Info_SetValueForKey would have
+added, empty when it would have refused the value.
+================
+*/
+static void SVC_ChallengeKey( char *key, int keySize, const char *challenge, const char *info ) {
+	key[0] = 0;
+
+	if ( !*challenge || strpbrk( challenge, "\\;\"" ) ) {
+		return;
+	}
+
+	Com_sprintf( key, keySize, "\\challenge\\%s", challenge );
+
+	if ( strlen( key ) + strlen( info ) >= MAX_INFO_STRING ) {
+		key[0] = 0;
+	}
 }
 
 /*
 ================
-SVC_RateLimitAddress
+SVC_SendResponse
 
-Rate limit for a particular address
+Sends the pieces of a response as one connectionless packet,
+cut off where NET_OutOfBandPrint would have cut it.
 ================
 */
-qboolean SVC_RateLimitAddress( netadr_t from, int burst, int period ) {
-	leakyBucket_t *bucket = SVC_BucketForAddress( from, burst, period );
+static void SVC_SendResponse( netadr_t from, const char **parts, int numParts ) {
+	char	packet[MAX_MSGLEN];
+	int		i, length, partLength;
 
-	return SVC_RateLimit( bucket, burst, period );
+	packet[0] = packet[1] = packet[2] = packet[3] = -1;
+	length = 4;
+
+	for ( i = 0 ; i < numParts ; i++ ) {
+		partLength = strlen( parts[i] );
+		if ( partLength > sizeof( packet ) - 1 - length ) {
+			partLength = sizeof( packet ) - 1 - length;
+		}
+		Com_Memcpy( packet + length, parts[i], partLength );
+		length += partLength;
+	}
+
+	NET_SendPacket( NS_SERVER, length, packet, from );
 }
 
 /*
@@ -555,27 +1171,14 @@ the simple info query.
 ================
 */
 static void SVC_Status( netadr_t from ) {
-	char	player[1024];
-	char	status[MAX_MSGLEN];
-	int		i;
-	client_t	*cl;
-	playerState_t	*ps;
-	int		statusLength;
-	int		playerLength;
-	char	infostring[MAX_INFO_STRING];
+	char		challenge[MAX_INFO_STRING];
+	const char	*parts[5];
 
 	// ignore if we are in single player
 	if ( Cvar_VariableValue( "g_gametype" ) == GT_SINGLE_PLAYER || Cvar_VariableValue("ui_singlePlayerActive")) {
 		return;
 	}
 
-	// Prevent using getstatus as an amplifier
-	if ( SVC_RateLimitAddress( from, 10, 1000 ) ) {
-		Com_DPrintf( "SVC_Status: rate limit from %s exceeded, dropping request\n",
-			NET_AdrToString( from ) );
-		return;
-	}
-
 	// Allow getstatus to be DoSed relatively easily, but prevent
 	// excess outbound bandwidth usage when being flooded inbound
 	if ( SVC_RateLimit( &outboundLeakyBucket, 10, 100 ) ) {
@@ -587,31 +1190,19 @@ static void SVC_Status( netadr_t from ) {
 	if(strlen(Cmd_Argv(1)) > 128)
 		return;
 
-	strcpy( infostring, Cvar_InfoString( CVAR_SERVERINFO ) );
+	SVC_UpdatePlayers();
+	SVC_UpdateInfo();
 
 	// echo back the parameter to status. so master servers can use it as a challenge
 	// to prevent timed spoofed reply packets that add ghost servers
-	Info_SetValueForKey( infostring, "challenge", Cmd_Argv(1) );
-
-	status[0] = 0;
-	statusLength = 0;
-
-	for (i=0 ; i < sv_maxclients->integer ; i++) {
-		cl = &svs.clients[i];
-		if ( cl->state >= CS_CONNECTED ) {
-			ps = SV_GameClientNum( i );
-			Com_sprintf (player, sizeof(player), "%i %i \"%s\"\n", 
-				ps->persistant[PERS_SCORE], cl->ping, cl->name);
-			playerLength = strlen(player);
-			if (statusLength + playerLength >= sizeof(status) ) {
-				break;		// can't hold any more
-			}
-			strcpy (status + statusLength, player);
-			statusLength += playerLength;
-		}
-	}
-
-	NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s\n%s", infostring, status );
+	SVC_ChallengeKey( challenge, sizeof( challenge ), Cmd_Argv(1), svcCache.serverInfo );
+
+	parts[0] = "statusResponse\n";
+	parts[1] = challenge;
+	parts[2] = svcCache.serverInfo;
+	parts[3] = "\n";
+	parts[4] = svcCache.playerList;
+	SVC_SendResponse( from, parts, 5 );
 }
 
 /*
@@ -623,22 +1214,14 @@ if a user is interested in a server to do a full status
 ================
 */
 void SVC_Info( netadr_t from ) {
-	int		i, count, humans;
-	char	*gamedir;
-	char	infostring[MAX_INFO_STRING];
+	char		challenge[MAX_INFO_STRING];
+	const char	*parts[3];
 
 	// ignore if we are in single player
 	if ( Cvar_VariableValue( "g_gametype" ) == GT_SINGLE_PLAYER || Cvar_VariableValue("ui_singlePlayerActive")) {
 		return;
 	}
 
-	// Prevent using getinfo as an amplifier
-	if ( SVC_RateLimitAddress( from, 10, 1000 ) ) {
-		Com_DPrintf( "SVC_Info: rate limit from %s exceeded, dropping request\n",
-			NET_AdrToString( from ) );
-		return;
-	}
-
 	// Allow getinfo to be DoSed relatively easily, but prevent
 	// excess outbound bandwidth usage when being flooded inbound
 	if ( SVC_RateLimit( &outboundLeakyBucket, 10, 100 ) ) {
@@ -655,82 +1238,71 @@ void SVC_Info( netadr_t from ) {
 	if(strlen(Cmd_Argv(1)) > 128)
 		return;
 
-	// don't count privateclients
-	count = humans = 0;
-	for (i = 0; i < sv_maxclients->integer; i++) {
-		if (svs.clients[i].state < CS_CONNECTED) {
-			continue;
-		}
-		if (i >= sv_privateClients->integer) {
-			count++;
-		}
-		if (svs.clients[i].netchan.remoteAddress.type != NA_BOT) {
-			humans++;
-		}
-	}
-
-	infostring[0] = 0;
+	SVC_UpdatePlayers();
+	SVC_UpdateInfo();
 
 	// echo back the parameter to status. so servers can use it as a challenge
-	// to prevent timed spoofed reply packets that add ghost servers
-	Info_SetValueForKey( infostring, "challenge", Cmd_Argv(1) );
-
-	Info_SetValueForKey( infostring, "gamename", com_gamename->string );
-
-#ifdef LEGACY_PROTOCOL
-	if(com_legacyprotocol->integer > 0)
-		Info_SetValueForKey(infostring, "protocol", va("%i", com_legacyprotocol->integer));
-	else
-#endif
-		Info_SetValueForKey(infostring, "protocol", va("%i", com_protocol->integer));
+	// to prevent timed spoofed reply packets that add ghost servers.
+	// It was set first, which leaves it at the end of the string
+	SVC_ChallengeKey( challenge, sizeof( challenge ), Cmd_Argv(1), "" );
+
+	parts[0] = "infoResponse\n";
+	parts[1] = svcCache.info;
+	parts[2] = challenge;
+	SVC_SendResponse( from, parts, 3 );
+}
 
-	Info_SetValueForKey( infostring, "hostname", sv_hostname->string );
-	Info_SetValueForKey( infostring, "mapname", sv_mapname->string );
-	Info_SetValueForKey( infostring, "clients", va("%i", count) );
-	Info_SetValueForKey( infostring, "bots", va("%i", count - humans));
-	Info_SetValueForKey( infostring, "sv_maxclients", 
-		va("%i", sv_maxclients->integer - sv_privateClients->integer ) );
-	Info_SetValueForKey( infostring, "gametype", va("%i", sv_gametype->integer ) );
-	Info_SetValueForKey( infostring, "pure", va("%i", sv_pure->integer ) );
+/*
+================
+SVC_FlushRedirect
 
-	// UrT checks for "password" instead of "g_needpass"
-	if (Cvar_VariableValue("g_needpass") == 1)
-		Info_SetValueForKey(infostring, "password", "1");
+================
+*/
+static void SV_FlushRedirect( char *outputbuf ) {
+	NET_OutOfBandPrint( NS_SERVER, svs.redirectAddress, "print\n%s", outputbuf );
+}
 
-#ifdef USE_AUTH
-	Info_SetValueForKey( infostring, "auth", Cvar_VariableString("auth") );
-#endif
+/*
+=================
+SV_MaxPacketLength
 
-#ifdef USE_VOIP
-	if (sv_voipProtocol->string && *sv_voipProtocol->string) {
-		Info_SetValueForKey( infostring, "voip", sv_voipProtocol->string );
-	}
-#endif
+The largest datagram sv_mtu allows to adr, 0 if it keeps to MAX_PACKETLEN
+=================
+*/
+int SV_MaxPacketLength( netadr_t adr ) {
+	int		length;
 
-	if( sv_minPing->integer ) {
-		Info_SetValueForKey( infostring, "minPing", va("%i", sv_minPing->integer) );
-	}
-	if( sv_maxPing->integer ) {
-		Info_SetValueForKey( infostring, "maxPing", va("%i", sv_maxPing->integer) );
-	}
-	gamedir = Cvar_VariableString( "fs_game" );
-	if( *gamedir ) {
-		Info_SetValueForKey( infostring, "game", gamedir );
+	length = sv_mtu->integer - NET_UDP_HEADERS( adr.type );
+	if ( length <= MAX_PACKETLEN ) {
+		return 0;
 	}
 
-	Info_SetValueForKey(infostring, "modversion", Cvar_VariableString("g_modversion"));
-
-	NET_OutOfBandPrint( NS_SERVER, from, "infoResponse\n%s", infostring );
+	return MIN( length, NET_MAX_PACKETLEN );
 }
 
 /*
-================
-SVC_FlushRedirect
+=================
+SVC_MtuProbe
 
-================
+A client looking for the largest datagram that gets through to it and
+back. The probe comes back at the size it came in with, never larger,
+with the don't fragment bit set so that it doesn't make it in pieces.
+=================
 */
-static void SV_FlushRedirect( char *outputbuf ) {
-	NET_OutOfBandPrint( NS_SERVER, svs.redirectAddress, "print\n%s", outputbuf );
+static void SVC_MtuProbe( netadr_t from, msg_t *msg ) {
+	byte	probe[NET_MAX_PACKETLEN];
+	int		size;
+
+	size = atoi( Cmd_Argv( 1 ) );
+	if ( size <= MAX_PACKETLEN || size > msg->cursize || size > SV_MaxPacketLength( from ) ) {
+		return;
+	}
+
+	Com_Memset( probe, 0, size );
+	*(int *)probe = -1;
+	Com_sprintf( (char *)probe + 4, size - 4, "mtuprobe %i %s\n", size, Cmd_Argv( 2 ) );
+
+	Sys_SendProbePacket( size, probe, from );
 }
 
 /*
@@ -751,13 +1323,6 @@ static void SVC_RemoteCommand( netadr_t from, msg_t *msg ) {
 	char		sv_outputbuf[SV_OUTPUTBUF_LENGTH];
 	char *cmd_aux;
 
-	// Prevent using rcon as an amplifier and make dictionary attacks impractical
-	if ( SVC_RateLimitAddress( from, 10, 1000 ) ) {
-		Com_DPrintf( "SVC_RemoteCommand: rate limit from %s exceeded, dropping request\n",
-			NET_AdrToString( from ) );
-		return;
-	}
-
 	if ( !strlen( sv_rconPassword->string ) ||
 		strcmp (Cmd_Argv(1), sv_rconPassword->string) ) {
 		static leakyBucket_t bucket;
@@ -825,14 +1390,23 @@ connectionless packets.
 static void SV_ConnectionlessPacket( netadr_t from, msg_t *msg ) {
 	char	*s;
 	char	*c;
-#ifdef USE_AUTH
-	netadr_t	authServerIP;
-#endif
+	svcCommand_t	command, parsed;
+
+	// Prevent using getstatus and friends as amplifiers and make rcon
+	// dictionary attacks impractical, before paying for the parsing
+	command = SVC_CommandForPacket( msg );
+	if ( SVC_RateLimitCommand( from, command ) ) {
+		if ( com_developer->integer ) {
+			Com_Printf( "SV_ConnectionlessPacket: %s rate limit from %s exceeded, dropping request\n",
+				svcCommandLimits[ command ].name, NET_AdrToString( from ) );
+		}
+		return;
+	}
 
 	MSG_BeginReadingOOB( msg );
 	MSG_ReadLong( msg );		// skip the -1 marker
 
-	if (!Q_strncmp("connect", (char *) &msg->data[4], 7)) {
+	if ( command == SVC_CONNECT ) {
 		Huff_Decompress(msg, 12);
 	}
 
@@ -842,6 +1416,14 @@ static void SV_ConnectionlessPacket( netadr_t from, msg_t *msg ) {
 	c = Cmd_Argv(0);
 	Com_DPrintf ("SV packet %s : %s\n", NET_AdrToStringwPort(from), c);
 
+	// odd formatting the first look missed still gets limited
+	parsed = SVC_CommandForName( c );
+	if ( parsed != command && SVC_RateLimitCommand( from, parsed ) ) {
+		Com_DPrintf( "SV_ConnectionlessPacket: %s rate limit from %s exceeded, dropping request\n",
+			svcCommandLimits[ parsed ].name, NET_AdrToString( from ) );
+		return;
+	}
+
 	if (!Q_stricmp(c, "getstatus")) {
 		SVC_Status( from );
 	} else if (!Q_stricmp(c, "getinfo")) {
@@ -852,8 +1434,7 @@ static void SV_ConnectionlessPacket( netadr_t from, msg_t *msg ) {
 		SV_DirectConnect( from );
 #ifdef USE_AUTH
 	} else if ((!Q_stricmp(c, "AUTH:SV"))) {
-		NET_StringToAdr(sv_authServerIP->string, &authServerIP, NA_IP);
-		if (!NET_CompareBaseAdr(from, authServerIP)) {
+		if (!SV_AuthPacketFromServer(from)) {
 			Com_Printf("AUTH not from the Auth Server!\n");
 			return;
 		}
@@ -861,6 +1442,8 @@ static void SV_ConnectionlessPacket( netadr_t from, msg_t *msg ) {
 #endif
 	} else if (!Q_stricmp(c, "rcon")) {
 		SVC_RemoteCommand( from, msg );
+	} else if (!Q_stricmp(c, "mtuprobe")) {
+		SVC_MtuProbe( from, msg );
 	} else if (!Q_stricmp(c, "disconnect")) {
 		// if a client starts up a local server, we may see some spurious
 		// server disconnect messages when their new server sees our final
@@ -883,6 +1466,8 @@ void SV_PacketEvent( netadr_t from, msg_t *msg ) {
 	client_t	*cl;
 	int			qport;
 
+	SV_CapturePacket( &from, msg );
+
 	// check for connectionless packet (0xffffffff) first
 	if ( msg->cursize >= 4 && *(int *)msg->data == -1) {
 		SV_ConnectionlessPacket( from, msg );
@@ -944,7 +1529,7 @@ static void SV_CalcPings( void ) {
 	client_t	*cl;
 	int			count;
 	float		total;
-	int			delta;
+	float		delta;
 	playerState_t	*ps;
 
 	for (i=0 ; i < sv_maxclients->integer ; i++) {
@@ -968,7 +1553,7 @@ static void SV_CalcPings( void ) {
 			if ( cl->frames[j].messageAcked == 0 ) {
 				continue;
 			}
-			delta = cl->frames[j].messageAcked - cl->frames[j].messageSent;
+			delta = ( cl->frames[j].messageAcked - cl->frames[j].messageSent ) * 0.001f;
 			count++;
 			total += 1.0/(delta+0.1);  // average frequency (avoiding 0 division)
 		}
@@ -987,6 +1572,86 @@ static void SV_CalcPings( void ) {
 	}
 }
 
+/*
+===================
+SV_NetStatsRtt
+
+A round trip measured from an acknowledged snapshot
+===================
+*/
+void SV_NetStatsRtt( client_t *cl, int64_t rtt ) {
+	clientNetStats_t	*stats = &cl->netStats;
+	int64_t				change;
+
+	if ( rtt < 0 ) {
+		return;
+	}
+
+	if ( stats->lastRtt ) {
+		change = rtt - stats->lastRtt;
+		if ( change < 0 ) {
+			change = -change;
+		}
+		stats->jitter += ( change - stats->jitter ) / 16.0f;
+	}
+	stats->lastRtt = rtt ? rtt : 1;
+}
+
+/*
+===================
+SV_NetStatsFrame
+
+Closes the window of every client it's been a second for, what
+status net and the metrics show
+===================
+*/
+#define	NETSTATS_WINDOW_USEC	1000000
+
+static void SV_NetStatsFrame( void ) {
+	clientNetStats_t	*stats;
+	client_t			*cl;
+	int64_t				now, elapsed;
+	int					i, in, lost, snapshots, choked;
+
+	now = Sys_Microseconds();
+
+	for ( i = 0, cl = svs.clients ; i < sv_maxclients->integer ; i++, cl++ ) {
+		if ( cl->state < CS_CONNECTED ) {
+			continue;
+		}
+		stats = &cl->netStats;
+
+		if ( !stats->windowStart ) {
+			stats->windowStart = now;
+			continue;
+		}
+		elapsed = now - stats->windowStart;
+		if ( elapsed < NETSTATS_WINDOW_USEC ) {
+			continue;
+		}
+
+		in = cl->packetsIn - stats->packetsIn;
+		lost = cl->packetsLost - stats->packetsLost;
+		snapshots = cl->snapshotsSent - stats->snapshots;
+		choked = cl->snapshotsChoked - stats->choked;
+
+		stats->loss = in + lost ? (float)lost / ( in + lost ) : 0;
+		stats->choke = snapshots + choked ? (float)choked / ( snapshots + choked ) : 0;
+		stats->bytesInRate = (int)( ( cl->bytesIn - stats->bytesIn ) * 1000000 / elapsed );
+		stats->bytesOutRate = (int)( ( cl->bytesOut - stats->bytesOut ) * 1000000 / elapsed );
+
+		SV_AdaptSnapshotRate( cl, (int)( (int64_t)snapshots * 1000000 / elapsed ) );
+
+		stats->windowStart = now;
+		stats->packetsIn = cl->packetsIn;
+		stats->packetsLost = cl->packetsLost;
+		stats->snapshots = cl->snapshotsSent;
+		stats->choked = cl->snapshotsChoked;
+		stats->bytesIn = cl->bytesIn;
+		stats->bytesOut = cl->bytesOut;
+	}
+}
+
 /*
 ==================
 SV_CheckTimeouts
@@ -1070,6 +1735,72 @@ static qboolean SV_CheckPaused( void ) {
 	return qtrue;
 }
 
+/*
+==================
+SV_UpdateIdle
+
+A dedicated server without players for sv_idleTime seconds idles: Com_Frame
+only wakes it sv_idleFps times a second or when a packet comes in, and
+SV_Frame runs a single game frame per wake, or none with sv_idlePause.
+svs.time still follows the real time for the timeouts and heartbeats.
+==================
+*/
+static void SV_UpdateIdle( int frameMsec ) {
+	client_t	*cl;
+	qboolean	players;
+	int			i, now;
+
+	players = qfalse;
+	for ( i = 0, cl = svs.clients ; i < sv_maxclients->integer ; i++, cl++ ) {
+		if ( cl->state >= CS_CONNECTED && cl->netchan.remoteAddress.type != NA_BOT ) {
+			players = qtrue;
+			break;
+		}
+	}
+
+	now = Sys_Milliseconds();
+
+	if ( players || !com_dedicated->integer || sv_idleTime->integer <= 0 ) {
+		svs.lastPlayerTime = now;
+
+		if ( svs.idle ) {
+			svs.idle = qfalse;
+			Com_Printf( "Player connecting, leaving idle mode\n" );
+
+			// the game doesn't catch up on the time it was idle
+			if ( sv.timeResidual > frameMsec ) {
+				svs.time += sv.timeResidual - frameMsec;
+				sv.timeResidual = frameMsec;
+			}
+		}
+		return;
+	}
+
+	if ( !svs.idle && now - svs.lastPlayerTime >= sv_idleTime->integer * 1000 ) {
+		svs.idle = qtrue;
+		Com_Printf( "No players for %i seconds, going idle\n", sv_idleTime->integer );
+	}
+}
+
+/*
+==================
+SV_Idle
+==================
+*/
+qboolean SV_Idle( void ) {
+	return com_sv_running->integer && svs.idle;
+}
+
+/*
+==================
+SV_IdleMsec
+Return the time in milliseconds between frames while idle.
+==================
+*/
+int SV_IdleMsec( void ) {
+	return MAX( 1000 / sv_idleFps->integer, SV_TickMsec() );
+}
+
 /*
 ==================
 SV_FrameMsec
@@ -1093,6 +1824,26 @@ int SV_FrameMsec()
 		return 1;
 }
 
+/*
+==================
+SV_TickMsec
+Return the length of one server frame in milliseconds.
+==================
+*/
+int SV_TickMsec(void)
+{
+	int frameMsec;
+
+	if(!sv_fps || sv_fps->integer < 1)
+		return 1;
+
+	frameMsec = 1000 / sv_fps->integer;
+	if(frameMsec < 1)
+		frameMsec = 1;
+
+	return frameMsec;
+}
+
 /*
 ==================
 SV_Frame
@@ -1103,7 +1854,9 @@ happen before SV_Frame is called
 */
 void SV_Frame( int msec ) {
 	int		frameMsec;
-	int		startTime;
+	int64_t	startTime;
+	qboolean	runGame;
+	int64_t	frameStart, stageStart, metricsStart;
 
 	// the menu kills the server with this cvar
 	if ( sv_killserver->integer ) {
@@ -1112,6 +1865,8 @@ void SV_Frame( int msec ) {
 		return;
 	}
 
+	SV_ReapZygoteChildren();
+
 	if (!com_sv_running->integer)
 	{
 		// Running as a server, but no map loaded
@@ -1123,6 +1878,8 @@ void SV_Frame( int msec ) {
 		return;
 	}
 
+	SV_CaptureFrame( msec );
+
 	// allow pause if only the local client is connected
 	if ( SV_CheckPaused() ) {
 		return;
@@ -1143,6 +1900,8 @@ void SV_Frame( int msec ) {
 
 	sv.timeResidual += msec;
 
+	SV_UpdateIdle( frameMsec );
+
 	if (!com_dedicated->integer) SV_BotFrame (sv.time + sv.timeResidual);
 
 	// if time is about to hit the 32nd bit, kick all clients
@@ -1154,12 +1913,6 @@ void SV_Frame( int msec ) {
 		Cbuf_AddText( va( "map %s\n", Cvar_VariableString( "mapname" ) ) );
 		return;
 	}
-	// this can happen considerably earlier when lots of clients play and the map doesn't change
-	if ( svs.nextSnapshotEntities >= 0x7FFFFFFE - svs.numSnapshotEntities ) {
-		SV_Shutdown( "Restarting server due to numSnapshotEntities wrapping" );
-		Cbuf_AddText( va( "map %s\n", Cvar_VariableString( "mapname" ) ) );
-		return;
-	}
 
 	if( sv.restartTime && sv.time >= sv.restartTime ) {
 		sv.restartTime = 0;
@@ -1168,77 +1921,146 @@ void SV_Frame( int msec ) {
 	}
 
 	// update infostrings if anything has been changed
-	if ( cvar_modifiedFlags & CVAR_SERVERINFO ) {
-		SV_SetConfigstring( CS_SERVERINFO, Cvar_InfoString( CVAR_SERVERINFO ) );
-		cvar_modifiedFlags &= ~CVAR_SERVERINFO;
+	if ( sv_infoChanged & CVAR_SERVERINFO ) {
+		SV_SetConfigstring( CS_SERVERINFO, sv_serverInfo );
 	}
-	if ( cvar_modifiedFlags & CVAR_SYSTEMINFO ) {
-		SV_SetConfigstring( CS_SYSTEMINFO, Cvar_InfoString_Big( CVAR_SYSTEMINFO ) );
-		cvar_modifiedFlags &= ~CVAR_SYSTEMINFO;
+	if ( sv_infoChanged & CVAR_SYSTEMINFO ) {
+		SV_SetConfigstring( CS_SYSTEMINFO, sv_systemInfo );
 	}
+	sv_infoChanged = 0;
+
+	// simulated clients send their usercmds
+	SV_LoadTestFrame( msec );
 
 	if ( com_speeds->integer ) {
-		startTime = Sys_Milliseconds ();
+		startTime = Sys_Microseconds();
 	} else {
 		startTime = 0;	// quite a compiler warning
 	}
 
+	frameStart = SV_ProfileStart();
+	metricsStart = SV_MetricsStart();
+
 	// update ping based on the all received frames
+	stageStart = SV_ProfileStart();
 	SV_CalcPings();
+	SV_ProfileEnd( SVPROF_CALCPINGS, stageStart );
+
+	// loss, choke and bandwidth over the last second
+	SV_NetStatsFrame();
 
 	if (com_dedicated->integer) SV_BotFrame (sv.time);
 
+#ifdef USE_SKEETMOD
+	// resolve the shots fired since the last frame before the skeets move on
+	stageStart = SV_ProfileStart();
+	SV_SkeetShootFrame();
+	SV_ProfileEnd( SVPROF_SKEET, stageStart );
+#endif
+
+	// idle, a single game frame once an idle frame has passed, packets
+	// waking the server in between don't run any, and the rest of the
+	// time only moves svs.time on
+	runGame = qtrue;
+	if ( svs.idle ) {
+		if ( sv_idlePause->integer ) {
+			svs.time += sv.timeResidual;
+			sv.timeResidual = 0;
+		} else if ( sv.timeResidual >= SV_IdleMsec() ) {
+			svs.time += sv.timeResidual - frameMsec;
+			sv.timeResidual = frameMsec;
+		} else {
+			runGame = qfalse;
+		}
+	}
+
 	// run the game simulation in chunks
-	while ( sv.timeResidual >= frameMsec ) {
+	while ( runGame && sv.timeResidual >= frameMsec ) {
 		sv.timeResidual -= frameMsec;
 		svs.time += frameMsec;
 		sv.time += frameMsec;
 
 		// let everything in the world think and move
+		SV_InvalidateTraceCache();
+		stageStart = SV_ProfileStart();
 		VM_Call (gvm, GAME_RUN_FRAME, sv.time);
+		SV_ProfileEnd( SVPROF_GAME, stageStart );
+
+		// remember where everything is for lag compensated traces
+		SV_RecordEntityHistory();
 	}
 
 	if ( com_speeds->integer ) {
-		time_game = Sys_Milliseconds () - startTime;
+		time_game = Sys_Microseconds() - startTime;
+		if ( sv_traceCache->integer ) {
+			SV_TraceCacheStats();
+		}
 	}
 
 	// check timeouts
+	stageStart = SV_ProfileStart();
 	SV_CheckTimeouts();
+	SV_ProfileEnd( SVPROF_TIMEOUTS, stageStart );
 
 	// check user info buffer thingy
 	SV_CheckClientUserinfoTimer();
 
+	// record the frame for the world demo, if any
+	SVD_WorldDemoFrame();
+
 	// send messages back to the clients
+	stageStart = SV_ProfileStart();
 	SV_SendClientMessages();
+	SV_ProfileEnd( SVPROF_SEND, stageStart );
 
 	// send a heartbeat to the master if needed
+	stageStart = SV_ProfileStart();
 	SV_MasterHeartbeat(HEARTBEAT_FOR_MASTER);
+	SV_ProfileEnd( SVPROF_HEARTBEAT, stageStart );
 
 #ifdef USE_SKEETMOD
 	// advance skeets
+	stageStart = SV_ProfileStart();
 	SV_SkeetThink();
+	SV_ProfileEnd( SVPROF_SKEET, stageStart );
 #endif
 
+	// let the log and demo writers catch up
+	SV_LogFrame();
+	SVD_WriterFrame();
+
+	// read the next map ahead near the end of this one
+	SV_PrefetchFrame();
+
+	// follow sv_httpPort
+	SV_HttpFrame();
+
+	// swap in bans loaded by rehashbans
+	SV_BansFrame();
+
+	SV_ProfileFrame( frameStart, frameMsec );
+
+	// time the frame and publish /metrics
+	SV_MetricsFrame( metricsStart, frameMsec );
 }
 
 /*
 ====================
-SV_RateMsec
+SV_ClientRate
 
-Return the number of msec until another message can be sent to
-a client based on its rate settings
+The rate in bytes per second a client is sent at, after sv_maxRate and
+sv_minRate
 ====================
 */
 
 #define UDPIP_HEADER_SIZE 28
 #define UDPIP6_HEADER_SIZE 48
+#define RATE_BURST_MSEC 50		// how much unused rate a client can save up
 
-int SV_RateMsec(client_t *client)
+int SV_ClientRate(client_t *client)
 {
-	int rate, rateMsec;
-	int messageSize;
-	
-	messageSize = client->netchan.lastSentSize;
+	int rate;
+
 	rate = client->rate;
 
 	if(sv_maxRate->integer)
@@ -1257,18 +2079,90 @@ int SV_RateMsec(client_t *client)
 			rate = sv_minRate->integer;
 	}
 
+	rate = (int) (rate * com_timescale->value);
+	if(rate < 1)
+		rate = 1;
+
+	return rate;
+}
+
+/*
+====================
+SV_RateRefill
+
+Every client has a token bucket of bytes it may be sent, filled at its
+rate and holding at most RATE_BURST_MSEC worth of it
+====================
+*/
+static void SV_RateRefill(client_t *client, int rate)
+{
+	int64_t now, elapsed;
+	int gained, burst;
+
+	now = Sys_Microseconds();
+	elapsed = now - client->rateTime;
+	if(elapsed > 1000000 || elapsed < 0)
+		elapsed = 1000000;
+
+	// keep the fraction of a byte for the next refill at low rates
+	gained = (int) (rate * elapsed / 1000000);
+	if(gained > 0)
+	{
+		client->rateTokens += gained;
+		client->rateTime = now;
+	}
+
+	burst = rate * RATE_BURST_MSEC / 1000;
+	if(client->rateTokens > burst)
+		client->rateTokens = burst;
+}
+
+/*
+====================
+SV_RateSent
+
+Charges the datagram the netchan just sent to the client, and counts it
+====================
+*/
+void SV_RateSent(client_t *client)
+{
+	int messageSize;
+
+	SV_RateRefill(client, SV_ClientRate(client));
+
+	messageSize = client->netchan.lastSentSize;
 	if(client->netchan.remoteAddress.type == NA_IP6)
 		messageSize += UDPIP6_HEADER_SIZE;
 	else
 		messageSize += UDPIP_HEADER_SIZE;
-		
-	rateMsec = messageSize * 1000 / ((int) (rate * com_timescale->value));
-	rate = Sys_Milliseconds() - client->netchan.lastSentTime;
-	
-	if(rate > rateMsec)
+
+	client->rateTokens -= messageSize;
+
+	client->packetsOut++;
+	client->bytesOut += messageSize;
+	svMetrics[SVM_PACKETS_OUT]++;
+	svMetrics[SVM_BYTES_OUT] += messageSize;
+}
+
+/*
+====================
+SV_RateMsec
+
+Return the number of msec until another message can be sent to
+a client based on its rate settings
+====================
+*/
+int SV_RateMsec(client_t *client)
+{
+	int rate;
+
+	rate = SV_ClientRate(client);
+	SV_RateRefill(client, rate);
+
+	if(client->rateTokens >= 0)
 		return 0;
-	else
-		return rateMsec - rate;
+
+	return (-client->rateTokens * 1000 + rate - 1) / rate;
 }
 
 /*
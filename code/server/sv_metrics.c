@@ -0,0 +1,319 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_metrics.c -- Prometheus metrics, served by sv_http.c on /metrics
+
+#include "server.h"
+
+/*
+The counters are bumped where things happen: the netchan wrappers count
+every client datagram in and out, SV_AddServerCommand and the snapshot
+writer count overflows, and the connectionless commands already keep
+their accepted and dropped counts for packetstats. With sv_metrics set,
+every SV_Frame is timed into a fixed histogram too.
+
+Once a second the main thread writes all of it out in the Prometheus text
+format and hands the text to the HTTP thread, which answers a scrape of
+/metrics with it and its own download counters. A scrape never touches
+the game state and is at most a second stale.
+*/
+
+#define	METRICS_TEXT_SIZE		( 128 * 1024 )
+#define	METRICS_INTERVAL_MSEC	1000
+
+// upper bounds of the frame time buckets, in usec
+static const int metricsFrameBounds[] = {
+	500, 1000, 2000, 4000, 8000, 16000, 33000, 50000, 100000, 250000, 1000000
+};
+
+#define	METRICS_FRAME_BUCKETS	ARRAY_LEN( metricsFrameBounds )
+
+int64_t	svMetrics[SVM_NUM_METRICS];
+
+static struct {
+	int			frames;
+	int64_t		frameUsec;
+	int			frameBuckets[METRICS_FRAME_BUCKETS];	// not cumulative
+	int			overBudget;
+
+	int			lastWrite;
+	qboolean	published;
+
+	char		text[METRICS_TEXT_SIZE];
+	int			length;
+	qboolean	full;
+} metrics;
+
+/*
+==================
+SV_MetricsPrintf
+==================
+*/
+static void QDECL SV_MetricsPrintf( const char *fmt, ... ) __attribute__ ((format (printf, 1, 2)));
+static void QDECL SV_MetricsPrintf( const char *fmt, ... ) {
+	va_list		argptr;
+	int			len;
+
+	if ( metrics.full ) {
+		return;
+	}
+
+	va_start( argptr, fmt );
+	len = Q_vsnprintf( metrics.text + metrics.length, sizeof( metrics.text ) - metrics.length, fmt, argptr );
+	va_end( argptr );
+
+	// a line that didn't fit is cut off, and everything after it
+	if ( len < 0 || metrics.length + len >= sizeof( metrics.text ) ) {
+		metrics.text[metrics.length] = 0;
+		metrics.full = qtrue;
+		return;
+	}
+	metrics.length += len;
+}
+
+/*
+==================
+SV_MetricsFamily
+==================
+*/
+static void SV_MetricsFamily( const char *name, const char *type, const char *help ) {
+	SV_MetricsPrintf( "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type );
+}
+
+/*
+==================
+SV_MetricsValue
+==================
+*/
+static void SV_MetricsValue( const char *name, const char *type, const char *help, int64_t value ) {
+	SV_MetricsFamily( name, type, help );
+	SV_MetricsPrintf( "%s %lld\n", name, (long long)value );
+}
+
+/*
+==================
+SV_MetricsClientLabels
+
+slot and name of a client, the name without colors and escaped
+==================
+*/
+static void SV_MetricsClientLabels( char *out, int outSize, int slot, const client_t *cl ) {
+	char	name[MAX_NAME_LENGTH];
+	char	escaped[MAX_NAME_LENGTH * 2];
+	int		i, o;
+
+	Q_strncpyz( name, cl->name, sizeof( name ) );
+	Q_CleanStr( name );
+
+	for ( i = 0, o = 0 ; name[i] && o < sizeof( escaped ) - 2 ; i++ ) {
+		if ( name[i] == '\\' || name[i] == '"' ) {
+			escaped[o++] = '\\';
+		}
+		escaped[o++] = name[i];
+	}
+	escaped[o] = 0;
+
+	Com_sprintf( out, outSize, "slot=\"%i\",name=\"%s\"", slot, escaped );
+}
+
+/*
+==================
+SV_MetricsClients
+
+One family at a time, as the text format wants all lines of a family
+together
+==================
+*/
+static void SV_MetricsClients( void ) {
+	static const struct {
+		const char	*name;
+		const char	*type;
+		const char	*help;
+	} families[] = {
+		{ "urt_client_ping_milliseconds", "gauge", "Ping of the client as the game sees it" },
+		{ "urt_client_rate_bytes", "gauge", "Bytes per second the client is sent at, after sv_minRate and sv_maxRate" },
+		{ "urt_client_received_packets_total", "counter", "Datagrams received from the client" },
+		{ "urt_client_lost_packets_total", "counter", "Datagrams from the client that never arrived" },
+		{ "urt_client_received_bytes_total", "counter", "Bytes received from the client" },
+		{ "urt_client_sent_packets_total", "counter", "Datagrams sent to the client" },
+		{ "urt_client_sent_bytes_total", "counter", "Bytes sent to the client, with UDP/IP headers" },
+		{ "urt_client_snapshots_total", "counter", "Snapshots sent to the client" },
+		{ "urt_client_choked_snapshots_total", "counter", "Server frames a snapshot due for the client was held back by its rate or fragments" },
+		{ "urt_client_jitter_seconds", "gauge", "Mean change between round trips of the client, as in RFC 3550" },
+		{ "urt_client_loss_ratio", "gauge", "Client packets lost over the last second" },
+		{ "urt_client_choke_ratio", "gauge", "Due snapshots held back over the last second" }
+	};
+	char		labels[MAX_NAME_LENGTH * 2 + 32];
+	char		value[32];
+	client_t	*cl;
+	int			f, i;
+
+	for ( f = 0 ; f < ARRAY_LEN( families ) ; f++ ) {
+		SV_MetricsFamily( families[f].name, families[f].type, families[f].help );
+
+		for ( i = 0, cl = svs.clients ; i < sv_maxclients->integer ; i++, cl++ ) {
+			if ( cl->state < CS_CONNECTED || cl->netchan.remoteAddress.type == NA_BOT ) {
+				continue;
+			}
+
+			switch ( f ) {
+			case 0: Com_sprintf( value, sizeof( value ), "%i", cl->ping ); break;
+			case 1: Com_sprintf( value, sizeof( value ), "%i", SV_ClientRate( cl ) ); break;
+			case 2: Com_sprintf( value, sizeof( value ), "%i", cl->packetsIn ); break;
+			case 3: Com_sprintf( value, sizeof( value ), "%i", cl->packetsLost ); break;
+			case 4: Com_sprintf( value, sizeof( value ), "%lld", (long long)cl->bytesIn ); break;
+			case 5: Com_sprintf( value, sizeof( value ), "%i", cl->packetsOut ); break;
+			case 6: Com_sprintf( value, sizeof( value ), "%lld", (long long)cl->bytesOut ); break;
+			case 7: Com_sprintf( value, sizeof( value ), "%i", cl->snapshotsSent ); break;
+			case 8: Com_sprintf( value, sizeof( value ), "%i", cl->snapshotsChoked ); break;
+			case 9: Com_sprintf( value, sizeof( value ), "%.6f", cl->netStats.jitter * 0.000001 ); break;
+			case 10: Com_sprintf( value, sizeof( value ), "%.4f", cl->netStats.loss ); break;
+			default: Com_sprintf( value, sizeof( value ), "%.4f", cl->netStats.choke ); break;
+			}
+
+			SV_MetricsClientLabels( labels, sizeof( labels ), i, cl );
+			SV_MetricsPrintf( "%s{%s} %s\n", families[f].name, labels, value );
+		}
+	}
+}
+
+/*
+==================
+SV_MetricsWrite
+==================
+*/
+static void SV_MetricsWrite( void ) {
+	const char	*name;
+	int			accepted, dropped;
+	int			hunkUsed, hunkTotal, zoneUsed, zoneTotal;
+	int			i, count, active;
+
+	metrics.length = 0;
+	metrics.text[0] = 0;
+	metrics.full = qfalse;
+
+	SV_MetricsFamily( "urt_frame_seconds", "histogram", "Time taken by SV_Frame" );
+	for ( i = 0, count = 0 ; i < METRICS_FRAME_BUCKETS ; i++ ) {
+		count += metrics.frameBuckets[i];
+		SV_MetricsPrintf( "urt_frame_seconds_bucket{le=\"%g\"} %i\n", metricsFrameBounds[i] * 0.000001, count );
+	}
+	SV_MetricsPrintf( "urt_frame_seconds_bucket{le=\"+Inf\"} %i\n", metrics.frames );
+	SV_MetricsPrintf( "urt_frame_seconds_sum %.6f\n", metrics.frameUsec * 0.000001 );
+	SV_MetricsPrintf( "urt_frame_seconds_count %i\n", metrics.frames );
+	SV_MetricsValue( "urt_frames_over_budget_total", "counter", "Frames that took longer than 1000 / sv_fps", metrics.overBudget );
+
+	active = 0;
+	for ( i = 0 ; i < sv_maxclients->integer ; i++ ) {
+		if ( svs.clients[i].state == CS_ACTIVE ) {
+			active++;
+		}
+	}
+	SV_MetricsValue( "urt_clients", "gauge", "Clients in the game", active );
+	SV_MetricsValue( "urt_max_clients", "gauge", "sv_maxclients", sv_maxclients->integer );
+	SV_MetricsValue( "urt_idle", "gauge", "1 while the server is idle for sv_idleTime", svs.idle );
+
+	SV_MetricsValue( "urt_received_packets_total", "counter", "Client datagrams received", svMetrics[SVM_PACKETS_IN] );
+	SV_MetricsValue( "urt_received_bytes_total", "counter", "Client datagram bytes received", svMetrics[SVM_BYTES_IN] );
+	SV_MetricsValue( "urt_lost_packets_total", "counter", "Client datagrams that never arrived", svMetrics[SVM_PACKETS_LOST] );
+	SV_MetricsValue( "urt_sent_packets_total", "counter", "Client datagrams sent", svMetrics[SVM_PACKETS_OUT] );
+	SV_MetricsValue( "urt_sent_bytes_total", "counter", "Client datagram bytes sent, with UDP/IP headers", svMetrics[SVM_BYTES_OUT] );
+	SV_MetricsValue( "urt_reliable_overflows_total", "counter", "Clients dropped for a server command overflow", svMetrics[SVM_RELIABLE_OVERFLOWS] );
+	SV_MetricsValue( "urt_snapshot_overflows_total", "counter", "Snapshots that overflowed the message", svMetrics[SVM_SNAPSHOT_OVERFLOWS] );
+
+	SV_MetricsFamily( "urt_connectionless_total", "counter", "Connectionless packets by command, accepted or dropped by the rate limits" );
+	for ( i = 0 ; ( name = SVC_CommandCounts( i, &accepted, &dropped ) ) != NULL ; i++ ) {
+		SV_MetricsPrintf( "urt_connectionless_total{command=\"%s\",result=\"accepted\"} %i\n", name, accepted );
+		SV_MetricsPrintf( "urt_connectionless_total{command=\"%s\",result=\"dropped\"} %i\n", name, dropped );
+	}
+
+	SV_MetricsClients();
+
+	Com_MemoryUsage( &hunkUsed, &hunkTotal, &zoneUsed, &zoneTotal );
+	SV_MetricsValue( "urt_hunk_used_bytes", "gauge", "Hunk in use", hunkUsed );
+	SV_MetricsValue( "urt_hunk_size_bytes", "gauge", "Hunk allocated", hunkTotal );
+	SV_MetricsValue( "urt_zone_used_bytes", "gauge", "Zone in use", zoneUsed );
+	SV_MetricsValue( "urt_zone_size_bytes", "gauge", "Zone allocated", zoneTotal );
+}
+
+/*
+==================
+SV_MetricsStart
+
+Returns 0 when metrics are off, so SV_MetricsFrame doesn't time the frame
+==================
+*/
+int64_t SV_MetricsStart( void ) {
+	if ( !sv_metrics->integer ) {
+		return 0;
+	}
+	return Sys_Microseconds();
+}
+
+/*
+==================
+SV_MetricsFrame
+
+Times the frame and hands the text to the HTTP server once a second
+==================
+*/
+void SV_MetricsFrame( int64_t start, int frameMsec ) {
+	int64_t		usec;
+	int			i, now;
+
+	if ( sv_metrics->modified ) {
+		sv_metrics->modified = qfalse;
+		if ( sv_metrics->integer && !sv_httpPort->integer ) {
+			Com_Printf( S_COLOR_YELLOW "WARNING: sv_metrics is served on sv_httpPort, which is 0\n" );
+		}
+	}
+
+	if ( !sv_metrics->integer ) {
+		if ( metrics.published ) {
+			SV_HttpSetMetrics( NULL, 0 );
+			metrics.published = qfalse;
+		}
+		return;
+	}
+
+	if ( start ) {
+		usec = Sys_Microseconds() - start;
+		metrics.frames++;
+		metrics.frameUsec += usec;
+		for ( i = 0 ; i < METRICS_FRAME_BUCKETS - 1 && usec > metricsFrameBounds[i] ; i++ ) {
+		}
+		if ( usec <= metricsFrameBounds[i] ) {
+			metrics.frameBuckets[i]++;
+		}
+		if ( usec > frameMsec * 1000 ) {
+			metrics.overBudget++;
+		}
+	}
+
+	now = Sys_Milliseconds();
+	if ( metrics.published && now - metrics.lastWrite < METRICS_INTERVAL_MSEC ) {
+		return;
+	}
+	metrics.lastWrite = now;
+
+	SV_MetricsWrite();
+	SV_HttpSetMetrics( metrics.text, metrics.length );
+	metrics.published = qtrue;
+}
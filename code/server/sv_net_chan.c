@@ -170,6 +170,7 @@ void SV_Netchan_TransmitNextInQueue(client_t *client)
 #endif
 
 	Netchan_Transmit(&client->netchan, netbuf->msg.cursize, netbuf->msg.data);
+	SV_RateSent(client);
 
 	// pop from queue
 	client->netchan_start_queue = netbuf->next;
@@ -198,6 +199,7 @@ int SV_Netchan_TransmitNextFragment(client_t *client)
 	if(client->netchan.unsentFragments)
 	{
 		Netchan_TransmitNextFragment(&client->netchan);
+		SV_RateSent(client);
 		return SV_RateMsec(client);
 	}
 	else if(client->netchan_start_queue)
@@ -251,6 +253,7 @@ void SV_Netchan_Transmit( client_t *client, msg_t *msg)
 			SV_Netchan_Encode(client, msg, client->lastClientCommandString);
 #endif
 		Netchan_Transmit( &client->netchan, msg->cursize, msg->data );
+		SV_RateSent(client);
 	}
 }
 
@@ -265,6 +268,13 @@ qboolean SV_Netchan_Process( client_t *client, msg_t *msg ) {
 	if (!ret)
 		return qfalse;
 
+	client->packetsIn++;
+	client->packetsLost += client->netchan.dropped;
+	client->bytesIn += msg->cursize;
+	svMetrics[SVM_PACKETS_IN]++;
+	svMetrics[SVM_PACKETS_LOST] += client->netchan.dropped;
+	svMetrics[SVM_BYTES_IN] += msg->cursize;
+
 #ifdef LEGACY_PROTOCOL
 	if(client->compat)
 		SV_Netchan_Decode(client, msg);
@@ -0,0 +1,372 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_prefetch.c -- reads the next map's files ahead of the map change
+
+#include "server.h"
+
+/*
+sv_mapPrefetch seconds before the timelimit runs out, the pk3s (or loose
+files) holding the next map's BSP and AAS are read through once from a
+thread, so they are in the OS page cache when SV_SpawnServer loads them.
+The next map is g_nextmap if it is set, then g_nextCycleMap, then the
+one after the current map in the g_mapcycle file. Without a thread the
+reading is spread over SV_PrefetchFrame calls.
+
+The steps of SV_SpawnServer can't run as jobs beside each other: the game
+is spawned on the collision map, it loads the AAS itself through botlib
+once it runs, and all of them go through the file system and the hunk,
+which belong to the main thread. What does overlap is the reading: when
+a map loads that wasn't prefetched, the thread reads the AAS while the
+BSP is loaded and the game module started, and a prefetch of the map
+that is still under way is kept instead of stopped.
+*/
+
+#define	MAX_PREFETCH_FILES		2
+#define	PREFETCH_CHUNK			( 64 * 1024 )
+#define	PREFETCH_FRAME_BYTES	( 1024 * 1024 )		// read per frame without a thread
+
+typedef struct {
+	char			map[MAX_QPATH];
+	char			paths[MAX_PREFETCH_FILES][MAX_OSPATH];
+	int				numPaths;
+
+	// owned by the thread while it runs
+	int				current;
+	FILE			*file;
+	byte			*buffer;
+
+	sysThread_t		*thread;
+	qboolean		quit;
+	qboolean		reading;		// from SV_PrefetchFrame
+
+	qboolean		started;		// for this map
+	int				startTime;		// sv.time the timelimit counts from
+} svPrefetch_t;
+
+static svPrefetch_t	svPrefetch;
+
+/*
+==================
+SV_PrefetchRead
+
+Reads up to maxBytes, returns qtrue once every file has been read
+==================
+*/
+static qboolean SV_PrefetchRead( svPrefetch_t *prefetch, int maxBytes ) {
+	int		length;
+
+	while ( maxBytes > 0 && prefetch->current < prefetch->numPaths ) {
+		if ( !prefetch->file ) {
+			prefetch->file = Sys_FOpen( prefetch->paths[prefetch->current], "rb" );
+			if ( !prefetch->file ) {
+				prefetch->current++;
+				continue;
+			}
+		}
+
+		length = fread( prefetch->buffer, 1, PREFETCH_CHUNK, prefetch->file );
+		maxBytes -= PREFETCH_CHUNK;
+
+		if ( length < PREFETCH_CHUNK ) {
+			fclose( prefetch->file );
+			prefetch->file = NULL;
+			prefetch->current++;
+		}
+	}
+
+	return prefetch->current >= prefetch->numPaths;
+}
+
+/*
+==================
+SV_PrefetchThread
+==================
+*/
+static void SV_PrefetchThread( void *arg ) {
+	svPrefetch_t	*prefetch = arg;
+
+	while ( !prefetch->quit && !SV_PrefetchRead( prefetch, PREFETCH_CHUNK ) ) {
+	}
+}
+
+/*
+==================
+SV_PrefetchStop
+==================
+*/
+static void SV_PrefetchStop( void ) {
+	if ( svPrefetch.thread ) {
+		svPrefetch.quit = qtrue;
+		Sys_JoinThread( svPrefetch.thread );
+		svPrefetch.thread = NULL;
+		svPrefetch.quit = qfalse;
+	}
+
+	if ( svPrefetch.file ) {
+		fclose( svPrefetch.file );
+		svPrefetch.file = NULL;
+	}
+	if ( svPrefetch.buffer ) {
+		Z_Free( svPrefetch.buffer );
+		svPrefetch.buffer = NULL;
+	}
+
+	svPrefetch.numPaths = 0;
+	svPrefetch.current = 0;
+	svPrefetch.reading = qfalse;
+}
+
+/*
+==================
+SV_PrefetchAddFile
+==================
+*/
+static void SV_PrefetchAddFile( const char *filename ) {
+	char	ospath[MAX_OSPATH];
+	int		i;
+
+	if ( svPrefetch.numPaths == MAX_PREFETCH_FILES || !FS_OSPathForFile( filename, ospath, sizeof( ospath ) ) ) {
+		return;
+	}
+
+	// the BSP and AAS usually come in the same pk3
+	for ( i = 0 ; i < svPrefetch.numPaths ; i++ ) {
+		if ( !strcmp( svPrefetch.paths[i], ospath ) ) {
+			return;
+		}
+	}
+
+	Q_strncpyz( svPrefetch.paths[svPrefetch.numPaths], ospath, sizeof( svPrefetch.paths[0] ) );
+	svPrefetch.numPaths++;
+}
+
+/*
+==================
+SV_PrefetchStart
+==================
+*/
+static void SV_PrefetchStart( const char *map ) {
+	SV_PrefetchStop();
+
+	svPrefetch.started = qtrue;
+	Q_strncpyz( svPrefetch.map, map, sizeof( svPrefetch.map ) );
+
+	SV_PrefetchAddFile( va( "maps/%s.bsp", map ) );
+	SV_PrefetchAddFile( va( "maps/%s.aas", map ) );
+
+	if ( !svPrefetch.numPaths ) {
+		Com_Printf( "Can't prefetch map %s, it isn't on the search path\n", map );
+		return;
+	}
+
+	Com_Printf( "Prefetching map %s\n", map );
+
+	svPrefetch.buffer = Z_Malloc( PREFETCH_CHUNK );
+	svPrefetch.thread = Sys_CreateThread( SV_PrefetchThread, &svPrefetch );
+	if ( !svPrefetch.thread ) {
+		svPrefetch.reading = qtrue;
+	}
+}
+
+/*
+==================
+SV_PrefetchLoad
+
+Reads the AAS of the map SV_SpawnServer is about to load, the BSP is read
+right away anyway. Only from a thread, in frames it would come too late.
+==================
+*/
+static void SV_PrefetchLoad( const char *map ) {
+	// a prefetch of this map carries on under the load
+	if ( svPrefetch.thread && !Q_stricmp( svPrefetch.map, map ) ) {
+		return;
+	}
+
+	SV_PrefetchStop();
+
+	Q_strncpyz( svPrefetch.map, map, sizeof( svPrefetch.map ) );
+	SV_PrefetchAddFile( va( "maps/%s.aas", map ) );
+	if ( !svPrefetch.numPaths ) {
+		return;
+	}
+
+	svPrefetch.buffer = Z_Malloc( PREFETCH_CHUNK );
+	svPrefetch.thread = Sys_CreateThread( SV_PrefetchThread, &svPrefetch );
+	if ( !svPrefetch.thread ) {
+		SV_PrefetchStop();
+	}
+}
+
+/*
+==================
+SV_PrefetchNextMap
+
+Returns NULL if there is no telling
+==================
+*/
+static const char *SV_PrefetchNextMap( void ) {
+	static char	map[MAX_QPATH];
+	char		first[MAX_QPATH];
+	const char	*cycle, *token;
+	char		*buffer, *p;
+	qboolean	found;
+
+	token = Cvar_VariableString( "g_nextmap" );
+	if ( !token[0] ) {
+		token = Cvar_VariableString( "g_nextCycleMap" );
+	}
+	if ( token[0] ) {
+		Q_strncpyz( map, token, sizeof( map ) );
+		return map;
+	}
+
+	cycle = Cvar_VariableString( "g_mapcycle" );
+	if ( !cycle[0] ) {
+		cycle = "mapcycle.txt";
+	}
+	if ( FS_ReadFile( cycle, (void **)&buffer ) <= 0 ) {
+		return NULL;
+	}
+
+	// map names, each maybe followed by a { } block of cvars
+	first[0] = map[0] = 0;
+	found = qfalse;
+	p = buffer;
+	while ( 1 ) {
+		token = COM_ParseExt( &p, qtrue );
+		if ( !token[0] ) {
+			break;
+		}
+
+		if ( !strcmp( token, "{" ) ) {
+			SkipBracedSection( &p, 1 );
+			continue;
+		}
+
+		if ( !first[0] ) {
+			Q_strncpyz( first, token, sizeof( first ) );
+		}
+		if ( found ) {
+			Q_strncpyz( map, token, sizeof( map ) );
+			break;
+		}
+		if ( !Q_stricmp( token, sv_mapname->string ) ) {
+			found = qtrue;
+		}
+	}
+
+	FS_FreeFile( buffer );
+
+	// wraps around from the last map, and starts over if the current map isn't there
+	if ( !map[0] ) {
+		Q_strncpyz( map, first, sizeof( map ) );
+	}
+	return map[0] ? map : NULL;
+}
+
+/*
+==================
+SV_PrefetchFrame
+==================
+*/
+void SV_PrefetchFrame( void ) {
+	const char	*map;
+	float		timelimit;
+
+	if ( svPrefetch.reading && SV_PrefetchRead( &svPrefetch, PREFETCH_FRAME_BYTES ) ) {
+		SV_PrefetchStop();
+	}
+
+	if ( svPrefetch.started || sv_mapPrefetch->integer <= 0 || sv.state != SS_GAME ) {
+		return;
+	}
+
+	timelimit = Cvar_VariableValue( "timelimit" );
+	if ( timelimit <= 0 ) {
+		return;
+	}
+
+	if ( sv.time - svPrefetch.startTime < timelimit * 60000 - sv_mapPrefetch->integer * 1000 ) {
+		return;
+	}
+
+	// only once per map, even if there's nothing to prefetch
+	svPrefetch.started = qtrue;
+
+	map = SV_PrefetchNextMap();
+	if ( map && Q_stricmp( map, sv_mapname->string ) ) {
+		SV_PrefetchStart( map );
+	}
+}
+
+/*
+==================
+SV_PrefetchMapChange
+
+Called with the map before it loads, and after a map_restart with NULL,
+as the timelimit counts from there.
+==================
+*/
+void SV_PrefetchMapChange( const char *map ) {
+	if ( !map ) {
+		svPrefetch.startTime = sv.time;
+		svPrefetch.started = qfalse;
+		return;
+	}
+
+	SV_PrefetchLoad( map );
+	svPrefetch.startTime = 0;
+	svPrefetch.started = qfalse;
+}
+
+/*
+==================
+SV_Prefetch_f
+
+prefetchmap [map]
+==================
+*/
+void SV_Prefetch_f( void ) {
+	const char	*map;
+
+	if ( Cmd_Argc() > 1 ) {
+		map = Cmd_Argv( 1 );
+	} else {
+		map = SV_PrefetchNextMap();
+		if ( !map ) {
+			Com_Printf( "Usage: prefetchmap <map>, the next map isn't known\n" );
+			return;
+		}
+	}
+
+	SV_PrefetchStart( map );
+}
+
+/*
+==================
+SV_PrefetchShutdown
+==================
+*/
+void SV_PrefetchShutdown( void ) {
+	SV_PrefetchStop();
+	Com_Memset( &svPrefetch, 0, sizeof( svPrefetch ) );
+}
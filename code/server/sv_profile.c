@@ -0,0 +1,310 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_profile.c -- per stage SV_Frame timing histograms, see sv_profile
+
+#include "server.h"
+
+/*
+Times are kept in microseconds in log scaled buckets: the first
+PROFILE_LINEAR values get a bucket each, after that every power of two
+is split into PROFILE_SUBBUCKETS, so a percentile read back from the
+histogram is within 1/PROFILE_SUBBUCKETS of the real value.
+*/
+#define	PROFILE_SUBBITS		3
+#define	PROFILE_SUBBUCKETS	( 1 << PROFILE_SUBBITS )
+#define	PROFILE_LINEAR		( PROFILE_SUBBUCKETS * 4 )
+#define	PROFILE_BUCKETS		( PROFILE_LINEAR + 26 * PROFILE_SUBBUCKETS )	// up to 2^31 usec
+
+typedef struct {
+	int			count;
+	int			max;
+	int64_t		total;
+	int			buckets[PROFILE_BUCKETS];
+} profileStat_t;
+
+static const char *sv_profileNames[SVPROF_NUM_STAGES] = {
+	"calcpings",
+	"game",
+	"timeouts",
+	"send",
+	"heartbeat",
+	"skeet",
+	"frame"
+};
+
+static profileStat_t	sv_profileStats[SVPROF_NUM_STAGES];
+static int				sv_profileOverBudget;	// frames that took longer than 1000 / sv_fps
+static int				sv_profileBudget;
+static int				sv_profilePeakClients;
+
+/*
+==================
+SV_ProfileBucket
+==================
+*/
+static int SV_ProfileBucket( int usec ) {
+	int		e, bucket;
+
+	if ( usec < PROFILE_LINEAR ) {
+		return usec;
+	}
+
+	for ( e = 0 ; ( usec >> e ) >= PROFILE_SUBBUCKETS * 2 ; e++ ) {
+	}
+
+	// the leading bit is implied, the next PROFILE_SUBBITS pick the sub bucket
+	bucket = PROFILE_LINEAR + ( e - 2 ) * PROFILE_SUBBUCKETS + ( ( usec >> e ) & ( PROFILE_SUBBUCKETS - 1 ) );
+	if ( bucket >= PROFILE_BUCKETS ) {
+		bucket = PROFILE_BUCKETS - 1;
+	}
+	return bucket;
+}
+
+/*
+==================
+SV_ProfileBucketLimit
+
+Largest time that falls in a bucket.
+==================
+*/
+static int SV_ProfileBucketLimit( int bucket ) {
+	int		e;
+
+	if ( bucket < PROFILE_LINEAR ) {
+		return bucket;
+	}
+
+	e = ( bucket - PROFILE_LINEAR ) / PROFILE_SUBBUCKETS + 2;
+	return ( ( PROFILE_SUBBUCKETS + ( bucket - PROFILE_LINEAR ) % PROFILE_SUBBUCKETS + 1 ) << e ) - 1;
+}
+
+/*
+==================
+SV_ProfilePercentile
+==================
+*/
+static int SV_ProfilePercentile( const profileStat_t *stat, int percent ) {
+	int		i, want, seen;
+
+	if ( !stat->count ) {
+		return 0;
+	}
+
+	want = (int)( ( (int64_t)stat->count * percent + 99 ) / 100 );
+	seen = 0;
+	for ( i = 0 ; i < PROFILE_BUCKETS ; i++ ) {
+		seen += stat->buckets[i];
+		if ( seen >= want ) {
+			break;
+		}
+	}
+
+	// the top bucket is open ended, and nothing is slower than the max
+	if ( i >= PROFILE_BUCKETS - 1 || SV_ProfileBucketLimit( i ) > stat->max ) {
+		return stat->max;
+	}
+	return SV_ProfileBucketLimit( i );
+}
+
+/*
+==================
+SV_ProfileReset
+==================
+*/
+void SV_ProfileReset( void ) {
+	Com_Memset( sv_profileStats, 0, sizeof( sv_profileStats ) );
+	sv_profileOverBudget = 0;
+	sv_profileBudget = 0;
+	sv_profilePeakClients = 0;
+}
+
+/*
+==================
+SV_ProfileStart
+
+Returns 0 when profiling is off, so SV_ProfileEnd can skip the stage.
+==================
+*/
+int64_t SV_ProfileStart( void ) {
+	if ( !sv_profile->integer ) {
+		return 0;
+	}
+	return Sys_Microseconds();
+}
+
+/*
+==================
+SV_ProfileAdd
+==================
+*/
+static int SV_ProfileAdd( svProfileStage_t stage, int64_t start ) {
+	profileStat_t	*stat;
+	int64_t			usec;
+
+	usec = Sys_Microseconds() - start;
+	if ( usec < 0 ) {
+		usec = 0;
+	} else if ( usec > 0x7fffffff ) {
+		usec = 0x7fffffff;
+	}
+
+	stat = &sv_profileStats[stage];
+	stat->count++;
+	stat->total += usec;
+	if ( usec > stat->max ) {
+		stat->max = (int)usec;
+	}
+	stat->buckets[SV_ProfileBucket( (int)usec )]++;
+
+	return (int)usec;
+}
+
+/*
+==================
+SV_ProfileEnd
+==================
+*/
+void SV_ProfileEnd( svProfileStage_t stage, int64_t start ) {
+	if ( !start || !sv_profile->integer ) {
+		return;
+	}
+
+	SV_ProfileAdd( stage, start );
+}
+
+/*
+==================
+SV_ProfileFrame
+
+Records a whole SV_Frame and checks it against the frame budget.
+==================
+*/
+void SV_ProfileFrame( int64_t start, int frameMsec ) {
+	int		i, clients;
+
+	if ( !start || !sv_profile->integer ) {
+		return;
+	}
+
+	sv_profileBudget = frameMsec * 1000;
+	if ( SV_ProfileAdd( SVPROF_FRAME, start ) > sv_profileBudget ) {
+		sv_profileOverBudget++;
+	}
+
+	clients = 0;
+	for ( i = 0 ; i < sv_maxclients->integer ; i++ ) {
+		if ( svs.clients[i].state == CS_ACTIVE ) {
+			clients++;
+		}
+	}
+	if ( clients > sv_profilePeakClients ) {
+		sv_profilePeakClients = clients;
+	}
+}
+
+/*
+==================
+SV_ProfileSummary
+
+Mean, 99th percentile and max in usec, returns the number of samples
+==================
+*/
+int SV_ProfileSummary( svProfileStage_t stage, int *mean, int *p99, int *max ) {
+	const profileStat_t	*stat = &sv_profileStats[stage];
+
+	if ( !stat->count ) {
+		*mean = *p99 = *max = 0;
+		return 0;
+	}
+
+	*mean = (int)( stat->total / stat->count );
+	*p99 = SV_ProfilePercentile( stat, 99 );
+	*max = stat->max;
+	return stat->count;
+}
+
+/*
+==================
+SV_ProfileOverBudget
+
+Frames since the last reset that took longer than 1000 / sv_fps
+==================
+*/
+int SV_ProfileOverBudget( void ) {
+	return sv_profileOverBudget;
+}
+
+/*
+==================
+SV_ProfileStats_f
+
+profilestats [json|reset]
+==================
+*/
+void SV_ProfileStats_f( void ) {
+	char			json[MAX_STRING_CHARS * 2];
+	profileStat_t	*stat;
+	int				i;
+	qboolean		first;
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		SV_ProfileReset();
+		Com_Printf( "profile stats cleared\n" );
+		return;
+	}
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "json" ) ) {
+		Com_sprintf( json, sizeof( json ), "{\"map\":\"%s\",\"peakClients\":%i,\"frameBudget\":%i,\"overBudget\":%i,\"stages\":{",
+			sv_mapname->string, sv_profilePeakClients, sv_profileBudget, sv_profileOverBudget );
+		first = qtrue;
+		for ( i = 0 ; i < SVPROF_NUM_STAGES ; i++ ) {
+			stat = &sv_profileStats[i];
+			if ( !stat->count ) {
+				continue;
+			}
+			Q_strcat( json, sizeof( json ), va( "%s\"%s\":{\"count\":%i,\"mean\":%i,\"p50\":%i,\"p99\":%i,\"max\":%i}",
+				first ? "" : ",", sv_profileNames[i], stat->count, (int)( stat->total / stat->count ),
+				SV_ProfilePercentile( stat, 50 ), SV_ProfilePercentile( stat, 99 ), stat->max ) );
+			first = qfalse;
+		}
+		Q_strcat( json, sizeof( json ), "}}" );
+		Com_Printf( "%s\n", json );
+		return;
+	}
+
+	if ( !sv_profile->integer ) {
+		Com_Printf( "sv_profile is off\n" );
+	}
+
+	Com_Printf( "map %s, peak %i clients, %i frames over the %i usec budget\n",
+		sv_mapname->string, sv_profilePeakClients, sv_profileOverBudget, sv_profileBudget );
+	Com_Printf( "stage          count     mean      p50      p99      max (usec)\n" );
+	for ( i = 0 ; i < SVPROF_NUM_STAGES ; i++ ) {
+		stat = &sv_profileStats[i];
+		if ( !stat->count ) {
+			continue;
+		}
+		Com_Printf( "%-10s %9i %8i %8i %8i %8i\n", sv_profileNames[i], stat->count,
+			(int)( stat->total / stat->count ), SV_ProfilePercentile( stat, 50 ),
+			SV_ProfilePercentile( stat, 99 ), stat->max );
+	}
+}
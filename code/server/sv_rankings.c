@@ -21,6 +21,13 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 // sv_rankings.c -- global rankings interface
 
+/*
+Not part of the build: the GRank library and its headers were never
+released.  The calls into it are already asynchronous, reports go out with
+GRankSendReportsAsync and the callbacks run from GRankPoll in SV_RankPoll,
+so a report submission never waits on the network in the server frame.
+*/
+
 #include "server.h"
 #include "..\rankings\1.0\gr\grapi.h"
 #include "..\rankings\1.0\gr\grlog.h"
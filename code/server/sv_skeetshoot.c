@@ -28,12 +28,14 @@
 #define STAT_PMOVE                          8
 #define STAT_AMOVE                         13
 #define EVT_FIRE_WEAPON                    31
+#define MAX_SKEET_SHOTS                   256
 
 #define DEG_TO_RAD(a)   ((a) * M_PI / 180.0f)
 
 
 static qboolean SV_SkeetExpired(svEntity_t *sEnt, sharedEntity_t *gEnt);
 static int      SV_SkeetHashOffsetFinder(unsigned int base);
+static qboolean SV_SkeetRayBounds(const vec3_t start, const vec3_t dir, const vec3_t absmin, const vec3_t absmax, float *enter, float *leave);
 static void     SV_SkeetHitReport(client_t *cl, float distance, int points);
 static void     SV_SkeetLogHit(client_t *cl, playerState_t *ps, float distance, int points);
 static void     SV_SkeetLogMiss(client_t *cl);
@@ -46,6 +48,13 @@ typedef struct {
 	int max;
 } skeetscore_t;
 
+typedef struct {
+	int clientNum;
+	int time;           // command time of the shot
+	vec3_t muzzle;
+	vec3_t forward;
+} skeetshot_t;
+
 
 skeetscore_t skeetscores[] = {
 	{ 1,     0,  4000  },
@@ -55,6 +64,9 @@ skeetscore_t skeetscores[] = {
 	{ 8, 10000, SKEET_MAX_TRACE },
 };
 
+skeetshot_t skeetshots[MAX_SKEET_SHOTS];
+int numskeetshots;
+
 
 // ====================================================================================
 
@@ -190,6 +202,8 @@ void SV_SkeetInit(void) {
 	svEntity_t *sEnt;
 	sharedEntity_t *gEnt;
 
+	numskeetshots = 0;  // drop the shots of the previous map
+
 	if (sv_skeetshoot->integer <= 0 || sv_gametype->integer != GT_FFA) {
 		return;
 	}
@@ -391,8 +405,7 @@ void SV_SkeetClientEvents(client_t *cl) {
 	for (i = cl->lastEventSequence; i < ps->eventSequence; i++) {
 		event = ps->events[i & (MAX_PS_EVENTS - 1)];
 		if (event == EVT_FIRE_WEAPON) {
-			if (!SV_SkeetShoot(cl, ps))
-				SV_SkeetLogMiss(cl);
+			SV_SkeetShoot(cl, ps);
 			SV_SkeetRestorePowerups(cl);
 		}
 	}
@@ -401,60 +414,166 @@ void SV_SkeetClientEvents(client_t *cl) {
 
 }
 
-qboolean SV_SkeetShoot(client_t *cl, playerState_t *ps) {
+void SV_SkeetShoot(client_t *cl, playerState_t *ps) {
 
-	svEntity_t *sEnt;
-	sharedEntity_t *gEnt;
+	skeetshot_t *shot;
 	sharedEntity_t *self;
-	trace_t trace;
-	vec3_t mins = { -0.5f, -0.5f, -0.5f };
-	vec3_t maxs = {  0.5f,  0.5f,  0.5f };
-	vec3_t muzzle = { 0, 0, 0 };
-	vec3_t forward =  {0, 0, 0 };
 	vec3_t right = { 0, 0, 0 };
-	vec3_t end = { 0, 0, 0 };
 	vec3_t up = { 0, 0, 0 };
 
 	if (sv_skeetshoot->integer <= 0 || sv_gametype->integer != GT_FFA) {
-		return qfalse;
+		return;
 	}
 
 	self = SV_GentityNum(cl - svs.clients);
 	if (!self) {
-		return qfalse;
+		return;
+	}
+
+	if (numskeetshots >= MAX_SKEET_SHOTS) {
+		SV_SkeetShootFrame();
 	}
 
-	AngleVectors(ps->viewangles, forward, right, up);   // angle vectors of the client
-	VectorCopy(self->s.pos.trBase, muzzle);             // muzzle origin
-	muzzle[2] += ps->viewheight;                        // muzzle on the eye point
-	VectorMA(muzzle, SKEET_MAX_TRACE, forward, end);    // end point of the trace
+	shot = &skeetshots[numskeetshots++];
+	shot->clientNum = cl - svs.clients;
+	shot->time = ps->commandTime;
+	AngleVectors(ps->viewangles, shot->forward, right, up);   // angle vectors of the client
+	VectorCopy(self->s.pos.trBase, shot->muzzle);               // muzzle origin
+	shot->muzzle[2] += ps->viewheight;                          // muzzle on the eye point
 
-	SV_Trace(&trace, muzzle, mins, maxs, end, cl - svs.clients, MASK_SHOT, qfalse);
+}
 
-	sEnt = &sv.svEntities[trace.entityNum];
-	if (!sEnt) {
-		return qfalse;
+void SV_SkeetShootFrame(void) {
+
+	int i, j;
+	int numtargets;
+	float enter, leave, far;
+	skeetshot_t *shot;
+	svEntity_t *sEnt;
+	sharedEntity_t *gEnt;
+	client_t *cl;
+	playerState_t *ps;
+	trace_t trace;
+	int targets[MAX_SKEETS];
+	vec3_t absmin, absmax;
+	vec3_t mins = { -0.5f, -0.5f, -0.5f };
+	vec3_t maxs = {  0.5f,  0.5f,  0.5f };
+	vec3_t end = { 0, 0, 0 };
+
+	if (!numskeetshots) {
+		return;
 	}
 
-	if (!sEnt->skeetInfo.valid || !sEnt->skeetInfo.moving) {
-		return qfalse;
+	// the skeets that can be hit this frame
+	numtargets = 0;
+	for (i = 0; i < MAX_SKEETS; i++) {
+		if (!(sEnt = sv.skeets[i])) {
+			break;
+		}
+		if (sEnt->skeetInfo.valid && sEnt->skeetInfo.moving) {
+			targets[numtargets++] = sEnt - sv.svEntities;
+		}
 	}
 
-	gEnt = SV_GEntityForSvEntity(sEnt);
-	if (!gEnt) {
-		return qfalse;
+	for (i = 0, shot = skeetshots; i < numskeetshots; i++, shot++) {
+
+		cl = &svs.clients[shot->clientNum];
+		if (cl->state != CS_ACTIVE) {
+			continue;
+		}
+
+		// only trace as far as the farthest skeet the shot can reach
+		far = -1;
+		for (j = 0; j < numtargets; j++) {
+			sEnt = &sv.svEntities[targets[j]];
+			if (!sEnt->skeetInfo.moving) {
+				continue;   // hit by an earlier shot
+			}
+			if (!SV_EntityBoundsAtTime(targets[j], shot->time, absmin, absmax)) {
+				continue;
+			}
+			if (SV_SkeetRayBounds(shot->muzzle, shot->forward, absmin, absmax, &enter, &leave) && leave > far) {
+				far = leave;
+			}
+		}
+
+		ps = SV_GameClientNum(shot->clientNum);
+
+		if (far < 0) {
+			SV_SkeetLogMiss(cl);
+			continue;
+		}
+
+		VectorMA(shot->muzzle, MIN(far + 1, SKEET_MAX_TRACE), shot->forward, end);
+
+		// trace against the skeets where the client saw them when firing
+		SV_TraceAtTime(&trace, shot->muzzle, mins, maxs, end, shot->clientNum, MASK_SHOT, qfalse, shot->time);
+
+		sEnt = &sv.svEntities[trace.entityNum];
+		if (!sEnt->skeetInfo.valid || !sEnt->skeetInfo.moving) {
+			SV_SkeetLogMiss(cl);
+			continue;
+		}
+
+		gEnt = SV_GEntityForSvEntity(sEnt);
+		if (!gEnt) {
+			SV_SkeetLogMiss(cl);
+			continue;
+		}
+
+		SV_SendSoundToClient(cl, sv_skeethitsound->string);  // send the hit sound
+		SV_SkeetScore(cl, ps, &trace);                       // increase score
+		SV_SkeetRespawn(sEnt, gEnt);                         // respawn the skeet
+
 	}
 
-	SV_SendSoundToClient(cl, sv_skeethitsound->string);  // send the hit sound
-	SV_SkeetScore(cl, ps, &trace);                       // increase score
-	SV_SkeetRespawn(sEnt, gEnt);                         // respawn the skeet
-	return qtrue;
+	numskeetshots = 0;
 
 }
 
 
 // ====================================================================================
 
+static qboolean SV_SkeetRayBounds(const vec3_t start, const vec3_t dir, const vec3_t absmin, const vec3_t absmax, float *enter, float *leave) {
+
+	int i;
+	float t1, t2, tmp;
+	float lo, hi;
+
+	// slab test against the bounds grown by the shot box and the link epsilon
+	*enter = 0;
+	*leave = SKEET_MAX_TRACE;
+	for (i = 0; i < 3; i++) {
+		lo = absmin[i] - 2.0f;
+		hi = absmax[i] + 2.0f;
+		if (dir[i] == 0) {
+			if (start[i] < lo || start[i] > hi) {
+				return qfalse;
+			}
+			continue;
+		}
+		t1 = (lo - start[i]) / dir[i];
+		t2 = (hi - start[i]) / dir[i];
+		if (t1 > t2) {
+			tmp = t1;
+			t1 = t2;
+			t2 = tmp;
+		}
+		if (t1 > *enter) {
+			*enter = t1;
+		}
+		if (t2 < *leave) {
+			*leave = t2;
+		}
+		if (*enter > *leave) {
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+
+}
+
 static int SV_SkeetHashOffsetFinder(unsigned int base) {
 
 	int i, j;
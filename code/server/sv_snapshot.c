@@ -45,6 +45,105 @@ A normal server packet will look like:
 =============================================================================
 */
 
+/*
+=============================================================================
+
+Entity delta cache
+
+Clients seeing the same entity usually delta it from the same old state
+to the same new state, so the encoded bits are kept and copied into the
+messages of the other clients.
+
+=============================================================================
+*/
+
+#define DELTA_CACHE_BUCKETS		256		// indexed by entity number
+#define DELTA_CACHE_WAYS		2
+#define DELTA_CACHE_BYTES		512		// larger deltas are not cached
+
+typedef struct {
+	qboolean		valid;
+	qboolean		force;
+	entityState_t	from;
+	entityState_t	to;
+	int				bits;
+	byte			data[DELTA_CACHE_BYTES];
+} deltaCacheEntry_t;
+
+static deltaCacheEntry_t	deltaCache[DELTA_CACHE_BUCKETS][DELTA_CACHE_WAYS];
+static int					deltaCacheNext[DELTA_CACHE_BUCKETS];
+
+/*
+=============
+SV_WriteCachedDeltaEntity
+
+Same as MSG_WriteDeltaEntity for a non NULL to
+=============
+*/
+static void SV_WriteCachedDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to, qboolean force ) {
+	deltaCacheEntry_t	*entry;
+	msg_t				delta;
+	int					bucket, i;
+
+	if ( !sv_deltaCache->integer ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	if ( !force && !memcmp( from, to, sizeof( *to ) ) ) {
+		return;		// nothing at all changed
+	}
+
+	bucket = to->number & ( DELTA_CACHE_BUCKETS - 1 );
+
+	for ( i = 0 ; i < DELTA_CACHE_WAYS ; i++ ) {
+		entry = &deltaCache[bucket][i];
+
+		if ( entry->valid && entry->force == force &&
+			!memcmp( &entry->to, to, sizeof( *to ) ) &&
+			!memcmp( &entry->from, from, sizeof( *from ) ) ) {
+			MSG_WriteBitstream( msg, entry->data, entry->bits );
+			return;
+		}
+	}
+
+	// encode it once on its own and remember the bits
+	entry = &deltaCache[bucket][deltaCacheNext[bucket]];
+	deltaCacheNext[bucket] = ( deltaCacheNext[bucket] + 1 ) % DELTA_CACHE_WAYS;
+
+	MSG_Init( &delta, entry->data, sizeof( entry->data ) );
+	delta.allowoverflow = qtrue;
+	MSG_WriteDeltaEntity( &delta, from, to, force );
+
+	if ( delta.overflowed ) {
+		entry->valid = qfalse;
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	entry->valid = qtrue;
+	entry->force = force;
+	entry->from = *from;
+	entry->to = *to;
+	entry->bits = delta.bit;
+
+	MSG_WriteBitstream( msg, entry->data, entry->bits );
+}
+
+/*
+=============
+SV_SnapshotEntity
+
+Each client stores its snapshot entities in a ring of its own, so they
+stay together in memory and the unsigned index, with the ring a power
+of two in size, can wrap without a restart.
+=============
+*/
+entityState_t *SV_SnapshotEntity( client_t *client, unsigned index ) {
+	return &svs.snapshotEntities[ ( client - svs.clients ) * svs.numSnapshotEntities +
+		( index & ( svs.numSnapshotEntities - 1 ) ) ];
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -52,7 +151,7 @@ SV_EmitPacketEntities
 Writes a delta update of an entityState_t list to the message.
 =============
 */
-static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to, msg_t *msg ) {
+static void SV_EmitPacketEntities( client_t *client, clientSnapshot_t *from, clientSnapshot_t *to, msg_t *msg ) {
 	entityState_t	*oldent, *newent;
 	int		oldindex, newindex;
 	int		oldnum, newnum;
@@ -73,14 +172,14 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 		if ( newindex >= to->num_entities ) {
 			newnum = 9999;
 		} else {
-			newent = &svs.snapshotEntities[(to->first_entity+newindex) % svs.numSnapshotEntities];
+			newent = SV_SnapshotEntity( client, to->first_entity + newindex );
 			newnum = newent->number;
 		}
 
 		if ( oldindex >= from_num_entities ) {
 			oldnum = 9999;
 		} else {
-			oldent = &svs.snapshotEntities[(from->first_entity+oldindex) % svs.numSnapshotEntities];
+			oldent = SV_SnapshotEntity( client, from->first_entity + oldindex );
 			oldnum = oldent->number;
 		}
 
@@ -88,7 +187,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 			// delta update from old position
 			// because the force parm is qfalse, this will not result
 			// in any bytes being emitted if the entity has not changed at all
-			MSG_WriteDeltaEntity (msg, oldent, newent, qfalse );
+			SV_WriteCachedDeltaEntity (msg, oldent, newent, qfalse );
 			oldindex++;
 			newindex++;
 			continue;
@@ -96,7 +195,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 		if ( newnum < oldnum ) {
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue );
+			SV_WriteCachedDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue );
 			newindex++;
 			continue;
 		}
@@ -138,6 +237,11 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
 		// client hasn't gotten a good message through in a long time
 		oldframe = NULL;
 		lastframe = 0;
+	} else if ( SVD_KeyframeDue( client ) ) {
+		// a keyframe for seeking the demo goes in front of this one
+		oldframe = NULL;
+		lastframe = 0;
+		client->demo_keyframe = qtrue;
 	} else if (client->demo_recording && client->demo_deltas <= 0) {
 		// if we're recording this client, force full frames every now and then
 		oldframe = NULL;
@@ -160,7 +264,7 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
 		lastframe = client->netchan.outgoingSequence - client->deltaMessage;
 
 		// the snapshot's entities may still have rolled off the buffer, though
-		if ( oldframe->first_entity <= svs.nextSnapshotEntities - svs.numSnapshotEntities ) {
+		if ( client->nextSnapshotEntities - oldframe->first_entity >= svs.numSnapshotEntities ) {
 			oldframe = NULL;
 			lastframe = 0;
 		}
@@ -216,7 +320,7 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
 	}
 
 	// delta encode the entities
-	SV_EmitPacketEntities (oldframe, frame, msg);
+	SV_EmitPacketEntities (client, oldframe, frame, msg);
 
 	// padding for rate debugging
 	if ( sv_padPackets->integer ) {
@@ -257,8 +361,13 @@ Build a client snapshot structure
 typedef struct {
 	int		numSnapshotEntities;
 	int		snapshotEntities[MAX_SNAPSHOT_ENTITIES];	
+	byte	added[MAX_GENTITIES/8];		// used to prevent double adding from portal views
+	const char	*error;					// raised once the snapshot is stored, see SV_StoreClientSnapshot
 } snapshotEntityNumbers_t;
 
+// entity numbers of the snapshots built in parallel by SV_SendClientMessages
+static snapshotEntityNumbers_t	svSnapshotNumbers[MAX_CLIENTS];
+
 /*
 =======================
 SV_QsortEntityNumbers
@@ -287,12 +396,14 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 SV_AddEntToSnapshot
 ===============
 */
-static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+static void SV_AddEntToSnapshot( sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+	int		num = gEnt->s.number;
+
 	// if we have already added this entity to this snapshot, don't add again
-	if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+	if ( eNums->added[num >> 3] & ( 1 << ( num & 7 ) ) ) {
 		return;
 	}
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	eNums->added[num >> 3] |= 1 << ( num & 7 );
 
 	// if we are full, silently discard entities
 	if ( eNums->numSnapshotEntities == MAX_SNAPSHOT_ENTITIES ) {
@@ -303,37 +414,83 @@ static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapsh
 	eNums->numSnapshotEntities++;
 }
 
+/*
+Which entities can be seen from a point depends on the client only for
+the SVF_*CLIENT* flags, the rest comes down to its cluster and area.
+Those are worked out once per snapshot pass for each cluster and area a
+viewpoint is in, so clients sharing a spawn room or a base share the
+result. Snapshots are built on worker threads, so the first to need an
+entry claims it under the lock and fills it, others that need it before
+it is ready fill a copy of their own.
+*/
+
+#define	VIS_CACHE_SIZE	64
+
+typedef struct {
+	int			generation;		// svVisCache.generation it was filled for, 0 = unused
+	int			cluster;
+	int			area;
+	qboolean	ready;
+	unsigned	visible[MAX_GENTITIES / 32];
+} svVisEntry_t;
+
+typedef struct {
+	sysMutex_t		*lock;
+	int				generation;		// one per snapshot pass
+	svVisEntry_t	entries[VIS_CACHE_SIZE];
+} svVisCache_t;
+
+static svVisCache_t	svVisCache;
+
+/*
+===============
+SV_FixEntityNumbers
+
+Done once before building snapshots, so the visibility checks that may
+run on worker threads never have to print or modify the entities, and
+starts a new generation of the visibility cache
+===============
+*/
+static void SV_FixEntityNumbers( void ) {
+	int		e;
+	sharedEntity_t *ent;
+
+	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		ent = SV_GentityNum(e);
+
+		if ( ent->r.linked && ent->s.number != e ) {
+			Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
+			ent->s.number = e;
+		}
+	}
+
+	if ( !svVisCache.lock ) {
+		svVisCache.lock = Sys_CreateMutex();
+	}
+	if ( ++svVisCache.generation <= 0 ) {
+		Com_Memset( svVisCache.entries, 0, sizeof( svVisCache.entries ) );
+		svVisCache.generation = 1;
+	}
+}
+
 /*
 ===============
-SV_AddEntitiesVisibleFromPoint
+SV_FillVisibleEntities
+
+Sets the bits of the entities that are sent to any client whose view is
+in the cluster and area
 ===============
 */
-static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame, 
-									snapshotEntityNumbers_t *eNums, qboolean portal ) {
+static void SV_FillVisibleEntities( unsigned *visible, int cluster, int area ) {
 	int		e, i;
 	sharedEntity_t *ent;
 	svEntity_t	*svEnt;
 	int		l;
-	int		clientarea, clientcluster;
-	int		leafnum;
-	byte	*clientpvs;
 	byte	*bitvector;
 
-	// during an error shutdown message we may need to transmit
-	// the shutdown message after the server has shutdown, so
-	// specfically check for it
-	if ( !sv.state ) {
-		return;
-	}
-
-	leafnum = CM_PointLeafnum (origin);
-	clientarea = CM_LeafArea (leafnum);
-	clientcluster = CM_LeafCluster (leafnum);
-
-	// calculate the visible areas
-	frame->areabytes = CM_WriteAreaBits( frame->areabits, clientarea );
+	Com_Memset( visible, 0, sizeof( svVisCache.entries[0].visible ) );
 
-	clientpvs = CM_ClusterPVS (clientcluster);
+	bitvector = CM_ClusterPVS (cluster);
 
 	for ( e = 0 ; e < sv.num_entities ; e++ ) {
 		ent = SV_GentityNum(e);
@@ -343,61 +500,29 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 			continue;
 		}
 
-		if (ent->s.number != e) {
-			Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
-			ent->s.number = e;
-		}
-
 		// entities can be flagged to explicitly not be sent to the client
 		if ( ent->r.svFlags & SVF_NOCLIENT ) {
 			continue;
 		}
 
-		// entities can be flagged to be sent to only one client
-		if ( ent->r.svFlags & SVF_SINGLECLIENT ) {
-			if ( ent->r.singleClient != frame->ps.clientNum ) {
-				continue;
-			}
-		}
-		// entities can be flagged to be sent to everyone but one client
-		if ( ent->r.svFlags & SVF_NOTSINGLECLIENT ) {
-			if ( ent->r.singleClient == frame->ps.clientNum ) {
-				continue;
-			}
-		}
-		// entities can be flagged to be sent to a given mask of clients
-		if ( ent->r.svFlags & SVF_CLIENTMASK ) {
-			if (frame->ps.clientNum >= 36)
-				Com_Error( ERR_DROP, "SVF_CLIENTMASK: clientNum >= 36" );
-			if (~ent->r.singleClient & (1 << frame->ps.clientNum))
-				continue;
-		}
-
-		svEnt = SV_SvEntityForGentity( ent );
-
-		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
-			continue;
-		}
+		svEnt = &sv.svEntities[e];
 
 		// broadcast entities are always sent
 		if ( ent->r.svFlags & SVF_BROADCAST ) {
-			SV_AddEntToSnapshot( svEnt, ent, eNums );
+			visible[e >> 5] |= 1u << ( e & 31 );
 			continue;
 		}
 
 		// ignore if not touching a PV leaf
 		// check area
-		if ( !CM_AreasConnected( clientarea, svEnt->areanum ) ) {
+		if ( !CM_AreasConnected( area, svEnt->areanum ) ) {
 			// doors can legally straddle two areas, so
 			// we may need to check another one
-			if ( !CM_AreasConnected( clientarea, svEnt->areanum2 ) ) {
+			if ( !CM_AreasConnected( area, svEnt->areanum2 ) ) {
 				continue;		// blocked by a door
 			}
 		}
 
-		bitvector = clientpvs;
-
 		// check individual leafs
 		if ( !svEnt->numClusters ) {
 			continue;
@@ -427,21 +552,140 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 			}
 		}
 
-		// add it
-		SV_AddEntToSnapshot( svEnt, ent, eNums );
+		visible[e >> 5] |= 1u << ( e & 31 );
+	}
+}
+
+/*
+===============
+SV_VisibleEntities
+
+Returns the cached visible entities for the cluster and area, or fills
+local when the entry is taken or still being filled
+===============
+*/
+static const unsigned *SV_VisibleEntities( int cluster, int area, unsigned *local ) {
+	svVisEntry_t	*entry;
+
+	entry = &svVisCache.entries[ ( (unsigned)cluster * 31 + (unsigned)area ) & ( VIS_CACHE_SIZE - 1 ) ];
+
+	Sys_LockMutex( svVisCache.lock );
+	if ( entry->generation == svVisCache.generation ) {
+		if ( entry->ready && entry->cluster == cluster && entry->area == area ) {
+			Sys_UnlockMutex( svVisCache.lock );
+			return entry->visible;
+		}
+		Sys_UnlockMutex( svVisCache.lock );
+
+		SV_FillVisibleEntities( local, cluster, area );
+		return local;
+	}
+
+	entry->generation = svVisCache.generation;
+	entry->cluster = cluster;
+	entry->area = area;
+	entry->ready = qfalse;
+	Sys_UnlockMutex( svVisCache.lock );
+
+	SV_FillVisibleEntities( entry->visible, cluster, area );
+
+	Sys_LockMutex( svVisCache.lock );
+	entry->ready = qtrue;
+	Sys_UnlockMutex( svVisCache.lock );
+
+	return entry->visible;
+}
+
+/*
+===============
+SV_AddEntitiesVisibleFromPoint
+
+This may run on a worker thread, errors are left in eNums->error
+===============
+*/
+static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame, 
+									snapshotEntityNumbers_t *eNums, qboolean portal ) {
+	int		e, w;
+	sharedEntity_t *ent;
+	int		clientarea, clientcluster;
+	int		leafnum;
+	unsigned	local[MAX_GENTITIES / 32];
+	const unsigned	*visible;
+	unsigned	bits;
+
+	// during an error shutdown message we may need to transmit
+	// the shutdown message after the server has shutdown, so
+	// specfically check for it
+	if ( !sv.state ) {
+		return;
+	}
+
+	leafnum = CM_PointLeafnum (origin);
+	clientarea = CM_LeafArea (leafnum);
+	clientcluster = CM_LeafCluster (leafnum);
+
+	// calculate the visible areas
+	frame->areabytes = CM_WriteAreaBits( frame->areabits, clientarea );
+
+	visible = SV_VisibleEntities( clientcluster, clientarea, local );
+
+	for ( w = 0 ; w < ( sv.num_entities + 31 ) >> 5 ; w++ ) {
+		for ( e = w << 5, bits = visible[w] ; bits ; e++, bits >>= 1 ) {
+			if ( !( bits & 1 ) ) {
+				continue;
+			}
+			ent = SV_GentityNum(e);
 
-		// if it's a portal entity, add everything visible from its camera position
-		if ( ent->r.svFlags & SVF_PORTAL ) {
-			if ( ent->s.generic1 ) {
-				vec3_t dir;
-				VectorSubtract(ent->s.origin, origin, dir);
-				if ( VectorLengthSquared(dir) > (float) ent->s.generic1 * ent->s.generic1 ) {
+			// entities can be flagged to be sent to only one client
+			if ( ent->r.svFlags & SVF_SINGLECLIENT ) {
+				if ( ent->r.singleClient != frame->ps.clientNum ) {
 					continue;
 				}
 			}
-			SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums, qtrue );
-		}
+			// entities can be flagged to be sent to everyone but one client
+			if ( ent->r.svFlags & SVF_NOTSINGLECLIENT ) {
+				if ( ent->r.singleClient == frame->ps.clientNum ) {
+					continue;
+				}
+			}
+			// entities can be flagged to be sent to a given mask of clients
+			if ( ent->r.svFlags & SVF_CLIENTMASK ) {
+				if (frame->ps.clientNum >= 36) {
+					eNums->error = "SVF_CLIENTMASK: clientNum >= 36";
+					return;
+				}
+				if (~ent->r.singleClient & (1 << frame->ps.clientNum))
+					continue;
+			}
+
+			// don't double add an entity through portals
+			if ( eNums->added[e >> 3] & ( 1 << ( e & 7 ) ) ) {
+				continue;
+			}
+
+			// add it
+			SV_AddEntToSnapshot( ent, eNums );
+
+			// broadcast entities don't open portals
+			if ( ent->r.svFlags & SVF_BROADCAST ) {
+				continue;
+			}
 
+			// if it's a portal entity, add everything visible from its camera position
+			if ( ent->r.svFlags & SVF_PORTAL ) {
+				if ( ent->s.generic1 ) {
+					vec3_t dir;
+					VectorSubtract(ent->s.origin, origin, dir);
+					if ( VectorLengthSquared(dir) > (float) ent->s.generic1 * ent->s.generic1 ) {
+						continue;
+					}
+				}
+				SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums, qtrue );
+				if ( eNums->error ) {
+					return;
+				}
+			}
+		}
 	}
 }
 
@@ -456,28 +700,25 @@ This properly handles multiple recursive portals, but the render
 currently doesn't.
 
 For viewing through other player's eyes, clent can be something other than client->gentity
+
+Only touches the client's own frame so it can run on a worker thread,
+SV_StoreClientSnapshot completes the snapshot afterwards.
 =============
 */
-static void SV_BuildClientSnapshot( client_t *client ) {
+static void SV_BuildClientSnapshot( client_t *client, snapshotEntityNumbers_t *entityNumbers ) {
 	vec3_t						org;
 	clientSnapshot_t			*frame;
-	snapshotEntityNumbers_t		entityNumbers;
-	int							i;
-	sharedEntity_t				*ent;
-	entityState_t				*state;
-	svEntity_t					*svEnt;
 	sharedEntity_t				*clent;
 	int							clientNum;
 	playerState_t				*ps;
 
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
-
 	// this is the frame we are creating
 	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
 	// clear everything in this snapshot
-	entityNumbers.numSnapshotEntities = 0;
+	entityNumbers->numSnapshotEntities = 0;
+	entityNumbers->error = NULL;
+	Com_Memset( entityNumbers->added, 0, sizeof( entityNumbers->added ) );
 	Com_Memset( frame->areabits, 0, sizeof( frame->areabits ) );
 
   // https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=62
@@ -496,11 +737,11 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	// be regenerated from the playerstate
 	clientNum = frame->ps.clientNum;
 	if ( clientNum < 0 || clientNum >= MAX_GENTITIES ) {
-		Com_Error( ERR_DROP, "SV_SvEntityForGentity: bad gEnt" );
+		entityNumbers->error = "SV_SvEntityForGentity: bad gEnt";
+		return;
 	}
-	svEnt = &sv.svEntities[ clientNum ];
 
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	entityNumbers->added[clientNum >> 3] |= 1 << ( clientNum & 7 );
 
 	// find the client's viewpoint
 	VectorCopy( ps->origin, org );
@@ -508,14 +749,285 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 
 	// add all the entities directly visible to the eye, which
 	// may include portal entities that merge other viewpoints
-	SV_AddEntitiesVisibleFromPoint( org, frame, &entityNumbers, qfalse );
+	SV_AddEntitiesVisibleFromPoint( org, frame, entityNumbers, qfalse );
+}
+
+/*
+=============================================================================
+
+Snapshot entity budget
+
+A client on a low rate used to be sent every visible entity and then
+choked for as many server frames as the big snapshot took to go out.
+With sv_snapshotBudget the snapshot is kept to what the rate allows for
+one snapshot interval: players nearby, missiles, new entities and events
+go every time, the rest in order of a priority that grows each snapshot
+they wait, faster the nearer they are. One that doesn't fit keeps the
+state the client was last sent, which deltas to little or nothing, and
+none waits longer than SNAPSHOT_MAX_DEFER_MSEC.
+
+=============================================================================
+*/
+
+#define	SNAPSHOT_NEAR_DIST			1024	// players within are always sent
+#define	SNAPSHOT_PRIORITY_SCALE		256		// priority gained per snapshot at SNAPSHOT_NEAR_DIST
+#define	SNAPSHOT_MAX_DEFER_MSEC		1000
+#define	SNAPSHOT_FIXED_BYTES		64		// headers, areabits and the playerstate, roughly
+
+typedef struct {
+	int		priority;
+	int		sentTime;			// svs.time the entity's current state was last sent
+} snapshotPriority_t;
+
+static snapshotPriority_t	svSnapshotPriority[MAX_CLIENTS][MAX_GENTITIES];
+
+typedef struct {
+	int		index;				// in the sorted entity numbers
+	int		priority;
+	int		cost;
+} snapshotCandidate_t;
+
+/*
+=============
+SV_EstimateDeltaSize
+
+Bytes MSG_WriteDeltaEntity takes for it, roughly: a number and a field
+count, then about two bytes a changed field once huffman coded.
+=============
+*/
+static int SV_EstimateDeltaSize( const entityState_t *from, const entityState_t *to, qboolean force ) {
+	const int	*a = (const int *)from, *b = (const int *)to;
+	int			i, changed;
+
+	changed = 0;
+	for ( i = 0 ; i < sizeof( *to ) / 4 ; i++ ) {
+		if ( a[i] != b[i] ) {
+			changed++;
+		}
+	}
+
+	if ( !changed && !force ) {
+		return 0;
+	}
+
+	return 3 + 2 * changed;
+}
+
+/*
+=============
+SV_SnapshotFrameEntity
+
+The state of entity num in a stored snapshot, NULL if it wasn't in it.
+index walks along with the ascending numbers asked for.
+=============
+*/
+static entityState_t *SV_SnapshotFrameEntity( client_t *client, clientSnapshot_t *frame, int num, int *index ) {
+	entityState_t	*state;
+
+	while ( *index < frame->num_entities ) {
+		state = SV_SnapshotEntity( client, frame->first_entity + *index );
+		if ( state->number >= num ) {
+			return state->number == num ? state : NULL;
+		}
+		(*index)++;
+	}
+
+	return NULL;
+}
+
+/*
+=============
+SV_QsortSnapshotCandidates
+=============
+*/
+static int QDECL SV_QsortSnapshotCandidates( const void *a, const void *b ) {
+	return ((const snapshotCandidate_t *)b)->priority - ((const snapshotCandidate_t *)a)->priority;
+}
+
+/*
+=============
+SV_SnapshotBudgetFrames
+
+The frame the snapshot will most likely delta from and the last one sent,
+qfalse if the entities can't be budgeted against them.
+=============
+*/
+static qboolean SV_SnapshotBudgetFrames( client_t *client, clientSnapshot_t **base, clientSnapshot_t **last ) {
+	int		sequence = client->netchan.outgoingSequence;
+
+	if ( client->deltaMessage <= 0 || client->state != CS_ACTIVE ||
+		sequence - client->deltaMessage >= PACKET_BACKUP - 3 ||
+		client->lastSnapshotSequence < client->deltaMessage ||
+		client->lastSnapshotSequence >= sequence ) {
+		return qfalse;
+	}
+
+	*base = &client->frames[ client->deltaMessage & PACKET_MASK ];
+	*last = &client->frames[ client->lastSnapshotSequence & PACKET_MASK ];
+
+	// the entities of the frame about to be stored must not overwrite them
+	if ( client->nextSnapshotEntities + MAX_SNAPSHOT_ENTITIES - (*base)->first_entity > svs.numSnapshotEntities ) {
+		return qfalse;
+	}
+
+	return qtrue;
+}
+
+/*
+=============
+SV_BudgetSnapshotEntities
+
+Picks which of the sorted entities get their current state, the others
+are marked in deferred to get the one they were last sent with.
+=============
+*/
+static void SV_BudgetSnapshotEntities( client_t *client, snapshotEntityNumbers_t *entityNumbers,
+									entityState_t **deferred ) {
+	snapshotCandidate_t	candidates[MAX_SNAPSHOT_ENTITIES];
+	clientSnapshot_t	*frame, *base, *last;
+	snapshotPriority_t	*priority;
+	sharedEntity_t		*ent;
+	entityState_t		*baseState, *lastState;
+	vec3_t				delta;
+	float				dist;
+	int					budget, interval, cost, keepCost, weight;
+	int					i, num, baseIndex, lastIndex, numCandidates;
+	qboolean			player;
+
+	if ( !sv_snapshotBudget->integer || ( client->gentity->r.svFlags & SVF_BOT ) ) {
+		return;
+	}
+
+	if ( client->netchan.remoteAddress.type == NA_LOOPBACK ||
+		( sv_lanForceRate->integer && Sys_IsLANAddress( client->netchan.remoteAddress ) ) ) {
+		return;
+	}
+
+	if ( !SV_SnapshotBudgetFrames( client, &base, &last ) ) {
+		return;
+	}
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+	priority = svSnapshotPriority[ client - svs.clients ];
+
+	// what the rate refills in one snapshot interval, less what else goes out with it
+	interval = SV_SnapshotMsec( client );
+	if ( sv_fps->integer > 0 && interval < 1000 / sv_fps->integer ) {
+		interval = 1000 / sv_fps->integer;
+	}
+	budget = (int)( (int64_t)SV_ClientRate( client ) * interval / 1000 ) - SNAPSHOT_FIXED_BYTES;
+	for ( i = client->reliableAcknowledge + 1 ; i <= client->reliableSequence ; i++ ) {
+		budget -= 6 + strlen( client->reliableCommands[ i & ( MAX_RELIABLE_COMMANDS - 1 ) ] );
+	}
+
+	numCandidates = 0;
+	baseIndex = lastIndex = 0;
+	for ( i = 0 ; i < entityNumbers->numSnapshotEntities ; i++ ) {
+		num = entityNumbers->snapshotEntities[i];
+		ent = SV_GentityNum( num );
+		baseState = SV_SnapshotFrameEntity( client, base, num, &baseIndex );
+		lastState = SV_SnapshotFrameEntity( client, last, num, &lastIndex );
+
+		if ( baseState ) {
+			cost = SV_EstimateDeltaSize( baseState, &ent->s, qfalse );
+		} else {
+			cost = SV_EstimateDeltaSize( &sv.svEntities[num].baseline, &ent->s, qtrue );
+		}
+
+		// new to the client, nothing to wait with, or an event that would be lost
+		if ( !lastState || !memcmp( lastState, &ent->s, sizeof( ent->s ) ) ||
+			lastState->event != ent->s.event ||
+			svs.time - priority[num].sentTime >= SNAPSHOT_MAX_DEFER_MSEC ) {
+			priority[num].priority = 0;
+			priority[num].sentTime = svs.time;
+			budget -= cost;
+			continue;
+		}
+
+		VectorSubtract( ent->s.pos.trBase, frame->ps.origin, delta );
+		dist = VectorLength( delta );
+		player = num < sv_maxclients->integer;
+
+		// nearby players and things in flight can't wait
+		if ( ( player && dist < SNAPSHOT_NEAR_DIST ) || ( !ent->r.bmodel &&
+			( ent->s.pos.trType == TR_LINEAR || ent->s.pos.trType == TR_GRAVITY ) ) ) {
+			priority[num].priority = 0;
+			priority[num].sentTime = svs.time;
+			budget -= cost;
+			continue;
+		}
+
+		// waiting isn't free, the last state still deltas from the base
+		if ( baseState ) {
+			keepCost = SV_EstimateDeltaSize( baseState, lastState, qfalse );
+		} else {
+			keepCost = SV_EstimateDeltaSize( &sv.svEntities[num].baseline, lastState, qtrue );
+		}
+		budget -= keepCost;
+
+		weight = SNAPSHOT_PRIORITY_SCALE * SNAPSHOT_NEAR_DIST / ( dist > SNAPSHOT_NEAR_DIST ? dist : SNAPSHOT_NEAR_DIST );
+		if ( player ) {
+			weight *= 2;
+		}
+		priority[num].priority += weight > 0 ? weight : 1;
+
+		candidates[numCandidates].index = i;
+		candidates[numCandidates].priority = priority[num].priority;
+		candidates[numCandidates].cost = cost - keepCost;
+		deferred[i] = lastState;
+		numCandidates++;
+	}
+
+	if ( !numCandidates ) {
+		return;
+	}
+
+	qsort( candidates, numCandidates, sizeof( candidates[0] ), SV_QsortSnapshotCandidates );
+
+	for ( i = 0 ; i < numCandidates ; i++ ) {
+		if ( candidates[i].cost > budget ) {
+			continue;
+		}
+		budget -= candidates[i].cost;
+
+		num = entityNumbers->snapshotEntities[ candidates[i].index ];
+		priority[num].priority = 0;
+		priority[num].sentTime = svs.time;
+		deferred[ candidates[i].index ] = NULL;
+	}
+}
+
+/*
+=============
+SV_StoreClientSnapshot
+
+Sorts the entities found by SV_BuildClientSnapshot and copies their
+states to the client's ring of snapshot entities.
+=============
+*/
+static void SV_StoreClientSnapshot( client_t *client, snapshotEntityNumbers_t *entityNumbers ) {
+	clientSnapshot_t			*frame;
+	int							i;
+	sharedEntity_t				*ent;
+	entityState_t				*state;
+	entityState_t				*deferred[MAX_SNAPSHOT_ENTITIES];
+
+	if ( entityNumbers->error ) {
+		Com_Error( ERR_DROP, "%s", entityNumbers->error );
+	}
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
+	if ( !client->gentity || client->state == CS_ZOMBIE ) {
+		return;
+	}
 
 	// if there were portals visible, there may be out of order entities
 	// in the list which will need to be resorted for the delta compression
 	// to work correctly.  This also catches the error condition
 	// of an entity being included twice.
-	qsort( entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities, 
-		sizeof( entityNumbers.snapshotEntities[0] ), SV_QsortEntityNumbers );
+	qsort( entityNumbers->snapshotEntities, entityNumbers->numSnapshotEntities, 
+		sizeof( entityNumbers->snapshotEntities[0] ), SV_QsortEntityNumbers );
 
 	// now that all viewpoint's areabits have been OR'd together, invert
 	// all of them to make it a mask vector, which is what the renderer wants
@@ -523,63 +1035,97 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 		((int *)frame->areabits)[i] = ((int *)frame->areabits)[i] ^ -1;
 	}
 
+	// keep within the client's rate, see SV_BudgetSnapshotEntities
+	Com_Memset( deferred, 0, entityNumbers->numSnapshotEntities * sizeof( deferred[0] ) );
+	SV_BudgetSnapshotEntities( client, entityNumbers, deferred );
+
 	// copy the entity states out
 	frame->num_entities = 0;
-	frame->first_entity = svs.nextSnapshotEntities;
-	for ( i = 0 ; i < entityNumbers.numSnapshotEntities ; i++ ) {
-		ent = SV_GentityNum(entityNumbers.snapshotEntities[i]);
-		state = &svs.snapshotEntities[svs.nextSnapshotEntities % svs.numSnapshotEntities];
-		*state = ent->s;
-		svs.nextSnapshotEntities++;
-		// this should never hit, map should always be restarted first in SV_Frame
-		if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
-			Com_Error(ERR_FATAL, "svs.nextSnapshotEntities wrapped");
-		}
+	frame->first_entity = client->nextSnapshotEntities;
+	for ( i = 0 ; i < entityNumbers->numSnapshotEntities ; i++ ) {
+		ent = SV_GentityNum(entityNumbers->snapshotEntities[i]);
+		state = SV_SnapshotEntity( client, client->nextSnapshotEntities );
+		*state = deferred[i] ? *deferred[i] : ent->s;
+		client->nextSnapshotEntities++;
 		frame->num_entities++;
 	}
+
+	client->lastSnapshotSequence = client->netchan.outgoingSequence;
+}
+
+/*
+=============
+SV_BuildSnapshotJob
+
+Worker job for SV_SendClientMessages, data is the list of clients to build
+=============
+*/
+static void SV_BuildSnapshotJob( void *data, int index ) {
+	client_t	**clients = data;
+
+	SV_BuildClientSnapshot( clients[index], &svSnapshotNumbers[index] );
 }
 
 #ifdef USE_VOIP
 /*
 ==================
-SV_WriteVoipToClient
+SV_SendVoipToClient
 
-Check to see if there is any VoIP queued for a client, and send if there is.
+Sends the VoIP queued for a client in a datagram of its own, so voice
+doesn't grow the snapshots or overflow them. It goes out just ahead of the
+snapshot, which stays the newest message the client acknowledges and keeps
+delta compressing against. Whatever doesn't fit goes with the next one.
 ==================
 */
-static void SV_WriteVoipToClient(client_t *cl, msg_t *msg)
+static void SV_SendVoipToClient(client_t *cl)
 {
-	int totalbytes = 0;
-	int i;
+	msg_t msg, fits;
+	int i, mark;
 	voipServerPacket_t *packet;
 
-	if(cl->queuedVoipPackets)
-	{
-		// Write as many VoIP packets as we reasonably can...
-		for(i = 0; i < cl->queuedVoipPackets; i++)
-		{
-			packet = cl->voipPacket[(i + cl->queuedVoipIndex) % ARRAY_LEN(cl->voipPacket)];
+	if(!cl->queuedVoipPackets)
+		return;
 
-			totalbytes += packet->len;
-			if (totalbytes > (msg->maxsize - msg->cursize) / 2)
-				break;
+	mark = Com_ScratchMark();
+	MSG_Init(&msg, Com_ScratchAlloc(MAX_MSGLEN), MAX_MSGLEN);
 
-			MSG_WriteByte(msg, svc_voipOpus);
-			MSG_WriteShort(msg, packet->sender);
-			MSG_WriteByte(msg, (byte) packet->generation);
-			MSG_WriteLong(msg, packet->sequence);
-			MSG_WriteByte(msg, packet->frames);
-			MSG_WriteShort(msg, packet->len);
-			MSG_WriteBits(msg, packet->flags, VOIP_FLAGCNT);
-			MSG_WriteData(msg, packet->data, packet->len);
+	MSG_WriteLong(&msg, cl->lastClientCommand);
 
-			Z_Free(packet);
+	for(i = 0; i < cl->queuedVoipPackets; i++)
+	{
+		packet = cl->voipPacket[(i + cl->queuedVoipIndex) % ARRAY_LEN(cl->voipPacket)];
+
+		// the huffman coded size is only known once written, a packet that
+		// takes the datagram over is taken back out unless it is the first
+		fits = msg;
+
+		MSG_WriteByte(&msg, svc_voipOpus);
+		MSG_WriteShort(&msg, packet->sender);
+		MSG_WriteByte(&msg, (byte) packet->generation);
+		MSG_WriteLong(&msg, packet->sequence);
+		MSG_WriteByte(&msg, packet->frames);
+		MSG_WriteShort(&msg, packet->len);
+		MSG_WriteBits(&msg, packet->flags, VOIP_FLAGCNT);
+		MSG_WriteData(&msg, packet->data, packet->len);
+
+		// leave room for the svc_EOF
+		if (i && msg.cursize + 1 > VOIP_DATAGRAM_SIZE) {
+			// the huffman writers OR into the last byte, clear what was taken back
+			msg = fits;
+			msg.data[msg.bit >> 3] &= (1 << (msg.bit & 7)) - 1;
+			break;
 		}
 
-		cl->queuedVoipPackets -= i;
-		cl->queuedVoipIndex += i;
-		cl->queuedVoipIndex %= ARRAY_LEN(cl->voipPacket);
+		SV_ReleaseVoipPacket(packet);
 	}
+
+	cl->queuedVoipPackets -= i;
+	cl->queuedVoipIndex += i;
+	cl->queuedVoipIndex %= ARRAY_LEN(cl->voipPacket);
+
+	SV_SendMessageToClient(&msg, cl);
+
+	Com_ScratchRelease(mark);
 }
 #endif
 
@@ -593,12 +1139,15 @@ Called by SV_SendClientSnapshot and SV_SendClientGameState
 void SV_SendMessageToClient( msg_t *msg, client_t *client )
 {
 	if ( client->demo_recording && !client->demo_waiting ) {
+		if ( client->demo_keyframe ) {
+			SVD_WriteKeyframe( client );
+		}
 		SVD_WriteDemoFile( client, msg );
 	}
 	
 	// record information about the message
 	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSize = msg->cursize;
-	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSent = svs.msgTime;
+	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSent = Sys_Microseconds();
 	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageAcked = 0;
 
 	// send the datagram
@@ -608,18 +1157,30 @@ void SV_SendMessageToClient( msg_t *msg, client_t *client )
 
 /*
 =======================
-SV_SendClientSnapshot
-
-Also called by SV_FinalMessage
+SV_SendBuiltSnapshot
 
+Stores a snapshot built by SV_BuildClientSnapshot, then encodes and
+sends it
 =======================
 */
-void SV_SendClientSnapshot( client_t *client ) {
-	byte		msg_buf[MAX_MSGLEN];
+static void SV_SendBuiltSnapshot( client_t *client, snapshotEntityNumbers_t *entityNumbers ) {
 	msg_t		msg;
+	int			mark;
 
-	// build the snapshot
-	SV_BuildClientSnapshot( client );
+#ifdef USE_VOIP
+	// before the snapshot is stored under the next outgoing sequence
+	if ( !( client->gentity && client->gentity->r.svFlags & SVF_BOT ) ) {
+		SV_SendVoipToClient( client );
+
+		// a voice datagram that had to be fragmented would send the
+		// snapshot out under another sequence, it waits for the next one
+		if ( client->netchan.unsentFragments ) {
+			return;
+		}
+	}
+#endif
+
+	SV_StoreClientSnapshot( client, entityNumbers );
 
 	// bots need to have their snapshots build, but
 	// the query them directly without needing to be sent
@@ -627,7 +1188,8 @@ void SV_SendClientSnapshot( client_t *client ) {
 		return;
 	}
 
-	MSG_Init (&msg, msg_buf, sizeof(msg_buf));
+	mark = Com_ScratchMark();
+	MSG_Init( &msg, Com_ScratchAlloc( MAX_MSGLEN ), MAX_MSGLEN );
 	msg.allowoverflow = qtrue;
 
 	// NOTE, MRE: all server->client messages now acknowledge
@@ -641,20 +1203,153 @@ void SV_SendClientSnapshot( client_t *client ) {
 	// and the playerState_t
 	SV_WriteSnapshotToClient( client, &msg );
 
-#ifdef USE_VOIP
-	SV_WriteVoipToClient( client, &msg );
-#endif
-
 	// check for overflow
 	if ( msg.overflowed ) {
+		svMetrics[SVM_SNAPSHOT_OVERFLOWS]++;
 		Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
 		MSG_Clear (&msg);
 	}
 
 	SV_SendMessageToClient( &msg, client );
+
+	Com_ScratchRelease( mark );
 }
 
 
+/*
+=======================
+SV_SendClientSnapshot
+
+Also called by SV_FinalMessage
+
+=======================
+*/
+void SV_SendClientSnapshot( client_t *client ) {
+	snapshotEntityNumbers_t		*entityNumbers;
+	int							mark;
+
+	SV_FixEntityNumbers();
+
+	mark = Com_ScratchMark();
+	entityNumbers = Com_ScratchAlloc( sizeof( *entityNumbers ) );
+
+	// build the snapshot
+	SV_BuildClientSnapshot( client, entityNumbers );
+
+	SV_SendBuiltSnapshot( client, entityNumbers );
+
+	Com_ScratchRelease( mark );
+}
+
+
+/*
+=============================================================================
+
+Adaptive snapshot rate
+
+The snaps a client asks for are the most it gets. With sv_snapshotAdapt
+a client whose snapshots are choked or whose packets get lost is sent
+fewer, down to SNAPSHOT_ADAPT_MAX_MSEC apart, and more again once its
+rate has room for them at the size they have been, in steps once a
+second as SV_NetStatsFrame closes its window.
+
+Clients due every few frames are also given a slot by their number, so
+they don't all come due on the same frame after a map change and are
+spread evenly over the frames between.
+
+=============================================================================
+*/
+
+#define	SNAPSHOT_ADAPT_MAX_MSEC		200		// 5 a second
+#define	SNAPSHOT_ADAPT_LOSS			0.05f	// or choke, that makes it back off
+
+/*
+=======================
+SV_SnapshotMsec
+
+msec between the client's snapshots, not counting the timescale
+=======================
+*/
+int SV_SnapshotMsec( client_t *client ) {
+	if ( sv_snapshotAdapt->integer && client->snapshotAdaptMsec > client->snapshotMsec ) {
+		return client->snapshotAdaptMsec;
+	}
+
+	return client->snapshotMsec;
+}
+
+/*
+=======================
+SV_AdaptSnapshotRate
+
+The window of client's net stats just closed, snapshots were sent a second
+=======================
+*/
+void SV_AdaptSnapshotRate( client_t *client, int snapshots ) {
+	clientNetStats_t	*stats = &client->netStats;
+	int					msec, faster, maxMsec, size;
+
+	if ( !sv_snapshotAdapt->integer || client->state != CS_ACTIVE ||
+		( client->gentity && client->gentity->r.svFlags & SVF_BOT ) ||
+		client->netchan.remoteAddress.type == NA_LOOPBACK ||
+		( sv_lanForceRate->integer && Sys_IsLANAddress( client->netchan.remoteAddress ) ) ) {
+		client->snapshotAdaptMsec = 0;
+		return;
+	}
+
+	msec = SV_SnapshotMsec( client );
+	maxMsec = MAX( client->snapshotMsec, SNAPSHOT_ADAPT_MAX_MSEC );
+
+	if ( stats->choke > SNAPSHOT_ADAPT_LOSS || stats->loss > SNAPSHOT_ADAPT_LOSS ) {
+		msec += msec / 4 + 1;
+	} else if ( snapshots > 0 && msec > client->snapshotMsec ) {
+		// only if the snapshots as they are would fit the rate at 90%
+		size = stats->bytesOutRate / snapshots;
+		faster = msec * 9 / 10;
+		if ( faster > 0 && (int64_t)size * 1000 / faster <= SV_ClientRate( client ) * 9 / 10 ) {
+			msec = faster;
+		}
+	}
+
+	if ( msec > maxMsec ) {
+		msec = maxMsec;
+	}
+	client->snapshotAdaptMsec = msec > client->snapshotMsec ? msec : 0;
+}
+
+/*
+=======================
+SV_SnapshotDue
+
+Whether a client that was last sent a snapshot elapsed msec ago gets one
+on this frame
+=======================
+*/
+static qboolean SV_SnapshotDue( client_t *client, int elapsed, int msec ) {
+	int		tick, period;
+
+	if ( elapsed < msec ) {
+		return qfalse;
+	}
+
+	if ( !sv_snapshotAdapt->integer ) {
+		return qtrue;
+	}
+
+	tick = (int)( SV_TickMsec() * com_timescale->value );
+	if ( tick < 1 ) {
+		tick = 1;
+	}
+	period = ( msec + tick - 1 ) / tick;
+
+	// a slot missed, to frames skipped or the rate, isn't waited for again
+	if ( period < 2 || elapsed >= msec + period * tick ) {
+		return qtrue;
+	}
+
+	return ( sv.time / tick + ( client - svs.clients ) ) % period == 0;
+}
+
 /*
 =======================
 SV_SendClientMessages
@@ -665,10 +1360,12 @@ void SV_SendClientMessages(void)
 	int			i;
 	client_t	*c;
 	qboolean	lanRate;
-	
-	svs.msgTime = Sys_Milliseconds();
+	client_t	*sendClients[MAX_CLIENTS];
+	int			numSendClients;
+	int			msec;
 
-	// send a message to each connected client
+	// find the clients that get a new message this frame
+	numSendClients = 0;
 	for( i = 0; i < sv_maxclients->integer; i++ )
 	{
 		c = &svs.clients[ i ];
@@ -676,8 +1373,13 @@ void SV_SendClientMessages(void)
 		if ( c->state == CS_FREE )
 			continue;		// not connected
 
+		msec = (int)( SV_SnapshotMsec( c ) * com_timescale->value );
+
 		if ( c->netchan.unsentFragments || c->netchan_start_queue )
 		{
+			// a snapshot held back when it's due is choke
+			if ( svs.time - c->lastSnapshotTime >= msec )
+				c->snapshotsChoked++;
 			c->rateDelayed = qtrue;
 			continue;		// Drop this snapshot if the packet queue is still full or delta compression will break
 		}
@@ -685,7 +1387,7 @@ void SV_SendClientMessages(void)
 		// 1. Local clients get snapshots every server frame
 		// 2. Remote clients get snapshots depending on rate and requested number of updates
 
-		if ( svs.time - c->lastSnapshotTime < c->snapshotMsec * com_timescale->value ) 
+		if ( !SV_SnapshotDue( c, svs.time - c->lastSnapshotTime, msec ) )
 		{
 			continue;		// not time yet
 		}
@@ -696,35 +1398,36 @@ void SV_SendClientMessages(void)
 		if ( !lanRate && SV_RateMsec( c ) > 0 )
 		{
 			// Not enough time since last packet passed through the line
+			c->snapshotsChoked++;
 			c->rateDelayed = qtrue;
 			continue;
 		}
 
-		// generate and send a new message
-		SV_SendClientSnapshot( c );
-		c->lastSnapshotTime = svs.time;
-		c->rateDelayed = qfalse;
+		sendClients[ numSendClients++ ] = c;
 	}
-}
 
-void SV_CheckClientUserinfoTimer( void ) {
-	int			i;
-	client_t	*cl;
-	char 		bigbuffer[MAX_INFO_STRING * 2];
+	if ( !numSendClients )
+		return;
 
-	for (i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++) {
-		if (!cl->state) {
-			continue; // not connected
-		}
+	// the visibility part of the snapshots only reads the world, so it
+	// is spread over the worker threads when there are any
+	SV_FixEntityNumbers();
+	Com_RunParallel( SV_BuildSnapshotJob, sendClients, numSendClients );
 
-		if ( (sv_floodProtect->integer) && (svs.time >= cl->nextReliableUserTime) && (cl->state >= CS_ACTIVE) && (cl->userinfobuffer[0] != 0) )
-		{
-			// We have something in the buffer
-			// and it's time to process it
-			Com_sprintf(bigbuffer, sizeof(bigbuffer), "userinfo \"%s\"", cl->userinfobuffer);
+	// collect the snapshot datagrams of all clients and send them together
+	Sys_BeginPacketBatch();
 
-			Cmd_TokenizeString(bigbuffer);
-			SV_UpdateUserinfo_f(cl);
-		}
+	// send a message to each client
+	for( i = 0; i < numSendClients; i++ )
+	{
+		c = sendClients[ i ];
+
+		// generate and send a new message
+		SV_SendBuiltSnapshot( c, &svSnapshotNumbers[ i ] );
+		c->lastSnapshotTime = svs.time;
+		c->rateDelayed = qfalse;
+		c->snapshotsSent++;
 	}
+
+	Sys_FlushPacketBatch();
 }
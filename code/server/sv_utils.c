@@ -64,21 +64,10 @@ int SV_FindConfigstringIndex(char *name, int start, int max, qboolean create) {
 void QDECL SV_LogPrintf(const char *fmt, ...) {
 
 	va_list argptr;
-	fileHandle_t file;
-	fsMode_t mode;
-	char *filename;
 	char buffer[MAX_STRING_CHARS];
 	int min, tens, sec;
 
-	filename = Cvar_VariableString("g_log");
-	if (!filename[0]) {
-		return;
-	}
-
-	mode = Cvar_VariableIntegerValue("g_logSync") ? FS_APPEND_SYNC : FS_APPEND;
-
-	FS_FOpenFileByMode(filename, &file, mode);
-	if (!file) {
+	if (!Cvar_VariableString("g_log")[0]) {
 		return;
 	}
 
@@ -91,11 +80,11 @@ void QDECL SV_LogPrintf(const char *fmt, ...) {
 	Com_sprintf(buffer, sizeof(buffer), "%3i:%i%i ", min, tens, sec);
 
 	va_start(argptr, fmt);
-	vsprintf(buffer + 7, fmt, argptr);
+	Q_vsnprintf(buffer + 7, sizeof(buffer) - 7, fmt, argptr);
 	va_end(argptr);
 
-	FS_Write(buffer, strlen(buffer), file);
-	FS_FCloseFile(file);
+	// buffered, see sv_log.c
+	SV_LogWrite(buffer, strlen(buffer));
 
 }
 
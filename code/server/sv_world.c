@@ -23,6 +23,14 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "server.h"
 
+#if defined( __SSE__ ) || idx64
+#include <xmmintrin.h>
+#define USE_SSE_BOUNDS
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define USE_NEON_BOUNDS
+#endif
+
 /*
 ================
 SV_ClipHandleForEntity
@@ -58,6 +66,14 @@ the world is carved up with an evenly spaced, axially aligned bsp tree.  Entitie
 are kept in chains either at the final leafs, or at the first node that splits
 them, which prevents having to deal with multiple fragments of a single entity.
 
+With sv_worldIndex 1 a loose grid over the map's x/y extents is used instead.
+Every entity is chained in the single cell that holds the center of its box,
+and a cell's contents may spill up to half a cell into its neighbours, so a
+query only has to look one ring of cells further out.  Entities wider than a
+cell are kept in one extra chain that every query checks.  The entities
+come back in another order than from the tree, and game code that touches
+or traces them in that order can behave differently, so it's off by default.
+
 ===============================================================================
 */
 
@@ -74,6 +90,32 @@ typedef struct worldSector_s {
 worldSector_t	sv_worldSectors[AREA_NODES];
 int			sv_numworldSectors;
 
+#define	GRID_MAX_SIZE		64				// cells along each axis
+#define	GRID_MIN_CELL		128.0f
+#define	GRID_HUGE_CELL		( GRID_MAX_SIZE * GRID_MAX_SIZE )	// entities wider than a cell
+
+static worldSector_t	sv_gridCells[GRID_MAX_SIZE * GRID_MAX_SIZE + 1];
+static qboolean	sv_gridActive;
+static vec2_t	sv_gridOrigin;
+static float	sv_gridCellSize;
+static int		sv_gridSize[2];
+
+#define	GRID_SCAN_CELLS		16				// bigger clip boxes scan sv_entityBounds instead
+
+/*
+Structure of arrays copy of the absmin / absmax of every linked entity,
+indexed by entity number, so SV_BoundsEntities can test several boxes at
+once.  Unlinked slots hold an inverted box that never overlaps anything.
+*/
+typedef struct {
+	float	mins[3][MAX_GENTITIES];
+	float	maxs[3][MAX_GENTITIES];
+} entityBounds_t;
+
+static entityBounds_t	sv_entityBounds;
+
+#define	BOUNDS_EMPTY		1.0e30f
+
 
 /*
 ===============
@@ -85,6 +127,26 @@ void SV_SectorList_f( void ) {
 	worldSector_t	*sec;
 	svEntity_t		*ent;
 
+	if ( sv_gridActive ) {
+		for ( i = 0 ; i <= GRID_HUGE_CELL ; i++ ) {
+			sec = &sv_gridCells[i];
+
+			c = 0;
+			for ( ent = sec->entities ; ent ; ent = ent->nextEntityInWorldSector ) {
+				c++;
+			}
+			if ( !c ) {
+				continue;
+			}
+			if ( i == GRID_HUGE_CELL ) {
+				Com_Printf( "oversized: %i entities\n", c );
+			} else {
+				Com_Printf( "cell %i,%i: %i entities\n", i % GRID_MAX_SIZE, i / GRID_MAX_SIZE, c );
+			}
+		}
+		return;
+	}
+
 	for ( i = 0 ; i < AREA_NODES ; i++ ) {
 		sec = &sv_worldSectors[i];
 
@@ -138,6 +200,108 @@ static worldSector_t *SV_CreateworldSector( int depth, vec3_t mins, vec3_t maxs
 	return anode;
 }
 
+/*
+===============
+SV_CreateGrid
+
+Sizes the loose grid so that the map fits in GRID_MAX_SIZE cells along
+its longest axis
+===============
+*/
+static void SV_CreateGrid( vec3_t mins, vec3_t maxs ) {
+	float	size;
+	int		i;
+
+	Com_Memset( sv_gridCells, 0, sizeof( sv_gridCells ) );
+	for ( i = 0 ; i <= GRID_HUGE_CELL ; i++ ) {
+		sv_gridCells[i].axis = -1;
+	}
+
+	sv_gridActive = sv_worldIndex->integer ? qtrue : qfalse;
+
+	size = MAX( maxs[0] - mins[0], maxs[1] - mins[1] );
+	sv_gridCellSize = MAX( size / GRID_MAX_SIZE, GRID_MIN_CELL );
+
+	for ( i = 0 ; i < 2 ; i++ ) {
+		sv_gridOrigin[i] = mins[i];
+		sv_gridSize[i] = (int)( ( maxs[i] - mins[i] ) / sv_gridCellSize ) + 1;
+		if ( sv_gridSize[i] > GRID_MAX_SIZE ) {
+			sv_gridSize[i] = GRID_MAX_SIZE;
+		} else if ( sv_gridSize[i] < 1 ) {
+			sv_gridSize[i] = 1;
+		}
+	}
+}
+
+/*
+===============
+SV_GridCoord
+
+Cells outside the map are clamped to the border, which keeps overlap tests
+between clamped ranges valid
+===============
+*/
+static ID_INLINE int SV_GridCoord( float v, int axis ) {
+	int		c;
+
+	c = (int)floor( ( v - sv_gridOrigin[axis] ) / sv_gridCellSize );
+	if ( c < 0 ) {
+		return 0;
+	}
+	if ( c >= sv_gridSize[axis] ) {
+		return sv_gridSize[axis] - 1;
+	}
+	return c;
+}
+
+/*
+===============
+SV_GridCellForBounds
+===============
+*/
+static worldSector_t *SV_GridCellForBounds( const vec3_t absmin, const vec3_t absmax ) {
+	int		x, y;
+
+	// a box no wider than a cell reaches at most half a cell past the
+	// cell that holds its center
+	if ( absmax[0] - absmin[0] > sv_gridCellSize || absmax[1] - absmin[1] > sv_gridCellSize ) {
+		return &sv_gridCells[GRID_HUGE_CELL];
+	}
+
+	x = SV_GridCoord( ( absmin[0] + absmax[0] ) * 0.5f, 0 );
+	y = SV_GridCoord( ( absmin[1] + absmax[1] ) * 0.5f, 1 );
+
+	return &sv_gridCells[y * GRID_MAX_SIZE + x];
+}
+
+/*
+===============
+SV_SetEntityBounds
+===============
+*/
+static void SV_SetEntityBounds( int num, const vec3_t absmin, const vec3_t absmax ) {
+	int		i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		sv_entityBounds.mins[i][num] = absmin[i];
+		sv_entityBounds.maxs[i][num] = absmax[i];
+	}
+}
+
+/*
+===============
+SV_ClearEntityBounds
+===============
+*/
+static void SV_ClearEntityBounds( int num ) {
+	int		i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		sv_entityBounds.mins[i][num] = BOUNDS_EMPTY;
+		sv_entityBounds.maxs[i][num] = -BOUNDS_EMPTY;
+	}
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -147,6 +311,7 @@ SV_ClearWorld
 void SV_ClearWorld( void ) {
 	clipHandle_t	h;
 	vec3_t			mins, maxs;
+	int				i;
 
 	Com_Memset( sv_worldSectors, 0, sizeof(sv_worldSectors) );
 	sv_numworldSectors = 0;
@@ -155,6 +320,14 @@ void SV_ClearWorld( void ) {
 	h = CM_InlineModel( 0 );
 	CM_ModelBounds( h, mins, maxs );
 	SV_CreateworldSector( 0, mins, maxs );
+
+	SV_CreateGrid( mins, maxs );
+
+	for ( i = 0 ; i < MAX_GENTITIES ; i++ ) {
+		SV_ClearEntityBounds( i );
+	}
+
+	SV_InvalidateTraceCache();
 }
 
 
@@ -166,7 +339,6 @@ SV_UnlinkEntity
 */
 void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
 	svEntity_t		*ent;
-	svEntity_t		*scan;
 	worldSector_t	*ws;
 
 	ent = SV_SvEntityForGentity( gEnt );
@@ -179,19 +351,24 @@ void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
 	}
 	ent->worldSector = NULL;
 
-	if ( ws->entities == ent ) {
-		ws->entities = ent->nextEntityInWorldSector;
-		return;
+	SV_InvalidateTraceCache();
+
+	SV_ClearEntityBounds( ent - sv.svEntities );
+
+	if ( ent->nextEntityInWorldSector ) {
+		ent->nextEntityInWorldSector->prevEntityInWorldSector = ent->prevEntityInWorldSector;
 	}
 
-	for ( scan = ws->entities ; scan ; scan = scan->nextEntityInWorldSector ) {
-		if ( scan->nextEntityInWorldSector == ent ) {
-			scan->nextEntityInWorldSector = ent->nextEntityInWorldSector;
-			return;
-		}
+	if ( ent->prevEntityInWorldSector ) {
+		ent->prevEntityInWorldSector->nextEntityInWorldSector = ent->nextEntityInWorldSector;
+	} else if ( ws->entities == ent ) {
+		ws->entities = ent->nextEntityInWorldSector;
+	} else {
+		Com_Printf( "WARNING: SV_UnlinkEntity: not found in worldSector\n" );
 	}
 
-	Com_Printf( "WARNING: SV_UnlinkEntity: not found in worldSector\n" );
+	ent->nextEntityInWorldSector = NULL;
+	ent->prevEntityInWorldSector = NULL;
 }
 
 
@@ -332,25 +509,36 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linkcount++;
 
-	// find the first world sector node that the ent's box crosses
-	node = sv_worldSectors;
-	while (1)
-	{
-		if (node->axis == -1)
-			break;
-		if ( gEnt->r.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if ( gEnt->r.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;		// crosses the node
+	if ( sv_gridActive ) {
+		node = SV_GridCellForBounds( gEnt->r.absmin, gEnt->r.absmax );
+	} else {
+		// find the first world sector node that the ent's box crosses
+		node = sv_worldSectors;
+		while (1)
+		{
+			if (node->axis == -1)
+				break;
+			if ( gEnt->r.absmin[node->axis] > node->dist)
+				node = node->children[0];
+			else if ( gEnt->r.absmax[node->axis] < node->dist)
+				node = node->children[1];
+			else
+				break;		// crosses the node
+		}
 	}
-	
+
 	// link it in
 	ent->worldSector = node;
+	ent->prevEntityInWorldSector = NULL;
 	ent->nextEntityInWorldSector = node->entities;
+	if ( node->entities ) {
+		node->entities->prevEntityInWorldSector = ent;
+	}
 	node->entities = ent;
 
+	SV_SetEntityBounds( ent - sv.svEntities, gEnt->r.absmin, gEnt->r.absmax );
+	SV_InvalidateTraceCache();
+
 	gEnt->r.linked = qtrue;
 }
 
@@ -374,11 +562,12 @@ typedef struct {
 
 /*
 ====================
-SV_AreaEntities_r
+SV_AreaEntitiesInSector
 
+Returns qfalse when the list is full
 ====================
 */
-static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
+static qboolean SV_AreaEntitiesInSector( worldSector_t *node, areaParms_t *ap ) {
 	svEntity_t	*check, *next;
 	sharedEntity_t *gcheck;
 
@@ -398,13 +587,27 @@ static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 
 		if ( ap->count == ap->maxcount ) {
 			Com_Printf ("SV_AreaEntities: MAXCOUNT\n");
-			return;
+			return qfalse;
 		}
 
 		ap->list[ap->count] = check - sv.svEntities;
 		ap->count++;
 	}
-	
+
+	return qtrue;
+}
+
+/*
+====================
+SV_AreaEntities_r
+
+====================
+*/
+static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
+	if ( !SV_AreaEntitiesInSector( node, ap ) ) {
+		return;
+	}
+
 	if (node->axis == -1) {
 		return;		// terminal node
 	}
@@ -418,6 +621,35 @@ static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 	}
 }
 
+/*
+====================
+SV_AreaEntitiesGrid
+
+====================
+*/
+static void SV_AreaEntitiesGrid( areaParms_t *ap ) {
+	float	half;
+	int		x, y, x0, x1, y0, y1;
+
+	if ( !SV_AreaEntitiesInSector( &sv_gridCells[GRID_HUGE_CELL], ap ) ) {
+		return;
+	}
+
+	half = sv_gridCellSize * 0.5f;
+	x0 = SV_GridCoord( ap->mins[0] - half, 0 );
+	x1 = SV_GridCoord( ap->maxs[0] + half, 0 );
+	y0 = SV_GridCoord( ap->mins[1] - half, 1 );
+	y1 = SV_GridCoord( ap->maxs[1] + half, 1 );
+
+	for ( y = y0 ; y <= y1 ; y++ ) {
+		for ( x = x0 ; x <= x1 ; x++ ) {
+			if ( !SV_AreaEntitiesInSector( &sv_gridCells[y * GRID_MAX_SIZE + x], ap ) ) {
+				return;
+			}
+		}
+	}
+}
+
 /*
 ================
 SV_AreaEntities
@@ -432,11 +664,107 @@ int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int
 	ap.count = 0;
 	ap.maxcount = maxcount;
 
-	SV_AreaEntities_r( sv_worldSectors, &ap );
+	if ( sv_gridActive ) {
+		SV_AreaEntitiesGrid( &ap );
+	} else {
+		SV_AreaEntities_r( sv_worldSectors, &ap );
+	}
 
 	return ap.count;
 }
 
+/*
+================
+SV_BoundsEntities
+
+Same result set as SV_AreaEntities, in entity number order, from a linear
+scan of sv_entityBounds that tests four entities per step.  This beats
+walking sector chains when the box covers a large part of the map.
+================
+*/
+static int SV_BoundsEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount ) {
+	int		i, j, bits, count, numEntities;
+
+	count = 0;
+	numEntities = ( sv.num_entities + 3 ) & ~3;
+	if ( numEntities > MAX_GENTITIES ) {
+		numEntities = MAX_GENTITIES;
+	}
+
+	for ( i = 0 ; i < numEntities ; i += 4 ) {
+#if defined( USE_SSE_BOUNDS )
+		__m128	m;
+
+		m = _mm_and_ps( _mm_cmple_ps( _mm_loadu_ps( &sv_entityBounds.mins[0][i] ), _mm_set1_ps( maxs[0] ) ),
+			_mm_cmpge_ps( _mm_loadu_ps( &sv_entityBounds.maxs[0][i] ), _mm_set1_ps( mins[0] ) ) );
+		m = _mm_and_ps( m, _mm_cmple_ps( _mm_loadu_ps( &sv_entityBounds.mins[1][i] ), _mm_set1_ps( maxs[1] ) ) );
+		m = _mm_and_ps( m, _mm_cmpge_ps( _mm_loadu_ps( &sv_entityBounds.maxs[1][i] ), _mm_set1_ps( mins[1] ) ) );
+		m = _mm_and_ps( m, _mm_cmple_ps( _mm_loadu_ps( &sv_entityBounds.mins[2][i] ), _mm_set1_ps( maxs[2] ) ) );
+		m = _mm_and_ps( m, _mm_cmpge_ps( _mm_loadu_ps( &sv_entityBounds.maxs[2][i] ), _mm_set1_ps( mins[2] ) ) );
+		bits = _mm_movemask_ps( m );
+#elif defined( USE_NEON_BOUNDS )
+		uint32x4_t	m;
+
+		m = vandq_u32( vcleq_f32( vld1q_f32( &sv_entityBounds.mins[0][i] ), vdupq_n_f32( maxs[0] ) ),
+			vcgeq_f32( vld1q_f32( &sv_entityBounds.maxs[0][i] ), vdupq_n_f32( mins[0] ) ) );
+		m = vandq_u32( m, vcleq_f32( vld1q_f32( &sv_entityBounds.mins[1][i] ), vdupq_n_f32( maxs[1] ) ) );
+		m = vandq_u32( m, vcgeq_f32( vld1q_f32( &sv_entityBounds.maxs[1][i] ), vdupq_n_f32( mins[1] ) ) );
+		m = vandq_u32( m, vcleq_f32( vld1q_f32( &sv_entityBounds.mins[2][i] ), vdupq_n_f32( maxs[2] ) ) );
+		m = vandq_u32( m, vcgeq_f32( vld1q_f32( &sv_entityBounds.maxs[2][i] ), vdupq_n_f32( mins[2] ) ) );
+		bits = ( vgetq_lane_u32( m, 0 ) & 1 ) | ( vgetq_lane_u32( m, 1 ) & 2 )
+			| ( vgetq_lane_u32( m, 2 ) & 4 ) | ( vgetq_lane_u32( m, 3 ) & 8 );
+#else
+		bits = 0;
+		for ( j = 0 ; j < 4 ; j++ ) {
+			if ( sv_entityBounds.mins[0][i + j] <= maxs[0] && sv_entityBounds.maxs[0][i + j] >= mins[0]
+			&& sv_entityBounds.mins[1][i + j] <= maxs[1] && sv_entityBounds.maxs[1][i + j] >= mins[1]
+			&& sv_entityBounds.mins[2][i + j] <= maxs[2] && sv_entityBounds.maxs[2][i + j] >= mins[2] ) {
+				bits |= 1 << j;
+			}
+		}
+#endif
+		if ( !bits ) {
+			continue;
+		}
+
+		for ( j = 0 ; j < 4 ; j++ ) {
+			if ( !( bits & ( 1 << j ) ) ) {
+				continue;
+			}
+			if ( count == maxcount ) {
+				Com_Printf ("SV_BoundsEntities: MAXCOUNT\n");
+				return count;
+			}
+			entityList[count++] = i + j;
+		}
+	}
+
+	return count;
+}
+
+/*
+================
+SV_ClipEntities
+
+Picks the cheaper broadphase for a clip box
+================
+*/
+static int SV_ClipEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount ) {
+	float	half;
+	int		cells;
+
+	if ( sv_gridActive ) {
+		half = sv_gridCellSize * 0.5f;
+		cells = ( SV_GridCoord( maxs[0] + half, 0 ) - SV_GridCoord( mins[0] - half, 0 ) + 1 )
+			* ( SV_GridCoord( maxs[1] + half, 1 ) - SV_GridCoord( mins[1] - half, 1 ) + 1 );
+		if ( cells <= GRID_SCAN_CELLS ) {
+			return SV_AreaEntities( mins, maxs, entityList, maxcount );
+		}
+	}
+
+	return SV_BoundsEntities( mins, maxs, entityList, maxcount );
+}
+
 
 
 //===========================================================================
@@ -455,6 +783,48 @@ typedef struct {
 } moveclip_t;
 
 
+/*
+The trace cache is direct mapped.  Entries from older generations are
+never matched, so invalidating only has to bump sv_traceGeneration.
+*/
+#define	TRACE_CACHE_SIZE	512		// must be a power of two
+
+typedef struct {
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	int			passEntityNum;
+	int			contentmask;
+	int			capsule;
+	int			generation;
+} traceCacheKey_t;
+
+typedef struct {
+	traceCacheKey_t	key;
+	trace_t			trace;
+} traceCacheEntry_t;
+
+static traceCacheEntry_t	sv_traceCacheEntries[TRACE_CACHE_SIZE];
+static int		sv_traceGeneration = 1;		// zeroed entries never match
+static int		sv_traceCacheHits;
+static int		sv_traceCacheMisses;
+
+/*
+SV_PointContents keeps the SV_AreaEntities candidates of recent points
+the same way.  They only change when an entity is linked or unlinked, so
+unlike traces they are reused whether sv_traceCache is set or not.
+*/
+#define	POINT_CACHE_SIZE		256		// must be a power of two
+#define	POINT_CACHE_ENTITIES	8		// longer lists aren't kept
+
+typedef struct {
+	vec3_t		point;
+	int			generation;
+	int			numEntities;
+	int			entities[POINT_CACHE_ENTITIES];
+} pointCacheEntry_t;
+
+static pointCacheEntry_t	sv_pointCacheEntries[POINT_CACHE_SIZE];
+
 /*
 ====================
 SV_ClipToEntity
@@ -512,7 +882,7 @@ static void SV_ClipMoveToEntities( moveclip_t *clip ) {
 	clipHandle_t	clipHandle;
 	float		*origin, *angles;
 
-	num = SV_AreaEntities( clip->boxmins, clip->boxmaxs, touchlist, MAX_GENTITIES);
+	num = SV_ClipEntities( clip->boxmins, clip->boxmaxs, touchlist, MAX_GENTITIES);
 
 	if ( clip->passEntityNum != ENTITYNUM_NONE ) {
 		passOwnerNum = ( SV_GentityNum( clip->passEntityNum ) )->r.ownerNum;
@@ -587,23 +957,16 @@ static void SV_ClipMoveToEntities( moveclip_t *clip ) {
 
 /*
 ==================
-SV_Trace
+SV_TraceUncached
 
 Moves the given mins/maxs volume through the world from start to end.
 passEntityNum and entities owned by passEntityNum are explicitly not checked.
 ==================
 */
-void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
+static void SV_TraceUncached( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
 	moveclip_t	clip;
 	int			i;
 
-	if ( !mins ) {
-		mins = vec3_origin;
-	}
-	if ( !maxs ) {
-		maxs = vec3_origin;
-	}
-
 	Com_Memset ( &clip, 0, sizeof ( moveclip_t ) );
 
 	// clip to world
@@ -645,6 +1008,136 @@ void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, c
 
 
 
+/*
+==================
+SV_InvalidateTraceCache
+
+Called at the start of every game frame, and whenever an entity is linked
+or unlinked
+==================
+*/
+void SV_InvalidateTraceCache( void ) {
+	sv_traceGeneration++;
+}
+
+/*
+==================
+SV_TraceCacheStats
+
+Prints and resets the hit counters for com_speeds
+==================
+*/
+void SV_TraceCacheStats( void ) {
+	int		total;
+
+	total = sv_traceCacheHits + sv_traceCacheMisses;
+	if ( total ) {
+		Com_Printf( "trace cache: %i/%i hits (%i%%)\n", sv_traceCacheHits, total,
+			sv_traceCacheHits * 100 / total );
+	}
+
+	sv_traceCacheHits = 0;
+	sv_traceCacheMisses = 0;
+}
+
+/*
+==================
+SV_Trace
+
+With sv_traceCache enabled, a trace that repeats one made earlier in the
+same game frame, with no entity relinked in between, returns the stored
+result.  Entity fields the game changes without relinking, such as
+r.contents or r.ownerNum, are not noticed.
+==================
+*/
+void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
+	traceCacheKey_t		key;
+	traceCacheEntry_t	*entry;
+	unsigned int		hash;
+	int					i;
+
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	// the cache isn't locked, the worker threads go around it
+	if ( !sv_traceCache->integer || Com_WorkerIndex() ) {
+		SV_TraceUncached( results, start, mins, maxs, end, passEntityNum, contentmask, capsule );
+		return;
+	}
+
+	Com_Memset( &key, 0, sizeof( key ) );
+	VectorCopy( start, key.start );
+	VectorCopy( end, key.end );
+	VectorCopy( mins, key.mins );
+	VectorCopy( maxs, key.maxs );
+	key.passEntityNum = passEntityNum;
+	key.contentmask = contentmask;
+	key.capsule = capsule;
+	key.generation = sv_traceGeneration;
+
+	hash = 2166136261u;
+	for ( i = 0 ; i < sizeof( key ) / sizeof( int ) ; i++ ) {
+		hash = ( hash ^ ((int *)&key)[i] ) * 16777619u;
+	}
+	entry = &sv_traceCacheEntries[hash & ( TRACE_CACHE_SIZE - 1 )];
+
+	if ( !memcmp( &entry->key, &key, sizeof( key ) ) ) {
+		sv_traceCacheHits++;
+		*results = entry->trace;
+		return;
+	}
+
+	sv_traceCacheMisses++;
+	SV_TraceUncached( results, start, mins, maxs, end, passEntityNum, contentmask, capsule );
+
+	entry->key = key;
+	entry->trace = *results;
+}
+
+/*
+=============
+SV_PointEntities
+
+SV_AreaEntities for a point, through the point cache
+=============
+*/
+static int SV_PointEntities( const vec3_t p, int *touch ) {
+	pointCacheEntry_t	*entry;
+	unsigned int		hash;
+	int					i, num;
+
+	// the cache isn't locked, the worker threads go around it
+	if ( Com_WorkerIndex() ) {
+		return SV_AreaEntities( p, p, touch, MAX_GENTITIES );
+	}
+
+	hash = 2166136261u;
+	for ( i = 0 ; i < 3 ; i++ ) {
+		hash = ( hash ^ ((int *)p)[i] ) * 16777619u;
+	}
+	entry = &sv_pointCacheEntries[hash & ( POINT_CACHE_SIZE - 1 )];
+
+	if ( entry->generation == sv_traceGeneration && !memcmp( entry->point, p, sizeof( entry->point ) ) ) {
+		Com_Memcpy( touch, entry->entities, entry->numEntities * sizeof( *touch ) );
+		return entry->numEntities;
+	}
+
+	num = SV_AreaEntities( p, p, touch, MAX_GENTITIES );
+
+	if ( num <= POINT_CACHE_ENTITIES ) {
+		VectorCopy( p, entry->point );
+		entry->generation = sv_traceGeneration;
+		entry->numEntities = num;
+		Com_Memcpy( entry->entities, touch, num * sizeof( *touch ) );
+	}
+
+	return num;
+}
+
 /*
 =============
 SV_PointContents
@@ -662,7 +1155,7 @@ int SV_PointContents( const vec3_t p, int passEntityNum ) {
 	contents = CM_PointContents( p, 0 );
 
 	// or in contents from all the other entities
-	num = SV_AreaEntities( p, p, touch, MAX_GENTITIES );
+	num = SV_PointEntities( p, touch );
 
 	for ( i=0 ; i<num ; i++ ) {
 		if ( touch[i] == passEntityNum ) {
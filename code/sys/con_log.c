@@ -127,3 +127,121 @@ unsigned int CON_LogRead( char *out, unsigned int outSize )
 
 	return outSize;
 }
+
+/*
+Com_Printf on any thread but the main one can't touch the console, the
+tty, qconsole.log or an rcon redirect, so the message is queued here and
+printed from the main thread by Com_DrainPrints. This is a bounded multi
+producer, single consumer ring: a producer claims a slot by moving
+printTail on with a compare and swap and hands the slot over through its
+sequence. Nothing ever waits, when the ring is full the message is
+dropped and counted.
+
+A slot at position pos is free for the producer of pos when its sequence
+is pos, and ready for the main thread when it is pos + 1. The sequences
+are kept relative to the slot index so the ring starts out zeroed.
+*/
+
+#define MAX_QUEUED_PRINTS	256		// power of two
+#define QUEUED_PRINT_SIZE	1024
+
+typedef struct {
+	volatile int	sequence;
+	qboolean		devPrint;
+	char			text[ QUEUED_PRINT_SIZE ];
+} queuedPrint_t;
+
+static queuedPrint_t	printRing[ MAX_QUEUED_PRINTS ];
+static volatile int		printTail = 0;
+static unsigned int		printHead = 0;
+static volatile int		printsDropped = 0;
+
+/*
+==================
+Sys_QueuePrint
+
+Safe on any thread, returns qfalse when the message was dropped
+==================
+*/
+qboolean Sys_QueuePrint( const char *msg, qboolean devPrint )
+{
+	queuedPrint_t	*slot;
+	unsigned int	pos, index;
+	int				diff;
+
+	while( 1 )
+	{
+		pos = (unsigned int)printTail;
+		index = pos & ( MAX_QUEUED_PRINTS - 1 );
+		slot = &printRing[ index ];
+		diff = (int)( (unsigned int)slot->sequence + index - pos );
+
+		if( diff == 0 )
+		{
+			if( Sys_AtomicCompareExchange( &printTail, (int)pos, (int)( pos + 1 ) ) )
+				break;
+		}
+		else if( diff < 0 )
+		{
+			// not printed yet since the last time around
+			Sys_AtomicAdd( &printsDropped, 1 );
+			return qfalse;
+		}
+	}
+
+	Q_strncpyz( slot->text, msg, sizeof( slot->text ) );
+	slot->devPrint = devPrint;
+
+	Sys_MemoryBarrier( );
+	slot->sequence = (int)( pos + 1 - index );
+
+	return qtrue;
+}
+
+/*
+==================
+Sys_NextQueuedPrint
+
+Main thread only, qfalse once the ring is empty
+==================
+*/
+qboolean Sys_NextQueuedPrint( char *out, int outSize, qboolean *devPrint )
+{
+	queuedPrint_t	*slot;
+	unsigned int	index;
+
+	index = printHead & ( MAX_QUEUED_PRINTS - 1 );
+	slot = &printRing[ index ];
+
+	if( (unsigned int)slot->sequence + index != printHead + 1 )
+		return qfalse;
+
+	Sys_MemoryBarrier( );
+
+	Q_strncpyz( out, slot->text, outSize );
+	*devPrint = slot->devPrint;
+
+	// free for the producer one time around later
+	Sys_MemoryBarrier( );
+	slot->sequence = (int)( printHead + MAX_QUEUED_PRINTS - index );
+	printHead++;
+
+	return qtrue;
+}
+
+/*
+==================
+Sys_QueuedPrintsDropped
+
+Main thread only, the messages dropped since the last call
+==================
+*/
+int Sys_QueuedPrintsDropped( void )
+{
+	int dropped = printsDropped;
+
+	if( dropped )
+		Sys_AtomicAdd( &printsDropped, -dropped );
+
+	return dropped;
+}
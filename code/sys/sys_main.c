@@ -193,9 +193,25 @@ Sys_RemovePIDFile
 void Sys_RemovePIDFile( const char *gamedir )
 {
 	char *pidFile = Sys_PIDFileName( gamedir );
+	char pidBuffer[ 64 ] = { 0 };
+	FILE *f;
 
-	if( pidFile != NULL )
-		remove( pidFile );
+	if( pidFile == NULL )
+		return;
+
+	// a forked server leaves the file of the one that started it
+	if( ( f = fopen( pidFile, "r" ) ) != NULL )
+	{
+		if( fread( pidBuffer, sizeof( char ), sizeof( pidBuffer ) - 1, f ) > 0 &&
+			atoi( pidBuffer ) != Sys_PID( ) )
+		{
+			fclose( f );
+			return;
+		}
+		fclose( f );
+	}
+
+	remove( pidFile );
 }
 
 /*
@@ -329,6 +345,15 @@ cpuFeatures_t Sys_GetProcessorFeatures( void )
 	if( SDL_HasAltiVec( ) )    features |= CF_ALTIVEC;
 #endif
 
+	// newer than the SDL headers, and wanted by the dedicated server too
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) && ( idx64 || id386 )
+	__builtin_cpu_init( );
+	if( __builtin_cpu_supports( "sse4.1" ) ) features |= CF_SSE41;
+	if( __builtin_cpu_supports( "avx2" ) )   features |= CF_AVX2;
+#elif defined( __aarch64__ )
+	features |= CF_NEON;
+#endif
+
 	return features;
 }
 
@@ -767,6 +792,9 @@ int main( int argc, char **argv )
 	signal( SIGTERM, Sys_SigHandler );
 	signal( SIGINT, Sys_SigHandler );
 
+	// a VM loaded by Com_Init may have set one up already
+	Sys_ChainFaultHandler( );
+
 	while( 1 )
 	{
 		Com_Frame( );
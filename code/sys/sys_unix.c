@@ -20,6 +20,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 ===========================================================================
 */
 
+#ifdef __linux__
+	// needed for dladdr() and the REG_* names in ucontext_t
+#	define _GNU_SOURCE
+#endif
+
 #include "../qcommon/q_shared.h"
 #include "../qcommon/qcommon.h"
 #include "sys_local.h"
@@ -33,11 +38,24 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <time.h>
 #include <pwd.h>
 #include <libgen.h>
 #include <fcntl.h>
 #include <fenv.h>
 #include <sys/wait.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#ifdef __linux__
+#include <ucontext.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/inotify.h>
+#endif
+#include <sys/resource.h>
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
 
 qboolean stdinIsATTY;
 
@@ -123,33 +141,50 @@ char *Sys_GogPath( void )
 /*
 ================
 Sys_Milliseconds
+
+The monotonic clock from the first call, so an NTP step or slew can't
+move game time. 0x7fffffff ms wraps after ~24 days, callers compare
+differences.
 ================
 */
-/* base time in seconds, that's our origin
-   timeval:tv_sec is an int:
-   assuming this wraps every 0x7fffffff - ~68 years since the Epoch (1970) - we're safe till 2038 */
-unsigned long sys_timeBase = 0;
-/* current time in ms, using sys_timeBase as origin
-   NOTE: sys_timeBase*1000 + curtime -> ms since the Epoch
-     0x7fffffff ms - ~24 days
-   although timeval:tv_usec is an int, I'm not sure wether it is actually used as an unsigned int
-     (which would affect the wrap period) */
-int curtime;
+static int64_t sys_timeBase = -1;
 int Sys_Milliseconds (void)
 {
-	struct timeval tp;
+	int64_t now = Sys_Microseconds();
 
-	gettimeofday(&tp, NULL);
+	if (sys_timeBase == -1)
+		sys_timeBase = now;
 
-	if (!sys_timeBase)
-	{
-		sys_timeBase = tp.tv_sec;
-		return tp.tv_usec/1000;
-	}
+	return (int)((now - sys_timeBase) / 1000);
+}
+
+/*
+================
+Sys_Microseconds
+================
+*/
+int64_t Sys_Microseconds (void)
+{
+#if defined( __APPLE__ )
+	static mach_timebase_info_data_t timebase;
+
+	if (!timebase.denom)
+		mach_timebase_info(&timebase);
+
+	return (int64_t)(mach_absolute_time() * timebase.numer / timebase.denom / 1000);
+#elif defined( CLOCK_MONOTONIC )
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	curtime = (tp.tv_sec - sys_timeBase)*1000 + tp.tv_usec/1000;
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	struct timeval tp;
+
+	gettimeofday(&tp, NULL);
 
-	return curtime;
+	return (int64_t)tp.tv_sec * 1000000 + tp.tv_usec;
+#endif
 }
 
 /*
@@ -241,6 +276,29 @@ FILE *Sys_FOpen( const char *ospath, const char *mode ) {
 	return fopen( ospath, mode );
 }
 
+/*
+==============
+Sys_FCreate
+
+Creates a file for writing that only this user can read and write, NULL
+if it exists already
+==============
+*/
+FILE *Sys_FCreate( const char *ospath ) {
+	FILE	*f;
+	int		fd;
+
+	fd = open( ospath, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, S_IRUSR | S_IWUSR );
+	if ( fd == -1 )
+		return NULL;
+
+	f = fdopen( fd, "wb" );
+	if ( !f )
+		close( fd );
+
+	return f;
+}
+
 /*
 ==================
 Sys_Mkdir
@@ -256,6 +314,284 @@ qboolean Sys_Mkdir( const char *path )
 	return qtrue;
 }
 
+/*
+==================
+Sys_StatFile
+==================
+*/
+qboolean Sys_StatFile( const char *ospath, int64_t *size, int64_t *mtime )
+{
+	struct stat buf;
+
+	if( stat( ospath, &buf ) || !S_ISREG( buf.st_mode ) )
+		return qfalse;
+
+	*size = buf.st_size;
+	*mtime = buf.st_mtime;
+	return qtrue;
+}
+
+/*
+==================
+Sys_MapFile
+
+Maps a whole file read only, NULL if it can't be mapped
+==================
+*/
+void *Sys_MapFile( const char *ospath, int *length )
+{
+	struct stat	buf;
+	void		*data;
+	int			fd;
+
+	fd = open( ospath, O_RDONLY );
+	if( fd == -1 )
+		return NULL;
+
+	if( fstat( fd, &buf ) || !S_ISREG( buf.st_mode ) || buf.st_size <= 0 || buf.st_size > 0x7fffffff )
+	{
+		close( fd );
+		return NULL;
+	}
+
+	data = mmap( NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+
+	if( data == MAP_FAILED )
+		return NULL;
+
+	*length = buf.st_size;
+	return data;
+}
+
+/*
+==================
+Sys_UnmapFile
+==================
+*/
+void Sys_UnmapFile( void *data, int length )
+{
+	munmap( data, length );
+}
+
+struct sysDirWatch_s
+{
+	int		fd;
+	char	filter[MAX_QPATH];
+};
+
+/*
+==================
+Sys_WatchDirectory
+
+Reports files whose names contain filter showing up, going away or
+being written to in path, inotify only
+==================
+*/
+sysDirWatch_t *Sys_WatchDirectory( const char *path, const char *filter )
+{
+#ifdef __linux__
+	sysDirWatch_t	*watch;
+	int				fd;
+
+	fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if( fd == -1 )
+		return NULL;
+
+	if( inotify_add_watch( fd, path, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+		IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR ) == -1 )
+	{
+		close( fd );
+		return NULL;
+	}
+
+	watch = malloc( sizeof( *watch ) );
+	if( !watch )
+	{
+		close( fd );
+		return NULL;
+	}
+
+	watch->fd = fd;
+	Q_strncpyz( watch->filter, filter, sizeof( watch->filter ) );
+	return watch;
+#else
+	return NULL;
+#endif
+}
+
+/*
+==================
+Sys_DirectoryChanged
+
+Whether anything was reported since the watch was set up or last asked
+==================
+*/
+qboolean Sys_DirectoryChanged( sysDirWatch_t *watch )
+{
+#ifdef __linux__
+	char						buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event	*event;
+	qboolean					changed = qfalse;
+	ssize_t						len;
+	char						*p;
+
+	while( ( len = read( watch->fd, buf, sizeof( buf ) ) ) > 0 )
+	{
+		for( p = buf; p < buf + len; p += sizeof( *event ) + event->len )
+		{
+			event = (const struct inotify_event *)p;
+
+			// the directory itself went away or events were lost
+			if( event->mask & ( IN_Q_OVERFLOW | IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF ) )
+				changed = qtrue;
+			else if( event->len && Q_stristr( event->name, watch->filter ) )
+				changed = qtrue;
+		}
+	}
+
+	if( len == -1 && errno != EAGAIN && errno != EINTR )
+		changed = qtrue;
+
+	return changed;
+#else
+	return qtrue;
+#endif
+}
+
+/*
+==================
+Sys_UnwatchDirectory
+==================
+*/
+void Sys_UnwatchDirectory( sysDirWatch_t *watch )
+{
+	close( watch->fd );
+	free( watch );
+}
+
+/*
+==================
+Sys_ReserveMemory
+
+Reserves zeroed address space at exactly base, NULL if any of it is
+taken; pages only cost memory once touched
+==================
+*/
+void *Sys_ReserveMemory( void *base, size_t size )
+{
+	void	*data;
+
+#ifdef MAP_FIXED_NOREPLACE
+	data = mmap( base, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE|MAP_FIXED_NOREPLACE, -1, 0 );
+#else
+	data = mmap( base, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0 );
+#endif
+	if( data == MAP_FAILED )
+		return NULL;
+
+	// older kernels take the address as a hint only
+	if( data != base )
+	{
+		munmap( data, size );
+		return NULL;
+	}
+
+	return data;
+}
+
+/*
+==================
+Sys_OpenPrivate
+
+Opens a regular file for reading that belongs to this user and is writable
+by nobody else, without following a link. -1 otherwise
+==================
+*/
+static int Sys_OpenPrivate( const char *ospath, struct stat *buf )
+{
+	int		fd;
+
+	fd = open( ospath, O_RDONLY | O_NOFOLLOW );
+	if( fd == -1 )
+		return -1;
+
+	if( fstat( fd, buf ) || !S_ISREG( buf->st_mode ) ||
+		buf->st_uid != geteuid() || ( buf->st_mode & ( S_IWGRP | S_IWOTH ) ) )
+	{
+		close( fd );
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+==================
+Sys_FOpenPrivate
+
+Opens a file for reading, NULL unless only this user can have written it
+==================
+*/
+FILE *Sys_FOpenPrivate( const char *ospath )
+{
+	struct stat	buf;
+	FILE		*f;
+	int			fd;
+
+	fd = Sys_OpenPrivate( ospath, &buf );
+	if( fd == -1 )
+		return NULL;
+
+	f = fdopen( fd, "rb" );
+	if( !f )
+		close( fd );
+
+	return f;
+}
+
+/*
+==================
+Sys_MapFileAt
+
+Maps the first length bytes of a file copy-on-write over memory
+reserved at base, so processes mapping the same file share its pages
+until they write to them. The file has to belong to this user and be
+writable by nobody else, whatever is in it is trusted.
+==================
+*/
+qboolean Sys_MapFileAt( const char *ospath, void *base, int length )
+{
+	struct stat	buf;
+	void		*data;
+	int			fd;
+
+	fd = Sys_OpenPrivate( ospath, &buf );
+	if( fd == -1 )
+		return qfalse;
+
+	if( buf.st_size < length )
+	{
+		close( fd );
+		return qfalse;
+	}
+
+	data = mmap( base, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_FIXED, fd, 0 );
+	close( fd );
+
+	return data == base ? qtrue : qfalse;
+}
+
+/*
+==================
+Sys_ReleaseMemory
+==================
+*/
+void Sys_ReleaseMemory( void *base, size_t size )
+{
+	munmap( base, size );
+}
+
 /*
 ==================
 Sys_Mkfifo
@@ -286,6 +622,33 @@ FILE *Sys_Mkfifo( const char *ospath )
 	return fifo;
 }
 
+/*
+==================
+Sys_OpenPipe
+
+Runs command through the shell with its stdin to write to
+==================
+*/
+FILE *Sys_OpenPipe( const char *command )
+{
+	// a program that fails or quits shows up as a failed write, not a signal
+	signal( SIGPIPE, SIG_IGN );
+
+	return popen( command, "w" );
+}
+
+/*
+==================
+Sys_ClosePipe
+
+Waits for the program to finish, returns its exit status
+==================
+*/
+int Sys_ClosePipe( FILE *pipe )
+{
+	return pclose( pipe );
+}
+
 /*
 ==================
 Sys_Cwd
@@ -906,6 +1269,55 @@ int Sys_PID( void )
 	return getpid( );
 }
 
+/*
+==============
+Sys_Fork
+
+The child gets its own random seed and no console input, the parent's
+terminal stays with the parent. The parent reaps it with Sys_ChildExited.
+==============
+*/
+int Sys_Fork( void )
+{
+	pid_t pid;
+	int fd;
+
+	// both processes would write out what's buffered, the log and the
+	// files in fsh[] among it
+	fflush( NULL );
+
+	pid = fork( );
+	if( pid != 0 )
+		return pid;
+
+	srand( getpid( ) ^ time( NULL ) );
+
+	fd = open( "/dev/null", O_RDONLY );
+	if( fd >= 0 )
+	{
+		dup2( fd, STDIN_FILENO );
+		close( fd );
+	}
+
+	return 0;
+}
+
+/*
+==============
+Sys_ChildExited
+
+Reaps a child of Sys_Fork if it's gone, without waiting for it
+==============
+*/
+qboolean Sys_ChildExited( int pid )
+{
+	pid_t result;
+
+	result = waitpid( pid, NULL, WNOHANG );
+
+	return ( result == pid || ( result == -1 && errno == ECHILD ) ) ? qtrue : qfalse;
+}
+
 /*
 ==============
 Sys_PIDIsRunning
@@ -964,3 +1376,601 @@ qboolean Sys_DllExtension( const char *name ) {
 
 	return qfalse;
 }
+
+/*
+==============================================================================
+
+THREADS
+
+==============================================================================
+*/
+
+struct sysThread_s
+{
+	pthread_t	thread;
+	void		(*func)( void *arg );
+	void		*arg;
+};
+
+struct sysMutex_s
+{
+	pthread_mutex_t	mutex;
+};
+
+// unnamed POSIX semaphores aren't available on OS X, so build one
+struct sysSemaphore_s
+{
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	int				count;
+};
+
+/*
+==============
+Sys_ProcessorCount
+==============
+*/
+int Sys_ProcessorCount( void )
+{
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+
+	return count > 0 ? (int)count : 1;
+}
+
+#ifdef __linux__
+#define MAX_PLACEMENT_CPUS	256
+#define MPOL_LOCAL			4		// not in the libc headers without libnuma
+
+static int		sys_cpus[ MAX_PLACEMENT_CPUS ];	// com_affinity, in order
+static int		sys_numCpus;
+
+/*
+==============
+Sys_SetThreadCpus
+
+The calling thread onto cpus[0 .. count)
+==============
+*/
+static qboolean Sys_SetThreadCpus( const int *cpus, int count )
+{
+	cpu_set_t	set;
+	int			i;
+
+	CPU_ZERO( &set );
+	for( i = 0; i < count; i++ )
+		CPU_SET( cpus[ i ], &set );
+
+	return pthread_setaffinity_np( pthread_self( ), sizeof( set ), &set ) == 0;
+}
+#endif
+
+/*
+==============
+Sys_SetPlacement
+
+Called early in Com_Init, before the hunk is allocated. The main thread
+goes onto the first of cpus, Sys_PinThread puts worker threads on the
+ones after it and any other thread runs on all of them. nice is a
+setpriority level, realtime a SCHED_FIFO priority that the threads
+created later inherit. numa keeps allocations on the node of the CPU
+that first touches them.
+==============
+*/
+void Sys_SetPlacement( const int *cpus, int numCpus, int nice, int realtime, qboolean numa )
+{
+	struct sched_param	param;
+
+	if( numCpus > 0 )
+	{
+#ifdef __linux__
+		int i;
+
+		sys_numCpus = 0;
+		for( i = 0; i < numCpus && sys_numCpus < MAX_PLACEMENT_CPUS; i++ )
+		{
+			if( cpus[ i ] >= 0 && cpus[ i ] < CPU_SETSIZE )
+				sys_cpus[ sys_numCpus++ ] = cpus[ i ];
+		}
+
+		if( sys_numCpus && Sys_SetThreadCpus( sys_cpus, 1 ) )
+			Com_Printf( "Main thread on CPU %i, %i CPUs for the process\n", sys_cpus[ 0 ], sys_numCpus );
+		else
+		{
+			Com_Printf( "WARNING: couldn't set the CPU affinity\n" );
+			sys_numCpus = 0;
+		}
+#else
+		Com_Printf( "WARNING: CPU affinity isn't supported on this platform\n" );
+#endif
+	}
+
+	if( nice )
+	{
+		if( setpriority( PRIO_PROCESS, 0, nice ) )
+			Com_Printf( "WARNING: couldn't set the nice level to %i: %s\n", nice, strerror( errno ) );
+	}
+
+	if( realtime > 0 )
+	{
+		memset( &param, 0, sizeof( param ) );
+		param.sched_priority = realtime;
+		if( pthread_setschedparam( pthread_self( ), SCHED_FIFO, &param ) )
+			Com_Printf( "WARNING: couldn't switch to SCHED_FIFO priority %i\n", realtime );
+		else
+			Com_Printf( "SCHED_FIFO priority %i\n", realtime );
+	}
+
+	if( numa )
+	{
+#if defined( __linux__ ) && defined( SYS_set_mempolicy )
+		if( syscall( SYS_set_mempolicy, MPOL_LOCAL, NULL, 0 ) )
+			Com_Printf( "WARNING: couldn't set the NUMA memory policy: %s\n", strerror( errno ) );
+#else
+		Com_Printf( "WARNING: NUMA placement isn't supported on this platform\n" );
+#endif
+	}
+}
+
+/*
+==============
+Sys_PinThread
+
+Worker index onto its own CPU of com_affinity, after the main thread's
+==============
+*/
+void Sys_PinThread( int index )
+{
+#ifdef __linux__
+	if( sys_numCpus > 1 )
+		Sys_SetThreadCpus( &sys_cpus[ index % sys_numCpus ], 1 );
+#endif
+}
+
+/*
+==============
+Sys_LockMemory
+
+Faults in and locks base, the pages never get swapped out
+==============
+*/
+void Sys_LockMemory( void *base, size_t size )
+{
+	if( mlock( base, size ) )
+		Com_Printf( "WARNING: couldn't lock %i megs of memory: %s\n", (int)( size >> 20 ), strerror( errno ) );
+	else
+		Com_Printf( "%i megs of memory locked\n", (int)( size >> 20 ) );
+}
+
+/*
+==============
+Sys_ThreadMain
+==============
+*/
+static void *Sys_ThreadMain( void *arg )
+{
+	sysThread_t *thread = arg;
+
+#ifdef __linux__
+	// off the main thread's CPU, onto all of com_affinity
+	if( sys_numCpus > 1 )
+		Sys_SetThreadCpus( sys_cpus, sys_numCpus );
+#endif
+
+	thread->func( thread->arg );
+
+	return NULL;
+}
+
+/*
+==============
+Sys_CreateThread
+==============
+*/
+sysThread_t *Sys_CreateThread( void (*func)( void *arg ), void *arg )
+{
+	sysThread_t *thread = malloc( sizeof( *thread ) );
+	sigset_t	set, old;
+	int			result;
+
+	if( !thread )
+		return NULL;
+
+	thread->func = func;
+	thread->arg = arg;
+
+	// the profiling timer only samples the main thread
+	sigemptyset( &set );
+	sigaddset( &set, SIGPROF );
+	pthread_sigmask( SIG_BLOCK, &set, &old );
+
+	result = pthread_create( &thread->thread, NULL, Sys_ThreadMain, thread );
+
+	pthread_sigmask( SIG_SETMASK, &old, NULL );
+
+	if( result )
+	{
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+/*
+==============
+Sys_JoinThread
+==============
+*/
+void Sys_JoinThread( sysThread_t *thread )
+{
+	pthread_join( thread->thread, NULL );
+	free( thread );
+}
+
+/*
+==============
+Sys_CreateMutex
+==============
+*/
+sysMutex_t *Sys_CreateMutex( void )
+{
+	sysMutex_t *mutex = malloc( sizeof( *mutex ) );
+
+	if( !mutex )
+		return NULL;
+
+	if( pthread_mutex_init( &mutex->mutex, NULL ) )
+	{
+		free( mutex );
+		return NULL;
+	}
+
+	return mutex;
+}
+
+/*
+==============
+Sys_DestroyMutex
+==============
+*/
+void Sys_DestroyMutex( sysMutex_t *mutex )
+{
+	pthread_mutex_destroy( &mutex->mutex );
+	free( mutex );
+}
+
+/*
+==============
+Sys_LockMutex
+==============
+*/
+void Sys_LockMutex( sysMutex_t *mutex )
+{
+	pthread_mutex_lock( &mutex->mutex );
+}
+
+/*
+==============
+Sys_UnlockMutex
+==============
+*/
+void Sys_UnlockMutex( sysMutex_t *mutex )
+{
+	pthread_mutex_unlock( &mutex->mutex );
+}
+
+/*
+==============
+Sys_CreateSemaphore
+==============
+*/
+sysSemaphore_t *Sys_CreateSemaphore( void )
+{
+	sysSemaphore_t *sem = malloc( sizeof( *sem ) );
+
+	if( !sem )
+		return NULL;
+
+	if( pthread_mutex_init( &sem->mutex, NULL ) )
+	{
+		free( sem );
+		return NULL;
+	}
+
+	if( pthread_cond_init( &sem->cond, NULL ) )
+	{
+		pthread_mutex_destroy( &sem->mutex );
+		free( sem );
+		return NULL;
+	}
+
+	sem->count = 0;
+
+	return sem;
+}
+
+/*
+==============
+Sys_DestroySemaphore
+==============
+*/
+void Sys_DestroySemaphore( sysSemaphore_t *sem )
+{
+	pthread_cond_destroy( &sem->cond );
+	pthread_mutex_destroy( &sem->mutex );
+	free( sem );
+}
+
+/*
+==============
+Sys_PostSemaphore
+==============
+*/
+void Sys_PostSemaphore( sysSemaphore_t *sem )
+{
+	pthread_mutex_lock( &sem->mutex );
+	sem->count++;
+	pthread_cond_signal( &sem->cond );
+	pthread_mutex_unlock( &sem->mutex );
+}
+
+/*
+==============
+Sys_WaitSemaphore
+==============
+*/
+void Sys_WaitSemaphore( sysSemaphore_t *sem )
+{
+	pthread_mutex_lock( &sem->mutex );
+	while( sem->count == 0 )
+		pthread_cond_wait( &sem->cond, &sem->mutex );
+	sem->count--;
+	pthread_mutex_unlock( &sem->mutex );
+}
+
+/*
+==============
+Sys_MemoryBarrier
+
+Orders the memory accesses before and after it, for lock-free
+hand-offs between threads
+==============
+*/
+void Sys_MemoryBarrier( void )
+{
+	__sync_synchronize( );
+}
+
+/*
+==============
+Sys_AtomicAdd
+
+Returns the new value, a full barrier like Sys_MemoryBarrier
+==============
+*/
+int Sys_AtomicAdd( volatile int *value, int add )
+{
+	return __sync_add_and_fetch( value, add );
+}
+
+/*
+==============
+Sys_AtomicCompareExchange
+
+Sets *value to exchange if it is still compare, a full barrier
+==============
+*/
+qboolean Sys_AtomicCompareExchange( volatile int *value, int compare, int exchange )
+{
+	return __sync_bool_compare_and_swap( value, compare, exchange ) ? qtrue : qfalse;
+}
+
+/*
+==============================================================================
+
+PROFILING
+
+==============================================================================
+*/
+
+static void (*sys_profileHandler)( void *ip, void *sp, void *fp );
+
+#if defined( __linux__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) || defined( __aarch64__ ) )
+/*
+==============
+Sys_ProfileSignal
+==============
+*/
+static void Sys_ProfileSignal( int sig, siginfo_t *info, void *context )
+{
+	ucontext_t	*uc = context;
+	int			saved = errno;
+
+#ifdef __x86_64__
+	sys_profileHandler( (void *)uc->uc_mcontext.gregs[REG_RIP], (void *)uc->uc_mcontext.gregs[REG_RSP],
+		(void *)uc->uc_mcontext.gregs[REG_RBP] );
+#elif defined( __aarch64__ )
+	sys_profileHandler( (void *)uc->uc_mcontext.pc, (void *)uc->uc_mcontext.sp,
+		(void *)uc->uc_mcontext.regs[29] );
+#else
+	sys_profileHandler( (void *)uc->uc_mcontext.gregs[REG_EIP], (void *)uc->uc_mcontext.gregs[REG_ESP],
+		(void *)uc->uc_mcontext.gregs[REG_EBP] );
+#endif
+
+	errno = saved;
+}
+#endif
+
+/*
+==============
+Sys_StartProfileTimer
+
+The handler is called from a signal handler on the main thread, hz times
+a second of CPU time, with the registers of the code it interrupted
+==============
+*/
+qboolean Sys_StartProfileTimer( int hz, void (*handler)( void *ip, void *sp, void *fp ) )
+{
+#if defined( __linux__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) || defined( __aarch64__ ) )
+	struct sigaction	action;
+	struct itimerval	timer;
+
+	sys_profileHandler = handler;
+
+	memset( &action, 0, sizeof( action ) );
+	action.sa_sigaction = Sys_ProfileSignal;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset( &action.sa_mask );
+	if( sigaction( SIGPROF, &action, NULL ) )
+		return qfalse;
+
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = 1000000 / hz;
+	timer.it_value = timer.it_interval;
+	if( setitimer( ITIMER_PROF, &timer, NULL ) )
+	{
+		signal( SIGPROF, SIG_IGN );
+		return qfalse;
+	}
+
+	return qtrue;
+#else
+	return qfalse;
+#endif
+}
+
+/*
+==============
+Sys_StopProfileTimer
+==============
+*/
+void Sys_StopProfileTimer( void )
+{
+	struct itimerval	timer;
+
+	memset( &timer, 0, sizeof( timer ) );
+	setitimer( ITIMER_PROF, &timer, NULL );
+
+	// one could still be pending, and the default action is to exit
+	signal( SIGPROF, SIG_IGN );
+}
+
+/*
+==============
+Sys_AddressToSymbol
+
+Names the function at address if it is in the same module as
+moduleAddress, or its offset into the module if that isn't exported
+==============
+*/
+qboolean Sys_AddressToSymbol( const void *address, const void *moduleAddress, char *name, int size )
+{
+	Dl_info	info, module;
+
+	if( !dladdr( (void *)address, &info ) || !dladdr( (void *)moduleAddress, &module ) )
+		return qfalse;
+
+	if( info.dli_fbase != module.dli_fbase )
+		return qfalse;
+
+	if( info.dli_sname )
+		Q_strncpyz( name, info.dli_sname, size );
+	else
+		Com_sprintf( name, size, "0x%lx", (unsigned long)( (const byte *)address - (const byte *)info.dli_fbase ) );
+
+	return qtrue;
+}
+
+/*
+==============================================================================
+
+MEMORY FAULTS
+
+==============================================================================
+*/
+
+static void *(*sys_faultHandler)( void *address, void *ip );
+
+#if defined( __linux__ ) && defined( __x86_64__ )
+static struct sigaction	sys_faultChain;
+
+/*
+==============
+Sys_FaultSignal
+==============
+*/
+static void Sys_FaultSignal( int sig, siginfo_t *info, void *context )
+{
+	ucontext_t	*uc = context;
+	greg_t		*regs = uc->uc_mcontext.gregs;
+	void		*resume;
+
+	resume = sys_faultHandler( info->si_addr, (void *)regs[REG_RIP] );
+	if( resume )
+	{
+		// as if it was called from where it faulted
+		regs[REG_RSP] = ( regs[REG_RSP] & ~15 ) - 8;
+		regs[REG_RIP] = (greg_t)resume;
+		return;
+	}
+
+	if( sys_faultChain.sa_flags & SA_SIGINFO )
+		sys_faultChain.sa_sigaction( sig, info, context );
+	else if( sys_faultChain.sa_handler != SIG_DFL && sys_faultChain.sa_handler != SIG_IGN )
+		sys_faultChain.sa_handler( sig );
+	else
+	{
+		// faults again on the way back, without this in the way
+		sigaction( sig, &sys_faultChain, NULL );
+	}
+}
+#endif
+
+/*
+==============
+Sys_ChainFaultHandler
+
+Puts the fault handler back in front of whatever SIGSEGV handler was
+installed since it was set
+==============
+*/
+void Sys_ChainFaultHandler( void )
+{
+#if defined( __linux__ ) && defined( __x86_64__ )
+	struct sigaction	action, current;
+
+	if( !sys_faultHandler )
+		return;
+
+	if( sigaction( SIGSEGV, NULL, &current ) || ( ( current.sa_flags & SA_SIGINFO ) && current.sa_sigaction == Sys_FaultSignal ) )
+		return;
+
+	memset( &action, 0, sizeof( action ) );
+	action.sa_sigaction = Sys_FaultSignal;
+	action.sa_flags = SA_SIGINFO;
+	sigemptyset( &action.sa_mask );
+	if( !sigaction( SIGSEGV, &action, &sys_faultChain ) )
+		return;
+
+	Com_Printf( "WARNING: couldn't install the memory fault handler\n" );
+#endif
+}
+
+/*
+==============
+Sys_SetFaultHandler
+==============
+*/
+qboolean Sys_SetFaultHandler( void *(*handler)( void *address, void *ip ) )
+{
+#if defined( __linux__ ) && defined( __x86_64__ )
+	struct sigaction	current;
+
+	sys_faultHandler = handler;
+	Sys_ChainFaultHandler( );
+
+	return !sigaction( SIGSEGV, NULL, &current ) && ( current.sa_flags & SA_SIGINFO ) && current.sa_sigaction == Sys_FaultSignal;
+#else
+	return qfalse;
+#endif
+}
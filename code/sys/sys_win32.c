@@ -33,6 +33,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <stdio.h>
 #include <direct.h>
 #include <io.h>
+#include <sys/stat.h>
 #include <conio.h>
 #include <wincrypt.h>
 #include <shlobj.h>
@@ -225,21 +226,39 @@ char *Sys_GogPath( void )
 /*
 ================
 Sys_Milliseconds
+
+The performance counter from the first call, the same clock as
+Sys_Microseconds and not held to the timeBeginPeriod resolution
 ================
 */
-int sys_timeBase;
+static int64_t sys_timeBase = -1;
 int Sys_Milliseconds (void)
 {
-	int             sys_curtime;
-	static qboolean initialized = qfalse;
+	int64_t now = Sys_Microseconds();
+
+	if (sys_timeBase == -1)
+		sys_timeBase = now;
+
+	return (int)((now - sys_timeBase) / 1000);
+}
 
-	if (!initialized) {
-		sys_timeBase = timeGetTime();
-		initialized = qtrue;
+/*
+================
+Sys_Microseconds
+================
+*/
+int64_t Sys_Microseconds (void)
+{
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER count;
+
+	if (!frequency.QuadPart) {
+		QueryPerformanceFrequency(&frequency);
 	}
-	sys_curtime = timeGetTime() - sys_timeBase;
+	QueryPerformanceCounter(&count);
 
-	return sys_curtime;
+	return (count.QuadPart / frequency.QuadPart) * 1000000 +
+		(count.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
 }
 
 /*
@@ -368,6 +387,47 @@ FILE *Sys_FOpen( const char *ospath, const char *mode ) {
 	return fopen( ospath, mode );
 }
 
+/*
+==============
+Sys_FCreate
+
+Creates a file for writing, NULL if it exists already
+==============
+*/
+FILE *Sys_FCreate( const char *ospath ) {
+	FILE	*f;
+	size_t	length;
+	int		fd;
+
+	length = strlen( ospath );
+	if ( length == 0 || ospath[length-1] == ' ' || ospath[length-1] == '.' ) {
+		return NULL;
+	}
+
+	fd = _open( ospath, _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE );
+	if ( fd == -1 ) {
+		return NULL;
+	}
+
+	f = _fdopen( fd, "wb" );
+	if ( !f ) {
+		_close( fd );
+	}
+
+	return f;
+}
+
+/*
+==============
+Sys_FOpenPrivate
+
+Opens a file for reading, the home directory is private to the user here
+==============
+*/
+FILE *Sys_FOpenPrivate( const char *ospath ) {
+	return Sys_FOpen( ospath, "rb" );
+}
+
 /*
 ==============
 Sys_Mkdir
@@ -384,6 +444,165 @@ qboolean Sys_Mkdir( const char *path )
 	return qtrue;
 }
 
+/*
+==================
+Sys_StatFile
+==================
+*/
+qboolean Sys_StatFile( const char *ospath, int64_t *size, int64_t *mtime )
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+
+	if( !GetFileAttributesExA( ospath, GetFileExInfoStandard, &data ) || ( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) )
+		return qfalse;
+
+	*size = ( (int64_t)data.nFileSizeHigh << 32 ) | data.nFileSizeLow;
+	*mtime = ( (int64_t)data.ftLastWriteTime.dwHighDateTime << 32 ) | data.ftLastWriteTime.dwLowDateTime;
+	return qtrue;
+}
+
+struct sysDirWatch_s
+{
+	HANDLE	change;
+};
+
+/*
+==================
+Sys_WatchDirectory
+
+Change notifications can't tell which file changed, so any file being
+added, removed or written to in path counts and the filter is ignored
+==================
+*/
+sysDirWatch_t *Sys_WatchDirectory( const char *path, const char *filter )
+{
+	sysDirWatch_t	*watch;
+	HANDLE			change;
+
+	change = FindFirstChangeNotificationA( path, FALSE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE );
+	if( change == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	watch = malloc( sizeof( *watch ) );
+	if( !watch )
+	{
+		FindCloseChangeNotification( change );
+		return NULL;
+	}
+
+	watch->change = change;
+	return watch;
+}
+
+/*
+==================
+Sys_DirectoryChanged
+
+Whether anything was reported since the watch was set up or last asked
+==================
+*/
+qboolean Sys_DirectoryChanged( sysDirWatch_t *watch )
+{
+	if( WaitForSingleObject( watch->change, 0 ) != WAIT_OBJECT_0 )
+		return qfalse;
+
+	// the notification stays signalled until it is asked for the next one
+	FindNextChangeNotification( watch->change );
+	return qtrue;
+}
+
+/*
+==================
+Sys_UnwatchDirectory
+==================
+*/
+void Sys_UnwatchDirectory( sysDirWatch_t *watch )
+{
+	FindCloseChangeNotification( watch->change );
+	free( watch );
+}
+
+/*
+==================
+Sys_MapFile
+
+Maps a whole file read only, NULL if it can't be mapped
+==================
+*/
+void *Sys_MapFile( const char *ospath, int *length )
+{
+	HANDLE			file, mapping;
+	LARGE_INTEGER	size;
+	void			*data;
+
+	file = CreateFileA( ospath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	if( !GetFileSizeEx( file, &size ) || size.QuadPart <= 0 || size.QuadPart > 0x7fffffff )
+	{
+		CloseHandle( file );
+		return NULL;
+	}
+
+	mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( file );
+	if( !mapping )
+		return NULL;
+
+	// the view keeps the mapping alive
+	data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+
+	if( !data )
+		return NULL;
+
+	*length = (int)size.QuadPart;
+	return data;
+}
+
+/*
+==================
+Sys_UnmapFile
+==================
+*/
+void Sys_UnmapFile( void *data, int length )
+{
+	UnmapViewOfFile( data );
+}
+
+/*
+==================
+Sys_ReserveMemory
+
+Not supported, callers fall back to their own memory
+==================
+*/
+void *Sys_ReserveMemory( void *base, size_t size )
+{
+	return NULL;
+}
+
+/*
+==================
+Sys_MapFileAt
+==================
+*/
+qboolean Sys_MapFileAt( const char *ospath, void *base, int length )
+{
+	return qfalse;
+}
+
+/*
+==================
+Sys_ReleaseMemory
+==================
+*/
+void Sys_ReleaseMemory( void *base, size_t size )
+{
+}
+
 /*
 ==================
 Sys_Mkfifo
@@ -395,6 +614,26 @@ FILE *Sys_Mkfifo( const char *ospath )
 	return NULL;
 }
 
+/*
+==================
+Sys_OpenPipe
+==================
+*/
+FILE *Sys_OpenPipe( const char *command )
+{
+	return _popen( command, "wb" );
+}
+
+/*
+==================
+Sys_ClosePipe
+==================
+*/
+int Sys_ClosePipe( FILE *pipe )
+{
+	return _pclose( pipe );
+}
+
 /*
 ==============
 Sys_Cwd
@@ -825,6 +1064,28 @@ int Sys_PID( void )
 	return GetCurrentProcessId( );
 }
 
+/*
+==============
+Sys_Fork
+
+Not supported
+==============
+*/
+int Sys_Fork( void )
+{
+	return -1;
+}
+
+/*
+==============
+Sys_ChildExited
+==============
+*/
+qboolean Sys_ChildExited( int pid )
+{
+	return qtrue;
+}
+
 /*
 ==============
 Sys_PIDIsRunning
@@ -861,3 +1122,392 @@ Check if filename should be allowed to be loaded as a DLL.
 qboolean Sys_DllExtension( const char *name ) {
 	return COM_CompareExtension( name, DLL_EXT );
 }
+
+/*
+==============================================================================
+
+THREADS
+
+==============================================================================
+*/
+
+struct sysThread_s
+{
+	HANDLE	handle;
+	void	(*func)( void *arg );
+	void	*arg;
+};
+
+struct sysMutex_s
+{
+	CRITICAL_SECTION	cs;
+};
+
+struct sysSemaphore_s
+{
+	HANDLE	handle;
+};
+
+/*
+==============
+Sys_ProcessorCount
+==============
+*/
+int Sys_ProcessorCount( void )
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo( &info );
+
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+static DWORD_PTR	sys_cpuMask;		// com_affinity
+static int			sys_cpus[ 64 ];
+static int			sys_numCpus;
+
+/*
+==============
+Sys_SetPlacement
+
+Called early in Com_Init, before the hunk is allocated. The main thread
+goes onto the first of cpus, Sys_PinThread puts worker threads on the
+ones after it and any other thread runs on all of them. A negative nice
+raises the priority class, a positive one lowers it, realtime asks for
+the realtime class.
+==============
+*/
+void Sys_SetPlacement( const int *cpus, int numCpus, int nice, int realtime, qboolean numa )
+{
+	int i;
+
+	sys_cpuMask = 0;
+	sys_numCpus = 0;
+
+	for( i = 0; i < numCpus; i++ )
+	{
+		if( cpus[ i ] >= 0 && cpus[ i ] < (int)( sizeof( DWORD_PTR ) * 8 ) && sys_numCpus < ARRAY_LEN( sys_cpus ) )
+		{
+			sys_cpus[ sys_numCpus++ ] = cpus[ i ];
+			sys_cpuMask |= (DWORD_PTR)1 << cpus[ i ];
+		}
+	}
+
+	if( sys_numCpus )
+	{
+		if( SetThreadAffinityMask( GetCurrentThread( ), (DWORD_PTR)1 << sys_cpus[ 0 ] ) )
+			Com_Printf( "Main thread on CPU %i, %i CPUs for the process\n", sys_cpus[ 0 ], sys_numCpus );
+		else
+		{
+			Com_Printf( "WARNING: couldn't set the CPU affinity\n" );
+			sys_cpuMask = 0;
+			sys_numCpus = 0;
+		}
+	}
+
+	if( realtime > 0 )
+	{
+		if( !SetPriorityClass( GetCurrentProcess( ), REALTIME_PRIORITY_CLASS ) )
+			Com_Printf( "WARNING: couldn't switch to the realtime priority class\n" );
+	}
+	else if( nice )
+	{
+		if( !SetPriorityClass( GetCurrentProcess( ), nice < 0 ? HIGH_PRIORITY_CLASS : BELOW_NORMAL_PRIORITY_CLASS ) )
+			Com_Printf( "WARNING: couldn't change the priority class\n" );
+	}
+
+	if( numa )
+		Com_Printf( "WARNING: NUMA placement isn't supported on this platform\n" );
+}
+
+/*
+==============
+Sys_PinThread
+
+Worker index onto its own CPU of com_affinity, after the main thread's
+==============
+*/
+void Sys_PinThread( int index )
+{
+	if( sys_numCpus > 1 )
+		SetThreadAffinityMask( GetCurrentThread( ), (DWORD_PTR)1 << sys_cpus[ index % sys_numCpus ] );
+}
+
+/*
+==============
+Sys_LockMemory
+
+Faults in and locks base, the pages never get paged out
+==============
+*/
+void Sys_LockMemory( void *base, size_t size )
+{
+	SIZE_T minSize, maxSize;
+
+	// the working set has to be able to hold it
+	if( GetProcessWorkingSetSize( GetCurrentProcess( ), &minSize, &maxSize ) )
+		SetProcessWorkingSetSize( GetCurrentProcess( ), minSize + size, maxSize + size );
+
+	if( !VirtualLock( base, size ) )
+		Com_Printf( "WARNING: couldn't lock %i megs of memory\n", (int)( size >> 20 ) );
+	else
+		Com_Printf( "%i megs of memory locked\n", (int)( size >> 20 ) );
+}
+
+/*
+==============
+Sys_ThreadMain
+==============
+*/
+static DWORD WINAPI Sys_ThreadMain( LPVOID arg )
+{
+	sysThread_t *thread = arg;
+
+	// off the main thread's CPU, onto all of com_affinity
+	if( sys_numCpus > 1 )
+		SetThreadAffinityMask( GetCurrentThread( ), sys_cpuMask );
+
+	thread->func( thread->arg );
+
+	return 0;
+}
+
+/*
+==============
+Sys_CreateThread
+==============
+*/
+sysThread_t *Sys_CreateThread( void (*func)( void *arg ), void *arg )
+{
+	sysThread_t *thread = malloc( sizeof( *thread ) );
+
+	if( !thread )
+		return NULL;
+
+	thread->func = func;
+	thread->arg = arg;
+	thread->handle = CreateThread( NULL, 0, Sys_ThreadMain, thread, 0, NULL );
+
+	if( !thread->handle )
+	{
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+/*
+==============
+Sys_JoinThread
+==============
+*/
+void Sys_JoinThread( sysThread_t *thread )
+{
+	WaitForSingleObject( thread->handle, INFINITE );
+	CloseHandle( thread->handle );
+	free( thread );
+}
+
+/*
+==============
+Sys_CreateMutex
+==============
+*/
+sysMutex_t *Sys_CreateMutex( void )
+{
+	sysMutex_t *mutex = malloc( sizeof( *mutex ) );
+
+	if( !mutex )
+		return NULL;
+
+	InitializeCriticalSection( &mutex->cs );
+
+	return mutex;
+}
+
+/*
+==============
+Sys_DestroyMutex
+==============
+*/
+void Sys_DestroyMutex( sysMutex_t *mutex )
+{
+	DeleteCriticalSection( &mutex->cs );
+	free( mutex );
+}
+
+/*
+==============
+Sys_LockMutex
+==============
+*/
+void Sys_LockMutex( sysMutex_t *mutex )
+{
+	EnterCriticalSection( &mutex->cs );
+}
+
+/*
+==============
+Sys_UnlockMutex
+==============
+*/
+void Sys_UnlockMutex( sysMutex_t *mutex )
+{
+	LeaveCriticalSection( &mutex->cs );
+}
+
+/*
+==============
+Sys_CreateSemaphore
+==============
+*/
+sysSemaphore_t *Sys_CreateSemaphore( void )
+{
+	sysSemaphore_t *sem = malloc( sizeof( *sem ) );
+
+	if( !sem )
+		return NULL;
+
+	sem->handle = CreateSemaphore( NULL, 0, 0x7fffffff, NULL );
+
+	if( !sem->handle )
+	{
+		free( sem );
+		return NULL;
+	}
+
+	return sem;
+}
+
+/*
+==============
+Sys_DestroySemaphore
+==============
+*/
+void Sys_DestroySemaphore( sysSemaphore_t *sem )
+{
+	CloseHandle( sem->handle );
+	free( sem );
+}
+
+/*
+==============
+Sys_PostSemaphore
+==============
+*/
+void Sys_PostSemaphore( sysSemaphore_t *sem )
+{
+	ReleaseSemaphore( sem->handle, 1, NULL );
+}
+
+/*
+==============
+Sys_WaitSemaphore
+==============
+*/
+void Sys_WaitSemaphore( sysSemaphore_t *sem )
+{
+	WaitForSingleObject( sem->handle, INFINITE );
+}
+
+/*
+==============
+Sys_MemoryBarrier
+
+Orders the memory accesses before and after it, for lock-free
+hand-offs between threads
+==============
+*/
+void Sys_MemoryBarrier( void )
+{
+	MemoryBarrier( );
+}
+
+/*
+==============
+Sys_AtomicAdd
+
+Returns the new value, a full barrier like Sys_MemoryBarrier
+==============
+*/
+int Sys_AtomicAdd( volatile int *value, int add )
+{
+	return InterlockedExchangeAdd( (volatile LONG *)value, add ) + add;
+}
+
+/*
+==============
+Sys_AtomicCompareExchange
+
+Sets *value to exchange if it is still compare, a full barrier
+==============
+*/
+qboolean Sys_AtomicCompareExchange( volatile int *value, int compare, int exchange )
+{
+	return InterlockedCompareExchange( (volatile LONG *)value, exchange, compare ) == compare ? qtrue : qfalse;
+}
+
+/*
+==============================================================================
+
+PROFILING
+
+==============================================================================
+*/
+
+/*
+==============
+Sys_StartProfileTimer
+==============
+*/
+qboolean Sys_StartProfileTimer( int hz, void (*handler)( void *ip, void *sp, void *fp ) )
+{
+	return qfalse;
+}
+
+/*
+==============
+Sys_StopProfileTimer
+==============
+*/
+void Sys_StopProfileTimer( void )
+{
+}
+
+/*
+==============
+Sys_AddressToSymbol
+==============
+*/
+qboolean Sys_AddressToSymbol( const void *address, const void *moduleAddress, char *name, int size )
+{
+	return qfalse;
+}
+
+/*
+==============================================================================
+
+MEMORY FAULTS
+
+==============================================================================
+*/
+
+/*
+==============
+Sys_ChainFaultHandler
+==============
+*/
+void Sys_ChainFaultHandler( void )
+{
+}
+
+/*
+==============
+Sys_SetFaultHandler
+==============
+*/
+qboolean Sys_SetFaultHandler( void *(*handler)( void *address, void *ip ) )
+{
+	return qfalse;
+}